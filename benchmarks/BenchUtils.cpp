@@ -0,0 +1,168 @@
+#include "BenchUtils.hpp"
+
+#include <polyfem/utils/Logger.hpp>
+
+#include <cmath>
+#include <map>
+#include <tuple>
+#include <utility>
+
+namespace polyfem::bench
+{
+	void regular_grid(const int dim, const int n, Eigen::MatrixXd &V, Eigen::MatrixXi &F)
+	{
+		assert(dim == 2 || dim == 3);
+		assert(n > 0);
+
+		const int np = n + 1;
+		const auto vid = [np](const int i, const int j, const int k) { return i + np * (j + np * k); };
+
+		if (dim == 2)
+		{
+			V.resize(np * np, 2);
+			for (int j = 0; j < np; ++j)
+				for (int i = 0; i < np; ++i)
+					V.row(vid(i, j, 0)) << double(i) / n, double(j) / n;
+
+			F.resize(2 * n * n, 3);
+			int f = 0;
+			for (int j = 0; j < n; ++j)
+			{
+				for (int i = 0; i < n; ++i)
+				{
+					F.row(f++) << vid(i, j, 0), vid(i + 1, j, 0), vid(i + 1, j + 1, 0);
+					F.row(f++) << vid(i, j, 0), vid(i + 1, j + 1, 0), vid(i, j + 1, 0);
+				}
+			}
+			return;
+		}
+
+		V.resize(np * np * np, 3);
+		for (int k = 0; k < np; ++k)
+			for (int j = 0; j < np; ++j)
+				for (int i = 0; i < np; ++i)
+					V.row(vid(i, j, k)) << double(i) / n, double(j) / n, double(k) / n;
+
+		// Kuhn subdivision, the 6 tetrahedra share the diagonal (0, 0, 0)-(1, 1, 1) of the cell,
+		// the odd permutations are flipped to have positive volumes
+		static const int paths[6][3] = {{0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}};
+		static const bool odd[6] = {false, true, true, false, false, true};
+		F.resize(6 * n * n * n, 4);
+		int f = 0;
+		for (int k = 0; k < n; ++k)
+		{
+			for (int j = 0; j < n; ++j)
+			{
+				for (int i = 0; i < n; ++i)
+				{
+					for (int p = 0; p < 6; ++p)
+					{
+						int c[3] = {i, j, k};
+						F(f, 0) = vid(c[0], c[1], c[2]);
+						for (int l = 0; l < 3; ++l)
+						{
+							++c[paths[p][l]];
+							F(f, l + 1) = vid(c[0], c[1], c[2]);
+						}
+						if (odd[p])
+							std::swap(F(f, 1), F(f, 2));
+						++f;
+					}
+				}
+			}
+		}
+	}
+
+	std::shared_ptr<State> get_state(const int dim, const int n, const std::string &material, const bool contact)
+	{
+		static std::map<std::tuple<int, int, std::string, bool>, std::shared_ptr<State>> states;
+
+		auto &state = states[{dim, n, material, contact}];
+		if (state)
+			return state;
+
+		json in_args = R"(
+		{
+			"materials": {
+				"E": 20000,
+				"nu": 0.3,
+				"rho": 1000
+			},
+			"contact": {
+				"dhat": 0.001
+			},
+			"output": {
+				"log": {
+					"level": "warning"
+				}
+			}
+		})"_json;
+		in_args["materials"]["type"] = material;
+		in_args["contact"]["enabled"] = contact;
+
+		Eigen::MatrixXd V;
+		Eigen::MatrixXi F;
+		regular_grid(dim, n, V, F);
+
+		if (contact)
+		{
+			// second copy on top of the first, closer than dhat
+			const double gap = 0.5 * in_args["contact"]["dhat"].get<double>();
+			Eigen::MatrixXd V2 = V;
+			V2.col(1).array() += 1 + gap;
+			Eigen::MatrixXd VV(2 * V.rows(), dim);
+			VV << V, V2;
+			Eigen::MatrixXi FF(2 * F.rows(), F.cols());
+			FF << F, F.array() + V.rows();
+			V = VV;
+			F = FF;
+		}
+
+		state = std::make_shared<State>();
+		state->init(in_args, true);
+		state->load_mesh(V, F);
+		state->build_basis();
+		state->assemble_rhs();
+		state->assemble_mass_mat();
+
+		return state;
+	}
+
+	Eigen::MatrixXd displacement(const State &state, const double amplitude)
+	{
+		const int dim = state.mesh->dimension();
+		const int problem_dim = state.problem->is_scalar() ? 1 : dim;
+
+		Eigen::MatrixXd u(state.n_bases * problem_dim, 1);
+		for (const auto &eb : state.bases)
+		{
+			for (const auto &b : eb.bases)
+			{
+				for (const auto &g : b.global())
+				{
+					for (int d = 0; d < problem_dim; ++d)
+					{
+						double val = 1;
+						for (int c = 0; c < dim; ++c)
+							val *= std::sin(3.14159265358979 * (g.node(c) + 0.1 * (d + 1)));
+						u(g.index * problem_dim + d) = amplitude * val;
+					}
+				}
+			}
+		}
+
+		return u;
+	}
+
+	std::vector<int> &mesh_sizes()
+	{
+		static std::vector<int> sizes = {8, 16, 32};
+		return sizes;
+	}
+
+	std::vector<int> &dimensions()
+	{
+		static std::vector<int> dims = {2, 3};
+		return dims;
+	}
+} // namespace polyfem::bench
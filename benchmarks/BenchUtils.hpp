@@ -0,0 +1,38 @@
+#pragma once
+
+#include <polyfem/State.hpp>
+
+#include <Eigen/Dense>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace polyfem::bench
+{
+	/// @brief Regular grid of [0, 1]^dim with n cells per side, cells are split in 2 triangles or 6 tetrahedra
+	/// @param[in] dim dimension, 2 or 3
+	/// @param[in] n number of cells per side
+	/// @param[out] V vertices
+	/// @param[out] F triangles or tetrahedra
+	void regular_grid(const int dim, const int n, Eigen::MatrixXd &V, Eigen::MatrixXi &F);
+
+	/// @brief State with bases, rhs and mass matrix on a generated grid, states are cached and shared between benchmarks
+	/// @param[in] dim dimension, 2 or 3
+	/// @param[in] n number of cells per side
+	/// @param[in] material material type (/materials/type)
+	/// @param[in] contact if true, the mesh is two grids stacked at half the barrier distance with contact enabled
+	std::shared_ptr<State> get_state(const int dim, const int n, const std::string &material, const bool contact = false);
+
+	/// @brief Deterministic smooth displacement of the dofs, scaled by amplitude
+	Eigen::MatrixXd displacement(const State &state, const double amplitude);
+
+	/// @brief Mesh sizes (cells per side) the benchmarks are registered for
+	std::vector<int> &mesh_sizes();
+	/// @brief Dimensions the benchmarks are registered for
+	std::vector<int> &dimensions();
+
+	void register_assembly_benchmarks();
+	void register_contact_benchmarks();
+	void register_output_benchmarks();
+} // namespace polyfem::bench
@@ -0,0 +1,158 @@
+#include "BenchUtils.hpp"
+
+#include <polyfem/assembler/AssemblyValsCache.hpp>
+#include <polyfem/utils/MatrixUtils.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <fmt/format.h>
+
+namespace polyfem::bench
+{
+	namespace
+	{
+		using namespace polyfem::assembler;
+
+		// nonlinear materials benchmarked for energy, gradient and hessian
+		const std::vector<std::string> nl_materials = {"LinearElasticity", "NeoHookean", "SaintVenant"};
+
+		void set_counters(benchmark::State &bench, const State &state)
+		{
+			bench.counters["elements"] = state.bases.size();
+			bench.counters["bases"] = state.n_bases;
+		}
+
+		void cache_init(benchmark::State &bench, const int dim, const int n)
+		{
+			const auto state = get_state(dim, n, "Laplacian");
+			for (auto _ : bench)
+			{
+				AssemblyValsCache cache;
+				cache.init(state->mesh->is_volume(), state->bases, state->geom_bases());
+				benchmark::ClobberMemory();
+			}
+			set_counters(bench, *state);
+		}
+
+		void linear_assemble(benchmark::State &bench, const int dim, const int n, const std::string &material)
+		{
+			const auto state = get_state(dim, n, material);
+			StiffnessMatrix stiffness;
+			for (auto _ : bench)
+			{
+				state->assembler->assemble(state->mesh->is_volume(), state->n_bases, state->bases, state->geom_bases(), state->ass_vals_cache, stiffness);
+				benchmark::DoNotOptimize(stiffness.valuePtr());
+			}
+			set_counters(bench, *state);
+			bench.counters["nnz"] = stiffness.nonZeros();
+		}
+
+		void nl_energy(benchmark::State &bench, const int dim, const int n, const std::string &material)
+		{
+			const auto state = get_state(dim, n, material);
+			const Eigen::MatrixXd u = displacement(*state, 1e-2);
+			for (auto _ : bench)
+			{
+				const double energy = state->assembler->assemble_energy(state->mesh->is_volume(), state->bases, state->geom_bases(), state->ass_vals_cache, 0, u, Eigen::MatrixXd());
+				benchmark::DoNotOptimize(energy);
+			}
+			set_counters(bench, *state);
+		}
+
+		void nl_gradient(benchmark::State &bench, const int dim, const int n, const std::string &material)
+		{
+			const auto state = get_state(dim, n, material);
+			const Eigen::MatrixXd u = displacement(*state, 1e-2);
+			Eigen::MatrixXd grad;
+			for (auto _ : bench)
+			{
+				state->assembler->assemble_gradient(state->mesh->is_volume(), state->n_bases, state->bases, state->geom_bases(), state->ass_vals_cache, 0, u, Eigen::MatrixXd(), grad);
+				benchmark::DoNotOptimize(grad.data());
+			}
+			set_counters(bench, *state);
+		}
+
+		void nl_hessian(benchmark::State &bench, const int dim, const int n, const std::string &material)
+		{
+			const auto state = get_state(dim, n, material);
+			const Eigen::MatrixXd u = displacement(*state, 1e-2);
+			// the cache keeps its mapping between iterations as in the nonlinear solves
+			utils::SparseMatrixCache mat_cache;
+			StiffnessMatrix hessian;
+			for (auto _ : bench)
+			{
+				state->assembler->assemble_hessian(state->mesh->is_volume(), state->n_bases, false, state->bases, state->geom_bases(), state->ass_vals_cache, 0, u, Eigen::MatrixXd(), mat_cache, hessian);
+				benchmark::DoNotOptimize(hessian.valuePtr());
+			}
+			set_counters(bench, *state);
+			bench.counters["nnz"] = hessian.nonZeros();
+		}
+
+		// adds a dense block of ones per element, as the scalar assemblers do
+		void fill_cache(const State &state, utils::SparseMatrixCache &cache)
+		{
+			for (int e = 0; e < state.bases.size(); ++e)
+			{
+				const auto &bs = state.bases[e].bases;
+				for (const auto &bi : bs)
+					for (const auto &bj : bs)
+						cache.add_value(e, bi.global()[0].index, bj.global()[0].index, 1);
+			}
+		}
+
+		// first assembly (triplets and mapping) or later assemblies through the mapping
+		void get_matrix(benchmark::State &bench, const int dim, const int n, const bool mapped)
+		{
+			const auto state = get_state(dim, n, "Laplacian");
+
+			utils::SparseMatrixCache mapped_cache(state->n_bases);
+			fill_cache(*state, mapped_cache);
+			StiffnessMatrix mat = mapped_cache.get_matrix();
+
+			for (auto _ : bench)
+			{
+				if (mapped)
+				{
+					mapped_cache.set_zero();
+					fill_cache(*state, mapped_cache);
+					mat = mapped_cache.get_matrix();
+				}
+				else
+				{
+					utils::SparseMatrixCache cache(state->n_bases);
+					fill_cache(*state, cache);
+					mat = cache.get_matrix();
+				}
+				benchmark::DoNotOptimize(mat.valuePtr());
+			}
+			set_counters(bench, *state);
+			bench.counters["nnz"] = mat.nonZeros();
+		}
+	} // namespace
+
+	void register_assembly_benchmarks()
+	{
+		for (const int dim : dimensions())
+		{
+			for (const int n : mesh_sizes())
+			{
+				const std::string suffix = fmt::format("/{}D/{}", dim, n);
+
+				benchmark::RegisterBenchmark(("AssemblyValsCache::init" + suffix).c_str(), cache_init, dim, n)->Unit(benchmark::kMillisecond);
+
+				for (const std::string material : {"Laplacian", "LinearElasticity"})
+					benchmark::RegisterBenchmark(fmt::format("LinearAssembler::assemble/{}{}", material, suffix).c_str(), linear_assemble, dim, n, material)->Unit(benchmark::kMillisecond);
+
+				for (const auto &material : nl_materials)
+				{
+					benchmark::RegisterBenchmark(fmt::format("NLAssembler::assemble_energy/{}{}", material, suffix).c_str(), nl_energy, dim, n, material)->Unit(benchmark::kMillisecond);
+					benchmark::RegisterBenchmark(fmt::format("NLAssembler::assemble_gradient/{}{}", material, suffix).c_str(), nl_gradient, dim, n, material)->Unit(benchmark::kMillisecond);
+					benchmark::RegisterBenchmark(fmt::format("NLAssembler::assemble_hessian/{}{}", material, suffix).c_str(), nl_hessian, dim, n, material)->Unit(benchmark::kMillisecond);
+				}
+
+				benchmark::RegisterBenchmark(("SparseMatrixCache::get_matrix/first" + suffix).c_str(), get_matrix, dim, n, false)->Unit(benchmark::kMillisecond);
+				benchmark::RegisterBenchmark(("SparseMatrixCache::get_matrix/mapped" + suffix).c_str(), get_matrix, dim, n, true)->Unit(benchmark::kMillisecond);
+			}
+		}
+	}
+} // namespace polyfem::bench
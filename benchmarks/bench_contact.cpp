@@ -0,0 +1,116 @@
+#include "BenchUtils.hpp"
+
+#include <polyfem/solver/forms/ContactForm.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <fmt/format.h>
+
+namespace polyfem::bench
+{
+	namespace
+	{
+		using namespace polyfem::solver;
+
+		std::unique_ptr<ContactForm> make_form(const State &state)
+		{
+			const json &contact = state.args["contact"];
+			const json &ccd = state.args["solver"]["contact"];
+			return std::make_unique<ContactForm>(
+				state.collision_mesh, contact["dhat"], state.avg_mass,
+				/*use_convergent_formulation=*/false, /*use_adaptive_barrier_stiffness=*/false,
+				/*is_time_dependent=*/false, ipc::BroadPhaseMethod::HASH_GRID,
+				ccd["CCD"]["tolerance"], ccd["CCD"]["max_iterations"]);
+		}
+
+		void set_counters(benchmark::State &bench, const State &state)
+		{
+			bench.counters["elements"] = state.bases.size();
+			bench.counters["collision_vertices"] = state.collision_mesh.num_vertices();
+		}
+
+		void value(benchmark::State &bench, const int dim, const int n)
+		{
+			const auto state = get_state(dim, n, "NeoHookean", true);
+			const auto form = make_form(*state);
+			const Eigen::VectorXd x = Eigen::VectorXd::Zero(state->n_bases * dim);
+			form->init(x);
+			for (auto _ : bench)
+			{
+				// the constraint set is rebuilt every time as in the line search
+				form->solution_changed(x);
+				benchmark::DoNotOptimize(form->value(x));
+			}
+			set_counters(bench, *state);
+		}
+
+		void gradient(benchmark::State &bench, const int dim, const int n)
+		{
+			const auto state = get_state(dim, n, "NeoHookean", true);
+			const auto form = make_form(*state);
+			const Eigen::VectorXd x = Eigen::VectorXd::Zero(state->n_bases * dim);
+			form->init(x);
+			form->solution_changed(x);
+			Eigen::VectorXd grad;
+			for (auto _ : bench)
+			{
+				form->first_derivative(x, grad);
+				benchmark::DoNotOptimize(grad.data());
+			}
+			set_counters(bench, *state);
+		}
+
+		void hessian(benchmark::State &bench, const int dim, const int n)
+		{
+			const auto state = get_state(dim, n, "NeoHookean", true);
+			const auto form = make_form(*state);
+			const Eigen::VectorXd x = Eigen::VectorXd::Zero(state->n_bases * dim);
+			form->init(x);
+			form->solution_changed(x);
+			StiffnessMatrix hess;
+			for (auto _ : bench)
+			{
+				form->second_derivative(x, hess);
+				benchmark::DoNotOptimize(hess.valuePtr());
+			}
+			set_counters(bench, *state);
+			bench.counters["nnz"] = hess.nonZeros();
+		}
+
+		void max_step_size(benchmark::State &bench, const int dim, const int n)
+		{
+			const auto state = get_state(dim, n, "NeoHookean", true);
+			const auto form = make_form(*state);
+			const Eigen::VectorXd x0 = Eigen::VectorXd::Zero(state->n_bases * dim);
+			form->init(x0);
+
+			// the top grid moves down through the bottom one
+			Eigen::VectorXd x1 = x0;
+			for (const auto &eb : state->bases)
+				for (const auto &b : eb.bases)
+					for (const auto &g : b.global())
+						if (g.node(1) > 1)
+							x1(g.index * dim + 1) = -0.5;
+
+			for (auto _ : bench)
+				benchmark::DoNotOptimize(form->max_step_size(x0, x1));
+			set_counters(bench, *state);
+		}
+	} // namespace
+
+	void register_contact_benchmarks()
+	{
+		for (const int dim : dimensions())
+		{
+			for (const int n : mesh_sizes())
+			{
+				const std::string suffix = fmt::format("/{}D/{}", dim, n);
+
+				benchmark::RegisterBenchmark(("ContactForm::value" + suffix).c_str(), value, dim, n)->Unit(benchmark::kMillisecond);
+				benchmark::RegisterBenchmark(("ContactForm::first_derivative" + suffix).c_str(), gradient, dim, n)->Unit(benchmark::kMillisecond);
+				benchmark::RegisterBenchmark(("ContactForm::second_derivative" + suffix).c_str(), hessian, dim, n)->Unit(benchmark::kMillisecond);
+				benchmark::RegisterBenchmark(("ContactForm::max_step_size" + suffix).c_str(), max_step_size, dim, n)->Unit(benchmark::kMillisecond);
+			}
+		}
+	}
+} // namespace polyfem::bench
@@ -0,0 +1,76 @@
+#include "BenchUtils.hpp"
+
+#include <polyfem/io/Evaluator.hpp>
+#include <polyfem/io/OutData.hpp>
+#include <polyfem/utils/RefElementSampler.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <fmt/format.h>
+
+#include <filesystem>
+
+namespace polyfem::bench
+{
+	namespace
+	{
+		void set_counters(benchmark::State &bench, const State &state)
+		{
+			bench.counters["elements"] = state.bases.size();
+			bench.counters["bases"] = state.n_bases;
+		}
+
+		void interpolate_function(benchmark::State &bench, const int dim, const int n)
+		{
+			const auto state = get_state(dim, n, "NeoHookean");
+			const Eigen::MatrixXd u = displacement(*state, 1e-2);
+
+			utils::RefElementSampler sampler;
+			sampler.init(state->mesh->is_volume(), state->mesh->n_elements(), state->args["output"]["paraview"]["vismesh_rel_area"]);
+			// the generated meshes are simplicial
+			const int n_points = state->mesh->n_elements() * sampler.simplex_points().rows();
+
+			Eigen::MatrixXd result;
+			for (auto _ : bench)
+			{
+				io::Evaluator::interpolate_function(
+					*state->mesh, dim, state->bases, state->disc_orders, state->polys, state->polys_3d,
+					sampler, n_points, u, result, /*use_sampler=*/true, /*boundary_only=*/false);
+				benchmark::DoNotOptimize(result.data());
+			}
+			set_counters(bench, *state);
+			bench.counters["points"] = n_points;
+		}
+
+		void save_vtu(benchmark::State &bench, const int dim, const int n)
+		{
+			const auto state = get_state(dim, n, "NeoHookean");
+			const Eigen::MatrixXd u = displacement(*state, 1e-2);
+
+			const std::string path = (std::filesystem::temp_directory_path() / fmt::format("polyfem_bench_{}d_{}.vtu", dim, n)).string();
+			const io::OutGeometryData::ExportOptions opts(state->args, state->mesh->is_linear(), state->problem->is_scalar(), /*solve_export_to_file=*/true);
+			std::vector<io::SolutionFrame> frames;
+
+			for (auto _ : bench)
+				state->out_geom.save_vtu(path, *state, u, Eigen::MatrixXd(), 0, 1, opts, false, frames);
+			set_counters(bench, *state);
+
+			std::error_code ec;
+			std::filesystem::remove(path, ec);
+		}
+	} // namespace
+
+	void register_output_benchmarks()
+	{
+		for (const int dim : dimensions())
+		{
+			for (const int n : mesh_sizes())
+			{
+				const std::string suffix = fmt::format("/{}D/{}", dim, n);
+
+				benchmark::RegisterBenchmark(("Evaluator::interpolate_function" + suffix).c_str(), interpolate_function, dim, n)->Unit(benchmark::kMillisecond);
+				benchmark::RegisterBenchmark(("OutGeometryData::save_vtu" + suffix).c_str(), save_vtu, dim, n)->Unit(benchmark::kMillisecond);
+			}
+		}
+	}
+} // namespace polyfem::bench
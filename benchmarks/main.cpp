@@ -0,0 +1,70 @@
+////////////////////////////////////////////////////////////////////////////////
+// Benchmarks of the hot paths on generated grids, e.g.
+//     polyfem_bench --mesh_sizes=8,16,32 --dims=2,3 --benchmark_filter=NLAssembler \
+//                   --benchmark_out=bench.json --benchmark_out_format=json
+// The remaining options are the ones of Google Benchmark (--help).
+////////////////////////////////////////////////////////////////////////////////
+
+#include "BenchUtils.hpp"
+
+#include <polyfem/utils/StringUtils.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	bool parse_list(const std::string &arg, const std::string &flag, std::vector<int> &values)
+	{
+		const std::string prefix = "--" + flag + "=";
+		if (arg.rfind(prefix, 0) != 0)
+			return false;
+
+		values.clear();
+		for (const std::string &v : polyfem::utils::StringUtils::split(arg.substr(prefix.size()), ","))
+		{
+			if (!v.empty())
+				values.push_back(std::stoi(v));
+		}
+		return true;
+	}
+} // namespace
+
+int main(int argc, char **argv)
+{
+	using namespace polyfem::bench;
+
+	// consume the polyfem options, the others are forwarded to Google Benchmark
+	std::vector<char *> args = {argv[0]};
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!parse_list(argv[i], "mesh_sizes", mesh_sizes()) && !parse_list(argv[i], "dims", dimensions()))
+			args.push_back(argv[i]);
+	}
+	int n_args = args.size();
+
+	for (const int dim : dimensions())
+	{
+		if (dim != 2 && dim != 3)
+		{
+			std::cerr << "Invalid dimension " << dim << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	register_assembly_benchmarks();
+	register_contact_benchmarks();
+	register_output_benchmarks();
+
+	benchmark::Initialize(&n_args, args.data());
+	if (benchmark::ReportUnrecognizedArguments(n_args, args.data()))
+		return EXIT_FAILURE;
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+
+	return EXIT_SUCCESS;
+}
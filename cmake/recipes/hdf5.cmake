@@ -21,6 +21,10 @@ option(HDF5_TEST_SWMR OFF)
 option(HDF5_TEST_TOOLS OFF)
 option(HDF5_TEST_VFD OFF)
 
+# deflate filter, the VTKHDF output writes zlib compressed chunks
+include(zlib)
+option(HDF5_ENABLE_Z_LIB_SUPPORT "" ON)
+
 #To prevent changes in the oput dirs
 set (HDF5_EXTERNALLY_CONFIGURED 1)
 
@@ -0,0 +1,32 @@
+# zlib
+# License: zlib
+
+if(TARGET ZLIB::ZLIB)
+    return()
+endif()
+
+# use the system zlib if any, hdf5 finds the same one for its deflate filter
+find_package(ZLIB QUIET)
+if(ZLIB_FOUND)
+    return()
+endif()
+
+message(STATUS "Third-party: creating target 'ZLIB::ZLIB'")
+
+include(FetchContent)
+FetchContent_Declare(
+    zlib
+    GIT_REPOSITORY https://github.com/madler/zlib.git
+    GIT_TAG v1.2.13
+    GIT_SHALLOW TRUE
+)
+FetchContent_MakeAvailable(zlib)
+
+target_include_directories(zlibstatic PUBLIC ${zlib_SOURCE_DIR} ${zlib_BINARY_DIR})
+add_library(ZLIB::ZLIB ALIAS zlibstatic)
+
+# seen by the zlib lookup of hdf5
+set(ZLIB_FOUND TRUE)
+set(ZLIB_LIBRARIES zlibstatic)
+set(ZLIB_INCLUDE_DIRS ${zlib_SOURCE_DIR} ${zlib_BINARY_DIR})
+set(ZLIB_INCLUDE_DIR ${zlib_SOURCE_DIR} ${zlib_BINARY_DIR})
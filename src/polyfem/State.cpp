@@ -15,6 +15,8 @@
 
 #include <polyfem/basis/LagrangeBasis2d.hpp>
 #include <polyfem/basis/LagrangeBasis3d.hpp>
+#include <polyfem/basis/NodeOrdering.hpp>
+#include <polyfem/basis/AdaptiveQuadrature.hpp>
 
 #include <polyfem/refinement/APriori.hpp>
 
@@ -36,6 +38,7 @@
 #include <polyfem/quadrature/TriQuadrature.hpp>
 
 #include <polyfem/utils/Logger.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
 #include <polyfem/utils/Timer.hpp>
 
 #include <igl/Timer.h>
@@ -44,6 +47,7 @@
 #include <algorithm>
 #include <memory>
 #include <filesystem>
+#include <set>
 
 #include <polyfem/utils/autodiff.h>
 DECLARE_DIFFSCALAR_BASE();
@@ -151,9 +155,9 @@ namespace polyfem
 			timer.start();
 			for (int in_ei = 0; in_ei < in_ordered_edges.rows(); in_ei++)
 			{
-				const std::pair<int, int> in_edge(
+				const std::array<int, 2> in_edge = {{
 					in_ordered_edges.row(in_ei).minCoeff(),
-					in_ordered_edges.row(in_ei).maxCoeff());
+					in_ordered_edges.row(in_ei).maxCoeff()}};
 				in_primitive_to_primitive[in_offset + in_ei] =
 					offset + edges_to_ids.at(in_edge); // offset edge ids
 			}
@@ -331,6 +335,13 @@ namespace polyfem
 			else
 				in_node_to_node[i] = possible_nodes[0];
 		}
+
+		// the bases were renumbered after being built
+		if (node_ordering.size() > 0)
+		{
+			for (int i = 0; i < num_nodes; i++)
+				in_node_to_node[i] = node_ordering[in_node_to_node[i]];
+		}
 		timer.stop();
 		logger().trace("Done (took {}s)", timer.getElapsedTime());
 	}
@@ -519,12 +530,15 @@ namespace polyfem
 
 	void State::build_basis()
 	{
+		utils::TaskArenaScope arena_scope(task_arena.get());
+
 		if (!mesh)
 		{
 			logger().error("Load the mesh first!");
 			return;
 		}
 
+		mesh->set_use_navigation_tables(args["space"]["advanced"]["navigation_tables"]);
 		mesh->prepare_mesh();
 
 		bases.clear();
@@ -539,6 +553,7 @@ namespace polyfem
 		polys.clear();
 		poly_edge_to_data.clear();
 		rhs.resize(0, 0);
+		nullspace_rest_vertices.resize(0, 0);
 
 		if (assembler::MultiModel *mm = dynamic_cast<assembler::MultiModel *>(assembler.get()))
 		{
@@ -572,6 +587,11 @@ namespace polyfem
 		local_neumann_boundary.clear();
 		std::map<int, basis::InterfaceData> poly_edge_to_data_geom; // temp dummy variable
 
+		// hexes with Gauss-Lobatto nodes, empty if none
+		std::vector<bool> gll_elements;
+		if (args["space"]["basis_type"] == "GLL")
+			gll_elements.assign(mesh->n_elements(), true);
+
 		const auto &tmp_json = args["space"]["discr_order"];
 		if (tmp_json.is_number_integer())
 		{
@@ -591,18 +611,29 @@ namespace polyfem
 			const auto b_discr_orders = tmp_json;
 
 			std::map<int, int> b_orders;
+			std::set<int> b_gll;
 			for (size_t i = 0; i < b_discr_orders.size(); ++i)
 			{
 				assert(b_discr_orders[i]["id"].is_array() || b_discr_orders[i]["id"].is_number_integer());
 
 				const int order = b_discr_orders[i]["order"];
+				const bool gll = b_discr_orders[i].value("gll", false);
 				for (const int id : json_as_array<int>(b_discr_orders[i]["id"]))
 				{
 					b_orders[id] = order;
-					logger().trace("bid {}, discr {}", id, order);
+					if (gll)
+						b_gll.insert(id);
+					logger().trace("bid {}, discr {}, gll {}", id, order, gll);
 				}
 			}
 
+			if (!b_gll.empty() && gll_elements.empty())
+			{
+				gll_elements.resize(mesh->n_elements());
+				for (int e = 0; e < mesh->n_elements(); ++e)
+					gll_elements[e] = b_gll.count(mesh->get_body_id(e)) > 0;
+			}
+
 			for (int e = 0; e < mesh->n_elements(); ++e)
 			{
 				const int bid = mesh->get_body_id(e);
@@ -688,7 +719,7 @@ namespace polyfem
 				if (!iso_parametric())
 					basis::LagrangeBasis3d::build_bases(tmp_mesh, assembler->name(), quadrature_order, mass_quadrature_order, geom_disc_orders, false, has_polys, true, geom_bases_, local_boundary, poly_edge_to_data_geom, mesh_nodes);
 
-				n_bases = basis::LagrangeBasis3d::build_bases(tmp_mesh, assembler->name(), quadrature_order, mass_quadrature_order, disc_orders, args["space"]["basis_type"] == "Serendipity", has_polys, false, bases, local_boundary, poly_edge_to_data, mesh_nodes);
+				n_bases = basis::LagrangeBasis3d::build_bases(tmp_mesh, assembler->name(), quadrature_order, mass_quadrature_order, disc_orders, args["space"]["basis_type"] == "Serendipity", has_polys, false, bases, local_boundary, poly_edge_to_data, mesh_nodes, gll_elements);
 			}
 
 			// if(problem->is_mixed())
@@ -717,6 +748,9 @@ namespace polyfem
 			}
 			else
 			{
+				if (!gll_elements.empty())
+					logger().warn("Gauss-Lobatto nodes are only supported on hexahedra, using equispaced Lagrange bases");
+
 				if (!iso_parametric())
 					basis::LagrangeBasis2d::build_bases(tmp_mesh, assembler->name(), quadrature_order, mass_quadrature_order, geom_disc_orders, false, has_polys, true, geom_bases_, local_boundary, poly_edge_to_data_geom, mesh_nodes);
 
@@ -730,6 +764,24 @@ namespace polyfem
 			}
 		}
 
+		const json &adaptive_quadrature_args = args["space"]["advanced"]["adaptive_quadrature"];
+		if (adaptive_quadrature_args["enabled"])
+		{
+			if (quadrature_order > 0 || mass_quadrature_order > 0)
+				logger().warn("Quadrature order is fixed, ignoring adaptive quadrature");
+			else
+			{
+				basis::adaptive_quadrature::Params params;
+				params.distortion_threshold = adaptive_quadrature_args["distortion_threshold"];
+				params.max_increase = adaptive_quadrature_args["max_increase"];
+				params.nonlinear_increase = adaptive_quadrature_args["nonlinear_increase"];
+				params.reduce_undistorted = adaptive_quadrature_args["reduce_undistorted"];
+
+				const int n_changed = basis::adaptive_quadrature::apply(assembler->name(), assembler->is_linear(), params, geom_bases(), bases);
+				logger().info("Adaptive quadrature changed the order of {} elements", n_changed);
+			}
+		}
+
 		if (mixed_assembler != nullptr)
 		{
 			assert(bases.size() == pressure_bases.size());
@@ -745,14 +797,24 @@ namespace polyfem
 
 		build_polygonal_basis();
 
+		node_ordering.resize(0);
+		const std::string node_ordering_type = args["space"]["advanced"]["node_ordering"];
+		if (node_ordering_type != "none")
+		{
+			igl::Timer timer2;
+			logger().debug("Reordering nodes ({})...", node_ordering_type);
+			timer2.start();
+			node_ordering = basis::node_ordering::compute(node_ordering_type, bases, n_bases);
+			basis::node_ordering::apply(node_ordering, bases);
+			timer2.stop();
+			logger().debug("Done (took {}s)", timer2.getElapsedTime());
+		}
+
 		auto &gbases = geom_bases();
 
 		for (const auto &lb : local_boundary)
 			total_local_boundary.emplace_back(lb);
 
-		if (args["space"]["advanced"]["count_flipped_els"])
-			stats.count_flipped_elements(*mesh, geom_bases());
-
 		const int prev_bases = n_bases;
 		n_bases += obstacle.n_vertices();
 
@@ -856,7 +918,7 @@ namespace polyfem
 
 		const auto &curret_bases = geom_bases();
 		const int n_samples = 10;
-		stats.compute_mesh_size(*mesh, curret_bases, n_samples, args["output"]["advanced"]["curved_mesh_size"]);
+		stats.compute_element_stats(*mesh, curret_bases, n_samples, args["output"]["advanced"]["curved_mesh_size"], args["space"]["advanced"]["count_flipped_els"]);
 
 		if (is_contact_enabled())
 		{
@@ -884,26 +946,66 @@ namespace polyfem
 
 		timings.building_basis_time = timer.getElapsedTime();
 		logger().info(" took {}s", timings.building_basis_time);
+		timings.sample_memory("build_basis");
 
 		logger().info("flipped elements {}", stats.n_flipped);
 		logger().info("h: {}", stats.mesh_size);
 		logger().info("n bases: {}", n_bases);
 		logger().info("n pressure bases: {}", n_pressure_bases);
 
-		ass_vals_cache.clear();
-		mass_ass_vals_cache.clear();
-		if (n_bases <= args["solver"]["advanced"]["cache_size"])
+		// after adapt_mesh the entries of the unchanged elements are kept
+		std::vector<int> previous_elements;
+		if (!prev_all_to_valid_elements.empty())
+			previous_elements = dynamic_cast<const NCMesh3D &>(*mesh).previous_elements(prev_all_to_valid_elements);
+		prev_all_to_valid_elements.clear();
+
+		// a budgeted cache is bounded in memory, it is also built for the meshes above cache_size
+		const size_t cache_budget = args["solver"]["advanced"]["cache_memory_budget"].get<double>() * 1024 * 1024;
+		if (n_bases <= args["solver"]["advanced"]["cache_size"] || cache_budget > 0)
 		{
+			const bool compact_cache = args["solver"]["advanced"]["compact_cache"];
+			const bool single_precision_cache = args["solver"]["advanced"]["cache_precision"] == "single";
+			if (previous_elements.empty() || compact_cache != ass_vals_cache.is_compact() || single_precision_cache != ass_vals_cache.is_single_precision())
+			{
+				ass_vals_cache.clear();
+				mass_ass_vals_cache.clear();
+			}
+			ass_vals_cache.set_compact(compact_cache);
+			mass_ass_vals_cache.set_compact(compact_cache);
+			pressure_ass_vals_cache.set_compact(compact_cache);
+			ass_vals_cache.set_single_precision(single_precision_cache);
+			mass_ass_vals_cache.set_single_precision(single_precision_cache);
+			pressure_ass_vals_cache.set_single_precision(single_precision_cache);
+			ass_vals_cache.set_memory_budget(cache_budget);
+			mass_ass_vals_cache.set_memory_budget(cache_budget);
+			pressure_ass_vals_cache.set_memory_budget(cache_budget);
+			// the mass and stiffness quadratures of Q_k elements are the same, their values are stored once
+			mass_ass_vals_cache.set_shared(&ass_vals_cache);
+
 			timer.start();
 			logger().info("Building cache...");
-			ass_vals_cache.init(mesh->is_volume(), bases, curret_bases);
-			mass_ass_vals_cache.init(mesh->is_volume(), bases, curret_bases, true);
+			if (previous_elements.empty())
+			{
+				ass_vals_cache.init(mesh->is_volume(), bases, curret_bases);
+				mass_ass_vals_cache.init(mesh->is_volume(), bases, curret_bases, true);
+			}
+			else
+			{
+				ass_vals_cache.update(mesh->is_volume(), bases, curret_bases, previous_elements);
+				mass_ass_vals_cache.update(mesh->is_volume(), bases, curret_bases, previous_elements, true);
+			}
 			if (mixed_assembler != nullptr)
 				pressure_ass_vals_cache.init(mesh->is_volume(), pressure_bases, curret_bases);
 
 			logger().info(" took {}s", timer.getElapsedTime());
 		}
+		else
+		{
+			ass_vals_cache.clear();
+			mass_ass_vals_cache.clear();
+		}
 
+		out_geom.clear_vis_cache();
 		out_geom.build_grid(*mesh, args["output"]["advanced"]["sol_on_grid"]);
 
 		if (!problem->is_time_dependent() && boundary_nodes.empty())
@@ -938,6 +1040,8 @@ namespace polyfem
 		assert(n_pressure_bases == 0 || poly_edge_to_data.size() == 0);
 
 		int new_bases = 0;
+		if (!polygon_samples_cache)
+			polygon_samples_cache = std::make_shared<basis::PolygonSamplesCache>();
 
 		if (iso_parametric())
 		{
@@ -997,7 +1101,8 @@ namespace polyfem
 						bases,
 						bases,
 						poly_edge_to_data,
-						polys);
+						polys,
+						polygon_samples_cache.get());
 				}
 			}
 		}
@@ -1063,7 +1168,8 @@ namespace polyfem
 						bases,
 						geom_bases_,
 						poly_edge_to_data,
-						polys);
+						polys,
+						polygon_samples_cache.get());
 				}
 			}
 		}
@@ -1080,7 +1186,32 @@ namespace polyfem
 		Eigen::MatrixXd node_positions;
 		Eigen::MatrixXi boundary_edges, boundary_triangles;
 		std::vector<Eigen::Triplet<double>> displacement_map_entries;
-		io::OutGeometryData::extract_boundary_mesh(*mesh, n_bases, bases, total_local_boundary,
+
+		// restrict the collision mesh to the boundary primitives with a selected id
+		std::vector<LocalBoundary> contact_local_boundary;
+		const std::vector<int> contact_boundary_ids = args["contact"]["boundary_ids"];
+		if (!contact_boundary_ids.empty())
+		{
+			const std::set<int> ids(contact_boundary_ids.begin(), contact_boundary_ids.end());
+			int n_primitives = 0, n_selected = 0;
+			for (const LocalBoundary &lb : total_local_boundary)
+			{
+				LocalBoundary selected(lb.element_id(), lb.type());
+				for (int j = 0; j < lb.size(); ++j)
+				{
+					++n_primitives;
+					if (ids.count(mesh->get_boundary_id(lb.global_primitive_id(j))))
+						selected.add_boundary_primitive(lb.global_primitive_id(j), lb[j]);
+				}
+				n_selected += selected.size();
+				if (!selected.empty())
+					contact_local_boundary.emplace_back(selected);
+			}
+			logger().info("Contact restricted to {}/{} boundary primitives", n_selected, n_primitives);
+		}
+
+		io::OutGeometryData::extract_boundary_mesh(*mesh, n_bases, bases,
+												   contact_boundary_ids.empty() ? total_local_boundary : contact_local_boundary,
 												   node_positions, boundary_edges, boundary_triangles, displacement_map_entries);
 
 		Eigen::VectorXi codimensional_nodes;
@@ -1136,15 +1267,94 @@ namespace polyfem
 											boundary_triangles,
 											displacement_map);
 
+		// same map as CollisionMesh::to_full_dof, used to move the contact Hessians in one pass
+		{
+			const int dim = mesh->dimension();
+			const Eigen::SparseMatrix<double, Eigen::RowMajor> vertex_map = displacement_map;
+			const bool is_identity = displacement_map_entries.empty();
+			const int n_vertices = collision_mesh.num_vertices();
+
+			// every vertex writes its entries at the prefix sum of the entry counts of the previous ones
+			std::vector<size_t> offsets(n_vertices + 1, 0);
+			for (int vi = 0; vi < n_vertices; ++vi)
+			{
+				const int fv = collision_mesh.to_full_vertex_id(vi);
+				offsets[vi + 1] = offsets[vi] + (is_identity ? 1 : vertex_map.outerIndexPtr()[fv + 1] - vertex_map.outerIndexPtr()[fv]) * dim;
+			}
+
+			std::vector<Eigen::Triplet<double>> entries(offsets.back());
+			utils::maybe_parallel_for(n_vertices, [&](int start, int end, int thread_id) {
+				for (int vi = start; vi < end; ++vi)
+				{
+					const int fv = collision_mesh.to_full_vertex_id(vi);
+					size_t index = offsets[vi];
+					if (is_identity)
+					{
+						for (int d = 0; d < dim; ++d)
+							entries[index++] = Eigen::Triplet<double>(fv * dim + d, vi * dim + d, 1);
+						continue;
+					}
+
+					for (Eigen::SparseMatrix<double, Eigen::RowMajor>::InnerIterator it(vertex_map, fv); it; ++it)
+						for (int d = 0; d < dim; ++d)
+							entries[index++] = Eigen::Triplet<double>(it.col() * dim + d, vi * dim + d, it.value());
+				}
+			});
+
+			const int n_full_vertices = is_identity ? collision_mesh.full_num_vertices() : n_bases;
+			collision_mesh_dof_map.resize(n_full_vertices * dim, collision_mesh.num_vertices() * dim);
+			collision_mesh_dof_map.setFromTriplets(entries.begin(), entries.end());
+			collision_mesh_dof_map.makeCompressed();
+		}
+
+		collision_groups = mesh::CollisionGroups(args["contact"]["collision_groups"], args["contact"]["disabled_group_pairs"]);
+		collision_vertex_groups.clear();
+		if (collision_groups.is_trivial())
+		{
+			collision_mesh.can_collide = [&](size_t vi, size_t vj) {
+				// obstacles do not collide with other obstacles
+				return !this->is_obstacle_vertex(collision_mesh.to_full_vertex_id(vi))
+					   || !this->is_obstacle_vertex(collision_mesh.to_full_vertex_id(vj));
+			};
+			return;
+		}
+
+		// body of every node, from the elements whose bases contain it
+		std::vector<int> node_body(n_bases, -1);
+		for (int e = 0; e < bases.size(); ++e)
+		{
+			const int body = mesh->get_body_id(e);
+			for (const auto &b : bases[e].bases)
+				for (const auto &g : b.global())
+					node_body[g.index] = body;
+		}
+
+		// the upsampled vertices take the body of a node they are interpolated from
+		const Eigen::SparseMatrix<double, Eigen::RowMajor> vertex_map = displacement_map;
+		collision_vertex_groups.resize(collision_mesh.num_vertices());
+		for (int vi = 0; vi < collision_mesh.num_vertices(); ++vi)
+		{
+			const int fv = collision_mesh.to_full_vertex_id(vi);
+			if (is_obstacle_vertex(fv))
+			{
+				collision_vertex_groups[vi] = collision_groups.obstacle_group();
+				continue;
+			}
+
+			const int node = displacement_map_entries.empty() ? fv : vertex_map.innerIndexPtr()[vertex_map.outerIndexPtr()[fv]];
+			collision_vertex_groups[vi] = node_body[node] < 0 ? collision_groups.default_group() : collision_groups.group(node_body[node]);
+		}
+
+		// the broad phases only keep the candidates with vertices in groups that can collide
 		collision_mesh.can_collide = [&](size_t vi, size_t vj) {
-			// obstacles do not collide with other obstacles
-			return !this->is_obstacle_vertex(collision_mesh.to_full_vertex_id(vi))
-				   || !this->is_obstacle_vertex(collision_mesh.to_full_vertex_id(vj));
+			return collision_groups.can_collide(collision_vertex_groups[vi], collision_vertex_groups[vj]);
 		};
 	}
 
 	void State::assemble_mass_mat()
 	{
+		utils::TaskArenaScope arena_scope(task_arena.get());
+
 		if (!mesh)
 		{
 			logger().error("Load the mesh first!");
@@ -1224,6 +1434,7 @@ namespace polyfem
 		timer.stop();
 		timings.assembling_mass_mat_time = timer.getElapsedTime();
 		logger().info(" took {}s", timings.assembling_mass_mat_time);
+		timings.sample_memory("assemble_mass_mat");
 
 		stats.nn_zero = mass.nonZeros();
 		stats.num_dofs = mass.rows();
@@ -1235,6 +1446,15 @@ namespace polyfem
 		const int n_bases,
 		const std::vector<basis::ElementBases> &bases,
 		const assembler::AssemblyValsCache &ass_vals_cache) const
+	{
+		return build_rhs_assembler(n_bases, bases, ass_vals_cache, *problem);
+	}
+
+	std::shared_ptr<RhsAssembler> State::build_rhs_assembler(
+		const int n_bases,
+		const std::vector<basis::ElementBases> &bases,
+		const assembler::AssemblyValsCache &ass_vals_cache,
+		const assembler::Problem &problem) const
 	{
 		json rhs_solver_params = args["solver"]["linear"];
 		rhs_solver_params["solver"]="Eigen::PardisoLDLT";
@@ -1246,12 +1466,31 @@ namespace polyfem
 			*assembler, *mesh, obstacle,
 			dirichlet_nodes, neumann_nodes,
 			dirichlet_nodes_position, neumann_nodes_position,
-			n_bases, size, bases, geom_bases(), ass_vals_cache, *problem,
+			n_bases, size, bases, geom_bases(), ass_vals_cache, problem,
 			args["space"]["advanced"]["bc_method"], rhs_solver_params["solver"], rhs_solver_params["precond"], rhs_solver_params);
 	}
 
+	json State::problem_parameters() const
+	{
+		json p_params = {};
+		p_params["formulation"] = assembler->name();
+		p_params["root_path"] = root_path();
+		{
+			RowVectorNd min, max, delta;
+			mesh->bounding_box(min, max);
+			delta = (max - min) / 2. + min;
+			if (mesh->is_volume())
+				p_params["bbox_center"] = {delta(0), delta(1), delta(2)};
+			else
+				p_params["bbox_center"] = {delta(0), delta(1)};
+		}
+		return p_params;
+	}
+
 	void State::assemble_rhs()
 	{
+		utils::TaskArenaScope arena_scope(task_arena.get());
+
 		if (!mesh)
 		{
 			logger().error("Load the mesh first!");
@@ -1268,19 +1507,7 @@ namespace polyfem
 		// if (args["boundary_conditions"]["rhs"].is_string())
 		// 	rhs_path = resolve_input_path(args["boundary_conditions"]["rhs"]);
 
-		json p_params = {};
-		p_params["formulation"] = assembler->name();
-		p_params["root_path"] = root_path();
-		{
-			RowVectorNd min, max, delta;
-			mesh->bounding_box(min, max);
-			delta = (max - min) / 2. + min;
-			if (mesh->is_volume())
-				p_params["bbox_center"] = {delta(0), delta(1), delta(2)};
-			else
-				p_params["bbox_center"] = {delta(0), delta(1)};
-		}
-		problem->set_parameters(p_params);
+		problem->set_parameters(problem_parameters());
 
 		rhs.resize(0, 0);
 
@@ -1323,10 +1550,13 @@ namespace polyfem
 		timer.stop();
 		timings.assigning_rhs_time = timer.getElapsedTime();
 		logger().info(" took {}s", timings.assigning_rhs_time);
+		timings.sample_memory("assemble_rhs");
 	}
 
 	void State::solve_problem(Eigen::MatrixXd &sol, Eigen::MatrixXd &pressure)
 	{
+		utils::TaskArenaScope arena_scope(task_arena.get());
+
 		if (!mesh)
 		{
 			logger().error("Load the mesh first!");
@@ -1352,28 +1582,8 @@ namespace polyfem
 		timer.start();
 		logger().info("Solving {}", assembler->name());
 
-		if(assembler->is_linear())
-		{
-			Eigen::MatrixXi tempF;
-			build_mesh_matrices(test_vertices,tempF);
-
-			test_boundary_nodes.clear();
-		}
-		else{
-			Eigen::MatrixXi tempV,tempF;
-			build_mesh_matrices(test_vertices,tempF);
-			int dim = mesh->dimension();
-			std::vector<int> order_nodes;
-			for (int i=0;i<boundary_nodes.size();i=i+dim)
-			{
-				order_nodes.push_back(boundary_nodes[i]/dim);
-			}
-			std::sort(order_nodes.begin(), order_nodes.end());
-			test_boundary_nodes=order_nodes;
-
-			// init_mesh_vertices(test_vertices);
-		}
-		
+		// the Newton solver removes the Dirichlet nodes, dirichlet_solve keeps them
+		update_nullspace_vertices(Eigen::MatrixXd(), !assembler->is_linear());
 
 		init_solve(sol, pressure);
 
@@ -1390,21 +1600,41 @@ namespace polyfem
 							  resolve_output_path(args["output"]["paraview"]["file_name"]));
 			}
 
+			const json &integrator = args["time"]["integrator"];
+			const std::string integrator_type = integrator.is_object() ? integrator["type"] : integrator;
+
 			if (assembler->name() == "NavierStokes")
 				solve_transient_navier_stokes(time_steps, t0, dt, sol, pressure);
 			else if (assembler->name() == "OperatorSplitting")
 				solve_transient_navier_stokes_split(time_steps, dt, sol, pressure);
+			else if (integrator_type == "CentralDifference" && !problem->is_scalar() && mixed_assembler == nullptr)
+				solve_transient_tensor_explicit(time_steps, t0, dt, sol);
 			else if (assembler->is_linear() && !is_contact_enabled()) // Collisions add nonlinearity to the problem
 				solve_transient_linear(time_steps, t0, dt, sol, pressure);
 			else if (!assembler->is_linear() && problem->is_scalar())
 				throw std::runtime_error("Nonlinear scalar problems are not supported yet!");
 			else
 				solve_transient_tensor_nonlinear(time_steps, t0, dt, sol);
+
+			flush_output();
 		}
 		else
 		{
 			if (assembler->name() == "NavierStokes")
 				solve_navier_stokes(sol, pressure);
+			else if (assembler->is_linear() && !is_contact_enabled() && !args["boundary_conditions"]["load_cases"].empty())
+			{
+				// the first load case is exported as the solution, all of them are written to /output/data/load_cases
+				Eigen::MatrixXd sols, pressures;
+				solve_linear_load_cases(args["boundary_conditions"]["load_cases"].get<std::vector<json>>(), sols, pressures);
+				sol = sols.col(0);
+				if (pressures.size() > 0)
+					pressure = pressures.col(0);
+
+				const std::string cases_path = resolve_output_path(args["output"]["data"]["load_cases"]);
+				if (!cases_path.empty())
+					write_matrix(cases_path, sols);
+			}
 			else if (assembler->is_linear() && !is_contact_enabled())
 				solve_linear(sol, pressure);
 			else if (!assembler->is_linear() && problem->is_scalar())
@@ -1422,6 +1652,15 @@ namespace polyfem
 		timer.stop();
 		timings.solving_time = timer.getElapsedTime();
 		logger().info(" took {}s", timings.solving_time);
+		timings.sample_memory("solve");
+
+		timings.assembling_merge_time = 0;
+		for (const auto &a : {assembler, pressure_assembler})
+			if (a)
+				timings.assembling_merge_time += a->merge_time();
+		if (mixed_assembler)
+			timings.assembling_merge_time += mixed_assembler->merge_time();
+		logger().debug("Thread storage merge took {}s", timings.assembling_merge_time);
 	}
 
 } // namespace polyfem
@@ -16,6 +16,7 @@
 #include <polyfem/mesh/Obstacle.hpp>
 #include <polyfem/mesh/MeshNodes.hpp>
 #include <polyfem/mesh/LocalBoundary.hpp>
+#include <polyfem/mesh/CollisionGroups.hpp>
 
 #include <polyfem/solver/SolveData.hpp>
 
@@ -23,18 +24,24 @@
 #include <polyfem/utils/ElasticityUtils.hpp>
 #include <polyfem/utils/JSONUtils.hpp>
 #include <polyfem/utils/Logger.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
+#include <polyfem/utils/ThreadPinning.hpp>
 
 #include <polyfem/io/OutData.hpp>
+#include <polyfem/io/Checkpoint.hpp>
+#include <polyfem/io/OutputQueue.hpp>
+#include <polyfem/io/SolutionFrameStore.hpp>
+#include <polyfem/io/OutputFilter.hpp>
+#include <polyfem/io/ProbeOutput.hpp>
+#include <polyfem/io/StreamOutput.hpp>
 
 #include <polysolve/LinearSolver.hpp>
 
 #include <Eigen/Dense>
 #include <Eigen/Sparse>
 
-#ifdef POLYFEM_WITH_TBB
-#include <tbb/global_control.h>
-#endif
 
+#include <array>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -54,6 +61,16 @@ namespace polyfem::assembler
 	class Mass;
 } // namespace polyfem::assembler
 
+namespace polyfem::time_integrator
+{
+	class AdaptiveTimeStepping;
+} // namespace polyfem::time_integrator
+
+namespace polyfem::basis
+{
+	class PolygonSamplesCache;
+} // namespace polyfem::basis
+
 namespace polyfem
 {
 	namespace mesh
@@ -70,12 +87,20 @@ namespace polyfem
 		//-----------------initialization--------------------
 		//---------------------------------------------------
 
-		~State() = default;
+		/// finishes the pending asynchronous writes while the data they read is alive
+		~State() { output_queue = nullptr; }
 		/// Constructor
 		State();
 
+		/// @brief Sets the number of threads of the parallel loops of this State, the limit of
+		/// the Eigen and C++ threads backends (without TBB) is global
 		/// @param[in] max_threads max number of threads
-		void set_max_threads(const unsigned int max_threads = std::numeric_limits<unsigned int>::max());
+		/// @param[in] pin_threads pins the threads of the arena to the cores (TBB on Linux only)
+		void set_max_threads(const unsigned int max_threads = std::numeric_limits<unsigned int>::max(), const bool pin_threads = false);
+
+		/// if false, init and set_max_threads leave the process wide settings (logger, profiler, Eigen and C++
+		/// threads limits) untouched, for the States initialized concurrently (e.g., by EnsembleRunner)
+		bool init_process_globals = true;
 
 		/// initialize the polyfem solver with a json settings
 		/// @param[in] args input arguments
@@ -96,7 +121,9 @@ namespace polyfem
 		/// @param[in] log_file is to write it to a file (use log_file="") to output to stdout
 		/// @param[in] log_level 0 all message, 6 no message. 2 is info, 1 is debug
 		/// @param[in] is_quit quiets the log
-		void init_logger(const std::string &log_file, const spdlog::level::level_enum log_level, const bool is_quiet);
+		/// @param[in] json_records writes the records as lines of JSON instead of text
+		/// @param[in] async_queue_size if positive, the records are formatted by the caller and written by a background thread through a queue of this size
+		void init_logger(const std::string &log_file, const spdlog::level::level_enum log_level, const bool is_quiet, const bool json_records = false, const int async_queue_size = 0);
 
 		/// initializing the logger writes to an output stream
 		/// @param[in] os output stream
@@ -124,7 +151,7 @@ namespace polyfem
 
 	private:
 		/// initializing the logger meant for internal usage
-		void init_logger(const std::vector<spdlog::sink_ptr> &sinks, const spdlog::level::level_enum log_level);
+		void init_logger(const std::vector<spdlog::sink_ptr> &sinks, const spdlog::level::level_enum log_level, const int async_queue_size = 0);
 
 	public:
 		//---------------------------------------------------
@@ -157,6 +184,8 @@ namespace polyfem
 		std::map<int, Eigen::MatrixXd> polys;
 		/// polyhedra, used since poly have no geom mapping
 		std::map<int, std::pair<Eigen::MatrixXd, Eigen::MatrixXi>> polys_3d;
+		/// samples and quadratures of the harmonic polygonal bases, reused when the bases are rebuilt
+		std::shared_ptr<basis::PolygonSamplesCache> polygon_samples_cache;
 
 		/// vector of discretization orders, used when not all elements have the same degree, one per element
 		Eigen::VectorXi disc_orders;
@@ -209,6 +238,12 @@ namespace polyfem
 			const int n_bases,
 			const std::vector<basis::ElementBases> &bases,
 			const assembler::AssemblyValsCache &ass_vals_cache) const;
+		/// build a RhsAssembler for the loads of another problem with the same boundaries (e.g., a load case)
+		std::shared_ptr<assembler::RhsAssembler> build_rhs_assembler(
+			const int n_bases,
+			const std::vector<basis::ElementBases> &bases,
+			const assembler::AssemblyValsCache &ass_vals_cache,
+			const assembler::Problem &problem) const;
 		/// build a RhsAssembler for the problem
 		std::shared_ptr<assembler::RhsAssembler> build_rhs_assembler() const
 		{
@@ -230,6 +265,8 @@ namespace polyfem
 		}
 
 	private:
+		/// parameters of the problem that depend on the formulation and the mesh, set before assembling the rhs
+		json problem_parameters() const;
 		/// splits the solution in solution and pressure for mixed problems
 		/// @param[in/out] sol solution
 		/// @param[out] pressure pressure
@@ -237,6 +274,29 @@ namespace polyfem
 		/// builds bases for polygons, called inside build_basis
 		void build_polygonal_basis();
 
+		/// all_to_valid_elements() of the NCMesh3D before the last adapt_mesh, empty otherwise;
+		/// build_basis uses it to keep the cached assembly values of the unchanged elements
+		std::vector<int> prev_all_to_valid_elements;
+
+	public:
+		/// refines and coarsens the non-conforming 3D mesh, rebuilds the bases and transfers the solution
+		/// by interpolating it at the new nodes; the assembly values of the unchanged elements are reused
+		/// @param[in] refine_ids elements to refine (current numbering)
+		/// @param[in] coarsen_ids elements whose parent is restored (current numbering), disjoint from refine_ids
+		/// @param[in,out] sol solution on the current bases (can be empty), on the new bases on exit
+		void adapt_mesh(const std::vector<int> &refine_ids, const std::vector<int> &coarsen_ids, Eigen::MatrixXd &sol);
+
+		/// solves a static problem on a non-conforming mesh, refining the elements marked by the Zienkiewicz-Zhu
+		/// estimate (Dörfler marking) until the estimated error is below tolerance; builds the bases first
+		/// @param[in] tolerance target estimated error (L2 norm of the flux error)
+		/// @param[in] max_iterations maximum number of refinements
+		/// @param[in] theta fraction of the squared error of the refined elements
+		/// @param[out] sol solution
+		/// @param[out] pressure pressure
+		/// @param[out] errors per element estimated errors of the final solution
+		void solve_adaptive(const double tolerance, const int max_iterations, const double theta,
+							Eigen::MatrixXd &sol, Eigen::MatrixXd &pressure, Eigen::VectorXd &errors);
+
 	public:
 		/// set the material and the problem dimension
 		/// @param[in/out] list of assembler to set
@@ -273,12 +333,15 @@ namespace polyfem
 
 			solve_export_to_file = false;
 			solution_frames.clear();
+			frame_store = nullptr;
 			solve_problem(sol, pressure);
 			solve_export_to_file = true;
 		}
 
 		/// timedependent stuff cached
 		solver::SolveData solve_data;
+		/// solver state read from /input/data/checkpoint, empty if none
+		io::Checkpoint input_checkpoint;
 		/// initialize solver
 		/// @param[out] sol solution
 		/// @param[out] pressure pressure
@@ -303,12 +366,26 @@ namespace polyfem
 		/// @param[out] sol solution
 		/// @param[out] pressure pressure
 		void solve_transient_linear(const int time_steps, const double t0, const double dt, Eigen::MatrixXd &sol, Eigen::MatrixXd &pressure);
+		/// solves transient linear elastodynamics in the basis of the lowest vibration modes (see /time/modal),
+		/// every step integrates the decoupled modal equations with the time integrator
+		/// @param[in] time_steps number of time steps
+		/// @param[in] t0 initial times
+		/// @param[in] dt timestep size
+		/// @param[out] sol solution
+		/// @param[out] pressure pressure (unused, the problem is not mixed)
+		void solve_transient_linear_modal(const int time_steps, const double t0, const double dt, Eigen::MatrixXd &sol, Eigen::MatrixXd &pressure);
 		/// solves transient tensor nonlinear problem
 		/// @param[in] time_steps number of time steps
 		/// @param[in] t0 initial times
 		/// @param[in] dt timestep size
 		/// @param[out] sol solution
 		void solve_transient_tensor_nonlinear(const int time_steps, const double t0, const double dt, Eigen::MatrixXd &sol);
+		/// solves transient tensor problem with the explicit central difference integrator (lumped mass, no linear solves)
+		/// @param[in] time_steps number of time steps
+		/// @param[in] t0 initial times
+		/// @param[in] dt timestep size, replaced by the CFL time step if auto_dt is enabled
+		/// @param[out] sol solution
+		void solve_transient_tensor_explicit(const int time_steps, const double t0, const double dt, Eigen::MatrixXd &sol);
 		/// initialize the nonlinear solver
 		/// @param[out] sol solution
 		/// @param[in] t (optional) initial time
@@ -317,6 +394,16 @@ namespace polyfem
 		/// @param[out] sol solution
 		/// @param[out] pressure pressure
 		void solve_linear(Eigen::MatrixXd &sol, Eigen::MatrixXd &pressure);
+		/// solves the Laplacian without assembling the stiffness matrix (see /solver/linear/matrix_free)
+		/// @param[out] sol solution
+		/// @return false if the matrix-free solver is disabled or does not support the problem, nothing is solved
+		bool solve_linear_matrix_free(Eigen::MatrixXd &sol);
+		/// solves a linear problem for several load cases, the system is assembled and factorized once
+		/// @param[in] load_cases loads of every case (see /boundary_conditions/load_cases), they replace the
+		/// body forces and the Neumann and pressure boundary conditions of /boundary_conditions
+		/// @param[out] sols solutions, one column per load case
+		/// @param[out] pressures pressures, one column per load case (mixed problems only)
+		void solve_linear_load_cases(const std::vector<json> &load_cases, Eigen::MatrixXd &sols, Eigen::MatrixXd &pressures);
 		/// solves a navier stokes
 		/// @param[out] sol solution
 		/// @param[out] pressure pressure
@@ -325,6 +412,27 @@ namespace polyfem
 		/// @param[out] sol solution
 		/// @param[in] t (optional) time step id
 		void solve_tensor_nonlinear(Eigen::MatrixXd &sol, const int t = 0, const bool init_lagging = true);
+		/// solves one time step of a transient nonlinear problem, rejecting and retrying with a smaller
+		/// step size until the local error is small enough and the nonlinear solve succeeds
+		/// @param[in,out] stepping adaptive time step controller
+		/// @param[in] time time at the beginning of the step
+		/// @param[in] t time step id
+		/// @param[in,out] sol solution at the beginning of the step, solution at the end on output
+		void solve_adaptive_time_step(time_integrator::AdaptiveTimeStepping &stepping, const double time, const int t, Eigen::MatrixXd &sol);
+		/// extrapolates the solution of the previous time step from the time integrator history to
+		/// initialize the next nonlinear solve (see /time/initial_guess), with contact the extrapolation
+		/// is shortened to a fraction of the collision free step
+		/// @param[in,out] sol solution of the previous time step, initial guess on output
+		void extrapolate_initial_guess(Eigen::MatrixXd &sol) const;
+		/// integrates again the region in contact (see /time/multirate) with smaller steps, the rest of the
+		/// mesh is prescribed to the linear interpolation of the full step, the time integrator is advanced
+		/// on success and left at the beginning of the step otherwise
+		/// @param[in] sol_prev solution at the beginning of the step
+		/// @param[in] time time at the beginning of the step
+		/// @param[in] t time step id
+		/// @param[in,out] sol full step solution, multirate solution on output
+		/// @return false if the step was not subcycled (no fast region or failed substep), sol is unchanged
+		bool solve_multirate_substeps(const Eigen::MatrixXd &sol_prev, const double time, const int t, Eigen::MatrixXd &sol);
 
 		/// factory to create the nl solver depending on input
 		/// @return nonlinear solver (eg newton or LBFGS)
@@ -388,6 +496,8 @@ namespace polyfem
 
 		/// Inpute nodes (including high-order) to polyfem nodes, only for isoparametric
 		Eigen::VectorXi in_node_to_node;
+		/// renumbering (old to new) of the polyfem nodes applied after building the bases, empty if the nodes are in build order
+		Eigen::VectorXi node_ordering;
 		/// maps in vertices/edges/faces/cells to polyfem vertices/edges/faces/cells
 		Eigen::VectorXi in_primitive_to_primitive;
 
@@ -460,12 +570,31 @@ namespace polyfem
 
 		void init_mesh_vertices(Eigen::MatrixXd &V);
 
+		/// Build the positions of all nodes (one row per node, obstacle last) using the bases node ordering
+		/// @param[in] sol displacement added to the positions, empty for the rest positions
+		/// @param[out] V node positions
+		void build_node_positions(const Eigen::MatrixXd &sol, Eigen::MatrixXd &V) const;
+
+		/// Set the node positions and removed nodes AMG uses to build the rigid body near-nullspace,
+		/// the number of columns of the positions is the block size. Only vector problems get modes.
+		/// @param[in] sol current displacement, empty for the rest positions
+		/// @param[in] reduced whether the solved system has the Dirichlet nodes removed (nonlinear) or not (dirichlet_solve)
+		void update_nullspace_vertices(const Eigen::MatrixXd &sol, const bool reduced);
+		/// rest positions of the nodes, built once by update_nullspace_vertices and cleared with the bases
+		Eigen::MatrixXd nullspace_rest_vertices;
+
 		//---------------------------------------------------
 		//-----------------IPC-------------------------------
 		//---------------------------------------------------
 
 		/// @brief IPC collision mesh
 		ipc::CollisionMesh collision_mesh;
+		/// @brief Map from the collision mesh dofs to the full dofs, column i holds the full dofs of the collision dof i
+		StiffnessMatrix collision_mesh_dof_map;
+		/// @brief Collision groups of the bodies (/contact/collision_groups)
+		mesh::CollisionGroups collision_groups;
+		/// @brief Collision group of every collision mesh vertex, empty if the groups filter nothing but the obstacles
+		std::vector<int> collision_vertex_groups;
 
 		/// extracts the boundary mesh for collision, called in build_basis
 		void build_collision_mesh();
@@ -499,12 +628,22 @@ namespace polyfem
 		bool solve_export_to_file = true;
 		/// saves the frames in a vector instead of VTU
 		std::vector<io::SolutionFrame> solution_frames;
+		/// encoded frames, used instead of solution_frames with /output/advanced/frames/compress
+		std::unique_ptr<io::SolutionFrameStore> frame_store;
+		/// time series of the probes and reductions of /output/probes, nullptr if there are none
+		std::unique_ptr<io::ProbeOutput> probe_output;
+		/// publisher of /output/stream, nullptr if it is disabled
+		std::unique_ptr<io::StreamOutput> stream_output;
+		/// change detection of the rest mesh and raw outputs of the time steps
+		io::OutputFilter output_filter;
 		/// visualization stuff
 		io::OutGeometryData out_geom;
 		/// runtime statistics
 		io::OutRuntimeData timings;
 		/// Other statistics
 		io::OutStatsData stats;
+		/// background writer of the time steps, nullptr if they are written synchronously
+		std::unique_ptr<io::OutputQueue> output_queue;
 
 		/// saves all data on the disk according to the input params
 		/// @param[in] sol solution
@@ -520,6 +659,36 @@ namespace polyfem
 		/// @param[in] pressure pressure
 		void save_timestep(const double time, const int t, const double t0, const double dt, const Eigen::MatrixXd &sol, const Eigen::MatrixXd &pressure);
 
+		/// appends the probes and reductions of /output/probes to their time series, a new series starts at t = 0
+		/// @param[in] time time in secs
+		/// @param[in] t time index
+		/// @param[in] dt delta t
+		/// @param[in] sol solution
+		void save_probes(const double time, const int t, const double dt, const Eigen::MatrixXd &sol);
+
+		/// publishes a time step to the clients of /output/stream, a new stream header is sent at t = 0
+		/// @param[in] time time in secs
+		/// @param[in] t time index
+		/// @param[in] sol solution
+		void stream_timestep(const double time, const int t, const Eigen::MatrixXd &sol);
+
+		/// @brief Paths the raw u, v and a of step t are written to (see /output/data/u_path), empty for the ones which are skipped.
+		/// They are written every /output/data/advanced/raw_frequency steps when u changed by more than
+		/// /output/data/advanced/raw_tolerance, a content equal to its previous write is not written again.
+		/// @param[in] t time index
+		/// @param[in] x solution
+		/// @param[in] v velocity
+		/// @param[in] a acceleration
+		/// @param[out] paths paths of u, v, and a
+		/// @return false if the step is not saved, the restart file of the step must not be written
+		bool raw_output_paths(const int t, const Eigen::MatrixXd &x, const Eigen::MatrixXd &v, const Eigen::MatrixXd &a, std::array<std::string, 3> &paths);
+
+		/// moves the last of the solution_frames to frame_store if /output/advanced/frames/compress is true
+		void store_solution_frame();
+
+		/// waits for the time steps queued for asynchronous writing to be on the disk
+		void flush_output();
+
 		/// saves a subsolve when save_solve_sequence_debug is true
 		/// @param[in] i sub solve index
 		/// @param[in] t time index
@@ -536,6 +705,13 @@ namespace polyfem
 		/// @param[in] sol solution
 		void save_json(const Eigen::MatrixXd &sol);
 
+		/// saves the Chrome trace of the profiler (/output/advanced/profile/trace) if it is enabled
+		void save_profile() const;
+
+		/// records the size of the main containers (assembly cache, bases, triplet buffers,
+		/// collision mesh, output frames) in timings, called before saving the statistics
+		void track_memory();
+
 		/// @brief computes all errors
 		void compute_errors(const Eigen::MatrixXd &sol);
 
@@ -543,6 +719,13 @@ namespace polyfem
 		/// @param t current time to restart at
 		void save_restart_json(const double t0, const double dt, const int t) const;
 
+		/// @brief Save the solver state (time integrator history, time step size, barrier stiffness, and AL weight)
+		/// to the binary checkpoint file /output/checkpoint, it is loaded back with /input/data/checkpoint
+		/// @param time current time
+		/// @param t current time step index
+		/// @return path of the checkpoint, empty if none was written
+		std::string save_checkpoint(const double time, const int t) const;
+
 		//-----------PATH management
 		/// Get the root path for the state (e.g., args["root_path"] or ".")
 		/// @return root path
@@ -559,10 +742,11 @@ namespace polyfem
 		/// @return resolvedpath
 		std::string resolve_output_path(const std::string &path) const;
 
-#ifdef POLYFEM_WITH_TBB
-		/// limits the number of used threads
-		std::shared_ptr<tbb::global_control> thread_limiter;
-#endif
+		/// arena with max_threads threads, the parallel loops of the State calls run in it so that
+		/// several States in the same process do not share a thread limit (nullptr for the default arena)
+		std::shared_ptr<utils::TaskArena> task_arena;
+		/// pinning of the threads of task_arena, declared after it to be released first
+		std::shared_ptr<utils::ThreadPinning> thread_pinning;
 	};
 
 } // namespace polyfem
@@ -2,11 +2,16 @@
 
 #include <polyfem/utils/Logger.hpp>
 #include <polyfem/utils/MaybeParallelFor.hpp>
+#include <polyfem/utils/Timer.hpp>
 
 #include <igl/Timer.h>
 
 #include <ipc/utils/eigen_ext.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <map>
+
 namespace polyfem::assembler
 {
 	using namespace basis;
@@ -21,6 +26,9 @@ namespace polyfem::assembler
 			SparseMatrixCache cache;
 			ElementAssemblyValues vals;
 			QuadratureVector da;
+			Eigen::MatrixXd hessian;
+			Eigen::VectorXd displacement;
+			std::vector<ReferenceIntegrals> integrals;
 
 			LocalThreadMatStorage()
 			{
@@ -50,12 +58,73 @@ namespace polyfem::assembler
 			}
 		};
 
+		/// Merges the caches of the thread storages with a pairwise parallel reduction,
+		/// the caches must be pruned and the result is stored in the first one.
+		template <typename Storage>
+		void merge_thread_caches(const std::vector<Storage *> &storages)
+		{
+			for (size_t stride = 1; stride < storages.size(); stride *= 2)
+			{
+				const int n_pairs = (storages.size() + 2 * stride - 1) / (2 * stride);
+				maybe_parallel_for(n_pairs, [&](int p) {
+					const size_t i = 2 * stride * p;
+					const size_t j = i + stride;
+					if (j < storages.size())
+						storages[i]->cache += storages[j]->cache;
+				});
+			}
+		}
+
+		template <typename Storages>
+		std::vector<typename Storages::value_type *> collect_thread_storages(Storages &storage)
+		{
+			std::vector<typename Storages::value_type *> storages;
+			storages.reserve(storage.size());
+			for (auto &local_storage : storage)
+				storages.push_back(&local_storage);
+			return storages;
+		}
+
+		class LocalThreadBlockStorage
+		{
+		public:
+			std::vector<double> values;
+			std::vector<std::pair<int, int>> pattern;
+			ElementAssemblyValues vals;
+			QuadratureVector da;
+			std::vector<ReferenceIntegrals> integrals;
+		};
+
+		// beyond this number of distinct reference integrals per thread the elements are integrated at the quadrature points
+		constexpr int MAX_REFERENCE_INTEGRALS = 64;
+
+		// reference integrals of the affine element vals, computed by the first element with these reference evaluations
+		const ReferenceIntegrals *find_reference_integrals(std::vector<ReferenceIntegrals> &integrals, const ElementAssemblyValues &vals)
+		{
+			for (const ReferenceIntegrals &r : integrals)
+			{
+				if (r.matches(vals))
+					return &r;
+			}
+
+			if (integrals.size() >= MAX_REFERENCE_INTEGRALS)
+				return nullptr;
+
+			integrals.emplace_back();
+			integrals.back().init(vals);
+			return &integrals.back();
+		}
+
 		class LocalThreadVecStorage
 		{
 		public:
 			Eigen::MatrixXd vec;
 			ElementAssemblyValues vals;
 			QuadratureVector da;
+			Eigen::VectorXd gradient;
+			/// local gradient of one term of the fused loops, summed into gradient
+			Eigen::VectorXd term_gradient;
+			Eigen::MatrixXd hessian;
 
 			LocalThreadVecStorage(const int size)
 			{
@@ -64,6 +133,15 @@ namespace polyfem::assembler
 			}
 		};
 
+		class LocalThreadElementStorage
+		{
+		public:
+			ElementAssemblyValues vals;
+			QuadratureVector da;
+			Eigen::MatrixXd hessian;
+			Eigen::VectorXd displacement;
+		};
+
 		class LocalThreadScalarStorage
 		{
 		public:
@@ -76,8 +154,163 @@ namespace polyfem::assembler
 				val = 0;
 			}
 		};
+
+		class LocalThreadFusedStorage
+		{
+		public:
+			SparseMatrixCache cache;
+			Eigen::MatrixXd vec;
+			double val = 0;
+			ElementAssemblyValues vals;
+			QuadratureVector da;
+			Eigen::VectorXd gradient;
+			Eigen::MatrixXd hessian;
+		};
+
+		/// passes the entries of the local hessian of an element to add_value(gi, gj, value) in a fixed order,
+		/// the order must not change between calls since the cache mapping relies on it
+		/// it only needs the element bases, the elements reusing a stored hessian do not compute their assembly values
+		template <typename AddValue>
+		void scatter_local_hessian(const ElementBases &bs, const Eigen::MatrixXd &hessian, const int size, const AddValue &add_value)
+		{
+			const int n_loc_bases = int(bs.bases.size());
+			for (int i = 0; i < n_loc_bases; ++i)
+			{
+				const auto &global_i = bs.bases[i].global();
+
+				for (int j = 0; j < n_loc_bases; ++j)
+				{
+					const auto &global_j = bs.bases[j].global();
+
+					for (int n = 0; n < size; ++n)
+					{
+						for (int m = 0; m < size; ++m)
+						{
+							const double local_value = hessian(i * size + m, j * size + n);
+							//  if (std::abs(local_value) < 1e-30)
+							//  {
+							// 	 continue;
+							//  }
+
+							for (size_t ii = 0; ii < global_i.size(); ++ii)
+							{
+								const auto gi = global_i[ii].index * size + m;
+								const auto wi = global_i[ii].val;
+
+								for (size_t jj = 0; jj < global_j.size(); ++jj)
+								{
+									const auto gj = global_j[jj].index * size + n;
+									const auto wj = global_j[jj].val;
+									add_value(gi, gj, local_value * wi * wj);
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+
+		/// adds the local gradient of an element to the global vector rhs
+		void scatter_local_gradient(const ElementAssemblyValues &vals, const Eigen::VectorXd &gradient, const int size, Eigen::MatrixXd &rhs)
+		{
+			for (size_t j = 0; j < vals.basis_values.size(); ++j)
+			{
+				const auto &global_j = vals.basis_values[j].global;
+				for (int m = 0; m < size; ++m)
+				{
+					const double local_value = gradient(j * size + m);
+					if (std::abs(local_value) < 1e-30)
+						continue;
+
+					for (size_t jj = 0; jj < global_j.size(); ++jj)
+						rhs(global_j[jj].index * size + m) += local_value * global_j[jj].val;
+				}
+			}
+		}
+
+		/// order independent hash of the global nodes of every element, it changes when the bases are rebuilt
+		uint64_t global_nodes_fingerprint(const std::vector<ElementBases> &bases)
+		{
+			auto storage = create_thread_storage(uint64_t(0));
+			maybe_parallel_for(bases.size(), [&](int start, int end, int thread_id) {
+				uint64_t &local_sum = get_local_thread_storage(storage, thread_id);
+				for (int e = start; e < end; ++e)
+				{
+					// FNV-1a of the nodes seeded by the element
+					uint64_t h = 0xcbf29ce484222325ull ^ (uint64_t(e) * 0x9e3779b97f4a7c15ull);
+					for (const Basis &b : bases[e].bases)
+					{
+						for (const Local2Global &g : b.global())
+							h = (h ^ uint64_t(g.index + 1)) * 0x100000001b3ull;
+					}
+					local_sum += h;
+				}
+			});
+
+			uint64_t fingerprint = bases.size();
+			for (const uint64_t local_sum : storage)
+				fingerprint += local_sum;
+			return fingerprint;
+		}
+
+		/// calls body(e, thread_id) for all the elements, the colors one after the other and the elements of a color in parallel
+		template <typename Body>
+		void for_each_colored_element(const std::vector<std::vector<int>> &colors, const Body &body)
+		{
+			for (const std::vector<int> &color : colors)
+			{
+				maybe_parallel_for(color.size(), [&](int start, int end, int thread_id) {
+					for (int k = start; k < end; ++k)
+						body(color[k], thread_id);
+				});
+			}
+		}
+
+		/// values of the displacement at the local bases of an element, interpolated by the local to global weights
+		void gather_local_displacement(const ElementBases &bs, const Eigen::MatrixXd &displacement, const int size, Eigen::VectorXd &local)
+		{
+			local.setZero(bs.bases.size() * size);
+			for (size_t j = 0; j < bs.bases.size(); ++j)
+			{
+				for (const auto &g : bs.bases[j].global())
+				{
+					for (int m = 0; m < size; ++m)
+						local(j * size + m) += g.val * displacement(g.index * size + m);
+				}
+			}
+		}
+
+		/// true if no node moved more than tolerance between the local displacements a and b
+		bool is_displacement_unchanged(const Eigen::VectorXd &a, const Eigen::VectorXd &b, const int size, const double tolerance)
+		{
+			if (a.size() != b.size())
+				return false;
+			for (int j = 0; j < a.size(); j += size)
+			{
+				if ((a.segment(j, size) - b.segment(j, size)).norm() > tolerance)
+					return false;
+			}
+			return true;
+		}
 	} // namespace
 
+	void LocalHessianCache::clear()
+	{
+		displacements_.clear();
+		hessians_.clear();
+	}
+
+	void LocalHessianCache::prepare(const int n_elements, const bool project_to_psd)
+	{
+		if (int(hessians_.size()) != n_elements || project_to_psd_ != project_to_psd)
+			clear();
+		displacements_.resize(n_elements);
+		hessians_.resize(n_elements);
+		project_to_psd_ = project_to_psd;
+		n_evaluated_ = 0;
+		n_reused_ = 0;
+	}
+
 	void Assembler::set_materials(const std::vector<int> &body_ids, const json &body_params)
 	{
 		if (!body_params.is_array())
@@ -134,6 +367,171 @@ namespace polyfem::assembler
 		}
 	}
 
+	LoopCostModel &Assembler::element_costs(const std::string &loop, const std::vector<ElementBases> &bases, const std::vector<int> &order, const bool is_mass) const
+	{
+		ElementCosts &entry = element_costs_[loop];
+		const int n_bases = int(bases.size());
+		if (entry.bases == bases.data() && entry.costs.size() == n_bases)
+			return entry.costs;
+
+		const bool reorder = order.size() == n_bases;
+		std::vector<double> costs(n_bases);
+		maybe_parallel_for(n_bases, [&](int k) {
+			const int e = reorder ? order[k] : k;
+			Quadrature quadrature;
+			if (is_mass)
+				bases[e].compute_mass_quadrature(quadrature);
+			else
+				bases[e].compute_quadrature(quadrature);
+			costs[k] = double(bases[e].bases.size()) * std::max<int>(1, quadrature.weights.size());
+		});
+
+		entry.bases = bases.data();
+		entry.costs.init(costs);
+		return entry.costs;
+	}
+
+	const std::vector<std::vector<int>> &Assembler::node_colors(const int n_basis, const std::vector<ElementBases> &bases) const
+	{
+		const uint64_t fingerprint = global_nodes_fingerprint(bases);
+		if (node_colors_.n_elements == bases.size() && node_colors_.fingerprint == fingerprint)
+			return node_colors_.colors;
+
+		POLYFEM_SCOPED_TIMER("node coloring");
+
+		const int n_elements = int(bases.size());
+
+		// elements of every node in compressed rows, an element may appear several times in a row
+		std::vector<int> node_offsets(n_basis + 1, 0);
+		for (const ElementBases &bs : bases)
+		{
+			for (const Basis &b : bs.bases)
+			{
+				for (const Local2Global &g : b.global())
+					++node_offsets[g.index + 1];
+			}
+		}
+		for (int i = 0; i < n_basis; ++i)
+			node_offsets[i + 1] += node_offsets[i];
+
+		std::vector<int> node_elements(node_offsets.back());
+		std::vector<int> next(node_offsets.begin(), node_offsets.end() - 1);
+		for (int e = 0; e < n_elements; ++e)
+		{
+			for (const Basis &b : bases[e].bases)
+			{
+				for (const Local2Global &g : b.global())
+					node_elements[next[g.index]++] = e;
+			}
+		}
+
+		// greedy coloring in the element order, forbidden[c] == e if the color c is used by a neighbor of e
+		std::vector<int> colors(n_elements, -1);
+		std::vector<int> forbidden;
+		int n_colors = 0;
+		for (int e = 0; e < n_elements; ++e)
+		{
+			for (const Basis &b : bases[e].bases)
+			{
+				for (const Local2Global &g : b.global())
+				{
+					for (int k = node_offsets[g.index]; k < node_offsets[g.index + 1]; ++k)
+					{
+						const int other = node_elements[k];
+						if (colors[other] >= 0)
+							forbidden[colors[other]] = e;
+					}
+				}
+			}
+
+			int c = 0;
+			while (c < n_colors && forbidden[c] == e)
+				++c;
+			if (c == n_colors)
+			{
+				++n_colors;
+				forbidden.push_back(-1);
+			}
+			colors[e] = c;
+		}
+
+		node_colors_.colors.assign(n_colors, {});
+		for (int e = 0; e < n_elements; ++e)
+			node_colors_.colors[colors[e]].push_back(e);
+		node_colors_.n_elements = bases.size();
+		node_colors_.fingerprint = fingerprint;
+
+		logger().trace("Node coloring computed, {} colors", n_colors);
+		return node_colors_.colors;
+	}
+
+	const Assembler::ConstraintProlongation &Assembler::constraint_prolongation(const int n_basis, const std::vector<ElementBases> &bases) const
+	{
+		const uint64_t fingerprint = global_nodes_fingerprint(bases);
+		CachedProlongation &cached = constraint_prolongation_;
+		if (cached.n_elements == bases.size() && cached.n_basis == n_basis && cached.fingerprint == fingerprint)
+			return cached.prolongation;
+
+		cached.n_elements = bases.size();
+		cached.n_basis = n_basis;
+		cached.fingerprint = fingerprint;
+		ConstraintProlongation &prolongation = cached.prolongation;
+		prolongation = ConstraintProlongation();
+
+		const auto is_node = [](const Basis &b) { return b.global().size() == 1 && b.global()[0].val == 1; };
+		bool conforming = true;
+		for (const ElementBases &bs : bases)
+			conforming = conforming && std::all_of(bs.bases.begin(), bs.bases.end(), is_node);
+		if (conforming)
+			return prolongation;
+
+		POLYFEM_SCOPED_TIMER("constraint prolongation");
+
+		// the bases with the same combination of global nodes share a local node
+		std::map<std::vector<std::pair<int, double>>, int> combinations;
+		std::vector<Eigen::Triplet<double>> entries;
+		entries.reserve(n_basis);
+		for (int g = 0; g < n_basis; ++g)
+			entries.emplace_back(g, g, 1);
+
+		int n_local = n_basis;
+		prolongation.local_nodes.resize(bases.size());
+		std::vector<std::pair<int, double>> combination;
+		for (size_t e = 0; e < bases.size(); ++e)
+		{
+			std::vector<int> &nodes = prolongation.local_nodes[e];
+			nodes.reserve(bases[e].bases.size());
+			for (const Basis &b : bases[e].bases)
+			{
+				if (is_node(b))
+				{
+					nodes.push_back(b.global()[0].index);
+					continue;
+				}
+
+				combination.clear();
+				for (const Local2Global &g : b.global())
+					combination.emplace_back(g.index, g.val);
+
+				const auto [it, inserted] = combinations.emplace(combination, n_local);
+				if (inserted)
+				{
+					for (const Local2Global &g : b.global())
+						entries.emplace_back(n_local, g.index, g.val);
+					++n_local;
+				}
+				nodes.push_back(it->second);
+			}
+		}
+
+		prolongation.n_local = n_local;
+		prolongation.P.resize(n_local, n_basis);
+		prolongation.P.setFromTriplets(entries.begin(), entries.end());
+
+		logger().trace("Constraint prolongation computed, {} combinations of global nodes", n_local - n_basis);
+		return prolongation;
+	}
+
 	LinearAssembler::LinearAssembler()
 	{
 	}
@@ -157,7 +555,11 @@ namespace polyfem::assembler
 		logger().trace("buffer_size {}", buffer_size);
 		try
 		{
-			stiffness.resize(n_basis * size(), n_basis * size());
+			// the constrained bases are assembled on the local space and prolongated at the end
+			const ConstraintProlongation &prolongation = constraint_prolongation(n_basis, bases);
+			const int n_nodes = prolongation.empty() ? n_basis : prolongation.n_local;
+
+			stiffness.resize(n_nodes * size(), n_nodes * size());
 			stiffness.setZero();
 
 			auto storage = create_thread_storage(LocalThreadMatStorage(buffer_size, stiffness.rows(), stiffness.cols()));
@@ -167,7 +569,7 @@ namespace polyfem::assembler
 			timerg.start();
 			assert(cache.is_mass() == is_mass);
 
-			maybe_parallel_for(n_bases, [&](int start, int end, int thread_id) {
+			maybe_parallel_for(element_costs(is_mass ? "mass" : "stiffness", bases, {}, is_mass), [&](int start, int end, int thread_id) {
 				LocalThreadMatStorage &local_storage = get_local_thread_storage(storage, thread_id);
 
 				for (int e = start; e < end; ++e)
@@ -183,6 +585,11 @@ namespace polyfem::assembler
 					local_storage.da = vals.det.array() * quadrature.weights.array();
 					const int n_loc_bases = int(vals.basis_values.size());
 
+					// the local matrix of an affine element with constant coefficients is a contraction of the reference integrals
+					const ReferenceIntegrals *integrals = nullptr;
+					if (affine_assembly_ && vals.is_affine && has_affine_assembly(e))
+						integrals = find_reference_integrals(local_storage.integrals, vals);
+
 					for (int i = 0; i < n_loc_bases; ++i)
 					{
 						// const AssemblyValues &values_i = vals.basis_values[i];
@@ -195,7 +602,9 @@ namespace polyfem::assembler
 							// const Eigen::MatrixXd &gradj = values_j.grad_t_m;
 							const auto &global_j = vals.basis_values[j].global;
 
-							const auto stiffness_val = assemble(LinearAssemblerData(vals, i, j, local_storage.da));
+							const auto stiffness_val = integrals
+														   ? assemble_affine(AffineAssemblerData(vals, *integrals, i, j))
+														   : assemble(LinearAssemblerData(vals, i, j, local_storage.da));
 							assert(stiffness_val.size() == size() * size());
 
 							// igl::Timer t1; t1.start();
@@ -209,6 +618,26 @@ namespace polyfem::assembler
 										continue;
 									}
 
+									const auto add_value = [&](const int gi, const int gj, const double value) {
+										local_storage.cache.add_value(e, gi, gj, value);
+										if (j < i)
+										{
+											local_storage.cache.add_value(e, gj, gi, value);
+										}
+
+										if (local_storage.cache.entries_size() >= max_triplets_size)
+										{
+											local_storage.cache.prune();
+											logger().trace("cleaning memory. Current storage: {}. mat nnz: {}", local_storage.cache.capacity(), local_storage.cache.non_zeros());
+										}
+									};
+
+									if (!prolongation.empty())
+									{
+										add_value(prolongation.local_nodes[e][i] * size() + m, prolongation.local_nodes[e][j] * size() + n, local_value);
+										continue;
+									}
+
 									for (size_t ii = 0; ii < global_i.size(); ++ii)
 									{
 										const auto gi = global_i[ii].index * size() + m;
@@ -219,17 +648,7 @@ namespace polyfem::assembler
 											const auto gj = global_j[jj].index * size() + n;
 											const auto wj = global_j[jj].val;
 
-											local_storage.cache.add_value(e, gi, gj, local_value * wi * wj);
-											if (j < i)
-											{
-												local_storage.cache.add_value(e, gj, gi, local_value * wj * wi);
-											}
-
-											if (local_storage.cache.entries_size() >= max_triplets_size)
-											{
-												local_storage.cache.prune();
-												logger().trace("cleaning memory. Current storage: {}. mat nnz: {}", local_storage.cache.capacity(), local_storage.cache.non_zeros());
-											}
+											add_value(gi, gj, local_value * wi * wj);
 										}
 									}
 								}
@@ -252,13 +671,7 @@ namespace polyfem::assembler
 			igl::Timer timer1, timer2, timer3;
 
 			// Collect thread storages
-			std::vector<LocalThreadMatStorage *> storages(storage.size());
-			int index = 0;
-			for (auto &local_storage : storage)
-			{
-				storages[index] = &local_storage;
-				++index;
-			}
+			const std::vector<LocalThreadMatStorage *> storages = collect_thread_storages(storage);
 
 			timerg.start();
 			maybe_parallel_for(storages.size(), [&](int i) {
@@ -266,12 +679,13 @@ namespace polyfem::assembler
 				s->cache.prune();
 			});
 			timerg.stop();
+			merge_time_ += timerg.getElapsedTime();
 			logger().trace("done pruning triplets {}s...", timerg.getElapsedTime());
 
 			// Prepares for parallel concatenation
 			std::vector<int> offsets(storage.size());
 
-			index = 0;
+			int index = 0;
 			int triplet_count = 0;
 			for (auto &local_storage : storage)
 			{
@@ -285,18 +699,18 @@ namespace polyfem::assembler
 
 			if (triplet_count >= triplets.max_size())
 			{
-				// Serial fallback version in case the vector of triplets cannot be allocated
+				// Fallback version in case the vector of triplets cannot be allocated
 
-				logger().warn("Cannot allocate space for triplets, switching to serial assembly.");
+				logger().warn("Cannot allocate space for triplets, switching to pairwise merge assembly.");
 
 				timerg.start();
-				// Serially merge local storages
-				for (LocalThreadMatStorage &local_storage : storage)
-					stiffness += local_storage.cache.get_matrix(false); // will also prune
+				merge_thread_caches(storages);
+				stiffness = storages.front()->cache.get_matrix(false);
 				stiffness.makeCompressed();
 				timerg.stop();
+				merge_time_ += timerg.getElapsedTime();
 
-				logger().trace("Serial assembly time: {}s...", timerg.getElapsedTime());
+				logger().trace("Pairwise merge assembly time: {}s...", timerg.getElapsedTime());
 			}
 			else
 			{
@@ -337,10 +751,35 @@ namespace polyfem::assembler
 				// Sort and assemble
 				stiffness.setFromTriplets(triplets.begin(), triplets.end());
 				timer3.stop();
+				merge_time_ += timer1.getElapsedTime() + timer2.getElapsedTime() + timer3.getElapsedTime();
 
 				logger().trace("done setFromTriplets assembly {}s...", timer3.getElapsedTime());
 			}
 
+			if (!prolongation.empty())
+			{
+				timerg.start();
+				// K = P^T K_local P, P acts on the size() components of every node
+				std::vector<Eigen::Triplet<double>> entries;
+				entries.reserve(prolongation.P.nonZeros() * size());
+				for (int k = 0; k < prolongation.P.outerSize(); ++k)
+				{
+					for (StiffnessMatrix::InnerIterator it(prolongation.P, k); it; ++it)
+					{
+						for (int d = 0; d < size(); ++d)
+							entries.emplace_back(it.row() * size() + d, it.col() * size() + d, it.value());
+					}
+				}
+				StiffnessMatrix P(n_nodes * size(), n_basis * size());
+				P.setFromTriplets(entries.begin(), entries.end());
+
+				const StiffnessMatrix KP = stiffness * P;
+				stiffness = P.transpose() * KP;
+				timerg.stop();
+				merge_time_ += timerg.getElapsedTime();
+				logger().trace("done constraint prolongation {}s...", timerg.getElapsedTime());
+			}
+
 			// exit(0);
 		}
 		catch (std::bad_alloc &ba)
@@ -353,6 +792,128 @@ namespace polyfem::assembler
 		// stiffness.setFromTriplets(entries.begin(), entries.end());
 	}
 
+	void LinearAssembler::assemble(
+		const bool is_volume,
+		const int n_basis,
+		const std::vector<ElementBases> &bases,
+		const std::vector<ElementBases> &gbases,
+		const AssemblyValsCache &cache,
+		BlockSparseMatrix &stiffness,
+		const bool is_mass) const
+	{
+		assert(size() > 0);
+		assert(cache.is_mass() == is_mass);
+
+		const int bs = size();
+		const int n_bases = int(bases.size());
+
+		auto storage = create_thread_storage(LocalThreadBlockStorage());
+
+		// one block per pair of nodes sharing an element
+		maybe_parallel_for(n_bases, [&](int start, int end, int thread_id) {
+			LocalThreadBlockStorage &local_storage = get_local_thread_storage(storage, thread_id);
+			std::vector<int> nodes;
+
+			for (int e = start; e < end; ++e)
+			{
+				nodes.clear();
+				for (const Basis &b : bases[e].bases)
+					for (const Local2Global &g : b.global())
+						nodes.push_back(g.index);
+
+				for (const int i : nodes)
+					for (const int j : nodes)
+						local_storage.pattern.emplace_back(i, j);
+			}
+		});
+
+		std::vector<std::pair<int, int>> pattern;
+		for (auto &local_storage : storage)
+		{
+			pattern.insert(pattern.end(), local_storage.pattern.begin(), local_storage.pattern.end());
+			std::vector<std::pair<int, int>>().swap(local_storage.pattern);
+		}
+		stiffness.init(bs, n_basis, pattern);
+
+		maybe_parallel_for(n_bases, [&](int start, int end, int thread_id) {
+			LocalThreadBlockStorage &local_storage = get_local_thread_storage(storage, thread_id);
+			if (local_storage.values.empty())
+				local_storage.values.assign(stiffness.values().size(), 0);
+
+			for (int e = start; e < end; ++e)
+			{
+				ElementAssemblyValues &vals = local_storage.vals;
+				cache.compute(e, is_volume, bases[e], gbases[e], vals);
+
+				const Quadrature &quadrature = vals.quadrature;
+
+				assert(MAX_QUAD_POINTS == -1 || quadrature.weights.size() < MAX_QUAD_POINTS);
+				local_storage.da = vals.det.array() * quadrature.weights.array();
+				const int n_loc_bases = int(vals.basis_values.size());
+
+				const ReferenceIntegrals *integrals = nullptr;
+				if (affine_assembly_ && vals.is_affine && has_affine_assembly(e))
+					integrals = find_reference_integrals(local_storage.integrals, vals);
+
+				for (int i = 0; i < n_loc_bases; ++i)
+				{
+					const auto &global_i = vals.basis_values[i].global;
+
+					for (int j = 0; j <= i; ++j)
+					{
+						const auto &global_j = vals.basis_values[j].global;
+
+						const auto stiffness_val = integrals
+													   ? assemble_affine(AffineAssemblerData(vals, *integrals, i, j))
+													   : assemble(LinearAssemblerData(vals, i, j, local_storage.da));
+						assert(stiffness_val.size() == bs * bs);
+
+						for (size_t ii = 0; ii < global_i.size(); ++ii)
+						{
+							const auto wi = global_i[ii].val;
+
+							for (size_t jj = 0; jj < global_j.size(); ++jj)
+							{
+								const auto wj = global_j[jj].val;
+								const double w = wi * wj;
+
+								// entry (m, n) of the block couples dof m of node i with dof n of node j
+								const int b_ij = stiffness.find(global_i[ii].index, global_j[jj].index);
+								assert(b_ij >= 0);
+								double *block_ij = local_storage.values.data() + size_t(b_ij) * bs * bs;
+								for (int m = 0; m < bs; ++m)
+									for (int n = 0; n < bs; ++n)
+										block_ij[m * bs + n] += w * stiffness_val(n * bs + m);
+
+								if (j < i)
+								{
+									const int b_ji = stiffness.find(global_j[jj].index, global_i[ii].index);
+									assert(b_ji >= 0);
+									double *block_ji = local_storage.values.data() + size_t(b_ji) * bs * bs;
+									for (int m = 0; m < bs; ++m)
+										for (int n = 0; n < bs; ++n)
+											block_ji[n * bs + m] += w * stiffness_val(n * bs + m);
+								}
+							}
+						}
+					}
+				}
+			}
+		});
+
+		// sum the thread contributions
+		std::vector<double> &values = stiffness.values();
+		maybe_parallel_for(int(values.size()), [&](int start, int end, int thread_id) {
+			for (const auto &local_storage : storage)
+			{
+				if (local_storage.values.empty())
+					continue;
+				for (int k = start; k < end; ++k)
+					values[k] += local_storage.values[k];
+			}
+		});
+	}
+
 	MixedAssembler::MixedAssembler()
 	{
 	}
@@ -454,35 +1015,195 @@ namespace polyfem::assembler
 		logger().trace("done separate assembly {}s...", timerg.getElapsedTime());
 
 		timerg.start();
-		// Serially merge local storages
-		for (LocalThreadMatStorage &local_storage : storage)
-			stiffness += local_storage.cache.get_matrix(false); // will also prune
+		const std::vector<LocalThreadMatStorage *> storages = collect_thread_storages(storage);
+		maybe_parallel_for(storages.size(), [&](int i) { storages[i]->cache.prune(); });
+		merge_thread_caches(storages);
+		stiffness = storages.front()->cache.get_matrix(false);
 		stiffness.makeCompressed();
 		timerg.stop();
+		merge_time_ += timerg.getElapsedTime();
 		logger().trace("done merge assembly {}s...", timerg.getElapsedTime());
 
 		// stiffness.resize(n_basis*size(), n_basis*size());
 		// stiffness.setFromTriplets(entries.begin(), entries.end());
 	}
 
-	double NLAssembler::assemble_energy(
+	void MixedAssembler::assemble_system(
 		const bool is_volume,
-		const std::vector<ElementBases> &bases,
+		const int n_psi_basis,
+		const int n_phi_basis,
+		const std::vector<ElementBases> &psi_bases,
+		const std::vector<ElementBases> &phi_bases,
 		const std::vector<ElementBases> &gbases,
-		const AssemblyValsCache &cache,
-		const double dt,
-		const Eigen::MatrixXd &displacement,
-		const Eigen::MatrixXd &displacement_prev) const
-	{
+		const AssemblyValsCache &psi_cache,
+		const AssemblyValsCache &phi_cache,
+		const LinearAssembler &phi_assembler,
+		const LinearAssembler &psi_assembler,
+		const bool add_average,
+		StiffnessMatrix &stiffness) const
+	{
+		assert(size() > 0);
+		assert(phi_bases.size() == psi_bases.size());
+		assert(phi_assembler.size() == rows());
+		assert(psi_assembler.size() == cols());
+
+		// the psi block starts after the phi dofs, the average row and column are the last ones
+		const int psi_offset = n_phi_basis * rows();
+		const int avg_offset = add_average ? 1 : 0;
+		const int n_dofs = psi_offset + n_psi_basis * cols() + avg_offset;
+
+		const int max_triplets_size = int(1e7);
+		const int buffer_size = std::min(long(max_triplets_size), long(n_dofs));
+		logger().debug("buffer_size {}", buffer_size);
+
+		auto storage = create_thread_storage(LocalThreadMatStorage(buffer_size, n_dofs, n_dofs));
+
+		const int n_bases = int(phi_bases.size());
+		igl::Timer timerg;
+		timerg.start();
+
+		maybe_parallel_for(n_bases, [&](int start, int end, int thread_id) {
+			LocalThreadMatStorage &local_storage = get_local_thread_storage(storage, thread_id);
+			ElementAssemblyValues psi_vals, phi_vals;
+			QuadratureVector psi_da;
+
+			// scatters the local block of the bases global_i and global_j, the entry (n, m) goes to
+			// (global_j * block_rows + n + row_offset, global_i * block_cols + m + col_offset) if direct and to its transpose if transpose
+			const auto add_block = [&](const int e, const auto &local_block, const int block_rows, const int block_cols,
+									   const std::vector<Local2Global> &global_i, const std::vector<Local2Global> &global_j,
+									   const int row_offset, const int col_offset, const bool direct, const bool transpose) {
+				for (int n = 0; n < block_rows; ++n)
+				{
+					for (int m = 0; m < block_cols; ++m)
+					{
+						const double local_value = local_block(n * block_cols + m);
+						if (std::abs(local_value) < 1e-30)
+							continue;
+
+						for (const auto &gl_i : global_i)
+						{
+							const int gi = gl_i.index * block_cols + m + col_offset;
+							for (const auto &gl_j : global_j)
+							{
+								const int gj = gl_j.index * block_rows + n + row_offset;
+								const double value = local_value * gl_i.val * gl_j.val;
+
+								if (direct)
+									local_storage.cache.add_value(e, gj, gi, value);
+								if (transpose)
+									local_storage.cache.add_value(e, gi, gj, value);
+
+								if (local_storage.cache.entries_size() >= max_triplets_size)
+								{
+									local_storage.cache.prune();
+									logger().debug("cleaning memory...");
+								}
+							}
+						}
+					}
+				}
+			};
+
+			for (int e = start; e < end; ++e)
+			{
+				psi_cache.compute(e, is_volume, psi_bases[e], gbases[e], psi_vals);
+				phi_cache.compute(e, is_volume, phi_bases[e], gbases[e], phi_vals);
+
+				assert(MAX_QUAD_POINTS == -1 || phi_vals.quadrature.weights.size() < MAX_QUAD_POINTS);
+				local_storage.da = phi_vals.det.array() * phi_vals.quadrature.weights.array();
+				psi_da = psi_vals.det.array() * psi_vals.quadrature.weights.array();
+				const int n_phi_loc_bases = int(phi_vals.basis_values.size());
+				const int n_psi_loc_bases = int(psi_vals.basis_values.size());
+
+				// A, symmetric: the blocks j < i are mirrored, the same entries as LinearAssembler::assemble
+				for (int i = 0; i < n_phi_loc_bases; ++i)
+				{
+					for (int j = 0; j <= i; ++j)
+					{
+						const auto stiffness_val = phi_assembler.assemble(LinearAssemblerData(phi_vals, i, j, local_storage.da));
+						assert(stiffness_val.size() == rows() * rows());
+						add_block(e, stiffness_val, rows(), rows(), phi_vals.basis_values[i].global, phi_vals.basis_values[j].global, 0, 0, j < i, true);
+					}
+				}
+
+				// B and B^T
+				for (int i = 0; i < n_psi_loc_bases; ++i)
+				{
+					for (int j = 0; j < n_phi_loc_bases; ++j)
+					{
+						const auto stiffness_val = assemble(MixedAssemblerData(psi_vals, phi_vals, i, j, local_storage.da));
+						assert(stiffness_val.size() == rows() * cols());
+						add_block(e, stiffness_val, rows(), cols(), psi_vals.basis_values[i].global, phi_vals.basis_values[j].global, 0, psi_offset, true, true);
+					}
+				}
+
+				// C, symmetric
+				for (int i = 0; i < n_psi_loc_bases; ++i)
+				{
+					for (int j = 0; j <= i; ++j)
+					{
+						const auto stiffness_val = psi_assembler.assemble(LinearAssemblerData(psi_vals, i, j, psi_da));
+						assert(stiffness_val.size() == cols() * cols());
+						add_block(e, stiffness_val, cols(), cols(), psi_vals.basis_values[i].global, psi_vals.basis_values[j].global, psi_offset, psi_offset, j < i, true);
+					}
+				}
+			}
+		});
+
+		timerg.stop();
+		logger().trace("done mixed system assembly {}s...", timerg.getElapsedTime());
+
+		timerg.start();
+		const std::vector<LocalThreadMatStorage *> storages = collect_thread_storages(storage);
+		maybe_parallel_for(storages.size(), [&](int i) { storages[i]->cache.prune(); });
+		merge_thread_caches(storages);
+		SparseMatrixCache &system = storages.front()->cache;
+
+		if (add_average)
+		{
+			const int n_psi_dofs = n_psi_basis * cols();
+			const double val = 1.0 / n_psi_dofs;
+			for (int i = 0; i < n_psi_dofs; ++i)
+			{
+				system.add_value(0, psi_offset + i, n_dofs - 1, val);
+				system.add_value(0, n_dofs - 1, psi_offset + i, val);
+			}
+		}
+
+		stiffness = system.get_matrix(false);
+		stiffness.makeCompressed();
+		timerg.stop();
+		merge_time_ += timerg.getElapsedTime();
+		logger().trace("done merge assembly {}s...", timerg.getElapsedTime());
+	}
+
+	double NLAssembler::assemble_energy(
+		const bool is_volume,
+		const std::vector<ElementBases> &bases,
+		const std::vector<ElementBases> &gbases,
+		const AssemblyValsCache &cache,
+		const double dt,
+		const Eigen::MatrixXd &displacement,
+		const Eigen::MatrixXd &displacement_prev) const
+	{
 		auto storage = create_thread_storage(LocalThreadScalarStorage());
 		const int n_bases = int(bases.size());
 
-		maybe_parallel_for(n_bases, [&](int start, int end, int thread_id) {
+		const std::vector<int> &order = element_order();
+		const bool reorder = order.size() == n_bases;
+
+		// in the deterministic mode the energies of the elements are summed afterwards in the element order
+		Eigen::VectorXd element_energies;
+		if (is_deterministic())
+			element_energies.setZero(n_bases);
+
+		maybe_parallel_for(element_costs("energy", bases, order), [&](int start, int end, int thread_id) {
 			LocalThreadScalarStorage &local_storage = get_local_thread_storage(storage, thread_id);
 			ElementAssemblyValues &vals = local_storage.vals;
 
-			for (int e = start; e < end; ++e)
+			for (int k = start; k < end; ++k)
 			{
+				const int e = reorder ? order[k] : k;
 				cache.compute(e, is_volume, bases[e], gbases[e], vals);
 
 				const Quadrature &quadrature = vals.quadrature;
@@ -491,10 +1212,16 @@ namespace polyfem::assembler
 				local_storage.da = vals.det.array() * quadrature.weights.array();
 
 				const double val = compute_energy(NonLinearAssemblerData(vals, dt, displacement, displacement_prev, local_storage.da));
-				local_storage.val += val;
+				if (is_deterministic())
+					element_energies[e] = val;
+				else
+					local_storage.val += val;
 			}
 		});
 
+		if (is_deterministic())
+			return compensated_sum(element_energies);
+
 		double res = 0;
 		// Serially merge local storages
 		for (const LocalThreadScalarStorage &local_storage : storage)
@@ -502,6 +1229,104 @@ namespace polyfem::assembler
 		return res;
 	}
 
+	bool NLAssembler::is_energy_finite(
+		const bool is_volume,
+		const std::vector<ElementBases> &bases,
+		const std::vector<ElementBases> &gbases,
+		const AssemblyValsCache &cache,
+		const double dt,
+		const Eigen::MatrixXd &displacement,
+		const Eigen::MatrixXd &displacement_prev) const
+	{
+		auto storage = create_thread_storage(LocalThreadScalarStorage());
+		const int n_bases = int(bases.size());
+
+		std::atomic<bool> is_finite(true);
+
+		maybe_parallel_for(n_bases, [&](int start, int end, int thread_id) {
+			LocalThreadScalarStorage &local_storage = get_local_thread_storage(storage, thread_id);
+			ElementAssemblyValues &vals = local_storage.vals;
+
+			for (int e = start; e < end && is_finite.load(std::memory_order_relaxed); ++e)
+			{
+				cache.compute(e, is_volume, bases[e], gbases[e], vals);
+
+				const Quadrature &quadrature = vals.quadrature;
+
+				assert(MAX_QUAD_POINTS == -1 || quadrature.weights.size() < MAX_QUAD_POINTS);
+				local_storage.da = vals.det.array() * quadrature.weights.array();
+
+				const double val = compute_energy(NonLinearAssemblerData(vals, dt, displacement, displacement_prev, local_storage.da));
+				if (!std::isfinite(val))
+					is_finite = false;
+			}
+		});
+
+		return is_finite;
+	}
+
+	Eigen::VectorXd NLAssembler::assemble_energies(
+		const bool is_volume,
+		const std::vector<ElementBases> &bases,
+		const std::vector<ElementBases> &gbases,
+		const AssemblyValsCache &cache,
+		const double dt,
+		const std::vector<Eigen::MatrixXd> &displacements,
+		const Eigen::MatrixXd &displacement_prev) const
+	{
+		const int n_displacements = int(displacements.size());
+		auto storage = create_thread_storage(LocalThreadVecStorage(n_displacements));
+		const int n_bases = int(bases.size());
+
+		// the element values are computed once for all the displacements
+		const std::vector<int> &order = element_order();
+		const bool reorder = order.size() == n_bases;
+
+		// in the deterministic mode the energies of the elements are summed afterwards in the element order
+		Eigen::MatrixXd element_energies;
+		if (is_deterministic())
+			element_energies.setZero(n_bases, n_displacements);
+
+		maybe_parallel_for(element_costs("energies", bases, order), [&](int start, int end, int thread_id) {
+			LocalThreadVecStorage &local_storage = get_local_thread_storage(storage, thread_id);
+
+			ElementAssemblyValues &vals = local_storage.vals;
+
+			for (int k = start; k < end; ++k)
+			{
+				const int e = reorder ? order[k] : k;
+				cache.compute(e, is_volume, bases[e], gbases[e], vals);
+
+				const Quadrature &quadrature = vals.quadrature;
+
+				assert(MAX_QUAD_POINTS == -1 || quadrature.weights.size() < MAX_QUAD_POINTS);
+				local_storage.da = vals.det.array() * quadrature.weights.array();
+
+				for (int k = 0; k < n_displacements; ++k)
+				{
+					const double val = compute_energy(NonLinearAssemblerData(vals, dt, displacements[k], displacement_prev, local_storage.da));
+					if (is_deterministic())
+						element_energies(e, k) = val;
+					else
+						local_storage.vec(k) += val;
+				}
+			}
+		});
+
+		Eigen::VectorXd res = Eigen::VectorXd::Zero(n_displacements);
+		if (is_deterministic())
+		{
+			for (int k = 0; k < n_displacements; ++k)
+				res(k) = compensated_sum(element_energies.col(k));
+			return res;
+		}
+
+		// Serially merge local storages
+		for (const LocalThreadVecStorage &local_storage : storage)
+			res += local_storage.vec;
+		return res;
+	}
+
 	void NLAssembler::assemble_gradient(
 		const bool is_volume,
 		const int n_basis,
@@ -513,67 +1338,203 @@ namespace polyfem::assembler
 		const Eigen::MatrixXd &displacement_prev,
 		Eigen::MatrixXd &rhs) const
 	{
+		// the gradient is first touched in parallel, with the same split as the merges of the other loops
 		rhs.resize(n_basis * size(), 1);
-		rhs.setZero();
+		maybe_parallel_fill(rhs.data(), rhs.size(), 0.0);
 
-		auto storage = create_thread_storage(LocalThreadVecStorage(rhs.size()));
+		const bool deterministic = is_deterministic();
+		auto storage = create_thread_storage(LocalThreadVecStorage(0));
 
 		const int n_bases = int(bases.size());
 
-		maybe_parallel_for(n_bases, [&](int start, int end, int thread_id) {
+		const auto local_gradient = [&](const int e, LocalThreadVecStorage &local_storage) -> const Eigen::VectorXd & {
+			ElementAssemblyValues &vals = local_storage.vals;
+			cache.compute(e, is_volume, bases[e], gbases[e], vals);
+
+			const Quadrature &quadrature = vals.quadrature;
+
+			assert(MAX_QUAD_POINTS == -1 || quadrature.weights.size() < MAX_QUAD_POINTS);
+			local_storage.da = vals.det.array() * quadrature.weights.array();
+
+			Eigen::VectorXd &val = local_storage.gradient;
+			assemble_gradient(NonLinearAssemblerData(vals, dt, displacement, displacement_prev, local_storage.da), val);
+			assert(val.size() == vals.basis_values.size() * size());
+			return val;
+		};
+
+		if (!deterministic)
+		{
+			// elements of the same color share no node, they scatter directly into the gradient:
+			// no full size vector per thread and no merge
+			for_each_colored_element(node_colors(n_basis, bases), [&](const int e, const int thread_id) {
+				LocalThreadVecStorage &local_storage = get_local_thread_storage(storage, thread_id);
+				scatter_local_gradient(local_storage.vals, local_gradient(e, local_storage), size(), rhs);
+			});
+			return;
+		}
+
+		const std::vector<int> &order = element_order();
+		const bool reorder = order.size() == n_bases;
+
+		// in the deterministic mode the local gradients are stored and scattered afterwards in the element order
+		std::vector<int> offsets(n_bases + 1, 0);
+		for (int e = 0; e < n_bases; ++e)
+			offsets[e + 1] = offsets[e] + int(bases[e].bases.size()) * size();
+		Eigen::VectorXd local_values(offsets.back());
+
+		maybe_parallel_for(element_costs("gradient", bases, order), [&](int start, int end, int thread_id) {
 			LocalThreadVecStorage &local_storage = get_local_thread_storage(storage, thread_id);
 
-			for (int e = start; e < end; ++e)
+			for (int k = start; k < end; ++k)
 			{
-				// igl::Timer timer; timer.start();
+				const int e = reorder ? order[k] : k;
+				const Eigen::VectorXd &val = local_gradient(e, local_storage);
+				assert(offsets[e + 1] - offsets[e] == val.size());
+				local_values.segment(offsets[e], val.size()) = val;
+			}
+		});
 
-				ElementAssemblyValues &vals = local_storage.vals;
-				// vals.compute(e, is_volume, bases[e], gbases[e]);
+		for (int e = 0; e < n_bases; ++e)
+		{
+			for (int j = 0; j < bases[e].bases.size(); ++j)
+			{
+				const auto &global_j = bases[e].bases[j].global();
+				for (int m = 0; m < size(); ++m)
+				{
+					const double local_value = local_values(offsets[e] + j * size() + m);
+					if (std::abs(local_value) < 1e-30)
+						continue;
+
+					for (size_t jj = 0; jj < global_j.size(); ++jj)
+						rhs(global_j[jj].index * size() + m) += local_value * global_j[jj].val;
+				}
+			}
+		}
+	}
+
+	Eigen::VectorXd NLAssembler::assemble_fused_energies(
+		const std::vector<FusedTerm> &terms,
+		const bool is_volume,
+		const std::vector<ElementBases> &bases,
+		const std::vector<ElementBases> &gbases,
+		const AssemblyValsCache &cache,
+		const Eigen::MatrixXd &displacement)
+	{
+		const int n_terms = int(terms.size());
+		Eigen::VectorXd res = Eigen::VectorXd::Zero(n_terms);
+		if (n_terms == 0)
+			return res;
+
+		const bool deterministic = std::any_of(terms.begin(), terms.end(), [](const FusedTerm &t) { return t.assembler->is_deterministic(); });
+		if (deterministic)
+		{
+			for (int i = 0; i < n_terms; ++i)
+				res(i) = terms[i].assembler->assemble_energy(is_volume, bases, gbases, cache, terms[i].dt, displacement, *terms[i].displacement_prev);
+			return res;
+		}
+
+		const NLAssembler &first = *terms.front().assembler;
+		auto storage = create_thread_storage(LocalThreadVecStorage(n_terms));
+		const int n_bases = int(bases.size());
+
+		const std::vector<int> &order = first.element_order();
+		const bool reorder = order.size() == n_bases;
+
+		maybe_parallel_for(first.element_costs("fused energies", bases, order), [&](int start, int end, int thread_id) {
+			LocalThreadVecStorage &local_storage = get_local_thread_storage(storage, thread_id);
+			ElementAssemblyValues &vals = local_storage.vals;
+
+			for (int k = start; k < end; ++k)
+			{
+				const int e = reorder ? order[k] : k;
 				cache.compute(e, is_volume, bases[e], gbases[e], vals);
 
 				const Quadrature &quadrature = vals.quadrature;
 
 				assert(MAX_QUAD_POINTS == -1 || quadrature.weights.size() < MAX_QUAD_POINTS);
 				local_storage.da = vals.det.array() * quadrature.weights.array();
-				const int n_loc_bases = int(vals.basis_values.size());
-
-				const auto val = assemble_gradient(NonLinearAssemblerData(vals, dt, displacement, displacement_prev, local_storage.da));
-				assert(val.size() == n_loc_bases * size());
 
-				for (int j = 0; j < n_loc_bases; ++j)
+				for (int i = 0; i < n_terms; ++i)
 				{
-					const auto &global_j = vals.basis_values[j].global;
+					const FusedTerm &term = terms[i];
+					local_storage.vec(i) += term.assembler->compute_energy(NonLinearAssemblerData(vals, term.dt, displacement, *term.displacement_prev, local_storage.da));
+				}
+			}
+		});
 
-					// igl::Timer t1; t1.start();
-					for (int m = 0; m < size(); ++m)
-					{
-						const double local_value = val(j * size() + m);
-						if (std::abs(local_value) < 1e-30)
-						{
-							continue;
-						}
+		// Serially merge local storages
+		for (const LocalThreadVecStorage &local_storage : storage)
+			res += local_storage.vec;
+		return res;
+	}
 
-						for (size_t jj = 0; jj < global_j.size(); ++jj)
-						{
-							const auto gj = global_j[jj].index * size() + m;
-							const auto wj = global_j[jj].val;
+	void NLAssembler::assemble_fused_gradient(
+		const std::vector<FusedTerm> &terms,
+		const bool is_volume,
+		const int n_basis,
+		const std::vector<ElementBases> &bases,
+		const std::vector<ElementBases> &gbases,
+		const AssemblyValsCache &cache,
+		const Eigen::MatrixXd &displacement,
+		Eigen::MatrixXd &rhs)
+	{
+		const bool deterministic = std::any_of(terms.begin(), terms.end(), [](const FusedTerm &t) { return t.assembler->is_deterministic(); });
+		if (terms.empty() || deterministic)
+		{
+			rhs.setZero(terms.empty() ? 0 : n_basis * terms.front().assembler->size(), 1);
+			Eigen::MatrixXd tmp;
+			for (const FusedTerm &term : terms)
+			{
+				term.assembler->assemble_gradient(is_volume, n_basis, bases, gbases, cache, term.dt, displacement, *term.displacement_prev, tmp);
+				rhs += term.weight * tmp;
+			}
+			return;
+		}
 
-							local_storage.vec(gj) += local_value * wj;
-						}
-					}
+		const NLAssembler &first = *terms.front().assembler;
+		const int size = first.size();
+		assert(std::all_of(terms.begin(), terms.end(), [size](const FusedTerm &t) { return t.assembler->size() == size; }));
 
-					// t1.stop();
-					// if (!vals.has_parameterization) { std::cout << "-- t1: " << t1.getElapsedTime() << std::endl; }
-				}
+		rhs.resize(n_basis * size, 1);
+		maybe_parallel_fill(rhs.data(), rhs.size(), 0.0);
+
+		auto storage = create_thread_storage(LocalThreadVecStorage(0));
 
-				// timer.stop();
-				// if (!vals.has_parameterization) { std::cout << "-- Timer: " << timer.getElapsedTime() << std::endl; }
+		// elements of the same color share no node, the weighted sum of the local gradients is scattered directly
+		for_each_colored_element(first.node_colors(n_basis, bases), [&](const int e, const int thread_id) {
+			LocalThreadVecStorage &local_storage = get_local_thread_storage(storage, thread_id);
+			ElementAssemblyValues &vals = local_storage.vals;
+			cache.compute(e, is_volume, bases[e], gbases[e], vals);
+
+			const Quadrature &quadrature = vals.quadrature;
+
+			assert(MAX_QUAD_POINTS == -1 || quadrature.weights.size() < MAX_QUAD_POINTS);
+			local_storage.da = vals.det.array() * quadrature.weights.array();
+
+			Eigen::VectorXd &sum = local_storage.gradient;
+			for (size_t i = 0; i < terms.size(); ++i)
+			{
+				const FusedTerm &term = terms[i];
+				Eigen::VectorXd &val = local_storage.term_gradient;
+				term.assembler->assemble_gradient(NonLinearAssemblerData(vals, term.dt, displacement, *term.displacement_prev, local_storage.da), val);
+				assert(val.size() == vals.basis_values.size() * size);
+				if (i == 0)
+					sum = term.weight * val;
+				else
+					sum += term.weight * val;
 			}
+			scatter_local_gradient(vals, sum, size, rhs);
 		});
+	}
 
-		// Serially merge local storages
-		for (const LocalThreadVecStorage &local_storage : storage)
-			rhs += local_storage.vec;
+	void NLAssembler::assemble_local_hessian(const NonLinearAssemblerData &data, const bool project_to_psd, Eigen::MatrixXd &hessian) const
+	{
+		if (project_to_psd && is_quadrature_psd_projection() && assemble_projected_hessian(data, hessian))
+			return;
+
+		assemble_hessian(data, hessian);
+		if (project_to_psd)
+			hessian = ipc::project_to_psd(hessian);
 	}
 
 	void NLAssembler::assemble_hessian(
@@ -588,6 +1549,40 @@ namespace polyfem::assembler
 		const Eigen::MatrixXd &displacement_prev,
 		SparseMatrixCache &mat_cache,
 		StiffnessMatrix &grad) const
+	{
+		assemble_global_hessian(is_volume, n_basis, project_to_psd, bases, gbases, cache, dt, displacement, displacement_prev, mat_cache, nullptr, grad);
+	}
+
+	void NLAssembler::assemble_hessian_incremental(
+		const bool is_volume,
+		const int n_basis,
+		const bool project_to_psd,
+		const std::vector<ElementBases> &bases,
+		const std::vector<ElementBases> &gbases,
+		const AssemblyValsCache &cache,
+		const double dt,
+		const Eigen::MatrixXd &displacement,
+		const Eigen::MatrixXd &displacement_prev,
+		SparseMatrixCache &mat_cache,
+		LocalHessianCache &local_cache,
+		StiffnessMatrix &grad) const
+	{
+		assemble_global_hessian(is_volume, n_basis, project_to_psd, bases, gbases, cache, dt, displacement, displacement_prev, mat_cache, &local_cache, grad);
+	}
+
+	void NLAssembler::assemble_global_hessian(
+		const bool is_volume,
+		const int n_basis,
+		const bool project_to_psd,
+		const std::vector<ElementBases> &bases,
+		const std::vector<ElementBases> &gbases,
+		const AssemblyValsCache &cache,
+		const double dt,
+		const Eigen::MatrixXd &displacement,
+		const Eigen::MatrixXd &displacement_prev,
+		SparseMatrixCache &mat_cache,
+		LocalHessianCache *local_cache,
+		StiffnessMatrix &grad) const
 	{
 		const int max_triplets_size = int(1e7);
 		const int buffer_size = std::min(long(max_triplets_size), long(n_basis) * size());
@@ -599,112 +1594,425 @@ namespace polyfem::assembler
 		mat_cache.init(n_basis * size());
 		mat_cache.set_zero();
 
-		auto storage = create_thread_storage(LocalThreadMatStorage(buffer_size, mat_cache));
-
 		const int n_bases = int(bases.size());
+
+		if (local_cache)
+			local_cache->prepare(n_bases, project_to_psd);
+		std::atomic<int> n_reused(0);
+
+		// computes the local hessian of element e, or takes the stored one if its nodes did not move, and passes its entries to add_value
+		const auto assemble_element = [&](const int e, auto &local_storage, const auto &add_value) {
+			Eigen::MatrixXd &stiffness_val = local_storage.hessian;
+
+			if (local_cache)
+			{
+				gather_local_displacement(bases[e], displacement, size(), local_storage.displacement);
+				if (is_displacement_unchanged(local_storage.displacement, local_cache->displacements_[e], size(), local_cache->tolerance()))
+				{
+					++n_reused;
+					scatter_local_hessian(bases[e], local_cache->hessians_[e], size(), add_value);
+					return;
+				}
+			}
+
+			ElementAssemblyValues &vals = local_storage.vals;
+			cache.compute(e, is_volume, bases[e], gbases[e], vals);
+
+			const Quadrature &quadrature = vals.quadrature;
+
+			assert(MAX_QUAD_POINTS == -1 || quadrature.weights.size() < MAX_QUAD_POINTS);
+			local_storage.da = vals.det.array() * quadrature.weights.array();
+			const int n_loc_bases = int(vals.basis_values.size());
+
+			assemble_local_hessian(NonLinearAssemblerData(vals, dt, displacement, displacement_prev, local_storage.da), project_to_psd, stiffness_val);
+			assert(stiffness_val.rows() == n_loc_bases * size());
+			assert(stiffness_val.cols() == n_loc_bases * size());
+
+			// every element is visited by one thread, the entries of different elements can be written concurrently
+			if (local_cache)
+			{
+				local_cache->displacements_[e] = local_storage.displacement;
+				local_cache->hessians_[e] = stiffness_val;
+			}
+
+			scatter_local_hessian(bases[e], stiffness_val, size(), add_value);
+		};
+
+		// the counters of the cache are set on every return
+		const auto count_reused = [&]() {
+			if (!local_cache)
+				return;
+			local_cache->n_reused_ = n_reused;
+			local_cache->n_evaluated_ = n_bases - n_reused;
+			logger().trace("incremental hessian assembly, {} elements reused, {} evaluated", local_cache->n_reused_, local_cache->n_evaluated_);
+		};
+
 		igl::Timer timerg;
+
+		if (!mat_cache.element_colors().empty())
+		{
+			// the pattern is known: elements of the same color share no dof, so they
+			// scatter directly into the cache values in parallel, without thread copies and merge
+			auto storage = create_thread_storage(LocalThreadElementStorage());
+
+			timerg.start();
+
+			for (const std::vector<int> &color : mat_cache.element_colors())
+			{
+				maybe_parallel_for(color.size(), [&](int start, int end, int thread_id) {
+					LocalThreadElementStorage &local_storage = get_local_thread_storage(storage, thread_id);
+
+					for (int k = start; k < end; ++k)
+					{
+						const int e = color[k];
+						int index = 0;
+						assemble_element(e, local_storage, [&](const int gi, const int gj, const double value) {
+							mat_cache.add_element_value(e, index++, value);
+						});
+					}
+				});
+			}
+
+			timerg.stop();
+			logger().trace("done colored assembly {}s...", timerg.getElapsedTime());
+			count_reused();
+
+			timerg.start();
+			mat_cache.get_matrix(grad);
+			timerg.stop();
+			merge_time_ += timerg.getElapsedTime();
+			logger().trace("done merge assembly {}s...", timerg.getElapsedTime());
+			return;
+		}
+
+		auto storage = create_thread_storage(LocalThreadMatStorage(buffer_size, mat_cache));
+
 		timerg.start();
 
-		maybe_parallel_for(n_bases, [&](int start, int end, int thread_id) {
+		const std::vector<int> &order = element_order();
+		const bool reorder = order.size() == n_bases;
+
+		maybe_parallel_for(element_costs("hessian", bases, order), [&](int start, int end, int thread_id) {
 			LocalThreadMatStorage &local_storage = get_local_thread_storage(storage, thread_id);
 
-			for (int e = start; e < end; ++e)
+			for (int k = start; k < end; ++k)
 			{
-				ElementAssemblyValues &vals = local_storage.vals;
-				cache.compute(e, is_volume, bases[e], gbases[e], vals);
+				const int e = reorder ? order[k] : k;
+				assemble_element(e, local_storage, [&](const int gi, const int gj, const double value) {
+					local_storage.cache.add_value(e, gi, gj, value);
 
-				const Quadrature &quadrature = vals.quadrature;
+					if (local_storage.cache.entries_size() >= max_triplets_size)
+					{
+						local_storage.cache.prune();
+						logger().debug("cleaning memory...");
+					}
+				});
+			}
+		});
 
-				assert(MAX_QUAD_POINTS == -1 || quadrature.weights.size() < MAX_QUAD_POINTS);
-				local_storage.da = vals.det.array() * quadrature.weights.array();
-				const int n_loc_bases = int(vals.basis_values.size());
+		timerg.stop();
+		logger().trace("done separate assembly {}s...", timerg.getElapsedTime());
+		count_reused();
 
-				auto stiffness_val = assemble_hessian(NonLinearAssemblerData(vals, dt, displacement, displacement_prev, local_storage.da));
-				assert(stiffness_val.rows() == n_loc_bases * size());
-				assert(stiffness_val.cols() == n_loc_bases * size());
-
-				if (project_to_psd)
-					stiffness_val = ipc::project_to_psd(stiffness_val);
-
-				// bool has_nan = false;
-				// for(int k = 0; k < stiffness_val.size(); ++k)
-				// {
-				// 	if(std::isnan(stiffness_val(k)))
-				// 	{
-				// 		has_nan = true;
-				// 		break;
-				// 	}
-				// }
-
-				// if(has_nan)
-				// {
-				// 	local_storage.entries.emplace_back(0, 0, std::nan(""));
-				// 	break;
-				// }
+		timerg.start();
 
-				for (int i = 0; i < n_loc_bases; ++i)
-				{
-					const auto &global_i = vals.basis_values[i].global;
+		// Pairwise merge of the local storages
+		const std::vector<LocalThreadMatStorage *> storages = collect_thread_storages(storage);
+		maybe_parallel_for(storages.size(), [&](int i) { storages[i]->cache.prune(); });
+		merge_thread_caches(storages);
+		mat_cache += storages.front()->cache;
+		mat_cache.get_matrix(grad);
 
-					for (int j = 0; j < n_loc_bases; ++j)
-					// for(int j = 0; j <= i; ++j)
-					{
-						const auto &global_j = vals.basis_values[j].global;
+		timerg.stop();
+		merge_time_ += timerg.getElapsedTime();
+		logger().trace("done merge assembly {}s...", timerg.getElapsedTime());
+	}
 
-						for (int n = 0; n < size(); ++n)
-						{
-							for (int m = 0; m < size(); ++m)
-							{
-								const double local_value = stiffness_val(i * size() + m, j * size() + n);
-								//  if (std::abs(local_value) < 1e-30)
-								//  {
-								// 	 continue;
-								//  }
+	void NLAssembler::compute_energy_gradient_hessian(const NonLinearAssemblerData &data, double *energy, Eigen::VectorXd *gradient, Eigen::MatrixXd *hessian) const
+	{
+		if (energy)
+			*energy = compute_energy(data);
+		if (gradient)
+			assemble_gradient(data, *gradient);
+		if (hessian)
+			assemble_hessian(data, *hessian);
+	}
 
-								for (size_t ii = 0; ii < global_i.size(); ++ii)
-								{
-									const auto gi = global_i[ii].index * size() + m;
-									const auto wi = global_i[ii].val;
+	void NLAssembler::assemble_energy_gradient_hessian(
+		const bool is_volume,
+		const int n_basis,
+		const bool project_to_psd,
+		const std::vector<ElementBases> &bases,
+		const std::vector<ElementBases> &gbases,
+		const AssemblyValsCache &cache,
+		const double dt,
+		const Eigen::MatrixXd &displacement,
+		const Eigen::MatrixXd &displacement_prev,
+		SparseMatrixCache &mat_cache,
+		double *energy,
+		Eigen::MatrixXd *rhs,
+		StiffnessMatrix *hessian) const
+	{
+		// the deterministic mode sums in the element order, the separate loops already do it
+		if (is_deterministic() || int(energy != nullptr) + int(rhs != nullptr) + int(hessian != nullptr) < 2)
+		{
+			Assembler::assemble_energy_gradient_hessian(is_volume, n_basis, project_to_psd, bases, gbases, cache, dt, displacement, displacement_prev, mat_cache, energy, rhs, hessian);
+			return;
+		}
 
-									for (size_t jj = 0; jj < global_j.size(); ++jj)
-									{
-										const auto gj = global_j[jj].index * size() + n;
-										const auto wj = global_j[jj].val;
+		const int max_triplets_size = int(1e7);
+		const int buffer_size = std::min(long(max_triplets_size), long(n_basis) * size());
 
-										local_storage.cache.add_value(e, gi, gj, local_value * wi * wj);
-										// if (j < i) {
-										// 	local_storage.entries.emplace_back(gj, gi, local_value * wj * wi);
-										// }
+		if (rhs)
+			rhs->setZero(n_basis * size(), 1);
+		if (hessian)
+		{
+			mat_cache.init(n_basis * size());
+			mat_cache.set_zero();
+		}
 
-										if (local_storage.cache.entries_size() >= max_triplets_size)
-										{
-											local_storage.cache.prune();
-											logger().debug("cleaning memory...");
-										}
-									}
-								}
+		const int n_bases = int(bases.size());
+		// elements of the same color share no dof: with the pattern of the hessian or, without hessian, the global nodes
+		const std::vector<std::vector<int>> *colors = nullptr;
+		if (hessian && !mat_cache.element_colors().empty())
+			colors = &mat_cache.element_colors();
+		else if (!hessian)
+			colors = &node_colors(n_basis, bases);
+		const bool colored = colors != nullptr;
+
+		// the element values and the per quadrature point quantities are computed once for the three outputs,
+		// the projected hessians are not a by-product of the derivatives and are computed on their own
+		const auto compute_element = [&](const int e, LocalThreadFusedStorage &local_storage) {
+			ElementAssemblyValues &vals = local_storage.vals;
+			cache.compute(e, is_volume, bases[e], gbases[e], vals);
+
+			assert(MAX_QUAD_POINTS == -1 || vals.quadrature.weights.size() < MAX_QUAD_POINTS);
+			local_storage.da = vals.det.array() * vals.quadrature.weights.array();
+
+			const NonLinearAssemblerData data(vals, dt, displacement, displacement_prev, local_storage.da);
+			double val = 0;
+			compute_energy_gradient_hessian(
+				data, energy ? &val : nullptr, rhs ? &local_storage.gradient : nullptr,
+				hessian && !project_to_psd ? &local_storage.hessian : nullptr);
+			if (hessian && project_to_psd)
+				assemble_local_hessian(data, true, local_storage.hessian);
+
+			local_storage.val += val;
+		};
+
+		LocalThreadFusedStorage storage_init;
+		if (rhs && !colored)
+			storage_init.vec.setZero(rhs->size(), 1);
+		if (hessian && !colored)
+		{
+			storage_init.cache.reserve(buffer_size);
+			storage_init.cache.init(mat_cache);
+		}
+		auto storage = create_thread_storage(storage_init);
+
+		igl::Timer timerg;
+		timerg.start();
+
+		if (colored)
+		{
+			// elements of the same color share no dof, they scatter the hessian and the gradient directly
+			for_each_colored_element(*colors, [&](const int e, const int thread_id) {
+				LocalThreadFusedStorage &local_storage = get_local_thread_storage(storage, thread_id);
+				compute_element(e, local_storage);
+
+				if (hessian)
+				{
+					int index = 0;
+					scatter_local_hessian(bases[e], local_storage.hessian, size(), [&](const int gi, const int gj, const double value) {
+						mat_cache.add_element_value(e, index++, value);
+					});
+				}
+				if (rhs)
+					scatter_local_gradient(local_storage.vals, local_storage.gradient, size(), *rhs);
+			});
+		}
+		else
+		{
+			const std::vector<int> &order = element_order();
+			const bool reorder = order.size() == n_bases;
+
+			maybe_parallel_for(element_costs("energy_gradient_hessian", bases, order), [&](int start, int end, int thread_id) {
+				LocalThreadFusedStorage &local_storage = get_local_thread_storage(storage, thread_id);
+
+				for (int k = start; k < end; ++k)
+				{
+					const int e = reorder ? order[k] : k;
+					compute_element(e, local_storage);
+
+					if (hessian)
+					{
+						scatter_local_hessian(bases[e], local_storage.hessian, size(), [&](const int gi, const int gj, const double value) {
+							local_storage.cache.add_value(e, gi, gj, value);
+
+							if (local_storage.cache.entries_size() >= max_triplets_size)
+							{
+								local_storage.cache.prune();
+								logger().debug("cleaning memory...");
 							}
-						}
+						});
 					}
+					if (rhs)
+						scatter_local_gradient(local_storage.vals, local_storage.gradient, size(), local_storage.vec);
 				}
-			}
-		});
+			});
+		}
 
 		timerg.stop();
-		logger().trace("done separate assembly {}s...", timerg.getElapsedTime());
+		logger().trace("done fused assembly {}s...", timerg.getElapsedTime());
 
 		timerg.start();
 
-		// Serially merge local storages
-		for (LocalThreadMatStorage &local_storage : storage)
+		if (energy)
+		{
+			*energy = 0;
+			for (const LocalThreadFusedStorage &local_storage : storage)
+				*energy += local_storage.val;
+		}
+		if (rhs && !colored)
 		{
-			local_storage.cache.prune();
-			mat_cache += local_storage.cache;
+			for (const LocalThreadFusedStorage &local_storage : storage)
+				*rhs += local_storage.vec;
+		}
+		if (hessian)
+		{
+			if (!colored)
+			{
+				const std::vector<LocalThreadFusedStorage *> storages = collect_thread_storages(storage);
+				maybe_parallel_for(storages.size(), [&](int i) { storages[i]->cache.prune(); });
+				merge_thread_caches(storages);
+				mat_cache += storages.front()->cache;
+			}
+			mat_cache.get_matrix(*hessian);
 		}
-		grad = mat_cache.get_matrix();
 
 		timerg.stop();
+		merge_time_ += timerg.getElapsedTime();
 		logger().trace("done merge assembly {}s...", timerg.getElapsedTime());
 	}
 
+	void NLAssembler::assemble_hessian_vector_product(
+		const bool is_volume,
+		const int n_basis,
+		const bool project_to_psd,
+		const std::vector<ElementBases> &bases,
+		const std::vector<ElementBases> &gbases,
+		const AssemblyValsCache &cache,
+		const double dt,
+		const Eigen::MatrixXd &displacement,
+		const Eigen::MatrixXd &displacement_prev,
+		const Eigen::MatrixXd &v,
+		Eigen::MatrixXd &out) const
+	{
+		assert(v.size() == n_basis * size());
+
+		out.resize(n_basis * size(), 1);
+		out.setZero();
+
+		auto storage = create_thread_storage(LocalThreadVecStorage(0));
+
+		// elements of the same color share no node, they scatter directly into out as in assemble_gradient
+		for_each_colored_element(node_colors(n_basis, bases), [&](const int e, const int thread_id) {
+			LocalThreadVecStorage &local_storage = get_local_thread_storage(storage, thread_id);
+
+			ElementAssemblyValues &vals = local_storage.vals;
+			cache.compute(e, is_volume, bases[e], gbases[e], vals);
+
+			const Quadrature &quadrature = vals.quadrature;
+
+			assert(MAX_QUAD_POINTS == -1 || quadrature.weights.size() < MAX_QUAD_POINTS);
+			local_storage.da = vals.det.array() * quadrature.weights.array();
+			const int n_loc_bases = int(vals.basis_values.size());
+
+			Eigen::MatrixXd &stiffness_val = local_storage.hessian;
+			assemble_local_hessian(NonLinearAssemblerData(vals, dt, displacement, displacement_prev, local_storage.da), project_to_psd, stiffness_val);
+			assert(stiffness_val.rows() == n_loc_bases * size());
+			assert(stiffness_val.cols() == n_loc_bases * size());
+
+			// gather v on the local dofs, local_storage.vec is unused and holds the local v
+			Eigen::MatrixXd &local_v = local_storage.vec;
+			local_v.setZero(n_loc_bases * size(), 1);
+			for (int i = 0; i < n_loc_bases; ++i)
+			{
+				const auto &global_i = vals.basis_values[i].global;
+				for (int m = 0; m < size(); ++m)
+					for (size_t ii = 0; ii < global_i.size(); ++ii)
+						local_v(i * size() + m) += global_i[ii].val * v(global_i[ii].index * size() + m);
+			}
+
+			Eigen::VectorXd &local_out = local_storage.gradient;
+			local_out.noalias() = stiffness_val * local_v;
+
+			scatter_local_gradient(vals, local_out, size(), out);
+		});
+	}
+
+	void NLAssembler::assemble_hessian_diagonal(
+		const bool is_volume,
+		const int n_basis,
+		const bool project_to_psd,
+		const std::vector<ElementBases> &bases,
+		const std::vector<ElementBases> &gbases,
+		const AssemblyValsCache &cache,
+		const double dt,
+		const Eigen::MatrixXd &displacement,
+		const Eigen::MatrixXd &displacement_prev,
+		Eigen::MatrixXd &diag) const
+	{
+		diag.resize(n_basis * size(), 1);
+		diag.setZero();
+
+		auto storage = create_thread_storage(LocalThreadVecStorage(0));
+
+		// elements of the same color share no node, they scatter directly into diag
+		for_each_colored_element(node_colors(n_basis, bases), [&](const int e, const int thread_id) {
+			LocalThreadVecStorage &local_storage = get_local_thread_storage(storage, thread_id);
+
+			ElementAssemblyValues &vals = local_storage.vals;
+			cache.compute(e, is_volume, bases[e], gbases[e], vals);
+
+			const Quadrature &quadrature = vals.quadrature;
+
+			assert(MAX_QUAD_POINTS == -1 || quadrature.weights.size() < MAX_QUAD_POINTS);
+			local_storage.da = vals.det.array() * quadrature.weights.array();
+			const int n_loc_bases = int(vals.basis_values.size());
+
+			Eigen::MatrixXd &stiffness_val = local_storage.hessian;
+			assemble_local_hessian(NonLinearAssemblerData(vals, dt, displacement, displacement_prev, local_storage.da), project_to_psd, stiffness_val);
+			assert(stiffness_val.rows() == n_loc_bases * size());
+			assert(stiffness_val.cols() == n_loc_bases * size());
+
+			// only the pairs of local dofs landing on the same global dof contribute to the diagonal
+			for (int i = 0; i < n_loc_bases; ++i)
+			{
+				const auto &global_i = vals.basis_values[i].global;
+
+				for (int j = 0; j < n_loc_bases; ++j)
+				{
+					const auto &global_j = vals.basis_values[j].global;
+
+					for (int m = 0; m < size(); ++m)
+					{
+						const double local_value = stiffness_val(i * size() + m, j * size() + m);
+
+						for (size_t ii = 0; ii < global_i.size(); ++ii)
+						{
+							for (size_t jj = 0; jj < global_j.size(); ++jj)
+							{
+								if (global_i[ii].index != global_j[jj].index)
+									continue;
+
+								diag(global_i[ii].index * size() + m) += local_value * global_i[ii].val * global_j[jj].val;
+							}
+						}
+					}
+				}
+			}
+		});
+	}
+
 } // namespace polyfem::assembler
@@ -4,14 +4,52 @@
 #include <polyfem/assembler/AssemblyValsCache.hpp>
 
 #include <polyfem/utils/MatrixUtils.hpp>
+#include <polyfem/utils/BlockSparseMatrix.hpp>
 #include <polyfem/utils/ElasticityUtils.hpp>
 #include <polyfem/utils/AutodiffTypes.hpp>
 #include <polyfem/utils/Logger.hpp>
+#include <polyfem/utils/LoopCostModel.hpp>
 
 // this casses are instantiated in the cpp, cannot be used with generic assembler
 // without adding template instantiation
 namespace polyfem::assembler
 {
+	/// local hessians of the elements kept between two hessian assemblies (see Assembler::assemble_hessian_incremental),
+	/// an element whose nodes moved less than the tolerance since its hessian was computed reuses it without evaluating the material
+	class LocalHessianCache
+	{
+	public:
+		/// @param[in] tolerance largest displacement change of a node of a reused element
+		LocalHessianCache(const double tolerance = 0) : tolerance_(tolerance) {}
+
+		double tolerance() const { return tolerance_; }
+		void set_tolerance(const double tolerance) { tolerance_ = tolerance; }
+
+		/// forgets the stored hessians, to call when the bases, the time step, or the previous solution change
+		void clear();
+
+		/// number of elements evaluated and reused by the last assembly
+		int n_evaluated() const { return n_evaluated_; }
+		int n_reused() const { return n_reused_; }
+
+	private:
+		friend class NLAssembler;
+
+		/// clears the cache if the number of elements or the psd projection changed
+		void prepare(const int n_elements, const bool project_to_psd);
+
+		double tolerance_;
+		bool project_to_psd_ = false;
+		/// local displacements at which the hessians were computed, empty for the elements without hessian
+		std::vector<Eigen::VectorXd> displacements_;
+		std::vector<Eigen::MatrixXd> hessians_;
+
+		int n_evaluated_ = 0;
+		int n_reused_ = 0;
+	};
+
+	class LinearAssembler;
+
 	// mixed formulation assembler
 	class MixedAssembler
 	{
@@ -32,13 +70,36 @@ namespace polyfem::assembler
 			const AssemblyValsCache &phi_cache,
 			StiffnessMatrix &stiffness) const;
 
+		// assembles the saddle point system of the mixed formulation in one element loop, without the three separate blocks
+		//  A   B
+		//  B^T C
+		// A is assembled by phi_assembler on the phi_bases, B by this assembler, and C by psi_assembler on the psi_bases
+		// if add_average, the last row and column constrain the average of the psi dofs (see AssemblerUtils::merge_mixed_matrices)
+		void assemble_system(
+			const bool is_volume,
+			const int n_psi_basis,
+			const int n_phi_basis,
+			const std::vector<basis::ElementBases> &psi_bases,
+			const std::vector<basis::ElementBases> &phi_bases,
+			const std::vector<basis::ElementBases> &gbases,
+			const AssemblyValsCache &psi_cache,
+			const AssemblyValsCache &phi_cache,
+			const LinearAssembler &phi_assembler,
+			const LinearAssembler &psi_assembler,
+			const bool add_average,
+			StiffnessMatrix &stiffness) const;
+
 		virtual std::string name() const = 0;
 
 		int size() const { return size_; }
 		virtual void set_size(const int size) { size_ = size; }
 
+		/// total time spent merging the per-thread storages, accumulated over all the assemblies
+		double merge_time() const { return merge_time_; }
+
 	protected:
 		int size_ = -1;
+		mutable double merge_time_ = 0;
 
 		virtual int rows() const = 0;
 		virtual int cols() const = 0;
@@ -70,6 +131,16 @@ namespace polyfem::assembler
 			StiffnessMatrix &stiffness,
 			const bool is_mass = false) const { log_and_throw_error("Assembler not implemented by {}!", name()); }
 
+		// same as assemble, into a block sparse matrix with one size() x size() block per node pair
+		virtual void assemble(
+			const bool is_volume,
+			const int n_basis,
+			const std::vector<basis::ElementBases> &bases,
+			const std::vector<basis::ElementBases> &gbases,
+			const AssemblyValsCache &cache,
+			utils::BlockSparseMatrix &stiffness,
+			const bool is_mass = false) const { log_and_throw_error("Block assembler not implemented by {}!", name()); }
+
 		// assemble energy
 		virtual double assemble_energy(
 			const bool is_volume,
@@ -80,6 +151,35 @@ namespace polyfem::assembler
 			const Eigen::MatrixXd &displacement,
 			const Eigen::MatrixXd &displacement_prev) const { log_and_throw_error("Assemble energy not implemented by {}!", name()); }
 
+		// the energy of every element is finite (e.g., no inverted element for the energies with a log barrier on det(F))
+		virtual bool is_energy_finite(
+			const bool is_volume,
+			const std::vector<basis::ElementBases> &bases,
+			const std::vector<basis::ElementBases> &gbases,
+			const AssemblyValsCache &cache,
+			const double dt,
+			const Eigen::MatrixXd &displacement,
+			const Eigen::MatrixXd &displacement_prev) const
+		{
+			return std::isfinite(assemble_energy(is_volume, bases, gbases, cache, dt, displacement, displacement_prev));
+		}
+
+		// assemble energy at several displacements (e.g., line search candidates)
+		virtual Eigen::VectorXd assemble_energies(
+			const bool is_volume,
+			const std::vector<basis::ElementBases> &bases,
+			const std::vector<basis::ElementBases> &gbases,
+			const AssemblyValsCache &cache,
+			const double dt,
+			const std::vector<Eigen::MatrixXd> &displacements,
+			const Eigen::MatrixXd &displacement_prev) const
+		{
+			Eigen::VectorXd res(displacements.size());
+			for (size_t k = 0; k < displacements.size(); ++k)
+				res[k] = assemble_energy(is_volume, bases, gbases, cache, dt, displacements[k], displacement_prev);
+			return res;
+		}
+
 		// assemble gradient of energy (rhs)
 		virtual void assemble_gradient(
 			const bool is_volume,
@@ -106,6 +206,77 @@ namespace polyfem::assembler
 			utils::SparseMatrixCache &mat_cache,
 			StiffnessMatrix &grad) const { log_and_throw_error("Assemble hessian not implemented by {}!", name()); }
 
+		// hessian of energy reusing the local hessians of local_cache for the elements whose displacement did not change
+		// the default ignores the cache, the non-linear assemblers store and reuse the local hessians
+		virtual void assemble_hessian_incremental(
+			const bool is_volume,
+			const int n_basis,
+			const bool project_to_psd,
+			const std::vector<basis::ElementBases> &bases,
+			const std::vector<basis::ElementBases> &gbases,
+			const AssemblyValsCache &cache,
+			const double dt,
+			const Eigen::MatrixXd &displacement,
+			const Eigen::MatrixXd &displacement_prev,
+			utils::SparseMatrixCache &mat_cache,
+			LocalHessianCache &local_cache,
+			StiffnessMatrix &grad) const
+		{
+			assemble_hessian(is_volume, n_basis, project_to_psd, bases, gbases, cache, dt, displacement, displacement_prev, mat_cache, grad);
+		}
+
+		// energy, gradient, and hessian of energy at the same displacement, the null outputs are skipped
+		// the default runs the separate assemblies, the non-linear assemblers share one element loop
+		virtual void assemble_energy_gradient_hessian(
+			const bool is_volume,
+			const int n_basis,
+			const bool project_to_psd,
+			const std::vector<basis::ElementBases> &bases,
+			const std::vector<basis::ElementBases> &gbases,
+			const AssemblyValsCache &cache,
+			const double dt,
+			const Eigen::MatrixXd &displacement,
+			const Eigen::MatrixXd &displacement_prev,
+			utils::SparseMatrixCache &mat_cache,
+			double *energy,
+			Eigen::MatrixXd *rhs,
+			StiffnessMatrix *hessian) const
+		{
+			if (energy)
+				*energy = assemble_energy(is_volume, bases, gbases, cache, dt, displacement, displacement_prev);
+			if (rhs)
+				assemble_gradient(is_volume, n_basis, bases, gbases, cache, dt, displacement, displacement_prev, *rhs);
+			if (hessian)
+				assemble_hessian(is_volume, n_basis, project_to_psd, bases, gbases, cache, dt, displacement, displacement_prev, mat_cache, *hessian);
+		}
+
+		// product of the hessian of energy with v, computed element by element without assembling the hessian
+		virtual void assemble_hessian_vector_product(
+			const bool is_volume,
+			const int n_basis,
+			const bool project_to_psd,
+			const std::vector<basis::ElementBases> &bases,
+			const std::vector<basis::ElementBases> &gbases,
+			const AssemblyValsCache &cache,
+			const double dt,
+			const Eigen::MatrixXd &displacement,
+			const Eigen::MatrixXd &displacement_prev,
+			const Eigen::MatrixXd &v,
+			Eigen::MatrixXd &out) const { log_and_throw_error("Assemble hessian vector product not implemented by {}!", name()); }
+
+		// diagonal of the hessian of energy, computed element by element without assembling the hessian
+		virtual void assemble_hessian_diagonal(
+			const bool is_volume,
+			const int n_basis,
+			const bool project_to_psd,
+			const std::vector<basis::ElementBases> &bases,
+			const std::vector<basis::ElementBases> &gbases,
+			const AssemblyValsCache &cache,
+			const double dt,
+			const Eigen::MatrixXd &displacement,
+			const Eigen::MatrixXd &displacement_prev,
+			Eigen::MatrixXd &diag) const { log_and_throw_error("Assemble hessian diagonal not implemented by {}!", name()); }
+
 		// plotting (eg von mises), assembler is the name of the formulation
 		virtual void compute_scalar_value(
 			const int el_id,
@@ -124,6 +295,10 @@ namespace polyfem::assembler
 			const Eigen::MatrixXd &fun,
 			std::vector<NamedMatrix> &result) const {}
 
+		// names of the values of compute_scalar_value and compute_tensor_value, so that the output computes only the requested ones
+		virtual std::vector<std::string> scalar_value_names() const { return {}; }
+		virtual std::vector<std::string> tensor_value_names() const { return {}; }
+
 		virtual std::map<std::string, ParamFunc> parameters() const = 0;
 		virtual VectorNd compute_rhs(const AutodiffHessianPt &pt) const { log_and_throw_error("Rhs not supported by {}!", name()); }
 
@@ -136,9 +311,90 @@ namespace polyfem::assembler
 		virtual bool is_solution_displacement() const { return false; }
 		virtual bool is_fluid() const { return false; }
 		virtual bool is_tensor() const { return false; }
+		/// true if the energy depends on the previous solution or the time step (e.g., damping),
+		/// the local hessians can only be reused while they do not change
+		virtual bool is_history_dependent() const { return false; }
+		/// true unless the material parameters are known not to change with the time,
+		/// the local hessians can then only be reused within a time step
+		virtual bool has_time_dependent_parameters() const { return true; }
+
+		/// if set, the energies and gradients are summed in the element order, so that they do not depend on the threads
+		void set_deterministic(const bool deterministic) { deterministic_ = deterministic; }
+		bool is_deterministic() const { return deterministic_; }
+
+		/// if set, the projected Newton hessians are made PSD per quadrature point (on d2Psi/dF2) instead of per element,
+		/// for the assemblers supporting it
+		void set_quadrature_psd_projection(const bool val) { quadrature_psd_projection_ = val; }
+		bool is_quadrature_psd_projection() const { return quadrature_psd_projection_; }
+
+		/// total time spent merging the per-thread storages, accumulated over all the assemblies
+		double merge_time() const { return merge_time_; }
 
 	protected:
 		int size_ = -1;
+		mutable double merge_time_ = 0;
+		bool deterministic_ = false;
+		bool quadrature_psd_projection_ = false;
+
+		/// cost model of the element loop named loop, used to balance the threads on heterogeneous meshes
+		/// (polyhedra, p-refined elements). It is initialized with local bases × quadrature points when
+		/// the bases change and then refreshed with the time measured by every run of the loop.
+		/// @param[in] order order in which the loop visits the elements, ignored if not of the size of bases
+		utils::LoopCostModel &element_costs(const std::string &loop, const std::vector<basis::ElementBases> &bases, const std::vector<int> &order = {}, const bool is_mass = false) const;
+
+		/// partition of the elements such that no two elements of the same color share a global node, so the loops
+		/// writing global vectors scatter directly from the threads of a color instead of summing one vector per thread.
+		/// It is computed once for the bases and recomputed when their global nodes change.
+		/// @param[in] n_basis number of global nodes
+		/// @param[in] bases bases of the elements
+		const std::vector<std::vector<int>> &node_colors(const int n_basis, const std::vector<basis::ElementBases> &bases) const;
+
+		struct ConstraintProlongation
+		{
+			/// number of nodes of the local space: the global nodes followed by one node per distinct combination
+			int n_local = 0;
+			/// local node of every basis of every element
+			std::vector<std::vector<int>> local_nodes;
+			/// n_local x n_basis prolongation, identity on the global nodes and the weights of the combinations
+			StiffnessMatrix P;
+
+			bool empty() const { return local_nodes.empty(); }
+		};
+
+		/// the bases of non-conforming meshes (hanging nodes), polygons and splines are weighted combinations of several
+		/// global nodes, scattering the local matrix of two such bases costs the product of their numbers of nodes.
+		/// The matrices are instead assembled on a local space where every distinct combination is a single node and
+		/// prolongated once, K = P^T K_local P. It is empty if every basis is a global node (conforming Lagrange bases)
+		/// and, as node_colors, recomputed when the global nodes change.
+		/// @param[in] n_basis number of global nodes
+		/// @param[in] bases bases of the elements
+		const ConstraintProlongation &constraint_prolongation(const int n_basis, const std::vector<basis::ElementBases> &bases) const;
+
+	private:
+		struct ElementCosts
+		{
+			const basis::ElementBases *bases = nullptr;
+			utils::LoopCostModel costs;
+		};
+		mutable std::map<std::string, ElementCosts> element_costs_;
+
+		struct NodeColors
+		{
+			/// order independent hash of the global nodes of every element
+			uint64_t fingerprint = 0;
+			size_t n_elements = 0;
+			std::vector<std::vector<int>> colors;
+		};
+		mutable NodeColors node_colors_;
+
+		struct CachedProlongation
+		{
+			uint64_t fingerprint = 0;
+			size_t n_elements = 0;
+			int n_basis = 0;
+			ConstraintProlongation prolongation;
+		};
+		mutable CachedProlongation constraint_prolongation_;
 	};
 
 	// assemble matrix based on the local assembler
@@ -158,9 +414,30 @@ namespace polyfem::assembler
 			StiffnessMatrix &stiffness,
 			const bool is_mass = false) const override;
 
+		void assemble(
+			const bool is_volume,
+			const int n_basis,
+			const std::vector<basis::ElementBases> &bases,
+			const std::vector<basis::ElementBases> &gbases,
+			const AssemblyValsCache &cache,
+			utils::BlockSparseMatrix &stiffness,
+			const bool is_mass = false) const override;
+
 		virtual bool is_linear() const override { return true; }
 
 		virtual Eigen::Matrix<double, Eigen::Dynamic, 1, 0, 9, 1> assemble(const LinearAssemblerData &data) const = 0;
+
+		// the local matrix of the affine element el_id is a contraction of the reference integrals (constant coefficients on the element)
+		virtual bool has_affine_assembly(const int el_id) const { return false; }
+		// same as assemble for an affine element, without quadrature
+		virtual Eigen::Matrix<double, Eigen::Dynamic, 1, 0, 9, 1> assemble_affine(const AffineAssemblerData &data) const { log_and_throw_error("Affine assembly not implemented by {}!", name()); }
+
+		// if set (default), the affine elements supported by has_affine_assembly are assembled from the reference integrals
+		void set_affine_assembly(const bool val) { affine_assembly_ = val; }
+		bool is_affine_assembly() const { return affine_assembly_; }
+
+	private:
+		bool affine_assembly_ = true;
 	};
 
 	// non-linear assembler (eg neohookean elasticity)
@@ -179,6 +456,26 @@ namespace polyfem::assembler
 			const Eigen::MatrixXd &displacement,
 			const Eigen::MatrixXd &displacement_prev) const override;
 
+		// element energies are evaluated until the first one that is not finite
+		bool is_energy_finite(
+			const bool is_volume,
+			const std::vector<basis::ElementBases> &bases,
+			const std::vector<basis::ElementBases> &gbases,
+			const AssemblyValsCache &cache,
+			const double dt,
+			const Eigen::MatrixXd &displacement,
+			const Eigen::MatrixXd &displacement_prev) const override;
+
+		// assemble energy at several displacements in a single element loop
+		Eigen::VectorXd assemble_energies(
+			const bool is_volume,
+			const std::vector<basis::ElementBases> &bases,
+			const std::vector<basis::ElementBases> &gbases,
+			const AssemblyValsCache &cache,
+			const double dt,
+			const std::vector<Eigen::MatrixXd> &displacements,
+			const Eigen::MatrixXd &displacement_prev) const override;
+
 		// assemble gradient of energy (rhs)
 		void assemble_gradient(
 			const bool is_volume,
@@ -205,13 +502,141 @@ namespace polyfem::assembler
 			utils::SparseMatrixCache &mat_cache,
 			StiffnessMatrix &grad) const override;
 
+		// hessian of energy, the elements whose nodes moved less than the tolerance of local_cache since their last
+		// evaluation scatter their stored local hessian, the others are evaluated and stored
+		void assemble_hessian_incremental(
+			const bool is_volume,
+			const int n_basis,
+			const bool project_to_psd,
+			const std::vector<basis::ElementBases> &bases,
+			const std::vector<basis::ElementBases> &gbases,
+			const AssemblyValsCache &cache,
+			const double dt,
+			const Eigen::MatrixXd &displacement,
+			const Eigen::MatrixXd &displacement_prev,
+			utils::SparseMatrixCache &mat_cache,
+			LocalHessianCache &local_cache,
+			StiffnessMatrix &grad) const override;
+
+		// energy, gradient, and hessian in a single element loop, the deterministic mode runs the separate loops
+		void assemble_energy_gradient_hessian(
+			const bool is_volume,
+			const int n_basis,
+			const bool project_to_psd,
+			const std::vector<basis::ElementBases> &bases,
+			const std::vector<basis::ElementBases> &gbases,
+			const AssemblyValsCache &cache,
+			const double dt,
+			const Eigen::MatrixXd &displacement,
+			const Eigen::MatrixXd &displacement_prev,
+			utils::SparseMatrixCache &mat_cache,
+			double *energy,
+			Eigen::MatrixXd *rhs,
+			StiffnessMatrix *hessian) const override;
+
+		// product of the hessian of energy with v
+		void assemble_hessian_vector_product(
+			const bool is_volume,
+			const int n_basis,
+			const bool project_to_psd,
+			const std::vector<basis::ElementBases> &bases,
+			const std::vector<basis::ElementBases> &gbases,
+			const AssemblyValsCache &cache,
+			const double dt,
+			const Eigen::MatrixXd &displacement,
+			const Eigen::MatrixXd &displacement_prev,
+			const Eigen::MatrixXd &v,
+			Eigen::MatrixXd &out) const override;
+
+		// diagonal of the hessian of energy
+		void assemble_hessian_diagonal(
+			const bool is_volume,
+			const int n_basis,
+			const bool project_to_psd,
+			const std::vector<basis::ElementBases> &bases,
+			const std::vector<basis::ElementBases> &gbases,
+			const AssemblyValsCache &cache,
+			const double dt,
+			const Eigen::MatrixXd &displacement,
+			const Eigen::MatrixXd &displacement_prev,
+			Eigen::MatrixXd &diag) const override;
+
 		virtual bool is_linear() const override { return false; }
 
+		// order in which the element loops visit the elements (e.g., grouped by material),
+		// empty or of the wrong size for the natural order
+		virtual const std::vector<int> &element_order() const
+		{
+			static const std::vector<int> natural;
+			return natural;
+		}
+
+		// term of the fused element loops, the assemblers of the terms share the bases and the assembly values cache
+		struct FusedTerm
+		{
+			const NLAssembler *assembler;
+			double weight;
+			double dt;
+			const Eigen::MatrixXd *displacement_prev;
+		};
+
+		// energies of several assemblers in a single element loop, the assembly values of an element are computed once
+		// for all the terms, returns the unweighted energy of every term; the deterministic mode runs the separate loops
+		static Eigen::VectorXd assemble_fused_energies(
+			const std::vector<FusedTerm> &terms,
+			const bool is_volume,
+			const std::vector<basis::ElementBases> &bases,
+			const std::vector<basis::ElementBases> &gbases,
+			const AssemblyValsCache &cache,
+			const Eigen::MatrixXd &displacement);
+
+		// weighted sum of the gradients of several assemblers in a single element loop, as above
+		static void assemble_fused_gradient(
+			const std::vector<FusedTerm> &terms,
+			const bool is_volume,
+			const int n_basis,
+			const std::vector<basis::ElementBases> &bases,
+			const std::vector<basis::ElementBases> &gbases,
+			const AssemblyValsCache &cache,
+			const Eigen::MatrixXd &displacement,
+			Eigen::MatrixXd &rhs);
+
 	protected:
 		// energy, gradient, and hessian used in newton method
 		virtual double compute_energy(const NonLinearAssemblerData &data) const = 0;
 		virtual Eigen::VectorXd assemble_gradient(const NonLinearAssemblerData &data) const = 0;
 		virtual Eigen::MatrixXd assemble_hessian(const NonLinearAssemblerData &data) const = 0;
+
+		// same as above into gradient and hessian, which the element loops keep per thread so that their storage is reused
+		// the default copies the returned values, the assemblers on the hot path compute them in place
+		virtual void assemble_gradient(const NonLinearAssemblerData &data, Eigen::VectorXd &gradient) const { gradient = assemble_gradient(data); }
+		virtual void assemble_hessian(const NonLinearAssemblerData &data, Eigen::MatrixXd &hessian) const { hessian = assemble_hessian(data); }
+
+		// local energy, gradient, and hessian of the fused element loop, the null outputs are skipped
+		// the default calls the three functions above, the assemblers override it to share the per quadrature point quantities
+		virtual void compute_energy_gradient_hessian(const NonLinearAssemblerData &data, double *energy, Eigen::VectorXd *gradient, Eigen::MatrixXd *hessian) const;
+
+		// PSD hessian projected per quadrature point, returns false if the assembler does not support it
+		virtual bool assemble_projected_hessian(const NonLinearAssemblerData &data, Eigen::MatrixXd &hessian) const { return false; }
+
+		// local hessian of the element loops, projected to PSD per quadrature point or per element if project_to_psd
+		void assemble_local_hessian(const NonLinearAssemblerData &data, const bool project_to_psd, Eigen::MatrixXd &hessian) const;
+
+	private:
+		// element loop of assemble_hessian and assemble_hessian_incremental, local_cache is null for the former
+		void assemble_global_hessian(
+			const bool is_volume,
+			const int n_basis,
+			const bool project_to_psd,
+			const std::vector<basis::ElementBases> &bases,
+			const std::vector<basis::ElementBases> &gbases,
+			const AssemblyValsCache &cache,
+			const double dt,
+			const Eigen::MatrixXd &displacement,
+			const Eigen::MatrixXd &displacement_prev,
+			utils::SparseMatrixCache &mat_cache,
+			LocalHessianCache *local_cache,
+			StiffnessMatrix &grad) const;
 	};
 
 	class ElasticityAssembler : virtual public Assembler
@@ -258,6 +683,9 @@ namespace polyfem::assembler
 			result.emplace_back("F", F);
 		}
 
+		std::vector<std::string> scalar_value_names() const override { return {"von_mises"}; }
+		std::vector<std::string> tensor_value_names() const override { return {"cauchy_stess", "pk1_stess", "pk2_stess", "F"}; }
+
 		void compute_stress_tensor(const int el_id, const basis::ElementBases &bs, const basis::ElementBases &gbs, const Eigen::MatrixXd &local_pts, const Eigen::MatrixXd &displacement, const ElasticityTensorType &type, Eigen::MatrixXd &stresses) const
 		{
 			assign_stress_tensor(el_id, bs, gbs, local_pts, displacement, size() * size(), type, stresses, [&](const Eigen::MatrixXd &stress) {
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <polyfem/assembler/ElementAssemblyValues.hpp>
+#include <polyfem/assembler/AssemblyValsCache.hpp>
+
+#include <vector>
 
 namespace polyfem::assembler
 {
@@ -45,6 +48,88 @@ namespace polyfem::assembler
 		const QuadratureVector &da;
 	};
 
+	/// integrals of the reference basis functions over the reference element, they are shared by the elements
+	/// with the same reference evaluations (see AssemblyValsCache::ReferenceTable)
+	class ReferenceIntegrals
+	{
+	public:
+		/// integrates the reference values and gradients of vals with its quadrature
+		void init(const ElementAssemblyValues &vals)
+		{
+			table.quadrature = vals.quadrature;
+			const int n = int(vals.basis_values.size());
+			table.val.resize(n);
+			table.grad.resize(n);
+			for (int i = 0; i < n; ++i)
+			{
+				table.val[i] = vals.basis_values[i].val;
+				table.grad[i] = vals.basis_values[i].grad;
+			}
+
+			const auto &w = vals.quadrature.weights;
+			const int dim = vals.quadrature.points.cols();
+			mass.resize(n, n);
+			stiffness.resize(n * n);
+			for (int i = 0; i < n; ++i)
+			{
+				for (int j = 0; j < n; ++j)
+				{
+					mass(i, j) = (table.val[i].array() * table.val[j].array() * w.array()).sum();
+					stiffness[i * n + j] = table.grad[i].leftCols(dim).transpose() * w.asDiagonal() * table.grad[j].leftCols(dim);
+				}
+			}
+		}
+
+		/// the reference evaluations of vals are the integrated ones
+		bool matches(const ElementAssemblyValues &vals) const { return table.matches(vals); }
+
+		/// int phi_i phi_j
+		Eigen::MatrixXd mass;
+		/// int grad phi_i^T grad phi_j (dim x dim) at i * n + j, with the reference gradients as rows
+		std::vector<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, 0, 3, 3>> stiffness;
+
+	private:
+		AssemblyValsCache::ReferenceTable table;
+	};
+
+	/// pair of bases of an affine element, the integrals are the reference ones contracted with the constant jacobian
+	class AffineAssemblerData
+	{
+	public:
+		AffineAssemblerData(
+			const ElementAssemblyValues &vals,
+			const ReferenceIntegrals &integrals,
+			int i, int j)
+			: vals(vals), integrals(integrals), i(i), j(j)
+		{
+		}
+
+		/// int phi_i phi_j over the element
+		double mass() const { return vals.det(0) * integrals.mass(i, j); }
+
+		/// int grad phi_i^T grad phi_j over the element (dim x dim)
+		Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, 0, 3, 3> gradient_outer() const
+		{
+			const auto &jac_it = vals.jac_it.front();
+			return vals.det(0) * (jac_it.transpose() * integrals.stiffness[i * vals.basis_values.size() + j] * jac_it);
+		}
+
+		/// int grad phi_i . grad phi_j over the element
+		double gradient_dot() const
+		{
+			const auto &jac_it = vals.jac_it.front();
+			return vals.det(0) * (jac_it * jac_it.transpose()).cwiseProduct(integrals.stiffness[i * vals.basis_values.size() + j]).sum();
+		}
+
+		/// stores the evaluation for that element
+		const ElementAssemblyValues &vals;
+		const ReferenceIntegrals &integrals;
+		/// first local order
+		const int i;
+		/// second local order
+		const int j;
+	};
+
 	class MixedAssemblerData
 	{
 	public:
@@ -1,6 +1,10 @@
 #include "AssemblyValsCache.hpp"
 
 #include <polyfem/utils/MaybeParallelFor.hpp>
+#include <polyfem/utils/MatrixUtils.hpp>
+#include <polyfem/utils/Logger.hpp>
+
+#include <algorithm>
 
 namespace polyfem
 {
@@ -8,15 +12,323 @@ namespace polyfem
 
 	namespace assembler
 	{
+		namespace
+		{
+			// beyond this number of distinct tables per thread the remaining elements are cached in full
+			constexpr int MAX_REFERENCE_TABLES = 64;
+
+			// states of the entries of the budgeted cache
+			constexpr char EMPTY = 0;
+			constexpr char FILLING = 1;
+			constexpr char READY = 2;
+
+			// the polyhedral bases are sums of kernels and harmonics, much more expensive than the polynomials
+			constexpr double POLYHEDRAL_COST_FACTOR = 8;
+
+			void compute_values(const int el_index, const bool is_volume, const bool is_mass, const ElementBases &basis, const ElementBases &gbasis, ElementAssemblyValues &vals)
+			{
+				if (is_mass)
+				{
+					auto &quadrature = vals.quadrature;
+					basis.compute_mass_quadrature(quadrature);
+					vals.compute(el_index, is_volume, quadrature.points, basis, gbasis);
+				}
+				else
+					vals.compute(el_index, is_volume, basis, gbasis);
+			}
+
+			// bytes of the values of an element and a proxy of the work to compute them, from the quadrature sizes only
+			void estimate_element(const bool is_volume, const bool is_mass, const ElementBases &basis, const ElementBases &gbasis, size_t &bytes, double &cost)
+			{
+				quadrature::Quadrature quadrature;
+				if (is_mass)
+					basis.compute_mass_quadrature(quadrature);
+				else
+					basis.compute_quadrature(quadrature);
+
+				const size_t dim = is_volume ? 3 : 2;
+				const size_t n_pts = quadrature.points.rows();
+				const size_t n_bases = basis.bases.size();
+
+				// val, grad and grad_t_m per basis, then points, weights, mapped points, det and jac_it per point
+				bytes = sizeof(ElementAssemblyValues)
+						+ n_bases * (sizeof(AssemblyValues) + n_pts * (1 + 2 * dim) * sizeof(double))
+						+ n_pts * ((2 * dim + 2) * sizeof(double) + sizeof(Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, 0, 3, 3>));
+
+				cost = double(n_pts) * n_bases * (1 + dim);
+				// non affine elements evaluate the geometric mapping and invert its jacobian at every point
+				if (!gbasis.is_affine || !gbasis.has_parameterization)
+					cost += double(n_pts) * (gbasis.bases.size() * (1 + dim) + dim * dim * dim);
+				if (!gbasis.has_parameterization)
+					cost *= POLYHEDRAL_COST_FACTOR;
+			}
+
+			class LocalThreadCompactStorage
+			{
+			public:
+				ElementAssemblyValues vals;
+				std::vector<AssemblyValsCache::ReferenceTable> tables;
+				std::vector<int> elements;
+				std::vector<std::pair<int, ElementAssemblyValues>> fallbacks;
+			};
+
+			size_t values_memory(const ElementAssemblyValues &vals)
+			{
+				size_t res = sizeof(ElementAssemblyValues);
+				for (const auto &bv : vals.basis_values)
+					res += sizeof(AssemblyValues) + utils::memory_usage(bv.val) + utils::memory_usage(bv.grad) + utils::memory_usage(bv.grad_t_m) + bv.global.capacity() * sizeof(Local2Global);
+				res += vals.jac_it.capacity() * sizeof(vals.jac_it.front());
+				res += utils::memory_usage(vals.quadrature.points) + utils::memory_usage(vals.quadrature.weights);
+				res += utils::memory_usage(vals.val) + utils::memory_usage(vals.det);
+				return res;
+			}
+		} // namespace
+
+		size_t AssemblyValsCache::memory_usage() const
+		{
+			size_t res = 0;
+			for (const auto &vals : cache)
+				res += values_memory(vals);
+
+			for (const auto &vals : float_cache_)
+			{
+				res += sizeof(FloatElementValues) + utils::memory_usage(vals.points) + utils::memory_usage(vals.weights) + utils::memory_usage(vals.mapped) + utils::memory_usage(vals.det);
+				for (const auto &m : vals.val)
+					res += utils::memory_usage(m);
+				for (const auto &m : vals.grad)
+					res += utils::memory_usage(m);
+				for (const auto &m : vals.grad_t_m)
+					res += utils::memory_usage(m);
+				res += vals.jac_it.capacity() * sizeof(vals.jac_it.front());
+			}
+
+			for (const auto &table : reference_tables_)
+			{
+				res += utils::memory_usage(table.quadrature.points) + utils::memory_usage(table.quadrature.weights);
+				for (const auto &m : table.val)
+					res += utils::memory_usage(m);
+				for (const auto &m : table.grad)
+					res += utils::memory_usage(m);
+			}
+			for (const auto &vals : compact_cache_)
+				res += sizeof(CompactElementValues) + vals.jac_it.capacity() * sizeof(vals.jac_it.front()) + utils::memory_usage(vals.val) + utils::memory_usage(vals.det);
+			for (const auto &[e, vals] : fallback_cache_)
+				res += values_memory(vals);
+
+			res += budget_slot_.capacity() * sizeof(int) + budget_cache_.capacity() * sizeof(ElementAssemblyValues);
+			for (size_t i = 0; i < budget_cache_.size(); ++i)
+			{
+				if (budget_state_[i].load(std::memory_order_acquire) == READY)
+					res += values_memory(budget_cache_[i]) - sizeof(ElementAssemblyValues);
+			}
+
+			return res;
+		}
+
+		AssemblyValsCache::Stats AssemblyValsCache::stats() const
+		{
+			Stats res;
+			res.hits = hits_.load();
+			res.misses = misses_.load();
+			res.cached_elements = budget_cache_.size();
+			res.estimated_memory = budget_estimated_memory_;
+			return res;
+		}
+
+		bool AssemblyValsCache::ReferenceTable::matches(const ElementAssemblyValues &vals) const
+		{
+			if (vals.basis_values.size() != val.size())
+				return false;
+			if (vals.quadrature.points.rows() != quadrature.points.rows() || vals.quadrature.points.cols() != quadrature.points.cols())
+				return false;
+			if (vals.quadrature.points != quadrature.points || vals.quadrature.weights != quadrature.weights)
+				return false;
+
+			for (size_t j = 0; j < val.size(); ++j)
+			{
+				if (vals.basis_values[j].val != val[j] || vals.basis_values[j].grad != grad[j])
+					return false;
+			}
+
+			return true;
+		}
+
+		void AssemblyValsCache::FloatElementValues::store(const ElementAssemblyValues &vals)
+		{
+			has_parameterization = vals.has_parameterization;
+			is_affine = vals.is_affine;
+			points = vals.quadrature.points.cast<float>();
+			weights = vals.quadrature.weights.cast<float>();
+			mapped = vals.val.cast<float>();
+
+			const size_t n_jac = is_affine ? std::min<size_t>(1, vals.jac_it.size()) : vals.jac_it.size();
+			jac_it.resize(n_jac);
+			for (size_t k = 0; k < n_jac; ++k)
+				jac_it[k] = vals.jac_it[k].cast<float>();
+			det = is_affine ? Eigen::VectorXf(vals.det.head(std::min<Eigen::Index>(1, vals.det.size())).cast<float>()) : Eigen::VectorXf(vals.det.cast<float>());
+
+			const size_t n_bases = vals.basis_values.size();
+			val.resize(n_bases);
+			grad.resize(n_bases);
+			grad_t_m.resize(n_bases);
+			for (size_t j = 0; j < n_bases; ++j)
+			{
+				val[j] = vals.basis_values[j].val.cast<float>();
+				grad[j] = vals.basis_values[j].grad.cast<float>();
+				grad_t_m[j] = vals.basis_values[j].grad_t_m.cast<float>();
+			}
+		}
+
+		void AssemblyValsCache::FloatElementValues::load(ElementAssemblyValues &vals) const
+		{
+			const int n_pts = points.rows();
+			vals.has_parameterization = has_parameterization;
+			vals.is_affine = is_affine;
+			vals.quadrature.points = points.cast<double>();
+			vals.quadrature.weights = weights.cast<double>();
+			vals.val = mapped.cast<double>();
+
+			if (is_affine && !jac_it.empty())
+				vals.jac_it.assign(n_pts, jac_it.front().cast<double>());
+			else
+			{
+				vals.jac_it.resize(jac_it.size());
+				for (size_t k = 0; k < jac_it.size(); ++k)
+					vals.jac_it[k] = jac_it[k].cast<double>();
+			}
+			if (is_affine && det.size() > 0)
+				vals.det.setConstant(n_pts, det(0));
+			else
+				vals.det = det.cast<double>();
+
+			vals.basis_values.resize(val.size());
+			for (size_t j = 0; j < val.size(); ++j)
+			{
+				AssemblyValues &ass_val = vals.basis_values[j];
+				ass_val.val = val[j].cast<double>();
+				ass_val.grad = grad[j].cast<double>();
+				ass_val.grad_t_m = grad_t_m[j].cast<double>();
+			}
+		}
+
+		size_t AssemblyValsCache::n_elements() const
+		{
+			return std::max({cache.size(), float_cache_.size(), compact_cache_.size(), budget_slot_.size()});
+		}
+
+		void AssemblyValsCache::init_shared(const std::vector<ElementBases> &bases)
+		{
+			from_shared_.clear();
+			if (shared_ == nullptr || shared_ == this || shared_->n_elements() != bases.size())
+				return;
+
+			from_shared_.assign(bases.size(), 0);
+			utils::maybe_parallel_for(bases.size(), [&](int start, int end, int thread_id) {
+				quadrature::Quadrature quadrature, shared_quadrature;
+				for (int e = start; e < end; ++e)
+				{
+					if (shared_->is_from_shared(e))
+						continue;
+
+					if (is_mass_)
+						bases[e].compute_mass_quadrature(quadrature);
+					else
+						bases[e].compute_quadrature(quadrature);
+					if (shared_->is_mass_)
+						bases[e].compute_mass_quadrature(shared_quadrature);
+					else
+						bases[e].compute_quadrature(shared_quadrature);
+
+					from_shared_[e] = quadrature.points.rows() == shared_quadrature.points.rows()
+									  && quadrature.points.cols() == shared_quadrature.points.cols()
+									  && quadrature.points == shared_quadrature.points
+									  && quadrature.weights == shared_quadrature.weights;
+				}
+			});
+
+			logger().debug("Assembly cache: {}/{} elements read from the {} cache", n_shared(), bases.size(), shared_->is_mass_ ? "mass" : "stiffness");
+		}
+
 		void AssemblyValsCache::init(const bool is_volume, const std::vector<ElementBases> &bases, const std::vector<ElementBases> &gbases, const bool is_mass)
 		{
 			is_mass_ = is_mass;
+			init_shared(bases);
+
+			if (compact_)
+			{
+				init_compact(is_volume, bases, gbases);
+				return;
+			}
+
+			if (memory_budget_ > 0 && !single_precision_)
+			{
+				init_budgeted(is_volume, bases, gbases);
+				return;
+			}
+
+			const int n_bases = bases.size();
+			if (single_precision_)
+				float_cache_.resize(n_bases);
+			else
+				cache.resize(n_bases);
+
+			utils::maybe_parallel_for(n_bases, [&](int start, int end, int thread_id) {
+				ElementAssemblyValues tmp;
+				for (int e = start; e < end; ++e)
+				{
+					if (is_from_shared(e))
+						continue;
+
+					ElementAssemblyValues &vals = single_precision_ ? tmp : cache[e];
+					if (is_mass_)
+					{
+						auto &quadrature = vals.quadrature;
+						bases[e].compute_mass_quadrature(quadrature);
+						vals.compute(e, is_volume, quadrature.points, bases[e], gbases[e]);
+					}
+					else
+						vals.compute(e, is_volume, bases[e], gbases[e]);
+
+					if (single_precision_)
+						float_cache_[e].store(vals);
+					else
+						vals.release_globals();
+				}
+			});
+		}
+
+		void AssemblyValsCache::update(const bool is_volume, const std::vector<ElementBases> &bases, const std::vector<ElementBases> &gbases, const std::vector<int> &previous, const bool is_mass)
+		{
+			// the compact tables are shared between elements and cheap to rebuild, the single precision entries are rebuilt too
+			if (compact_ || single_precision_ || cache.empty() || is_mass != is_mass_)
+			{
+				clear();
+				init(is_volume, bases, gbases, is_mass);
+				return;
+			}
+			init_shared(bases);
+
+			assert(previous.size() == bases.size());
+			std::vector<ElementAssemblyValues> old_cache;
+			std::swap(old_cache, cache);
+
 			const int n_bases = bases.size();
 			cache.resize(n_bases);
 
 			utils::maybe_parallel_for(n_bases, [&](int start, int end, int thread_id) {
 				for (int e = start; e < end; ++e)
 				{
+					if (is_from_shared(e))
+						continue;
+
+					const int prev = previous[e];
+					if (prev >= 0 && prev < old_cache.size() && old_cache[prev].basis_values.size() == bases[e].bases.size())
+					{
+						cache[e] = std::move(old_cache[prev]);
+						cache[e].element_id = e;
+						continue;
+					}
+
 					if (is_mass_)
 					{
 						auto &quadrature = cache[e].quadrature;
@@ -25,25 +337,266 @@ namespace polyfem
 					}
 					else
 						cache[e].compute(e, is_volume, bases[e], gbases[e]);
+					cache[e].release_globals();
 				}
 			});
 		}
 
+		void AssemblyValsCache::init_compact(const bool is_volume, const std::vector<ElementBases> &bases, const std::vector<ElementBases> &gbases)
+		{
+			const int n_bases = bases.size();
+			compact_cache_.resize(n_bases);
+
+			auto storage = utils::create_thread_storage(LocalThreadCompactStorage());
+
+			utils::maybe_parallel_for(n_bases, [&](int start, int end, int thread_id) {
+				LocalThreadCompactStorage &local_storage = utils::get_local_thread_storage(storage, thread_id);
+				ElementAssemblyValues &vals = local_storage.vals;
+
+				for (int e = start; e < end; ++e)
+				{
+					CompactElementValues &entry = compact_cache_[e];
+					entry.table = -1;
+					if (is_from_shared(e))
+						continue;
+
+					if (is_mass_)
+					{
+						auto &quadrature = vals.quadrature;
+						bases[e].compute_mass_quadrature(quadrature);
+						vals.compute(e, is_volume, quadrature.points, bases[e], gbases[e]);
+					}
+					else
+						vals.compute(e, is_volume, bases[e], gbases[e]);
+
+					if (vals.has_parameterization)
+					{
+						for (int t = 0; t < local_storage.tables.size(); ++t)
+						{
+							if (local_storage.tables[t].matches(vals))
+							{
+								entry.table = t;
+								break;
+							}
+						}
+
+						if (entry.table < 0 && local_storage.tables.size() < MAX_REFERENCE_TABLES)
+						{
+							ReferenceTable table;
+							table.quadrature = vals.quadrature;
+							for (const AssemblyValues &v : vals.basis_values)
+							{
+								table.val.push_back(v.val);
+								table.grad.push_back(v.grad);
+							}
+							entry.table = local_storage.tables.size();
+							local_storage.tables.push_back(std::move(table));
+						}
+					}
+
+					if (entry.table < 0)
+					{
+						local_storage.fallbacks.emplace_back(e, vals);
+						continue;
+					}
+
+					entry.is_affine = vals.is_affine;
+					if (entry.is_affine)
+					{
+						entry.jac_it.assign(1, vals.jac_it.front());
+						entry.det = vals.det.head<1>();
+					}
+					else
+					{
+						entry.jac_it = vals.jac_it;
+						entry.det = vals.det;
+					}
+					entry.val = vals.val;
+					local_storage.elements.push_back(e);
+				}
+			});
+
+			// Serially merge the thread local tables, the per element indices become global
+			reference_tables_.clear();
+			fallback_cache_.clear();
+			for (LocalThreadCompactStorage &local_storage : storage)
+			{
+				std::vector<int> global_index(local_storage.tables.size(), -1);
+				for (int t = 0; t < local_storage.tables.size(); ++t)
+				{
+					const ReferenceTable &table = local_storage.tables[t];
+					for (int g = 0; g < reference_tables_.size(); ++g)
+					{
+						const ReferenceTable &other = reference_tables_[g];
+						if (other.val.size() == table.val.size()
+							&& other.quadrature.points.rows() == table.quadrature.points.rows()
+							&& other.quadrature.points.cols() == table.quadrature.points.cols()
+							&& other.quadrature.points == table.quadrature.points
+							&& other.quadrature.weights == table.quadrature.weights
+							&& other.val == table.val && other.grad == table.grad)
+						{
+							global_index[t] = g;
+							break;
+						}
+					}
+
+					if (global_index[t] < 0)
+					{
+						global_index[t] = reference_tables_.size();
+						reference_tables_.push_back(std::move(local_storage.tables[t]));
+					}
+				}
+
+				for (const int e : local_storage.elements)
+					compact_cache_[e].table = global_index[compact_cache_[e].table];
+
+				for (auto &fallback : local_storage.fallbacks)
+					fallback_cache_.emplace(fallback.first, std::move(fallback.second));
+			}
+
+			logger().debug("Compact assembly cache: {} reference tables, {} elements cached in full", reference_tables_.size(), fallback_cache_.size());
+		}
+
+		void AssemblyValsCache::init_budgeted(const bool is_volume, const std::vector<ElementBases> &bases, const std::vector<ElementBases> &gbases)
+		{
+			const int n_bases = bases.size();
+			std::vector<size_t> bytes(n_bases);
+			std::vector<double> cost(n_bases);
+
+			utils::maybe_parallel_for(n_bases, [&](int start, int end, int thread_id) {
+				for (int e = start; e < end; ++e)
+					estimate_element(is_volume, is_mass_, bases[e], gbases[e], bytes[e], cost[e]);
+			});
+
+			// greedy selection by recompute work saved per byte, the largest work first on ties
+			std::vector<int> order(n_bases);
+			for (int e = 0; e < n_bases; ++e)
+				order[e] = e;
+			std::stable_sort(order.begin(), order.end(), [&](const int a, const int b) {
+				const double ra = cost[a] / bytes[a];
+				const double rb = cost[b] / bytes[b];
+				if (ra != rb)
+					return ra > rb;
+				return cost[a] > cost[b];
+			});
+
+			budget_slot_.assign(n_bases, -1);
+			budget_estimated_memory_ = 0;
+			int n_cached = 0;
+			for (const int e : order)
+			{
+				if (is_from_shared(e) || budget_estimated_memory_ + bytes[e] > memory_budget_)
+					continue;
+				budget_estimated_memory_ += bytes[e];
+				budget_slot_[e] = n_cached++;
+			}
+
+			budget_cache_.clear();
+			budget_cache_.resize(n_cached);
+			budget_state_ = std::make_unique<std::atomic<char>[]>(n_cached);
+			for (int i = 0; i < n_cached; ++i)
+				budget_state_[i].store(EMPTY);
+			hits_ = 0;
+			misses_ = 0;
+
+			logger().debug("Budgeted assembly cache: {} of {} elements cached on demand, {} estimated bytes of {}", n_cached, n_bases, budget_estimated_memory_, memory_budget_);
+		}
+
 		void AssemblyValsCache::compute(const int el_index, const bool is_volume, const ElementBases &basis, const ElementBases &gbasis, ElementAssemblyValues &vals) const
 		{
-			if (cache.empty())
+			if (is_from_shared(el_index))
+			{
+				shared_->compute(el_index, is_volume, basis, gbasis, vals);
+				return;
+			}
+
+			if (compact_ && !compact_cache_.empty())
 			{
-				if (is_mass_)
+				const CompactElementValues &entry = compact_cache_[el_index];
+				if (entry.table < 0)
 				{
-					auto &quadrature = vals.quadrature;
-					basis.compute_mass_quadrature(quadrature);
-					vals.compute(el_index, is_volume, quadrature.points, basis, gbasis);
+					vals = fallback_cache_.at(el_index);
+					return;
+				}
+
+				const ReferenceTable &table = reference_tables_[entry.table];
+				const int n_pts = table.quadrature.points.rows();
+				vals.element_id = el_index;
+				vals.has_parameterization = true;
+				vals.is_affine = entry.is_affine;
+				vals.quadrature = table.quadrature;
+				vals.val = entry.val;
+				if (entry.is_affine)
+				{
+					vals.jac_it.assign(n_pts, entry.jac_it.front());
+					vals.det.setConstant(n_pts, entry.det(0));
 				}
 				else
-					vals.compute(el_index, is_volume, basis, gbasis);
+				{
+					vals.jac_it = entry.jac_it;
+					vals.det = entry.det;
+				}
+
+				assert(table.val.size() == basis.bases.size());
+				vals.basis_values.resize(table.val.size());
+				for (size_t j = 0; j < table.val.size(); ++j)
+				{
+					AssemblyValues &ass_val = vals.basis_values[j];
+					ass_val.global = basis.bases[j].global();
+					ass_val.val = table.val[j];
+					ass_val.grad = table.grad[j];
+					if (entry.is_affine)
+						ass_val.grad_t_m.noalias() = ass_val.grad * entry.jac_it.front();
+					else
+					{
+						ass_val.finalize();
+						for (long k = 0; k < ass_val.grad.rows(); ++k)
+							ass_val.grad_t_m.row(k).noalias() = ass_val.grad.row(k) * entry.jac_it[k];
+					}
+				}
+			}
+			else if (!float_cache_.empty())
+			{
+				float_cache_[el_index].load(vals);
+				vals.element_id = el_index;
+				assert(vals.basis_values.size() == basis.bases.size());
+				for (size_t j = 0; j < vals.basis_values.size(); ++j)
+					vals.basis_values[j].global = basis.bases[j].global();
 			}
+			else if (!budget_slot_.empty())
+			{
+				const int slot = budget_slot_[el_index];
+				if (slot >= 0 && budget_state_[slot].load(std::memory_order_acquire) == READY)
+				{
+					hits_.fetch_add(1, std::memory_order_relaxed);
+					vals = budget_cache_[slot];
+					assert(vals.basis_values.size() == basis.bases.size());
+					for (size_t j = 0; j < vals.basis_values.size(); ++j)
+						vals.basis_values[j].global = basis.bases[j].global();
+					return;
+				}
+
+				misses_.fetch_add(1, std::memory_order_relaxed);
+				compute_values(el_index, is_volume, is_mass_, basis, gbasis, vals);
+
+				// the first thread computing the element stores it, the others do not wait for it
+				char expected = EMPTY;
+				if (slot >= 0 && budget_state_[slot].compare_exchange_strong(expected, FILLING, std::memory_order_acq_rel))
+				{
+					budget_cache_[slot] = vals;
+					budget_cache_[slot].release_globals();
+					budget_state_[slot].store(READY, std::memory_order_release);
+				}
+			}
+			else if (cache.empty())
+				compute_values(el_index, is_volume, is_mass_, basis, gbasis, vals);
 			else
+			{
 				vals = cache[el_index];
+				assert(vals.basis_values.size() == basis.bases.size());
+				for (size_t j = 0; j < vals.basis_values.size(); ++j)
+					vals.basis_values[j].global = basis.bases[j].global();
+			}
 		}
 	} // namespace assembler
 
@@ -2,6 +2,11 @@
 
 #include <polyfem/assembler/ElementAssemblyValues.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+
 namespace polyfem
 {
 	namespace assembler
@@ -12,16 +17,134 @@ namespace polyfem
 			void init(const bool is_volume, const std::vector<basis::ElementBases> &bases, const std::vector<basis::ElementBases> &gbases, const bool is_mass = false);
 			void compute(const int el_index, const bool is_volume, const basis::ElementBases &basis, const basis::ElementBases &gbasis, ElementAssemblyValues &vals) const;
 
+			// rebuilds the cache after the bases changed, previous[e] is the element of the old bases whose values are still valid for e (-1 otherwise, each old element is used at most once)
+			// the reused entries only get their global indices updated, the others are recomputed
+			void update(const bool is_volume, const std::vector<basis::ElementBases> &bases, const std::vector<basis::ElementBases> &gbases, const std::vector<int> &previous, const bool is_mass = false);
+
 			void clear()
 			{
 				cache.clear();
+				reference_tables_.clear();
+				compact_cache_.clear();
+				fallback_cache_.clear();
+				float_cache_.clear();
+				budget_slot_.clear();
+				budget_cache_.clear();
+				budget_state_.reset();
+				from_shared_.clear();
 			}
 
 			inline bool is_mass() const { return is_mass_; }
 
+			// the elements whose quadrature is the one of other (e.g., the mass and stiffness quadratures of Q_k elements)
+			// read their values from other instead of keeping a copy, other must be built on the same bases, be initialized
+			// before this cache and outlive it
+			void set_shared(const AssemblyValsCache *other) { shared_ = other; }
+			// number of elements read from the shared cache
+			int n_shared() const { return std::count(from_shared_.begin(), from_shared_.end(), char(1)); }
+
+			// size in bytes of the cached values
+			size_t memory_usage() const;
+
+			// in compact mode elements sharing the same reference basis evaluations keep a single table,
+			// per element only the geometric mapping is stored and physical gradients are recomputed in compute
+			void set_compact(const bool val) { compact_ = val; }
+			inline bool is_compact() const { return compact_; }
+
+			// in single precision mode the full (non compact) cache stores the values as floats, they are converted back in compute
+			void set_single_precision(const bool val) { single_precision_ = val; }
+			inline bool is_single_precision() const { return single_precision_; }
+
+			// with a memory budget in bytes (0 for none) the full double precision cache keeps only the elements that are the most
+			// expensive to recompute per stored byte (polyhedra, then curved, then high order elements) until the budget is used,
+			// their values are stored at their first compute, the others are recomputed every time
+			void set_memory_budget(const size_t bytes) { memory_budget_ = bytes; }
+			inline size_t memory_budget() const { return memory_budget_; }
+
+			// usage of the budgeted cache since its init, a miss is a compute of the values
+			struct Stats
+			{
+				size_t hits = 0;
+				size_t misses = 0;
+				int cached_elements = 0; ///< elements selected for the cache
+				size_t estimated_memory = 0; ///< estimated bytes of the selected elements
+
+				double hit_rate() const { return hits + misses > 0 ? double(hits) / double(hits + misses) : 0; }
+			};
+			Stats stats() const;
+
+			// reference basis evaluations at the quadrature points shared by several elements
+			struct ReferenceTable
+			{
+				quadrature::Quadrature quadrature;
+				std::vector<Eigen::MatrixXd> val;
+				std::vector<Eigen::MatrixXd> grad;
+
+				bool matches(const ElementAssemblyValues &vals) const;
+			};
+
+			// per element geometric mapping, table < 0 means the element is in fallback_cache_
+			// affine elements keep a single jac_it and det
+			struct CompactElementValues
+			{
+				int table = -1;
+				bool is_affine = false;
+				std::vector<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, 0, 3, 3>> jac_it;
+				Eigen::MatrixXd val;
+				Eigen::VectorXd det;
+			};
+
+			// single precision values of an element, affine elements keep a single jac_it and det
+			struct FloatElementValues
+			{
+				bool has_parameterization = true;
+				bool is_affine = false;
+				Eigen::MatrixXf points;
+				Eigen::VectorXf weights;
+				std::vector<Eigen::MatrixXf> val;
+				std::vector<Eigen::MatrixXf> grad;
+				std::vector<Eigen::MatrixXf> grad_t_m;
+				std::vector<Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, 0, 3, 3>> jac_it;
+				Eigen::MatrixXf mapped;
+				Eigen::VectorXf det;
+
+				void store(const ElementAssemblyValues &vals);
+				// the global mappings are not stored, they are set by the caller
+				void load(ElementAssemblyValues &vals) const;
+			};
+
 		private:
+			void init_compact(const bool is_volume, const std::vector<basis::ElementBases> &bases, const std::vector<basis::ElementBases> &gbases);
+			void init_budgeted(const bool is_volume, const std::vector<basis::ElementBases> &bases, const std::vector<basis::ElementBases> &gbases);
+			// flags the elements with the same quadrature in shared_
+			void init_shared(const std::vector<basis::ElementBases> &bases);
+			bool is_from_shared(const int e) const { return !from_shared_.empty() && from_shared_[e]; }
+			// number of elements of the initialized cache, 0 if it is empty
+			size_t n_elements() const;
+
+			// the cached entries do not keep the global mappings, compute copies them from the bases
 			std::vector<ElementAssemblyValues> cache;
 			bool is_mass_;
+
+			bool single_precision_ = false;
+			std::vector<FloatElementValues> float_cache_;
+
+			bool compact_ = false;
+			std::vector<ReferenceTable> reference_tables_;
+			std::vector<CompactElementValues> compact_cache_;
+			std::unordered_map<int, ElementAssemblyValues> fallback_cache_; ///< elements without a shared table (e.g., polygons)
+
+			size_t memory_budget_ = 0;
+			size_t budget_estimated_memory_ = 0;
+			std::vector<int> budget_slot_; ///< slot of every element in budget_cache_, -1 if it is recomputed
+			// filled at the first compute of the element, budget_state_ is EMPTY, FILLING or READY
+			mutable std::vector<ElementAssemblyValues> budget_cache_;
+			std::unique_ptr<std::atomic<char>[]> budget_state_;
+			mutable std::atomic<size_t> hits_{0};
+			mutable std::atomic<size_t> misses_{0};
+
+			const AssemblyValsCache *shared_ = nullptr;
+			std::vector<char> from_shared_; ///< 1 if the element is read from shared_
 		};
 	} // namespace assembler
 } // namespace polyfem
@@ -47,6 +47,12 @@ namespace polyfem::assembler
 		Eigen::Matrix<double, Eigen::Dynamic, 1, 0, 9, 1>
 		assemble(const LinearAssemblerData &data) const override;
 
+		bool has_affine_assembly(const int el_id) const override { return true; }
+		Eigen::Matrix<double, Eigen::Dynamic, 1, 0, 9, 1> assemble_affine(const AffineAssemblerData &data) const override
+		{
+			return Eigen::Matrix<double, 1, 1>::Constant(data.mass());
+		}
+
 		std::string name() const override { return "BiLaplacianAux"; }
 		std::map<std::string, ParamFunc> parameters() const override { return std::map<std::string, ParamFunc>(); }
 	};
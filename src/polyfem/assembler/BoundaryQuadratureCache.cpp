@@ -0,0 +1,54 @@
+#include "BoundaryQuadratureCache.hpp"
+
+#include <polyfem/utils/BoundarySampler.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
+
+namespace polyfem
+{
+	using namespace mesh;
+
+	namespace assembler
+	{
+		void BoundaryQuadratureCache::append_signature(const std::vector<LocalBoundary> &local_boundary, std::vector<int> &signature)
+		{
+			signature.push_back(local_boundary.size());
+			for (const auto &lb : local_boundary)
+			{
+				signature.push_back(lb.element_id());
+				signature.push_back(lb.size());
+				for (int i = 0; i < lb.size(); ++i)
+					signature.push_back(lb.global_primitive_id(i));
+			}
+		}
+
+		const std::vector<BoundaryQuadratureCache::Entry> &BoundaryQuadratureCache::get(
+			const std::vector<LocalBoundary> &local_boundary, const int resolution, const Mesh &mesh,
+			const std::vector<basis::ElementBases> &bases, const std::vector<basis::ElementBases> &gbases)
+		{
+			std::vector<int> signature = {resolution};
+			append_signature(local_boundary, signature);
+
+			if (signature == signature_)
+				return entries_;
+
+			signature_ = std::move(signature);
+			entries_.clear();
+			entries_.resize(local_boundary.size());
+
+			utils::maybe_parallel_for(local_boundary.size(), [&](int start, int end, int thread_id) {
+				for (int k = start; k < end; ++k)
+				{
+					const LocalBoundary &lb = local_boundary[k];
+					const int e = lb.element_id();
+					Entry &entry = entries_[k];
+
+					entry.has_samples = utils::BoundarySampler::boundary_quadrature(lb, resolution, mesh, false, entry.uv, entry.points, entry.normals, entry.weights, entry.global_primitive_ids);
+					if (entry.has_samples)
+						entry.vals.compute(e, mesh.is_volume(), entry.points, bases[e], gbases[e]);
+				}
+			});
+
+			return entries_;
+		}
+	} // namespace assembler
+} // namespace polyfem
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <polyfem/assembler/ElementAssemblyValues.hpp>
+#include <polyfem/basis/ElementBases.hpp>
+#include <polyfem/mesh/LocalBoundary.hpp>
+#include <polyfem/mesh/Mesh.hpp>
+
+#include <vector>
+
+namespace polyfem
+{
+	namespace assembler
+	{
+		// boundary counterpart of AssemblyValsCache: per local boundary quadrature, mapped points,
+		// reference normals and basis values, computed once per boundary configuration and resolution
+		class BoundaryQuadratureCache
+		{
+		public:
+			struct Entry
+			{
+				bool has_samples = false;
+				Eigen::MatrixXd uv;
+				Eigen::MatrixXd points;
+				// normals of the reference element, they still need to be mapped by the jacobian (and the displacement)
+				Eigen::MatrixXd normals;
+				Eigen::VectorXd weights;
+				Eigen::VectorXi global_primitive_ids;
+				// values at the quadrature points, vals.val are the mapped points
+				ElementAssemblyValues vals;
+			};
+
+			// entries of local_boundary, they are recomputed only if the boundary or the resolution changed
+			const std::vector<Entry> &get(const std::vector<mesh::LocalBoundary> &local_boundary, const int resolution, const mesh::Mesh &mesh,
+										  const std::vector<basis::ElementBases> &bases, const std::vector<basis::ElementBases> &gbases);
+
+			void clear()
+			{
+				signature_.clear();
+				entries_.clear();
+			}
+
+			// appends the elements and primitives of local_boundary to signature, to detect boundary changes
+			static void append_signature(const std::vector<mesh::LocalBoundary> &local_boundary, std::vector<int> &signature);
+
+		private:
+			std::vector<int> signature_;
+			std::vector<Entry> entries_;
+		};
+	} // namespace assembler
+} // namespace polyfem
@@ -5,6 +5,8 @@
 
 #define POLYFEM_DECLARE_VIRTUAL_ELASTIC_ENERGY                                                                                                                                                                                                                                                                                                                                                                           \
 	virtual double elastic_energy(const RowVectorNd &p, const int el_id, const DefGradMatrix<double> &def_grad) const = 0;                                                                                                                                                                                                                                                                                               \
+	virtual DScalar1<double, Eigen::Matrix<double, 4, 1>> elastic_energy(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar1<double, Eigen::Matrix<double, 4, 1>>> &def_grad) const = 0;                                                                                                                                                                                                                 \
+	virtual DScalar1<double, Eigen::Matrix<double, 9, 1>> elastic_energy(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar1<double, Eigen::Matrix<double, 9, 1>>> &def_grad) const = 0;                                                                                                                                                                                                                 \
 	virtual DScalar1<double, Eigen::Matrix<double, 6, 1>> elastic_energy(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar1<double, Eigen::Matrix<double, 6, 1>>> &def_grad) const = 0;                                                                                                                                                                                                                 \
 	virtual DScalar1<double, Eigen::Matrix<double, 8, 1>> elastic_energy(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar1<double, Eigen::Matrix<double, 8, 1>>> &def_grad) const = 0;                                                                                                                                                                                                                 \
 	virtual DScalar1<double, Eigen::Matrix<double, 12, 1>> elastic_energy(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar1<double, Eigen::Matrix<double, 12, 1>>> &def_grad) const = 0;                                                                                                                                                                                                               \
@@ -17,6 +19,8 @@
 	virtual DScalar1<double, Eigen::Matrix<double, Eigen::Dynamic, 1, 0, SMALL_N, 1>> elastic_energy(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar1<double, Eigen::Matrix<double, Eigen::Dynamic, 1, 0, SMALL_N, 1>>> &def_grad) const = 0;                                                                                                                                                         \
 	virtual DScalar1<double, Eigen::Matrix<double, Eigen::Dynamic, 1, 0, BIG_N, 1>> elastic_energy(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar1<double, Eigen::Matrix<double, Eigen::Dynamic, 1, 0, BIG_N, 1>>> &def_grad) const = 0;                                                                                                                                                             \
 	virtual DScalar1<double, Eigen::VectorXd> elastic_energy(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar1<double, Eigen::VectorXd>> &def_grad) const = 0;                                                                                                                                                                                                                                         \
+	virtual DScalar2<double, Eigen::Matrix<double, 4, 1>, Eigen::Matrix<double, 4, 4>> elastic_energy(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar2<double, Eigen::Matrix<double, 4, 1>, Eigen::Matrix<double, 4, 4>>> &def_grad) const = 0;                                                                                                                                                       \
+	virtual DScalar2<double, Eigen::Matrix<double, 9, 1>, Eigen::Matrix<double, 9, 9>> elastic_energy(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar2<double, Eigen::Matrix<double, 9, 1>, Eigen::Matrix<double, 9, 9>>> &def_grad) const = 0;                                                                                                                                                       \
 	virtual DScalar2<double, Eigen::Matrix<double, 6, 1>, Eigen::Matrix<double, 6, 6>> elastic_energy(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar2<double, Eigen::Matrix<double, 6, 1>, Eigen::Matrix<double, 6, 6>>> &def_grad) const = 0;                                                                                                                                                       \
 	virtual DScalar2<double, Eigen::Matrix<double, 8, 1>, Eigen::Matrix<double, 8, 8>> elastic_energy(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar2<double, Eigen::Matrix<double, 8, 1>, Eigen::Matrix<double, 8, 8>>> &def_grad) const = 0;                                                                                                                                                       \
 	virtual DScalar2<double, Eigen::Matrix<double, 12, 1>, Eigen::Matrix<double, 12, 12>> elastic_energy(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar2<double, Eigen::Matrix<double, 12, 1>, Eigen::Matrix<double, 12, 12>>> &def_grad) const = 0;                                                                                                                                                 \
@@ -30,6 +34,8 @@
 
 #define POLYFEM_OVERRIDE_ELASTIC_ENERGY                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                      \
 	double elastic_energy(const RowVectorNd &p, const int el_id, const DefGradMatrix<double> &def_grad) const override { return elastic_energy_T<double>(p, el_id, def_grad); }                                                                                                                                                                                                                                                                                                                                                                                                                                              \
+	DScalar1<double, Eigen::Matrix<double, 4, 1>> elastic_energy(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar1<double, Eigen::Matrix<double, 4, 1>>> &def_grad) const override { return elastic_energy_T<DScalar1<double, Eigen::Matrix<double, 4, 1>>>(p, el_id, def_grad); }                                                                                                                                                                                                                                                                                                                         \
+	DScalar1<double, Eigen::Matrix<double, 9, 1>> elastic_energy(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar1<double, Eigen::Matrix<double, 9, 1>>> &def_grad) const override { return elastic_energy_T<DScalar1<double, Eigen::Matrix<double, 9, 1>>>(p, el_id, def_grad); }                                                                                                                                                                                                                                                                                                                         \
 	DScalar1<double, Eigen::Matrix<double, 6, 1>> elastic_energy(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar1<double, Eigen::Matrix<double, 6, 1>>> &def_grad) const override { return elastic_energy_T<DScalar1<double, Eigen::Matrix<double, 6, 1>>>(p, el_id, def_grad); }                                                                                                                                                                                                                                                                                                                         \
 	DScalar1<double, Eigen::Matrix<double, 8, 1>> elastic_energy(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar1<double, Eigen::Matrix<double, 8, 1>>> &def_grad) const override { return elastic_energy_T<DScalar1<double, Eigen::Matrix<double, 8, 1>>>(p, el_id, def_grad); }                                                                                                                                                                                                                                                                                                                         \
 	DScalar1<double, Eigen::Matrix<double, 12, 1>> elastic_energy(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar1<double, Eigen::Matrix<double, 12, 1>>> &def_grad) const override { return elastic_energy_T<DScalar1<double, Eigen::Matrix<double, 12, 1>>>(p, el_id, def_grad); }                                                                                                                                                                                                                                                                                                                      \
@@ -42,6 +48,8 @@
 	DScalar1<double, Eigen::Matrix<double, Eigen::Dynamic, 1, 0, SMALL_N, 1>> elastic_energy(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar1<double, Eigen::Matrix<double, Eigen::Dynamic, 1, 0, SMALL_N, 1>>> &def_grad) const override { return elastic_energy_T<DScalar1<double, Eigen::Matrix<double, Eigen::Dynamic, 1, 0, SMALL_N, 1>>>(p, el_id, def_grad); }                                                                                                                                                                                                                                     \
 	DScalar1<double, Eigen::Matrix<double, Eigen::Dynamic, 1, 0, BIG_N, 1>> elastic_energy(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar1<double, Eigen::Matrix<double, Eigen::Dynamic, 1, 0, BIG_N, 1>>> &def_grad) const override { return elastic_energy_T<DScalar1<double, Eigen::Matrix<double, Eigen::Dynamic, 1, 0, BIG_N, 1>>>(p, el_id, def_grad); }                                                                                                                                                                                                                                           \
 	DScalar1<double, Eigen::VectorXd> elastic_energy(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar1<double, Eigen::VectorXd>> &def_grad) const override { return elastic_energy_T<DScalar1<double, Eigen::VectorXd>>(p, el_id, def_grad); }                                                                                                                                                                                                                                                                                                                                                             \
+	DScalar2<double, Eigen::Matrix<double, 4, 1>, Eigen::Matrix<double, 4, 4>> elastic_energy(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar2<double, Eigen::Matrix<double, 4, 1>, Eigen::Matrix<double, 4, 4>>> &def_grad) const override { return elastic_energy_T<DScalar2<double, Eigen::Matrix<double, 4, 1>, Eigen::Matrix<double, 4, 4>>>(p, el_id, def_grad); }                                                                                                                                                                                                                                  \
+	DScalar2<double, Eigen::Matrix<double, 9, 1>, Eigen::Matrix<double, 9, 9>> elastic_energy(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar2<double, Eigen::Matrix<double, 9, 1>, Eigen::Matrix<double, 9, 9>>> &def_grad) const override { return elastic_energy_T<DScalar2<double, Eigen::Matrix<double, 9, 1>, Eigen::Matrix<double, 9, 9>>>(p, el_id, def_grad); }                                                                                                                                                                                                                                  \
 	DScalar2<double, Eigen::Matrix<double, 6, 1>, Eigen::Matrix<double, 6, 6>> elastic_energy(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar2<double, Eigen::Matrix<double, 6, 1>, Eigen::Matrix<double, 6, 6>>> &def_grad) const override { return elastic_energy_T<DScalar2<double, Eigen::Matrix<double, 6, 1>, Eigen::Matrix<double, 6, 6>>>(p, el_id, def_grad); }                                                                                                                                                                                                                                  \
 	DScalar2<double, Eigen::Matrix<double, 8, 1>, Eigen::Matrix<double, 8, 8>> elastic_energy(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar2<double, Eigen::Matrix<double, 8, 1>, Eigen::Matrix<double, 8, 8>>> &def_grad) const override { return elastic_energy_T<DScalar2<double, Eigen::Matrix<double, 8, 1>, Eigen::Matrix<double, 8, 8>>>(p, el_id, def_grad); }                                                                                                                                                                                                                                  \
 	DScalar2<double, Eigen::Matrix<double, 12, 1>, Eigen::Matrix<double, 12, 12>> elastic_energy(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar2<double, Eigen::Matrix<double, 12, 1>, Eigen::Matrix<double, 12, 12>>> &def_grad) const override { return elastic_energy_T<DScalar2<double, Eigen::Matrix<double, 12, 1>, Eigen::Matrix<double, 12, 12>>>(p, el_id, def_grad); }                                                                                                                                                                                                                         \
@@ -55,6 +63,8 @@
 
 #define POLYFEM_TEMPLATE_SPECIALIZE_ELASTIC_ENERGY(NAME)                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                             \
 	template double NAME::elastic_energy_T<double>(const RowVectorNd &p, const int el_id, const DefGradMatrix<double> &def_grad) const;                                                                                                                                                                                                                                                                                                                                                                                                                                              \
+	template DScalar1<double, Eigen::Matrix<double, 4, 1>> NAME::elastic_energy_T<DScalar1<double, Eigen::Matrix<double, 4, 1>>>(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar1<double, Eigen::Matrix<double, 4, 1>>> &def_grad) const;                                                                                                                                                                                                                                                                                                                         \
+	template DScalar1<double, Eigen::Matrix<double, 9, 1>> NAME::elastic_energy_T<DScalar1<double, Eigen::Matrix<double, 9, 1>>>(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar1<double, Eigen::Matrix<double, 9, 1>>> &def_grad) const;                                                                                                                                                                                                                                                                                                                         \
 	template DScalar1<double, Eigen::Matrix<double, 6, 1>> NAME::elastic_energy_T<DScalar1<double, Eigen::Matrix<double, 6, 1>>>(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar1<double, Eigen::Matrix<double, 6, 1>>> &def_grad) const;                                                                                                                                                                                                                                                                                                                         \
 	template DScalar1<double, Eigen::Matrix<double, 8, 1>> NAME::elastic_energy_T<DScalar1<double, Eigen::Matrix<double, 8, 1>>>(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar1<double, Eigen::Matrix<double, 8, 1>>> &def_grad) const;                                                                                                                                                                                                                                                                                                                         \
 	template DScalar1<double, Eigen::Matrix<double, 12, 1>> NAME::elastic_energy_T<DScalar1<double, Eigen::Matrix<double, 12, 1>>>(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar1<double, Eigen::Matrix<double, 12, 1>>> &def_grad) const;                                                                                                                                                                                                                                                                                                                      \
@@ -67,6 +77,8 @@
 	template DScalar1<double, Eigen::Matrix<double, Eigen::Dynamic, 1, 0, SMALL_N, 1>> NAME::elastic_energy_T<DScalar1<double, Eigen::Matrix<double, Eigen::Dynamic, 1, 0, SMALL_N, 1>>>(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar1<double, Eigen::Matrix<double, Eigen::Dynamic, 1, 0, SMALL_N, 1>>> &def_grad) const;                                                                                                                                                                                                                                     \
 	template DScalar1<double, Eigen::Matrix<double, Eigen::Dynamic, 1, 0, BIG_N, 1>> NAME::elastic_energy_T<DScalar1<double, Eigen::Matrix<double, Eigen::Dynamic, 1, 0, BIG_N, 1>>>(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar1<double, Eigen::Matrix<double, Eigen::Dynamic, 1, 0, BIG_N, 1>>> &def_grad) const;                                                                                                                                                                                                                                           \
 	template DScalar1<double, Eigen::VectorXd> NAME::elastic_energy_T<DScalar1<double, Eigen::VectorXd>>(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar1<double, Eigen::VectorXd>> &def_grad) const;                                                                                                                                                                                                                                                                                                                                                             \
+	template DScalar2<double, Eigen::Matrix<double, 4, 1>, Eigen::Matrix<double, 4, 4>> NAME::elastic_energy_T<DScalar2<double, Eigen::Matrix<double, 4, 1>, Eigen::Matrix<double, 4, 4>>>(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar2<double, Eigen::Matrix<double, 4, 1>, Eigen::Matrix<double, 4, 4>>> &def_grad) const;                                                                                                                                                                                                                                  \
+	template DScalar2<double, Eigen::Matrix<double, 9, 1>, Eigen::Matrix<double, 9, 9>> NAME::elastic_energy_T<DScalar2<double, Eigen::Matrix<double, 9, 1>, Eigen::Matrix<double, 9, 9>>>(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar2<double, Eigen::Matrix<double, 9, 1>, Eigen::Matrix<double, 9, 9>>> &def_grad) const;                                                                                                                                                                                                                                  \
 	template DScalar2<double, Eigen::Matrix<double, 6, 1>, Eigen::Matrix<double, 6, 6>> NAME::elastic_energy_T<DScalar2<double, Eigen::Matrix<double, 6, 1>, Eigen::Matrix<double, 6, 6>>>(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar2<double, Eigen::Matrix<double, 6, 1>, Eigen::Matrix<double, 6, 6>>> &def_grad) const;                                                                                                                                                                                                                                  \
 	template DScalar2<double, Eigen::Matrix<double, 8, 1>, Eigen::Matrix<double, 8, 8>> NAME::elastic_energy_T<DScalar2<double, Eigen::Matrix<double, 8, 1>, Eigen::Matrix<double, 8, 8>>>(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar2<double, Eigen::Matrix<double, 8, 1>, Eigen::Matrix<double, 8, 8>>> &def_grad) const;                                                                                                                                                                                                                                  \
 	template DScalar2<double, Eigen::Matrix<double, 12, 1>, Eigen::Matrix<double, 12, 12>> NAME::elastic_energy_T<DScalar2<double, Eigen::Matrix<double, 12, 1>, Eigen::Matrix<double, 12, 12>>>(const RowVectorNd &p, const int el_id, const DefGradMatrix<DScalar2<double, Eigen::Matrix<double, 12, 1>, Eigen::Matrix<double, 12, 12>>> &def_grad) const;                                                                                                                                                                                                                         \
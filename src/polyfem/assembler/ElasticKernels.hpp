@@ -0,0 +1,315 @@
+#pragma once
+
+#include <cmath>
+
+// the kernels only use raw arrays and fixed size loops, so the same code runs on the host and in device code
+#ifdef __CUDACC__
+#define POLYFEM_HOST_DEVICE __host__ __device__
+#else
+#define POLYFEM_HOST_DEVICE
+#endif
+
+// Closed form energy density, first Piola-Kirchhoff stress and tangent of the elastic materials, and the element
+// energy, gradient, and hessian built from them.
+// Conventions:
+//   grad_u, F, and P are dim x dim row major, grad_u[i * dim + j] = du_i/dx_j
+//   C[(i * dim + j) * dim * dim + k * dim + l] = dP_ij/dF_kl, it is skipped if C is null
+//   grads[(p * n_bases + i) * dim + c] is the derivative of basis i at point p with respect to x_c
+//   u[i * dim + d] is the d-th component of the displacement of basis i, the local dofs have the same order
+namespace polyfem::assembler::kernels
+{
+	/// Voigt index of the symmetric tensor entry (a, b), (xx, yy, xy) in 2D and (xx, yy, zz, yz, xz, xy) in 3D
+	template <int dim>
+	POLYFEM_HOST_DEVICE inline int voigt_index(const int a, const int b)
+	{
+		if (a == b)
+			return a;
+		if (dim == 2)
+			return 2;
+		return 6 - a - b;
+	}
+
+	/// psi = mu eps:eps + lambda/2 tr(eps)^2, with the small strain eps = (grad_u + grad_u^T)/2
+	template <int dim>
+	POLYFEM_HOST_DEVICE inline double linear_elasticity(const double lambda, const double mu, const double *grad_u, double *P, double *C)
+	{
+		double eps[dim * dim];
+		double tr = 0;
+		for (int i = 0; i < dim; ++i)
+		{
+			for (int j = 0; j < dim; ++j)
+				eps[i * dim + j] = 0.5 * (grad_u[i * dim + j] + grad_u[j * dim + i]);
+			tr += eps[i * dim + i];
+		}
+
+		double psi = 0.5 * lambda * tr * tr;
+		for (int k = 0; k < dim * dim; ++k)
+		{
+			psi += mu * eps[k] * eps[k];
+			P[k] = 2 * mu * eps[k];
+		}
+		for (int i = 0; i < dim; ++i)
+			P[i * dim + i] += lambda * tr;
+
+		if (C != nullptr)
+		{
+			for (int i = 0; i < dim; ++i)
+				for (int j = 0; j < dim; ++j)
+					for (int k = 0; k < dim; ++k)
+						for (int l = 0; l < dim; ++l)
+							C[(i * dim + j) * dim * dim + k * dim + l] =
+								mu * ((i == k && j == l) + (i == l && j == k)) + lambda * (i == j && k == l);
+		}
+
+		return psi;
+	}
+
+	/// psi = S:E / 2, with the Green strain E = (F^T F - I)/2 and S = C:E given by the Voigt matrix voigt (engineering shear strains)
+	template <int dim>
+	POLYFEM_HOST_DEVICE inline double saint_venant(const double *voigt, const double *grad_u, double *P, double *C)
+	{
+		constexpr int n_voigt = dim == 2 ? 3 : 6;
+
+		double F[dim * dim];
+		for (int i = 0; i < dim; ++i)
+			for (int j = 0; j < dim; ++j)
+				F[i * dim + j] = grad_u[i * dim + j] + (i == j);
+
+		double e[n_voigt];
+		for (int a = 0; a < dim; ++a)
+		{
+			for (int b = a; b < dim; ++b)
+			{
+				double FtF = 0;
+				for (int m = 0; m < dim; ++m)
+					FtF += F[m * dim + a] * F[m * dim + b];
+				// the shear entries are 2 E_ab = FtF_ab
+				e[voigt_index<dim>(a, b)] = a == b ? 0.5 * (FtF - 1) : FtF;
+			}
+		}
+
+		double s[n_voigt];
+		double psi = 0;
+		for (int v = 0; v < n_voigt; ++v)
+		{
+			s[v] = 0;
+			for (int w = 0; w < n_voigt; ++w)
+				s[v] += voigt[v * n_voigt + w] * e[w];
+			psi += 0.5 * s[v] * e[v];
+		}
+
+		// P = F S
+		for (int i = 0; i < dim; ++i)
+		{
+			for (int j = 0; j < dim; ++j)
+			{
+				P[i * dim + j] = 0;
+				for (int m = 0; m < dim; ++m)
+					P[i * dim + j] += F[i * dim + m] * s[voigt_index<dim>(m, j)];
+			}
+		}
+
+		if (C != nullptr)
+		{
+			// dP_ij/dF_kl = delta_ik S_lj + sum_m F_im dS_mj/dF_kl, dS_mj/dF_kl = sum_b V(mj, lb) F_kb
+			for (int i = 0; i < dim; ++i)
+			{
+				for (int j = 0; j < dim; ++j)
+				{
+					for (int k = 0; k < dim; ++k)
+					{
+						for (int l = 0; l < dim; ++l)
+						{
+							double val = i == k ? s[voigt_index<dim>(l, j)] : 0;
+							for (int m = 0; m < dim; ++m)
+							{
+								double dS = 0;
+								for (int b = 0; b < dim; ++b)
+									dS += voigt[voigt_index<dim>(m, j) * n_voigt + voigt_index<dim>(l, b)] * F[k * dim + b];
+								val += F[i * dim + m] * dS;
+							}
+							C[(i * dim + j) * dim * dim + k * dim + l] = val;
+						}
+					}
+				}
+			}
+		}
+
+		return psi;
+	}
+
+	/// psi = mu/2 (tr(F^T F) - dim - 2 log J) + lambda/2 log(J)^2, NaN if J <= 0
+	template <int dim>
+	POLYFEM_HOST_DEVICE inline double neo_hookean(const double lambda, const double mu, const double *grad_u, double *P, double *C)
+	{
+		double F[dim * dim];
+		for (int i = 0; i < dim; ++i)
+			for (int j = 0; j < dim; ++j)
+				F[i * dim + j] = grad_u[i * dim + j] + (i == j);
+
+		// cofactor, F^-T = cof / J
+		double cof[dim * dim];
+		double J;
+		if (dim == 2)
+		{
+			cof[0] = F[3];
+			cof[1] = -F[2];
+			cof[2] = -F[1];
+			cof[3] = F[0];
+			J = F[0] * F[3] - F[1] * F[2];
+		}
+		else
+		{
+			for (int i = 0; i < dim; ++i)
+			{
+				const int i1 = (i + 1) % dim, i2 = (i + 2) % dim;
+				for (int j = 0; j < dim; ++j)
+				{
+					const int j1 = (j + 1) % dim, j2 = (j + 2) % dim;
+					cof[i * dim + j] = F[i1 * dim + j1] * F[i2 * dim + j2] - F[i1 * dim + j2] * F[i2 * dim + j1];
+				}
+			}
+			J = F[0] * cof[0] + F[1] * cof[1] + F[2] * cof[2];
+		}
+
+		const double log_J = J > 0 ? std::log(J) : NAN;
+		double FF = 0;
+		for (int k = 0; k < dim * dim; ++k)
+			FF += F[k] * F[k];
+		const double psi = 0.5 * mu * (FF - dim - 2 * log_J) + 0.5 * lambda * log_J * log_J;
+
+		// P = mu F + (lambda log(J) - mu) F^-T
+		const double a = lambda * log_J - mu;
+		double FinvT[dim * dim];
+		for (int k = 0; k < dim * dim; ++k)
+		{
+			FinvT[k] = cof[k] / J;
+			P[k] = mu * F[k] + a * FinvT[k];
+		}
+
+		if (C != nullptr)
+		{
+			// dP_ij/dF_kl = mu delta_ik delta_jl + lambda F^-T_ij F^-T_kl - (lambda log(J) - mu) F^-T_il F^-T_kj
+			for (int i = 0; i < dim; ++i)
+				for (int j = 0; j < dim; ++j)
+					for (int k = 0; k < dim; ++k)
+						for (int l = 0; l < dim; ++l)
+							C[(i * dim + j) * dim * dim + k * dim + l] =
+								mu * (i == k && j == l) + lambda * FinvT[i * dim + j] * FinvT[k * dim + l] - a * FinvT[i * dim + l] * FinvT[k * dim + j];
+		}
+
+		return psi;
+	}
+
+	/// grad_u at point p from the local displacement
+	template <int dim>
+	POLYFEM_HOST_DEVICE inline void displacement_gradient(const int n_bases, const int p, const double *grads, const double *u, double *grad_u)
+	{
+		for (int k = 0; k < dim * dim; ++k)
+			grad_u[k] = 0;
+		for (int i = 0; i < n_bases; ++i)
+		{
+			const double *g = grads + (p * n_bases + i) * dim;
+			for (int d = 0; d < dim; ++d)
+				for (int c = 0; c < dim; ++c)
+					grad_u[d * dim + c] += u[i * dim + d] * g[c];
+		}
+	}
+
+	/// Element energy sum_p da[p] psi_p, gradient, and hessian with one evaluation of the material per point,
+	/// material(p, grad_u, P, C) evaluates one of the kernels above at point p and returns psi. The null outputs are skipped.
+	///   gradient[i * dim + d] = sum_p da[p] P_p(d, :) . grad phi_i, n_bases * dim entries
+	///   hessian[(i * dim + d) * n_bases * dim + j * dim + e] = sum_p da[p] grad phi_i . C_p(d:, e:) . grad phi_j, row major
+	template <int dim, typename Material>
+	POLYFEM_HOST_DEVICE inline void element_energy_gradient_hessian(const int n_bases, const int n_pts, const double *grads, const double *da, const double *u, const Material &material, double *energy, double *gradient, double *hessian)
+	{
+		const int n = n_bases * dim;
+		if (energy != nullptr)
+			*energy = 0;
+		if (gradient != nullptr)
+			for (int k = 0; k < n; ++k)
+				gradient[k] = 0;
+		if (hessian != nullptr)
+			for (int k = 0; k < n * n; ++k)
+				hessian[k] = 0;
+
+		double grad_u[dim * dim], P[dim * dim], C[dim * dim * dim * dim];
+		for (int p = 0; p < n_pts; ++p)
+		{
+			displacement_gradient<dim>(n_bases, p, grads, u, grad_u);
+			const double psi = material(p, grad_u, P, hessian != nullptr ? C : static_cast<double *>(nullptr));
+			if (energy != nullptr)
+				*energy += da[p] * psi;
+
+			for (int i = 0; i < n_bases; ++i)
+			{
+				const double *gi = grads + (p * n_bases + i) * dim;
+
+				if (gradient != nullptr)
+				{
+					for (int d = 0; d < dim; ++d)
+					{
+						double val = 0;
+						for (int c = 0; c < dim; ++c)
+							val += P[d * dim + c] * gi[c];
+						gradient[i * dim + d] += da[p] * val;
+					}
+				}
+
+				if (hessian == nullptr)
+					continue;
+
+				// CG[d][e][f] = sum_c gi_c C(dc, ef), shared by all j
+				double CG[dim * dim * dim];
+				for (int d = 0; d < dim; ++d)
+				{
+					for (int ef = 0; ef < dim * dim; ++ef)
+					{
+						double val = 0;
+						for (int c = 0; c < dim; ++c)
+							val += gi[c] * C[(d * dim + c) * dim * dim + ef];
+						CG[d * dim * dim + ef] = val;
+					}
+				}
+
+				for (int j = 0; j < n_bases; ++j)
+				{
+					const double *gj = grads + (p * n_bases + j) * dim;
+					for (int d = 0; d < dim; ++d)
+					{
+						for (int e = 0; e < dim; ++e)
+						{
+							double val = 0;
+							for (int f = 0; f < dim; ++f)
+								val += CG[d * dim * dim + e * dim + f] * gj[f];
+							hessian[(i * dim + d) * n + j * dim + e] += da[p] * val;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	/// sum_p da[p] psi_p
+	template <int dim, typename Material>
+	POLYFEM_HOST_DEVICE inline double element_energy(const int n_bases, const int n_pts, const double *grads, const double *da, const double *u, const Material &material)
+	{
+		double energy;
+		element_energy_gradient_hessian<dim>(n_bases, n_pts, grads, da, u, material, &energy, static_cast<double *>(nullptr), static_cast<double *>(nullptr));
+		return energy;
+	}
+
+	/// gradient of element_energy, overwritten
+	template <int dim, typename Material>
+	POLYFEM_HOST_DEVICE inline void element_gradient(const int n_bases, const int n_pts, const double *grads, const double *da, const double *u, const Material &material, double *gradient)
+	{
+		element_energy_gradient_hessian<dim>(n_bases, n_pts, grads, da, u, material, static_cast<double *>(nullptr), gradient, static_cast<double *>(nullptr));
+	}
+
+	/// hessian of element_energy, row major and overwritten
+	template <int dim, typename Material>
+	POLYFEM_HOST_DEVICE inline void element_hessian(const int n_bases, const int n_pts, const double *grads, const double *da, const double *u, const Material &material, double *hessian)
+	{
+		element_energy_gradient_hessian<dim>(n_bases, n_pts, grads, da, u, material, static_cast<double *>(nullptr), static_cast<double *>(nullptr), hessian);
+	}
+} // namespace polyfem::assembler::kernels
@@ -7,11 +7,110 @@ namespace polyfem
 
 	namespace assembler
 	{
+		namespace
+		{
+			/// inverse transposed jacobians of the geometric mapping at all the points of an element, in SoA form:
+			/// the column r * DIM + c of jac_it holds the entry (r, c) at every point (one point per row).
+			/// The jacobians are one product of the reference gradients with the nodes of the geometric bases
+			/// per direction, the inverses are the closed-form cofactor formulas evaluated on whole columns.
+			template <int DIM>
+			void batched_jacobians(
+				const ElementBases &gbasis,
+				const std::vector<AssemblyValues> &gbasis_values,
+				const long n_pts,
+				Eigen::VectorXd &det,
+				Eigen::Matrix<double, Eigen::Dynamic, DIM * DIM> &jac_it)
+			{
+				const int n_gbases = gbasis_values.size();
+
+				// position of the geometric nodes, the sum of the global nodes weighted by their coefficients
+				Eigen::Matrix<double, Eigen::Dynamic, DIM> nodes(n_gbases, DIM);
+				nodes.setZero();
+				for (int j = 0; j < n_gbases; ++j)
+				{
+					for (const Local2Global &g : gbasis.bases[j].global())
+						nodes.row(j) += g.val * g.node;
+				}
+
+				// J(r, c) = sum_j dphi_j/dx_r * node_j(c), row r of the jacobians at all the points
+				Eigen::Matrix<double, Eigen::Dynamic, DIM * DIM> jac(n_pts, DIM * DIM);
+				Eigen::MatrixXd ref_grads(n_pts, n_gbases);
+				for (int r = 0; r < DIM; ++r)
+				{
+					for (int j = 0; j < n_gbases; ++j)
+					{
+						assert(gbasis_values[j].grad.rows() == n_pts);
+						assert(gbasis_values[j].grad.cols() == DIM);
+						ref_grads.col(j) = gbasis_values[j].grad.col(r);
+					}
+					jac.template middleCols<DIM>(r * DIM).noalias() = ref_grads * nodes;
+				}
+
+				const auto J = [&](const int r, const int c) { return jac.col(r * DIM + c).array(); };
+				jac_it.resize(n_pts, DIM * DIM);
+				if constexpr (DIM == 2)
+				{
+					det = (J(0, 0) * J(1, 1) - J(0, 1) * J(1, 0)).matrix();
+					const Eigen::ArrayXd inv_det = det.array().inverse();
+					jac_it.col(0) = (J(1, 1) * inv_det).matrix();
+					jac_it.col(1) = (-J(1, 0) * inv_det).matrix();
+					jac_it.col(2) = (-J(0, 1) * inv_det).matrix();
+					jac_it.col(3) = (J(0, 0) * inv_det).matrix();
+				}
+				else
+				{
+					// the inverse transpose is the cofactor matrix over the determinant
+					for (int r = 0; r < 3; ++r)
+					{
+						const int r1 = (r + 1) % 3, r2 = (r + 2) % 3;
+						for (int c = 0; c < 3; ++c)
+						{
+							const int c1 = (c + 1) % 3, c2 = (c + 2) % 3;
+							jac_it.col(r * 3 + c) = (J(r1, c1) * J(r2, c2) - J(r1, c2) * J(r2, c1)).matrix();
+						}
+					}
+					det = (J(0, 0) * jac_it.col(0).array() + J(0, 1) * jac_it.col(1).array() + J(0, 2) * jac_it.col(2).array()).matrix();
+					jac_it.array().colwise() /= det.array();
+				}
+			}
+
+			/// stores the batched inverse transposed jacobians and maps the gradients of the bases, one column
+			/// of the points at a time
+			template <int DIM>
+			void apply_batched_jacobians(
+				const Eigen::Matrix<double, Eigen::Dynamic, DIM * DIM> &batched_jac_it,
+				std::vector<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, 0, 3, 3>> &jac_it,
+				std::vector<AssemblyValues> &basis_values)
+			{
+				const long n_pts = batched_jac_it.rows();
+				jac_it.resize(n_pts);
+				for (long k = 0; k < n_pts; ++k)
+				{
+					jac_it[k].resize(DIM, DIM);
+					for (int r = 0; r < DIM; ++r)
+						for (int c = 0; c < DIM; ++c)
+							jac_it[k](r, c) = batched_jac_it(k, r * DIM + c);
+				}
+
+				for (AssemblyValues &v : basis_values)
+				{
+					assert(v.grad.rows() == n_pts && v.grad.cols() == DIM);
+					for (int c = 0; c < DIM; ++c)
+					{
+						v.grad_t_m.col(c) = v.grad.col(0).cwiseProduct(batched_jac_it.col(c));
+						for (int r = 1; r < DIM; ++r)
+							v.grad_t_m.col(c) += v.grad.col(r).cwiseProduct(batched_jac_it.col(r * DIM + c));
+					}
+				}
+			}
+		} // namespace
+
 		void ElementAssemblyValues::finalize_global_element(const Eigen::MatrixXd &v)
 		{
 			val = v;
 
 			has_parameterization = false;
+			is_affine = false;
 			det.resize(v.rows(), 1);
 
 			jac_it.resize(v.rows());
@@ -20,7 +119,7 @@ namespace polyfem
 
 			det.setConstant(1); // volume (det of the geometric mapping)
 			for (std::size_t j = 0; j < basis_values.size(); ++j)
-				basis_values[j].grad_t_m = basis_values[j].grad; // / scaling
+				basis_values[j].grad_t_m.noalias() = basis_values[j].grad; // / scaling
 		}
 
 		bool ElementAssemblyValues::is_geom_mapping_positive(const Eigen::MatrixXd &dx, const Eigen::MatrixXd &dy, const Eigen::MatrixXd &dz) const
@@ -99,33 +198,40 @@ namespace polyfem
 			Eigen::Matrix3d tmp;
 			jac_it.resize(val.rows());
 
-			// loop over points
-			for (long k = 0; k < val.rows(); ++k)
+			if (is_affine)
 			{
+				// constant jacobian, computed once from the gradients at the first point and broadcast
 				tmp.setZero();
 				for (int j = 0; j < gbasis_values.size(); ++j)
 				{
 					const Basis &b = gbasis.bases[j];
-					assert(gbasis.has_parameterization);
-					assert(gbasis_values[j].grad.rows() == val.rows());
+					assert(gbasis_values[j].grad.rows() >= 1);
 					assert(gbasis_values[j].grad.cols() == 3);
 
 					for (std::size_t ii = 0; ii < b.global().size(); ++ii)
 					{
+						const long k = 0;
 						tmp.row(0) += gbasis_values[j].grad(k, 0) * b.global()[ii].node * b.global()[ii].val;
 						tmp.row(1) += gbasis_values[j].grad(k, 1) * b.global()[ii].node * b.global()[ii].val;
 						tmp.row(2) += gbasis_values[j].grad(k, 2) * b.global()[ii].node * b.global()[ii].val;
 					}
 				}
 
-				det(k) = tmp.determinant();
-				// assert(det(k)>0);
-				// std::cout<<det(k)<<std::endl;
-
-				jac_it[k] = tmp.inverse().transpose();
+				det.setConstant(tmp.determinant());
+				const Eigen::Matrix3d tmp_it = tmp.inverse().transpose();
+				for (long k = 0; k < val.rows(); ++k)
+					jac_it[k] = tmp_it;
 				for (std::size_t j = 0; j < basis_values.size(); ++j)
-					basis_values[j].grad_t_m.row(k) = basis_values[j].grad.row(k) * jac_it[k];
+					basis_values[j].grad_t_m.noalias() = basis_values[j].grad * tmp_it;
+
+				return;
 			}
+
+			// all the points at once
+			assert(gbasis.has_parameterization);
+			Eigen::Matrix<double, Eigen::Dynamic, 9> batched_jac_it;
+			batched_jacobians<3>(gbasis, gbasis_values, val.rows(), det, batched_jac_it);
+			apply_batched_jacobians<3>(batched_jac_it, jac_it, basis_values);
 		}
 
 		// void ElementAssemblyValues::finalize(const Eigen::MatrixXd &v, const Eigen::MatrixXd &dx, const Eigen::MatrixXd &dy)
@@ -164,32 +270,39 @@ namespace polyfem
 			Eigen::Matrix2d tmp;
 			jac_it.resize(val.rows());
 
-			// loop over points
-			for (long k = 0; k < val.rows(); ++k)
+			if (is_affine)
 			{
+				// constant jacobian, computed once from the gradients at the first point and broadcast
 				tmp.setZero();
 				for (int j = 0; j < gbasis_values.size(); ++j)
 				{
 					const Basis &b = gbasis.bases[j];
-					assert(gbasis.has_parameterization);
-					assert(gbasis_values[j].grad.rows() == val.rows());
+					assert(gbasis_values[j].grad.rows() >= 1);
 					assert(gbasis_values[j].grad.cols() == 2);
 
 					for (std::size_t ii = 0; ii < b.global().size(); ++ii)
 					{
+						const long k = 0;
 						tmp.row(0) += gbasis_values[j].grad(k, 0) * b.global()[ii].node * b.global()[ii].val;
 						tmp.row(1) += gbasis_values[j].grad(k, 1) * b.global()[ii].node * b.global()[ii].val;
 					}
 				}
 
-				det(k) = tmp.determinant();
-				// assert(det(k)>0);
-				// std::cout<<det(k)<<std::endl;
-
-				jac_it[k] = tmp.inverse().transpose();
+				det.setConstant(tmp.determinant());
+				const Eigen::Matrix2d tmp_it = tmp.inverse().transpose();
+				for (long k = 0; k < val.rows(); ++k)
+					jac_it[k] = tmp_it;
 				for (std::size_t j = 0; j < basis_values.size(); ++j)
-					basis_values[j].grad_t_m.row(k) = basis_values[j].grad.row(k) * jac_it[k];
+					basis_values[j].grad_t_m.noalias() = basis_values[j].grad * tmp_it;
+
+				return;
 			}
+
+			// all the points at once
+			assert(gbasis.has_parameterization);
+			Eigen::Matrix<double, Eigen::Dynamic, 4> batched_jac_it;
+			batched_jacobians<2>(gbasis, gbasis_values, val.rows(), det, batched_jac_it);
+			apply_batched_jacobians<2>(batched_jac_it, jac_it, basis_values);
 		}
 
 		void ElementAssemblyValues::compute(const int el_index, const bool is_volume, const ElementBases &basis, const ElementBases &gbasis)
@@ -252,13 +365,24 @@ namespace polyfem
 			const int n_local_bases = int(basis.bases.size());
 			const int n_local_g_bases = int(gbasis.bases.size());
 
-			basis.evaluate_bases(pts, basis_values);
-			basis.evaluate_grads(pts, basis_values);
+			// Lagrange bases copy the shared values of their reference element
+			basis.evaluate_tabulated(pts, basis_values);
+
+			is_affine = gbasis.is_affine && gbasis.has_parameterization;
 
 			if (&basis != &gbasis)
 			{
-				gbasis.evaluate_bases(pts, g_basis_values_cache_);
-				gbasis.evaluate_grads(pts, g_basis_values_cache_);
+				if (gbasis.has_reference_table())
+					gbasis.evaluate_tabulated(pts, g_basis_values_cache_);
+				else
+				{
+					gbasis.evaluate_bases(pts, g_basis_values_cache_);
+					// the gradients of an affine mapping are constant, one point is enough
+					if (is_affine)
+						gbasis.evaluate_grads(pts.topRows(1), g_basis_values_cache_);
+					else
+						gbasis.evaluate_grads(pts, g_basis_values_cache_);
+				}
 			}
 
 			for (int j = 0; j < n_local_bases; ++j)
@@ -390,5 +514,12 @@ namespace polyfem
 
 			return is_volume ? is_geom_mapping_positive(dxmv, dymv, dzmv) : is_geom_mapping_positive(dxmv, dymv);
 		}
+
+		void ElementAssemblyValues::release_globals()
+		{
+			for (AssemblyValues &v : basis_values)
+				std::vector<basis::Local2Global>().swap(v.global);
+			std::vector<AssemblyValues>().swap(g_basis_values_cache_);
+		}
 	} // namespace assembler
 } // namespace polyfem
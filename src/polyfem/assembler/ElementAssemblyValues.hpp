@@ -30,6 +30,9 @@ namespace polyfem
 			// only poly elements have no parameterization
 			bool has_parameterization = true;
 
+			// the geometric mapping is affine, jac_it and det are the same at every quadrature point
+			bool is_affine = false;
+
 			// computes the per element values at the quadrature points
 			void compute(const int el_index, const bool is_volume, const basis::ElementBases &basis, const basis::ElementBases &gbasis);
 			// computes the per element values at the local (ref el) points (pts)
@@ -37,6 +40,10 @@ namespace polyfem
 			// check if the element is flipped
 			bool is_geom_mapping_positive(const bool is_volume, const basis::ElementBases &gbasis) const;
 
+			// frees the global mappings of the bases and the geometric bases evaluations kept after compute,
+			// used for the cached copies which get the global mappings back from the bases
+			void release_globals();
+
 		private:
 			std::vector<AssemblyValues> g_basis_values_cache_;
 
@@ -72,35 +72,237 @@ namespace polyfem::assembler
 	Eigen::VectorXd GenericElastic::assemble_gradient(const NonLinearAssemblerData &data) const
 	{
 		const int n_bases = data.vals.basis_values.size();
-		return polyfem::gradient_from_energy(
-			size(), n_bases, data,
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, 6, 1>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, 8, 1>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, 12, 1>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, 18, 1>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, 24, 1>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, 30, 1>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, 60, 1>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, 81, 1>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, Eigen::Dynamic, 1, 0, SMALL_N, 1>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, Eigen::Dynamic, 1, 0, BIG_N, 1>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::VectorXd>>(data); });
+		if (size() == 2)
+		{
+			switch (n_bases)
+			{
+			case 3:
+				return compute_gradient_fast<3, 2>(data);
+			case 4:
+				return compute_gradient_fast<4, 2>(data);
+			case 6:
+				return compute_gradient_fast<6, 2>(data);
+			default:
+				return compute_gradient_fast<Eigen::Dynamic, 2>(data);
+			}
+		}
+		else // if (size() == 3)
+		{
+			assert(size() == 3);
+			switch (n_bases)
+			{
+			case 4:
+				return compute_gradient_fast<4, 3>(data);
+			case 8:
+				return compute_gradient_fast<8, 3>(data);
+			case 10:
+				return compute_gradient_fast<10, 3>(data);
+			default:
+				return compute_gradient_fast<Eigen::Dynamic, 3>(data);
+			}
+		}
 	}
 
 	Eigen::MatrixXd GenericElastic::assemble_hessian(const NonLinearAssemblerData &data) const
+	{
+		Eigen::MatrixXd hessian;
+		compute_derivatives(data, nullptr, nullptr, hessian);
+		return hessian;
+	}
+
+	void GenericElastic::compute_energy_gradient_hessian(const NonLinearAssemblerData &data, double *energy, Eigen::VectorXd *gradient, Eigen::MatrixXd *hessian) const
+	{
+		// without the hessian the first order autodiff is cheaper
+		if (hessian == nullptr)
+		{
+			NLAssembler::compute_energy_gradient_hessian(data, energy, gradient, hessian);
+			return;
+		}
+
+		compute_derivatives(data, energy, gradient, *hessian);
+	}
+
+	void GenericElastic::compute_derivatives(const NonLinearAssemblerData &data, double *energy, Eigen::VectorXd *gradient, Eigen::MatrixXd &hessian) const
 	{
 		const int n_bases = data.vals.basis_values.size();
-		return polyfem::hessian_from_energy(
-			size(), n_bases, data,
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::Matrix<double, 6, 1>, Eigen::Matrix<double, 6, 6>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::Matrix<double, 8, 1>, Eigen::Matrix<double, 8, 8>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::Matrix<double, 12, 1>, Eigen::Matrix<double, 12, 12>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::Matrix<double, 18, 1>, Eigen::Matrix<double, 18, 18>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::Matrix<double, 24, 1>, Eigen::Matrix<double, 24, 24>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::Matrix<double, 30, 1>, Eigen::Matrix<double, 30, 30>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::Matrix<double, 60, 1>, Eigen::Matrix<double, 60, 60>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::Matrix<double, 81, 1>, Eigen::Matrix<double, 81, 81>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::Matrix<double, Eigen::Dynamic, 1, 0, SMALL_N, 1>, Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, 0, SMALL_N, SMALL_N>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::VectorXd, Eigen::MatrixXd>>(data); });
+		if (size() == 2)
+		{
+			switch (n_bases)
+			{
+			case 3:
+				compute_derivatives_fast<3, 2>(data, energy, gradient, hessian);
+				break;
+			case 4:
+				compute_derivatives_fast<4, 2>(data, energy, gradient, hessian);
+				break;
+			case 6:
+				compute_derivatives_fast<6, 2>(data, energy, gradient, hessian);
+				break;
+			default:
+				compute_derivatives_fast<Eigen::Dynamic, 2>(data, energy, gradient, hessian);
+			}
+		}
+		else // if (size() == 3)
+		{
+			assert(size() == 3);
+			switch (n_bases)
+			{
+			case 4:
+				compute_derivatives_fast<4, 3>(data, energy, gradient, hessian);
+				break;
+			case 8:
+				compute_derivatives_fast<8, 3>(data, energy, gradient, hessian);
+				break;
+			case 10:
+				compute_derivatives_fast<10, 3>(data, energy, gradient, hessian);
+				break;
+			default:
+				compute_derivatives_fast<Eigen::Dynamic, 3>(data, energy, gradient, hessian);
+			}
+		}
+	}
+
+	namespace
+	{
+		template <int n_basis, int dim>
+		Eigen::Matrix<double, n_basis, dim> local_displacement(const NonLinearAssemblerData &data)
+		{
+			assert(data.x.cols() == 1);
+
+			Eigen::Matrix<double, n_basis, dim> local_disp(data.vals.basis_values.size(), dim);
+			local_disp.setZero();
+			for (size_t i = 0; i < data.vals.basis_values.size(); ++i)
+			{
+				const auto &bs = data.vals.basis_values[i];
+				for (size_t ii = 0; ii < bs.global.size(); ++ii)
+				{
+					for (int d = 0; d < dim; ++d)
+					{
+						local_disp(i, d) += bs.global[ii].val * data.x(bs.global[ii].index * dim + d);
+					}
+				}
+			}
+
+			return local_disp;
+		}
+
+		// gradients of the bases in physical coordinates at the quadrature point p
+		template <int n_basis, int dim>
+		Eigen::Matrix<double, n_basis, dim> physical_gradient(const NonLinearAssemblerData &data, const long p)
+		{
+			Eigen::Matrix<double, n_basis, dim> grad(data.vals.basis_values.size(), dim);
+			for (size_t i = 0; i < data.vals.basis_values.size(); ++i)
+				grad.row(i) = data.vals.basis_values[i].grad.row(p);
+
+			const Eigen::Matrix<double, dim, dim> jac_it = data.vals.jac_it[p];
+			return grad * jac_it;
+		}
+	} // namespace
+
+	template <int n_basis, int dim>
+	Eigen::VectorXd GenericElastic::compute_gradient_fast(const NonLinearAssemblerData &data) const
+	{
+		typedef DScalar1<double, Eigen::Matrix<double, dim * dim, 1>> Diff;
+		DiffScalarBase::setVariableCount(dim * dim);
+
+		const int n_loc_bases = data.vals.basis_values.size();
+		const Eigen::Matrix<double, n_basis, dim> local_disp = local_displacement<n_basis, dim>(data);
+
+		DefGradMatrix<Diff> def_grad_ad(dim, dim);
+		Eigen::Matrix<double, n_basis, dim> G(n_loc_bases, dim);
+		G.setZero();
+
+		const int n_pts = data.da.size();
+		for (long p = 0; p < n_pts; ++p)
+		{
+			const Eigen::Matrix<double, n_basis, dim> grad = physical_gradient<n_basis, dim>(data, p);
+
+			// Id + grad d
+			const Eigen::Matrix<double, dim, dim> def_grad = local_disp.transpose() * grad + Eigen::Matrix<double, dim, dim>::Identity();
+			for (int d1 = 0; d1 < dim; ++d1)
+			{
+				for (int d2 = 0; d2 < dim; ++d2)
+					def_grad_ad(d1, d2) = Diff(d1 * dim + d2, def_grad(d1, d2));
+			}
+
+			const Diff val = elastic_energy(data.vals.val.row(p), data.vals.element_id, def_grad_ad);
+
+			// first Piola-Kirchhoff stress, dPsi/dF
+			const Eigen::Matrix<double, dim, dim, Eigen::RowMajor> stress = Eigen::Map<const Eigen::Matrix<double, dim, dim, Eigen::RowMajor>>(val.getGradient().data());
+
+			G.noalias() += grad * stress.transpose() * data.da(p);
+		}
+
+		const Eigen::Matrix<double, dim, n_basis> G_T = G.transpose();
+		return Eigen::Map<const Eigen::VectorXd>(G_T.data(), G_T.size());
+	}
+
+	template <int n_basis, int dim>
+	void GenericElastic::compute_derivatives_fast(const NonLinearAssemblerData &data, double *energy, Eigen::VectorXd *gradient, Eigen::MatrixXd &hessian) const
+	{
+		typedef DScalar2<double, Eigen::Matrix<double, dim * dim, 1>, Eigen::Matrix<double, dim * dim, dim * dim>> Diff;
+		DiffScalarBase::setVariableCount(dim * dim);
+
+		constexpr int N = (n_basis == Eigen::Dynamic) ? Eigen::Dynamic : n_basis * dim;
+		const int n_loc_bases = data.vals.basis_values.size();
+		const Eigen::Matrix<double, n_basis, dim> local_disp = local_displacement<n_basis, dim>(data);
+
+		DefGradMatrix<Diff> def_grad_ad(dim, dim);
+		Eigen::Matrix<double, N, N> H(n_loc_bases * dim, n_loc_bases * dim);
+		H.setZero();
+		Eigen::Matrix<double, n_basis, dim> G(n_loc_bases, dim);
+		G.setZero();
+		double E = 0;
+
+		const int n_pts = data.da.size();
+		for (long p = 0; p < n_pts; ++p)
+		{
+			const Eigen::Matrix<double, n_basis, dim> grad = physical_gradient<n_basis, dim>(data, p);
+
+			// Id + grad d
+			const Eigen::Matrix<double, dim, dim> def_grad = local_disp.transpose() * grad + Eigen::Matrix<double, dim, dim>::Identity();
+			for (int d1 = 0; d1 < dim; ++d1)
+			{
+				for (int d2 = 0; d2 < dim; ++d2)
+					def_grad_ad(d1, d2) = Diff(d1 * dim + d2, def_grad(d1, d2));
+			}
+
+			const Diff val = elastic_energy(data.vals.val.row(p), data.vals.element_id, def_grad_ad);
+
+			// the second order autodiff also gives the energy and the stress
+			E += val.getValue() * data.da(p);
+			if (gradient)
+			{
+				const Eigen::Matrix<double, dim, dim, Eigen::RowMajor> stress = Eigen::Map<const Eigen::Matrix<double, dim, dim, Eigen::RowMajor>>(val.getGradient().data());
+				G.noalias() += grad * stress.transpose() * data.da(p);
+			}
+
+			// derivative of the first Piola-Kirchhoff stress, d2Psi/dF2, the displacement
+			// component k of basis a only enters the row k of F with weight grad(a, :)
+			const auto &dstress = val.getHessian();
+			for (int k = 0; k < dim; ++k)
+			{
+				for (int l = 0; l < dim; ++l)
+				{
+					const Eigen::Matrix<double, dim, dim> dstress_kl = dstress.template block<dim, dim>(k * dim, l * dim);
+					const Eigen::Matrix<double, n_basis, n_basis> block = grad * dstress_kl * grad.transpose() * data.da(p);
+
+					for (int a = 0; a < n_loc_bases; ++a)
+					{
+						for (int b = 0; b < n_loc_bases; ++b)
+							H(a * dim + k, b * dim + l) += block(a, b);
+					}
+				}
+			}
+		}
+
+		if (energy)
+			*energy = E;
+		if (gradient)
+		{
+			const Eigen::Matrix<double, dim, n_basis> G_T = G.transpose();
+			*gradient = Eigen::Map<const Eigen::VectorXd>(G_T.data(), G_T.size());
+		}
+		hessian = H;
 	}
 } // namespace polyfem::assembler
\ No newline at end of file
@@ -21,6 +21,8 @@ namespace polyfem::assembler
 		double compute_energy(const NonLinearAssemblerData &data) const override;
 		Eigen::MatrixXd assemble_hessian(const NonLinearAssemblerData &data) const override;
 		Eigen::VectorXd assemble_gradient(const NonLinearAssemblerData &data) const override;
+		// a single second order autodiff per quadrature point gives the three
+		void compute_energy_gradient_hessian(const NonLinearAssemblerData &data, double *energy, Eigen::VectorXd *gradient, Eigen::MatrixXd *hessian) const override;
 
 		// sets material params
 		virtual void add_multimaterial(const int index, const json &params) override = 0;
@@ -33,6 +35,15 @@ namespace polyfem::assembler
 		void assign_stress_tensor(const int el_id, const basis::ElementBases &bs, const basis::ElementBases &gbs, const Eigen::MatrixXd &local_pts, const Eigen::MatrixXd &displacement, const int all_size, const ElasticityTensorType &type, Eigen::MatrixXd &all, const std::function<Eigen::MatrixXd(const Eigen::MatrixXd &)> &fun) const override;
 
 	private:
+		// gradient and hessian computed per quadrature point with respect to the deformation gradient only
+		// and contracted with the basis gradients, specialized on the number of local bases and dimension
+		template <int n_basis, int dim>
+		Eigen::VectorXd compute_gradient_fast(const NonLinearAssemblerData &data) const;
+		// the hessian, and the energy and gradient if not null, from the same autodiff
+		template <int n_basis, int dim>
+		void compute_derivatives_fast(const NonLinearAssemblerData &data, double *energy, Eigen::VectorXd *gradient, Eigen::MatrixXd &hessian) const;
+		void compute_derivatives(const NonLinearAssemblerData &data, double *energy, Eigen::VectorXd *gradient, Eigen::MatrixXd &hessian) const;
+
 		// utility function that computes energy, the template is used for double, DScalar1, and DScalar2 in energy, gradient and hessian
 		template <typename T>
 		T compute_energy_aux(const NonLinearAssemblerData &data) const
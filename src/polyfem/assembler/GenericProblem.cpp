@@ -5,6 +5,8 @@
 #include <polyfem/utils/StringUtils.hpp>
 #include <polyfem/io/MatrixIO.hpp>
 
+#include <algorithm>
+
 namespace polyfem
 {
 	using namespace utils;
@@ -46,6 +48,114 @@ namespace polyfem
 
 				return j_boundary;
 			}
+
+			// index in ids of the boundary id of every point, -1 if none
+			std::vector<int> boundary_index(const mesh::Mesh &mesh, const Eigen::MatrixXi &global_ids, const std::vector<int> &ids)
+			{
+				std::vector<int> res(global_ids.size(), -1);
+				if (ids.empty())
+					return res;
+
+				// the id -> entry map is resolved once in a flat table (unless the ids are too sparse),
+				// the first entry wins as in a linear search
+				const int min_id = *std::min_element(ids.begin(), ids.end());
+				const int max_id = *std::max_element(ids.begin(), ids.end());
+				const bool use_table = double(max_id) - min_id < 1024 + 4 * ids.size();
+				std::vector<int> table;
+				if (use_table)
+				{
+					table.assign(size_t(max_id - min_id) + 1, -1);
+					for (int b = int(ids.size()) - 1; b >= 0; --b)
+						table[ids[b] - min_id] = b;
+				}
+				const auto lookup = [&](const int id) {
+					if (id < min_id || id > max_id)
+						return -1;
+					if (use_table)
+						return table[id - min_id];
+					const auto it = std::find(ids.begin(), ids.end(), id);
+					return it == ids.end() ? -1 : int(it - ids.begin());
+				};
+
+				// consecutive samples usually lie on the same primitive
+				int prev_primitive = -1, prev_index = -1;
+				for (long i = 0; i < global_ids.size(); ++i)
+				{
+					if (i == 0 || global_ids(i) != prev_primitive)
+					{
+						prev_primitive = global_ids(i);
+						prev_index = lookup(mesh.get_boundary_id(prev_primitive));
+					}
+					res[i] = prev_index;
+				}
+				return res;
+			}
+
+			// calls f(b, rows, sub_pts) once per boundary b with the rows of pts belonging to it
+			template <typename Func>
+			void for_each_boundary(const std::vector<int> &index, const size_t n_boundaries, const Eigen::MatrixXd &pts, Func &&f)
+			{
+				std::vector<std::vector<int>> rows(n_boundaries);
+				for (size_t i = 0; i < index.size(); ++i)
+				{
+					if (index[i] >= 0)
+						rows[index[i]].push_back(i);
+				}
+
+				Eigen::MatrixXd sub_pts;
+				for (size_t b = 0; b < n_boundaries; ++b)
+				{
+					if (rows[b].empty())
+						continue;
+
+					sub_pts.resize(rows[b].size(), pts.cols());
+					for (size_t k = 0; k < rows[b].size(); ++k)
+						sub_pts.row(k) = pts.row(rows[b][k]);
+
+					f(b, rows[b], sub_pts);
+				}
+			}
+
+			// time dependence of the sum of value(x, t) * interpolation(t), ramp is the interpolation shared by all the terms in the separable case
+			Problem::TimeDependence loads_time_dependence(const std::vector<std::pair<const ExpressionValue *, const Interpolation *>> &terms, const Interpolation *&ramp)
+			{
+				ramp = nullptr;
+				bool has_constant = false;
+				for (const auto &[value, interpolation] : terms)
+				{
+					if (value->is_time_dependent())
+						return Problem::TimeDependence::GENERAL;
+
+					if (interpolation == nullptr || dynamic_cast<const NoInterpolation *>(interpolation) != nullptr)
+						has_constant = true;
+					else if (ramp == nullptr || ramp == interpolation)
+						ramp = interpolation;
+					else
+						return Problem::TimeDependence::GENERAL;
+				}
+
+				if (ramp == nullptr)
+					return Problem::TimeDependence::CONSTANT;
+				return has_constant ? Problem::TimeDependence::GENERAL : Problem::TimeDependence::SEPARABLE;
+			}
+
+			std::vector<std::pair<const ExpressionValue *, const Interpolation *>> tensor_terms(const std::vector<TensorBCValue> &values)
+			{
+				std::vector<std::pair<const ExpressionValue *, const Interpolation *>> res;
+				for (const auto &v : values)
+				{
+					for (int d = 0; d < 3; ++d)
+					{
+						const Interpolation *interpolation = nullptr;
+						if (v.interpolation.size() == 1)
+							interpolation = v.interpolation[0].get();
+						else if (d < v.interpolation.size())
+							interpolation = v.interpolation[d].get();
+						res.emplace_back(&v.value[d], interpolation);
+					}
+				}
+				return res;
+			}
 		} // namespace
 
 		GenericTensorProblem::GenericTensorProblem(const std::string &name)
@@ -63,14 +173,11 @@ namespace polyfem
 				return;
 			}
 
-			const bool planar = pts.cols() == 2;
-			for (int i = 0; i < pts.rows(); ++i)
+			Eigen::VectorXd tmp;
+			for (int j = 0; j < pts.cols(); ++j)
 			{
-				for (int j = 0; j < pts.cols(); ++j)
-				{
-					double x = pts(i, 0), y = pts(i, 1), z = planar ? 0 : pts(i, 2);
-					val(i, j) = rhs_[j](x, y, z, t);
-				}
+				rhs_[j].eval(pts, t, tmp);
+				val.col(j) = tmp;
 			}
 		}
 
@@ -101,69 +208,80 @@ namespace polyfem
 		void GenericTensorProblem::dirichlet_bc(const mesh::Mesh &mesh, const Eigen::MatrixXi &global_ids, const Eigen::MatrixXd &uv, const Eigen::MatrixXd &pts, const double t, Eigen::MatrixXd &val) const
 		{
 			val = Eigen::MatrixXd::Zero(pts.rows(), mesh.dimension());
+			Eigen::VectorXd tmp;
 
-			for (long i = 0; i < pts.rows(); ++i)
+			if (is_all_)
 			{
-				if (is_all_)
+				assert(displacements_.size() == 1);
+				for (int d = 0; d < val.cols(); ++d)
 				{
-					assert(displacements_.size() == 1);
-					for (int d = 0; d < val.cols(); ++d)
-					{
-						val(i, d) = displacements_[0].eval(pts.row(i), d, t);
-					}
+					displacements_[0].eval(pts, d, t, tmp);
+					val.col(d) = tmp;
 				}
-				else
-				{
-					const int id = mesh.get_boundary_id(global_ids(i));
-					for (size_t b = 0; b < boundary_ids_.size(); ++b)
-					{
-						if (id == boundary_ids_[b])
-						{
-							for (int d = 0; d < val.cols(); ++d)
-							{
-								val(i, d) = displacements_[b].eval(pts.row(i), d, t);
-							}
+				return;
+			}
 
-							break;
-						}
-					}
+			const std::vector<int> index = boundary_index(mesh, global_ids, boundary_ids_);
+			for_each_boundary(index, boundary_ids_.size(), pts, [&](const int b, const std::vector<int> &rows, const Eigen::MatrixXd &sub_pts) {
+				for (int d = 0; d < val.cols(); ++d)
+				{
+					displacements_[b].eval(sub_pts, d, t, tmp);
+					for (size_t k = 0; k < rows.size(); ++k)
+						val(rows[k], d) = tmp(k);
 				}
-			}
+			});
 		}
 
 		void GenericTensorProblem::neumann_bc(const mesh::Mesh &mesh, const Eigen::MatrixXi &global_ids, const Eigen::MatrixXd &uv, const Eigen::MatrixXd &pts, const Eigen::MatrixXd &normals, const double t, Eigen::MatrixXd &val) const
 		{
 			val = Eigen::MatrixXd::Zero(pts.rows(), mesh.dimension());
+			Eigen::VectorXd tmp;
 
-			for (long i = 0; i < pts.rows(); ++i)
-			{
-				const int id = mesh.get_boundary_id(global_ids(i));
-
-				for (size_t b = 0; b < neumann_boundary_ids_.size(); ++b)
+			const std::vector<int> neumann_index = boundary_index(mesh, global_ids, neumann_boundary_ids_);
+			for_each_boundary(neumann_index, neumann_boundary_ids_.size(), pts, [&](const int b, const std::vector<int> &rows, const Eigen::MatrixXd &sub_pts) {
+				for (int d = 0; d < val.cols(); ++d)
 				{
-					if (id == neumann_boundary_ids_[b])
-					{
-						for (int d = 0; d < val.cols(); ++d)
-						{
-							val(i, d) = forces_[b].eval(pts.row(i), d, t);
-						}
-
-						break;
-					}
+					forces_[b].eval(sub_pts, d, t, tmp);
+					for (size_t k = 0; k < rows.size(); ++k)
+						val(rows[k], d) = tmp(k);
 				}
+			});
 
-				for (size_t b = 0; b < pressure_boundary_ids_.size(); ++b)
-				{
-					if (id == pressure_boundary_ids_[b])
-					{
-						for (int d = 0; d < val.cols(); ++d)
-						{
-							val(i, d) = pressures_[b].eval(pts.row(i), t) * normals(i, d);
-						}
-						break;
-					}
-				}
+			// a pressure replaces the traction on the same point
+			const std::vector<int> pressure_index = boundary_index(mesh, global_ids, pressure_boundary_ids_);
+			for_each_boundary(pressure_index, pressure_boundary_ids_.size(), pts, [&](const int b, const std::vector<int> &rows, const Eigen::MatrixXd &sub_pts) {
+				pressures_[b].eval(sub_pts, t, tmp);
+				for (size_t k = 0; k < rows.size(); ++k)
+					for (int d = 0; d < val.cols(); ++d)
+						val(rows[k], d) = tmp(k) * normals(rows[k], d);
+			});
+		}
+
+		Problem::TimeDependence GenericTensorProblem::rhs_time_dependence() const
+		{
+			for (const auto &r : rhs_)
+			{
+				if (r.is_time_dependent())
+					return TimeDependence::GENERAL;
 			}
+			return TimeDependence::CONSTANT;
+		}
+
+		Problem::TimeDependence GenericTensorProblem::neumann_time_dependence() const
+		{
+			// pressures follow the (deformed) normals
+			if (!pressures_.empty())
+				return TimeDependence::GENERAL;
+
+			const Interpolation *ramp;
+			return loads_time_dependence(tensor_terms(forces_), ramp);
+		}
+
+		double GenericTensorProblem::neumann_time_scaling(const double t) const
+		{
+			const Interpolation *ramp;
+			loads_time_dependence(tensor_terms(forces_), ramp);
+			return ramp == nullptr ? 1 : ramp->eval(t);
 		}
 
 		void GenericTensorProblem::exact(const Eigen::MatrixXd &pts, const double t, Eigen::MatrixXd &val) const
@@ -1034,58 +1152,69 @@ namespace polyfem
 				val.setZero();
 				return;
 			}
-			const bool planar = pts.cols() == 2;
-			for (int i = 0; i < pts.rows(); ++i)
-			{
-				double x = pts(i, 0), y = pts(i, 1), z = planar ? 0 : pts(i, 2);
-				val(i) = rhs_(x, y, z, t);
-			}
+			Eigen::VectorXd tmp;
+			rhs_.eval(pts, t, tmp);
+			val = tmp;
 		}
 
 		void GenericScalarProblem::dirichlet_bc(const mesh::Mesh &mesh, const Eigen::MatrixXi &global_ids, const Eigen::MatrixXd &uv, const Eigen::MatrixXd &pts, const double t, Eigen::MatrixXd &val) const
 		{
 			val = Eigen::MatrixXd::Zero(pts.rows(), 1);
+			Eigen::VectorXd tmp;
 
-			for (long i = 0; i < pts.rows(); ++i)
+			if (is_all_)
 			{
-				const int id = mesh.get_boundary_id(global_ids(i));
-				if (is_all_)
-				{
-					assert(dirichlet_.size() == 1);
-					val(i) = dirichlet_[0].eval(pts.row(i), t);
-				}
-				else
-				{
-					for (size_t b = 0; b < boundary_ids_.size(); ++b)
-					{
-						if (id == boundary_ids_[b])
-						{
-							val(i) = dirichlet_[b].eval(pts.row(i), t);
-							break;
-						}
-					}
-				}
+				assert(dirichlet_.size() == 1);
+				dirichlet_[0].eval(pts, t, tmp);
+				val = tmp;
+				return;
 			}
+
+			const std::vector<int> index = boundary_index(mesh, global_ids, boundary_ids_);
+			for_each_boundary(index, boundary_ids_.size(), pts, [&](const int b, const std::vector<int> &rows, const Eigen::MatrixXd &sub_pts) {
+				dirichlet_[b].eval(sub_pts, t, tmp);
+				for (size_t k = 0; k < rows.size(); ++k)
+					val(rows[k]) = tmp(k);
+			});
 		}
 
 		void GenericScalarProblem::neumann_bc(const mesh::Mesh &mesh, const Eigen::MatrixXi &global_ids, const Eigen::MatrixXd &uv, const Eigen::MatrixXd &pts, const Eigen::MatrixXd &normals, const double t, Eigen::MatrixXd &val) const
 		{
 			val = Eigen::MatrixXd::Zero(pts.rows(), 1);
+			Eigen::VectorXd tmp;
+
+			const std::vector<int> index = boundary_index(mesh, global_ids, neumann_boundary_ids_);
+			for_each_boundary(index, neumann_boundary_ids_.size(), pts, [&](const int b, const std::vector<int> &rows, const Eigen::MatrixXd &sub_pts) {
+				neumann_[b].eval(sub_pts, t, tmp);
+				for (size_t k = 0; k < rows.size(); ++k)
+					val(rows[k]) = tmp(k);
+			});
+		}
 
-			for (long i = 0; i < pts.rows(); ++i)
-			{
-				const int id = mesh.get_boundary_id(global_ids(i));
+		Problem::TimeDependence GenericScalarProblem::rhs_time_dependence() const
+		{
+			return rhs_.is_time_dependent() ? TimeDependence::GENERAL : TimeDependence::CONSTANT;
+		}
 
-				for (size_t b = 0; b < neumann_boundary_ids_.size(); ++b)
-				{
-					if (id == neumann_boundary_ids_[b])
-					{
-						double x = pts(i, 0), y = pts(i, 1), z = pts.cols() == 2 ? 0 : pts(i, 2);
-						val(i) = neumann_[b].eval(pts.row(i), t);
-						break;
-					}
-				}
-			}
+		Problem::TimeDependence GenericScalarProblem::neumann_time_dependence() const
+		{
+			std::vector<std::pair<const ExpressionValue *, const Interpolation *>> terms;
+			for (const auto &n : neumann_)
+				terms.emplace_back(&n.value, n.interpolation.get());
+
+			const Interpolation *ramp;
+			return loads_time_dependence(terms, ramp);
+		}
+
+		double GenericScalarProblem::neumann_time_scaling(const double t) const
+		{
+			std::vector<std::pair<const ExpressionValue *, const Interpolation *>> terms;
+			for (const auto &n : neumann_)
+				terms.emplace_back(&n.value, n.interpolation.get());
+
+			const Interpolation *ramp;
+			loads_time_dependence(terms, ramp);
+			return ramp == nullptr ? 1 : ramp->eval(t);
 		}
 
 		void GenericScalarProblem::initial_solution(const mesh::Mesh &mesh, const Eigen::MatrixXi &global_ids, const Eigen::MatrixXd &pts, Eigen::MatrixXd &val) const
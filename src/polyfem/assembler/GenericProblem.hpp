@@ -32,6 +32,23 @@ namespace polyfem
 
 				return val;
 			}
+
+			// evaluates at every row of pts at once
+			void eval(const Eigen::MatrixXd &pts, const int dim, const double t, Eigen::VectorXd &val, const int el_id = -1) const
+			{
+				value[dim].eval(pts, t, val, el_id);
+
+				if (interpolation.empty())
+				{
+				}
+				else if (interpolation.size() == 1)
+					val *= interpolation[0]->eval(t);
+				else
+				{
+					assert(dim < interpolation.size());
+					val *= interpolation[dim]->eval(t);
+				}
+			}
 		};
 
 		struct ScalarBCValue
@@ -45,6 +62,13 @@ namespace polyfem
 				double x = pts(0), y = pts(1), z = pts.size() == 3 ? pts(2) : 0.0;
 				return value(x, y, z, t) * interpolation->eval(t);
 			}
+
+			// evaluates at every row of pts at once
+			void eval(const Eigen::MatrixXd &pts, const double t, Eigen::VectorXd &val) const
+			{
+				value.eval(pts, t, val);
+				val *= interpolation->eval(t);
+			}
 		};
 
 		class GenericTensorProblem : public Problem
@@ -82,6 +106,10 @@ namespace polyfem
 			bool is_constant_in_time() const override { return !is_time_dept_; }
 			bool might_have_no_dirichlet() override { return !is_all_; }
 
+			TimeDependence rhs_time_dependence() const override;
+			TimeDependence neumann_time_dependence() const override;
+			double neumann_time_scaling(const double t) const override;
+
 			void initial_solution(const mesh::Mesh &mesh, const Eigen::MatrixXi &global_ids, const Eigen::MatrixXd &pts, Eigen::MatrixXd &val) const override;
 			void initial_velocity(const mesh::Mesh &mesh, const Eigen::MatrixXi &global_ids, const Eigen::MatrixXd &pts, Eigen::MatrixXd &val) const override;
 			void initial_acceleration(const mesh::Mesh &mesh, const Eigen::MatrixXi &global_ids, const Eigen::MatrixXd &pts, Eigen::MatrixXd &val) const override;
@@ -167,6 +195,10 @@ namespace polyfem
 			bool is_constant_in_time() const override { return !is_time_dept_; }
 			bool might_have_no_dirichlet() override { return !is_all_; }
 
+			TimeDependence rhs_time_dependence() const override;
+			TimeDependence neumann_time_dependence() const override;
+			double neumann_time_scaling(const double t) const override;
+
 			void set_parameters(const json &params) override;
 
 			void exact(const Eigen::MatrixXd &pts, const double t, Eigen::MatrixXd &val) const override;
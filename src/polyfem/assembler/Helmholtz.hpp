@@ -13,6 +13,12 @@ namespace polyfem::assembler
 
 		Eigen::Matrix<double, Eigen::Dynamic, 1, 0, 9, 1>
 		assemble(const LinearAssemblerData &data) const override;
+
+		bool has_affine_assembly(const int el_id) const override { return true; }
+		Eigen::Matrix<double, Eigen::Dynamic, 1, 0, 9, 1> assemble_affine(const AffineAssemblerData &data) const override
+		{
+			return Eigen::Matrix<double, 1, 1>::Constant(data.gradient_dot() - data.mass() * k_ * k_);
+		}
 		VectorNd compute_rhs(const AutodiffHessianPt &pt) const override;
 
 		Eigen::Matrix<AutodiffScalarGrad, Eigen::Dynamic, 1, 0, 3, 1> kernel(const int dim, const AutodiffGradPt &rvect, const AutodiffScalarGrad &r) const override;
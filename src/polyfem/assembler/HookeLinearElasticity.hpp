@@ -35,6 +35,8 @@ namespace polyfem::assembler
 
 		// sets the elasticty tensor
 		void add_multimaterial(const int index, const json &params) override;
+		// the stiffness tensor is given by numbers
+		bool has_time_dependent_parameters() const override { return false; }
 
 		const ElasticityTensor &elasticity_tensor() const { return elasticity_tensor_; }
 
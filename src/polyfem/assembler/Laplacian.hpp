@@ -19,6 +19,12 @@ namespace polyfem
 			// computes local stiffness matrix (1x1) for bases i,j
 			Eigen::Matrix<double, Eigen::Dynamic, 1, 0, 9, 1> assemble(const LinearAssemblerData &data) const override;
 
+			bool has_affine_assembly(const int el_id) const override { return true; }
+			Eigen::Matrix<double, Eigen::Dynamic, 1, 0, 9, 1> assemble_affine(const AffineAssemblerData &data) const override
+			{
+				return Eigen::Matrix<double, 1, 1>::Constant(data.gradient_dot());
+			}
+
 			// uses autodiff to compute the rhs for a fabricated solution
 			// in this case it just return pt.getHessian().trace()
 			// pt is the evaluation of the solution at a point
@@ -1,5 +1,6 @@
 #include "LinearElasticity.hpp"
 
+#include <polyfem/assembler/ElasticKernels.hpp>
 #include <polyfem/autogen/auto_elasticity_rhs.hpp>
 
 namespace polyfem
@@ -8,6 +9,23 @@ namespace polyfem
 
 	namespace assembler
 	{
+		namespace
+		{
+			template <int dim>
+			struct LinearElasticityMaterial
+			{
+				const LameParameters &params;
+				const NonLinearAssemblerData &data;
+
+				double operator()(const int p, const double *grad_u, double *P, double *C) const
+				{
+					double lambda, mu;
+					params.lambda_mu(data.vals.quadrature.points.row(p), data.vals.val.row(p), data.vals.element_id, lambda, mu);
+					return kernels::linear_elasticity<dim>(lambda, mu, grad_u, P, C);
+				}
+			};
+		} // namespace
+
 		void LinearElasticity::add_multimaterial(const int index, const json &params)
 		{
 			assert(size() == 2 || size() == 3);
@@ -50,6 +68,30 @@ namespace polyfem
 			return res;
 		}
 
+		Eigen::Matrix<double, Eigen::Dynamic, 1, 0, 9, 1>
+		LinearElasticity::assemble_affine(const AffineAssemblerData &data) const
+		{
+			// same as assemble with outer = int gradi' gradj
+			const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, 0, 3, 3> outer = data.gradient_outer();
+			const double dot = outer.trace();
+
+			double lambda, mu;
+			params_.lambda_mu(data.vals.quadrature.points.row(0), data.vals.val.row(0), data.vals.element_id, lambda, mu);
+
+			Eigen::Matrix<double, Eigen::Dynamic, 1, 0, 9, 1> res(size() * size());
+			for (int ii = 0; ii < size(); ++ii)
+			{
+				for (int jj = 0; jj < size(); ++jj)
+				{
+					res(jj * size() + ii) = outer(ii * size() + jj) * mu + outer(jj * size() + ii) * lambda;
+					if (ii == jj)
+						res(jj * size() + ii) += mu * dot;
+				}
+			}
+
+			return res;
+		}
+
 		double LinearElasticity::compute_energy(const NonLinearAssemblerData &data) const
 		{
 			return compute_energy_aux<double>(data);
@@ -58,36 +100,54 @@ namespace polyfem
 		Eigen::VectorXd LinearElasticity::assemble_gradient(const NonLinearAssemblerData &data) const
 		{
 			const int n_bases = data.vals.basis_values.size();
-			return polyfem::gradient_from_energy(
-				size(), n_bases, data,
-				[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, 6, 1>>>(data); },
-				[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, 8, 1>>>(data); },
-				[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, 12, 1>>>(data); },
-				[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, 18, 1>>>(data); },
-				[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, 24, 1>>>(data); },
-				[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, 30, 1>>>(data); },
-				[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, 60, 1>>>(data); },
-				[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, 81, 1>>>(data); },
-				[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, Eigen::Dynamic, 1, 0, SMALL_N, 1>>>(data); },
-				[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, Eigen::Dynamic, 1, 0, BIG_N, 1>>>(data); },
-				[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::VectorXd>>(data); });
+			Eigen::VectorXd grads, local_disp;
+			flatten_element_data(data, size(), grads, local_disp);
+
+			Eigen::VectorXd res(n_bases * size());
+			if (size() == 2)
+				kernels::element_gradient<2>(n_bases, data.da.size(), grads.data(), data.da.data(), local_disp.data(), LinearElasticityMaterial<2>{params_, data}, res.data());
+			else
+				kernels::element_gradient<3>(n_bases, data.da.size(), grads.data(), data.da.data(), local_disp.data(), LinearElasticityMaterial<3>{params_, data}, res.data());
+			return res;
 		}
 
 		Eigen::MatrixXd LinearElasticity::assemble_hessian(const NonLinearAssemblerData &data) const
 		{
 			const int n_bases = data.vals.basis_values.size();
-			return polyfem::hessian_from_energy(
-				size(), n_bases, data,
-				[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::Matrix<double, 6, 1>, Eigen::Matrix<double, 6, 6>>>(data); },
-				[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::Matrix<double, 8, 1>, Eigen::Matrix<double, 8, 8>>>(data); },
-				[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::Matrix<double, 12, 1>, Eigen::Matrix<double, 12, 12>>>(data); },
-				[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::Matrix<double, 18, 1>, Eigen::Matrix<double, 18, 18>>>(data); },
-				[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::Matrix<double, 24, 1>, Eigen::Matrix<double, 24, 24>>>(data); },
-				[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::Matrix<double, 30, 1>, Eigen::Matrix<double, 30, 30>>>(data); },
-				[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::Matrix<double, 60, 1>, Eigen::Matrix<double, 60, 60>>>(data); },
-				[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::Matrix<double, 81, 1>, Eigen::Matrix<double, 81, 81>>>(data); },
-				[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::Matrix<double, Eigen::Dynamic, 1, 0, SMALL_N, 1>, Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, 0, SMALL_N, SMALL_N>>>(data); },
-				[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::VectorXd, Eigen::MatrixXd>>(data); });
+			Eigen::VectorXd grads, local_disp;
+			flatten_element_data(data, size(), grads, local_disp);
+
+			// the kernels write row major
+			Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> res(n_bases * size(), n_bases * size());
+			if (size() == 2)
+				kernels::element_hessian<2>(n_bases, data.da.size(), grads.data(), data.da.data(), local_disp.data(), LinearElasticityMaterial<2>{params_, data}, res.data());
+			else
+				kernels::element_hessian<3>(n_bases, data.da.size(), grads.data(), data.da.data(), local_disp.data(), LinearElasticityMaterial<3>{params_, data}, res.data());
+			return res;
+		}
+
+		void LinearElasticity::compute_energy_gradient_hessian(const NonLinearAssemblerData &data, double *energy, Eigen::VectorXd *gradient, Eigen::MatrixXd *hessian) const
+		{
+			const int n_bases = data.vals.basis_values.size();
+			Eigen::VectorXd grads, local_disp;
+			flatten_element_data(data, size(), grads, local_disp);
+
+			// the kernels write row major
+			Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> hess;
+			if (gradient)
+				gradient->resize(n_bases * size());
+			if (hessian)
+				hess.resize(n_bases * size(), n_bases * size());
+			double *gradient_data = gradient ? gradient->data() : nullptr;
+			double *hessian_data = hessian ? hess.data() : nullptr;
+
+			if (size() == 2)
+				kernels::element_energy_gradient_hessian<2>(n_bases, data.da.size(), grads.data(), data.da.data(), local_disp.data(), LinearElasticityMaterial<2>{params_, data}, energy, gradient_data, hessian_data);
+			else
+				kernels::element_energy_gradient_hessian<3>(n_bases, data.da.size(), grads.data(), data.da.data(), local_disp.data(), LinearElasticityMaterial<3>{params_, data}, energy, gradient_data, hessian_data);
+
+			if (hessian)
+				*hessian = hess;
 		}
 
 		// Compute \int mu eps : eps + lambda/2 tr(eps)^2 = \int mu tr(eps^2) + lambda/2 tr(eps)^2
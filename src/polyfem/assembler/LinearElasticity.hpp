@@ -22,12 +22,18 @@ namespace polyfem::assembler
 		Eigen::Matrix<double, Eigen::Dynamic, 1, 0, 9, 1>
 		assemble(const LinearAssemblerData &data) const override;
 
+		// constant lambda and mu on the element
+		bool has_affine_assembly(const int el_id) const override { return params_.is_element_constant(el_id); }
+		Eigen::Matrix<double, Eigen::Dynamic, 1, 0, 9, 1> assemble_affine(const AffineAssemblerData &data) const override;
+
 		// compute elastic energy
 		double compute_energy(const NonLinearAssemblerData &data) const override;
 		// neccessary for mixing linear model with non-linear collision response
 		Eigen::MatrixXd assemble_hessian(const NonLinearAssemblerData &data) const override;
 		// compute gradient of elastic energy, as assembler
 		Eigen::VectorXd assemble_gradient(const NonLinearAssemblerData &data) const override;
+		// energy, gradient, and hessian with one evaluation of the stress per quadrature point
+		void compute_energy_gradient_hessian(const NonLinearAssemblerData &data, double *energy, Eigen::VectorXd *gradient, Eigen::MatrixXd *hessian) const override;
 
 		// kernel of the pde, used in kernel problem
 		Eigen::Matrix<AutodiffScalarGrad, Eigen::Dynamic, 1, 0, 3, 1> kernel(const int dim, const AutodiffGradPt &r, const AutodiffScalarGrad &) const override;
@@ -43,6 +49,7 @@ namespace polyfem::assembler
 		// class that stores and compute lame parameters per point
 		const LameParameters &lame_params() const { return params_; }
 		void set_params(const LameParameters &params) { params_ = params; }
+		bool has_time_dependent_parameters() const override { return params_.is_time_dependent(); }
 
 		virtual bool is_linear() const override { return true; }
 
@@ -19,6 +19,19 @@ namespace polyfem::assembler
 		return res;
 	}
 
+	Eigen::Matrix<double, Eigen::Dynamic, 1, 0, 9, 1> Mass::assemble_affine(const AffineAssemblerData &data) const
+	{
+		const double rho = density_(data.vals.quadrature.points.row(0), data.vals.val.row(0), data.vals.element_id);
+		const double tmp = rho * data.mass();
+
+		Eigen::Matrix<double, Eigen::Dynamic, 1, 0, 9, 1> res(size() * size(), 1);
+		res.setZero();
+		for (int i = 0; i < size(); ++i)
+			res(i * size() + i) = tmp;
+
+		return res;
+	}
+
 	Eigen::Matrix<double, Eigen::Dynamic, 1, 0, 3, 1> Mass::compute_rhs(const AutodiffHessianPt &pt) const
 	{
 		assert(false);
@@ -15,6 +15,10 @@ namespace polyfem::assembler
 		Eigen::Matrix<double, Eigen::Dynamic, 1, 0, 9, 1>
 		assemble(const LinearAssemblerData &data) const override;
 
+		// constant density on the element
+		bool has_affine_assembly(const int el_id) const override { return density_.is_element_constant(el_id); }
+		Eigen::Matrix<double, Eigen::Dynamic, 1, 0, 9, 1> assemble_affine(const AffineAssemblerData &data) const override;
+
 		// uses autodiff to compute the rhs for a fabricated solution
 		// in this case it just return pt.getHessian().trace()
 		// pt is the evaluation of the solution at a point
@@ -2,10 +2,17 @@
 
 #include <polyfem/utils/JSONUtils.hpp>
 
+#include <algorithm>
+
 namespace polyfem::assembler
 {
 	namespace
 	{
+		bool any_time_dependent(const std::vector<utils::ExpressionValue> &values)
+		{
+			return std::any_of(values.begin(), values.end(), [](const utils::ExpressionValue &v) { return v.is_time_dependent(); });
+		}
+
 		double convert_to_lambda(const bool is_volume, const double E, const double nu)
 		{
 			if (is_volume)
@@ -34,6 +41,18 @@ namespace polyfem::assembler
 
 		if (params.count(param_name_))
 			param_[index].init(params[param_name_]);
+
+		update_table(index);
+	}
+
+	void GenericMatParam::update_table(const int index)
+	{
+		is_tabulated_.resize(param_.size(), false);
+		table_.resize(param_.size(), 0);
+
+		is_tabulated_[index] = param_[index].is_constant();
+		if (is_tabulated_[index])
+			table_[index] = param_[index](0, 0, 0, 0, index);
 	}
 
 	double GenericMatParam::operator()(const RowVectorNd &p, double t, int index) const
@@ -49,9 +68,16 @@ namespace polyfem::assembler
 	{
 		assert(param_.size() == 1 || index < param_.size());
 
-		const auto &tmp_param = param_.size() == 1 ? param_[0] : param_[index];
+		const int i = param_.size() == 1 ? 0 : index;
+		if (i < is_tabulated_.size() && is_tabulated_[i])
+			return table_[i];
 
-		return tmp_param(x, y, z, t, index);
+		return param_[i](x, y, z, t, index);
+	}
+
+	bool GenericMatParam::is_time_dependent() const
+	{
+		return any_time_dependent(param_);
 	}
 
 	GenericMatParams::GenericMatParams(const std::string &param_name)
@@ -79,9 +105,15 @@ namespace polyfem::assembler
 			}
 
 			params_.at(i).param_[index].init(params_array[i]);
+			params_.at(i).update_table(index);
 		}
 	}
 
+	bool GenericMatParams::is_time_dependent() const
+	{
+		return std::any_of(params_.begin(), params_.end(), [](const GenericMatParam &p) { return p.is_time_dependent(); });
+	}
+
 	void ElasticityTensor::resize(const int size)
 	{
 		if (size == 2)
@@ -308,14 +340,40 @@ namespace polyfem::assembler
 		is_lambda_mu_ = true;
 	}
 
+	void LameParameters::update_table(const int index)
+	{
+		is_tabulated_.resize(lambda_or_E_.size(), false);
+		table_.resize(lambda_or_E_.size());
+
+		// the conversion needs the dimension
+		is_tabulated_[index] = size_ > 0 && lambda_or_E_[index].is_constant() && mu_or_nu_[index].is_constant();
+		if (!is_tabulated_[index])
+			return;
+
+		const double llambda = lambda_or_E_[index](0, 0, 0, 0, index);
+		const double mmu = mu_or_nu_[index](0, 0, 0, 0, index);
+		if (is_lambda_mu_)
+			table_[index] = {{llambda, mmu}};
+		else
+			table_[index] = {{convert_to_lambda(size_ == 3, llambda, mmu), convert_to_mu(llambda, mmu)}};
+	}
+
 	void LameParameters::lambda_mu(double px, double py, double pz, double x, double y, double z, int el_id, double &lambda, double &mu) const
 	{
 		assert(lambda_or_E_.size() == 1 || el_id < lambda_or_E_.size());
 		assert(mu_or_nu_.size() == 1 || el_id < mu_or_nu_.size());
 		assert(size_ == 2 || size_ == 3);
 
-		const auto &tmp1 = lambda_or_E_.size() == 1 ? lambda_or_E_[0] : lambda_or_E_[el_id];
-		const auto &tmp2 = mu_or_nu_.size() == 1 ? mu_or_nu_[0] : mu_or_nu_[el_id];
+		const int i = lambda_or_E_.size() == 1 ? 0 : el_id;
+		if (i < is_tabulated_.size() && is_tabulated_[i])
+		{
+			lambda = table_[i][0];
+			mu = table_[i][1];
+			return;
+		}
+
+		const auto &tmp1 = lambda_or_E_[i];
+		const auto &tmp2 = mu_or_nu_[i];
 
 		double llambda = tmp1(x, y, z, 0, el_id);
 		double mmu = tmp2(x, y, z, 0, el_id);
@@ -337,11 +395,25 @@ namespace polyfem::assembler
 		assert(!std::isinf(mu));
 	}
 
+	bool LameParameters::is_element_constant(const int el_id) const
+	{
+		const int i = lambda_or_E_.size() == 1 ? 0 : el_id;
+		if (i < is_tabulated_.size() && is_tabulated_[i])
+			return true;
+		return lambda_or_E_[i].is_index_only() && mu_or_nu_[i].is_index_only();
+	}
+
+	bool LameParameters::is_time_dependent() const
+	{
+		return any_time_dependent(lambda_or_E_) || any_time_dependent(mu_or_nu_);
+	}
+
 	void LameParameters::add_multimaterial(const int index, const json &params, const bool is_volume)
 	{
 		const int size = is_volume ? 3 : 2;
 		assert(size_ == -1 || size == size_);
 		size_ = size;
+		const bool was_lambda_mu = is_lambda_mu_;
 
 		for (int i = lambda_or_E_.size(); i <= index; ++i)
 		{
@@ -363,6 +435,15 @@ namespace polyfem::assembler
 			mu_or_nu_[index].init(params["mu"]);
 			is_lambda_mu_ = true;
 		}
+
+		// the conversion is shared by all the materials, a change invalidates the other entries
+		if (is_lambda_mu_ != was_lambda_mu || table_.empty())
+		{
+			for (int i = 0; i < lambda_or_E_.size(); ++i)
+				update_table(i);
+		}
+		else
+			update_table(index);
 	}
 
 	void LameParameters::set_e_nu(const int index, const json &E, const json &nu)
@@ -377,19 +458,31 @@ namespace polyfem::assembler
 	{
 		rho_.emplace_back();
 		rho_.back().init(1.0);
+		update_table(0);
 	}
 
 	double Density::operator()(double px, double py, double pz, double x, double y, double z, int el_id) const
 	{
 		assert(rho_.size() == 1 || el_id < rho_.size());
 
-		const auto &tmp = rho_.size() == 1 ? rho_[0] : rho_[el_id];
-		const double res = tmp(x, y, z, 0, el_id);
+		const int i = rho_.size() == 1 ? 0 : el_id;
+		if (i < is_tabulated_.size() && is_tabulated_[i])
+			return table_[i];
+
+		const double res = rho_[i](x, y, z, 0, el_id);
 		assert(!std::isnan(res));
 		assert(!std::isinf(res));
 		return res;
 	}
 
+	bool Density::is_element_constant(const int el_id) const
+	{
+		const int i = rho_.size() == 1 ? 0 : el_id;
+		if (i < is_tabulated_.size() && is_tabulated_[i])
+			return true;
+		return rho_[i].is_index_only();
+	}
+
 	void Density::add_multimaterial(const int index, const json &params)
 	{
 		for (int i = rho_.size(); i <= index; ++i)
@@ -405,6 +498,18 @@ namespace polyfem::assembler
 		{
 			rho_[index].init(params["density"]);
 		}
+
+		update_table(index);
+	}
+
+	void Density::update_table(const int index)
+	{
+		is_tabulated_.resize(rho_.size(), false);
+		table_.resize(rho_.size(), 0);
+
+		is_tabulated_[index] = rho_[index].is_constant();
+		if (is_tabulated_[index])
+			table_[index] = rho_[index](0, 0, 0, 0, index);
 	}
 
 	// template instantiation
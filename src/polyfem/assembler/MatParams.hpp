@@ -4,6 +4,8 @@
 #include <polyfem/utils/Types.hpp>
 #include <polyfem/utils/ExpressionValue.hpp>
 
+#include <array>
+
 namespace polyfem::assembler
 {
 	class GenericMatParam
@@ -15,10 +17,17 @@ namespace polyfem::assembler
 		double operator()(double x, double y, double z, double t, int index) const;
 
 		void add_multimaterial(const int index, const json &params);
+		// the parameter of a material changes with t
+		bool is_time_dependent() const;
 
 	private:
+		void update_table(const int index);
+
 		const std::string param_name_;
 		std::vector<utils::ExpressionValue> param_;
+		// values of the constant parameters, evaluated once
+		std::vector<bool> is_tabulated_;
+		std::vector<double> table_;
 
 		friend class GenericMatParams;
 	};
@@ -32,6 +41,8 @@ namespace polyfem::assembler
 		size_t size() const { return params_.size(); }
 
 		void add_multimaterial(const int index, const json &params);
+		// one of the parameters changes with t
+		bool is_time_dependent() const;
 
 	private:
 		const std::string param_name_;
@@ -72,7 +83,13 @@ namespace polyfem::assembler
 		void add_multimaterial(const int index, const json &params, const bool is_volume);
 
 		void lambda_mu(double px, double py, double pz, double x, double y, double z, int el_id, double &lambda, double &mu) const;
-		void lambda_mu(const Eigen::MatrixXd &param, const Eigen::MatrixXd &p, int el_id, double &lambda, double &mu) const
+		// lambda and mu are constant on the element
+		bool is_element_constant(const int el_id) const;
+		// lambda or mu of a material changes with t
+		bool is_time_dependent() const;
+		// templated so that the rows of the quadrature points are passed without copies
+		template <typename ParamDerived, typename PointDerived>
+		void lambda_mu(const Eigen::MatrixBase<ParamDerived> &param, const Eigen::MatrixBase<PointDerived> &p, int el_id, double &lambda, double &mu) const
 		{
 			assert(param.size() == 2 || param.size() == 3);
 			assert(param.size() == p.size());
@@ -84,10 +101,15 @@ namespace polyfem::assembler
 
 	private:
 		void set_e_nu(const int index, const json &E, const json &nu);
+		void update_table(const int index);
 
 		int size_;
 		std::vector<utils::ExpressionValue> lambda_or_E_, mu_or_nu_;
 		bool is_lambda_mu_;
+
+		// lambda and mu of the materials with constant parameters, converted once
+		std::vector<bool> is_tabulated_;
+		std::vector<std::array<double, 2>> table_;
 	};
 
 	class Density
@@ -98,6 +120,8 @@ namespace polyfem::assembler
 		void add_multimaterial(const int index, const json &params);
 
 		double operator()(double px, double py, double pz, double x, double y, double z, int el_id) const;
+		// the density is constant on the element
+		bool is_element_constant(const int el_id) const;
 		double operator()(const Eigen::MatrixXd &param, const Eigen::MatrixXd &p, int el_id) const
 		{
 			assert(param.size() == 2 || param.size() == 3);
@@ -109,7 +133,11 @@ namespace polyfem::assembler
 
 	private:
 		void set_rho(const json &rho);
+		void update_table(const int index);
 
 		std::vector<utils::ExpressionValue> rho_;
+		// densities of the materials with constant rho, evaluated once
+		std::vector<bool> is_tabulated_;
+		std::vector<double> table_;
 	};
 } // namespace polyfem::assembler
\ No newline at end of file
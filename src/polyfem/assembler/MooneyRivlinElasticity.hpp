@@ -13,6 +13,7 @@ namespace polyfem::assembler
 
 		// sets material params
 		void add_multimaterial(const int index, const json &params) override;
+		bool has_time_dependent_parameters() const override { return c1_.is_time_dependent() || c2_.is_time_dependent() || k_.is_time_dependent(); }
 
 		const GenericMatParam &c1() const { return c1_; }
 		const GenericMatParam &c2() const { return c2_; }
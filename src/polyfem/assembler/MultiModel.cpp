@@ -1,5 +1,10 @@
 #include "MultiModel.hpp"
 
+#include <polyfem/utils/Logger.hpp>
+
+#include <array>
+#include <map>
+
 // #include <polyfem/basis/Basis.hpp>
 // #include <polyfem/autogen/auto_elasticity_rhs.hpp>
 
@@ -45,28 +50,68 @@ namespace polyfem::assembler
 		return res;
 	}
 
+	bool MultiModel::has_time_dependent_parameters() const
+	{
+		return saint_venant_.has_time_dependent_parameters()
+			   || neo_hookean_.has_time_dependent_parameters()
+			   || linear_elasticity_.has_time_dependent_parameters()
+			   || hooke_.has_time_dependent_parameters()
+			   || mooney_rivlin_elasticity_.has_time_dependent_parameters()
+			   || unconstrained_ogden_elasticity_.has_time_dependent_parameters()
+			   || incompressible_ogden_elasticity_.has_time_dependent_parameters();
+	}
+
+	void MultiModel::init_multimodels(const std::vector<std::string> &mats)
+	{
+		static const std::map<std::string, Model> names = {
+			{"SaintVenant", Model::SAINT_VENANT},
+			{"NeoHookean", Model::NEO_HOOKEAN},
+			{"LinearElasticity", Model::LINEAR_ELASTICITY},
+			{"HookeLinearElasticity", Model::HOOKE_LINEAR_ELASTICITY},
+			{"MooneyRivlin", Model::MOONEY_RIVLIN},
+			{"UnconstrainedOgden", Model::UNCONSTRAINED_OGDEN},
+			{"IncompressibleOgden", Model::INCOMPRESSIBLE_OGDEN}};
+
+		multi_material_models_.resize(mats.size());
+		std::array<int, int(Model::N_MODELS) + 1> offsets;
+		offsets.fill(0);
+		for (int e = 0; e < mats.size(); ++e)
+		{
+			const auto it = names.find(mats[e]);
+			if (it == names.end())
+				log_and_throw_error("Unknown material model {}", mats[e]);
+			multi_material_models_[e] = it->second;
+			++offsets[int(it->second) + 1];
+		}
+
+		// stable bucket sort, the elements of a model are consecutive and keep their order
+		for (int m = 0; m < int(Model::N_MODELS); ++m)
+			offsets[m + 1] += offsets[m];
+		element_order_.resize(mats.size());
+		for (int e = 0; e < mats.size(); ++e)
+			element_order_[offsets[int(multi_material_models_[e])]++] = e;
+	}
+
 	Eigen::VectorXd
 	MultiModel::assemble_gradient(const NonLinearAssemblerData &data) const
 	{
-		const int el_id = data.vals.element_id;
-		const std::string model = multi_material_models_[el_id];
-
-		if (model == "SaintVenant")
-			return saint_venant_.assemble_gradient(data);
-		else if (model == "NeoHookean")
-			return neo_hookean_.assemble_gradient(data);
-		else if (model == "LinearElasticity")
-			return linear_elasticity_.assemble_gradient(data);
-		else if (model == "HookeLinearElasticity")
-			return hooke_.assemble_gradient(data);
-		else if (model == "MooneyRivlin")
-			return mooney_rivlin_elasticity_.assemble_gradient(data);
-		else if (model == "UnconstrainedOgden")
-			return unconstrained_ogden_elasticity_.assemble_gradient(data);
-		else if (model == "IncompressibleOgden")
-			return incompressible_ogden_elasticity_.assemble_gradient(data);
-		else
+		switch (multi_material_models_[data.vals.element_id])
 		{
+		case Model::SAINT_VENANT:
+			return saint_venant_.SaintVenantElasticity::assemble_gradient(data);
+		case Model::NEO_HOOKEAN:
+			return neo_hookean_.NeoHookeanElasticity::assemble_gradient(data);
+		case Model::LINEAR_ELASTICITY:
+			return linear_elasticity_.LinearElasticity::assemble_gradient(data);
+		case Model::HOOKE_LINEAR_ELASTICITY:
+			return hooke_.HookeLinearElasticity::assemble_gradient(data);
+		case Model::MOONEY_RIVLIN:
+			return mooney_rivlin_elasticity_.MooneyRivlinElasticity::assemble_gradient(data);
+		case Model::UNCONSTRAINED_OGDEN:
+			return unconstrained_ogden_elasticity_.UnconstrainedOgdenElasticity::assemble_gradient(data);
+		case Model::INCOMPRESSIBLE_OGDEN:
+			return incompressible_ogden_elasticity_.IncompressibleOgdenElasticity::assemble_gradient(data);
+		default:
 			assert(false);
 			return Eigen::VectorXd(0, 0);
 		}
@@ -75,25 +120,23 @@ namespace polyfem::assembler
 	Eigen::MatrixXd
 	MultiModel::assemble_hessian(const NonLinearAssemblerData &data) const
 	{
-		const int el_id = data.vals.element_id;
-		const std::string model = multi_material_models_[el_id];
-
-		if (model == "SaintVenant")
-			return saint_venant_.assemble_hessian(data);
-		else if (model == "NeoHookean")
-			return neo_hookean_.assemble_hessian(data);
-		else if (model == "LinearElasticity")
-			return linear_elasticity_.assemble_hessian(data);
-		else if (model == "HookeLinearElasticity")
-			return hooke_.assemble_hessian(data);
-		else if (model == "MooneyRivlin")
-			return mooney_rivlin_elasticity_.assemble_hessian(data);
-		else if (model == "UnconstrainedOgden")
-			return unconstrained_ogden_elasticity_.assemble_hessian(data);
-		else if (model == "IncompressibleOgden")
-			return incompressible_ogden_elasticity_.assemble_hessian(data);
-		else
+		switch (multi_material_models_[data.vals.element_id])
 		{
+		case Model::SAINT_VENANT:
+			return saint_venant_.SaintVenantElasticity::assemble_hessian(data);
+		case Model::NEO_HOOKEAN:
+			return neo_hookean_.NeoHookeanElasticity::assemble_hessian(data);
+		case Model::LINEAR_ELASTICITY:
+			return linear_elasticity_.LinearElasticity::assemble_hessian(data);
+		case Model::HOOKE_LINEAR_ELASTICITY:
+			return hooke_.HookeLinearElasticity::assemble_hessian(data);
+		case Model::MOONEY_RIVLIN:
+			return mooney_rivlin_elasticity_.MooneyRivlinElasticity::assemble_hessian(data);
+		case Model::UNCONSTRAINED_OGDEN:
+			return unconstrained_ogden_elasticity_.UnconstrainedOgdenElasticity::assemble_hessian(data);
+		case Model::INCOMPRESSIBLE_OGDEN:
+			return incompressible_ogden_elasticity_.IncompressibleOgdenElasticity::assemble_hessian(data);
+		default:
 			assert(false);
 			return Eigen::MatrixXd(0, 0);
 		}
@@ -101,25 +144,23 @@ namespace polyfem::assembler
 
 	double MultiModel::compute_energy(const NonLinearAssemblerData &data) const
 	{
-		const int el_id = data.vals.element_id;
-		const std::string model = multi_material_models_[el_id];
-
-		if (model == "SaintVenant")
-			return saint_venant_.compute_energy(data);
-		else if (model == "NeoHookean")
-			return neo_hookean_.compute_energy(data);
-		else if (model == "LinearElasticity")
-			return linear_elasticity_.compute_energy(data);
-		else if (model == "HookeLinearElasticity")
-			return hooke_.compute_energy(data);
-		else if (model == "MooneyRivlin")
-			return mooney_rivlin_elasticity_.compute_energy(data);
-		else if (model == "UnconstrainedOgden")
-			return unconstrained_ogden_elasticity_.compute_energy(data);
-		else if (model == "IncompressibleOgden")
-			return incompressible_ogden_elasticity_.compute_energy(data);
-		else
+		switch (multi_material_models_[data.vals.element_id])
 		{
+		case Model::SAINT_VENANT:
+			return saint_venant_.SaintVenantElasticity::compute_energy(data);
+		case Model::NEO_HOOKEAN:
+			return neo_hookean_.NeoHookeanElasticity::compute_energy(data);
+		case Model::LINEAR_ELASTICITY:
+			return linear_elasticity_.LinearElasticity::compute_energy(data);
+		case Model::HOOKE_LINEAR_ELASTICITY:
+			return hooke_.HookeLinearElasticity::compute_energy(data);
+		case Model::MOONEY_RIVLIN:
+			return mooney_rivlin_elasticity_.MooneyRivlinElasticity::compute_energy(data);
+		case Model::UNCONSTRAINED_OGDEN:
+			return unconstrained_ogden_elasticity_.UnconstrainedOgdenElasticity::compute_energy(data);
+		case Model::INCOMPRESSIBLE_OGDEN:
+			return incompressible_ogden_elasticity_.IncompressibleOgdenElasticity::compute_energy(data);
+		default:
 			assert(false);
 			return 0;
 		}
@@ -127,24 +168,30 @@ namespace polyfem::assembler
 
 	void MultiModel::assign_stress_tensor(const int el_id, const basis::ElementBases &bs, const basis::ElementBases &gbs, const Eigen::MatrixXd &local_pts, const Eigen::MatrixXd &displacement, const int all_size, const ElasticityTensorType &type, Eigen::MatrixXd &all, const std::function<Eigen::MatrixXd(const Eigen::MatrixXd &)> &fun) const
 	{
-		const std::string model = multi_material_models_[el_id];
-
-		if (model == "SaintVenant")
+		switch (multi_material_models_[el_id])
+		{
+		case Model::SAINT_VENANT:
 			saint_venant_.assign_stress_tensor(el_id, bs, gbs, local_pts, displacement, all_size, type, all, fun);
-		else if (model == "NeoHookean")
+			break;
+		case Model::NEO_HOOKEAN:
 			neo_hookean_.assign_stress_tensor(el_id, bs, gbs, local_pts, displacement, all_size, type, all, fun);
-		else if (model == "LinearElasticity")
+			break;
+		case Model::LINEAR_ELASTICITY:
 			linear_elasticity_.assign_stress_tensor(el_id, bs, gbs, local_pts, displacement, all_size, type, all, fun);
-		else if (model == "HookeLinearElasticity")
-			return hooke_.assign_stress_tensor(el_id, bs, gbs, local_pts, displacement, all_size, type, all, fun);
-		else if (model == "MooneyRivlin")
-			return mooney_rivlin_elasticity_.assign_stress_tensor(el_id, bs, gbs, local_pts, displacement, all_size, type, all, fun);
-		else if (model == "UnconstrainedOgden")
-			return unconstrained_ogden_elasticity_.assign_stress_tensor(el_id, bs, gbs, local_pts, displacement, all_size, type, all, fun);
-		else if (model == "IncompressibleOgden")
-			return incompressible_ogden_elasticity_.assign_stress_tensor(el_id, bs, gbs, local_pts, displacement, all_size, type, all, fun);
-		else
-		{
+			break;
+		case Model::HOOKE_LINEAR_ELASTICITY:
+			hooke_.assign_stress_tensor(el_id, bs, gbs, local_pts, displacement, all_size, type, all, fun);
+			break;
+		case Model::MOONEY_RIVLIN:
+			mooney_rivlin_elasticity_.assign_stress_tensor(el_id, bs, gbs, local_pts, displacement, all_size, type, all, fun);
+			break;
+		case Model::UNCONSTRAINED_OGDEN:
+			unconstrained_ogden_elasticity_.assign_stress_tensor(el_id, bs, gbs, local_pts, displacement, all_size, type, all, fun);
+			break;
+		case Model::INCOMPRESSIBLE_OGDEN:
+			incompressible_ogden_elasticity_.assign_stress_tensor(el_id, bs, gbs, local_pts, displacement, all_size, type, all, fun);
+			break;
+		default:
 			assert(false);
 		}
 	}
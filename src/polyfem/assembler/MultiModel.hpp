@@ -33,8 +33,13 @@ namespace polyfem::assembler
 
 		// inialize material parameter
 		void add_multimaterial(const int index, const json &params) override;
-		// initialized multi models
-		inline void init_multimodels(const std::vector<std::string> &mats) { multi_material_models_ = mats; }
+		// initialized multi models, groups the elements by model
+		void init_multimodels(const std::vector<std::string> &mats);
+		// any of the models, the unused ones have no material
+		bool has_time_dependent_parameters() const override;
+
+		// elements grouped by model, the element loops process one model at a time
+		const std::vector<int> &element_order() const override { return element_order_; }
 
 		std::string name() const override { return "MultiModels"; }
 		std::map<std::string, ParamFunc> parameters() const override;
@@ -43,7 +48,21 @@ namespace polyfem::assembler
 		void assign_stress_tensor(const int el_id, const basis::ElementBases &bs, const basis::ElementBases &gbs, const Eigen::MatrixXd &local_pts, const Eigen::MatrixXd &displacement, const int all_size, const ElasticityTensorType &type, Eigen::MatrixXd &all, const std::function<Eigen::MatrixXd(const Eigen::MatrixXd &)> &fun) const override;
 
 	private:
-		std::vector<std::string> multi_material_models_;
+		enum class Model
+		{
+			SAINT_VENANT,
+			NEO_HOOKEAN,
+			LINEAR_ELASTICITY,
+			HOOKE_LINEAR_ELASTICITY,
+			MOONEY_RIVLIN,
+			UNCONSTRAINED_OGDEN,
+			INCOMPRESSIBLE_OGDEN,
+			N_MODELS
+		};
+
+		// model of every element, resolved once from the material names
+		std::vector<Model> multi_material_models_;
+		std::vector<int> element_order_;
 
 		SaintVenantElasticity saint_venant_;
 		NeoHookeanElasticity neo_hookean_;
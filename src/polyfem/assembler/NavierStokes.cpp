@@ -1,5 +1,7 @@
 #include "NavierStokes.hpp"
 
+#include <array>
+
 namespace polyfem::assembler
 {
 
@@ -31,183 +33,139 @@ namespace polyfem::assembler
 		return res;
 	}
 
-	Eigen::VectorXd
-	NavierStokesVelocity::assemble_gradient(const NonLinearAssemblerData &data) const
+	namespace
 	{
-		assert(false);
-		return Eigen::VectorXd(data.vals.basis_values.size() * size());
-	}
-
-	Eigen::MatrixXd
-	NavierStokesVelocity::assemble_hessian(const NonLinearAssemblerData &data) const
-	{
-		Eigen::MatrixXd H;
-		if (full_gradient_)
-			H = compute_N(data) + compute_W(data);
-		else
-			H = compute_N(data);
-
-		return H.transpose();
-	}
-
-	// Compute N = int v \cdot \nabla phi_i \cdot \phi_j
+		/// @brief Convective term (u \cdot \nabla) u of one element, its Picard and full Jacobians, in one pass
+		/// The quadrature points are batched: with Phi(p, i) = phi_i(p) and A(p, i) = u(p) \cdot \nabla phi_i(p)
+		///     K = Phi^T diag(da) A,   K(j, i) = int phi_j u \cdot \nabla phi_i
+		/// is the Picard matrix of every component and the Newton term of the components n, m is
+		///     W_nm = Phi^T diag(da du_n/dx_m) Phi
+		/// @tparam DIM dimension of the problem
+		/// @tparam N_BASES number of bases of the element, Eigen::Dynamic for any (fixed for P2 triangles and tets)
+		/// @param[in] full_gradient add the Newton term to the Jacobian
+		/// @param[out] hessian Jacobian with the test dofs in the rows, nullptr to skip it
+		/// @param[out] residual int phi_j (u \cdot \nabla) u, nullptr to skip it
+		template <int DIM, int N_BASES>
+		void convective_kernel(const NonLinearAssemblerData &data, const bool full_gradient, Eigen::MatrixXd *hessian, Eigen::VectorXd *residual)
+		{
+			typedef Eigen::Matrix<double, Eigen::Dynamic, N_BASES> PointsMat;
 
-	Eigen::MatrixXd NavierStokesVelocity::compute_N(const NonLinearAssemblerData &data) const
-	{
-		typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, 0, 3, 3> GradMat;
+			assert(data.x.cols() == 1);
 
-		assert(data.x.cols() == 1);
+			const int n_pts = data.da.size();
+			const int n_bases = data.vals.basis_values.size();
+			assert(N_BASES == Eigen::Dynamic || N_BASES == n_bases);
 
-		const int n_pts = data.da.size();
-		const int n_bases = data.vals.basis_values.size();
+			Eigen::Matrix<double, N_BASES, DIM> local_vel(n_bases, DIM);
+			local_vel.setZero();
+			PointsMat phi(n_pts, n_bases);
+			std::array<PointsMat, DIM> grad_phi;
+			for (int c = 0; c < DIM; ++c)
+				grad_phi[c].resize(n_pts, n_bases);
 
-		Eigen::Matrix<double, Eigen::Dynamic, 1> local_vel(n_bases * size(), 1);
-		local_vel.setZero();
-		for (size_t i = 0; i < n_bases; ++i)
-		{
-			const auto &bs = data.vals.basis_values[i];
-			for (size_t ii = 0; ii < bs.global.size(); ++ii)
+			for (int i = 0; i < n_bases; ++i)
 			{
-				for (int d = 0; d < size(); ++d)
+				const auto &bs = data.vals.basis_values[i];
+				for (const auto &g : bs.global)
 				{
-					local_vel(i * size() + d) += bs.global[ii].val * data.x(bs.global[ii].index * size() + d);
+					for (int d = 0; d < DIM; ++d)
+						local_vel(i, d) += g.val * data.x(g.index * DIM + d);
 				}
-			}
-		}
 
-		Eigen::MatrixXd N(size() * n_bases, size() * n_bases);
-		N.setZero();
+				phi.col(i) = bs.val;
+				for (int c = 0; c < DIM; ++c)
+					grad_phi[c].col(i) = bs.grad_t_m.col(c);
+			}
 
-		GradMat grad_i(size(), size());
-		GradMat jac_it(size(), size());
+			// velocity at the quadrature points and u \cdot \nabla phi_i
+			const Eigen::Matrix<double, Eigen::Dynamic, DIM> vel = phi * local_vel;
+			PointsMat advected = vel.col(0).asDiagonal() * grad_phi[0];
+			for (int c = 1; c < DIM; ++c)
+				advected += vel.col(c).asDiagonal() * grad_phi[c];
 
-		Eigen::VectorXd vel(size(), 1);
-		Eigen::Matrix<double, Eigen::Dynamic, 1, 0, 3, 1> phi_j(size(), 1);
+			const PointsMat phi_da = data.da.asDiagonal() * phi;
+			const Eigen::Matrix<double, N_BASES, N_BASES> picard = phi_da.transpose() * advected;
 
-		for (long p = 0; p < n_pts; ++p)
-		{
-			vel.setZero();
-
-			for (size_t i = 0; i < n_bases; ++i)
+			if (residual)
 			{
-				const auto &bs = data.vals.basis_values[i];
-				const double val = bs.val(p);
-
-				for (int d = 0; d < size(); ++d)
+				const Eigen::Matrix<double, N_BASES, DIM> res = picard * local_vel;
+				residual->resize(n_bases * DIM);
+				for (int j = 0; j < n_bases; ++j)
 				{
-					vel(d) += val * local_vel(i * size() + d);
+					for (int n = 0; n < DIM; ++n)
+						(*residual)(j * DIM + n) = res(j, n);
 				}
 			}
 
-			for (long k = 0; k < jac_it.size(); ++k)
-				jac_it(k) = data.vals.jac_it[p](k);
+			if (!hessian)
+				return;
 
-			for (int i = 0; i < n_bases; ++i)
+			Eigen::MatrixXd &H = *hessian;
+			H.setZero(n_bases * DIM, n_bases * DIM);
+			for (int j = 0; j < n_bases; ++j)
 			{
-				const auto &bi = data.vals.basis_values[i];
-				for (int m = 0; m < size(); ++m)
+				for (int i = 0; i < n_bases; ++i)
 				{
-					grad_i.setZero();
-					grad_i.row(m) = bi.grad.row(p);
-					grad_i = grad_i * jac_it;
-
-					for (int j = 0; j < n_bases; ++j)
-					{
-						const auto &bj = data.vals.basis_values[j];
-						for (int n = 0; n < size(); ++n)
-						{
-							phi_j.setZero();
-							phi_j(n) = bj.val(p);
-							N(i * size() + m, j * size() + n) += (grad_i * vel).dot(phi_j) * data.da(p);
-						}
-					}
+					for (int n = 0; n < DIM; ++n)
+						H(j * DIM + n, i * DIM + n) = picard(j, i);
 				}
 			}
-		}
-
-		return N;
-	}
-
-	// Compute N = int phi_j \cdot \nabla v \cdot \phi_j
-
-	Eigen::MatrixXd NavierStokesVelocity::compute_W(const NonLinearAssemblerData &data) const
-	{
-		typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, 0, 3, 3> GradMat;
 
-		assert(data.x.cols() == 1);
+			if (!full_gradient)
+				return;
 
-		const int n_pts = data.da.size();
-		const int n_bases = data.vals.basis_values.size();
-
-		Eigen::Matrix<double, Eigen::Dynamic, 1> local_vel(n_bases * size(), 1);
-		local_vel.setZero();
-		for (size_t i = 0; i < n_bases; ++i)
-		{
-			const auto &bs = data.vals.basis_values[i];
-			for (size_t ii = 0; ii < bs.global.size(); ++ii)
+			for (int m = 0; m < DIM; ++m)
 			{
-				for (int d = 0; d < size(); ++d)
+				// du/dx_m at the quadrature points
+				const Eigen::Matrix<double, Eigen::Dynamic, DIM> grad_vel = grad_phi[m] * local_vel;
+				for (int n = 0; n < DIM; ++n)
 				{
-					local_vel(i * size() + d) += bs.global[ii].val * data.x(bs.global[ii].index * size() + d);
+					const Eigen::Matrix<double, N_BASES, N_BASES> w = phi_da.transpose() * grad_vel.col(n).asDiagonal() * phi;
+					for (int j = 0; j < n_bases; ++j)
+					{
+						for (int i = 0; i < n_bases; ++i)
+							H(j * DIM + n, i * DIM + m) += w(j, i);
+					}
 				}
 			}
 		}
 
-		Eigen::MatrixXd W(size() * n_bases, size() * n_bases);
-		W.setZero();
-
-		GradMat grad_v(size(), size());
-		GradMat jac_it(size(), size());
-
-		Eigen::Matrix<double, Eigen::Dynamic, 1, 0, 3, 1> phi_i(size(), 1);
-		Eigen::Matrix<double, Eigen::Dynamic, 1, 0, 3, 1> phi_j(size(), 1);
-
-		for (long p = 0; p < n_pts; ++p)
+		/// dispatches to the fixed size kernels of P2 triangles (6 bases) and tets (10 bases)
+		void convective_term(const int dim, const NonLinearAssemblerData &data, const bool full_gradient, Eigen::MatrixXd *hessian, Eigen::VectorXd *residual)
 		{
-			grad_v.setZero();
-
-			for (size_t i = 0; i < n_bases; ++i)
+			const int n_bases = data.vals.basis_values.size();
+			if (dim == 2)
 			{
-				const auto &bs = data.vals.basis_values[i];
-				const Eigen::Matrix<double, Eigen::Dynamic, 1, 0, 3, 1> grad = bs.grad.row(p);
-				assert(grad.size() == size());
-
-				for (int d = 0; d < size(); ++d)
-				{
-					for (int c = 0; c < size(); ++c)
-					{
-						grad_v(d, c) += grad(c) * local_vel(i * size() + d);
-					}
-				}
+				if (n_bases == 6)
+					convective_kernel<2, 6>(data, full_gradient, hessian, residual);
+				else
+					convective_kernel<2, Eigen::Dynamic>(data, full_gradient, hessian, residual);
 			}
-
-			for (long k = 0; k < jac_it.size(); ++k)
-				jac_it(k) = data.vals.jac_it[p](k);
-			grad_v = (grad_v * jac_it).eval();
-
-			for (int i = 0; i < n_bases; ++i)
+			else
 			{
-				const auto &bi = data.vals.basis_values[i];
-				for (int m = 0; m < size(); ++m)
-				{
-					phi_i.setZero();
-					phi_i(m) = bi.val(p);
-
-					for (int j = 0; j < n_bases; ++j)
-					{
-						const auto &bj = data.vals.basis_values[j];
-						for (int n = 0; n < size(); ++n)
-						{
-							phi_j.setZero();
-							phi_j(n) = bj.val(p);
-							W(i * size() + m, j * size() + n) += (grad_v * phi_i).dot(phi_j) * data.da(p);
-						}
-					}
-				}
+				assert(dim == 3);
+				if (n_bases == 10)
+					convective_kernel<3, 10>(data, full_gradient, hessian, residual);
+				else
+					convective_kernel<3, Eigen::Dynamic>(data, full_gradient, hessian, residual);
 			}
 		}
+	} // namespace
 
-		return W;
+	Eigen::VectorXd
+	NavierStokesVelocity::assemble_gradient(const NonLinearAssemblerData &data) const
+	{
+		Eigen::VectorXd res;
+		convective_term(size(), data, full_gradient_, nullptr, &res);
+		return res;
+	}
+
+	Eigen::MatrixXd
+	NavierStokesVelocity::assemble_hessian(const NonLinearAssemblerData &data) const
+	{
+		Eigen::MatrixXd H;
+		convective_term(size(), data, full_gradient_, &H, nullptr);
+		return H;
 	}
 
 	std::map<std::string, Assembler::ParamFunc> NavierStokesVelocity::parameters() const
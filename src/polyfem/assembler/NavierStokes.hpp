@@ -25,7 +25,7 @@ namespace polyfem::assembler
 		}
 
 		// res is R^{dim²}
-		// pde
+		// convective term int phi_j (u \cdot \nabla) u of the pde
 		Eigen::VectorXd
 		assemble_gradient(const NonLinearAssemblerData &data) const override;
 
@@ -48,9 +48,6 @@ namespace polyfem::assembler
 
 		// not full graidnet used for Picard iteration
 		bool full_gradient_ = true;
-
-		Eigen::MatrixXd compute_N(const NonLinearAssemblerData &data) const;
-		Eigen::MatrixXd compute_W(const NonLinearAssemblerData &data) const;
 	};
 
 } // namespace polyfem::assembler
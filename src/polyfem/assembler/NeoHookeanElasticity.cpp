@@ -2,6 +2,8 @@
 
 #include <polyfem/autogen/auto_elasticity_rhs.hpp>
 
+#include <array>
+
 namespace polyfem::assembler
 {
 	NeoHookeanElasticity::NeoHookeanElasticity()
@@ -38,8 +40,13 @@ namespace polyfem::assembler
 	Eigen::VectorXd
 	NeoHookeanElasticity::assemble_gradient(const NonLinearAssemblerData &data) const
 	{
-		Eigen::Matrix<double, Eigen::Dynamic, 1> gradient;
+		Eigen::VectorXd gradient;
+		assemble_gradient(data, gradient);
+		return gradient;
+	}
 
+	void NeoHookeanElasticity::assemble_gradient(const NonLinearAssemblerData &data, Eigen::VectorXd &gradient) const
+	{
 		if (size() == 2)
 		{
 			switch (data.vals.basis_values.size())
@@ -50,6 +57,12 @@ namespace polyfem::assembler
 				compute_energy_aux_gradient_fast<3, 2>(data, gradient);
 				break;
 			}
+			case 4:
+			{
+				gradient.resize(8);
+				compute_energy_aux_gradient_fast<4, 2>(data, gradient);
+				break;
+			}
 			case 6:
 			{
 				gradient.resize(12);
@@ -81,6 +94,12 @@ namespace polyfem::assembler
 				compute_energy_aux_gradient_fast<4, 3>(data, gradient);
 				break;
 			}
+			case 8:
+			{
+				gradient.resize(24);
+				compute_energy_aux_gradient_fast<8, 3>(data, gradient);
+				break;
+			}
 			case 10:
 			{
 				gradient.resize(30);
@@ -101,15 +120,29 @@ namespace polyfem::assembler
 			}
 			}
 		}
-
-		return gradient;
 	}
 
 	Eigen::MatrixXd
 	NeoHookeanElasticity::assemble_hessian(const NonLinearAssemblerData &data) const
 	{
 		Eigen::MatrixXd hessian;
+		assemble_hessian(data, hessian);
+		return hessian;
+	}
 
+	void NeoHookeanElasticity::assemble_hessian(const NonLinearAssemblerData &data, Eigen::MatrixXd &hessian) const
+	{
+		assemble_hessian_aux(data, false, hessian);
+	}
+
+	bool NeoHookeanElasticity::assemble_projected_hessian(const NonLinearAssemblerData &data, Eigen::MatrixXd &hessian) const
+	{
+		assemble_hessian_aux(data, true, hessian);
+		return true;
+	}
+
+	void NeoHookeanElasticity::assemble_hessian_aux(const NonLinearAssemblerData &data, const bool project_to_psd, Eigen::MatrixXd &hessian) const
+	{
 		if (size() == 2)
 		{
 			switch (data.vals.basis_values.size())
@@ -118,28 +151,35 @@ namespace polyfem::assembler
 			{
 				hessian.resize(6, 6);
 				hessian.setZero();
-				compute_energy_hessian_aux_fast<3, 2>(data, hessian);
+				compute_energy_hessian_aux_fast<3, 2>(data, project_to_psd, hessian);
+				break;
+			}
+			case 4:
+			{
+				hessian.resize(8, 8);
+				hessian.setZero();
+				compute_energy_hessian_aux_fast<4, 2>(data, project_to_psd, hessian);
 				break;
 			}
 			case 6:
 			{
 				hessian.resize(12, 12);
 				hessian.setZero();
-				compute_energy_hessian_aux_fast<6, 2>(data, hessian);
+				compute_energy_hessian_aux_fast<6, 2>(data, project_to_psd, hessian);
 				break;
 			}
 			case 10:
 			{
 				hessian.resize(20, 20);
 				hessian.setZero();
-				compute_energy_hessian_aux_fast<10, 2>(data, hessian);
+				compute_energy_hessian_aux_fast<10, 2>(data, project_to_psd, hessian);
 				break;
 			}
 			default:
 			{
 				hessian.resize(data.vals.basis_values.size() * 2, data.vals.basis_values.size() * 2);
 				hessian.setZero();
-				compute_energy_hessian_aux_fast<Eigen::Dynamic, 2>(data, hessian);
+				compute_energy_hessian_aux_fast<Eigen::Dynamic, 2>(data, project_to_psd, hessian);
 				break;
 			}
 			}
@@ -153,34 +193,39 @@ namespace polyfem::assembler
 			{
 				hessian.resize(12, 12);
 				hessian.setZero();
-				compute_energy_hessian_aux_fast<4, 3>(data, hessian);
+				compute_energy_hessian_aux_fast<4, 3>(data, project_to_psd, hessian);
+				break;
+			}
+			case 8:
+			{
+				hessian.resize(24, 24);
+				hessian.setZero();
+				compute_energy_hessian_aux_fast<8, 3>(data, project_to_psd, hessian);
 				break;
 			}
 			case 10:
 			{
 				hessian.resize(30, 30);
 				hessian.setZero();
-				compute_energy_hessian_aux_fast<10, 3>(data, hessian);
+				compute_energy_hessian_aux_fast<10, 3>(data, project_to_psd, hessian);
 				break;
 			}
 			case 20:
 			{
 				hessian.resize(60, 60);
 				hessian.setZero();
-				compute_energy_hessian_aux_fast<20, 3>(data, hessian);
+				compute_energy_hessian_aux_fast<20, 3>(data, project_to_psd, hessian);
 				break;
 			}
 			default:
 			{
 				hessian.resize(data.vals.basis_values.size() * 3, data.vals.basis_values.size() * 3);
 				hessian.setZero();
-				compute_energy_hessian_aux_fast<Eigen::Dynamic, 3>(data, hessian);
+				compute_energy_hessian_aux_fast<Eigen::Dynamic, 3>(data, project_to_psd, hessian);
 				break;
 			}
 			}
 		}
-
-		return hessian;
 	}
 
 	void NeoHookeanElasticity::assign_stress_tensor(const int el_id, const basis::ElementBases &bs, const basis::ElementBases &gbs, const Eigen::MatrixXd &local_pts, const Eigen::MatrixXd &displacement, const int all_size, const ElasticityTensorType &type, Eigen::MatrixXd &all, const std::function<Eigen::MatrixXd(const Eigen::MatrixXd &)> &fun) const
@@ -260,120 +305,143 @@ namespace polyfem::assembler
 		return energy;
 	}
 
-	template <int dim>
-	Eigen::Matrix<double, dim, dim> hat(const Eigen::Matrix<double, dim, 1> &x)
+	namespace
 	{
+		// Deformation gradients of all the quadrature points of an element stored as structure of arrays,
+		// one row per component i * dim + j, so that the constitutive evaluation vectorizes across points.
+		// The kernels keep one batch per thread, the arrays are only reallocated when the number of points grows.
+		template <int n_basis, int dim>
+		struct QuadraturePointsBatch
+		{
+			typedef Eigen::Array<double, dim * dim, Eigen::Dynamic, Eigen::RowMajor> ComponentArray;
+			typedef Eigen::Array<double, 1, Eigen::Dynamic> PointArray;
 
-		Eigen::Matrix<double, dim, dim> prod;
-		prod.setZero();
-
-		prod(0, 1) = -x(2);
-		prod(0, 2) = x(1);
-		prod(1, 0) = x(2);
-		prod(1, 2) = -x(0);
-		prod(2, 0) = -x(1);
-		prod(2, 1) = x(0);
-
-		return prod;
-	}
-
-	template <int dim>
-	Eigen::Matrix<double, dim, 1> cross(const Eigen::Matrix<double, dim, 1> &x, const Eigen::Matrix<double, dim, 1> &y)
-	{
-
-		Eigen::Matrix<double, dim, 1> z;
-		z.setZero();
-
-		z(0) = x(1) * y(2) - x(2) * y(1);
-		z(1) = x(2) * y(0) - x(0) * y(2);
-		z(2) = x(0) * y(1) - x(1) * y(0);
-
-		return z;
-	}
-
-	template <int n_basis, int dim>
-	void NeoHookeanElasticity::compute_energy_aux_gradient_fast(const NonLinearAssemblerData &data, Eigen::Matrix<double, Eigen::Dynamic, 1> &G_flattened) const
-	{
-		assert(data.x.cols() == 1);
+			void compute(const NonLinearAssemblerData &data, const LameParameters &params)
+			{
+				assert(data.x.cols() == 1);
 
-		const int n_pts = data.da.size();
+				const int n_loc_bases = data.vals.basis_values.size();
+				const int n_pts = data.da.size();
 
-		Eigen::Matrix<double, n_basis, dim> local_disp(data.vals.basis_values.size(), size());
-		local_disp.setZero();
-		for (size_t i = 0; i < data.vals.basis_values.size(); ++i)
-		{
-			const auto &bs = data.vals.basis_values[i];
-			for (size_t ii = 0; ii < bs.global.size(); ++ii)
-			{
-				for (int d = 0; d < size(); ++d)
+				Eigen::Matrix<double, n_basis, dim> local_disp(n_loc_bases, dim);
+				local_disp.setZero();
+				for (size_t i = 0; i < n_loc_bases; ++i)
 				{
-					local_disp(i, d) += bs.global[ii].val * data.x(bs.global[ii].index * size() + d);
+					const auto &bs = data.vals.basis_values[i];
+					for (size_t ii = 0; ii < bs.global.size(); ++ii)
+					{
+						for (int d = 0; d < dim; ++d)
+						{
+							local_disp(i, d) += bs.global[ii].val * data.x(bs.global[ii].index * dim + d);
+						}
+					}
 				}
-			}
-		}
 
-		Eigen::Matrix<double, dim, dim> def_grad(size(), size());
+				grads.resize(n_pts);
+				F.resize(dim * dim, n_pts);
+				for (long p = 0; p < n_pts; ++p)
+				{
+					Eigen::Matrix<double, n_basis, dim> grad(n_loc_bases, dim);
+					for (size_t i = 0; i < n_loc_bases; ++i)
+						grad.row(i) = data.vals.basis_values[i].grad.row(p);
+
+					const Eigen::Matrix<double, dim, dim> jac_it = data.vals.jac_it[p];
+					grads[p] = grad * jac_it;
+
+					// Id + grad d
+					const Eigen::Matrix<double, dim, dim> def_grad = local_disp.transpose() * grads[p] + Eigen::Matrix<double, dim, dim>::Identity();
+					for (int d1 = 0; d1 < dim; ++d1)
+					{
+						for (int d2 = 0; d2 < dim; ++d2)
+							F(d1 * dim + d2, p) = def_grad(d1, d2);
+					}
+				}
 
-		Eigen::Matrix<double, n_basis, dim> G(data.vals.basis_values.size(), size());
-		G.setZero();
+				// cofactor matrix, dJ/dF
+				cof.resize(dim * dim, n_pts);
+				if constexpr (dim == 2)
+				{
+					cof.row(0) = F.row(3);
+					cof.row(1) = -F.row(2);
+					cof.row(2) = -F.row(1);
+					cof.row(3) = F.row(0);
+				}
+				else
+				{
+					for (int d1 = 0; d1 < dim; ++d1)
+					{
+						const int r1 = (d1 + 1) % dim, r2 = (d1 + 2) % dim;
+						for (int d2 = 0; d2 < dim; ++d2)
+						{
+							const int c1 = (d2 + 1) % dim, c2 = (d2 + 2) % dim;
+							cof.row(d1 * dim + d2) = F.row(r1 * dim + c1) * F.row(r2 * dim + c2) - F.row(r1 * dim + c2) * F.row(r2 * dim + c1);
+						}
+					}
+				}
 
-		for (long p = 0; p < n_pts; ++p)
-		{
-			Eigen::Matrix<double, n_basis, dim> grad(data.vals.basis_values.size(), size());
+				J = (F.topRows(dim) * cof.topRows(dim)).colwise().sum();
+				log_J = J.log();
 
-			for (size_t i = 0; i < data.vals.basis_values.size(); ++i)
-			{
-				grad.row(i) = data.vals.basis_values[i].grad.row(p);
+				lambda.resize(n_pts);
+				mu.resize(n_pts);
+				for (long p = 0; p < n_pts; ++p)
+					params.lambda_mu(data.vals.quadrature.points.row(p), data.vals.val.row(p), data.vals.element_id, lambda(p), mu(p));
 			}
 
-			Eigen::Matrix<double, dim, dim> jac_it = data.vals.jac_it[p];
-
-			// Id + grad d
-			def_grad = local_disp.transpose() * grad * jac_it + Eigen::Matrix<double, dim, dim>::Identity(size(), size());
-
-			const double J = def_grad.determinant();
-			const double log_det_j = log(J);
-
-			Eigen::Matrix<double, dim, dim> delJ_delF(size(), size());
-			delJ_delF.setZero();
-
-			if (dim == 2)
+			Eigen::Matrix<double, dim, dim> component_matrix(const ComponentArray &a, const long p) const
 			{
-
-				delJ_delF(0, 0) = def_grad(1, 1);
-				delJ_delF(0, 1) = -def_grad(1, 0);
-				delJ_delF(1, 0) = -def_grad(0, 1);
-				delJ_delF(1, 1) = def_grad(0, 0);
+				Eigen::Matrix<double, dim, dim> res;
+				for (int d1 = 0; d1 < dim; ++d1)
+				{
+					for (int d2 = 0; d2 < dim; ++d2)
+						res(d1, d2) = a(d1 * dim + d2, p);
+				}
+				return res;
 			}
 
-			else if (dim == 3)
-			{
+			// gradients of the bases in physical coordinates, per quadrature point
+			std::vector<Eigen::Matrix<double, n_basis, dim>> grads;
+			ComponentArray F, cof;
+			PointArray J, log_J;
+			PointArray lambda, mu;
 
-				Eigen::Matrix<double, dim, 1> u(def_grad.rows());
-				Eigen::Matrix<double, dim, 1> v(def_grad.rows());
-				Eigen::Matrix<double, dim, 1> w(def_grad.rows());
+			// scratch of the kernels
+			ComponentArray stress;
+			PointArray a, b;
+		};
 
-				u = def_grad.col(0);
-				v = def_grad.col(1);
-				w = def_grad.col(2);
+		// clamps the negative eigenvalues of the symmetric M to zero, a successful Cholesky factorization
+		// detects the (common) positive definite case without the eigendecomposition
+		template <int n>
+		void project_tangent_to_psd(Eigen::Matrix<double, n, n> &M)
+		{
+			if (Eigen::LLT<Eigen::Matrix<double, n, n>>(M).info() == Eigen::Success)
+				return;
 
-				delJ_delF.col(0) = cross<dim>(v, w);
-				delJ_delF.col(1) = cross<dim>(w, u);
-				delJ_delF.col(2) = cross<dim>(u, v);
-			}
+			const Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double, n, n>> eigs(M);
+			M = eigs.eigenvectors() * eigs.eigenvalues().cwiseMax(0).asDiagonal() * eigs.eigenvectors().transpose();
+		}
+	} // namespace
 
-			double lambda, mu;
-			params_.lambda_mu(data.vals.quadrature.points.row(p), data.vals.val.row(p), data.vals.element_id, lambda, mu);
+	template <int n_basis, int dim>
+	void NeoHookeanElasticity::compute_energy_aux_gradient_fast(const NonLinearAssemblerData &data, Eigen::Matrix<double, Eigen::Dynamic, 1> &G_flattened) const
+	{
+		typedef QuadraturePointsBatch<n_basis, dim> Batch;
 
-			Eigen::Matrix<double, n_basis, dim> delF_delU = grad * jac_it;
+		const int n_pts = data.da.size();
+		thread_local Batch batch;
+		batch.compute(data, params_);
+		const typename Batch::PointArray &lambda = batch.lambda, &mu = batch.mu;
 
-			Eigen::Matrix<double, dim, dim> gradient_temp = mu * def_grad - mu * (1 / J) * delJ_delF + lambda * log_det_j * (1 / J) * delJ_delF;
-			Eigen::Matrix<double, n_basis, dim> gradient = delF_delU * gradient_temp.transpose();
+		// first Piola-Kirchhoff stress, P = mu F + (lambda log(J) - mu) / J cof(F)
+		typename Batch::ComponentArray &stress = batch.stress;
+		stress = batch.F.rowwise() * mu + batch.cof.rowwise() * ((lambda * batch.log_J - mu) / batch.J);
 
-			double val = mu / 2 * ((def_grad.transpose() * def_grad).trace() - size() - 2 * log_det_j) + lambda / 2 * log_det_j * log_det_j;
+		Eigen::Matrix<double, n_basis, dim> G(data.vals.basis_values.size(), size());
+		G.setZero();
 
-			G.noalias() += gradient * data.da(p);
-		}
+		for (long p = 0; p < n_pts; ++p)
+			G.noalias() += batch.grads[p] * batch.component_matrix(stress, p).transpose() * data.da(p);
 
 		Eigen::Matrix<double, dim, n_basis> G_T = G.transpose();
 
@@ -383,114 +451,123 @@ namespace polyfem::assembler
 	}
 
 	template <int n_basis, int dim>
-	void NeoHookeanElasticity::compute_energy_hessian_aux_fast(const NonLinearAssemblerData &data, Eigen::MatrixXd &H) const
+	void NeoHookeanElasticity::compute_energy_hessian_aux_fast(const NonLinearAssemblerData &data, const bool project_to_psd, Eigen::MatrixXd &H) const
 	{
-		assert(data.x.cols() == 1);
+		typedef QuadraturePointsBatch<n_basis, dim> Batch;
+		typedef Eigen::Matrix<double, n_basis, n_basis> BasisMatrix;
 
-		constexpr int N = (n_basis == Eigen::Dynamic) ? Eigen::Dynamic : n_basis * dim;
+		const int n_loc_bases = data.vals.basis_values.size();
 		const int n_pts = data.da.size();
+		thread_local Batch batch;
+		batch.compute(data, params_);
+		const typename Batch::PointArray &lambda = batch.lambda, &mu = batch.mu;
+
+		// d2Psi/dF2 = mu Id + a dJ/dF dJ/dF^T + b d2J/dF2
+		typename Batch::PointArray &a = batch.a, &b = batch.b;
+		a = (mu + lambda * (1 - batch.log_J)) / batch.J.square();
+		b = (lambda * batch.log_J - mu) / batch.J;
 
-		Eigen::Matrix<double, n_basis, dim> local_disp(data.vals.basis_values.size(), size());
-		local_disp.setZero();
-		for (size_t i = 0; i < data.vals.basis_values.size(); ++i)
+		// the three terms are contracted with the basis gradients in closed form, without forming d2Psi/dF2
+		if (project_to_psd)
 		{
-			const auto &bs = data.vals.basis_values[i];
-			for (size_t ii = 0; ii < bs.global.size(); ++ii)
+			// d2Psi/dF2 (on the row-major components of F) is projected per quadrature point and then contracted
+			// with the basis gradients, the element hessian is a sum of PSD terms without the element eigendecomposition
+			typedef Eigen::Matrix<double, dim * dim, dim * dim> Tangent;
+			const auto eps = [](const int i, const int j) { return dim == 2 ? (i < j ? 1 : -1) : ((j - i + dim) % dim == 1 ? 1 : -1); };
+
+			for (long p = 0; p < n_pts; ++p)
 			{
-				for (int d = 0; d < size(); ++d)
+				const Eigen::Matrix<double, dim * dim, 1> cof = batch.cof.col(p).matrix();
+				Tangent tangent = mu(p) * Tangent::Identity();
+				tangent.noalias() += a(p) * cof * cof.transpose();
+
+				// d2J/dF_{kj}dF_{lm} is eps_{kl} eps_{jm} in 2d and eps_{klq} eps_{jmr} F_{qr} in 3d
+				for (int k = 0; k < dim; ++k)
+				{
+					for (int l = 0; l < dim; ++l)
+					{
+						if (k == l)
+							continue;
+						for (int j = 0; j < dim; ++j)
+						{
+							for (int m = 0; m < dim; ++m)
+							{
+								if (j == m)
+									continue;
+								const double d2J = dim == 2 ? 1 : batch.F((dim - k - l) * dim + dim - j - m, p);
+								tangent(k * dim + j, l * dim + m) += b(p) * eps(k, l) * eps(j, m) * d2J;
+							}
+						}
+					}
+				}
+
+				project_tangent_to_psd(tangent);
+
+				const Eigen::Matrix<double, n_basis, dim> &grad = batch.grads[p];
+				for (int k = 0; k < dim; ++k)
 				{
-					local_disp(i, d) += bs.global[ii].val * data.x(bs.global[ii].index * size() + d);
+					for (int l = 0; l < dim; ++l)
+					{
+						const BasisMatrix block = grad * tangent.template block<dim, dim>(k * dim, l * dim) * grad.transpose() * data.da(p);
+						for (int i = 0; i < n_loc_bases; ++i)
+						{
+							for (int j = 0; j < n_loc_bases; ++j)
+								H(i * dim + k, j * dim + l) += block(i, j);
+						}
+					}
 				}
 			}
+			return;
 		}
 
-		Eigen::Matrix<double, dim, dim> def_grad(size(), size());
-
+		std::array<BasisMatrix, dim> d2J;
 		for (long p = 0; p < n_pts; ++p)
 		{
-			Eigen::Matrix<double, n_basis, dim> grad(data.vals.basis_values.size(), size());
+			const Eigen::Matrix<double, n_basis, dim> &grad = batch.grads[p];
+			const BasisMatrix grad_grad_t = grad * grad.transpose();
+			const Eigen::Matrix<double, n_basis, dim> grad_cof = grad * batch.component_matrix(batch.cof, p).transpose();
 
-			for (size_t i = 0; i < data.vals.basis_values.size(); ++i)
+			// d2J/dF_{kj}dF_{lm} grad_{aj} grad_{bm} is eps_{kl} (grad_a x grad_b) in 2d
+			// and eps_{klq} F_q . (grad_a x grad_b) in 3d, d2J[q] stores the second factor
+			if constexpr (dim == 2)
 			{
-				grad.row(i) = data.vals.basis_values[i].grad.row(p);
+				Eigen::Matrix<double, n_basis, dim> grad_perp(n_loc_bases, dim);
+				grad_perp.col(0) = -grad.col(1);
+				grad_perp.col(1) = grad.col(0);
+				d2J[0] = grad_perp * grad.transpose();
 			}
-
-			Eigen::Matrix<double, dim, dim> jac_it = data.vals.jac_it[p];
-
-			// Id + grad d
-			def_grad = local_disp.transpose() * grad * jac_it + Eigen::Matrix<double, dim, dim>::Identity(size(), size());
-
-			const double J = def_grad.determinant();
-			double log_det_j = log(J);
-
-			Eigen::Matrix<double, dim, dim> delJ_delF(size(), size());
-			delJ_delF.setZero();
-			Eigen::Matrix<double, dim * dim, dim * dim> del2J_delF2(size() * size(), size() * size());
-			del2J_delF2.setZero();
-
-			if (dim == 2)
-			{
-				delJ_delF(0, 0) = def_grad(1, 1);
-				delJ_delF(0, 1) = -def_grad(1, 0);
-				delJ_delF(1, 0) = -def_grad(0, 1);
-				delJ_delF(1, 1) = def_grad(0, 0);
-
-				del2J_delF2(0, 3) = 1;
-				del2J_delF2(1, 2) = -1;
-				del2J_delF2(2, 1) = -1;
-				del2J_delF2(3, 0) = 1;
-			}
-			else if (size() == 3)
+			else
 			{
-				Eigen::Matrix<double, dim, 1> u(def_grad.rows());
-				Eigen::Matrix<double, dim, 1> v(def_grad.rows());
-				Eigen::Matrix<double, dim, 1> w(def_grad.rows());
-
-				u = def_grad.col(0);
-				v = def_grad.col(1);
-				w = def_grad.col(2);
-
-				delJ_delF.col(0) = cross<dim>(v, w);
-				delJ_delF.col(1) = cross<dim>(w, u);
-				delJ_delF.col(2) = cross<dim>(u, v);
-
-				del2J_delF2.template block<dim, dim>(0, 6) = hat<dim>(v);
-				del2J_delF2.template block<dim, dim>(6, 0) = -hat<dim>(v);
-				del2J_delF2.template block<dim, dim>(0, 3) = -hat<dim>(w);
-				del2J_delF2.template block<dim, dim>(3, 0) = hat<dim>(w);
-				del2J_delF2.template block<dim, dim>(3, 6) = -hat<dim>(u);
-				del2J_delF2.template block<dim, dim>(6, 3) = hat<dim>(u);
+				const Eigen::Matrix<double, dim, dim> def_grad = batch.component_matrix(batch.F, p);
+				for (int q = 0; q < dim; ++q)
+				{
+					Eigen::Matrix<double, n_basis, dim> f_cross_grad(n_loc_bases, dim);
+					for (int i = 0; i < n_loc_bases; ++i)
+						f_cross_grad.row(i) = def_grad.row(q).cross(grad.row(i));
+					d2J[q] = f_cross_grad * grad.transpose();
+				}
 			}
 
-			double lambda, mu;
-			params_.lambda_mu(data.vals.quadrature.points.row(p), data.vals.val.row(p), data.vals.element_id, lambda, mu);
-
-			Eigen::Matrix<double, dim * dim, dim *dim> id = Eigen::Matrix<double, dim * dim, dim * dim>::Identity(size() * size(), size() * size());
-
-			Eigen::Matrix<double, dim * dim, 1> g_j = Eigen::Map<const Eigen::Matrix<double, dim * dim, 1>>(delJ_delF.data(), delJ_delF.size());
-
-			Eigen::Matrix<double, dim * dim, dim *dim> hessian_temp = (mu * id) + (((mu + lambda * (1 - log_det_j)) / (J * J)) * (g_j * g_j.transpose())) + (((lambda * log_det_j - mu) / (J)) * del2J_delF2);
-
-			Eigen::Matrix<double, dim * dim, N> delF_delU_tensor(jac_it.size(), grad.size());
-
-			for (size_t i = 0; i < local_disp.rows(); ++i)
+			for (int k = 0; k < dim; ++k)
 			{
-				for (size_t j = 0; j < local_disp.cols(); ++j)
+				for (int l = 0; l < dim; ++l)
 				{
-					Eigen::Matrix<double, dim, dim> temp(size(), size());
-					temp.setZero();
-					temp.row(j) = grad.row(i);
-					temp = temp * jac_it;
-					Eigen::Matrix<double, dim * dim, 1> temp_flattened(Eigen::Map<Eigen::Matrix<double, dim * dim, 1>>(temp.data(), temp.size()));
-					delF_delU_tensor.col(i * size() + j) = temp_flattened;
+					BasisMatrix block = a(p) * grad_cof.col(k) * grad_cof.col(l).transpose();
+					if (k == l)
+						block += mu(p) * grad_grad_t;
+					else if (dim == 2)
+						block += (k == 0 ? b(p) : -b(p)) * d2J[0];
+					else
+						block += ((l - k + dim) % dim == 1 ? b(p) : -b(p)) * d2J[dim - k - l];
+
+					block *= data.da(p);
+					for (int i = 0; i < n_loc_bases; ++i)
+					{
+						for (int j = 0; j < n_loc_bases; ++j)
+							H(i * dim + k, j * dim + l) += block(i, j);
+					}
 				}
 			}
-
-			Eigen::Matrix<double, N, N> hessian = delF_delU_tensor.transpose() * hessian_temp * delF_delU_tensor;
-
-			double val = mu / 2 * ((def_grad.transpose() * def_grad).trace() - size() - 2 * log_det_j) + lambda / 2 * log_det_j * log_det_j;
-
-			H += hessian * data.da(p);
 		}
 	}
 
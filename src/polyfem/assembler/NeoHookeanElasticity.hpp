@@ -21,6 +21,11 @@ namespace polyfem::assembler
 		double compute_energy(const NonLinearAssemblerData &data) const override;
 		Eigen::VectorXd assemble_gradient(const NonLinearAssemblerData &data) const override;
 		Eigen::MatrixXd assemble_hessian(const NonLinearAssemblerData &data) const override;
+		// in place versions, the storage of gradient and hessian is reused when their size does not change
+		void assemble_gradient(const NonLinearAssemblerData &data, Eigen::VectorXd &gradient) const override;
+		void assemble_hessian(const NonLinearAssemblerData &data, Eigen::MatrixXd &hessian) const override;
+		// hessian with d2Psi/dF2 projected to PSD at every quadrature point
+		bool assemble_projected_hessian(const NonLinearAssemblerData &data, Eigen::MatrixXd &hessian) const override;
 
 		// rhs for fabbricated solution, compute with automatic sympy code
 		VectorNd compute_rhs(const AutodiffHessianPt &pt) const override;
@@ -28,6 +33,7 @@ namespace polyfem::assembler
 		// sets material params
 		void add_multimaterial(const int index, const json &params) override;
 		void set_params(const LameParameters &params) { params_ = params; }
+		bool has_time_dependent_parameters() const override { return params_.is_time_dependent(); }
 
 		std::string name() const override { return "NeoHookean"; }
 		std::map<std::string, ParamFunc> parameters() const override;
@@ -40,8 +46,9 @@ namespace polyfem::assembler
 		// utility function that computes energy, the template is used for double, DScalar1, and DScalar2 in energy, gradient and hessian
 		template <typename T>
 		T compute_energy_aux(const NonLinearAssemblerData &data) const;
+		void assemble_hessian_aux(const NonLinearAssemblerData &data, const bool project_to_psd, Eigen::MatrixXd &hessian) const;
 		template <int n_basis, int dim>
-		void compute_energy_hessian_aux_fast(const NonLinearAssemblerData &data, Eigen::MatrixXd &H) const;
+		void compute_energy_hessian_aux_fast(const NonLinearAssemblerData &data, const bool project_to_psd, Eigen::MatrixXd &H) const;
 		template <int n_basis, int dim>
 		void compute_energy_aux_gradient_fast(const NonLinearAssemblerData &data, Eigen::VectorXd &G_flattened) const;
 
@@ -17,6 +17,7 @@ namespace polyfem::assembler
 
 		// sets material params
 		void add_multimaterial(const int index, const json &params) override;
+		bool has_time_dependent_parameters() const override { return params_.is_time_dependent(); }
 
 		// This macro defines the overriden functions that compute the energy:
 		// template <typename T>
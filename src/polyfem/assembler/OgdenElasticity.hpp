@@ -12,6 +12,7 @@ namespace polyfem::assembler
 
 		// sets material params
 		void add_multimaterial(const int index, const json &params) override;
+		bool has_time_dependent_parameters() const override { return alphas_.is_time_dependent() || mus_.is_time_dependent() || Ds_.is_time_dependent(); }
 
 		const GenericMatParams &alphas() const { return alphas_; }
 		const GenericMatParams &mus() const { return mus_; }
@@ -44,6 +45,7 @@ namespace polyfem::assembler
 
 		// sets material params
 		void add_multimaterial(const int index, const json &params) override;
+		bool has_time_dependent_parameters() const override { return coefficients_.is_time_dependent() || expoenents_.is_time_dependent() || bulk_modulus_.is_time_dependent(); }
 
 		/// Coefficient of nth term, where n can range from 1 to 6
 		const GenericMatParams &coefficients() const { return coefficients_; }
@@ -12,6 +12,14 @@ namespace polyfem
 		class Problem
 		{
 		public:
+			// how a load depends on time: not at all, as f(x) g(t) with a known scalar g, or in general
+			enum class TimeDependence
+			{
+				CONSTANT,
+				SEPARABLE,
+				GENERAL
+			};
+
 			Problem(const std::string &name);
 			virtual ~Problem() {}
 
@@ -36,12 +44,25 @@ namespace polyfem
 			virtual bool has_exact_sol() const = 0;
 			virtual void exact(const Eigen::MatrixXd &pts, const double t, Eigen::MatrixXd &val) const {};
 			virtual void exact_grad(const Eigen::MatrixXd &pts, const double t, Eigen::MatrixXd &val) const {};
+			// exact solution and its gradient at the same points, problems with a joint evaluation override it
+			virtual void exact_with_grad(const Eigen::MatrixXd &pts, const double t, Eigen::MatrixXd &val, Eigen::MatrixXd &grad) const
+			{
+				exact(pts, t, val);
+				exact_grad(pts, t, grad);
+			}
 
 			virtual void clear() {}
 
 			virtual bool is_time_dependent() const { return false; }
 			virtual bool is_constant_in_time() const { return true; }
 
+			// time dependence of the body force (rhs) and of the Neumann loads (neumann_bc), the scaling is g(t) of the separable case
+			// the Neumann loads must not depend on the normals to be reported as constant or separable
+			virtual TimeDependence rhs_time_dependence() const { return TimeDependence::GENERAL; }
+			virtual double rhs_time_scaling(const double t) const { return 1; }
+			virtual TimeDependence neumann_time_dependence() const { return TimeDependence::GENERAL; }
+			virtual double neumann_time_scaling(const double t) const { return 1; }
+
 			virtual void initial_solution(const mesh::Mesh &mesh, const Eigen::MatrixXi &global_ids, const Eigen::MatrixXd &pts, Eigen::MatrixXd &val) const {}
 			virtual void initial_velocity(const mesh::Mesh &mesh, const Eigen::MatrixXi &global_ids, const Eigen::MatrixXd &pts, Eigen::MatrixXd &val) const {}
 			virtual void initial_acceleration(const mesh::Mesh &mesh, const Eigen::MatrixXi &global_ids, const Eigen::MatrixXd &pts, Eigen::MatrixXd &val) const {}
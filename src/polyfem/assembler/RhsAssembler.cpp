@@ -7,6 +7,8 @@
 
 #include <polysolve/LinearSolver.hpp>
 
+#include <map>
+
 namespace polyfem
 {
 	using namespace polysolve;
@@ -29,6 +31,32 @@ namespace polyfem
 					val = 0;
 				}
 			};
+
+			class LocalThreadVecStorage
+			{
+			public:
+				Eigen::MatrixXd vec;
+				Eigen::MatrixXd areas;
+				Eigen::MatrixXd rhs_fun, normals, deform_mat, trafo;
+
+				LocalThreadVecStorage(const int size)
+				{
+					vec.setZero(size, 1);
+					areas.setZero(size, 1);
+				}
+			};
+
+			// dofs listed in bounday_nodes, for constant time lookups
+			std::vector<bool> dirichlet_mask(const std::vector<int> &bounday_nodes, const int size)
+			{
+				std::vector<bool> res(size, false);
+				for (const int b : bounday_nodes)
+				{
+					if (b < size)
+						res[b] = true;
+				}
+				return res;
+			}
 		} // namespace
 
 		RhsAssembler::RhsAssembler(const Assembler &assembler, const Mesh &mesh, const Obstacle &obstacle,
@@ -105,6 +133,34 @@ namespace polyfem
 			}
 		}
 
+		bool RhsAssembler::cached_body_force(const Density &density, const double t, Eigen::MatrixXd &rhs) const
+		{
+			const Problem::TimeDependence dependence = problem_.rhs_time_dependence();
+			if (dependence == Problem::TimeDependence::GENERAL)
+				return false;
+
+			const double scaling = dependence == Problem::TimeDependence::CONSTANT ? 1 : problem_.rhs_time_scaling(t);
+			if (body_cache_.density != &density || body_cache_.values.size() == 0)
+			{
+				// the spatial part cannot be recovered from a too small scaling
+				if (scaling != 0 && std::abs(scaling) < 1e-8)
+					return false;
+
+				if (scaling == 0)
+				{
+					rhs = Eigen::MatrixXd::Zero(n_basis_ * size_, 1);
+					return true;
+				}
+
+				assemble(density, body_cache_.values, t);
+				body_cache_.values /= scaling;
+				body_cache_.density = &density;
+			}
+
+			rhs = scaling * body_cache_.values;
+			return true;
+		}
+
 		void RhsAssembler::initial_solution(Eigen::MatrixXd &sol) const
 		{
 			time_bc([&](const Mesh &mesh, const Eigen::MatrixXi &global_ids, const Eigen::MatrixXd &pts, Eigen::MatrixXd &val) {
@@ -220,17 +276,18 @@ namespace polyfem
 					{
 						solver->solve(b.block(0, i, mass.rows(), 1), sol.block(0, i, mass.rows(), 1));
 					}
-					logger().trace("mass matrix error {}", (mass * sol - b).norm());
+					if (logger().should_log(spdlog::level::trace))
+						logger().trace("mass matrix error {}", (mass * sol - b).norm());
 				}
 			}
 		}
 
-		void RhsAssembler::lsq_bc(const std::function<void(const Eigen::MatrixXi &, const Eigen::MatrixXd &, const Eigen::MatrixXd &, Eigen::MatrixXd &)> &df,
-								  const std::vector<LocalBoundary> &local_boundary, const std::vector<int> &bounday_nodes, const int resolution, Eigen::MatrixXd &rhs) const
+		void RhsAssembler::build_lsq_cache(const std::vector<LocalBoundary> &local_boundary, const std::vector<int> &bounday_nodes, const int resolution, const std::vector<int> &signature) const
 		{
-			const int n_el = int(bases_.size());
+			lsq_cache_ = LsqCache();
+			lsq_cache_.signature = signature;
 
-			Eigen::MatrixXd uv, samples, gtmp, rhs_fun;
+			Eigen::MatrixXd uv, samples, mapped;
 			Eigen::VectorXi global_primitive_ids;
 
 			const int actual_dim = problem_.is_scalar() ? 1 : mesh_.dimension();
@@ -249,41 +306,96 @@ namespace polyfem
 			}
 			assert(skipped_count <= 1);
 
-			for (int d = 0; d < size_; ++d)
+			// samples of every local boundary, the bases are evaluated once for all dimensions
+			std::vector<int> block_elements;
+			std::vector<std::vector<AssemblyValues>> block_vals;
+			std::vector<Eigen::MatrixXd> block_uv, block_mapped;
+			for (const auto &lb : local_boundary)
 			{
-				int index = 0;
-				std::vector<int> indices;
-				indices.reserve(n_el * 10);
-				std::vector<int> tags;
-				tags.reserve(n_el * 10);
+				const int e = lb.element_id();
+				bool has_samples = utils::BoundarySampler::sample_boundary(lb, resolution, mesh_, false, uv, samples, global_primitive_ids);
 
-				long total_size = 0;
+				if (!has_samples)
+					continue;
 
-				Eigen::VectorXi global_index_to_col(n_basis_);
-				global_index_to_col.setConstant(-1);
+				assert(global_primitive_ids.size() == samples.rows());
+				gbases_[e].eval_geom_mapping(samples, mapped);
 
-				std::vector<AssemblyValues> tmp_val;
+				block_elements.push_back(e);
+				block_vals.emplace_back();
+				bases_[e].evaluate_bases(samples, block_vals.back());
 
-				for (const auto &lb : local_boundary)
+				lsq_cache_.global_primitive_ids.push_back(global_primitive_ids);
+				block_uv.push_back(uv);
+				block_mapped.push_back(mapped);
+			}
+
+			// one batch per uv size (e.g., triangles and quads of an hybrid mesh)
+			std::map<int, std::vector<int>> blocks_per_uv_size;
+			for (int k = 0; k < block_uv.size(); ++k)
+				blocks_per_uv_size[block_uv[k].cols()].push_back(k);
+			for (const auto &[uv_size, blocks] : blocks_per_uv_size)
+			{
+				LsqCache::Batch &batch = lsq_cache_.batches.emplace_back();
+				batch.blocks = blocks;
+
+				int n_samples = 0;
+				for (const int k : blocks)
+					n_samples += block_uv[k].rows();
+				batch.global_primitive_ids.resize(n_samples);
+				batch.uv.resize(n_samples, uv_size);
+				batch.mapped.resize(n_samples, block_mapped[blocks.front()].cols());
+
+				int offset = 0;
+				for (const int k : blocks)
 				{
-					const int e = lb.element_id();
-					bool has_samples = utils::BoundarySampler::sample_boundary(lb, resolution, mesh_, true, uv, samples, global_primitive_ids);
+					const int n = block_uv[k].rows();
+					batch.global_primitive_ids.segment(offset, n) = lsq_cache_.global_primitive_ids[k];
+					batch.uv.middleRows(offset, n) = block_uv[k];
+					batch.mapped.middleRows(offset, n) = block_mapped[k];
+					offset += n;
+				}
+			}
 
-					if (!has_samples)
-						continue;
+			// the sampled points depend on the dimension only if some dimensions are not Dirichlet
+			if (problem_.all_dimensions_dirichlet())
+			{
+				lsq_cache_.projections.emplace_back();
+				for (int d = 0; d < size_; ++d)
+					lsq_cache_.projections.back().dims.push_back(d);
+			}
+			else
+			{
+				for (int d = 0; d < size_; ++d)
+				{
+					lsq_cache_.projections.emplace_back();
+					lsq_cache_.projections.back().dims.push_back(d);
+				}
+			}
 
-					const basis::ElementBases &bs = bases_[e];
-					bs.evaluate_bases(samples, tmp_val);
+			for (auto &projection : lsq_cache_.projections)
+			{
+				const int d = projection.dims.front();
+				int index = 0;
+
+				Eigen::VectorXi global_index_to_col(n_basis_);
+				global_index_to_col.setConstant(-1);
+				std::vector<int> tags;
+
+				for (int k = 0; k < block_elements.size(); ++k)
+				{
+					const basis::ElementBases &bs = bases_[block_elements[k]];
+					const std::vector<AssemblyValues> &tmp_val = block_vals[k];
+					const Eigen::VectorXi &ids = lsq_cache_.global_primitive_ids[k];
 					const int n_local_bases = int(bs.bases.size());
-					assert(global_primitive_ids.size() == samples.rows());
 
-					for (int s = 0; s < samples.rows(); ++s)
+					for (int s = 0; s < ids.size(); ++s)
 					{
-						const int tag = mesh_.get_boundary_id(global_primitive_ids(s));
+						const int tag = mesh_.get_boundary_id(ids(s));
 						if (!problem_.all_dimensions_dirichlet() && !problem_.is_dimension_dirichet(tag, d))
 							continue;
 
-						total_size++;
+						projection.rows.emplace_back(k, s);
 
 						for (int j = 0; j < n_local_bases; ++j)
 						{
@@ -301,9 +413,9 @@ namespace polyfem
 									if (global_index_to_col(b.global()[ii].index) == -1)
 									{
 										global_index_to_col(b.global()[ii].index) = index++;
-										indices.push_back(b.global()[ii].index);
+										projection.indices.push_back(b.global()[ii].index);
 										tags.push_back(tag);
-										assert(indices.size() == size_t(index));
+										assert(projection.indices.size() == size_t(index));
 									}
 								}
 							}
@@ -311,103 +423,138 @@ namespace polyfem
 					}
 				}
 
-				Eigen::MatrixXd global_rhs = Eigen::MatrixXd::Zero(total_size, 1);
-
-				const long buffer_size = total_size * long(indices.size());
-				std::vector<Eigen::Triplet<double>> entries, entries_t;
-
-				index = 0;
-
-				int global_counter = 0;
-				Eigen::MatrixXd mapped;
-
-				for (const auto &lb : local_boundary)
+				std::vector<Eigen::Triplet<double>> entries_t;
+				for (int r = 0; r < projection.rows.size(); ++r)
 				{
-					const int e = lb.element_id();
-					bool has_samples = utils::BoundarySampler::sample_boundary(lb, resolution, mesh_, false, uv, samples, global_primitive_ids);
+					const auto [k, s] = projection.rows[r];
+					const basis::ElementBases &bs = bases_[block_elements[k]];
+					const std::vector<AssemblyValues> &tmp_val = block_vals[k];
 
-					if (!has_samples)
-						continue;
+					for (int j = 0; j < int(bs.bases.size()); ++j)
+					{
+						const basis::Basis &b = bs.bases[j];
+						const double tmp = tmp_val[j].val(s);
 
-					const basis::ElementBases &bs = bases_[e];
-					const basis::ElementBases &gbs = gbases_[e];
-					const int n_local_bases = int(bs.bases.size());
+						for (std::size_t ii = 0; ii < b.global().size(); ++ii)
+						{
+							auto item = global_index_to_col(b.global()[ii].index);
+							if (item != -1)
+								entries_t.push_back(Eigen::Triplet<double>(item, r, tmp * b.global()[ii].val));
+						}
+					}
+				}
 
-					gbs.eval_geom_mapping(samples, mapped);
+				projection.mat_t.resize(int(projection.indices.size()), int(projection.rows.size()));
+				projection.mat_t.setFromTriplets(entries_t.begin(), entries_t.end());
 
-					bs.evaluate_bases(samples, tmp_val);
-					df(global_primitive_ids, uv, mapped, rhs_fun);
+				// resolved once, the Dirichlet dimensions of the tags do not change between steps
+				projection.is_dirichlet.resize(tags.size(), projection.dims.size());
+				for (size_t i = 0; i < tags.size(); ++i)
+				{
+					for (size_t c = 0; c < projection.dims.size(); ++c)
+						projection.is_dirichlet(i, c) = problem_.all_dimensions_dirichlet() || problem_.is_dimension_dirichet(tags[i], projection.dims[c]);
+				}
+			}
+		}
 
-					for (int s = 0; s < samples.rows(); ++s)
-					{
-						const int tag = mesh_.get_boundary_id(global_primitive_ids(s));
-						if (!problem_.all_dimensions_dirichlet() && !problem_.is_dimension_dirichet(tag, d))
-							continue;
+		void RhsAssembler::lsq_bc(const std::function<void(const Eigen::MatrixXi &, const Eigen::MatrixXd &, const Eigen::MatrixXd &, Eigen::MatrixXd &)> &df,
+								  const std::vector<LocalBoundary> &local_boundary, const std::vector<int> &bounday_nodes, const int resolution, Eigen::MatrixXd &rhs) const
+		{
+			std::vector<int> signature;
+			signature.reserve(bounday_nodes.size() + 4 * local_boundary.size() + 3);
+			signature.push_back(resolution);
+			signature.push_back(bounday_nodes.size());
+			signature.insert(signature.end(), bounday_nodes.begin(), bounday_nodes.end());
+			signature.push_back(local_boundary.size());
+			for (const auto &lb : local_boundary)
+			{
+				signature.push_back(lb.element_id());
+				signature.push_back(lb.size());
+				for (int i = 0; i < lb.size(); ++i)
+					signature.push_back(lb.global_primitive_id(i));
+			}
 
-						for (int j = 0; j < n_local_bases; ++j)
-						{
-							const basis::Basis &b = bs.bases[j];
-							const double tmp = tmp_val[j].val(s);
+			if (signature != lsq_cache_.signature)
+				build_lsq_cache(local_boundary, bounday_nodes, resolution, signature);
 
-							for (std::size_t ii = 0; ii < b.global().size(); ++ii)
-							{
-								auto item = global_index_to_col(b.global()[ii].index);
-								if (item != -1)
-								{
-									entries.push_back(Eigen::Triplet<double>(global_counter, item, tmp * b.global()[ii].val));
-									entries_t.push_back(Eigen::Triplet<double>(item, global_counter, tmp * b.global()[ii].val));
-								}
-							}
-						}
+			// only the bc values change between calls
+			std::vector<Eigen::MatrixXd> rhs_fun(lsq_cache_.global_primitive_ids.size());
+			Eigen::MatrixXd batch_fun;
+			for (const LsqCache::Batch &batch : lsq_cache_.batches)
+			{
+				df(batch.global_primitive_ids, batch.uv, batch.mapped, batch_fun);
 
-						global_rhs(global_counter) = rhs_fun(s, d);
-						global_counter++;
-					}
+				int offset = 0;
+				for (const int k : batch.blocks)
+				{
+					const int n = lsq_cache_.global_primitive_ids[k].size();
+					rhs_fun[k] = batch_fun.middleRows(offset, n);
+					offset += n;
 				}
+			}
 
-				assert(global_counter == total_size);
+			for (auto &projection : lsq_cache_.projections)
+			{
+				const long total_size = projection.rows.size();
+				if (total_size <= 0 || projection.indices.empty())
+					continue;
 
-				if (total_size > 0)
+				const int n_dims = projection.dims.size();
+				Eigen::MatrixXd global_rhs(total_size, n_dims);
+				for (long r = 0; r < total_size; ++r)
 				{
-					const double mmin = global_rhs.minCoeff();
-					const double mmax = global_rhs.maxCoeff();
+					const auto [k, s] = projection.rows[r];
+					for (int c = 0; c < n_dims; ++c)
+						global_rhs(r, c) = rhs_fun[k](s, projection.dims[c]);
+				}
 
-					if (fabs(mmin) < 1e-8 && fabs(mmax) < 1e-8)
+				std::vector<int> to_solve;
+				for (int c = 0; c < n_dims; ++c)
+				{
+					const int d = projection.dims[c];
+					if (global_rhs.col(c).cwiseAbs().maxCoeff() >= 1e-8)
 					{
-						for (size_t i = 0; i < indices.size(); ++i)
-						{
-							const int tag = tags[i];
-							if (problem_.all_dimensions_dirichlet() || problem_.is_dimension_dirichet(tag, d))
-								rhs(indices[i] * size_ + d) = 0;
-						}
+						to_solve.push_back(c);
+						continue;
 					}
-					else
+
+					for (size_t i = 0; i < projection.indices.size(); ++i)
 					{
-						StiffnessMatrix mat(int(total_size), int(indices.size()));
-						mat.setFromTriplets(entries.begin(), entries.end());
+						if (projection.is_dirichlet(i, c))
+							rhs(projection.indices[i] * size_ + d) = 0;
+					}
+				}
 
-						StiffnessMatrix mat_t(int(indices.size()), int(total_size));
-						mat_t.setFromTriplets(entries_t.begin(), entries_t.end());
+				if (to_solve.empty())
+					continue;
 
-						StiffnessMatrix A = mat_t * mat;
-						Eigen::VectorXd b = mat_t * global_rhs;
+				// factorized the first time a non zero bc is projected
+				if (!projection.solver)
+				{
+					const StiffnessMatrix A = projection.mat_t * StiffnessMatrix(projection.mat_t.transpose());
+					projection.solver = LinearSolver::create(solver_, preconditioner_);
+					projection.solver->setParameters(solver_params_);
+					projection.solver->analyzePattern(A, A.rows());
+					projection.solver->factorize(A);
+				}
 
-						Eigen::VectorXd coeffs(b.rows(), 1);
-						auto solver = LinearSolver::create(solver_, preconditioner_);
-						solver->setParameters(solver_params_);
-						solver->analyzePattern(A, A.rows());
-						solver->factorize(A);
-						coeffs.setZero();
-						solver->solve(b, coeffs);
+				const Eigen::MatrixXd b = projection.mat_t * global_rhs;
 
-						logger().trace("RHS solve error {}", (A * coeffs - b).norm());
+				Eigen::VectorXd coeffs(b.rows());
+				for (const int c : to_solve)
+				{
+					const int d = projection.dims[c];
+					const Eigen::VectorXd bc = b.col(c);
+					coeffs.setZero();
+					projection.solver->solve(bc, coeffs);
 
-						for (long i = 0; i < coeffs.rows(); ++i)
-						{
-							const int tag = tags[i];
-							if (problem_.all_dimensions_dirichlet() || problem_.is_dimension_dirichet(tag, d))
-								rhs(indices[i] * size_ + d) = coeffs(i);
-						}
+					if (logger().should_log(spdlog::level::trace))
+						logger().trace("RHS solve error {}", (projection.mat_t * (projection.mat_t.transpose() * coeffs) - bc).norm());
+
+					for (long i = 0; i < coeffs.rows(); ++i)
+					{
+						if (projection.is_dirichlet(i, c))
+							rhs(projection.indices[i] * size_ + d) = coeffs(i);
 					}
 				}
 			}
@@ -484,18 +631,9 @@ namespace polyfem
 										const std::vector<LocalBoundary> &local_boundary, const std::vector<int> &bounday_nodes, const int resolution, Eigen::MatrixXd &rhs) const
 		{
 			assert(false);
-			Eigen::MatrixXd uv, samples, rhs_fun, normals, mapped;
-			Eigen::VectorXd weights;
-
-			Eigen::VectorXi global_primitive_ids;
-			std::vector<AssemblyValues> tmp_val;
-
 			Eigen::Matrix<bool, Eigen::Dynamic, 1> is_boundary(n_basis_);
 			is_boundary.setConstant(false);
 
-			Eigen::MatrixXd areas(rhs.rows(), 1);
-			areas.setZero();
-
 			const int actual_dim = problem_.is_scalar() ? 1 : mesh_.dimension();
 
 			int skipped_count = 0;
@@ -510,52 +648,67 @@ namespace polyfem
 					skipped_count++;
 			}
 			assert(skipped_count <= 1);
-			ElementAssemblyValues vals;
 
-			for (const auto &lb : local_boundary)
-			{
-				const int e = lb.element_id();
-				bool has_samples = utils::BoundarySampler::boundary_quadrature(lb, resolution, mesh_, false, uv, samples, normals, weights, global_primitive_ids);
+			const std::vector<bool> is_dirichlet = dirichlet_mask(bounday_nodes, rhs.rows());
+			const auto &entries = dirichlet_quadrature_cache_.get(local_boundary, resolution, mesh_, bases_, gbases_);
 
-				if (!has_samples)
-					continue;
+			auto storage = create_thread_storage(LocalThreadVecStorage(rhs.rows()));
 
-				const basis::ElementBases &bs = bases_[e];
-				const basis::ElementBases &gbs = gbases_[e];
+			maybe_parallel_for(local_boundary.size(), [&](int start, int end, int thread_id) {
+				LocalThreadVecStorage &local_storage = get_local_thread_storage(storage, thread_id);
+				Eigen::MatrixXd &rhs_fun = local_storage.rhs_fun;
 
-				vals.compute(e, mesh_.is_volume(), samples, bs, gbs);
+				for (int k = start; k < end; ++k)
+				{
+					const auto &lb = local_boundary[k];
+					const auto &entry = entries[k];
+					if (!entry.has_samples)
+						continue;
 
-				df(global_primitive_ids, uv, vals.val, rhs_fun);
+					const basis::ElementBases &bs = bases_[lb.element_id()];
+					const ElementAssemblyValues &vals = entry.vals;
+					const Eigen::VectorXd &weights = entry.weights;
 
-				for (int d = 0; d < size_; ++d)
-					rhs_fun.col(d) = rhs_fun.col(d).array() * weights.array();
+					df(entry.global_primitive_ids, entry.uv, vals.val, rhs_fun);
 
-				for (int i = 0; i < lb.size(); ++i)
-				{
-					const int primitive_global_id = lb.global_primitive_id(i);
-					const auto nodes = bs.local_nodes_for_primitive(primitive_global_id, mesh_);
+					for (int d = 0; d < size_; ++d)
+						rhs_fun.col(d) = rhs_fun.col(d).array() * weights.array();
 
-					for (long n = 0; n < nodes.size(); ++n)
+					for (int i = 0; i < lb.size(); ++i)
 					{
-						// const auto &b = bs.bases[nodes(n)];
-						const AssemblyValues &v = vals.basis_values[nodes(n)];
-						const double area = (weights.array() * v.val.array()).sum();
-						for (int d = 0; d < size_; ++d)
-						{
-							const double rhs_value = (rhs_fun.col(d).array() * v.val.array()).sum();
+						const int primitive_global_id = lb.global_primitive_id(i);
+						const auto nodes = bs.local_nodes_for_primitive(primitive_global_id, mesh_);
 
-							for (size_t g = 0; g < v.global.size(); ++g)
+						for (long n = 0; n < nodes.size(); ++n)
+						{
+							// const auto &b = bs.bases[nodes(n)];
+							const AssemblyValues &v = vals.basis_values[nodes(n)];
+							const double area = (weights.array() * v.val.array()).sum();
+							for (int d = 0; d < size_; ++d)
 							{
-								const int g_index = v.global[g].index * size_ + d;
-								if (problem_.all_dimensions_dirichlet() || std::find(bounday_nodes.begin(), bounday_nodes.end(), g_index) != bounday_nodes.end())
+								const double rhs_value = (rhs_fun.col(d).array() * v.val.array()).sum();
+
+								for (size_t g = 0; g < v.global.size(); ++g)
 								{
-									rhs(g_index) += rhs_value * v.global[g].val;
-									areas(g_index) += area * v.global[g].val;
+									const int g_index = v.global[g].index * size_ + d;
+									if (problem_.all_dimensions_dirichlet() || is_dirichlet[g_index])
+									{
+										local_storage.vec(g_index) += rhs_value * v.global[g].val;
+										local_storage.areas(g_index) += area * v.global[g].val;
+									}
 								}
 							}
 						}
 					}
 				}
+			});
+
+			// Serially merge local storages
+			Eigen::MatrixXd areas = Eigen::MatrixXd::Zero(rhs.rows(), 1);
+			for (const LocalThreadVecStorage &local_storage : storage)
+			{
+				rhs += local_storage.vec;
+				areas += local_storage.areas;
 			}
 
 			for (int b : bounday_nodes)
@@ -565,6 +718,110 @@ namespace polyfem
 			}
 		}
 
+		void RhsAssembler::integrate_neumann(
+			const std::function<void(const Eigen::MatrixXi &, const Eigen::MatrixXd &, const Eigen::MatrixXd &, const Eigen::MatrixXd &, Eigen::MatrixXd &)> &nf,
+			const std::vector<LocalBoundary> &local_neumann_boundary, const std::vector<int> &bounday_nodes, const int resolution,
+			const Eigen::MatrixXd &displacement, const int size, Eigen::MatrixXd &neumann) const
+		{
+			const std::vector<bool> is_dirichlet = dirichlet_mask(bounday_nodes, size);
+			const auto &entries = neumann_quadrature_cache_.get(local_neumann_boundary, resolution, mesh_, bases_, gbases_);
+
+			auto storage = create_thread_storage(LocalThreadVecStorage(size));
+
+			maybe_parallel_for(local_neumann_boundary.size(), [&](int start, int end, int thread_id) {
+				LocalThreadVecStorage &local_storage = get_local_thread_storage(storage, thread_id);
+				Eigen::MatrixXd &rhs_fun = local_storage.rhs_fun;
+				Eigen::MatrixXd &normals = local_storage.normals;
+				Eigen::MatrixXd &deform_mat = local_storage.deform_mat;
+				Eigen::MatrixXd &trafo = local_storage.trafo;
+
+				for (int k = start; k < end; ++k)
+				{
+					const auto &lb = local_neumann_boundary[k];
+					const auto &entry = entries[k];
+					if (!entry.has_samples)
+						continue;
+
+					const basis::ElementBases &bs = bases_[lb.element_id()];
+					const ElementAssemblyValues &vals = entry.vals;
+					const Eigen::VectorXd &weights = entry.weights;
+
+					normals = entry.normals;
+					for (int n = 0; n < vals.jac_it.size(); ++n)
+					{
+						Eigen::MatrixXd ppp(1, size_);
+						ppp = vals.val.row(n);
+
+						trafo = vals.jac_it[n];
+
+						if (displacement.size() > 0)
+						{
+							assert(size_ == 2 || size_ == 3);
+							deform_mat.resize(size_, size_);
+							deform_mat.setZero();
+							for (const auto &b : vals.basis_values)
+							{
+								for (const auto &g : b.global)
+								{
+									for (int d = 0; d < size_; ++d)
+									{
+										deform_mat.col(d) += displacement(g.index * size_ + d) * b.grad_t_m.row(n);
+
+										ppp(d) += displacement(g.index * size_ + d) * b.val(n);
+									}
+								}
+							}
+
+							trafo += deform_mat;
+						}
+
+						normals.row(n) = normals.row(n) * trafo;
+						normals.row(n).normalize();
+					}
+
+					// problem_.neumann_bc(mesh_, global_primitive_ids, vals.val, t, rhs_fun);
+					nf(entry.global_primitive_ids, entry.uv, vals.val, normals, rhs_fun);
+
+					// UIState::ui_state().debug_data().add_points(vals.val, Eigen::RowVector3d(0,1,0));
+
+					for (int d = 0; d < size_; ++d)
+						rhs_fun.col(d) = rhs_fun.col(d).array() * weights.array();
+
+					for (int i = 0; i < lb.size(); ++i)
+					{
+						const int primitive_global_id = lb.global_primitive_id(i);
+						const auto nodes = bs.local_nodes_for_primitive(primitive_global_id, mesh_);
+
+						for (long n = 0; n < nodes.size(); ++n)
+						{
+							// const auto &b = bs.bases[nodes(n)];
+							const AssemblyValues &v = vals.basis_values[nodes(n)];
+							for (int d = 0; d < size_; ++d)
+							{
+								const double rhs_value = (rhs_fun.col(d).array() * v.val.array()).sum();
+
+								for (size_t g = 0; g < v.global.size(); ++g)
+								{
+									const int g_index = v.global[g].index * size_ + d;
+									const bool is_neumann = !is_dirichlet[g_index];
+
+									if (is_neumann)
+									{
+										local_storage.vec(g_index) += rhs_value * v.global[g].val;
+									}
+								}
+							}
+						}
+					}
+				}
+			});
+
+			// Serially merge local storages
+			neumann = Eigen::MatrixXd::Zero(size, 1);
+			for (const LocalThreadVecStorage &local_storage : storage)
+				neumann += local_storage.vec;
+		}
+
 		void RhsAssembler::set_bc(
 			const std::function<void(const Eigen::MatrixXi &, const Eigen::MatrixXd &, const Eigen::MatrixXd &, Eigen::MatrixXd &)> &df,
 			const std::function<void(const Eigen::MatrixXi &, const Eigen::MatrixXd &, const Eigen::MatrixXd &, const Eigen::MatrixXd &, Eigen::MatrixXd &)> &nf,
@@ -603,108 +860,56 @@ namespace polyfem
 			}
 
 			// Neumann
-			Eigen::MatrixXd uv, samples, gtmp, rhs_fun, deform_mat, trafo;
-			Eigen::VectorXi global_primitive_ids;
-			Eigen::MatrixXd points, normals;
-			Eigen::VectorXd weights;
-
-			ElementAssemblyValues vals;
-
-			for (const auto &lb : local_neumann_boundary)
+			if (!local_neumann_boundary.empty())
 			{
-				const int e = lb.element_id();
-				bool has_samples = utils::BoundarySampler::boundary_quadrature(lb, resolution, mesh_, false, uv, points, normals, weights, global_primitive_ids);
-
-				if (!has_samples)
-					continue;
-
-				const basis::ElementBases &gbs = gbases_[e];
-				const basis::ElementBases &bs = bases_[e];
-
-				vals.compute(e, mesh_.is_volume(), points, bs, gbs);
-
-				for (int n = 0; n < vals.jac_it.size(); ++n)
-				{
-					Eigen::MatrixXd ppp(1, size_);
-					ppp = vals.val.row(n);
-
-					trafo = vals.jac_it[n];
-
-					if (displacement.size() > 0)
-					{
-						assert(size_ == 2 || size_ == 3);
-						deform_mat.resize(size_, size_);
-						deform_mat.setZero();
-						for (const auto &b : vals.basis_values)
-						{
-							for (const auto &g : b.global)
-							{
-								for (int d = 0; d < size_; ++d)
-								{
-									deform_mat.col(d) += displacement(g.index * size_ + d) * b.grad_t_m.row(n);
-
-									ppp(d) += displacement(g.index * size_ + d) * b.val(n);
-								}
-							}
-						}
+				Eigen::MatrixXd neumann;
+				integrate_neumann(nf, local_neumann_boundary, bounday_nodes, resolution, displacement, rhs.rows(), neumann);
+				rhs += neumann;
+			}
 
-						trafo += deform_mat;
-					}
+			// TODO add nodal neumann
+		}
 
-					normals.row(n) = normals.row(n) * trafo;
-					normals.row(n).normalize();
-				}
+		void RhsAssembler::set_bc(const std::vector<LocalBoundary> &local_boundary, const std::vector<int> &bounday_nodes, const int resolution, const std::vector<LocalBoundary> &local_neumann_boundary, Eigen::MatrixXd &rhs, const Eigen::MatrixXd &displacement, const double t) const
+		{
+			const auto nf = [&](const Eigen::MatrixXi &global_ids, const Eigen::MatrixXd &uv, const Eigen::MatrixXd &pts, const Eigen::MatrixXd &normals, Eigen::MatrixXd &val) {
+				problem_.neumann_bc(mesh_, global_ids, uv, pts, normals, t, val);
+			};
 
-				// problem_.neumann_bc(mesh_, global_primitive_ids, vals.val, t, rhs_fun);
-				nf(global_primitive_ids, uv, vals.val, normals, rhs_fun);
+			const Problem::TimeDependence neumann_dependence = problem_.neumann_time_dependence();
+			const bool cache_neumann = !local_neumann_boundary.empty() && neumann_dependence != Problem::TimeDependence::GENERAL;
 
-				// UIState::ui_state().debug_data().add_points(vals.val, Eigen::RowVector3d(0,1,0));
+			set_bc(
+				[&](const Eigen::MatrixXi &global_ids, const Eigen::MatrixXd &uv, const Eigen::MatrixXd &pts, Eigen::MatrixXd &val) {
+					problem_.dirichlet_bc(mesh_, global_ids, uv, pts, t, val);
+				},
+				nf, local_boundary, bounday_nodes, resolution, cache_neumann ? std::vector<LocalBoundary>() : local_neumann_boundary, displacement, t, rhs);
 
-				for (int d = 0; d < size_; ++d)
-					rhs_fun.col(d) = rhs_fun.col(d).array() * weights.array();
+			// loads constant or separable in time are integrated once and scaled
+			const double scaling = neumann_dependence == Problem::TimeDependence::CONSTANT ? 1 : problem_.neumann_time_scaling(t);
+			if (cache_neumann && scaling != 0)
+			{
+				std::vector<int> signature = {resolution, int(rhs.rows())};
+				signature.insert(signature.end(), bounday_nodes.begin(), bounday_nodes.end());
+				BoundaryQuadratureCache::append_signature(local_neumann_boundary, signature);
 
-				for (int i = 0; i < lb.size(); ++i)
+				if (signature == neumann_cache_.signature)
+					rhs += scaling * neumann_cache_.values;
+				else
 				{
-					const int primitive_global_id = lb.global_primitive_id(i);
-					const auto nodes = bs.local_nodes_for_primitive(primitive_global_id, mesh_);
+					Eigen::MatrixXd neumann;
+					integrate_neumann(nf, local_neumann_boundary, bounday_nodes, resolution, displacement, rhs.rows(), neumann);
+					rhs += neumann;
 
-					for (long n = 0; n < nodes.size(); ++n)
+					// the spatial part cannot be recovered from a too small scaling
+					if (std::abs(scaling) >= 1e-8)
 					{
-						// const auto &b = bs.bases[nodes(n)];
-						const AssemblyValues &v = vals.basis_values[nodes(n)];
-						for (int d = 0; d < size_; ++d)
-						{
-							const double rhs_value = (rhs_fun.col(d).array() * v.val.array()).sum();
-
-							for (size_t g = 0; g < v.global.size(); ++g)
-							{
-								const int g_index = v.global[g].index * size_ + d;
-								const bool is_neumann = std::find(bounday_nodes.begin(), bounday_nodes.end(), g_index) == bounday_nodes.end();
-
-								if (is_neumann)
-								{
-									rhs(g_index) += rhs_value * v.global[g].val;
-								}
-							}
-						}
+						neumann_cache_.values = neumann / scaling;
+						neumann_cache_.signature = std::move(signature);
 					}
 				}
 			}
 
-			// TODO add nodal neumann
-		}
-
-		void RhsAssembler::set_bc(const std::vector<LocalBoundary> &local_boundary, const std::vector<int> &bounday_nodes, const int resolution, const std::vector<LocalBoundary> &local_neumann_boundary, Eigen::MatrixXd &rhs, const Eigen::MatrixXd &displacement, const double t) const
-		{
-			set_bc(
-				[&](const Eigen::MatrixXi &global_ids, const Eigen::MatrixXd &uv, const Eigen::MatrixXd &pts, Eigen::MatrixXd &val) {
-					problem_.dirichlet_bc(mesh_, global_ids, uv, pts, t, val);
-				},
-				[&](const Eigen::MatrixXi &global_ids, const Eigen::MatrixXd &uv, const Eigen::MatrixXd &pts, const Eigen::MatrixXd &normals, Eigen::MatrixXd &val) {
-					problem_.neumann_bc(mesh_, global_ids, uv, pts, normals, t, val);
-				},
-				local_boundary, bounday_nodes, resolution, local_neumann_boundary, displacement, t, rhs);
-
 			obstacle_.update_displacement(t, rhs);
 		}
 
@@ -716,7 +921,8 @@ namespace polyfem
 			}
 			else
 			{
-				assemble(density, rhs, t);
+				if (!cached_body_force(density, t, rhs))
+					assemble(density, rhs, t);
 				rhs *= -1;
 
 				if (rhs.size() != final_rhs.size())
@@ -737,7 +943,13 @@ namespace polyfem
 
 			double res = 0;
 
-			if (!problem_.is_rhs_zero())
+			Eigen::MatrixXd body_force;
+			if (!problem_.is_rhs_zero() && cached_body_force(density, t, body_force))
+			{
+				// same quadrature as assemble, the energy is the dot product with the assembled body force
+				res += (body_force.array() * displacement.topRows(body_force.rows()).array()).sum();
+			}
+			else if (!problem_.is_rhs_zero())
 			{
 				auto storage = create_thread_storage(LocalThreadScalarStorage());
 				const int n_bases = int(bases_.size());
@@ -795,59 +1007,63 @@ namespace polyfem
 					res += local_storage.val;
 			}
 
-			VectorNd local_displacement(size_);
-			Eigen::MatrixXd forces;
-
-			ElementAssemblyValues vals;
 			// Neumann
-			Eigen::MatrixXd points, uv, normals, deform_mat;
-			Eigen::VectorXd weights;
-			Eigen::VectorXi global_primitive_ids;
-			for (const auto &lb : local_neumann_boundary)
-			{
-				const int e = lb.element_id();
-				bool has_samples = utils::BoundarySampler::boundary_quadrature(lb, resolution, mesh_, false, uv, points, normals, weights, global_primitive_ids);
+			const auto &entries = neumann_quadrature_cache_.get(local_neumann_boundary, resolution, mesh_, bases_, gbases_);
 
-				if (!has_samples)
-					continue;
-
-				const basis::ElementBases &gbs = gbases_[e];
-				const basis::ElementBases &bs = bases_[e];
+			auto storage = create_thread_storage(LocalThreadScalarStorage());
 
-				vals.compute(e, mesh_.is_volume(), points, bs, gbs);
+			maybe_parallel_for(local_neumann_boundary.size(), [&](int start, int end, int thread_id) {
+				LocalThreadScalarStorage &local_storage = get_local_thread_storage(storage, thread_id);
+				VectorNd local_displacement(size_);
+				Eigen::MatrixXd forces, normals;
 
-				for (int n = 0; n < vals.jac_it.size(); ++n)
+				for (int k = start; k < end; ++k)
 				{
-					normals.row(n) = normals.row(n) * vals.jac_it[n];
-					normals.row(n).normalize();
-				}
-				problem_.neumann_bc(mesh_, global_primitive_ids, uv, vals.val, normals, t, forces);
+					const auto &entry = entries[k];
+					if (!entry.has_samples)
+						continue;
 
-				// UIState::ui_state().debug_data().add_points(vals.val, Eigen::RowVector3d(1,0,0));
+					const ElementAssemblyValues &vals = entry.vals;
+					const Eigen::VectorXd &weights = entry.weights;
 
-				for (long p = 0; p < weights.size(); ++p)
-				{
-					local_displacement.setZero();
+					normals = entry.normals;
+					for (int n = 0; n < vals.jac_it.size(); ++n)
+					{
+						normals.row(n) = normals.row(n) * vals.jac_it[n];
+						normals.row(n).normalize();
+					}
+					problem_.neumann_bc(mesh_, entry.global_primitive_ids, entry.uv, vals.val, normals, t, forces);
 
-					for (size_t i = 0; i < vals.basis_values.size(); ++i)
+					// UIState::ui_state().debug_data().add_points(vals.val, Eigen::RowVector3d(1,0,0));
+
+					for (long p = 0; p < weights.size(); ++p)
 					{
-						const auto &vv = vals.basis_values[i];
-						assert(vv.val.size() == weights.size());
-						const double b_val = vv.val(p);
+						local_displacement.setZero();
 
-						for (int d = 0; d < size_; ++d)
+						for (size_t i = 0; i < vals.basis_values.size(); ++i)
 						{
-							for (std::size_t ii = 0; ii < vv.global.size(); ++ii)
+							const auto &vv = vals.basis_values[i];
+							assert(vv.val.size() == weights.size());
+							const double b_val = vv.val(p);
+
+							for (int d = 0; d < size_; ++d)
 							{
-								local_displacement(d) += (vv.global[ii].val * b_val) * displacement(vv.global[ii].index * size_ + d);
+								for (std::size_t ii = 0; ii < vv.global.size(); ++ii)
+								{
+									local_displacement(d) += (vv.global[ii].val * b_val) * displacement(vv.global[ii].index * size_ + d);
+								}
 							}
 						}
-					}
 
-					for (int d = 0; d < size_; ++d)
-						res -= forces(p, d) * local_displacement(d) * weights(p);
+						for (int d = 0; d < size_; ++d)
+							local_storage.val -= forces(p, d) * local_displacement(d) * weights(p);
+					}
 				}
-			}
+			});
+
+			// Serially merge local storages
+			for (const LocalThreadScalarStorage &local_storage : storage)
+				res += local_storage.val;
 
 			return res;
 		}
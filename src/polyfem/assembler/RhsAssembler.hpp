@@ -1,12 +1,17 @@
 #pragma once
 
 #include <polyfem/assembler/Assembler.hpp>
+#include <polyfem/assembler/BoundaryQuadratureCache.hpp>
 #include <polyfem/mesh/Obstacle.hpp>
 
 #include <polyfem/assembler/Problem.hpp>
 #include <polyfem/assembler/MatParams.hpp>
 #include <polyfem/mesh/LocalBoundary.hpp>
 
+#include <polysolve/LinearSolver.hpp>
+
+#include <memory>
+
 namespace polyfem
 {
 	namespace assembler
@@ -53,6 +58,61 @@ namespace polyfem
 			void lsq_bc(const std::function<void(const Eigen::MatrixXi &, const Eigen::MatrixXd &, const Eigen::MatrixXd &, Eigen::MatrixXd &)> &df,
 						const std::vector<mesh::LocalBoundary> &local_boundary, const std::vector<int> &bounday_nodes, const int resolution, Eigen::MatrixXd &rhs) const;
 
+			// least-squares projection of the Dirichlet bc, it depends only on the boundary and is reused across calls (e.g., time steps)
+			struct LsqProjection
+			{
+				// dimensions projected with this operator, all of them when every dimension is Dirichlet
+				std::vector<int> dims;
+				// sampled points of the operator (block of the sampled boundary, sample in the block)
+				std::vector<std::pair<int, int>> rows;
+				// boundary bases (columns)
+				std::vector<int> indices;
+				// columns x dims, the dimension is Dirichlet for the tag of the sample that added the column
+				Eigen::Array<bool, Eigen::Dynamic, Eigen::Dynamic> is_dirichlet;
+				StiffnessMatrix mat_t;
+				// factorization of mat_t * mat
+				std::unique_ptr<polysolve::LinearSolver> solver;
+			};
+
+			struct LsqCache
+			{
+				// boundary configuration the cache has been built for
+				std::vector<int> signature;
+				// primitives of the samples of every sampled local boundary (block)
+				std::vector<Eigen::VectorXi> global_primitive_ids;
+				// inputs of the bc function, the blocks with the same uv size are concatenated so that the
+				// bc function is called once per batch and evaluates each bc entry once
+				struct Batch
+				{
+					std::vector<int> blocks;
+					Eigen::VectorXi global_primitive_ids;
+					Eigen::MatrixXd uv;
+					Eigen::MatrixXd mapped;
+				};
+				std::vector<Batch> batches;
+				std::vector<LsqProjection> projections;
+			};
+
+			// builds the sampling operators and factorizes the normal equations of lsq_bc
+			void build_lsq_cache(const std::vector<mesh::LocalBoundary> &local_boundary, const std::vector<int> &bounday_nodes, const int resolution, const std::vector<int> &signature) const;
+
+			// loads integrated once, see Problem::TimeDependence
+			struct LoadCache
+			{
+				std::vector<int> signature;
+				const Density *density = nullptr;
+				// spatial part, the load at t is scaling(t) * values
+				Eigen::MatrixXd values;
+			};
+
+			// body force of assemble if it is constant or separable in time, false if it has to be assembled
+			bool cached_body_force(const Density &density, const double t, Eigen::MatrixXd &rhs) const;
+
+			// integrates the Neumann loads nf on the dofs not in bounday_nodes, neumann has size rows
+			void integrate_neumann(const std::function<void(const Eigen::MatrixXi &, const Eigen::MatrixXd &, const Eigen::MatrixXd &, const Eigen::MatrixXd &, Eigen::MatrixXd &)> &nf,
+								   const std::vector<mesh::LocalBoundary> &local_neumann_boundary, const std::vector<int> &bounday_nodes, const int resolution,
+								   const Eigen::MatrixXd &displacement, const int size, Eigen::MatrixXd &neumann) const;
+
 			// integrate bc
 			void integrate_bc(const std::function<void(const Eigen::MatrixXi &, const Eigen::MatrixXd &, const Eigen::MatrixXd &, Eigen::MatrixXd &)> &df,
 							  const std::vector<mesh::LocalBoundary> &local_boundary, const std::vector<int> &bounday_nodes, const int resolution, Eigen::MatrixXd &rhs) const;
@@ -91,6 +151,13 @@ namespace polyfem
 			const std::vector<RowVectorNd> &dirichlet_nodes_position_;
 			const std::vector<int> &neumann_nodes_;
 			const std::vector<RowVectorNd> &neumann_nodes_position_;
+
+			mutable LsqCache lsq_cache_;
+			// quadrature of the Dirichlet (integrate_bc) and Neumann boundaries
+			mutable BoundaryQuadratureCache dirichlet_quadrature_cache_;
+			mutable BoundaryQuadratureCache neumann_quadrature_cache_;
+			mutable LoadCache body_cache_;
+			mutable LoadCache neumann_cache_;
 		};
 	} // namespace assembler
 } // namespace polyfem
@@ -1,5 +1,6 @@
 #include "SaintVenantElasticity.hpp"
 
+#include <polyfem/assembler/ElasticKernels.hpp>
 #include <polyfem/autogen/auto_elasticity_rhs.hpp>
 
 namespace polyfem::assembler
@@ -17,6 +18,25 @@ namespace polyfem::assembler
 
 			return mat;
 		}
+
+		template <int dim>
+		struct SaintVenantMaterial
+		{
+			static constexpr int n_voigt = dim == 2 ? 3 : 6;
+			double voigt[n_voigt * n_voigt];
+
+			explicit SaintVenantMaterial(const ElasticityTensor &tensor)
+			{
+				for (int v = 0; v < n_voigt; ++v)
+					for (int w = 0; w < n_voigt; ++w)
+						voigt[v * n_voigt + w] = tensor(v, w);
+			}
+
+			double operator()(const int p, const double *grad_u, double *P, double *C) const
+			{
+				return kernels::saint_venant<dim>(voigt, grad_u, P, C);
+			}
+		};
 	} // namespace
 
 	SaintVenantElasticity::SaintVenantElasticity()
@@ -88,43 +108,56 @@ namespace polyfem::assembler
 	Eigen::VectorXd
 	SaintVenantElasticity::assemble_gradient(const NonLinearAssemblerData &data) const
 	{
-		// igl::Timer time; time.start();
-
 		const int n_bases = data.vals.basis_values.size();
+		Eigen::VectorXd grads, local_disp;
+		flatten_element_data(data, size(), grads, local_disp);
 
-		return polyfem::gradient_from_energy(
-			size(), n_bases, data,
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, 6, 1>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, 8, 1>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, 12, 1>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, 18, 1>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, 24, 1>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, 30, 1>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, 60, 1>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, 81, 1>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, Eigen::Dynamic, 1, 0, SMALL_N, 1>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::Matrix<double, Eigen::Dynamic, 1, 0, BIG_N, 1>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar1<double, Eigen::VectorXd>>(data); });
+		Eigen::VectorXd res(n_bases * size());
+		if (size() == 2)
+			kernels::element_gradient<2>(n_bases, data.da.size(), grads.data(), data.da.data(), local_disp.data(), SaintVenantMaterial<2>(elasticity_tensor_), res.data());
+		else
+			kernels::element_gradient<3>(n_bases, data.da.size(), grads.data(), data.da.data(), local_disp.data(), SaintVenantMaterial<3>(elasticity_tensor_), res.data());
+		return res;
 	}
 
 	Eigen::MatrixXd
 	SaintVenantElasticity::assemble_hessian(const NonLinearAssemblerData &data) const
 	{
-		// igl::Timer time; time.start();
+		const int n_bases = data.vals.basis_values.size();
+		Eigen::VectorXd grads, local_disp;
+		flatten_element_data(data, size(), grads, local_disp);
+
+		// the kernels write row major
+		Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> res(n_bases * size(), n_bases * size());
+		if (size() == 2)
+			kernels::element_hessian<2>(n_bases, data.da.size(), grads.data(), data.da.data(), local_disp.data(), SaintVenantMaterial<2>(elasticity_tensor_), res.data());
+		else
+			kernels::element_hessian<3>(n_bases, data.da.size(), grads.data(), data.da.data(), local_disp.data(), SaintVenantMaterial<3>(elasticity_tensor_), res.data());
+		return res;
+	}
 
+	void SaintVenantElasticity::compute_energy_gradient_hessian(const NonLinearAssemblerData &data, double *energy, Eigen::VectorXd *gradient, Eigen::MatrixXd *hessian) const
+	{
 		const int n_bases = data.vals.basis_values.size();
-		return polyfem::hessian_from_energy(
-			size(), n_bases, data,
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::Matrix<double, 6, 1>, Eigen::Matrix<double, 6, 6>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::Matrix<double, 8, 1>, Eigen::Matrix<double, 8, 8>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::Matrix<double, 12, 1>, Eigen::Matrix<double, 12, 12>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::Matrix<double, 18, 1>, Eigen::Matrix<double, 18, 18>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::Matrix<double, 24, 1>, Eigen::Matrix<double, 24, 24>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::Matrix<double, 30, 1>, Eigen::Matrix<double, 30, 30>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::Matrix<double, 60, 1>, Eigen::Matrix<double, 60, 60>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::Matrix<double, 81, 1>, Eigen::Matrix<double, 81, 81>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::Matrix<double, Eigen::Dynamic, 1, 0, SMALL_N, 1>, Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, 0, SMALL_N, SMALL_N>>>(data); },
-			[&](const NonLinearAssemblerData &data) { return compute_energy_aux<DScalar2<double, Eigen::VectorXd, Eigen::MatrixXd>>(data); });
+		Eigen::VectorXd grads, local_disp;
+		flatten_element_data(data, size(), grads, local_disp);
+
+		// the kernels write row major
+		Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> hess;
+		if (gradient)
+			gradient->resize(n_bases * size());
+		if (hessian)
+			hess.resize(n_bases * size(), n_bases * size());
+		double *gradient_data = gradient ? gradient->data() : nullptr;
+		double *hessian_data = hessian ? hess.data() : nullptr;
+
+		if (size() == 2)
+			kernels::element_energy_gradient_hessian<2>(n_bases, data.da.size(), grads.data(), data.da.data(), local_disp.data(), SaintVenantMaterial<2>(elasticity_tensor_), energy, gradient_data, hessian_data);
+		else
+			kernels::element_energy_gradient_hessian<3>(n_bases, data.da.size(), grads.data(), data.da.data(), local_disp.data(), SaintVenantMaterial<3>(elasticity_tensor_), energy, gradient_data, hessian_data);
+
+		if (hessian)
+			*hessian = hess;
 	}
 
 	void SaintVenantElasticity::assign_stress_tensor(const int el_id, const basis::ElementBases &bs, const basis::ElementBases &gbs, const Eigen::MatrixXd &local_pts, const Eigen::MatrixXd &displacement, const int all_size, const ElasticityTensorType &type, Eigen::MatrixXd &all, const std::function<Eigen::MatrixXd(const Eigen::MatrixXd &)> &fun) const
@@ -20,6 +20,7 @@ namespace polyfem::assembler
 		double compute_energy(const NonLinearAssemblerData &data) const override;
 		Eigen::VectorXd assemble_gradient(const NonLinearAssemblerData &data) const override;
 		Eigen::MatrixXd assemble_hessian(const NonLinearAssemblerData &data) const override;
+		void compute_energy_gradient_hessian(const NonLinearAssemblerData &data, double *energy, Eigen::VectorXd *gradient, Eigen::MatrixXd *hessian) const override;
 
 		VectorNd compute_rhs(const AutodiffHessianPt &pt) const override;
 
@@ -29,6 +30,8 @@ namespace polyfem::assembler
 		double stifness_tensor(int i, int j) const;
 
 		void add_multimaterial(const int index, const json &params) override;
+		// the stiffness tensor is given by numbers
+		bool has_time_dependent_parameters() const override { return false; }
 
 		std::string name() const override { return "SaintVenant"; }
 		std::map<std::string, ParamFunc> parameters() const override;
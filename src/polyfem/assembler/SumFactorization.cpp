@@ -0,0 +1,320 @@
+#include "SumFactorization.hpp"
+
+#include <polyfem/assembler/ElementAssemblyValues.hpp>
+#include <polyfem/autogen/all_bases.hpp>
+
+#include <polyfem/utils/MaybeParallelFor.hpp>
+
+#include <cmath>
+#include <map>
+
+namespace polyfem::assembler
+{
+	using namespace basis;
+	using namespace quadrature;
+	using namespace utils;
+
+	namespace
+	{
+		// one dimensional rule of a tensor-product quadrature (first coordinate fastest), false if it is not one
+		bool line_quadrature(const int dim, const Quadrature &quad, Eigen::VectorXd &points, Eigen::VectorXd &weights)
+		{
+			const int n = int(std::lround(std::pow(quad.size(), 1. / dim)));
+			if (n <= 0 || std::pow(n, dim) != quad.size())
+				return false;
+
+			points = quad.points.col(0).head(n);
+			// the first n weights are w_0^(dim - 1) w_k and the 1D weights sum to one
+			const double w0 = std::pow(quad.weights.head(n).sum(), 1. / (dim - 1));
+			weights = quad.weights.head(n) / std::pow(w0, dim - 1);
+
+			for (int q = 0; q < quad.size(); ++q)
+			{
+				double w = 1;
+				for (int d = 0, r = q; d < dim; ++d, r /= n)
+				{
+					if (std::abs(quad.points(q, d) - points(r % n)) > 1e-12)
+						return false;
+					w *= weights(r % n);
+				}
+				if (std::abs(quad.weights(q) - w) > 1e-12)
+					return false;
+			}
+			return true;
+		}
+	} // namespace
+
+	bool SumFactorization::init(const int dim, const ElementBases &basis)
+	{
+		const auto element = basis.reference_element();
+		if (element != (dim == 3 ? reference_tables::ReferenceElement::HEXAHEDRON : reference_tables::ReferenceElement::QUAD) || basis.reference_order() < 1)
+			return false;
+
+		Quadrature quad;
+		basis.compute_quadrature(quad);
+		Eigen::VectorXd points, weights;
+		if (!line_quadrature(dim, quad, points, weights))
+			return false;
+
+		dim_ = dim;
+		order_ = basis.reference_order();
+		quadrature_ = quad;
+
+		Eigen::ArrayXXd val, grad;
+		autogen::q_lagrange_1d(order_, points.array(), val, grad);
+		val_1d_ = val.matrix();
+		grad_1d_ = grad.matrix();
+		val_1d_t_ = val_1d_.transpose();
+		grad_1d_t_ = grad_1d_.transpose();
+
+		const Eigen::MatrixXi indices = autogen::q_tensor_indices(order_, dim);
+		assert(indices.rows() == basis.bases.size());
+		local_to_tensor_.resize(indices.rows());
+		for (int j = 0; j < indices.rows(); ++j)
+		{
+			int index = 0;
+			for (int d = dim - 1; d >= 0; --d)
+				index = index * (order_ + 1) + indices(j, d);
+			local_to_tensor_[j] = index;
+		}
+
+		return true;
+	}
+
+	void SumFactorization::contract(const std::vector<const Eigen::MatrixXd *> &mats, const Eigen::VectorXd &in, Eigen::VectorXd &out) const
+	{
+		Eigen::VectorXd tmp = in;
+		std::vector<int> sizes(dim_);
+		for (int d = 0; d < dim_; ++d)
+			sizes[d] = mats[d]->cols();
+
+		for (int d = 0; d < dim_; ++d)
+		{
+			const Eigen::MatrixXd &m = *mats[d];
+			int left = 1, right = 1;
+			for (int o = 0; o < d; ++o)
+				left *= sizes[o];
+			for (int o = d + 1; o < dim_; ++o)
+				right *= sizes[o];
+
+			// each slice is a left x cols matrix, multiplied by m^T along the direction d
+			out.resize(left * m.rows() * right);
+			for (int r = 0; r < right; ++r)
+			{
+				Eigen::Map<const Eigen::MatrixXd> slice(tmp.data() + r * left * m.cols(), left, m.cols());
+				Eigen::Map<Eigen::MatrixXd>(out.data() + r * left * m.rows(), left, m.rows()).noalias() = slice * m.transpose();
+			}
+
+			sizes[d] = m.rows();
+			tmp.swap(out);
+		}
+		out.swap(tmp);
+	}
+
+	void SumFactorization::gradients(const Eigen::VectorXd &coeffs, Eigen::MatrixXd &grads) const
+	{
+		assert(coeffs.size() == n_bases());
+
+		Eigen::VectorXd tensor(n_bases());
+		for (int j = 0; j < n_bases(); ++j)
+			tensor[local_to_tensor_[j]] = coeffs[j];
+
+		grads.resize(n_points(), dim_);
+		Eigen::VectorXd tmp;
+		std::vector<const Eigen::MatrixXd *> mats(dim_);
+		for (int d = 0; d < dim_; ++d)
+		{
+			for (int o = 0; o < dim_; ++o)
+				mats[o] = o == d ? &grad_1d_ : &val_1d_;
+			contract(mats, tensor, tmp);
+			grads.col(d) = tmp;
+		}
+	}
+
+	void SumFactorization::integrate_gradients(const Eigen::MatrixXd &fluxes, Eigen::VectorXd &res) const
+	{
+		assert(fluxes.rows() == n_points() && fluxes.cols() == dim_);
+
+		Eigen::VectorXd tensor = Eigen::VectorXd::Zero(n_bases());
+		Eigen::VectorXd tmp;
+		std::vector<const Eigen::MatrixXd *> mats(dim_);
+		for (int d = 0; d < dim_; ++d)
+		{
+			for (int o = 0; o < dim_; ++o)
+				mats[o] = o == d ? &grad_1d_t_ : &val_1d_t_;
+			contract(mats, fluxes.col(d), tmp);
+			tensor += tmp;
+		}
+
+		res.resize(n_bases());
+		for (int j = 0; j < n_bases(); ++j)
+			res[j] = tensor[local_to_tensor_[j]];
+	}
+
+	SumFactorizedLaplacian::SumFactorizedLaplacian(const bool is_volume, const int n_bases, const std::vector<ElementBases> &bases, const std::vector<ElementBases> &gbases)
+		: bases_(bases), n_bases_(n_bases), dim_(is_volume ? 3 : 2)
+	{
+		// elements with the same order and quadrature share their tables
+		std::map<std::pair<int, int>, std::shared_ptr<const SumFactorization>> tables;
+		std::vector<std::shared_ptr<const SumFactorization>> element_tables(bases.size());
+		for (size_t e = 0; e < bases.size(); ++e)
+		{
+			auto tensor = std::make_shared<SumFactorization>();
+			if (!tensor->init(dim_, bases[e]))
+				continue;
+
+			auto &shared = tables[std::make_pair(tensor->order(), tensor->n_points())];
+			if (!shared)
+				shared = tensor;
+			element_tables[e] = shared;
+			++n_sum_factorized_;
+		}
+
+		elements_.resize(bases.size());
+		maybe_parallel_for(bases.size(), [&](int start, int end, int thread_id) {
+			ElementAssemblyValues vals;
+			for (int e = start; e < end; ++e)
+			{
+				Element &el = elements_[e];
+				el.tables = element_tables[e];
+
+				if (el.tables)
+				{
+					// only the geometric mapping is needed
+					const Quadrature &quad = el.tables->quadrature();
+					vals.compute(e, is_volume, quad.points, gbases[e], gbases[e]);
+
+					el.factors.resize(dim_ * dim_, quad.size());
+					for (int q = 0; q < quad.size(); ++q)
+					{
+						const Eigen::MatrixXd g = quad.weights(q) * vals.det(q) * vals.jac_it[q] * vals.jac_it[q].transpose();
+						el.factors.col(q) = Eigen::Map<const Eigen::VectorXd>(g.data(), g.size());
+					}
+				}
+				else
+				{
+					vals.compute(e, is_volume, bases[e], gbases[e]);
+					const Eigen::VectorXd da = vals.det.array() * vals.quadrature.weights.array();
+					const int n_loc = vals.basis_values.size();
+
+					el.stiffness.setZero(n_loc, n_loc);
+					Eigen::MatrixXd grads(da.size(), n_loc);
+					for (int d = 0; d < dim_; ++d)
+					{
+						for (int j = 0; j < n_loc; ++j)
+							grads.col(j) = vals.basis_values[j].grad_t_m.col(d);
+						el.stiffness += grads.transpose() * da.asDiagonal() * grads;
+					}
+				}
+			}
+		});
+	}
+
+	void SumFactorizedLaplacian::apply(const Eigen::VectorXd &v, Eigen::VectorXd &out) const
+	{
+		assert(v.size() == n_bases_);
+
+		auto storage = create_thread_storage(Eigen::VectorXd(Eigen::VectorXd::Zero(n_bases_)));
+
+		maybe_parallel_for(elements_.size(), [&](int start, int end, int thread_id) {
+			Eigen::VectorXd &local_out = get_local_thread_storage(storage, thread_id);
+			Eigen::VectorXd local_v, res;
+			Eigen::MatrixXd grads, fluxes;
+
+			for (int e = start; e < end; ++e)
+			{
+				const Element &el = elements_[e];
+				const auto &bs = bases_[e].bases;
+
+				local_v.setZero(bs.size());
+				for (size_t j = 0; j < bs.size(); ++j)
+				{
+					for (const auto &g : bs[j].global())
+						local_v[j] += g.val * v[g.index];
+				}
+
+				if (el.tables)
+				{
+					el.tables->gradients(local_v, grads);
+					fluxes.resize(grads.rows(), dim_);
+					for (int q = 0; q < grads.rows(); ++q)
+						fluxes.row(q) = grads.row(q) * Eigen::Map<const Eigen::MatrixXd>(el.factors.col(q).data(), dim_, dim_);
+					el.tables->integrate_gradients(fluxes, res);
+				}
+				else
+					res = el.stiffness * local_v;
+
+				for (size_t j = 0; j < bs.size(); ++j)
+				{
+					for (const auto &g : bs[j].global())
+						local_out[g.index] += g.val * res[j];
+				}
+			}
+		});
+
+		out.setZero(n_bases_);
+		for (const auto &local_out : storage)
+			out += local_out;
+	}
+
+	Eigen::VectorXd SumFactorizedLaplacian::diagonal() const
+	{
+		// reference gradients of every local basis, shared by the elements with the same tables
+		std::map<const SumFactorization *, std::vector<Eigen::MatrixXd>> basis_grads;
+		for (const Element &el : elements_)
+		{
+			if (!el.tables || basis_grads.count(el.tables.get()))
+				continue;
+
+			std::vector<Eigen::MatrixXd> &grads = basis_grads[el.tables.get()];
+			grads.resize(el.tables->n_bases());
+			for (int j = 0; j < el.tables->n_bases(); ++j)
+				el.tables->gradients(Eigen::VectorXd::Unit(el.tables->n_bases(), j), grads[j]);
+		}
+
+		auto storage = create_thread_storage(Eigen::VectorXd(Eigen::VectorXd::Zero(n_bases_)));
+
+		maybe_parallel_for(elements_.size(), [&](int start, int end, int thread_id) {
+			Eigen::VectorXd &local_diagonal = get_local_thread_storage(storage, thread_id);
+
+			for (int e = start; e < end; ++e)
+			{
+				const Element &el = elements_[e];
+				const auto &bs = bases_[e].bases;
+				const std::vector<Eigen::MatrixXd> *grads = el.tables ? &basis_grads.at(el.tables.get()) : nullptr;
+
+				// entry (j, k) of the local matrix
+				const auto local_entry = [&](const int j, const int k) {
+					if (!grads)
+						return el.stiffness(j, k);
+
+					double res = 0;
+					for (int q = 0; q < el.factors.cols(); ++q)
+						res += (*grads)[j].row(q).dot((*grads)[k].row(q) * Eigen::Map<const Eigen::MatrixXd>(el.factors.col(q).data(), dim_, dim_));
+					return res;
+				};
+
+				// only the pairs of local bases sharing a global node contribute, usually j == k
+				for (size_t j = 0; j < bs.size(); ++j)
+				{
+					for (size_t k = 0; k < bs.size(); ++k)
+					{
+						for (const auto &g : bs[j].global())
+						{
+							for (const auto &h : bs[k].global())
+							{
+								if (g.index == h.index)
+									local_diagonal[g.index] += g.val * h.val * local_entry(j, k);
+							}
+						}
+					}
+				}
+			}
+		});
+
+		Eigen::VectorXd diagonal = Eigen::VectorXd::Zero(n_bases_);
+		for (const auto &local_diagonal : storage)
+			diagonal += local_diagonal;
+		return diagonal;
+	}
+} // namespace polyfem::assembler
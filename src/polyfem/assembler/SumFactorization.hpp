@@ -0,0 +1,97 @@
+#pragma once
+
+#include <polyfem/basis/ElementBases.hpp>
+#include <polyfem/quadrature/Quadrature.hpp>
+
+#include <Eigen/Dense>
+
+#include <memory>
+#include <vector>
+
+namespace polyfem
+{
+	namespace assembler
+	{
+		/// @brief Sum-factorized evaluation of the Q_k Lagrange bases of a quad or hex at a tensor-product quadrature.
+		/// The bases and the quadrature points are products of one dimensional ones, so the gradients at all the points
+		/// are computed by contracting one direction at a time, O(k^(dim + 1)) instead of O(k^(2 dim)) per element.
+		/// The coefficients are in the local ordering of the element bases.
+		class SumFactorization
+		{
+		public:
+			/// @brief Builds the one dimensional tables of the element
+			/// @param[in] dim dimension of the element
+			/// @param[in] basis element bases, must be Q_k Lagrange bases (k >= 1, no serendipity)
+			/// @return false if the element is not a Q_k element or its quadrature is not a tensor product
+			bool init(const int dim, const basis::ElementBases &basis);
+
+			int dim() const { return dim_; }
+			int order() const { return order_; }
+			int n_bases() const { return local_to_tensor_.size(); }
+			int n_points() const { return quadrature_.size(); }
+			const quadrature::Quadrature &quadrature() const { return quadrature_; }
+
+			/// @brief Reference gradients at the quadrature points of the function with local coefficients coeffs
+			/// @param[in] coeffs #bases coefficients
+			/// @param[out] grads #points x dim gradients
+			void gradients(const Eigen::VectorXd &coeffs, Eigen::MatrixXd &grads) const;
+
+			/// @brief Transpose of gradients: res_i = sum_q fluxes(q, :) . grad phi_i(q)
+			/// @param[in] fluxes #points x dim values at the quadrature points
+			/// @param[out] res #bases integrated values
+			void integrate_gradients(const Eigen::MatrixXd &fluxes, Eigen::VectorXd &res) const;
+
+		private:
+			/// applies mats[d] along every direction d of the tensor in (first direction fastest)
+			void contract(const std::vector<const Eigen::MatrixXd *> &mats, const Eigen::VectorXd &in, Eigen::VectorXd &out) const;
+
+			int dim_ = 0;
+			int order_ = 0;
+			quadrature::Quadrature quadrature_;
+
+			/// 1D values and derivatives at the 1D points, #1D points x (k + 1)
+			Eigen::MatrixXd val_1d_, grad_1d_;
+			Eigen::MatrixXd val_1d_t_, grad_1d_t_;
+			/// position of the local bases in the tensor of coefficients
+			Eigen::VectorXi local_to_tensor_;
+		};
+
+		/// @brief Matrix-free application of the Laplacian stiffness matrix. Q_k quads and hexes use sum factorization with
+		/// precomputed geometric factors, the other elements keep their dense local matrix.
+		class SumFactorizedLaplacian
+		{
+		public:
+			/// @param[in] is_volume if the mesh is 3d
+			/// @param[in] n_bases number of global nodes
+			/// @param[in] bases bases
+			/// @param[in] gbases geometric bases
+			SumFactorizedLaplacian(const bool is_volume, const int n_bases, const std::vector<basis::ElementBases> &bases, const std::vector<basis::ElementBases> &gbases);
+
+			/// out = K v, in parallel over the elements
+			void apply(const Eigen::VectorXd &v, Eigen::VectorXd &out) const;
+
+			/// diagonal of K, for the Jacobi and Chebyshev smoothers
+			Eigen::VectorXd diagonal() const;
+
+			/// number of elements applied with sum factorization
+			int n_sum_factorized() const { return n_sum_factorized_; }
+
+		private:
+			struct Element
+			{
+				/// shared tables, nullptr for the dense elements
+				std::shared_ptr<const SumFactorization> tables;
+				/// w det J^-1 J^-T at the quadrature points, one column per point
+				Eigen::MatrixXd factors;
+				/// dense local matrix
+				Eigen::MatrixXd stiffness;
+			};
+
+			const std::vector<basis::ElementBases> &bases_;
+			const int n_bases_;
+			const int dim_;
+			std::vector<Element> elements_;
+			int n_sum_factorized_ = 0;
+		};
+	} // namespace assembler
+} // namespace polyfem
@@ -58,21 +58,8 @@ namespace polyfem::assembler
 		}
 	}
 
-	void ViscousDamping::add_multimaterial(const int index, const json &params)
+	std::shared_ptr<const ViscousDamping::ElementHistory> ViscousDamping::element_history(const NonLinearAssemblerData &data, Eigen::MatrixXd &local_disp) const
 	{
-		assert(size() == 2 || size() == 3);
-
-		if (params.contains("psi"))
-			psi_ = params["psi"];
-		if (params.contains("phi"))
-			phi_ = params["phi"];
-	}
-
-	// E := 0.5(F^T F - I), Compute Stress = \int dF/dt * (2\psi dE/dt + \phi Tr(dE/dt) I) : gradv du
-	Eigen::VectorXd
-	ViscousDamping::assemble_gradient(const NonLinearAssemblerData &data) const
-	{
-		Eigen::MatrixXd local_disp;
 		local_disp.setZero(data.vals.basis_values.size(), size());
 		Eigen::MatrixXd local_prev_disp = local_disp;
 		for (size_t i = 0; i < data.vals.basis_values.size(); ++i)
@@ -88,31 +75,78 @@ namespace polyfem::assembler
 			}
 		}
 
+		const int n_pts = data.da.size();
+		std::shared_ptr<const ElementHistory> old;
+		{
+			std::lock_guard<std::mutex> lock(history_mutex_);
+			const auto it = history_.find(data.vals.element_id);
+			if (it != history_.end())
+				old = it->second;
+		}
+		const bool same_geometry = old && old->grad_jac.size() == n_pts && n_pts > 0
+								   && old->local_prev_disp.rows() == local_prev_disp.rows()
+								   && old->jac_it == data.vals.jac_it[0];
+		if (same_geometry && old->local_prev_disp == local_prev_disp)
+			return old;
+
+		auto history = std::make_shared<ElementHistory>();
+		history->local_prev_disp = local_prev_disp;
+		if (n_pts > 0)
+			history->jac_it = data.vals.jac_it[0];
+		// only the previous deformation gradients are recomputed at a new time step
+		if (same_geometry)
+			history->grad_jac = old->grad_jac;
+		else
+		{
+			history->grad_jac.resize(n_pts);
+			Eigen::MatrixXd grad(data.vals.basis_values.size(), size());
+			for (long p = 0; p < n_pts; ++p)
+			{
+				for (size_t i = 0; i < data.vals.basis_values.size(); ++i)
+					grad.row(i) = data.vals.basis_values[i].grad.row(p);
+				history->grad_jac[p] = grad * data.vals.jac_it[p];
+			}
+		}
+
+		history->prev_def_grad.resize(n_pts);
+		for (long p = 0; p < n_pts; ++p)
+			history->prev_def_grad[p] = local_prev_disp.transpose() * history->grad_jac[p] + Eigen::MatrixXd::Identity(size(), size());
+
+		std::lock_guard<std::mutex> lock(history_mutex_);
+		history_[data.vals.element_id] = history;
+		return history;
+	}
+
+	void ViscousDamping::add_multimaterial(const int index, const json &params)
+	{
+		assert(size() == 2 || size() == 3);
+
+		if (params.contains("psi"))
+			psi_ = params["psi"];
+		if (params.contains("phi"))
+			phi_ = params["phi"];
+	}
+
+	// E := 0.5(F^T F - I), Compute Stress = \int dF/dt * (2\psi dE/dt + \phi Tr(dE/dt) I) : gradv du
+	Eigen::VectorXd
+	ViscousDamping::assemble_gradient(const NonLinearAssemblerData &data) const
+	{
+		Eigen::MatrixXd local_disp;
+		const std::shared_ptr<const ElementHistory> history = element_history(data, local_disp);
+
 		Eigen::MatrixXd G;
 		G.setZero(data.vals.basis_values.size(), size());
 
 		const int n_pts = data.da.size();
 
-		Eigen::MatrixXd def_grad(size(), size()), prev_def_grad(size(), size());
+		Eigen::MatrixXd def_grad(size(), size());
 		for (long p = 0; p < n_pts; ++p)
 		{
-			def_grad.setZero();
-			prev_def_grad.setZero();
+			const Eigen::MatrixXd &delF_delU = history->grad_jac[p];
 
-			Eigen::MatrixXd grad(data.vals.basis_values.size(), size());
+			def_grad = local_disp.transpose() * delF_delU + Eigen::MatrixXd::Identity(size(), size());
 
-			for (size_t i = 0; i < data.vals.basis_values.size(); ++i)
-			{
-				grad.row(i) = data.vals.basis_values[i].grad.row(p);
-			}
-
-			Eigen::MatrixXd jac_it = data.vals.jac_it[p];
-
-			def_grad = local_disp.transpose() * grad * jac_it + Eigen::MatrixXd::Identity(size(), size());
-			prev_def_grad = local_prev_disp.transpose() * grad * jac_it + Eigen::MatrixXd::Identity(size(), size());
-
-			Eigen::MatrixXd delF_delU = grad * jac_it;
-			auto dFdt = (def_grad - prev_def_grad) / data.dt;
+			auto dFdt = (def_grad - history->prev_def_grad[p]) / data.dt;
 
 			Eigen::MatrixXd dRdF, dRdFdot;
 			Eigen::MatrixXd dEdt = 0.5 * (dFdt.transpose() * def_grad + def_grad.transpose() * dFdt);
@@ -136,41 +170,20 @@ namespace polyfem::assembler
 		hessian.setZero(data.vals.basis_values.size() * size(), data.vals.basis_values.size() * size());
 
 		Eigen::MatrixXd local_disp;
-		local_disp.setZero(data.vals.basis_values.size(), size());
-		Eigen::MatrixXd local_prev_disp = local_disp;
-		for (size_t i = 0; i < data.vals.basis_values.size(); ++i)
-		{
-			const auto &bs = data.vals.basis_values[i];
-			for (size_t ii = 0; ii < bs.global.size(); ++ii)
-			{
-				for (int d = 0; d < size(); ++d)
-				{
-					local_disp(i, d) += bs.global[ii].val * data.x(bs.global[ii].index * size() + d);
-					local_prev_disp(i, d) += bs.global[ii].val * data.x_prev(bs.global[ii].index * size() + d);
-				}
-			}
-		}
+		const std::shared_ptr<const ElementHistory> history = element_history(data, local_disp);
 
 		const int n_pts = data.da.size();
 
-		Eigen::MatrixXd def_grad(size(), size()), prev_def_grad(size(), size());
+		Eigen::MatrixXd def_grad(size(), size());
 		Eigen::MatrixXd d2RdF2, d2RdFdFdot, d2RdFdot2;
 		Eigen::MatrixXd hessian_temp, hessian_temp2;
 		for (long p = 0; p < n_pts; ++p)
 		{
-			Eigen::MatrixXd grad(data.vals.basis_values.size(), size());
+			const Eigen::MatrixXd &grad_jac = history->grad_jac[p];
 
-			for (size_t i = 0; i < data.vals.basis_values.size(); ++i)
-			{
-				grad.row(i) = data.vals.basis_values[i].grad.row(p);
-			}
-
-			Eigen::MatrixXd jac_it = data.vals.jac_it[p];
+			def_grad = local_disp.transpose() * grad_jac + Eigen::MatrixXd::Identity(size(), size());
 
-			def_grad = local_disp.transpose() * grad * jac_it + Eigen::MatrixXd::Identity(size(), size());
-			prev_def_grad = local_prev_disp.transpose() * grad * jac_it + Eigen::MatrixXd::Identity(size(), size());
-
-			Eigen::MatrixXd dFdt = (def_grad - prev_def_grad) / data.dt;
+			Eigen::MatrixXd dFdt = (def_grad - history->prev_def_grad[p]) / data.dt;
 			compute_stress_grad_aux(def_grad, dFdt, d2RdF2, d2RdFdFdot, d2RdFdot2);
 
 			hessian_temp = d2RdF2 + (1. / data.dt) * (d2RdFdFdot + d2RdFdFdot.transpose()) + (1. / data.dt / data.dt) * d2RdFdot2;
@@ -181,7 +194,7 @@ namespace polyfem::assembler
 						for (int l = 0; l < size(); l++)
 							hessian_temp(i + j * size(), k + l * size()) = hessian_temp2(i * size() + j, k * size() + l);
 
-			Eigen::MatrixXd delF_delU_tensor(jac_it.size(), grad.size());
+			Eigen::MatrixXd delF_delU_tensor(size() * size(), grad_jac.size());
 
 			for (size_t i = 0; i < local_disp.rows(); ++i)
 			{
@@ -189,8 +202,7 @@ namespace polyfem::assembler
 				{
 					Eigen::MatrixXd temp;
 					temp.setZero(size(), size());
-					temp.row(j) = grad.row(i);
-					temp = temp * jac_it;
+					temp.row(j) = grad_jac.row(i);
 					Eigen::VectorXd temp_flattened(Eigen::Map<Eigen::VectorXd>(temp.data(), temp.size()));
 					delF_delU_tensor.col(i * size() + j) = temp_flattened;
 				}
@@ -206,52 +218,17 @@ namespace polyfem::assembler
 	double ViscousDamping::compute_energy(const NonLinearAssemblerData &data) const
 	{
 		Eigen::MatrixXd local_disp;
-		local_disp.setZero(data.vals.basis_values.size(), size());
-		Eigen::MatrixXd local_prev_disp = local_disp;
-		for (size_t i = 0; i < data.vals.basis_values.size(); ++i)
-		{
-			const auto &bs = data.vals.basis_values[i];
-			for (size_t ii = 0; ii < bs.global.size(); ++ii)
-			{
-				for (int d = 0; d < size(); ++d)
-				{
-					local_disp(i, d) += bs.global[ii].val * data.x(bs.global[ii].index * size() + d);
-					local_prev_disp(i, d) += bs.global[ii].val * data.x_prev(bs.global[ii].index * size() + d);
-				}
-			}
-		}
+		const std::shared_ptr<const ElementHistory> history = element_history(data, local_disp);
 
 		double energy = 0;
 		const int n_pts = data.da.size();
 
-		Eigen::MatrixXd def_grad(size(), size()), prev_def_grad(size(), size());
+		Eigen::MatrixXd def_grad(size(), size());
 		for (long p = 0; p < n_pts; ++p)
 		{
-			def_grad.setZero();
-			prev_def_grad.setZero();
-
-			for (size_t i = 0; i < data.vals.basis_values.size(); ++i)
-			{
-				const auto &bs = data.vals.basis_values[i];
-
-				for (int d = 0; d < size(); ++d)
-				{
-					for (int c = 0; c < size(); ++c)
-					{
-						def_grad(d, c) += bs.grad(p, c) * local_disp(i, d);
-						prev_def_grad(d, c) += bs.grad(p, c) * local_prev_disp(i, d);
-					}
-				}
-			}
-
-			Eigen::MatrixXd jac_it(size(), size());
-			for (long k = 0; k < jac_it.size(); ++k)
-				jac_it(k) = data.vals.jac_it[p](k);
-
-			def_grad = def_grad * jac_it + Eigen::MatrixXd::Identity(size(), size());
-			prev_def_grad = prev_def_grad * jac_it + Eigen::MatrixXd::Identity(size(), size());
+			def_grad = local_disp.transpose() * history->grad_jac[p] + Eigen::MatrixXd::Identity(size(), size());
 
-			Eigen::MatrixXd dFdt = (def_grad - prev_def_grad) / data.dt;
+			Eigen::MatrixXd dFdt = (def_grad - history->prev_def_grad[p]) / data.dt;
 			Eigen::MatrixXd dEdt = 0.5 * (dFdt.transpose() * def_grad + def_grad.transpose() * dFdt);
 
 			double val = psi_ * dEdt.squaredNorm() + 0.5 * phi_ * pow(dEdt.trace(), 2);
@@ -2,6 +2,11 @@
 
 #include <polyfem/assembler/Assembler.hpp>
 
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
 // non linear NeoHookean material model
 namespace polyfem
 {
@@ -38,10 +43,33 @@ namespace polyfem
 
 			bool is_valid() const { return (psi_ > 0) && (phi_ > 0); }
 
+			// the damping depends on the velocity (displacement - displacement_prev) / dt
+			bool is_history_dependent() const override { return true; }
+
 		private:
 			// material parameters controlling shear and bulk damping
 			double psi_ = 0, phi_ = 0;
 
+			// quantities of an element that do not change during a time step, they are shared by the
+			// newton iterations and line search trials until the previous displacement changes
+			struct ElementHistory
+			{
+				// nodal previous displacement of the element, the entry is rebuilt when it changes
+				Eigen::MatrixXd local_prev_disp;
+				// inverse transposed jacobian at the first quadrature point, to detect a change of geometry
+				Eigen::MatrixXd jac_it;
+				// gradients of the bases wrt the physical coordinates at every quadrature point
+				std::vector<Eigen::MatrixXd> grad_jac;
+				// previous deformation gradient at every quadrature point
+				std::vector<Eigen::MatrixXd> prev_def_grad;
+			};
+
+			// gathers the nodal displacement of the element and returns its history, built if needed
+			std::shared_ptr<const ElementHistory> element_history(const NonLinearAssemblerData &data, Eigen::MatrixXd &local_disp) const;
+
+			mutable std::mutex history_mutex_;
+			mutable std::unordered_map<int, std::shared_ptr<const ElementHistory>> history_;
+
 			void compute_stress_aux(const Eigen::MatrixXd &F, const Eigen::MatrixXd &dFdt, Eigen::MatrixXd &dRdF, Eigen::MatrixXd &dRdFdot) const;
 			void compute_stress_grad_aux(const Eigen::MatrixXd &F, const Eigen::MatrixXd &dFdt, Eigen::MatrixXd &d2RdF2, Eigen::MatrixXd &d2RdFdFdot, Eigen::MatrixXd &d2RdFdot2) const;
 		};
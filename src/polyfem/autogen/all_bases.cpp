@@ -0,0 +1,295 @@
+#include "all_bases.hpp"
+
+#include "auto_p_bases.hpp"
+#include "auto_q_bases.hpp"
+
+#include <cassert>
+#include <cmath>
+
+namespace polyfem
+{
+	namespace autogen
+	{
+		namespace
+		{
+			// exponents of the factors of every basis, one row per basis
+			// the simplex bases have an extra factor for the last barycentric coordinate
+			Eigen::MatrixXi exponents(const Eigen::MatrixXd &nodes, const int order, const bool simplex)
+			{
+				const int dim = nodes.cols();
+				Eigen::MatrixXi res(nodes.rows(), simplex ? dim + 1 : dim);
+				for (int i = 0; i < nodes.rows(); ++i)
+				{
+					for (int d = 0; d < dim; ++d)
+						res(i, d) = int(std::lround(nodes(i, d) * order));
+					if (simplex)
+						res(i, dim) = order - res.row(i).head(dim).sum();
+				}
+				return res;
+			}
+
+			// P(m, p, z) of p_n_bases for m = 0..p and its derivative, one column per m
+			void simplex_factors(const int p, const Eigen::ArrayXd &z, Eigen::ArrayXXd &f, Eigen::ArrayXXd &df)
+			{
+				f.resize(z.size(), p + 1);
+				df.resize(z.size(), p + 1);
+				f.col(0).setOnes();
+				df.col(0).setZero();
+				for (int m = 1; m <= p; ++m)
+				{
+					const Eigen::ArrayXd t = (p * z - (m - 1)) / double(m);
+					df.col(m) = df.col(m - 1) * t + f.col(m - 1) * (p / double(m));
+					f.col(m) = f.col(m - 1) * t;
+				}
+			}
+
+			void factor_values(const std::vector<Eigen::ArrayXXd> &f, const Eigen::MatrixXi &exps, Eigen::MatrixXd &val)
+			{
+				const int n_pts = f.front().rows();
+				val.resize(n_pts, exps.rows());
+				for (int j = 0; j < exps.rows(); ++j)
+				{
+					auto col = val.col(j).array();
+					col = f[0].col(exps(j, 0));
+					for (size_t c = 1; c < f.size(); ++c)
+						col *= f[c].col(exps(j, c));
+				}
+			}
+
+			// the derivative of the factor c along d is 1 if c == d, and -1 for the last barycentric coordinate of a simplex
+			void factor_grads(const std::vector<Eigen::ArrayXXd> &f, const std::vector<Eigen::ArrayXXd> &df, const Eigen::MatrixXi &exps,
+							  const int dim, const bool simplex, std::vector<Eigen::MatrixXd> &grad)
+			{
+				const int n_pts = f.front().rows();
+				const int n_factors = f.size();
+				grad.resize(exps.rows());
+
+				Eigen::ArrayXd term(n_pts);
+				for (int j = 0; j < exps.rows(); ++j)
+				{
+					grad[j].setZero(n_pts, dim);
+					for (int c = 0; c < n_factors; ++c)
+					{
+						term = df[c].col(exps(j, c));
+						for (int o = 0; o < n_factors; ++o)
+						{
+							if (o != c)
+								term *= f[o].col(exps(j, o));
+						}
+
+						if (c < dim)
+							grad[j].col(c).array() += term;
+						else
+						{
+							assert(simplex);
+							grad[j].array().colwise() -= term;
+						}
+					}
+				}
+			}
+
+			void p_factors(const int p, const Eigen::MatrixXd &uv, std::vector<Eigen::ArrayXXd> &f, std::vector<Eigen::ArrayXXd> &df, Eigen::MatrixXi &exps)
+			{
+				const int dim = uv.cols();
+				assert(dim == 2 || dim == 3);
+
+				Eigen::MatrixXd nodes;
+				if (dim == 2)
+					p_nodes_2d(p, nodes);
+				else
+					p_nodes_3d(p, nodes);
+				exps = exponents(nodes, p, true);
+
+				f.resize(dim + 1);
+				df.resize(dim + 1);
+				for (int d = 0; d < dim; ++d)
+					simplex_factors(p, uv.col(d).array(), f[d], df[d]);
+				simplex_factors(p, 1 - uv.rowwise().sum().array(), f[dim], df[dim]);
+			}
+
+			void q_factors(const int q, const Eigen::MatrixXd &uv, std::vector<Eigen::ArrayXXd> &f, std::vector<Eigen::ArrayXXd> &df, Eigen::MatrixXi &exps)
+			{
+				const int dim = uv.cols();
+				assert(dim == 2 || dim == 3);
+				assert(q >= 0);
+
+				exps = q_tensor_indices(q, dim);
+
+				f.resize(dim);
+				df.resize(dim);
+				for (int d = 0; d < dim; ++d)
+					q_lagrange_1d(q, uv.col(d).array(), f[d], df[d]);
+			}
+
+			void q_nodal_factors(const Eigen::VectorXd &nodes, const Eigen::MatrixXd &uv, std::vector<Eigen::ArrayXXd> &f, std::vector<Eigen::ArrayXXd> &df, Eigen::MatrixXi &exps)
+			{
+				const int dim = uv.cols();
+				assert(dim == 2 || dim == 3);
+				assert(nodes.size() >= 2);
+				assert(nodes[0] == 0 && nodes[nodes.size() - 1] == 1);
+
+				exps = q_tensor_indices(nodes.size() - 1, dim);
+
+				f.resize(dim);
+				df.resize(dim);
+				for (int d = 0; d < dim; ++d)
+					lagrange_1d(nodes, uv.col(d).array(), f[d], df[d]);
+			}
+
+			int n_q_nodes(const int q, const int dim)
+			{
+				Eigen::MatrixXd nodes;
+				if (dim == 2)
+					q_nodes_2d(q, nodes);
+				else
+					q_nodes_3d(q, nodes);
+				return nodes.rows();
+			}
+		} // namespace
+
+		void q_lagrange_1d(const int q, const Eigen::ArrayXd &t, Eigen::ArrayXXd &f, Eigen::ArrayXXd &df)
+		{
+			f.resize(t.size(), q + 1);
+			df.setZero(t.size(), q + 1);
+			for (int i = 0; i <= q; ++i)
+			{
+				f.col(i).setOnes();
+				for (int m = 0; m <= q; ++m)
+				{
+					if (m != i)
+						f.col(i) *= (q * t - m) / double(i - m);
+				}
+
+				for (int k = 0; k <= q; ++k)
+				{
+					if (k == i)
+						continue;
+					Eigen::ArrayXd tmp = Eigen::ArrayXd::Constant(t.size(), q / double(i - k));
+					for (int m = 0; m <= q; ++m)
+					{
+						if (m != i && m != k)
+							tmp *= (q * t - m) / double(i - m);
+					}
+					df.col(i) += tmp;
+				}
+			}
+		}
+
+		void lagrange_1d(const Eigen::VectorXd &nodes, const Eigen::ArrayXd &t, Eigen::ArrayXXd &f, Eigen::ArrayXXd &df)
+		{
+			const int n = nodes.size();
+			f.resize(t.size(), n);
+			df.setZero(t.size(), n);
+			for (int i = 0; i < n; ++i)
+			{
+				f.col(i).setOnes();
+				for (int m = 0; m < n; ++m)
+				{
+					if (m != i)
+						f.col(i) *= (t - nodes[m]) / (nodes[i] - nodes[m]);
+				}
+
+				for (int k = 0; k < n; ++k)
+				{
+					if (k == i)
+						continue;
+					Eigen::ArrayXd tmp = Eigen::ArrayXd::Constant(t.size(), 1 / (nodes[i] - nodes[k]));
+					for (int m = 0; m < n; ++m)
+					{
+						if (m != i && m != k)
+							tmp *= (t - nodes[m]) / (nodes[i] - nodes[m]);
+					}
+					df.col(i) += tmp;
+				}
+			}
+		}
+
+		Eigen::MatrixXi q_tensor_indices(const int q, const int dim)
+		{
+			assert(q >= 0);
+			Eigen::MatrixXd nodes;
+			if (dim == 2)
+				q_nodes_2d(q, nodes);
+			else
+				q_nodes_3d(q, nodes);
+			return exponents(nodes, q, false);
+		}
+
+		void p_basis_values(const int p, const Eigen::MatrixXd &uv, Eigen::MatrixXd &val)
+		{
+			std::vector<Eigen::ArrayXXd> f, df;
+			Eigen::MatrixXi exps;
+			p_factors(p, uv, f, df, exps);
+			factor_values(f, exps, val);
+		}
+
+		void p_grad_basis_values(const int p, const Eigen::MatrixXd &uv, std::vector<Eigen::MatrixXd> &grad)
+		{
+			std::vector<Eigen::ArrayXXd> f, df;
+			Eigen::MatrixXi exps;
+			p_factors(p, uv, f, df, exps);
+			factor_grads(f, df, exps, uv.cols(), true, grad);
+		}
+
+		void q_basis_values(const int q, const Eigen::MatrixXd &uv, Eigen::MatrixXd &val)
+		{
+			if (q < 0)
+			{
+				const int n_bases = n_q_nodes(q, uv.cols());
+				val.resize(uv.rows(), n_bases);
+				Eigen::MatrixXd tmp;
+				for (int j = 0; j < n_bases; ++j)
+				{
+					if (uv.cols() == 2)
+						q_basis_value_2d(q, j, uv, tmp);
+					else
+						q_basis_value_3d(q, j, uv, tmp);
+					val.col(j) = tmp;
+				}
+				return;
+			}
+
+			std::vector<Eigen::ArrayXXd> f, df;
+			Eigen::MatrixXi exps;
+			q_factors(q, uv, f, df, exps);
+			factor_values(f, exps, val);
+		}
+
+		void q_grad_basis_values(const int q, const Eigen::MatrixXd &uv, std::vector<Eigen::MatrixXd> &grad)
+		{
+			if (q < 0)
+			{
+				grad.resize(n_q_nodes(q, uv.cols()));
+				for (int j = 0; j < grad.size(); ++j)
+				{
+					if (uv.cols() == 2)
+						q_grad_basis_value_2d(q, j, uv, grad[j]);
+					else
+						q_grad_basis_value_3d(q, j, uv, grad[j]);
+				}
+				return;
+			}
+
+			std::vector<Eigen::ArrayXXd> f, df;
+			Eigen::MatrixXi exps;
+			q_factors(q, uv, f, df, exps);
+			factor_grads(f, df, exps, uv.cols(), false, grad);
+		}
+
+		void q_nodal_basis_values(const Eigen::VectorXd &nodes, const Eigen::MatrixXd &uv, Eigen::MatrixXd &val)
+		{
+			std::vector<Eigen::ArrayXXd> f, df;
+			Eigen::MatrixXi exps;
+			q_nodal_factors(nodes, uv, f, df, exps);
+			factor_values(f, exps, val);
+		}
+
+		void q_nodal_grad_basis_values(const Eigen::VectorXd &nodes, const Eigen::MatrixXd &uv, std::vector<Eigen::MatrixXd> &grad)
+		{
+			std::vector<Eigen::ArrayXXd> f, df;
+			Eigen::MatrixXi exps;
+			q_nodal_factors(nodes, uv, f, df, exps);
+			factor_grads(f, df, exps, uv.cols(), false, grad);
+		}
+	} // namespace autogen
+} // namespace polyfem
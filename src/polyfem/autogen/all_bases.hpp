@@ -0,0 +1,43 @@
+#pragma once
+
+#include <Eigen/Dense>
+
+#include <vector>
+
+namespace polyfem
+{
+	namespace autogen
+	{
+		// Evaluation of all the bases of an element at once. The Lagrange bases on equispaced nodes are products
+		// of one dimensional factors (barycentric for P, tensor for Q), the factors are computed once per point
+		// and shared by all the bases. The local ordering is the one of p_basis_value_2d/3d and q_basis_value_2d/3d.
+
+		/// values of all the P_p bases, #uv x #bases, dimension given by uv
+		void p_basis_values(const int p, const Eigen::MatrixXd &uv, Eigen::MatrixXd &val);
+
+		/// gradients of all the P_p bases, grad[j] is #uv x dim
+		void p_grad_basis_values(const int p, const Eigen::MatrixXd &uv, std::vector<Eigen::MatrixXd> &grad);
+
+		/// values of all the Q_q bases, #uv x #bases, serendipity (q = -2) bases are evaluated one by one
+		void q_basis_values(const int q, const Eigen::MatrixXd &uv, Eigen::MatrixXd &val);
+
+		/// gradients of all the Q_q bases, grad[j] is #uv x dim
+		void q_grad_basis_values(const int q, const Eigen::MatrixXd &uv, std::vector<Eigen::MatrixXd> &grad);
+
+		/// one dimensional Lagrange polynomials on the nodes i / q (the factors of the Q_q bases) and their derivatives at t, #t x (q + 1)
+		void q_lagrange_1d(const int q, const Eigen::ArrayXd &t, Eigen::ArrayXXd &val, Eigen::ArrayXXd &grad);
+
+		/// one dimensional Lagrange polynomials on arbitrary distinct nodes and their derivatives at t, #t x #nodes
+		void lagrange_1d(const Eigen::VectorXd &nodes, const Eigen::ArrayXd &t, Eigen::ArrayXXd &val, Eigen::ArrayXXd &grad);
+
+		/// values of all the Q_q bases with the one dimensional factors interpolating on nodes instead of i / q (q = #nodes - 1),
+		/// nodes must be increasing from 0 to 1 so that the bases keep the ordering of q_basis_values (e.g., Gauss-Lobatto nodes)
+		void q_nodal_basis_values(const Eigen::VectorXd &nodes, const Eigen::MatrixXd &uv, Eigen::MatrixXd &val);
+
+		/// gradients of all the Q_q bases on the given one dimensional nodes, see q_nodal_basis_values
+		void q_nodal_grad_basis_values(const Eigen::VectorXd &nodes, const Eigen::MatrixXd &uv, std::vector<Eigen::MatrixXd> &grad);
+
+		/// position of the factors of every Q_q basis, one row per basis and one column per coordinate
+		Eigen::MatrixXi q_tensor_indices(const int q, const int dim);
+	} // namespace autogen
+} // namespace polyfem
@@ -55,24 +55,14 @@ namespace polyfem
 
 		Eigen::ArrayXd P_prime(const int m, const int p, const Eigen::ArrayXd &z)
 		{
-			Eigen::ArrayXd result, tmp;
-			result.resize(z.size());
-			tmp.resize(z.size());
-			result.setZero();
-			if (m >= 1)
+			// product rule on the factors of P, linear in m
+			Eigen::ArrayXd value = Eigen::ArrayXd::Ones(z.size());
+			Eigen::ArrayXd result = Eigen::ArrayXd::Zero(z.size());
+			for (int i = 1; i <= m; ++i)
 			{
-				for (int i = 1; i <= m; ++i)
-				{
-					tmp.setConstant(1);
-					for (int j = 1; j <= m; ++j)
-					{
-						if (j != i)
-						{
-							tmp *= (p * z - j + 1) / double(j);
-						}
-					}
-					result += tmp * p / double(i);
-				}
+				const Eigen::ArrayXd t = (p * z - i + 1) / double(i);
+				result = result * t + value * (p / double(i));
+				value *= t;
 			}
 			return result;
 		}
@@ -0,0 +1,156 @@
+#include "AdaptiveQuadrature.hpp"
+
+#include <polyfem/assembler/AssemblerUtils.hpp>
+#include <polyfem/quadrature/QuadratureCache.hpp>
+#include <polyfem/utils/Logger.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace polyfem
+{
+	using namespace assembler;
+	using namespace quadrature;
+	using namespace utils;
+
+	namespace basis
+	{
+		namespace adaptive_quadrature
+		{
+			namespace
+			{
+				// below this variation the Jacobian is considered constant
+				const double undistorted_tolerance = 1e-10;
+				// highest orders of the simplex rules and of the line rules
+				const int max_simplex_order = 15;
+				const int max_line_order = 64;
+
+				bool is_cube(const reference_tables::ReferenceElement element)
+				{
+					return element == reference_tables::ReferenceElement::QUAD || element == reference_tables::ReferenceElement::HEXAHEDRON;
+				}
+
+				int dimension(const reference_tables::ReferenceElement element)
+				{
+					return element == reference_tables::ReferenceElement::TETRAHEDRON || element == reference_tables::ReferenceElement::HEXAHEDRON ? 3 : 2;
+				}
+
+				QuadratureCache::Shape shape(const reference_tables::ReferenceElement element)
+				{
+					switch (element)
+					{
+					case reference_tables::ReferenceElement::TRIANGLE:
+						return QuadratureCache::Shape::TRIANGLE;
+					case reference_tables::ReferenceElement::QUAD:
+						return QuadratureCache::Shape::QUAD;
+					case reference_tables::ReferenceElement::TETRAHEDRON:
+						return QuadratureCache::Shape::TETRAHEDRON;
+					default:
+						assert(element == reference_tables::ReferenceElement::HEXAHEDRON);
+						return QuadratureCache::Shape::HEXAHEDRON;
+					}
+				}
+
+				int default_order(const std::string &assembler, const reference_tables::ReferenceElement element, const int discr_order)
+				{
+					const auto type = is_cube(element) ? AssemblerUtils::BasisType::CUBE_LAGRANGE : AssemblerUtils::BasisType::SIMPLEX_LAGRANGE;
+					return AssemblerUtils::quadrature_order(assembler, std::abs(discr_order), type, dimension(element));
+				}
+			} // namespace
+
+			double jacobian_variation(const ElementBases &gbasis, const Eigen::MatrixXd &samples)
+			{
+				if (gbasis.is_affine || samples.rows() == 0)
+					return 0;
+
+				std::vector<Eigen::MatrixXd> grads;
+				gbasis.eval_geom_mapping_grads(samples, grads);
+
+				double min_det = std::numeric_limits<double>::max();
+				double max_det = -std::numeric_limits<double>::max();
+				for (const auto &g : grads)
+				{
+					const double det = g.determinant();
+					min_det = std::min(min_det, det);
+					max_det = std::max(max_det, det);
+				}
+
+				if (min_det <= 0)
+					return std::numeric_limits<double>::infinity();
+				return (max_det - min_det) / max_det;
+			}
+
+			int quadrature_order(const std::string &assembler, const reference_tables::ReferenceElement element, const int discr_order,
+								 const double variation, const bool is_linear, const Params &params)
+			{
+				assert(element != reference_tables::ReferenceElement::NONE);
+
+				int order = default_order(assembler, element, discr_order);
+
+				if (variation > params.distortion_threshold)
+				{
+					// one more order every time the variation doubles
+					const double levels = std::log2(variation / params.distortion_threshold);
+					order += std::isfinite(levels) ? std::min(params.max_increase, 1 + int(levels)) : params.max_increase;
+				}
+				else if (is_cube(element) && is_linear && params.reduce_undistorted && variation <= undistorted_tolerance)
+				{
+					// with a constant Jacobian the integrands have degree 2p per direction, p+1 Gauss points are exact
+					order = std::min(order, std::abs(discr_order) + 1);
+				}
+
+				if (!is_linear)
+					order += params.nonlinear_increase;
+
+				return std::clamp(order, 1, is_cube(element) ? max_line_order : max_simplex_order);
+			}
+
+			int apply(const std::string &assembler, const bool is_linear, const Params &params,
+					  const std::vector<ElementBases> &gbases, std::vector<ElementBases> &bases)
+			{
+				assert(gbases.size() == bases.size());
+
+				// the distortion is sampled at the default quadrature points
+				std::vector<double> variation(bases.size(), 0);
+				maybe_parallel_for(bases.size(), [&](int start, int end, int thread_id) {
+					Quadrature quad;
+					for (int e = start; e < end; ++e)
+					{
+						if (!bases[e].has_reference_table())
+							continue;
+						bases[e].compute_quadrature(quad);
+						variation[e] = jacobian_variation(gbases[e], quad.points);
+					}
+				});
+
+				int n_increased = 0, n_reduced = 0;
+				for (int e = 0; e < bases.size(); ++e)
+				{
+					ElementBases &b = bases[e];
+					if (!b.has_reference_table())
+						continue;
+
+					const auto element = b.reference_element();
+					const int order = quadrature_order(assembler, element, b.reference_order(), variation[e], is_linear, params);
+					const int mass_order = quadrature_order("Mass", element, b.reference_order(), variation[e], true, params);
+					const auto s = shape(element);
+
+					b.set_quadrature([s, order](Quadrature &quad) { quad = QuadratureCache::get(s, order); });
+					b.set_mass_quadrature([s, mass_order](Quadrature &quad) { quad = QuadratureCache::get(s, mass_order); });
+
+					const int reference = default_order(assembler, element, b.reference_order());
+					if (order > reference)
+						++n_increased;
+					else if (order < reference)
+						++n_reduced;
+				}
+
+				logger().debug("Adaptive quadrature: {} elements with more points, {} with fewer points", n_increased, n_reduced);
+
+				return n_increased + n_reduced;
+			}
+		} // namespace adaptive_quadrature
+	} // namespace basis
+} // namespace polyfem
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <polyfem/basis/ElementBases.hpp>
+#include <polyfem/basis/ReferenceTables.hpp>
+
+#include <Eigen/Dense>
+
+#include <string>
+#include <vector>
+
+namespace polyfem
+{
+	namespace basis
+	{
+		/// @brief Per-element selection of the quadrature order of the Lagrange elements.
+		/// Elements whose geometric mapping is distorted get more points than the default order of
+		/// AssemblerUtils::quadrature_order, undistorted cubes of linear formulations get the fewest points that are still exact.
+		namespace adaptive_quadrature
+		{
+			struct Params
+			{
+				/// relative variation of the Jacobian determinant above which the order is increased
+				double distortion_threshold = 0.1;
+				/// maximal increase of the order due to the distortion
+				int max_increase = 2;
+				/// increase of the order for nonlinear formulations (e.g., hyperelastic materials)
+				int nonlinear_increase = 1;
+				/// use p+1 points per direction on cubes with a constant Jacobian (parallelograms and parallelepipeds) for linear formulations
+				bool reduce_undistorted = true;
+			};
+
+			/// @brief Relative variation (max - min) / max of the determinant of the Jacobian of the geometric mapping
+			/// @param[in] gbasis geometric mapping of the element
+			/// @param[in] samples #S x dim points in the reference element
+			/// @return 0 for affine elements, infinity if the element is flipped at a sample
+			double jacobian_variation(const ElementBases &gbasis, const Eigen::MatrixXd &samples);
+
+			/// @brief Quadrature order of an element
+			/// @param[in] assembler name of the formulation, as in AssemblerUtils::quadrature_order
+			/// @param[in] element reference element
+			/// @param[in] discr_order discretization order (negative for serendipity)
+			/// @param[in] variation relative variation of the Jacobian determinant, see jacobian_variation
+			/// @param[in] is_linear if the formulation is linear
+			/// @param[in] params selection parameters
+			/// @return order of the rule, as in the get_quadrature of the rule of the element
+			int quadrature_order(const std::string &assembler, const reference_tables::ReferenceElement element, const int discr_order,
+								 const double variation, const bool is_linear, const Params &params);
+
+			/// @brief Sets the quadrature and mass quadrature of every Lagrange element from its distortion.
+			/// Elements without a reference element (splines, polytopes) are left unchanged.
+			/// @param[in] assembler name of the formulation
+			/// @param[in] is_linear if the formulation is linear
+			/// @param[in] params selection parameters
+			/// @param[in] gbases geometric mappings of the elements, can be the same vector as bases
+			/// @param[in,out] bases bases whose quadratures are set
+			/// @return number of elements whose order differs from the default one
+			int apply(const std::string &assembler, const bool is_linear, const Params &params,
+					  const std::vector<ElementBases> &gbases, std::vector<ElementBases> &bases);
+		} // namespace adaptive_quadrature
+	} // namespace basis
+} // namespace polyfem
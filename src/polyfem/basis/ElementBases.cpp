@@ -1,10 +1,79 @@
 #include <polyfem/basis/ElementBases.hpp>
 
+#include <map>
+#include <tuple>
+
 namespace polyfem
 {
 	using namespace assembler;
 	namespace basis
 	{
+		namespace
+		{
+			// nodes of the geometric mapping, one row per basis: the mapping is sum_j phi_j(uv) nodes.row(j)
+			void mapping_nodes(const ElementBases &gbasis, Eigen::Ref<Eigen::MatrixXd> nodes)
+			{
+				nodes.setZero();
+				for (size_t j = 0; j < gbasis.bases.size(); ++j)
+				{
+					for (const Local2Global &g : gbasis.bases[j].global())
+						nodes.row(j) += g.node * g.val;
+				}
+			}
+
+			// groups the elements by the reference table of the samples, the elements without a table are in untabulated
+			// the keys are the table pointers, kept alive by the returned tables
+			void group_by_table(
+				const std::vector<ElementBases> &gbases,
+				const std::vector<int> &elements,
+				const Eigen::MatrixXd &samples,
+				std::vector<std::shared_ptr<const ReferenceTable>> &tables,
+				std::vector<std::vector<int>> &groups,
+				std::vector<int> &untabulated)
+			{
+				using Key = std::tuple<reference_tables::ReferenceElement, int, int>;
+				std::map<Key, int> table_index;
+
+				tables.clear();
+				groups.clear();
+				untabulated.clear();
+				for (int i = 0; i < int(elements.size()); ++i)
+				{
+					const ElementBases &gb = gbases[elements[i]];
+					if (!gb.has_parameterization || !gb.has_reference_table())
+					{
+						untabulated.push_back(i);
+						continue;
+					}
+
+					const Key key(gb.reference_element(), gb.reference_order(), gb.bases.size());
+					auto it = table_index.find(key);
+					if (it == table_index.end())
+					{
+						std::shared_ptr<const ReferenceTable> table = gb.reference_table(samples);
+						it = table_index.emplace(key, table ? int(tables.size()) : -1).first;
+						if (table)
+						{
+							tables.push_back(table);
+							groups.emplace_back();
+						}
+					}
+
+					if (it->second < 0)
+						untabulated.push_back(i);
+					else
+						groups[it->second].push_back(i);
+				}
+			}
+		} // namespace
+
+		size_t ElementBases::memory_usage() const
+		{
+			size_t res = sizeof(ElementBases) + bases.capacity() * sizeof(Basis);
+			for (const auto &b : bases)
+				res += b.global().capacity() * sizeof(Local2Global);
+			return res;
+		}
 
 		bool ElementBases::is_complete() const
 		{
@@ -79,6 +148,64 @@ namespace polyfem
 			}
 		}
 
+		void ElementBases::set_all_bases_funcs(const std::function<void(const Eigen::MatrixXd &, Eigen::MatrixXd &)> &values,
+											   const std::function<void(const Eigen::MatrixXd &, std::vector<Eigen::MatrixXd> &)> &grads)
+		{
+			eval_bases_func_ = [values](const Eigen::MatrixXd &uv, std::vector<AssemblyValues> &basis_values) {
+				Eigen::MatrixXd val;
+				values(uv, val);
+				basis_values.resize(val.cols());
+				for (int i = 0; i < val.cols(); ++i)
+					basis_values[i].val = val.col(i);
+			};
+
+			eval_grads_func_ = [grads](const Eigen::MatrixXd &uv, std::vector<AssemblyValues> &basis_values) {
+				std::vector<Eigen::MatrixXd> grad;
+				grads(uv, grad);
+				basis_values.resize(grad.size());
+				for (size_t i = 0; i < grad.size(); ++i)
+					basis_values[i].grad.swap(grad[i]);
+			};
+		}
+
+		std::shared_ptr<const ReferenceTable> ElementBases::reference_table(const Eigen::MatrixXd &uv) const
+		{
+			if (!has_reference_table())
+				return nullptr;
+
+			return reference_tables::get(reference_element_, reference_order_, bases.size(), uv, [this](ReferenceTable &t) {
+				std::vector<AssemblyValues> tmp;
+				evaluate_bases(t.points, tmp);
+				evaluate_grads(t.points, tmp);
+
+				t.val.resize(t.points.rows(), tmp.size());
+				t.grad.resize(tmp.size());
+				for (size_t i = 0; i < tmp.size(); ++i)
+				{
+					t.val.col(i) = tmp[i].val;
+					t.grad[i] = std::move(tmp[i].grad);
+				}
+			});
+		}
+
+		void ElementBases::evaluate_tabulated(const Eigen::MatrixXd &uv, std::vector<AssemblyValues> &basis_values) const
+		{
+			const std::shared_ptr<const ReferenceTable> table = reference_table(uv);
+			if (!table)
+			{
+				evaluate_bases(uv, basis_values);
+				evaluate_grads(uv, basis_values);
+				return;
+			}
+
+			basis_values.resize(bases.size());
+			for (size_t i = 0; i < bases.size(); ++i)
+			{
+				basis_values[i].val = table->val.col(i);
+				basis_values[i].grad = table->grad[i];
+			}
+		}
+
 		void ElementBases::eval_geom_mapping_grads(const Eigen::MatrixXd &samples, std::vector<Eigen::MatrixXd> &grads) const
 		{
 			grads.resize(samples.rows());
@@ -131,6 +258,91 @@ namespace polyfem
 			}
 		}
 
+		void ElementBases::eval_geom_mapping(const std::vector<ElementBases> &gbases, const std::vector<int> &elements, const Eigen::MatrixXd &samples, Eigen::MatrixXd &mapped)
+		{
+			const int n_samples = samples.rows();
+			const int dim = samples.cols();
+			mapped.resize(elements.size() * n_samples, dim);
+
+			std::vector<std::shared_ptr<const ReferenceTable>> tables;
+			std::vector<std::vector<int>> groups;
+			std::vector<int> untabulated;
+			group_by_table(gbases, elements, samples, tables, groups, untabulated);
+
+			Eigen::MatrixXd tmp;
+			for (const int i : untabulated)
+			{
+				gbases[elements[i]].eval_geom_mapping(samples, tmp);
+				mapped.middleRows(i * n_samples, n_samples) = tmp;
+			}
+
+			Eigen::MatrixXd nodes, res;
+			for (size_t t = 0; t < tables.size(); ++t)
+			{
+				const std::vector<int> &group = groups[t];
+				const Eigen::MatrixXd &val = tables[t]->val;
+
+				// #B x (dim * #group) nodes, the mapped samples of all the elements are one product
+				nodes.resize(val.cols(), dim * group.size());
+				for (size_t k = 0; k < group.size(); ++k)
+					mapping_nodes(gbases[elements[group[k]]], nodes.middleCols(k * dim, dim));
+				res.noalias() = val * nodes;
+
+				for (size_t k = 0; k < group.size(); ++k)
+					mapped.middleRows(group[k] * n_samples, n_samples) = res.middleCols(k * dim, dim);
+			}
+		}
+
+		void ElementBases::eval_geom_mapping_grads(const std::vector<ElementBases> &gbases, const std::vector<int> &elements, const Eigen::MatrixXd &samples, std::vector<Eigen::MatrixXd> &grads)
+		{
+			const int n_samples = samples.rows();
+			const int dim = samples.cols();
+			grads.resize(elements.size() * n_samples);
+
+			std::vector<std::shared_ptr<const ReferenceTable>> tables;
+			std::vector<std::vector<int>> groups;
+			std::vector<int> untabulated;
+			group_by_table(gbases, elements, samples, tables, groups, untabulated);
+
+			std::vector<Eigen::MatrixXd> tmp;
+			for (const int i : untabulated)
+			{
+				gbases[elements[i]].eval_geom_mapping_grads(samples, tmp);
+				std::move(tmp.begin(), tmp.end(), grads.begin() + i * n_samples);
+			}
+
+			Eigen::MatrixXd nodes, ref_grad, res;
+			for (size_t t = 0; t < tables.size(); ++t)
+			{
+				const std::vector<int> &group = groups[t];
+				const ReferenceTable &table = *tables[t];
+				const int n_local_bases = table.grad.size();
+
+				nodes.resize(n_local_bases, dim * group.size());
+				for (size_t k = 0; k < group.size(); ++k)
+				{
+					mapping_nodes(gbases[elements[group[k]]], nodes.middleCols(k * dim, dim));
+					for (int s = 0; s < n_samples; ++s)
+						grads[group[k] * n_samples + s].resize(dim, dim);
+				}
+
+				// the row d of the gradients is the derivative along the reference coordinate d
+				ref_grad.resize(n_samples, n_local_bases);
+				for (int d = 0; d < dim; ++d)
+				{
+					for (int j = 0; j < n_local_bases; ++j)
+						ref_grad.col(j) = table.grad[j].col(d);
+					res.noalias() = ref_grad * nodes;
+
+					for (size_t k = 0; k < group.size(); ++k)
+					{
+						for (int s = 0; s < n_samples; ++s)
+							grads[group[k] * n_samples + s].row(d) = res.block(s, k * dim, 1, dim);
+					}
+				}
+			}
+		}
+
 		Eigen::MatrixXd ElementBases::nodes() const
 		{
 			if (bases.size() == 0)
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <polyfem/basis/Basis.hpp>
+#include <polyfem/basis/ReferenceTables.hpp>
 #include <polyfem/quadrature/Quadrature.hpp>
 #include <polyfem/mesh/Mesh.hpp>
 
@@ -26,6 +27,9 @@ namespace polyfem
 			// Assemble the global nodal positions of the bases.
 			Eigen::MatrixXd nodes() const;
 
+			// size in bytes of the bases and their global mappings, the basis functions are not counted
+			size_t memory_usage() const;
+
 			// quadrature points to evaluate the basis functions inside the element
 			void compute_quadrature(quadrature::Quadrature &quadrature) const { quadrature_builder_(quadrature); }
 			void compute_mass_quadrature(quadrature::Quadrature &quadrature) const { mass_quadrature_builder_(quadrature); }
@@ -35,6 +39,9 @@ namespace polyfem
 			// or directly in the object domain (harmonic bases)
 			bool has_parameterization = true;
 
+			// whether the geometric mapping is affine (straight-sided P1 simplices), its jacobian is then constant over the element
+			bool is_affine = false;
+
 			/// @brief Map the sample positions in the parametric domain to the object domain (if the element has no parameterization, e.g. harmonic bases, then the parametric domain = object domain,
 			/// and the mapping is identity)
 			///
@@ -48,6 +55,23 @@ namespace polyfem
 			/// @param[out] grads #S list of dim x dim matrices of gradients
 			void eval_geom_mapping_grads(const Eigen::MatrixXd &samples, std::vector<Eigen::MatrixXd> &grads) const;
 
+			/// @brief Maps the same samples in several elements. The elements sharing a reference table are mapped together
+			/// with one product of the tabulated values and their stacked nodes, the others are mapped one by one.
+			///
+			/// @param[in] gbases geometric bases of all the elements
+			/// @param[in] elements ids of the elements to map
+			/// @param[in] samples #S x dim matrix of sample positions in the parametric domain
+			/// @param[out] mapped (#elements * #S) x dim matrix, the rows [i * #S, (i + 1) * #S) are the samples mapped in elements[i]
+			static void eval_geom_mapping(const std::vector<ElementBases> &gbases, const std::vector<int> &elements, const Eigen::MatrixXd &samples, Eigen::MatrixXd &mapped);
+
+			/// @brief Gradients of the geometric mapping of the same samples in several elements, batched as eval_geom_mapping
+			///
+			/// @param[in] gbases geometric bases of all the elements
+			/// @param[in] elements ids of the elements to map
+			/// @param[in] samples #S x dim matrix of sample positions in the parametric domain
+			/// @param[out] grads #elements * #S list of dim x dim matrices of gradients, grads[i * #S + k] is the gradient at sample k in elements[i]
+			static void eval_geom_mapping_grads(const std::vector<ElementBases> &gbases, const std::vector<int> &elements, const Eigen::MatrixXd &samples, std::vector<Eigen::MatrixXd> &grads);
+
 			/// @brief Checks if all the bases are complete
 			bool is_complete() const;
 
@@ -87,9 +111,38 @@ namespace polyfem
 				}
 			}
 
+			/// @brief Evaluates the values and the gradients of the bases at the points. If the element has a reference table,
+			/// they are copied from the shared table of the point set instead of evaluating every basis.
+			///
+			/// @param[in] uv #P x dim evaluation points, usually the quadrature points
+			/// @param[out] basis_values values and gradients of the bases
+			void evaluate_tabulated(const Eigen::MatrixXd &uv, std::vector<assembler::AssemblyValues> &basis_values) const;
+
+			/// @brief Shared reference table of the bases at the points, nullptr if the element has no reference element or
+			/// the point set cannot be tabulated
+			std::shared_ptr<const ReferenceTable> reference_table(const Eigen::MatrixXd &uv) const;
+
+			/// @brief Marks the bases as the parametric bases of a reference element, all the elements with the same
+			/// reference element and order share their tables. The bases must not depend on the element.
+			void set_reference_element(const reference_tables::ReferenceElement element, const int order)
+			{
+				reference_element_ = element;
+				reference_order_ = order;
+			}
+			bool has_reference_table() const { return reference_element_ != reference_tables::ReferenceElement::NONE; }
+			reference_tables::ReferenceElement reference_element() const { return reference_element_; }
+			/// discretization order of the reference element (negative for serendipity bases)
+			int reference_order() const { return reference_order_; }
+
 			void set_bases_func(EvalBasesFunc fun) { eval_bases_func_ = fun; }
 			void set_grads_func(EvalBasesFunc fun) { eval_grads_func_ = fun; }
 
+			/// @brief Sets the evaluation functions from kernels evaluating all the bases at once
+			/// @param[in] values fills the #uv x #bases values
+			/// @param[in] grads fills the #bases gradients, each #uv x dim
+			void set_all_bases_funcs(const std::function<void(const Eigen::MatrixXd &, Eigen::MatrixXd &)> &values,
+									 const std::function<void(const Eigen::MatrixXd &, std::vector<Eigen::MatrixXd> &)> &grads);
+
 			// sets mapping from local nodes to global nodes
 			void set_local_node_from_primitive_func(LocalNodeFromPrimitiveFunc fun) { local_node_from_primitive_ = fun; }
 
@@ -104,6 +157,9 @@ namespace polyfem
 			QuadratureFunction mass_quadrature_builder_;
 
 			LocalNodeFromPrimitiveFunc local_node_from_primitive_;
+
+			reference_tables::ReferenceElement reference_element_ = reference_tables::ReferenceElement::NONE;
+			int reference_order_ = 0;
 		};
 	} // namespace basis
 } // namespace polyfem
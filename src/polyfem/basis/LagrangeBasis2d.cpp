@@ -1,8 +1,8 @@
 ////////////////////////////////////////////////////////////////////////////////
 #include "LagrangeBasis2d.hpp"
 
-#include <polyfem/quadrature/TriQuadrature.hpp>
-#include <polyfem/quadrature/QuadQuadrature.hpp>
+#include <polyfem/quadrature/QuadratureCache.hpp>
+#include <polyfem/autogen/all_bases.hpp>
 #include <polyfem/autogen/auto_p_bases.hpp>
 #include <polyfem/autogen/auto_q_bases.hpp>
 
@@ -728,194 +728,210 @@ int LagrangeBasis2d::build_bases(
 	// boundary_nodes = nodes.boundary_nodes();
 
 	bases.resize(mesh.n_faces());
-	std::vector<int> interface_elements;
-	interface_elements.reserve(mesh.n_faces());
-
-	for (int e = 0; e < mesh.n_faces(); ++e)
-	{
-		ElementBases &b = bases[e];
-		const int discr_order = discr_orders(e);
-		const int n_el_bases = element_nodes_id[e].size();
-		b.bases.resize(n_el_bases);
-
-		bool skip_interface_element = false;
+	// the nodes are already numbered and only read here, so the elements are built in parallel
+	std::vector<char> is_interface_element(mesh.n_faces(), false);
 
-		for (int j = 0; j < n_el_bases; ++j)
+	utils::maybe_parallel_for(mesh.n_faces(), [&](int start, int end, int thread_id) {
+		for (int e = start; e < end; ++e)
 		{
-			const int global_index = element_nodes_id[e][j];
-			if (global_index < 0)
-			{
-				skip_interface_element = true;
-				break;
-			}
-		}
+			ElementBases &b = bases[e];
+			const int discr_order = discr_orders(e);
+			const int n_el_bases = element_nodes_id[e].size();
+			b.bases.resize(n_el_bases);
 
-		if (skip_interface_element)
-		{
-			interface_elements.push_back(e);
-		}
-
-		if (mesh.is_cube(e))
-		{
-			const int real_order = quadrature_order > 0 ? quadrature_order : AssemblerUtils::quadrature_order(assembler, discr_order, AssemblerUtils::BasisType::CUBE_LAGRANGE, 2);
-			const int real_mass_order = mass_quadrature_order > 0 ? mass_quadrature_order : AssemblerUtils::quadrature_order("Mass", discr_order, AssemblerUtils::BasisType::CUBE_LAGRANGE, 2);
-			b.set_quadrature([real_order](Quadrature &quad) {
-				QuadQuadrature quad_quadrature;
-				quad_quadrature.get_quadrature(real_order, quad);
-			});
-			b.set_mass_quadrature([real_mass_order](Quadrature &quad) {
-				QuadQuadrature quad_quadrature;
-				quad_quadrature.get_quadrature(real_mass_order, quad);
-			});
-			// quad_quadrature.get_quadrature(real_order, b.quadrature);
-
-			b.set_local_node_from_primitive_func([discr_order, e](const int primitive_id, const Mesh &mesh) {
-				const auto &mesh2d = dynamic_cast<const Mesh2D &>(mesh);
-				auto index = mesh2d.get_index_from_face(e);
-
-				for (int le = 0; le < mesh2d.n_face_vertices(e); ++le)
-				{
-					if (index.edge == primitive_id)
-						break;
-					index = mesh2d.next_around_face(index);
-				}
-				assert(index.edge == primitive_id);
-				return quad_edge_local_nodes(discr_order, mesh2d, index);
-			});
+			bool skip_interface_element = false;
 
 			for (int j = 0; j < n_el_bases; ++j)
 			{
 				const int global_index = element_nodes_id[e][j];
-
-				// if(!skip_interface_element)
-				b.bases[j].init(discr_order, global_index, j, nodes.node_position(global_index));
-
-				const int dtmp = serendipity ? -2 : discr_order;
-
-				b.bases[j].set_basis([dtmp, j](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::q_basis_value_2d(dtmp, j, uv, val); });
-				b.bases[j].set_grad([dtmp, j](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::q_grad_basis_value_2d(dtmp, j, uv, val); });
-			}
-		}
-		else if (mesh.is_simplex(e))
-		{
-			const int real_order = quadrature_order > 0 ? quadrature_order : AssemblerUtils::quadrature_order(assembler, discr_order, AssemblerUtils::BasisType::SIMPLEX_LAGRANGE, 2);
-			const int real_mass_order = mass_quadrature_order > 0 ? mass_quadrature_order : AssemblerUtils::quadrature_order("Mass", discr_order, AssemblerUtils::BasisType::SIMPLEX_LAGRANGE, 2);
-			b.set_quadrature([real_order](Quadrature &quad) {
-				TriQuadrature tri_quadrature;
-				tri_quadrature.get_quadrature(real_order, quad);
-			});
-			b.set_mass_quadrature([real_mass_order](Quadrature &quad) {
-				TriQuadrature tri_quadrature;
-				tri_quadrature.get_quadrature(real_mass_order, quad);
-			});
-
-			b.set_local_node_from_primitive_func([discr_order, e](const int primitive_id, const Mesh &mesh) {
-				const auto &mesh2d = dynamic_cast<const Mesh2D &>(mesh);
-				auto index = mesh2d.get_index_from_face(e);
-
-				for (int le = 0; le < mesh2d.n_face_vertices(e); ++le)
+				if (global_index < 0)
 				{
-					if (index.edge == primitive_id)
-						break;
-					index = mesh2d.next_around_face(index);
+					skip_interface_element = true;
+					break;
 				}
-				assert(index.edge == primitive_id);
-				return tri_edge_local_nodes(discr_order, mesh2d, index);
-			});
+			}
 
-			const bool rational = is_geom_bases && mesh.is_rational() && !mesh.cell_weights(e).empty();
+			if (skip_interface_element)
+			{
+				is_interface_element[e] = true;
+			}
 
-			for (int j = 0; j < n_el_bases; ++j)
+			if (mesh.is_cube(e))
 			{
-				const int global_index = element_nodes_id[e][j];
+				const int real_order = quadrature_order > 0 ? quadrature_order : AssemblerUtils::quadrature_order(assembler, discr_order, AssemblerUtils::BasisType::CUBE_LAGRANGE, 2);
+				const int real_mass_order = mass_quadrature_order > 0 ? mass_quadrature_order : AssemblerUtils::quadrature_order("Mass", discr_order, AssemblerUtils::BasisType::CUBE_LAGRANGE, 2);
+				b.set_quadrature([real_order](Quadrature &quad) {
+					quad = QuadratureCache::get(QuadratureCache::Shape::QUAD, real_order);
+				});
+				b.set_mass_quadrature([real_mass_order](Quadrature &quad) {
+					quad = QuadratureCache::get(QuadratureCache::Shape::QUAD, real_mass_order);
+				});
+				// quad_quadrature.get_quadrature(real_order, b.quadrature);
+
+				b.set_local_node_from_primitive_func([discr_order, e](const int primitive_id, const Mesh &mesh) {
+					const auto &mesh2d = dynamic_cast<const Mesh2D &>(mesh);
+					auto index = mesh2d.get_index_from_face(e);
+
+					for (int le = 0; le < mesh2d.n_face_vertices(e); ++le)
+					{
+						if (index.edge == primitive_id)
+							break;
+						index = mesh2d.next_around_face(index);
+					}
+					assert(index.edge == primitive_id);
+					return quad_edge_local_nodes(discr_order, mesh2d, index);
+				});
 
-				if (!skip_interface_element)
+				for (int j = 0; j < n_el_bases; ++j)
 				{
+					const int global_index = element_nodes_id[e][j];
+
+					// if(!skip_interface_element)
 					b.bases[j].init(discr_order, global_index, j, nodes.node_position(global_index));
+
+					const int dtmp = serendipity ? -2 : discr_order;
+
+					b.bases[j].set_basis([dtmp, j](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::q_basis_value_2d(dtmp, j, uv, val); });
+					b.bases[j].set_grad([dtmp, j](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::q_grad_basis_value_2d(dtmp, j, uv, val); });
 				}
+				const int q = serendipity ? -2 : discr_order;
+				b.set_all_bases_funcs([q](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::q_basis_values(q, uv, val); },
+									  [q](const Eigen::MatrixXd &uv, std::vector<Eigen::MatrixXd> &grad) { autogen::q_grad_basis_values(q, uv, grad); });
+				b.set_reference_element(reference_tables::ReferenceElement::QUAD, q);
+			}
+			else if (mesh.is_simplex(e))
+			{
+				const int real_order = quadrature_order > 0 ? quadrature_order : AssemblerUtils::quadrature_order(assembler, discr_order, AssemblerUtils::BasisType::SIMPLEX_LAGRANGE, 2);
+				const int real_mass_order = mass_quadrature_order > 0 ? mass_quadrature_order : AssemblerUtils::quadrature_order("Mass", discr_order, AssemblerUtils::BasisType::SIMPLEX_LAGRANGE, 2);
+				b.is_affine = discr_order == 1;
+				b.set_quadrature([real_order](Quadrature &quad) {
+					quad = QuadratureCache::get(QuadratureCache::Shape::TRIANGLE, real_order);
+				});
+				b.set_mass_quadrature([real_mass_order](Quadrature &quad) {
+					quad = QuadratureCache::get(QuadratureCache::Shape::TRIANGLE, real_mass_order);
+				});
+
+				b.set_local_node_from_primitive_func([discr_order, e](const int primitive_id, const Mesh &mesh) {
+					const auto &mesh2d = dynamic_cast<const Mesh2D &>(mesh);
+					auto index = mesh2d.get_index_from_face(e);
+
+					for (int le = 0; le < mesh2d.n_face_vertices(e); ++le)
+					{
+						if (index.edge == primitive_id)
+							break;
+						index = mesh2d.next_around_face(index);
+					}
+					assert(index.edge == primitive_id);
+					return tri_edge_local_nodes(discr_order, mesh2d, index);
+				});
 
-				if (rational)
+				const bool rational = is_geom_bases && mesh.is_rational() && !mesh.cell_weights(e).empty();
+
+				for (int j = 0; j < n_el_bases; ++j)
 				{
-					const auto &w = mesh.cell_weights(e);
-					assert(discr_order == 2);
-					assert(w.size() == 6);
+					const int global_index = element_nodes_id[e][j];
 
-					b.bases[j].set_basis([discr_order, j, w](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) {
-						autogen::p_basis_value_2d(discr_order, j, uv, val);
-						Eigen::MatrixXd denom = val;
-						denom.setZero();
-						Eigen::MatrixXd tmp;
+					if (!skip_interface_element)
+					{
+						b.bases[j].init(discr_order, global_index, j, nodes.node_position(global_index));
+					}
 
-						for (int k = 0; k < 6; ++k)
-						{
-							autogen::p_basis_value_2d(discr_order, k, uv, tmp);
-							denom += w[k] * tmp;
-						}
+					if (rational)
+					{
+						const auto &w = mesh.cell_weights(e);
+						assert(discr_order == 2);
+						assert(w.size() == 6);
 
-						val = (w[j] * val.array() / denom.array()).eval();
-					});
+						b.bases[j].set_basis([discr_order, j, w](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) {
+							autogen::p_basis_value_2d(discr_order, j, uv, val);
+							Eigen::MatrixXd denom = val;
+							denom.setZero();
+							Eigen::MatrixXd tmp;
 
-					b.bases[j].set_grad([discr_order, j, w](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) {
-						Eigen::MatrixXd b;
-						autogen::p_basis_value_2d(discr_order, j, uv, b);
-						autogen::p_grad_basis_value_2d(discr_order, j, uv, val);
-						Eigen::MatrixXd denom = b;
-						denom.setZero();
-						Eigen::MatrixXd denom_prime = val;
-						denom_prime.setZero();
-						Eigen::MatrixXd tmp;
+							for (int k = 0; k < 6; ++k)
+							{
+								autogen::p_basis_value_2d(discr_order, k, uv, tmp);
+								denom += w[k] * tmp;
+							}
 
-						for (int k = 0; k < 6; ++k)
-						{
-							autogen::p_basis_value_2d(discr_order, k, uv, tmp);
-							denom += w[k] * tmp;
+							val = (w[j] * val.array() / denom.array()).eval();
+						});
 
-							autogen::p_grad_basis_value_2d(discr_order, k, uv, tmp);
-							denom_prime += w[k] * tmp;
-						}
+						b.bases[j].set_grad([discr_order, j, w](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) {
+							Eigen::MatrixXd b;
+							autogen::p_basis_value_2d(discr_order, j, uv, b);
+							autogen::p_grad_basis_value_2d(discr_order, j, uv, val);
+							Eigen::MatrixXd denom = b;
+							denom.setZero();
+							Eigen::MatrixXd denom_prime = val;
+							denom_prime.setZero();
+							Eigen::MatrixXd tmp;
+
+							for (int k = 0; k < 6; ++k)
+							{
+								autogen::p_basis_value_2d(discr_order, k, uv, tmp);
+								denom += w[k] * tmp;
+
+								autogen::p_grad_basis_value_2d(discr_order, k, uv, tmp);
+								denom_prime += w[k] * tmp;
+							}
 
-						val.col(0) = ((w[j] * val.col(0).array() * denom.array() - w[j] * b.array() * denom_prime.col(0).array()) / (denom.array() * denom.array())).eval();
-						val.col(1) = ((w[j] * val.col(1).array() * denom.array() - w[j] * b.array() * denom_prime.col(1).array()) / (denom.array() * denom.array())).eval();
-					});
+							val.col(0) = ((w[j] * val.col(0).array() * denom.array() - w[j] * b.array() * denom_prime.col(0).array()) / (denom.array() * denom.array())).eval();
+							val.col(1) = ((w[j] * val.col(1).array() * denom.array() - w[j] * b.array() * denom_prime.col(1).array()) / (denom.array() * denom.array())).eval();
+						});
+					}
+					else
+					{
+						b.bases[j].set_basis([discr_order, j](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::p_basis_value_2d(discr_order, j, uv, val); });
+						b.bases[j].set_grad([discr_order, j](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::p_grad_basis_value_2d(discr_order, j, uv, val); });
+					}
 				}
-				else
+				if (!rational)
 				{
-					b.bases[j].set_basis([discr_order, j](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::p_basis_value_2d(discr_order, j, uv, val); });
-					b.bases[j].set_grad([discr_order, j](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::p_grad_basis_value_2d(discr_order, j, uv, val); });
+					b.set_all_bases_funcs([discr_order](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::p_basis_values(discr_order, uv, val); },
+										  [discr_order](const Eigen::MatrixXd &uv, std::vector<Eigen::MatrixXd> &grad) { autogen::p_grad_basis_values(discr_order, uv, grad); });
+					b.set_reference_element(reference_tables::ReferenceElement::TRIANGLE, discr_order);
 				}
 			}
-		}
-		else
-		{
-			// Polygon bases are built later on
-		}
+			else
+			{
+				// Polygon bases are built later on
+			}
 
 #ifndef NDEBUG
-		if (mesh.is_conforming())
-		{
-			Eigen::MatrixXd uv(4, 2);
-			uv << 0.1, 0.1, 0.3, 0.3, 0.9, 0.01, 0.01, 0.9;
-			Eigen::MatrixXd dx(4, 1);
-			dx.setConstant(1e-6);
-			Eigen::MatrixXd uvdx = uv;
-			uvdx.col(0) += dx;
-			Eigen::MatrixXd uvdy = uv;
-			uvdy.col(1) += dx;
-			Eigen::MatrixXd grad, val, vdx, vdy;
-
-			for (int j = 0; j < n_el_bases; ++j)
+			if (mesh.is_conforming())
 			{
-				b.bases[j].eval_grad(uv, grad);
+				Eigen::MatrixXd uv(4, 2);
+				uv << 0.1, 0.1, 0.3, 0.3, 0.9, 0.01, 0.01, 0.9;
+				Eigen::MatrixXd dx(4, 1);
+				dx.setConstant(1e-6);
+				Eigen::MatrixXd uvdx = uv;
+				uvdx.col(0) += dx;
+				Eigen::MatrixXd uvdy = uv;
+				uvdy.col(1) += dx;
+				Eigen::MatrixXd grad, val, vdx, vdy;
+
+				for (int j = 0; j < n_el_bases; ++j)
+				{
+					b.bases[j].eval_grad(uv, grad);
 
-				b.bases[j].eval_basis(uv, val);
-				b.bases[j].eval_basis(uvdx, vdx);
-				b.bases[j].eval_basis(uvdy, vdy);
+					b.bases[j].eval_basis(uv, val);
+					b.bases[j].eval_basis(uvdx, vdx);
+					b.bases[j].eval_basis(uvdy, vdy);
 
-				assert((grad.col(0) - (vdx - val) / 1e-6).norm() < 1e-4);
-				assert((grad.col(1) - (vdy - val) / 1e-6).norm() < 1e-4);
+					assert((grad.col(0) - (vdx - val) / 1e-6).norm() < 1e-4);
+					assert((grad.col(1) - (vdy - val) / 1e-6).norm() < 1e-4);
+				}
 			}
-		}
 #endif
+		}
+	});
+
+	std::vector<int> interface_elements;
+	for (int e = 0; e < mesh.n_faces(); ++e)
+	{
+		if (is_interface_element[e])
+			interface_elements.push_back(e);
 	}
 
 	if (!is_geom_bases)
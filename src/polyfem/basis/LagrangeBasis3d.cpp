@@ -3,14 +3,16 @@
 #include "LagrangeBasis3d.hpp"
 
 #include <polyfem/mesh/MeshNodes.hpp>
-#include <polyfem/quadrature/TetQuadrature.hpp>
-#include <polyfem/quadrature/HexQuadrature.hpp>
+#include <polyfem/quadrature/GaussLobattoQuadrature.hpp>
+#include <polyfem/quadrature/QuadratureCache.hpp>
 
 #include <polyfem/assembler/AssemblerUtils.hpp>
 
+#include <polyfem/autogen/all_bases.hpp>
 #include <polyfem/autogen/auto_p_bases.hpp>
 #include <polyfem/autogen/auto_q_bases.hpp>
 
+#include <polyfem/utils/Logger.hpp>
 #include <polyfem/utils/MaybeParallelFor.hpp>
 
 #include <cassert>
@@ -1401,10 +1403,31 @@ int LagrangeBasis3d::build_bases(
 	std::vector<ElementBases> &bases,
 	std::vector<LocalBoundary> &local_boundary,
 	std::map<int, InterfaceData> &poly_face_to_data,
-	std::shared_ptr<MeshNodes> &mesh_nodes)
+	std::shared_ptr<MeshNodes> &mesh_nodes,
+	const std::vector<bool> &gll)
 {
 	assert(mesh.is_volume());
 	assert(discr_orders.size() == mesh.n_cells());
+	assert(gll.empty() || gll.size() == mesh.n_cells());
+
+	// Gauss-Lobatto nodes of the orders of the spectral elements
+	std::map<int, Eigen::VectorXd> gll_nodes;
+	for (int e = 0; e < gll.size(); ++e)
+	{
+		if (!gll[e] || !mesh.is_cube(e) || discr_orders(e) < 1)
+			continue;
+		if (serendipity || is_geom_bases)
+			log_and_throw_error("Gauss-Lobatto nodes are only supported for the Q_k bases");
+		if (!mesh.is_conforming())
+			log_and_throw_error("Gauss-Lobatto nodes are not supported on non-conforming meshes");
+
+		Eigen::VectorXd &n = gll_nodes[discr_orders(e)];
+		if (n.size() == 0)
+		{
+			Eigen::VectorXd w;
+			GaussLobattoQuadrature::points_1d(discr_orders(e) + 1, n, w);
+		}
+	}
 
 	// Navigation3D::get_index_from_element_face_time = 0;
 	// Navigation3D::switch_vertex_time = 0;
@@ -1439,122 +1462,220 @@ int LagrangeBasis3d::build_bases(
 	// std::cout<<"switch_element_time " << Navigation3D::switch_element_time <<std::endl;
 
 	bases.resize(mesh.n_cells());
-	std::vector<int> interface_elements;
-	interface_elements.reserve(mesh.n_faces());
-
-	for (int e = 0; e < mesh.n_cells(); ++e)
-	{
-		ElementBases &b = bases[e];
-		const int discr_order = discr_orders(e);
-		const int n_el_bases = (int)element_nodes_id[e].size();
-		b.bases.resize(n_el_bases);
-
-		bool skip_interface_element = false;
+	// the nodes are already numbered and only read here, so the elements are built in parallel
+	std::vector<char> is_interface_element(mesh.n_cells(), false);
 
-		for (int j = 0; j < n_el_bases; ++j)
+	polyfem::utils::maybe_parallel_for(mesh.n_cells(), [&](int start, int end, int thread_id) {
+		for (int e = start; e < end; ++e)
 		{
-			const int global_index = element_nodes_id[e][j];
-			if (global_index < 0)
-			{
-				skip_interface_element = true;
-				break;
-			}
-		}
+			ElementBases &b = bases[e];
+			const int discr_order = discr_orders(e);
+			const int n_el_bases = (int)element_nodes_id[e].size();
+			b.bases.resize(n_el_bases);
 
-		if (skip_interface_element)
-		{
-			interface_elements.push_back(e);
-		}
+			bool skip_interface_element = false;
 
-		if (mesh.is_cube(e))
-		{
-			const int real_order = quadrature_order > 0 ? quadrature_order : AssemblerUtils::quadrature_order(assembler, discr_order, AssemblerUtils::BasisType::CUBE_LAGRANGE, 3);
-			const int real_mass_order = mass_quadrature_order > 0 ? mass_quadrature_order : AssemblerUtils::quadrature_order("Mass", discr_order, AssemblerUtils::BasisType::CUBE_LAGRANGE, 3);
-			b.set_quadrature([real_order](Quadrature &quad) {
-				HexQuadrature hex_quadrature;
-				hex_quadrature.get_quadrature(real_order, quad);
-			});
-			b.set_mass_quadrature([real_mass_order](Quadrature &quad) {
-				HexQuadrature hex_quadrature;
-				hex_quadrature.get_quadrature(real_mass_order, quad);
-			});
-
-			b.set_local_node_from_primitive_func([serendipity, discr_order, e](const int primitive_id, const Mesh &mesh) {
-				const auto &mesh3d = dynamic_cast<const Mesh3D &>(mesh);
-				Navigation3D::Index index;
-
-				for (int lf = 0; lf < 6; ++lf)
+			for (int j = 0; j < n_el_bases; ++j)
+			{
+				const int global_index = element_nodes_id[e][j];
+				if (global_index < 0)
 				{
-					index = mesh3d.get_index_from_element(e, lf, 0);
-					if (index.face == primitive_id)
-						break;
+					skip_interface_element = true;
+					break;
 				}
-				assert(index.face == primitive_id);
-				return hex_face_local_nodes(serendipity, discr_order, mesh3d, index);
-			});
+			}
 
-			for (int j = 0; j < n_el_bases; ++j)
+			if (skip_interface_element)
 			{
-				const int global_index = element_nodes_id[e][j];
+				is_interface_element[e] = true;
+			}
 
-				b.bases[j].init(discr_order, global_index, j, nodes.node_position(global_index));
+			const auto gll_it = !gll.empty() && gll[e] ? gll_nodes.find(discr_order) : gll_nodes.end();
+			if (mesh.is_cube(e) && gll_it != gll_nodes.end())
+			{
+				// spectral element: the nodes are the Gauss-Lobatto points, which are also the mass quadrature points
+				const Eigen::VectorXd &gll_1d = gll_it->second;
+				const int real_order = quadrature_order > 0 ? quadrature_order : AssemblerUtils::quadrature_order(assembler, discr_order, AssemblerUtils::BasisType::CUBE_LAGRANGE, 3);
+				b.set_quadrature([real_order](Quadrature &quad) {
+					quad = QuadratureCache::get(QuadratureCache::Shape::HEXAHEDRON, real_order);
+				});
+				b.set_mass_quadrature([discr_order](Quadrature &quad) {
+					quad = QuadratureCache::get(QuadratureCache::Shape::LOBATTO_HEXAHEDRON, discr_order + 1);
+				});
 
-				const int dtmp = serendipity ? -2 : discr_order;
+				b.set_local_node_from_primitive_func([discr_order, e](const int primitive_id, const Mesh &mesh) {
+					const auto &mesh3d = dynamic_cast<const Mesh3D &>(mesh);
+					Navigation3D::Index index;
 
-				b.bases[j].set_basis([dtmp, j](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::q_basis_value_3d(dtmp, j, uv, val); });
-				b.bases[j].set_grad([dtmp, j](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::q_grad_basis_value_3d(dtmp, j, uv, val); });
-			}
-		}
-		else if (mesh.is_simplex(e))
-		{
-			const int real_order = quadrature_order > 0 ? quadrature_order : AssemblerUtils::quadrature_order(assembler, discr_order, AssemblerUtils::BasisType::SIMPLEX_LAGRANGE, 3);
-			const int real_mass_order = mass_quadrature_order > 0 ? mass_quadrature_order : AssemblerUtils::quadrature_order("Mass", discr_order, AssemblerUtils::BasisType::SIMPLEX_LAGRANGE, 3);
-
-			b.set_quadrature([real_order](Quadrature &quad) {
-				TetQuadrature tet_quadrature;
-				tet_quadrature.get_quadrature(real_order, quad);
-			});
-			b.set_mass_quadrature([real_mass_order](Quadrature &quad) {
-				TetQuadrature tet_quadrature;
-				tet_quadrature.get_quadrature(real_mass_order, quad);
-			});
-
-			b.set_local_node_from_primitive_func([discr_order, e](const int primitive_id, const Mesh &mesh) {
-				const auto &mesh3d = dynamic_cast<const Mesh3D &>(mesh);
-				Navigation3D::Index index;
-
-				for (int lf = 0; lf < mesh3d.n_cell_faces(e); ++lf)
+					for (int lf = 0; lf < 6; ++lf)
+					{
+						index = mesh3d.get_index_from_element(e, lf, 0);
+						if (index.face == primitive_id)
+							break;
+					}
+					assert(index.face == primitive_id);
+					return hex_face_local_nodes(false, discr_order, mesh3d, index);
+				});
+
+				// the MeshNodes are equispaced, the nodes are moved with the trilinear map of the vertices
+				const Eigen::MatrixXi exps = autogen::q_tensor_indices(discr_order, 3);
+				Eigen::MatrixXd ref_nodes(n_el_bases, 3);
+				for (int j = 0; j < n_el_bases; ++j)
+					for (int d = 0; d < 3; ++d)
+						ref_nodes(j, d) = gll_1d[exps(j, d)];
+				Eigen::MatrixXd trilinear, vertices(8, 3);
+				autogen::q_basis_values(1, ref_nodes, trilinear);
+				for (int v = 0; v < 8; ++v)
+					vertices.row(v) = nodes.node_position(element_nodes_id[e][v]);
+				const Eigen::MatrixXd positions = trilinear * vertices;
+
+				for (int j = 0; j < n_el_bases; ++j)
 				{
-					index = mesh3d.get_index_from_element(e, lf, 0);
-					if (index.face == primitive_id)
-						break;
+					const int global_index = element_nodes_id[e][j];
+
+					b.bases[j].init(discr_order, global_index, j, positions.row(j));
+
+					b.bases[j].set_basis([gll_1d, j](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) {
+						Eigen::MatrixXd all;
+						autogen::q_nodal_basis_values(gll_1d, uv, all);
+						val = all.col(j);
+					});
+					b.bases[j].set_grad([gll_1d, j](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) {
+						std::vector<Eigen::MatrixXd> all;
+						autogen::q_nodal_grad_basis_values(gll_1d, uv, all);
+						val = all[j];
+					});
 				}
-				assert(index.face == primitive_id);
-				return tet_face_local_nodes(discr_order, mesh3d, index);
-			});
+				b.set_all_bases_funcs([gll_1d](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::q_nodal_basis_values(gll_1d, uv, val); },
+									  [gll_1d](const Eigen::MatrixXd &uv, std::vector<Eigen::MatrixXd> &grad) { autogen::q_nodal_grad_basis_values(gll_1d, uv, grad); });
+				// no reference element, the shared tables are built for the equispaced nodes
+			}
+			else if (mesh.is_cube(e))
+			{
+				const int real_order = quadrature_order > 0 ? quadrature_order : AssemblerUtils::quadrature_order(assembler, discr_order, AssemblerUtils::BasisType::CUBE_LAGRANGE, 3);
+				const int real_mass_order = mass_quadrature_order > 0 ? mass_quadrature_order : AssemblerUtils::quadrature_order("Mass", discr_order, AssemblerUtils::BasisType::CUBE_LAGRANGE, 3);
+				b.set_quadrature([real_order](Quadrature &quad) {
+					quad = QuadratureCache::get(QuadratureCache::Shape::HEXAHEDRON, real_order);
+				});
+				b.set_mass_quadrature([real_mass_order](Quadrature &quad) {
+					quad = QuadratureCache::get(QuadratureCache::Shape::HEXAHEDRON, real_mass_order);
+				});
 
-			const bool rational = is_geom_bases && mesh.is_rational() && !mesh.cell_weights(e).empty();
-			assert(!rational);
+				b.set_local_node_from_primitive_func([serendipity, discr_order, e](const int primitive_id, const Mesh &mesh) {
+					const auto &mesh3d = dynamic_cast<const Mesh3D &>(mesh);
+					Navigation3D::Index index;
 
-			for (int j = 0; j < n_el_bases; ++j)
-			{
-				const int global_index = element_nodes_id[e][j];
-				if (!skip_interface_element)
+					for (int lf = 0; lf < 6; ++lf)
+					{
+						index = mesh3d.get_index_from_element(e, lf, 0);
+						if (index.face == primitive_id)
+							break;
+					}
+					assert(index.face == primitive_id);
+					return hex_face_local_nodes(serendipity, discr_order, mesh3d, index);
+				});
+
+				for (int j = 0; j < n_el_bases; ++j)
 				{
+					const int global_index = element_nodes_id[e][j];
+
 					b.bases[j].init(discr_order, global_index, j, nodes.node_position(global_index));
+
+					const int dtmp = serendipity ? -2 : discr_order;
+
+					b.bases[j].set_basis([dtmp, j](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::q_basis_value_3d(dtmp, j, uv, val); });
+					b.bases[j].set_grad([dtmp, j](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::q_grad_basis_value_3d(dtmp, j, uv, val); });
 				}
+				const int q = serendipity ? -2 : discr_order;
+				b.set_all_bases_funcs([q](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::q_basis_values(q, uv, val); },
+									  [q](const Eigen::MatrixXd &uv, std::vector<Eigen::MatrixXd> &grad) { autogen::q_grad_basis_values(q, uv, grad); });
+				b.set_reference_element(reference_tables::ReferenceElement::HEXAHEDRON, q);
+			}
+			else if (mesh.is_simplex(e))
+			{
+				const int real_order = quadrature_order > 0 ? quadrature_order : AssemblerUtils::quadrature_order(assembler, discr_order, AssemblerUtils::BasisType::SIMPLEX_LAGRANGE, 3);
+				const int real_mass_order = mass_quadrature_order > 0 ? mass_quadrature_order : AssemblerUtils::quadrature_order("Mass", discr_order, AssemblerUtils::BasisType::SIMPLEX_LAGRANGE, 3);
+				b.is_affine = discr_order == 1;
+
+				b.set_quadrature([real_order](Quadrature &quad) {
+					quad = QuadratureCache::get(QuadratureCache::Shape::TETRAHEDRON, real_order);
+				});
+				b.set_mass_quadrature([real_mass_order](Quadrature &quad) {
+					quad = QuadratureCache::get(QuadratureCache::Shape::TETRAHEDRON, real_mass_order);
+				});
+
+				b.set_local_node_from_primitive_func([discr_order, e](const int primitive_id, const Mesh &mesh) {
+					const auto &mesh3d = dynamic_cast<const Mesh3D &>(mesh);
+					Navigation3D::Index index;
+
+					for (int lf = 0; lf < mesh3d.n_cell_faces(e); ++lf)
+					{
+						index = mesh3d.get_index_from_element(e, lf, 0);
+						if (index.face == primitive_id)
+							break;
+					}
+					assert(index.face == primitive_id);
+					return tet_face_local_nodes(discr_order, mesh3d, index);
+				});
+
+				const bool rational = is_geom_bases && mesh.is_rational() && !mesh.cell_weights(e).empty();
+				assert(!rational);
+
+				for (int j = 0; j < n_el_bases; ++j)
+				{
+					const int global_index = element_nodes_id[e][j];
+					if (!skip_interface_element)
+					{
+						b.bases[j].init(discr_order, global_index, j, nodes.node_position(global_index));
+					}
 
-				b.bases[j].set_basis([discr_order, j](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::p_basis_value_3d(discr_order, j, uv, val); });
-				b.bases[j].set_grad([discr_order, j](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::p_grad_basis_value_3d(discr_order, j, uv, val); });
+					b.bases[j].set_basis([discr_order, j](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::p_basis_value_3d(discr_order, j, uv, val); });
+					b.bases[j].set_grad([discr_order, j](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::p_grad_basis_value_3d(discr_order, j, uv, val); });
+				}
+				b.set_all_bases_funcs([discr_order](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::p_basis_values(discr_order, uv, val); },
+									  [discr_order](const Eigen::MatrixXd &uv, std::vector<Eigen::MatrixXd> &grad) { autogen::p_grad_basis_values(discr_order, uv, grad); });
+				b.set_reference_element(reference_tables::ReferenceElement::TETRAHEDRON, discr_order);
+			}
+			else
+			{
+				// Polyhedra bases are built later on
+				// assert(false);
 			}
 		}
-		else
+	});
+
+	if (!gll_nodes.empty())
+	{
+		// from order 3 the Gauss-Lobatto and equispaced nodes differ, the elements sharing an edge or face node must use the same ones
+		std::vector<int> node_kind(nodes.n_nodes(), -1);
+		for (int e = 0; e < mesh.n_cells(); ++e)
 		{
-			// Polyhedra bases are built later on
-			// assert(false);
+			if (!mesh.is_cube(e) && !mesh.is_simplex(e))
+				continue;
+			const bool spectral = gll[e] && mesh.is_cube(e) && discr_orders(e) >= 3;
+			const int kind = spectral ? discr_orders(e) : 0;
+			const int n_vertices = mesh.is_cube(e) ? 8 : 4;
+			for (int j = n_vertices; j < element_nodes_id[e].size(); ++j)
+			{
+				const int global_index = element_nodes_id[e][j];
+				if (global_index < 0)
+					continue;
+				int &k = node_kind[global_index];
+				if (k == -1)
+					k = kind;
+				else if (k != kind)
+					log_and_throw_error("Element {} shares nodes with an element with different nodes, Gauss-Lobatto elements of order {} must only be adjacent to Gauss-Lobatto elements of the same order", e, std::max(kind, k));
+			}
 		}
 	}
 
+	std::vector<int> interface_elements;
+	for (int e = 0; e < mesh.n_cells(); ++e)
+	{
+		if (is_interface_element[e])
+			interface_elements.push_back(e);
+	}
+
 	if (!is_geom_bases)
 	{
 		if (!mesh.is_conforming())
@@ -71,6 +71,9 @@ namespace polyfem
 			///                                the canonical elements lie on the boundary of the mesh
 			/// @param[out] poly_edge_to_data  Data for edges at the interface with a polygon (used to
 			///                                build the harmonics inside polygons)
+			/// @param[in]  gll                Per element flag, the flagged hexes use spectral element bases: Q_k with
+			///                                the nodes and the mass quadrature on the Gauss-Lobatto points, so the mass
+			///                                matrix is diagonal. Empty for equispaced nodes everywhere.
 			///
 			/// @return     The number of basis functions created.
 			///
@@ -86,7 +89,8 @@ namespace polyfem
 				std::vector<ElementBases> &bases,
 				std::vector<mesh::LocalBoundary> &local_boundary,
 				std::map<int, InterfaceData> &poly_face_to_data,
-				std::shared_ptr<mesh::MeshNodes> &mesh_nodes);
+				std::shared_ptr<mesh::MeshNodes> &mesh_nodes,
+				const std::vector<bool> &gll = {});
 
 			// return the local faces nodes for a tet or a hex of order p, index points to a face
 			static Eigen::VectorXi tet_face_local_nodes(const int p, const mesh::Mesh3D &mesh, mesh::Navigation3D::Index index);
@@ -0,0 +1,240 @@
+#include "NodeOrdering.hpp"
+
+#include <polyfem/utils/Logger.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+namespace polyfem::basis::node_ordering
+{
+	namespace
+	{
+		// sorted unique global indices of the element
+		std::vector<int> element_nodes(const ElementBases &bs)
+		{
+			std::vector<int> nodes;
+			for (const auto &b : bs.bases)
+				for (const auto &g : b.global())
+					nodes.push_back(g.index);
+			std::sort(nodes.begin(), nodes.end());
+			nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+			return nodes;
+		}
+
+		// node graph in CSR form, the neighbors of every node are sorted
+		void node_graph(const std::vector<ElementBases> &bases, const int n_bases, std::vector<int> &offsets, std::vector<int> &neighbors)
+		{
+			std::vector<std::vector<int>> el_nodes(bases.size());
+			utils::maybe_parallel_for(bases.size(), [&](int start, int end, int thread_id) {
+				for (int e = start; e < end; ++e)
+					el_nodes[e] = element_nodes(bases[e]);
+			});
+
+			std::vector<size_t> pair_offsets(bases.size() + 1, 0);
+			for (size_t e = 0; e < bases.size(); ++e)
+			{
+				const size_t n = el_nodes[e].size();
+				pair_offsets[e + 1] = pair_offsets[e] + (n > 0 ? n * (n - 1) : 0);
+			}
+
+			std::vector<std::pair<int, int>> pairs(pair_offsets.back());
+			utils::maybe_parallel_for(bases.size(), [&](int start, int end, int thread_id) {
+				for (int e = start; e < end; ++e)
+				{
+					const auto &nodes = el_nodes[e];
+					size_t k = pair_offsets[e];
+					for (const int i : nodes)
+						for (const int j : nodes)
+							if (i != j)
+								pairs[k++] = std::make_pair(i, j);
+				}
+			});
+			utils::maybe_parallel_sort(pairs.begin(), pairs.end());
+			pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+			offsets.assign(n_bases + 1, 0);
+			for (const auto &p : pairs)
+				++offsets[p.first + 1];
+			for (int i = 0; i < n_bases; ++i)
+				offsets[i + 1] += offsets[i];
+
+			neighbors.resize(pairs.size());
+			for (size_t k = 0; k < pairs.size(); ++k)
+				neighbors[k] = pairs[k].second;
+		}
+
+		// breadth first traversal from root, visiting the neighbors by increasing degree
+		// returns the visited nodes in order and the level of the last one
+		int bfs(const std::vector<int> &offsets, const std::vector<int> &neighbors, const int root,
+				std::vector<int> &level, std::vector<int> &order)
+		{
+			const auto degree = [&](const int i) { return offsets[i + 1] - offsets[i]; };
+
+			order.clear();
+			order.push_back(root);
+			level[root] = 0;
+			std::vector<int> next;
+			for (size_t k = 0; k < order.size(); ++k)
+			{
+				const int i = order[k];
+				next.clear();
+				for (int l = offsets[i]; l < offsets[i + 1]; ++l)
+				{
+					const int j = neighbors[l];
+					if (level[j] < 0)
+					{
+						level[j] = level[i] + 1;
+						next.push_back(j);
+					}
+				}
+				std::stable_sort(next.begin(), next.end(), [&](const int a, const int b) { return degree(a) < degree(b); });
+				order.insert(order.end(), next.begin(), next.end());
+			}
+			return level[order.back()];
+		}
+	} // namespace
+
+	Eigen::VectorXi reverse_cuthill_mckee(const std::vector<ElementBases> &bases, const int n_bases)
+	{
+		std::vector<int> offsets, neighbors;
+		node_graph(bases, n_bases, offsets, neighbors);
+		const auto degree = [&](const int i) { return offsets[i + 1] - offsets[i]; };
+
+		std::vector<int> seeds(n_bases);
+		for (int i = 0; i < n_bases; ++i)
+			seeds[i] = i;
+		std::stable_sort(seeds.begin(), seeds.end(), [&](const int a, const int b) { return degree(a) < degree(b); });
+
+		std::vector<int> level(n_bases, -1);
+		std::vector<bool> visited(n_bases, false);
+		std::vector<int> new_to_old, component;
+		new_to_old.reserve(n_bases);
+
+		for (const int seed : seeds)
+		{
+			if (visited[seed])
+				continue;
+
+			// pseudo-peripheral root: restart from a lowest degree node of the last level while the eccentricity grows
+			int root = seed;
+			int eccentricity = bfs(offsets, neighbors, root, level, component);
+			for (int iter = 0; iter < 10; ++iter)
+			{
+				const int last_level = eccentricity;
+				int candidate = component.back();
+				for (auto it = component.rbegin(); it != component.rend() && level[*it] == last_level; ++it)
+					if (degree(*it) < degree(candidate))
+						candidate = *it;
+
+				for (const int i : component)
+					level[i] = -1;
+				const int candidate_eccentricity = bfs(offsets, neighbors, candidate, level, component);
+				if (candidate_eccentricity <= eccentricity)
+					break;
+				root = candidate;
+				eccentricity = candidate_eccentricity;
+			}
+
+			for (const int i : component)
+				level[i] = -1;
+			bfs(offsets, neighbors, root, level, component);
+
+			for (const int i : component)
+			{
+				visited[i] = true;
+				new_to_old.push_back(i);
+			}
+		}
+		assert(new_to_old.size() == n_bases);
+
+		Eigen::VectorXi old_to_new(n_bases);
+		for (int k = 0; k < n_bases; ++k)
+			old_to_new[new_to_old[k]] = n_bases - 1 - k;
+
+		return old_to_new;
+	}
+
+	Eigen::VectorXi morton(const std::vector<ElementBases> &bases, const int n_bases)
+	{
+		Eigen::MatrixXd nodes;
+		std::vector<bool> has_node(n_bases, false);
+		for (const auto &bs : bases)
+		{
+			for (const auto &b : bs.bases)
+			{
+				for (const auto &g : b.global())
+				{
+					if (nodes.size() == 0)
+						nodes.setZero(n_bases, g.node.size());
+					if (!has_node[g.index])
+					{
+						nodes.row(g.index) = g.node;
+						has_node[g.index] = true;
+					}
+				}
+			}
+		}
+
+		std::vector<std::pair<uint64_t, int>> codes(n_bases);
+		const int dim = nodes.cols();
+		const int bits = dim > 0 ? 63 / dim : 0;
+		const Eigen::RowVectorXd min = dim > 0 ? Eigen::RowVectorXd(nodes.colwise().minCoeff()) : Eigen::RowVectorXd();
+		const Eigen::RowVectorXd max = dim > 0 ? Eigen::RowVectorXd(nodes.colwise().maxCoeff()) : Eigen::RowVectorXd();
+		const double extent = dim > 0 ? std::max((max - min).maxCoeff(), std::numeric_limits<double>::min()) : 1;
+		const double scale = double((uint64_t(1) << bits) - 1) / extent;
+
+		utils::maybe_parallel_for(n_bases, [&](int start, int end, int thread_id) {
+			for (int i = start; i < end; ++i)
+			{
+				uint64_t code = 0;
+				for (int d = 0; d < dim; ++d)
+				{
+					const uint64_t q = uint64_t((nodes(i, d) - min[d]) * scale);
+					for (int b = 0; b < bits; ++b)
+						code |= ((q >> b) & uint64_t(1)) << (b * dim + d);
+				}
+				codes[i] = std::make_pair(code, i);
+			}
+		});
+		utils::maybe_parallel_sort(codes.begin(), codes.end());
+
+		Eigen::VectorXi old_to_new(n_bases);
+		for (int k = 0; k < n_bases; ++k)
+			old_to_new[codes[k].second] = k;
+
+		return old_to_new;
+	}
+
+	Eigen::VectorXi compute(const std::string &type, const std::vector<ElementBases> &bases, const int n_bases)
+	{
+		if (type == "none")
+			return Eigen::VectorXi();
+		else if (type == "rcm")
+			return reverse_cuthill_mckee(bases, n_bases);
+		else if (type == "morton")
+			return morton(bases, n_bases);
+
+		log_and_throw_error("Unknown node ordering {}!", type);
+	}
+
+	void apply(const Eigen::VectorXi &old_to_new, std::vector<ElementBases> &bases)
+	{
+		utils::maybe_parallel_for(bases.size(), [&](int start, int end, int thread_id) {
+			for (int e = start; e < end; ++e)
+			{
+				for (auto &b : bases[e].bases)
+				{
+					for (auto &g : b.global())
+					{
+						assert(g.index >= 0 && g.index < old_to_new.size());
+						g.index = old_to_new[g.index];
+					}
+				}
+			}
+		});
+	}
+} // namespace polyfem::basis::node_ordering
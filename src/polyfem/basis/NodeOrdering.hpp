@@ -0,0 +1,41 @@
+#pragma once
+
+#include <polyfem/basis/ElementBases.hpp>
+
+#include <Eigen/Dense>
+
+#include <string>
+#include <vector>
+
+namespace polyfem
+{
+	namespace basis
+	{
+		/// @brief Renumbering of the global nodes of a discretization to improve the locality of the assembled matrices.
+		/// All the functions return (or take) a permutation old_to_new of [0, n_bases).
+		namespace node_ordering
+		{
+			/// @brief Reverse Cuthill-McKee ordering of the node graph (two nodes are connected if they share an element).
+			/// Each connected component starts from a pseudo-peripheral node, which reduces the bandwidth of the matrices.
+			/// @param[in] bases element bases, their global indices must be in [0, n_bases)
+			/// @param[in] n_bases number of global nodes
+			/// @return old_to_new permutation
+			Eigen::VectorXi reverse_cuthill_mckee(const std::vector<ElementBases> &bases, const int n_bases);
+
+			/// @brief Ordering of the nodes along a Morton (Z-order) space-filling curve of their positions.
+			/// @param[in] bases element bases, their global indices must be in [0, n_bases)
+			/// @param[in] n_bases number of global nodes
+			/// @return old_to_new permutation
+			Eigen::VectorXi morton(const std::vector<ElementBases> &bases, const int n_bases);
+
+			/// @brief Computes the ordering with the given name ("rcm" or "morton").
+			/// @return old_to_new permutation, empty for "none"
+			Eigen::VectorXi compute(const std::string &type, const std::vector<ElementBases> &bases, const int n_bases);
+
+			/// @brief Renumbers the global indices of the bases.
+			/// @param[in] old_to_new permutation of the global nodes
+			/// @param[in,out] bases element bases to renumber
+			void apply(const Eigen::VectorXi &old_to_new, std::vector<ElementBases> &bases);
+		} // namespace node_ordering
+	} // namespace basis
+} // namespace polyfem
@@ -2,16 +2,19 @@
 #include "PolygonalBasis2d.hpp"
 #include "LagrangeBasis2d.hpp"
 
-#include <polyfem/quadrature/PolygonQuadrature.hpp>
+#include <polyfem/quadrature/PolytopeQuadratureCache.hpp>
 #include <polyfem/mesh/mesh2D/PolygonUtils.hpp>
 #include "function/RBFWithLinear.hpp"
 #include "function/RBFWithQuadratic.hpp"
 #include "function/RBFWithQuadraticLagrange.hpp"
+#include "function/PolytopeSimilarity.hpp"
 #include <polyfem/utils/Logger.hpp>
 #include <polyfem/assembler/AssemblerUtils.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
 
 #include <polyfem/autogen/auto_q_bases.hpp>
 
+#include <cstring>
 #include <random>
 #include <memory>
 ////////////////////////////////////////////////////////////////////////////////
@@ -168,6 +171,61 @@ namespace polyfem
 				compute_offset_kernels(collocation_points, n_kernels, eps, kernel_centers);
 			}
 
+			// -----------------------------------------------------------------------------
+
+			/// @brief Hash of the inputs of sample_polygon: the vertices of the polygon, the geometric nodes of its neighbors and their bases on the interface
+			uint64_t samples_fingerprint(const int element_index, const int n_samples_per_edge, const Mesh2D &mesh, const std::map<int, InterfaceData> &poly_edge_to_data,
+										 const std::vector<ElementBases> &bases, const std::vector<ElementBases> &gbases)
+			{
+				// FNV-1a
+				uint64_t h = 0xcbf29ce484222325ull;
+				const auto add = [&h](const uint64_t x) { h = (h ^ x) * 0x100000001b3ull; };
+				const auto add_double = [&add](const double x) {
+					uint64_t bits;
+					std::memcpy(&bits, &x, sizeof(bits));
+					add(bits);
+				};
+
+				add(n_samples_per_edge);
+				const int n_edges = mesh.n_face_vertices(element_index);
+				for (int lv = 0; lv < n_edges; ++lv)
+				{
+					const RowVectorNd p = mesh.point(mesh.face_vertex(element_index, lv));
+					add_double(p(0));
+					add_double(p(1));
+				}
+
+				Navigation::Index index = mesh.get_index_from_face(element_index);
+				for (int i = 0; i < n_edges; ++i)
+				{
+					const int f2 = mesh.switch_face(index).face;
+					add(f2);
+					add(bases[f2].bases.size());
+					for (const Basis &b : gbases[f2].bases)
+					{
+						for (const auto &x : b.global())
+						{
+							for (int d = 0; d < x.node.size(); ++d)
+								add_double(x.node(d));
+						}
+					}
+
+					for (int other_local_basis_id : poly_edge_to_data.at(index.edge).local_indices)
+					{
+						add(other_local_basis_id);
+						for (const auto &x : bases[f2].bases[other_local_basis_id].global())
+						{
+							add(x.index);
+							add_double(x.val);
+						}
+					}
+
+					index = mesh.next_around_face(index);
+				}
+
+				return h;
+			}
+
 		} // anonymous namespace
 
 		////////////////////////////////////////////////////////////////////////////////
@@ -345,7 +403,7 @@ namespace polyfem
 
 		int PolygonalBasis2d::build_bases(const LinearAssembler &assembler, const int n_samples_per_edge, const Mesh2D &mesh, const int n_bases,
 										  const int quadrature_order, const int mass_quadrature_order, const int integral_constraints, std::vector<ElementBases> &bases, const std::vector<ElementBases> &gbases,
-										  const std::map<int, InterfaceData> &poly_edge_to_data, std::map<int, Eigen::MatrixXd> &mapped_boundary)
+										  const std::map<int, InterfaceData> &poly_edge_to_data, std::map<int, Eigen::MatrixXd> &mapped_boundary, PolygonSamplesCache *samples_cache)
 		{
 			assert(!mesh.is_volume());
 			if (poly_edge_to_data.empty())
@@ -359,122 +417,195 @@ namespace polyfem
 			Eigen::MatrixXd basis_integrals;
 			compute_integral_constraints(assembler, mesh, n_bases, bases, gbases, basis_integrals);
 
-			// Step 2: Compute the rest =)
-			PolygonQuadrature poly_quadr;
+			if (integral_constraints < 0 || integral_constraints > 2)
+			{
+				throw std::runtime_error(fmt::format("Unsupported constraint order: {:d}", integral_constraints));
+			}
+
+			// Step 2: Sample the polygons in parallel, the samples of the previous build are reused if their inputs did not change
+			std::vector<int> polygons;
 			for (int e = 0; e < mesh.n_elements(); ++e)
 			{
-				if (!mesh.is_polytope(e))
-				{
-					continue;
-				}
-				// No boundary polytope
-				// assert(element_type[e] != ElementType::BOUNDARY_POLYTOPE);
+				if (mesh.is_polytope(e))
+					polygons.push_back(e);
+			}
 
-				// Kernel distance to polygon boundary
-				const double eps = compute_epsilon(mesh, e);
+			PolygonSamplesCache local_cache;
+			PolygonSamplesCache &cache = samples_cache ? *samples_cache : local_cache;
 
-				std::vector<int> local_to_global; // map local basis id (the ones that are nonzero on the polygon boundary) to global basis id
-				Eigen::MatrixXd collocation_points, kernel_centers;
-				Eigen::MatrixXd rhs; // 1 row per collocation point, 1 column per basis that is nonzero on the polygon boundary
+			std::vector<const PolygonSamplesCache::Entry *> previous(polygons.size(), nullptr);
+			for (size_t i = 0; i < polygons.size(); ++i)
+			{
+				const auto it = cache.entries_.find(polygons[i]);
+				if (it != cache.entries_.end())
+					previous[i] = &it->second;
+			}
 
-				sample_polygon(e, n_samples_per_edge, mesh, poly_edge_to_data, bases, gbases, eps, local_to_global, collocation_points, kernel_centers, rhs);
+			std::vector<RBFFitData> fit_data(polygons.size());
+			std::vector<std::vector<int>> local_to_global(polygons.size()); // map local basis id (the ones that are nonzero on the polygon boundary) to global basis id
+			std::vector<uint64_t> fingerprints(polygons.size());
+			std::vector<char> reused(polygons.size(), false);
+			utils::maybe_parallel_for(polygons.size(), [&](int start, int end, int thread_id) {
+				for (int i = start; i < end; ++i)
+				{
+					const int e = polygons[i];
+					RBFFitData &data = fit_data[i];
 
-				// igl::opengl::glfw::Viewer viewer;
-				// viewer.data().add_points(kernel_centers, Eigen::Vector3d(0,1,1).transpose());
+					fingerprints[i] = samples_fingerprint(e, n_samples_per_edge, mesh, poly_edge_to_data, bases, gbases);
+					if (previous[i] && previous[i]->fingerprint == fingerprints[i])
+					{
+						local_to_global[i] = previous[i]->local_to_global;
+						data.collocation_points = previous[i]->collocation_points;
+						data.centers = previous[i]->centers;
+						data.rhs = previous[i]->rhs;
+						reused[i] = true;
+						continue;
+					}
 
-				// Eigen::MatrixXd asd(collocation_points.rows(), 3);
-				// asd.col(0)=collocation_points.col(0);
-				// asd.col(1)=collocation_points.col(1);
-				// asd.col(2)=rhs.col(0);
-				// viewer.data().add_points(asd, Eigen::Vector3d(1,0,1).transpose());
+					// Kernel distance to polygon boundary
+					const double eps = compute_epsilon(mesh, e);
 
-				// for(int asd = 0; asd < collocation_points.rows(); ++asd) {
-				//     viewer.data().add_label(collocation_points.row(asd), std::to_string(asd));
-				// }
+					sample_polygon(e, n_samples_per_edge, mesh, poly_edge_to_data, bases, gbases, eps, local_to_global[i], data.collocation_points, data.centers, data.rhs);
+				}
+			});
 
-				// viewer.launch();
+			cache.n_reused_ = std::count(reused.begin(), reused.end(), true);
+			if (samples_cache)
+			{
+				// only the current polygons are kept
+				std::map<int, PolygonSamplesCache::Entry> entries;
+				for (size_t i = 0; i < polygons.size(); ++i)
+				{
+					PolygonSamplesCache::Entry &entry = entries[polygons[i]];
+					entry.fingerprint = fingerprints[i];
+					entry.local_to_global = local_to_global[i];
+					entry.collocation_points = fit_data[i].collocation_points;
+					entry.centers = fit_data[i].centers;
+					entry.rhs = fit_data[i].rhs;
+				}
+				cache.entries_ = std::move(entries);
+				logger().debug("{}/{} polygon samples reused from the previous build", cache.n_reused_, polygons.size());
+			}
 
-				// igl::opengl::glfw::Viewer & viewer = UIState::ui_state().viewer;
-				// viewer.data().clear();
-				// viewer.data().set_mesh(triangulated_vertices, triangulated_faces);
-				// viewer.data().add_points(kernel_centers, Eigen::Vector3d(0,1,1).transpose());
-				// add_spheres(viewer, kernel_centers, 0.01);
+			// Quadratures, serially since the triangulation of the quadrature is not thread safe
+			PolytopeQuadratureCache &quadrature_cache = cache.quadratures_;
+			for (size_t i = 0; i < polygons.size(); ++i)
+			{
+				const int e = polygons[i];
+				RBFFitData &data = fit_data[i];
 
 				ElementBases &b = bases[e];
 				b.has_parameterization = false;
 
-				// Compute quadrature points for the polygon
-				Quadrature tmp_quadrature;
-				poly_quadr.get_quadrature(collocation_points, quadrature_order > 0 ? quadrature_order : AssemblerUtils::quadrature_order(assembler.name(), 2, AssemblerUtils::BasisType::POLY, 2), tmp_quadrature);
-
-				Quadrature tmp_mass_quadrature;
-				poly_quadr.get_quadrature(collocation_points, mass_quadrature_order > 0 ? mass_quadrature_order : AssemblerUtils::quadrature_order("Mass", 2, AssemblerUtils::BasisType::POLY, 2), tmp_mass_quadrature);
+				// Compute quadrature points for the polygon, shared with its translated copies
+				const TranslatedQuadrature quadrature = quadrature_cache.polygon(data.collocation_points, quadrature_order > 0 ? quadrature_order : AssemblerUtils::quadrature_order(assembler.name(), 2, AssemblerUtils::BasisType::POLY, 2));
+				const TranslatedQuadrature mass_quadrature = quadrature_cache.polygon(data.collocation_points, mass_quadrature_order > 0 ? mass_quadrature_order : AssemblerUtils::quadrature_order("Mass", 2, AssemblerUtils::BasisType::POLY, 2));
+				quadrature.get(data.quadrature);
 
-				b.set_quadrature([tmp_quadrature](Quadrature &quad) { quad = tmp_quadrature; });
-				b.set_mass_quadrature([tmp_mass_quadrature](Quadrature &quad) { quad = tmp_mass_quadrature; });
+				b.set_quadrature([quadrature](Quadrature &quad) { quadrature.get(quad); });
+				b.set_mass_quadrature([mass_quadrature](Quadrature &quad) { mass_quadrature.get(quad); });
 
-				// Compute the weights of the harmonic kernels
-				Eigen::MatrixXd local_basis_integrals(rhs.cols(), basis_integrals.cols());
-				for (long k = 0; k < rhs.cols(); ++k)
+				data.local_basis_integral.resize(data.rhs.cols(), basis_integrals.cols());
+				for (long k = 0; k < data.rhs.cols(); ++k)
 				{
-					local_basis_integrals.row(k) = -basis_integrals.row(local_to_global[k]);
+					data.local_basis_integral.row(k) = -basis_integrals.row(local_to_global[i][k]);
 				}
-				auto set_rbf = [&b](auto rbf) {
-					b.set_bases_func([rbf](const Eigen::MatrixXd &uv, std::vector<AssemblyValues> &val) {
-						Eigen::MatrixXd tmp;
-						rbf->bases_values(uv, tmp);
-						val.resize(tmp.cols());
-						assert(tmp.rows() == uv.rows());
-
-						for (size_t i = 0; i < tmp.cols(); ++i)
-						{
-							val[i].val = tmp.col(i);
-						}
-					});
-					b.set_grads_func([rbf](const Eigen::MatrixXd &uv, std::vector<AssemblyValues> &val) {
-						Eigen::MatrixXd tmpx, tmpy;
 
-						rbf->bases_grads(0, uv, tmpx);
-						rbf->bases_grads(1, uv, tmpy);
+				// Polygon boundary after geometric mapping from neighboring elements
+				mapped_boundary[e] = data.collocation_points;
+			}
+			logger().debug("{} polygon quadratures built, {} reused from a translated polygon", quadrature_cache.n_built(), quadrature_cache.n_reused());
 
-						val.resize(tmpx.cols());
-						assert(tmpx.cols() == tmpy.cols());
-						assert(tmpx.rows() == uv.rows());
-						for (size_t i = 0; i < tmpx.cols(); ++i)
-						{
-							val[i].grad.resize(uv.rows(), uv.cols());
-							val[i].grad.col(0) = tmpx.col(i);
-							val[i].grad.col(1) = tmpy.col(i);
-						}
-					});
-				};
-				if (integral_constraints == 0)
-				{
-					set_rbf(std::make_shared<RBFWithLinear>(kernel_centers, collocation_points, local_basis_integrals, tmp_quadrature, rhs, false));
-				}
-				else if (integral_constraints == 1)
-				{
-					set_rbf(std::make_shared<RBFWithLinear>(kernel_centers, collocation_points, local_basis_integrals, tmp_quadrature, rhs));
-				}
-				else if (integral_constraints == 2)
-				{
-					set_rbf(std::make_shared<RBFWithQuadraticLagrange>(assembler, kernel_centers, collocation_points, local_basis_integrals, tmp_quadrature, rhs));
-				}
-				else
+			// Step 3: Compute the weights of the harmonic kernels, in parallel
+			const auto set_rbf = [](ElementBases &b, auto rbf) {
+				b.set_bases_func([rbf](const Eigen::MatrixXd &uv, std::vector<AssemblyValues> &val) {
+					Eigen::MatrixXd tmp;
+					rbf->bases_values(uv, tmp);
+					val.resize(tmp.cols());
+					assert(tmp.rows() == uv.rows());
+
+					for (size_t i = 0; i < tmp.cols(); ++i)
+					{
+						val[i].val = tmp.col(i);
+					}
+				});
+				b.set_grads_func([rbf](const Eigen::MatrixXd &uv, std::vector<AssemblyValues> &val) {
+					Eigen::MatrixXd tmpx, tmpy;
+
+					rbf->bases_grads(0, uv, tmpx);
+					rbf->bases_grads(1, uv, tmpy);
+
+					val.resize(tmpx.cols());
+					assert(tmpx.cols() == tmpy.cols());
+					assert(tmpx.rows() == uv.rows());
+					for (size_t i = 0; i < tmpx.cols(); ++i)
+					{
+						val[i].grad.resize(uv.rows(), uv.cols());
+						val[i].grad.col(0) = tmpx.col(i);
+						val[i].grad.col(1) = tmpy.col(i);
+					}
+				});
+			};
+
+			if (integral_constraints == 2)
+			{
+				std::vector<std::shared_ptr<RBFWithQuadraticLagrange>> rbfs(polygons.size());
+				utils::maybe_parallel_for(polygons.size(), [&](int start, int end, int thread_id) {
+					for (int i = start; i < end; ++i)
+					{
+						const RBFFitData &data = fit_data[i];
+						Eigen::MatrixXd rhs = data.rhs;
+						rbfs[i] = std::make_shared<RBFWithQuadraticLagrange>(assembler, data.centers, data.collocation_points, data.local_basis_integral, data.quadrature, rhs);
+					}
+				});
+
+				for (size_t i = 0; i < polygons.size(); ++i)
+					set_rbf(bases[polygons[i]], rbfs[i]);
+			}
+			else
+			{
+				// polygons equal up to a similarity share their fit
+				const bool with_constraints = integral_constraints == 1;
+				std::vector<int> representative;
+				std::vector<Similarity> to_representative;
+				group_similar_polytopes(fit_data, with_constraints, representative, to_representative);
+
+				std::vector<std::shared_ptr<RBFWithLinear>> rbfs(polygons.size());
+				utils::maybe_parallel_for(polygons.size(), [&](int start, int end, int thread_id) {
+					for (int i = start; i < end; ++i)
+					{
+						if (representative[i] != i)
+							continue;
+						const RBFFitData &data = fit_data[i];
+						Eigen::MatrixXd rhs = data.rhs;
+						rbfs[i] = std::make_shared<RBFWithLinear>(data.centers, data.collocation_points, data.local_basis_integral, data.quadrature, rhs, with_constraints);
+					}
+				});
+
+				int n_reused = 0;
+				for (size_t i = 0; i < polygons.size(); ++i)
 				{
-					throw std::runtime_error(fmt::format("Unsupported constraint order: {:d}", integral_constraints));
+					if (representative[i] == int(i))
+						set_rbf(bases[polygons[i]], rbfs[i]);
+					else
+					{
+						set_rbf(bases[polygons[i]], std::make_shared<MappedRBFWithLinear>(rbfs[representative[i]], to_representative[i]));
+						++n_reused;
+					}
 				}
+				logger().debug("{}/{} polygons reuse the bases of a similar polygon", n_reused, polygons.size());
+			}
 
-				// Set the bases which are nonzero inside the polygon
-				const int n_poly_bases = int(local_to_global.size());
+			// Set the bases which are nonzero inside the polygons
+			for (size_t i = 0; i < polygons.size(); ++i)
+			{
+				ElementBases &b = bases[polygons[i]];
+				const int n_poly_bases = int(local_to_global[i].size());
 				b.bases.resize(n_poly_bases);
-				for (int i = 0; i < n_poly_bases; ++i)
+				for (int j = 0; j < n_poly_bases; ++j)
 				{
-					b.bases[i].init(-2, local_to_global[i], i, Eigen::MatrixXd::Constant(1, 2, std::nan("")));
+					b.bases[j].init(-2, local_to_global[i][j], j, Eigen::MatrixXd::Constant(1, 2, std::nan("")));
 				}
-
-				// Polygon boundary after geometric mapping from neighboring elements
-				mapped_boundary[e] = collocation_points;
 			}
 
 			return 0;
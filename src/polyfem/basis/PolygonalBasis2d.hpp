@@ -6,6 +6,7 @@
 #include <polyfem/basis/ElementBases.hpp>
 #include <polyfem/assembler/ElementAssemblyValues.hpp>
 #include <polyfem/basis/InterfaceData.hpp>
+#include <polyfem/quadrature/PolytopeQuadratureCache.hpp>
 
 #include <Eigen/Dense>
 #include <vector>
@@ -15,6 +16,42 @@ namespace polyfem
 {
 	namespace basis
 	{
+		/// Geometric preprocessing of the polygons, which does not depend on the assembler: collocation points, kernel
+		/// centers, values of the neighboring bases at the collocation points and quadratures. Kept by the caller across
+		/// the calls of PolygonalBasis2d::build_bases, so rebuilding the bases on the same mesh and space (e.g., after
+		/// changing the materials) only recomputes the integral constraints and the fits. The samples of a polygon are
+		/// recomputed when its vertices, its neighbors or their bases change.
+		class PolygonSamplesCache
+		{
+		public:
+			void clear()
+			{
+				entries_.clear();
+				quadratures_ = quadrature::PolytopeQuadratureCache();
+			}
+
+			/// number of polygons whose samples were reused by the last build
+			int n_reused() const { return n_reused_; }
+
+		private:
+			friend class PolygonalBasis2d;
+
+			struct Entry
+			{
+				/// hash of the inputs of the samples
+				uint64_t fingerprint = 0;
+				std::vector<int> local_to_global;
+				Eigen::MatrixXd collocation_points;
+				Eigen::MatrixXd centers;
+				Eigen::MatrixXd rhs;
+			};
+
+			/// samples of every polygon
+			std::map<int, Entry> entries_;
+			quadrature::PolytopeQuadratureCache quadratures_;
+			int n_reused_ = 0;
+		};
+
 		class PolygonalBasis2d
 		{
 		public:
@@ -50,6 +87,7 @@ namespace polyfem
 			/// @param[in]     gbases                 List of the different basis used to discretize the geometry of the mesh
 			/// @param[in]     poly_edge_to_data      Additional data computed for edges at the interface with a polygon
 			/// @param[out]    mapped_boundary        Map element id -> #S x dim polyline formed by the collocation points on the boundary of the polygon. The collocation points are mapped through the geometric mapping of the element across the edge, so this polyline may differ from the original polygon.
+			/// @param[in,out] samples_cache          Samples and quadratures of the previous builds, nullptr to compute them from scratch
 			/// @param[in]  element_types   Per-element tag indicating the type of each element (see Mesh.hpp)
 			/// @param[in]  values          Per-element shape functions for the PDE, evaluated over the element, used for the system matrix assembly (used for linear reproduction)
 			/// @param[in]  gvalues         Per-element shape functions for the geometric mapping, evaluated over the element (get boundary of the polygon)
@@ -65,7 +103,8 @@ namespace polyfem
 				std::vector<ElementBases> &bases,
 				const std::vector<ElementBases> &gbases,
 				const std::map<int, InterfaceData> &poly_edge_to_data,
-				std::map<int, Eigen::MatrixXd> &mapped_boundary);
+				std::map<int, Eigen::MatrixXd> &mapped_boundary,
+				PolygonSamplesCache *samples_cache = nullptr);
 		};
 	} // namespace basis
 } // namespace polyfem
@@ -3,7 +3,7 @@
 #include "LagrangeBasis3d.hpp"
 
 #include <polyfem/assembler/AssemblerUtils.hpp>
-#include <polyfem/quadrature/PolyhedronQuadrature.hpp>
+#include <polyfem/quadrature/PolytopeQuadratureCache.hpp>
 #include <polyfem/assembler/AssemblerUtils.hpp>
 #include <polyfem/mesh/MeshUtils.hpp>
 #include <polyfem/mesh/mesh2D/Refinement.hpp>
@@ -11,7 +11,9 @@
 #include "function/RBFWithLinear.hpp"
 #include "function/RBFWithQuadratic.hpp"
 #include "function/RBFWithQuadraticLagrange.hpp"
+#include "function/PolytopeSimilarity.hpp"
 #include <polyfem/utils/Logger.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
 
 #include <polyfem/autogen/auto_q_bases.hpp>
 
@@ -231,8 +233,6 @@ namespace polyfem
 				const int n_quadrature_vertices_per_edge,
 				const int n_kernels_per_edge,
 				int n_samples_per_edge,
-				const int quadrature_order,
-				const int mass_quadrature_order,
 				const Mesh3D &mesh,
 				const std::map<int, InterfaceData> &poly_face_to_data,
 				const std::vector<ElementBases> &bases,
@@ -244,8 +244,8 @@ namespace polyfem
 				Eigen::MatrixXd &rhs,
 				Eigen::MatrixXd &triangulated_vertices,
 				Eigen::MatrixXi &triangulated_faces,
-				Quadrature &quadrature,
-				Quadrature &mass_quadrature,
+				PolytopeQuadratureCache &quadrature_cache,
+				TranslatedQuadrature &quadrature,
 				double &scaling,
 				Eigen::RowVector3d &translation)
 			{
@@ -377,10 +377,7 @@ namespace polyfem
 				scaling = 1.0;
 				translation.setZero();
 				// NV = (NV.rowwise() - translation) / scaling;
-				PolyhedronQuadrature::get_quadrature(NV, triangulated_faces, mesh.kernel(element_index),
-													 quadrature_order, quadrature);
-				PolyhedronQuadrature::get_quadrature(NV, triangulated_faces, mesh.kernel(element_index),
-													 mass_quadrature_order, mass_quadrature);
+				quadrature = quadrature_cache.polyhedron(NV, triangulated_faces, mesh.kernel(element_index));
 
 				// Normalization
 				// collocation_points = (collocation_points.rowwise() - translation) / scaling;
@@ -597,144 +594,159 @@ namespace polyfem
 			Eigen::MatrixXd basis_integrals;
 			compute_integral_constraints(assembler, mesh, n_bases, bases, gbases, basis_integrals);
 
-			// Step 2: Compute the rest =)
+			if (integral_constraints < 0 || integral_constraints > 2)
+			{
+				throw std::runtime_error(fmt::format("Unsupported constraint order: {:d}", integral_constraints));
+			}
+
+			// Step 2: Sample the polyhedra, serially since their tetrahedralization is not thread safe
+			std::vector<int> polyhedra;
 			for (int e = 0; e < mesh.n_elements(); ++e)
 			{
-				if (!mesh.is_polytope(e))
-				{
-					continue;
-				}
-				// No boundary polytope
-				// assert(element_type[e] != ElementType::BOUNDARY_POLYTOPE);
+				if (mesh.is_polytope(e))
+					polyhedra.push_back(e);
+			}
+
+			std::vector<RBFFitData> fit_data(polyhedra.size());
+			std::vector<std::vector<int>> local_to_global(polyhedra.size()); // map local basis id (the ones that are nonzero on the polygon boundary) to global basis id
+			PolytopeQuadratureCache quadrature_cache;
+			for (size_t i = 0; i < polyhedra.size(); ++i)
+			{
+				const int e = polyhedra[i];
+				RBFFitData &data = fit_data[i];
 
 				// Kernel distance to polygon boundary
 				const double eps = compute_epsilon(mesh, e);
 
-				std::vector<int> local_to_global; // map local basis id (the ones that are nonzero on the polygon boundary) to global basis id
-				Eigen::MatrixXd collocation_points, kernel_centers, triangulated_vertices;
+				Eigen::MatrixXd triangulated_vertices;
 				Eigen::MatrixXi triangulated_faces;
-				Eigen::MatrixXd rhs; // 1 row per collocation point, 1 column per basis that is nonzero on the polygon boundary
 
 				ElementBases &b = bases[e];
 				b.has_parameterization = false;
 
-				Quadrature tmp_quadrature, tmp_mass_quadrature;
+				// the polyhedron rule does not depend on the order, it is shared by the stiffness and the mass
+				TranslatedQuadrature quadrature;
 				double scaling;
 				Eigen::RowVector3d translation;
 				sample_polyhedra(e, 2, n_kernels_per_edge, n_samples_per_edge,
-								 quadrature_order > 0 ? quadrature_order : AssemblerUtils::quadrature_order(assembler.name(), 2, AssemblerUtils::BasisType::POLY, 3),
-								 mass_quadrature_order > 0 ? mass_quadrature_order : AssemblerUtils::quadrature_order("Mass", 2, AssemblerUtils::BasisType::POLY, 3),
-								 mesh, poly_face_to_data, bases, gbases, eps, local_to_global,
-								 collocation_points, kernel_centers, rhs, triangulated_vertices,
-								 triangulated_faces, tmp_quadrature, tmp_mass_quadrature, scaling, translation);
-
-				b.set_quadrature([tmp_quadrature](Quadrature &quad) { quad = tmp_quadrature; });
-				b.set_mass_quadrature([tmp_mass_quadrature](Quadrature &quad) { quad = tmp_mass_quadrature; });
+								 mesh, poly_face_to_data, bases, gbases, eps, local_to_global[i],
+								 data.collocation_points, data.centers, data.rhs, triangulated_vertices,
+								 triangulated_faces, quadrature_cache, quadrature, scaling, translation);
+				quadrature.get(data.quadrature);
+
+				b.set_quadrature([quadrature](Quadrature &quad) { quadrature.get(quad); });
+				b.set_mass_quadrature([quadrature](Quadrature &quad) { quadrature.get(quad); });
 				// b.scaling_ = scaling;
 				// b.translation_ = translation;
 
-				// igl::opengl::glfw::Viewer & viewer = UIState::ui_state().viewer;
-				// viewer.data().clear();
-				// viewer.data().set_mesh(triangulated_vertices, triangulated_faces);
-				// viewer.data().add_points(kernel_centers, Eigen::Vector3d(0,1,1).transpose());
-				// add_spheres(viewer, kernel_centers, 0.005);
-
-				// Eigen::MatrixXd pts = triangulated_vertices, normals;
-				// Eigen::MatrixXi tris = triangulated_faces;
-				// igl::per_corner_normals(pts, tris, 20, normals);
-				// viewer.data().set_normals(normals);
-				// viewer.data().set_face_based(false);
-				// viewer.launch();
+				data.local_basis_integral.resize(data.rhs.cols(), basis_integrals.cols());
+				for (long k = 0; k < data.rhs.cols(); ++k)
+				{
+					data.local_basis_integral.row(k) = -basis_integrals.row(local_to_global[i][k]);
+				}
 
-				// for(int a = 0; rhs.cols();++a)
-				// 	{
-				// 	igl::opengl::glfw::Viewer viewer;
-				// 	Eigen::MatrixXd asd(collocation_points.rows(), 3);
-				// 	asd.col(0)=collocation_points.col(0);
-				// 	asd.col(1)=collocation_points.col(1);
-				// 	asd.col(2)=collocation_points.col(2);
-				// 	Eigen::VectorXd S = rhs.col(a);
-				// 	Eigen::MatrixXd C;
-				// 	igl::colormap(igl::COLOR_MAP_TYPE_VIRIDIS, S, true, C);
-				// 	viewer.data().add_points(asd, C);
-				// 	viewer.launch();
-				// }
+				// Polygon boundary after geometric mapping from neighboring elements
+				orient_closed_surface(triangulated_vertices, triangulated_faces, false); // stupid viewer is flipping all the faces
+				mapped_boundary[e].first = triangulated_vertices;
+				mapped_boundary[e].second = triangulated_faces;
+			}
+			logger().debug("{} polyhedron quadratures built, {} reused from a translated polyhedron", quadrature_cache.n_built(), quadrature_cache.n_reused());
 
-				// for(int asd = 0; asd < collocation_points.rows(); ++asd) {
-				//     viewer.data().add_label(collocation_points.row(asd), std::to_string(asd));
-				// }
+			// Step 3: Compute the weights of the RBF kernels, in parallel
+			const auto set_rbf = [](ElementBases &b, auto rbf) {
+				b.set_bases_func([rbf](const Eigen::MatrixXd &uv, std::vector<AssemblyValues> &val) {
+					Eigen::MatrixXd tmp;
+					rbf->bases_values(uv, tmp);
+					val.resize(tmp.cols());
+					assert(tmp.rows() == uv.rows());
 
-				// Compute the weights of the RBF kernels
-				Eigen::MatrixXd local_basis_integrals(rhs.cols(), basis_integrals.cols());
-				for (long k = 0; k < rhs.cols(); ++k)
-				{
-					local_basis_integrals.row(k) = -basis_integrals.row(local_to_global[k]);
-				}
-				auto set_rbf = [&b](auto rbf) {
-					b.set_bases_func([rbf](const Eigen::MatrixXd &uv, std::vector<AssemblyValues> &val) {
-						Eigen::MatrixXd tmp;
-						rbf->bases_values(uv, tmp);
-						val.resize(tmp.cols());
-						assert(tmp.rows() == uv.rows());
-
-						for (size_t i = 0; i < tmp.cols(); ++i)
-						{
-							val[i].val = tmp.col(i);
-						}
-					});
-					b.set_grads_func([rbf](const Eigen::MatrixXd &uv, std::vector<AssemblyValues> &val) {
-						Eigen::MatrixXd tmpx, tmpy, tmpz;
-
-						rbf->bases_grads(0, uv, tmpx);
-						rbf->bases_grads(1, uv, tmpy);
-						rbf->bases_grads(2, uv, tmpz);
-
-						val.resize(tmpx.cols());
-						assert(tmpx.cols() == tmpy.cols());
-						assert(tmpx.cols() == tmpz.cols());
-						assert(tmpx.rows() == uv.rows());
-						for (size_t i = 0; i < tmpx.cols(); ++i)
-						{
-							val[i].grad.resize(uv.rows(), uv.cols());
-							val[i].grad.col(0) = tmpx.col(i);
-							val[i].grad.col(1) = tmpy.col(i);
-							val[i].grad.col(2) = tmpz.col(i);
-						}
-					});
-				};
-				if (integral_constraints == 0)
-				{
-					set_rbf(std::make_shared<RBFWithLinear>(
-						kernel_centers, collocation_points, local_basis_integrals, tmp_quadrature, rhs, false));
-				}
-				else if (integral_constraints == 1)
-				{
-					set_rbf(std::make_shared<RBFWithLinear>(
-						kernel_centers, collocation_points, local_basis_integrals, tmp_quadrature, rhs));
-				}
-				else if (integral_constraints == 2)
-				{
-					set_rbf(std::make_shared<RBFWithQuadratic>(
-						// set_rbf(std::make_shared<RBFWithQuadraticLagrange>(
-						assembler, kernel_centers, collocation_points, local_basis_integrals, tmp_quadrature, rhs));
-				}
-				else
+					for (size_t i = 0; i < tmp.cols(); ++i)
+					{
+						val[i].val = tmp.col(i);
+					}
+				});
+				b.set_grads_func([rbf](const Eigen::MatrixXd &uv, std::vector<AssemblyValues> &val) {
+					Eigen::MatrixXd tmpx, tmpy, tmpz;
+
+					rbf->bases_grads(0, uv, tmpx);
+					rbf->bases_grads(1, uv, tmpy);
+					rbf->bases_grads(2, uv, tmpz);
+
+					val.resize(tmpx.cols());
+					assert(tmpx.cols() == tmpy.cols());
+					assert(tmpx.cols() == tmpz.cols());
+					assert(tmpx.rows() == uv.rows());
+					for (size_t i = 0; i < tmpx.cols(); ++i)
+					{
+						val[i].grad.resize(uv.rows(), uv.cols());
+						val[i].grad.col(0) = tmpx.col(i);
+						val[i].grad.col(1) = tmpy.col(i);
+						val[i].grad.col(2) = tmpz.col(i);
+					}
+				});
+			};
+
+			if (integral_constraints == 2)
+			{
+				std::vector<std::shared_ptr<RBFWithQuadratic>> rbfs(polyhedra.size());
+				maybe_parallel_for(polyhedra.size(), [&](int start, int end, int thread_id) {
+					for (int i = start; i < end; ++i)
+					{
+						const RBFFitData &data = fit_data[i];
+						Eigen::MatrixXd rhs = data.rhs;
+						rbfs[i] = std::make_shared<RBFWithQuadratic>(
+							// rbfs[i] = std::make_shared<RBFWithQuadraticLagrange>(
+							assembler, data.centers, data.collocation_points, data.local_basis_integral, data.quadrature, rhs);
+					}
+				});
+
+				for (size_t i = 0; i < polyhedra.size(); ++i)
+					set_rbf(bases[polyhedra[i]], rbfs[i]);
+			}
+			else
+			{
+				// polyhedra equal up to a similarity share their fit
+				const bool with_constraints = integral_constraints == 1;
+				std::vector<int> representative;
+				std::vector<Similarity> to_representative;
+				group_similar_polytopes(fit_data, with_constraints, representative, to_representative);
+
+				std::vector<std::shared_ptr<RBFWithLinear>> rbfs(polyhedra.size());
+				maybe_parallel_for(polyhedra.size(), [&](int start, int end, int thread_id) {
+					for (int i = start; i < end; ++i)
+					{
+						if (representative[i] != i)
+							continue;
+						const RBFFitData &data = fit_data[i];
+						Eigen::MatrixXd rhs = data.rhs;
+						rbfs[i] = std::make_shared<RBFWithLinear>(data.centers, data.collocation_points, data.local_basis_integral, data.quadrature, rhs, with_constraints);
+					}
+				});
+
+				int n_reused = 0;
+				for (size_t i = 0; i < polyhedra.size(); ++i)
 				{
-					throw std::runtime_error(fmt::format("Unsupported constraint order: {:d}", integral_constraints));
+					if (representative[i] == int(i))
+						set_rbf(bases[polyhedra[i]], rbfs[i]);
+					else
+					{
+						set_rbf(bases[polyhedra[i]], std::make_shared<MappedRBFWithLinear>(rbfs[representative[i]], to_representative[i]));
+						++n_reused;
+					}
 				}
+				logger().debug("{}/{} polyhedra reuse the bases of a similar polyhedron", n_reused, polyhedra.size());
+			}
 
-				// Set the bases which are nonzero inside the polygon
-				const int n_poly_bases = int(local_to_global.size());
+			// Set the bases which are nonzero inside the polyhedra
+			for (size_t i = 0; i < polyhedra.size(); ++i)
+			{
+				ElementBases &b = bases[polyhedra[i]];
+				const int n_poly_bases = int(local_to_global[i].size());
 				b.bases.resize(n_poly_bases);
-				for (int i = 0; i < n_poly_bases; ++i)
+				for (int j = 0; j < n_poly_bases; ++j)
 				{
-					b.bases[i].init(-2, local_to_global[i], i, Eigen::MatrixXd::Constant(1, 3, std::nan("")));
+					b.bases[j].init(-2, local_to_global[i][j], j, Eigen::MatrixXd::Constant(1, 3, std::nan("")));
 				}
-
-				// Polygon boundary after geometric mapping from neighboring elements
-				orient_closed_surface(triangulated_vertices, triangulated_faces, false); // stupid viewer is flipping all the faces
-				mapped_boundary[e].first = triangulated_vertices;
-				mapped_boundary[e].second = triangulated_faces;
 			}
 
 			return 0;
@@ -0,0 +1,91 @@
+#include "ReferenceTables.hpp"
+
+#include <cassert>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <tuple>
+
+namespace polyfem::basis::reference_tables
+{
+	namespace
+	{
+		using Key = std::tuple<ReferenceElement, int, int>;
+
+		struct Cache
+		{
+			std::shared_mutex mutex;
+			std::map<Key, std::vector<std::shared_ptr<const ReferenceTable>>> tables;
+		};
+
+		Cache &cache()
+		{
+			static Cache instance;
+			return instance;
+		}
+
+		std::shared_ptr<const ReferenceTable> find(const std::vector<std::shared_ptr<const ReferenceTable>> &tables, const Eigen::MatrixXd &points)
+		{
+			for (const auto &t : tables)
+			{
+				if (t->points.rows() == points.rows() && t->points.cols() == points.cols() && t->points == points)
+					return t;
+			}
+			return nullptr;
+		}
+	} // namespace
+
+	std::shared_ptr<const ReferenceTable> get(
+		const ReferenceElement element, const int order, const int n_bases,
+		const Eigen::MatrixXd &points,
+		const std::function<void(ReferenceTable &)> &build)
+	{
+		Cache &c = cache();
+		const Key key(element, order, n_bases);
+
+		{
+			std::shared_lock lock(c.mutex);
+			const auto it = c.tables.find(key);
+			if (it != c.tables.end())
+			{
+				if (auto t = find(it->second, points))
+					return t;
+				if (it->second.size() >= MAX_POINT_SETS)
+					return nullptr;
+			}
+		}
+
+		auto table = std::make_shared<ReferenceTable>();
+		table->points = points;
+		build(*table);
+		assert(table->val.rows() == points.rows() && table->val.cols() == n_bases);
+		assert(table->grad.size() == n_bases);
+
+		std::unique_lock lock(c.mutex);
+		auto &tables = c.tables[key];
+		// another thread may have built it in the meantime
+		if (auto t = find(tables, points))
+			return t;
+		if (tables.size() >= MAX_POINT_SETS)
+			return nullptr;
+		tables.push_back(table);
+		return table;
+	}
+
+	int size()
+	{
+		Cache &c = cache();
+		std::shared_lock lock(c.mutex);
+		int res = 0;
+		for (const auto &[key, tables] : c.tables)
+			res += tables.size();
+		return res;
+	}
+
+	void clear()
+	{
+		Cache &c = cache();
+		std::unique_lock lock(c.mutex);
+		c.tables.clear();
+	}
+} // namespace polyfem::basis::reference_tables
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <Eigen/Dense>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace polyfem
+{
+	namespace basis
+	{
+		/// @brief Values and gradients of the bases of a reference element at a set of points
+		struct ReferenceTable
+		{
+			/// #P x dim evaluation points
+			Eigen::MatrixXd points;
+			/// #P x #B values, one column per basis
+			Eigen::MatrixXd val;
+			/// #B gradients, each #P x dim
+			std::vector<Eigen::MatrixXd> grad;
+		};
+
+		/// @brief Global thread-safe cache of reference tables, shared by all the elements with the same reference element and order.
+		/// The point sets are compared exactly, so the tables are only reused for the same quadrature.
+		namespace reference_tables
+		{
+			/// reference elements of the parametric Lagrange bases
+			enum class ReferenceElement
+			{
+				NONE = 0,
+				TRIANGLE,
+				QUAD,
+				TETRAHEDRON,
+				HEXAHEDRON
+			};
+
+			/// maximal number of point sets stored per reference element and order, the other point sets are not tabulated
+			constexpr int MAX_POINT_SETS = 16;
+
+			/// @brief Returns the table of the reference element at the points, built on the first request
+			/// @param[in] element reference element
+			/// @param[in] order discretization order (negative for serendipity bases)
+			/// @param[in] n_bases number of bases of the element
+			/// @param[in] points evaluation points
+			/// @param[in] build fills val and grad of a table, called without holding the lock
+			/// @return shared table, nullptr if there are already MAX_POINT_SETS tables for this element and order
+			std::shared_ptr<const ReferenceTable> get(
+				const ReferenceElement element, const int order, const int n_bases,
+				const Eigen::MatrixXd &points,
+				const std::function<void(ReferenceTable &)> &build);
+
+			/// number of stored tables
+			int size();
+
+			/// removes all the tables
+			void clear();
+		} // namespace reference_tables
+	} // namespace basis
+} // namespace polyfem
@@ -3,7 +3,7 @@
 #include "LagrangeBasis2d.hpp"
 #include "function/QuadraticBSpline2d.hpp"
 
-#include <polyfem/quadrature/QuadQuadrature.hpp>
+#include <polyfem/quadrature/QuadratureCache.hpp>
 #include <polyfem/mesh/MeshNodes.hpp>
 
 #include <polyfem/assembler/AssemblerUtils.hpp>
@@ -11,12 +11,14 @@
 #include <polysolve/LinearSolver.hpp>
 
 #include <polyfem/utils/Types.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
 
 #include <polyfem/Common.hpp>
 #include <polyfem/autogen/auto_q_bases.hpp>
 
 #include <Eigen/Sparse>
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <vector>
@@ -344,6 +346,31 @@ namespace polyfem
 				}
 			}
 
+			// Node ids of the faces around the irregular vertex of the element, in the order of the walk. The missing nodes are created.
+			void irregular_vertex_neighs(const int el_id, const Mesh2D &mesh, MeshNodes &mesh_nodes, std::vector<int> &ids)
+			{
+				Navigation::Index start_index = mesh.get_index_from_face(el_id);
+				bool found = false;
+				for (int i = 0; i < 4; ++i)
+				{
+					ids.clear();
+					Navigation::Index index = start_index;
+					do
+					{
+						ids.push_back(mesh_nodes.node_id_from_face(index.face));
+						index = mesh.next_around_vertex(index);
+					} while (index.face != start_index.face);
+					if (ids.size() != 4)
+					{
+						found = true;
+						break;
+					}
+
+					start_index = mesh.next_around_face(start_index);
+				}
+				assert(found);
+			}
+
 			void basis_for_irregulard_quad(const int el_id, const Mesh2D &mesh, MeshNodes &mesh_nodes, const SpaceMatrix &space, const NodeMatrix &loc_nodes, const std::array<std::array<double, 4>, 3> &h_knots, const std::array<std::array<double, 4>, 3> &v_knots, ElementBases &b)
 			{
 				for (int y = 0; y < 3; ++y)
@@ -358,37 +385,17 @@ namespace polyfem
 							const int mmx = x;
 							const int mmy = 1;
 
-							std::vector<int> other_indices;
 							const auto &center = b.bases[1 * 3 + 1].global().front();
 
 							const auto &el1 = b.bases[mpy * 3 + mpx].global().front();
 							const auto &el2 = b.bases[mmy * 3 + mmx].global().front();
 
-							Navigation::Index start_index = mesh.get_index_from_face(el_id);
-							bool found = false;
-							for (int i = 0; i < 4; ++i)
-							{
-								other_indices.clear();
-								int n_neighs = 0;
-								Navigation::Index index = start_index;
-								do
-								{
-									const int f_index = mesh_nodes.node_id_from_face(index.face);
-									if (f_index != el1.index && f_index != el2.index && f_index != center.index)
-										other_indices.push_back(f_index);
-
-									++n_neighs;
-									index = mesh.next_around_vertex(index);
-								} while (index.face != start_index.face);
-								if (n_neighs != 4)
-								{
-									found = true;
-									break;
-								}
-
-								start_index = mesh.next_around_face(start_index);
-							}
-							assert(found);
+							std::vector<int> other_indices;
+							irregular_vertex_neighs(el_id, mesh, mesh_nodes, other_indices);
+							other_indices.erase(std::remove_if(other_indices.begin(), other_indices.end(), [&](const int f_index) {
+													return f_index == el1.index || f_index == el2.index || f_index == center.index;
+												}),
+												other_indices.end());
 
 							const int local_index = y * 3 + x;
 							auto &base = b.bases[local_index];
@@ -690,79 +697,91 @@ namespace polyfem
 
 			local_boundary.clear();
 
-			// QuadQuadrature quad_quadrature;
-
+			// The stencils create the node ids, they are built serially in the order of the elements (with the nodes around the
+			// irregular vertices) so that the numbering does not depend on the threads. The bases only read the nodes.
+			std::vector<SpaceMatrix> spaces(n_els);
+			std::vector<NodeMatrix> loc_nodes(n_els);
+			std::vector<int> irregular_ids;
 			for (int e = 0; e < n_els; ++e)
 			{
 				if (!mesh.is_spline_compatible(e))
 					continue;
 
-				SpaceMatrix space;
-				NodeMatrix loc_nodes;
-
 				// const int max_local_base =
-				build_local_space(mesh, mesh_nodes, e, space, loc_nodes, local_boundary, poly_edge_to_data);
+				build_local_space(mesh, mesh_nodes, e, spaces[e], loc_nodes[e], local_boundary, poly_edge_to_data);
 				// n_bases = max(n_bases, max_local_base);
 
-				ElementBases &b = bases[e];
-				// quad_quadrature.get_quadrature(quadrature_order, b.quadrature);
-				const int real_order = quadrature_order > 0 ? quadrature_order : AssemblerUtils::quadrature_order(assembler, 2, AssemblerUtils::BasisType::SPLINE, 2);
-				const int real_mass_order = mass_quadrature_order > 0 ? mass_quadrature_order : AssemblerUtils::quadrature_order("Mass", 2, AssemblerUtils::BasisType::SPLINE, 2);
+				const SpaceMatrix &space = spaces[e];
+				if (std::any_of(space.data(), space.data() + space.size(), [](const std::vector<int> &ids) { return ids.size() > 1; }))
+					irregular_vertex_neighs(e, mesh, mesh_nodes, irregular_ids);
+			}
 
-				b.set_quadrature([real_order](Quadrature &quad) {
-					QuadQuadrature quad_quadrature;
-					quad_quadrature.get_quadrature(real_order, quad);
-				});
-				b.set_mass_quadrature([real_mass_order](Quadrature &quad) {
-					QuadQuadrature quad_quadrature;
-					quad_quadrature.get_quadrature(real_mass_order, quad);
-				});
-				b.bases.resize(9);
+			const int real_order = quadrature_order > 0 ? quadrature_order : AssemblerUtils::quadrature_order(assembler, 2, AssemblerUtils::BasisType::SPLINE, 2);
+			const int real_mass_order = mass_quadrature_order > 0 ? mass_quadrature_order : AssemblerUtils::quadrature_order("Mass", 2, AssemblerUtils::BasisType::SPLINE, 2);
 
-				b.set_local_node_from_primitive_func([e](const int primitive_id, const Mesh &mesh) {
-					Eigen::VectorXi res(3);
-					const auto &mesh2d = dynamic_cast<const Mesh2D &>(mesh);
-					auto index = mesh2d.get_index_from_face(e);
-					int le;
-					for (le = 0; le < mesh2d.n_face_vertices(e); ++le)
-					{
-						if (index.edge == primitive_id)
-							break;
-						index = mesh2d.next_around_face(index);
-					}
-					assert(index.edge == primitive_id);
+			utils::maybe_parallel_for(n_els, [&](int start, int end, int thread_id) {
+				for (int e = start; e < end; ++e)
+				{
+					if (!mesh.is_spline_compatible(e))
+						continue;
 
-					switch (le)
-					{
-					case 3:
-						res << (3 * 0 + 0), (3 * 1 + 0), (3 * 2 + 0);
-						break;
-					case 0:
-						res << (3 * 0 + 0), (3 * 0 + 1), (3 * 0 + 2);
-						break;
-					case 1:
-						res << (3 * 0 + 2), (3 * 1 + 2), (3 * 2 + 2);
-						break;
-					case 2:
-						res << (3 * 2 + 0), (3 * 2 + 1), (3 * 2 + 2);
-						break;
-					default:
-						assert(false);
-					}
+					const SpaceMatrix &space = spaces[e];
+
+					ElementBases &b = bases[e];
+					// quad_quadrature.get_quadrature(quadrature_order, b.quadrature);
+					b.set_quadrature([real_order](Quadrature &quad) {
+						quad = QuadratureCache::get(QuadratureCache::Shape::QUAD, real_order);
+					});
+					b.set_mass_quadrature([real_mass_order](Quadrature &quad) {
+						quad = QuadratureCache::get(QuadratureCache::Shape::QUAD, real_mass_order);
+					});
+					b.bases.resize(9);
+
+					b.set_local_node_from_primitive_func([e](const int primitive_id, const Mesh &mesh) {
+						Eigen::VectorXi res(3);
+						const auto &mesh2d = dynamic_cast<const Mesh2D &>(mesh);
+						auto index = mesh2d.get_index_from_face(e);
+						int le;
+						for (le = 0; le < mesh2d.n_face_vertices(e); ++le)
+						{
+							if (index.edge == primitive_id)
+								break;
+							index = mesh2d.next_around_face(index);
+						}
+						assert(index.edge == primitive_id);
 
-					return res;
-				});
+						switch (le)
+						{
+						case 3:
+							res << (3 * 0 + 0), (3 * 1 + 0), (3 * 2 + 0);
+							break;
+						case 0:
+							res << (3 * 0 + 0), (3 * 0 + 1), (3 * 0 + 2);
+							break;
+						case 1:
+							res << (3 * 0 + 2), (3 * 1 + 2), (3 * 2 + 2);
+							break;
+						case 2:
+							res << (3 * 2 + 0), (3 * 2 + 1), (3 * 2 + 2);
+							break;
+						default:
+							assert(false);
+						}
 
-				std::array<std::array<double, 4>, 3> h_knots;
-				std::array<std::array<double, 4>, 3> v_knots;
+						return res;
+					});
 
-				setup_knots_vectors(mesh_nodes, space, h_knots, v_knots);
+					std::array<std::array<double, 4>, 3> h_knots;
+					std::array<std::array<double, 4>, 3> v_knots;
 
-				// print_local_space(space);
+					setup_knots_vectors(mesh_nodes, space, h_knots, v_knots);
 
-				basis_for_regular_quad(space, loc_nodes, h_knots, v_knots, b);
-				basis_for_irregulard_quad(e, mesh, mesh_nodes, space, loc_nodes, h_knots, v_knots, b);
-			}
+					// print_local_space(space);
+
+					basis_for_regular_quad(space, loc_nodes[e], h_knots, v_knots, b);
+					basis_for_irregulard_quad(e, mesh, mesh_nodes, space, loc_nodes[e], h_knots, v_knots, b);
+				}
+			});
 
 			std::set<int> edge_id;
 			std::set<int> vertex_id;
@@ -780,12 +799,10 @@ namespace polyfem
 				const int real_mass_order = mass_quadrature_order > 0 ? mass_quadrature_order : AssemblerUtils::quadrature_order("Mass", 2, AssemblerUtils::BasisType::CUBE_LAGRANGE, 2);
 
 				b.set_quadrature([real_order](Quadrature &quad) {
-					QuadQuadrature quad_quadrature;
-					quad_quadrature.get_quadrature(real_order, quad);
+					quad = QuadratureCache::get(QuadratureCache::Shape::QUAD, real_order);
 				});
 				b.set_mass_quadrature([real_mass_order](Quadrature &quad) {
-					QuadQuadrature quad_quadrature;
-					quad_quadrature.get_quadrature(real_mass_order, quad);
+					quad = QuadratureCache::get(QuadratureCache::Shape::QUAD, real_mass_order);
 				});
 
 				b.set_local_node_from_primitive_func([e](const int primitive_id, const Mesh &mesh) {
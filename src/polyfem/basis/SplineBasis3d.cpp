@@ -2,7 +2,7 @@
 
 #include "LagrangeBasis3d.hpp"
 #include "function/QuadraticBSpline3d.hpp"
-#include <polyfem/quadrature/HexQuadrature.hpp>
+#include <polyfem/quadrature/QuadratureCache.hpp>
 
 #include <polyfem/assembler/AssemblerUtils.hpp>
 
@@ -10,6 +10,7 @@
 #include <polyfem/mesh/MeshNodes.hpp>
 
 #include <polyfem/utils/Types.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
 
 #include <polyfem/Common.hpp>
 #include <polyfem/autogen/auto_q_bases.hpp>
@@ -599,94 +600,102 @@ namespace polyfem
 				}
 			}
 
-			void basis_for_irregulard_hex(const int el_index, const Mesh3D &mesh, MeshNodes &mesh_nodes, const SpaceMatrix &space, const std::array<std::array<double, 4>, 3> &h_knots, const std::array<std::array<double, 4>, 3> &v_knots, const std::array<std::array<double, 4>, 3> &w_knots, ElementBases &b, std::map<int, InterfaceData> &poly_face_to_data)
+			// Local indices of the center and of the two neighbours of the irregular basis (x, y, z), and the node ids of the elements
+			// around the irregular edge, the center first. The missing nodes are created.
+			void irregular_edge_neighs(const int el_index, const Mesh3D &mesh, MeshNodes &mesh_nodes, const SpaceMatrix &space, const int x, const int y, const int z, int &center_local, int &el1_local, int &el2_local, std::vector<int> &ids)
 			{
-				for (int z = 0; z < 3; ++z)
-				{
-					for (int y = 0; y < 3; ++y)
-					{
-						for (int x = 0; x < 3; ++x)
-						{
-							if (!space.is_regular(x, y, z)) // space(1, y, z).size() > 1 || space(x, 1, z).size() > 1 || space(x, y, 1).size() > 1)
-							{
-								const int local_index = 9 * z + 3 * y + x;
+				int mpx = -1;
+				int mpy = -1;
+				int mpz = -1;
 
-								int mpx = -1;
-								int mpy = -1;
-								int mpz = -1;
+				int mmx = -1;
+				int mmy = -1;
+				int mmz = -1;
 
-								int mmx = -1;
-								int mmy = -1;
-								int mmz = -1;
+				int xx = 1;
+				int yy = 1;
+				int zz = 1;
 
-								int xx = 1;
-								int yy = 1;
-								int zz = 1;
+				const int edge_id = space.edge_id;
+				int dir = -1;
 
-								const int edge_id = space.edge_id;
-								int dir = -1;
+				if (space.x == x && space.y == y && space.z == 1)
+				{
+					mpx = 1;
+					mpy = y;
+					mpz = z;
 
-								if (space.x == x && space.y == y && space.z == 1)
-								{
-									mpx = 1;
-									mpy = y;
-									mpz = z;
+					mmx = x;
+					mmy = 1;
+					mmz = z;
 
-									mmx = x;
-									mmy = 1;
-									mmz = z;
+					zz = z;
+					dir = z;
+				}
+				else if (space.x == x && space.y == 1 && space.z == z)
+				{
+					mpx = 1;
+					mpy = y;
+					mpz = z;
 
-									zz = z;
-									dir = z;
-								}
-								else if (space.x == x && space.y == 1 && space.z == z)
-								{
-									mpx = 1;
-									mpy = y;
-									mpz = z;
+					mmx = x;
+					mmy = y;
+					mmz = 1;
 
-									mmx = x;
-									mmy = y;
-									mmz = 1;
+					yy = y;
+					dir = y;
+				}
+				else if (space.x == 1 && space.y == y && space.z == z)
+				{
+					mpx = x;
+					mpy = y;
+					mpz = 1;
 
-									yy = y;
-									dir = y;
-								}
-								else if (space.x == 1 && space.y == y && space.z == z)
-								{
-									mpx = x;
-									mpy = y;
-									mpz = 1;
+					mmx = x;
+					mmy = 1;
+					mmz = z;
 
-									mmx = x;
-									mmy = 1;
-									mmz = z;
+					xx = x;
+					dir = x;
+				}
+				else
+					assert(false);
 
-									xx = x;
-									dir = x;
-								}
-								else
-									assert(false);
+				// the center is a regular basis, its node is the one of the space
+				center_local = zz * 9 + yy * 3 + xx;
+				el1_local = mpz * 9 + mpy * 3 + mpx;
+				el2_local = mmz * 9 + mmy * 3 + mmx;
 
-								const auto &center = b.bases[zz * 9 + yy * 3 + xx].global().front();
+				ids.clear();
+				get_edge_elements_neighs(mesh, mesh_nodes, el_index, edge_id, dir, ids);
 
-								const auto &el1 = b.bases[mpz * 9 + mpy * 3 + mpx].global().front();
-								const auto &el2 = b.bases[mmz * 9 + mmy * 3 + mmx].global().front();
+				if (ids.front() != space(xx, yy, zz))
+				{
+					assert(dir != 1);
+					ids.clear();
+					get_edge_elements_neighs(mesh, mesh_nodes, el_index, edge_id, dir == 2 ? 0 : 2, ids);
+				}
+			}
 
-								// std::cout<<"el_index "<<el_index<<std::endl;
-								// std::cout<<"center "<<center.index<<std::endl;
-								// std::cout<<"el1 "<<el1.index<<std::endl;
-								// std::cout<<"el2 "<<el2.index<<std::endl;
+			void basis_for_irregulard_hex(const int el_index, const Mesh3D &mesh, MeshNodes &mesh_nodes, const SpaceMatrix &space, const std::array<std::array<double, 4>, 3> &h_knots, const std::array<std::array<double, 4>, 3> &v_knots, const std::array<std::array<double, 4>, 3> &w_knots, ElementBases &b, std::map<int, InterfaceData> &poly_face_to_data)
+			{
+				for (int z = 0; z < 3; ++z)
+				{
+					for (int y = 0; y < 3; ++y)
+					{
+						for (int x = 0; x < 3; ++x)
+						{
+							if (!space.is_regular(x, y, z)) // space(1, y, z).size() > 1 || space(x, 1, z).size() > 1 || space(x, y, 1).size() > 1)
+							{
+								const int local_index = 9 * z + 3 * y + x;
 
+								int center_local, el1_local, el2_local;
 								std::vector<int> ids;
-								get_edge_elements_neighs(mesh, mesh_nodes, el_index, edge_id, dir, ids);
+								irregular_edge_neighs(el_index, mesh, mesh_nodes, space, x, y, z, center_local, el1_local, el2_local, ids);
 
-								if (ids.front() != center.index)
-								{
-									assert(dir != 1);
-									ids.clear();
-									get_edge_elements_neighs(mesh, mesh_nodes, el_index, edge_id, dir == 2 ? 0 : 2, ids);
-								}
+								const auto &center = b.bases[center_local].global().front();
+								const auto &el1 = b.bases[el1_local].global().front();
+								const auto &el2 = b.bases[el2_local].global().front();
 
 								assert(ids.front() == center.index);
 
@@ -1040,77 +1049,95 @@ namespace polyfem
 
 			// HexQuadrature hex_quadrature;
 
-			std::array<std::array<double, 4>, 3> h_knots;
-			std::array<std::array<double, 4>, 3> v_knots;
-			std::array<std::array<double, 4>, 3> w_knots;
-
+			// The stencils create the node ids, they are built serially in the order of the elements (with the nodes around the
+			// irregular edges) so that the numbering does not depend on the threads. The bases only read the nodes.
+			std::vector<SpaceMatrix> spaces(n_els);
 			for (int e = 0; e < n_els; ++e)
 			{
 				if (!mesh.is_spline_compatible(e))
 					continue;
 
-				SpaceMatrix space;
-
+				SpaceMatrix &space = spaces[e];
 				build_local_space(mesh, mesh_nodes, e, space, local_boundary, poly_face_to_data);
 
-				ElementBases &b = bases[e];
-				const int real_order = quadrature_order > 0 ? quadrature_order : AssemblerUtils::quadrature_order(assembler, 2, AssemblerUtils::BasisType::SPLINE, 3);
-				const int real_mass_order = mass_quadrature_order > 0 ? mass_quadrature_order : AssemblerUtils::quadrature_order("Mass", 2, AssemblerUtils::BasisType::SPLINE, 3);
+				int center_local, el1_local, el2_local;
+				std::vector<int> ids;
+				for (int z = 0; z < 3; ++z)
+					for (int y = 0; y < 3; ++y)
+						for (int x = 0; x < 3; ++x)
+							if (!space.is_regular(x, y, z))
+								irregular_edge_neighs(e, mesh, mesh_nodes, space, x, y, z, center_local, el1_local, el2_local, ids);
+			}
 
-				b.set_quadrature([real_order](Quadrature &quad) {
-					HexQuadrature hex_quadrature;
-					hex_quadrature.get_quadrature(real_order, quad);
-				});
-				b.set_mass_quadrature([real_mass_order](Quadrature &quad) {
-					HexQuadrature hex_quadrature;
-					hex_quadrature.get_quadrature(real_mass_order, quad);
-				});
-				// hex_quadrature.get_quadrature(quadrature_order, b.quadrature);
-				b.bases.resize(27);
+			const int real_order = quadrature_order > 0 ? quadrature_order : AssemblerUtils::quadrature_order(assembler, 2, AssemblerUtils::BasisType::SPLINE, 3);
+			const int real_mass_order = mass_quadrature_order > 0 ? mass_quadrature_order : AssemblerUtils::quadrature_order("Mass", 2, AssemblerUtils::BasisType::SPLINE, 3);
 
-				b.set_local_node_from_primitive_func([e](const int primitive_id, const Mesh &mesh) {
-					const auto &mesh3d = dynamic_cast<const Mesh3D &>(mesh);
+			utils::maybe_parallel_for(n_els, [&](int start, int end, int thread_id) {
+				std::array<std::array<double, 4>, 3> h_knots;
+				std::array<std::array<double, 4>, 3> v_knots;
+				std::array<std::array<double, 4>, 3> w_knots;
 
-					std::array<std::function<Navigation3D::Index(Navigation3D::Index)>, 6> to_face;
-					mesh3d.to_face_functions(to_face);
+				for (int e = start; e < end; ++e)
+				{
+					if (!mesh.is_spline_compatible(e))
+						continue;
 
-					auto start_index = mesh3d.get_index_from_element(e);
-					auto index = start_index;
+					const SpaceMatrix &space = spaces[e];
 
-					int lf;
-					for (lf = 0; lf < mesh3d.n_cell_faces(e); ++lf)
-					{
-						index = to_face[lf](start_index);
-						if (index.face == primitive_id)
-							break;
-					}
-					assert(index.face == primitive_id);
+					ElementBases &b = bases[e];
+					b.set_quadrature([real_order](Quadrature &quad) {
+						quad = QuadratureCache::get(QuadratureCache::Shape::HEXAHEDRON, real_order);
+					});
+					b.set_mass_quadrature([real_mass_order](Quadrature &quad) {
+						quad = QuadratureCache::get(QuadratureCache::Shape::HEXAHEDRON, real_mass_order);
+					});
+					// hex_quadrature.get_quadrature(quadrature_order, b.quadrature);
+					b.bases.resize(27);
+
+					b.set_local_node_from_primitive_func([e](const int primitive_id, const Mesh &mesh) {
+						const auto &mesh3d = dynamic_cast<const Mesh3D &>(mesh);
 
-					static constexpr std::array<std::array<int, 9>, 6> face_to_index = {{
-						{{2 * 9 + 0 * 3 + 0, 2 * 9 + 1 * 3 + 0, 2 * 9 + 2 * 3 + 0, 2 * 9 + 0 * 3 + 1, 2 * 9 + 1 * 3 + 1, 2 * 9 + 2 * 3 + 1, 2 * 9 + 0 * 3 + 2, 2 * 9 + 1 * 3 + 2, 2 * 9 + 2 * 3 + 2}}, // 0
-						{{0 * 9 + 0 * 3 + 0, 0 * 9 + 1 * 3 + 0, 0 * 9 + 2 * 3 + 0, 0 * 9 + 0 * 3 + 1, 0 * 9 + 1 * 3 + 1, 0 * 9 + 2 * 3 + 1, 0 * 9 + 0 * 3 + 2, 0 * 9 + 1 * 3 + 2, 0 * 9 + 2 * 3 + 2}}, // 1
+						std::array<std::function<Navigation3D::Index(Navigation3D::Index)>, 6> to_face;
+						mesh3d.to_face_functions(to_face);
 
-						{{0 * 9 + 0 * 3 + 2, 0 * 9 + 1 * 3 + 2, 0 * 9 + 2 * 3 + 2, 1 * 9 + 0 * 3 + 2, 1 * 9 + 1 * 3 + 2, 1 * 9 + 2 * 3 + 2, 2 * 9 + 0 * 3 + 2, 2 * 9 + 1 * 3 + 2, 2 * 9 + 2 * 3 + 2}}, // 2
-						{{0 * 9 + 0 * 3 + 0, 0 * 9 + 1 * 3 + 0, 0 * 9 + 2 * 3 + 0, 1 * 9 + 0 * 3 + 0, 1 * 9 + 1 * 3 + 0, 1 * 9 + 2 * 3 + 0, 2 * 9 + 0 * 3 + 0, 2 * 9 + 1 * 3 + 0, 2 * 9 + 2 * 3 + 0}}, // 3
+						auto start_index = mesh3d.get_index_from_element(e);
+						auto index = start_index;
 
-						{{0 * 9 + 2 * 3 + 0, 0 * 9 + 2 * 3 + 1, 0 * 9 + 2 * 3 + 2, 1 * 9 + 2 * 3 + 0, 1 * 9 + 2 * 3 + 1, 1 * 9 + 2 * 3 + 2, 2 * 9 + 2 * 3 + 0, 2 * 9 + 2 * 3 + 1, 2 * 9 + 2 * 3 + 2}}, // 4
-						{{0 * 9 + 0 * 3 + 0, 0 * 9 + 0 * 3 + 1, 0 * 9 + 0 * 3 + 2, 1 * 9 + 0 * 3 + 0, 1 * 9 + 0 * 3 + 1, 1 * 9 + 0 * 3 + 2, 2 * 9 + 0 * 3 + 0, 2 * 9 + 0 * 3 + 1, 2 * 9 + 0 * 3 + 2}}, // 5
-					}};
+						int lf;
+						for (lf = 0; lf < mesh3d.n_cell_faces(e); ++lf)
+						{
+							index = to_face[lf](start_index);
+							if (index.face == primitive_id)
+								break;
+						}
+						assert(index.face == primitive_id);
 
-					Eigen::VectorXi res(9);
+						static constexpr std::array<std::array<int, 9>, 6> face_to_index = {{
+							{{2 * 9 + 0 * 3 + 0, 2 * 9 + 1 * 3 + 0, 2 * 9 + 2 * 3 + 0, 2 * 9 + 0 * 3 + 1, 2 * 9 + 1 * 3 + 1, 2 * 9 + 2 * 3 + 1, 2 * 9 + 0 * 3 + 2, 2 * 9 + 1 * 3 + 2, 2 * 9 + 2 * 3 + 2}}, // 0
+							{{0 * 9 + 0 * 3 + 0, 0 * 9 + 1 * 3 + 0, 0 * 9 + 2 * 3 + 0, 0 * 9 + 0 * 3 + 1, 0 * 9 + 1 * 3 + 1, 0 * 9 + 2 * 3 + 1, 0 * 9 + 0 * 3 + 2, 0 * 9 + 1 * 3 + 2, 0 * 9 + 2 * 3 + 2}}, // 1
 
-					for (int i = 0; i < 9; ++i)
-						res(i) = face_to_index[lf][i];
+							{{0 * 9 + 0 * 3 + 2, 0 * 9 + 1 * 3 + 2, 0 * 9 + 2 * 3 + 2, 1 * 9 + 0 * 3 + 2, 1 * 9 + 1 * 3 + 2, 1 * 9 + 2 * 3 + 2, 2 * 9 + 0 * 3 + 2, 2 * 9 + 1 * 3 + 2, 2 * 9 + 2 * 3 + 2}}, // 2
+							{{0 * 9 + 0 * 3 + 0, 0 * 9 + 1 * 3 + 0, 0 * 9 + 2 * 3 + 0, 1 * 9 + 0 * 3 + 0, 1 * 9 + 1 * 3 + 0, 1 * 9 + 2 * 3 + 0, 2 * 9 + 0 * 3 + 0, 2 * 9 + 1 * 3 + 0, 2 * 9 + 2 * 3 + 0}}, // 3
 
-					return res;
-				});
+							{{0 * 9 + 2 * 3 + 0, 0 * 9 + 2 * 3 + 1, 0 * 9 + 2 * 3 + 2, 1 * 9 + 2 * 3 + 0, 1 * 9 + 2 * 3 + 1, 1 * 9 + 2 * 3 + 2, 2 * 9 + 2 * 3 + 0, 2 * 9 + 2 * 3 + 1, 2 * 9 + 2 * 3 + 2}}, // 4
+							{{0 * 9 + 0 * 3 + 0, 0 * 9 + 0 * 3 + 1, 0 * 9 + 0 * 3 + 2, 1 * 9 + 0 * 3 + 0, 1 * 9 + 0 * 3 + 1, 1 * 9 + 0 * 3 + 2, 2 * 9 + 0 * 3 + 0, 2 * 9 + 0 * 3 + 1, 2 * 9 + 0 * 3 + 2}}, // 5
+						}};
 
-				setup_knots_vectors(mesh_nodes, space, h_knots, v_knots, w_knots);
-				// print_local_space(space);
+						Eigen::VectorXi res(9);
 
-				basis_for_regular_hex(mesh_nodes, space, h_knots, v_knots, w_knots, b);
-				basis_for_irregulard_hex(e, mesh, mesh_nodes, space, h_knots, v_knots, w_knots, b, poly_face_to_data);
-			}
+						for (int i = 0; i < 9; ++i)
+							res(i) = face_to_index[lf][i];
+
+						return res;
+					});
+
+					setup_knots_vectors(mesh_nodes, space, h_knots, v_knots, w_knots);
+					// print_local_space(space);
+
+					basis_for_regular_hex(mesh_nodes, space, h_knots, v_knots, w_knots, b);
+					basis_for_irregulard_hex(e, mesh, mesh_nodes, space, h_knots, v_knots, w_knots, b, poly_face_to_data);
+				}
+			});
 
 			int n_bases = mesh_nodes.n_nodes();
 
@@ -1130,12 +1157,10 @@ namespace polyfem
 
 				// hex_quadrature.get_quadrature(quadrature_order, b.quadrature);
 				b.set_quadrature([real_order](Quadrature &quad) {
-					HexQuadrature hex_quadrature;
-					hex_quadrature.get_quadrature(real_order, quad);
+					quad = QuadratureCache::get(QuadratureCache::Shape::HEXAHEDRON, real_order);
 				});
 				b.set_mass_quadrature([real_mass_order](Quadrature &quad) {
-					HexQuadrature hex_quadrature;
-					hex_quadrature.get_quadrature(real_mass_order, quad);
+					quad = QuadratureCache::get(QuadratureCache::Shape::HEXAHEDRON, real_mass_order);
 				});
 
 				b.set_local_node_from_primitive_func([e](const int primitive_id, const Mesh &mesh) {
@@ -1,10 +1,12 @@
 ////////////////////////////////////////////////////////////////////////////////
 #include "BarycentricBasis2d.hpp"
-#include <polyfem/quadrature/PolygonQuadrature.hpp>
+#include <polyfem/quadrature/PolytopeQuadratureCache.hpp>
 
 #include <polyfem/assembler/AssemblerUtils.hpp>
 
+#include <map>
 #include <memory>
+#include <mutex>
 
 namespace polyfem
 {
@@ -109,10 +111,113 @@ namespace polyfem
 				return local_to_global;
 			}
 
+			/// values of the bases at the points of a polygon quadrature, shared by the translated copies of the
+			/// polygon since the barycentric coordinates do not change when the polygon and the points are translated
+			class QuadratureTable
+			{
+			public:
+				explicit QuadratureTable(const std::shared_ptr<const Quadrature> &rule) : rule_(rule) {}
+
+				/// true if uv are the points of the rule translated to origin
+				bool matches(const Eigen::MatrixXd &uv, const Eigen::RowVectorXd &origin) const
+				{
+					if (uv.rows() != rule_->points.rows() || uv.cols() != rule_->points.cols())
+						return false;
+					const double tol = 1e-12 * (1 + origin.cwiseAbs().maxCoeff());
+					return ((uv.rowwise() - origin) - rule_->points).cwiseAbs().maxCoeff() <= tol;
+				}
+
+				/// values at uv, computed by the first polygon evaluating them
+				const Eigen::MatrixXd &values(const BarycentricBasis2d::PolygonData &polygon, const Eigen::MatrixXd &uv, const BarycentricBasis2d::BlockFunction &bc, const double tol)
+				{
+					std::call_once(values_flag_, [&]() { bc(polygon, uv, values_, tol); });
+					return values_;
+				}
+
+				/// derivatives at uv, computed by the first polygon evaluating them
+				void grads(const BarycentricBasis2d::PolygonData &polygon, const Eigen::MatrixXd &uv, const BarycentricBasis2d::BlockGradFunction &bc_prime, const double tol, const Eigen::MatrixXd *&dx, const Eigen::MatrixXd *&dy)
+				{
+					std::call_once(grads_flag_, [&]() { bc_prime(polygon, uv, dx_, dy_, tol); });
+					dx = &dx_;
+					dy = &dy_;
+				}
+
+			private:
+				const std::shared_ptr<const Quadrature> rule_;
+				std::once_flag values_flag_, grads_flag_;
+				Eigen::MatrixXd values_, dx_, dy_;
+			};
+
+			/// table of the rule of a translated quadrature, created on the first use of the rule
+			std::shared_ptr<QuadratureTable> quadrature_table(std::map<const Quadrature *, std::shared_ptr<QuadratureTable>> &tables, const TranslatedQuadrature &quadrature)
+			{
+				std::shared_ptr<QuadratureTable> &table = tables[quadrature.rule.get()];
+				if (!table)
+					table = std::make_shared<QuadratureTable>(quadrature.rule);
+				return table;
+			}
 		} // anonymous namespace
 
 		////////////////////////////////////////////////////////////////////////////////
 
+		BarycentricBasis2d::PolygonData::PolygonData(const Eigen::MatrixXd &polygon)
+			: vertices(polygon)
+		{
+			const int n = polygon.rows();
+			areas_prime.resize(n, 2);
+			corner_areas.resize(n);
+			for (int i = 0; i < n; ++i)
+			{
+				const int ip1 = (i + 1) == n ? 0 : (i + 1);
+				const int im1 = i == 0 ? (n - 1) : (i - 1);
+
+				areas_prime(i, 0) = polygon(i, 1) - polygon(ip1, 1);
+				areas_prime(i, 1) = polygon(ip1, 0) - polygon(i, 0);
+
+				const Eigen::RowVector2d e0 = polygon.row(im1) - polygon.row(i);
+				const Eigen::RowVector2d e1 = polygon.row(ip1) - polygon.row(i);
+				corner_areas(i) = e0(0) * e1(1) - e0(1) * e1(0);
+			}
+		}
+
+		BarycentricBasis2d::BlockData::BlockData(const PolygonData &polygon, const Eigen::MatrixXd &points, const double tol)
+		{
+			assert(points.cols() == 2);
+			const int n_pts = points.rows();
+			const int n = polygon.vertices.rows();
+
+			sx.resize(n_pts, n);
+			sy.resize(n_pts, n);
+			for (int i = 0; i < n; ++i)
+			{
+				sx.col(i) = polygon.vertices(i, 0) - points.col(0).array();
+				sy.col(i) = polygon.vertices(i, 1) - points.col(1).array();
+			}
+			radii = (sx.square() + sy.square()).sqrt();
+
+			const Eigen::ArrayXXd sx1 = shifted(sx, 1);
+			const Eigen::ArrayXXd sy1 = shifted(sy, 1);
+			areas = sx * sy1 - sy * sx1;
+			products = sx * sx1 + sy * sy1;
+
+			const Eigen::Array<bool, Eigen::Dynamic, 1> on_boundary = (radii < tol).rowwise().any() || (areas.abs() < tol && products < 0).rowwise().any();
+			for (int p = 0; p < n_pts; ++p)
+			{
+				if (on_boundary(p))
+					boundary_points.push_back(p);
+			}
+		}
+
+		Eigen::ArrayXXd BarycentricBasis2d::BlockData::shifted(const Eigen::ArrayXXd &a, const int offset)
+		{
+			const int n = a.cols();
+			const int k = ((offset % n) + n) % n;
+			Eigen::ArrayXXd res(a.rows(), n);
+			res.leftCols(n - k) = a.rightCols(n - k);
+			res.rightCols(k) = a.leftCols(k);
+			return res;
+		}
+
 		int BarycentricBasis2d::build_bases(
 			const std::string &assembler_name,
 			const int dim,
@@ -120,8 +225,8 @@ namespace polyfem
 			const int n_bases,
 			const int quadrature_order,
 			const int mass_quadrature_order,
-			const std::function<void(const Eigen::MatrixXd &, const Eigen::RowVector2d &, Eigen::MatrixXd &, const double)> bc,
-			const std::function<void(const Eigen::MatrixXd &, const Eigen::RowVector2d &, Eigen::MatrixXd &, const double)> bc_prime,
+			const BlockFunction bc,
+			const BlockGradFunction bc_prime,
 			std::vector<ElementBases> &bases,
 			std::vector<LocalBoundary> &local_boundary,
 			std::map<int, Eigen::MatrixXd> &mapped_boundary)
@@ -134,7 +239,8 @@ namespace polyfem
 
 			std::map<int, int> new_nodes;
 
-			PolygonQuadrature poly_quadr;
+			PolytopeQuadratureCache quadrature_cache;
+			std::map<const Quadrature *, std::shared_ptr<QuadratureTable>> tables;
 			for (int e = 0; e < mesh.n_elements(); ++e)
 			{
 				if (!mesh.is_polytope(e))
@@ -172,52 +278,50 @@ namespace polyfem
 				ElementBases &b = bases[e];
 				b.has_parameterization = false;
 
-				// Compute quadrature points for the polygon
-				Quadrature tmp_quadrature;
-				poly_quadr.get_quadrature(polygon, quadrature_order > 0 ? quadrature_order : AssemblerUtils::quadrature_order(assembler_name, 1, AssemblerUtils::BasisType::POLY, 2), tmp_quadrature);
-
-				Quadrature tmp_mass_quadrature;
-				poly_quadr.get_quadrature(polygon, mass_quadrature_order > 0 ? mass_quadrature_order : AssemblerUtils::quadrature_order("Mass", 1, AssemblerUtils::BasisType::POLY, 2), tmp_mass_quadrature);
+				// Compute quadrature points for the polygon, shared with its translated copies
+				const TranslatedQuadrature quadrature = quadrature_cache.polygon(polygon, quadrature_order > 0 ? quadrature_order : AssemblerUtils::quadrature_order(assembler_name, 1, AssemblerUtils::BasisType::POLY, 2));
+				const TranslatedQuadrature mass_quadrature = quadrature_cache.polygon(polygon, mass_quadrature_order > 0 ? mass_quadrature_order : AssemblerUtils::quadrature_order("Mass", 1, AssemblerUtils::BasisType::POLY, 2));
 
-				b.set_quadrature([tmp_quadrature](Quadrature &quad) { quad = tmp_quadrature; });
-				b.set_mass_quadrature([tmp_mass_quadrature](Quadrature &quad) { quad = tmp_mass_quadrature; });
+				b.set_quadrature([quadrature](Quadrature &quad) { quadrature.get(quad); });
+				b.set_mass_quadrature([mass_quadrature](Quadrature &quad) { mass_quadrature.get(quad); });
 
 				const double tol = 1e-10;
-				b.set_bases_func([polygon, tol, bc](const Eigen::MatrixXd &uv, std::vector<AssemblyValues> &val) {
-					Eigen::MatrixXd tmp;
-					val.resize(polygon.rows());
-					for (size_t i = 0; i < polygon.rows(); ++i)
-					{
-						val[i].val.resize(uv.rows(), 1);
-					}
+				const auto data = std::make_shared<const PolygonData>(polygon);
+				const std::shared_ptr<QuadratureTable> table = quadrature_table(tables, quadrature);
+				const std::shared_ptr<QuadratureTable> mass_table = quadrature_table(tables, mass_quadrature);
+				const Eigen::RowVectorXd origin = quadrature.origin;
+				const Eigen::RowVectorXd mass_origin = mass_quadrature.origin;
 
-					for (int i = 0; i < uv.rows(); ++i)
-					{
-						bc(polygon, uv.row(i), tmp, tol);
+				b.set_bases_func([data, tol, bc, table, mass_table, origin, mass_origin](const Eigen::MatrixXd &uv, std::vector<AssemblyValues> &val) {
+					Eigen::MatrixXd tmp;
+					const Eigen::MatrixXd *values = &tmp;
+					if (table->matches(uv, origin))
+						values = &table->values(*data, uv, bc, tol);
+					else if (mass_table->matches(uv, mass_origin))
+						values = &mass_table->values(*data, uv, bc, tol);
+					else
+						bc(*data, uv, tmp, tol);
 
-						for (size_t j = 0; j < tmp.size(); ++j)
-						{
-							val[j].val(i) = tmp(j);
-						}
-					}
+					val.resize(data->vertices.rows());
+					for (size_t j = 0; j < val.size(); ++j)
+						val[j].val = values->col(j);
 				});
-				b.set_grads_func([polygon, tol, bc_prime](const Eigen::MatrixXd &uv, std::vector<AssemblyValues> &val) {
-					Eigen::MatrixXd tmp;
-					val.resize(polygon.rows());
-					for (size_t i = 0; i < polygon.rows(); ++i)
-					{
-						val[i].grad.resize(uv.rows(), 2);
-					}
+				b.set_grads_func([data, tol, bc_prime, table, mass_table, origin, mass_origin](const Eigen::MatrixXd &uv, std::vector<AssemblyValues> &val) {
+					Eigen::MatrixXd tmp_dx, tmp_dy;
+					const Eigen::MatrixXd *dx = &tmp_dx, *dy = &tmp_dy;
+					if (table->matches(uv, origin))
+						table->grads(*data, uv, bc_prime, tol, dx, dy);
+					else if (mass_table->matches(uv, mass_origin))
+						mass_table->grads(*data, uv, bc_prime, tol, dx, dy);
+					else
+						bc_prime(*data, uv, tmp_dx, tmp_dy, tol);
 
-					for (int i = 0; i < uv.rows(); ++i)
+					val.resize(data->vertices.rows());
+					for (size_t j = 0; j < val.size(); ++j)
 					{
-						bc_prime(polygon, uv.row(i), tmp, tol);
-						assert(tmp.rows() == polygon.rows());
-
-						for (size_t j = 0; j < tmp.rows(); ++j)
-						{
-							val[j].grad.row(i) = tmp.row(j);
-						}
+						val[j].grad.resize(uv.rows(), 2);
+						val[j].grad.col(0) = dx->col(j);
+						val[j].grad.col(1) = dy->col(j);
 					}
 				});
 
@@ -5,6 +5,8 @@
 #include <polyfem/mesh/LocalBoundary.hpp>
 
 #include <Eigen/Dense>
+
+#include <functional>
 #include <vector>
 
 namespace polyfem
@@ -14,6 +16,44 @@ namespace polyfem
 		class BarycentricBasis2d
 		{
 		public:
+			/// data of a polygon that does not depend on the evaluation points, shared by all the evaluations
+			struct PolygonData
+			{
+				explicit PolygonData(const Eigen::MatrixXd &polygon);
+
+				/// n x 2 vertices
+				Eigen::MatrixXd vertices;
+				/// row i is the gradient wrt the point p of the signed area det(v_i - p, v_i+1 - p)
+				Eigen::MatrixXd areas_prime;
+				/// det(v_i-1 - v_i, v_i+1 - v_i), twice the area of the corner triangle at v_i
+				Eigen::VectorXd corner_areas;
+			};
+
+			/// quantities of a block of points wrt the vertices of a polygon, one row per point and one column per vertex
+			struct BlockData
+			{
+				BlockData(const PolygonData &polygon, const Eigen::MatrixXd &points, const double tol);
+
+				/// v_i - p
+				Eigen::ArrayXXd sx, sy;
+				/// |v_i - p|
+				Eigen::ArrayXXd radii;
+				/// det(v_i - p, v_i+1 - p)
+				Eigen::ArrayXXd areas;
+				/// (v_i - p) . (v_i+1 - p)
+				Eigen::ArrayXXd products;
+				/// rows of the points on a vertex or an edge, they are evaluated pointwise
+				std::vector<int> boundary_points;
+
+				/// columns of a shifted by offset vertices, e.g., column i of shifted(a, 1) is column i + 1 of a
+				static Eigen::ArrayXXd shifted(const Eigen::ArrayXXd &a, const int offset);
+			};
+
+			/// coordinates at a block of points, one row per point and one column per vertex
+			using BlockFunction = std::function<void(const PolygonData &, const Eigen::MatrixXd &, Eigen::MatrixXd &, const double)>;
+			/// x and y derivatives of the coordinates at a block of points, one row per point and one column per vertex
+			using BlockGradFunction = std::function<void(const PolygonData &, const Eigen::MatrixXd &, Eigen::MatrixXd &, Eigen::MatrixXd &, const double)>;
+
 			static int build_bases(
 				const std::string &assembler_name,
 				const int dim,
@@ -21,8 +61,8 @@ namespace polyfem
 				const int n_bases,
 				const int quadrature_order,
 				const int mass_quadrature_order,
-				const std::function<void(const Eigen::MatrixXd &, const Eigen::RowVector2d &, Eigen::MatrixXd &, const double)> bc,
-				const std::function<void(const Eigen::MatrixXd &, const Eigen::RowVector2d &, Eigen::MatrixXd &, const double)> bc_prime,
+				const BlockFunction bc,
+				const BlockGradFunction bc_prime,
 				std::vector<ElementBases> &bases,
 				std::vector<mesh::LocalBoundary> &local_boundary,
 				std::map<int, Eigen::MatrixXd> &mapped_boundary);
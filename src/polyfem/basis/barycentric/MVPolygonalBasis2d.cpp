@@ -238,6 +238,65 @@ namespace polyfem
 			}
 		}
 
+		void MVPolygonalBasis2d::meanvalue_block(const BarycentricBasis2d::PolygonData &polygon, const Eigen::MatrixXd &points, Eigen::MatrixXd &b, const double tol)
+		{
+			using BlockData = BarycentricBasis2d::BlockData;
+			const BlockData block(polygon, points, tol);
+
+			// tan(alpha_i / 2) of the angle at p between v_i and v_i+1
+			const Eigen::ArrayXXd tangents = block.areas / (block.radii * BlockData::shifted(block.radii, 1) + block.products);
+			const Eigen::ArrayXXd w = (BlockData::shifted(tangents, -1) + tangents) / block.radii;
+			b = (w.colwise() / w.rowwise().sum()).matrix();
+
+			Eigen::MatrixXd tmp;
+			for (const int p : block.boundary_points)
+			{
+				meanvalue(polygon.vertices, points.row(p), tmp, tol);
+				b.row(p) = tmp.transpose();
+			}
+		}
+
+		void MVPolygonalBasis2d::meanvalue_derivative_block(const BarycentricBasis2d::PolygonData &polygon, const Eigen::MatrixXd &points, Eigen::MatrixXd &dx, Eigen::MatrixXd &dy, const double tol)
+		{
+			using BlockData = BarycentricBasis2d::BlockData;
+			const BlockData block(polygon, points, tol);
+			const int n = polygon.vertices.rows();
+
+			const Eigen::ArrayXXd radii1 = BlockData::shifted(block.radii, 1);
+			const Eigen::ArrayXXd denominator = block.radii * radii1 + block.products;
+			const Eigen::ArrayXXd tangents = block.areas / denominator;
+			const Eigen::ArrayXXd tangents_sum = BlockData::shifted(tangents, -1) + tangents;
+			const Eigen::ArrayXXd w = tangents_sum / block.radii;
+			const Eigen::ArrayXd W = w.rowwise().sum();
+
+			// derivatives wrt the coordinate d of the point, s_i = v_i - p
+			const auto derivative = [&](const Eigen::ArrayXXd &s, const Eigen::ArrayXXd &s1, const int d, Eigen::MatrixXd &res) {
+				const Eigen::ArrayXXd radii_prime = -s / block.radii;
+				const Eigen::ArrayXXd products_prime = -s - s1;
+				const Eigen::ArrayXXd denominator_prime = radii_prime * radii1 + block.radii * BlockData::shifted(radii_prime, 1) + products_prime;
+
+				Eigen::ArrayXXd tangents_prime = -block.areas * denominator_prime;
+				for (int i = 0; i < n; ++i)
+					tangents_prime.col(i) += polygon.areas_prime(i, d) * denominator.col(i);
+				tangents_prime /= denominator.square();
+
+				const Eigen::ArrayXXd w_prime = ((BlockData::shifted(tangents_prime, -1) + tangents_prime) * block.radii - tangents_sum * radii_prime) / block.radii.square();
+				const Eigen::ArrayXd W_prime = w_prime.rowwise().sum();
+
+				res = ((w_prime.colwise() * W - w.colwise() * W_prime).colwise() / W.square()).matrix();
+			};
+			derivative(block.sx, BlockData::shifted(block.sx, 1), 0, dx);
+			derivative(block.sy, BlockData::shifted(block.sy, 1), 1, dy);
+
+			Eigen::MatrixXd tmp;
+			for (const int p : block.boundary_points)
+			{
+				meanvalue_derivative(polygon.vertices, points.row(p), tmp, tol);
+				dx.row(p) = tmp.col(0).transpose();
+				dy.row(p) = tmp.col(1).transpose();
+			}
+		}
+
 		int MVPolygonalBasis2d::build_bases(
 			const std::string &assembler_name,
 			const int dim,
@@ -249,7 +308,7 @@ namespace polyfem
 			std::vector<mesh::LocalBoundary> &local_boundary,
 			std::map<int, Eigen::MatrixXd> &mapped_boundary)
 		{
-			return BarycentricBasis2d::build_bases(assembler_name, dim, mesh, n_bases, quadrature_order, mass_quadrature_order, meanvalue, meanvalue_derivative, bases, local_boundary, mapped_boundary);
+			return BarycentricBasis2d::build_bases(assembler_name, dim, mesh, n_bases, quadrature_order, mass_quadrature_order, meanvalue_block, meanvalue_derivative_block, bases, local_boundary, mapped_boundary);
 		}
 
 	} // namespace basis
@@ -183,6 +183,54 @@ namespace polyfem
 			}
 		}
 
+		void WSPolygonalBasis2d::wachspress_block(const BarycentricBasis2d::PolygonData &polygon, const Eigen::MatrixXd &points, Eigen::MatrixXd &b, const double tol)
+		{
+			using BlockData = BarycentricBasis2d::BlockData;
+			const BlockData block(polygon, points, tol);
+
+			const Eigen::ArrayXXd w = (1. / (BlockData::shifted(block.areas, -1) * block.areas)).rowwise() * polygon.corner_areas.transpose().array();
+			b = (w.colwise() / w.rowwise().sum()).matrix();
+
+			Eigen::MatrixXd tmp;
+			for (const int p : block.boundary_points)
+			{
+				wachspress(polygon.vertices, points.row(p), tmp, tol);
+				b.row(p) = tmp.transpose();
+			}
+		}
+
+		void WSPolygonalBasis2d::wachspress_derivative_block(const BarycentricBasis2d::PolygonData &polygon, const Eigen::MatrixXd &points, Eigen::MatrixXd &dx, Eigen::MatrixXd &dy, const double tol)
+		{
+			using BlockData = BarycentricBasis2d::BlockData;
+			const BlockData block(polygon, points, tol);
+
+			const Eigen::ArrayXXd areas0 = BlockData::shifted(block.areas, -1);
+			const Eigen::ArrayXXd w = (1. / (areas0 * block.areas)).rowwise() * polygon.corner_areas.transpose().array();
+			const Eigen::ArrayXd W = w.rowwise().sum();
+
+			// the derivatives of the areas do not depend on the point
+			const auto derivative = [&](const int d, Eigen::MatrixXd &res) {
+				const Eigen::RowVectorXd areas_prime = polygon.areas_prime.col(d).transpose();
+				Eigen::RowVectorXd areas_prime0(areas_prime.size());
+				areas_prime0 << areas_prime.tail(1), areas_prime.head(areas_prime.size() - 1);
+
+				const Eigen::ArrayXXd w_prime = w / (areas0 * block.areas) * ((block.areas.rowwise() * areas_prime0.array()) + (areas0.rowwise() * areas_prime.array()));
+				const Eigen::ArrayXd W_prime = w_prime.rowwise().sum();
+
+				res = ((w.colwise() * W_prime - w_prime.colwise() * W).colwise() / W.square()).matrix();
+			};
+			derivative(0, dx);
+			derivative(1, dy);
+
+			Eigen::MatrixXd tmp;
+			for (const int p : block.boundary_points)
+			{
+				wachspress_derivative(polygon.vertices, points.row(p), tmp, tol);
+				dx.row(p) = tmp.col(0).transpose();
+				dy.row(p) = tmp.col(1).transpose();
+			}
+		}
+
 		int WSPolygonalBasis2d::build_bases(
 			const std::string &assembler_name,
 			const int dim,
@@ -194,7 +242,7 @@ namespace polyfem
 			std::vector<mesh::LocalBoundary> &local_boundary,
 			std::map<int, Eigen::MatrixXd> &mapped_boundary)
 		{
-			return BarycentricBasis2d::build_bases(assembler_name, dim, mesh, n_bases, quadrature_order, mass_quadrature_order, wachspress, wachspress_derivative, bases, local_boundary, mapped_boundary);
+			return BarycentricBasis2d::build_bases(assembler_name, dim, mesh, n_bases, quadrature_order, mass_quadrature_order, wachspress_block, wachspress_derivative_block, bases, local_boundary, mapped_boundary);
 		}
 
 	} // namespace basis
@@ -3,6 +3,7 @@
 #include <polyfem/mesh/mesh2D/Mesh2D.hpp>
 #include <polyfem/basis/ElementBases.hpp>
 #include <polyfem/mesh/LocalBoundary.hpp>
+#include <polyfem/basis/barycentric/BarycentricBasis2d.hpp>
 
 #include <Eigen/Dense>
 #include <vector>
@@ -27,6 +28,16 @@ namespace polyfem
 
 			static void wachspress(const Eigen::MatrixXd &polygon, const Eigen::RowVector2d &point, Eigen::MatrixXd &b, const double tol);
 			static void wachspress_derivative(const Eigen::MatrixXd &polygon, const Eigen::RowVector2d &point, Eigen::MatrixXd &derivatives, const double tol);
+
+			/// @brief Coordinates at a block of points, evaluated on whole columns of points; the points on the
+			/// boundary of the polygon use the pointwise evaluation
+			/// @param[in] polygon precomputed polygon data
+			/// @param[in] points n x 2 points
+			/// @param[out] b n x #vertices coordinates
+			/// @param[in] tol distance to the boundary of the points on it
+			static void wachspress_block(const BarycentricBasis2d::PolygonData &polygon, const Eigen::MatrixXd &points, Eigen::MatrixXd &b, const double tol);
+			/// @brief Derivatives of wachspress_block
+			static void wachspress_derivative_block(const BarycentricBasis2d::PolygonData &polygon, const Eigen::MatrixXd &points, Eigen::MatrixXd &dx, Eigen::MatrixXd &dy, const double tol);
 		};
 	} // namespace basis
 } // namespace polyfem
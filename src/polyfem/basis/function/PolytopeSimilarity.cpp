@@ -0,0 +1,179 @@
+#include "PolytopeSimilarity.hpp"
+
+#include <cassert>
+#include <cmath>
+#include <map>
+
+namespace polyfem
+{
+	namespace basis
+	{
+		namespace
+		{
+			// relative tolerance on the normalized geometry and on the data
+			const double tolerance = 1e-8;
+			// number of points used to bucket the polytopes
+			const int n_signature_points = 8;
+
+			// points centered and scaled to unit root mean square distance to the centroid
+			struct NormalizedPoints
+			{
+				Eigen::RowVectorXd center;
+				double scale;
+				Eigen::MatrixXd points;
+			};
+
+			NormalizedPoints normalize(const Eigen::MatrixXd &pts)
+			{
+				NormalizedPoints res;
+				res.center = pts.colwise().mean();
+				res.points = pts.rowwise() - res.center;
+				res.scale = std::sqrt(res.points.squaredNorm() / std::max<Eigen::Index>(pts.rows(), 1));
+				if (res.scale > 0)
+					res.points /= res.scale;
+				return res;
+			}
+
+			bool is_close(const Eigen::MatrixXd &a, const Eigen::MatrixXd &b)
+			{
+				if (a.rows() != b.rows() || a.cols() != b.cols())
+					return false;
+				if (a.size() == 0)
+					return true;
+				const double ref = std::max(1., a.cwiseAbs().maxCoeff());
+				return (a - b).cwiseAbs().maxCoeff() <= tolerance * ref;
+			}
+
+			// sizes and rotation invariant radii of the first collocation points, polytopes with different keys are never similar
+			std::vector<long> signature(const RBFFitData &d, const NormalizedPoints &n)
+			{
+				std::vector<long> res = {long(d.collocation_points.rows()), long(d.collocation_points.cols()), long(d.centers.rows()),
+										 long(d.rhs.cols()), long(d.local_basis_integral.cols()), long(d.quadrature.weights.size())};
+				for (int i = 0; i < std::min<int>(n_signature_points, n.points.rows()); ++i)
+					res.push_back(std::lround(n.points.row(i).norm() / (100 * tolerance)));
+				return res;
+			}
+
+			// similarity mapping the polytope other onto rep, if any
+			bool find_similarity(const RBFFitData &rep, const NormalizedPoints &rep_n,
+								 const RBFFitData &other, const NormalizedPoints &other_n,
+								 const bool with_constraints, Similarity &sim)
+			{
+				const int dim = rep.collocation_points.cols();
+				if (rep_n.scale <= 0 || other_n.scale <= 0)
+					return false;
+				if (rep.centers.rows() != other.centers.rows() || rep.rhs.cols() != other.rhs.cols()
+					|| rep.quadrature.weights.size() != other.quadrature.weights.size())
+					return false;
+
+				// boundary values do not depend on the frame
+				if (!is_close(rep.rhs, other.rhs))
+					return false;
+
+				// orthogonal matrix q minimizing |rep_n q - other_n| (no need to exclude reflections)
+				const Eigen::MatrixXd m = rep_n.points.transpose() * other_n.points;
+				Eigen::JacobiSVD<Eigen::MatrixXd> svd(m, Eigen::ComputeFullU | Eigen::ComputeFullV);
+				const Eigen::MatrixXd q = svd.matrixU() * svd.matrixV().transpose();
+
+				if (!is_close(rep_n.points * q, other_n.points))
+					return false;
+
+				const auto to_normalized = [](const Eigen::MatrixXd &pts, const NormalizedPoints &n) -> Eigen::MatrixXd {
+					return (pts.rowwise() - n.center) / n.scale;
+				};
+				if (!is_close(to_normalized(rep.centers, rep_n) * q, to_normalized(other.centers, other_n)))
+					return false;
+				if (!is_close(to_normalized(rep.quadrature.points, rep_n) * q, to_normalized(other.quadrature.points, other_n)))
+					return false;
+
+				const double ratio = other_n.scale / rep_n.scale;
+				if (!is_close(rep.quadrature.weights * std::pow(ratio, dim), other.quadrature.weights))
+					return false;
+
+				// the integrals of the gradients rotate with the polytope and scale with its measure over its size
+				if (with_constraints)
+				{
+					if (rep.local_basis_integral.rows() != other.local_basis_integral.rows() || rep.local_basis_integral.cols() < dim || other.local_basis_integral.cols() < dim)
+						return false;
+					if (!is_close(std::pow(ratio, dim - 1) * rep.local_basis_integral.leftCols(dim) * q, other.local_basis_integral.leftCols(dim)))
+						return false;
+				}
+
+				sim.from_center = other_n.center;
+				sim.to_center = rep_n.center;
+				sim.linear = q.transpose() / ratio;
+				return true;
+			}
+		} // namespace
+
+		void Similarity::apply(const Eigen::MatrixXd &x, Eigen::MatrixXd &res) const
+		{
+			res = ((x.rowwise() - from_center) * linear).rowwise() + to_center;
+		}
+
+		void group_similar_polytopes(const std::vector<RBFFitData> &data, const bool with_constraints,
+									 std::vector<int> &representative, std::vector<Similarity> &to_representative)
+		{
+			representative.resize(data.size());
+			to_representative.resize(data.size());
+
+			std::vector<NormalizedPoints> normalized(data.size());
+			std::map<std::vector<long>, std::vector<int>> buckets;
+
+			// serial and in order, so the groups do not depend on the number of threads
+			for (size_t i = 0; i < data.size(); ++i)
+			{
+				normalized[i] = normalize(data[i].collocation_points);
+				representative[i] = i;
+
+				auto &bucket = buckets[signature(data[i], normalized[i])];
+				for (const int r : bucket)
+				{
+					if (find_similarity(data[r], normalized[r], data[i], normalized[i], with_constraints, to_representative[i]))
+					{
+						representative[i] = r;
+						break;
+					}
+				}
+
+				if (representative[i] == int(i))
+				{
+					const int dim = data[i].collocation_points.cols();
+					to_representative[i].from_center.setZero(dim);
+					to_representative[i].to_center.setZero(dim);
+					to_representative[i].linear.setIdentity(dim, dim);
+					bucket.push_back(i);
+				}
+			}
+		}
+
+		MappedRBFWithLinear::MappedRBFWithLinear(const std::shared_ptr<const RBFWithLinear> &rbf, const Similarity &to_rbf)
+			: rbf_(rbf), to_rbf_(to_rbf)
+		{
+			assert(rbf_);
+		}
+
+		void MappedRBFWithLinear::bases_values(const Eigen::MatrixXd &samples, Eigen::MatrixXd &val) const
+		{
+			Eigen::MatrixXd mapped;
+			to_rbf_.apply(samples, mapped);
+			rbf_->bases_values(mapped, val);
+		}
+
+		void MappedRBFWithLinear::bases_grads(const int axis, const Eigen::MatrixXd &samples, Eigen::MatrixXd &val) const
+		{
+			Eigen::MatrixXd mapped, tmp;
+			to_rbf_.apply(samples, mapped);
+
+			// chain rule, the gradient row vector is multiplied by linear^T
+			for (int d = 0; d < to_rbf_.linear.cols(); ++d)
+			{
+				rbf_->bases_grads(d, mapped, tmp);
+				if (d == 0)
+					val = to_rbf_.linear(axis, d) * tmp;
+				else
+					val += to_rbf_.linear(axis, d) * tmp;
+			}
+		}
+	} // namespace basis
+} // namespace polyfem
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "RBFWithLinear.hpp"
+
+#include <polyfem/quadrature/Quadrature.hpp>
+
+#include <Eigen/Dense>
+
+#include <memory>
+#include <vector>
+
+namespace polyfem
+{
+	namespace basis
+	{
+		/// @brief Inputs of the RBF fit of a polytope
+		struct RBFFitData
+		{
+			/// #C x dim kernel centers
+			Eigen::MatrixXd centers;
+			/// #S x dim collocation points
+			Eigen::MatrixXd collocation_points;
+			/// #B x #constraints expected integrals of the bases
+			Eigen::MatrixXd local_basis_integral;
+			/// #S x #B values of the bases at the collocation points
+			Eigen::MatrixXd rhs;
+			/// quadrature inside the polytope
+			quadrature::Quadrature quadrature;
+		};
+
+		/// @brief Similarity x -> to_center + (x - from_center) * linear, linear is a rotation (or reflection) times a scale
+		struct Similarity
+		{
+			Eigen::RowVectorXd from_center;
+			Eigen::RowVectorXd to_center;
+			Eigen::MatrixXd linear;
+
+			void apply(const Eigen::MatrixXd &x, Eigen::MatrixXd &res) const;
+		};
+
+		///
+		/// @brief      Groups the polytopes whose RBFWithLinear fits are the same up to a similarity (rotation, uniform scale and translation).
+		///             Two polytopes are grouped if their collocation points, kernel centers and quadratures are mapped onto each other (in the same order),
+		///             their boundary values are the same and, with constraints, their integrals transform accordingly.
+		///             The harmonic kernels and the linear polynomials span a space invariant under similarities, so the fit of one polytope
+		///             evaluated through the similarity is the fit of the other one.
+		///
+		/// @param[in]  data              fit inputs of the polytopes
+		/// @param[in]  with_constraints  if the fits impose the integral constraints
+		/// @param[out] representative    for every polytope, index of the polytope whose fit is reused (itself if it must be fitted), always a smaller index
+		/// @param[out] to_representative for every polytope, similarity from the polytope to its representative
+		///
+		void group_similar_polytopes(const std::vector<RBFFitData> &data, const bool with_constraints,
+									 std::vector<int> &representative, std::vector<Similarity> &to_representative);
+
+		/// @brief RBFWithLinear fitted on a similar polytope, evaluated through the similarity
+		class MappedRBFWithLinear
+		{
+		public:
+			MappedRBFWithLinear(const std::shared_ptr<const RBFWithLinear> &rbf, const Similarity &to_rbf);
+
+			/// @brief Batch evaluates the bases on a set of sample points, see RBFWithLinear::bases_values
+			void bases_values(const Eigen::MatrixXd &samples, Eigen::MatrixXd &val) const;
+
+			/// @brief Batch evaluates the gradient of the bases wrt axis on a set of sample points, see RBFWithLinear::bases_grads
+			void bases_grads(const int axis, const Eigen::MatrixXd &samples, Eigen::MatrixXd &val) const;
+
+		private:
+			std::shared_ptr<const RBFWithLinear> rbf_;
+			Similarity to_rbf_;
+		};
+	} // namespace basis
+} // namespace polyfem
@@ -0,0 +1,113 @@
+#include "Checkpoint.hpp"
+
+#include <polyfem/utils/Logger.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+namespace polyfem::io
+{
+	namespace
+	{
+		constexpr char MAGIC[8] = {'P', 'F', 'C', 'K', 'P', 'T', '0', '1'};
+
+		inline uint64_t padded_size(const uint64_t size) { return (size + 7) / 8 * 8; }
+	} // namespace
+
+	const Eigen::MatrixXd &Checkpoint::get(const std::string &name) const
+	{
+		const auto it = entries_.find(name);
+		if (it == entries_.end())
+			log_and_throw_error("Checkpoint has no entry {}", name);
+		return it->second;
+	}
+
+	double Checkpoint::get_scalar(const std::string &name) const
+	{
+		const Eigen::MatrixXd &mat = get(name);
+		if (mat.size() != 1)
+			log_and_throw_error("Checkpoint entry {} is not a scalar ({}x{})", name, mat.rows(), mat.cols());
+		return mat(0);
+	}
+
+	bool Checkpoint::write(const std::string &path) const
+	{
+		std::ofstream out(path, std::ios::out | std::ios::binary);
+		if (!out.good())
+		{
+			logger().error("Failed to open file: {}", path);
+			return false;
+		}
+
+		out.write(MAGIC, sizeof(MAGIC));
+		const uint64_t n_entries = entries_.size();
+		out.write(reinterpret_cast<const char *>(&n_entries), sizeof(n_entries));
+
+		const char zeros[8] = {0};
+		for (const auto &[name, mat] : entries_)
+		{
+			const uint64_t name_size = name.size();
+			out.write(reinterpret_cast<const char *>(&name_size), sizeof(name_size));
+			out.write(name.data(), name_size);
+			out.write(zeros, padded_size(name_size) - name_size);
+
+			const int64_t rows = mat.rows(), cols = mat.cols();
+			out.write(reinterpret_cast<const char *>(&rows), sizeof(rows));
+			out.write(reinterpret_cast<const char *>(&cols), sizeof(cols));
+			out.write(reinterpret_cast<const char *>(mat.data()), mat.size() * sizeof(double));
+		}
+
+		return out.good();
+	}
+
+	bool Checkpoint::read(const std::string &path)
+	{
+		entries_.clear();
+
+		std::ifstream in(path, std::ios::in | std::ios::binary);
+		if (!in.good())
+		{
+			logger().error("Failed to open file: {}", path);
+			return false;
+		}
+
+		char magic[sizeof(MAGIC)];
+		in.read(magic, sizeof(magic));
+		if (!in.good() || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+		{
+			logger().error("{} is not a checkpoint file", path);
+			return false;
+		}
+
+		uint64_t n_entries = 0;
+		in.read(reinterpret_cast<char *>(&n_entries), sizeof(n_entries));
+		for (uint64_t i = 0; i < n_entries && in.good(); ++i)
+		{
+			uint64_t name_size = 0;
+			in.read(reinterpret_cast<char *>(&name_size), sizeof(name_size));
+			std::string name(padded_size(name_size), '\0');
+			in.read(name.data(), name.size());
+			name.resize(name_size);
+
+			int64_t rows = 0, cols = 0;
+			in.read(reinterpret_cast<char *>(&rows), sizeof(rows));
+			in.read(reinterpret_cast<char *>(&cols), sizeof(cols));
+			if (!in.good() || rows < 0 || cols < 0)
+				break;
+
+			Eigen::MatrixXd &mat = entries_[name];
+			mat.resize(rows, cols);
+			in.read(reinterpret_cast<char *>(mat.data()), mat.size() * sizeof(double));
+		}
+
+		if (!in.good())
+		{
+			logger().error("Checkpoint file {} is truncated", path);
+			entries_.clear();
+			return false;
+		}
+
+		return true;
+	}
+} // namespace polyfem::io
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <Eigen/Dense>
+
+#include <map>
+#include <string>
+
+namespace polyfem::io
+{
+	/// Named dense matrices (and scalars) saved together in one flat binary file, used to restart
+	/// a simulation with the full solver state (e.g., the whole time integrator history).
+	///
+	/// The file starts with the magic string "PFCKPT01" and the number of entries (uint64), then each
+	/// entry is its name length (uint64), the name zero-padded to a multiple of 8 bytes, the rows and
+	/// columns (int64), and the column-major values (double). All the values are 8-byte aligned so the
+	/// file can be memory mapped.
+	class Checkpoint
+	{
+	public:
+		Checkpoint() {}
+
+		/// @brief Add or replace a matrix.
+		void set(const std::string &name, const Eigen::MatrixXd &mat) { entries_[name] = mat; }
+		/// @brief Add or replace a scalar, stored as a 1x1 matrix.
+		void set(const std::string &name, const double value) { entries_[name] = Eigen::MatrixXd::Constant(1, 1, value); }
+
+		bool has(const std::string &name) const { return entries_.find(name) != entries_.end(); }
+		bool empty() const { return entries_.empty(); }
+		void clear() { entries_.clear(); }
+
+		/// @brief Get a matrix, throws if it is missing.
+		const Eigen::MatrixXd &get(const std::string &name) const;
+		/// @brief Get a scalar, throws if it is missing or not 1x1.
+		double get_scalar(const std::string &name) const;
+
+		/// @brief Write the entries to a file.
+		/// @return true on success
+		bool write(const std::string &path) const;
+		/// @brief Replace the entries with the ones of a file.
+		/// @return true on success
+		bool read(const std::string &path);
+
+	private:
+		std::map<std::string, Eigen::MatrixXd> entries_;
+	};
+} // namespace polyfem::io
@@ -3,10 +3,7 @@
 #include <polyfem/mesh/mesh2D/Mesh2D.hpp>
 #include <polyfem/mesh/mesh3D/Mesh3D.hpp>
 
-#include <polyfem/quadrature/HexQuadrature.hpp>
-#include <polyfem/quadrature/QuadQuadrature.hpp>
-#include <polyfem/quadrature/TetQuadrature.hpp>
-#include <polyfem/quadrature/TriQuadrature.hpp>
+#include <polyfem/quadrature/QuadratureCache.hpp>
 
 #include <polyfem/utils/BoundarySampler.hpp>
 
@@ -14,6 +11,7 @@
 #include <polyfem/autogen/auto_q_bases.hpp>
 
 #include <polyfem/utils/Logger.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
 
 #include <igl/AABB.h>
 #include <igl/per_face_normals.h>
@@ -26,6 +24,138 @@ namespace polyfem::io
 
 	namespace
 	{
+		/// local points of the element e used by interpolate_function
+		/// @return false if the element is skipped
+		bool interpolation_points(
+			const mesh::Mesh &mesh,
+			const Eigen::VectorXi &disc_orders,
+			const std::map<int, Eigen::MatrixXd> &polys,
+			const std::map<int, std::pair<Eigen::MatrixXd, Eigen::MatrixXi>> &polys_3d,
+			const utils::RefElementSampler &sampler,
+			const int e,
+			const bool use_sampler,
+			const bool boundary_only,
+			Eigen::MatrixXd &local_pts)
+		{
+			if (boundary_only && mesh.is_volume() && !mesh.is_boundary_element(e))
+				return false;
+
+			if (use_sampler)
+			{
+				if (mesh.is_simplex(e))
+					local_pts = sampler.simplex_points();
+				else if (mesh.is_cube(e))
+					local_pts = sampler.cube_points();
+				else
+				{
+					Eigen::MatrixXi vis_faces_poly, vis_edges_poly;
+					if (mesh.is_volume())
+						sampler.sample_polyhedron(polys_3d.at(e).first, polys_3d.at(e).second, local_pts, vis_faces_poly, vis_edges_poly);
+					else
+						sampler.sample_polygon(polys.at(e), local_pts, vis_faces_poly, vis_edges_poly);
+				}
+				return true;
+			}
+
+			if (mesh.is_simplex(e))
+			{
+				if (mesh.is_volume())
+					autogen::p_nodes_3d(disc_orders(e), local_pts);
+				else
+					autogen::p_nodes_2d(disc_orders(e), local_pts);
+				return true;
+			}
+			if (mesh.is_cube(e))
+			{
+				if (mesh.is_volume())
+					autogen::q_nodes_3d(disc_orders(e), local_pts);
+				else
+					autogen::q_nodes_2d(disc_orders(e), local_pts);
+				return true;
+			}
+			return false;
+		}
+
+		/// local points of all the elements and first output row of each of them, -1 for the skipped elements
+		/// @return number of output rows
+		int interpolation_points(
+			const mesh::Mesh &mesh,
+			const int n_elements,
+			const Eigen::VectorXi &disc_orders,
+			const std::map<int, Eigen::MatrixXd> &polys,
+			const std::map<int, std::pair<Eigen::MatrixXd, Eigen::MatrixXi>> &polys_3d,
+			const utils::RefElementSampler &sampler,
+			const bool use_sampler,
+			const bool boundary_only,
+			std::vector<Eigen::MatrixXd> &local_pts,
+			std::vector<int> &offsets)
+		{
+			local_pts.resize(n_elements);
+			offsets.assign(n_elements, -1);
+
+			int index = 0;
+			for (int e = 0; e < n_elements; ++e)
+			{
+				if (!interpolation_points(mesh, disc_orders, polys, polys_3d, sampler, e, use_sampler, boundary_only, local_pts[e]))
+					continue;
+				offsets[e] = index;
+				index += local_pts[e].rows();
+			}
+			return index;
+		}
+
+		/// evaluates eval(e, values) on the non-skipped elements in parallel and copies the values at the rows
+		/// of the elements, the names and sizes of the values are the ones of the first element
+		template <typename Eval>
+		void evaluate_named_values(
+			const std::vector<Eigen::MatrixXd> &local_pts,
+			const std::vector<int> &offsets,
+			const int n_points,
+			Eval eval,
+			std::vector<assembler::Assembler::NamedMatrix> &result)
+		{
+			result.clear();
+
+			const auto first = std::find_if(offsets.begin(), offsets.end(), [](const int o) { return o >= 0; });
+			if (first == offsets.end())
+				return;
+
+			std::vector<assembler::Assembler::NamedMatrix> tmp;
+			eval(int(first - offsets.begin()), tmp);
+			result.resize(tmp.size());
+			for (int k = 0; k < tmp.size(); ++k)
+			{
+				result[k].first = tmp[k].first;
+				result[k].second.resize(n_points, tmp[k].second.cols());
+			}
+
+			// each element writes its own rows, no need to lock
+			auto storage = utils::create_thread_storage(std::vector<assembler::Assembler::NamedMatrix>());
+			utils::maybe_parallel_for(offsets.size(), [&](int start, int end, int thread_id) {
+				std::vector<assembler::Assembler::NamedMatrix> &local_vals = utils::get_local_thread_storage(storage, thread_id);
+
+				for (int e = start; e < end; ++e)
+				{
+					if (offsets[e] < 0)
+						continue;
+
+					eval(e, local_vals);
+					assert(local_vals.size() == result.size());
+					for (int k = 0; k < local_vals.size(); ++k)
+					{
+						assert(local_pts[e].rows() == local_vals[k].second.rows());
+						result[k].second.block(offsets[e], 0, local_vals[k].second.rows(), local_vals[k].second.cols()) = local_vals[k].second;
+					}
+				}
+			});
+		}
+
+		/// key of the points of interpolation_points in a StressField
+		std::string interpolation_points_key(const bool use_sampler, const bool boundary_only)
+		{
+			return std::string(use_sampler ? "sampler" : "nodes") + (boundary_only ? "_boundary" : "");
+		}
+
 		void flattened_tensor_coeffs(const Eigen::MatrixXd &S, Eigen::MatrixXd &X)
 		{
 			if (S.cols() == 4)
@@ -570,7 +700,8 @@ namespace polyfem::io
 		std::vector<assembler::Assembler::NamedMatrix> &result_scalar,
 		std::vector<assembler::Assembler::NamedMatrix> &result_tensor,
 		const bool use_sampler,
-		const bool boundary_only)
+		const bool boundary_only,
+		StressField *field)
 	{
 		result_scalar.clear();
 		result_tensor.clear();
@@ -589,49 +720,54 @@ namespace polyfem::io
 		assert(!is_problem_scalar);
 		const int actual_dim = mesh.dimension();
 
+		// values at the nodes of the elements, polygons are not supported
+		std::vector<Eigen::MatrixXd> local_pts;
+		std::vector<int> offsets;
+		interpolation_points(mesh, bases.size(), disc_orders, polys, polys_3d, sampler, false, false, local_pts, offsets);
+
+		std::vector<std::vector<assembler::Assembler::NamedMatrix>> element_vals(bases.size());
+		std::vector<double> element_areas(bases.size(), 0);
+
+		std::shared_ptr<const StressField::Values> values;
+		if (field != nullptr)
+			values = field->get(interpolation_points_key(false, false), assembler, bases, gbases, local_pts, fun, false);
+
+		auto storage = utils::create_thread_storage(ElementAssemblyValues());
+		utils::maybe_parallel_for(bases.size(), [&](int start, int end, int thread_id) {
+			ElementAssemblyValues &vals = utils::get_local_thread_storage(storage, thread_id);
+
+			for (int i = start; i < end; ++i)
+			{
+				if (offsets[i] < 0)
+					continue;
+
+				vals.compute(i, actual_dim == 3, bases[i], gbases[i]);
+				const quadrature::Quadrature &quadrature = vals.quadrature;
+				element_areas[i] = (vals.det.array() * quadrature.weights.array()).sum();
+
+				if (values)
+					element_vals[i] = values->scalar[i];
+				else
+					assembler.compute_scalar_value(i, bases[i], gbases[i], local_pts[i], fun, element_vals[i]);
+			}
+		});
+
+		// accumulated in element order so that the result does not depend on the threads
 		std::vector<Eigen::MatrixXd> avg_scalar;
 
 		Eigen::MatrixXd areas(n_bases, 1);
 		areas.setZero();
 
 		std::vector<std::pair<std::string, Eigen::MatrixXd>> tmp_s;
-		Eigen::MatrixXd local_val;
 
-		ElementAssemblyValues vals;
 		for (int i = 0; i < int(bases.size()); ++i)
 		{
-			const ElementBases &bs = bases[i];
-			const ElementBases &gbs = gbases[i];
-			Eigen::MatrixXd local_pts;
-
-			if (mesh.is_simplex(i))
-			{
-				if (mesh.dimension() == 3)
-					autogen::p_nodes_3d(disc_orders(i), local_pts);
-				else
-					autogen::p_nodes_2d(disc_orders(i), local_pts);
-			}
-			else if (mesh.is_cube(i))
-			{
-				if (mesh.dimension() == 3)
-					autogen::q_nodes_3d(disc_orders(i), local_pts);
-				else
-					autogen::q_nodes_2d(disc_orders(i), local_pts);
-			}
-			else
-			{
-				// not supported for polys
+			if (offsets[i] < 0)
 				continue;
-			}
-
-			vals.compute(i, actual_dim == 3, bases[i], gbases[i]);
-			const quadrature::Quadrature &quadrature = vals.quadrature;
-			const double area = (vals.det.array() * quadrature.weights.array()).sum();
 
-			assembler.compute_scalar_value(i, bs, gbs, local_pts, fun, tmp_s);
-
-			// assembler.compute_tensor_value(i, bs, gbs, local_pts, fun, local_val);
-			// MatrixXd avg_tensor(n_points * actual_dim*actual_dim, 1);
+			const ElementBases &bs = bases[i];
+			const double area = element_areas[i];
+			tmp_s = std::move(element_vals[i]);
 
 			for (size_t j = 0; j < bs.bases.size(); ++j)
 			{
@@ -655,7 +791,7 @@ namespace polyfem::io
 
 			for (int k = 0; k < tmp_s.size(); ++k)
 			{
-				local_val = tmp_s[k].second;
+				const Eigen::MatrixXd &local_val = tmp_s[k].second;
 
 				for (size_t j = 0; j < bs.bases.size(); ++j)
 				{
@@ -777,7 +913,8 @@ namespace polyfem::io
 		const assembler::Assembler &assembler,
 		const Eigen::MatrixXd &fun,
 		Eigen::MatrixXd &result,
-		Eigen::VectorXd &von_mises)
+		Eigen::VectorXd &von_mises,
+		StressField *field)
 	{
 		// if (!mesh)
 		// {
@@ -798,70 +935,44 @@ namespace polyfem::io
 		const int actual_dim = mesh.dimension();
 		assert(!is_problem_scalar);
 
-		Eigen::MatrixXd local_val, local_stress, local_mises;
-
+		// quadrature points of every element, polytopes are skipped
+		std::vector<Eigen::MatrixXd> local_pts(mesh.n_elements());
+		std::vector<int> offsets(mesh.n_elements(), -1);
 		int num_quadr_pts = 0;
-		result.resize(disc_orders.sum(), actual_dim == 2 ? 3 : 6);
-		result.setZero();
-		von_mises.resize(disc_orders.sum(), 1);
-		von_mises.setZero();
 		for (int e = 0; e < mesh.n_elements(); ++e)
 		{
-			// Compute quadrature points for element
-			quadrature::Quadrature quadr;
+			quadrature::QuadratureCache::Shape shape;
 			if (mesh.is_simplex(e))
-			{
-				if (mesh.is_volume())
-				{
-					quadrature::TetQuadrature f;
-					f.get_quadrature(disc_orders(e), quadr);
-				}
-				else
-				{
-					quadrature::TriQuadrature f;
-					f.get_quadrature(disc_orders(e), quadr);
-				}
-			}
+				shape = mesh.is_volume() ? quadrature::QuadratureCache::Shape::TETRAHEDRON : quadrature::QuadratureCache::Shape::TRIANGLE;
 			else if (mesh.is_cube(e))
-			{
-				if (mesh.is_volume())
-				{
-					quadrature::HexQuadrature f;
-					f.get_quadrature(disc_orders(e), quadr);
-				}
-				else
-				{
-					quadrature::QuadQuadrature f;
-					f.get_quadrature(disc_orders(e), quadr);
-				}
-			}
+				shape = mesh.is_volume() ? quadrature::QuadratureCache::Shape::HEXAHEDRON : quadrature::QuadratureCache::Shape::QUAD;
 			else
-			{
 				continue;
-			}
 
-			std::vector<std::pair<std::string, Eigen::MatrixXd>> tmp_s, tmp_t;
-
-			assembler.compute_scalar_value(e, bases[e], gbases[e], quadr.points, fun, tmp_s);
-			assembler.compute_tensor_value(e, bases[e], gbases[e], quadr.points, fun, tmp_t);
+			local_pts[e] = quadrature::QuadratureCache::get(shape, disc_orders(e)).points;
+			offsets[e] = num_quadr_pts;
+			num_quadr_pts += local_pts[e].rows();
+		}
 
-			local_mises = tmp_s[0].second;
-			local_val = tmp_t[0].second;
+		// the stresses and von Mises stresses of all the elements are computed in one sweep
+		StressField local_field;
+		const auto values = (field != nullptr ? field : &local_field)->get("disc_orders_quadrature", assembler, bases, gbases, local_pts, fun, true);
 
-			if (num_quadr_pts + local_val.rows() >= result.rows())
+		result.resize(num_quadr_pts, actual_dim == 2 ? 3 : 6);
+		von_mises.resize(num_quadr_pts, 1);
+		utils::maybe_parallel_for(mesh.n_elements(), [&](int start, int end, int thread_id) {
+			Eigen::MatrixXd local_stress;
+			for (int e = start; e < end; ++e)
 			{
-				result.conservativeResize(
-					std::max(num_quadr_pts + local_val.rows() + 1, 2 * result.rows()),
-					result.cols());
-				von_mises.conservativeResize(result.rows(), von_mises.cols());
+				if (offsets[e] < 0)
+					continue;
+
+				const Eigen::MatrixXd &local_mises = values->scalar[e][0].second;
+				flattened_tensor_coeffs(values->tensor[e][0].second, local_stress);
+				result.block(offsets[e], 0, local_stress.rows(), local_stress.cols()) = local_stress;
+				von_mises.segment(offsets[e], local_mises.rows()) = local_mises;
 			}
-			flattened_tensor_coeffs(local_val, local_stress);
-			result.block(num_quadr_pts, 0, local_stress.rows(), local_stress.cols()) = local_stress;
-			von_mises.block(num_quadr_pts, 0, local_mises.rows(), local_mises.cols()) = local_mises;
-			num_quadr_pts += local_val.rows();
-		}
-		result.conservativeResize(num_quadr_pts, result.cols());
-		von_mises.conservativeResize(num_quadr_pts, von_mises.cols());
+		});
 	}
 
 	void Evaluator::interpolate_function(
@@ -906,74 +1017,106 @@ namespace polyfem::io
 			return;
 		}
 
-		std::vector<AssemblyValues> tmp;
+		std::vector<Eigen::MatrixXd> local_pts;
+		std::vector<int> offsets;
+		interpolation_points(mesh, basis.size(), disc_orders, polys, polys_3d, sampler, use_sampler, boundary_only, local_pts, offsets);
 
 		result.resize(n_points, actual_dim);
 
-		int index = 0;
+		auto storage = utils::create_thread_storage(std::vector<AssemblyValues>());
+		utils::maybe_parallel_for(basis.size(), [&](int start, int end, int thread_id) {
+			std::vector<AssemblyValues> &tmp = utils::get_local_thread_storage(storage, thread_id);
 
-		Eigen::MatrixXi vis_faces_poly, vis_edges_poly;
+			for (int i = start; i < end; ++i)
+			{
+				if (offsets[i] < 0)
+					continue;
 
-		for (int i = 0; i < int(basis.size()); ++i)
+				const ElementBases &bs = basis[i];
+
+				Eigen::MatrixXd local_res = Eigen::MatrixXd::Zero(local_pts[i].rows(), actual_dim);
+				bs.evaluate_bases(local_pts[i], tmp);
+				for (size_t j = 0; j < bs.bases.size(); ++j)
+				{
+					const Basis &b = bs.bases[j];
+
+					for (int d = 0; d < actual_dim; ++d)
+					{
+						for (size_t ii = 0; ii < b.global().size(); ++ii)
+							local_res.col(d) += b.global()[ii].val * tmp[j].val * fun(b.global()[ii].index * actual_dim + d);
+					}
+				}
+
+				result.block(offsets[i], 0, local_res.rows(), actual_dim) = local_res;
+			}
+		});
+	}
+
+	void Evaluator::interpolation_operator(
+		const mesh::Mesh &mesh,
+		const std::vector<basis::ElementBases> &bases,
+		const Eigen::VectorXi &disc_orders,
+		const std::map<int, Eigen::MatrixXd> &polys,
+		const std::map<int, std::pair<Eigen::MatrixXd, Eigen::MatrixXi>> &polys_3d,
+		const utils::RefElementSampler &sampler,
+		const int n_points,
+		const int n_nodes,
+		const bool use_sampler,
+		const bool boundary_only,
+		Eigen::SparseMatrix<double, Eigen::RowMajor> &op)
+	{
+		std::vector<Eigen::Triplet<double>> entries;
+		std::vector<AssemblyValues> tmp;
+
+		int index = 0;
+		for (int i = 0; i < int(bases.size()); ++i)
 		{
-			const ElementBases &bs = basis[i];
+			const ElementBases &bs = bases[i];
 			Eigen::MatrixXd local_pts;
 
-			if (boundary_only && mesh.is_volume() && !mesh.is_boundary_element(i))
+			if (!interpolation_points(mesh, disc_orders, polys, polys_3d, sampler, i, use_sampler, boundary_only, local_pts))
 				continue;
 
-			if (use_sampler)
-			{
-				if (mesh.is_simplex(i))
-					local_pts = sampler.simplex_points();
-				else if (mesh.is_cube(i))
-					local_pts = sampler.cube_points();
-				else
-				{
-					if (mesh.is_volume())
-						sampler.sample_polyhedron(polys_3d.at(i).first, polys_3d.at(i).second, local_pts, vis_faces_poly, vis_edges_poly);
-					else
-						sampler.sample_polygon(polys.at(i), local_pts, vis_faces_poly, vis_edges_poly);
-				}
-			}
-			else
+			bs.evaluate_bases(local_pts, tmp);
+			for (size_t j = 0; j < bs.bases.size(); ++j)
 			{
-				if (mesh.is_volume())
-				{
-					if (mesh.is_simplex(i))
-						autogen::p_nodes_3d(disc_orders(i), local_pts);
-					else if (mesh.is_cube(i))
-						autogen::q_nodes_3d(disc_orders(i), local_pts);
-					else
-						continue;
-				}
-				else
+				for (const auto &g : bs.bases[j].global())
 				{
-					if (mesh.is_simplex(i))
-						autogen::p_nodes_2d(disc_orders(i), local_pts);
-					else if (mesh.is_cube(i))
-						autogen::q_nodes_2d(disc_orders(i), local_pts);
-					else
-						continue;
+					assert(g.index < n_nodes);
+					for (int k = 0; k < local_pts.rows(); ++k)
+						entries.emplace_back(index + k, g.index, g.val * tmp[j].val(k));
 				}
 			}
+			index += local_pts.rows();
+		}
+		assert(index <= n_points);
 
-			Eigen::MatrixXd local_res = Eigen::MatrixXd::Zero(local_pts.rows(), actual_dim);
-			bs.evaluate_bases(local_pts, tmp);
-			for (size_t j = 0; j < bs.bases.size(); ++j)
-			{
-				const Basis &b = bs.bases[j];
+		op.resize(n_points, n_nodes);
+		op.setFromTriplets(entries.begin(), entries.end());
+		op.makeCompressed();
+	}
+
+	void Evaluator::apply_interpolation(
+		const Eigen::SparseMatrix<double, Eigen::RowMajor> &op,
+		const int actual_dim,
+		const Eigen::MatrixXd &fun,
+		Eigen::MatrixXd &result)
+	{
+		assert(fun.size() >= op.cols() * actual_dim);
+		result.resize(op.rows(), actual_dim);
 
+		utils::maybe_parallel_for(op.rows(), [&](int start, int end, int thread_id) {
+			for (int i = start; i < end; ++i)
+			{
 				for (int d = 0; d < actual_dim; ++d)
 				{
-					for (size_t ii = 0; ii < b.global().size(); ++ii)
-						local_res.col(d) += b.global()[ii].val * tmp[j].val * fun(b.global()[ii].index * actual_dim + d);
+					double val = 0;
+					for (Eigen::SparseMatrix<double, Eigen::RowMajor>::InnerIterator it(op, i); it; ++it)
+						val += it.value() * fun(it.col() * actual_dim + d);
+					result(i, d) = val;
 				}
 			}
-
-			result.block(index, 0, local_res.rows(), actual_dim) = local_res;
-			index += local_res.rows();
-		}
+		});
 	}
 
 	void Evaluator::interpolate_at_local_vals(
@@ -1138,7 +1281,8 @@ namespace polyfem::io
 		const Eigen::MatrixXd &fun,
 		std::vector<assembler::Assembler::NamedMatrix> &result,
 		const bool use_sampler,
-		const bool boundary_only)
+		const bool boundary_only,
+		StressField *field)
 	{
 		if (fun.size() <= 0)
 		{
@@ -1146,79 +1290,28 @@ namespace polyfem::io
 			return;
 		}
 
-		result.clear();
-
 		assert(!is_problem_scalar);
 
-		int index = 0;
-
-		Eigen::MatrixXi vis_faces_poly, vis_edges_poly;
-		std::vector<std::pair<std::string, Eigen::MatrixXd>> tmp_s;
+		std::vector<Eigen::MatrixXd> local_pts;
+		std::vector<int> offsets;
+		interpolation_points(mesh, bases.size(), disc_orders, polys, polys_3d, sampler, use_sampler, boundary_only, local_pts, offsets);
 
-		for (int i = 0; i < int(bases.size()); ++i)
+		if (field != nullptr)
 		{
-			if (boundary_only && mesh.is_volume() && !mesh.is_boundary_element(i))
-				continue;
-
-			const ElementBases &bs = bases[i];
-			const ElementBases &gbs = gbases[i];
-			Eigen::MatrixXd local_pts;
-
-			if (use_sampler)
-			{
-				if (mesh.is_simplex(i))
-					local_pts = sampler.simplex_points();
-				else if (mesh.is_cube(i))
-					local_pts = sampler.cube_points();
-				else
-				{
-					if (mesh.is_volume())
-						sampler.sample_polyhedron(polys_3d.at(i).first, polys_3d.at(i).second, local_pts, vis_faces_poly, vis_edges_poly);
-					else
-						sampler.sample_polygon(polys.at(i), local_pts, vis_faces_poly, vis_edges_poly);
-				}
-			}
-			else
-			{
-				if (mesh.is_volume())
-				{
-					if (mesh.is_simplex(i))
-						autogen::p_nodes_3d(disc_orders(i), local_pts);
-					else if (mesh.is_cube(i))
-						autogen::q_nodes_3d(disc_orders(i), local_pts);
-					else
-						continue;
-				}
-				else
-				{
-					if (mesh.is_simplex(i))
-						autogen::p_nodes_2d(disc_orders(i), local_pts);
-					else if (mesh.is_cube(i))
-						autogen::q_nodes_2d(disc_orders(i), local_pts);
-					else
-						continue;
-				}
-			}
-
-			assembler.compute_scalar_value(i, bs, gbs, local_pts, fun, tmp_s);
-
-			if (result.empty())
-			{
-				result.resize(tmp_s.size());
-				for (int k = 0; k < tmp_s.size(); ++k)
-				{
-					result[k].first = tmp_s[k].first;
-					result[k].second.resize(n_points, 1);
-				}
-			}
-
-			for (int k = 0; k < tmp_s.size(); ++k)
-			{
-				assert(local_pts.rows() == tmp_s[k].second.rows());
-				result[k].second.block(index, 0, tmp_s[k].second.rows(), 1) = tmp_s[k].second;
-			}
-			index += local_pts.rows();
+			const auto values = field->get(interpolation_points_key(use_sampler, boundary_only), assembler, bases, gbases, local_pts, fun, false);
+			evaluate_named_values(
+				local_pts, offsets, n_points,
+				[&](const int e, std::vector<assembler::Assembler::NamedMatrix> &vals) { vals = values->scalar[e]; },
+				result);
+			return;
 		}
+
+		evaluate_named_values(
+			local_pts, offsets, n_points,
+			[&](const int e, std::vector<assembler::Assembler::NamedMatrix> &vals) {
+				assembler.compute_scalar_value(e, bases[e], gbases[e], local_pts[e], fun, vals);
+			},
+			result);
 	}
 
 	void Evaluator::compute_tensor_value(
@@ -1235,7 +1328,8 @@ namespace polyfem::io
 		const Eigen::MatrixXd &fun,
 		std::vector<assembler::Assembler::NamedMatrix> &result,
 		const bool use_sampler,
-		const bool boundary_only)
+		const bool boundary_only,
+		StressField *field)
 	{
 		if (fun.size() <= 0)
 		{
@@ -1243,79 +1337,27 @@ namespace polyfem::io
 			return;
 		}
 
-		result.clear();
-
-		const int actual_dim = mesh.dimension();
 		assert(!is_problem_scalar);
 
-		int index = 0;
+		std::vector<Eigen::MatrixXd> local_pts;
+		std::vector<int> offsets;
+		interpolation_points(mesh, bases.size(), disc_orders, polys, polys_3d, sampler, use_sampler, boundary_only, local_pts, offsets);
 
-		Eigen::MatrixXi vis_faces_poly, vis_edges_poly;
-		std::vector<std::pair<std::string, Eigen::MatrixXd>> tmp_t;
-
-		for (int i = 0; i < int(bases.size()); ++i)
+		if (field != nullptr)
 		{
-			if (boundary_only && mesh.is_volume() && !mesh.is_boundary_element(i))
-				continue;
-
-			const ElementBases &bs = bases[i];
-			const ElementBases &gbs = gbases[i];
-			Eigen::MatrixXd local_pts;
-
-			if (use_sampler)
-			{
-				if (mesh.is_simplex(i))
-					local_pts = sampler.simplex_points();
-				else if (mesh.is_cube(i))
-					local_pts = sampler.cube_points();
-				else
-				{
-					if (mesh.is_volume())
-						sampler.sample_polyhedron(polys_3d.at(i).first, polys_3d.at(i).second, local_pts, vis_faces_poly, vis_edges_poly);
-					else
-						sampler.sample_polygon(polys.at(i), local_pts, vis_faces_poly, vis_edges_poly);
-				}
-			}
-			else
-			{
-				if (mesh.is_volume())
-				{
-					if (mesh.is_simplex(i))
-						autogen::p_nodes_3d(disc_orders(i), local_pts);
-					else if (mesh.is_cube(i))
-						autogen::q_nodes_3d(disc_orders(i), local_pts);
-					else
-						continue;
-				}
-				else
-				{
-					if (mesh.is_simplex(i))
-						autogen::p_nodes_2d(disc_orders(i), local_pts);
-					else if (mesh.is_cube(i))
-						autogen::q_nodes_2d(disc_orders(i), local_pts);
-					else
-						continue;
-				}
-			}
-
-			assembler.compute_tensor_value(i, bs, gbs, local_pts, fun, tmp_t);
-
-			if (result.empty())
-			{
-				result.resize(tmp_t.size());
-				for (int k = 0; k < tmp_t.size(); ++k)
-				{
-					result[k].first = tmp_t[k].first;
-					result[k].second.resize(n_points, actual_dim * actual_dim);
-				}
-			}
-
-			for (int k = 0; k < tmp_t.size(); ++k)
-			{
-				assert(local_pts.rows() == tmp_t[k].second.rows());
-				result[k].second.block(index, 0, tmp_t[k].second.rows(), tmp_t[k].second.cols()) = tmp_t[k].second;
-			}
-			index += local_pts.rows();
+			const auto values = field->get(interpolation_points_key(use_sampler, boundary_only), assembler, bases, gbases, local_pts, fun, true);
+			evaluate_named_values(
+				local_pts, offsets, n_points,
+				[&](const int e, std::vector<assembler::Assembler::NamedMatrix> &vals) { vals = values->tensor[e]; },
+				result);
+			return;
 		}
+
+		evaluate_named_values(
+			local_pts, offsets, n_points,
+			[&](const int e, std::vector<assembler::Assembler::NamedMatrix> &vals) {
+				assembler.compute_tensor_value(e, bases[e], gbases[e], local_pts[e], fun, vals);
+			},
+			result);
 	}
 } // namespace polyfem::io
@@ -1,11 +1,13 @@
 #pragma once
 
 #include <Eigen/Core>
+#include <Eigen/Sparse>
 
 #include <polyfem/basis/ElementBases.hpp>
 #include <polyfem/assembler/Assembler.hpp>
 #include <polyfem/mesh/Mesh.hpp>
 
+#include <polyfem/io/StressField.hpp>
 #include <polyfem/utils/RefElementSampler.hpp>
 
 namespace polyfem::io
@@ -41,6 +43,7 @@ namespace polyfem::io
 		/// @param[in] fun function to use
 		/// @param[out] result output displacement
 		/// @param[out] von_mises output von mises
+		/// @param[in] field values of the step shared with the other outputs, nullptr to compute them
 		static void compute_stress_at_quadrature_points(
 			const mesh::Mesh &mesh,
 			const bool is_problem_scalar,
@@ -50,7 +53,8 @@ namespace polyfem::io
 			const assembler::Assembler &assembler,
 			const Eigen::MatrixXd &fun,
 			Eigen::MatrixXd &result,
-			Eigen::VectorXd &von_mises);
+			Eigen::VectorXd &von_mises,
+			StressField *field = nullptr);
 
 		/// interpolate the function fun.
 		/// @param[in] mesh mesh
@@ -106,6 +110,43 @@ namespace polyfem::io
 			const bool use_sampler,
 			const bool boundary_only);
 
+		/// sparse operator interpolating the nodal functions at the points of interpolate_function,
+		/// it only depends on the discretization and is applied to each function with apply_interpolation
+		/// @param[in] mesh mesh
+		/// @param[in] bases bases
+		/// @param[in] disc_orders discretization orders
+		/// @param[in] polys polygons
+		/// @param[in] polys_3d polyhedra
+		/// @param[in] sampler sampler for the local element
+		/// @param[in] n_points is the number of rows of the output
+		/// @param[in] n_nodes is the number of columns of the output (number of bases)
+		/// @param[in] use_sampler uses the sampler or not
+		/// @param[in] boundary_only interpolates only at boundary elements
+		/// @param[out] op interpolation operator, row i holds the weights of the nodes at the point i
+		static void interpolation_operator(
+			const mesh::Mesh &mesh,
+			const std::vector<basis::ElementBases> &bases,
+			const Eigen::VectorXi &disc_orders,
+			const std::map<int, Eigen::MatrixXd> &polys,
+			const std::map<int, std::pair<Eigen::MatrixXd, Eigen::MatrixXi>> &polys_3d,
+			const utils::RefElementSampler &sampler,
+			const int n_points,
+			const int n_nodes,
+			const bool use_sampler,
+			const bool boundary_only,
+			Eigen::SparseMatrix<double, Eigen::RowMajor> &op);
+
+		/// applies an operator of interpolation_operator to fun, in parallel over the points
+		/// @param[in] op interpolation operator
+		/// @param[in] actual_dim is the size of the problem (e.g., 1 for Laplace, dim for elasticity)
+		/// @param[in] fun nodal function with actual_dim interleaved components
+		/// @param[out] result interpolated function, one row per point
+		static void apply_interpolation(
+			const Eigen::SparseMatrix<double, Eigen::RowMajor> &op,
+			const int actual_dim,
+			const Eigen::MatrixXd &fun,
+			Eigen::MatrixXd &result);
+
 		/// interpolate solution and gradient at element (calls interpolate_at_local_vals with sol)
 		/// @param[in] mesh mesh
 		/// @param[in] is_problem_scalar if problem is scalar
@@ -192,6 +233,7 @@ namespace polyfem::io
 		/// @param[out] result scalar value
 		/// @param[in] use_sampler uses the sampler or not
 		/// @param[in] boundary_only interpolates only at boundary elements
+		/// @param[in] field values of the step shared with the other outputs, nullptr to compute them
 		static void compute_scalar_value(
 			const mesh::Mesh &mesh,
 			const bool is_problem_scalar,
@@ -206,7 +248,8 @@ namespace polyfem::io
 			const Eigen::MatrixXd &fun,
 			std::vector<assembler::Assembler::NamedMatrix> &result,
 			const bool use_sampler,
-			const bool boundary_only);
+			const bool boundary_only,
+			StressField *field = nullptr);
 
 		/// computes scalar quantity of funtion (ie von mises for elasticity and norm of velocity for fluid)
 		/// the scalar value is averaged around every node to make it continuos
@@ -226,6 +269,7 @@ namespace polyfem::io
 		/// @param[out] result_tensor tensor value
 		/// @param[in] use_sampler uses the sampler or not
 		/// @param[in] boundary_only interpolates only at boundary elements
+		/// @param[in] field values of the step shared with the other outputs, nullptr to compute them
 		static void average_grad_based_function(
 			const mesh::Mesh &mesh,
 			const bool is_problem_scalar,
@@ -242,7 +286,8 @@ namespace polyfem::io
 			std::vector<assembler::Assembler::NamedMatrix> &result_scalar,
 			std::vector<assembler::Assembler::NamedMatrix> &result_tensor,
 			const bool use_sampler,
-			const bool boundary_only);
+			const bool boundary_only,
+			StressField *field = nullptr);
 
 		/// compute tensor quantity (ie stress tensor or velocy)
 		/// @param[in] mesh mesh
@@ -259,6 +304,7 @@ namespace polyfem::io
 		/// @param[out] result resulting tensor
 		/// @param[in] use_sampler uses the sampler or not
 		/// @param[in] boundary_only interpolates only at boundary elements
+		/// @param[in] field values of the step shared with the other outputs, nullptr to compute them
 		static void compute_tensor_value(
 			const mesh::Mesh &mesh,
 			const bool is_problem_scalar,
@@ -273,7 +319,8 @@ namespace polyfem::io
 			const Eigen::MatrixXd &fun,
 			std::vector<assembler::Assembler::NamedMatrix> &result,
 			const bool use_sampler,
-			const bool boundary_only);
+			const bool boundary_only,
+			StressField *field = nullptr);
 
 		/// computes integrated solution (fun) per surface face. pts and faces are the boundary are the boundary on the rest configuration
 		/// @param[in] mesh mesh
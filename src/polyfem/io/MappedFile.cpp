@@ -0,0 +1,59 @@
+#include "MappedFile.hpp"
+
+#if defined(_WIN32)
+#include <fstream>
+#include <sstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace polyfem::io
+{
+	MappedFile::MappedFile(const std::string &path)
+	{
+#if defined(_WIN32)
+		std::ifstream file(path, std::ios::binary);
+		if (!file.good())
+			return;
+		std::stringstream buffer;
+		buffer << file.rdbuf();
+		buffer_ = buffer.str();
+		data_ = buffer_.data();
+		size_ = buffer_.size();
+		ok_ = true;
+#else
+		const int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return;
+		struct stat st;
+		if (fstat(fd, &st) == 0)
+		{
+			size_ = st.st_size;
+			if (size_ == 0)
+				ok_ = true;
+			else
+			{
+				void *data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (data != MAP_FAILED)
+				{
+					madvise(data, size_, MADV_SEQUENTIAL);
+					data_ = static_cast<const char *>(data);
+					ok_ = true;
+				}
+			}
+		}
+		close(fd);
+#endif
+	}
+
+	MappedFile::~MappedFile()
+	{
+#if !defined(_WIN32)
+		if (data_ != nullptr)
+			munmap(const_cast<char *>(data_), size_);
+#endif
+	}
+} // namespace polyfem::io
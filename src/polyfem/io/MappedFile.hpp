@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace polyfem::io
+{
+	/// Read-only view of a whole file, memory mapped when the platform allows it (read in a buffer otherwise)
+	class MappedFile
+	{
+	public:
+		explicit MappedFile(const std::string &path);
+		~MappedFile();
+
+		MappedFile(const MappedFile &) = delete;
+		MappedFile &operator=(const MappedFile &) = delete;
+
+		bool ok() const { return ok_; }
+		const char *data() const { return data_; }
+		size_t size() const { return size_; }
+
+	private:
+		const char *data_ = nullptr;
+		size_t size_ = 0;
+		bool ok_ = false;
+#if defined(_WIN32)
+		std::string buffer_;
+#endif
+	};
+} // namespace polyfem::io
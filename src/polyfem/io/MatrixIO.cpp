@@ -1,9 +1,18 @@
 #include "MatrixIO.hpp"
 
+#include <polyfem/io/MappedFile.hpp>
 #include <polyfem/utils/Logger.hpp>
 
 #include <igl/list_to_matrix.h>
 
+#include <highfive/H5File.hpp>
+
+#include <unsupported/Eigen/SparseExtra>
+
+#include <zlib.h>
+
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iomanip> // setprecision
 #include <vector>
@@ -11,18 +20,230 @@
 
 namespace polyfem::io
 {
+	namespace
+	{
+		constexpr char binary_magic[4] = {'P', 'F', 'M', 'X'};
+		constexpr uint32_t binary_version = 1;
+		/// compression level of the ".binz" files
+		constexpr int binz_compression_level = 6;
+
+		enum BinaryFlags : uint32_t
+		{
+			SPARSE_CSR = 1,
+			COMPRESSED = 2
+		};
+
+		struct BinaryHeader
+		{
+			char magic[4];
+			uint32_t version;
+			uint32_t scalar; ///< see scalar_code
+			uint32_t flags;  ///< BinaryFlags
+			int64_t rows;
+			int64_t cols;
+			int64_t nnz;           ///< number of stored values
+			uint64_t payload_size; ///< size in bytes of the payload after the header, compressed or not
+		};
+		static_assert(sizeof(BinaryHeader) == 48, "the values after the header must be aligned");
+
+		template <typename T>
+		uint32_t scalar_code();
+		template <>
+		uint32_t scalar_code<double>() { return 0; }
+		template <>
+		uint32_t scalar_code<float>() { return 1; }
+		template <>
+		uint32_t scalar_code<int>() { return 2; }
+
+		size_t scalar_size(const uint32_t code)
+		{
+			switch (code)
+			{
+			case 0:
+				return sizeof(double);
+			case 1:
+				return sizeof(float);
+			case 2:
+				return sizeof(int);
+			default:
+				return 0;
+			}
+		}
+
+		std::string lower_extension(const std::string &path)
+		{
+			std::string extension = std::filesystem::path(path).extension().string();
+			std::transform(extension.begin(), extension.end(), extension.begin(),
+						   [](unsigned char c) { return std::tolower(c); });
+			return extension;
+		}
+
+		/// Writes the header and the payload made of the blocks, deflated if compression_level > 0
+		bool write_binary(const std::string &path, BinaryHeader header, const std::vector<std::pair<const char *, size_t>> &blocks, const int compression_level)
+		{
+			std::memcpy(header.magic, binary_magic, sizeof(binary_magic));
+			header.version = binary_version;
+
+			size_t size = 0;
+			for (const auto &[data, n] : blocks)
+				size += n;
+
+			std::vector<Bytef> compressed;
+			if (compression_level > 0)
+			{
+				std::vector<Bytef> payload(size);
+				size_t offset = 0;
+				for (const auto &[data, n] : blocks)
+				{
+					if (n > 0)
+						std::memcpy(payload.data() + offset, data, n);
+					offset += n;
+				}
+
+				uLongf compressed_size = compressBound(size);
+				compressed.resize(compressed_size);
+				if (compress2(compressed.data(), &compressed_size, payload.data(), size, std::min(compression_level, 9)) != Z_OK)
+				{
+					logger().error("Failed to compress matrix {}", path);
+					return false;
+				}
+				compressed.resize(compressed_size);
+				header.flags |= COMPRESSED;
+				header.payload_size = compressed_size;
+			}
+			else
+				header.payload_size = size;
+
+			std::ofstream out(path, std::ios::out | std::ios::binary);
+			if (!out.good())
+			{
+				logger().error("Failed to write to file: {}", path);
+				return false;
+			}
+
+			out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+			if (compression_level > 0)
+				out.write(reinterpret_cast<const char *>(compressed.data()), compressed.size());
+			else
+			{
+				for (const auto &[data, n] : blocks)
+					out.write(data, n);
+			}
+
+			return out.good();
+		}
+
+		/// Payload of a binary file with header, mapped or decompressed
+		class BinaryPayload
+		{
+		public:
+			explicit BinaryPayload(const std::string &path) : file_(path) {}
+
+			/// false if the file does not start with the magic of the format
+			bool has_header() const
+			{
+				return file_.ok() && file_.size() >= sizeof(BinaryHeader) && std::memcmp(file_.data(), binary_magic, sizeof(binary_magic)) == 0;
+			}
+
+			/// @param[in] expected_size size in bytes of the uncompressed payload, computed from the header
+			bool read(const std::string &path, const size_t expected_size)
+			{
+				if (header().version != binary_version)
+				{
+					logger().error("Unsupported binary matrix version {} in {}", header().version, path);
+					return false;
+				}
+				if (sizeof(BinaryHeader) + header().payload_size > file_.size())
+				{
+					logger().error("Truncated binary matrix {}", path);
+					return false;
+				}
+
+				const char *payload = file_.data() + sizeof(BinaryHeader);
+				if (header().flags & COMPRESSED)
+				{
+					buffer_.resize(expected_size);
+					uLongf size = expected_size;
+					if (uncompress(reinterpret_cast<Bytef *>(buffer_.data()), &size, reinterpret_cast<const Bytef *>(payload), header().payload_size) != Z_OK || size != expected_size)
+					{
+						logger().error("Failed to decompress binary matrix {}", path);
+						return false;
+					}
+					data_ = buffer_.data();
+				}
+				else
+				{
+					if (header().payload_size != expected_size)
+					{
+						logger().error("Invalid payload size in binary matrix {}", path);
+						return false;
+					}
+					data_ = payload;
+				}
+
+				return true;
+			}
+
+			const MappedFile &file() const { return file_; }
+			BinaryHeader header() const
+			{
+				BinaryHeader h;
+				std::memcpy(&h, file_.data(), sizeof(h));
+				return h;
+			}
+			const char *data() const { return data_; }
+
+		private:
+			const MappedFile file_;
+			std::vector<char> buffer_;
+			const char *data_ = nullptr;
+		};
+
+		/// Copies n values of the type of code at data to out
+		template <typename T>
+		void copy_values(const uint32_t code, const char *data, const size_t n, T *out)
+		{
+			const auto copy = [&](auto tag) {
+				using S = decltype(tag);
+				if constexpr (std::is_same_v<S, T>)
+					std::memcpy(out, data, n * sizeof(T));
+				else
+				{
+					std::vector<S> tmp(n);
+					std::memcpy(tmp.data(), data, n * sizeof(S));
+					for (size_t i = 0; i < n; ++i)
+						out[i] = T(tmp[i]);
+				}
+			};
+
+			switch (code)
+			{
+			case 0:
+				copy(double());
+				break;
+			case 1:
+				copy(float());
+				break;
+			case 2:
+				copy(int());
+				break;
+			}
+		}
+	} // namespace
 	template <typename T>
 	bool read_matrix(const std::string &path, Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> &mat)
 	{
-		std::string extension = std::filesystem::path(path).extension().string();
-		std::transform(extension.begin(), extension.end(), extension.begin(),
-					   [](unsigned char c) { return std::tolower(c); });
+		std::string hdf5_file, dataset;
+		if (split_hdf5_dataset_path(path, hdf5_file, dataset))
+			return read_matrix_hdf5(hdf5_file, dataset, mat);
+
+		const std::string extension = lower_extension(path);
 
 		if (extension == ".txt")
 		{
 			return read_matrix_ascii(path, mat);
 		}
-		else if (extension == ".bin")
+		else if (is_binary_matrix_path(path) || BinaryPayload(path).has_header())
 		{
 			return read_matrix_binary(path, mat);
 		}
@@ -38,9 +259,7 @@ namespace polyfem::io
 	template <typename Mat>
 	bool write_matrix(const std::string &path, const Mat &mat)
 	{
-		std::string extension = std::filesystem::path(path).extension().string();
-		std::transform(extension.begin(), extension.end(), extension.begin(),
-					   [](unsigned char c) { return std::tolower(c); });
+		const std::string extension = lower_extension(path);
 
 		if (extension == ".txt")
 		{
@@ -50,6 +269,10 @@ namespace polyfem::io
 		{
 			return write_matrix_binary(path, mat);
 		}
+		else if (extension == ".binz")
+		{
+			return write_matrix_binary(path, mat, binz_compression_level);
+		}
 		else
 		{
 			logger().warn("Uknown output matrix format (\"{}\"). Using ASCII format.");
@@ -123,46 +346,216 @@ namespace polyfem::io
 	{
 		typedef typename Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>::Index Index;
 
-		std::ifstream in(path, std::ios::in | std::ios::binary);
-		if (!in.good())
+		BinaryPayload payload(path);
+		const MappedFile &file = payload.file();
+		if (!file.ok())
 		{
 			logger().error("Failed to open file: {}", path);
-			in.close();
-
 			return false;
 		}
 
-		Index rows = 0, cols = 0;
-		in.read((char *)(&rows), sizeof(Index));
-		in.read((char *)(&cols), sizeof(Index));
+		if (!payload.has_header())
+		{
+			// format without header: rows, cols, values
+			Index rows = 0, cols = 0;
+			if (file.size() < 2 * sizeof(Index))
+			{
+				logger().error("Invalid binary matrix {}", path);
+				return false;
+			}
+			std::memcpy(&rows, file.data(), sizeof(Index));
+			std::memcpy(&cols, file.data() + sizeof(Index), sizeof(Index));
+			if (rows < 0 || cols < 0 || file.size() != 2 * sizeof(Index) + size_t(rows) * size_t(cols) * sizeof(T))
+			{
+				logger().error("Invalid binary matrix {}", path);
+				return false;
+			}
+
+			mat.resize(rows, cols);
+			std::memcpy(mat.data(), file.data() + 2 * sizeof(Index), mat.size() * sizeof(T));
+			return true;
+		}
+
+		const BinaryHeader header = payload.header();
+		if (header.flags & SPARSE_CSR)
+		{
+			logger().error("Binary matrix {} is sparse", path);
+			return false;
+		}
+		const size_t value_size = scalar_size(header.scalar);
+		if (value_size == 0 || header.rows < 0 || header.cols < 0 || header.nnz != header.rows * header.cols)
+		{
+			logger().error("Invalid binary matrix {}", path);
+			return false;
+		}
+		if (!payload.read(path, header.nnz * value_size))
+			return false;
 
-		mat.resize(rows, cols);
-		in.read((char *)mat.data(), rows * cols * sizeof(T));
-		in.close();
+		mat.resize(header.rows, header.cols);
+		copy_values(header.scalar, payload.data(), header.nnz, mat.data());
 
 		return true;
 	}
 
 	template <typename Mat>
-	bool write_matrix_binary(const std::string &path, const Mat &mat)
+	bool write_matrix_binary(const std::string &path, const Mat &mat, const int compression_level)
 	{
-		typedef typename Mat::Index Index;
 		typedef typename Mat::Scalar Scalar;
-		std::ofstream out(path, std::ios::out | std::ios::binary);
 
-		if (!out.good())
+		BinaryHeader header;
+		header.scalar = scalar_code<Scalar>();
+		header.flags = 0;
+		header.rows = mat.rows();
+		header.cols = mat.cols();
+		header.nnz = mat.size();
+
+		return write_binary(path, header, {{reinterpret_cast<const char *>(mat.data()), mat.size() * sizeof(Scalar)}}, compression_level);
+	}
+
+	bool read_sparse_matrix_binary(const std::string &path, StiffnessMatrix &mat)
+	{
+		BinaryPayload payload(path);
+		if (!payload.file().ok())
 		{
-			logger().error("Failed to write to file: {}", path);
-			out.close();
+			logger().error("Failed to open file: {}", path);
+			return false;
+		}
+		if (!payload.has_header() || !(payload.header().flags & SPARSE_CSR))
+		{
+			logger().error("{} is not a binary sparse matrix", path);
+			return false;
+		}
 
+		const BinaryHeader header = payload.header();
+		const size_t value_size = scalar_size(header.scalar);
+		if (value_size == 0 || header.rows < 0 || header.cols < 0 || header.nnz < 0)
+		{
+			logger().error("Invalid binary matrix {}", path);
 			return false;
 		}
+		if (!payload.read(path, (header.rows + 1 + header.nnz) * sizeof(int64_t) + header.nnz * value_size))
+			return false;
 
-		const Index rows = mat.rows(), cols = mat.cols();
-		out.write((const char *)(&rows), sizeof(Index));
-		out.write((const char *)(&cols), sizeof(Index));
-		out.write((const char *)mat.data(), rows * cols * sizeof(Scalar));
-		out.close();
+		std::vector<int64_t> outer(header.rows + 1), inner(header.nnz);
+		std::memcpy(outer.data(), payload.data(), outer.size() * sizeof(int64_t));
+		std::memcpy(inner.data(), payload.data() + outer.size() * sizeof(int64_t), inner.size() * sizeof(int64_t));
+		if (outer.front() != 0 || outer.back() != header.nnz)
+		{
+			logger().error("Invalid row offsets in binary matrix {}", path);
+			return false;
+		}
+
+		Eigen::SparseMatrix<double, Eigen::RowMajor> csr(header.rows, header.cols);
+		csr.resizeNonZeros(header.nnz);
+		for (size_t i = 0; i < outer.size(); ++i)
+			csr.outerIndexPtr()[i] = outer[i];
+		for (size_t i = 0; i < inner.size(); ++i)
+		{
+			if (inner[i] < 0 || inner[i] >= header.cols)
+			{
+				logger().error("Invalid column index in binary matrix {}", path);
+				return false;
+			}
+			csr.innerIndexPtr()[i] = inner[i];
+		}
+		copy_values(header.scalar, payload.data() + (outer.size() + inner.size()) * sizeof(int64_t), header.nnz, csr.valuePtr());
+
+		mat = csr;
+		return true;
+	}
+
+	bool write_sparse_matrix_binary(const std::string &path, const StiffnessMatrix &mat, const int compression_level)
+	{
+		Eigen::SparseMatrix<double, Eigen::RowMajor> csr = mat;
+		csr.makeCompressed();
+
+		std::vector<int64_t> outer(csr.outerIndexPtr(), csr.outerIndexPtr() + csr.rows() + 1);
+		std::vector<int64_t> inner(csr.innerIndexPtr(), csr.innerIndexPtr() + csr.nonZeros());
+
+		BinaryHeader header;
+		header.scalar = scalar_code<double>();
+		header.flags = SPARSE_CSR;
+		header.rows = csr.rows();
+		header.cols = csr.cols();
+		header.nnz = csr.nonZeros();
+
+		return write_binary(
+			path, header,
+			{{reinterpret_cast<const char *>(outer.data()), outer.size() * sizeof(int64_t)},
+			 {reinterpret_cast<const char *>(inner.data()), inner.size() * sizeof(int64_t)},
+			 {reinterpret_cast<const char *>(csr.valuePtr()), csr.nonZeros() * sizeof(double)}},
+			compression_level);
+	}
+
+	bool write_sparse_matrix(const std::string &path, const StiffnessMatrix &mat)
+	{
+		const std::string extension = lower_extension(path);
+		if (extension == ".bin")
+			return write_sparse_matrix_binary(path, mat);
+		else if (extension == ".binz")
+			return write_sparse_matrix_binary(path, mat, binz_compression_level);
+		else if (extension == ".csv")
+			return write_sparse_matrix_csv(path, mat);
+		else
+			return Eigen::saveMarket(mat, path);
+	}
+
+	bool is_binary_matrix_path(const std::string &path)
+	{
+		const std::string extension = lower_extension(path);
+		return extension == ".bin" || extension == ".binz";
+	}
+
+	bool split_hdf5_dataset_path(const std::string &path, std::string &file, std::string &dataset)
+	{
+		std::string lower = path;
+		std::transform(lower.begin(), lower.end(), lower.begin(),
+					   [](unsigned char c) { return std::tolower(c); });
+
+		for (const std::string extension : {".hdf5:", ".h5:"})
+		{
+			const size_t pos = lower.rfind(extension);
+			if (pos == std::string::npos || pos + extension.size() == path.size())
+				continue;
+
+			file = path.substr(0, pos + extension.size() - 1);
+			dataset = path.substr(pos + extension.size());
+			return true;
+		}
+
+		return false;
+	}
+
+	template <typename T>
+	bool read_matrix_hdf5(const std::string &file, const std::string &dataset, Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> &mat)
+	{
+		try
+		{
+			const HighFive::File h5(file, HighFive::File::ReadOnly);
+			if (!h5.exist(dataset))
+			{
+				logger().error("Missing dataset {} in {}", dataset, file);
+				return false;
+			}
+
+			const HighFive::DataSet data = h5.getDataSet(dataset);
+			const std::vector<size_t> dims = data.getDimensions();
+			if (dims.empty() || dims.size() > 2)
+			{
+				logger().error("Dataset {} in {} is not a matrix", dataset, file);
+				return false;
+			}
+
+			// HDF5 stores the rows contiguously, it converts the type and decompresses the chunks while reading
+			Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> tmp(dims[0], dims.size() == 2 ? dims[1] : 1);
+			data.read(tmp.data());
+			mat = tmp;
+		}
+		catch (const HighFive::Exception &e)
+		{
+			logger().error("Failed to read dataset {} in {}: {}", dataset, file, e.what());
+			return false;
+		}
 
 		return true;
 	}
@@ -241,10 +634,14 @@ namespace polyfem::io
 	template bool read_matrix_binary<int>(const std::string &, Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic> &);
 	template bool read_matrix_binary<double>(const std::string &, Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> &);
 
-	template bool write_matrix_binary<Eigen::MatrixXd>(const std::string &, const Eigen::MatrixXd &);
-	template bool write_matrix_binary<Eigen::MatrixXf>(const std::string &, const Eigen::MatrixXf &);
-	template bool write_matrix_binary<Eigen::VectorXd>(const std::string &, const Eigen::VectorXd &);
-	template bool write_matrix_binary<Eigen::VectorXf>(const std::string &, const Eigen::VectorXf &);
+	template bool write_matrix_binary<Eigen::MatrixXd>(const std::string &, const Eigen::MatrixXd &, const int);
+	template bool write_matrix_binary<Eigen::MatrixXf>(const std::string &, const Eigen::MatrixXf &, const int);
+	template bool write_matrix_binary<Eigen::VectorXd>(const std::string &, const Eigen::VectorXd &, const int);
+	template bool write_matrix_binary<Eigen::VectorXf>(const std::string &, const Eigen::VectorXf &, const int);
+	template bool write_matrix_binary<Eigen::MatrixXi>(const std::string &, const Eigen::MatrixXi &, const int);
+
+	template bool read_matrix_hdf5<int>(const std::string &, const std::string &, Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic> &);
+	template bool read_matrix_hdf5<double>(const std::string &, const std::string &, Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> &);
 
 	template bool import_matrix<int>(const std::string &path, const json &import, Eigen::MatrixXi &mat);
 	template bool import_matrix<double>(const std::string &path, const json &import, Eigen::MatrixXd &mat);
@@ -9,10 +9,12 @@
 namespace polyfem::io
 {
 	/// Reads a matrix from a file. Determines the file format based on the path's extension.
+	/// A path "file.hdf5:/group/dataset" (or .h5) reads the dataset of the HDF5 file.
 	template <typename T>
 	bool read_matrix(const std::string &path, Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> &mat);
 
-	/// Writes a matrix to a file. Determines the file format based on the path's extension.
+	/// Writes a matrix to a file. Determines the file format based on the path's extension,
+	/// ".binz" is the binary format with a compressed payload.
 	template <typename Mat>
 	bool write_matrix(const std::string &path, const Mat &mat);
 
@@ -22,11 +24,36 @@ namespace polyfem::io
 	template <typename Mat>
 	bool write_matrix_ascii(const std::string &path, const Mat &mat);
 
+	/// Binary files start with a header (magic "PFMX", version, scalar type, storage, sizes) followed by the values
+	/// in column major order for dense matrices, or by the CSR arrays (row offsets, column indices, values) for sparse
+	/// ones. The payload is optionally deflated. The files are memory mapped and the values copied without parsing.
+	/// Files without header (rows, cols, values) are still read.
 	template <typename T>
 	bool read_matrix_binary(const std::string &path, Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> &mat);
 
+	/// @param[in] compression_level zlib level of the payload in [0, 9], 0 for no compression
 	template <typename Mat>
-	bool write_matrix_binary(const std::string &path, const Mat &mat);
+	bool write_matrix_binary(const std::string &path, const Mat &mat, const int compression_level = 0);
+
+	/// Reads a sparse matrix written by write_sparse_matrix_binary
+	bool read_sparse_matrix_binary(const std::string &path, StiffnessMatrix &mat);
+
+	/// Writes a sparse matrix in the binary CSR format of write_matrix_binary
+	bool write_sparse_matrix_binary(const std::string &path, const StiffnessMatrix &mat, const int compression_level = 0);
+
+	/// Writes a sparse matrix, the format is given by the extension: binary for ".bin" (".binz" compressed),
+	/// CSV for ".csv" and Matrix Market otherwise.
+	bool write_sparse_matrix(const std::string &path, const StiffnessMatrix &mat);
+
+	/// The path has the extension of the binary formats (".bin" or ".binz")
+	bool is_binary_matrix_path(const std::string &path);
+
+	/// Splits a path "file.hdf5:/group/dataset" (or .h5) into the HDF5 file and the dataset, false for other paths
+	bool split_hdf5_dataset_path(const std::string &path, std::string &file, std::string &dataset);
+
+	/// Reads a 1D or 2D dataset of an HDF5 file, a 1D dataset is a column. Only this dataset is read from the file.
+	template <typename T>
+	bool read_matrix_hdf5(const std::string &file, const std::string &dataset, Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> &mat);
 
 	bool write_sparse_matrix_csv(const std::string &path, const Eigen::SparseMatrix<double> &mat);
 
@@ -2,9 +2,11 @@
 
 #include <polyfem/utils/Logger.hpp>
 #include <polyfem/utils/StringUtils.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
 
 #include <mshio/mshio.h>
 
+#include <algorithm>
 #include <fstream>
 #include <string>
 #include <iostream>
@@ -14,6 +16,39 @@
 
 namespace polyfem::io
 {
+	namespace
+	{
+		/// @brief Number of vertices of the linear cell of an element type, -1 if it is not a supported volume or surface element.
+		int cell_vertices_count(const int type)
+		{
+			if (type == 2 || type == 9 || type == 21 || type == 23 || type == 25) // tri
+				return 3;
+			if (type == 3 || type == 10) // quad
+				return 4;
+			if (type == 4 || type == 11 || type == 29 || type == 30 || type == 31) // tet
+				return 4;
+			if (type == 5 || type == 12) // hex
+				return 8;
+			return -1;
+		}
+
+		/// @brief Calls body(block, index in block, global index) in parallel for all the items of consecutive blocks.
+		/// @param offsets index of the first item of each block, followed by the total number of items
+		template <typename Body>
+		void for_each_block_item(const std::vector<int> &offsets, const Body &body)
+		{
+			utils::maybe_parallel_for(offsets.back(), [&](int start, int end, int thread_id) {
+				int b = std::upper_bound(offsets.begin(), offsets.end(), start) - offsets.begin() - 1;
+				for (int k = start; k < end; ++k)
+				{
+					while (k >= offsets[b + 1])
+						++b;
+					body(b, k - offsets[b], k);
+				}
+			});
+		}
+	} // namespace
+
 	template <typename Entity>
 	void map_entity_tag_to_physical_tag(const std::vector<Entity> &entities, std::unordered_map<int, int> &entity_tag_to_physical_tag)
 	{
@@ -68,57 +103,41 @@ namespace polyfem::io
 		if (n_vertices != max_tag)
 			logger().warn("MSH file contains more node tags than nodes, condensing nodes which will break input node ordering.");
 
-		int index = 0;
+		std::vector<int> node_offsets(1, 0);
 		for (const auto &n : nodes.entity_blocks)
-		{
-			for (int i = 0; i < n.num_nodes_in_block * 3; i += 3)
-			{
-				const int node_id = n_vertices != max_tag ? (index++) : (n.tags[i / 3] - 1);
+			node_offsets.push_back(node_offsets.back() + n.num_nodes_in_block);
+		assert(node_offsets.back() == n_vertices);
 
-				if (dim == 2)
-					vertices.row(node_id) << n.data[i], n.data[i + 1];
-				if (dim == 3)
-					vertices.row(node_id) << n.data[i], n.data[i + 1], n.data[i + 2];
+		for_each_block_item(node_offsets, [&](const int b, const int i, const int index) {
+			const auto &n = nodes.entity_blocks[b];
+			const int node_id = n_vertices != max_tag ? index : (n.tags[i] - 1);
 
-				assert(n.tags[i / 3] < tag_to_index.size());
-				tag_to_index[n.tags[i / 3]] = node_id;
-			}
-		}
+			for (int d = 0; d < dim; ++d)
+				vertices(node_id, d) = n.data[3 * i + d];
 
+			assert(n.tags[i] < tag_to_index.size());
+			tag_to_index[n.tags[i]] = node_id;
+		});
+
+		using ElementBlock = std::decay_t<decltype(els.entity_blocks)>::value_type;
+		std::vector<const ElementBlock *> cell_blocks;
+		std::vector<int> cell_offsets(1, 0);
 		int cells_cols = -1;
-		int num_els = 0;
 		for (const auto &e : els.entity_blocks)
 		{
 			if (e.entity_dim != dim)
 				continue;
-			const int type = e.element_type;
+			const int n_cell_vertices = cell_vertices_count(e.element_type);
+			if (n_cell_vertices < 0)
+				continue;
 
-			if (type == 2 || type == 9 || type == 21 || type == 23 || type == 25) // tri
-			{
-				assert(cells_cols == -1 || cells_cols == 3);
-				cells_cols = 3;
-				num_els += e.num_elements_in_block;
-			}
-			else if (type == 3 || type == 10) // quad
-			{
-				assert(cells_cols == -1 || cells_cols == 4);
-				cells_cols = 4;
-				num_els += e.num_elements_in_block;
-			}
-			else if (type == 4 || type == 11 || type == 29 || type == 30 || type == 31) // tet
-			{
-				assert(cells_cols == -1 || cells_cols == 4);
-				cells_cols = 4;
-				num_els += e.num_elements_in_block;
-			}
-			else if (type == 5 || type == 12) // hex
-			{
-				assert(cells_cols == -1 || cells_cols == 8);
-				cells_cols = 8;
-				num_els += e.num_elements_in_block;
-			}
+			assert(cells_cols == -1 || cells_cols == n_cell_vertices);
+			cells_cols = n_cell_vertices;
+			cell_blocks.push_back(&e);
+			cell_offsets.push_back(cell_offsets.back() + e.num_elements_in_block);
 		}
 		assert(cells_cols > 0);
+		const int num_els = cell_offsets.back();
 
 		std::unordered_map<int, int> entity_tag_to_physical_tag;
 		if (dim == 2)
@@ -130,40 +149,29 @@ namespace polyfem::io
 		body_ids.resize(num_els);
 		elements.resize(num_els);
 		weights.resize(num_els);
-		int cell_index = 0;
-		for (const auto &e : els.entity_blocks)
-		{
-			if (e.entity_dim != dim)
-				continue;
-			const int type = e.element_type;
-			if (type == 2 || type == 9 || type == 21 || type == 23 || type == 25 || type == 3 || type == 10 || type == 4 || type == 11 || type == 29 || type == 30 || type == 31 || type == 5 || type == 12)
+
+		for_each_block_item(cell_offsets, [&](const int b, const int i, const int cell_index) {
+			const auto &e = *cell_blocks[b];
+			const size_t n_nodes = mshio::nodes_per_element(e.element_type);
+			// element tag followed by the node tags
+			const auto *data = e.data.data() + i * (n_nodes + 1) + 1;
+
+			auto &element = elements[cell_index];
+			element.resize(n_nodes);
+			for (int j = 0; j < n_nodes; ++j)
 			{
-				const size_t n_nodes = mshio::nodes_per_element(type);
-				for (int i = 0; i < e.data.size(); i += (n_nodes + 1))
-				{
-					int index = 0;
-					for (int j = i + 1; j <= i + cells_cols; ++j)
-					{
-						const int v_index = tag_to_index[e.data[j]];
-						assert(v_index < n_vertices);
-						cells(cell_index, index++) = v_index;
-					}
-
-					for (int j = i + 1; j < i + 1 + n_nodes; ++j)
-					{
-						const int v_index = tag_to_index[e.data[j]];
-						assert(v_index < n_vertices);
-						elements[cell_index].push_back(v_index);
-					}
-
-					const auto &it = entity_tag_to_physical_tag.find(e.entity_tag);
-					body_ids[cell_index] =
-						it != entity_tag_to_physical_tag.end() ? it->second : 0;
-
-					++cell_index;
-				}
+				const int v_index = tag_to_index[data[j]];
+				assert(v_index >= 0 && v_index < n_vertices);
+				element[j] = v_index;
 			}
-		}
+
+			for (int j = 0; j < cells_cols; ++j)
+				cells(cell_index, j) = element[j];
+
+			const auto &it = entity_tag_to_physical_tag.find(e.entity_tag);
+			body_ids[cell_index] =
+				it != entity_tag_to_physical_tag.end() ? it->second : 0;
+		});
 
 		// std::ifstream infile(path.c_str());
 
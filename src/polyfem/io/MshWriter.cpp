@@ -1,7 +1,11 @@
 #include "MshWriter.hpp"
 
+#include <polyfem/utils/MaybeParallelFor.hpp>
+
 #include <mshio/mshio.h>
 
+#include <map>
+
 namespace polyfem::io
 {
 	void MshWriter::write(
@@ -11,7 +15,7 @@ namespace polyfem::io
 	{
 		Eigen::MatrixXd points(mesh.n_vertices(), mesh.dimension());
 		for (int i = 0; i < mesh.n_vertices(); ++i)
-			points.col(i) = mesh.point(i);
+			points.row(i) = mesh.point(i);
 
 		std::vector<std::vector<int>> cells(mesh.n_elements());
 		for (int i = 0; i < mesh.n_elements(); ++i)
@@ -70,37 +74,64 @@ namespace polyfem::io
 			block.parametric = 0;                     // 0: non-parametric, 1: parametric.
 			block.num_nodes_in_block = points.rows(); // The number of nodes in block.
 
-			for (int i = 0; i < points.rows(); ++i)
-			{
-				block.tags.push_back(i + 1); // A std::vector of unique, positive node tags.
-				const auto p = points.row(i);
-				block.data.push_back(p(0));
-				block.data.push_back(p(1)); // A std::vector of coordinates (x,y,z,<u>,<points>,<w>,...)
-				block.data.push_back(is_volume ? p(2) : 0);
-			}
+			block.tags.resize(points.rows());    // A std::vector of unique, positive node tags.
+			block.data.resize(3 * points.rows()); // A std::vector of coordinates (x,y,z,<u>,<points>,<w>,...)
+			utils::maybe_parallel_for(points.rows(), [&](int start, int end, int thread_id) {
+				for (int i = start; i < end; ++i)
+				{
+					block.tags[i] = i + 1;
+					for (int d = 0; d < 3; ++d)
+						block.data[3 * i + d] = d < points.cols() ? points(i, d) : 0;
+				}
+			});
+		}
+
+		// one block per element type, the elements keep their order inside a block
+		std::map<int, std::vector<int>> type_to_cells;
+		for (int i = 0; i < cells.size(); ++i)
+		{
+			const int n_local_v = cells[i].size();
+			// only simplices, quads and hexes for the moment
+			assert(n_local_v == 3 || n_local_v == 4 || n_local_v == 8);
+
+			int type;
+			if (n_local_v == 3)
+				type = 2; // tri
+			else if (n_local_v == 4)
+				type = is_volume ? 4 : 3; // tet or quad
+			else
+				type = 5; // hex
+			type_to_cells[type].push_back(i);
 		}
 
 		auto &elements = out.elements;
-		elements.num_entity_blocks = cells.size(); // Number of element blocks.
-		elements.num_elements = cells.size();      // Total number of elmeents.
+		elements.num_entity_blocks = type_to_cells.size(); // Number of element blocks.
+		elements.num_elements = cells.size();              // Total number of elmeents.
 		elements.min_element_tag = 1;
 		elements.max_element_tag = cells.size();
-		elements.entity_blocks.resize(cells.size()); // A std::vector of element blocks.
+		elements.entity_blocks.resize(type_to_cells.size()); // A std::vector of element blocks.
 
-		for (int i = 0; i < cells.size(); ++i)
+		int block_id = 0;
+		for (const auto &[type, ids] : type_to_cells)
 		{
-			auto &block = elements.entity_blocks[i];
-			block.entity_dim = points.cols(); // The dimension of the elements.
-			block.entity_tag = 1;             // The entity these elements belongs to.
-			const int n_local_v = cells[i].size();
-			// only tet and tri for the moment
-			assert(n_local_v == 3 || n_local_v == 4);
-
-			block.element_type = n_local_v == 3 ? 2 : 4; // See element type table below.
-			block.num_elements_in_block = 1;             // The number of elements in this block.
-			block.data.push_back(i + 1);
-			for (int j = 0; j < n_local_v; ++j)
-				block.data.push_back(cells[i][j] + 1); // See more detail below.
+			auto &block = elements.entity_blocks[block_id++];
+			block.entity_dim = points.cols();         // The dimension of the elements.
+			block.entity_tag = 1;                     // The entity these elements belongs to.
+			block.element_type = type;                // See element type table below.
+			block.num_elements_in_block = ids.size(); // The number of elements in this block.
+
+			// element tag followed by the node tags
+			const int n_local_v = mshio::nodes_per_element(type);
+			block.data.resize(ids.size() * (n_local_v + 1));
+			utils::maybe_parallel_for(ids.size(), [&](int start, int end, int thread_id) {
+				for (int k = start; k < end; ++k)
+				{
+					auto *data = block.data.data() + k * (n_local_v + 1);
+					data[0] = ids[k] + 1;
+					for (int j = 0; j < n_local_v; ++j)
+						data[j + 1] = cells[ids[k]][j] + 1;
+				}
+			});
 
 			// block.entity_tag = body_ids.empty() ? 0 : body_ids[i];
 		}
@@ -9,14 +9,21 @@
 
 #include "OBJReader.hpp"
 
+#include <algorithm>
+#include <charconv>
 #include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iterator>
+#include <sstream>
+#include <string_view>
 
 #include <igl/edges.h>
 #include <igl/list_to_matrix.h>
 
+#include <polyfem/io/MappedFile.hpp>
 #include <polyfem/utils/Logger.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
 
 namespace polyfem::io
 {
@@ -27,6 +34,187 @@ namespace polyfem::io
 			s.erase(std::remove(s.begin(), s.end(), '\n'), s.end());
 			return s;
 		}
+
+		bool is_space(const char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+		const char *skip_spaces(const char *p, const char *end)
+		{
+			while (p < end && is_space(*p))
+				++p;
+			return p;
+		}
+
+		/// Parse a double starting at p, returns the end of the number or nullptr on failure
+		const char *parse_double(const char *p, const char *end, double &x)
+		{
+			if (p < end && *p == '+')
+				++p;
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+			const auto res = std::from_chars(p, end, x);
+			return res.ec == std::errc() ? res.ptr : nullptr;
+#else
+			// no floating point from_chars, copy the token to null terminate it for strtod
+			char buffer[128];
+			const size_t n = std::min<size_t>(std::find_if(p, end, [](const char c) { return is_space(c) || c == '\n'; }) - p, sizeof(buffer) - 1);
+			std::memcpy(buffer, p, n);
+			buffer[n] = '\0';
+			char *last;
+			x = std::strtod(buffer, &last);
+			return last == buffer ? nullptr : p + (last - buffer);
+#endif
+		}
+
+		const char *parse_int(const char *p, const char *end, long &i)
+		{
+			if (p < end && *p == '+')
+				++p;
+			const auto res = std::from_chars(p, end, i);
+			return res.ec == std::errc() ? res.ptr : nullptr;
+		}
+
+		/// Records of a chunk of lines of an obj file, vertex indices are zero based and
+		/// relative (negative) indices are resolved against the vertices of the chunk
+		struct OBJChunk
+		{
+			std::vector<double> V;
+			int n_vertices = 0;
+			int vertex_size = -1; ///< number of coordinates of the vertices, -2 if they differ
+
+			std::vector<int> F;
+			int n_faces = 0;
+			int face_size = -1; ///< number of vertices of the faces, -2 if they differ
+
+			std::vector<int> E; ///< edges of the polylines
+
+			/// positions in F and E of the relative indices, they must be shifted by the vertices of the previous chunks
+			std::vector<int> F_relative, E_relative;
+
+			int n_lines = 0;
+			int error_line = -1; ///< line of the first error in the chunk
+			std::string error;
+			std::vector<std::pair<int, std::string>> ignored;
+		};
+
+		/// Parse the lines in [begin, end), end is a line start or the end of the file
+		void parse_obj_chunk(const char *begin, const char *end, OBJChunk &chunk)
+		{
+			const auto resolve = [&chunk](const long i) -> int {
+				return i < 0 ? (i + chunk.n_vertices) : (i - 1);
+			};
+			std::vector<std::pair<int, bool>> polyline; // vertices and if they are relative
+
+			for (const char *line = begin; line < end; ++chunk.n_lines)
+			{
+				const char *eol = static_cast<const char *>(std::memchr(line, '\n', end - line));
+				if (eol == nullptr)
+					eol = end;
+				const char *next = eol < end ? eol + 1 : end;
+
+				const char *p = skip_spaces(line, eol);
+				const char *word_end = p;
+				while (word_end < eol && !is_space(*word_end))
+					++word_end;
+				const std::string_view type(p, word_end - p);
+				p = skip_spaces(word_end, eol);
+
+				const auto fail = [&](const std::string &msg) {
+					chunk.error_line = chunk.n_lines;
+					chunk.error = msg;
+				};
+
+				if (type == "v")
+				{
+					int size = 0;
+					while (p < eol)
+					{
+						double x;
+						p = parse_double(p, eol, x);
+						if (p == nullptr)
+						{
+							fail("vertex has invalid coordinates");
+							return;
+						}
+						chunk.V.push_back(x);
+						++size;
+						p = skip_spaces(p, eol);
+					}
+					if (chunk.vertex_size == -1)
+						chunk.vertex_size = size;
+					else if (chunk.vertex_size != size)
+						chunk.vertex_size = -2;
+					++chunk.n_vertices;
+				}
+				else if (type == "f")
+				{
+					int size = 0;
+					while (p < eol)
+					{
+						long i;
+						p = parse_int(p, eol, i);
+						if (p == nullptr)
+						{
+							fail("face has invalid element format");
+							return;
+						}
+						if (i < 0)
+							chunk.F_relative.push_back(chunk.F.size());
+						chunk.F.push_back(resolve(i));
+						++size;
+						// skip the texture and normal indices
+						while (p < eol && !is_space(*p))
+							++p;
+						p = skip_spaces(p, eol);
+					}
+					if (chunk.face_size == -1)
+						chunk.face_size = size;
+					else if (chunk.face_size != size)
+						chunk.face_size = -2;
+					++chunk.n_faces;
+				}
+				else if (type == "l")
+				{
+					polyline.clear();
+					while (p < eol)
+					{
+						long i;
+						p = parse_int(p, eol, i);
+						if (p == nullptr)
+						{
+							fail("line element has invalid format");
+							return;
+						}
+						polyline.emplace_back(resolve(i), i < 0);
+						p = skip_spaces(p, eol);
+					}
+					if (polyline.size() < 2)
+					{
+						fail("line element should have at least 2 vertices");
+						return;
+					}
+					for (int k = 1; k < polyline.size(); ++k)
+					{
+						for (const auto &[v, relative] : {polyline[k - 1], polyline[k]})
+						{
+							if (relative)
+								chunk.E_relative.push_back(chunk.E.size());
+							chunk.E.push_back(v);
+						}
+					}
+				}
+				else if (
+					type.empty() || type[0] == '#' || type == "vn" || type == "vt" || type == "g" || type == "s" || type == "o"
+					|| type == "usemtl" || type == "mtllib")
+				{
+					// ignore comments, normals, textures or other stuff
+				}
+				else
+				{
+					chunk.ignored.emplace_back(chunk.n_lines, std::string(line, eol - line));
+				}
+
+				line = next;
+			}
+		}
 	} // namespace
 
 	bool OBJReader::read(
@@ -296,41 +484,98 @@ namespace polyfem::io
 		Eigen::MatrixXi &E,
 		Eigen::MatrixXi &F)
 	{
-		std::vector<std::vector<double>> vV, vTC, vN;
-		std::vector<std::vector<int>> vF, vFTC, vFN, vL;
-		bool success = read(str, vV, vTC, vN, vF, vFTC, vFN, vL);
-		if (!success)
-		{
-			// read(str,vV,vTC,vN,vF,vFTC,vFN) should have already printed
-			// an error message
-			return false;
-		}
-		bool V_rect = igl::list_to_matrix(vV, V);
-		if (!V_rect)
+		const MappedFile file(str);
+		if (!file.ok())
 		{
-			// igl::list_to_matrix(vV,V) already printed error message
+			logger().error("OBJReader::read: {:s} could not be opened!", str);
 			return false;
 		}
-		bool F_rect = igl::list_to_matrix(vF, F);
-		if (!F_rect)
+
+		// split the file in chunks of about chunk_size bytes starting at a line
+		constexpr size_t chunk_size = 1 << 20;
+		const char *file_end = file.data() + file.size();
+		std::vector<const char *> starts = {file.data()};
+		while (file_end - starts.back() > chunk_size)
 		{
-			// igl::list_to_matrix(vF,F) already printed error message
-			return false;
+			const char *eol = static_cast<const char *>(std::memchr(starts.back() + chunk_size, '\n', file_end - starts.back() - chunk_size));
+			if (eol == nullptr || eol + 1 == file_end)
+				break;
+			starts.push_back(eol + 1);
 		}
-		std::vector<std::vector<int>> vE;
-		for (const std::vector<int> &polyline : vL)
+		starts.push_back(file_end);
+
+		std::vector<OBJChunk> chunks(starts.size() - 1);
+		utils::maybe_parallel_for(chunks.size(), [&](int start, int end, int thread_id) {
+			for (int i = start; i < end; ++i)
+				parse_obj_chunk(starts[i], starts[i + 1], chunks[i]);
+		});
+
+		const auto merge_size = [](int &size, const int chunk_size) {
+			if (chunk_size == -1)
+				return;
+			size = (size == -1 || size == chunk_size) ? chunk_size : -2;
+		};
+
+		int n_lines = 0, n_vertices = 0, n_faces = 0, n_edges = 0;
+		int vertex_size = -1, face_size = -1;
+		std::vector<int> vertex_offsets, face_offsets, edge_offsets;
+		for (const OBJChunk &chunk : chunks)
 		{
-			for (int i = 1; i < polyline.size(); i++)
+			for (const auto &[line, text] : chunk.ignored)
+				logger().warn("OBJReader::read: ignored non-comment line {:d}: {:s}", n_lines + line + 1, text);
+			if (chunk.error_line >= 0)
 			{
-				vE.push_back({{polyline[i - 1], polyline[i]}});
+				logger().error("OBJReader::read: {:s} on line {:d}", chunk.error, n_lines + chunk.error_line + 1);
+				return false;
 			}
+
+			vertex_offsets.push_back(n_vertices);
+			face_offsets.push_back(n_faces);
+			edge_offsets.push_back(n_edges);
+
+			n_lines += chunk.n_lines;
+			n_vertices += chunk.n_vertices;
+			n_faces += chunk.n_faces;
+			n_edges += chunk.E.size() / 2;
+			merge_size(vertex_size, chunk.vertex_size);
+			merge_size(face_size, chunk.face_size);
 		}
-		bool E_rect = igl::list_to_matrix(vE, E);
-		if (!E_rect)
+
+		if (vertex_size == -2)
 		{
-			logger().error("OBJReader::read: edges not rectangular matrix!");
+			logger().error("OBJReader::read: vertices not rectangular matrix!");
 			return false;
 		}
+		if (face_size == -2)
+		{
+			logger().error("OBJReader::read: faces not rectangular matrix!");
+			return false;
+		}
+
+		V.resize(n_vertices, std::max(vertex_size, 0));
+		F.resize(n_faces, std::max(face_size, 0));
+		E.resize(n_edges, n_edges > 0 ? 2 : 0);
+
+		using RowMatrixXd = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+		using RowMatrixXi = Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+		utils::maybe_parallel_for(chunks.size(), [&](int start, int end, int thread_id) {
+			for (int i = start; i < end; ++i)
+			{
+				OBJChunk &chunk = chunks[i];
+				for (const int r : chunk.F_relative)
+					chunk.F[r] += vertex_offsets[i];
+				for (const int r : chunk.E_relative)
+					chunk.E[r] += vertex_offsets[i];
+
+				if (chunk.n_vertices > 0)
+					V.middleRows(vertex_offsets[i], chunk.n_vertices) = Eigen::Map<const RowMatrixXd>(chunk.V.data(), chunk.n_vertices, V.cols());
+				if (chunk.n_faces > 0)
+					F.middleRows(face_offsets[i], chunk.n_faces) = Eigen::Map<const RowMatrixXi>(chunk.F.data(), chunk.n_faces, F.cols());
+				if (!chunk.E.empty())
+					E.middleRows(edge_offsets[i], chunk.E.size() / 2) = Eigen::Map<const RowMatrixXi>(chunk.E.data(), chunk.E.size() / 2, 2);
+			}
+		});
+
 		// if (F.size())
 		// {
 		// 	Eigen::MatrixXi faceE;
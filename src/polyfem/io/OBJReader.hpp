@@ -66,10 +66,13 @@ namespace polyfem::io
 			std::vector<std::vector<int>> &F,
 			std::vector<std::vector<int>> &L);
 
-		/// @brief Eigen Wrappers of read_obj.
+		/// @brief Read V, polyline edges E, and F from an obj file into Eigen matrices.
+		///
+		/// The file is memory mapped, split in chunks at line boundaries and the
+		/// chunks are parsed in parallel. Only the v, f, and l records are read.
 		/// @retruns These will return true only if the data is perfectly
-		///          "rectangular": All faces are the same degree, all have the same
-		///          number of textures/normals etc.
+		///          "rectangular": All faces are the same degree and all vertices
+		///          have the same number of coordinates.
 		static bool read(
 			const std::string str,
 			Eigen::MatrixXd &V,
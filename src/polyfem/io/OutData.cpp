@@ -11,6 +11,7 @@
 #include <polyfem/basis/ElementBases.hpp>
 
 #include <polyfem/mesh/MeshUtils.hpp>
+#include <polyfem/mesh/PointLocator.hpp>
 #include <polyfem/mesh/mesh2D/Mesh2D.hpp>
 #include <polyfem/mesh/mesh3D/Mesh3D.hpp>
 
@@ -21,6 +22,7 @@
 #include <polyfem/solver/NLProblem.hpp>
 
 #include <polyfem/utils/EdgeSampler.hpp>
+#include <polyfem/utils/ElasticityUtils.hpp>
 #include <polyfem/utils/Logger.hpp>
 #include <polyfem/utils/par_for.hpp>
 #include <polyfem/utils/BoundarySampler.hpp>
@@ -33,8 +35,6 @@
 #include <paraviewo/VTMWriter.hpp>
 #include <paraviewo/PVDWriter.hpp>
 
-#include <BVH.hpp>
-
 #include <igl/write_triangle_mesh.h>
 #include <igl/edges.h>
 #include <igl/facet_adjacency_matrix.h>
@@ -42,12 +42,87 @@
 
 #include <ipc/ipc.hpp>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <filesystem>
 
 extern "C" size_t getPeakRSS();
+extern "C" size_t getCurrentRSS();
 
 namespace polyfem::io
 {
+	namespace
+	{
+		/// sum with a fixed pairwise association, the result only depends on the values
+		double pairwise_sum(const Eigen::VectorXd &v, const int begin, const int end)
+		{
+			if (end - begin <= 16)
+				return v.segment(begin, end - begin).sum();
+
+			const int mid = begin + (end - begin) / 2;
+			return pairwise_sum(v, begin, mid) + pairwise_sum(v, mid, end);
+		}
+
+		double pairwise_sum(const Eigen::VectorXd &v)
+		{
+			return pairwise_sum(v, 0, v.size());
+		}
+	} // namespace
+
+	class OutGeometryData::FieldWriter
+	{
+	public:
+		/// @param[in] opts export options
+		/// @param[in] series time series receiving the step, nullptr to write a paraview file
+		/// @param[in] t time of the step
+		FieldWriter(const ExportOptions &opts, VTKHDFWriter *series, const double t)
+			: series_(series), t_(t)
+		{
+			if (series_ != nullptr)
+				return;
+
+			if (opts.use_hdf5)
+				writer_ = std::make_shared<paraviewo::HDF5VTUWriter>();
+			else
+				writer_ = std::make_shared<paraviewo::VTUWriter>();
+		}
+
+		void add_field(const std::string &name, const Eigen::MatrixXd &data)
+		{
+			if (series_ == nullptr)
+				writer_->add_field(name, data);
+			else
+				fields_.emplace_back(name, data);
+		}
+
+		void write_mesh(const std::string &path, const Eigen::MatrixXd &points, const Eigen::MatrixXi &cells)
+		{
+			if (series_ == nullptr)
+				writer_->write_mesh(path, points, cells);
+			else
+				series_->write_step(t_, points, cells, fields_);
+		}
+
+		void write_mesh(
+			const std::string &path,
+			const Eigen::MatrixXd &points,
+			const std::vector<std::vector<int>> &cells,
+			const bool is_simplicial,
+			const bool has_poly)
+		{
+			if (series_ == nullptr)
+				writer_->write_mesh(path, points, cells, is_simplicial, has_poly);
+			else
+				series_->write_step(t_, points, cells, is_simplicial, fields_);
+		}
+
+	private:
+		std::shared_ptr<paraviewo::ParaviewWriter> writer_;
+		VTKHDFWriter *series_;
+		const double t_;
+		std::vector<VTKHDFWriter::NamedField> fields_;
+	};
 
 	void OutGeometryData::extract_boundary_mesh(
 		const mesh::Mesh &mesh,
@@ -63,6 +138,21 @@ namespace polyfem::io
 
 		displacement_map_entries.clear();
 
+		// the local boundaries are processed in parallel into their own chunk, the chunks are concatenated in order
+		// with prefix sums so that the primitives do not depend on the threads. A node shared by several boundaries
+		// is claimed by the first one reaching it, which writes its position and its entry of the displacement map.
+		struct BoundaryChunk
+		{
+			std::vector<std::array<int, 3>> tris;
+			std::vector<std::array<int, 2>> edges;
+			std::vector<Eigen::Triplet<double>> entries;
+			std::vector<int> skipped_sizes;
+		};
+		std::vector<BoundaryChunk> chunks(total_local_boundary.size());
+
+		std::vector<std::atomic<char>> has_position(n_bases), has_entry(n_bases);
+		const auto claim = [](std::vector<std::atomic<char>> &flags, const int i) { return !flags[i].exchange(1); };
+
 		if (mesh.is_volume())
 		{
 			const bool is_simplicial = mesh.is_simplicial();
@@ -71,179 +161,190 @@ namespace polyfem::io
 			node_positions.setZero();
 			const Mesh3D &mesh3d = dynamic_cast<const Mesh3D &>(mesh);
 
-			std::vector<std::tuple<int, int, int>> tris;
-
-			std::vector<bool> visited_node(n_bases, false);
-
-			std::stringstream print_warning;
-
-			for (const LocalBoundary &lb : total_local_boundary)
-			{
-				const basis::ElementBases &b = bases[lb.element_id()];
-
-				for (int j = 0; j < lb.size(); ++j)
+			utils::maybe_parallel_for(total_local_boundary.size(), [&](int start, int end, int thread_id) {
+				for (int lbi = start; lbi < end; ++lbi)
 				{
-					const int eid = lb.global_primitive_id(j);
-					const int lid = lb[j];
-					const auto nodes = b.local_nodes_for_primitive(eid, mesh3d);
+					const LocalBoundary &lb = total_local_boundary[lbi];
+					const basis::ElementBases &b = bases[lb.element_id()];
+					std::vector<std::array<int, 3>> &tris = chunks[lbi].tris;
 
-					if (mesh.is_cube(lb.element_id()))
+					for (int j = 0; j < lb.size(); ++j)
 					{
-						assert(!is_simplicial);
-						assert(!mesh.has_poly());
-						std::vector<int> loc_nodes;
-						RowVectorNd bary = RowVectorNd::Zero(3);
+						const int eid = lb.global_primitive_id(j);
+						const int lid = lb[j];
+						const auto nodes = b.local_nodes_for_primitive(eid, mesh3d);
 
-						for (long n = 0; n < nodes.size(); ++n)
+						if (mesh.is_cube(lb.element_id()))
 						{
-							auto &bs = b.bases[nodes(n)];
-							const auto &glob = bs.global();
-							if (glob.size() != 1)
+							assert(!is_simplicial);
+							assert(!mesh.has_poly());
+							std::vector<int> loc_nodes;
+							RowVectorNd bary = RowVectorNd::Zero(3);
+
+							for (long n = 0; n < nodes.size(); ++n)
+							{
+								auto &bs = b.bases[nodes(n)];
+								const auto &glob = bs.global();
+								if (glob.size() != 1)
+									continue;
+
+								int gindex = glob.front().index;
+								if (claim(has_position, gindex))
+									node_positions.row(gindex) = glob.front().node;
+								bary += glob.front().node;
+								loc_nodes.push_back(gindex);
+							}
+
+							if (loc_nodes.size() != 4)
+							{
+								logger().trace("skipping element {} since it is not Q1", eid);
 								continue;
+							}
 
-							int gindex = glob.front().index;
-							node_positions.row(gindex) = glob.front().node;
-							bary += glob.front().node;
-							loc_nodes.push_back(gindex);
+							bary /= 4;
+
+							const int new_node = n_bases + eid;
+							node_positions.row(new_node) = bary;
+							tris.push_back({loc_nodes[1], loc_nodes[0], new_node});
+							tris.push_back({loc_nodes[2], loc_nodes[1], new_node});
+							tris.push_back({loc_nodes[3], loc_nodes[2], new_node});
+							tris.push_back({loc_nodes[0], loc_nodes[3], new_node});
+
+							for (int q = 0; q < 4; ++q)
+							{
+								if (claim(has_entry, loc_nodes[q]))
+									chunks[lbi].entries.emplace_back(loc_nodes[q], loc_nodes[q], 1);
+								chunks[lbi].entries.emplace_back(new_node, loc_nodes[q], 0.25);
+							}
+
+							continue;
 						}
 
-						if (loc_nodes.size() != 4)
+						if (!mesh.is_simplex(lb.element_id()))
 						{
-							logger().trace("skipping element {} since it is not Q1", eid);
+							logger().trace("skipping element {} since it is not a simplex or hex", eid);
 							continue;
 						}
 
-						bary /= 4;
+						assert(mesh.is_simplex(lb.element_id()));
 
-						const int new_node = n_bases + eid;
-						node_positions.row(new_node) = bary;
-						tris.emplace_back(loc_nodes[1], loc_nodes[0], new_node);
-						tris.emplace_back(loc_nodes[2], loc_nodes[1], new_node);
-						tris.emplace_back(loc_nodes[3], loc_nodes[2], new_node);
-						tris.emplace_back(loc_nodes[0], loc_nodes[3], new_node);
+						std::vector<int> loc_nodes;
 
-						for (int q = 0; q < 4; ++q)
+						bool is_follower = false;
+						if (!mesh3d.is_conforming())
 						{
-							if (!visited_node[loc_nodes[q]])
-								displacement_map_entries.emplace_back(loc_nodes[q], loc_nodes[q], 1);
-
-							visited_node[loc_nodes[q]] = true;
-							displacement_map_entries.emplace_back(new_node, loc_nodes[q], 0.25);
+							for (long n = 0; n < nodes.size(); ++n)
+							{
+								auto &bs = b.bases[nodes(n)];
+								const auto &glob = bs.global();
+								if (glob.size() != 1)
+								{
+									is_follower = true;
+									break;
+								}
+							}
 						}
 
-						continue;
-					}
-
-					if (!mesh.is_simplex(lb.element_id()))
-					{
-						logger().trace("skipping element {} since it is not a simplex or hex", eid);
-						continue;
-					}
-
-					assert(mesh.is_simplex(lb.element_id()));
-
-					std::vector<int> loc_nodes;
+						if (is_follower)
+							continue;
 
-					bool is_follower = false;
-					if (!mesh3d.is_conforming())
-					{
 						for (long n = 0; n < nodes.size(); ++n)
 						{
 							auto &bs = b.bases[nodes(n)];
 							const auto &glob = bs.global();
 							if (glob.size() != 1)
-							{
-								is_follower = true;
-								break;
-							}
-						}
-					}
-
-					if (is_follower)
-						continue;
-
-					for (long n = 0; n < nodes.size(); ++n)
-					{
-						auto &bs = b.bases[nodes(n)];
-						const auto &glob = bs.global();
-						if (glob.size() != 1)
-							continue;
-
-						int gindex = glob.front().index;
-						node_positions.row(gindex) = glob.front().node;
-						loc_nodes.push_back(gindex);
-					}
-
-					if (loc_nodes.size() == 3)
-					{
-						tris.emplace_back(loc_nodes[0], loc_nodes[1], loc_nodes[2]);
-					}
-					else if (loc_nodes.size() == 6)
-					{
-						tris.emplace_back(loc_nodes[0], loc_nodes[3], loc_nodes[5]);
-						tris.emplace_back(loc_nodes[3], loc_nodes[1], loc_nodes[4]);
-						tris.emplace_back(loc_nodes[4], loc_nodes[2], loc_nodes[5]);
-						tris.emplace_back(loc_nodes[3], loc_nodes[4], loc_nodes[5]);
-					}
-					else if (loc_nodes.size() == 10)
-					{
-						tris.emplace_back(loc_nodes[0], loc_nodes[3], loc_nodes[8]);
-						tris.emplace_back(loc_nodes[3], loc_nodes[4], loc_nodes[9]);
-						tris.emplace_back(loc_nodes[4], loc_nodes[1], loc_nodes[5]);
-						tris.emplace_back(loc_nodes[5], loc_nodes[6], loc_nodes[9]);
-						tris.emplace_back(loc_nodes[6], loc_nodes[2], loc_nodes[7]);
-						tris.emplace_back(loc_nodes[7], loc_nodes[8], loc_nodes[9]);
-						tris.emplace_back(loc_nodes[8], loc_nodes[3], loc_nodes[9]);
-						tris.emplace_back(loc_nodes[9], loc_nodes[4], loc_nodes[5]);
-						tris.emplace_back(loc_nodes[6], loc_nodes[7], loc_nodes[9]);
-					}
-					else if (loc_nodes.size() == 15)
-					{
-						tris.emplace_back(loc_nodes[0], loc_nodes[3], loc_nodes[11]);
-						tris.emplace_back(loc_nodes[3], loc_nodes[4], loc_nodes[12]);
-						tris.emplace_back(loc_nodes[3], loc_nodes[12], loc_nodes[11]);
-						tris.emplace_back(loc_nodes[12], loc_nodes[10], loc_nodes[11]);
-						tris.emplace_back(loc_nodes[4], loc_nodes[5], loc_nodes[13]);
-						tris.emplace_back(loc_nodes[4], loc_nodes[13], loc_nodes[12]);
-						tris.emplace_back(loc_nodes[12], loc_nodes[13], loc_nodes[14]);
-						tris.emplace_back(loc_nodes[12], loc_nodes[14], loc_nodes[10]);
-						tris.emplace_back(loc_nodes[14], loc_nodes[9], loc_nodes[10]);
-						tris.emplace_back(loc_nodes[5], loc_nodes[1], loc_nodes[6]);
-						tris.emplace_back(loc_nodes[5], loc_nodes[6], loc_nodes[13]);
-						tris.emplace_back(loc_nodes[6], loc_nodes[7], loc_nodes[13]);
-						tris.emplace_back(loc_nodes[13], loc_nodes[7], loc_nodes[14]);
-						tris.emplace_back(loc_nodes[7], loc_nodes[8], loc_nodes[14]);
-						tris.emplace_back(loc_nodes[14], loc_nodes[8], loc_nodes[9]);
-						tris.emplace_back(loc_nodes[8], loc_nodes[2], loc_nodes[9]);
-					}
-					else
-					{
+								continue;
 
-						print_warning << loc_nodes.size() << " ";
-						// assert(false);
-					}
+							int gindex = glob.front().index;
+							if (claim(has_position, gindex))
+								node_positions.row(gindex) = glob.front().node;
+							loc_nodes.push_back(gindex);
+						}
 
-					if (!is_simplicial)
-					{
-						for (int k = 0; k < loc_nodes.size(); ++k)
+						if (loc_nodes.size() == 3)
+						{
+							tris.push_back({loc_nodes[0], loc_nodes[1], loc_nodes[2]});
+						}
+						else if (loc_nodes.size() == 6)
 						{
-							if (!visited_node[loc_nodes[k]])
-								displacement_map_entries.emplace_back(loc_nodes[k], loc_nodes[k], 1);
+							tris.push_back({loc_nodes[0], loc_nodes[3], loc_nodes[5]});
+							tris.push_back({loc_nodes[3], loc_nodes[1], loc_nodes[4]});
+							tris.push_back({loc_nodes[4], loc_nodes[2], loc_nodes[5]});
+							tris.push_back({loc_nodes[3], loc_nodes[4], loc_nodes[5]});
+						}
+						else if (loc_nodes.size() == 10)
+						{
+							tris.push_back({loc_nodes[0], loc_nodes[3], loc_nodes[8]});
+							tris.push_back({loc_nodes[3], loc_nodes[4], loc_nodes[9]});
+							tris.push_back({loc_nodes[4], loc_nodes[1], loc_nodes[5]});
+							tris.push_back({loc_nodes[5], loc_nodes[6], loc_nodes[9]});
+							tris.push_back({loc_nodes[6], loc_nodes[2], loc_nodes[7]});
+							tris.push_back({loc_nodes[7], loc_nodes[8], loc_nodes[9]});
+							tris.push_back({loc_nodes[8], loc_nodes[3], loc_nodes[9]});
+							tris.push_back({loc_nodes[9], loc_nodes[4], loc_nodes[5]});
+							tris.push_back({loc_nodes[6], loc_nodes[7], loc_nodes[9]});
+						}
+						else if (loc_nodes.size() == 15)
+						{
+							tris.push_back({loc_nodes[0], loc_nodes[3], loc_nodes[11]});
+							tris.push_back({loc_nodes[3], loc_nodes[4], loc_nodes[12]});
+							tris.push_back({loc_nodes[3], loc_nodes[12], loc_nodes[11]});
+							tris.push_back({loc_nodes[12], loc_nodes[10], loc_nodes[11]});
+							tris.push_back({loc_nodes[4], loc_nodes[5], loc_nodes[13]});
+							tris.push_back({loc_nodes[4], loc_nodes[13], loc_nodes[12]});
+							tris.push_back({loc_nodes[12], loc_nodes[13], loc_nodes[14]});
+							tris.push_back({loc_nodes[12], loc_nodes[14], loc_nodes[10]});
+							tris.push_back({loc_nodes[14], loc_nodes[9], loc_nodes[10]});
+							tris.push_back({loc_nodes[5], loc_nodes[1], loc_nodes[6]});
+							tris.push_back({loc_nodes[5], loc_nodes[6], loc_nodes[13]});
+							tris.push_back({loc_nodes[6], loc_nodes[7], loc_nodes[13]});
+							tris.push_back({loc_nodes[13], loc_nodes[7], loc_nodes[14]});
+							tris.push_back({loc_nodes[7], loc_nodes[8], loc_nodes[14]});
+							tris.push_back({loc_nodes[14], loc_nodes[8], loc_nodes[9]});
+							tris.push_back({loc_nodes[8], loc_nodes[2], loc_nodes[9]});
+						}
+						else
+						{
+							chunks[lbi].skipped_sizes.push_back(loc_nodes.size());
+							// assert(false);
+						}
 
-							visited_node[loc_nodes[k]] = true;
+						if (!is_simplicial)
+						{
+							for (int k = 0; k < loc_nodes.size(); ++k)
+							{
+								if (claim(has_entry, loc_nodes[k]))
+									chunks[lbi].entries.emplace_back(loc_nodes[k], loc_nodes[k], 1);
+							}
 						}
 					}
 				}
-			}
+			});
 
+			std::stringstream print_warning;
+			for (const BoundaryChunk &chunk : chunks)
+			{
+				for (const int size : chunk.skipped_sizes)
+					print_warning << size << " ";
+			}
 			if (print_warning.str().size() > 0)
 				logger().warn("Skipping faces as theys have {} nodes, boundary export supported up to p4", print_warning.str());
 
-			boundary_triangles.resize(tris.size(), 3);
-			for (int i = 0; i < tris.size(); ++i)
-			{
-				boundary_triangles.row(i) << std::get<0>(tris[i]), std::get<2>(tris[i]), std::get<1>(tris[i]);
-			}
+			std::vector<int> offsets(chunks.size() + 1, 0);
+			for (size_t i = 0; i < chunks.size(); ++i)
+				offsets[i + 1] = offsets[i] + chunks[i].tris.size();
+
+			boundary_triangles.resize(offsets.back(), 3);
+			utils::maybe_parallel_for(chunks.size(), [&](int start, int end, int thread_id) {
+				for (int i = start; i < end; ++i)
+				{
+					for (size_t j = 0; j < chunks[i].tris.size(); ++j)
+					{
+						const std::array<int, 3> &t = chunks[i].tris[j];
+						boundary_triangles.row(offsets[i] + j) << t[0], t[2], t[1];
+					}
+				}
+			});
 
 			if (boundary_triangles.rows() > 0)
 			{
@@ -256,45 +357,62 @@ namespace polyfem::io
 			node_positions.setZero();
 			const Mesh2D &mesh2d = dynamic_cast<const Mesh2D &>(mesh);
 
-			std::vector<std::pair<int, int>> edges;
-
-			for (auto it = total_local_boundary.begin(); it != total_local_boundary.end(); ++it)
-			{
-				const auto &lb = *it;
-				const basis::ElementBases &b = bases[lb.element_id()];
-
-				for (int j = 0; j < lb.size(); ++j)
+			utils::maybe_parallel_for(total_local_boundary.size(), [&](int start, int end, int thread_id) {
+				for (int lbi = start; lbi < end; ++lbi)
 				{
-					const int eid = lb.global_primitive_id(j);
-					const int lid = lb[j];
-					const auto nodes = b.local_nodes_for_primitive(eid, mesh2d);
-
-					int prev_node = -1;
+					const LocalBoundary &lb = total_local_boundary[lbi];
+					const basis::ElementBases &b = bases[lb.element_id()];
 
-					for (long n = 0; n < nodes.size(); ++n)
+					for (int j = 0; j < lb.size(); ++j)
 					{
-						auto &bs = b.bases[nodes(n)];
-						const auto &glob = bs.global();
-						if (glob.size() != 1)
-							continue;
+						const int eid = lb.global_primitive_id(j);
+						const int lid = lb[j];
+						const auto nodes = b.local_nodes_for_primitive(eid, mesh2d);
 
-						int gindex = glob.front().index;
-						node_positions.row(gindex) << glob.front().node(0), glob.front().node(1);
+						int prev_node = -1;
 
-						if (prev_node >= 0)
-							edges.emplace_back(prev_node, gindex);
-						prev_node = gindex;
+						for (long n = 0; n < nodes.size(); ++n)
+						{
+							auto &bs = b.bases[nodes(n)];
+							const auto &glob = bs.global();
+							if (glob.size() != 1)
+								continue;
+
+							int gindex = glob.front().index;
+							if (claim(has_position, gindex))
+								node_positions.row(gindex) << glob.front().node(0), glob.front().node(1);
+
+							if (prev_node >= 0)
+								chunks[lbi].edges.push_back({prev_node, gindex});
+							prev_node = gindex;
+						}
 					}
 				}
-			}
+			});
+
+			std::vector<int> offsets(chunks.size() + 1, 0);
+			for (size_t i = 0; i < chunks.size(); ++i)
+				offsets[i + 1] = offsets[i] + chunks[i].edges.size();
 
 			boundary_triangles.resize(0, 0);
-			boundary_edges.resize(edges.size(), 2);
-			for (int i = 0; i < edges.size(); ++i)
-			{
-				boundary_edges.row(i) << edges[i].first, edges[i].second;
-			}
+			boundary_edges.resize(offsets.back(), 2);
+			utils::maybe_parallel_for(chunks.size(), [&](int start, int end, int thread_id) {
+				for (int i = start; i < end; ++i)
+				{
+					for (size_t j = 0; j < chunks[i].edges.size(); ++j)
+						boundary_edges.row(offsets[i] + j) << chunks[i].edges[j][0], chunks[i].edges[j][1];
+				}
+			});
 		}
+
+		std::vector<size_t> entry_offsets(chunks.size() + 1, 0);
+		for (size_t i = 0; i < chunks.size(); ++i)
+			entry_offsets[i + 1] = entry_offsets[i] + chunks[i].entries.size();
+		displacement_map_entries.resize(entry_offsets.back());
+		utils::maybe_parallel_for(chunks.size(), [&](int start, int end, int thread_id) {
+			for (int i = start; i < end; ++i)
+				std::copy(chunks[i].entries.begin(), chunks[i].entries.end(), displacement_map_entries.begin() + entry_offsets[i]);
+		});
 	}
 
 	void OutGeometryData::build_vis_boundary_mesh(
@@ -539,6 +657,8 @@ namespace polyfem::io
 		const auto &current_bases = gbases;
 		int tet_total_size = 0;
 		int pts_total_size = 0;
+		// the simplices and the cubes share the sampler points, they are mapped in batches
+		std::vector<int> simplex_elements, cube_elements;
 
 		Eigen::MatrixXd vis_pts_poly;
 		Eigen::MatrixXi vis_faces_poly, vis_edges_poly;
@@ -554,11 +674,13 @@ namespace polyfem::io
 			{
 				tet_total_size += sampler.simplex_volume().rows();
 				pts_total_size += sampler.simplex_points().rows();
+				simplex_elements.push_back(i);
 			}
 			else if (mesh.is_cube(i))
 			{
 				tet_total_size += sampler.cube_volume().rows();
 				pts_total_size += sampler.cube_points().rows();
+				cube_elements.push_back(i);
 			}
 			else
 			{
@@ -585,8 +707,15 @@ namespace polyfem::io
 		el_id.resize(pts_total_size, 1);
 		discr.resize(pts_total_size, 1);
 
+		Eigen::MatrixXd simplex_mapped, cube_mapped;
+		basis::ElementBases::eval_geom_mapping(current_bases, simplex_elements, sampler.simplex_points(), simplex_mapped);
+		basis::ElementBases::eval_geom_mapping(current_bases, cube_elements, sampler.cube_points(), cube_mapped);
+		const int n_simplex_pts = sampler.simplex_points().rows();
+		const int n_cube_pts = sampler.cube_points().rows();
+
 		Eigen::MatrixXd mapped, tmp;
 		int tet_index = 0, pts_index = 0;
+		int simplex_index = 0, cube_index = 0;
 
 		for (size_t i = 0; i < current_bases.size(); ++i)
 		{
@@ -597,27 +726,23 @@ namespace polyfem::io
 
 			if (mesh.is_simplex(i))
 			{
-				bs.eval_geom_mapping(sampler.simplex_points(), mapped);
-
 				tets.block(tet_index, 0, sampler.simplex_volume().rows(), tets.cols()) = sampler.simplex_volume().array() + pts_index;
 				tet_index += sampler.simplex_volume().rows();
 
-				points.block(pts_index, 0, mapped.rows(), points.cols()) = mapped;
-				discr.block(pts_index, 0, mapped.rows(), 1).setConstant(disc_orders(i));
-				el_id.block(pts_index, 0, mapped.rows(), 1).setConstant(i);
-				pts_index += mapped.rows();
+				points.block(pts_index, 0, n_simplex_pts, points.cols()) = simplex_mapped.middleRows(simplex_index++ * n_simplex_pts, n_simplex_pts);
+				discr.block(pts_index, 0, n_simplex_pts, 1).setConstant(disc_orders(i));
+				el_id.block(pts_index, 0, n_simplex_pts, 1).setConstant(i);
+				pts_index += n_simplex_pts;
 			}
 			else if (mesh.is_cube(i))
 			{
-				bs.eval_geom_mapping(sampler.cube_points(), mapped);
-
 				tets.block(tet_index, 0, sampler.cube_volume().rows(), tets.cols()) = sampler.cube_volume().array() + pts_index;
 				tet_index += sampler.cube_volume().rows();
 
-				points.block(pts_index, 0, mapped.rows(), points.cols()) = mapped;
-				discr.block(pts_index, 0, mapped.rows(), 1).setConstant(disc_orders(i));
-				el_id.block(pts_index, 0, mapped.rows(), 1).setConstant(i);
-				pts_index += mapped.rows();
+				points.block(pts_index, 0, n_cube_pts, points.cols()) = cube_mapped.middleRows(cube_index++ * n_cube_pts, n_cube_pts);
+				discr.block(pts_index, 0, n_cube_pts, 1).setConstant(disc_orders(i));
+				el_id.block(pts_index, 0, n_cube_pts, 1).setConstant(i);
+				pts_index += n_cube_pts;
 			}
 			else
 			{
@@ -928,7 +1053,7 @@ namespace polyfem::io
 			Evaluator::compute_stress_at_quadrature_points(
 				mesh, problem.is_scalar(),
 				bases, gbases, state.disc_orders, *state.assembler,
-				sol, result, mises);
+				sol, result, mises, &stress_field_);
 			std::ofstream out(stress_path);
 			out.precision(20);
 			out << result;
@@ -940,7 +1065,7 @@ namespace polyfem::io
 			Evaluator::compute_stress_at_quadrature_points(
 				mesh, problem.is_scalar(),
 				bases, gbases, state.disc_orders, *state.assembler,
-				sol, result, mises);
+				sol, result, mises, &stress_field_);
 			std::ofstream out(mises_path);
 			out.precision(20);
 			out << mises;
@@ -970,9 +1095,31 @@ namespace polyfem::io
 
 		use_hdf5 = args["output"]["paraview"]["options"]["use_hdf5"];
 
+		for (const std::string &name : args["output"]["paraview"]["fields"])
+			fields.insert(name);
+
+		vtkhdf_compression_level = args["output"]["paraview"]["vtkhdf"]["compression_level"];
+		vtkhdf_chunk_size = args["output"]["paraview"]["vtkhdf"]["chunk_size"];
+		for (const json &field : args["output"]["paraview"]["vtkhdf"]["fields"])
+			vtkhdf_fields[field["name"].get<std::string>()] = {field["compression_level"].get<int>(), field["float32"].get<bool>()};
+
 		this->solve_export_to_file = solve_export_to_file;
 	}
 
+	OutGeometryData::SolverSnapshot::SolverSnapshot(const State &state)
+	{
+		const std::shared_ptr<time_integrator::ImplicitTimeIntegrator> &time_integrator = state.solve_data.time_integrator;
+		if (time_integrator != nullptr)
+		{
+			velocity = time_integrator->v_prev();
+			acceleration = time_integrator->a_prev();
+		}
+		if (state.solve_data.contact_form != nullptr)
+			barrier_stiffness = state.solve_data.contact_form->barrier_stiffness();
+		if (state.solve_data.friction_form != nullptr)
+			displaced_surface_prev = state.solve_data.friction_form->displaced_surface_prev();
+	}
+
 	void OutGeometryData::save_vtu(
 		const std::string &path,
 		const State &state,
@@ -1036,10 +1183,10 @@ namespace polyfem::io
 
 		if (opts.points)
 		{
-			save_points(base_path + "_points" + opts.file_extension(), state, sol, opts, solution_frames);
+			save_points(base_path + "_points" + opts.file_extension(), state, sol, t, opts, solution_frames);
 		}
 
-		if (!opts.solve_export_to_file)
+		if (!opts.solve_export_to_file || opts.use_vtkhdf())
 			return;
 
 		paraviewo::VTMWriter vtm(t);
@@ -1056,6 +1203,88 @@ namespace polyfem::io
 		vtm.save(base_path + ".vtm");
 	}
 
+	std::shared_ptr<const OutGeometryData::VolumeVisCache> OutGeometryData::volume_vis_cache(
+		const State &state,
+		const ExportOptions &opts) const
+	{
+		std::lock_guard<std::mutex> lock(volume_vis_cache_mutex_);
+
+		if (volume_vis_cache_ != nullptr
+			&& volume_vis_cache_->use_sampler == opts.use_sampler
+			&& volume_vis_cache_->boundary_only == opts.boundary_only)
+			return volume_vis_cache_;
+
+		POLYFEM_SCOPED_TIMER("Build visualization mesh");
+
+		const mesh::Mesh &mesh = *state.mesh;
+
+		auto vis = std::make_shared<VolumeVisCache>();
+		vis->use_sampler = opts.use_sampler;
+		vis->boundary_only = opts.boundary_only;
+
+		if (opts.use_sampler)
+			build_vis_mesh(mesh, state.disc_orders, state.geom_bases(),
+						   state.polys, state.polys_3d, opts.boundary_only,
+						   vis->points, vis->tets, vis->el_id, vis->discr);
+		else
+			build_high_order_vis_mesh(mesh, state.disc_orders, state.bases,
+									  vis->points, vis->elements, vis->el_id, vis->discr);
+
+		// n_bases includes the obstacle vertices, their columns are empty
+		Evaluator::interpolation_operator(
+			mesh, state.bases, state.disc_orders, state.polys, state.polys_3d, ref_element_sampler,
+			vis->points.rows(), state.n_bases, opts.use_sampler, opts.boundary_only, vis->interpolation);
+
+		if (state.mixed_assembler != nullptr)
+			Evaluator::interpolation_operator(
+				mesh, // FIXME: state.disc_orders should use pressure discr orders, works only with sampler
+				state.pressure_bases, state.disc_orders, state.polys, state.polys_3d, ref_element_sampler,
+				vis->points.rows(), state.n_pressure_bases, opts.use_sampler, opts.boundary_only, vis->pressure_interpolation);
+
+		volume_vis_cache_ = vis;
+		return volume_vis_cache_;
+	}
+
+	void OutGeometryData::vis_solution(const State &state, const ExportOptions &opts, const Eigen::MatrixXd &sol, Eigen::MatrixXd &points, Eigen::MatrixXd &values) const
+	{
+		const std::shared_ptr<const VolumeVisCache> vis = volume_vis_cache(state, opts);
+		points = vis->points;
+		Evaluator::apply_interpolation(vis->interpolation, state.problem->is_scalar() ? 1 : state.mesh->dimension(), sol, values);
+	}
+
+	void OutGeometryData::clear_vis_cache()
+	{
+		std::lock_guard<std::mutex> lock(volume_vis_cache_mutex_);
+		volume_vis_cache_ = nullptr;
+		stress_field_.clear();
+	}
+
+	VTKHDFWriter *OutGeometryData::vtkhdf_series(const ExportOptions &opts, const std::string &suffix) const
+	{
+		if (!opts.use_vtkhdf())
+			return nullptr;
+
+		const std::filesystem::path fs_path(opts.vtkhdf_path);
+		const std::string path = (fs_path.parent_path() / (fs_path.stem().string() + suffix + ".vtkhdf")).string();
+
+		std::lock_guard<std::mutex> lock(vtkhdf_series_mutex_);
+		std::unique_ptr<VTKHDFWriter> &series = vtkhdf_series_[path];
+		if (series == nullptr)
+		{
+			logger().debug("Opening VTKHDF time series {}", path);
+			series = std::make_unique<VTKHDFWriter>(path, opts.vtkhdf_compression_level, opts.vtkhdf_chunk_size);
+			for (const auto &[name, options] : opts.vtkhdf_fields)
+				series->set_field_options(name, options);
+		}
+		return series.get();
+	}
+
+	void OutGeometryData::close_vtkhdf_series()
+	{
+		std::lock_guard<std::mutex> lock(vtkhdf_series_mutex_);
+		vtkhdf_series_.clear();
+	}
+
 	void OutGeometryData::save_volume(
 		const std::string &path,
 		const State &state,
@@ -1078,19 +1307,15 @@ namespace polyfem::io
 		const mesh::Obstacle &obstacle = state.obstacle;
 		const assembler::Problem &problem = *state.problem;
 
-		Eigen::MatrixXd points;
-		Eigen::MatrixXi tets;
-		Eigen::MatrixXi el_id;
-		Eigen::MatrixXd discr;
-		std::vector<std::vector<int>> elements;
+		const std::shared_ptr<const VolumeVisCache> vis = volume_vis_cache(state, opts);
+		const int actual_dim = problem.is_scalar() ? 1 : mesh.dimension();
 
-		if (opts.use_sampler)
-			build_vis_mesh(mesh, disc_orders, gbases,
-						   state.polys, state.polys_3d, opts.boundary_only,
-						   points, tets, el_id, discr);
-		else
-			build_high_order_vis_mesh(mesh, disc_orders, bases,
-									  points, elements, el_id, discr);
+		// the obstacle is appended to these
+		Eigen::MatrixXd points = vis->points;
+		Eigen::MatrixXd discr = vis->discr;
+		std::vector<std::vector<int>> elements = vis->elements;
+		const Eigen::MatrixXi &tets = vis->tets;
+		const Eigen::MatrixXi &el_id = vis->el_id;
 
 		Eigen::MatrixXd fun, exact_fun, err, node_fun;
 
@@ -1155,25 +1380,23 @@ namespace polyfem::io
 			}
 		}
 
-		Evaluator::interpolate_function(
-			mesh, problem.is_scalar(), bases, state.disc_orders,
-			state.polys, state.polys_3d, ref_element_sampler,
-			points.rows(), sol, fun, opts.use_sampler, opts.boundary_only);
+		Evaluator::apply_interpolation(vis->interpolation, actual_dim, sol, fun);
 
+		const bool export_nodes = opts.solve_export_to_file && opts.export_field("nodes");
+		if (export_nodes)
 		{
 			Eigen::MatrixXd tmp = Eigen::VectorXd::LinSpaced(sol.size(), 0, sol.size() - 1);
-
-			Evaluator::interpolate_function(
-				mesh, problem.is_scalar(), bases, state.disc_orders,
-				state.polys, state.polys_3d, ref_element_sampler,
-				points.rows(), tmp, node_fun, opts.use_sampler, opts.boundary_only);
+			Evaluator::apply_interpolation(vis->interpolation, actual_dim, tmp, node_fun);
 		}
 
 		if (obstacle.n_vertices() > 0)
 		{
 			fun.conservativeResize(fun.rows() + obstacle.n_vertices(), fun.cols());
-			node_fun.conservativeResize(node_fun.rows() + obstacle.n_vertices(), node_fun.cols());
-			node_fun.bottomRows(obstacle.n_vertices()).setZero();
+			if (export_nodes)
+			{
+				node_fun.conservativeResize(node_fun.rows() + obstacle.n_vertices(), node_fun.cols());
+				node_fun.bottomRows(obstacle.n_vertices()).setZero();
+			}
 			// obstacle.update_displacement(t, fun);
 			// NOTE: Assuming the obstacle displacement is the last part of the solution
 			fun.bottomRows(obstacle.n_vertices()) = utils::unflatten(sol.bottomRows(obstacle.ndof()), fun.cols());
@@ -1195,43 +1418,37 @@ namespace polyfem::io
 			}
 		}
 
-		std::shared_ptr<paraviewo::ParaviewWriter> tmpw;
-		if (opts.use_hdf5)
-			tmpw = std::make_shared<paraviewo::HDF5VTUWriter>();
-		else
-			tmpw = std::make_shared<paraviewo::VTUWriter>();
-		paraviewo::ParaviewWriter &writer = *tmpw;
+		FieldWriter writer(opts, vtkhdf_series(opts, ""), t);
 
-		if (opts.solve_export_to_file)
+		if (export_nodes)
 			writer.add_field("nodes", node_fun);
 
 		if (problem.is_time_dependent())
 		{
 			bool is_time_integrator_valid = time_integrator != nullptr;
+			if (opts.snapshot != nullptr)
+				is_time_integrator_valid = opts.snapshot->velocity.size() == sol.size();
 
-			if (opts.velocity)
+			if (opts.export_field("velocity", opts.velocity))
 			{
 				const Eigen::VectorXd velocity =
-					is_time_integrator_valid ? (time_integrator->v_prev()) : Eigen::VectorXd::Zero(sol.size());
-				save_volume_vector_field(state, points, opts, "velocity", velocity, writer);
+					is_time_integrator_valid ? (opts.snapshot != nullptr ? opts.snapshot->velocity : time_integrator->v_prev()) : Eigen::VectorXd::Zero(sol.size());
+				save_volume_vector_field(state, *vis, opts, "velocity", velocity, writer);
 			}
 
-			if (opts.acceleration)
+			if (opts.export_field("acceleration", opts.acceleration))
 			{
 				const Eigen::VectorXd acceleration =
-					is_time_integrator_valid ? (time_integrator->a_prev()) : Eigen::VectorXd::Zero(sol.size());
-				save_volume_vector_field(state, points, opts, "acceleration", acceleration, writer);
+					is_time_integrator_valid ? (opts.snapshot != nullptr ? opts.snapshot->acceleration : time_integrator->a_prev()) : Eigen::VectorXd::Zero(sol.size());
+				save_volume_vector_field(state, *vis, opts, "acceleration", acceleration, writer);
 			}
 		}
 
 		// if(problem->is_mixed())
-		if (state.mixed_assembler != nullptr)
+		if (state.mixed_assembler != nullptr && (!opts.solve_export_to_file || opts.export_field("pressure")))
 		{
 			Eigen::MatrixXd interp_p;
-			Evaluator::interpolate_function(
-				mesh, 1, // FIXME: state.disc_orders should use pressure discr orders, works only with sampler
-				pressure_bases, state.disc_orders, state.polys, state.polys_3d, ref_element_sampler,
-				points.rows(), pressure, interp_p, opts.use_sampler, opts.boundary_only);
+			Evaluator::apply_interpolation(vis->pressure_interpolation, 1, pressure, interp_p);
 
 			if (obstacle.n_vertices() > 0)
 			{
@@ -1251,14 +1468,16 @@ namespace polyfem::io
 			discr.bottomRows(obstacle.n_vertices()).setZero();
 		}
 
-		if (opts.solve_export_to_file)
+		if (opts.solve_export_to_file && opts.export_field("discr"))
 			writer.add_field("discr", discr);
 		if (problem.has_exact_sol())
 		{
 			if (opts.solve_export_to_file)
 			{
-				writer.add_field("exact", exact_fun);
-				writer.add_field("error", err);
+				if (opts.export_field("exact"))
+					writer.add_field("exact", exact_fun);
+				if (opts.export_field("error"))
+					writer.add_field("error", err);
 			}
 			else
 			{
@@ -1269,12 +1488,36 @@ namespace polyfem::io
 
 		if (fun.cols() != 1)
 		{
+			// each pass over the elements is done only if one of its fields is exported,
+			// the frames keep the first scalar value and its average
+			const std::vector<std::string> scalar_names = assembler.scalar_value_names();
+			const std::vector<std::string> tensor_names = assembler.tensor_value_names();
+			const auto is_any_exported = [&](const std::vector<std::string> &names, const std::string &suffix) {
+				return std::any_of(names.begin(), names.end(), [&](const std::string &name) { return opts.export_field(name + suffix); });
+			};
+			const bool need_scalar = !opts.solve_export_to_file || is_any_exported(scalar_names, "");
+			const bool need_tensor = opts.solve_export_to_file && is_any_exported(tensor_names, "");
+			const bool need_avg = !opts.use_spline && (!opts.solve_export_to_file || is_any_exported(scalar_names, "_avg"));
+
 			std::vector<assembler::Assembler::NamedMatrix> vals, tvals;
-			Evaluator::compute_scalar_value(
-				mesh, problem.is_scalar(), bases, gbases,
-				state.disc_orders, state.polys, state.polys_3d,
-				*state.assembler,
-				ref_element_sampler, points.rows(), sol, vals, opts.use_sampler, opts.boundary_only);
+			if (need_tensor)
+			{
+				Evaluator::compute_tensor_value(
+					mesh, problem.is_scalar(), bases, gbases,
+					state.disc_orders, state.polys, state.polys_3d,
+					*state.assembler,
+					ref_element_sampler, points.rows(), sol, tvals, opts.use_sampler, opts.boundary_only, &stress_field_);
+			}
+
+			// with the tensors, the von Mises stress of elasticity comes from the same pass
+			if (need_scalar)
+			{
+				Evaluator::compute_scalar_value(
+					mesh, problem.is_scalar(), bases, gbases,
+					state.disc_orders, state.polys, state.polys_3d,
+					*state.assembler,
+					ref_element_sampler, points.rows(), sol, vals, opts.use_sampler, opts.boundary_only, &stress_field_);
+			}
 
 			if (obstacle.n_vertices() > 0)
 			{
@@ -1288,43 +1531,41 @@ namespace polyfem::io
 			if (opts.solve_export_to_file)
 			{
 				for (const auto &v : vals)
-					writer.add_field(v.first, v.second);
+				{
+					if (opts.export_field(v.first))
+						writer.add_field(v.first, v.second);
+				}
 			}
 			else if (vals.size() > 0)
 				solution_frames.back().scalar_value = vals[0].second;
 
-			if (opts.solve_export_to_file)
+			for (const auto &v : tvals)
 			{
-				Evaluator::compute_tensor_value(
-					mesh, problem.is_scalar(), bases, gbases,
-					state.disc_orders, state.polys, state.polys_3d,
-					*state.assembler,
-					ref_element_sampler, points.rows(), sol, tvals, opts.use_sampler, opts.boundary_only);
-				for (const auto &v : tvals)
+				if (!opts.export_field(v.first))
+					continue;
+
+				for (int i = 0; i < v.second.cols(); ++i)
 				{
-					for (int i = 0; i < v.second.cols(); ++i)
+					Eigen::MatrixXd tmp = v.second.col(i);
+					if (obstacle.n_vertices() > 0)
 					{
-						Eigen::MatrixXd tmp = v.second.col(i);
-						if (obstacle.n_vertices() > 0)
-						{
-							tmp.conservativeResize(tmp.size() + obstacle.n_vertices(), 1);
-							tmp.bottomRows(obstacle.n_vertices()).setZero();
-						}
-
-						const int ii = (i / mesh.dimension()) + 1;
-						const int jj = (i % mesh.dimension()) + 1;
-						writer.add_field(fmt::format("{:s}_{:d}{:d}", v.first, ii, jj), tmp);
+						tmp.conservativeResize(tmp.size() + obstacle.n_vertices(), 1);
+						tmp.bottomRows(obstacle.n_vertices()).setZero();
 					}
+
+					const int ii = (i / mesh.dimension()) + 1;
+					const int jj = (i % mesh.dimension()) + 1;
+					writer.add_field(fmt::format("{:s}_{:d}{:d}", v.first, ii, jj), tmp);
 				}
 			}
 
-			if (!opts.use_spline)
+			if (need_avg)
 			{
 				Evaluator::average_grad_based_function(
 					mesh, problem.is_scalar(), state.n_bases, bases, gbases,
 					state.disc_orders, state.polys, state.polys_3d,
 					*state.assembler,
-					ref_element_sampler, points.rows(), sol, vals, tvals, opts.use_sampler, opts.boundary_only);
+					ref_element_sampler, points.rows(), sol, vals, tvals, opts.use_sampler, opts.boundary_only, &stress_field_);
 
 				if (obstacle.n_vertices() > 0)
 				{
@@ -1338,7 +1579,10 @@ namespace polyfem::io
 				if (opts.solve_export_to_file)
 				{
 					for (const auto &v : vals)
-						writer.add_field(fmt::format("{:s}_avg", v.first), v.second);
+					{
+						if (opts.export_field(v.first + "_avg"))
+							writer.add_field(fmt::format("{:s}_avg", v.first), v.second);
+					}
 				}
 				else if (vals.size() > 0)
 					solution_frames.back().scalar_value_avg = vals[0].second;
@@ -1350,10 +1594,17 @@ namespace polyfem::io
 			}
 		}
 
-		if (opts.material_params)
+		// the material parameters share a single pass over the elements
+		std::map<std::string, assembler::ParamFunc> params;
+		for (const auto &[p, func] : assembler.parameters())
 		{
-			const auto &params = assembler.parameters();
+			if (opts.export_field(p, opts.material_params))
+				params[p] = func;
+		}
+		const bool export_rho = opts.export_field("rho", opts.material_params);
 
+		if (!params.empty() || export_rho)
+		{
 			std::map<std::string, Eigen::MatrixXd> param_val;
 			for (const auto &[p, _] : params)
 				param_val[p] = Eigen::MatrixXd(points.rows(), 1);
@@ -1422,7 +1673,8 @@ namespace polyfem::io
 					for (const auto &[p, func] : params)
 						param_val.at(p)(index) = func(local_pts.row(j), vals.val.row(j), t, e);
 
-					rhos(index) = density(local_pts.row(j), vals.val.row(j), e);
+					if (export_rho)
+						rhos(index) = density(local_pts.row(j), vals.val.row(j), e);
 
 					++index;
 				}
@@ -1443,10 +1695,11 @@ namespace polyfem::io
 			}
 			for (const auto &[p, tmp] : param_val)
 				writer.add_field(p, tmp);
-			writer.add_field("rho", rhos);
+			if (export_rho)
+				writer.add_field("rho", rhos);
 		}
 
-		if (opts.body_ids)
+		if (opts.export_field("body_ids", opts.body_ids))
 		{
 
 			Eigen::MatrixXd ids(points.rows(), 1);
@@ -1470,7 +1723,10 @@ namespace polyfem::io
 
 		// Write the solution last so it is the default for warp-by-vector
 		if (opts.solve_export_to_file)
-			writer.add_field("solution", fun);
+		{
+			if (opts.export_field("solution"))
+				writer.add_field("solution", fun);
+		}
 		else
 			solution_frames.back().solution = fun;
 
@@ -1528,17 +1784,16 @@ namespace polyfem::io
 
 	void OutGeometryData::save_volume_vector_field(
 		const State &state,
-		const Eigen::MatrixXd &points,
+		const VolumeVisCache &vis,
 		const ExportOptions &opts,
 		const std::string &name,
 		const Eigen::VectorXd &field,
-		paraviewo::ParaviewWriter &writer) const
+		FieldWriter &writer) const
 	{
 		Eigen::MatrixXd inerpolated_field;
-		Evaluator::interpolate_function(
-			*state.mesh, state.problem->is_scalar(), state.bases, state.disc_orders,
-			state.polys, state.polys_3d, ref_element_sampler,
-			points.rows(), field, inerpolated_field, opts.use_sampler, opts.boundary_only);
+		Evaluator::apply_interpolation(
+			vis.interpolation, state.problem->is_scalar() ? 1 : state.mesh->dimension(),
+			field, inerpolated_field);
 
 		if (state.obstacle.n_vertices() > 0)
 		{
@@ -1655,12 +1910,7 @@ namespace polyfem::io
 			}
 		}
 
-		std::shared_ptr<paraviewo::ParaviewWriter> tmpw;
-		if (opts.use_hdf5)
-			tmpw = std::make_shared<paraviewo::HDF5VTUWriter>();
-		else
-			tmpw = std::make_shared<paraviewo::VTUWriter>();
-		paraviewo::ParaviewWriter &writer = *tmpw;
+		FieldWriter writer(opts, vtkhdf_series(opts, "_surf"), t);
 
 		if (opts.solve_export_to_file)
 		{
@@ -1756,12 +2006,7 @@ namespace polyfem::io
 
 		if (opts.solve_export_to_file)
 		{
-			std::shared_ptr<paraviewo::ParaviewWriter> tmpw;
-			if (opts.use_hdf5)
-				tmpw = std::make_shared<paraviewo::HDF5VTUWriter>();
-			else
-				tmpw = std::make_shared<paraviewo::VTUWriter>();
-			paraviewo::ParaviewWriter &writer = *tmpw;
+			FieldWriter writer(opts, vtkhdf_series(opts, "_surf_contact"), t);
 
 			const int problem_dim = mesh.dimension();
 			const Eigen::MatrixXd full_displacements = utils::unflatten(sol, problem_dim);
@@ -1769,17 +2014,37 @@ namespace polyfem::io
 
 			const Eigen::MatrixXd displaced_surface = collision_mesh.displace_vertices(full_displacements);
 
+			// the live sets of the forms are reused when they were built at this solution, a snapshot is exported
+			// while the solver keeps changing them
+			const Eigen::VectorXd x = sol;
+			const bool use_forms = opts.snapshot == nullptr;
+			const ipc::Constraints *contact_constraint_set = use_forms && contact_form != nullptr ? contact_form->constraint_set(x) : nullptr;
+			const bool at_contact_form_solution = contact_constraint_set != nullptr;
+
 			ipc::Constraints constraint_set;
-			constraint_set.use_convergent_formulation = state.args["contact"]["use_convergent_formulation"];
-			constraint_set.build(
-				collision_mesh, displaced_surface, dhat,
-				/*dmin=*/0, state.args["solver"]["contact"]["CCD"]["broad_phase"]);
+			const auto get_constraint_set = [&]() -> const ipc::Constraints & {
+				if (contact_constraint_set == nullptr)
+				{
+					constraint_set.use_convergent_formulation = state.args["contact"]["use_convergent_formulation"];
+					constraint_set.build(
+						collision_mesh, displaced_surface, dhat,
+						/*dmin=*/0, state.args["solver"]["contact"]["CCD"]["broad_phase"]);
+					contact_constraint_set = &constraint_set;
+				}
+				return *contact_constraint_set;
+			};
 
-			const double barrier_stiffness = contact_form != nullptr ? contact_form->barrier_stiffness() : 1;
+			const double barrier_stiffness =
+				opts.snapshot != nullptr ? opts.snapshot->barrier_stiffness
+										 : (contact_form != nullptr ? contact_form->barrier_stiffness() : 1);
 
 			if (opts.contact_forces)
 			{
-				Eigen::MatrixXd forces = -barrier_stiffness * ipc::compute_barrier_potential_gradient(collision_mesh, displaced_surface, constraint_set, dhat);
+				Eigen::MatrixXd forces;
+				if (at_contact_form_solution)
+					forces = -barrier_stiffness * contact_form->surface_gradient(x);
+				else
+					forces = -barrier_stiffness * ipc::compute_barrier_potential_gradient(collision_mesh, displaced_surface, get_constraint_set(), dhat);
 				// forces = collision_mesh.to_full_dof(forces);
 				// assert(forces.size() == sol.size());
 
@@ -1793,23 +2058,31 @@ namespace polyfem::io
 			if (opts.friction_forces)
 			{
 				Eigen::MatrixXd displaced_surface_prev;
-				if (friction_form != nullptr)
+				if (opts.snapshot != nullptr)
+					displaced_surface_prev = opts.snapshot->displaced_surface_prev;
+				else if (friction_form != nullptr)
 					displaced_surface_prev = friction_form->displaced_surface_prev();
 				if (displaced_surface_prev.size() == 0)
 					displaced_surface_prev = displaced_surface;
 
 				ipc::FrictionConstraints friction_constraint_set;
-				ipc::construct_friction_constraint_set(
-					collision_mesh, displaced_surface, constraint_set,
-					dhat, barrier_stiffness, friction_coefficient,
-					friction_constraint_set);
+				const ipc::FrictionConstraints *live_friction_constraint_set =
+					use_forms && friction_form != nullptr ? friction_form->friction_constraint_set(x, barrier_stiffness) : nullptr;
+				if (live_friction_constraint_set == nullptr)
+				{
+					ipc::construct_friction_constraint_set(
+						collision_mesh, displaced_surface, get_constraint_set(),
+						dhat, barrier_stiffness, friction_coefficient,
+						friction_constraint_set);
+					live_friction_constraint_set = &friction_constraint_set;
+				}
 
 				double dt = 1;
 				if (dt_in > 0)
 					dt = dt_in;
 				Eigen::MatrixXd forces = -ipc::compute_friction_potential_gradient(
 					collision_mesh, displaced_surface_prev, displaced_surface,
-					friction_constraint_set, epsv * dt);
+					*live_friction_constraint_set, epsv * dt);
 				// forces = collision_mesh.to_full_dof(forces);
 				// assert(forces.size() == sol.size());
 
@@ -1856,6 +2129,7 @@ namespace polyfem::io
 		int seg_total_size = 0;
 		int pts_total_size = 0;
 		int faces_total_size = 0;
+		std::vector<int> simplex_elements, cube_elements;
 
 		for (size_t i = 0; i < current_bases.size(); ++i)
 		{
@@ -1866,12 +2140,14 @@ namespace polyfem::io
 				pts_total_size += sampler.simplex_points().rows();
 				seg_total_size += sampler.simplex_edges().rows();
 				faces_total_size += sampler.simplex_faces().rows();
+				simplex_elements.push_back(i);
 			}
 			else if (mesh.is_cube(i))
 			{
 				pts_total_size += sampler.cube_points().rows();
 				seg_total_size += sampler.cube_edges().rows();
 				faces_total_size += sampler.cube_faces().rows();
+				cube_elements.push_back(i);
 			}
 			else
 			{
@@ -1891,35 +2167,40 @@ namespace polyfem::io
 		Eigen::MatrixXi faces(faces_total_size, 3);
 		points.setZero();
 
+		Eigen::MatrixXd simplex_mapped, cube_mapped;
+		basis::ElementBases::eval_geom_mapping(current_bases, simplex_elements, sampler.simplex_points(), simplex_mapped);
+		basis::ElementBases::eval_geom_mapping(current_bases, cube_elements, sampler.cube_points(), cube_mapped);
+		const int n_simplex_pts = sampler.simplex_points().rows();
+		const int n_cube_pts = sampler.cube_points().rows();
+
 		Eigen::MatrixXd mapped, tmp;
 		int seg_index = 0, pts_index = 0, face_index = 0;
+		int simplex_index = 0, cube_index = 0;
 		for (size_t i = 0; i < current_bases.size(); ++i)
 		{
 			const auto &bs = current_bases[i];
 
 			if (mesh.is_simplex(i))
 			{
-				bs.eval_geom_mapping(sampler.simplex_points(), mapped);
 				edges.block(seg_index, 0, sampler.simplex_edges().rows(), edges.cols()) = sampler.simplex_edges().array() + pts_index;
 				seg_index += sampler.simplex_edges().rows();
 
 				faces.block(face_index, 0, sampler.simplex_faces().rows(), 3) = sampler.simplex_faces().array() + pts_index;
 				face_index += sampler.simplex_faces().rows();
 
-				points.block(pts_index, 0, mapped.rows(), points.cols()) = mapped;
-				pts_index += mapped.rows();
+				points.block(pts_index, 0, n_simplex_pts, points.cols()) = simplex_mapped.middleRows(simplex_index++ * n_simplex_pts, n_simplex_pts);
+				pts_index += n_simplex_pts;
 			}
 			else if (mesh.is_cube(i))
 			{
-				bs.eval_geom_mapping(sampler.cube_points(), mapped);
 				edges.block(seg_index, 0, sampler.cube_edges().rows(), edges.cols()) = sampler.cube_edges().array() + pts_index;
 				seg_index += sampler.cube_edges().rows();
 
 				faces.block(face_index, 0, sampler.cube_faces().rows(), 3) = sampler.cube_faces().array() + pts_index;
 				face_index += sampler.cube_faces().rows();
 
-				points.block(pts_index, 0, mapped.rows(), points.cols()) = mapped;
-				pts_index += mapped.rows();
+				points.block(pts_index, 0, n_cube_pts, points.cols()) = cube_mapped.middleRows(cube_index++ * n_cube_pts, n_cube_pts);
+				pts_index += n_cube_pts;
 			}
 			else
 			{
@@ -1991,32 +2272,34 @@ namespace polyfem::io
 			err = (fun - exact_fun).eval().rowwise().norm();
 		}
 
-		std::shared_ptr<paraviewo::ParaviewWriter> tmpw;
-		if (opts.use_hdf5)
-			tmpw = std::make_shared<paraviewo::HDF5VTUWriter>();
-		else
-			tmpw = std::make_shared<paraviewo::VTUWriter>();
-		paraviewo::ParaviewWriter &writer = *tmpw;
+		FieldWriter writer(opts, vtkhdf_series(opts, "_wire"), t);
 
 		if (problem.has_exact_sol())
 		{
-			writer.add_field("exact", exact_fun);
-			writer.add_field("error", err);
+			if (opts.export_field("exact"))
+				writer.add_field("exact", exact_fun);
+			if (opts.export_field("error"))
+				writer.add_field("error", err);
 		}
 
-		if (fun.cols() != 1)
+		const std::vector<std::string> scalar_names = state.assembler->scalar_value_names();
+		if (fun.cols() != 1 && std::any_of(scalar_names.begin(), scalar_names.end(), [&](const std::string &n) { return opts.export_field(n); }))
 		{
 			std::vector<assembler::Assembler::NamedMatrix> scalar_val;
 			Evaluator::compute_scalar_value(
 				mesh, problem.is_scalar(), state.bases, gbases,
 				state.disc_orders, state.polys, state.polys_3d,
 				*state.assembler,
-				ref_element_sampler, pts_index, sol, scalar_val, /*use_sampler*/ true, false);
+				ref_element_sampler, pts_index, sol, scalar_val, /*use_sampler*/ true, false, &stress_field_);
 			for (const auto &v : scalar_val)
-				writer.add_field(v.first, v.second);
+			{
+				if (opts.export_field(v.first))
+					writer.add_field(v.first, v.second);
+			}
 		}
 		// Write the solution last so it is the default for warp-by-vector
-		writer.add_field("solution", fun);
+		if (opts.export_field("solution"))
+			writer.add_field("solution", fun);
 
 		writer.write_mesh(name, points, edges);
 	}
@@ -2025,6 +2308,7 @@ namespace polyfem::io
 		const std::string &path,
 		const State &state,
 		const Eigen::MatrixXd &sol,
+		const double t,
 		const ExportOptions &opts,
 		std::vector<SolutionFrame> &solution_frames) const
 	{
@@ -2061,12 +2345,7 @@ namespace polyfem::io
 			cells[i].push_back(i);
 		}
 
-		std::shared_ptr<paraviewo::ParaviewWriter> tmpw;
-		if (opts.use_hdf5)
-			tmpw = std::make_shared<paraviewo::HDF5VTUWriter>();
-		else
-			tmpw = std::make_shared<paraviewo::VTUWriter>();
-		paraviewo::ParaviewWriter &writer = *tmpw;
+		FieldWriter writer(opts, vtkhdf_series(opts, "_points"), t);
 
 		if (opts.solve_export_to_file)
 		{
@@ -2088,6 +2367,7 @@ namespace polyfem::io
 	void OutGeometryData::init_sampler(const polyfem::mesh::Mesh &mesh, const double vismesh_rel_area)
 	{
 		ref_element_sampler.init(mesh.is_volume(), mesh.n_elements(), vismesh_rel_area);
+		clear_vis_cache();
 	}
 
 	void OutGeometryData::build_grid(const polyfem::mesh::Mesh &mesh, const double spacing)
@@ -2130,67 +2410,18 @@ namespace polyfem::io
 
 		assert(index == n);
 
-		std::vector<std::array<Eigen::Vector3d, 2>> boxes;
-		mesh.elements_boxes(boxes);
-
-		BVH::BVH bvh;
-		bvh.init(boxes);
-
-		const double eps = 1e-6;
-
-		grid_points_to_elements.resize(grid_points.rows(), 1);
-		grid_points_to_elements.setConstant(-1);
-
-		grid_points_bc.resize(grid_points.rows(), mesh.is_volume() ? 4 : 3);
-
-		for (int i = 0; i < grid_points.rows(); ++i)
-		{
-			const Eigen::Vector3d min(
-				grid_points(i, 0) - eps,
-				grid_points(i, 1) - eps,
-				(mesh.is_volume() ? grid_points(i, 2) : 0) - eps);
-
-			const Eigen::Vector3d max(
-				grid_points(i, 0) + eps,
-				grid_points(i, 1) + eps,
-				(mesh.is_volume() ? grid_points(i, 2) : 0) + eps);
-
-			std::vector<unsigned int> candidates;
-
-			bvh.intersect_box(min, max, candidates);
-
-			for (const auto cand : candidates)
-			{
-				if (!mesh.is_simplex(cand))
-				{
-					logger().warn("Element {} is not simplex, skipping", cand);
-					continue;
-				}
-
-				Eigen::MatrixXd coords;
-				mesh.barycentric_coords(grid_points.row(i), cand, coords);
-
-				for (int d = 0; d < coords.size(); ++d)
-				{
-					if (fabs(coords(d)) < 1e-8)
-						coords(d) = 0;
-					else if (fabs(coords(d) - 1) < 1e-8)
-						coords(d) = 1;
-				}
-
-				if (coords.array().minCoeff() >= 0 && coords.array().maxCoeff() <= 1)
-				{
-					grid_points_to_elements(i) = cand;
-					grid_points_bc.row(i) = coords;
-					break;
-				}
-			}
-		}
+		const mesh::PointLocator locator(mesh);
+		locator.locate(grid_points, grid_points_to_elements, grid_points_bc);
 	}
 
 	void OutStatsData::compute_mesh_size(const polyfem::mesh::Mesh &mesh_in, const std::vector<polyfem::basis::ElementBases> &bases_in, const int n_samples, const bool use_curved_mesh_size)
 	{
-		Eigen::MatrixXd samples_simplex, samples_cube, mapped, p0, p1, p;
+		compute_element_stats(mesh_in, bases_in, n_samples, use_curved_mesh_size, false);
+	}
+
+	void OutStatsData::compute_element_stats(const polyfem::mesh::Mesh &mesh, const std::vector<polyfem::basis::ElementBases> &gbases, const int n_samples, const bool use_curved_mesh_size, const bool count_flipped)
+	{
+		using namespace mesh;
 
 		mesh_size = 0;
 		average_edge_length = 0;
@@ -2198,100 +2429,112 @@ namespace polyfem::io
 
 		if (!use_curved_mesh_size)
 		{
-			mesh_in.get_edges(p0, p1);
-			p = p0 - p1;
-			min_edge_length = p.rowwise().norm().minCoeff();
-			average_edge_length = p.rowwise().norm().mean();
-			mesh_size = p.rowwise().norm().maxCoeff();
-
-			logger().info("hmin: {}", min_edge_length);
-			logger().info("hmax: {}", mesh_size);
-			logger().info("havg: {}", average_edge_length);
-
-			return;
+			Eigen::MatrixXd p0, p1;
+			mesh.get_edges(p0, p1);
+			const Eigen::VectorXd lengths = (p0 - p1).rowwise().norm();
+			min_edge_length = lengths.minCoeff();
+			average_edge_length = lengths.mean();
+			mesh_size = lengths.maxCoeff();
 		}
 
-		if (mesh_in.is_volume())
-		{
-			utils::EdgeSampler::sample_3d_simplex(n_samples, samples_simplex);
-			utils::EdgeSampler::sample_3d_cube(n_samples, samples_cube);
-		}
-		else
-		{
-			utils::EdgeSampler::sample_2d_simplex(n_samples, samples_simplex);
-			utils::EdgeSampler::sample_2d_cube(n_samples, samples_cube);
-		}
+		if (count_flipped)
+			logger().info("Counting flipped elements...");
 
-		int n = 0;
-		for (size_t i = 0; i < bases_in.size(); ++i)
+		if (use_curved_mesh_size || count_flipped)
 		{
-			if (mesh_in.is_polytope(i))
-				continue;
-			int n_edges;
-
-			if (mesh_in.is_simplex(i))
-			{
-				n_edges = mesh_in.is_volume() ? 6 : 3;
-				bases_in[i].eval_geom_mapping(samples_simplex, mapped);
-			}
-			else
+			Eigen::MatrixXd samples_simplex, samples_cube;
+			if (use_curved_mesh_size)
 			{
-				n_edges = mesh_in.is_volume() ? 12 : 4;
-				bases_in[i].eval_geom_mapping(samples_cube, mapped);
+				if (mesh.is_volume())
+				{
+					utils::EdgeSampler::sample_3d_simplex(n_samples, samples_simplex);
+					utils::EdgeSampler::sample_3d_cube(n_samples, samples_cube);
+				}
+				else
+				{
+					utils::EdgeSampler::sample_2d_simplex(n_samples, samples_simplex);
+					utils::EdgeSampler::sample_2d_cube(n_samples, samples_cube);
+				}
 			}
 
-			for (int j = 0; j < n_edges; ++j)
+			struct LocalThreadStatsStorage
 			{
-				double current_edge = 0;
-				for (int k = 0; k < n_samples - 1; ++k)
-				{
-					p0 = mapped.row(j * n_samples + k);
-					p1 = mapped.row(j * n_samples + k + 1);
-					p = p0 - p1;
+				Eigen::MatrixXd mapped;
+				polyfem::assembler::ElementAssemblyValues vals;
+				double min_edge_length = std::numeric_limits<double>::max();
+				double max_edge_length = 0;
+				int n_edges = 0;
+				std::vector<int> flipped;
+			};
+			auto storage = utils::create_thread_storage(LocalThreadStatsStorage());
 
-					current_edge += p.norm();
-				}
+			// sum of the curved edge lengths of every element, summed in the element order so that the average does not depend on the threads
+			const int n_el = int(gbases.size());
+			Eigen::VectorXd edge_length_sums = Eigen::VectorXd::Zero(n_el);
 
-				mesh_size = std::max(current_edge, mesh_size);
-				min_edge_length = std::min(current_edge, min_edge_length);
-				average_edge_length += current_edge;
-				++n;
-			}
-		}
+			utils::maybe_parallel_for(n_el, [&](int start, int end, int thread_id) {
+				LocalThreadStatsStorage &local_storage = utils::get_local_thread_storage(storage, thread_id);
+				Eigen::MatrixXd &mapped = local_storage.mapped;
+				std::vector<int> simplex_elements, cube_elements;
 
-		average_edge_length /= n;
+				for (int e = start; e < end; ++e)
+				{
+					if (mesh.is_polytope(e))
+						continue;
 
-		logger().info("hmin: {}", min_edge_length);
-		logger().info("hmax: {}", mesh_size);
-		logger().info("havg: {}", average_edge_length);
-	}
+					if (count_flipped && !local_storage.vals.is_geom_mapping_positive(mesh.is_volume(), gbases[e]))
+						local_storage.flipped.push_back(e);
 
-	void OutStatsData::reset()
-	{
-		sigma_avg = 0;
-		sigma_max = 0;
-		sigma_min = 0;
+					if (mesh.is_simplex(e))
+						simplex_elements.push_back(e);
+					else
+						cube_elements.push_back(e);
+				}
 
-		n_flipped = 0;
-	}
+				if (!use_curved_mesh_size)
+					return;
 
-	void OutStatsData::count_flipped_elements(const polyfem::mesh::Mesh &mesh, const std::vector<polyfem::basis::ElementBases> &gbases)
-	{
-		using namespace mesh;
+				// the edge samples of the elements of the range are mapped in one batch per element type
+				for (const bool simplex : {true, false})
+				{
+					const std::vector<int> &elements = simplex ? simplex_elements : cube_elements;
+					const Eigen::MatrixXd &samples = simplex ? samples_simplex : samples_cube;
+					const int n_edges = simplex ? (mesh.is_volume() ? 6 : 3) : (mesh.is_volume() ? 12 : 4);
+					basis::ElementBases::eval_geom_mapping(gbases, elements, samples, mapped);
 
-		logger().info("Counting flipped elements...");
-		const auto &els_tag = mesh.elements_tag();
+					for (size_t i = 0; i < elements.size(); ++i)
+					{
+						const int offset = i * samples.rows();
+						for (int j = 0; j < n_edges; ++j)
+						{
+							double current_edge = 0;
+							for (int k = 0; k < n_samples - 1; ++k)
+								current_edge += (mapped.row(offset + j * n_samples + k) - mapped.row(offset + j * n_samples + k + 1)).norm();
+
+							local_storage.max_edge_length = std::max(current_edge, local_storage.max_edge_length);
+							local_storage.min_edge_length = std::min(current_edge, local_storage.min_edge_length);
+							edge_length_sums[elements[i]] += current_edge;
+							++local_storage.n_edges;
+						}
+					}
+				}
+			});
 
-		// flipped_elements.clear();
-		for (size_t i = 0; i < gbases.size(); ++i)
-		{
-			if (mesh.is_polytope(i))
-				continue;
+			int n = 0;
+			std::vector<int> flipped;
+			for (const auto &local_storage : storage)
+			{
+				mesh_size = std::max(mesh_size, local_storage.max_edge_length);
+				min_edge_length = std::min(min_edge_length, local_storage.min_edge_length);
+				n += local_storage.n_edges;
+				flipped.insert(flipped.end(), local_storage.flipped.begin(), local_storage.flipped.end());
+			}
+			if (use_curved_mesh_size)
+				average_edge_length = edge_length_sums.sum() / n;
 
-			polyfem::assembler::ElementAssemblyValues vals;
-			if (!vals.is_geom_mapping_positive(mesh.is_volume(), gbases[i]))
+			if (!flipped.empty())
 			{
-				++n_flipped;
+				n_flipped += flipped.size();
 
 				static const std::vector<std::string> element_type_names{{
 					"Simplex",
@@ -2307,23 +2550,39 @@ namespace polyfem::io
 					"Undefined",
 				}};
 
-				log_and_throw_error("element {} is flipped, type {}", i, element_type_names[static_cast<int>(els_tag[i])]);
+				// the first flipped element in the element order is reported
+				const int e = *std::min_element(flipped.begin(), flipped.end());
+				log_and_throw_error("element {} is flipped, type {}", e, element_type_names[static_cast<int>(mesh.elements_tag()[e])]);
 			}
 		}
 
-		logger().info(" done");
+		if (count_flipped)
+			logger().info(" done");
+
+		logger().info("hmin: {}", min_edge_length);
+		logger().info("hmax: {}", mesh_size);
+		logger().info("havg: {}", average_edge_length);
+	}
+
+	void OutStatsData::reset()
+	{
+		sigma_avg = 0;
+		sigma_max = 0;
+		sigma_min = 0;
 
-		// dynamic_cast<Mesh3D *>(mesh.get())->save({56}, 1, "mesh.HYBRID");
+		n_flipped = 0;
+	}
 
-		// std::sort(flipped_elements.begin(), flipped_elements.end());
-		// auto it = std::unique(flipped_elements.begin(), flipped_elements.end());
-		// flipped_elements.resize(std::distance(flipped_elements.begin(), it));
+	void OutStatsData::count_flipped_elements(const polyfem::mesh::Mesh &mesh, const std::vector<polyfem::basis::ElementBases> &gbases)
+	{
+		compute_element_stats(mesh, gbases, 0, false, true);
 	}
 
 	void OutStatsData::compute_errors(
 		const int n_bases,
 		const std::vector<polyfem::basis::ElementBases> &bases,
 		const std::vector<polyfem::basis::ElementBases> &gbases,
+		const assembler::AssemblyValsCache &cache,
 		const polyfem::mesh::Mesh &mesh,
 		const assembler::Problem &problem,
 		const double tend,
@@ -2351,9 +2610,6 @@ namespace polyfem::io
 
 		const int n_el = int(bases.size());
 
-		Eigen::MatrixXd v_exact, v_approx;
-		Eigen::MatrixXd v_exact_grad(0, 0), v_approx_grad;
-
 		l2_err = 0;
 		h1_err = 0;
 		grad_max_err = 0;
@@ -2364,94 +2620,127 @@ namespace polyfem::io
 
 		static const int p = 8;
 
-		// Eigen::MatrixXd err_per_el(n_el, 5);
-		polyfem::assembler::ElementAssemblyValues vals;
-
-		for (int e = 0; e < n_el; ++e)
+		struct LocalThreadErrorStorage
 		{
-			vals.compute(e, mesh.is_volume(), bases[e], gbases[e]);
+			polyfem::assembler::ElementAssemblyValues vals;
+			Eigen::MatrixXd v_exact, v_approx;
+			Eigen::MatrixXd v_exact_grad, v_approx_grad;
+		};
+		auto storage = utils::create_thread_storage(LocalThreadErrorStorage());
 
-			if (problem.has_exact_sol())
-			{
-				problem.exact(vals.val, tend, v_exact);
-				problem.exact_grad(vals.val, tend, v_exact_grad);
-			}
+		// per element integrals, summed in a fixed order so that the errors do not depend on the number of threads
+		Eigen::VectorXd l2_per_el(n_el), h1_per_el(n_el), lp_per_el(n_el), linf_per_el(n_el);
+		// the cache stores floats in single precision mode, not accurate enough for convergence studies
+		const bool use_cache = !cache.is_single_precision();
+
+		// Eigen::MatrixXd err_per_el(n_el, 5);
+		utils::maybe_parallel_for(n_el, [&](int start, int end, int thread_id) {
+			LocalThreadErrorStorage &local_storage = utils::get_local_thread_storage(storage, thread_id);
+			polyfem::assembler::ElementAssemblyValues &vals = local_storage.vals;
+			Eigen::MatrixXd &v_exact = local_storage.v_exact;
+			Eigen::MatrixXd &v_approx = local_storage.v_approx;
+			Eigen::MatrixXd &v_exact_grad = local_storage.v_exact_grad;
+			Eigen::MatrixXd &v_approx_grad = local_storage.v_approx_grad;
+
+			for (int e = start; e < end; ++e)
+			{
+				if (use_cache)
+					cache.compute(e, mesh.is_volume(), bases[e], gbases[e], vals);
+				else
+					vals.compute(e, mesh.is_volume(), bases[e], gbases[e]);
 
-			v_approx.resize(vals.val.rows(), actual_dim);
-			v_approx.setZero();
+				// value and gradient come from the same evaluation of the exact solution
+				if (problem.has_exact_sol())
+					problem.exact_with_grad(vals.val, tend, v_exact, v_exact_grad);
 
-			v_approx_grad.resize(vals.val.rows(), mesh.dimension() * actual_dim);
-			v_approx_grad.setZero();
+				v_approx.resize(vals.val.rows(), actual_dim);
+				v_approx.setZero();
 
-			const int n_loc_bases = int(vals.basis_values.size());
+				v_approx_grad.resize(vals.val.rows(), mesh.dimension() * actual_dim);
+				v_approx_grad.setZero();
 
-			for (int i = 0; i < n_loc_bases; ++i)
-			{
-				const auto &val = vals.basis_values[i];
+				const int n_loc_bases = int(vals.basis_values.size());
 
-				for (size_t ii = 0; ii < val.global.size(); ++ii)
+				for (int i = 0; i < n_loc_bases; ++i)
 				{
-					for (int d = 0; d < actual_dim; ++d)
+					const auto &val = vals.basis_values[i];
+
+					for (size_t ii = 0; ii < val.global.size(); ++ii)
 					{
-						v_approx.col(d) += val.global[ii].val * sol(val.global[ii].index * actual_dim + d) * val.val;
-						v_approx_grad.block(0, d * val.grad_t_m.cols(), v_approx_grad.rows(), val.grad_t_m.cols()) += val.global[ii].val * sol(val.global[ii].index * actual_dim + d) * val.grad_t_m;
+						for (int d = 0; d < actual_dim; ++d)
+						{
+							v_approx.col(d) += val.global[ii].val * sol(val.global[ii].index * actual_dim + d) * val.val;
+							v_approx_grad.block(0, d * val.grad_t_m.cols(), v_approx_grad.rows(), val.grad_t_m.cols()) += val.global[ii].val * sol(val.global[ii].index * actual_dim + d) * val.grad_t_m;
+						}
 					}
 				}
-			}
-
-			const auto err = problem.has_exact_sol() ? (v_exact - v_approx).eval().rowwise().norm().eval() : (v_approx).eval().rowwise().norm().eval();
-			const auto err_grad = problem.has_exact_sol() ? (v_exact_grad - v_approx_grad).eval().rowwise().norm().eval() : (v_approx_grad).eval().rowwise().norm().eval();
-
-			// for(long i = 0; i < err.size(); ++i)
-			// errors.push_back(err(i));
-
-			linf_err = std::max(linf_err, err.maxCoeff());
-			grad_max_err = std::max(linf_err, err_grad.maxCoeff());
-
-			// {
-			// 	const auto &mesh3d = *dynamic_cast<Mesh3D *>(mesh.get());
-			// 	const auto v0 = mesh3d.point(mesh3d.cell_vertex(e, 0));
-			// 	const auto v1 = mesh3d.point(mesh3d.cell_vertex(e, 1));
-			// 	const auto v2 = mesh3d.point(mesh3d.cell_vertex(e, 2));
-			// 	const auto v3 = mesh3d.point(mesh3d.cell_vertex(e, 3));
-
-			// 	Eigen::Matrix<double, 6, 3> ee;
-			// 	ee.row(0) = v0 - v1;
-			// 	ee.row(1) = v1 - v2;
-			// 	ee.row(2) = v2 - v0;
-
-			// 	ee.row(3) = v0 - v3;
-			// 	ee.row(4) = v1 - v3;
-			// 	ee.row(5) = v2 - v3;
-
-			// 	Eigen::Matrix<double, 6, 1> en = ee.rowwise().norm();
 
-			// 	// Eigen::Matrix<double, 3*4, 1> alpha;
-			// 	// alpha(0) = angle3(e.row(0), -e.row(1));	 	alpha(1) = angle3(e.row(1), -e.row(2));	 	alpha(2) = angle3(e.row(2), -e.row(0));
-			// 	// alpha(3) = angle3(e.row(0), -e.row(4));	 	alpha(4) = angle3(e.row(4), e.row(3));	 	alpha(5) = angle3(-e.row(3), -e.row(0));
-			// 	// alpha(6) = angle3(-e.row(4), -e.row(1));	alpha(7) = angle3(e.row(1), -e.row(5));	 	alpha(8) = angle3(e.row(5), e.row(4));
-			// 	// alpha(9) = angle3(-e.row(2), -e.row(5));	alpha(10) = angle3(e.row(5), e.row(3));		alpha(11) = angle3(-e.row(3), e.row(2));
-
-			// 	const double S = (ee.row(0).cross(ee.row(1)).norm() + ee.row(0).cross(ee.row(4)).norm() + ee.row(4).cross(ee.row(1)).norm() + ee.row(2).cross(ee.row(5)).norm()) / 2;
-			// 	const double V = std::abs(ee.row(3).dot(ee.row(2).cross(-ee.row(0))))/6;
-			// 	const double rho = 3 * V / S;
-			// 	const double hp = en.maxCoeff();
-			// 	const int pp = disc_orders(e);
-			// 	const int p_ref = args["space"]["discr_order"];
+				const auto err = problem.has_exact_sol() ? (v_exact - v_approx).eval().rowwise().norm().eval() : (v_approx).eval().rowwise().norm().eval();
+				const auto err_grad = problem.has_exact_sol() ? (v_exact_grad - v_approx_grad).eval().rowwise().norm().eval() : (v_approx_grad).eval().rowwise().norm().eval();
+
+				linf_per_el[e] = err.maxCoeff();
+				// the reported gradient error is the max of the Linf error and of the gradient error of the last element
+				if (e == n_el - 1)
+					grad_max_err = err_grad.maxCoeff();
+
+				// for(long i = 0; i < err.size(); ++i)
+				// errors.push_back(err(i));
+
+				linf_err = std::max(linf_err, err.maxCoeff());
+				grad_max_err = std::max(linf_err, err_grad.maxCoeff());
+
+				// {
+				// 	const auto &mesh3d = *dynamic_cast<Mesh3D *>(mesh.get());
+				// 	const auto v0 = mesh3d.point(mesh3d.cell_vertex(e, 0));
+				// 	const auto v1 = mesh3d.point(mesh3d.cell_vertex(e, 1));
+				// 	const auto v2 = mesh3d.point(mesh3d.cell_vertex(e, 2));
+				// 	const auto v3 = mesh3d.point(mesh3d.cell_vertex(e, 3));
+
+				// 	Eigen::Matrix<double, 6, 3> ee;
+				// 	ee.row(0) = v0 - v1;
+				// 	ee.row(1) = v1 - v2;
+				// 	ee.row(2) = v2 - v0;
+
+				// 	ee.row(3) = v0 - v3;
+				// 	ee.row(4) = v1 - v3;
+				// 	ee.row(5) = v2 - v3;
+
+				// 	Eigen::Matrix<double, 6, 1> en = ee.rowwise().norm();
+
+				// 	// Eigen::Matrix<double, 3*4, 1> alpha;
+				// 	// alpha(0) = angle3(e.row(0), -e.row(1));	 	alpha(1) = angle3(e.row(1), -e.row(2));	 	alpha(2) = angle3(e.row(2), -e.row(0));
+				// 	// alpha(3) = angle3(e.row(0), -e.row(4));	 	alpha(4) = angle3(e.row(4), e.row(3));	 	alpha(5) = angle3(-e.row(3), -e.row(0));
+				// 	// alpha(6) = angle3(-e.row(4), -e.row(1));	alpha(7) = angle3(e.row(1), -e.row(5));	 	alpha(8) = angle3(e.row(5), e.row(4));
+				// 	// alpha(9) = angle3(-e.row(2), -e.row(5));	alpha(10) = angle3(e.row(5), e.row(3));		alpha(11) = angle3(-e.row(3), e.row(2));
+
+				// 	const double S = (ee.row(0).cross(ee.row(1)).norm() + ee.row(0).cross(ee.row(4)).norm() + ee.row(4).cross(ee.row(1)).norm() + ee.row(2).cross(ee.row(5)).norm()) / 2;
+				// 	const double V = std::abs(ee.row(3).dot(ee.row(2).cross(-ee.row(0))))/6;
+				// 	const double rho = 3 * V / S;
+				// 	const double hp = en.maxCoeff();
+				// 	const int pp = disc_orders(e);
+				// 	const int p_ref = args["space"]["discr_order"];
+
+				// 	err_per_el(e, 0) = err.mean();
+				// 	err_per_el(e, 1) = err.maxCoeff();
+				// 	err_per_el(e, 2) = std::pow(hp, pp+1)/(rho/hp); // /std::pow(average_edge_length, p_ref+1) * (sqrt(6)/12);
+				// 	err_per_el(e, 3) = rho/hp;
+				// 	err_per_el(e, 4) = (vals.det.array() * vals.quadrature.weights.array()).sum();
+
+				// 	// pred_norm += (pow(std::pow(hp, pp+1)/(rho/hp),p) * vals.det.array() * vals.quadrature.weights.array()).sum();
+				// }
 
-			// 	err_per_el(e, 0) = err.mean();
-			// 	err_per_el(e, 1) = err.maxCoeff();
-			// 	err_per_el(e, 2) = std::pow(hp, pp+1)/(rho/hp); // /std::pow(average_edge_length, p_ref+1) * (sqrt(6)/12);
-			// 	err_per_el(e, 3) = rho/hp;
-			// 	err_per_el(e, 4) = (vals.det.array() * vals.quadrature.weights.array()).sum();
+				const Eigen::ArrayXd da = vals.det.array() * vals.quadrature.weights.array();
+				l2_per_el[e] = (err.array() * err.array() * da).sum();
+				h1_per_el[e] = (err_grad.array() * err_grad.array() * da).sum();
+				lp_per_el[e] = (err.array().pow(p) * da).sum();
+			}
+		});
 
-			// 	// pred_norm += (pow(std::pow(hp, pp+1)/(rho/hp),p) * vals.det.array() * vals.quadrature.weights.array()).sum();
-			// }
-
-			l2_err += (err.array() * err.array() * vals.det.array() * vals.quadrature.weights.array()).sum();
-			h1_err += (err_grad.array() * err_grad.array() * vals.det.array() * vals.quadrature.weights.array()).sum();
-			lp_err += (err.array().pow(p) * vals.det.array() * vals.quadrature.weights.array()).sum();
-		}
+		l2_err = pairwise_sum(l2_per_el);
+		h1_err = pairwise_sum(h1_per_el);
+		lp_err = pairwise_sum(lp_per_el);
+		linf_err = n_el > 0 ? linf_per_el.maxCoeff() : 0;
+		grad_max_err = std::max(linf_err, grad_max_err);
 
 		h1_semi_err = sqrt(fabs(h1_err));
 		h1_err = sqrt(fabs(l2_err) + fabs(h1_err));
@@ -2485,60 +2774,40 @@ namespace polyfem::io
 	{
 		using namespace polyfem::mesh;
 
-		simplex_count = 0;
-		regular_count = 0;
-		regular_boundary_count = 0;
-		simple_singular_count = 0;
-		multi_singular_count = 0;
-		boundary_count = 0;
-		non_regular_boundary_count = 0;
-		non_regular_count = 0;
-		undefined_count = 0;
-		multi_singular_boundary_count = 0;
-
 		const auto &els_tag = mesh.elements_tag();
 
-		for (size_t i = 0; i < els_tag.size(); ++i)
-		{
-			const ElementType type = els_tag[i];
-
-			switch (type)
-			{
-			case ElementType::SIMPLEX:
-				simplex_count++;
-				break;
-			case ElementType::REGULAR_INTERIOR_CUBE:
-				regular_count++;
-				break;
-			case ElementType::REGULAR_BOUNDARY_CUBE:
-				regular_boundary_count++;
-				break;
-			case ElementType::SIMPLE_SINGULAR_INTERIOR_CUBE:
-				simple_singular_count++;
-				break;
-			case ElementType::MULTI_SINGULAR_INTERIOR_CUBE:
-				multi_singular_count++;
-				break;
-			case ElementType::SIMPLE_SINGULAR_BOUNDARY_CUBE:
-				boundary_count++;
-				break;
-			case ElementType::INTERFACE_CUBE:
-			case ElementType::MULTI_SINGULAR_BOUNDARY_CUBE:
-				multi_singular_boundary_count++;
-				break;
-			case ElementType::BOUNDARY_POLYTOPE:
-				non_regular_boundary_count++;
-				break;
-			case ElementType::INTERIOR_POLYTOPE:
-				non_regular_count++;
-				break;
-			case ElementType::UNDEFINED:
-				undefined_count++;
-				break;
-			default:
-				throw std::runtime_error("Unknown element type");
+		// number of elements of every type, counted per thread
+		constexpr int n_types = static_cast<int>(ElementType::UNDEFINED) + 1;
+		auto storage = utils::create_thread_storage(std::array<int, n_types>{});
+		utils::maybe_parallel_for(els_tag.size(), [&](int start, int end, int thread_id) {
+			std::array<int, n_types> &local_counts = utils::get_local_thread_storage(storage, thread_id);
+			for (int i = start; i < end; ++i)
+			{
+				const int type = static_cast<int>(els_tag[i]);
+				if (type < 0 || type >= n_types)
+					throw std::runtime_error("Unknown element type");
+				local_counts[type]++;
 			}
+		});
+
+		std::array<int, n_types> counts{};
+		for (const auto &local_counts : storage)
+		{
+			for (int t = 0; t < n_types; ++t)
+				counts[t] += local_counts[t];
 		}
+		const auto count = [&](const ElementType type) { return counts[static_cast<int>(type)]; };
+
+		simplex_count = count(ElementType::SIMPLEX);
+		regular_count = count(ElementType::REGULAR_INTERIOR_CUBE);
+		regular_boundary_count = count(ElementType::REGULAR_BOUNDARY_CUBE);
+		simple_singular_count = count(ElementType::SIMPLE_SINGULAR_INTERIOR_CUBE);
+		multi_singular_count = count(ElementType::MULTI_SINGULAR_INTERIOR_CUBE);
+		boundary_count = count(ElementType::SIMPLE_SINGULAR_BOUNDARY_CUBE);
+		multi_singular_boundary_count = count(ElementType::INTERFACE_CUBE) + count(ElementType::MULTI_SINGULAR_BOUNDARY_CUBE);
+		non_regular_boundary_count = count(ElementType::BOUNDARY_POLYTOPE);
+		non_regular_count = count(ElementType::INTERIOR_POLYTOPE);
+		undefined_count = count(ElementType::UNDEFINED);
 
 		logger().info("simplex_count: \t{}", simplex_count);
 		logger().info("regular_count: \t{}", regular_count);
@@ -2553,6 +2822,31 @@ namespace polyfem::io
 		logger().info("total count:\t {}", mesh.n_elements());
 	}
 
+	size_t OutRuntimeData::current_memory()
+	{
+		return getCurrentRSS();
+	}
+
+	void OutRuntimeData::track_memory(const std::string &name, const size_t bytes)
+	{
+		size_t &val = container_memory[name];
+		val = std::max(val, bytes);
+	}
+
+	void OutRuntimeData::sample_memory(const std::string &phase)
+	{
+		const size_t rss = getCurrentRSS();
+		for (auto &[name, bytes] : phase_memory)
+		{
+			if (name == phase)
+			{
+				bytes = rss;
+				return;
+			}
+		}
+		phase_memory.emplace_back(phase, rss);
+	}
+
 	void OutStatsData::save_json(
 		const nlohmann::json &args,
 		const int n_bases, const int n_pressure_bases,
@@ -2619,6 +2913,7 @@ namespace polyfem::io
 		j["time_assembling_mass_mat"] = runtime.assembling_mass_mat_time;
 		j["time_assigning_rhs"] = runtime.assigning_rhs_time;
 		j["time_solving"] = runtime.solving_time;
+		j["time_assembling_merge"] = runtime.assembling_merge_time;
 		// j["time_computing_errors"] = runtime.computing_errors_time;
 
 		j["solver_info"] = solver_info;
@@ -2638,6 +2933,17 @@ namespace polyfem::io
 
 		j["peak_memory"] = getPeakRSS() / (1024 * 1024);
 
+		// MB, the tracked containers may be freed before the end of the run
+		json memory_phases = json::object();
+		for (const auto &[phase, bytes] : runtime.phase_memory)
+			memory_phases[phase] = bytes / (1024. * 1024.);
+		j["memory_phases"] = memory_phases;
+
+		json memory_containers = json::object();
+		for (const auto &[name, bytes] : runtime.container_memory)
+			memory_containers[name] = bytes / (1024. * 1024.);
+		j["memory_containers"] = memory_containers;
+
 		const int actual_dim = problem.is_scalar() ? 1 : mesh.dimension();
 
 		std::vector<double> mmin(actual_dim);
@@ -2,6 +2,7 @@
 
 #include <polyfem/Common.hpp>
 
+#include <polyfem/assembler/AssemblyValsCache.hpp>
 #include <polyfem/assembler/Problem.hpp>
 
 #include <polyfem/basis/ElementBases.hpp>
@@ -13,8 +14,17 @@
 #include <paraviewo/HDF5VTUWriter.hpp>
 
 #include <polyfem/utils/RefElementSampler.hpp>
+#include <polyfem/io/SolutionFrame.hpp>
+#include <polyfem/io/StressField.hpp>
+#include <polyfem/io/VTKHDFWriter.hpp>
 
 #include <Eigen/Dense>
+#include <Eigen/Sparse>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 
 namespace polyfem
 {
@@ -23,25 +33,24 @@ namespace polyfem
 
 namespace polyfem::io
 {
-	/// class used to save the solution of time dependent problems in code instead of saving it to the disc
-	class SolutionFrame
-	{
-	public:
-		std::string name;
-		Eigen::MatrixXd points;
-		Eigen::MatrixXi connectivity;
-		Eigen::MatrixXd solution;
-		Eigen::MatrixXd pressure;
-		Eigen::MatrixXd exact;
-		Eigen::MatrixXd error;
-		Eigen::MatrixXd scalar_value;
-		Eigen::MatrixXd scalar_value_avg;
-	};
-
 	/// Utilies related to export of geometry
 	class OutGeometryData
 	{
 	public:
+		/// @brief Solver quantities which change during the simulation, copied when an export is
+		/// deferred (e.g., to an OutputQueue) so it does not read the live solver state.
+		struct SolverSnapshot
+		{
+			Eigen::VectorXd velocity;               ///< velocity of the time integrator, empty if none
+			Eigen::VectorXd acceleration;           ///< acceleration of the time integrator, empty if none
+			double barrier_stiffness = 1;           ///< barrier stiffness of the contact form
+			Eigen::MatrixXd displaced_surface_prev; ///< lagged surface of the friction form, empty if none
+
+			/// @brief copy the quantities from the solver state
+			/// @param[in] state state holding the solver data
+			SolverSnapshot(const State &state);
+		};
+
 		/// @brief different export flags
 		struct ExportOptions
 		{
@@ -67,6 +76,22 @@ namespace polyfem::io
 
 			bool use_hdf5;
 
+			/// names of the exported fields, empty to export the fields selected by the flags
+			std::set<std::string> fields;
+
+			/// single VTKHDF file receiving the time steps (with a suffix per exported mesh) instead of
+			/// one file per step, empty for per step files
+			std::string vtkhdf_path;
+			/// deflate level of the VTKHDF datasets
+			int vtkhdf_compression_level;
+			/// number of rows of the VTKHDF chunks
+			int vtkhdf_chunk_size;
+			/// storage of the VTKHDF fields by name
+			std::map<std::string, VTKHDFWriter::FieldOptions> vtkhdf_fields;
+
+			/// solver quantities to use instead of the state ones, nullptr to read the state
+			std::shared_ptr<const SolverSnapshot> snapshot;
+
 			/// @brief initialize the flags based on the input args
 			/// @param[in] args input arguments used to set most of the flags
 			/// @param[in] is_mesh_linear if the mesh is linear
@@ -80,6 +105,14 @@ namespace polyfem::io
 			/// @brief return the extension of the output paraview files depending on use_hdf5
 			/// @return either hdf or vtu
 			inline std::string file_extension() const { return use_hdf5 ? ".hdf" : ".vtu"; }
+
+			/// @brief if a field is exported, fields that are not are never computed
+			/// @param[in] name name of the field (the name of a tensor covers its components)
+			/// @param[in] flag flag selecting the field when no field list is given
+			inline bool export_field(const std::string &name, const bool flag = true) const { return fields.empty() ? flag : fields.count(name) > 0; }
+
+			/// @brief if the time steps are appended to a VTKHDF time series
+			inline bool use_vtkhdf() const { return !vtkhdf_path.empty(); }
 		};
 
 		/// extracts the boundary mesh
@@ -111,6 +144,20 @@ namespace polyfem::io
 		/// @param[in] spacing grid spacing, <=0 mean no grid
 		void build_grid(const polyfem::mesh::Mesh &mesh, const double spacing);
 
+		/// @brief drops the cached visualization mesh, to be called when the discretization changes
+		void clear_vis_cache();
+
+		/// @brief solution at the points of the cached visualization mesh of the export options
+		/// @param[in] state state of the discretization
+		/// @param[in] opts export options selecting the visualization mesh (e.g., boundary_only)
+		/// @param[in] sol solution
+		/// @param[out] points visualization points in the rest configuration, one per row
+		/// @param[out] values solution at the points, one row per point
+		void vis_solution(const State &state, const ExportOptions &opts, const Eigen::MatrixXd &sol, Eigen::MatrixXd &points, Eigen::MatrixXd &values) const;
+
+		/// @brief stresses of the exported solution, shared by the outputs of a step
+		StressField &stress_field() const { return stress_field_; }
+
 		/// @brief exports everytihng, txt, vtu, etc
 		/// @param[in] state state to get the data
 		/// @param[in] sol solution
@@ -237,12 +284,14 @@ namespace polyfem::io
 		/// @param[in] path filename
 		/// @param[in] state state to get the data
 		/// @param[in] sol solution
+		/// @param[in] t time
 		/// @param[in] opts export options
 		/// @param[out] solution_frames saves the output here instead of vtu
 		void save_points(
 			const std::string &path,
 			const State &state,
 			const Eigen::MatrixXd &sol,
+			const double t,
 			const ExportOptions &opts,
 			std::vector<SolutionFrame> &solution_frames) const;
 
@@ -256,6 +305,9 @@ namespace polyfem::io
 		void save_pvd(const std::string &name, const std::function<std::string(int)> &vtu_names,
 					  int time_steps, double t0, double dt, int skip_frame = 1) const;
 
+		/// closes the VTKHDF time series, the next time step truncates the files
+		void close_vtkhdf_series();
+
 	private:
 		/// used to sample the solution
 		utils::RefElementSampler ref_element_sampler;
@@ -263,7 +315,7 @@ namespace polyfem::io
 		/// grid mesh points to export solution sampled on a grid
 		Eigen::MatrixXd grid_points;
 		/// grid mesh mapping to fe elements
-		Eigen::MatrixXi grid_points_to_elements;
+		Eigen::VectorXi grid_points_to_elements;
 		/// grid mesh boundaries
 		Eigen::MatrixXd grid_points_bc;
 
@@ -335,13 +387,55 @@ namespace polyfem::io
 			Eigen::MatrixXi &el_id,
 			Eigen::MatrixXd &discr) const;
 
+		/// visualization mesh and interpolation operators, they only depend on the discretization
+		/// and are reused by all the exports of a simulation
+		struct VolumeVisCache
+		{
+			bool use_sampler;
+			bool boundary_only;
+
+			Eigen::MatrixXd points;
+			Eigen::MatrixXi tets;
+			Eigen::MatrixXi el_id;
+			Eigen::MatrixXd discr;
+			std::vector<std::vector<int>> elements;
+
+			/// interpolation of the nodal solution at the points
+			Eigen::SparseMatrix<double, Eigen::RowMajor> interpolation;
+			/// interpolation of the nodal pressure at the points, empty if not mixed
+			Eigen::SparseMatrix<double, Eigen::RowMajor> pressure_interpolation;
+		};
+
+		/// @brief returns the cached visualization mesh for the options, builds it if needed
+		/// @param[in] state state to get the discretization
+		/// @param[in] opts export options
+		std::shared_ptr<const VolumeVisCache> volume_vis_cache(const State &state, const ExportOptions &opts) const;
+
+		mutable std::shared_ptr<const VolumeVisCache> volume_vis_cache_;
+		mutable std::mutex volume_vis_cache_mutex_;
+
+		mutable StressField stress_field_;
+
+		/// writes the fields and the mesh of one export either to a paraview file or to a VTKHDF time series
+		class FieldWriter;
+
+		/// @brief returns the VTKHDF time series of an exported mesh, opens it if needed
+		/// @param[in] opts export options
+		/// @param[in] suffix suffix of the exported mesh (e.g., _surf), empty for the volume
+		/// @return nullptr if the options do not use VTKHDF
+		VTKHDFWriter *vtkhdf_series(const ExportOptions &opts, const std::string &suffix) const;
+
+		/// VTKHDF time series by file path
+		mutable std::map<std::string, std::unique_ptr<VTKHDFWriter>> vtkhdf_series_;
+		mutable std::mutex vtkhdf_series_mutex_;
+
 		void save_volume_vector_field(
 			const State &state,
-			const Eigen::MatrixXd &points,
+			const VolumeVisCache &vis,
 			const ExportOptions &opts,
 			const std::string &name,
 			const Eigen::VectorXd &field,
-			paraviewo::ParaviewWriter &writer) const;
+			FieldWriter &writer) const;
 	};
 
 	/// @brief stores all runtime data
@@ -362,6 +456,25 @@ namespace polyfem::io
 		double assigning_rhs_time;
 		/// time to solve
 		double solving_time;
+		/// time spent merging the per-thread assembly storages
+		double assembling_merge_time = 0;
+
+		/// current RSS (bytes) at the end of each phase, in order
+		std::vector<std::pair<std::string, size_t>> phase_memory;
+		/// tracked size (bytes) of the main containers
+		std::map<std::string, size_t> container_memory;
+
+		/// @brief records the current RSS at the end of a phase, a phase run again is overwritten
+		/// @param[in] phase name of the phase
+		void sample_memory(const std::string &phase);
+
+		/// @brief records the size of a container, keeps the largest size recorded under the same name
+		/// @param[in] name name of the container
+		/// @param[in] bytes size in bytes
+		void track_memory(const std::string &name, const size_t bytes);
+
+		/// @brief current RSS in bytes, 0 if it is not available on this OS
+		static size_t current_memory();
 
 		/// @brief computes total time
 		/// @return total time
@@ -429,6 +542,7 @@ namespace polyfem::io
 		/// @param[in] n_bases number of base
 		/// @param[in] bases bases
 		/// @param[in] gbases geometric bases
+		/// @param[in] cache assembly values of the bases, recomputed if it is in single precision
 		/// @param[in] mesh mesh
 		/// @param[in] problem problem
 		/// @param[in] tend end time step
@@ -436,6 +550,7 @@ namespace polyfem::io
 		void compute_errors(const int n_bases,
 							const std::vector<polyfem::basis::ElementBases> &bases,
 							const std::vector<polyfem::basis::ElementBases> &gbases,
+							const assembler::AssemblyValsCache &cache,
 							const polyfem::mesh::Mesh &mesh,
 							const assembler::Problem &problem,
 							const double tend,
@@ -457,11 +572,19 @@ namespace polyfem::io
 		/// @brief clears all stats
 		void reset();
 
-		/// @brief counts the number of flipped elements
+		/// @brief counts the number of flipped elements, throws if there is one
 		/// @param[in] mesh mesh
 		/// @param[in] gbases geometric bases
 		void count_flipped_elements(const polyfem::mesh::Mesh &mesh, const std::vector<polyfem::basis::ElementBases> &gbases);
 
+		/// @brief compute_mesh_size and count_flipped_elements in a single parallel pass over the elements
+		/// @param[in] mesh mesh
+		/// @param[in] gbases geom bases
+		/// @param[in] n_samples used for curved meshes
+		/// @param[in] use_curved_mesh_size use curved edges to compute mesh size
+		/// @param[in] count_flipped check the sign of the Jacobian of the geometric mapping, throws if an element is flipped
+		void compute_element_stats(const polyfem::mesh::Mesh &mesh, const std::vector<polyfem::basis::ElementBases> &gbases, const int n_samples, const bool use_curved_mesh_size, const bool count_flipped);
+
 		/// saves the output statistic to a json object
 		/// @param[in] j output json
 
@@ -0,0 +1,60 @@
+#include "OutputFilter.hpp"
+
+#include <cstring>
+
+namespace polyfem::io
+{
+	bool OutputFilter::due(const std::string &stream, const int t, const Eigen::MatrixXd &data, const int every, const double tolerance) const
+	{
+		if (every > 1 && t % every != 0)
+			return false;
+
+		const auto it = streams_.find(stream);
+		if (it == streams_.end() || tolerance <= 0)
+			return true;
+
+		const Eigen::MatrixXd &last = it->second.data;
+		if (last.rows() != data.rows() || last.cols() != data.cols())
+			return true;
+
+		return (data - last).norm() > tolerance * last.norm();
+	}
+
+	bool OutputFilter::changed(const std::string &stream, const uint64_t fingerprint, const std::string &path)
+	{
+		const auto it = streams_.find(stream);
+		if (it != streams_.end() && it->second.fingerprint == fingerprint)
+		{
+			++n_skipped_;
+			return false;
+		}
+
+		Stream &s = streams_[stream];
+		s.fingerprint = fingerprint;
+		s.path = path;
+		return true;
+	}
+
+	bool OutputFilter::changed(const std::string &stream, const Eigen::MatrixXd &data, const std::string &path)
+	{
+		if (!changed(stream, fingerprint(data), path))
+			return false;
+
+		streams_[stream].data = data;
+		return true;
+	}
+
+	const std::string &OutputFilter::path(const std::string &stream) const
+	{
+		static const std::string empty;
+		const auto it = streams_.find(stream);
+		return it == streams_.end() ? empty : it->second.path;
+	}
+
+	uint64_t OutputFilter::bits(const double value)
+	{
+		uint64_t b;
+		std::memcpy(&b, &value, sizeof(b));
+		return b;
+	}
+} // namespace polyfem::io
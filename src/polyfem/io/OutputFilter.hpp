@@ -0,0 +1,84 @@
+#pragma once
+
+#include <Eigen/Dense>
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace polyfem::io
+{
+	/// Change detection of the per step output streams (e.g., the rest mesh or the raw solution),
+	/// so that a content which did not change is written once and its file is referenced afterwards.
+	///
+	/// Every stream keeps a fingerprint of the content it last wrote and the path it was written to.
+	/// The streams can also be written only every few steps or when their content changed significantly (see due).
+	class OutputFilter
+	{
+	public:
+		/// @brief Forgets all the streams
+		void clear()
+		{
+			streams_.clear();
+			n_skipped_ = 0;
+		}
+
+		/// @brief Checks if the stream has to be written at step t
+		/// @param[in] stream name of the stream
+		/// @param[in] t time step index
+		/// @param[in] data content of the stream at step t
+		/// @param[in] every write every k-th step only
+		/// @param[in] tolerance minimal change of the data since the last write relative to its norm, 0 for any change
+		/// @return true if t is a multiple of every and the stream was never written or changed more than the tolerance
+		bool due(const std::string &stream, const int t, const Eigen::MatrixXd &data, const int every, const double tolerance) const;
+
+		/// @brief Checks if the content differs from the last write of the stream and records it as written to path if it does
+		/// @param[in] stream name of the stream
+		/// @param[in] fingerprint fingerprint of the content
+		/// @param[in] path file the content is written to
+		/// @return true if the content has to be written to path, false if path(stream) already has it
+		bool changed(const std::string &stream, const uint64_t fingerprint, const std::string &path);
+
+		/// @brief Same as above, the data is also kept for the tolerance of due
+		bool changed(const std::string &stream, const Eigen::MatrixXd &data, const std::string &path);
+
+		/// @brief File of the last write of the stream, empty if it was never written
+		const std::string &path(const std::string &stream) const;
+
+		/// @brief Number of writes skipped because the content did not change
+		int n_skipped() const { return n_skipped_; }
+
+		/// @brief Fingerprint of the size and the coefficients of a matrix, seed chains several matrices
+		template <typename Derived>
+		static uint64_t fingerprint(const Eigen::MatrixBase<Derived> &m, const uint64_t seed = 14695981039346656037ull)
+		{
+			uint64_t h = mix(seed, uint64_t(m.rows()));
+			h = mix(h, uint64_t(m.cols()));
+			for (Eigen::Index j = 0; j < m.cols(); ++j)
+				for (Eigen::Index i = 0; i < m.rows(); ++i)
+					h = mix(h, bits(m(i, j)));
+			return h;
+		}
+
+	private:
+		static uint64_t mix(const uint64_t h, const uint64_t value)
+		{
+			uint64_t r = (h ^ value) * 0x9E3779B97F4A7C15ull;
+			return r ^ (r >> 29);
+		}
+
+		static uint64_t bits(const double value);
+		static uint64_t bits(const int value) { return uint64_t(uint32_t(value)); }
+
+		struct Stream
+		{
+			uint64_t fingerprint = 0;
+			std::string path;
+			/// content of the last write, only for the streams with data
+			Eigen::MatrixXd data;
+		};
+
+		std::map<std::string, Stream> streams_;
+		int n_skipped_ = 0;
+	};
+} // namespace polyfem::io
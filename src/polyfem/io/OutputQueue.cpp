@@ -0,0 +1,117 @@
+#include "OutputQueue.hpp"
+
+#include <polyfem/utils/Logger.hpp>
+
+#include <algorithm>
+#include <cassert>
+
+namespace polyfem::io
+{
+	OutputQueue::OutputQueue(const int n_threads, const int capacity)
+		: capacity_(std::max(capacity, 1))
+	{
+		assert(n_threads > 0);
+		threads_.reserve(n_threads);
+		for (int i = 0; i < n_threads; ++i)
+			threads_.emplace_back(&OutputQueue::run, this);
+	}
+
+	OutputQueue::~OutputQueue()
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			task_done_.wait(lock, [this]() { return tasks_.empty() && running_ == 0; });
+			stop_ = true;
+		}
+		task_available_.notify_all();
+
+		for (std::thread &thread : threads_)
+			thread.join();
+
+		if (error_)
+		{
+			try
+			{
+				std::rethrow_exception(error_);
+			}
+			catch (const std::exception &e)
+			{
+				logger().error("Output task failed: {}", e.what());
+			}
+			catch (...)
+			{
+				logger().error("Output task failed");
+			}
+		}
+	}
+
+	void OutputQueue::push(std::function<void()> task)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			task_done_.wait(lock, [this]() { return tasks_.size() < capacity_ || error_; });
+			rethrow();
+			tasks_.push_back(std::move(task));
+		}
+		task_available_.notify_one();
+	}
+
+	void OutputQueue::flush()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		task_done_.wait(lock, [this]() { return tasks_.empty() && running_ == 0; });
+		rethrow();
+	}
+
+	int OutputQueue::pending() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return tasks_.size() + running_;
+	}
+
+	void OutputQueue::rethrow()
+	{
+		// called with the lock held
+		if (error_)
+		{
+			std::exception_ptr error = error_;
+			error_ = nullptr;
+			std::rethrow_exception(error);
+		}
+	}
+
+	void OutputQueue::run()
+	{
+		while (true)
+		{
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				task_available_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+				if (tasks_.empty())
+					return; // stopped
+				task = std::move(tasks_.front());
+				tasks_.pop_front();
+				++running_;
+			}
+
+			std::exception_ptr error;
+			try
+			{
+				task();
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				--running_;
+				if (error && !error_)
+					error_ = error;
+			}
+			task_done_.notify_all();
+		}
+	}
+} // namespace polyfem::io
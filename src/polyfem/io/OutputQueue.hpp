@@ -0,0 +1,57 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace polyfem::io
+{
+	/// Bounded queue of output tasks (e.g., VTU export of a time step) run by background writer threads,
+	/// so the solver does not wait for the disk. The tasks must own copies of the data they write.
+	class OutputQueue
+	{
+	public:
+		/// @brief Start the writer threads.
+		/// @param[in] n_threads number of writer threads
+		/// @param[in] capacity maximum number of pending tasks, push blocks when it is reached
+		OutputQueue(const int n_threads, const int capacity);
+
+		/// Run the pending tasks and stop the writer threads
+		~OutputQueue();
+
+		OutputQueue(const OutputQueue &) = delete;
+		OutputQueue &operator=(const OutputQueue &) = delete;
+
+		/// @brief Add a task, waits for a free slot if the queue is full.
+		/// @throws the exception of a previous task which failed
+		void push(std::function<void()> task);
+
+		/// @brief Wait until all the tasks are done.
+		/// @throws the exception of the first task which failed
+		void flush();
+
+		/// @brief Number of tasks queued or running.
+		int pending() const;
+
+	private:
+		void run();
+		void rethrow();
+
+		const int capacity_;
+
+		mutable std::mutex mutex_;
+		std::condition_variable task_available_;
+		std::condition_variable task_done_;
+
+		std::deque<std::function<void()>> tasks_;
+		int running_ = 0;
+		bool stop_ = false;
+		std::exception_ptr error_;
+
+		std::vector<std::thread> threads_;
+	};
+} // namespace polyfem::io
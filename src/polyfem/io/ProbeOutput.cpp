@@ -0,0 +1,268 @@
+#include "ProbeOutput.hpp"
+
+#include <polyfem/State.hpp>
+#include <polyfem/assembler/ElementAssemblyValues.hpp>
+#include <polyfem/mesh/PointLocator.hpp>
+#include <polyfem/quadrature/Quadrature.hpp>
+#include <polyfem/utils/Logger.hpp>
+#include <polyfem/utils/MatrixUtils.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <set>
+
+namespace polyfem::io
+{
+	ProbeOutput::ProbeOutput(const std::string &path, const Eigen::MatrixXd &points, const std::vector<std::string> &reductions)
+		: points_(points), reductions_(reductions)
+	{
+		for (const std::string &r : reductions_)
+		{
+			if (std::find(supported_reductions().begin(), supported_reductions().end(), r) == supported_reductions().end())
+				log_and_throw_error("Unknown probe reduction {}!", r);
+		}
+
+		file_.open(path, std::ios::out | std::ios::trunc);
+		if (!file_.good())
+			log_and_throw_error("Unable to open probe output {}!", path);
+	}
+
+	const std::vector<std::string> &ProbeOutput::supported_reductions()
+	{
+		static const std::vector<std::string> names = {"reaction_forces", "energy", "max_von_mises"};
+		return names;
+	}
+
+	bool ProbeOutput::has_reduction(const std::string &name) const
+	{
+		return std::find(reductions_.begin(), reductions_.end(), name) != reductions_.end();
+	}
+
+	StiffnessMatrix ProbeOutput::interpolation_weights(
+		const mesh::Mesh &mesh,
+		const std::vector<basis::ElementBases> &bases,
+		const std::vector<basis::ElementBases> &gbases,
+		const int n_bases,
+		const Eigen::MatrixXd &points,
+		std::vector<bool> &found)
+	{
+		if (points.rows() > 0 && points.cols() != mesh.dimension())
+			log_and_throw_error("Probe points have {} coordinates instead of {}!", points.cols(), mesh.dimension());
+
+		Eigen::VectorXi elements;
+		Eigen::MatrixXd bc;
+		mesh::PointLocator(mesh).locate(points, elements, bc);
+
+		found.assign(points.rows(), false);
+		std::vector<Eigen::Triplet<double>> entries;
+		for (int i = 0; i < points.rows(); ++i)
+		{
+			const int el_id = elements(i);
+			if (el_id < 0)
+				continue;
+			found[i] = true;
+
+			// local coordinates are the barycentric coordinates without the first one
+			const Eigen::MatrixXd local_pt = bc.block(i, 1, 1, bc.cols() - 1);
+			assembler::ElementAssemblyValues vals;
+			vals.compute(el_id, mesh.is_volume(), local_pt, bases[el_id], gbases[el_id]);
+
+			for (const assembler::AssemblyValues &v : vals.basis_values)
+			{
+				for (const basis::Local2Global &g : v.global)
+					entries.emplace_back(i, g.index, g.val * v.val(0));
+			}
+		}
+
+		StiffnessMatrix weights(points.rows(), n_bases);
+		weights.setFromTriplets(entries.begin(), entries.end());
+		return weights;
+	}
+
+	void ProbeOutput::init(const State &state)
+	{
+		const mesh::Mesh &mesh = *state.mesh;
+		problem_dim_ = state.problem->is_scalar() ? 1 : mesh.dimension();
+
+		weights_ = interpolation_weights(mesh, state.bases, state.geom_bases(), state.n_bases, points_, found_);
+		const int n_lost = std::count(found_.begin(), found_.end(), false);
+		if (n_lost > 0)
+			logger().warn("{} probe points are outside of the mesh, their values are NaN", n_lost);
+
+		columns_.clear();
+		for (int i = 0; i < points_.rows(); ++i)
+		{
+			if (problem_dim_ == 1)
+				columns_.push_back(fmt::format("probe{}", i));
+			else
+				for (int d = 0; d < problem_dim_; ++d)
+					columns_.push_back(fmt::format("probe{}_{}", i, d));
+		}
+
+		boundary_nodes_.clear();
+		if (has_reduction("reaction_forces"))
+		{
+			std::map<int, std::set<int>> nodes;
+			for (const mesh::LocalBoundary &lb : state.local_boundary)
+			{
+				const basis::ElementBases &bs = state.bases[lb.element_id()];
+				for (int i = 0; i < lb.size(); ++i)
+				{
+					const int primitive_global_id = lb.global_primitive_id(i);
+					std::set<int> &tag_nodes = nodes[mesh.get_boundary_id(primitive_global_id)];
+					const auto local_nodes = bs.local_nodes_for_primitive(primitive_global_id, mesh);
+					for (long n = 0; n < local_nodes.size(); ++n)
+					{
+						for (const basis::Local2Global &g : bs.bases[local_nodes(n)].global())
+							tag_nodes.insert(g.index);
+					}
+				}
+			}
+
+			for (const auto &[id, tag_nodes] : nodes)
+			{
+				boundary_nodes_[id].assign(tag_nodes.begin(), tag_nodes.end());
+				for (int d = 0; d < problem_dim_; ++d)
+					columns_.push_back(problem_dim_ == 1 ? fmt::format("reaction_{}", id) : fmt::format("reaction_{}_{}", id, d));
+			}
+		}
+
+		if (has_reduction("energy"))
+			columns_.push_back("energy");
+
+		body_ids_.clear();
+		element_body_.clear();
+		if (has_reduction("max_von_mises"))
+		{
+			const std::vector<std::string> names = state.assembler->scalar_value_names();
+			if (std::find(names.begin(), names.end(), "von_mises") == names.end())
+				log_and_throw_error("Von Mises stresses are not computed by {}!", state.assembler->name());
+
+			element_body_.resize(mesh.n_elements());
+			for (int e = 0; e < mesh.n_elements(); ++e)
+				body_ids_.push_back(mesh.get_body_id(e));
+			std::sort(body_ids_.begin(), body_ids_.end());
+			body_ids_.erase(std::unique(body_ids_.begin(), body_ids_.end()), body_ids_.end());
+			for (int e = 0; e < mesh.n_elements(); ++e)
+				element_body_[e] = std::lower_bound(body_ids_.begin(), body_ids_.end(), mesh.get_body_id(e)) - body_ids_.begin();
+
+			for (const int id : body_ids_)
+				columns_.push_back(fmt::format("max_von_mises_{}", id));
+		}
+
+		stiffness_.resize(0, 0);
+		if (state.assembler->is_linear() && (has_reduction("reaction_forces") || has_reduction("energy")))
+			state.assembler->assemble(mesh.is_volume(), state.n_bases, state.bases, state.geom_bases(), state.ass_vals_cache, stiffness_);
+
+		file_ << "time";
+		for (const std::string &c : columns_)
+			file_ << "," << c;
+		file_ << std::endl;
+	}
+
+	Eigen::MatrixXd ProbeOutput::probe_values(const Eigen::MatrixXd &sol) const
+	{
+		assert(sol.size() >= weights_.cols() * problem_dim_);
+
+		// the mixed formulations append the pressure to the solution
+		const Eigen::MatrixXd u = utils::unflatten(sol.topRows(weights_.cols() * problem_dim_), problem_dim_);
+		Eigen::MatrixXd res = weights_ * u;
+		for (int i = 0; i < res.rows(); ++i)
+		{
+			if (!found_[i])
+				res.row(i).setConstant(std::numeric_limits<double>::quiet_NaN());
+		}
+		return res;
+	}
+
+	Eigen::VectorXd ProbeOutput::reduction_values(const State &state, const double dt, const Eigen::MatrixXd &sol)
+	{
+		const mesh::Mesh &mesh = *state.mesh;
+		const assembler::Assembler &assembler = *state.assembler;
+		const Eigen::MatrixXd u = sol.topRows(state.n_bases * problem_dim_);
+
+		std::vector<double> res;
+
+		if (has_reduction("reaction_forces"))
+		{
+			Eigen::MatrixXd forces;
+			if (stiffness_.size() > 0)
+				forces = stiffness_ * u;
+			else
+				assembler.assemble_gradient(mesh.is_volume(), state.n_bases, state.bases, state.geom_bases(), state.ass_vals_cache, dt, u, u, forces);
+
+			for (const auto &[id, nodes] : boundary_nodes_)
+			{
+				Eigen::VectorXd total = Eigen::VectorXd::Zero(problem_dim_);
+				for (const int n : nodes)
+					total += forces.block(n * problem_dim_, 0, problem_dim_, 1);
+				res.insert(res.end(), total.data(), total.data() + total.size());
+			}
+		}
+
+		if (has_reduction("energy"))
+		{
+			if (stiffness_.size() > 0)
+				res.push_back(0.5 * (u.transpose() * (stiffness_ * u))(0));
+			else
+				res.push_back(assembler.assemble_energy(mesh.is_volume(), state.bases, state.geom_bases(), state.ass_vals_cache, dt, u, u));
+		}
+
+		if (has_reduction("max_von_mises"))
+		{
+			const int n_bodies = body_ids_.size();
+
+			// the values at the quadrature points are shared with the other outputs of the step
+			std::vector<Eigen::MatrixXd> local_pts(mesh.n_elements());
+			quadrature::Quadrature quad;
+			for (int e = 0; e < mesh.n_elements(); ++e)
+			{
+				state.bases[e].compute_quadrature(quad);
+				local_pts[e] = quad.points;
+			}
+			const auto values = state.out_geom.stress_field().get("assembly_quadrature", assembler, state.bases, state.geom_bases(), local_pts, sol, false);
+
+			auto storage = utils::create_thread_storage(Eigen::VectorXd::Constant(n_bodies, -std::numeric_limits<double>::infinity()).eval());
+			utils::maybe_parallel_for(mesh.n_elements(), [&](int start, int end, int thread_id) {
+				Eigen::VectorXd &local_max = utils::get_local_thread_storage(storage, thread_id);
+				for (int e = start; e < end; ++e)
+				{
+					for (const auto &[name, val] : values->scalar[e])
+					{
+						if (name == "von_mises" && val.size() > 0)
+							local_max[element_body_[e]] = std::max(local_max[element_body_[e]], val.maxCoeff());
+					}
+				}
+			});
+
+			Eigen::VectorXd max = Eigen::VectorXd::Constant(n_bodies, -std::numeric_limits<double>::infinity());
+			for (const Eigen::VectorXd &local_max : storage)
+				max = max.cwiseMax(local_max);
+			res.insert(res.end(), max.data(), max.data() + max.size());
+		}
+
+		return Eigen::Map<Eigen::VectorXd>(res.data(), res.size());
+	}
+
+	void ProbeOutput::write(const State &state, const double time, const double dt, const Eigen::MatrixXd &sol)
+	{
+		const Eigen::MatrixXd probes = probe_values(sol);
+		const Eigen::VectorXd reductions = reduction_values(state, dt, sol);
+
+		last_row_.resize(probes.size() + reductions.size());
+		int k = 0;
+		for (int i = 0; i < probes.rows(); ++i)
+		{
+			for (int d = 0; d < probes.cols(); ++d)
+				last_row_(k++) = probes(i, d);
+		}
+		last_row_.tail(reductions.size()) = reductions;
+
+		file_ << fmt::format("{}", time);
+		for (int i = 0; i < last_row_.size(); ++i)
+			file_ << fmt::format(",{}", last_row_(i));
+		// the rows of the finished steps are readable during the simulation
+		file_ << std::endl;
+	}
+} // namespace polyfem::io
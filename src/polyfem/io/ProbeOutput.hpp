@@ -0,0 +1,103 @@
+#pragma once
+
+#include <polyfem/Common.hpp>
+#include <polyfem/basis/ElementBases.hpp>
+#include <polyfem/mesh/Mesh.hpp>
+#include <polyfem/utils/Types.hpp>
+
+#include <Eigen/Dense>
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace polyfem
+{
+	class State;
+}
+
+namespace polyfem::io
+{
+	/// In-situ output of a time series instead of the full fields: the solution at probe points and reductions
+	/// over the mesh, written as one CSV row per time step.
+	///
+	/// The probes are located once in the rest mesh, their interpolation weights are the rows of a sparse matrix W
+	/// so the values at every step are W u. The reductions are
+	///  - reaction_forces: sum per Dirichlet boundary id of the elastic forces (gradient of the elastic energy) at
+	///    the nodes of the boundary, body forces and inertia are not included;
+	///  - energy: elastic energy;
+	///  - max_von_mises: maximum von Mises stress at the quadrature points of the elements of every body.
+	class ProbeOutput
+	{
+	public:
+		/// @param[in] path CSV file, it is truncated
+		/// @param[in] points probe points in the rest configuration, one per row
+		/// @param[in] reductions names of the reductions
+		ProbeOutput(const std::string &path, const Eigen::MatrixXd &points, const std::vector<std::string> &reductions);
+
+		/// @brief Locates the probes and collects the boundary nodes and bodies of the reductions, writes the CSV header
+		void init(const State &state);
+
+		/// @brief Appends the row of a time step
+		/// @param[in] state state after init
+		/// @param[in] time time of the step
+		/// @param[in] dt time step size, passed to the assembler
+		/// @param[in] sol solution of the step
+		void write(const State &state, const double time, const double dt, const Eigen::MatrixXd &sol);
+
+		/// @brief Interpolation weights of points, W(i, j) is the weight of the basis j at the point i
+		/// Only simplices are supported, the rows of the points outside of the mesh are empty.
+		/// @param[in] mesh rest mesh
+		/// @param[in] bases bases of the elements
+		/// @param[in] gbases geometric bases of the elements
+		/// @param[in] n_bases number of bases
+		/// @param[in] points physical points, one per row
+		/// @param[out] found true for the points inside the mesh
+		static StiffnessMatrix interpolation_weights(
+			const mesh::Mesh &mesh,
+			const std::vector<basis::ElementBases> &bases,
+			const std::vector<basis::ElementBases> &gbases,
+			const int n_bases,
+			const Eigen::MatrixXd &points,
+			std::vector<bool> &found);
+
+		/// @brief Values of the solution at the probes, one row per probe, NaN outside of the mesh
+		Eigen::MatrixXd probe_values(const Eigen::MatrixXd &sol) const;
+
+		/// @brief Values of the reductions in the order of the columns
+		Eigen::VectorXd reduction_values(const State &state, const double dt, const Eigen::MatrixXd &sol);
+
+		/// @brief Names of the columns after time
+		const std::vector<std::string> &columns() const { return columns_; }
+
+		/// @brief Values of the columns of the last written row
+		const Eigen::VectorXd &last_row() const { return last_row_; }
+
+		/// @brief Reductions supported by the output
+		static const std::vector<std::string> &supported_reductions();
+
+	private:
+		bool has_reduction(const std::string &name) const;
+
+		std::ofstream file_;
+		const Eigen::MatrixXd points_;
+		const std::vector<std::string> reductions_;
+
+		int problem_dim_ = 0;
+		StiffnessMatrix weights_;
+		std::vector<bool> found_;
+
+		/// global nodes of every Dirichlet boundary id
+		std::map<int, std::vector<int>> boundary_nodes_;
+		/// body ids and index of the body of every element
+		std::vector<int> body_ids_;
+		std::vector<int> element_body_;
+
+		/// stiffness matrix of linear assemblers, the forces and energy are computed with it
+		StiffnessMatrix stiffness_;
+
+		std::vector<std::string> columns_;
+		Eigen::VectorXd last_row_;
+	};
+} // namespace polyfem::io
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <Eigen/Dense>
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace polyfem::io
+{
+	/// Non owning description of a dense 2D array following the buffer protocol layout (data pointer,
+	/// format character, shape and byte strides), so bindings can wrap the memory (e.g., as a NumPy array) without copying.
+	/// The view is valid as long as the array is alive and not resized.
+	struct BufferView
+	{
+		const void *data = nullptr;
+		std::string format; ///< Python struct format character of the scalars
+		size_t itemsize = 0;
+		std::array<ptrdiff_t, 2> shape = {{0, 0}};
+		std::array<ptrdiff_t, 2> strides = {{0, 0}}; ///< in bytes
+
+		template <typename Derived>
+		static BufferView of(const Eigen::PlainObjectBase<Derived> &mat)
+		{
+			using Scalar = typename Derived::Scalar;
+			static_assert(std::is_same_v<Scalar, double> || std::is_same_v<Scalar, float> || std::is_same_v<Scalar, int>,
+						  "unsupported scalar type");
+
+			BufferView view;
+			view.data = mat.data();
+			view.format = std::is_same_v<Scalar, double> ? "d" : (std::is_same_v<Scalar, float> ? "f" : "i");
+			view.itemsize = sizeof(Scalar);
+			view.shape = {{mat.rows(), mat.cols()}};
+			view.strides = {{ptrdiff_t(mat.rowStride() * sizeof(Scalar)), ptrdiff_t(mat.colStride() * sizeof(Scalar))}};
+			return view;
+		}
+	};
+
+	/// class used to save the solution of time dependent problems in code instead of saving it to the disc
+	class SolutionFrame
+	{
+	public:
+		std::string name;
+		Eigen::MatrixXd points;
+		Eigen::MatrixXi connectivity;
+		Eigen::MatrixXd solution;
+		Eigen::MatrixXd pressure;
+		Eigen::MatrixXd exact;
+		Eigen::MatrixXd error;
+		Eigen::MatrixXd scalar_value;
+		Eigen::MatrixXd scalar_value_avg;
+
+		/// @brief Views of the non empty arrays of the frame, named as the members.
+		std::vector<std::pair<std::string, BufferView>> buffers() const
+		{
+			std::vector<std::pair<std::string, BufferView>> res;
+			const auto add = [&res](const std::string &name, const auto &mat) {
+				if (mat.size() > 0)
+					res.emplace_back(name, BufferView::of(mat));
+			};
+			add("points", points);
+			add("connectivity", connectivity);
+			add("solution", solution);
+			add("pressure", pressure);
+			add("exact", exact);
+			add("error", error);
+			add("scalar_value", scalar_value);
+			add("scalar_value_avg", scalar_value_avg);
+			return res;
+		}
+	};
+} // namespace polyfem::io
@@ -0,0 +1,343 @@
+#include "SolutionFrameStore.hpp"
+
+#include <polyfem/utils/Logger.hpp>
+
+#include <cstring>
+#include <filesystem>
+
+namespace polyfem::io
+{
+	namespace
+	{
+		void write_varint(uint64_t v, std::string &out)
+		{
+			while (v >= 0x80)
+			{
+				out.push_back(char(v | 0x80));
+				v >>= 7;
+			}
+			out.push_back(char(v));
+		}
+
+		uint64_t read_varint(const std::string &in, size_t &pos)
+		{
+			uint64_t v = 0;
+			for (int shift = 0; pos < in.size(); shift += 7)
+			{
+				const uint8_t b = in[pos++];
+				v |= uint64_t(b & 0x7F) << shift;
+				if (!(b & 0x80))
+					return v;
+			}
+			log_and_throw_error("Corrupted solution frame");
+		}
+
+		/// Words of the values of a matrix, the bit patterns of double, float or int values
+		template <typename Scalar>
+		uint64_t to_word(const Scalar v, const bool use_float)
+		{
+			if constexpr (std::is_same_v<Scalar, int>)
+			{
+				uint32_t w;
+				std::memcpy(&w, &v, sizeof(w));
+				return w;
+			}
+			else if (use_float)
+			{
+				const float f = v;
+				uint32_t w;
+				std::memcpy(&w, &f, sizeof(w));
+				return w;
+			}
+			else
+			{
+				uint64_t w;
+				std::memcpy(&w, &v, sizeof(w));
+				return w;
+			}
+		}
+
+		template <typename Scalar>
+		Scalar from_word(const uint64_t w, const bool use_float)
+		{
+			if constexpr (std::is_same_v<Scalar, int>)
+			{
+				const uint32_t w32 = w;
+				int v;
+				std::memcpy(&v, &w32, sizeof(v));
+				return v;
+			}
+			else if (use_float)
+			{
+				const uint32_t w32 = w;
+				float f;
+				std::memcpy(&f, &w32, sizeof(f));
+				return f;
+			}
+			else
+			{
+				double v;
+				std::memcpy(&v, &w, sizeof(v));
+				return v;
+			}
+		}
+
+		template <typename Scalar>
+		int word_size(const bool use_float)
+		{
+			return std::is_same_v<Scalar, int> || use_float ? 4 : 8;
+		}
+
+		/// Shape, reference flag, then the byte planes of the words run-length encoded as
+		/// (number of zero bytes, number of literal bytes, literal bytes) tokens
+		template <typename Scalar>
+		void encode_matrix(
+			const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> &mat,
+			const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> *prev,
+			const bool use_float,
+			std::string &out)
+		{
+			write_varint(mat.rows(), out);
+			write_varint(mat.cols(), out);
+
+			const bool use_prev = prev != nullptr && prev->rows() == mat.rows() && prev->cols() == mat.cols();
+			out.push_back(use_prev ? 1 : 0);
+
+			const int w = word_size<Scalar>(use_float);
+			const size_t n = mat.size();
+			std::string planes(n * w, 0);
+			for (size_t i = 0; i < n; ++i)
+			{
+				uint64_t word = to_word(mat(i), use_float);
+				if (use_prev)
+					word ^= to_word((*prev)(i), use_float);
+				for (int b = 0; b < w; ++b)
+					planes[b * n + i] = char((word >> (8 * b)) & 0xFF);
+			}
+
+			size_t pos = 0;
+			while (pos < planes.size())
+			{
+				size_t zeros = 0;
+				while (pos + zeros < planes.size() && planes[pos + zeros] == 0)
+					++zeros;
+				size_t literals = 0;
+				// a single zero byte between literals is cheaper kept as a literal
+				while (pos + zeros + literals < planes.size()
+					   && (planes[pos + zeros + literals] != 0
+						   || (pos + zeros + literals + 1 < planes.size() && planes[pos + zeros + literals + 1] != 0)))
+					++literals;
+				write_varint(zeros, out);
+				write_varint(literals, out);
+				out.append(planes, pos + zeros, literals);
+				pos += zeros + literals;
+			}
+		}
+
+		template <typename Scalar>
+		void decode_matrix(
+			const std::string &in,
+			size_t &pos,
+			const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> &prev,
+			const bool use_float,
+			Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> &mat)
+		{
+			const uint64_t rows = read_varint(in, pos);
+			const uint64_t cols = read_varint(in, pos);
+			if (pos >= in.size())
+				log_and_throw_error("Corrupted solution frame");
+			const bool use_prev = in[pos++] != 0;
+			if (use_prev && (uint64_t(prev.rows()) != rows || uint64_t(prev.cols()) != cols))
+				log_and_throw_error("Corrupted solution frame");
+
+			const int w = word_size<Scalar>(use_float);
+			const size_t n = rows * cols;
+			std::string planes(n * w, 0);
+			for (size_t k = 0; k < planes.size();)
+			{
+				const uint64_t zeros = read_varint(in, pos);
+				const uint64_t literals = read_varint(in, pos);
+				if (k + zeros + literals > planes.size() || pos + literals > in.size())
+					log_and_throw_error("Corrupted solution frame");
+				k += zeros;
+				in.copy(&planes[k], literals, pos);
+				k += literals;
+				pos += literals;
+			}
+
+			mat.resize(rows, cols);
+			for (size_t i = 0; i < n; ++i)
+			{
+				uint64_t word = 0;
+				for (int b = 0; b < w; ++b)
+					word |= uint64_t(uint8_t(planes[b * n + i])) << (8 * b);
+				if (use_prev)
+					word ^= to_word(prev(i), use_float);
+				mat(i) = from_word<Scalar>(word, use_float);
+			}
+		}
+
+		/// Apply f to the fields of a frame and of its reference
+		template <typename F>
+		void for_each_field(SolutionFrame &frame, const SolutionFrame &prev, F f)
+		{
+			f(frame.points, prev.points);
+			f(frame.connectivity, prev.connectivity);
+			f(frame.solution, prev.solution);
+			f(frame.pressure, prev.pressure);
+			f(frame.exact, prev.exact);
+			f(frame.error, prev.error);
+			f(frame.scalar_value, prev.scalar_value);
+			f(frame.scalar_value_avg, prev.scalar_value_avg);
+		}
+	} // namespace
+
+	SolutionFrameStore::SolutionFrameStore(
+		const size_t memory_budget,
+		const std::string &spill_path,
+		const bool use_float,
+		const int keyframe_interval)
+		: memory_budget_(memory_budget),
+		  spill_path_(spill_path),
+		  use_float_(use_float),
+		  keyframe_interval_(keyframe_interval)
+	{
+		if (keyframe_interval_ < 1)
+			log_and_throw_error("Solution frame keyframe interval must be positive");
+		if (memory_budget_ > 0 && spill_path_.empty())
+			log_and_throw_error("Solution frames with a memory budget need a spill file");
+	}
+
+	SolutionFrameStore::~SolutionFrameStore()
+	{
+		clear();
+	}
+
+	void SolutionFrameStore::clear()
+	{
+		entries_.clear();
+		memory_usage_ = 0;
+		spilled_size_ = 0;
+		first_in_memory_ = 0;
+		last_pushed_ = SolutionFrame();
+		cached_index_ = -1;
+		cached_frame_ = SolutionFrame();
+
+		if (spill_file_ != nullptr)
+		{
+			spill_file_ = nullptr;
+			std::error_code ec;
+			std::filesystem::remove(spill_path_, ec);
+		}
+	}
+
+	void SolutionFrameStore::push(const SolutionFrame &frame)
+	{
+		const bool keyframe = is_keyframe(entries_.size());
+
+		Entry entry;
+		std::string &out = entry.data;
+		write_varint(frame.name.size(), out);
+		out += frame.name;
+
+		// the reference of the next frame is this frame as it is decoded
+		SolutionFrame quantized = frame;
+		for_each_field(quantized, last_pushed_, [&](auto &mat, const auto &prev) {
+			encode_matrix(mat, keyframe ? nullptr : &prev, use_float_, out);
+			if constexpr (std::is_same_v<typename std::decay_t<decltype(mat)>::Scalar, double>)
+			{
+				if (use_float_)
+					mat = mat.template cast<float>().template cast<double>();
+			}
+		});
+		last_pushed_ = std::move(quantized);
+
+		entry.size = out.size();
+		memory_usage_ += entry.size;
+		entries_.push_back(std::move(entry));
+
+		spill();
+	}
+
+	void SolutionFrameStore::spill()
+	{
+		if (memory_budget_ == 0 || memory_usage_ <= memory_budget_)
+			return;
+
+		if (spill_file_ == nullptr)
+		{
+			spill_file_ = std::make_unique<std::fstream>(
+				spill_path_, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!spill_file_->good())
+				log_and_throw_error("Failed to open file: {}", spill_path_);
+		}
+
+		spill_file_->seekp(0, std::ios::end);
+		while (memory_usage_ > memory_budget_ && first_in_memory_ < size())
+		{
+			Entry &entry = entries_[first_in_memory_++];
+			entry.offset = spill_file_->tellp();
+			spill_file_->write(entry.data.data(), entry.size);
+			entry.spilled = true;
+			std::string().swap(entry.data);
+
+			memory_usage_ -= entry.size;
+			spilled_size_ += entry.size;
+		}
+		spill_file_->flush();
+		if (!spill_file_->good())
+			log_and_throw_error("Failed to write file: {}", spill_path_);
+	}
+
+	std::string SolutionFrameStore::read_entry(const int i) const
+	{
+		const Entry &entry = entries_[i];
+		if (!entry.spilled)
+			return entry.data;
+
+		std::string data(entry.size, 0);
+		spill_file_->seekg(entry.offset);
+		spill_file_->read(data.data(), entry.size);
+		if (!spill_file_->good())
+			log_and_throw_error("Failed to read file: {}", spill_path_);
+		return data;
+	}
+
+	void SolutionFrameStore::decode(const std::string &data, const SolutionFrame &prev, SolutionFrame &frame) const
+	{
+		size_t pos = 0;
+		const uint64_t name_size = read_varint(data, pos);
+		if (pos + name_size > data.size())
+			log_and_throw_error("Corrupted solution frame");
+		frame.name = data.substr(pos, name_size);
+		pos += name_size;
+
+		for_each_field(frame, prev, [&](auto &mat, const auto &prev_mat) {
+			decode_matrix(data, pos, prev_mat, use_float_, mat);
+		});
+		assert(pos == data.size());
+	}
+
+	SolutionFrame SolutionFrameStore::get(const int i) const
+	{
+		if (i < 0 || i >= size())
+			log_and_throw_error("Solution frame {} out of range [0, {})", i, size());
+
+		// decode from the closest keyframe, or from the cached frame if it is on the way
+		int start = i - i % keyframe_interval_;
+		if (cached_index_ >= start && cached_index_ <= i)
+			start = cached_index_ + 1;
+		else
+			cached_frame_ = SolutionFrame();
+
+		for (int j = start; j <= i; ++j)
+		{
+			SolutionFrame frame;
+			decode(read_entry(j), cached_frame_, frame);
+			cached_frame_ = std::move(frame);
+			cached_index_ = j;
+		}
+
+		return cached_frame_;
+	}
+} // namespace polyfem::io
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <polyfem/io/SolutionFrame.hpp>
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace polyfem::io
+{
+	/// Memory bounded storage of SolutionFrames. Each frame is encoded on push: the fields are optionally
+	/// quantized to float32, XORed bitwise with the same field of the previous frame (except on keyframes),
+	/// byte-shuffled and run-length encoded, so slowly changing or constant fields (e.g., the points and
+	/// connectivity) take little space. When the encoded frames exceed the memory budget, the oldest ones
+	/// are moved to a spill file.
+	///
+	/// A frame is decoded from the closest keyframe before it, so a random access costs at most
+	/// keyframe_interval frame decodings, the last decoded frame is cached for sequential reads.
+	class SolutionFrameStore
+	{
+	public:
+		/// @param memory_budget maximum size in bytes of the encoded frames kept in memory, 0 for no limit
+		/// @param spill_path file receiving the frames above the budget, it is truncated
+		/// @param use_float if true, the fields are stored as float32 (lossy)
+		/// @param keyframe_interval number of frames between two frames encoded without reference to the previous one
+		SolutionFrameStore(
+			const size_t memory_budget = 0,
+			const std::string &spill_path = "",
+			const bool use_float = false,
+			const int keyframe_interval = 16);
+		~SolutionFrameStore();
+
+		/// @brief Encode and append a frame.
+		void push(const SolutionFrame &frame);
+
+		/// @brief Decode the i-th frame.
+		SolutionFrame get(const int i) const;
+
+		int size() const { return entries_.size(); }
+		bool empty() const { return entries_.empty(); }
+
+		/// @brief Size in bytes of the encoded frames kept in memory.
+		size_t memory_usage() const { return memory_usage_; }
+		/// @brief Size in bytes of the encoded frames moved to the spill file.
+		size_t spilled_size() const { return spilled_size_; }
+
+		/// @brief Remove all the frames.
+		void clear();
+
+	private:
+		struct Entry
+		{
+			std::string data;     ///< encoded frame, empty once spilled
+			bool spilled = false; ///< if true, the frame is at offset in the spill file
+			uint64_t offset = 0;
+			uint64_t size = 0;
+		};
+
+		/// @brief Move the oldest frames kept in memory to the spill file until the budget is met.
+		void spill();
+
+		/// @brief Encoded data of the i-th frame.
+		std::string read_entry(const int i) const;
+
+		/// @brief Decode data with prev as reference of the XORed fields.
+		void decode(const std::string &data, const SolutionFrame &prev, SolutionFrame &frame) const;
+
+		bool is_keyframe(const int i) const { return i % keyframe_interval_ == 0; }
+
+		const size_t memory_budget_;
+		const std::string spill_path_;
+		const bool use_float_;
+		const int keyframe_interval_;
+
+		std::vector<Entry> entries_;
+		size_t memory_usage_ = 0;
+		size_t spilled_size_ = 0;
+		int first_in_memory_ = 0; ///< entries before this one are spilled
+
+		/// spill file, opened on the first spill
+		mutable std::unique_ptr<std::fstream> spill_file_;
+
+		SolutionFrame last_pushed_; ///< last pushed frame as it is decoded, reference of the next push
+
+		mutable int cached_index_ = -1; ///< index of cached_frame_, -1 if none
+		mutable SolutionFrame cached_frame_;
+	};
+} // namespace polyfem::io
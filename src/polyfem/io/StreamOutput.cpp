@@ -0,0 +1,318 @@
+#include "StreamOutput.hpp"
+
+#include <polyfem/utils/Logger.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#if !defined(_WIN32)
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace polyfem::io
+{
+	namespace
+	{
+		template <typename T>
+		void append(std::vector<char> &buffer, const T &value)
+		{
+			const char *bytes = reinterpret_cast<const char *>(&value);
+			buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+		}
+
+		uint32_t message_type(const std::vector<char> &message)
+		{
+			uint32_t type;
+			std::memcpy(&type, message.data(), sizeof(type));
+			return type;
+		}
+
+		/// the messages replayed to the new clients
+		bool is_header_message(const std::vector<char> &message)
+		{
+			const uint32_t type = message_type(message);
+			return type == uint32_t(StreamOutput::MessageType::HEADER) || type == uint32_t(StreamOutput::MessageType::SURFACE_POINTS);
+		}
+
+		std::vector<char> json_payload(const json &j)
+		{
+			const std::string text = j.dump();
+			return std::vector<char>(text.begin(), text.end());
+		}
+
+#if !defined(_WIN32)
+		/// false if the client is gone or stalled
+		bool send_message(const int client, const std::vector<char> &message)
+		{
+			size_t sent = 0;
+			while (sent < message.size())
+			{
+				const ssize_t n = send(client, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+				if (n <= 0)
+					return false;
+				sent += n;
+			}
+			return true;
+		}
+#endif
+	} // namespace
+
+	StreamOutput::StreamOutput(const std::string &host, const int port, const int capacity)
+		: capacity_(std::max(capacity, 1))
+	{
+#if defined(_WIN32)
+		log_and_throw_error("Streaming the results is not supported on Windows!");
+#else
+		socket_ = socket(AF_INET, SOCK_STREAM, 0);
+		if (socket_ < 0)
+			log_and_throw_error("Unable to create the stream socket: {}", std::strerror(errno));
+
+		const int reuse = 1;
+		setsockopt(socket_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+		sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_port = htons(port);
+		if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1)
+		{
+			close(socket_);
+			log_and_throw_error("Invalid stream address {}!", host);
+		}
+
+		if (bind(socket_, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || listen(socket_, 8) != 0)
+		{
+			const std::string error = std::strerror(errno);
+			close(socket_);
+			log_and_throw_error("Unable to listen on {}:{}: {}", host, port, error);
+		}
+		// the sender thread polls it for new clients
+		fcntl(socket_, F_SETFL, fcntl(socket_, F_GETFL) | O_NONBLOCK);
+
+		socklen_t length = sizeof(address);
+		getsockname(socket_, reinterpret_cast<sockaddr *>(&address), &length);
+		port_ = ntohs(address.sin_port);
+		logger().info("Streaming the results on {}:{}", host, port_);
+
+		thread_ = std::thread(&StreamOutput::run, this);
+#endif
+	}
+
+	StreamOutput::~StreamOutput()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stop_ = true;
+		}
+		message_available_.notify_all();
+		if (thread_.joinable())
+			thread_.join();
+
+#if !defined(_WIN32)
+		for (const int client : clients_)
+			close(client);
+		if (socket_ >= 0)
+			close(socket_);
+#endif
+
+		if (n_dropped_ > 0)
+			logger().warn("{} streamed messages were dropped, the clients did not keep up", n_dropped_);
+	}
+
+	void StreamOutput::publish_header(const json &header, const Eigen::MatrixXd &surface_points)
+	{
+		std::vector<char> points;
+		append(points, uint32_t(surface_points.rows()));
+		append(points, uint32_t(surface_points.cols()));
+		for (int i = 0; i < surface_points.rows(); ++i)
+			for (int j = 0; j < surface_points.cols(); ++j)
+				append(points, float(surface_points(i, j)));
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			n_published_stats_ = 0;
+		}
+		push(encode_message(MessageType::HEADER, json_payload(header)));
+		push(encode_message(MessageType::SURFACE_POINTS, points));
+	}
+
+	void StreamOutput::publish_step(const int step, const double time, const Eigen::VectorXd &values, const Eigen::MatrixXd &surface)
+	{
+		push(encode_message(MessageType::STEP, encode_step(step, time, values, surface)));
+	}
+
+	void StreamOutput::publish_stats(const json &solver_info)
+	{
+		if (!solver_info.is_array())
+			return;
+
+		size_t start;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			// a new simulation restarted the info
+			if (solver_info.size() < n_published_stats_)
+				n_published_stats_ = 0;
+			start = n_published_stats_;
+			n_published_stats_ = solver_info.size();
+		}
+		if (start == solver_info.size())
+			return;
+
+		const json entries(solver_info.begin() + start, solver_info.end());
+		push(encode_message(MessageType::STATS, json_payload(entries)));
+	}
+
+	size_t StreamOutput::n_dropped() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return n_dropped_;
+	}
+
+	std::vector<char> StreamOutput::encode_step(const int step, const double time, const Eigen::VectorXd &values, const Eigen::MatrixXd &surface)
+	{
+		std::vector<char> payload;
+		payload.reserve(4 + 8 + 4 + 8 * values.size() + 8 + 4 * surface.size());
+
+		append(payload, int32_t(step));
+		append(payload, time);
+		append(payload, uint32_t(values.size()));
+		for (int i = 0; i < values.size(); ++i)
+			append(payload, values(i));
+
+		append(payload, uint32_t(surface.rows()));
+		append(payload, uint32_t(surface.cols()));
+		for (int i = 0; i < surface.rows(); ++i)
+			for (int j = 0; j < surface.cols(); ++j)
+				append(payload, float(surface(i, j)));
+
+		return payload;
+	}
+
+	std::vector<char> StreamOutput::encode_message(const MessageType type, const std::vector<char> &payload)
+	{
+		std::vector<char> message;
+		message.reserve(8 + payload.size());
+		append(message, uint32_t(type));
+		append(message, uint32_t(payload.size()));
+		message.insert(message.end(), payload.begin(), payload.end());
+		return message;
+	}
+
+	size_t StreamOutput::enqueue(std::deque<std::vector<char>> &messages, std::vector<char> message, const size_t capacity)
+	{
+		if (messages.size() < capacity)
+		{
+			messages.push_back(std::move(message));
+			return 0;
+		}
+
+		// a client missing the header cannot decode the steps, only the steps and stats are dropped
+		const auto oldest = std::find_if(messages.begin(), messages.end(), [](const std::vector<char> &m) { return !is_header_message(m); });
+		if (oldest != messages.end())
+		{
+			messages.erase(oldest);
+			messages.push_back(std::move(message));
+			return 1;
+		}
+
+		// only header messages are queued, there are few of them
+		if (is_header_message(message))
+		{
+			messages.push_back(std::move(message));
+			return 0;
+		}
+		return 1;
+	}
+
+	void StreamOutput::push(std::vector<char> message)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			n_dropped_ += enqueue(messages_, std::move(message), capacity_);
+		}
+		message_available_.notify_one();
+	}
+
+	void StreamOutput::run()
+	{
+		while (true)
+		{
+			std::vector<char> message;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				// wakes up regularly to accept the new clients
+				message_available_.wait_for(lock, std::chrono::milliseconds(100), [this]() { return stop_ || !messages_.empty(); });
+				if (messages_.empty())
+				{
+					if (stop_)
+						return;
+				}
+				else
+				{
+					message = std::move(messages_.front());
+					messages_.pop_front();
+				}
+			}
+
+			accept_clients();
+			if (message.empty())
+				continue;
+
+			// the new clients receive the header of the messages sent so far
+			if (message_type(message) == uint32_t(MessageType::HEADER))
+				header_messages_.clear();
+			if (is_header_message(message))
+				header_messages_.push_back(message);
+
+			send_to_clients(message);
+		}
+	}
+
+	void StreamOutput::accept_clients()
+	{
+#if !defined(_WIN32)
+		while (true)
+		{
+			const int client = accept(socket_, nullptr, nullptr);
+			if (client < 0)
+				return;
+
+			// a stalled client is dropped instead of blocking the queue
+			timeval timeout = {1, 0};
+			setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+			logger().debug("Stream client connected");
+
+			bool connected = true;
+			for (const std::vector<char> &message : header_messages_)
+				connected = connected && send_message(client, message);
+
+			if (connected)
+				clients_.push_back(client);
+			else
+				close(client);
+		}
+#endif
+	}
+
+	void StreamOutput::send_to_clients(const std::vector<char> &message)
+	{
+#if !defined(_WIN32)
+		for (auto it = clients_.begin(); it != clients_.end();)
+		{
+			if (!send_message(*it, message))
+			{
+				logger().debug("Stream client disconnected");
+				close(*it);
+				it = clients_.erase(it);
+			}
+			else
+				++it;
+		}
+#endif
+	}
+} // namespace polyfem::io
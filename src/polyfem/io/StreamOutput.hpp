@@ -0,0 +1,110 @@
+#pragma once
+
+#include <polyfem/Common.hpp>
+
+#include <Eigen/Dense>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace polyfem::io
+{
+	/// Publishes the results of the time steps to the clients connected to a TCP socket, so that a run can be
+	/// monitored without polling the output files. The messages are queued and sent by a background thread,
+	/// the solver thread never waits: when the queue is full the oldest step or stats message is dropped.
+	///
+	/// Every message is a header of two little endian uint32, its type and the size of the payload, followed by the payload:
+	///  - header (JSON): columns of the values, dimension and number of surface points, replayed to the new clients,
+	///    a new header starts a new simulation;
+	///  - surface_points (binary): rest positions of the streamed surface points, replayed to the new clients;
+	///  - step (binary): see encode_step;
+	///  - stats (JSON): array of the solver info entries added since the previous step.
+	/// Not supported on Windows.
+	class StreamOutput
+	{
+	public:
+		enum class MessageType : uint32_t
+		{
+			HEADER = 1,
+			SURFACE_POINTS = 2,
+			STEP = 3,
+			STATS = 4,
+		};
+
+		/// @param[in] host address to listen on
+		/// @param[in] port port to listen on, 0 picks a free one (see port())
+		/// @param[in] capacity maximum number of queued messages
+		StreamOutput(const std::string &host, const int port, const int capacity);
+
+		/// Sends the queued messages and closes the connections
+		~StreamOutput();
+
+		StreamOutput(const StreamOutput &) = delete;
+		StreamOutput &operator=(const StreamOutput &) = delete;
+
+		/// @brief Port the socket listens on
+		int port() const { return port_; }
+
+		/// @brief Publishes the description of the stream, sent again to every new client, it is never dropped
+		/// @param[in] header JSON description
+		/// @param[in] surface_points rest positions of the streamed surface points, one per row
+		void publish_header(const json &header, const Eigen::MatrixXd &surface_points);
+
+		/// @brief Queues the results of a step, does not wait for the clients
+		/// @param[in] step index of the time step
+		/// @param[in] time time of the step
+		/// @param[in] values values of the columns of the header (e.g., probes and reductions)
+		/// @param[in] surface surface field at the surface points, one row per point, empty if none
+		void publish_step(const int step, const double time, const Eigen::VectorXd &values, const Eigen::MatrixXd &surface);
+
+		/// @brief Queues the solver info entries added since the previous call
+		/// @param[in] solver_info array of the solver info of the run
+		void publish_stats(const json &solver_info);
+
+		/// @brief Number of messages dropped because the queue was full
+		size_t n_dropped() const;
+
+		/// @brief Payload of a step message: int32 step, float64 time, uint32 number of values, the values as
+		/// float64, uint32 rows and uint32 columns of the surface field, the field row by row as float32
+		static std::vector<char> encode_step(const int step, const double time, const Eigen::VectorXd &values, const Eigen::MatrixXd &surface);
+
+		/// @brief Header and payload of a message
+		static std::vector<char> encode_message(const MessageType type, const std::vector<char> &payload);
+
+		/// @brief Appends the message to the queue. When the queue is full, the oldest step or stats message is dropped
+		/// (or the message itself if the queue has none), the header and surface points messages are never dropped
+		/// @return number of dropped messages, 0 or 1
+		static size_t enqueue(std::deque<std::vector<char>> &messages, std::vector<char> message, const size_t capacity);
+
+	private:
+		void run();
+		void push(std::vector<char> message);
+		void accept_clients();
+		/// sends the message to all the clients, the failed ones are closed
+		void send_to_clients(const std::vector<char> &message);
+
+		int socket_ = -1;
+		int port_ = 0;
+		const size_t capacity_;
+
+		mutable std::mutex mutex_;
+		std::condition_variable message_available_;
+		std::deque<std::vector<char>> messages_;
+		size_t n_dropped_ = 0;
+		bool stop_ = false;
+
+		/// solver info entries already published
+		size_t n_published_stats_ = 0;
+
+		/// only used by the sender thread
+		std::vector<int> clients_;
+		/// header messages already sent, replayed to the new clients
+		std::vector<std::vector<char>> header_messages_;
+		std::thread thread_;
+	};
+} // namespace polyfem::io
@@ -0,0 +1,83 @@
+#include "StressField.hpp"
+
+#include <polyfem/utils/ElasticityUtils.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace polyfem::io
+{
+	std::shared_ptr<const StressField::Values> StressField::get(
+		const std::string &key,
+		const assembler::Assembler &assembler,
+		const std::vector<basis::ElementBases> &bases,
+		const std::vector<basis::ElementBases> &gbases,
+		const std::vector<Eigen::MatrixXd> &local_pts,
+		const Eigen::MatrixXd &sol,
+		const bool need_tensor)
+	{
+		assert(local_pts.size() == bases.size());
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (sol_.rows() != sol.rows() || sol_.cols() != sol.cols() || sol_ != sol)
+		{
+			values_.clear();
+			sol_ = sol;
+		}
+
+		const auto it = values_.find(key);
+		if (it != values_.end() && (it->second->has_tensor || !need_tensor))
+			return it->second;
+
+		auto values = std::make_shared<Values>();
+		values->has_tensor = need_tensor;
+		values->scalar.resize(bases.size());
+		if (need_tensor)
+			values->tensor.resize(bases.size());
+
+		// the von Mises stress of elasticity is a function of the Cauchy stress, it is not computed again
+		const bool is_elasticity = dynamic_cast<const assembler::ElasticityAssembler *>(&assembler) != nullptr;
+
+		utils::maybe_parallel_for(bases.size(), [&](int start, int end, int thread_id) {
+			for (int e = start; e < end; ++e)
+			{
+				if (local_pts[e].rows() == 0)
+					continue;
+
+				if (need_tensor)
+				{
+					std::vector<assembler::Assembler::NamedMatrix> &tensor = values->tensor[e];
+					assembler.compute_tensor_value(e, bases[e], gbases[e], local_pts[e], sol, tensor);
+
+					const auto cauchy = std::find_if(tensor.begin(), tensor.end(), [](const auto &v) { return v.first == "cauchy_stess"; });
+					if (is_elasticity && cauchy != tensor.end())
+					{
+						const int dim = std::round(std::sqrt(cauchy->second.cols()));
+						Eigen::MatrixXd von_mises(cauchy->second.rows(), 1);
+						for (int i = 0; i < cauchy->second.rows(); ++i)
+						{
+							const Eigen::VectorXd flat = cauchy->second.row(i).transpose();
+							von_mises(i) = von_mises_stress_for_stress_tensor(Eigen::Map<const Eigen::MatrixXd>(flat.data(), dim, dim));
+						}
+						values->scalar[e].emplace_back("von_mises", von_mises);
+						continue;
+					}
+				}
+
+				assembler.compute_scalar_value(e, bases[e], gbases[e], local_pts[e], sol, values->scalar[e]);
+			}
+		});
+
+		++n_sweeps_;
+		values_[key] = values;
+		return values;
+	}
+
+	void StressField::clear()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		values_.clear();
+		sol_.resize(0, 0);
+	}
+} // namespace polyfem::io
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <polyfem/assembler/Assembler.hpp>
+#include <polyfem/basis/ElementBases.hpp>
+
+#include <Eigen/Dense>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace polyfem::io
+{
+	/// Scalar (e.g., von Mises) and tensor (e.g., stresses) values of the assembler at the points of every element,
+	/// computed in one parallel sweep per solution and point set and shared by all the outputs of a step.
+	/// The point sets are identified by a key, the values of all the keys are dropped when the solution changes.
+	class StressField
+	{
+	public:
+		struct Values
+		{
+			bool has_tensor = false;
+			/// values of every element, empty for the elements without points
+			std::vector<std::vector<assembler::Assembler::NamedMatrix>> scalar;
+			/// empty if has_tensor is false
+			std::vector<std::vector<assembler::Assembler::NamedMatrix>> tensor;
+		};
+
+		/// @brief Values at the points, computed if they are not stored for the solution and the key
+		/// @param[in] key identifier of the point set, a key is always used with the same points
+		/// @param[in] assembler assembler computing the values
+		/// @param[in] bases bases of the elements
+		/// @param[in] gbases geometric bases of the elements
+		/// @param[in] local_pts points in the reference element of every element, the elements without points are skipped
+		/// @param[in] sol solution
+		/// @param[in] need_tensor the tensor values are needed too
+		std::shared_ptr<const Values> get(
+			const std::string &key,
+			const assembler::Assembler &assembler,
+			const std::vector<basis::ElementBases> &bases,
+			const std::vector<basis::ElementBases> &gbases,
+			const std::vector<Eigen::MatrixXd> &local_pts,
+			const Eigen::MatrixXd &sol,
+			const bool need_tensor);
+
+		/// @brief Drops all the values, e.g. after the bases changed
+		void clear();
+
+		/// @brief Number of sweeps over the elements since the construction
+		int n_sweeps() const { return n_sweeps_; }
+
+	private:
+		std::mutex mutex_;
+		Eigen::MatrixXd sol_;
+		std::map<std::string, std::shared_ptr<const Values>> values_;
+		int n_sweeps_ = 0;
+	};
+} // namespace polyfem::io
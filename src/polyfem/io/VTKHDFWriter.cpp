@@ -0,0 +1,455 @@
+#include "VTKHDFWriter.hpp"
+
+#include <polyfem/utils/Logger.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
+
+#include <hdf5.h>
+#include <zlib.h>
+
+#include <algorithm>
+
+namespace polyfem::io
+{
+	namespace
+	{
+		/// HDF5 identifier closed when going out of scope
+		class Handle
+		{
+		public:
+			Handle(const hid_t id, herr_t (*close)(hid_t), const std::string &what)
+				: id_(id), close_(close)
+			{
+				if (id_ < 0)
+					log_and_throw_error("Failed to {} in VTKHDF file", what);
+			}
+			~Handle() { close_(id_); }
+
+			Handle(const Handle &) = delete;
+			Handle &operator=(const Handle &) = delete;
+
+			operator hid_t() const { return id_; }
+
+		private:
+			const hid_t id_;
+			herr_t (*close_)(hid_t);
+		};
+
+		void check(const herr_t err, const std::string &what)
+		{
+			if (err < 0)
+				log_and_throw_error("Failed to {} in VTKHDF file", what);
+		}
+
+		template <typename T>
+		hid_t native_type();
+		template <>
+		hid_t native_type<double>() { return H5T_NATIVE_DOUBLE; }
+		template <>
+		hid_t native_type<float>() { return H5T_NATIVE_FLOAT; }
+		template <>
+		hid_t native_type<int64_t>() { return H5T_NATIVE_INT64; }
+		template <>
+		hid_t native_type<uint8_t>() { return H5T_NATIVE_UINT8; }
+
+		/// shuffles the bytes of the values then deflates them, as the shuffle and deflate filters of HDF5
+		std::vector<char> compress_chunk(const char *data, const size_t n_values, const size_t value_size, const int compression_level)
+		{
+			const size_t n_bytes = n_values * value_size;
+			std::vector<Bytef> shuffled(n_bytes);
+			for (size_t i = 0; i < n_values; ++i)
+				for (size_t b = 0; b < value_size; ++b)
+					shuffled[b * n_values + i] = data[i * value_size + b];
+
+			uLongf size = compressBound(n_bytes);
+			std::vector<char> compressed(size);
+			if (compress2(reinterpret_cast<Bytef *>(compressed.data()), &size, shuffled.data(), n_bytes, compression_level) != Z_OK)
+				log_and_throw_error("Failed to compress a VTKHDF chunk");
+			compressed.resize(size);
+			return compressed;
+		}
+
+		void write_attribute(const hid_t loc, const std::string &name, const int64_t value)
+		{
+			if (H5Aexists(loc, name.c_str()) <= 0)
+			{
+				Handle space(H5Screate(H5S_SCALAR), H5Sclose, "create the dataspace of " + name);
+				Handle attr(H5Acreate2(loc, name.c_str(), H5T_NATIVE_INT64, space, H5P_DEFAULT, H5P_DEFAULT), H5Aclose, "create " + name);
+			}
+			Handle attr(H5Aopen(loc, name.c_str(), H5P_DEFAULT), H5Aclose, "open " + name);
+			check(H5Awrite(attr, H5T_NATIVE_INT64, &value), "write " + name);
+		}
+
+		void write_attribute(const hid_t loc, const std::string &name, const std::vector<int> &values)
+		{
+			const hsize_t dims[1] = {values.size()};
+			Handle space(H5Screate_simple(1, dims, nullptr), H5Sclose, "create the dataspace of " + name);
+			Handle attr(H5Acreate2(loc, name.c_str(), H5T_NATIVE_INT, space, H5P_DEFAULT, H5P_DEFAULT), H5Aclose, "create " + name);
+			check(H5Awrite(attr, H5T_NATIVE_INT, values.data()), "write " + name);
+		}
+
+		/// VTK reads fixed-length ASCII strings
+		void write_attribute(const hid_t loc, const std::string &name, const std::string &value)
+		{
+			Handle type(H5Tcopy(H5T_C_S1), H5Tclose, "create the type of " + name);
+			check(H5Tset_size(type, value.size()), "set the size of " + name);
+			check(H5Tset_strpad(type, H5T_STR_NULLPAD), "set the padding of " + name);
+			Handle space(H5Screate(H5S_SCALAR), H5Sclose, "create the dataspace of " + name);
+			Handle attr(H5Acreate2(loc, name.c_str(), type, space, H5P_DEFAULT, H5P_DEFAULT), H5Aclose, "create " + name);
+			check(H5Awrite(attr, type, value.c_str()), "write " + name);
+		}
+
+		void create_group(const hid_t loc, const std::string &name)
+		{
+			Handle group(H5Gcreate2(loc, name.c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT), H5Gclose, "create " + name);
+		}
+
+		/// VTK type of a cell from its number of nodes, Lagrange cells above the linear ones
+		uint8_t vtk_cell_type(const int n_nodes, const int dim, const bool is_simplicial)
+		{
+			if (n_nodes == 1)
+				return 1; // VTK_VERTEX
+			if (n_nodes == 2)
+				return 3; // VTK_LINE
+
+			if (is_simplicial)
+			{
+				if (n_nodes == 3)
+					return 5; // VTK_TRIANGLE
+				if (dim == 3 && n_nodes == 4)
+					return 10; // VTK_TETRA
+				return dim == 3 ? 71 : 69; // VTK_LAGRANGE_TETRAHEDRON, VTK_LAGRANGE_TRIANGLE
+			}
+
+			if (n_nodes == 4)
+				return 9; // VTK_QUAD
+			if (dim == 3 && n_nodes == 8)
+				return 12; // VTK_HEXAHEDRON
+			return dim == 3 ? 72 : 70; // VTK_LAGRANGE_HEXAHEDRON, VTK_LAGRANGE_QUADRILATERAL
+		}
+
+		using RowMatrixXd = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+		using RowMatrixXf = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+	} // namespace
+
+	VTKHDFWriter::VTKHDFWriter(const std::string &path, const int compression_level, const int chunk_size)
+		: path_(path), compression_level_(compression_level), chunk_size_(chunk_size)
+	{
+		if (compression_level_ < 0 || compression_level_ > 9)
+			log_and_throw_error("VTKHDF compression level must be in [0, 9], got {}", compression_level_);
+		if (chunk_size_ < 1)
+			log_and_throw_error("VTKHDF chunk size must be positive, got {}", chunk_size_);
+
+		file_ = H5Fcreate(path_.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+		if (file_ < 0)
+			log_and_throw_error("Failed to open file: {}", path_);
+
+		create_group(file_, "VTKHDF");
+		Handle root(H5Gopen2(file_, "VTKHDF", H5P_DEFAULT), H5Gclose, "open VTKHDF");
+		write_attribute(root, "Version", std::vector<int>{2, 0});
+		write_attribute(root, "Type", std::string("UnstructuredGrid"));
+
+		// topologies, one entry per part
+		for (const std::string name : {"NumberOfPoints", "NumberOfCells", "NumberOfConnectivityIds", "Offsets", "Connectivity"})
+			create_dataset("VTKHDF/" + name, H5T_NATIVE_INT64, 0, chunk_size_, compression_level_);
+		create_dataset("VTKHDF/Types", H5T_NATIVE_UINT8, 0, chunk_size_, compression_level_);
+		create_dataset("VTKHDF/Points", H5T_NATIVE_DOUBLE, 3, chunk_size_, compression_level_);
+		create_group(root, "PointData");
+
+		// steps, they are few so the chunks are small
+		create_group(root, "Steps");
+		Handle steps(H5Gopen2(root, "Steps", H5P_DEFAULT), H5Gclose, "open Steps");
+		write_attribute(steps, "NSteps", int64_t(0));
+		create_dataset("VTKHDF/Steps/Values", H5T_NATIVE_DOUBLE, 0, 64, 0);
+		for (const std::string name : {"PartOffsets", "NumberOfParts", "PointOffsets"})
+			create_dataset("VTKHDF/Steps/" + name, H5T_NATIVE_INT64, 0, 64, 0);
+		// one column per topology, only one for unstructured grids
+		for (const std::string name : {"CellOffsets", "ConnectivityIdOffsets"})
+			create_dataset("VTKHDF/Steps/" + name, H5T_NATIVE_INT64, 1, 64, 0);
+		create_group(steps, "PointDataOffsets");
+
+		check(H5Fflush(file_, H5F_SCOPE_GLOBAL), "flush");
+	}
+
+	VTKHDFWriter::~VTKHDFWriter()
+	{
+		if (file_ >= 0)
+			H5Fclose(file_);
+	}
+
+	void VTKHDFWriter::create_dataset(
+		const std::string &path,
+		const int64_t type,
+		const int cols,
+		const int chunk_size,
+		const int compression_level)
+	{
+		const int rank = cols > 0 ? 2 : 1;
+		const hsize_t dims[2] = {0, hsize_t(std::max(cols, 1))};
+		const hsize_t max_dims[2] = {H5S_UNLIMITED, hsize_t(std::max(cols, 1))};
+		const hsize_t chunk[2] = {hsize_t(chunk_size), hsize_t(std::max(cols, 1))};
+
+		Handle space(H5Screate_simple(rank, dims, max_dims), H5Sclose, "create the dataspace of " + path);
+		Handle props(H5Pcreate(H5P_DATASET_CREATE), H5Pclose, "create the properties of " + path);
+		check(H5Pset_chunk(props, rank, chunk), "set the chunks of " + path);
+		if (compression_level > 0)
+		{
+			// only declares the filters for the readers, the chunks are compressed in append
+			check(H5Pset_shuffle(props), "set the shuffle filter of " + path);
+			check(H5Pset_deflate(props, compression_level), "set the compression of " + path);
+			compressed_[path] = CompressedDataset{compression_level, chunk_size, std::max(cols, 1)};
+		}
+		Handle dataset(H5Dcreate2(file_, path.c_str(), type, space, H5P_DEFAULT, props, H5P_DEFAULT), H5Dclose, "create " + path);
+	}
+
+	template <typename T>
+	void VTKHDFWriter::append(const std::string &path, const T *data, const int64_t rows)
+	{
+		Handle dataset(H5Dopen2(file_, path.c_str(), H5P_DEFAULT), H5Dclose, "open " + path);
+
+		hsize_t dims[2] = {0, 1};
+		int rank;
+		{
+			Handle space(H5Dget_space(dataset), H5Sclose, "get the dataspace of " + path);
+			rank = H5Sget_simple_extent_ndims(space);
+			H5Sget_simple_extent_dims(space, dims, nullptr);
+		}
+
+		const hsize_t start[2] = {dims[0], 0};
+		const hsize_t count[2] = {hsize_t(rows), dims[1]};
+		dims[0] += rows;
+		check(H5Dset_extent(dataset, dims), "extend " + path);
+		if (rows == 0)
+			return;
+
+		const auto compressed = compressed_.find(path);
+		if (compressed == compressed_.end())
+		{
+			Handle space(H5Dget_space(dataset), H5Sclose, "get the dataspace of " + path);
+			check(H5Sselect_hyperslab(space, H5S_SELECT_SET, start, nullptr, count, nullptr), "select the rows of " + path);
+			Handle mem_space(H5Screate_simple(rank, count, nullptr), H5Sclose, "create the memory dataspace of " + path);
+			check(H5Dwrite(dataset, native_type<T>(), mem_space, space, H5P_DEFAULT, data), "write " + path);
+			return;
+		}
+
+		// the chunks from the one containing the first new row are compressed again, with the new rows
+		CompressedDataset &info = compressed->second;
+		const size_t row_bytes = info.cols * sizeof(T);
+		const size_t chunk_bytes = info.chunk_size * row_bytes;
+		const int64_t first_chunk = info.rows / info.chunk_size;
+
+		std::vector<char> buffer = std::move(info.tail);
+		buffer.insert(buffer.end(), reinterpret_cast<const char *>(data), reinterpret_cast<const char *>(data) + rows * row_bytes);
+		const size_t n_chunks = (buffer.size() + chunk_bytes - 1) / chunk_bytes;
+
+		std::vector<std::vector<char>> chunks(n_chunks);
+		utils::maybe_parallel_for(n_chunks, [&](int start, int end, int thread_id) {
+			std::vector<char> chunk(chunk_bytes);
+			for (int c = start; c < end; ++c)
+			{
+				// the last chunk is padded with zeros, they are outside of the extent
+				const size_t size = std::min(chunk_bytes, buffer.size() - c * chunk_bytes);
+				std::fill(std::copy_n(buffer.begin() + c * chunk_bytes, size, chunk.begin()), chunk.end(), 0);
+				chunks[c] = compress_chunk(chunk.data(), chunk_bytes / sizeof(T), sizeof(T), info.compression_level);
+			}
+		});
+
+		for (size_t c = 0; c < n_chunks; ++c)
+		{
+			const hsize_t offset[2] = {hsize_t((first_chunk + c) * info.chunk_size), 0};
+			check(H5Dwrite_chunk(dataset, H5P_DEFAULT, 0, offset, chunks[c].size(), chunks[c].data()), "write a chunk of " + path);
+		}
+
+		info.rows += rows;
+		info.tail.assign(buffer.begin() + (buffer.size() / chunk_bytes) * chunk_bytes, buffer.end());
+	}
+
+	void VTKHDFWriter::set_field_options(const std::string &name, const FieldOptions &options)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		if (field_cols_.count(name))
+			log_and_throw_error("Field {} of the VTKHDF file is already written, cannot change its options", name);
+		if (options.compression_level < -1 || options.compression_level > 9)
+			log_and_throw_error("VTKHDF compression level of {} must be in [0, 9], got {}", name, options.compression_level);
+
+		field_options_[name] = options;
+	}
+
+	void VTKHDFWriter::write_step(
+		const double t,
+		const Eigen::MatrixXd &points,
+		const Eigen::MatrixXi &cells,
+		const std::vector<NamedField> &fields)
+	{
+		std::vector<int64_t> connectivity(cells.size());
+		std::vector<int64_t> offsets(cells.rows() + 1);
+		std::vector<uint8_t> types(cells.rows(), vtk_cell_type(cells.cols(), points.cols(), true));
+		for (int i = 0; i < cells.rows(); ++i)
+		{
+			offsets[i] = i * cells.cols();
+			for (int j = 0; j < cells.cols(); ++j)
+				connectivity[i * cells.cols() + j] = cells(i, j);
+		}
+		offsets.back() = cells.size();
+
+		write_step(t, points, connectivity, offsets, types, fields);
+	}
+
+	void VTKHDFWriter::write_step(
+		const double t,
+		const Eigen::MatrixXd &points,
+		const std::vector<std::vector<int>> &cells,
+		const bool is_simplicial,
+		const std::vector<NamedField> &fields)
+	{
+		std::vector<int64_t> connectivity;
+		std::vector<int64_t> offsets(1, 0);
+		std::vector<uint8_t> types;
+		offsets.reserve(cells.size() + 1);
+		types.reserve(cells.size());
+		for (const std::vector<int> &cell : cells)
+		{
+			connectivity.insert(connectivity.end(), cell.begin(), cell.end());
+			offsets.push_back(connectivity.size());
+			types.push_back(vtk_cell_type(cell.size(), points.cols(), is_simplicial));
+		}
+
+		write_step(t, points, connectivity, offsets, types, fields);
+	}
+
+	void VTKHDFWriter::write_step(
+		const double t,
+		const Eigen::MatrixXd &points,
+		const std::vector<int64_t> &connectivity,
+		const std::vector<int64_t> &offsets,
+		const std::vector<uint8_t> &types,
+		const std::vector<NamedField> &fields)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		// checked before writing anything so that a failed step leaves the file valid
+		for (const auto &[name, data] : fields)
+		{
+			const auto cols = field_cols_.find(name);
+			if (cols != field_cols_.end() && cols->second != data.cols())
+				log_and_throw_error("Field {} of the VTKHDF file has {} columns instead of {}", name, data.cols(), cols->second);
+		}
+
+		const bool same_topology =
+			n_parts_ > 0
+			&& last_points_.rows() == points.rows() && last_points_.cols() == points.cols()
+			&& last_points_ == points
+			&& last_connectivity_ == connectivity && last_types_ == types;
+		if (!same_topology)
+			write_topology(points, connectivity, offsets, types);
+
+		append_value("VTKHDF/Steps/Values", t);
+		append_value("VTKHDF/Steps/PartOffsets", n_parts_ - 1);
+		append_value("VTKHDF/Steps/NumberOfParts", int64_t(1));
+		append_value("VTKHDF/Steps/PointOffsets", part_points_offset_);
+		append_value("VTKHDF/Steps/CellOffsets", part_cells_offset_);
+		append_value("VTKHDF/Steps/ConnectivityIdOffsets", part_connectivity_offset_);
+
+		std::map<std::string, bool> written;
+		for (const auto &[name, data] : fields)
+		{
+			if (data.rows() != points.rows())
+			{
+				logger().warn("Skipping field {} of VTKHDF step {}, it has {} rows instead of {}", name, n_steps_, data.rows(), points.rows());
+				continue;
+			}
+			write_field(name, data);
+			written[name] = true;
+		}
+
+		// every step needs all the fields
+		for (const auto &[name, cols] : field_cols_)
+		{
+			if (!written[name])
+				write_field(name, Eigen::MatrixXd::Zero(points.rows(), cols));
+		}
+
+		++n_steps_;
+		Handle steps(H5Gopen2(file_, "VTKHDF/Steps", H5P_DEFAULT), H5Gclose, "open Steps");
+		write_attribute(steps, "NSteps", int64_t(n_steps_));
+
+		check(H5Fflush(file_, H5F_SCOPE_GLOBAL), "flush");
+	}
+
+	void VTKHDFWriter::write_topology(
+		const Eigen::MatrixXd &points,
+		const std::vector<int64_t> &connectivity,
+		const std::vector<int64_t> &offsets,
+		const std::vector<uint8_t> &types)
+	{
+		assert(offsets.size() == types.size() + 1);
+
+		RowMatrixXd points3d = RowMatrixXd::Zero(points.rows(), 3);
+		points3d.leftCols(std::min<int>(points.cols(), 3)) = points.leftCols(std::min<int>(points.cols(), 3));
+
+		append_value("VTKHDF/NumberOfPoints", int64_t(points.rows()));
+		append_value("VTKHDF/NumberOfCells", int64_t(types.size()));
+		append_value("VTKHDF/NumberOfConnectivityIds", int64_t(connectivity.size()));
+		append("VTKHDF/Points", points3d.data(), points3d.rows());
+		append("VTKHDF/Offsets", offsets);
+		append("VTKHDF/Connectivity", connectivity);
+		append("VTKHDF/Types", types);
+
+		part_points_offset_ = n_points_;
+		part_cells_offset_ = n_cells_;
+		part_connectivity_offset_ = n_connectivity_ids_;
+		n_points_ += points.rows();
+		n_cells_ += types.size();
+		n_connectivity_ids_ += connectivity.size();
+		++n_parts_;
+
+		last_points_ = points;
+		last_connectivity_ = connectivity;
+		last_types_ = types;
+	}
+
+	void VTKHDFWriter::write_field(const std::string &name, const Eigen::MatrixXd &data)
+	{
+		const std::string data_path = "VTKHDF/PointData/" + name;
+		const std::string offsets_path = "VTKHDF/Steps/PointDataOffsets/" + name;
+
+		const auto options = field_options_.find(name);
+		const bool float32 = options != field_options_.end() && options->second.float32;
+
+		const auto cols = field_cols_.find(name);
+		if (cols == field_cols_.end())
+		{
+			int compression_level = compression_level_;
+			if (options != field_options_.end() && options->second.compression_level >= 0)
+				compression_level = options->second.compression_level;
+
+			// scalars are 1d arrays
+			create_dataset(
+				data_path, float32 ? H5T_NATIVE_FLOAT : H5T_NATIVE_DOUBLE,
+				data.cols() == 1 ? 0 : data.cols(), chunk_size_, compression_level);
+			create_dataset(offsets_path, H5T_NATIVE_INT64, 0, 64, 0);
+			field_cols_[name] = data.cols();
+			field_rows_[name] = 0;
+
+			// the steps before the field appeared show its first values
+			const std::vector<int64_t> previous(n_steps_, 0);
+			append(offsets_path, previous);
+		}
+		assert(field_cols_[name] == data.cols());
+
+		int64_t &rows = field_rows_[name];
+		append_value(offsets_path, rows);
+
+		if (float32)
+		{
+			const RowMatrixXf row_data = data.cast<float>();
+			append(data_path, row_data.data(), row_data.rows());
+		}
+		else
+		{
+			const RowMatrixXd row_data = data;
+			append(data_path, row_data.data(), row_data.rows());
+		}
+		rows += data.rows();
+	}
+} // namespace polyfem::io
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <Eigen/Core>
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace polyfem::io
+{
+	/// Time series of an unstructured grid in a single VTKHDF (version 2.0) file, readable by ParaView >= 5.12.
+	/// The topology is written once and appended again only when it changes, each step appends its point
+	/// fields to chunked, optionally compressed, datasets. The file is flushed after each step so that the
+	/// steps written so far stay readable if the simulation stops.
+	/// The chunks are compressed in parallel by the writer (as the shuffle and deflate filters of HDF5 would)
+	/// and written directly, HDF5 only compresses on a single thread.
+	class VTKHDFWriter
+	{
+	public:
+		using NamedField = std::pair<std::string, Eigen::MatrixXd>;
+
+		/// storage of a point field
+		struct FieldOptions
+		{
+			int compression_level = -1; ///< deflate level in [0, 9], -1 for the level of the writer
+			bool float32 = false;       ///< store the values in single precision, for visualization only fields
+		};
+
+		/// @param path output file, it is truncated
+		/// @param compression_level deflate level in [0, 9], 0 for no compression
+		/// @param chunk_size number of rows of the dataset chunks
+		VTKHDFWriter(const std::string &path, const int compression_level = 4, const int chunk_size = 4096);
+		~VTKHDFWriter();
+
+		VTKHDFWriter(const VTKHDFWriter &) = delete;
+		VTKHDFWriter &operator=(const VTKHDFWriter &) = delete;
+
+		/// @brief Append a time step with simplicial cells, one per row.
+		/// @param[in] t time of the step
+		/// @param[in] points mesh points, 2d points are padded with zeros
+		/// @param[in] cells mesh cells
+		/// @param[in] fields point fields, one row per point
+		void write_step(
+			const double t,
+			const Eigen::MatrixXd &points,
+			const Eigen::MatrixXi &cells,
+			const std::vector<NamedField> &fields);
+
+		/// @brief Append a time step with cells of any size, e.g., high-order cells or obstacle faces and edges.
+		/// @param[in] t time of the step
+		/// @param[in] points mesh points, 2d points are padded with zeros
+		/// @param[in] cells mesh cells, the VTK cell type is deduced from the number of nodes
+		/// @param[in] is_simplicial if the cells are simplices (otherwise quads or hexes)
+		/// @param[in] fields point fields, one row per point
+		void write_step(
+			const double t,
+			const Eigen::MatrixXd &points,
+			const std::vector<std::vector<int>> &cells,
+			const bool is_simplicial,
+			const std::vector<NamedField> &fields);
+
+		/// @brief Set the storage of a field, to be called before the first step containing it.
+		/// @param[in] name field name
+		/// @param[in] options storage options
+		void set_field_options(const std::string &name, const FieldOptions &options);
+
+		int n_steps() const { return n_steps_; }
+		const std::string &path() const { return path_; }
+
+	private:
+		/// dataset whose chunks are compressed by the writer
+		struct CompressedDataset
+		{
+			int compression_level;
+			int chunk_size;
+			int cols;
+			/// number of rows written
+			int64_t rows = 0;
+			/// uncompressed bytes of the rows of the last, partial, chunk, it is written again with the next rows
+			std::vector<char> tail;
+		};
+
+		/// @brief Create an empty extendible dataset.
+		/// @param[in] path dataset path in the file
+		/// @param[in] type HDF5 type of the values
+		/// @param[in] cols number of columns, 0 for a 1d dataset
+		/// @param[in] chunk_size number of rows of the chunks
+		/// @param[in] compression_level deflate level, 0 for no compression
+		void create_dataset(const std::string &path, const int64_t type, const int cols, const int chunk_size, const int compression_level);
+
+		/// @brief Append rows of row-major values to a dataset.
+		template <typename T>
+		void append(const std::string &path, const T *data, const int64_t rows);
+
+		template <typename T>
+		void append(const std::string &path, const std::vector<T> &data) { append(path, data.data(), data.size()); }
+
+		template <typename T>
+		void append_value(const std::string &path, const T value) { append(path, &value, 1); }
+
+		void write_step(
+			const double t,
+			const Eigen::MatrixXd &points,
+			const std::vector<int64_t> &connectivity,
+			const std::vector<int64_t> &offsets,
+			const std::vector<uint8_t> &types,
+			const std::vector<NamedField> &fields);
+
+		/// @brief Append the topology of a new part.
+		void write_topology(
+			const Eigen::MatrixXd &points,
+			const std::vector<int64_t> &connectivity,
+			const std::vector<int64_t> &offsets,
+			const std::vector<uint8_t> &types);
+
+		/// @brief Append the offset and the values of a field for the current step.
+		void write_field(const std::string &name, const Eigen::MatrixXd &data);
+
+		const std::string path_;
+		const int compression_level_;
+		const int chunk_size_;
+
+		int64_t file_ = -1; ///< HDF5 file handle
+
+		int n_steps_ = 0;
+		int64_t n_parts_ = 0;
+
+		/// first point, cell and connectivity id of the current part
+		int64_t part_points_offset_ = 0;
+		int64_t part_cells_offset_ = 0;
+		int64_t part_connectivity_offset_ = 0;
+
+		/// total number of points, cells and connectivity ids written
+		int64_t n_points_ = 0;
+		int64_t n_cells_ = 0;
+		int64_t n_connectivity_ids_ = 0;
+
+		/// topology of the current part, to detect changes
+		Eigen::MatrixXd last_points_;
+		std::vector<int64_t> last_connectivity_;
+		std::vector<uint8_t> last_types_;
+
+		/// number of rows written per field
+		std::map<std::string, int64_t> field_rows_;
+		/// number of columns per field
+		std::map<std::string, int> field_cols_;
+		/// storage of the fields with non default options
+		std::map<std::string, FieldOptions> field_options_;
+
+		/// datasets compressed by the writer by path
+		std::map<std::string, CompressedDataset> compressed_;
+
+		std::mutex mutex_;
+	};
+} // namespace polyfem::io
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <filesystem>
 
 #include <CLI/CLI.hpp>
@@ -6,6 +7,8 @@
 #include <highfive/H5Easy.hpp>
 
 #include <polyfem/State.hpp>
+#include <polyfem/state/EnsembleRunner.hpp>
+#include <polyfem/state/JobServer.hpp>
 #include <polyfem/utils/JSONUtils.hpp>
 #include <polyfem/utils/Logger.hpp>
 
@@ -45,6 +48,15 @@ int main(int argc, char **argv)
 	bool is_strict = true;
 	command_line.add_flag("-s,--strict_validation,!--ns,!--no_strict_validation", is_strict, "Disables strict validation of input JSON");
 
+	bool server = false;
+	command_line.add_flag("--server", server, "Keeps running and answers JSON-RPC jobs from stdin, the --json file gives the default job arguments");
+
+	int max_cached_states = 4;
+	command_line.add_option("--max_cached_states", max_cached_states, "Maximum number of meshes kept resident by --server");
+
+	std::string ensemble_file = "";
+	command_line.add_option("--ensemble", ensemble_file, "JSON list of merge patches of the --json arguments, the jobs run concurrently (at most --max_threads) with one thread each and their results are printed as JSON lines")->check(CLI::ExistingFile);
+
 	bool fallback_solver = false;
 	command_line.add_flag("--enable_overwrite_solver", fallback_solver, "If solver in json is not present, falls back to default");
 
@@ -67,10 +79,6 @@ int main(int argc, char **argv)
 
 	CLI11_PARSE(command_line, argc, argv);
 
-	std::vector<std::string> names;
-	std::vector<Eigen::MatrixXi> cells;
-	std::vector<Eigen::MatrixXd> vertices;
-
 	json in_args = json({});
 
 	if (!json_file.empty())
@@ -96,21 +104,29 @@ int main(int argc, char **argv)
 		in_args = json::parse(json_string);
 		in_args["root_path"] = hdf5_file;
 
-		HighFive::Group meshes = file.getGroup("meshes");
-		names = meshes.listObjectNames();
-		cells.resize(names.size());
-		vertices.resize(names.size());
-
-		for (size_t i = 0; i < names.size(); ++i)
+		// the meshes stay in the file, the geometry refers to them by name and only their datasets are read when the mesh is loaded
+		const std::string hdf5_path = std::filesystem::absolute(hdf5_file).string();
+		std::vector<std::string> names;
+		if (file.exist("meshes"))
+			names = file.getGroup("meshes").listObjectNames();
+
+		const auto to_hdf5_mesh = [&](json &geometry) {
+			if (geometry.is_object() && geometry.contains("mesh") && geometry["mesh"].is_string()
+				&& std::find(names.begin(), names.end(), geometry["mesh"].get<std::string>()) != names.end())
+			{
+				geometry["hdf5_group"] = "/meshes/" + geometry["mesh"].get<std::string>();
+				geometry["mesh"] = hdf5_path;
+			}
+		};
+		if (in_args.contains("geometry") && in_args["geometry"].is_array())
 		{
-			const auto &s = names[i];
-			const auto &tmp = meshes.getGroup(s);
-
-			tmp.getDataSet("c").read(cells[i]);
-			tmp.getDataSet("v").read(vertices[i]);
+			for (json &geometry : in_args["geometry"])
+				to_hdf5_mesh(geometry);
 		}
+		else if (in_args.contains("geometry"))
+			to_hdf5_mesh(in_args["geometry"]);
 	}
-	else
+	else if (!server)
 	{
 		logger().error("No input file specified!");
 		return command_line.exit(CLI::RequiredError("--json or --hdf5"));
@@ -128,9 +144,44 @@ int main(int argc, char **argv)
 	assert(tmp.is_object());
 	in_args.merge_patch(tmp);
 
+	if (server)
+	{
+		if (!hdf5_file.empty())
+			log_and_throw_error("--server does not support hdf5 inputs");
+
+		JobServer job_server(in_args, is_strict, max_cached_states);
+		job_server.run(std::cin, std::cout);
+		return EXIT_SUCCESS;
+	}
+
+	if (!ensemble_file.empty())
+	{
+		if (!hdf5_file.empty())
+			log_and_throw_error("--ensemble does not support hdf5 inputs");
+
+		std::ifstream file(ensemble_file);
+		json patches;
+		file >> patches;
+		if (!patches.is_array())
+			log_and_throw_error("{} is not a list of job patches", ensemble_file);
+
+		// the jobs run with one thread, --max_threads limits the number of concurrent jobs
+		const int max_jobs = has_arg(command_line, "max_threads") ? int(std::min<size_t>(max_threads, std::numeric_limits<int>::max())) : 0;
+		const EnsembleRunner runner(in_args, is_strict, max_jobs);
+		const std::vector<json> results = runner.run(patches.get<std::vector<json>>());
+
+		bool success = true;
+		for (const json &result : results)
+		{
+			std::cout << result.dump() << std::endl;
+			success &= result["success"].get<bool>();
+		}
+		return success ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
 	State state;
 	state.init(in_args, is_strict);
-	state.load_mesh(/*non_conforming=*/false, names, cells, vertices);
+	state.load_mesh(/*non_conforming=*/false);
 
 	// Mesh was not loaded successfully; load_mesh() logged the error.
 	if (state.mesh == nullptr)
@@ -155,8 +206,10 @@ int main(int argc, char **argv)
 
 	logger().info("total time: {}s", state.timings.total_time());
 
-	state.save_json(sol);
+	// the export is before the statistics to record its memory
 	state.export_data(sol, pressure);
+	state.save_json(sol);
+	state.save_profile();
 
 	return EXIT_SUCCESS;
 }
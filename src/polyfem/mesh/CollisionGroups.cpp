@@ -0,0 +1,49 @@
+#include "CollisionGroups.hpp"
+
+#include <polyfem/utils/Logger.hpp>
+
+namespace polyfem::mesh
+{
+	CollisionGroups::CollisionGroups()
+		: CollisionGroups(json::array(), json::array())
+	{
+	}
+
+	CollisionGroups::CollisionGroups(const json &groups, const json &disabled_pairs)
+	{
+		n_listed_ = groups.size();
+		allowed_.assign(n_groups() * n_groups(), true);
+		set_allowed(obstacle_group(), obstacle_group(), false);
+
+		for (int g = 0; g < n_listed_; ++g)
+		{
+			for (const int body_id : groups[g]["body_ids"])
+			{
+				const auto [it, inserted] = body_to_group_.emplace(body_id, g);
+				if (!inserted)
+					log_and_throw_error("Body {} is in collision groups {} and {}", body_id, it->second, g);
+			}
+			set_allowed(g, g, groups[g].value("self_collision", true));
+		}
+
+		for (const json &pair : disabled_pairs)
+		{
+			const int g0 = pair[0], g1 = pair[1];
+			if (g0 < 0 || g0 >= n_listed_ || g1 < 0 || g1 >= n_listed_)
+				log_and_throw_error("Invalid collision group pair [{}, {}], there are {} groups", g0, g1, n_listed_);
+			set_allowed(g0, g1, false);
+		}
+	}
+
+	int CollisionGroups::group(const int body_id) const
+	{
+		const auto it = body_to_group_.find(body_id);
+		return it == body_to_group_.end() ? default_group() : it->second;
+	}
+
+	void CollisionGroups::set_allowed(const int g0, const int g1, const bool val)
+	{
+		allowed_[g0 * n_groups() + g1] = val;
+		allowed_[g1 * n_groups() + g0] = val;
+	}
+} // namespace polyfem::mesh
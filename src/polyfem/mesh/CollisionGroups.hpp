@@ -0,0 +1,49 @@
+#pragma once
+
+#include <polyfem/Common.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+namespace polyfem::mesh
+{
+	/// @brief Groups of bodies for the contact, with the pairs of groups that can collide.
+	/// The groups listed in /contact/collision_groups come first, then the default group of the bodies not listed,
+	/// and the obstacle group last. Every group collides with every other one unless the pair is disabled,
+	/// the default group collides with itself, and the obstacles do not.
+	class CollisionGroups
+	{
+	public:
+		/// @brief No groups, everything collides except obstacles with obstacles
+		CollisionGroups();
+
+		/// @param[in] groups list of {"body_ids", "self_collision"} (/contact/collision_groups)
+		/// @param[in] disabled_pairs pairs of indices in groups that do not collide (/contact/disabled_group_pairs)
+		CollisionGroups(const json &groups, const json &disabled_pairs);
+
+		/// @brief Group of a body, the default group if it is not listed
+		int group(const int body_id) const;
+
+		int default_group() const { return n_listed_; }
+		int obstacle_group() const { return n_listed_ + 1; }
+		int n_groups() const { return n_listed_ + 2; }
+
+		/// @brief Can primitives of the groups g0 and g1 collide
+		bool can_collide(const int g0, const int g1) const
+		{
+			assert(g0 >= 0 && g0 < n_groups() && g1 >= 0 && g1 < n_groups());
+			return allowed_[g0 * n_groups() + g1];
+		}
+
+		/// @brief The groups filter nothing but the obstacle pairs
+		bool is_trivial() const { return n_listed_ == 0; }
+
+	private:
+		void set_allowed(const int g0, const int g1, const bool val);
+
+		int n_listed_ = 0;
+		std::unordered_map<int, int> body_to_group_;
+		/// n_groups x n_groups, symmetric
+		std::vector<char> allowed_;
+	};
+} // namespace polyfem::mesh
@@ -0,0 +1,110 @@
+#include "FrameSequence.hpp"
+
+#include <polyfem/utils/Logger.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+namespace polyfem::mesh
+{
+	FrameSequence::FrameSequence(const Loader &loader, const int n_frames, const double fps, const Eigen::MatrixXd &first_frame)
+		: loader_(loader), n_frames_(n_frames), fps_(fps), first_frame_(first_frame),
+		  last_t_(std::numeric_limits<double>::quiet_NaN())
+	{
+		if (n_frames_ <= 0)
+			log_and_throw_error("Empty mesh sequence!");
+		frames_[0] = std::make_shared<const Eigen::MatrixXd>(first_frame_);
+	}
+
+	FrameSequence::~FrameSequence()
+	{
+		if (prefetch_.valid())
+			prefetch_.wait();
+	}
+
+	Eigen::MatrixXd FrameSequence::displacement(const double t)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		update(t);
+		return last_displacement_;
+	}
+
+	double FrameSequence::displacement(const double t, const int vertex, const int d)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		update(t);
+		return last_displacement_(vertex, d);
+	}
+
+	int FrameSequence::n_loaded() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return frames_.size() + (prefetch_.valid() ? 1 : 0);
+	}
+
+	void FrameSequence::update(const double t)
+	{
+		if (t == last_t_)
+			return;
+
+		const double frame = t * fps_;
+		const int frame0 = std::clamp(int(std::floor(frame)), 0, n_frames_ - 1);
+		const int frame1 = std::clamp(int(std::ceil(frame)), 0, n_frames_ - 1);
+		const double interp = frame1 == frame0 ? 0 : frame - frame0;
+
+		const std::shared_ptr<const Eigen::MatrixXd> u0 = this->frame(frame0);
+		const std::shared_ptr<const Eigen::MatrixXd> u1 = this->frame(frame1);
+
+		// only the bracketing frames stay in memory
+		for (auto it = frames_.begin(); it != frames_.end();)
+		{
+			if (it->first != frame0 && it->first != frame1)
+				it = frames_.erase(it);
+			else
+				++it;
+		}
+
+		last_displacement_ = (*u1 - *u0) * interp + *u0 - first_frame_;
+		last_t_ = t;
+
+		// the simulation moves forward, read the next frame in the background
+		const int next = frame1 + 1;
+		if (next < n_frames_ && !prefetch_.valid() && frames_.count(next) == 0)
+		{
+			prefetch_frame_ = next;
+			prefetch_ = std::async(std::launch::async, [this, next]() { return load(next); });
+		}
+	}
+
+	std::shared_ptr<const Eigen::MatrixXd> FrameSequence::frame(const int i)
+	{
+		const auto it = frames_.find(i);
+		if (it != frames_.end())
+			return it->second;
+
+		if (prefetch_.valid())
+		{
+			const int prefetched = prefetch_frame_;
+			// rethrows the exception of the loader
+			std::shared_ptr<const Eigen::MatrixXd> res = prefetch_.get();
+			prefetch_frame_ = -1;
+			frames_[prefetched] = res;
+			if (prefetched == i)
+				return res;
+		}
+
+		std::shared_ptr<const Eigen::MatrixXd> res = load(i);
+		frames_[i] = res;
+		return res;
+	}
+
+	std::shared_ptr<const Eigen::MatrixXd> FrameSequence::load(const int i) const
+	{
+		std::shared_ptr<const Eigen::MatrixXd> res = std::make_shared<const Eigen::MatrixXd>(loader_(i));
+		if (res->rows() != first_frame_.rows() || res->cols() != first_frame_.cols())
+			log_and_throw_error("Frame {} of the mesh sequence has {} vertices, expected {}!", i, res->rows(), first_frame_.rows());
+		return res;
+	}
+} // namespace polyfem::mesh
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <Eigen/Dense>
+
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace polyfem::mesh
+{
+	/// Vertex positions of an animated obstacle (mesh sequence) read on demand: only the two frames bracketing the
+	/// last requested time are kept in memory, and the following frame is read by a background thread.
+	class FrameSequence
+	{
+	public:
+		/// @brief Reads the vertex positions of a frame, called from the background thread for the prefetch
+		using Loader = std::function<Eigen::MatrixXd(const int frame)>;
+
+		/// @param[in] loader reads a frame, it is never called concurrently
+		/// @param[in] n_frames number of frames
+		/// @param[in] fps frames per second
+		/// @param[in] first_frame positions of the first frame, the displacements are relative to it
+		FrameSequence(const Loader &loader, const int n_frames, const double fps, const Eigen::MatrixXd &first_frame);
+
+		/// Waits for the prefetch
+		~FrameSequence();
+
+		FrameSequence(const FrameSequence &) = delete;
+		FrameSequence &operator=(const FrameSequence &) = delete;
+
+		/// @brief Displacement from the first frame at time t, linearly interpolated between frames,
+		/// the last frame is kept after the end of the sequence. The result of the last time is reused.
+		/// @param[in] t time
+		/// @return one row per vertex
+		Eigen::MatrixXd displacement(const double t);
+
+		/// @brief Component d of the displacement of a vertex at time t.
+		double displacement(const double t, const int vertex, const int d);
+
+		inline int n_frames() const { return n_frames_; }
+
+		/// @brief Number of frames in memory, including the prefetched one.
+		int n_loaded() const;
+
+	private:
+		// called with the lock held
+		void update(const double t);
+		std::shared_ptr<const Eigen::MatrixXd> frame(const int i);
+		std::shared_ptr<const Eigen::MatrixXd> load(const int i) const;
+
+		const Loader loader_;
+		const int n_frames_;
+		const double fps_;
+		const Eigen::MatrixXd first_frame_;
+
+		mutable std::mutex mutex_;
+		std::map<int, std::shared_ptr<const Eigen::MatrixXd>> frames_;
+		std::future<std::shared_ptr<const Eigen::MatrixXd>> prefetch_;
+		int prefetch_frame_ = -1;
+
+		double last_t_;
+		Eigen::MatrixXd last_displacement_;
+	};
+} // namespace polyfem::mesh
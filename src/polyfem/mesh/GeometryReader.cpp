@@ -1,6 +1,7 @@
 #include "GeometryReader.hpp"
 
 #include <polyfem/mesh/Mesh.hpp>
+#include <polyfem/mesh/MeshCache.hpp>
 #include <polyfem/mesh/MeshUtils.hpp>
 #include <polyfem/io/MshReader.hpp>
 #include <polyfem/utils/StringUtils.hpp>
@@ -8,6 +9,7 @@
 #include <polyfem/utils/JSONUtils.hpp>
 #include <polyfem/utils/Selection.hpp>
 #include <polyfem/utils/Logger.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
 
 #include <Eigen/Core>
 
@@ -16,12 +18,45 @@
 
 #include <strnatcmp.h>
 #include <glob/glob.h>
+#include <exception>
 #include <filesystem>
 
 namespace polyfem::mesh
 {
 	using namespace polyfem::utils;
 
+	namespace
+	{
+		/// Reads the n entries of a geometry concurrently, the results are in the order of the entries.
+		/// The error of the first failed entry is rethrown, as if the entries were read one after another.
+		template <typename T>
+		std::vector<T> read_entries(const int n, const std::function<T(int)> &read)
+		{
+			std::vector<T> results(n);
+			std::vector<std::exception_ptr> errors(n);
+			maybe_parallel_for(n, [&](int start, int end, int /*thread_id*/) {
+				for (int i = start; i < end; ++i)
+				{
+					try
+					{
+						results[i] = read(i);
+					}
+					catch (...)
+					{
+						errors[i] = std::current_exception();
+					}
+				}
+			});
+
+			for (const std::exception_ptr &error : errors)
+			{
+				if (error)
+					std::rethrow_exception(error);
+			}
+			return results;
+		}
+	} // namespace
+
 	std::unique_ptr<Mesh> read_fem_mesh(
 		const json &j_mesh,
 		const std::string &root_path,
@@ -33,7 +68,31 @@ namespace polyfem::mesh
 		if (j_mesh["extract"].get<std::string>() != "volume")
 			log_and_throw_error("Only volumetric elements are implemented for FEM meshes!");
 
-		std::unique_ptr<Mesh> mesh = Mesh::create(resolve_path(j_mesh["mesh"], root_path), non_conforming);
+		std::string mesh_path = resolve_path(j_mesh["mesh"], root_path);
+		const std::string hdf5_group = j_mesh["hdf5_group"];
+		if (!hdf5_group.empty())
+			mesh_path += ":" + hdf5_group;
+
+		std::unique_ptr<MeshCache> cache;
+		std::string cache_key;
+		const std::string cache_directory = j_mesh["advanced"]["cache_directory"];
+		// the cache does not store the refinement levels
+		const bool keep_refinement_levels = j_mesh["advanced"]["keep_refinement_levels"];
+		// the meshes of an HDF5 file are not cached, the key would hash the whole file
+		if (!cache_directory.empty() && !non_conforming && !keep_refinement_levels && hdf5_group.empty())
+		{
+			json options = j_mesh;
+			options["advanced"].erase("cache_directory");
+			cache = std::make_unique<MeshCache>(resolve_path(cache_directory, root_path));
+			cache_key = MeshCache::key(mesh_path, options);
+			if (std::unique_ptr<Mesh> mesh = cache->load(cache_key))
+				return mesh;
+		}
+
+		std::unique_ptr<Mesh> mesh = Mesh::create(mesh_path, non_conforming);
+		if (mesh == nullptr)
+			// error already logged in Mesh::create()
+			log_and_throw_error(fmt::format("Unable to read mesh: {}", mesh_path));
 
 		// --------------------------------------------------------------------
 
@@ -80,7 +139,17 @@ namespace polyfem::mesh
 					log_and_throw_error(fmt::format("Unable to apply stored nonuniform volume_selection because n_refs={} > 0!", n_refs));
 
 			logger().info("Performing global h-refinement with {} refinements", n_refs);
-			mesh->refine(n_refs, refinement_location);
+			if (keep_refinement_levels)
+			{
+				// one level at a time to record the nested meshes, e.g., for geometric multigrid
+				for (int i = 0; i < n_refs; ++i)
+				{
+					mesh->push_refinement_level();
+					mesh->refine(1, refinement_location);
+				}
+			}
+			else
+				mesh->refine(n_refs, refinement_location);
 			mesh->set_body_ids(std::vector<int>(mesh->n_elements(), uniform_value));
 		}
 
@@ -132,8 +201,8 @@ namespace polyfem::mesh
 
 		// --------------------------------------------------------------------
 
-		const std::vector<std::shared_ptr<Selection>> node_selections =
-			is_param_valid(j_mesh, "point_selection") ? Selection::build_selections(j_mesh["point_selection"], bbox, root_path) : std::vector<std::shared_ptr<Selection>>();
+		const SelectionList node_selections(
+			is_param_valid(j_mesh, "point_selection") ? Selection::build_selections(j_mesh["point_selection"], bbox, root_path) : std::vector<std::shared_ptr<Selection>>());
 
 		if (!node_selections.empty())
 		{
@@ -141,13 +210,8 @@ namespace polyfem::mesh
 				if (!is_boundary)
 					return -1;
 
-				const std::vector<int> tmp = {int(n_id)};
-				for (const auto &selection : node_selections)
-				{
-					if (selection->inside(n_id, tmp, p))
-						return selection->id(n_id, tmp, p);
-				}
-				return std::numeric_limits<int>::max(); // default for no selected boundary
+				// default for no selected boundary
+				return node_selections.id(n_id, {int(n_id)}, p, std::numeric_limits<int>::max());
 			});
 		}
 
@@ -156,8 +220,9 @@ namespace polyfem::mesh
 
 		// --------------------------------------------------------------------
 
-		std::vector<std::shared_ptr<Selection>> surface_selections =
-			is_param_valid(j_mesh, "surface_selection") ? Selection::build_selections(j_mesh["surface_selection"], bbox, root_path) : std::vector<std::shared_ptr<Selection>>();
+		// bounded selections are looked up in a BVH, the faces are marked in parallel
+		const SelectionList surface_selections(
+			is_param_valid(j_mesh, "surface_selection") ? Selection::build_selections(j_mesh["surface_selection"], bbox, root_path) : std::vector<std::shared_ptr<Selection>>());
 
 		if (!surface_selections.empty())
 		{
@@ -165,12 +230,8 @@ namespace polyfem::mesh
 				if (!is_boundary)
 					return -1;
 
-				for (const auto &selection : surface_selections)
-				{
-					if (selection->inside(p_id, vs, p))
-						return selection->id(p_id, vs, p);
-				}
-				return std::numeric_limits<int>::max(); // default for no selected boundary
+				// default for no selected boundary
+				return surface_selections.id(p_id, vs, p, std::numeric_limits<int>::max());
 			});
 		}
 
@@ -202,19 +263,18 @@ namespace polyfem::mesh
 			if (mesh->has_body_ids())
 				volume_selections.push_back(std::make_shared<SpecifiedSelection>(mesh->get_body_ids()));
 
+			const SelectionList volume_selection_list(volume_selections);
 			mesh->compute_body_ids([&](const size_t cell_id, const RowVectorNd &p) -> int {
-				for (const auto &selection : volume_selections)
-				{
-					// TODO: add vs to compute_body_ids
-					if (selection->inside(cell_id, {}, p))
-						return selection->id(cell_id, {}, p);
-				}
-				return 0;
+				// TODO: add vs to compute_body_ids
+				return volume_selection_list.id(cell_id, {}, p, 0);
 			});
 		}
 
 		// --------------------------------------------------------------------
 
+		if (cache)
+			cache->save(cache_key, *mesh);
+
 		return mesh;
 	}
 
@@ -259,8 +319,7 @@ namespace polyfem::mesh
 
 		// --------------------------------------------------------------------
 
-		std::unique_ptr<Mesh> mesh = nullptr;
-
+		std::vector<const json *> entries;
 		for (const json &geometry : geometries)
 		{
 			if (!geometry["enabled"].get<bool>() || geometry["is_obstacle"].get<bool>())
@@ -270,12 +329,28 @@ namespace polyfem::mesh
 				log_and_throw_error(
 					fmt::format("Invalid geometry type \"{}\" for FEM mesh!", geometry["type"]));
 
+			entries.push_back(&geometry);
+		}
+
+		// the meshes are read, transformed and selected concurrently
+		std::vector<std::unique_ptr<Mesh>> meshes = read_entries<std::unique_ptr<Mesh>>(entries.size(), [&](int i) {
+			return read_fem_mesh(*entries[i], root_path, non_conforming);
+		});
+
+		std::unique_ptr<Mesh> mesh = nullptr;
+		// the other meshes are appended at once, appending them one by one would copy the accumulated mesh every time
+		std::vector<const Mesh *> to_append;
+		for (std::unique_ptr<Mesh> &tmp : meshes)
+		{
 			if (mesh == nullptr)
-				mesh = read_fem_mesh(geometry, root_path, non_conforming);
-			else
-				mesh->append(read_fem_mesh(geometry, root_path, non_conforming));
+				mesh = std::move(tmp);
+			else if (tmp != nullptr)
+				to_append.push_back(tmp.get());
 		}
 
+		if (mesh != nullptr && !to_append.empty())
+			mesh->append(to_append);
+
 		// --------------------------------------------------------------------
 
 		return mesh;
@@ -410,6 +485,31 @@ namespace polyfem::mesh
 
 		std::vector<json> geometries = utils::json_as_array(geometry);
 
+		// the mesh obstacles are read and transformed concurrently
+		std::vector<const json *> mesh_entries;
+		for (const json &geometry : geometries)
+		{
+			if (geometry["is_obstacle"].get<bool>() && geometry["enabled"].get<bool>() && geometry["type"] == "mesh")
+				mesh_entries.push_back(&geometry);
+		}
+		std::vector<Obstacle::MeshData> read_meshes = read_entries<Obstacle::MeshData>(mesh_entries.size(), [&](int i) {
+			Obstacle::MeshData mesh;
+			read_obstacle_mesh(
+				*mesh_entries[i], root_path, dim, mesh.vertices, mesh.codim_vertices,
+				mesh.codim_edges, mesh.faces);
+			return mesh;
+		});
+		int next_mesh = 0;
+
+		// the meshes are appended in batches, appending them one by one would copy the accumulated obstacle every time
+		std::vector<Obstacle::MeshData> pending_meshes;
+		std::vector<json> pending_displacements;
+		const auto flush_meshes = [&]() {
+			obstacle.append_meshes(pending_meshes, pending_displacements);
+			pending_meshes.clear();
+			pending_displacements.clear();
+		};
+
 		for (const json &geometry : geometries)
 		{
 
@@ -421,13 +521,8 @@ namespace polyfem::mesh
 
 			if (geometry["type"] == "mesh")
 			{
-				Eigen::MatrixXd vertices;
-				Eigen::VectorXi codim_vertices;
-				Eigen::MatrixXi codim_edges;
-				Eigen::MatrixXi faces;
-				read_obstacle_mesh(
-					geometry, root_path, dim, vertices, codim_vertices,
-					codim_edges, faces);
+				assert(mesh_entries[next_mesh] == &geometry);
+				Obstacle::MeshData mesh = std::move(read_meshes[next_mesh++]);
 
 				json displacement = "{\"value\":[0, 0, 0]}"_json;
 				if (is_param_valid(geometry, "surface_selection"))
@@ -480,8 +575,8 @@ namespace polyfem::mesh
 					}
 				}
 
-				obstacle.append_mesh(
-					vertices, codim_vertices, codim_edges, faces, displacement);
+				pending_meshes.push_back(std::move(mesh));
+				pending_displacements.push_back(displacement);
 			}
 			else if (geometry["type"] == "plane")
 			{
@@ -528,39 +623,43 @@ namespace polyfem::mesh
 					});
 				}
 
-				std::vector<Eigen::MatrixXd> vertices(mesh_files.size());
+				if (mesh_files.empty())
+					continue;
+
+				// only the connectivity of the first frame is read now, the frames are read during the simulation
+				Eigen::MatrixXd vertices;
 				Eigen::VectorXi codim_vertices;
 				Eigen::MatrixXi codim_edges;
 				Eigen::MatrixXi faces;
-
-				for (int i = 0; i < mesh_files.size(); ++i)
 				{
 					json jmesh = geometry;
-					jmesh["mesh"] = mesh_files[i];
+					jmesh["mesh"] = mesh_files[0];
 					jmesh["n_refs"] = 0;
+					read_obstacle_mesh(
+						jmesh, root_path, dim, vertices,
+						codim_vertices, codim_edges, faces);
+				}
 
+				const FrameSequence::Loader loader = [geometry, root_path, dim, mesh_files, faces](const int frame) {
+					json jmesh = geometry;
+					jmesh["mesh"] = mesh_files[frame];
+					jmesh["n_refs"] = 0;
+
+					Eigen::MatrixXd frame_vertices;
 					Eigen::VectorXi tmp_codim_vertices;
 					Eigen::MatrixXi tmp_codim_edges;
 					Eigen::MatrixXi tmp_faces;
 					read_obstacle_mesh(
-						jmesh, root_path, dim, vertices[i],
+						jmesh, root_path, dim, frame_vertices,
 						tmp_codim_vertices, tmp_codim_edges, tmp_faces);
-					if (i == 0)
-					{
-						codim_vertices = tmp_codim_vertices;
-						codim_edges = tmp_codim_edges;
-						faces = tmp_faces;
-					}
-					else
-					{
-						assert((codim_vertices.array() == tmp_codim_vertices.array()).all());
-						assert((codim_edges.array() == tmp_codim_edges.array()).all());
-						assert((faces.array() == tmp_faces.array()).all());
-					}
-				}
+					assert((faces.array() == tmp_faces.array()).all());
+					return frame_vertices;
+				};
 
+				// keeps the order of the displacements
+				flush_meshes();
 				obstacle.append_mesh_sequence(
-					vertices, codim_vertices, codim_edges, faces, geometry["fps"]);
+					loader, mesh_files.size(), codim_vertices, codim_edges, faces, geometry["fps"]);
 			}
 			else
 			{
@@ -568,6 +667,7 @@ namespace polyfem::mesh
 					fmt::format("Invalid geometry type \"{}\" for obstacle!", geometry["type"]));
 			}
 		}
+		flush_meshes();
 
 		return obstacle;
 	}
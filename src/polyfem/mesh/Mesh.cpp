@@ -8,9 +8,11 @@
 #include <polyfem/mesh/MeshUtils.hpp>
 #include <polyfem/utils/StringUtils.hpp>
 #include <polyfem/io/MshReader.hpp>
+#include <polyfem/io/MatrixIO.hpp>
 
 #include <polyfem/utils/Logger.hpp>
 #include <polyfem/utils/MatrixUtils.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
 
 #include <geogram/mesh/mesh_io.h>
 #include <geogram/mesh/mesh_geometry.h>
@@ -32,9 +34,10 @@ namespace polyfem::mesh
 
 	namespace
 	{
-		std::vector<int> sort_face(const Eigen::RowVectorXi f)
+		std::array<int, 3> sort_face(const Eigen::RowVectorXi f)
 		{
-			std::vector<int> sorted_face(f.data(), f.data() + f.size());
+			assert(f.size() == 3);
+			std::array<int, 3> sorted_face = {{f[0], f[1], f[2]}};
 			std::sort(sorted_face.begin(), sorted_face.end());
 			return sorted_face;
 		}
@@ -60,21 +63,15 @@ namespace polyfem::mesh
 			const int num_faces = (OF.rows() + BF.rows()) / 2;
 			F.resize(num_faces, 3);
 			F.topRows(BF.rows()) = BF;
-			std::unordered_set<std::vector<int>, HashVector> processed_faces;
-			for (int fi = 0; fi < BF.rows(); fi++)
-			{
-				processed_faces.insert(sort_face(BF.row(fi)));
-			}
+			FlatHashMap<3, int> processed_faces(num_faces);
+			processed_faces.bulk_emplace(
+				BF.rows(), [&](int fi) { return sort_face(BF.row(fi)); }, [](int fi) { return fi; });
 
 			for (int fi = 0; fi < OF.rows(); fi++)
 			{
-				std::vector<int> sorted_face = sort_face(OF.row(fi));
-				const auto iter = processed_faces.find(sorted_face);
-				if (iter == processed_faces.end())
-				{
-					F.row(processed_faces.size()) = OF.row(fi);
-					processed_faces.insert(sorted_face);
-				}
+				const int next = processed_faces.size();
+				if (processed_faces.emplace(sort_face(OF.row(fi)), next).second)
+					F.row(next) = OF.row(fi);
 			}
 
 			assert(F.rows() == processed_faces.size());
@@ -172,6 +169,20 @@ namespace polyfem::mesh
 
 	std::unique_ptr<Mesh> Mesh::create(const std::string &path, const bool non_conforming)
 	{
+		// a group of an HDF5 file with the vertices (v) and cells (c), only these two datasets are read
+		std::string hdf5_file, group;
+		if (io::split_hdf5_dataset_path(path, hdf5_file, group))
+		{
+			Eigen::MatrixXd vertices;
+			Eigen::MatrixXi cells;
+			if (!io::read_matrix_hdf5(hdf5_file, group + "/v", vertices) || !io::read_matrix_hdf5(hdf5_file, group + "/c", cells))
+			{
+				logger().error("Failed to load HDF5 mesh: {}", path);
+				return nullptr;
+			}
+			return create(vertices, cells, non_conforming);
+		}
+
 		if (!std::filesystem::exists(path))
 		{
 			logger().error(path.empty() ? "No mesh provided!" : "Mesh file does not exist: {}", path);
@@ -257,23 +268,22 @@ namespace polyfem::mesh
 
 		if (dim == 2)
 		{
-			std::unordered_set<std::pair<int, int>, HashPair> edges;
-			for (int f = 0; f < cells.rows(); ++f)
-			{
-				for (int lv = 0; lv < cells.cols(); ++lv)
-				{
+			// the edges are numbered in the order of the cells
+			FlatHashMap<2, int> edges(cells.size());
+			edges.bulk_emplace(
+				cells.size(),
+				[&](int i) {
+					const int f = i / cells.cols(), lv = i % cells.cols();
 					const int v0 = cells(f, lv);
 					const int v1 = cells(f, (lv + 1) % cells.cols());
-					edges.emplace(std::pair<int, int>(std::min(v0, v1), std::max(v0, v1)));
-				}
-			}
+					return std::array<int, 2>{{std::min(v0, v1), std::max(v0, v1)}};
+				},
+				[](int) { return 0; });
 			mesh->in_ordered_edges_.resize(edges.size(), 2);
-			int index = 0;
-			for (auto it = edges.begin(); it != edges.end(); ++it)
+			for (int index = 0; index < int(edges.size()); ++index)
 			{
-				mesh->in_ordered_edges_(index, 0) = it->first;
-				mesh->in_ordered_edges_(index, 1) = it->second;
-				++index;
+				mesh->in_ordered_edges_(index, 0) = edges.keys()[index][0];
+				mesh->in_ordered_edges_(index, 1) = edges.keys()[index][1];
 			}
 
 			assert(mesh->in_ordered_edges_.size() > 0);
@@ -452,18 +462,17 @@ namespace polyfem::mesh
 		return res;
 	}
 
-	std::unordered_map<std::pair<int, int>, size_t, HashPair> Mesh::edges_to_ids() const
+	FlatHashMap<2, int> Mesh::edges_to_ids() const
 	{
-		std::unordered_map<std::pair<int, int>, size_t, HashPair> res;
-		res.reserve(n_edges());
-
-		for (int e_id = 0; e_id < n_edges(); ++e_id)
-		{
-			const int e0 = edge_vertex(e_id, 0);
-			const int e1 = edge_vertex(e_id, 1);
-
-			res[std::pair<int, int>(std::min(e0, e1), std::max(e0, e1))] = e_id;
-		}
+		FlatHashMap<2, int> res(n_edges());
+		res.bulk_emplace(
+			n_edges(),
+			[&](int e_id) {
+				const int e0 = edge_vertex(e_id, 0);
+				const int e1 = edge_vertex(e_id, 1);
+				return std::array<int, 2>{{std::min(e0, e1), std::max(e0, e1)}};
+			},
+			[](int e_id) { return e_id; });
 
 		return res;
 	}
@@ -489,125 +498,220 @@ namespace polyfem::mesh
 
 	void Mesh::append(const Mesh &mesh)
 	{
-		const int n_vertices = this->n_vertices();
-
-		elements_tag_.insert(elements_tag_.end(), mesh.elements_tag_.begin(), mesh.elements_tag_.end());
-
-		// --------------------------------------------------------------------
+		append_mesh_data({&mesh});
+	}
 
-		// Initialize node_ids_ if it is not initialized yet.
-		if (!has_node_ids() && mesh.has_node_ids())
+	void Mesh::append(const std::vector<const Mesh *> &meshes)
+	{
+		for (const Mesh *mesh : meshes)
 		{
-			node_ids_.resize(n_vertices);
-			for (int i = 0; i < node_ids_.size(); ++i)
-				node_ids_[i] = get_node_id(i); // results in default if node_ids_ is empty
+			assert(mesh != nullptr);
+			append(*mesh);
 		}
+	}
 
-		if (mesh.has_node_ids())
-		{
-			node_ids_.insert(node_ids_.end(), mesh.node_ids_.begin(), mesh.node_ids_.end());
-		}
-		else if (has_node_ids()) // && !mesh.has_node_ids()
-		{
-			node_ids_.resize(n_vertices + mesh.n_vertices());
-			for (int i = 0; i < mesh.n_vertices(); ++i)
-				node_ids_[n_vertices + i] = mesh.get_node_id(i); // results in default if node_ids_ is empty
-		}
+	void Mesh::append_mesh_data(const std::vector<const Mesh *> &meshes)
+	{
+		if (meshes.empty())
+			return;
 
-		assert(node_ids_.empty() || node_ids_.size() == n_vertices + mesh.n_vertices());
+		const int n_meshes = meshes.size();
+
+		// the refinement levels of the merged mesh are not nested in the ones of the first mesh
+		if (!refinement_levels_.empty())
+		{
+			logger().warn("Appended meshes do not keep their refinement levels");
+			refinement_levels_.clear();
+		}
+
+		// offsets of every appended mesh, the last entry is the total
+		std::vector<int> v_offsets(n_meshes + 1), el_offsets(n_meshes + 1), b_offsets(n_meshes + 1);
+		std::vector<size_t> in_v_offsets(n_meshes + 1), in_e_offsets(n_meshes + 1), in_f_offsets(n_meshes + 1);
+		std::vector<size_t> en_offsets(n_meshes + 1), fn_offsets(n_meshes + 1), cn_offsets(n_meshes + 1), w_offsets(n_meshes + 1);
+		v_offsets[0] = n_vertices();
+		el_offsets[0] = n_elements();
+		b_offsets[0] = n_boundary_elements();
+		in_v_offsets[0] = in_ordered_vertices_.rows();
+		in_e_offsets[0] = in_ordered_edges_.rows();
+		in_f_offsets[0] = in_ordered_faces_.rows();
+		en_offsets[0] = edge_nodes_.size();
+		fn_offsets[0] = face_nodes_.size();
+		cn_offsets[0] = cell_nodes_.size();
+		w_offsets[0] = cell_weights_.size();
+
+		bool any_node_ids = has_node_ids(), any_boundary_ids = has_boundary_ids(), any_body_ids = has_body_ids();
+		bool keep_in_edges = in_ordered_edges_.size() > 0, keep_in_faces = in_ordered_faces_.size() > 0;
+		for (int k = 0; k < n_meshes; ++k)
+		{
+			const Mesh &mesh = *meshes[k];
+			v_offsets[k + 1] = v_offsets[k] + mesh.n_vertices();
+			el_offsets[k + 1] = el_offsets[k] + mesh.n_elements();
+			b_offsets[k + 1] = b_offsets[k] + mesh.n_boundary_elements();
+			in_v_offsets[k + 1] = in_v_offsets[k] + mesh.in_ordered_vertices_.rows();
+			in_e_offsets[k + 1] = in_e_offsets[k] + mesh.in_ordered_edges_.rows();
+			in_f_offsets[k + 1] = in_f_offsets[k] + mesh.in_ordered_faces_.rows();
+			en_offsets[k + 1] = en_offsets[k] + mesh.edge_nodes_.size();
+			fn_offsets[k + 1] = fn_offsets[k] + mesh.face_nodes_.size();
+			cn_offsets[k + 1] = cn_offsets[k] + mesh.cell_nodes_.size();
+			w_offsets[k + 1] = w_offsets[k] + mesh.cell_weights_.size();
+
+			any_node_ids = any_node_ids || mesh.has_node_ids();
+			any_boundary_ids = any_boundary_ids || mesh.has_boundary_ids();
+			any_body_ids = any_body_ids || mesh.has_body_ids();
+			keep_in_edges = keep_in_edges && mesh.in_ordered_edges_.size() > 0;
+			keep_in_faces = keep_in_faces && mesh.in_ordered_faces_.size() > 0;
+			is_rational_ = is_rational_ || mesh.is_rational_;
+
+			assert(in_ordered_vertices_.cols() == mesh.in_ordered_vertices_.cols());
+			assert(!keep_in_edges || in_ordered_edges_.cols() == mesh.in_ordered_edges_.cols());
+			assert(!keep_in_faces || in_ordered_faces_.cols() == mesh.in_ordered_faces_.cols());
+		}
 
 		// --------------------------------------------------------------------
+		// Resize everything once, the missing ids of this mesh get their defaults
 
-		// Initialize boundary_ids_ if it is not initialized yet.
-		if (!has_boundary_ids() && mesh.has_boundary_ids())
-		{
-			boundary_ids_.resize(n_boundary_elements());
-			for (int i = 0; i < boundary_ids_.size(); ++i)
-				boundary_ids_[i] = get_boundary_id(i); // results in default if boundary_ids_ is empty
-		}
+		elements_tag_.resize(el_offsets.back());
 
-		if (mesh.has_boundary_ids())
+		if (any_node_ids)
 		{
-			boundary_ids_.insert(boundary_ids_.end(), mesh.boundary_ids_.begin(), mesh.boundary_ids_.end());
+			const int n = v_offsets[0];
+			if (!has_node_ids())
+			{
+				node_ids_.resize(n);
+				for (int i = 0; i < n; ++i)
+					node_ids_[i] = get_node_id(i); // results in default if node_ids_ is empty
+			}
+			node_ids_.resize(v_offsets.back());
 		}
-		else if (has_boundary_ids()) // && !mesh.has_boundary_ids()
+
+		if (any_boundary_ids)
 		{
-			boundary_ids_.resize(n_boundary_elements() + mesh.n_boundary_elements());
-			for (int i = 0; i < mesh.n_boundary_elements(); ++i)
-				boundary_ids_[n_boundary_elements() + i] = mesh.get_boundary_id(i); // results in default if boundary_ids_ is empty
+			const int n = b_offsets[0];
+			if (!has_boundary_ids())
+			{
+				boundary_ids_.resize(n);
+				for (int i = 0; i < n; ++i)
+					boundary_ids_[i] = get_boundary_id(i); // results in default if boundary_ids_ is empty
+			}
+			boundary_ids_.resize(b_offsets.back());
 		}
 
-		// --------------------------------------------------------------------
+		if (any_body_ids)
+			body_ids_.resize(el_offsets.back(), 0); // 0 is the default body_id
 
-		// Initialize body_ids_ if it is not initialized yet.
-		if (!has_body_ids() && mesh.has_body_ids())
-			body_ids_ = std::vector<int>(n_elements(), 0); // 0 is the default body_id
+		if (orders_.size() == 0)
+			orders_.setOnes(el_offsets[0], 1);
+		orders_.conservativeResize(el_offsets.back(), orders_.cols());
 
-		if (mesh.has_body_ids())
-			body_ids_.insert(body_ids_.end(), mesh.body_ids_.begin(), mesh.body_ids_.end());
-		else if (has_body_ids())                                   // && !mesh.has_body_ids()
-			body_ids_.resize(n_elements() + mesh.n_elements(), 0); // 0 is the default body_id
+		edge_nodes_.resize(en_offsets.back());
+		face_nodes_.resize(fn_offsets.back());
+		cell_nodes_.resize(cn_offsets.back());
+		cell_weights_.resize(w_offsets.back());
+
+		in_ordered_vertices_.conservativeResize(in_v_offsets.back(), in_ordered_vertices_.cols());
+		if (keep_in_edges)
+			in_ordered_edges_.conservativeResize(in_e_offsets.back(), in_ordered_edges_.cols());
+		else
+			in_ordered_edges_.resize(0, 0);
+		if (keep_in_faces)
+			in_ordered_faces_.conservativeResize(in_f_offsets.back(), in_ordered_faces_.cols());
+		else
+			in_ordered_faces_.resize(0, 0);
 
 		// --------------------------------------------------------------------
+		// Every mesh fills its own ranges
 
-		if (orders_.size() == 0)
-			orders_.setOnes(n_elements(), 1);
-		Eigen::MatrixXi mesh_orders = mesh.orders_;
-		if (mesh_orders.size() == 0)
-			mesh_orders.setOnes(mesh.n_elements(), 1);
-		assert(orders_.cols() == mesh_orders.cols());
-		orders_.conservativeResize(orders_.rows() + mesh_orders.rows(), orders_.cols());
-		orders_.bottomRows(mesh_orders.rows()) = mesh_orders;
+		utils::maybe_parallel_for(n_meshes, [&](int start, int end, int thread_id) {
+			for (int k = start; k < end; ++k)
+			{
+				const Mesh &mesh = *meshes[k];
+				const int n_v = v_offsets[k];
 
-		is_rational_ = is_rational_ || mesh.is_rational_;
+				std::copy(mesh.elements_tag_.begin(), mesh.elements_tag_.end(), elements_tag_.begin() + el_offsets[k]);
 
-		// --------------------------------------------------------------------
-		for (const auto &n : mesh.edge_nodes_)
-		{
-			auto tmp = n;
-			tmp.v1 += n_vertices;
-			tmp.v2 += n_vertices;
-			edge_nodes_.push_back(tmp);
-		}
-		for (const auto &n : mesh.face_nodes_)
-		{
-			auto tmp = n;
-			tmp.v1 += n_vertices;
-			tmp.v2 += n_vertices;
-			tmp.v3 += n_vertices;
-			face_nodes_.push_back(tmp);
-		}
-		for (const auto &n : mesh.cell_nodes_)
-		{
-			auto tmp = n;
-			tmp.v1 += n_vertices;
-			tmp.v2 += n_vertices;
-			tmp.v3 += n_vertices;
-			tmp.v4 += n_vertices;
-			cell_nodes_.push_back(tmp);
-		}
-		cell_weights_.insert(cell_weights_.end(), mesh.cell_weights_.begin(), mesh.cell_weights_.end());
-		// --------------------------------------------------------------------
+				if (any_node_ids)
+					for (int i = 0; i < mesh.n_vertices(); ++i)
+						node_ids_[n_v + i] = mesh.get_node_id(i); // results in default if node_ids_ is empty
 
-		assert(in_ordered_vertices_.cols() == mesh.in_ordered_vertices_.cols());
-		in_ordered_vertices_.conservativeResize(in_ordered_vertices_.rows() + mesh.in_ordered_vertices_.rows(), in_ordered_vertices_.cols());
-		in_ordered_vertices_.bottomRows(mesh.in_ordered_vertices_.rows()) = mesh.in_ordered_vertices_.array() + n_vertices;
+				if (any_boundary_ids)
+					for (int i = 0; i < mesh.n_boundary_elements(); ++i)
+						boundary_ids_[b_offsets[k] + i] = mesh.get_boundary_id(i); // results in default if boundary_ids_ is empty
 
-		if (in_ordered_edges_.size() == 0 || mesh.in_ordered_edges_.size() == 0)
-			in_ordered_edges_.resize(0, 0);
-		else
+				if (mesh.has_body_ids())
+					std::copy(mesh.body_ids_.begin(), mesh.body_ids_.end(), body_ids_.begin() + el_offsets[k]);
+
+				if (mesh.orders_.size() == 0)
+					orders_.middleRows(el_offsets[k], mesh.n_elements()).setOnes();
+				else
+				{
+					assert(orders_.cols() == mesh.orders_.cols());
+					orders_.middleRows(el_offsets[k], mesh.orders_.rows()) = mesh.orders_;
+				}
+
+				for (size_t i = 0; i < mesh.edge_nodes_.size(); ++i)
+				{
+					auto &tmp = edge_nodes_[en_offsets[k] + i];
+					tmp = mesh.edge_nodes_[i];
+					tmp.v1 += n_v;
+					tmp.v2 += n_v;
+				}
+				for (size_t i = 0; i < mesh.face_nodes_.size(); ++i)
+				{
+					auto &tmp = face_nodes_[fn_offsets[k] + i];
+					tmp = mesh.face_nodes_[i];
+					tmp.v1 += n_v;
+					tmp.v2 += n_v;
+					tmp.v3 += n_v;
+				}
+				for (size_t i = 0; i < mesh.cell_nodes_.size(); ++i)
+				{
+					auto &tmp = cell_nodes_[cn_offsets[k] + i];
+					tmp = mesh.cell_nodes_[i];
+					tmp.v1 += n_v;
+					tmp.v2 += n_v;
+					tmp.v3 += n_v;
+					tmp.v4 += n_v;
+				}
+				std::copy(mesh.cell_weights_.begin(), mesh.cell_weights_.end(), cell_weights_.begin() + w_offsets[k]);
+
+				in_ordered_vertices_.segment(in_v_offsets[k], mesh.in_ordered_vertices_.rows()) = mesh.in_ordered_vertices_.array() + n_v;
+				if (keep_in_edges)
+					in_ordered_edges_.middleRows(in_e_offsets[k], mesh.in_ordered_edges_.rows()) = mesh.in_ordered_edges_.array() + n_v;
+				if (keep_in_faces)
+					in_ordered_faces_.middleRows(in_f_offsets[k], mesh.in_ordered_faces_.rows()) = mesh.in_ordered_faces_.array() + n_v;
+			}
+		});
+
+		assert(node_ids_.empty() || node_ids_.size() == v_offsets.back());
+	}
+
+	void Mesh::push_refinement_level()
+	{
+		const int n_el = n_elements();
+		const int n_el_vertices = n_el > 0 ? (is_volume() ? n_cell_vertices(0) : n_face_vertices(0)) : 0;
+		for (int e = 0; e < n_el; ++e)
 		{
-			assert(in_ordered_edges_.cols() == mesh.in_ordered_edges_.cols());
-			utils::append_rows(in_ordered_edges_, mesh.in_ordered_edges_.array() + n_vertices);
+			if ((is_volume() ? n_cell_vertices(e) : n_face_vertices(e)) != n_el_vertices)
+			{
+				logger().warn("Refinement levels are only kept for meshes with one element type");
+				refinement_levels_.clear();
+				return;
+			}
 		}
 
-		if (in_ordered_faces_.size() == 0 || mesh.in_ordered_faces_.size() == 0)
-			in_ordered_faces_.resize(0, 0);
-		else
+		RefinementLevel level;
+		level.vertices.resize(n_vertices(), dimension());
+		for (int i = 0; i < n_vertices(); ++i)
+			level.vertices.row(i) = point(i);
+
+		level.cells.resize(n_el, n_el_vertices);
+		for (int e = 0; e < n_el; ++e)
 		{
-			assert(in_ordered_faces_.cols() == mesh.in_ordered_faces_.cols());
-			utils::append_rows(in_ordered_faces_, mesh.in_ordered_faces_.array() + n_vertices);
+			for (int lv = 0; lv < n_el_vertices; ++lv)
+				level.cells(e, lv) = is_volume() ? cell_vertex(e, lv) : face_vertex(e, lv);
 		}
+
+		refinement_levels_.push_back(std::move(level));
 	}
 
 	void Mesh::apply_affine_transformation(const MatrixNd &A, const VectorNd &b)
@@ -618,5 +722,8 @@ namespace polyfem::mesh
 			p = A * p + b;
 			set_point(i, p.transpose());
 		}
+
+		for (RefinementLevel &level : refinement_levels_)
+			level.vertices = ((level.vertices * A.transpose()).rowwise() + b.transpose()).eval();
 	}
 } // namespace polyfem::mesh
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <polyfem/Common.hpp>
 #include <polyfem/mesh/mesh2D/Navigation.hpp>
 #include <polyfem/utils/Types.hpp>
+#include <polyfem/utils/FlatHashMap.hpp>
 #include <polyfem/utils/HashUtils.hpp>
 #include <polyfem/utils/Types.hpp>
 
@@ -424,12 +425,14 @@ namespace polyfem
 			virtual void compute_boundary_ids(const std::function<int(const std::vector<int> &, bool)> &marker) = 0;
 			/// @brief computes boundary selections based on a function
 			///
-			/// @param[in] marker lambda function that takes the id, the list of vertices, the barycenter, and true/false if the element is on the boundary and returns an integer
+			/// @param[in] marker lambda function that takes the id, the list of vertices, the barycenter, and true/false if the element is on the boundary and returns an integer;
+			/// it is called concurrently from several threads
 			virtual void compute_boundary_ids(const std::function<int(const size_t, const std::vector<int> &, const RowVectorNd &, bool)> &marker) = 0;
 
 			/// @brief computes boundary selections based on a function
 			///
-			/// @param[in] marker lambda function that takes the id and barycenter and returns an integer
+			/// @param[in] marker lambda function that takes the id and barycenter and returns an integer;
+			/// it is called concurrently from several threads
 			virtual void compute_body_ids(const std::function<int(const size_t, const RowVectorNd &)> &marker) = 0;
 			/// @brief Set the boundary selection from a vector
 			///
@@ -533,6 +536,11 @@ namespace polyfem
 			///
 			virtual void prepare_mesh(){};
 
+			/// @brief enables the precomputed navigation tables of the conforming meshes, they are built by prepare_mesh
+			///
+			/// @param[in] use if prepare_mesh builds the tables
+			void set_use_navigation_tables(const bool use) { use_navigation_tables_ = use; }
+
 			/// @brief checks if the mesh has polytopes
 			///
 			/// @return if the mesh has polytopes
@@ -575,10 +583,10 @@ namespace polyfem
 			/// @return list of *sorted* faces
 			std::vector<std::vector<int>> faces() const;
 
-			/// @brief map from edge (pair of v id) to the id of the edge
+			/// @brief map from edge (sorted pair of v id) to the id of the edge
 			///
 			/// @return map
-			std::unordered_map<std::pair<int, int>, size_t, polyfem::utils::HashPair> edges_to_ids() const;
+			utils::FlatHashMap<2, int> edges_to_ids() const;
 			/// @brief map from face (tuple of v id) to the id of the face
 			///
 			/// @return map
@@ -611,12 +619,40 @@ namespace polyfem
 					append(*mesh);
 			}
 
+			/// @brief appends several meshes at once to the end of this, the offsets are computed once and the
+			/// arrays are filled in parallel instead of being reallocated for every mesh
+			///
+			/// @param[in] meshes meshes to append, in order, of the same type as this
+			virtual void append(const std::vector<const Mesh *> &meshes);
+
+			/// @brief Vertices and cells of the mesh before a uniform refinement
+			struct RefinementLevel
+			{
+				Eigen::MatrixXd vertices;
+				Eigen::MatrixXi cells;
+			};
+
+			/// @brief Records the current mesh as the next coarse level before it is refined, see refinement_levels.
+			/// Only meshes with one element type (e.g., all triangles) are recorded, mixed meshes clear the levels.
+			void push_refinement_level();
+
+			/// @brief Meshes before each uniform refinement, coarsest first, empty if they were not kept
+			///
+			/// @return list of levels, the current mesh is the refinement of the last one
+			inline const std::vector<RefinementLevel> &refinement_levels() const { return refinement_levels_; }
+
 			/// @brief Apply an affine transformation \f$Ax+b\f$ to the vertex positions \f$x\f$.
 			/// @param[in] A Multiplicative matrix component of transformation
 			/// @param[in] b Additive translation component of transformation
 			void apply_affine_transformation(const MatrixNd &A, const VectorNd &b);
 
 		protected:
+			/// @brief appends the data stored in Mesh (ids, tags, orders, high-order nodes and input orders) of several meshes,
+			/// called by append before the derived classes append their connectivity
+			///
+			/// @param[in] meshes meshes to append, in order
+			void append_mesh_data(const std::vector<const Mesh *> &meshes);
+
 			/// @brief loads a mesh from the path
 			///
 			/// @param[in] path file location
@@ -640,6 +676,8 @@ namespace polyfem
 			Eigen::MatrixXi orders_;
 			/// stores if the mesh is rational
 			bool is_rational_ = false;
+			/// if prepare_mesh builds the navigation tables
+			bool use_navigation_tables_ = false;
 
 			/// high-order nodes associates to edges
 			std::vector<EdgeNodes> edge_nodes_;
@@ -650,6 +688,9 @@ namespace polyfem
 			/// weights associates to cells for rational polynomail meshes
 			std::vector<std::vector<double>> cell_weights_;
 
+			/// meshes before the uniform refinements, coarsest first
+			std::vector<RefinementLevel> refinement_levels_;
+
 			/// Order of the input vertices
 			Eigen::VectorXi in_ordered_vertices_;
 			/// Order of the input edges
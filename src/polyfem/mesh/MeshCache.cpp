@@ -0,0 +1,244 @@
+#include "MeshCache.hpp"
+
+#include <polyfem/io/Checkpoint.hpp>
+#include <polyfem/utils/Logger.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <random>
+
+namespace polyfem::mesh
+{
+	namespace
+	{
+		constexpr int FORMAT_VERSION = 1;
+
+		// FNV-1a
+		class Hasher
+		{
+		public:
+			void add(const char *data, const size_t size)
+			{
+				for (size_t i = 0; i < size; ++i)
+				{
+					hash_ ^= uint8_t(data[i]);
+					hash_ *= 1099511628211ULL;
+				}
+			}
+
+			uint64_t hash() const { return hash_; }
+
+		private:
+			uint64_t hash_ = 14695981039346656037ULL;
+		};
+
+		/// Sorted vertices of a boundary primitive (face in 3d, edge in 2d)
+		std::vector<int> primitive_vertices(const Mesh &mesh, const int p)
+		{
+			std::vector<int> vs;
+			if (mesh.is_volume())
+			{
+				vs.resize(mesh.n_face_vertices(p));
+				for (int i = 0; i < vs.size(); ++i)
+					vs[i] = mesh.face_vertex(p, i);
+			}
+			else
+				vs = {mesh.edge_vertex(p, 0), mesh.edge_vertex(p, 1)};
+			std::sort(vs.begin(), vs.end());
+			return vs;
+		}
+
+		Eigen::MatrixXd to_matrix(const std::vector<int> &values)
+		{
+			Eigen::MatrixXd res(values.size(), 1);
+			for (int i = 0; i < values.size(); ++i)
+				res(i) = values[i];
+			return res;
+		}
+
+		std::vector<int> to_vector(const Eigen::MatrixXd &values)
+		{
+			std::vector<int> res(values.size());
+			for (int i = 0; i < values.size(); ++i)
+				res[i] = int(values(i));
+			return res;
+		}
+	} // namespace
+
+	MeshCache::MeshCache(const std::string &directory)
+		: directory_(directory)
+	{
+		std::filesystem::create_directories(directory_);
+	}
+
+	std::string MeshCache::key(const std::string &mesh_path, const json &options)
+	{
+		Hasher hasher;
+
+		std::ifstream file(mesh_path, std::ios::in | std::ios::binary);
+		if (!file.good())
+			log_and_throw_error("Unable to open mesh file {}", mesh_path);
+		std::vector<char> buffer(1 << 20);
+		while (file)
+		{
+			file.read(buffer.data(), buffer.size());
+			hasher.add(buffer.data(), file.gcount());
+		}
+
+		const std::string dump = options.dump();
+		hasher.add(dump.data(), dump.size());
+
+		return fmt::format("{:016x}", hasher.hash());
+	}
+
+	bool MeshCache::is_cacheable(const Mesh &mesh)
+	{
+		if (!mesh.is_conforming() || !mesh.is_linear() || mesh.is_rational() || mesh.has_poly() || mesh.n_elements() == 0)
+			return false;
+
+		const int n_cell_vertices = mesh.n_cell_vertices(0);
+		for (int e = 1; e < mesh.n_elements(); ++e)
+		{
+			if (mesh.n_cell_vertices(e) != n_cell_vertices)
+				return false;
+		}
+		return true;
+	}
+
+	std::unique_ptr<Mesh> MeshCache::load(const std::string &key) const
+	{
+		const std::string path = entry_path(key);
+		if (!std::filesystem::exists(path))
+			return nullptr;
+
+		io::Checkpoint entry;
+		if (!entry.read(path) || !entry.has("version") || entry.get_scalar("version") != FORMAT_VERSION)
+		{
+			logger().warn("Ignoring invalid mesh cache entry {}", path);
+			return nullptr;
+		}
+
+		const Eigen::MatrixXi cells = entry.get("cells").cast<int>();
+		std::unique_ptr<Mesh> mesh = Mesh::create(entry.get("vertices"), cells);
+		if (!mesh)
+			return nullptr;
+
+		if (entry.has("body_ids"))
+			mesh->set_body_ids(to_vector(entry.get("body_ids")));
+
+		if (entry.has("node_ids"))
+		{
+			const Eigen::MatrixXd &node_ids = entry.get("node_ids");
+			mesh->compute_node_ids([&](const size_t n_id, const RowVectorNd &p, bool is_boundary) {
+				return int(node_ids(n_id));
+			});
+		}
+
+		if (entry.has("boundary_ids"))
+		{
+			// the primitives are matched by vertices, their order may differ in the rebuilt mesh
+			const Eigen::MatrixXd &boundary_vertices = entry.get("boundary_vertices");
+			const Eigen::MatrixXd &boundary_ids = entry.get("boundary_ids");
+			std::map<std::vector<int>, int> ids;
+			for (int p = 0; p < boundary_vertices.rows(); ++p)
+			{
+				std::vector<int> vs;
+				for (int i = 0; i < boundary_vertices.cols() && boundary_vertices(p, i) >= 0; ++i)
+					vs.push_back(int(boundary_vertices(p, i)));
+				ids[vs] = int(boundary_ids(p));
+			}
+
+			mesh->compute_boundary_ids([&](const std::vector<int> &vs, bool is_boundary) {
+				const auto it = ids.find(vs);
+				if (it != ids.end())
+					return it->second;
+				return is_boundary ? std::numeric_limits<int>::max() : -1;
+			});
+		}
+
+		logger().info("Loaded mesh from cache {}", path);
+		return mesh;
+	}
+
+	bool MeshCache::save(const std::string &key, const Mesh &mesh) const
+	{
+		if (!is_cacheable(mesh))
+		{
+			logger().debug("Mesh cannot be cached, skipping");
+			return false;
+		}
+
+		io::Checkpoint entry;
+		entry.set("version", FORMAT_VERSION);
+
+		Eigen::MatrixXd vertices(mesh.n_vertices(), mesh.dimension());
+		for (int v = 0; v < mesh.n_vertices(); ++v)
+			vertices.row(v) = mesh.point(v);
+		entry.set("vertices", vertices);
+
+		Eigen::MatrixXd cells(mesh.n_elements(), mesh.n_cell_vertices(0));
+		for (int e = 0; e < cells.rows(); ++e)
+			for (int i = 0; i < cells.cols(); ++i)
+				cells(e, i) = mesh.cell_vertex(e, i);
+		entry.set("cells", cells);
+
+		if (mesh.has_body_ids())
+			entry.set("body_ids", to_matrix(mesh.get_body_ids()));
+
+		if (mesh.has_node_ids())
+		{
+			std::vector<int> node_ids(mesh.n_vertices());
+			for (int v = 0; v < node_ids.size(); ++v)
+				node_ids[v] = mesh.get_node_id(v);
+			entry.set("node_ids", to_matrix(node_ids));
+		}
+
+		if (mesh.has_boundary_ids())
+		{
+			const int n_primitives = mesh.n_boundary_elements();
+			std::vector<std::vector<int>> primitives(n_primitives);
+			int max_size = 0;
+			for (int p = 0; p < n_primitives; ++p)
+			{
+				primitives[p] = primitive_vertices(mesh, p);
+				max_size = std::max<int>(max_size, primitives[p].size());
+			}
+
+			Eigen::MatrixXd boundary_vertices = Eigen::MatrixXd::Constant(n_primitives, max_size, -1);
+			Eigen::MatrixXd boundary_ids(n_primitives, 1);
+			for (int p = 0; p < n_primitives; ++p)
+			{
+				for (int i = 0; i < primitives[p].size(); ++i)
+					boundary_vertices(p, i) = primitives[p][i];
+				boundary_ids(p) = mesh.get_boundary_id(p);
+			}
+			entry.set("boundary_vertices", boundary_vertices);
+			entry.set("boundary_ids", boundary_ids);
+		}
+
+		// write to a temporary file first so concurrent runs never read a partial entry
+		const std::string path = entry_path(key);
+		const std::string tmp_path = fmt::format("{}.{}.tmp", path, std::random_device()());
+		if (!entry.write(tmp_path))
+			return false;
+		std::error_code ec;
+		std::filesystem::rename(tmp_path, path, ec);
+		if (ec)
+		{
+			std::filesystem::remove(tmp_path, ec);
+			return false;
+		}
+
+		logger().info("Saved mesh to cache {}", path);
+		return true;
+	}
+
+	std::string MeshCache::entry_path(const std::string &key) const
+	{
+		return (std::filesystem::path(directory_) / (key + ".pfmesh")).string();
+	}
+} // namespace polyfem::mesh
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <polyfem/Common.hpp>
+#include <polyfem/mesh/Mesh.hpp>
+
+#include <memory>
+#include <string>
+
+namespace polyfem::mesh
+{
+	/// Content addressed cache of the meshes built by read_fem_mesh, used to skip the parsing,
+	/// transformation, refinement and selections when the same geometry is loaded again.
+	///
+	/// The key is a hash of the mesh file contents and of the geometry options. An entry stores
+	/// the vertices, cells, body ids, node ids and boundary ids in the io::Checkpoint format.
+	/// Only conforming, linear meshes without polytopes can be cached, since they are rebuilt
+	/// with Mesh::create from their vertices and cells.
+	class MeshCache
+	{
+	public:
+		/// @param directory directory of the cache entries, created if missing
+		explicit MeshCache(const std::string &directory);
+
+		/// @brief Key of a mesh.
+		/// @param mesh_path path of the mesh file, its contents are hashed
+		/// @param options geometry options used to build the mesh
+		static std::string key(const std::string &mesh_path, const json &options);
+
+		/// @brief Check if a mesh can be stored in the cache.
+		static bool is_cacheable(const Mesh &mesh);
+
+		/// @brief Load a cached mesh.
+		/// @return the mesh, nullptr if there is no valid entry for the key
+		std::unique_ptr<Mesh> load(const std::string &key) const;
+
+		/// @brief Store a mesh.
+		/// @return true if the mesh was stored
+		bool save(const std::string &key, const Mesh &mesh) const;
+
+	private:
+		std::string entry_path(const std::string &key) const;
+
+		const std::string directory_;
+	};
+} // namespace polyfem::mesh
@@ -0,0 +1,269 @@
+#include "MeshPartition.hpp"
+
+#include <polyfem/utils/Logger.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+namespace polyfem::mesh::partition
+{
+	namespace
+	{
+		// breadth first traversal of the elements with subset[e] == id, starting from root
+		// returns the visited elements in order, level is reset to -1 by the caller
+		void bfs(const std::vector<int> &offsets, const std::vector<int> &neighbors,
+				 const std::vector<int> &subset, const int id, const int root,
+				 std::vector<int> &level, std::vector<int> &order)
+		{
+			order.clear();
+			order.push_back(root);
+			level[root] = 0;
+			for (size_t k = 0; k < order.size(); ++k)
+			{
+				const int e = order[k];
+				for (int l = offsets[e]; l < offsets[e + 1]; ++l)
+				{
+					const int f = neighbors[l];
+					if (subset[f] == id && level[f] < 0)
+					{
+						level[f] = level[e] + 1;
+						order.push_back(f);
+					}
+				}
+			}
+		}
+
+		// elements of the subset in breadth first order, every connected component starts from a pseudo-peripheral element
+		std::vector<int> bfs_order(const std::vector<int> &offsets, const std::vector<int> &neighbors,
+								   const std::vector<int> &subset, const int id, const std::vector<int> &elements,
+								   std::vector<int> &level)
+		{
+			std::vector<int> order, component;
+			order.reserve(elements.size());
+			for (const int seed : elements)
+			{
+				if (level[seed] >= 0)
+					continue;
+
+				// restart from the last element while the eccentricity grows
+				int root = seed;
+				bfs(offsets, neighbors, subset, id, root, level, component);
+				int eccentricity = level[component.back()];
+				for (int iter = 0; iter < 5; ++iter)
+				{
+					const int candidate = component.back();
+					for (const int e : component)
+						level[e] = -1;
+					bfs(offsets, neighbors, subset, id, candidate, level, component);
+					if (level[component.back()] <= eccentricity)
+						break;
+					root = candidate;
+					eccentricity = level[component.back()];
+				}
+				for (const int e : component)
+					level[e] = -1;
+				bfs(offsets, neighbors, subset, id, root, level, component);
+
+				order.insert(order.end(), component.begin(), component.end());
+			}
+
+			for (const int e : order)
+				level[e] = -1;
+			assert(order.size() == elements.size());
+			return order;
+		}
+
+		// greedy pairwise swaps between the two halves of a split that reduce the cut, the sizes are unchanged
+		void refine_split(const std::vector<int> &offsets, const std::vector<int> &neighbors,
+						  std::vector<int> &subset, const int left_id, const int right_id,
+						  const std::vector<int> &elements, std::vector<bool> &locked)
+		{
+			// decrease of the cut when e changes side
+			const auto gain = [&](const int e) {
+				int g = 0;
+				for (int l = offsets[e]; l < offsets[e + 1]; ++l)
+				{
+					const int id = subset[neighbors[l]];
+					if (id == left_id || id == right_id)
+						g += id == subset[e] ? -1 : 1;
+				}
+				return g;
+			};
+
+			std::vector<std::pair<int, int>> left, right;
+			for (int pass = 0; pass < 10; ++pass)
+			{
+				left.clear();
+				right.clear();
+				for (const int e : elements)
+				{
+					const int g = gain(e);
+					// only elements on the interface can have a positive pair gain
+					if (g > -1)
+						(subset[e] == left_id ? left : right).emplace_back(-g, e);
+				}
+				std::sort(left.begin(), left.end());
+				std::sort(right.begin(), right.end());
+
+				int n_swaps = 0;
+				for (size_t i = 0, j = 0; i < left.size() && j < right.size(); ++i, ++j)
+				{
+					const int a = left[i].second;
+					const int b = right[j].second;
+					if (locked[a] || locked[b])
+						continue;
+					// the gains are stale if a neighbor was swapped, recompute them
+					const int ga = gain(a);
+					const int gb = gain(b);
+					const bool adjacent = std::binary_search(neighbors.begin() + offsets[a], neighbors.begin() + offsets[a + 1], b);
+					if (ga + gb - (adjacent ? 2 : 0) <= 0)
+						break;
+
+					std::swap(subset[a], subset[b]);
+					locked[a] = locked[b] = true;
+					++n_swaps;
+				}
+
+				for (const auto &p : left)
+					locked[p.second] = false;
+				for (const auto &p : right)
+					locked[p.second] = false;
+				if (n_swaps == 0)
+					break;
+			}
+		}
+	} // namespace
+
+	void dual_graph(const Mesh &mesh, std::vector<int> &offsets, std::vector<int> &neighbors)
+	{
+		const int n_elements = mesh.n_elements();
+
+		// elements around every vertex
+		std::vector<std::pair<int, int>> vertex_element;
+		for (int e = 0; e < n_elements; ++e)
+			for (int lv = 0; lv < (mesh.is_volume() ? mesh.n_cell_vertices(e) : mesh.n_face_vertices(e)); ++lv)
+				vertex_element.emplace_back(mesh.element_vertex(e, lv), e);
+		utils::maybe_parallel_sort(vertex_element.begin(), vertex_element.end());
+
+		std::vector<size_t> vertex_offsets(1, 0);
+		std::vector<size_t> pair_offsets(1, 0);
+		for (size_t k = 0; k < vertex_element.size();)
+		{
+			size_t l = k;
+			while (l < vertex_element.size() && vertex_element[l].first == vertex_element[k].first)
+				++l;
+			const size_t n = l - k;
+			vertex_offsets.push_back(l);
+			pair_offsets.push_back(pair_offsets.back() + n * (n - 1));
+			k = l;
+		}
+
+		// one pair per shared vertex, facet neighbors share at least dim vertices
+		std::vector<std::pair<int, int>> pairs(pair_offsets.back());
+		utils::maybe_parallel_for(int(vertex_offsets.size()) - 1, [&](int start, int end, int thread_id) {
+			for (int v = start; v < end; ++v)
+			{
+				size_t k = pair_offsets[v];
+				for (size_t i = vertex_offsets[v]; i < vertex_offsets[v + 1]; ++i)
+					for (size_t j = vertex_offsets[v]; j < vertex_offsets[v + 1]; ++j)
+						if (i != j)
+							pairs[k++] = std::make_pair(vertex_element[i].second, vertex_element[j].second);
+			}
+		});
+		utils::maybe_parallel_sort(pairs.begin(), pairs.end());
+
+		const size_t dim = mesh.dimension();
+		offsets.assign(n_elements + 1, 0);
+		neighbors.clear();
+		for (size_t k = 0; k < pairs.size();)
+		{
+			size_t l = k;
+			while (l < pairs.size() && pairs[l] == pairs[k])
+				++l;
+			if (l - k >= dim)
+			{
+				++offsets[pairs[k].first + 1];
+				neighbors.push_back(pairs[k].second);
+			}
+			k = l;
+		}
+		for (int e = 0; e < n_elements; ++e)
+			offsets[e + 1] += offsets[e];
+	}
+
+	Eigen::VectorXi bisection(const Mesh &mesh, const int n_parts)
+	{
+		if (n_parts < 1)
+			log_and_throw_error("Invalid number of parts {}!", n_parts);
+
+		std::vector<int> offsets, neighbors;
+		dual_graph(mesh, offsets, neighbors);
+
+		const int n_elements = mesh.n_elements();
+		// subset[e] is the first part of the range being split that contains e
+		std::vector<int> subset(n_elements, 0);
+		std::vector<int> level(n_elements, -1);
+		std::vector<bool> locked(n_elements, false);
+
+		struct Range
+		{
+			std::vector<int> elements;
+			int first;
+			int n_parts;
+		};
+		std::vector<Range> stack;
+		stack.push_back({std::vector<int>(n_elements), 0, n_parts});
+		for (int e = 0; e < n_elements; ++e)
+			stack.back().elements[e] = e;
+
+		while (!stack.empty())
+		{
+			Range range = std::move(stack.back());
+			stack.pop_back();
+			if (range.n_parts == 1)
+				continue;
+
+			const std::vector<int> order = bfs_order(offsets, neighbors, subset, range.first, range.elements, level);
+
+			const int n_left = range.n_parts / 2;
+			const size_t size_left = range.elements.size() * n_left / range.n_parts;
+
+			const int right_id = range.first + n_left;
+			for (size_t i = size_left; i < order.size(); ++i)
+				subset[order[i]] = right_id;
+			refine_split(offsets, neighbors, subset, range.first, right_id, range.elements, locked);
+
+			Range left{{}, range.first, n_left};
+			Range right{{}, right_id, range.n_parts - n_left};
+			for (const int e : range.elements)
+				(subset[e] == right_id ? right : left).elements.push_back(e);
+
+			stack.push_back(std::move(left));
+			stack.push_back(std::move(right));
+		}
+
+		Eigen::VectorXi part(n_elements);
+		for (int e = 0; e < n_elements; ++e)
+			part[e] = subset[e];
+
+		return part;
+	}
+
+	int edge_cut(const Mesh &mesh, const Eigen::VectorXi &part)
+	{
+		assert(part.size() == mesh.n_elements());
+
+		std::vector<int> offsets, neighbors;
+		dual_graph(mesh, offsets, neighbors);
+
+		int cut = 0;
+		for (int e = 0; e < part.size(); ++e)
+			for (int l = offsets[e]; l < offsets[e + 1]; ++l)
+				if (neighbors[l] > e && part[neighbors[l]] != part[e])
+					++cut;
+
+		return cut;
+	}
+} // namespace polyfem::mesh::partition
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <polyfem/mesh/Mesh.hpp>
+
+#include <Eigen/Dense>
+
+#include <vector>
+
+namespace polyfem::mesh
+{
+	/// @brief Partitioning of the elements of a mesh, the first step to split a problem into independent subdomains.
+	namespace partition
+	{
+		/// @brief Dual graph of the mesh in CSR form: two elements are connected if they share a facet
+		/// (at least dim vertices), the neighbors of every element are sorted.
+		/// @param[in] mesh mesh
+		/// @param[out] offsets neighbors of element e are neighbors[offsets[e]..offsets[e+1])
+		/// @param[out] neighbors concatenated neighbors
+		void dual_graph(const Mesh &mesh, std::vector<int> &offsets, std::vector<int> &neighbors);
+
+		/// @brief Recursive bisection of the dual graph: every part is split along the breadth first order from a
+		/// pseudo-peripheral element, proportionally to the number of parts on each side, then improved by greedy swaps
+		/// of interface elements.
+		/// The part sizes differ by at most one element.
+		/// @param[in] mesh mesh
+		/// @param[in] n_parts number of parts, at least one
+		/// @return part of every element, in [0, n_parts)
+		Eigen::VectorXi bisection(const Mesh &mesh, const int n_parts);
+
+		/// @brief Number of dual graph edges between elements of different parts.
+		/// @param[in] mesh mesh
+		/// @param[in] part part of every element
+		/// @return number of cut facets
+		int edge_cut(const Mesh &mesh, const Eigen::VectorXi &part);
+	} // namespace partition
+} // namespace polyfem::mesh
@@ -6,6 +6,7 @@
 #include <polyfem/utils/StringUtils.hpp>
 #include <polyfem/utils/Logger.hpp>
 #include <polyfem/utils/MatrixUtils.hpp>
+#include <polyfem/utils/FlatHashMap.hpp>
 #include <polyfem/utils/HashUtils.hpp>
 
 #include <unordered_set>
@@ -76,8 +77,14 @@ GEO::vec3 polyfem::mesh::facet_barycenter(const GEO::Mesh &M, GEO::index_t f)
 
 GEO::index_t polyfem::mesh::mesh_create_vertex(GEO::Mesh &M, const GEO::vec3 &p)
 {
-	using GEO::index_t;
 	auto v = M.vertices.create_vertex();
+	mesh_set_vertex(M, v, p);
+	return v;
+}
+
+void polyfem::mesh::mesh_set_vertex(GEO::Mesh &M, GEO::index_t v, const GEO::vec3 &p)
+{
+	using GEO::index_t;
 	for (index_t d = 0; d < std::min(3u, (index_t)M.vertices.dimension()); ++d)
 	{
 		if (M.vertices.double_precision())
@@ -89,7 +96,6 @@ GEO::index_t polyfem::mesh::mesh_create_vertex(GEO::Mesh &M, const GEO::vec3 &p)
 			M.vertices.single_precision_point_ptr(v)[d] = (float)p[d];
 		}
 	}
-	return v;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1019,23 +1025,25 @@ void find_triangle_surface_from_tets(
 	const Eigen::MatrixXi &tets,
 	Eigen::MatrixXi &faces)
 {
-	std::unordered_set<Eigen::Vector3i, HashMatrix> tri_to_tet(4 * tets.rows());
-	for (int i = 0; i < tets.rows(); i++)
-	{
-		tri_to_tet.emplace(tets(i, 0), tets(i, 2), tets(i, 1));
-		tri_to_tet.emplace(tets(i, 0), tets(i, 3), tets(i, 2));
-		tri_to_tet.emplace(tets(i, 0), tets(i, 1), tets(i, 3));
-		tri_to_tet.emplace(tets(i, 1), tets(i, 2), tets(i, 3));
-	}
+	// oriented faces of the tets
+	static const int local_faces[4][3] = {{0, 2, 1}, {0, 3, 2}, {0, 1, 3}, {1, 2, 3}};
+	FlatHashMap<3, int> tri_to_tet(4 * tets.rows());
+	tri_to_tet.bulk_emplace(
+		4 * tets.rows(),
+		[&](int i) {
+			const int *lf = local_faces[i % 4];
+			return std::array<int, 3>{{tets(i / 4, lf[0]), tets(i / 4, lf[1]), tets(i / 4, lf[2])}};
+		},
+		[](int i) { return i / 4; });
 
 	std::vector<Eigen::RowVector3i> faces_vector;
-	for (const auto &tri : tri_to_tet)
+	for (const auto &tri : tri_to_tet.keys())
 	{
 		// find dual triangle with reversed indices:
 		bool is_surface_triangle =
-			tri_to_tet.find(Eigen::Vector3i(tri[2], tri[1], tri[0])) == tri_to_tet.end()
-			&& tri_to_tet.find(Eigen::Vector3i(tri[1], tri[0], tri[2])) == tri_to_tet.end()
-			&& tri_to_tet.find(Eigen::Vector3i(tri[0], tri[2], tri[1])) == tri_to_tet.end();
+			!tri_to_tet.contains({{tri[2], tri[1], tri[0]}})
+			&& !tri_to_tet.contains({{tri[1], tri[0], tri[2]}})
+			&& !tri_to_tet.contains({{tri[0], tri[2], tri[1]}});
 		if (is_surface_triangle)
 		{
 			faces_vector.emplace_back(tri[0], tri[1], tri[2]);
@@ -42,6 +42,14 @@ namespace polyfem
 		//
 		GEO::index_t mesh_create_vertex(GEO::Mesh &M, const GEO::vec3 &p);
 
+		// Set the coordinates of an existing mesh vertex. Different vertices can be set concurrently.
+		//
+		// @param      M     Mesh to modify
+		// @param[in]  v      Vertex to move
+		// @param[in]  p      New vertex position
+		//
+		void mesh_set_vertex(GEO::Mesh &M, GEO::index_t v, const GEO::vec3 &p);
+
 		///
 		/// @brief      Compute the type of each facet in a surface mesh.
 		///
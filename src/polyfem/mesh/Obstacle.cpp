@@ -4,6 +4,7 @@
 #include <polyfem/utils/JSONUtils.hpp>
 #include <polyfem/utils/StringUtils.hpp>
 #include <polyfem/utils/Logger.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
 
 #include <igl/edges.h>
 #include <ipc/utils/eigen_ext.hpp>
@@ -43,65 +44,107 @@ namespace polyfem
 			const Eigen::MatrixXi &codim_edges,
 			const Eigen::MatrixXi &faces)
 		{
-			if (vertices.size() == 0)
-				return;
-
-			if (dim_ == 0)
-				dim_ = vertices.cols();
-			assert(dim_ == vertices.cols());
+			const MeshData mesh{vertices, codim_vertices, codim_edges, faces};
+			append_meshes(std::vector<const MeshData *>{&mesh});
+		}
 
-			if (codim_vertices.size())
+		void Obstacle::append_meshes(const std::vector<const MeshData *> &meshes)
+		{
+			std::vector<const MeshData *> non_empty;
+			for (const MeshData *mesh : meshes)
 			{
-				codim_v_.conservativeResize(codim_v_.size() + codim_vertices.size());
-				codim_v_.tail(codim_vertices.size()) = codim_vertices.array() + v_.rows();
-
-				in_v_.conservativeResize(in_v_.size() + codim_vertices.size());
-				in_v_.tail(codim_vertices.size()) = codim_vertices.array() + v_.rows();
+				if (mesh->vertices.size() == 0)
+					continue;
+				if (mesh->faces.size() && mesh->faces.cols() != 3)
+					log_and_throw_error("Obstacle supports only segments and triangles!");
+
+				if (dim_ == 0)
+					dim_ = mesh->vertices.cols();
+				assert(dim_ == mesh->vertices.cols());
+				non_empty.push_back(mesh);
 			}
+			if (non_empty.empty())
+				return;
 
-			if (codim_edges.size())
+			const int n_meshes = non_empty.size();
+			std::vector<Eigen::MatrixXi> face_edges(n_meshes);
+			utils::maybe_parallel_for(n_meshes, [&](int start, int end, int thread_id) {
+				for (int k = start; k < end; ++k)
+					if (non_empty[k]->faces.size())
+						igl::edges(non_empty[k]->faces, face_edges[k]);
+			});
+
+			// offsets of every mesh, the codim edges of a mesh are followed by the edges of its faces
+			std::vector<int> v_offsets(n_meshes + 1), cv_offsets(n_meshes + 1), e_offsets(n_meshes + 1), in_e_offsets(n_meshes + 1), f_offsets(n_meshes + 1);
+			v_offsets[0] = v_.rows();
+			cv_offsets[0] = codim_v_.size();
+			e_offsets[0] = e_.rows();
+			in_e_offsets[0] = in_e_.rows();
+			f_offsets[0] = f_.rows();
+			const int in_v_shift = in_v_.size() - codim_v_.size();
+			assert(in_f_.rows() == f_.rows());
+			for (int k = 0; k < n_meshes; ++k)
 			{
-				e_.conservativeResize(e_.rows() + codim_edges.rows(), 2);
-				e_.bottomRows(codim_edges.rows()) = codim_edges.array() + v_.rows();
-
-				in_e_.conservativeResize(in_e_.rows() + codim_edges.rows(), 2);
-				in_e_.bottomRows(codim_edges.rows()) = codim_edges.array() + v_.rows();
+				const MeshData &mesh = *non_empty[k];
+				v_offsets[k + 1] = v_offsets[k] + mesh.vertices.rows();
+				cv_offsets[k + 1] = cv_offsets[k] + mesh.codim_vertices.size();
+				e_offsets[k + 1] = e_offsets[k] + mesh.codim_edges.rows() + face_edges[k].rows();
+				in_e_offsets[k + 1] = in_e_offsets[k] + mesh.codim_edges.rows();
+				f_offsets[k + 1] = f_offsets[k] + mesh.faces.rows();
 			}
 
-			if (faces.size() && faces.cols() == 3)
+			// the arrays keep their shape when nothing is added to them
+			v_.conservativeResize(v_offsets.back(), dim_);
+			if (cv_offsets.back() > cv_offsets[0])
 			{
-				f_.conservativeResize(f_.rows() + faces.rows(), 3);
-				f_.bottomRows(faces.rows()) = faces.array() + v_.rows();
-
-				in_f_.conservativeResize(in_f_.rows() + faces.rows(), 3);
-				in_f_.bottomRows(faces.rows()) = faces.array() + v_.rows();
-
-				Eigen::MatrixXi edges;
-				igl::edges(faces, edges);
-
-				e_.conservativeResize(e_.rows() + edges.rows(), 2);
-				e_.bottomRows(edges.rows()) = edges.array() + v_.rows();
+				codim_v_.conservativeResize(cv_offsets.back());
+				in_v_.conservativeResize(in_v_shift + cv_offsets.back());
 			}
-			else if (faces.size())
+			if (e_offsets.back() > e_offsets[0])
+				e_.conservativeResize(e_offsets.back(), 2);
+			if (in_e_offsets.back() > in_e_offsets[0])
+				in_e_.conservativeResize(in_e_offsets.back(), 2);
+			if (f_offsets.back() > f_offsets[0])
 			{
-				log_and_throw_error("Obstacle supports only segments and triangles!");
+				f_.conservativeResize(f_offsets.back(), 3);
+				in_f_.conservativeResize(f_offsets.back(), 3);
 			}
 
-			v_.conservativeResize(v_.rows() + vertices.rows(), dim_);
-			v_.bottomRows(vertices.rows()) = vertices;
+			utils::maybe_parallel_for(n_meshes, [&](int start, int end, int thread_id) {
+				for (int k = start; k < end; ++k)
+				{
+					const MeshData &mesh = *non_empty[k];
+					const int n_v = v_offsets[k];
+
+					v_.middleRows(n_v, mesh.vertices.rows()) = mesh.vertices;
+
+					if (mesh.codim_vertices.size())
+					{
+						codim_v_.segment(cv_offsets[k], mesh.codim_vertices.size()) = mesh.codim_vertices.array() + n_v;
+						in_v_.segment(in_v_shift + cv_offsets[k], mesh.codim_vertices.size()) = mesh.codim_vertices.array() + n_v;
+					}
+
+					if (mesh.codim_edges.size())
+					{
+						e_.middleRows(e_offsets[k], mesh.codim_edges.rows()) = mesh.codim_edges.array() + n_v;
+						in_e_.middleRows(in_e_offsets[k], mesh.codim_edges.rows()) = mesh.codim_edges.array() + n_v;
+					}
+
+					if (mesh.faces.size())
+					{
+						f_.middleRows(f_offsets[k], mesh.faces.rows()) = mesh.faces.array() + n_v;
+						in_f_.middleRows(f_offsets[k], mesh.faces.rows()) = mesh.faces.array() + n_v;
+						e_.middleRows(e_offsets[k] + mesh.codim_edges.rows(), face_edges[k].rows()) = face_edges[k].array() + n_v;
+					}
+				}
+			});
 
-			endings_.push_back(v_.rows());
+			for (int k = 0; k < n_meshes; ++k)
+				endings_.push_back(v_offsets[k + 1]);
 		}
 
-		void Obstacle::append_mesh(
-			const Eigen::MatrixXd &vertices,
-			const Eigen::VectorXi &codim_vertices,
-			const Eigen::MatrixXi &codim_edges,
-			const Eigen::MatrixXi &faces,
-			const json &displacement)
+		void Obstacle::append_displacement(const json &displacement)
 		{
-			append_mesh(vertices, codim_vertices, codim_edges, faces);
-
 			displacements_.emplace_back();
 			for (size_t d = 0; d < dim_; ++d)
 			{
@@ -121,6 +164,30 @@ namespace polyfem
 			}
 		}
 
+		void Obstacle::append_mesh(
+			const Eigen::MatrixXd &vertices,
+			const Eigen::VectorXi &codim_vertices,
+			const Eigen::MatrixXi &codim_edges,
+			const Eigen::MatrixXi &faces,
+			const json &displacement)
+		{
+			append_mesh(vertices, codim_vertices, codim_edges, faces);
+			append_displacement(displacement);
+		}
+
+		void Obstacle::append_meshes(const std::vector<MeshData> &meshes, const std::vector<json> &displacements)
+		{
+			assert(meshes.size() == displacements.size());
+
+			std::vector<const MeshData *> ptrs(meshes.size());
+			for (size_t k = 0; k < meshes.size(); ++k)
+				ptrs[k] = &meshes[k];
+			append_meshes(ptrs);
+
+			for (const json &displacement : displacements)
+				append_displacement(displacement);
+		}
+
 		void Obstacle::append_mesh_sequence(
 			const std::vector<Eigen::MatrixXd> &vertices,
 			const Eigen::VectorXi &codim_vertices,
@@ -131,31 +198,37 @@ namespace polyfem
 			if (vertices.size() == 0 || vertices[0].size() == 0)
 				return;
 
-			append_mesh(vertices[0], codim_vertices, codim_edges, faces);
+			const auto frames = std::make_shared<const std::vector<Eigen::MatrixXd>>(vertices);
+			append_mesh_sequence(
+				[frames](const int frame) { return (*frames)[frame]; }, frames->size(),
+				codim_vertices, codim_edges, faces, fps);
+		}
 
-			std::array<std::vector<Eigen::MatrixXd>, 3> displacements_xyz;
-			for (size_t i = 0; i < vertices.size(); ++i)
-			{
-				Eigen::MatrixXd displacement = vertices[i] - vertices[0];
-				for (size_t d = 0; d < dim_; ++d)
-					displacements_xyz[d].push_back(displacement.col(d));
-			}
+		void Obstacle::append_mesh_sequence(
+			const FrameSequence::Loader &loader,
+			const int n_frames,
+			const Eigen::VectorXi &codim_vertices,
+			const Eigen::MatrixXi &codim_edges,
+			const Eigen::MatrixXi &faces,
+			const int fps)
+		{
+			if (n_frames <= 0)
+				return;
+
+			const Eigen::MatrixXd first_frame = loader(0);
+			if (first_frame.size() == 0)
+				return;
+
+			append_mesh(first_frame, codim_vertices, codim_edges, faces);
 
+			// the frames are shared by the components, only the bracketing ones are in memory
+			const auto sequence = std::make_shared<FrameSequence>(loader, n_frames, fps, first_frame);
 			displacements_.emplace_back();
 			for (size_t d = 0; d < dim_; ++d)
 			{
-				const std::vector<Eigen::MatrixXd> displacements = displacements_xyz[d];
 				displacements_.back().value[d].init(
-					[displacements, fps](double x, double y, double z, double t, int index) -> double {
-						const double frame = t * fps;
-						const double interp = frame - floor(frame);
-						const int frame0 = (int)floor(frame);
-						const int frame1 = (int)ceil(frame);
-						if (frame1 >= displacements.size())
-							return displacements.back()(index);
-						const double u0 = displacements[frame0](index);
-						const double u1 = displacements[frame1](index);
-						return (u1 - u0) * interp + u0;
+					[sequence, d](double x, double y, double z, double t, int index) -> double {
+						return sequence->displacement(t, index, d);
 					});
 			}
 		}
@@ -6,6 +6,7 @@
 #include <polyfem/utils/Types.hpp>
 
 #include <polyfem/assembler/GenericProblem.hpp>
+#include <polyfem/mesh/FrameSequence.hpp>
 
 #include <Eigen/Dense>
 
@@ -19,6 +20,21 @@ namespace polyfem
 			Obstacle();
 			virtual ~Obstacle() = default;
 
+			/// Geometry of one obstacle mesh
+			struct MeshData
+			{
+				Eigen::MatrixXd vertices;
+				Eigen::VectorXi codim_vertices;
+				Eigen::MatrixXi codim_edges;
+				Eigen::MatrixXi faces;
+			};
+
+			/// @brief Appends several meshes at once, the arrays are resized once and filled in parallel
+			/// (appending them one by one copies the accumulated obstacle every time).
+			/// @param[in] meshes geometries, in order
+			/// @param[in] displacements one displacement per mesh
+			void append_meshes(const std::vector<MeshData> &meshes, const std::vector<json> &displacements);
+
 			void append_mesh(
 				const Eigen::MatrixXd &vertices,
 				const Eigen::VectorXi &codim_vertices,
@@ -31,6 +47,20 @@ namespace polyfem
 				const Eigen::MatrixXi &codim_edges,
 				const Eigen::MatrixXi &faces,
 				const int fps);
+			/// @brief Appends a mesh sequence whose frames are read on demand, see FrameSequence.
+			/// @param[in] loader reads the vertex positions of a frame
+			/// @param[in] n_frames number of frames
+			/// @param[in] codim_vertices codimensional vertices, shared by all frames
+			/// @param[in] codim_edges codimensional edges, shared by all frames
+			/// @param[in] faces faces, shared by all frames
+			/// @param[in] fps frames per second
+			void append_mesh_sequence(
+				const FrameSequence::Loader &loader,
+				const int n_frames,
+				const Eigen::VectorXi &codim_vertices,
+				const Eigen::MatrixXi &codim_edges,
+				const Eigen::MatrixXi &faces,
+				const int fps);
 			void append_plane(const VectorNd &point, const VectorNd &normal);
 
 			inline int n_vertices() const { return v_.rows(); }
@@ -69,6 +99,8 @@ namespace polyfem
 				const Eigen::VectorXi &codim_vertices,
 				const Eigen::MatrixXi &codim_edges,
 				const Eigen::MatrixXi &faces);
+			void append_meshes(const std::vector<const MeshData *> &meshes);
+			void append_displacement(const json &displacement);
 
 			int dim_;
 			Eigen::MatrixXd v_;
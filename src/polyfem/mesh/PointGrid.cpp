@@ -0,0 +1,150 @@
+#include "PointGrid.hpp"
+
+#include <polyfem/utils/MaybeParallelFor.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+namespace polyfem::mesh
+{
+	namespace
+	{
+		// at most this many cells per point, bounds the memory for tiny requested cell sizes
+		const int max_cells_per_point = 4;
+	} // namespace
+
+	PointGrid::PointGrid(const Eigen::MatrixXd &points, const double cell_size)
+		: points_(points)
+	{
+		const int n = points_.rows();
+		const int dim = points_.cols();
+		n_cells_.setOnes(dim);
+		offsets_.assign(2, 0);
+		if (n == 0)
+			return;
+
+		min_ = points_.colwise().minCoeff();
+		const RowVectorNd extent = points_.colwise().maxCoeff() - min_;
+
+		cell_size_ = cell_size > 0 ? cell_size : std::max(extent.maxCoeff(), 1e-10);
+		const auto count = [&](const double h) {
+			double res = 1;
+			for (int d = 0; d < dim; ++d)
+				res *= std::floor(extent(d) / h) + 1;
+			return res;
+		};
+		while (count(cell_size_) > double(max_cells_per_point) * n + 1)
+			cell_size_ *= 2;
+
+		for (int d = 0; d < dim; ++d)
+			n_cells_(d) = int(std::floor(extent(d) / cell_size_)) + 1;
+
+		std::vector<long> cell(n);
+		utils::maybe_parallel_for(n, [&](int start, int end, int thread_id) {
+			for (int i = start; i < end; ++i)
+				cell[i] = cell_index(cell_coords(points_.row(i)));
+		});
+
+		// counting sort, the points of every cell stay in increasing order
+		offsets_.assign(n_cells_.cast<long>().prod() + 1, 0);
+		for (int i = 0; i < n; ++i)
+			++offsets_[cell[i] + 1];
+		for (size_t c = 1; c < offsets_.size(); ++c)
+			offsets_[c] += offsets_[c - 1];
+
+		ids_.resize(n);
+		std::vector<int> next(offsets_.begin(), offsets_.end() - 1);
+		for (int i = 0; i < n; ++i)
+			ids_[next[cell[i]]++] = i;
+	}
+
+	Eigen::VectorXi PointGrid::cell_coords(const RowVectorNd &p) const
+	{
+		Eigen::VectorXi res(n_cells_.size());
+		for (int d = 0; d < res.size(); ++d)
+		{
+			const double c = std::floor((p(d) - min_(d)) / cell_size_);
+			res(d) = int(std::clamp(c, 0., double(n_cells_(d) - 1)));
+		}
+		return res;
+	}
+
+	long PointGrid::cell_index(const Eigen::VectorXi &coords) const
+	{
+		long res = 0;
+		for (int d = coords.size() - 1; d >= 0; --d)
+			res = res * n_cells_(d) + coords(d);
+		return res;
+	}
+
+	int PointGrid::nearest(const RowVectorNd &p) const
+	{
+		if (points_.rows() == 0)
+			return -1;
+		assert(p.size() == points_.cols());
+
+		const int dim = n_cells_.size();
+		const Eigen::VectorXi center = cell_coords(p);
+		const int max_ring = n_cells_.maxCoeff();
+
+		double best_dist = std::numeric_limits<double>::max();
+		int best = -1;
+
+		Eigen::VectorXi coords(dim);
+		for (int r = 0; r <= max_ring; ++r)
+		{
+			// cells at Chebyshev distance r from the center
+			Eigen::VectorXi lo(dim), hi(dim);
+			for (int d = 0; d < dim; ++d)
+			{
+				lo(d) = center(d) - r;
+				hi(d) = center(d) + r;
+			}
+
+			coords = lo;
+			while (true)
+			{
+				bool on_ring = false, inside = true;
+				for (int d = 0; d < dim; ++d)
+				{
+					on_ring |= coords(d) == lo(d) || coords(d) == hi(d);
+					inside &= coords(d) >= 0 && coords(d) < n_cells_(d);
+				}
+
+				if (on_ring && inside)
+				{
+					const long c = cell_index(coords);
+					for (int k = offsets_[c]; k < offsets_[c + 1]; ++k)
+					{
+						const int i = ids_[k];
+						const double dist = (points_.row(i) - p).squaredNorm();
+						if (dist < best_dist || (dist == best_dist && i < best))
+						{
+							best_dist = dist;
+							best = i;
+						}
+					}
+				}
+
+				int d = 0;
+				while (d < dim && coords(d) == hi(d))
+				{
+					coords(d) = lo(d);
+					++d;
+				}
+				if (d == dim)
+					break;
+				++coords(d);
+			}
+
+			// the query is projected on the grid box, which does not increase its distance to the points, and the
+			// cells of the next rings are at least r cells away from the projection
+			if (best >= 0 && std::sqrt(best_dist) < r * cell_size_)
+				break;
+		}
+
+		return best;
+	}
+} // namespace polyfem::mesh
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <polyfem/utils/Types.hpp>
+
+#include <Eigen/Dense>
+
+#include <vector>
+
+namespace polyfem::mesh
+{
+	/// Uniform grid over a set of points for nearest point queries. The grid is stored flat:
+	/// the points are sorted by cell (counting sort) and every cell stores the offset of its first point,
+	/// so the memory is linear in the number of points and cells.
+	class PointGrid
+	{
+	public:
+		PointGrid() = default;
+
+		/// @brief Builds the grid, the cells are computed in parallel
+		/// @param[in] points points, one per row
+		/// @param[in] cell_size requested size of the cells (e.g., the average edge length), it is increased if the
+		///                      grid would have more than a few cells per point
+		PointGrid(const Eigen::MatrixXd &points, const double cell_size);
+
+		/// @brief Nearest point, ties are broken by the smallest index
+		/// @param[in] p query point, it can be outside of the grid
+		/// @return index of the nearest point, -1 if there are no points
+		int nearest(const RowVectorNd &p) const;
+
+		int n_points() const { return points_.rows(); }
+		int n_cells() const { return offsets_.size() - 1; }
+		double cell_size() const { return cell_size_; }
+
+	private:
+		/// cell index of a point along every axis, clamped to the grid
+		Eigen::VectorXi cell_coords(const RowVectorNd &p) const;
+		long cell_index(const Eigen::VectorXi &coords) const;
+
+		Eigen::MatrixXd points_;
+		RowVectorNd min_;
+		double cell_size_ = 1;
+		Eigen::VectorXi n_cells_;
+		/// points of cell c are ids_[offsets_[c]] ... ids_[offsets_[c + 1] - 1], in increasing order
+		std::vector<int> offsets_;
+		std::vector<int> ids_;
+	};
+} // namespace polyfem::mesh
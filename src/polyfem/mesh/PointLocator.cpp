@@ -0,0 +1,87 @@
+#include "PointLocator.hpp"
+
+#include <polyfem/utils/Logger.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
+
+#include <algorithm>
+
+namespace polyfem::mesh
+{
+	PointLocator::PointLocator(const Mesh &mesh, const double eps)
+		: mesh_(mesh), eps_(eps)
+	{
+		std::vector<std::array<Eigen::Vector3d, 2>> boxes;
+		mesh_.elements_boxes(boxes);
+		bvh_.init(boxes);
+	}
+
+	void PointLocator::candidates(const RowVectorNd &p, std::vector<unsigned int> &candidates) const
+	{
+		const double z = p.size() >= 3 ? p(2) : 0;
+		const Eigen::Vector3d min(p(0) - eps_, p(1) - eps_, z - eps_);
+		const Eigen::Vector3d max(p(0) + eps_, p(1) + eps_, z + eps_);
+
+		candidates.clear();
+		bvh_.intersect_box(min, max, candidates);
+		// the result does not depend on the traversal order of the BVH
+		std::sort(candidates.begin(), candidates.end());
+	}
+
+	bool PointLocator::inside_simplex(const RowVectorNd &p, const int el_id, Eigen::MatrixXd &coords) const
+	{
+		if (!mesh_.is_simplex(el_id))
+		{
+			logger().warn("Element {} is not simplex, skipping", el_id);
+			return false;
+		}
+
+		mesh_.barycentric_coords(p, el_id, coords);
+
+		for (int d = 0; d < coords.size(); ++d)
+		{
+			if (fabs(coords(d)) < 1e-8)
+				coords(d) = 0;
+			else if (fabs(coords(d) - 1) < 1e-8)
+				coords(d) = 1;
+		}
+
+		return coords.array().minCoeff() >= 0 && coords.array().maxCoeff() <= 1;
+	}
+
+	int PointLocator::locate(const RowVectorNd &p, const InsideTest &inside, Eigen::MatrixXd &coords) const
+	{
+		std::vector<unsigned int> cands;
+		candidates(p, cands);
+
+		for (const unsigned int cand : cands)
+		{
+			if (inside(p, cand, coords))
+				return cand;
+		}
+
+		return -1;
+	}
+
+	int PointLocator::locate(const RowVectorNd &p, Eigen::MatrixXd &coords) const
+	{
+		return locate(
+			p, [this](const RowVectorNd &q, const int el_id, Eigen::MatrixXd &c) { return inside_simplex(q, el_id, c); },
+			coords);
+	}
+
+	void PointLocator::locate(const Eigen::MatrixXd &points, Eigen::VectorXi &elements, Eigen::MatrixXd &coords) const
+	{
+		elements.setConstant(points.rows(), -1);
+		coords.setZero(points.rows(), mesh_.dimension() + 1);
+
+		utils::maybe_parallel_for(points.rows(), [&](int start, int end, int thread_id) {
+			Eigen::MatrixXd local_coords;
+			for (int i = start; i < end; ++i)
+			{
+				elements(i) = locate(points.row(i), local_coords);
+				if (elements(i) >= 0)
+					coords.row(i) = local_coords;
+			}
+		});
+	}
+} // namespace polyfem::mesh
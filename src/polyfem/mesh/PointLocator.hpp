@@ -0,0 +1,64 @@
+#pragma once
+
+#include <polyfem/Common.hpp>
+#include <polyfem/mesh/Mesh.hpp>
+
+#include <BVH.hpp>
+
+#include <Eigen/Dense>
+
+#include <functional>
+#include <vector>
+
+namespace polyfem::mesh
+{
+	/// Finds the elements containing arbitrary physical points, with a BVH of the element boxes.
+	/// Shared by the grid output, probes and the particles of the operator splitting solver.
+	class PointLocator
+	{
+	public:
+		/// @brief Test if an element contains a point
+		/// @param[in] p physical point
+		/// @param[in] el_id candidate element
+		/// @param[out] coords coordinates of the point in the element (e.g., barycentric or local)
+		/// @return if the element contains the point
+		using InsideTest = std::function<bool(const RowVectorNd &p, const int el_id, Eigen::MatrixXd &coords)>;
+
+		/// @brief Builds the BVH of the boxes of the elements of a mesh.
+		/// @param[in] mesh mesh, it must outlive the locator
+		/// @param[in] eps size of the query boxes around the points
+		PointLocator(const Mesh &mesh, const double eps = 1e-6);
+
+		/// @brief Element containing a point, only for simplices, using barycentric coordinates.
+		/// @param[in] p physical point
+		/// @param[out] coords barycentric coordinates of the point in the element
+		/// @return element id, -1 if outside of the mesh
+		int locate(const RowVectorNd &p, Eigen::MatrixXd &coords) const;
+
+		/// @brief Element containing a point, with a custom inside test (e.g., for non simplicial elements).
+		/// @param[in] p physical point
+		/// @param[in] inside inside test, called on the candidates in increasing order
+		/// @param[out] coords coordinates returned by the test of the element
+		/// @return element id, -1 if outside of the mesh
+		int locate(const RowVectorNd &p, const InsideTest &inside, Eigen::MatrixXd &coords) const;
+
+		/// @brief Elements containing a batch of points, in parallel, only for simplices.
+		/// @param[in] points physical points, one per row
+		/// @param[out] elements element id per point, -1 if outside of the mesh
+		/// @param[out] coords barycentric coordinates per point, one per row
+		void locate(const Eigen::MatrixXd &points, Eigen::VectorXi &elements, Eigen::MatrixXd &coords) const;
+
+		/// @brief Elements whose box contains a point.
+		/// @param[in] p physical point
+		/// @param[out] candidates element ids, in increasing order
+		void candidates(const RowVectorNd &p, std::vector<unsigned int> &candidates) const;
+
+		/// @brief Barycentric inside test of simplices, the coordinates close to 0 or 1 are snapped.
+		bool inside_simplex(const RowVectorNd &p, const int el_id, Eigen::MatrixXd &coords) const;
+
+	private:
+		const Mesh &mesh_;
+		const double eps_;
+		BVH::BVH bvh_;
+	};
+} // namespace polyfem::mesh
@@ -6,6 +6,7 @@
 #include <polyfem/io/MshReader.hpp>
 #include <polyfem/utils/StringUtils.hpp>
 #include <polyfem/utils/Logger.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
 
 #include <geogram/basic/file_system.h>
 #include <geogram/mesh/mesh_io.h>
@@ -22,6 +23,14 @@ namespace polyfem
 
 	namespace mesh
 	{
+		void CMesh2D::prepare_mesh()
+		{
+			if (use_navigation_tables_ && c2e_)
+				navigation_table_.build(mesh_, *c2e_);
+			else
+				navigation_table_.clear();
+		}
+
 		void CMesh2D::refine(const int n_refinement, const double t)
 		{
 			// return;
@@ -44,6 +53,7 @@ namespace polyfem
 				mesh.copy(mesh_);
 
 				c2e_.reset();
+				navigation_table_.clear();
 				boundary_vertices_.reset();
 				boundary_edges_.reset();
 
@@ -146,6 +156,7 @@ namespace polyfem
 			cell_nodes_.clear();
 
 			c2e_.reset();
+			navigation_table_.clear();
 			boundary_vertices_.reset();
 			boundary_edges_.reset();
 
@@ -169,6 +180,7 @@ namespace polyfem
 			cell_nodes_.clear();
 
 			c2e_.reset();
+			navigation_table_.clear();
 			boundary_vertices_.reset();
 			boundary_edges_.reset();
 
@@ -567,11 +579,13 @@ namespace polyfem
 			body_ids_.resize(n_elements());
 			std::fill(body_ids_.begin(), body_ids_.end(), -1);
 
-			for (int e = 0; e < n_elements(); ++e)
-			{
-				const auto bary = face_barycenter(e);
-				body_ids_[e] = marker(e, bary);
-			}
+			utils::maybe_parallel_for(n_elements(), [&](int start, int end, int thread_id) {
+				for (int e = start; e < end; ++e)
+				{
+					const auto bary = face_barycenter(e);
+					body_ids_[e] = marker(e, bary);
+				}
+			});
 		}
 
 		void CMesh2D::compute_boundary_ids(const double eps)
@@ -662,47 +676,71 @@ namespace polyfem
 		{
 			boundary_ids_.resize(n_edges());
 
-			for (int e = 0; e < n_edges(); ++e)
-			{
-				bool is_boundary = is_boundary_edge(e);
-				const auto p = edge_barycenter(e);
-				std::vector<int> vs = {edge_vertex(e, 0), edge_vertex(e, 1)};
-				std::sort(vs.begin(), vs.end());
-				boundary_ids_[e] = marker(e, vs, p, is_boundary);
-			}
+			utils::maybe_parallel_for(n_edges(), [&](int start, int end, int thread_id) {
+				for (int e = start; e < end; ++e)
+				{
+					bool is_boundary = is_boundary_edge(e);
+					const auto p = edge_barycenter(e);
+					std::vector<int> vs = {edge_vertex(e, 0), edge_vertex(e, 1)};
+					std::sort(vs.begin(), vs.end());
+					boundary_ids_[e] = marker(e, vs, p, is_boundary);
+				}
+			});
 		}
 
 		void CMesh2D::append(const Mesh &mesh)
 		{
-			assert(typeid(mesh) == typeid(CMesh2D));
-			Mesh::append(mesh);
+			append(std::vector<const Mesh *>{&mesh});
+		}
 
-			const CMesh2D &mesh2d = dynamic_cast<const CMesh2D &>(mesh);
+		void CMesh2D::append(const std::vector<const Mesh *> &meshes)
+		{
+			if (meshes.empty())
+				return;
 
-			const int n_v = n_vertices();
-			const int n_f = n_faces();
+			Mesh::append_mesh_data(meshes);
 
-			mesh_.vertices.create_vertices(mesh2d.n_vertices());
-			for (int i = n_v; i < (int)mesh_.vertices.nb(); ++i)
+			const int n_meshes = meshes.size();
+			std::vector<int> v_offsets(n_meshes + 1);
+			int n_f = n_faces();
+			v_offsets[0] = n_vertices();
+			for (int k = 0; k < n_meshes; ++k)
 			{
-				GEO::vec3 &p = mesh_.vertices.point(i);
-				set_point(i, mesh2d.point(i - n_v));
+				assert(typeid(*meshes[k]) == typeid(CMesh2D));
+				v_offsets[k + 1] = v_offsets[k] + meshes[k]->n_vertices();
+				n_f += meshes[k]->n_faces();
 			}
 
+			mesh_.vertices.create_vertices(v_offsets.back() - v_offsets[0]);
+			utils::maybe_parallel_for(n_meshes, [&](int start, int end, int thread_id) {
+				for (int k = start; k < end; ++k)
+				{
+					const CMesh2D &mesh2d = dynamic_cast<const CMesh2D &>(*meshes[k]);
+					for (int i = 0; i < mesh2d.n_vertices(); ++i)
+						set_point(v_offsets[k] + i, mesh2d.point(i));
+				}
+			});
+
 			std::vector<GEO::index_t> indices;
-			for (int i = 0; i < mesh2d.n_faces(); ++i)
+			for (int k = 0; k < n_meshes; ++k)
 			{
-				indices.clear();
-				for (int j = 0; j < mesh2d.mesh_.facets.nb_vertices(i); ++j)
-					indices.push_back(mesh2d.mesh_.facets.vertex(i, j) + n_v);
+				const CMesh2D &mesh2d = dynamic_cast<const CMesh2D &>(*meshes[k]);
+				for (int i = 0; i < mesh2d.n_faces(); ++i)
+				{
+					indices.clear();
+					for (int j = 0; j < mesh2d.mesh_.facets.nb_vertices(i); ++j)
+						indices.push_back(mesh2d.mesh_.facets.vertex(i, j) + v_offsets[k]);
 
-				mesh_.facets.create_polygon(indices.size(), &indices[0]);
+					mesh_.facets.create_polygon(indices.size(), &indices[0]);
+				}
 			}
 
-			assert(n_vertices() == n_v + mesh2d.n_vertices());
-			assert(n_faces() == n_f + mesh2d.n_faces());
+			assert(n_vertices() == v_offsets.back());
+			assert(n_faces() == n_f);
 
+			// the connectivity is rebuilt once for all the appended meshes
 			c2e_.reset();
+			navigation_table_.clear();
 			boundary_vertices_.reset();
 			boundary_edges_.reset();
 			Navigation::prepare_mesh(mesh_);
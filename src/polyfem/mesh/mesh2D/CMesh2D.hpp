@@ -86,13 +86,16 @@ namespace polyfem
 			inline Navigation::Index get_index_from_face(int f, int lv = 0) const override { return Navigation::get_index_from_face(mesh_, *c2e_, f, lv); }
 
 			// Navigation in a surface mesh
-			inline Navigation::Index switch_vertex(Navigation::Index idx) const override { return Navigation::switch_vertex(mesh_, idx); }
-			inline Navigation::Index switch_edge(Navigation::Index idx) const override { return Navigation::switch_edge(mesh_, *c2e_, idx); }
-			inline Navigation::Index switch_face(Navigation::Index idx) const override { return Navigation::switch_face(mesh_, *c2e_, idx); }
+			inline Navigation::Index switch_vertex(Navigation::Index idx) const override { return navigation_table_.empty() ? Navigation::switch_vertex(mesh_, idx) : navigation_table_.switch_vertex(idx); }
+			inline Navigation::Index switch_edge(Navigation::Index idx) const override { return navigation_table_.empty() ? Navigation::switch_edge(mesh_, *c2e_, idx) : navigation_table_.switch_edge(idx); }
+			inline Navigation::Index switch_face(Navigation::Index idx) const override { return navigation_table_.empty() ? Navigation::switch_face(mesh_, *c2e_, idx) : navigation_table_.switch_face(idx); }
+
+			void prepare_mesh() override;
 
 			void triangulate_faces(Eigen::MatrixXi &tris, Eigen::MatrixXd &pts, std::vector<int> &ranges) const override;
 
 			void append(const Mesh &mesh) override;
+			void append(const std::vector<const Mesh *> &meshes) override;
 
 		protected:
 			bool load(const std::string &path) override;
@@ -103,6 +106,8 @@ namespace polyfem
 			std::unique_ptr<GEO::Attribute<GEO::index_t>> c2e_;
 			std::unique_ptr<GEO::Attribute<bool>> boundary_vertices_;
 			std::unique_ptr<GEO::Attribute<bool>> boundary_edges_;
+			/// built by prepare_mesh if use_navigation_tables_, cleared when the connectivity changes
+			Navigation::NavigationTable navigation_table_;
 		};
 	} // namespace mesh
 } // namespace polyfem
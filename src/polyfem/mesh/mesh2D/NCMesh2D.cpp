@@ -5,6 +5,7 @@
 #include <igl/writeOBJ.h>
 
 #include <polyfem/mesh/MeshUtils.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
 
 namespace polyfem
 {
@@ -101,11 +102,8 @@ namespace polyfem
 		int NCMesh2D::find_vertex(Eigen::Vector2i v) const
 		{
 			std::sort(v.data(), v.data() + v.size());
-			auto search = midpointMap.find(v);
-			if (search != midpointMap.end())
-				return search->second;
-			else
-				return -1;
+			const int *search = midpointMap.find({{v[0], v[1]}});
+			return search == nullptr ? -1 : *search;
 		}
 
 		int NCMesh2D::get_vertex(Eigen::Vector2i v)
@@ -117,7 +115,7 @@ namespace polyfem
 				Eigen::VectorXd v_mid = (vertices[v[0]].pos + vertices[v[1]].pos) / 2.;
 				id = vertices.size();
 				vertices.emplace_back(v_mid);
-				midpointMap.emplace(v, id);
+				midpointMap.emplace({{v[0], v[1]}}, id);
 			}
 			return id;
 		}
@@ -125,11 +123,8 @@ namespace polyfem
 		int NCMesh2D::find_edge(Eigen::Vector2i v) const
 		{
 			std::sort(v.data(), v.data() + v.size());
-			auto search = edgeMap.find(v);
-			if (search != edgeMap.end())
-				return search->second;
-			else
-				return -1;
+			const int *search = edgeMap.find({{v[0], v[1]}});
+			return search == nullptr ? -1 : *search;
 		}
 
 		int NCMesh2D::get_edge(Eigen::Vector2i v)
@@ -140,7 +135,7 @@ namespace polyfem
 			{
 				edges.emplace_back(v);
 				id = edges.size() - 1;
-				edgeMap.emplace(v, id);
+				edgeMap.emplace({{v[0], v[1]}}, id);
 			}
 			return id;
 		}
@@ -796,12 +791,14 @@ namespace polyfem
 			body_ids_.resize(n_faces());
 			std::fill(body_ids_.begin(), body_ids_.end(), -1);
 
-			for (int e = 0; e < n_faces(); ++e)
-			{
-				const auto bary = face_barycenter(e);
-				body_ids_[e] = marker(e, bary);
-				elements[valid_to_all_elem(e)].body_id = body_ids_[e];
-			}
+			utils::maybe_parallel_for(n_faces(), [&](int start, int end, int thread_id) {
+				for (int e = start; e < end; ++e)
+				{
+					const auto bary = face_barycenter(e);
+					body_ids_[e] = marker(e, bary);
+					elements[valid_to_all_elem(e)].body_id = body_ids_[e];
+				}
+			});
 		}
 
 		void NCMesh2D::compute_boundary_ids(const double eps)
@@ -898,16 +895,18 @@ namespace polyfem
 		{
 			boundary_ids_.resize(n_edges());
 
-			for (int e = 0; e < n_edges(); ++e)
-			{
-				bool is_boundary = is_boundary_edge(e);
-				const auto p = edge_barycenter(e);
+			utils::maybe_parallel_for(n_edges(), [&](int start, int end, int thread_id) {
+				for (int e = start; e < end; ++e)
+				{
+					bool is_boundary = is_boundary_edge(e);
+					const auto p = edge_barycenter(e);
 
-				std::vector<int> vs = {edge_vertex(e, 0), edge_vertex(e, 1)};
-				std::sort(vs.begin(), vs.end());
-				boundary_ids_[e] = marker(e, vs, p, is_boundary);
-				edges[valid_to_all_edge(e)].boundary_id = boundary_ids_[e];
-			}
+					std::vector<int> vs = {edge_vertex(e, 0), edge_vertex(e, 1)};
+					std::sort(vs.begin(), vs.end());
+					boundary_ids_[e] = marker(e, vs, p, is_boundary);
+					edges[valid_to_all_edge(e)].boundary_id = boundary_ids_[e];
+				}
+			});
 		}
 
 	} // namespace mesh
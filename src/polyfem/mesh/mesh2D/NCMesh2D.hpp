@@ -1,6 +1,7 @@
 #pragma once
 
 #include <polyfem/mesh/mesh2D/Mesh2D.hpp>
+#include <polyfem/utils/FlatHashMap.hpp>
 
 namespace polyfem
 {
@@ -297,15 +298,6 @@ namespace polyfem
 
 			void append(const Mesh &mesh) override;
 
-		private:
-			struct ArrayHasher2D
-			{
-				long operator()(const Eigen::Vector2i &a) const
-				{
-					return (long)((long)984120265 * a[0] + (long)125965121 * a[1]);
-				}
-			};
-
 		protected:
 			bool load(const std::string &path) override;
 			bool load(const GEO::Mesh &mesh) override;
@@ -385,8 +377,8 @@ namespace polyfem
 			std::vector<ncVert> vertices;
 			std::vector<ncBoundary> edges;
 
-			std::unordered_map<Eigen::Vector2i, int, ArrayHasher2D> midpointMap;
-			std::unordered_map<Eigen::Vector2i, int, ArrayHasher2D> edgeMap;
+			utils::FlatHashMap<2, int> midpointMap;
+			utils::FlatHashMap<2, int> edgeMap;
 
 			std::vector<int> all_to_valid_elemMap, valid_to_all_elemMap;
 			std::vector<int> all_to_valid_vertexMap, valid_to_all_vertexMap;
@@ -2,6 +2,7 @@
 #include <polyfem/mesh/mesh2D/Navigation.hpp>
 
 #include <polyfem/utils/Logger.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
 
 #include <algorithm>
 #include <cassert>
@@ -190,3 +191,60 @@ Index polyfem::mesh::Navigation::switch_face(const GEO::Mesh &M, const GEO::Attr
 		return idx;
 	}
 }
+
+////////////////////////////////////////////////////////////////////////////////
+
+void polyfem::mesh::Navigation::NavigationTable::build(const GEO::Mesh &M, const GEO::Attribute<GEO::index_t> &c2e)
+{
+	const int n_corners = M.facet_corners.nb();
+	vertex_.resize(n_corners);
+	face_.resize(n_corners);
+	edge_.resize(n_corners);
+	next_.resize(n_corners);
+	prev_.resize(n_corners);
+	across_next_.resize(n_corners);
+	across_prev_.resize(n_corners);
+
+	// Same search as switch_face: first corner of the adjacent facet with the given vertex
+	const auto corner_across = [&](const index_t c, const index_t v) {
+		const index_t f2 = M.facet_corners.adjacent_facet(c);
+		if (f2 == NO_FACET)
+			return -1;
+		for (index_t c2 = M.facets.corners_begin(f2); c2 < M.facets.corners_end(f2); ++c2)
+		{
+			if (M.facet_corners.vertex(c2) == v)
+				return int(c2);
+		}
+		assert(false); // This should not happen
+		return -1;
+	};
+
+	polyfem::utils::maybe_parallel_for(M.facets.nb(), [&](int start, int end, int thread_id) {
+		for (index_t f = start; f < (index_t)end; ++f)
+		{
+			for (index_t c = M.facets.corners_begin(f); c < M.facets.corners_end(f); ++c)
+			{
+				const index_t v = M.facet_corners.vertex(c);
+				const index_t prev = M.facets.prev_corner_around_facet(f, c);
+				vertex_[c] = v;
+				face_[c] = f;
+				edge_[c] = c2e[c];
+				next_[c] = M.facets.next_corner_around_facet(f, c);
+				prev_[c] = prev;
+				across_next_[c] = corner_across(c, v);
+				across_prev_[c] = corner_across(prev, v);
+			}
+		}
+	});
+}
+
+void polyfem::mesh::Navigation::NavigationTable::clear()
+{
+	vertex_.clear();
+	face_.clear();
+	edge_.clear();
+	next_.clear();
+	prev_.clear();
+	across_next_.clear();
+	across_prev_.clear();
+}
@@ -3,6 +3,8 @@
 #include <geogram/mesh/mesh.h>
 #include <geogram/basic/attributes.h>
 
+#include <vector>
+
 namespace polyfem
 {
 	namespace mesh
@@ -35,6 +37,49 @@ namespace polyfem
 			inline Index next_around_edge(const GEO::Mesh &M, const GEO::Attribute<GEO::index_t> &c2e, Index idx) { return switch_vertex(M, switch_face(M, c2e, idx)); }
 			inline Index next_around_vertex(const GEO::Mesh &M, const GEO::Attribute<GEO::index_t> &c2e, Index idx) { return switch_face(M, c2e, switch_edge(M, c2e, idx)); }
 
+			// Precomputed corner tables of a surface mesh, the switches are lookups returning the same indices as the functions above.
+			// They must be rebuilt after any change of the connectivity.
+			class NavigationTable
+			{
+			public:
+				// Builds the tables in parallel over the facets, c2e is the edge attribute computed by prepare_mesh
+				void build(const GEO::Mesh &M, const GEO::Attribute<GEO::index_t> &c2e);
+				void clear();
+				bool empty() const { return vertex_.empty(); }
+
+				inline Index switch_vertex(Index idx) const
+				{
+					idx.face_corner = edge_[idx.face_corner] == idx.edge ? next_[idx.face_corner] : prev_[idx.face_corner];
+					idx.vertex = vertex_[idx.face_corner];
+					return idx;
+				}
+
+				inline Index switch_edge(Index idx) const
+				{
+					idx.edge = edge_[idx.face_corner] == idx.edge ? edge_[prev_[idx.face_corner]] : edge_[idx.face_corner];
+					return idx;
+				}
+
+				inline Index switch_face(Index idx) const
+				{
+					const int c = edge_[idx.face_corner] == idx.edge ? across_next_[idx.face_corner] : across_prev_[idx.face_corner];
+					if (c < 0)
+					{
+						idx.face = -1;
+						return idx;
+					}
+					idx.face = face_[c];
+					idx.face_corner = c;
+					return idx;
+				}
+
+			private:
+				// Per facet corner: vertex, facet, edge to the next corner, next and previous corners around the facet
+				std::vector<int> vertex_, face_, edge_, next_, prev_;
+				// Corner of the same vertex in the facet across the edge to the next (previous) corner, -1 on the boundary
+				std::vector<int> across_next_, across_prev_;
+			};
+
 		} // namespace Navigation
 	}     // namespace mesh
 } // namespace polyfem
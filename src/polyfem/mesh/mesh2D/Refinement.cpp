@@ -4,10 +4,13 @@
 #include <polyfem/mesh/MeshUtils.hpp>
 #include "PolygonUtils.hpp"
 #include <polyfem/utils/Logger.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
 
 #include <iostream>
 #include <vector>
 #include <array>
+#include <atomic>
+#include <functional>
 #include <numeric>
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -617,6 +620,102 @@ void polyfem::mesh::Polygons::no_split(const Eigen::MatrixXd &IV, Eigen::MatrixX
 
 ////////////////////////////////////////////////////////////////////////////////
 
+namespace
+{
+	// Creates the vertices of the refinement of M_in in M_out, numbered as if the facets were visited in order: every
+	// facet creates the midpoints of the edges it is the first to contain, then its barycenter if with_center(f).
+	// The facets are processed in parallel, the vertices of a facet start at the prefix sum of the counts of the
+	// previous facets.
+	//
+	// @param[in]  M_in              Input mesh
+	// @param[in]  c2e               Edge of every facet corner of M_in
+	// @param[in]  with_center       Facets getting a mid-facet vertex
+	// @param      M_out             Output mesh, the new vertices are appended
+	// @param[out] edge_to_midpoint  Midpoint vertex of every edge of M_in
+	// @param[out] facet_to_center   Mid-facet vertex of every facet of M_in, -1 if it has none
+	//
+	void create_refinement_vertices(
+		const GEO::Mesh &M_in, const GEO::Attribute<GEO::index_t> &c2e,
+		const std::function<bool(GEO::index_t)> &with_center,
+		GEO::Mesh &M_out, std::vector<int> &edge_to_midpoint, std::vector<int> &facet_to_center)
+	{
+		using GEO::index_t;
+		const int n_facets = M_in.facets.nb();
+		const int n_edges = M_in.edges.nb();
+
+		// First facet containing each edge, it creates the midpoint
+		std::vector<std::atomic<int>> first_facet(n_edges);
+		utils::maybe_parallel_for(n_edges, [&](int start, int end, int thread_id) {
+			for (int e = start; e < end; ++e)
+				first_facet[e].store(n_facets, std::memory_order_relaxed);
+		});
+		utils::maybe_parallel_for(n_facets, [&](int start, int end, int thread_id) {
+			for (int f = start; f < end; ++f)
+			{
+				for (index_t lv = 0; lv < M_in.facets.nb_vertices(f); ++lv)
+				{
+					std::atomic<int> &first = first_facet[c2e[M_in.facets.corner(f, lv)]];
+					int current = first.load(std::memory_order_relaxed);
+					while (f < current && !first.compare_exchange_weak(current, f, std::memory_order_relaxed))
+						;
+				}
+			}
+		});
+
+		const auto creates_midpoint = [&](const index_t f, const index_t lv) {
+			const index_t e = c2e[M_in.facets.corner(f, lv)];
+			if (first_facet[e].load(std::memory_order_relaxed) != (int)f)
+				return false;
+			for (index_t lv2 = 0; lv2 < lv; ++lv2)
+			{
+				if (c2e[M_in.facets.corner(f, lv2)] == e)
+					return false;
+			}
+			return true;
+		};
+
+		// Number of vertices created by each facet
+		std::vector<int> offsets(n_facets + 1, 0);
+		utils::maybe_parallel_for(n_facets, [&](int start, int end, int thread_id) {
+			for (int f = start; f < end; ++f)
+			{
+				int count = with_center(f) ? 1 : 0;
+				for (index_t lv = 0; lv < M_in.facets.nb_vertices(f); ++lv)
+				{
+					if (creates_midpoint(f, lv))
+						++count;
+				}
+				offsets[f + 1] = count;
+			}
+		});
+		std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+		const index_t first_vertex = M_out.vertices.create_vertices(offsets.back());
+		edge_to_midpoint.assign(n_edges, -1);
+		facet_to_center.assign(n_facets, -1);
+		utils::maybe_parallel_for(n_facets, [&](int start, int end, int thread_id) {
+			for (int f = start; f < end; ++f)
+			{
+				const index_t nv = M_in.facets.nb_vertices(f);
+				index_t v = first_vertex + offsets[f];
+				for (index_t lv = 0; lv < nv; ++lv)
+				{
+					if (!creates_midpoint(f, lv))
+						continue;
+					GEO::vec3 coords = 0.5 * (mesh::mesh_vertex(M_in, M_in.facets.vertex(f, lv)) + mesh::mesh_vertex(M_in, M_in.facets.vertex(f, (lv + 1) % nv)));
+					mesh::mesh_set_vertex(M_out, v, coords);
+					edge_to_midpoint[c2e[M_in.facets.corner(f, lv)]] = v++;
+				}
+				if (with_center(f))
+				{
+					mesh::mesh_set_vertex(M_out, v, mesh::facet_barycenter(M_in, f));
+					facet_to_center[f] = v;
+				}
+			}
+		});
+	}
+} // namespace
+
 void polyfem::mesh::refine_polygonal_mesh(const GEO::Mesh &M_in, GEO::Mesh &M_out, Polygons::SplitFunction split_func)
 {
 	using GEO::index_t;
@@ -628,47 +727,42 @@ void polyfem::mesh::refine_polygonal_mesh(const GEO::Mesh &M_in, GEO::Mesh &M_ou
 	M_out.edges.clear();
 	M_out.facets.clear();
 	GEO::Attribute<GEO::index_t> c2e(M_in.facet_corners.attributes(), "edge_id");
+	const int n_facets = M_in.facets.nb();
 
-	// Step 1: Iterate over facets and refine triangles and quads
-	std::vector<int> edge_to_midpoint(M_in.edges.nb(), -1);
-	for (index_t f = 0; f < M_in.facets.nb(); ++f)
-	{
-		index_t nv = M_in.facets.nb_vertices(f);
-		assert(nv > 2);
-		Index idx = Navigation::get_index_from_face(M_in, c2e, f, 0);
-		assert(Navigation::switch_vertex(M_in, idx).vertex == (int)M_in.facets.vertex(f, 1));
+	// Step 1: Create mid-edge vertices, and mid-face vertices of the quads
+	std::vector<int> edge_to_midpoint, facet_to_center;
+	create_refinement_vertices(
+		M_in, c2e, [&](index_t f) { return M_in.facets.nb_vertices(f) == 4; },
+		M_out, edge_to_midpoint, facet_to_center);
 
-		// Create mid-edge vertices
-		for (index_t lv = 0; lv < M_in.facets.nb_vertices(f); ++lv, idx = Navigation::next_around_face(M_in, c2e, idx))
-		{
-			assert(idx.vertex == (int)M_in.facets.vertex(f, lv));
-			if (edge_to_midpoint[idx.edge] == -1)
-			{
-				GEO::vec3 coords = 0.5 * (mesh_vertex(M_in, idx.vertex) + mesh_vertex(M_in, Navigation::switch_vertex(M_in, idx).vertex));
-				edge_to_midpoint[idx.edge] = mesh_create_vertex(M_out, coords);
-				assert(edge_to_midpoint[idx.edge] + 1 == (int)M_out.vertices.nb());
-			}
-		}
-
-		if (/*nv == 3 ||*/ nv == 4)
-		{
-			// Create mid-face vertex
-			index_t vf = mesh_create_vertex(M_out, facet_barycenter(M_in, f));
-			assert(vf + 1 == M_out.vertices.nb());
-
-			// Create quads
-			for (index_t lv = 0; lv < M_in.facets.nb_vertices(f); ++lv)
+	// Refine the quads into 4 quads each, in the order of the facets
+	std::vector<int> quad_offsets(n_facets + 1, 0);
+	for (int f = 0; f < n_facets; ++f)
+	{
+		assert(M_in.facets.nb_vertices(f) > 2);
+		quad_offsets[f + 1] = quad_offsets[f] + (M_in.facets.nb_vertices(f) == 4 ? 4 : 0);
+	}
+	const index_t first_quad = M_out.facets.create_quads(quad_offsets.back());
+	utils::maybe_parallel_for(n_facets, [&](int start, int end, int thread_id) {
+		for (int f = start; f < end; ++f)
+		{
+			if (/*nv == 3 ||*/ M_in.facets.nb_vertices(f) != 4)
+				continue;
+			const int vf = facet_to_center[f];
+			for (index_t lv = 0; lv < 4; ++lv)
 			{
-				idx = Navigation::get_index_from_face(M_in, c2e, f, lv);
-				assert(Navigation::switch_vertex(M_in, idx).vertex == (int)M_in.facets.vertex(f, (lv + 1) % M_in.facets.nb_vertices(f)));
-				int v1 = idx.vertex;
-				int v12 = edge_to_midpoint[idx.edge];
-				int v01 = edge_to_midpoint[Navigation::switch_edge(M_in, c2e, idx).edge];
+				const index_t q = first_quad + quad_offsets[f] + lv;
+				const int v1 = M_in.facets.vertex(f, lv);
+				const int v12 = edge_to_midpoint[c2e[M_in.facets.corner(f, lv)]];
+				const int v01 = edge_to_midpoint[c2e[M_in.facets.corner(f, (lv + 3) % 4)]];
 				assert(v12 != -1 && v01 != -1);
-				M_out.facets.create_quad(v1, v12, vf, v01);
+				M_out.facets.set_vertex(q, 0, v1);
+				M_out.facets.set_vertex(q, 1, v12);
+				M_out.facets.set_vertex(q, 2, vf);
+				M_out.facets.set_vertex(q, 3, v01);
 			}
 		}
-	}
+	});
 
 	// Step 2: Create polygonal faces following vertices around holes
 	for (index_t f = 0; f < M_in.facets.nb(); ++f)
@@ -736,7 +830,6 @@ void polyfem::mesh::refine_polygonal_mesh(const GEO::Mesh &M_in, GEO::Mesh &M_ou
 void polyfem::mesh::refine_triangle_mesh(const GEO::Mesh &M_in, GEO::Mesh &M_out)
 {
 	using GEO::index_t;
-	using Navigation::Index;
 
 	// Step 1: Clear output mesh, and fill it with M_in's vertices
 	assert(&M_in != &M_out);
@@ -744,41 +837,35 @@ void polyfem::mesh::refine_triangle_mesh(const GEO::Mesh &M_in, GEO::Mesh &M_out
 	M_out.edges.clear();
 	M_out.facets.clear();
 	GEO::Attribute<GEO::index_t> c2e(M_in.facet_corners.attributes(), "edge_id");
-
-	// Step 2: Iterate over facets and refine triangles
-	std::vector<int> edge_to_midpoint(M_in.edges.nb(), -1);
-	for (index_t f = 0; f < M_in.facets.nb(); ++f)
-	{
-		index_t nv = M_in.facets.nb_vertices(f);
-		assert(nv == 3);
-		Index idx = Navigation::get_index_from_face(M_in, c2e, f, 0);
-		assert(Navigation::switch_vertex(M_in, idx).vertex == (int)M_in.facets.vertex(f, 1));
-
-		// Create mid-edge vertices
-		for (index_t lv = 0; lv < M_in.facets.nb_vertices(f); ++lv, idx = Navigation::next_around_face(M_in, c2e, idx))
-		{
-			assert(idx.vertex == (int)M_in.facets.vertex(f, lv));
-			if (edge_to_midpoint[idx.edge] == -1)
+	const int n_facets = M_in.facets.nb();
+
+	// Step 2: Create mid-edge vertices
+	std::vector<int> edge_to_midpoint, facet_to_center;
+	create_refinement_vertices(
+		M_in, c2e, [](index_t) { return false; },
+		M_out, edge_to_midpoint, facet_to_center);
+
+	// Step 3: Refine every triangle into 4 triangles, in the order of the facets
+	const index_t first_triangle = M_out.facets.create_triangles(4 * n_facets);
+	utils::maybe_parallel_for(n_facets, [&](int start, int end, int thread_id) {
+		for (int f = start; f < end; ++f)
+		{
+			assert(M_in.facets.nb_vertices(f) == 3);
+			std::array<index_t, 3> e2v;
+			for (index_t lv = 0; lv < 3; ++lv)
 			{
-				GEO::vec3 coords = 0.5 * (mesh_vertex(M_in, idx.vertex) + mesh_vertex(M_in, Navigation::switch_vertex(M_in, idx).vertex));
-				edge_to_midpoint[idx.edge] = mesh_create_vertex(M_out, coords);
-				assert(edge_to_midpoint[idx.edge] + 1 == (int)M_out.vertices.nb());
+				const index_t t = first_triangle + 4 * f + lv;
+				const int v1 = M_in.facets.vertex(f, lv);
+				const int v12 = edge_to_midpoint[c2e[M_in.facets.corner(f, lv)]];
+				const int v01 = edge_to_midpoint[c2e[M_in.facets.corner(f, (lv + 2) % 3)]];
+				e2v[lv] = v12;
+				assert(v12 != -1 && v01 != -1);
+				M_out.facets.set_vertex(t, 0, v1);
+				M_out.facets.set_vertex(t, 1, v12);
+				M_out.facets.set_vertex(t, 2, v01);
 			}
+			for (index_t lv = 0; lv < 3; ++lv)
+				M_out.facets.set_vertex(first_triangle + 4 * f + 3, lv, e2v[lv]);
 		}
-
-		// Create triangles
-		std::array<index_t, 3> e2v;
-		for (index_t lv = 0; lv < M_in.facets.nb_vertices(f); ++lv)
-		{
-			idx = Navigation::get_index_from_face(M_in, c2e, f, lv);
-			assert(Navigation::switch_vertex(M_in, idx).vertex == (int)M_in.facets.vertex(f, (lv + 1) % M_in.facets.nb_vertices(f)));
-			int v1 = idx.vertex;
-			int v12 = edge_to_midpoint[idx.edge];
-			int v01 = edge_to_midpoint[Navigation::switch_edge(M_in, c2e, idx).edge];
-			e2v[lv] = v12;
-			assert(v12 != -1 && v01 != -1);
-			M_out.facets.create_triangle(v1, v12, v01);
-		}
-		M_out.facets.create_triangle(e2v[0], e2v[1], e2v[2]);
-	}
+	});
 }
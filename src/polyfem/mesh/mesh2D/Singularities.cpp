@@ -2,7 +2,9 @@
 #include "Singularities.hpp"
 #include "Navigation.hpp"
 #include <polyfem/mesh/MeshUtils.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
 #include <algorithm>
+#include <numeric>
 ////////////////////////////////////////////////////////////////////////////////
 
 void polyfem::mesh::singular_vertices(
@@ -111,20 +113,35 @@ void polyfem::mesh::create_patch_around_singularities(
 	}
 
 	// Step 1: Find all edges around singularities and create new vertices on those edge
-	std::vector<int> edge_to_midpoint(M.edges.nb(), -1);
-	for (index_t e = 0; e < M.edges.nb(); ++e)
-	{
-		for (index_t lv = 0; lv < 2; ++lv)
+	// The new vertices are numbered in the order of the edges, the offset of each edge is the prefix sum of the marked edges
+	const int n_edges = M.edges.nb();
+	std::vector<int> edge_to_midpoint(n_edges, -1);
+	std::vector<int> offsets(n_edges + 1, 0);
+	utils::maybe_parallel_for(n_edges, [&](int start, int end, int thread_id) {
+		for (int e = start; e < end; ++e)
+		{
+			offsets[e + 1] = is_singular[M.edges.vertex(e, 0)] != is_singular[M.edges.vertex(e, 1)] ? 1 : 0;
+		}
+	});
+	std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+	const index_t first_vertex = M.vertices.create_vertices(offsets.back());
+	utils::maybe_parallel_for(n_edges, [&](int start, int end, int thread_id) {
+		for (int e = start; e < end; ++e)
 		{
-			int v1 = M.edges.vertex(e, lv);
-			int v2 = M.edges.vertex(e, (lv + 1) % 2);
-			if (is_singular[v1] && !is_singular[v2])
+			for (index_t lv = 0; lv < 2; ++lv)
 			{
-				GEO::vec3 coords = t * mesh_vertex(M, v1) + (1.0 - t) * mesh_vertex(M, v2);
-				edge_to_midpoint[e] = mesh_create_vertex(M, coords);
+				int v1 = M.edges.vertex(e, lv);
+				int v2 = M.edges.vertex(e, (lv + 1) % 2);
+				if (is_singular[v1] && !is_singular[v2])
+				{
+					GEO::vec3 coords = t * mesh_vertex(M, v1) + (1.0 - t) * mesh_vertex(M, v2);
+					edge_to_midpoint[e] = first_vertex + offsets[e];
+					mesh_set_vertex(M, edge_to_midpoint[e], coords);
+				}
 			}
 		}
-	}
+	});
 
 	GEO::Attribute<GEO::index_t> c2e(M.facet_corners.attributes(), "edge_id");
 
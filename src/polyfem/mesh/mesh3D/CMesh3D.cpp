@@ -2,6 +2,7 @@
 #include <polyfem/mesh/mesh3D/MeshProcessing3D.hpp>
 #include <polyfem/mesh/MeshUtils.hpp>
 #include <polyfem/utils/StringUtils.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
 
 #include <polyfem/utils/Logger.hpp>
 
@@ -16,6 +17,14 @@ namespace polyfem
 {
 	namespace mesh
 	{
+		void CMesh3D::prepare_mesh()
+		{
+			if (use_navigation_tables_)
+				navigation_table_.build(mesh_);
+			else
+				navigation_table_.clear();
+		}
+
 		void CMesh3D::refine(const int n_refinement, const double t)
 		{
 			if (n_refinement <= 0)
@@ -43,6 +52,7 @@ namespace polyfem
 			}
 
 			Navigation3D::prepare_mesh(mesh_);
+			navigation_table_.clear();
 			compute_elements_tag();
 
 			in_ordered_vertices_ = Eigen::VectorXi::LinSpaced(n_vertices(), 0, n_vertices() - 1);
@@ -193,6 +203,7 @@ namespace polyfem
 			}
 
 			Navigation3D::prepare_mesh(mesh_);
+			navigation_table_.clear();
 			// if(is_simplicial())
 			// MeshProcessing3D::orient_volume_mesh(mesh_);
 			compute_elements_tag();
@@ -406,6 +417,7 @@ namespace polyfem
 			}
 
 			Navigation3D::prepare_mesh(mesh_);
+			navigation_table_.clear();
 			// if (is_simplicial()) {
 			// 	MeshProcessing3D::orient_volume_mesh(mesh_);
 			// }
@@ -1124,19 +1136,15 @@ namespace polyfem
 
 		bool CMesh3D::is_boundary_element(const int element_global_id) const
 		{
-			const auto &fs = mesh_.elements[element_global_id].fs;
-
-			for (auto f_id : fs)
+			for (const uint32_t *f_id = mesh_.element_fs.begin(element_global_id); f_id != mesh_.element_fs.end(element_global_id); ++f_id)
 			{
-				if (is_boundary_face(f_id))
+				if (is_boundary_face(*f_id))
 					return true;
 			}
 
-			const auto &vs = mesh_.elements[element_global_id].vs;
-
-			for (auto v_id : vs)
+			for (const uint32_t *v_id = mesh_.element_vs.begin(element_global_id); v_id != mesh_.element_vs.end(element_global_id); ++v_id)
 			{
-				if (is_boundary_vertex(v_id))
+				if (is_boundary_vertex(*v_id))
 					return true;
 			}
 
@@ -1202,18 +1210,20 @@ namespace polyfem
 		{
 			boundary_ids_.resize(n_faces());
 
-			for (int f = 0; f < n_faces(); ++f)
-			{
-				const bool is_boundary = is_boundary_face(f);
-				std::vector<int> vs(n_face_vertices(f));
-				for (int vid = 0; vid < vs.size(); ++vid)
-					vs[vid] = face_vertex(f, vid);
+			utils::maybe_parallel_for(n_faces(), [&](int start, int end, int thread_id) {
+				for (int f = start; f < end; ++f)
+				{
+					const bool is_boundary = is_boundary_face(f);
+					std::vector<int> vs(n_face_vertices(f));
+					for (int vid = 0; vid < vs.size(); ++vid)
+						vs[vid] = face_vertex(f, vid);
 
-				const auto p = face_barycenter(f);
+					const auto p = face_barycenter(f);
 
-				std::sort(vs.begin(), vs.end());
-				boundary_ids_[f] = marker(f, vs, p, is_boundary);
-			}
+					std::sort(vs.begin(), vs.end());
+					boundary_ids_[f] = marker(f, vs, p, is_boundary);
+				}
+			});
 		}
 
 		void CMesh3D::compute_boundary_ids(const double eps)
@@ -1254,11 +1264,13 @@ namespace polyfem
 			body_ids_.resize(n_elements());
 			std::fill(body_ids_.begin(), body_ids_.end(), -1);
 
-			for (int e = 0; e < n_elements(); ++e)
-			{
-				const auto bary = cell_barycenter(e);
-				body_ids_[e] = marker(e, bary);
-			}
+			utils::maybe_parallel_for(n_elements(), [&](int start, int end, int thread_id) {
+				for (int e = start; e < end; ++e)
+				{
+					const auto bary = cell_barycenter(e);
+					body_ids_[e] = marker(e, bary);
+				}
+			});
 		}
 
 		RowVectorNd CMesh3D::point(const int global_index) const
@@ -1296,188 +1308,191 @@ namespace polyfem
 
 			// boundary flags
 			std::vector<bool> bv_flag(mesh_.vertices.size(), false), be_flag(mesh_.edges.size(), false), bf_flag(mesh_.faces.size(), false);
-			for (auto f : mesh_.faces)
+			for (const auto &f : mesh_.faces)
 				if (f.boundary)
 					bf_flag[f.id] = true;
 				else
 				{
-					for (auto nhid : f.neighbor_hs)
-						if (!mesh_.elements[nhid].hex)
+					for (const uint32_t *nhid = mesh_.face_hs.begin(f.id); nhid != mesh_.face_hs.end(f.id); ++nhid)
+						if (!mesh_.elements[*nhid].hex)
 							bf_flag[f.id] = true;
 				}
 			for (uint32_t i = 0; i < mesh_.faces.size(); ++i)
 				if (bf_flag[i])
-					for (uint32_t j = 0; j < mesh_.faces[i].vs.size(); ++j)
+					for (uint32_t j = 0; j < mesh_.face_vs.size(i); ++j)
 					{
-						uint32_t eid = mesh_.faces[i].es[j];
+						uint32_t eid = mesh_.face_es(i, j);
 						be_flag[eid] = true;
-						bv_flag[mesh_.faces[i].vs[j]] = true;
+						bv_flag[mesh_.face_vs(i, j)] = true;
 					}
 
-			for (auto &ele : mesh_.elements)
-			{
-				if (ele.hex)
+			utils::maybe_parallel_for(mesh_.elements.size(), [&](int start, int end, int thread_id) {
+				for (int e = start; e < end; ++e)
 				{
-					bool attaching_non_hex = false, on_boundary = false;
-					;
-					for (auto vid : ele.vs)
+					const auto &ele = mesh_.elements[e];
+					if (ele.hex)
 					{
-						for (auto eleid : mesh_.vertices[vid].neighbor_hs)
-							if (!mesh_.elements[eleid].hex)
+						bool attaching_non_hex = false, on_boundary = false;
+						;
+						for (auto vid : ele.vs)
+						{
+							for (auto eleid : mesh_.vertices[vid].neighbor_hs)
+								if (!mesh_.elements[eleid].hex)
+								{
+									attaching_non_hex = true;
+									break;
+								}
+							if (mesh_.vertices[vid].boundary)
 							{
-								attaching_non_hex = true;
+								on_boundary = true;
 								break;
 							}
-						if (mesh_.vertices[vid].boundary)
+							if (on_boundary || attaching_non_hex)
+								break;
+						}
+						if (attaching_non_hex)
 						{
-							on_boundary = true;
-							break;
+							ele_tag[ele.id] = ElementType::INTERFACE_CUBE;
+							continue;
 						}
-						if (on_boundary || attaching_non_hex)
-							break;
-					}
-					if (attaching_non_hex)
-					{
-						ele_tag[ele.id] = ElementType::INTERFACE_CUBE;
-						continue;
-					}
 
-					if (on_boundary)
-					{
-						ele_tag[ele.id] = ElementType::MULTI_SINGULAR_BOUNDARY_CUBE;
-						// has no boundary edge--> singular
-						bool boundary_edge = false, boundary_edge_singular = false, interior_edge_singular = false;
-						int n_interior_edge_singular = 0;
-						for (auto eid : ele.es)
+						if (on_boundary)
 						{
-							int en = 0;
-							if (be_flag[eid])
-							{
-								boundary_edge = true;
-								for (auto nhid : mesh_.edges[eid].neighbor_hs)
-									if (mesh_.elements[nhid].hex)
-										en++;
-								if (en > 2)
-									boundary_edge_singular = true;
-							}
-							else
+							ele_tag[ele.id] = ElementType::MULTI_SINGULAR_BOUNDARY_CUBE;
+							// has no boundary edge--> singular
+							bool boundary_edge = false, boundary_edge_singular = false, interior_edge_singular = false;
+							int n_interior_edge_singular = 0;
+							for (auto eid : ele.es)
 							{
-								for (auto nhid : mesh_.edges[eid].neighbor_hs)
-									if (mesh_.elements[nhid].hex)
-										en++;
-								if (en != 4)
+								int en = 0;
+								if (be_flag[eid])
 								{
-									interior_edge_singular = true;
-									n_interior_edge_singular++;
+									boundary_edge = true;
+									for (auto nhid : mesh_.edges[eid].neighbor_hs)
+										if (mesh_.elements[nhid].hex)
+											en++;
+									if (en > 2)
+										boundary_edge_singular = true;
+								}
+								else
+								{
+									for (auto nhid : mesh_.edges[eid].neighbor_hs)
+										if (mesh_.elements[nhid].hex)
+											en++;
+									if (en != 4)
+									{
+										interior_edge_singular = true;
+										n_interior_edge_singular++;
+									}
 								}
 							}
-						}
-						if (!boundary_edge || boundary_edge_singular || n_interior_edge_singular > 1)
-							continue;
+							if (!boundary_edge || boundary_edge_singular || n_interior_edge_singular > 1)
+								continue;
 
-						bool has_singular_v = false, has_iregular_v = false;
-						int n_in_irregular_v = 0;
-						for (auto vid : ele.vs)
-						{
-							int vn = 0;
-							if (bv_flag[vid])
+							bool has_singular_v = false, has_iregular_v = false;
+							int n_in_irregular_v = 0;
+							for (auto vid : ele.vs)
 							{
-								int nh = 0;
-								for (auto nhid : mesh_.vertices[vid].neighbor_hs)
-									if (mesh_.elements[nhid].hex)
-										nh++;
-								if (nh > 4)
-									has_iregular_v = true;
-								continue; // not sure the conditions
-							}
-							else
-							{
-								if (mesh_.vertices[vid].neighbor_hs.size() != 8)
-									n_in_irregular_v++;
-								int n_irregular_e = 0;
-								for (auto eid : mesh_.vertices[vid].neighbor_es)
+								int vn = 0;
+								if (bv_flag[vid])
 								{
-									if (mesh_.edges[eid].neighbor_hs.size() != 4)
-										n_irregular_e++;
+									int nh = 0;
+									for (auto nhid : mesh_.vertices[vid].neighbor_hs)
+										if (mesh_.elements[nhid].hex)
+											nh++;
+									if (nh > 4)
+										has_iregular_v = true;
+									continue; // not sure the conditions
 								}
-								if (n_irregular_e != 0 && n_irregular_e != 2)
+								else
 								{
-									has_singular_v = true;
-									break;
+									if (mesh_.vertices[vid].neighbor_hs.size() != 8)
+										n_in_irregular_v++;
+									int n_irregular_e = 0;
+									for (auto eid : mesh_.vertices[vid].neighbor_es)
+									{
+										if (mesh_.edges[eid].neighbor_hs.size() != 4)
+											n_irregular_e++;
+									}
+									if (n_irregular_e != 0 && n_irregular_e != 2)
+									{
+										has_singular_v = true;
+										break;
+									}
 								}
 							}
-						}
-						int n_irregular_e = 0;
-						for (auto eid : ele.es)
-							if (!be_flag[eid] && mesh_.edges[eid].neighbor_hs.size() != 4)
-								n_irregular_e++;
-						if (has_singular_v)
-							continue;
-						if (!has_singular_v)
-						{
-							if (n_irregular_e == 1)
+							int n_irregular_e = 0;
+							for (auto eid : ele.es)
+								if (!be_flag[eid] && mesh_.edges[eid].neighbor_hs.size() != 4)
+									n_irregular_e++;
+							if (has_singular_v)
+								continue;
+							if (!has_singular_v)
 							{
-								ele_tag[ele.id] = ElementType::SIMPLE_SINGULAR_BOUNDARY_CUBE;
+								if (n_irregular_e == 1)
+								{
+									ele_tag[ele.id] = ElementType::SIMPLE_SINGULAR_BOUNDARY_CUBE;
+								}
+								else if (n_irregular_e == 0 && n_in_irregular_v == 0 && !has_iregular_v)
+									ele_tag[ele.id] = ElementType::REGULAR_BOUNDARY_CUBE;
+								else
+									continue;
 							}
-							else if (n_irregular_e == 0 && n_in_irregular_v == 0 && !has_iregular_v)
-								ele_tag[ele.id] = ElementType::REGULAR_BOUNDARY_CUBE;
-							else
-								continue;
+							continue;
 						}
-						continue;
-					}
 
-					// type 1
-					bool has_irregular_v = false;
-					for (auto vid : ele.vs)
-						if (mesh_.vertices[vid].neighbor_hs.size() != 8)
+						// type 1
+						bool has_irregular_v = false;
+						for (auto vid : ele.vs)
+							if (mesh_.vertices[vid].neighbor_hs.size() != 8)
+							{
+								has_irregular_v = true;
+								break;
+							}
+						if (!has_irregular_v)
 						{
-							has_irregular_v = true;
-							break;
+							ele_tag[ele.id] = ElementType::REGULAR_INTERIOR_CUBE;
+							continue;
 						}
-					if (!has_irregular_v)
-					{
-						ele_tag[ele.id] = ElementType::REGULAR_INTERIOR_CUBE;
-						continue;
-					}
-					// type 2
-					bool has_singular_v = false;
-					int n_irregular_v = 0;
-					for (auto vid : ele.vs)
-					{
-						if (mesh_.vertices[vid].neighbor_hs.size() != 8)
-							n_irregular_v++;
-						int n_irregular_e = 0;
-						for (auto eid : mesh_.vertices[vid].neighbor_es)
+						// type 2
+						bool has_singular_v = false;
+						int n_irregular_v = 0;
+						for (auto vid : ele.vs)
 						{
-							if (mesh_.edges[eid].neighbor_hs.size() != 4)
-								n_irregular_e++;
+							if (mesh_.vertices[vid].neighbor_hs.size() != 8)
+								n_irregular_v++;
+							int n_irregular_e = 0;
+							for (auto eid : mesh_.vertices[vid].neighbor_es)
+							{
+								if (mesh_.edges[eid].neighbor_hs.size() != 4)
+									n_irregular_e++;
+							}
+							if (n_irregular_e != 0 && n_irregular_e != 2)
+							{
+								has_singular_v = true;
+								break;
+							}
 						}
-						if (n_irregular_e != 0 && n_irregular_e != 2)
+						if (!has_singular_v && n_irregular_v == 2)
 						{
-							has_singular_v = true;
-							break;
+							ele_tag[ele.id] = ElementType::SIMPLE_SINGULAR_INTERIOR_CUBE;
+							continue;
 						}
+
+						ele_tag[ele.id] = ElementType::MULTI_SINGULAR_INTERIOR_CUBE;
 					}
-					if (!has_singular_v && n_irregular_v == 2)
+					else
 					{
-						ele_tag[ele.id] = ElementType::SIMPLE_SINGULAR_INTERIOR_CUBE;
-						continue;
+						ele_tag[ele.id] = ElementType::INTERIOR_POLYTOPE;
+						for (auto fid : ele.fs)
+							if (mesh_.faces[fid].boundary)
+							{
+								ele_tag[ele.id] = ElementType::BOUNDARY_POLYTOPE;
+								break;
+							}
 					}
-
-					ele_tag[ele.id] = ElementType::MULTI_SINGULAR_INTERIOR_CUBE;
-				}
-				else
-				{
-					ele_tag[ele.id] = ElementType::INTERIOR_POLYTOPE;
-					for (auto fid : ele.fs)
-						if (mesh_.faces[fid].boundary)
-						{
-							ele_tag[ele.id] = ElementType::BOUNDARY_POLYTOPE;
-							break;
-						}
 				}
-			}
+			});
 
 			// TODO correct?
 			for (auto &ele : mesh_.elements)
@@ -1492,7 +1507,7 @@ namespace polyfem
 			const int n_vertices = n_face_vertices(gid);
 			assert(n_vertices == 4);
 
-			const auto &vertices = mesh_.faces[gid].vs;
+			const uint32_t *vertices = mesh_.face_vs.begin(gid);
 
 			const auto v1 = point(vertices[0]);
 			const auto v2 = point(vertices[1]);
@@ -1510,8 +1525,8 @@ namespace polyfem
 
 		RowVectorNd CMesh3D::edge_barycenter(const int e) const
 		{
-			const int v0 = mesh_.edges[e].vs[0];
-			const int v1 = mesh_.edges[e].vs[1];
+			const int v0 = mesh_.edge_vs(e, 0);
+			const int v1 = mesh_.edge_vs(e, 1);
 			return 0.5 * (point(v0) + point(v1));
 		}
 
@@ -1521,7 +1536,7 @@ namespace polyfem
 			RowVectorNd bary(3);
 			bary.setZero();
 
-			const auto &vertices = mesh_.faces[f].vs;
+			const uint32_t *vertices = mesh_.face_vs.begin(f);
 			for (int lv = 0; lv < n_vertices; ++lv)
 			{
 				bary += point(vertices[lv]);
@@ -1535,7 +1550,7 @@ namespace polyfem
 			RowVectorNd bary(3);
 			bary.setZero();
 
-			const auto &vertices = mesh_.elements[c].vs;
+			const uint32_t *vertices = mesh_.element_vs.begin(c);
 			for (int lv = 0; lv < n_vertices; ++lv)
 			{
 				bary += point(vertices[lv]);
@@ -1622,13 +1637,28 @@ namespace polyfem
 
 		void CMesh3D::append(const Mesh &mesh)
 		{
-			assert(typeid(mesh) == typeid(CMesh3D));
-			Mesh::append(mesh);
+			append(std::vector<const Mesh *>{&mesh});
+		}
+
+		void CMesh3D::append(const std::vector<const Mesh *> &meshes)
+		{
+			if (meshes.empty())
+				return;
 
-			const CMesh3D &mesh3d = dynamic_cast<const CMesh3D &>(mesh);
-			mesh_.append(mesh3d.mesh_);
+			Mesh::append_mesh_data(meshes);
+
+			std::vector<const Mesh3DStorage *> storages;
+			storages.reserve(meshes.size());
+			for (const Mesh *mesh : meshes)
+			{
+				assert(typeid(*mesh) == typeid(CMesh3D));
+				storages.push_back(&dynamic_cast<const CMesh3D &>(*mesh).mesh_);
+			}
+			mesh_.append(storages);
 
+			// the connectivity is rebuilt once for all the appended meshes
 			Navigation3D::prepare_mesh(mesh_);
+			navigation_table_.clear();
 			compute_elements_tag();
 		}
 
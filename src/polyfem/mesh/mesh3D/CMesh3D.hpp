@@ -34,15 +34,15 @@ namespace polyfem
 			int n_edges() const override { return int(mesh_.edges.size()); }
 			int n_vertices() const override { return int(mesh_.points.cols()); }
 
-			inline int n_face_vertices(const int f_id) const override { return mesh_.faces[f_id].vs.size(); }
-			inline int n_cell_vertices(const int c_id) const override { return mesh_.elements[c_id].vs.size(); }
-			inline int n_cell_edges(const int c_id) const override { return mesh_.elements[c_id].es.size(); }
-			inline int n_cell_faces(const int c_id) const override { return mesh_.elements[c_id].fs.size(); }
-			inline int cell_vertex(const int c_id, const int lv_id) const override { return mesh_.elements[c_id].vs[lv_id]; }
-			inline int cell_face(const int c_id, const int lf_id) const override { return mesh_.elements[c_id].fs[lf_id]; }
-			inline int cell_edge(const int c_id, const int le_id) const override { return mesh_.elements[c_id].es[le_id]; }
-			inline int face_vertex(const int f_id, const int lv_id) const override { return mesh_.faces[f_id].vs[lv_id]; }
-			inline int edge_vertex(const int e_id, const int lv_id) const override { return mesh_.edges[e_id].vs[lv_id]; }
+			inline int n_face_vertices(const int f_id) const override { return mesh_.face_vs.size(f_id); }
+			inline int n_cell_vertices(const int c_id) const override { return mesh_.element_vs.size(c_id); }
+			inline int n_cell_edges(const int c_id) const override { return mesh_.element_es.size(c_id); }
+			inline int n_cell_faces(const int c_id) const override { return mesh_.element_fs.size(c_id); }
+			inline int cell_vertex(const int c_id, const int lv_id) const override { return mesh_.element_vs(c_id, lv_id); }
+			inline int cell_face(const int c_id, const int lf_id) const override { return mesh_.element_fs(c_id, lf_id); }
+			inline int cell_edge(const int c_id, const int le_id) const override { return mesh_.element_es(c_id, le_id); }
+			inline int face_vertex(const int f_id, const int lv_id) const override { return mesh_.face_vs(f_id, lv_id); }
+			inline int edge_vertex(const int e_id, const int lv_id) const override { return mesh_.edge_vs(e_id, lv_id); }
 
 			void elements_boxes(std::vector<std::array<Eigen::Vector3d, 2>> &boxes) const override;
 			void barycentric_coords(const RowVectorNd &p, const int el_id, Eigen::MatrixXd &coord) const override;
@@ -78,14 +78,16 @@ namespace polyfem
 			Navigation3D::Index get_index_from_element_edge(int hi, int v0, int v1) const override { return Navigation3D::get_index_from_element_edge(mesh_, hi, v0, v1); }
 			Navigation3D::Index get_index_from_element_face(int hi, int v0, int v1, int v2) const override { return Navigation3D::get_index_from_element_tri(mesh_, hi, v0, v1, v2); }
 
-			inline std::vector<uint32_t> vertex_neighs(const int v_gid) const override { return mesh_.vertices[v_gid].neighbor_hs; }
-			inline std::vector<uint32_t> edge_neighs(const int e_gid) const override { return mesh_.edges[e_gid].neighbor_hs; }
+			inline std::vector<uint32_t> vertex_neighs(const int v_gid) const override { return mesh_.vertex_hs.to_vector(v_gid); }
+			inline std::vector<uint32_t> edge_neighs(const int e_gid) const override { return mesh_.edge_hs.to_vector(e_gid); }
 
 			// Navigation in a surface mesh
 			Navigation3D::Index switch_vertex(Navigation3D::Index idx) const override { return Navigation3D::switch_vertex(mesh_, idx); }
 			Navigation3D::Index switch_edge(Navigation3D::Index idx) const override { return Navigation3D::switch_edge(mesh_, idx); }
-			Navigation3D::Index switch_face(Navigation3D::Index idx) const override { return Navigation3D::switch_face(mesh_, idx); }
-			Navigation3D::Index switch_element(Navigation3D::Index idx) const override { return Navigation3D::switch_element(mesh_, idx); }
+			Navigation3D::Index switch_face(Navigation3D::Index idx) const override { return navigation_table_.empty() ? Navigation3D::switch_face(mesh_, idx) : navigation_table_.switch_face(mesh_, idx); }
+			Navigation3D::Index switch_element(Navigation3D::Index idx) const override { return navigation_table_.empty() ? Navigation3D::switch_element(mesh_, idx) : navigation_table_.switch_element(mesh_, idx); }
+
+			void prepare_mesh() override;
 
 			// Iterate in a mesh
 			inline Navigation3D::Index next_around_edge(Navigation3D::Index idx) const override { return Navigation3D::next_around_3Dedge(mesh_, idx); }
@@ -94,12 +96,12 @@ namespace polyfem
 			void get_vertex_elements_neighs(const int v_id, std::vector<int> &ids) const override
 			{
 				ids.clear();
-				ids.insert(ids.begin(), mesh_.vertices[v_id].neighbor_hs.begin(), mesh_.vertices[v_id].neighbor_hs.end());
+				ids.insert(ids.begin(), mesh_.vertex_hs.begin(v_id), mesh_.vertex_hs.end(v_id));
 			}
 			void get_edge_elements_neighs(const int e_id, std::vector<int> &ids) const override
 			{
 				ids.clear();
-				ids.insert(ids.begin(), mesh_.edges[e_id].neighbor_hs.begin(), mesh_.edges[e_id].neighbor_hs.end());
+				ids.insert(ids.begin(), mesh_.edge_hs.begin(e_id), mesh_.edge_hs.end(e_id));
 			}
 
 			void compute_boundary_ids(const double eps) override;
@@ -116,11 +118,13 @@ namespace polyfem
 			Mesh3DStorage &mesh_storge()
 			{
 				std::cerr << "never user this function" << std::endl;
+				navigation_table_.clear();
 				return mesh_;
 			}
 			static void geomesh_2_mesh_storage(const GEO::Mesh &gm, Mesh3DStorage &m);
 
 			void append(const Mesh &mesh) override;
+			void append(const std::vector<const Mesh *> &meshes) override;
 
 		protected:
 			bool load(const std::string &path) override;
@@ -128,6 +132,8 @@ namespace polyfem
 
 		private:
 			Mesh3DStorage mesh_;
+			/// built by prepare_mesh if use_navigation_tables_, cleared when the connectivity changes
+			Navigation3D::NavigationTable navigation_table_;
 		};
 	} // namespace mesh
 } // namespace polyfem
@@ -0,0 +1,160 @@
+#include "Mesh3DStorage.hpp"
+
+#include <polyfem/utils/MaybeParallelFor.hpp>
+
+#include <cassert>
+
+namespace polyfem::mesh
+{
+	namespace
+	{
+		template <typename Entity, typename Getter>
+		void build_relation(const std::vector<Entity> &entities, const Getter &get, CSRRelation &relation)
+		{
+			relation.offsets.resize(entities.size() + 1);
+			relation.offsets[0] = 0;
+			for (size_t i = 0; i < entities.size(); ++i)
+				relation.offsets[i + 1] = relation.offsets[i] + get(entities[i]).size();
+
+			relation.indices.resize(relation.offsets.back());
+			utils::maybe_parallel_for(entities.size(), [&](int start, int end, int thread_id) {
+				for (int i = start; i < end; ++i)
+				{
+					const auto &list = get(entities[i]);
+					std::copy(list.begin(), list.end(), relation.indices.begin() + relation.offsets[i]);
+				}
+			});
+		}
+	} // namespace
+
+	void Mesh3DStorage::compress()
+	{
+		build_relation(vertices, [](const Vertex &v) -> const auto & { return v.neighbor_vs; }, vertex_vs);
+		build_relation(vertices, [](const Vertex &v) -> const auto & { return v.neighbor_es; }, vertex_es);
+		build_relation(vertices, [](const Vertex &v) -> const auto & { return v.neighbor_fs; }, vertex_fs);
+		build_relation(vertices, [](const Vertex &v) -> const auto & { return v.neighbor_hs; }, vertex_hs);
+
+		build_relation(edges, [](const Edge &e) -> const auto & { return e.vs; }, edge_vs);
+		build_relation(edges, [](const Edge &e) -> const auto & { return e.neighbor_fs; }, edge_fs);
+		build_relation(edges, [](const Edge &e) -> const auto & { return e.neighbor_hs; }, edge_hs);
+
+		build_relation(faces, [](const Face &f) -> const auto & { return f.vs; }, face_vs);
+		build_relation(faces, [](const Face &f) -> const auto & { return f.es; }, face_es);
+		build_relation(faces, [](const Face &f) -> const auto & { return f.neighbor_hs; }, face_hs);
+
+		build_relation(elements, [](const Element &h) -> const auto & { return h.vs; }, element_vs);
+		build_relation(elements, [](const Element &h) -> const auto & { return h.es; }, element_es);
+		build_relation(elements, [](const Element &h) -> const auto & { return h.fs; }, element_fs);
+
+		element_fs_flag.assign(element_fs.indices.size(), 0);
+		utils::maybe_parallel_for(elements.size(), [&](int start, int end, int thread_id) {
+			for (int i = start; i < end; ++i)
+			{
+				const auto &flags = elements[i].fs_flag;
+				const int n_flags = std::min<int>(flags.size(), element_fs.size(i));
+				for (int j = 0; j < n_flags; ++j)
+					element_fs_flag[element_fs.offsets[i] + j] = flags[j];
+			}
+		});
+	}
+
+	void Mesh3DStorage::append(const std::vector<const Mesh3DStorage *> &others)
+	{
+		if (others.empty())
+			return;
+
+		const int n_others = others.size();
+		std::vector<int> v_offsets(n_others + 1), e_offsets(n_others + 1), f_offsets(n_others + 1), c_offsets(n_others + 1);
+		v_offsets[0] = points.cols();
+		e_offsets[0] = edges.size();
+		f_offsets[0] = faces.size();
+		c_offsets[0] = elements.size();
+		assert(v_offsets[0] == vertices.size());
+		for (int k = 0; k < n_others; ++k)
+		{
+			const Mesh3DStorage &other = *others[k];
+			if (other.type != type)
+				type = MeshType::HYB;
+			assert(points.rows() == other.points.rows());
+
+			v_offsets[k + 1] = v_offsets[k] + other.points.cols();
+			e_offsets[k + 1] = e_offsets[k] + other.edges.size();
+			f_offsets[k + 1] = f_offsets[k] + other.faces.size();
+			c_offsets[k + 1] = c_offsets[k] + other.elements.size();
+			assert(other.points.cols() == other.vertices.size());
+		}
+
+		points.conservativeResize(points.rows(), v_offsets.back());
+		vertices.resize(v_offsets.back());
+		edges.resize(e_offsets.back());
+		faces.resize(f_offsets.back());
+		elements.resize(c_offsets.back());
+
+		const auto shift = [](std::vector<uint32_t> &ids, const int offset) {
+			for (auto &id : ids)
+				id += offset;
+		};
+
+		utils::maybe_parallel_for(n_others, [&](int start, int end, int thread_id) {
+			for (int k = start; k < end; ++k)
+			{
+				const Mesh3DStorage &other = *others[k];
+				const int n_v = v_offsets[k];
+				const int n_e = e_offsets[k];
+				const int n_f = f_offsets[k];
+				const int n_c = c_offsets[k];
+
+				points.middleCols(n_v, other.points.cols()) = other.points;
+
+				for (size_t i = 0; i < other.vertices.size(); ++i)
+				{
+					Vertex &tmp = vertices[n_v + i];
+					tmp = other.vertices[i];
+					tmp.id += n_v;
+					shift(tmp.neighbor_vs, n_v);
+					shift(tmp.neighbor_es, n_e);
+					shift(tmp.neighbor_fs, n_f);
+					shift(tmp.neighbor_hs, n_c);
+				}
+
+				for (size_t i = 0; i < other.edges.size(); ++i)
+				{
+					Edge &tmp = edges[n_e + i];
+					tmp = other.edges[i];
+					tmp.id += n_e;
+					shift(tmp.vs, n_v);
+					shift(tmp.neighbor_fs, n_f);
+					shift(tmp.neighbor_hs, n_c);
+				}
+
+				for (size_t i = 0; i < other.faces.size(); ++i)
+				{
+					Face &tmp = faces[n_f + i];
+					tmp = other.faces[i];
+					tmp.id += n_f;
+					shift(tmp.vs, n_v);
+					shift(tmp.es, n_e);
+					shift(tmp.neighbor_hs, n_c);
+				}
+
+				for (size_t i = 0; i < other.elements.size(); ++i)
+				{
+					Element &tmp = elements[n_c + i];
+					tmp = other.elements[i];
+					tmp.id += n_c;
+					shift(tmp.vs, n_v);
+					shift(tmp.es, n_e);
+					shift(tmp.fs, n_f);
+				}
+			}
+		});
+
+		EV.resize(0, 0);
+		FV.resize(0, 0);
+		FE.resize(0, 0);
+		FH.resize(0, 0);
+		FHi.resize(0, 0);
+		HV.resize(0, 0);
+		HF.resize(0, 0);
+	}
+} // namespace polyfem::mesh
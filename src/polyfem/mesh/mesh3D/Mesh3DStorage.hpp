@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <vector>
 #include <Eigen/Dense>
 
@@ -50,6 +52,28 @@ namespace polyfem
 			std::vector<double> v_in_Kernel;
 		};
 
+		/// Compressed sparse row storage of a relation between two kinds of entities (e.g., faces to vertices):
+		/// the entities related to the i-th one are indices[offsets[i]], ..., indices[offsets[i+1]-1].
+		struct CSRRelation
+		{
+			std::vector<uint32_t> offsets = {0};
+			std::vector<uint32_t> indices;
+
+			/// number of entities related to the i-th one
+			inline int size(const int i) const { return offsets[i + 1] - offsets[i]; }
+			/// j-th entity related to the i-th one
+			inline uint32_t operator()(const int i, const int j) const { return indices[offsets[i] + j]; }
+			inline const uint32_t *begin(const int i) const { return indices.data() + offsets[i]; }
+			inline const uint32_t *end(const int i) const { return indices.data() + offsets[i + 1]; }
+			/// position of the entity e in the list of the i-th one, -1 if it is not there
+			inline int find(const int i, const uint32_t e) const
+			{
+				const uint32_t *it = std::find(begin(i), end(i), e);
+				return it == end(i) ? -1 : int(it - begin(i));
+			}
+			std::vector<uint32_t> to_vector(const int i) const { return std::vector<uint32_t>(begin(i), end(i)); }
+		};
+
 		enum class MeshType
 		{
 			TRI = 0,
@@ -74,125 +98,22 @@ namespace polyfem
 			Eigen::MatrixXi FV, FE, FH, FHi; // FV (3, nf), FE(3, nf), FH (2, nf), FHi(2, nf)
 			Eigen::MatrixXi HV, HF;          // HV(4, nh), HE(6, nh), HF(4, nh)
 
-			void append(const Mesh3DStorage &other)
-			{
-				if (other.type != type)
-					type = MeshType::HYB;
-
-				const int n_v = points.cols();
-				const int n_e = edges.size();
-				const int n_f = faces.size();
-				const int n_c = elements.size();
-				assert(n_v == vertices.size());
-
-				assert(points.rows() == other.points.rows());
-				points.conservativeResize(points.rows(), n_v + other.points.cols());
-				points.rightCols(other.points.cols()) = other.points;
-
-				for (const auto &v : other.vertices)
-				{
-					auto tmp = v;
-					tmp.id += n_v;
-					for (auto &e : tmp.neighbor_vs)
-						e += n_v;
-
-					for (auto &e : tmp.neighbor_es)
-						e += n_e;
-
-					for (auto &e : tmp.neighbor_fs)
-						e += n_f;
-
-					for (auto &e : tmp.neighbor_hs)
-						e += n_c;
-
-					vertices.push_back(tmp);
-				}
-				assert(points.cols() == vertices.size());
-				assert(vertices.size() == n_v + other.vertices.size());
-
-				for (const auto &e : other.edges)
-				{
-					auto tmp = e;
-					tmp.id += n_e;
-					for (auto &e : tmp.vs)
-						e += n_v;
-
-					for (auto &e : tmp.neighbor_fs)
-						e += n_f;
-
-					for (auto &e : tmp.neighbor_hs)
-						e += n_c;
-
-					edges.push_back(tmp);
-				}
-				assert(edges.size() == n_e + other.edges.size());
-
-				for (const auto &f : other.faces)
-				{
-					auto tmp = f;
-					tmp.id += n_f;
-					for (auto &e : tmp.vs)
-						e += n_v;
-
-					for (auto &e : tmp.es)
-						e += n_e;
-
-					for (auto &e : tmp.neighbor_hs)
-						e += n_c;
-
-					faces.push_back(tmp);
-				}
-				assert(faces.size() == n_f + other.faces.size());
-
-				for (const auto &c : other.elements)
-				{
-					auto tmp = c;
-					tmp.id += n_c;
-					for (auto &e : tmp.vs)
-						e += n_v;
-
-					for (auto &e : tmp.es)
-						e += n_e;
-
-					for (auto &e : tmp.fs)
-						e += n_f;
-
-					elements.push_back(tmp);
-				}
-				assert(elements.size() == n_c + other.elements.size());
-				EV.resize(0, 0);
-				// assert(EV.size() == 0 || EV.rows() == other.EV.rows());
-				// EV.conservativeResize(std::max(EV.rows(), other.EV.rows()), other.EV.cols() + EV.cols());
-				// EV.rightCols(other.EV.cols()) = other.EV.array() + n_v;
-
-				// //////////////////
-				FV.resize(0, 0);
-				// assert(FV.size() == 0 || FV.rows() == other.FV.rows());
-				// FV.conservativeResize(std::max(FV.rows(), other.FV.rows()), other.FV.cols() + FV.cols());
-				// FV.rightCols(other.FV.cols()) = other.FV.array() + n_v;
-				FE.resize(0, 0);
-				// assert(FE.size() == 0 || FE.rows() == other.FE.rows());
-				// FE.conservativeResize(std::max(FE.rows(), other.FE.rows()), other.FE.cols() + FE.cols());
-				// FE.rightCols(other.FE.cols()) = other.FE.array() + n_e;
-				FH.resize(0, 0);
-				// assert(FH.size() == 0 || FH.rows() == other.FH.rows());
-				// FH.conservativeResize(std::max(FH.rows(), other.FH.rows()), other.FH.cols() + FH.cols());
-				// FH.rightCols(other.FH.cols()) = other.FH.array() + n_c;
-				FHi.resize(0, 0);
-				// assert(FHi.size() == 0 || FHi.rows() == other.FHi.rows());
-				// FHi.conservativeResize(std::max(FHi.rows(), other.FHi.rows()), other.FHi.cols() + FHi.cols());
-				// FHi.rightCols(other.FHi.cols()) = other.FHi.array();
-
-				// /////////////////
-				HV.resize(0, 0);
-				// assert(HV.size() == 0 || HV.rows() == other.HV.rows());
-				// HV.conservativeResize(std::max(HV.rows(), other.HV.rows()), other.HV.cols() + HV.cols());
-				// HV.rightCols(other.HV.cols()) = other.HV.array() + n_v;
-				HF.resize(0, 0);
-				// assert(HF.size() == 0 || HF.rows() == other.HF.rows());
-				// HF.conservativeResize(std::max(HF.rows(), other.HF.rows()), other.HF.cols() + HF.cols());
-				// HF.rightCols(other.HF.cols()) = other.HF.array() + n_f;
-			}
+			// Flat copy of the connectivity of vertices, edges, faces and elements, used by the queries
+			// (Navigation3D, CMesh3D) instead of the per entity vectors. Built by compress(), the
+			// vectors above remain the editable representation used while building and refining.
+			CSRRelation vertex_vs, vertex_es, vertex_fs, vertex_hs;
+			CSRRelation edge_vs, edge_fs, edge_hs;
+			CSRRelation face_vs, face_es, face_hs;
+			CSRRelation element_vs, element_es, element_fs;
+			std::vector<uint8_t> element_fs_flag; ///< same layout as element_fs
+
+			/// @brief Rebuild the CSR relations from the per entity vectors, must be called after any change of the connectivity.
+			void compress();
+
+			/// @brief Appends other meshes, their entity ids are shifted by the current counts.
+			/// The storage is resized once and every mesh fills its own range in parallel. The matrices (EV, FV, ...) are cleared.
+			void append(const std::vector<const Mesh3DStorage *> &others);
+			void append(const Mesh3DStorage &other) { append(std::vector<const Mesh3DStorage *>{&other}); }
 		};
 
 		struct Mesh_Quality
@@ -1,5 +1,6 @@
 #include "MeshProcessing3D.hpp"
 #include <polyfem/utils/Logger.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
 
 #include <Eigen/Dense>
 
@@ -8,6 +9,7 @@
 #include <set>
 #include <queue>
 #include <iterator>
+#include <tuple>
 #include <cassert>
 
 using namespace polyfem::mesh;
@@ -15,124 +17,181 @@ using namespace polyfem;
 using namespace std;
 using namespace Eigen;
 
-void MeshProcessing3D::build_connectivity(Mesh3DStorage &hmi)
+namespace
 {
-	hmi.edges.clear();
-	if (hmi.type == MeshType::TRI || hmi.type == MeshType::QUA || hmi.type == MeshType::H_SUR)
+	// Replaces the per-target lists of the inverse of the source -> targets relation:
+	// assign(t, begin, end) receives the sources of target t in increasing order, with repetitions,
+	// i.e., the same lists as pushing back s into the targets of s for s = 0, 1, ...
+	template <typename Targets, typename Assign>
+	void invert_relation(const int n_sources, const int n_targets, const Targets &targets, const Assign &assign)
 	{
-		std::vector<std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>> temp;
-		temp.reserve(hmi.faces.size() * 3);
-		for (uint32_t i = 0; i < hmi.faces.size(); ++i)
-		{
-			int vn = hmi.faces[i].vs.size();
-			for (uint32_t j = 0; j < vn; ++j)
+		std::vector<size_t> offsets(n_sources + 1, 0);
+		for (int s = 0; s < n_sources; ++s)
+			offsets[s + 1] = offsets[s] + targets(s).size();
+
+		std::vector<std::pair<uint32_t, uint32_t>> pairs(offsets.back());
+		utils::maybe_parallel_for(n_sources, [&](int start, int end, int thread_id) {
+			for (int s = start; s < end; ++s)
 			{
-				uint32_t v0 = hmi.faces[i].vs[j], v1 = hmi.faces[i].vs[(j + 1) % vn];
-				if (v0 > v1)
-					std::swap(v0, v1);
-				temp.push_back(std::make_tuple(v0, v1, i, j));
+				const auto &ts = targets(s);
+				for (size_t k = 0; k < ts.size(); ++k)
+					pairs[offsets[s] + k] = std::make_pair(uint32_t(ts[k]), uint32_t(s));
 			}
-			hmi.faces[i].es.resize(vn);
-		}
-		std::sort(temp.begin(), temp.end());
-		hmi.edges.reserve(temp.size() / 2);
-		uint32_t E_num = 0;
-		Edge e;
-		e.boundary = true;
-		e.vs.resize(2);
-		for (uint32_t i = 0; i < temp.size(); ++i)
+		});
+		utils::maybe_parallel_sort(pairs.begin(), pairs.end());
+
+		std::vector<size_t> target_offsets(n_targets + 1, 0);
+		for (const auto &p : pairs)
+			++target_offsets[p.first + 1];
+		for (int t = 0; t < n_targets; ++t)
+			target_offsets[t + 1] += target_offsets[t];
+
+		std::vector<uint32_t> sources(pairs.size());
+		utils::maybe_parallel_for(pairs.size(), [&](int start, int end, int thread_id) {
+			for (int i = start; i < end; ++i)
+				sources[i] = pairs[i].second;
+		});
+		utils::maybe_parallel_for(n_targets, [&](int start, int end, int thread_id) {
+			for (int t = start; t < end; ++t)
+				assign(t, sources.data() + target_offsets[t], sources.data() + target_offsets[t + 1]);
+		});
+	}
+
+	// Numbers the unique keys of the sorted array: ids[i] is the id of keys[i], ids are given in sorted order.
+	// Returns the number of unique keys.
+	template <typename Keys, typename SameKey>
+	uint32_t unique_ids(const Keys &keys, const SameKey &same_key, std::vector<uint32_t> &ids)
+	{
+		ids.resize(keys.size());
+		uint32_t n = 0;
+		for (size_t i = 0; i < keys.size(); ++i)
 		{
-			if (i == 0 || (i != 0 && (std::get<0>(temp[i]) != std::get<0>(temp[i - 1]) || std::get<1>(temp[i]) != std::get<1>(temp[i - 1]))))
+			if (i == 0 || !same_key(keys[i - 1], keys[i]))
+				++n;
+			ids[i] = n - 1;
+		}
+		return n;
+	}
+
+	// Builds hmi.edges and the faces es from the faces vs.
+	// Edges are numbered in lexicographic order of their sorted vertices.
+	// If boundary_if_single, an edge is on the boundary when it belongs to one face only.
+	void build_edges(Mesh3DStorage &hmi, const bool boundary_if_single)
+	{
+		const int n_faces = hmi.faces.size();
+		std::vector<size_t> offsets(n_faces + 1, 0);
+		for (int i = 0; i < n_faces; ++i)
+			offsets[i + 1] = offsets[i] + hmi.faces[i].vs.size();
+
+		std::vector<std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>> temp(offsets.back());
+		utils::maybe_parallel_for(n_faces, [&](int start, int end, int thread_id) {
+			for (int i = start; i < end; ++i)
 			{
-				e.id = E_num;
-				E_num++;
-				e.vs[0] = std::get<0>(temp[i]);
-				e.vs[1] = std::get<1>(temp[i]);
-				hmi.edges.push_back(e);
+				const int vn = hmi.faces[i].vs.size();
+				for (int j = 0; j < vn; ++j)
+				{
+					uint32_t v0 = hmi.faces[i].vs[j], v1 = hmi.faces[i].vs[(j + 1) % vn];
+					if (v0 > v1)
+						std::swap(v0, v1);
+					temp[offsets[i] + j] = std::make_tuple(v0, v1, i, j);
+				}
+				hmi.faces[i].es.resize(vn);
 			}
-			else if (i != 0 && (std::get<0>(temp[i]) == std::get<0>(temp[i - 1]) && std::get<1>(temp[i]) == std::get<1>(temp[i - 1])))
-				hmi.edges[E_num - 1].boundary = false;
+		});
+		utils::maybe_parallel_sort(temp.begin(), temp.end());
 
-			hmi.faces[std::get<2>(temp[i])].es[std::get<3>(temp[i])] = E_num - 1;
-		}
-		// boundary
-		for (auto &v : hmi.vertices)
-			v.boundary = false;
-		for (uint32_t i = 0; i < hmi.edges.size(); ++i)
-			if (hmi.edges[i].boundary)
+		std::vector<uint32_t> ids;
+		const uint32_t E_num = unique_ids(
+			temp, [](const auto &a, const auto &b) { return std::get<0>(a) == std::get<0>(b) && std::get<1>(a) == std::get<1>(b); }, ids);
+
+		hmi.edges.resize(E_num);
+		utils::maybe_parallel_for(temp.size(), [&](int start, int end, int thread_id) {
+			for (int i = start; i < end; ++i)
 			{
-				hmi.vertices[hmi.edges[i].vs[0]].boundary = hmi.vertices[hmi.edges[i].vs[1]].boundary = true;
+				const uint32_t eid = ids[i];
+				if (i == 0 || ids[i - 1] != eid)
+				{
+					Edge &e = hmi.edges[eid];
+					e.id = eid;
+					e.vs = {std::get<0>(temp[i]), std::get<1>(temp[i])};
+					e.boundary = boundary_if_single && (i + 1 == int(temp.size()) || ids[i + 1] != eid);
+				}
+				hmi.faces[std::get<2>(temp[i])].es[std::get<3>(temp[i])] = eid;
 			}
+		});
 	}
-	else if (hmi.type == MeshType::HEX)
-	{
 
-		std::vector<std::vector<uint32_t>> total_fs(hmi.elements.size() * 6);
-		std::vector<std::tuple<uint32_t, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t>> tempF(hmi.elements.size() * 6);
-		std::vector<uint32_t> vs(4);
-		for (uint32_t i = 0; i < hmi.elements.size(); ++i)
-		{
-			for (short j = 0; j < 6; j++)
+	// Builds hmi.faces and the elements fs from the hexes vs, using hex_face_table.
+	// Faces are numbered in lexicographic order of their sorted vertices.
+	void build_hex_faces(Mesh3DStorage &hmi)
+	{
+		const int n_elements = hmi.elements.size();
+		std::vector<std::array<uint32_t, 4>> total_fs(n_elements * 6);
+		std::vector<std::tuple<uint32_t, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t>> tempF(n_elements * 6);
+		utils::maybe_parallel_for(n_elements, [&](int start, int end, int thread_id) {
+			std::array<uint32_t, 4> vs;
+			for (int i = start; i < end; ++i)
 			{
-				for (short k = 0; k < 4; k++)
-					vs[k] = hmi.elements[i].vs[hex_face_table[j][k]];
-				uint32_t id = 6 * i + j;
-				total_fs[id] = vs;
-				std::sort(vs.begin(), vs.end());
-				tempF[id] = std::make_tuple(vs[0], vs[1], vs[2], vs[3], id, i, j);
+				for (short j = 0; j < 6; j++)
+				{
+					for (short k = 0; k < 4; k++)
+						vs[k] = hmi.elements[i].vs[MeshProcessing3D::hex_face_table[j][k]];
+					const uint32_t id = 6 * i + j;
+					total_fs[id] = vs;
+					std::sort(vs.begin(), vs.end());
+					tempF[id] = std::make_tuple(vs[0], vs[1], vs[2], vs[3], id, i, j);
+				}
+				hmi.elements[i].fs.resize(6);
 			}
-			hmi.elements[i].fs.resize(6);
-		}
-		std::sort(tempF.begin(), tempF.end());
-		hmi.faces.reserve(tempF.size() / 3);
-		Face f;
-		f.boundary = true;
-		uint32_t F_num = 0;
-		for (uint32_t i = 0; i < tempF.size(); ++i)
-		{
-			if (i == 0 || (i != 0 && (std::get<0>(tempF[i]) != std::get<0>(tempF[i - 1]) || std::get<1>(tempF[i]) != std::get<1>(tempF[i - 1]) || std::get<2>(tempF[i]) != std::get<2>(tempF[i - 1]) || std::get<3>(tempF[i]) != std::get<3>(tempF[i - 1]))))
+		});
+		utils::maybe_parallel_sort(tempF.begin(), tempF.end());
+
+		std::vector<uint32_t> ids;
+		const uint32_t F_num = unique_ids(
+			tempF, [](const auto &a, const auto &b) {
+				return std::get<0>(a) == std::get<0>(b) && std::get<1>(a) == std::get<1>(b) && std::get<2>(a) == std::get<2>(b) && std::get<3>(a) == std::get<3>(b);
+			},
+			ids);
+
+		hmi.faces.clear();
+		hmi.faces.resize(F_num);
+		utils::maybe_parallel_for(tempF.size(), [&](int start, int end, int thread_id) {
+			for (int i = start; i < end; ++i)
 			{
-				f.id = F_num;
-				F_num++;
-				f.vs = total_fs[std::get<4>(tempF[i])];
-				hmi.faces.push_back(f);
+				const uint32_t fid = ids[i];
+				if (i == 0 || ids[i - 1] != fid)
+				{
+					Face &f = hmi.faces[fid];
+					f.id = fid;
+					const auto &vs = total_fs[std::get<4>(tempF[i])];
+					f.vs.assign(vs.begin(), vs.end());
+					f.boundary = i + 1 == int(tempF.size()) || ids[i + 1] != fid;
+				}
+				hmi.elements[std::get<5>(tempF[i])].fs[std::get<6>(tempF[i])] = fid;
 			}
-			else if (i != 0 && (std::get<0>(tempF[i]) == std::get<0>(tempF[i - 1]) && std::get<1>(tempF[i]) == std::get<1>(tempF[i - 1]) && std::get<2>(tempF[i]) == std::get<2>(tempF[i - 1]) && std::get<3>(tempF[i]) == std::get<3>(tempF[i - 1])))
-				hmi.faces[F_num - 1].boundary = false;
-
-			hmi.elements[std::get<5>(tempF[i])].fs[std::get<6>(tempF[i])] = F_num - 1;
-		}
+		});
+	}
+} // namespace
 
-		std::vector<std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>> temp(hmi.faces.size() * 4);
-		for (uint32_t i = 0; i < hmi.faces.size(); ++i)
-		{
-			for (uint32_t j = 0; j < 4; ++j)
-			{
-				uint32_t v0 = hmi.faces[i].vs[j], v1 = hmi.faces[i].vs[(j + 1) % 4];
-				if (v0 > v1)
-					std::swap(v0, v1);
-				temp[4 * i + j] = std::make_tuple(v0, v1, i, j);
-			}
-			hmi.faces[i].es.resize(4);
-		}
-		std::sort(temp.begin(), temp.end());
-		hmi.edges.reserve(temp.size() / 2);
-		uint32_t E_num = 0;
-		Edge e;
-		e.boundary = false;
-		e.vs.resize(2);
-		for (uint32_t i = 0; i < temp.size(); ++i)
-		{
-			if (i == 0 || (i != 0 && (std::get<0>(temp[i]) != std::get<0>(temp[i - 1]) || std::get<1>(temp[i]) != std::get<1>(temp[i - 1]))))
+void MeshProcessing3D::build_connectivity(Mesh3DStorage &hmi)
+{
+	hmi.edges.clear();
+	if (hmi.type == MeshType::TRI || hmi.type == MeshType::QUA || hmi.type == MeshType::H_SUR)
+	{
+		build_edges(hmi, true);
+		// boundary
+		for (auto &v : hmi.vertices)
+			v.boundary = false;
+		for (uint32_t i = 0; i < hmi.edges.size(); ++i)
+			if (hmi.edges[i].boundary)
 			{
-				e.id = E_num;
-				E_num++;
-				e.vs[0] = std::get<0>(temp[i]);
-				e.vs[1] = std::get<1>(temp[i]);
-				hmi.edges.push_back(e);
+				hmi.vertices[hmi.edges[i].vs[0]].boundary = hmi.vertices[hmi.edges[i].vs[1]].boundary = true;
 			}
-			hmi.faces[std::get<2>(temp[i])].es[std::get<3>(temp[i])] = E_num - 1;
-		}
+	}
+	else if (hmi.type == MeshType::HEX)
+	{
+		build_hex_faces(hmi);
+		build_edges(hmi, false);
 		// boundary
 		for (auto &v : hmi.vertices)
 			v.boundary = false;
@@ -148,43 +207,13 @@ void MeshProcessing3D::build_connectivity(Mesh3DStorage &hmi)
 	else if (hmi.type == MeshType::HYB || hmi.type == MeshType::TET)
 	{
 		vector<bool> bf_flag(hmi.faces.size(), false);
-		for (auto h : hmi.elements)
+		for (const auto &h : hmi.elements)
 			for (auto f : h.fs)
 				bf_flag[f] = !bf_flag[f];
 		for (auto &f : hmi.faces)
 			f.boundary = bf_flag[f.id];
 
-		std::vector<std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>> temp;
-		for (uint32_t i = 0; i < hmi.faces.size(); ++i)
-		{
-			int fl = hmi.faces[i].vs.size();
-			for (uint32_t j = 0; j < hmi.faces[i].vs.size(); ++j)
-			{
-				uint32_t v0 = hmi.faces[i].vs[j], v1 = hmi.faces[i].vs[(j + 1) % fl];
-				if (v0 > v1)
-					std::swap(v0, v1);
-				temp.push_back(std::make_tuple(v0, v1, i, j));
-			}
-			hmi.faces[i].es.resize(fl);
-		}
-		std::sort(temp.begin(), temp.end());
-		hmi.edges.reserve(temp.size() / 2);
-		uint32_t E_num = 0;
-		Edge e;
-		e.boundary = false;
-		e.vs.resize(2);
-		for (uint32_t i = 0; i < temp.size(); ++i)
-		{
-			if (i == 0 || (i != 0 && (std::get<0>(temp[i]) != std::get<0>(temp[i - 1]) || std::get<1>(temp[i]) != std::get<1>(temp[i - 1]))))
-			{
-				e.id = E_num;
-				E_num++;
-				e.vs[0] = std::get<0>(temp[i]);
-				e.vs[1] = std::get<1>(temp[i]);
-				hmi.edges.push_back(e);
-			}
-			hmi.faces[std::get<2>(temp[i])].es[std::get<3>(temp[i])] = E_num - 1;
-		}
+		build_edges(hmi, false);
 		// boundary
 		for (auto &v : hmi.vertices)
 			v.boundary = false;
@@ -198,190 +227,184 @@ void MeshProcessing3D::build_connectivity(Mesh3DStorage &hmi)
 				}
 	}
 	// f_nhs;
-	for (auto &f : hmi.faces)
-		f.neighbor_hs.clear();
-	for (uint32_t i = 0; i < hmi.elements.size(); i++)
-	{
-		for (uint32_t j = 0; j < hmi.elements[i].fs.size(); j++)
-		{
-			hmi.faces[hmi.elements[i].fs[j]].neighbor_hs.push_back(i);
-		}
-	}
+	invert_relation(
+		hmi.elements.size(), hmi.faces.size(),
+		[&](int i) -> const auto & { return hmi.elements[i].fs; },
+		[&](int f, const uint32_t *begin, const uint32_t *end) { hmi.faces[f].neighbor_hs.assign(begin, end); });
 	// e_nfs, v_nfs
-	for (auto &e : hmi.edges)
-		e.neighbor_fs.clear();
-	for (auto &v : hmi.vertices)
-		v.neighbor_fs.clear();
-	for (uint32_t i = 0; i < hmi.faces.size(); i++)
-	{
-		for (uint32_t j = 0; j < hmi.faces[i].es.size(); j++)
-			hmi.edges[hmi.faces[i].es[j]].neighbor_fs.push_back(i);
-		for (uint32_t j = 0; j < hmi.faces[i].vs.size(); j++)
-			hmi.vertices[hmi.faces[i].vs[j]].neighbor_fs.push_back(i);
-	}
+	invert_relation(
+		hmi.faces.size(), hmi.edges.size(),
+		[&](int i) -> const auto & { return hmi.faces[i].es; },
+		[&](int e, const uint32_t *begin, const uint32_t *end) { hmi.edges[e].neighbor_fs.assign(begin, end); });
+	invert_relation(
+		hmi.faces.size(), hmi.vertices.size(),
+		[&](int i) -> const auto & { return hmi.faces[i].vs; },
+		[&](int v, const uint32_t *begin, const uint32_t *end) { hmi.vertices[v].neighbor_fs.assign(begin, end); });
 	// v_nes, v_nvs
-	for (auto &v : hmi.vertices)
-	{
-		v.neighbor_es.clear();
-		v.neighbor_vs.clear();
-	}
-	for (uint32_t i = 0; i < hmi.edges.size(); i++)
-	{
-		uint32_t v0 = hmi.edges[i].vs[0], v1 = hmi.edges[i].vs[1];
-		hmi.vertices[v0].neighbor_es.push_back(i);
-		hmi.vertices[v1].neighbor_es.push_back(i);
-		hmi.vertices[v0].neighbor_vs.push_back(v1);
-		hmi.vertices[v1].neighbor_vs.push_back(v0);
-	}
+	invert_relation(
+		hmi.edges.size(), hmi.vertices.size(),
+		[&](int i) -> const auto & { return hmi.edges[i].vs; },
+		[&](int v, const uint32_t *begin, const uint32_t *end) {
+			Vertex &vertex = hmi.vertices[v];
+			vertex.neighbor_es.assign(begin, end);
+			vertex.neighbor_vs.resize(vertex.neighbor_es.size());
+			for (size_t k = 0; k < vertex.neighbor_es.size(); ++k)
+			{
+				const auto &evs = hmi.edges[vertex.neighbor_es[k]].vs;
+				vertex.neighbor_vs[k] = evs[0] == uint32_t(v) ? evs[1] : evs[0];
+			}
+		});
 	// e_nhs
-	for (auto &e : hmi.edges)
-		e.neighbor_hs.clear();
-	for (auto &ele : hmi.elements)
-		ele.es.clear();
-	for (uint32_t i = 0; i < hmi.edges.size(); i++)
-	{
-		std::vector<uint32_t> nhs;
-		for (uint32_t j = 0; j < hmi.edges[i].neighbor_fs.size(); j++)
+	utils::maybe_parallel_for(hmi.edges.size(), [&](int start, int end, int thread_id) {
+		for (int i = start; i < end; i++)
 		{
-			uint32_t nfid = hmi.edges[i].neighbor_fs[j];
-			nhs.insert(nhs.end(), hmi.faces[nfid].neighbor_hs.begin(), hmi.faces[nfid].neighbor_hs.end());
+			std::vector<uint32_t> nhs;
+			for (uint32_t j = 0; j < hmi.edges[i].neighbor_fs.size(); j++)
+			{
+				uint32_t nfid = hmi.edges[i].neighbor_fs[j];
+				nhs.insert(nhs.end(), hmi.faces[nfid].neighbor_hs.begin(), hmi.faces[nfid].neighbor_hs.end());
+			}
+			std::sort(nhs.begin(), nhs.end());
+			nhs.erase(std::unique(nhs.begin(), nhs.end()), nhs.end());
+			hmi.edges[i].neighbor_hs = nhs;
 		}
-		std::sort(nhs.begin(), nhs.end());
-		nhs.erase(std::unique(nhs.begin(), nhs.end()), nhs.end());
-		hmi.edges[i].neighbor_hs = nhs;
-		for (auto nhid : nhs)
-			hmi.elements[nhid].es.push_back(i);
-	}
+	});
+	invert_relation(
+		hmi.edges.size(), hmi.elements.size(),
+		[&](int i) -> const auto & { return hmi.edges[i].neighbor_hs; },
+		[&](int h, const uint32_t *begin, const uint32_t *end) { hmi.elements[h].es.assign(begin, end); });
 	// v_nhs; ordering fs for hex
 	if (hmi.type != MeshType::HYB && hmi.type != MeshType::TET)
 		return;
 
-	for (auto &v : hmi.vertices)
-		v.neighbor_hs.clear();
-	for (uint32_t i = 0; i < hmi.elements.size(); i++)
-	{
-		vector<uint32_t> vs;
-		for (auto fid : hmi.elements[i].fs)
-			vs.insert(vs.end(), hmi.faces[fid].vs.begin(), hmi.faces[fid].vs.end());
-		sort(vs.begin(), vs.end());
-		vs.erase(unique(vs.begin(), vs.end()), vs.end());
-
-		bool degree3 = true;
-		for (auto vid : vs)
+	utils::maybe_parallel_for(hmi.elements.size(), [&](int start, int end, int thread_id) {
+		for (int i = start; i < end; i++)
 		{
-			int nv = 0;
-			for (auto nvid : hmi.vertices[vid].neighbor_vs)
-				if (find(vs.begin(), vs.end(), nvid) != vs.end())
-					nv++;
-			if (nv != 3)
+			vector<uint32_t> vs;
+			for (auto fid : hmi.elements[i].fs)
+				vs.insert(vs.end(), hmi.faces[fid].vs.begin(), hmi.faces[fid].vs.end());
+			sort(vs.begin(), vs.end());
+			vs.erase(unique(vs.begin(), vs.end()), vs.end());
+
+			bool degree3 = true;
+			for (auto vid : vs)
 			{
-				degree3 = false;
-				break;
+				int nv = 0;
+				for (auto nvid : hmi.vertices[vid].neighbor_vs)
+					if (find(vs.begin(), vs.end(), nvid) != vs.end())
+						nv++;
+				if (nv != 3)
+				{
+					degree3 = false;
+					break;
+				}
 			}
-		}
 
-		if (hmi.elements[i].hex && (vs.size() != 8 || !degree3))
-			hmi.elements[i].hex = false;
+			if (hmi.elements[i].hex && (vs.size() != 8 || !degree3))
+				hmi.elements[i].hex = false;
 
-		hmi.elements[i].vs.clear();
+			hmi.elements[i].vs.clear();
 
-		if (hmi.elements[i].hex)
-		{
-			int top_fid = hmi.elements[i].fs[0];
-			hmi.elements[i].vs = hmi.faces[top_fid].vs;
+			if (hmi.elements[i].hex)
+			{
+				int top_fid = hmi.elements[i].fs[0];
+				hmi.elements[i].vs = hmi.faces[top_fid].vs;
 
-			std::set<uint32_t> s_model(vs.begin(), vs.end());
-			std::set<uint32_t> s_pattern(hmi.faces[top_fid].vs.begin(), hmi.faces[top_fid].vs.end());
-			vector<uint32_t> vs_left;
-			std::set_difference(s_model.begin(), s_model.end(), s_pattern.begin(), s_pattern.end(), std::back_inserter(vs_left));
+				std::set<uint32_t> s_model(vs.begin(), vs.end());
+				std::set<uint32_t> s_pattern(hmi.faces[top_fid].vs.begin(), hmi.faces[top_fid].vs.end());
+				vector<uint32_t> vs_left;
+				std::set_difference(s_model.begin(), s_model.end(), s_pattern.begin(), s_pattern.end(), std::back_inserter(vs_left));
 
-			for (auto vid : hmi.faces[top_fid].vs)
-				for (auto nvid : hmi.vertices[vid].neighbor_vs)
-					if (find(vs_left.begin(), vs_left.end(), nvid) != vs_left.end())
-					{
-						hmi.elements[i].vs.push_back(nvid);
-						break;
-					}
+				for (auto vid : hmi.faces[top_fid].vs)
+					for (auto nvid : hmi.vertices[vid].neighbor_vs)
+						if (find(vs_left.begin(), vs_left.end(), nvid) != vs_left.end())
+						{
+							hmi.elements[i].vs.push_back(nvid);
+							break;
+						}
 
-			function<int(vector<uint32_t> &, int &)> WHICH_F = [&](vector<uint32_t> &vs0, int &f_flag) -> int {
-				int which_f = -1;
-				sort(vs0.begin(), vs0.end());
-				bool found_f = false;
-				for (uint32_t j = 0; j < hmi.elements[i].fs.size(); j++)
-				{
-					auto fid = hmi.elements[i].fs[j];
-					vector<uint32_t> vs1 = hmi.faces[fid].vs;
-					sort(vs1.begin(), vs1.end());
-					if (vs0.size() == vs1.size() && std::equal(vs0.begin(), vs0.end(), vs1.begin()))
+				function<int(vector<uint32_t> &, int &)> WHICH_F = [&](vector<uint32_t> &vs0, int &f_flag) -> int {
+					int which_f = -1;
+					sort(vs0.begin(), vs0.end());
+					bool found_f = false;
+					for (uint32_t j = 0; j < hmi.elements[i].fs.size(); j++)
 					{
-						f_flag = hmi.elements[i].fs_flag[j];
-						which_f = fid;
-						break;
+						auto fid = hmi.elements[i].fs[j];
+						vector<uint32_t> vs1 = hmi.faces[fid].vs;
+						sort(vs1.begin(), vs1.end());
+						if (vs0.size() == vs1.size() && std::equal(vs0.begin(), vs0.end(), vs1.begin()))
+						{
+							f_flag = hmi.elements[i].fs_flag[j];
+							which_f = fid;
+							break;
+						}
 					}
-				}
-				return which_f;
-			};
-
-			vector<uint32_t> fs;
-			vector<bool> fs_flag;
-			fs_flag.push_back(hmi.elements[i].fs_flag[0]);
-			fs.push_back(top_fid);
-			vector<uint32_t> vs_temp;
-
-			vs_temp.insert(vs_temp.end(), hmi.elements[i].vs.begin() + 4, hmi.elements[i].vs.end());
-			int f_flag = -1;
-			int bottom_fid = WHICH_F(vs_temp, f_flag);
-			fs_flag.push_back(f_flag);
-			fs.push_back(bottom_fid);
-
-			vs_temp.clear();
-			vs_temp.push_back(hmi.elements[i].vs[0]);
-			vs_temp.push_back(hmi.elements[i].vs[1]);
-			vs_temp.push_back(hmi.elements[i].vs[4]);
-			vs_temp.push_back(hmi.elements[i].vs[5]);
-			f_flag = -1;
-			int front_fid = WHICH_F(vs_temp, f_flag);
-			fs_flag.push_back(f_flag);
-			fs.push_back(front_fid);
-
-			vs_temp.clear();
-			vs_temp.push_back(hmi.elements[i].vs[2]);
-			vs_temp.push_back(hmi.elements[i].vs[3]);
-			vs_temp.push_back(hmi.elements[i].vs[6]);
-			vs_temp.push_back(hmi.elements[i].vs[7]);
-			f_flag = -1;
-			int back_fid = WHICH_F(vs_temp, f_flag);
-			fs_flag.push_back(f_flag);
-			fs.push_back(back_fid);
-
-			vs_temp.clear();
-			vs_temp.push_back(hmi.elements[i].vs[1]);
-			vs_temp.push_back(hmi.elements[i].vs[2]);
-			vs_temp.push_back(hmi.elements[i].vs[5]);
-			vs_temp.push_back(hmi.elements[i].vs[6]);
-			f_flag = -1;
-			int left_fid = WHICH_F(vs_temp, f_flag);
-			fs_flag.push_back(f_flag);
-			fs.push_back(left_fid);
-
-			vs_temp.clear();
-			vs_temp.push_back(hmi.elements[i].vs[3]);
-			vs_temp.push_back(hmi.elements[i].vs[0]);
-			vs_temp.push_back(hmi.elements[i].vs[7]);
-			vs_temp.push_back(hmi.elements[i].vs[4]);
-			f_flag = -1;
-			int right_fid = WHICH_F(vs_temp, f_flag);
-			fs_flag.push_back(f_flag);
-			fs.push_back(right_fid);
-
-			hmi.elements[i].fs = fs;
-			hmi.elements[i].fs_flag = fs_flag;
+					return which_f;
+				};
+
+				vector<uint32_t> fs;
+				vector<bool> fs_flag;
+				fs_flag.push_back(hmi.elements[i].fs_flag[0]);
+				fs.push_back(top_fid);
+				vector<uint32_t> vs_temp;
+
+				vs_temp.insert(vs_temp.end(), hmi.elements[i].vs.begin() + 4, hmi.elements[i].vs.end());
+				int f_flag = -1;
+				int bottom_fid = WHICH_F(vs_temp, f_flag);
+				fs_flag.push_back(f_flag);
+				fs.push_back(bottom_fid);
+
+				vs_temp.clear();
+				vs_temp.push_back(hmi.elements[i].vs[0]);
+				vs_temp.push_back(hmi.elements[i].vs[1]);
+				vs_temp.push_back(hmi.elements[i].vs[4]);
+				vs_temp.push_back(hmi.elements[i].vs[5]);
+				f_flag = -1;
+				int front_fid = WHICH_F(vs_temp, f_flag);
+				fs_flag.push_back(f_flag);
+				fs.push_back(front_fid);
+
+				vs_temp.clear();
+				vs_temp.push_back(hmi.elements[i].vs[2]);
+				vs_temp.push_back(hmi.elements[i].vs[3]);
+				vs_temp.push_back(hmi.elements[i].vs[6]);
+				vs_temp.push_back(hmi.elements[i].vs[7]);
+				f_flag = -1;
+				int back_fid = WHICH_F(vs_temp, f_flag);
+				fs_flag.push_back(f_flag);
+				fs.push_back(back_fid);
+
+				vs_temp.clear();
+				vs_temp.push_back(hmi.elements[i].vs[1]);
+				vs_temp.push_back(hmi.elements[i].vs[2]);
+				vs_temp.push_back(hmi.elements[i].vs[5]);
+				vs_temp.push_back(hmi.elements[i].vs[6]);
+				f_flag = -1;
+				int left_fid = WHICH_F(vs_temp, f_flag);
+				fs_flag.push_back(f_flag);
+				fs.push_back(left_fid);
+
+				vs_temp.clear();
+				vs_temp.push_back(hmi.elements[i].vs[3]);
+				vs_temp.push_back(hmi.elements[i].vs[0]);
+				vs_temp.push_back(hmi.elements[i].vs[7]);
+				vs_temp.push_back(hmi.elements[i].vs[4]);
+				f_flag = -1;
+				int right_fid = WHICH_F(vs_temp, f_flag);
+				fs_flag.push_back(f_flag);
+				fs.push_back(right_fid);
+
+				hmi.elements[i].fs = fs;
+				hmi.elements[i].fs_flag = fs_flag;
+			}
+			else
+				hmi.elements[i].vs = vs;
 		}
-		else
-			hmi.elements[i].vs = vs;
-		for (uint32_t j = 0; j < hmi.elements[i].vs.size(); j++)
-			hmi.vertices[hmi.elements[i].vs[j]].neighbor_hs.push_back(i);
-	}
+	});
+	invert_relation(
+		hmi.elements.size(), hmi.vertices.size(),
+		[&](int i) -> const auto & { return hmi.elements[i].vs; },
+		[&](int v, const uint32_t *begin, const uint32_t *end) { hmi.vertices[v].neighbor_hs.assign(begin, end); });
 	// matrix representation of tet mesh
 	if (hmi.type == MeshType::TET)
 	{
@@ -395,50 +418,56 @@ void MeshProcessing3D::build_connectivity(Mesh3DStorage &hmi)
 		hmi.FE.resize(3, hmi.faces.size());
 		hmi.FH.resize(2, hmi.faces.size());
 		hmi.FHi.resize(2, hmi.faces.size());
-		for (const auto &f : hmi.faces)
-		{
-			hmi.FV(0, f.id) = f.vs[0];
-			hmi.FV(1, f.id) = f.vs[1];
-			hmi.FV(2, f.id) = f.vs[2];
-
-			hmi.FE(0, f.id) = f.es[0];
-			hmi.FE(1, f.id) = f.es[1];
-			hmi.FE(2, f.id) = f.es[2];
-
-			hmi.FH(0, f.id) = f.neighbor_hs[0];
-			for (int i = 0; i < hmi.elements[f.neighbor_hs[0]].fs.size(); i++)
-				if (f.id == hmi.elements[f.neighbor_hs[0]].fs[i])
-					hmi.FHi(0, f.id) = i;
-
-			hmi.FH(1, f.id) = -1;
-			hmi.FHi(1, f.id) = -1;
-			if (f.neighbor_hs.size() == 2)
+		utils::maybe_parallel_for(hmi.faces.size(), [&](int start, int end, int thread_id) {
+			for (int fi = start; fi < end; ++fi)
 			{
-				hmi.FH(1, f.id) = f.neighbor_hs[1];
-				for (int i = 0; i < hmi.elements[f.neighbor_hs[1]].fs.size(); i++)
-					if (f.id == hmi.elements[f.neighbor_hs[1]].fs[i])
-						hmi.FHi(1, f.id) = i;
+				const auto &f = hmi.faces[fi];
+				hmi.FV(0, f.id) = f.vs[0];
+				hmi.FV(1, f.id) = f.vs[1];
+				hmi.FV(2, f.id) = f.vs[2];
+
+				hmi.FE(0, f.id) = f.es[0];
+				hmi.FE(1, f.id) = f.es[1];
+				hmi.FE(2, f.id) = f.es[2];
+
+				hmi.FH(0, f.id) = f.neighbor_hs[0];
+				for (int i = 0; i < hmi.elements[f.neighbor_hs[0]].fs.size(); i++)
+					if (f.id == hmi.elements[f.neighbor_hs[0]].fs[i])
+						hmi.FHi(0, f.id) = i;
+
+				hmi.FH(1, f.id) = -1;
+				hmi.FHi(1, f.id) = -1;
+				if (f.neighbor_hs.size() == 2)
+				{
+					hmi.FH(1, f.id) = f.neighbor_hs[1];
+					for (int i = 0; i < hmi.elements[f.neighbor_hs[1]].fs.size(); i++)
+						if (f.id == hmi.elements[f.neighbor_hs[1]].fs[i])
+							hmi.FHi(1, f.id) = i;
+				}
 			}
-		}
+		});
 		hmi.HV.resize(4, hmi.elements.size());
 		hmi.HF.resize(4, hmi.elements.size());
-		for (const auto &h : hmi.elements)
-		{
-			hmi.HV(0, h.id) = h.vs[0];
-			hmi.HV(1, h.id) = h.vs[1];
-			hmi.HV(2, h.id) = h.vs[2];
-			hmi.HV(3, h.id) = h.vs[3];
-
-			hmi.HF(0, h.id) = h.fs[0];
-			hmi.HF(1, h.id) = h.fs[1];
-			hmi.HF(2, h.id) = h.fs[2];
-			hmi.HF(3, h.id) = h.fs[3];
-		}
+		utils::maybe_parallel_for(hmi.elements.size(), [&](int start, int end, int thread_id) {
+			for (int hi = start; hi < end; ++hi)
+			{
+				const auto &h = hmi.elements[hi];
+				hmi.HV(0, h.id) = h.vs[0];
+				hmi.HV(1, h.id) = h.vs[1];
+				hmi.HV(2, h.id) = h.vs[2];
+				hmi.HV(3, h.id) = h.vs[3];
+
+				hmi.HF(0, h.id) = h.fs[0];
+				hmi.HF(1, h.id) = h.fs[1];
+				hmi.HF(2, h.id) = h.fs[2];
+				hmi.HF(3, h.id) = h.fs[3];
+			}
+		});
 	}
 
 	// boundary flags for hybrid mesh
 	std::vector<bool> bv_flag(hmi.vertices.size(), false), be_flag(hmi.edges.size(), false), bf_flag(hmi.faces.size(), false);
-	for (auto f : hmi.faces)
+	for (const auto &f : hmi.faces)
 		if (f.boundary && hmi.elements[f.neighbor_hs[0]].hex)
 			bf_flag[f.id] = true;
 		else if (!f.boundary)
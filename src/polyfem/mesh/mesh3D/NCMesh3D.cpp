@@ -3,11 +3,13 @@
 #include <polyfem/utils/StringUtils.hpp>
 
 #include <polyfem/utils/Logger.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
 
 #include <igl/writeMESH.h>
 
 #include <geogram/mesh/mesh_io.h>
 #include <fstream>
+#include <limits>
 
 using namespace polyfem::utils;
 
@@ -265,20 +267,22 @@ namespace polyfem
 			boundary_ids_.resize(n_faces());
 			std::fill(boundary_ids_.begin(), boundary_ids_.end(), -1);
 
-			for (int f = 0; f < n_faces(); ++f)
-			{
-				const bool is_boundary = is_boundary_face(f);
-				std::vector<int> vs(n_face_vertices(f));
-				const auto p = face_barycenter(f);
+			utils::maybe_parallel_for(n_faces(), [&](int start, int end, int thread_id) {
+				for (int f = start; f < end; ++f)
+				{
+					const bool is_boundary = is_boundary_face(f);
+					std::vector<int> vs(n_face_vertices(f));
+					const auto p = face_barycenter(f);
 
-				for (int vid = 0; vid < vs.size(); ++vid)
-					vs[vid] = face_vertex(f, vid);
+					for (int vid = 0; vid < vs.size(); ++vid)
+						vs[vid] = face_vertex(f, vid);
 
-				std::sort(vs.begin(), vs.end());
-				boundary_ids_[f] = marker(f, vs, p, is_boundary);
+					std::sort(vs.begin(), vs.end());
+					boundary_ids_[f] = marker(f, vs, p, is_boundary);
 
-				faces[valid_to_all_face(f)].boundary_id = boundary_ids_[f];
-			}
+					faces[valid_to_all_face(f)].boundary_id = boundary_ids_[f];
+				}
+			});
 		}
 
 		void NCMesh3D::compute_body_ids(const std::function<int(const size_t, const RowVectorNd &)> &marker)
@@ -286,12 +290,14 @@ namespace polyfem
 			body_ids_.resize(n_cells());
 			std::fill(body_ids_.begin(), body_ids_.end(), -1);
 
-			for (int e = 0; e < n_cells(); ++e)
-			{
-				const auto bary = cell_barycenter(e);
-				body_ids_[e] = marker(e, bary);
-				elements[valid_to_all_elem(e)].body_id = body_ids_[e];
-			}
+			utils::maybe_parallel_for(n_cells(), [&](int start, int end, int thread_id) {
+				for (int e = start; e < end; ++e)
+				{
+					const auto bary = cell_barycenter(e);
+					body_ids_[e] = marker(e, bary);
+					elements[valid_to_all_elem(e)].body_id = body_ids_[e];
+				}
+			});
 		}
 		void NCMesh3D::set_boundary_ids(const std::vector<int> &boundary_ids)
 		{
@@ -793,6 +799,75 @@ namespace polyfem
 			refineHistory.push_back(parent_id);
 		}
 
+		void NCMesh3D::coarsen_elements(const std::vector<int> &ids)
+		{
+			std::vector<int> parents;
+			for (const int id : ids)
+			{
+				const int parent = elements[valid_to_all_elem(id)].parent;
+				if (parent < 0)
+					log_and_throw_error("Cannot coarsen element {}, it has no parent!", id);
+				parents.push_back(parent);
+			}
+			std::sort(parents.begin(), parents.end());
+			parents.erase(std::unique(parents.begin(), parents.end()), parents.end());
+
+			for (const int parent : parents)
+				coarsen_element(elements[parent].children(0));
+		}
+
+		std::vector<int> NCMesh3D::previous_elements(const std::vector<int> &prev_all_to_valid) const
+		{
+			std::vector<int> res(n_cells());
+			for (int e = 0; e < res.size(); e++)
+			{
+				const int id = valid_to_all_elem(e);
+				res[e] = id < prev_all_to_valid.size() ? prev_all_to_valid[id] : -1;
+			}
+			return res;
+		}
+
+		int NCMesh3D::find_previous_element(const std::vector<int> &prev_all_to_valid, const int e, const RowVectorNd &p) const
+		{
+			const auto previous = [&](const int id) { return id < prev_all_to_valid.size() ? prev_all_to_valid[id] : -1; };
+
+			// the element itself or a refined ancestor
+			for (int id = valid_to_all_elem(e); id >= 0; id = elements[id].parent)
+			{
+				if (previous(id) >= 0)
+					return previous(id);
+			}
+
+			// the element was coarsened, descend to the child containing p
+			const Eigen::Vector3d q = p.transpose();
+			int id = valid_to_all_elem(e);
+			while (elements[id].children(0) >= 0)
+			{
+				int best = -1;
+				double best_coord = -std::numeric_limits<double>::max();
+				for (int c = 0; c < elements[id].children.size(); c++)
+				{
+					const Eigen::VectorXi &v = elements[elements[id].children(c)].vertices;
+					Eigen::Matrix3d A;
+					for (int d = 0; d < 3; d++)
+						A.col(d) = vertices[v(d + 1)].pos - vertices[v(0)].pos;
+					const Eigen::Vector3d coords = A.partialPivLu().solve(q - vertices[v(0)].pos);
+					const double min_coord = std::min(1 - coords.sum(), coords.minCoeff());
+					if (min_coord > best_coord)
+					{
+						best_coord = min_coord;
+						best = elements[id].children(c);
+					}
+				}
+
+				id = best;
+				if (previous(id) >= 0)
+					return previous(id);
+			}
+
+			return -1;
+		}
+
 		void NCMesh3D::mark_boundary()
 		{
 			for (auto &face : faces)
@@ -968,11 +1043,8 @@ namespace polyfem
 		int NCMesh3D::find_vertex(Eigen::Vector2i v) const
 		{
 			std::sort(v.data(), v.data() + v.size());
-			auto search = midpointMap.find(v);
-			if (search != midpointMap.end())
-				return search->second;
-			else
-				return -1;
+			const int *search = midpointMap.find({{v[0], v[1]}});
+			return search == nullptr ? -1 : *search;
 		}
 		int NCMesh3D::get_vertex(Eigen::Vector2i v)
 		{
@@ -983,18 +1055,15 @@ namespace polyfem
 				Eigen::VectorXd v_mid = (vertices[v[0]].pos + vertices[v[1]].pos) / 2.;
 				id = vertices.size();
 				vertices.emplace_back(v_mid);
-				midpointMap.emplace(v, id);
+				midpointMap.emplace({{v[0], v[1]}}, id);
 			}
 			return id;
 		}
 		int NCMesh3D::find_edge(Eigen::Vector2i v) const
 		{
 			std::sort(v.data(), v.data() + v.size());
-			auto search = edgeMap.find(v);
-			if (search != edgeMap.end())
-				return search->second;
-			else
-				return -1;
+			const int *search = edgeMap.find({{v[0], v[1]}});
+			return search == nullptr ? -1 : *search;
 		}
 		int NCMesh3D::get_edge(Eigen::Vector2i v)
 		{
@@ -1004,18 +1073,15 @@ namespace polyfem
 			{
 				edges.emplace_back(v);
 				id = edges.size() - 1;
-				edgeMap.emplace(v, id);
+				edgeMap.emplace({{v[0], v[1]}}, id);
 			}
 			return id;
 		}
 		int NCMesh3D::find_face(Eigen::Vector3i v) const
 		{
 			std::sort(v.data(), v.data() + v.size());
-			auto search = faceMap.find(v);
-			if (search != faceMap.end())
-				return search->second;
-			else
-				return -1;
+			const int *search = faceMap.find({{v[0], v[1], v[2]}});
+			return search == nullptr ? -1 : *search;
 		}
 		int NCMesh3D::get_face(Eigen::Vector3i v)
 		{
@@ -1025,7 +1091,7 @@ namespace polyfem
 			{
 				faces.emplace_back(v);
 				id = faces.size() - 1;
-				faceMap.emplace(v, id);
+				faceMap.emplace({{v[0], v[1], v[2]}}, id);
 			}
 			return id;
 		}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <polyfem/mesh/mesh3D/Mesh3D.hpp>
+#include <polyfem/utils/FlatHashMap.hpp>
 #include <set>
 #include <tuple>
 
@@ -337,6 +338,24 @@ namespace polyfem
 			void refine_elements(const std::vector<int> &ids);
 
 			void coarsen_element(int id_full);
+			/// @brief Coarsens the parents of the elements (in the current numbering), the siblings of each element must all be valid
+			void coarsen_elements(const std::vector<int> &ids);
+
+			/// @brief Map from the full ids of the elements to the current numbering (-1 if not valid).
+			/// Full ids never change, a copy taken before refine/coarsen identifies the previous elements.
+			const std::vector<int> &all_to_valid_elements() const { return all_to_valid_elemMap; }
+
+			/// @brief For each current element, its index in the previous numbering if it was not changed since, -1 otherwise
+			/// @param[in] prev_all_to_valid all_to_valid_elements() before the changes
+			std::vector<int> previous_elements(const std::vector<int> &prev_all_to_valid) const;
+
+			/// @brief Previous element containing the point p of the current element e, that is the element itself,
+			/// its ancestor (refinement) or the descendant containing p (coarsening)
+			/// @param[in] prev_all_to_valid all_to_valid_elements() before the changes
+			/// @param[in] e current element
+			/// @param[in] p point in the element e
+			/// @return element in the previous numbering, -1 if not found
+			int find_previous_element(const std::vector<int> &prev_all_to_valid, const int e, const RowVectorNd &p) const;
 
 			void mark_boundary();
 
@@ -357,23 +376,6 @@ namespace polyfem
 
 			void append(const Mesh &mesh) override;
 
-		private:
-			struct ArrayHasher2D
-			{
-				long operator()(const Eigen::Vector2i &a) const
-				{
-					return (long)((long)984120265 * a[0] + (long)125965121 * a[1]);
-				}
-			};
-
-			struct ArrayHasher3D
-			{
-				long operator()(const Eigen::Vector3i &a) const
-				{
-					return (long)((long)984120265 * a[0] + (long)125965121 * a[1] + (long)495698413 * a[2]);
-				}
-			};
-
 		protected:
 			bool load(const std::string &path) override;
 			bool load(const GEO::Mesh &M) override;
@@ -468,9 +470,9 @@ namespace polyfem
 			std::vector<ncBoundary> edges;
 			std::vector<ncBoundary> faces;
 
-			std::unordered_map<Eigen::Vector2i, int, ArrayHasher2D> midpointMap;
-			std::unordered_map<Eigen::Vector2i, int, ArrayHasher2D> edgeMap;
-			std::unordered_map<Eigen::Vector3i, int, ArrayHasher3D> faceMap;
+			utils::FlatHashMap<2, int> midpointMap;
+			utils::FlatHashMap<2, int> edgeMap;
+			utils::FlatHashMap<3, int> faceMap;
 
 			std::vector<int> all_to_valid_elemMap, valid_to_all_elemMap;
 			std::vector<int> all_to_valid_vertexMap, valid_to_all_vertexMap;
@@ -1,9 +1,13 @@
 #include "Navigation3D.hpp"
 #include "MeshProcessing3D.hpp"
 
+#include <polyfem/utils/MaybeParallelFor.hpp>
+
 // #include <igl/Timer.h>
 #include <algorithm>
+#include <array>
 #include <iterator>
+#include <numeric>
 #include <set>
 #include <cassert>
 
@@ -17,12 +21,27 @@ using namespace std;
 // double polyfem::mesh::Navigation3D::switch_face_time;
 // double polyfem::mesh::Navigation3D::switch_element_time;
 
+namespace
+{
+	// first num entries of [a_begin, a_end) also in [b_begin, b_end)
+	void shared_entries(const uint32_t *a_begin, const uint32_t *a_end, const uint32_t *b_begin, const uint32_t *b_end, std::array<uint32_t, 2> &shared, const int num)
+	{
+		int n = 0;
+		for (const uint32_t *a = a_begin; a != a_end && n < num; ++a)
+		{
+			if (std::find(b_begin, b_end, *a) != b_end)
+				shared[n++] = *a;
+		}
+	}
+} // namespace
+
 void polyfem::mesh::Navigation3D::prepare_mesh(Mesh3DStorage &M)
 {
 	if (M.type != MeshType::TET)
 		M.type = MeshType::HYB;
 	MeshProcessing3D::build_connectivity(M);
 	MeshProcessing3D::global_orientation_hexes(M);
+	M.compress();
 }
 
 polyfem::mesh::Navigation3D::Index polyfem::mesh::Navigation3D::get_index_from_element_face(const Mesh3DStorage &M, int hi)
@@ -39,7 +58,7 @@ polyfem::mesh::Navigation3D::Index polyfem::mesh::Navigation3D::get_index_from_e
 		idx.vertex = M.FV(0, idx.face);
 		idx.edge = M.FE(0, idx.face);
 
-		if (M.elements[hi].fs_flag[idx.element_patch])
+		if (M.element_fs_flag[M.element_fs.offsets[hi] + idx.element_patch])
 			idx.edge = M.FE(2, idx.face);
 		// get_index_from_element_face_time += timer.getElapsedTime();
 	}
@@ -53,29 +72,29 @@ polyfem::mesh::Navigation3D::Index polyfem::mesh::Navigation3D::get_index_from_e
 		// idx.face_corner = 0;
 		// idx.edge = M.faces[idx.face].es[0];
 
-		vector<uint32_t> fvs, fvs_;
-		fvs.insert(fvs.end(), M.elements[hi].vs.begin(), M.elements[hi].vs.begin() + 4);
+		std::array<uint32_t, 4> fvs, fvs_;
+		std::copy(M.element_vs.begin(hi), M.element_vs.begin(hi) + 4, fvs.begin());
 		sort(fvs.begin(), fvs.end());
 		idx.element_patch = -1;
 
 		for (uint32_t i = 0; i < 6; i++)
 		{
 			idx.element_patch = i;
-			fvs_ = M.faces[M.elements[hi].fs[i]].vs;
+			const int fid = M.element_fs(hi, i);
+			assert(M.face_vs.size(fid) == 4);
+			std::copy(M.face_vs.begin(fid), M.face_vs.end(fid), fvs_.begin());
 			sort(fvs_.begin(), fvs_.end());
-			if (std::equal(fvs.begin(), fvs.end(), fvs_.begin()))
+			if (fvs == fvs_)
 				break;
 		}
-		idx.face = M.elements[hi].fs[idx.element_patch];
+		idx.face = M.element_fs(hi, idx.element_patch);
 
-		idx.vertex = M.elements[hi].vs[0];
-		idx.face_corner = find(M.faces[idx.face].vs.begin(), M.faces[idx.face].vs.end(), idx.vertex) - M.faces[idx.face].vs.begin();
+		idx.vertex = M.element_vs(hi, 0);
+		idx.face_corner = find(M.face_vs.begin(idx.face), M.face_vs.end(idx.face), idx.vertex) - M.face_vs.begin(idx.face);
 
-		int v0 = idx.vertex, v1 = M.elements[hi].vs[1];
-		const vector<uint32_t> &ves0 = M.vertices[v0].neighbor_es, &ves1 = M.vertices[v1].neighbor_es;
+		int v0 = idx.vertex, v1 = M.element_vs(hi, 1);
 		std::array<uint32_t, 2> sharedes;
-		int num = 1;
-		MeshProcessing3D::set_intersection_own(ves0, ves1, sharedes, num);
+		shared_entries(M.vertex_es.begin(v0), M.vertex_es.end(v0), M.vertex_es.begin(v1), M.vertex_es.end(v1), sharedes, 1);
 		idx.edge = sharedes[0];
 		// get_index_from_element_face_time += timer.getElapsedTime();
 	}
@@ -96,20 +115,21 @@ polyfem::mesh::Navigation3D::Index polyfem::mesh::Navigation3D::get_index_from_e
 		hi = hi % M.elements.size();
 	idx.element = hi;
 
-	if (lf >= M.elements[hi].fs.size())
-		lf = lf % M.elements[hi].fs.size();
+	if (lf >= M.element_fs.size(hi))
+		lf = lf % M.element_fs.size(hi);
 	idx.element_patch = lf;
-	idx.face = M.elements[hi].fs[idx.element_patch];
+	idx.face = M.element_fs(hi, idx.element_patch);
 
-	if (lv >= M.faces[idx.face].vs.size())
-		lv = lv % M.faces[idx.face].vs.size();
+	const int n_face_vertices = M.face_vs.size(idx.face);
+	if (lv >= n_face_vertices)
+		lv = lv % n_face_vertices;
 	idx.face_corner = lv;
-	idx.vertex = M.faces[idx.face].vs[idx.face_corner];
+	idx.vertex = M.face_vs(idx.face, idx.face_corner);
 
 	int ei = idx.face_corner;
-	if (M.elements[hi].fs_flag[idx.element_patch])
-		ei = (idx.face_corner + M.faces[idx.face].vs.size() - 1) % M.faces[idx.face].vs.size();
-	idx.edge = M.faces[idx.face].es[ei];
+	if (M.element_fs_flag[M.element_fs.offsets[hi] + idx.element_patch])
+		ei = (idx.face_corner + n_face_vertices - 1) % n_face_vertices;
+	idx.edge = M.face_es(idx.face, ei);
 	// timer.stop();
 	//  get_index_from_element_face_time += timer.getElapsedTime();
 
@@ -158,20 +178,20 @@ polyfem::mesh::Navigation3D::Index polyfem::mesh::Navigation3D::get_index_from_e
 	}
 	else
 	{
-		for (int i = 0; i < M.elements[hi].fs.size(); i++)
+		for (int i = 0; i < M.element_fs.size(hi); i++)
 		{
-			const auto &fid = M.elements[hi].fs[i];
-			for (int j = 0; j < M.faces[fid].es.size(); j++)
+			const int fid = M.element_fs(hi, i);
+			for (int j = 0; j < M.face_es.size(fid); j++)
 			{
-				const auto &eid = M.faces[fid].es[j];
-				assert(M.edges[eid].vs[0] < M.edges[eid].vs[1]);
-				if (M.edges[eid].vs[0] == v0 && M.edges[eid].vs[1] == v1)
+				const int eid = M.face_es(fid, j);
+				assert(M.edge_vs(eid, 0) < M.edge_vs(eid, 1));
+				if (M.edge_vs(eid, 0) == v0 && M.edge_vs(eid, 1) == v1)
 				{
 					idx.element_patch = i;
 					idx.face = fid;
 					idx.edge = eid;
-					for (int k = 0; k < M.faces[fid].vs.size(); k++)
-						if (M.faces[fid].vs[k] == idx.vertex)
+					for (int k = 0; k < M.face_vs.size(fid); k++)
+						if (M.face_vs(fid, k) == idx.vertex)
 							idx.face_corner = k;
 
 					assert(idx.vertex == v0i);
@@ -259,11 +279,11 @@ polyfem::mesh::Navigation3D::Index polyfem::mesh::Navigation3D::get_index_from_e
 	}
 	else
 	{
-		assert(M.elements[idx.element].fs.size() == 4);
+		assert(M.element_fs.size(idx.element) == 4);
 		for (int i = 0; i < 4; i++)
 		{
-			const auto fid = M.elements[idx.element].fs[i];
-			const auto &fvid = M.faces[fid].vs;
+			const int fid = M.element_fs(idx.element, i);
+			const uint32_t *fvid = M.face_vs.begin(fid);
 			int fv0 = fvid[0], fv1 = fvid[1], fv2 = fvid[2];
 			if (fv0 > fv2)
 				swap(fv0, fv2);
@@ -284,8 +304,8 @@ polyfem::mesh::Navigation3D::Index polyfem::mesh::Navigation3D::get_index_from_e
 
 			for (int j = 0; j < 3; j++)
 			{
-				const auto eid = M.faces[fid].es[j];
-				const auto &veid = M.edges[eid].vs;
+				const int eid = M.face_es(fid, j);
+				const uint32_t *veid = M.edge_vs.begin(eid);
 				assert(veid[0] < veid[1]);
 				if (veid[0] == v0_ && veid[1] == v1_)
 				{
@@ -329,15 +349,15 @@ polyfem::mesh::Navigation3D::Index polyfem::mesh::Navigation3D::switch_vertex(co
 	}
 	else
 	{
-		if (idx.vertex == M.edges[idx.edge].vs[0])
-			idx.vertex = M.edges[idx.edge].vs[1];
+		if (idx.vertex == M.edge_vs(idx.edge, 0))
+			idx.vertex = M.edge_vs(idx.edge, 1);
 		else
-			idx.vertex = M.edges[idx.edge].vs[0];
+			idx.vertex = M.edge_vs(idx.edge, 0);
 
-		int &corner = idx.face_corner, n = M.faces[idx.face].vs.size(), corner_1 = (corner - 1 + n) % n, corner1 = (corner + 1) % n;
-		if (M.faces[idx.face].vs[corner1] == idx.vertex)
+		int &corner = idx.face_corner, n = M.face_vs.size(idx.face), corner_1 = (corner - 1 + n) % n, corner1 = (corner + 1) % n;
+		if (M.face_vs(idx.face, corner1) == idx.vertex)
 			idx.face_corner = corner1;
-		else if (M.faces[idx.face].vs[corner_1] == idx.vertex)
+		else if (M.face_vs(idx.face, corner_1) == idx.vertex)
 			idx.face_corner = corner_1;
 	}
 	// switch_vertex_time += timer.getElapsedTime();
@@ -357,11 +377,11 @@ polyfem::mesh::Navigation3D::Index polyfem::mesh::Navigation3D::switch_edge(cons
 	}
 	else
 	{
-		int n = M.faces[idx.face].vs.size();
-		if (idx.edge == M.faces[idx.face].es[idx.face_corner])
-			idx.edge = M.faces[idx.face].es[(idx.face_corner - 1 + n) % n];
+		int n = M.face_vs.size(idx.face);
+		if (idx.edge == M.face_es(idx.face, idx.face_corner))
+			idx.edge = M.face_es(idx.face, (idx.face_corner - 1 + n) % n);
 		else
-			idx.edge = M.faces[idx.face].es[idx.face_corner];
+			idx.edge = M.face_es(idx.face, idx.face_corner);
 	}
 	// switch_edge_time += timer.getElapsedTime();
 	return idx;
@@ -393,28 +413,20 @@ polyfem::mesh::Navigation3D::Index polyfem::mesh::Navigation3D::switch_face(cons
 	}
 	else
 	{
-		const vector<uint32_t> &efs = M.edges[idx.edge].neighbor_fs, &hfs = M.elements[idx.element].fs;
 		std::array<uint32_t, 2> sharedfs;
-		int num = 2;
-		MeshProcessing3D::set_intersection_own(efs, hfs, sharedfs, num);
+		shared_entries(M.edge_fs.begin(idx.edge), M.edge_fs.end(idx.edge), M.element_fs.begin(idx.element), M.element_fs.end(idx.element), sharedfs, 2);
 		if (sharedfs[0] == idx.face)
 			idx.face = sharedfs[1];
 		else
 			idx.face = sharedfs[0];
-		for (int i = 0; i < hfs.size(); i++)
-			if (idx.face == hfs[i])
-			{
-				idx.element_patch = i;
-				break;
-			}
 
-		const vector<uint32_t> &fvs = M.faces[idx.face].vs;
-		for (int i = 0; i < fvs.size(); i++)
-			if (idx.vertex == fvs[i])
-			{
-				idx.face_corner = i;
-				break;
-			}
+		const int patch = M.element_fs.find(idx.element, idx.face);
+		if (patch >= 0)
+			idx.element_patch = patch;
+
+		const int corner = M.face_vs.find(idx.face, idx.vertex);
+		if (corner >= 0)
+			idx.face_corner = corner;
 	}
 
 	// switch_face_time += timer.getElapsedTime();
@@ -446,25 +458,21 @@ polyfem::mesh::Navigation3D::Index polyfem::mesh::Navigation3D::switch_element(c
 	}
 	else
 	{
-		if (M.faces[idx.face].neighbor_hs.size() == 1)
+		if (M.face_hs.size(idx.face) == 1)
 		{
 			idx.element = -1;
 			return idx;
 		}
 		else
 		{
-			if (M.faces[idx.face].neighbor_hs[0] == idx.element)
-				idx.element = M.faces[idx.face].neighbor_hs[1];
+			if (M.face_hs(idx.face, 0) == idx.element)
+				idx.element = M.face_hs(idx.face, 1);
 			else
-				idx.element = M.faces[idx.face].neighbor_hs[0];
+				idx.element = M.face_hs(idx.face, 0);
 
-			const vector<uint32_t> &fs = M.elements[idx.element].fs;
-			for (int i = 0; i < fs.size(); i++)
-				if (idx.face == fs[i])
-				{
-					idx.element_patch = i;
-					break;
-				}
+			const int patch = M.element_fs.find(idx.element, idx.face);
+			if (patch >= 0)
+				idx.element_patch = patch;
 		}
 		// const vector<uint32_t> &fvs = M.faces[idx.face].vs;
 		// for(int i=0;i<fvs.size();i++) if(idx.vertex == fvs[i]){idx.face_corner=i; break;}
@@ -473,3 +481,121 @@ polyfem::mesh::Navigation3D::Index polyfem::mesh::Navigation3D::switch_element(c
 	// switch_element_time += timer.getElapsedTime();
 	return idx;
 }
+
+void polyfem::mesh::Navigation3D::NavigationTable::build(const Mesh3DStorage &M)
+{
+	clear();
+	if (M.type == MeshType::TET)
+		return;
+
+	const int n_elements = M.element_fs.offsets.size() - 1;
+	const int n_half_faces = M.element_fs.indices.size();
+	const int n_faces = M.face_vs.offsets.size() - 1;
+
+	half_face_offsets_.assign(n_half_faces + 1, 0);
+	polyfem::utils::maybe_parallel_for(n_half_faces, [&](int start, int end, int thread_id) {
+		for (int h = start; h < end; ++h)
+			half_face_offsets_[h + 1] = M.face_vs.size(M.element_fs.indices[h]);
+	});
+	std::partial_sum(half_face_offsets_.begin(), half_face_offsets_.end(), half_face_offsets_.begin());
+
+	adjacent_patch_.resize(half_face_offsets_.back());
+	adjacent_corners_.resize(half_face_offsets_.back());
+	polyfem::utils::maybe_parallel_for(n_elements, [&](int start, int end, int thread_id) {
+		std::array<uint32_t, 2> sharedfs;
+		for (int e = start; e < end; ++e)
+		{
+			for (int lf = 0; lf < M.element_fs.size(e); ++lf)
+			{
+				const int h = M.element_fs.offsets[e] + lf;
+				const int f = M.element_fs(e, lf);
+				for (int k = 0; k < M.face_es.size(f); ++k)
+				{
+					const int slot = half_face_offsets_[h] + k;
+					const int edge = M.face_es(f, k);
+
+					// same choice as switch_face
+					int n_shared = 0;
+					for (const uint32_t *it = M.edge_fs.begin(edge); it != M.edge_fs.end(edge) && n_shared < 2; ++it)
+					{
+						if (M.element_fs.find(e, *it) >= 0)
+							sharedfs[n_shared++] = *it;
+					}
+					if (n_shared < 2)
+					{
+						adjacent_patch_[slot] = -1;
+						adjacent_corners_[slot] = {{-1, -1}};
+						continue;
+					}
+
+					const int f2 = sharedfs[0] == (uint32_t)f ? sharedfs[1] : sharedfs[0];
+					adjacent_patch_[slot] = M.element_fs.find(e, f2);
+					adjacent_corners_[slot] = {{M.face_vs.find(f2, M.edge_vs(edge, 0)), M.face_vs.find(f2, M.edge_vs(edge, 1))}};
+				}
+			}
+		}
+	});
+
+	face_patches_.resize(n_faces);
+	polyfem::utils::maybe_parallel_for(n_faces, [&](int start, int end, int thread_id) {
+		for (int f = start; f < end; ++f)
+		{
+			face_patches_[f] = {{-1, -1}};
+			for (int i = 0; i < std::min(M.face_hs.size(f), 2); ++i)
+				face_patches_[f][i] = M.element_fs.find(M.face_hs(f, i), f);
+		}
+	});
+}
+
+void polyfem::mesh::Navigation3D::NavigationTable::clear()
+{
+	half_face_offsets_.clear();
+	adjacent_patch_.clear();
+	adjacent_corners_.clear();
+	face_patches_.clear();
+}
+
+polyfem::mesh::Navigation3D::Index polyfem::mesh::Navigation3D::NavigationTable::switch_face(const Mesh3DStorage &M, Index idx) const
+{
+	if (idx.element_patch < 0 || idx.element_patch >= M.element_fs.size(idx.element) || M.element_fs(idx.element, idx.element_patch) != (uint32_t)idx.face)
+		return Navigation3D::switch_face(M, idx);
+
+	// local edge of the face, the edges at a corner are face_es(f, c) and face_es(f, c - 1)
+	const int n = M.face_es.size(idx.face);
+	int k = idx.face_corner;
+	if (M.face_es(idx.face, k) != (uint32_t)idx.edge)
+		k = (k - 1 + n) % n;
+	const int side = idx.vertex == (int)M.edge_vs(idx.edge, 0) ? 0 : 1;
+	if (M.face_es(idx.face, k) != (uint32_t)idx.edge || idx.vertex != (int)M.edge_vs(idx.edge, side))
+		return Navigation3D::switch_face(M, idx);
+
+	const int slot = half_face_offsets_[M.element_fs.offsets[idx.element] + idx.element_patch] + k;
+	const int patch = adjacent_patch_[slot];
+	if (patch < 0)
+		return Navigation3D::switch_face(M, idx);
+
+	idx.element_patch = patch;
+	idx.face = M.element_fs(idx.element, patch);
+	const int corner = adjacent_corners_[slot][side];
+	if (corner >= 0)
+		idx.face_corner = corner;
+
+	return idx;
+}
+
+polyfem::mesh::Navigation3D::Index polyfem::mesh::Navigation3D::NavigationTable::switch_element(const Mesh3DStorage &M, Index idx) const
+{
+	if (M.face_hs.size(idx.face) == 1)
+	{
+		idx.element = -1;
+		return idx;
+	}
+
+	const int side = M.face_hs(idx.face, 0) == (uint32_t)idx.element ? 1 : 0;
+	idx.element = M.face_hs(idx.face, side);
+	const int patch = face_patches_[idx.face][side];
+	if (patch >= 0)
+		idx.element_patch = patch;
+
+	return idx;
+}
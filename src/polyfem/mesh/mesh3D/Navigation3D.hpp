@@ -2,6 +2,9 @@
 
 #include "Mesh3DStorage.hpp"
 
+#include <array>
+#include <vector>
+
 namespace polyfem
 {
 	namespace mesh
@@ -42,6 +45,31 @@ namespace polyfem
 			inline Index next_around_2Dvertex(const Mesh3DStorage &M, Index idx) { return switch_face(M, switch_edge(M, idx)); }
 
 			inline Index next_around_3Dedge(const Mesh3DStorage &M, Index idx) { return switch_element(M, switch_face(M, idx)); }
+			// Precomputed tables of a polyhedral Mesh3DStorage (not MeshType::TET), switch_face and switch_element become lookups
+			// returning the same indices as the functions above. They must be rebuilt after any change of the connectivity.
+			class NavigationTable
+			{
+			public:
+				// Builds the tables in parallel over the elements and faces, the tables stay empty for tet meshes
+				void build(const Mesh3DStorage &M);
+				void clear();
+				bool empty() const { return half_face_offsets_.empty(); }
+
+				// Fall back to the searches of Navigation3D if the local face of idx is not consistent
+				Index switch_face(const Mesh3DStorage &M, Index idx) const;
+				Index switch_element(const Mesh3DStorage &M, Index idx) const;
+
+			private:
+				// First entry of every half-face (element, local face), in the order of element_fs, in the tables of the face edges
+				std::vector<int> half_face_offsets_;
+				// For every edge of every half-face: local face of the element across the edge, -1 if there is none
+				std::vector<int> adjacent_patch_;
+				// For every edge of every half-face: corners of the edge vertices edge_vs(e, 0) and edge_vs(e, 1) in the face across
+				std::vector<std::array<int, 2>> adjacent_corners_;
+				// Local face of each face in its elements face_hs(f, 0) and face_hs(f, 1)
+				std::vector<std::array<int, 2>> face_patches_;
+			};
+
 			// inline Index next_around_3Delement(const Mesh3DStorage &M, Index idx) { idx.element_patch++; return get_index_from_element_face(M, idx.element,idx.element_patch,idx.face_corner); }
 		} // namespace Navigation3D
 	}     // namespace mesh
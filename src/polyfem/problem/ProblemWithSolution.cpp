@@ -14,11 +14,11 @@ namespace polyfem
 			const int size = size_for(pts);
 			val.resize(pts.rows(), size);
 
+			DiffScalarBase::setVariableCount(pts.cols());
+			AutodiffHessianPt pt(pts.cols());
+
 			for (long i = 0; i < pts.rows(); ++i)
 			{
-				DiffScalarBase::setVariableCount(pts.cols());
-				AutodiffHessianPt pt(pts.cols());
-
 				for (long d = 0; d < pts.cols(); ++d)
 					pt(d) = AutodiffScalarHessian(d, pts(i, d));
 
@@ -44,15 +44,27 @@ namespace polyfem
 		}
 
 		void ProblemWithSolution::exact_grad(const Eigen::MatrixXd &pts, const double t, Eigen::MatrixXd &val) const
+		{
+			eval_with_grad(pts, t, nullptr, val);
+		}
+
+		void ProblemWithSolution::exact_with_grad(const Eigen::MatrixXd &pts, const double t, Eigen::MatrixXd &val, Eigen::MatrixXd &grad) const
+		{
+			eval_with_grad(pts, t, &val, grad);
+		}
+
+		void ProblemWithSolution::eval_with_grad(const Eigen::MatrixXd &pts, const double t, Eigen::MatrixXd *val, Eigen::MatrixXd &grad) const
 		{
 			const int size = size_for(pts);
-			val.resize(pts.rows(), pts.cols() * size);
+			grad.resize(pts.rows(), pts.cols() * size);
+			if (val)
+				val->resize(pts.rows(), size);
+
+			DiffScalarBase::setVariableCount(pts.cols());
+			AutodiffGradPt pt(pts.cols());
 
 			for (long i = 0; i < pts.rows(); ++i)
 			{
-				DiffScalarBase::setVariableCount(pts.cols());
-				AutodiffGradPt pt(pts.cols());
-
 				for (long d = 0; d < pts.cols(); ++d)
 					pt(d) = AutodiffScalarGrad(d, pts(i, d));
 
@@ -61,7 +73,9 @@ namespace polyfem
 				for (int m = 0; m < size; ++m)
 				{
 					const auto &tmp = res(m);
-					val.block(i, m * pts.cols(), 1, pts.cols()) = tmp.getGradient().transpose();
+					grad.block(i, m * pts.cols(), 1, pts.cols()) = tmp.getGradient().transpose();
+					if (val)
+						(*val)(i, m) = tmp.getValue();
 				}
 			}
 		}
@@ -19,6 +19,8 @@ namespace polyfem
 
 			virtual void exact(const Eigen::MatrixXd &pts, const double t, Eigen::MatrixXd &val) const override;
 			virtual void exact_grad(const Eigen::MatrixXd &pts, const double t, Eigen::MatrixXd &val) const override;
+			// the gradient autodiff pass also gives the values
+			virtual void exact_with_grad(const Eigen::MatrixXd &pts, const double t, Eigen::MatrixXd &val, Eigen::MatrixXd &grad) const override;
 
 			virtual bool has_exact_sol() const override { return true; }
 			virtual bool is_rhs_zero() const override { return false; }
@@ -31,6 +33,10 @@ namespace polyfem
 			virtual AutodiffHessianPt eval_fun(const AutodiffHessianPt &pt, double t) const = 0;
 
 			virtual int size_for(const Eigen::MatrixXd &pts) const { return is_scalar() ? 1 : pts.cols(); }
+
+		private:
+			// gradient (and values if val is not null) with one autodiff pass per point
+			void eval_with_grad(const Eigen::MatrixXd &pts, const double t, Eigen::MatrixXd *val, Eigen::MatrixXd &grad) const;
 		};
 
 		class BilaplacianProblemWithSolution : public assembler::Problem
@@ -0,0 +1,87 @@
+#include "GaussLobattoQuadrature.hpp"
+
+#include <polyfem/utils/Logger.hpp>
+
+#include <cassert>
+#include <cmath>
+
+namespace polyfem
+{
+	namespace quadrature
+	{
+		GaussLobattoQuadrature::GaussLobattoQuadrature()
+		{
+		}
+
+		void GaussLobattoQuadrature::points_1d(const int n_points, Eigen::VectorXd &points, Eigen::VectorXd &weights)
+		{
+			if (n_points < 2)
+				log_and_throw_error("Gauss-Lobatto rules need at least 2 points, {} requested", n_points);
+
+			// the interior points are the roots of P'_n, found with Newton from the Chebyshev-Gauss-Lobatto points
+			const int n = n_points - 1;
+			Eigen::VectorXd x(n_points);
+			for (int i = 0; i < n_points; ++i)
+				x[i] = -std::cos(M_PI * i / n);
+
+			// Legendre polynomials P_{n-1} and P_n at x
+			Eigen::VectorXd p_prev(n_points), p(n_points);
+			const auto legendre = [&]() {
+				for (int i = 0; i < n_points; ++i)
+				{
+					double a = 1, b = x[i];
+					for (int k = 2; k <= n; ++k)
+					{
+						const double c = ((2 * k - 1) * x[i] * b - (k - 1) * a) / k;
+						a = b;
+						b = c;
+					}
+					p_prev[i] = a;
+					p[i] = b;
+				}
+			};
+
+			for (int it = 0; it < 100; ++it)
+			{
+				legendre();
+				const Eigen::VectorXd dx = (x.cwiseProduct(p) - p_prev).cwiseQuotient((n + 1) * p);
+				x -= dx;
+				if (dx.cwiseAbs().maxCoeff() < 1e-15)
+					break;
+			}
+			legendre();
+
+			x[0] = -1;
+			x[n] = 1;
+			points = (x.array() + 1) / 2;
+			// 2 / (n (n + 1) P_n^2) on [-1, 1], halved on [0, 1]
+			weights = (1. / (n * (n + 1))) * p.array().square().inverse();
+
+			assert(std::abs(weights.sum() - 1) < 1e-12);
+		}
+
+		void GaussLobattoQuadrature::get_quadrature(const int n_points, const int dim, Quadrature &quad)
+		{
+			assert(dim >= 1 && dim <= 3);
+
+			Eigen::VectorXd pts, w;
+			points_1d(n_points, pts, w);
+
+			const int n_quad_pts = std::pow(n_points, dim);
+			quad.points.resize(n_quad_pts, dim);
+			quad.weights.resize(n_quad_pts);
+
+			for (int index = 0; index < n_quad_pts; ++index)
+			{
+				quad.weights[index] = 1;
+				for (int d = 0, rest = index; d < dim; ++d, rest /= n_points)
+				{
+					quad.points(index, d) = pts[rest % n_points];
+					quad.weights[index] *= w[rest % n_points];
+				}
+			}
+
+			assert(std::abs(quad.weights.sum() - 1) < 1e-12);
+		}
+	} // namespace quadrature
+} // namespace polyfem
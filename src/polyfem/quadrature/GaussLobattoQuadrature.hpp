@@ -0,0 +1,30 @@
+#pragma once
+
+#include "Quadrature.hpp"
+
+namespace polyfem
+{
+	namespace quadrature
+	{
+		/// @brief Gauss-Lobatto-Legendre rules on [0, 1]^dim. The points include the end points of every direction,
+		/// so they can be used as interpolation nodes (spectral elements): the n point rule integrates exactly
+		/// the polynomials of degree 2n - 3 per direction.
+		class GaussLobattoQuadrature
+		{
+		public:
+			GaussLobattoQuadrature();
+
+			/// @brief Tensor product rule, x varies fastest as in HexQuadrature
+			/// @param[in] n_points number of points per direction, at least 2
+			/// @param[in] dim dimension (1, 2, or 3)
+			/// @param[out] quad rule on [0, 1]^dim
+			void get_quadrature(const int n_points, const int dim, Quadrature &quad);
+
+			/// @brief One dimensional rule, points in increasing order
+			/// @param[in] n_points number of points, at least 2
+			/// @param[out] points points in [0, 1], the first is 0 and the last is 1
+			/// @param[out] weights weights, summing to 1
+			static void points_1d(const int n_points, Eigen::VectorXd &points, Eigen::VectorXd &weights);
+		};
+	} // namespace quadrature
+} // namespace polyfem
@@ -2,7 +2,6 @@
 #include "TriQuadrature.hpp"
 
 #include <igl/predicates/ear_clipping.h>
-#include <igl/write_triangle_mesh.h>
 
 #ifdef POLYFEM_WITH_TRIANGLE
 #include <igl/triangle/triangulate.h>
@@ -80,13 +79,6 @@ namespace polyfem
 
 			igl::triangle::triangulate(poly, E, H, flags, pts, tris);
 			assign_quadrature(tri_quadr_pts, tris, pts, quadr);
-
-			Eigen::MatrixXd asd(pts.rows(), 3);
-			asd.col(0) = pts.col(0);
-			asd.col(1) = pts.col(1);
-			asd.col(2).setZero();
-			igl::write_triangle_mesh("quad.obj", asd, tris);
-
 #else
 			const int n_vertices = poly.rows();
 			double area = 0;
@@ -0,0 +1,108 @@
+#include "PolytopeQuadratureCache.hpp"
+#include "PolyhedronQuadrature.hpp"
+
+#include <cmath>
+
+namespace polyfem
+{
+	namespace quadrature
+	{
+		namespace
+		{
+			// vertices closer than this fraction of the polytope size are considered equal
+			const int tolerance_exponent = -33;
+
+			enum class Kind : long long
+			{
+				POLYGON = 0,
+				POLYHEDRON = 1
+			};
+
+			// shape of the polytope up to a translation: vertices relative to the first one, rounded on a grid scaled with the polytope
+			std::vector<long long> shape_key(const Kind kind, const int order, const Eigen::MatrixXd &V, const Eigen::MatrixXi &F, const Eigen::RowVectorXd &extra)
+			{
+				std::vector<long long> key = {static_cast<long long>(kind), order, V.rows(), V.cols(), F.rows(), F.cols()};
+				if (V.rows() == 0)
+					return key;
+
+				const double size = (V.colwise().maxCoeff() - V.colwise().minCoeff()).maxCoeff();
+				int exponent;
+				std::frexp(size, &exponent);
+				key.push_back(exponent);
+
+				// power of two, so that copies of the polytope round the same way
+				const double step = std::ldexp(1., exponent + tolerance_exponent);
+				const auto push = [&](const Eigen::RowVectorXd &p) {
+					for (int d = 0; d < p.size(); ++d)
+						key.push_back(std::llround((p(d) - V(0, d)) / step));
+				};
+
+				for (int i = 0; i < V.rows(); ++i)
+					push(V.row(i));
+				if (extra.size() > 0)
+					push(extra);
+				for (int i = 0; i < F.size(); ++i)
+					key.push_back(F(i));
+
+				return key;
+			}
+		} // namespace
+
+		TranslatedQuadrature PolytopeQuadratureCache::find(const Key &key, const Eigen::RowVectorXd &origin) const
+		{
+			TranslatedQuadrature res;
+			const auto it = rules_.find(key);
+			if (it != rules_.end())
+			{
+				res.rule = it->second;
+				res.origin = origin;
+			}
+			return res;
+		}
+
+		TranslatedQuadrature PolytopeQuadratureCache::insert(const Key &key, const Eigen::RowVectorXd &origin, Quadrature &quadr)
+		{
+			quadr.points.rowwise() -= origin;
+
+			TranslatedQuadrature res;
+			res.rule = std::make_shared<const Quadrature>(std::move(quadr));
+			res.origin = origin;
+			rules_[key] = res.rule;
+			return res;
+		}
+
+		TranslatedQuadrature PolytopeQuadratureCache::polygon(const Eigen::MatrixXd &poly, const int order)
+		{
+			const Key key = shape_key(Kind::POLYGON, order, poly, Eigen::MatrixXi(), Eigen::RowVectorXd());
+			const Eigen::RowVectorXd origin = poly.row(0);
+
+			TranslatedQuadrature res = find(key, origin);
+			if (res.rule)
+			{
+				++n_reused_;
+				return res;
+			}
+
+			Quadrature quadr;
+			polygon_quadrature_.get_quadrature(poly, order, quadr);
+			return insert(key, origin, quadr);
+		}
+
+		TranslatedQuadrature PolytopeQuadratureCache::polyhedron(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F, const Eigen::RowVector3d &kernel)
+		{
+			const Key key = shape_key(Kind::POLYHEDRON, 0, V, F, kernel);
+			const Eigen::RowVectorXd origin = V.row(0);
+
+			TranslatedQuadrature res = find(key, origin);
+			if (res.rule)
+			{
+				++n_reused_;
+				return res;
+			}
+
+			Quadrature quadr;
+			PolyhedronQuadrature::get_quadrature(V, F, kernel, 0, quadr);
+			return insert(key, origin, quadr);
+		}
+	} // namespace quadrature
+} // namespace polyfem
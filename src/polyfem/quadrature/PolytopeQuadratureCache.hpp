@@ -0,0 +1,69 @@
+#pragma once
+
+#include "PolygonQuadrature.hpp"
+#include "Quadrature.hpp"
+
+#include <Eigen/Dense>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace polyfem
+{
+	namespace quadrature
+	{
+		/// @brief Quadrature of a polytope stored relative to one of its vertices, the rule is shared by all the translated copies of the polytope
+		class TranslatedQuadrature
+		{
+		public:
+			/// rule with points relative to origin
+			std::shared_ptr<const Quadrature> rule;
+			/// position of the reference vertex of the polytope
+			Eigen::RowVectorXd origin;
+
+			/// @brief Quadrature of the polytope in the object domain
+			void get(Quadrature &quadr) const
+			{
+				assert(rule);
+				quadr.points = rule->points.rowwise() + origin;
+				quadr.weights = rule->weights;
+			}
+		};
+
+		/// @brief Builds the quadratures of the polygons and polyhedra of a mesh once per shape.
+		/// Polytopes with the same vertices up to a translation (within a relative tolerance) share their rule,
+		/// so regular polytopal meshes triangulate or tetrahedralize each distinct shape only once.
+		/// Not thread safe, the triangulations are not either.
+		class PolytopeQuadratureCache
+		{
+		public:
+			/// @brief Quadrature of a polygon, see PolygonQuadrature::get_quadrature
+			/// @param[in] poly n x 2 coordinates of the polyline defining the boundary of the polygon
+			/// @param[in] order order of the quadrature
+			TranslatedQuadrature polygon(const Eigen::MatrixXd &poly, const int order);
+
+			/// @brief Quadrature of a polyhedron, see PolyhedronQuadrature::get_quadrature.
+			/// The rule of PolyhedronQuadrature does not depend on the order, the same rule serves the stiffness and the mass.
+			/// @param[in] V #V x 3 vertices of the triangulated surface of the polyhedron
+			/// @param[in] F #F x 3 faces of the triangulated surface
+			/// @param[in] kernel a point in the kernel of the polyhedron
+			TranslatedQuadrature polyhedron(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F, const Eigen::RowVector3d &kernel);
+
+			/// number of rules built
+			int n_built() const { return rules_.size(); }
+			/// number of rules reused from another polytope
+			int n_reused() const { return n_reused_; }
+
+		private:
+			using Key = std::vector<long long>;
+
+			TranslatedQuadrature find(const Key &key, const Eigen::RowVectorXd &origin) const;
+			TranslatedQuadrature insert(const Key &key, const Eigen::RowVectorXd &origin, Quadrature &quadr);
+
+			PolygonQuadrature polygon_quadrature_;
+			std::map<Key, std::shared_ptr<const Quadrature>> rules_;
+			int n_reused_ = 0;
+		};
+	} // namespace quadrature
+} // namespace polyfem
@@ -0,0 +1,91 @@
+#include "QuadratureCache.hpp"
+
+#include "GaussLobattoQuadrature.hpp"
+#include "HexQuadrature.hpp"
+#include "LineQuadrature.hpp"
+#include "QuadQuadrature.hpp"
+#include "TetQuadrature.hpp"
+#include "TriQuadrature.hpp"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+
+namespace polyfem::quadrature
+{
+	namespace
+	{
+		using Key = std::pair<QuadratureCache::Shape, int>;
+
+		struct Cache
+		{
+			std::shared_mutex mutex;
+			// rules are heap allocated so that their address never changes
+			std::map<Key, std::unique_ptr<const Quadrature>> rules;
+		};
+
+		Cache &cache()
+		{
+			static Cache instance;
+			return instance;
+		}
+
+		std::unique_ptr<const Quadrature> build(const QuadratureCache::Shape shape, const int order)
+		{
+			auto quad = std::make_unique<Quadrature>();
+			switch (shape)
+			{
+			case QuadratureCache::Shape::LINE:
+				LineQuadrature().get_quadrature(order, *quad);
+				break;
+			case QuadratureCache::Shape::TRIANGLE:
+				TriQuadrature().get_quadrature(order, *quad);
+				break;
+			case QuadratureCache::Shape::QUAD:
+				QuadQuadrature().get_quadrature(order, *quad);
+				break;
+			case QuadratureCache::Shape::TETRAHEDRON:
+				TetQuadrature().get_quadrature(order, *quad);
+				break;
+			case QuadratureCache::Shape::HEXAHEDRON:
+				HexQuadrature().get_quadrature(order, *quad);
+				break;
+			case QuadratureCache::Shape::LOBATTO_HEXAHEDRON:
+				GaussLobattoQuadrature().get_quadrature(order, 3, *quad);
+				break;
+			}
+			return quad;
+		}
+	} // namespace
+
+	const Quadrature &QuadratureCache::get(const Shape shape, const int order)
+	{
+		Cache &c = cache();
+		const Key key(shape, order);
+
+		{
+			std::shared_lock lock(c.mutex);
+			const auto it = c.rules.find(key);
+			if (it != c.rules.end())
+				return *it->second;
+		}
+
+		// built outside of the lock, another thread might insert the same rule first
+		auto quad = build(shape, order);
+
+		std::unique_lock lock(c.mutex);
+		auto &rule = c.rules[key];
+		if (!rule)
+			rule = std::move(quad);
+		return *rule;
+	}
+
+	int QuadratureCache::size()
+	{
+		Cache &c = cache();
+		std::shared_lock lock(c.mutex);
+		return c.rules.size();
+	}
+} // namespace polyfem::quadrature
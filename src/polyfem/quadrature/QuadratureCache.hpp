@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Quadrature.hpp"
+
+namespace polyfem::quadrature
+{
+	/// @brief Process-wide cache of the quadrature rules of the reference elements.
+	/// Rules are built on first use and never modified nor released, so the returned
+	/// references stay valid for the whole run and can be shared between threads.
+	class QuadratureCache
+	{
+	public:
+		enum class Shape
+		{
+			LINE,
+			TRIANGLE,
+			QUAD,
+			TETRAHEDRON,
+			HEXAHEDRON,
+			/// Gauss-Lobatto-Legendre rule on the hexahedron, the order is the number of points per direction
+			LOBATTO_HEXAHEDRON
+		};
+
+		/// @brief Quadrature rule of a reference element
+		/// @param[in] shape reference element
+		/// @param[in] order order of the rule, as in the get_quadrature of the corresponding rule
+		/// @return rule shared by all callers, it must not be modified
+		static const Quadrature &get(const Shape shape, const int order);
+
+		/// @brief Number of cached rules
+		static int size();
+	};
+} // namespace polyfem::quadrature
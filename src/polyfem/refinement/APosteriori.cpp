@@ -0,0 +1,179 @@
+#include "APosteriori.hpp"
+
+#include <polyfem/assembler/ElementAssemblyValues.hpp>
+#include <polyfem/io/Evaluator.hpp>
+
+#include <polyfem/utils/Logger.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace polyfem::refinement
+{
+	using namespace mesh;
+	using namespace basis;
+
+	namespace
+	{
+		// vertices of the reference simplex or cube
+		Eigen::MatrixXd reference_vertices(const Mesh &mesh, const int e)
+		{
+			const int dim = mesh.dimension();
+			Eigen::MatrixXd pts;
+			if (mesh.is_simplex(e))
+			{
+				pts.setZero(dim + 1, dim);
+				for (int d = 0; d < dim; ++d)
+					pts(d + 1, d) = 1;
+			}
+			else
+			{
+				pts.resize(1 << dim, dim);
+				for (int i = 0; i < pts.rows(); ++i)
+					for (int d = 0; d < dim; ++d)
+						pts(i, d) = (i >> d) & 1;
+			}
+			return pts;
+		}
+
+		// linear (simplex) or multilinear (cube) shape function of the reference vertex v at the points
+		Eigen::VectorXd vertex_shape_function(const bool is_simplex, const Eigen::MatrixXd &ref_vertices, const int v, const Eigen::MatrixXd &pts)
+		{
+			if (is_simplex)
+				return v == 0 ? Eigen::VectorXd(1 - pts.rowwise().sum().array()) : Eigen::VectorXd(pts.col(v - 1));
+
+			Eigen::VectorXd res = Eigen::VectorXd::Ones(pts.rows());
+			for (int d = 0; d < pts.cols(); ++d)
+				res.array() *= ref_vertices(v, d) > 0 ? pts.col(d).array() : (1 - pts.col(d).array());
+			return res;
+		}
+
+		// flux at the local points, one row per point
+		void compute_flux(const Mesh &mesh, const int actual_dim, const std::vector<ElementBases> &bases, const std::vector<ElementBases> &gbases,
+						  const assembler::Assembler &assembler, const int e, const Eigen::MatrixXd &local_pts, const Eigen::MatrixXd &fun,
+						  Eigen::MatrixXd &flux)
+		{
+			std::vector<assembler::Assembler::NamedMatrix> tensor;
+			if (actual_dim > 1)
+				assembler.compute_tensor_value(e, bases[e], gbases[e], local_pts, fun, tensor);
+
+			if (!tensor.empty())
+				flux = tensor.front().second;
+			else
+			{
+				Eigen::MatrixXd val;
+				io::Evaluator::interpolate_at_local_vals(mesh, actual_dim, bases, gbases, e, local_pts, fun, val, flux);
+			}
+		}
+	} // namespace
+
+	void APosteriori::zz_estimate(const Mesh &mesh,
+								  const int actual_dim,
+								  const std::vector<ElementBases> &bases,
+								  const std::vector<ElementBases> &gbases,
+								  const assembler::Assembler &assembler,
+								  const Eigen::MatrixXd &fun,
+								  Eigen::VectorXd &errors)
+	{
+		const int n_elements = mesh.n_elements();
+		errors.setZero(n_elements);
+
+		// flux at the element vertices, and the corresponding mesh vertices
+		std::vector<Eigen::MatrixXd> vertex_flux(n_elements);
+		std::vector<std::vector<int>> vertex_ids(n_elements);
+		utils::maybe_parallel_for(n_elements, [&](int start, int end, int thread_id) {
+			Eigen::MatrixXd mapped;
+			for (int e = start; e < end; ++e)
+			{
+				if (!mesh.is_simplex(e) && !mesh.is_cube(e))
+					continue;
+
+				const Eigen::MatrixXd ref_vertices = reference_vertices(mesh, e);
+				compute_flux(mesh, actual_dim, bases, gbases, assembler, e, ref_vertices, fun, vertex_flux[e]);
+
+				// the mesh vertex of a reference vertex is the closest element vertex to its image
+				gbases[e].eval_geom_mapping(ref_vertices, mapped);
+				vertex_ids[e].resize(ref_vertices.rows());
+				for (int i = 0; i < ref_vertices.rows(); ++i)
+				{
+					double best = std::numeric_limits<double>::max();
+					for (int lv = 0; lv < ref_vertices.rows(); ++lv)
+					{
+						const int v = mesh.element_vertex(e, lv);
+						const double dist = (mesh.point(v) - mapped.row(i)).squaredNorm();
+						if (dist < best)
+						{
+							best = dist;
+							vertex_ids[e][i] = v;
+						}
+					}
+				}
+			}
+		});
+
+		// average at the vertices
+		Eigen::MatrixXd recovered;
+		Eigen::VectorXi count = Eigen::VectorXi::Zero(mesh.n_vertices());
+		for (int e = 0; e < n_elements; ++e)
+		{
+			if (vertex_ids[e].empty())
+				continue;
+			if (recovered.size() == 0)
+				recovered.setZero(mesh.n_vertices(), vertex_flux[e].cols());
+
+			for (int i = 0; i < vertex_ids[e].size(); ++i)
+			{
+				recovered.row(vertex_ids[e][i]) += vertex_flux[e].row(i);
+				++count[vertex_ids[e][i]];
+			}
+		}
+		for (int v = 0; v < count.size(); ++v)
+		{
+			if (count[v] > 0)
+				recovered.row(v) /= count[v];
+		}
+
+		utils::maybe_parallel_for(n_elements, [&](int start, int end, int thread_id) {
+			assembler::ElementAssemblyValues vals;
+			Eigen::MatrixXd flux;
+			for (int e = start; e < end; ++e)
+			{
+				if (vertex_ids[e].empty())
+					continue;
+
+				vals.compute(e, mesh.is_volume(), bases[e], gbases[e]);
+				const Eigen::MatrixXd &pts = vals.quadrature.points;
+				compute_flux(mesh, actual_dim, bases, gbases, assembler, e, pts, fun, flux);
+
+				const Eigen::MatrixXd ref_vertices = reference_vertices(mesh, e);
+				for (int i = 0; i < vertex_ids[e].size(); ++i)
+					flux -= vertex_shape_function(mesh.is_simplex(e), ref_vertices, i, pts) * recovered.row(vertex_ids[e][i]);
+
+				const Eigen::VectorXd w = vals.quadrature.weights.array() * vals.det.array();
+				errors[e] = std::sqrt(w.dot(flux.rowwise().squaredNorm()));
+			}
+		});
+	}
+
+	std::vector<int> APosteriori::mark(const Eigen::VectorXd &errors, const double theta)
+	{
+		std::vector<int> order(errors.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&](const int a, const int b) { return errors[a] > errors[b]; });
+
+		const double target = theta * errors.squaredNorm();
+		std::vector<int> marked;
+		double sum = 0;
+		for (const int e : order)
+		{
+			if (sum >= target)
+				break;
+			marked.push_back(e);
+			sum += errors[e] * errors[e];
+		}
+
+		return marked;
+	}
+} // namespace polyfem::refinement
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <polyfem/Common.hpp>
+
+#include <polyfem/assembler/Assembler.hpp>
+#include <polyfem/basis/ElementBases.hpp>
+#include <polyfem/mesh/Mesh.hpp>
+
+#include <vector>
+
+namespace polyfem::refinement
+{
+	/// Class for a posteriori error estimation and marking for h-refinement
+	class APosteriori
+	{
+	private:
+		APosteriori() {}
+
+	public:
+		/// Zienkiewicz-Zhu recovery estimate, the flux (Cauchy stress for tensor problems, gradient otherwise) is averaged
+		/// at the mesh vertices and interpolated linearly, the error of an element is the L2 norm of the difference with the discrete flux.
+		/// Computed in parallel over the elements, polygonal elements get a zero error.
+		/// @param[in] mesh mesh
+		/// @param[in] actual_dim is the size of the problem (e.g., 1 for Laplace, dim for elasticity)
+		/// @param[in] bases bases
+		/// @param[in] gbases geom bases
+		/// @param[in] assembler assembler, its first tensor value is used as flux
+		/// @param[in] fun solution
+		/// @param[out] errors per element estimated error
+		static void zz_estimate(const mesh::Mesh &mesh,
+								const int actual_dim,
+								const std::vector<basis::ElementBases> &bases,
+								const std::vector<basis::ElementBases> &gbases,
+								const assembler::Assembler &assembler,
+								const Eigen::MatrixXd &fun,
+								Eigen::VectorXd &errors);
+
+		/// Dörfler (bulk) marking: the fewest elements whose squared errors sum to at least theta of the total
+		/// @param[in] errors per element estimated error
+		/// @param[in] theta fraction in (0, 1]
+		/// @return marked elements, by decreasing error
+		static std::vector<int> mark(const Eigen::VectorXd &errors, const double theta);
+	};
+} // namespace polyfem::refinement
@@ -2,6 +2,8 @@
 
 #include <polyfem/utils/Logger.hpp>
 
+#include <limits>
+
 namespace polyfem::solver
 {
 	ALSolver::ALSolver(
@@ -37,6 +39,21 @@ namespace polyfem::solver
 
 		double al_weight = initial_al_weight;
 		int al_steps = 0;
+		int skipped_steps = 0;
+
+		// Skip the weights a cold start would try before the warm start one
+		if (warm_start_weight > 0 && scaling > 1)
+		{
+			while (skipped_steps < max_al_steps && al_weight / scaling >= warm_start_weight * (1 - 1e-10))
+			{
+				al_weight /= scaling;
+				++skipped_steps;
+			}
+			al_steps = skipped_steps;
+		}
+
+		converged_weight_ = -1;
+		saved_steps_ = 0;
 
 		nl_problem.line_search_begin(sol, tmp_sol);
 		while (force_al
@@ -56,8 +73,19 @@ namespace polyfem::solver
 			nl_solver->minimize(nl_problem, tmp_sol);
 
 			sol = tmp_sol;
+			converged_weight_ = al_weight;
+			saved_steps_ = skipped_steps;
+			const double al_error = al_form == nullptr ? std::numeric_limits<double>::infinity() : al_form->compute_error(sol);
 			set_al_weight(nl_problem, sol, -1, initial_weight);
 			tmp_sol = nl_problem.full_to_reduced(sol);
+
+			if (al_error <= error_tolerance)
+			{
+				logger().debug("AL error {} is below tolerance {}, imposing DBC directly", al_error, error_tolerance);
+				nl_problem.line_search_begin(sol, tmp_sol);
+				post_subsolve(al_weight / scaling);
+				break;
+			}
 			nl_problem.line_search_begin(sol, tmp_sol);
 
 			al_weight /= scaling;
@@ -29,6 +29,16 @@ namespace polyfem::solver
 
 		std::function<void(const double)> post_subsolve = [](const double) {};
 
+		/// If positive, the AL loop starts from this weight instead of the initial one (e.g., the weight that worked in the previous time step)
+		double warm_start_weight = -1;
+		/// If the AL error after a subsolve is below this tolerance, the DBC are imposed directly without checking the projected step
+		double error_tolerance = 0;
+
+		/// @brief Weight of the last AL subsolve in solve, negative if the DBC could be imposed without AL
+		double converged_weight() const { return converged_weight_; }
+		/// @brief Number of AL subsolves skipped in solve thanks to the warm start
+		int saved_steps() const { return saved_steps_; }
+
 	protected:
 		void set_al_weight(NLProblem &nl_problem, const Eigen::VectorXd &x, const double weight, const std::vector<double> &initial_weight);
 
@@ -38,6 +48,9 @@ namespace polyfem::solver
 		const double scaling;
 		const int max_al_steps;
 
+		double converged_weight_ = -1;
+		int saved_steps_ = 0;
+
 		// TODO: replace this with a member function
 		std::function<void(const Eigen::VectorXd &)> update_barrier_stiffness;
 	};
@@ -0,0 +1,322 @@
+#include "BlockStokesSolver.hpp"
+
+#include <polyfem/utils/Logger.hpp>
+
+#include <cmath>
+
+namespace polyfem::solver
+{
+	namespace
+	{
+		std::unique_ptr<polysolve::LinearSolver> create_inner_solver(const json &linear_params, const std::string &solver, const std::string &precond)
+		{
+			// empty names fall back to the solver of /solver/linear
+			auto res = polysolve::LinearSolver::create(
+				solver.empty() ? linear_params["solver"].get<std::string>() : solver,
+				solver.empty() ? linear_params["precond"].get<std::string>() : precond);
+			res->setParameters(linear_params);
+			return res;
+		}
+	} // namespace
+
+	BlockStokesSolver::BlockStokesSolver(const json &linear_params, const int n_velocity, const int n_pressure, const bool use_avg_pressure)
+		: n_velocity_(n_velocity), n_pressure_(n_pressure), use_avg_pressure_(use_avg_pressure)
+	{
+		const json &params = linear_params["block"];
+		schur_ = params["schur"];
+		tolerance_ = params["tolerance"];
+		max_iter_ = params["max_iter"];
+		restart_ = params["restart"];
+
+		if (schur_ != "mass" && schur_ != "lsc")
+			log_and_throw_error("Unknown Schur complement approximation {}", schur_);
+		if (restart_ <= 0)
+			log_and_throw_error("Invalid FGMRES restart {}", restart_);
+
+		velocity_solver_ = create_inner_solver(linear_params, params["velocity_solver"], params["velocity_precond"]);
+		// also used by "mass" if there is no pressure mass matrix
+		pressure_solver_ = create_inner_solver(linear_params, params["pressure_solver"], params["pressure_precond"]);
+	}
+
+	bool BlockStokesSolver::is_enabled(const json &linear_params)
+	{
+		return linear_params.contains("block") && linear_params["block"].is_object() && linear_params["block"]["enabled"].get<bool>();
+	}
+
+	void BlockStokesSolver::set_pressure_mass(const StiffnessMatrix &pressure_mass, const double viscosity)
+	{
+		assert(pressure_mass.rows() == n_pressure_ && pressure_mass.cols() == n_pressure_);
+		assert(viscosity > 0);
+		pressure_mass_ = pressure_mass;
+		viscosity_ = viscosity;
+	}
+
+	void BlockStokesSolver::factorize(const StiffnessMatrix &A, const std::vector<int> &boundary_nodes)
+	{
+		const int n_multipliers = use_avg_pressure_ ? 1 : 0;
+		const int n = n_velocity_ + n_pressure_ + n_multipliers;
+		if (A.rows() != n || A.cols() != n)
+			log_and_throw_error("Block solver expects a {}x{} matrix, got {}x{}", n, n, A.rows(), A.cols());
+
+		// Dirichlet dofs and dofs without any entry are replaced by the identity
+		is_identity_.assign(n, false);
+		for (const int i : boundary_nodes)
+			is_identity_[i] = true;
+
+		std::vector<bool> empty_row(n, true), empty_col(n, true);
+		for (int k = 0; k < A.outerSize(); ++k)
+		{
+			for (StiffnessMatrix::InnerIterator it(A, k); it; ++it)
+			{
+				if (it.value() != 0)
+				{
+					empty_row[it.row()] = false;
+					empty_col[it.col()] = false;
+				}
+			}
+		}
+		for (int i = 0; i < n; ++i)
+		{
+			if (empty_row[i] && empty_col[i])
+				is_identity_[i] = true;
+		}
+
+		std::vector<Eigen::Triplet<double>> triplets;
+		triplets.reserve(A.nonZeros() + boundary_nodes.size());
+		for (int k = 0; k < A.outerSize(); ++k)
+		{
+			for (StiffnessMatrix::InnerIterator it(A, k); it; ++it)
+			{
+				if (!is_identity_[it.row()])
+					triplets.emplace_back(it.row(), it.col(), it.value());
+			}
+		}
+		for (int i = 0; i < n; ++i)
+		{
+			if (is_identity_[i])
+				triplets.emplace_back(i, i, 1.);
+		}
+		A_.resize(n, n);
+		A_.setFromTriplets(triplets.begin(), triplets.end());
+		A_.makeCompressed();
+
+		const StiffnessMatrix A_vv = A_.topLeftCorner(n_velocity_, n_velocity_);
+		Bt_ = A_.topRightCorner(n_velocity_, n_pressure_ + n_multipliers);
+		const StiffnessMatrix B = A_.block(n_velocity_, 0, n_pressure_, n_velocity_);
+		const StiffnessMatrix C = A_.block(n_velocity_, n_velocity_, n_pressure_, n_pressure_);
+
+		velocity_solver_->analyzePattern(A_vv, A_vv.rows());
+		velocity_solver_->factorize(A_vv);
+
+		if (schur_ == "mass" && pressure_mass_.size() == 0)
+		{
+			logger().warn("No pressure mass matrix for the mass Schur complement, using the least-squares commutator");
+			schur_ = "lsc";
+		}
+
+		if (schur_ == "mass")
+		{
+			// S = C - B A^-1 B^T ~ C - M / viscosity
+			const Eigen::VectorXd lumped = pressure_mass_ * Eigen::VectorXd::Ones(n_pressure_);
+			schur_diagonal_ = lumped / viscosity_ - C.diagonal();
+			for (int i = 0; i < n_pressure_; ++i)
+			{
+				if (schur_diagonal_[i] <= 0)
+					schur_diagonal_[i] = 1;
+			}
+			lsc_middle_.resize(0, 0);
+		}
+		else
+		{
+			schur_diagonal_.resize(0);
+
+			// the Dirichlet velocities are not coupled to the pressure in the preconditioner
+			Eigen::VectorXd d_inv(n_velocity_);
+			for (int i = 0; i < n_velocity_; ++i)
+			{
+				const double d = std::abs(A_vv.coeff(i, i));
+				d_inv[i] = (is_identity_[i] || d == 0) ? 0 : 1 / d;
+			}
+
+			const StiffnessMatrix BD = B * d_inv.asDiagonal();
+			StiffnessMatrix L = BD * B.transpose();
+			lsc_middle_ = BD * A_vv * BD.transpose();
+
+			// the pressure Laplacian is singular without pressure boundary conditions
+			const Eigen::VectorXd l_diag = L.diagonal();
+			const double reg = 1e-10 * std::max(l_diag.cwiseAbs().maxCoeff(), 1e-300);
+			StiffnessMatrix shift(n_pressure_, n_pressure_);
+			shift.reserve(Eigen::VectorXi::Constant(n_pressure_, 1));
+			for (int i = 0; i < n_pressure_; ++i)
+				shift.insert(i, i) = l_diag[i] == 0 ? 1 : reg;
+			L += shift;
+
+			pressure_solver_->analyzePattern(L, L.rows());
+			pressure_solver_->factorize(L);
+		}
+
+		if (use_avg_pressure_)
+		{
+			avg_column_ = Eigen::VectorXd(A_.block(n_velocity_, n_velocity_ + n_pressure_, n_pressure_, 1));
+			apply_pressure_schur(avg_column_, avg_schur_column_);
+			avg_schur_ = avg_column_.dot(avg_schur_column_);
+		}
+	}
+
+	void BlockStokesSolver::apply_pressure_schur(const Eigen::VectorXd &r, Eigen::VectorXd &y) const
+	{
+		Eigen::VectorXd rhs = r;
+		for (int i = 0; i < n_pressure_; ++i)
+		{
+			if (is_identity_[n_velocity_ + i])
+				rhs[i] = 0;
+		}
+
+		if (schur_ == "mass")
+		{
+			y = -rhs.cwiseQuotient(schur_diagonal_);
+		}
+		else
+		{
+			Eigen::VectorXd z(n_pressure_), w(n_pressure_);
+			z.setZero();
+			pressure_solver_->solve(rhs, z);
+			w = lsc_middle_ * z;
+			y.setZero(n_pressure_);
+			pressure_solver_->solve(w, y);
+			y *= -1;
+		}
+
+		for (int i = 0; i < n_pressure_; ++i)
+		{
+			if (is_identity_[n_velocity_ + i])
+				y[i] = r[i];
+		}
+	}
+
+	void BlockStokesSolver::apply_schur(const Eigen::VectorXd &r, Eigen::VectorXd &y) const
+	{
+		if (!use_avg_pressure_)
+		{
+			apply_pressure_schur(r, y);
+			return;
+		}
+
+		// bordered system [S_pp c; c^T 0], the multiplier is eliminated first
+		Eigen::VectorXd s;
+		apply_pressure_schur(r.head(n_pressure_), s);
+		const double r_avg = r[n_pressure_];
+		double y_avg = 0;
+		if (is_identity_[n_velocity_ + n_pressure_])
+			y_avg = r_avg;
+		else if (avg_schur_ != 0)
+			y_avg = (avg_column_.dot(s) - r_avg) / avg_schur_;
+
+		y.resize(n_pressure_ + 1);
+		y.head(n_pressure_) = s - y_avg * avg_schur_column_;
+		y[n_pressure_] = y_avg;
+	}
+
+	void BlockStokesSolver::apply_preconditioner(const Eigen::VectorXd &r, Eigen::VectorXd &y) const
+	{
+		const int n_q = r.size() - n_velocity_;
+
+		Eigen::VectorXd y_q;
+		apply_schur(r.tail(n_q), y_q);
+
+		const Eigen::VectorXd r_v = r.head(n_velocity_) - Bt_ * y_q;
+		Eigen::VectorXd y_v = Eigen::VectorXd::Zero(n_velocity_);
+		velocity_solver_->solve(r_v, y_v);
+
+		y.resize(r.size());
+		y.head(n_velocity_) = y_v;
+		y.tail(n_q) = y_q;
+	}
+
+	void BlockStokesSolver::solve(const Eigen::VectorXd &b, Eigen::VectorXd &x)
+	{
+		const int n = A_.rows();
+		assert(b.size() == n);
+		if (x.size() != n)
+			x.setZero(n);
+
+		const double b_norm = b.norm();
+		const double target = tolerance_ * (b_norm > 0 ? b_norm : 1);
+
+		// right preconditioned flexible GMRES, the preconditioner contains inexact inner solves
+		Eigen::MatrixXd V(n, restart_ + 1), Z(n, restart_);
+		Eigen::MatrixXd H = Eigen::MatrixXd::Zero(restart_ + 1, restart_);
+		Eigen::VectorXd cs(restart_), sn(restart_), g(restart_ + 1);
+		Eigen::VectorXd w, z;
+
+		Eigen::VectorXd r = b - A_ * x;
+		double res = r.norm();
+		int it = 0;
+
+		while (res > target && it < max_iter_)
+		{
+			V.col(0) = r / res;
+			g.setZero();
+			g[0] = res;
+			H.setZero();
+
+			int k = 0;
+			while (k < restart_ && it < max_iter_)
+			{
+				apply_preconditioner(V.col(k), z);
+				Z.col(k) = z;
+				w = A_ * z;
+
+				// modified Gram-Schmidt
+				for (int i = 0; i <= k; ++i)
+				{
+					H(i, k) = w.dot(V.col(i));
+					w -= H(i, k) * V.col(i);
+				}
+				const double h_next = w.norm();
+				H(k + 1, k) = h_next;
+				if (h_next > 0)
+					V.col(k + 1) = w / h_next;
+
+				for (int i = 0; i < k; ++i)
+				{
+					const double tmp = cs[i] * H(i, k) + sn[i] * H(i + 1, k);
+					H(i + 1, k) = -sn[i] * H(i, k) + cs[i] * H(i + 1, k);
+					H(i, k) = tmp;
+				}
+				const double rho = std::hypot(H(k, k), H(k + 1, k));
+				cs[k] = rho > 0 ? H(k, k) / rho : 1;
+				sn[k] = rho > 0 ? H(k + 1, k) / rho : 0;
+				H(k, k) = rho;
+				H(k + 1, k) = 0;
+				g[k + 1] = -sn[k] * g[k];
+				g[k] *= cs[k];
+
+				++k;
+				++it;
+				res = std::abs(g[k]);
+				// the Krylov space is invariant, the solution is in it
+				if (res <= target || h_next == 0)
+					break;
+			}
+
+			const Eigen::VectorXd y = H.topLeftCorner(k, k).triangularView<Eigen::Upper>().solve(g.head(k));
+			x += Z.leftCols(k) * y;
+
+			r = b - A_ * x;
+			res = r.norm();
+		}
+
+		info_ = json::object();
+		info_["solver"] = "FGMRES";
+		info_["schur"] = schur_;
+		info_["velocity_solver"] = velocity_solver_->name();
+		info_["iterations"] = it;
+		info_["error"] = res / (b_norm > 0 ? b_norm : 1);
+
+		if (res > target)
+			logger().warn("Block solver did not converge in {} iterations, relative residual {}", it, res / (b_norm > 0 ? b_norm : 1));
+		else
+			logger().debug("Block solver converged in {} iterations, relative residual {}", it, res / (b_norm > 0 ? b_norm : 1));
+	}
+} // namespace polyfem::solver
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <polyfem/Common.hpp>
+#include <polyfem/utils/Types.hpp>
+
+#include <polysolve/LinearSolver.hpp>
+
+#include <Eigen/Dense>
+
+#include <memory>
+#include <vector>
+
+namespace polyfem::solver
+{
+	/// @brief Block preconditioned FGMRES for the mixed systems of AssemblerUtils::merge_mixed_matrices
+	///     [A  B^T] [u]   [f]
+	///     [B  C  ] [p] = [g]
+	/// The preconditioner is the block upper triangular matrix [A B^T; 0 S] where the velocity block A is solved
+	/// with an inner linear solver (e.g., AMG) and the Schur complement S = C - B A^-1 B^T is approximated either
+	/// by the lumped pressure mass over the viscosity ("mass") or by the least-squares commutator ("lsc")
+	///     S^-1 ~ -(B D^-1 B^T)^-1 (B D^-1 A D^-1 B^T) (B D^-1 B^T)^-1, D = diag(A)
+	/// The optional zero average pressure multiplier is the last dof and is eliminated exactly in the Schur solve.
+	class BlockStokesSolver
+	{
+	public:
+		/// @param[in] linear_params settings of the linear solver (/solver/linear), the block settings are in "block"
+		/// @param[in] n_velocity number of velocity dofs (n_bases * problem_dim)
+		/// @param[in] n_pressure number of pressure dofs
+		/// @param[in] use_avg_pressure if the last dof is the multiplier of the zero average pressure
+		BlockStokesSolver(const json &linear_params, const int n_velocity, const int n_pressure, const bool use_avg_pressure);
+
+		/// @brief Pressure mass matrix, required by the "mass" Schur complement approximation
+		/// @param[in] pressure_mass n_pressure x n_pressure mass matrix of the pressure bases
+		/// @param[in] viscosity viscosity of the fluid
+		void set_pressure_mass(const StiffnessMatrix &pressure_mass, const double viscosity);
+
+		/// @brief Builds the preconditioner, the Dirichlet rows are replaced by rows of the identity as in dirichlet_solve
+		/// @param[in] A merged system matrix
+		/// @param[in] boundary_nodes Dirichlet dofs
+		void factorize(const StiffnessMatrix &A, const std::vector<int> &boundary_nodes);
+
+		/// @brief Solves the factorized system, x is the initial guess if it has the right size
+		/// @param[in] b right-hand side, its Dirichlet entries are the values of the Dirichlet dofs
+		/// @param[in, out] x solution
+		void solve(const Eigen::VectorXd &b, Eigen::VectorXd &x);
+
+		/// @brief factorize and solve
+		void solve(const StiffnessMatrix &A, const Eigen::VectorXd &b, const std::vector<int> &boundary_nodes, Eigen::VectorXd &x)
+		{
+			factorize(A, boundary_nodes);
+			solve(b, x);
+		}
+
+		/// @brief Iterations and residual of the last solve
+		void get_info(json &params) const { params = info_; }
+
+		/// @brief Block settings are enabled in the linear solver settings
+		static bool is_enabled(const json &linear_params);
+
+	private:
+		/// y = P^-1 r
+		void apply_preconditioner(const Eigen::VectorXd &r, Eigen::VectorXd &y) const;
+		/// y = S^-1 r for the pressure and multiplier dofs
+		void apply_schur(const Eigen::VectorXd &r, Eigen::VectorXd &y) const;
+		/// y = S_pp^-1 r for the pressure dofs only
+		void apply_pressure_schur(const Eigen::VectorXd &r, Eigen::VectorXd &y) const;
+
+		const int n_velocity_;
+		const int n_pressure_;
+		const bool use_avg_pressure_;
+
+		std::string schur_;
+		double tolerance_;
+		int max_iter_;
+		int restart_;
+
+		std::unique_ptr<polysolve::LinearSolver> velocity_solver_;
+		std::unique_ptr<polysolve::LinearSolver> pressure_solver_;
+
+		StiffnessMatrix pressure_mass_;
+		double viscosity_ = 1;
+
+		/// system matrix with the Dirichlet rows replaced
+		StiffnessMatrix A_;
+		/// velocity x (pressure + multiplier) block
+		StiffnessMatrix Bt_;
+
+		/// dofs replaced by the identity
+		std::vector<bool> is_identity_;
+
+		/// "mass": lumped Schur complement diagonal, S_pp ~ -diag(schur_diagonal_)
+		Eigen::VectorXd schur_diagonal_;
+		/// "lsc": B D^-1 A D^-1 B^T
+		StiffnessMatrix lsc_middle_;
+
+		/// zero average constraint: column of the multiplier, S_pp^-1 of it and the multiplier Schur complement
+		Eigen::VectorXd avg_column_;
+		Eigen::VectorXd avg_schur_column_;
+		double avg_schur_ = 0;
+
+		json info_;
+	};
+} // namespace polyfem::solver
@@ -1,5 +1,8 @@
 #include "FullNLProblem.hpp"
 
+#include <polyfem/solver/forms/ElementSweep.hpp>
+#include <polyfem/utils/Profiler.hpp>
+
 namespace polyfem::solver
 {
 	FullNLProblem::FullNLProblem(const std::vector<std::shared_ptr<Form>> &forms)
@@ -9,6 +12,7 @@ namespace polyfem::solver
 
 	void FullNLProblem::init(const TVector &x)
 	{
+		invalidate_cache();
 		for (auto &f : forms_)
 			f->init(x);
 	}
@@ -21,12 +25,14 @@ namespace polyfem::solver
 
 	void FullNLProblem::init_lagging(const TVector &x)
 	{
+		invalidate_cached_evaluations();
 		for (auto &f : forms_)
 			f->init_lagging(x);
 	}
 
 	void FullNLProblem::update_lagging(const TVector &x, const int iter_num)
 	{
+		invalidate_cached_evaluations();
 		for (auto &f : forms_)
 			f->update_lagging(x, iter_num);
 	}
@@ -86,48 +92,264 @@ namespace polyfem::solver
 
 	double FullNLProblem::value(const TVector &x)
 	{
+		const bool cached = is_cached_solution(x);
+		if (cached)
+		{
+			update_cached_weights();
+			if (has_cached_value_)
+			{
+				++cache_hits_.values;
+				return cached_value_;
+			}
+		}
+
+		POLYFEM_PROFILE_SCOPE("energy");
 		double val = 0;
+		if (element_sweep_ && element_sweep_->is_active())
+			val += element_sweep_->value(x);
 		for (auto &f : forms_)
-			if (f->enabled())
+			if (f->enabled() && !in_element_sweep(*f))
 				val += f->value(x);
+
+		if (cached)
+		{
+			cached_value_ = val;
+			has_cached_value_ = true;
+		}
 		return val;
 	}
 
+	void FullNLProblem::values(const std::vector<TVector> &xs, Eigen::VectorXd &vals)
+	{
+		// the forms are left at the last solution
+		has_cached_x_ = false;
+		invalidate_cached_evaluations();
+
+		vals.setZero(xs.size());
+		Eigen::VectorXd form_vals;
+		for (auto &f : forms_)
+		{
+			if (!f->enabled())
+				continue;
+			f->values(xs, form_vals);
+			vals += form_vals;
+		}
+	}
+
 	void FullNLProblem::gradient(const TVector &x, TVector &grad)
 	{
+		if (use_cached_gradient(x, grad))
+			return;
+
+		POLYFEM_PROFILE_SCOPE("gradient");
 		grad = TVector::Zero(x.size());
+		if (element_sweep_ && element_sweep_->is_active())
+			element_sweep_->first_derivative(x, grad);
 		for (auto &f : forms_)
 		{
-			if (!f->enabled())
+			if (!f->enabled() || in_element_sweep(*f))
 				continue;
 			TVector tmp;
 			f->first_derivative(x, tmp);
 			grad += tmp;
 		}
+
+		cache_gradient(x, grad);
+	}
+
+	bool FullNLProblem::in_element_sweep(const Form &form) const
+	{
+		return element_sweep_ && element_sweep_->contains(&form) && element_sweep_->is_active();
 	}
 
 	void FullNLProblem::hessian(const TVector &x, THessian &hessian)
 	{
-		hessian.resize(x.size(), x.size());
+		sum_hessians(x, x.size(), {}, hessian);
+	}
+
+	void FullNLProblem::gradient_and_hessian(const TVector &x, TVector &grad, THessian &hessian)
+	{
+		sum_hessians(x, x.size(), {}, hessian, &grad);
+	}
+
+	void FullNLProblem::sum_hessians(const TVector &x, const int reduced_size, const std::vector<int> &removed_vars, THessian &hessian, TVector *gradv)
+	{
+		POLYFEM_PROFILE_SCOPE("hessian");
+
+		// the gradient is computed by the forms together with their Hessian, unless it is memoized
+		TVector *grad = gradv != nullptr && !use_cached_gradient(x, *gradv) ? gradv : nullptr;
+		if (grad)
+			grad->setZero(x.size());
+		TVector tmp;
+
+		// Constant Hessians are summed in place with their scale, the others are assembled at x
+		std::vector<THessian> hessians;
+		hessians.reserve(forms_.size());
+		std::vector<const THessian *> summands;
+		std::vector<double> scales;
+		summands.reserve(forms_.size());
+		scales.reserve(forms_.size());
 		for (auto &f : forms_)
 		{
 			if (!f->enabled())
 				continue;
+
+			double scale;
+			const THessian *constant = f->constant_hessian(scale);
+			if (constant != nullptr && constant->rows() == x.size())
+			{
+				summands.push_back(constant);
+				scales.push_back(f->weight() * scale);
+				if (grad)
+				{
+					f->first_derivative(x, tmp);
+					*grad += tmp;
+				}
+				continue;
+			}
+
+			hessians.emplace_back();
+			f->value_and_derivatives(x, nullptr, grad ? &tmp : nullptr, &hessians.back());
+			if (grad)
+				*grad += tmp;
+			if (hessians.back().rows() == 0)
+				hessians.back().resize(x.size(), x.size());
+			hessians.back().makeCompressed();
+			summands.push_back(&hessians.back());
+			scales.push_back(1);
+		}
+
+		hessian_accumulator_.sum(summands, scales, x.size(), reduced_size, removed_vars, hessian);
+
+		if (grad)
+			cache_gradient(x, *grad);
+	}
+
+	void FullNLProblem::init_hessian_vector_product(const TVector &x)
+	{
+		assembled_hessian_.resize(x.size(), x.size());
+		assembled_hessian_.setZero();
+		for (auto &f : forms_)
+		{
+			if (!f->enabled() || f->has_matrix_free_hessian())
+				continue;
 			THessian tmp;
 			f->second_derivative(x, tmp);
-			hessian += tmp;
+			assembled_hessian_ += tmp;
+		}
+	}
+
+	void FullNLProblem::hessian_vector_product(const TVector &x, const TVector &v, TVector &out)
+	{
+		assert(assembled_hessian_.rows() == x.size());
+		out = assembled_hessian_ * v;
+		for (auto &f : forms_)
+		{
+			if (!f->enabled() || !f->has_matrix_free_hessian())
+				continue;
+			TVector tmp;
+			f->hessian_vector_product(x, v, tmp);
+			out += tmp;
+		}
+	}
+
+	void FullNLProblem::hessian_diagonal(const TVector &x, TVector &diag)
+	{
+		assert(assembled_hessian_.rows() == x.size());
+		diag = assembled_hessian_.diagonal();
+		for (auto &f : forms_)
+		{
+			if (!f->enabled() || !f->has_matrix_free_hessian())
+				continue;
+			TVector tmp;
+			f->hessian_diagonal(x, tmp);
+			diag += tmp;
 		}
 	}
 
 	void FullNLProblem::solution_changed(const TVector &x)
 	{
+		if (is_cached_solution(x))
+		{
+			++cache_hits_.solution_changes;
+			return;
+		}
+
 		for (auto &f : forms_)
 			f->solution_changed(x);
+
+		cached_x_ = x;
+		has_cached_x_ = true;
+		invalidate_cached_evaluations();
 	}
 
 	void FullNLProblem::post_step(const int iter_num, const TVector &x)
 	{
+		// the forms only change their weights (e.g., barrier stiffness), checked by the cache
 		for (auto &f : forms_)
 			f->post_step(iter_num, x);
 	}
+
+	void FullNLProblem::invalidate_cache()
+	{
+		has_cached_x_ = false;
+		invalidate_cached_evaluations();
+	}
+
+	void FullNLProblem::invalidate_cached_evaluations()
+	{
+		has_cached_value_ = false;
+		has_cached_gradient_ = false;
+		cached_weights_.clear();
+	}
+
+	bool FullNLProblem::is_cached_solution(const TVector &x) const
+	{
+		return has_cached_x_ && cached_x_.size() == x.size() && cached_x_ == x;
+	}
+
+	bool FullNLProblem::use_cached_gradient(const TVector &x, TVector &grad)
+	{
+		if (!is_cached_solution(x))
+			return false;
+
+		update_cached_weights();
+		if (!has_cached_gradient_)
+			return false;
+
+		++cache_hits_.gradients;
+		grad = cached_gradient_;
+		return true;
+	}
+
+	void FullNLProblem::cache_gradient(const TVector &x, const TVector &grad)
+	{
+		if (!is_cached_solution(x))
+			return;
+
+		cached_gradient_ = grad;
+		has_cached_gradient_ = true;
+	}
+
+	bool FullNLProblem::cached_weights_match() const
+	{
+		if (cached_weights_.size() != forms_.size())
+			return false;
+		for (size_t i = 0; i < forms_.size(); ++i)
+			if (cached_weights_[i] != (forms_[i]->enabled() ? forms_[i]->weight() : 0))
+				return false;
+		return true;
+	}
+
+	void FullNLProblem::update_cached_weights()
+	{
+		if (cached_weights_match())
+			return;
+
+		has_cached_value_ = false;
+		has_cached_gradient_ = false;
+		cached_weights_.resize(forms_.size());
+		for (size_t i = 0; i < forms_.size(); ++i)
+			cached_weights_[i] = forms_[i]->enabled() ? forms_[i]->weight() : 0;
+	}
 } // namespace polyfem::solver
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <polyfem/solver/forms/Form.hpp>
+#include <polyfem/utils/MatrixUtils.hpp>
 
 #include <cppoptlib/problem.h>
 
@@ -9,6 +10,8 @@
 
 namespace polyfem::solver
 {
+	class ElementSweep;
+
 	class FullNLProblem : public cppoptlib::Problem<double>
 	{
 	public:
@@ -20,8 +23,20 @@ namespace polyfem::solver
 		virtual void init(const TVector &x0);
 
 		virtual double value(const TVector &x) override;
+		/// @brief Values at several solutions, forms able to do so evaluate them in a single pass
+		/// @note The forms are left in the state of the last solution, call solution_changed before using the problem again
+		virtual void values(const std::vector<TVector> &xs, Eigen::VectorXd &vals);
 		virtual void gradient(const TVector &x, TVector &gradv) override;
 		virtual void hessian(const TVector &x, THessian &hessian);
+		/// @brief Gradient and Hessian at the same solution, the forms able to do so compute both in a single pass
+		virtual void gradient_and_hessian(const TVector &x, TVector &gradv, THessian &hessian);
+
+		/// @brief Prepare the Hessian-vector products at x, assembles the forms without a matrix-free Hessian
+		virtual void init_hessian_vector_product(const TVector &x);
+		/// @brief Product of the Hessian at x with v, requires init_hessian_vector_product(x)
+		virtual void hessian_vector_product(const TVector &x, const TVector &v, TVector &out);
+		/// @brief Diagonal of the Hessian at x, requires init_hessian_vector_product(x)
+		virtual void hessian_diagonal(const TVector &x, TVector &diag);
 
 		virtual bool is_step_valid(const TVector &x0, const TVector &x1) const;
 		virtual bool is_step_collision_free(const TVector &x0, const TVector &x1) const;
@@ -42,7 +57,68 @@ namespace polyfem::solver
 
 		std::vector<std::shared_ptr<Form>> &forms() { return forms_; }
 
+		/// @brief Evaluate the values and gradients of the forms registered to sweep in a single element loop, null to evaluate every form on its own
+		void set_element_sweep(const std::shared_ptr<ElementSweep> &sweep) { element_sweep_ = sweep; }
+
+		/// Number of queries answered from the memoized evaluations
+		struct CacheHits
+		{
+			long values = 0;
+			long gradients = 0;
+			long solution_changes = 0;
+		};
+		const CacheHits &cache_hits() const { return cache_hits_; }
+
+		/// @brief Forget the memoized evaluations, required when the forms are changed by other means than the weights or this problem
+		void invalidate_cache();
+
 	protected:
 		std::vector<std::shared_ptr<Form>> forms_;
+
+		/// Forms evaluated together by value and gradient, they are skipped in the loops over the forms
+		std::shared_ptr<ElementSweep> element_sweep_;
+
+		/// @brief Check if the form is evaluated by the active element sweep
+		bool in_element_sweep(const Form &form) const;
+
+		/// Sum of the Hessians of the forms without a matrix-free Hessian
+		THessian assembled_hessian_;
+
+		/// @brief Sum the Hessians of the enabled forms into a single pattern, dropping removed_vars rows and columns
+		/// @param[in] x Current full size solution
+		/// @param[in] reduced_size Size of the output, removed_vars is ignored if equal to x.size()
+		/// @param[in] removed_vars Sorted variables to drop
+		/// @param[out] hessian Output summed Hessian
+		/// @param[out] gradv Output full size gradient computed with the Hessians, skipped if null
+		void sum_hessians(const TVector &x, const int reduced_size, const std::vector<int> &removed_vars, THessian &hessian, TVector *gradv = nullptr);
+
+		/// Union pattern of the form Hessians, reused while the form patterns do not change
+		utils::SparseMatrixAccumulator hessian_accumulator_;
+
+		/// @brief Forget the memoized value and gradient but keep the solution of the forms
+		void invalidate_cached_evaluations();
+
+	private:
+		/// @brief Check if x is the solution the forms were last updated to in solution_changed
+		bool is_cached_solution(const TVector &x) const;
+		/// @brief Check if the memoized value and gradient were computed with the current enabled forms and weights
+		bool cached_weights_match() const;
+		/// @brief Keep the value and gradient only if they were computed with the current weights
+		void update_cached_weights();
+		/// @brief Copy the memoized gradient into grad if it was computed at x
+		bool use_cached_gradient(const TVector &x, TVector &grad);
+		/// @brief Memoize the gradient if x is the cached solution
+		void cache_gradient(const TVector &x, const TVector &grad);
+
+		/// Value, gradient and constraint set are memoized at the last solution passed to solution_changed
+		TVector cached_x_;
+		bool has_cached_x_ = false;
+		double cached_value_;
+		bool has_cached_value_ = false;
+		TVector cached_gradient_;
+		bool has_cached_gradient_ = false;
+		/// Weights of the forms (zero if disabled) used for the memoized value and gradient
+		std::vector<double> cached_weights_;
+		CacheHits cache_hits_;
 	};
 } // namespace polyfem::solver
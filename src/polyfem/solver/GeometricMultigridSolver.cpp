@@ -0,0 +1,284 @@
+#include "GeometricMultigridSolver.hpp"
+
+#include <polyfem/utils/Logger.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace polyfem::solver
+{
+	namespace
+	{
+		/// the linear coarse elements are simplices if they have dim + 1 bases, cubes otherwise
+		bool is_simplex(const basis::ElementBases &el, const int dim)
+		{
+			return int(el.bases.size()) == dim + 1;
+		}
+
+		bool is_inside_reference(const Eigen::RowVectorXd &uv, const bool simplex, const double tol)
+		{
+			if (simplex)
+				return uv.minCoeff() >= -tol && uv.sum() <= 1 + tol;
+			return uv.minCoeff() >= -tol && uv.maxCoeff() <= 1 + tol;
+		}
+
+		/// Inverts the geometric mapping of el at p with Newton iterations, false if they did not converge
+		bool reference_coordinates(const basis::ElementBases &el, const RowVectorNd &p, const bool simplex, const double tol, Eigen::MatrixXd &uv)
+		{
+			const int dim = p.size();
+			uv.setConstant(1, dim, simplex ? 1. / (dim + 1) : 0.5);
+
+			Eigen::MatrixXd mapped;
+			std::vector<Eigen::MatrixXd> grads;
+			for (int it = 0; it < 20; ++it)
+			{
+				el.eval_geom_mapping(uv, mapped);
+				const Eigen::RowVectorXd residual = mapped.row(0) - p;
+				if (residual.norm() < tol)
+					return true;
+
+				// grads[0](d, c) is the derivative of x_c with respect to uv_d
+				el.eval_geom_mapping_grads(uv, grads);
+				const Eigen::MatrixXd J = grads[0].transpose();
+
+				uv -= J.partialPivLu().solve(residual.transpose()).transpose();
+				if (!uv.allFinite())
+					return false;
+			}
+
+			el.eval_geom_mapping(uv, mapped);
+			return (mapped.row(0) - p).norm() < tol;
+		}
+
+		/// Uniform grid of the bounding boxes of the coarse elements
+		class ElementGrid
+		{
+		public:
+			ElementGrid(const std::vector<basis::ElementBases> &bases, const std::vector<Eigen::MatrixXd> &nodes)
+			{
+				const int dim = nodes.front().cols();
+				min_ = nodes.front().colwise().minCoeff();
+				Eigen::RowVectorXd max = nodes.front().colwise().maxCoeff();
+				for (const auto &n : nodes)
+				{
+					min_ = min_.cwiseMin(n.colwise().minCoeff());
+					max = max.cwiseMax(n.colwise().maxCoeff());
+				}
+
+				// about one element per cell
+				const double extent = (max - min_).maxCoeff();
+				const int n_per_dim = std::max(1, int(std::ceil(std::pow(double(bases.size()), 1. / dim))));
+				cell_size_ = std::max(extent, 1e-16) / n_per_dim;
+				eps_ = 1e-8 * extent;
+
+				res_.resize(dim);
+				for (int d = 0; d < dim; ++d)
+					res_[d] = std::max(1, int(std::ceil((max[d] - min_[d]) / cell_size_)));
+
+				int n_cells = 1;
+				for (int d = 0; d < dim; ++d)
+					n_cells *= res_[d];
+				cells_.resize(n_cells);
+
+				for (size_t e = 0; e < nodes.size(); ++e)
+				{
+					const Eigen::VectorXi lo = cell_coordinates(nodes[e].colwise().minCoeff().array() - eps_);
+					const Eigen::VectorXi hi = cell_coordinates(nodes[e].colwise().maxCoeff().array() + eps_);
+
+					Eigen::VectorXi c = lo;
+					while (true)
+					{
+						cells_[cell_index(c)].push_back(e);
+
+						int d = 0;
+						for (; d < dim; ++d)
+						{
+							if (++c[d] <= hi[d])
+								break;
+							c[d] = lo[d];
+						}
+						if (d == dim)
+							break;
+					}
+				}
+			}
+
+			const std::vector<int> &candidates(const Eigen::RowVectorXd &p) const
+			{
+				return cells_[cell_index(cell_coordinates(p))];
+			}
+
+		private:
+			Eigen::VectorXi cell_coordinates(const Eigen::RowVectorXd &p) const
+			{
+				Eigen::VectorXi c(res_.size());
+				for (int d = 0; d < res_.size(); ++d)
+					c[d] = std::clamp(int(std::floor((p[d] - min_[d]) / cell_size_)), 0, res_[d] - 1);
+				return c;
+			}
+
+			int cell_index(const Eigen::VectorXi &c) const
+			{
+				int index = 0;
+				for (int d = res_.size() - 1; d >= 0; --d)
+					index = index * res_[d] + c[d];
+				return index;
+			}
+
+			Eigen::RowVectorXd min_;
+			double cell_size_;
+			double eps_;
+			Eigen::VectorXi res_;
+			std::vector<std::vector<int>> cells_;
+		};
+	} // namespace
+
+	GeometricMultigridSolver::GeometricMultigridSolver(const json &linear_params)
+		: MultigridSolver(linear_params, linear_params["geometric_multigrid"])
+	{
+	}
+
+	bool GeometricMultigridSolver::is_enabled(const json &linear_params)
+	{
+		return linear_params.contains("geometric_multigrid") && linear_params["geometric_multigrid"].is_object() && linear_params["geometric_multigrid"]["enabled"].get<bool>();
+	}
+
+	std::vector<StiffnessMatrix> GeometricMultigridSolver::prolongations(
+		const mesh::Mesh &mesh,
+		const std::string &assembler,
+		const std::vector<basis::ElementBases> &bases,
+		const int n_bases,
+		const int problem_dim)
+	{
+		const auto &levels = mesh.refinement_levels();
+		if (levels.empty())
+			log_and_throw_error("Geometric multigrid needs the refinement levels of the mesh, set keep_refinement_levels in the advanced geometry settings");
+
+		const int n_levels = levels.size();
+		std::vector<StiffnessMatrix> res(n_levels);
+
+		// the bases of the coarser levels may refer to their mesh, both are kept until the end
+		std::vector<std::unique_ptr<mesh::Mesh>> level_meshes(n_levels);
+		std::vector<std::vector<basis::ElementBases>> level_bases(n_levels);
+
+		const std::vector<basis::ElementBases> *fine_bases = &bases;
+		int n_fine = n_bases;
+		for (int l = n_levels - 1; l >= 0; --l)
+		{
+			level_meshes[l] = mesh::Mesh::create(levels[l].vertices, levels[l].cells);
+			const int n_coarse = build_linear_bases(*level_meshes[l], assembler, level_bases[l]);
+
+			// the finest level comes first, every level has problem_dim dofs per basis
+			res[n_levels - 1 - l] = interpolation(level_bases[l], n_coarse, *fine_bases, n_fine, problem_dim);
+			logger().debug("Geometric multigrid level {}: {} bases", n_levels - l, n_coarse);
+
+			fine_bases = &level_bases[l];
+			n_fine = n_coarse;
+		}
+
+		return res;
+	}
+
+	StiffnessMatrix GeometricMultigridSolver::interpolation(
+		const std::vector<basis::ElementBases> &coarse_bases,
+		const int n_coarse,
+		const std::vector<basis::ElementBases> &fine_bases,
+		const int n_fine,
+		const int problem_dim)
+	{
+		if (coarse_bases.empty() || fine_bases.empty())
+			log_and_throw_error("Geometric multigrid needs non-empty coarse and fine meshes");
+
+		std::vector<Eigen::MatrixXd> coarse_nodes(coarse_bases.size());
+		for (size_t e = 0; e < coarse_bases.size(); ++e)
+		{
+			if (!coarse_bases[e].has_parameterization)
+				log_and_throw_error("Geometric multigrid needs parametric bases, coarse element {} has none", e);
+			coarse_nodes[e] = coarse_bases[e].nodes();
+		}
+		const int dim = coarse_nodes.front().cols();
+		const ElementGrid grid(coarse_bases, coarse_nodes);
+
+		std::vector<bool> assigned(n_fine, false);
+		std::vector<Eigen::Triplet<double>> triplets;
+
+		int n_unlocated = 0;
+		Eigen::MatrixXd uv;
+		std::vector<assembler::AssemblyValues> coarse_vals;
+		for (size_t e = 0; e < fine_bases.size(); ++e)
+		{
+			const basis::ElementBases &fine = fine_bases[e];
+
+			bool has_new_dof = false;
+			for (const auto &b : fine.bases)
+			{
+				if (b.global().size() == 1 && !assigned[b.global()[0].index])
+					has_new_dof = true;
+			}
+			if (!has_new_dof)
+				continue;
+
+			// the center of a fine element is inside its parent only, unlike its nodes
+			const Eigen::MatrixXd fine_nodes = fine.nodes();
+			const RowVectorNd center = fine_nodes.colwise().mean();
+			const double tol = 1e-10 * (fine_nodes.colwise().maxCoeff() - fine_nodes.colwise().minCoeff()).norm();
+
+			int parent = -1;
+			bool parent_simplex = false;
+			for (const int c : grid.candidates(center))
+			{
+				const bool simplex = is_simplex(coarse_bases[c], dim);
+				if (reference_coordinates(coarse_bases[c], center, simplex, tol, uv) && is_inside_reference(uv.row(0), simplex, 1e-8))
+				{
+					parent = c;
+					parent_simplex = simplex;
+					break;
+				}
+			}
+			if (parent < 0)
+			{
+				++n_unlocated;
+				continue;
+			}
+			const basis::ElementBases &coarse = coarse_bases[parent];
+
+			for (size_t j = 0; j < fine.bases.size(); ++j)
+			{
+				// constrained (hanging) nodes are not dofs
+				const auto &fine_global = fine.bases[j].global();
+				if (fine_global.size() != 1 || assigned[fine_global[0].index])
+					continue;
+
+				if (!reference_coordinates(coarse, fine_global[0].node, parent_simplex, tol, uv))
+					log_and_throw_error("Geometric multigrid: unable to map the node {} to its parent element {}", fine_global[0].index, parent);
+
+				const int row = fine_global[0].index;
+				assigned[row] = true;
+
+				coarse.evaluate_bases(uv, coarse_vals);
+				for (size_t k = 0; k < coarse_vals.size(); ++k)
+				{
+					const double v = coarse_vals[k].val(0) / fine_global[0].val;
+					if (std::abs(v) < 1e-12)
+						continue;
+					for (const auto &g : coarse.bases[k].global())
+					{
+						for (int d = 0; d < problem_dim; ++d)
+							triplets.emplace_back(row * problem_dim + d, g.index * problem_dim + d, v * g.val);
+					}
+				}
+			}
+		}
+
+		if (n_unlocated > 0)
+			logger().warn("Geometric multigrid interpolation: {} fine elements are outside of the coarse mesh", n_unlocated);
+		const int n_missing = std::count(assigned.begin(), assigned.end(), false);
+		if (n_missing > 0)
+			logger().warn("Geometric multigrid interpolation: {} fine bases are not interpolated from the coarse ones", n_missing);
+
+		StiffnessMatrix P(n_fine * problem_dim, n_coarse * problem_dim);
+		P.setFromTriplets(triplets.begin(), triplets.end());
+		P.makeCompressed();
+		return P;
+	}
+} // namespace polyfem::solver
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "MultigridSolver.hpp"
+
+namespace polyfem::solver
+{
+	/// @brief Geometric multigrid over the uniform refinements of the mesh
+	/// The coarse levels are the P1/Q1 bases of the meshes kept before each refinement (see Mesh::refinement_levels),
+	/// the prolongations interpolate the coarse bases at the nodes of the finer ones located in their parent element.
+	class GeometricMultigridSolver : public MultigridSolver
+	{
+	public:
+		/// @param[in] linear_params settings of the linear solver (/solver/linear), the multigrid settings are in "geometric_multigrid"
+		GeometricMultigridSolver(const json &linear_params);
+
+		/// @brief Prolongations of the refinement hierarchy, finest first
+		/// @param[in] mesh refined mesh, with its refinement levels
+		/// @param[in] assembler name of the assembler
+		/// @param[in] bases bases of the refined mesh (Lagrange of any order)
+		/// @param[in] n_bases number of bases
+		/// @param[in] problem_dim number of dofs per basis, the prolongations are repeated for every component
+		/// @return one prolongation per refinement level, see MultigridSolver::set_prolongations
+		static std::vector<StiffnessMatrix> prolongations(
+			const mesh::Mesh &mesh,
+			const std::string &assembler,
+			const std::vector<basis::ElementBases> &bases,
+			const int n_bases,
+			const int problem_dim);
+
+		/// @brief Interpolation of the coarse bases at the nodes of the fine bases, the fine mesh must be nested in the coarse one
+		/// Every fine element is located in its parent from its center, its nodes are mapped to the reference parent.
+		/// @param[in] coarse_bases Lagrange bases of the coarse mesh
+		/// @param[in] n_coarse number of coarse bases
+		/// @param[in] fine_bases Lagrange bases of the fine mesh
+		/// @param[in] n_fine number of fine bases
+		/// @param[in] problem_dim number of dofs per basis
+		/// @return (n_fine * problem_dim) x (n_coarse * problem_dim) prolongation
+		static StiffnessMatrix interpolation(
+			const std::vector<basis::ElementBases> &coarse_bases,
+			const int n_coarse,
+			const std::vector<basis::ElementBases> &fine_bases,
+			const int n_fine,
+			const int problem_dim);
+
+		/// @brief Geometric multigrid settings are enabled in the linear solver settings
+		static bool is_enabled(const json &linear_params);
+	};
+} // namespace polyfem::solver
@@ -1,4 +1,4 @@
-// L-BFGS solver (Using the LBFGSpp under MIT License).
+// L-BFGS solver (two-loop recursion adapted from LBFGSpp under MIT License).
 
 #pragma once
 
@@ -11,8 +11,6 @@
 
 #include <igl/Timer.h>
 
-#include <LBFGSpp/BFGSMat.h>
-
 namespace cppoptlib
 {
 	template <typename ProblemType>
@@ -43,7 +41,19 @@ namespace cppoptlib
 			const TVector &grad,
 			TVector &direction) override;
 
-		LBFGSpp::BFGSMat<Scalar> m_bfgs; // Approximation to the Hessian matrix
+		/// Add the pair s = x_{i+1} - x_i, y = g_{i+1} - g_i to the history, skipped without positive curvature
+		void add_correction(const TVector &x, const TVector &grad);
+
+		/// Two-loop recursion computing H * v, with H the inverse Hessian approximation
+		void apply_inverse_hessian(const TVector &v, TVector &out);
+
+		/// Apply the initial metric H0 to v in place
+		void apply_initial_metric(TVector &v) const;
+
+		/// Inverse of the Hessian diagonal at x for the initial metric
+		void update_diagonal_metric(ProblemType &objFunc, const TVector &x);
+
+		void update_solver_info() override;
 
 		/// The number of corrections to approximate the inverse Hessian matrix.
 		/// The L-BFGS routine stores the computation results of previous \ref m
@@ -53,6 +63,20 @@ namespace cppoptlib
 		/// not recommended. Large values will result in excessive computing time.
 		int m_history_size = 6;
 
+		Eigen::MatrixXd m_s; // History of the s vectors, circular over the columns
+		Eigen::MatrixXd m_y; // History of the y vectors, circular over the columns
+		TVector m_ys;        // sᵀy of the history
+		TVector m_alpha;     // First loop coefficients
+		int m_ncorr = 0;     // Number of corrections in the history
+		int m_ptr = 0;       // Column of the next correction
+		double m_theta = 1;  // Scalar initial metric H0 = I / theta, theta = yᵀy / sᵀy of the last correction
+
+		bool m_diagonal_metric = false;  // Whether H0 is the inverse Hessian diagonal
+		int m_metric_update_interval;    // Iterations between two updates of the diagonal
+		int m_metric_age = 0;            // Iterations since the last update of the diagonal
+		int m_n_metric_updates = 0;      // Number of diagonal updates since the last reset
+		TVector m_inv_diag;              // Inverse Hessian diagonal, 0 where the diagonal is not positive
+
 		TVector m_prev_x;    // Previous x
 		TVector m_prev_grad; // Previous gradient
 	};
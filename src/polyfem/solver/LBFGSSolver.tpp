@@ -1,4 +1,4 @@
-// L-BFGS solver (Using the LBFGSpp under MIT License).
+// L-BFGS solver (two-loop recursion adapted from LBFGSpp under MIT License).
 
 #pragma once
 
@@ -10,6 +10,9 @@ namespace cppoptlib
 	LBFGSSolver<ProblemType>::LBFGSSolver(const json &solver_params, const double dt)
 		: Superclass(solver_params, dt)
 	{
+		const json &lbfgs_params = solver_params["lbfgs"];
+		m_diagonal_metric = lbfgs_params["initial_metric"] == "diagonal";
+		m_metric_update_interval = lbfgs_params["metric_update_interval"];
 	}
 
 	template <typename ProblemType>
@@ -32,7 +35,9 @@ namespace cppoptlib
 		if (this->descent_strategy == 1)
 			this->descent_strategy++;
 
-		m_bfgs.reset(m_prev_x.size(), m_history_size);
+		m_ncorr = 0;
+		m_ptr = 0;
+		m_theta = 1;
 
 		assert(this->descent_strategy <= 2);
 	}
@@ -42,7 +47,17 @@ namespace cppoptlib
 	{
 		Superclass::reset(ndof);
 
-		m_bfgs.reset(ndof, m_history_size);
+		m_s.resize(ndof, m_history_size);
+		m_y.resize(ndof, m_history_size);
+		m_ys.resize(m_history_size);
+		m_alpha.resize(m_history_size);
+		m_ncorr = 0;
+		m_ptr = 0;
+		m_theta = 1;
+
+		m_inv_diag.resize(0);
+		m_metric_age = 0;
+		m_n_metric_updates = 0;
 
 		// Use gradient descent for first iteration
 		this->descent_strategy = 2;
@@ -55,22 +70,27 @@ namespace cppoptlib
 		const TVector &grad,
 		TVector &direction)
 	{
+		if (m_diagonal_metric && (m_inv_diag.size() != x.size() || m_metric_age >= m_metric_update_interval))
+			update_diagonal_metric(objFunc, x);
+		++m_metric_age;
+
 		if (this->descent_strategy == 2)
 		{
-			// Use gradient descent in the first iteration or if the previous iteration failed
+			// Use gradient descent in the first iteration or if the previous iteration failed,
+			// scaled by the Hessian diagonal if available
 			direction = -grad;
+			if (m_diagonal_metric)
+				apply_initial_metric(direction);
 		}
 		else
 		{
-			// Update s and y
-			// s_{i+1} = x_{i+1} - x_i
-			// y_{i+1} = g_{i+1} - g_i
 			assert(m_prev_x.size() == x.size());
 			assert(m_prev_grad.size() == grad.size());
-			m_bfgs.add_correction(x - m_prev_x, grad - m_prev_grad);
+			add_correction(x, grad);
 
 			// Recursive formula to compute d = -H * g
-			m_bfgs.apply_Hv(grad, -Scalar(1), direction);
+			apply_inverse_hessian(grad, direction);
+			direction *= -1;
 		}
 
 		m_prev_x = x;
@@ -78,4 +98,103 @@ namespace cppoptlib
 
 		return true;
 	}
+
+	template <typename ProblemType>
+	void LBFGSSolver<ProblemType>::add_correction(const TVector &x, const TVector &grad)
+	{
+		// s_{i+1} = x_{i+1} - x_i
+		// y_{i+1} = g_{i+1} - g_i
+		m_s.col(m_ptr) = x - m_prev_x;
+		m_y.col(m_ptr) = grad - m_prev_grad;
+
+		const double ys = polyfem::utils::parallel_dot(m_s.col(m_ptr), m_y.col(m_ptr));
+		if (!(ys > 0))
+		{
+			// the approximation would not be positive definite anymore
+			polyfem::logger().trace("[{}] skipping correction without positive curvature (sᵀy={})", name(), ys);
+			return;
+		}
+
+		m_ys[m_ptr] = ys;
+		m_theta = polyfem::utils::parallel_dot(m_y.col(m_ptr), m_y.col(m_ptr)) / ys;
+
+		m_ptr = (m_ptr + 1) % m_history_size;
+		m_ncorr = std::min(m_ncorr + 1, m_history_size);
+	}
+
+	template <typename ProblemType>
+	void LBFGSSolver<ProblemType>::apply_inverse_hessian(const TVector &v, TVector &out)
+	{
+		const int m = m_history_size;
+		out = v;
+
+		// first loop, newest to oldest: alpha_i = s_iᵀq / s_iᵀy_i, q -= alpha_i y_i,
+		// each update is fused with the dot product of the next correction
+		if (m_ncorr > 0)
+		{
+			int j = (m_ptr + m - 1) % m;
+			double sq = polyfem::utils::parallel_dot(m_s.col(j), out);
+			for (int k = 0; k < m_ncorr; ++k)
+			{
+				m_alpha[j] = sq / m_ys[j];
+				const int next = (j + m - 1) % m;
+				if (k + 1 < m_ncorr)
+					sq = polyfem::utils::parallel_axpy_dot(-m_alpha[j], m_y.col(j), out, m_s.col(next));
+				else
+					polyfem::utils::parallel_axpy(-m_alpha[j], m_y.col(j), out);
+				j = next;
+			}
+		}
+
+		apply_initial_metric(out);
+
+		// second loop, oldest to newest: beta_i = y_iᵀr / s_iᵀy_i, r += (alpha_i - beta_i) s_i
+		if (m_ncorr > 0)
+		{
+			int j = (m_ptr + m - m_ncorr) % m;
+			double yr = polyfem::utils::parallel_dot(m_y.col(j), out);
+			for (int k = 0; k < m_ncorr; ++k)
+			{
+				const double beta = yr / m_ys[j];
+				const int next = (j + 1) % m;
+				if (k + 1 < m_ncorr)
+					yr = polyfem::utils::parallel_axpy_dot(m_alpha[j] - beta, m_s.col(j), out, m_y.col(next));
+				else
+					polyfem::utils::parallel_axpy(m_alpha[j] - beta, m_s.col(j), out);
+				j = next;
+			}
+		}
+	}
+
+	template <typename ProblemType>
+	void LBFGSSolver<ProblemType>::apply_initial_metric(TVector &v) const
+	{
+		if (m_diagonal_metric && m_inv_diag.size() == v.size())
+			// the scalar metric is used where the diagonal is not positive
+			v = (m_inv_diag.array() > 0).select(v.cwiseProduct(m_inv_diag), v / m_theta);
+		else
+			v /= m_theta;
+	}
+
+	template <typename ProblemType>
+	void LBFGSSolver<ProblemType>::update_diagonal_metric(ProblemType &objFunc, const TVector &x)
+	{
+		POLYFEM_SCOPED_TIMER("assembly time", this->assembly_time);
+
+		// the metric has to be positive definite
+		objFunc.set_project_to_psd(true);
+		objFunc.init_hessian_vector_product(x);
+		objFunc.hessian_diagonal(x, m_inv_diag);
+		m_inv_diag = (m_inv_diag.array() > 0).select(m_inv_diag.cwiseInverse(), 0);
+
+		m_metric_age = 0;
+		++m_n_metric_updates;
+	}
+
+	template <typename ProblemType>
+	void LBFGSSolver<ProblemType>::update_solver_info()
+	{
+		Superclass::update_solver_info();
+		this->solver_info["metric_updates"] = m_n_metric_updates;
+	}
 } // namespace cppoptlib
@@ -0,0 +1,115 @@
+#include "MergedMatrixCache.hpp"
+
+#include <polyfem/utils/Logger.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace polyfem::solver
+{
+	MergedMatrixCache::MergedMatrixCache(const StiffnessMatrix &constant)
+		: constant_(constant)
+	{
+		constant_.makeCompressed();
+	}
+
+	std::vector<int> MergedMatrixCache::zero_columns(const std::vector<int> &dirichlet_rows) const
+	{
+		std::vector<bool> is_dirichlet(constant_.rows(), false);
+		for (const int i : dirichlet_rows)
+			is_dirichlet[i] = true;
+
+		std::vector<bool> zero_col(constant_.cols(), true);
+		for (int i = 0; i < std::min(constant_.rows(), constant_.cols()); ++i)
+		{
+			if (is_dirichlet[i])
+				zero_col[i] = false;
+		}
+		for (int k = 0; k < constant_.outerSize(); ++k)
+		{
+			for (StiffnessMatrix::InnerIterator it(constant_, k); it; ++it)
+			{
+				if (!is_dirichlet[it.row()] && std::fabs(it.value()) > 1e-12)
+					zero_col[it.col()] = false;
+			}
+		}
+
+		std::vector<int> res;
+		for (int i = 0; i < zero_col.size(); ++i)
+		{
+			if (zero_col[i])
+				res.push_back(i);
+		}
+		return res;
+	}
+
+	void MergedMatrixCache::add(const StiffnessMatrix &block, StiffnessMatrix &sum)
+	{
+		if (block.rows() > constant_.rows() || block.cols() > constant_.cols())
+			log_and_throw_error("Block of size {}x{} larger than the matrix {}x{}", block.rows(), block.cols(), constant_.rows(), constant_.cols());
+
+		if (!block.isCompressed())
+		{
+			StiffnessMatrix compressed = block;
+			compressed.makeCompressed();
+			add(compressed, sum);
+			return;
+		}
+
+		if (!same_pattern(block))
+			update_pattern(block);
+
+		Eigen::Map<Eigen::VectorXd> values(sum_.valuePtr(), sum_.nonZeros());
+		values = constant_values_;
+		const double *block_values = block.valuePtr();
+		for (int i = 0; i < slots_.size(); ++i)
+			values[slots_[i]] += block_values[i];
+
+		// copy, the solvers can modify the matrix (e.g., for the Dirichlet nodes)
+		sum = sum_;
+	}
+
+	bool MergedMatrixCache::same_pattern(const StiffnessMatrix &block) const
+	{
+		if (block.rows() != block_rows_ || block.cols() != block_cols_ || block.nonZeros() != block_inner_.size())
+			return false;
+
+		return std::equal(block_outer_.begin(), block_outer_.end(), block.outerIndexPtr())
+			   && std::equal(block_inner_.begin(), block_inner_.end(), block.innerIndexPtr());
+	}
+
+	void MergedMatrixCache::update_pattern(const StiffnessMatrix &block)
+	{
+		// union of the patterns, the explicit zeros of the embedded block are kept by the sum
+		StiffnessMatrix embedded = block;
+		embedded.conservativeResize(constant_.rows(), constant_.cols());
+		embedded.makeCompressed();
+		std::fill(embedded.valuePtr(), embedded.valuePtr() + embedded.nonZeros(), 0.);
+
+		sum_ = constant_ + embedded;
+		sum_.makeCompressed();
+		constant_values_ = Eigen::Map<const Eigen::VectorXd>(sum_.valuePtr(), sum_.nonZeros());
+
+		// both inner index lists are sorted
+		slots_.resize(block.nonZeros());
+		for (int k = 0; k < block.outerSize(); ++k)
+		{
+			int s = sum_.outerIndexPtr()[k];
+			for (int i = block.outerIndexPtr()[k]; i < block.outerIndexPtr()[k + 1]; ++i)
+			{
+				while (sum_.innerIndexPtr()[s] != block.innerIndexPtr()[i])
+					++s;
+				assert(s < sum_.outerIndexPtr()[k + 1]);
+				slots_[i] = s;
+			}
+		}
+
+		block_outer_.assign(block.outerIndexPtr(), block.outerIndexPtr() + block.outerSize() + 1);
+		block_inner_.assign(block.innerIndexPtr(), block.innerIndexPtr() + block.nonZeros());
+		block_rows_ = block.rows();
+		block_cols_ = block.cols();
+
+		++n_pattern_updates_;
+		logger().trace("Merged matrix pattern updated, {} nonzeros", sum_.nonZeros());
+	}
+} // namespace polyfem::solver
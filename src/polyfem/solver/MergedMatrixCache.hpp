@@ -0,0 +1,58 @@
+#pragma once
+
+#include <polyfem/utils/Types.hpp>
+
+#include <Eigen/Dense>
+
+#include <vector>
+
+namespace polyfem::solver
+{
+	/// @brief Sum of a constant matrix and a varying top-left block, e.g., the merged Stokes matrix and the convective
+	/// Jacobian of Navier-Stokes. The pattern of the sum and the position of every entry of the block in it are computed
+	/// once and recomputed only when the pattern of the block changes, so every sum is a copy of the constant values
+	/// and a scatter of the block values.
+	class MergedMatrixCache
+	{
+	public:
+		/// @param[in] constant constant matrix (e.g., the output of AssemblerUtils::merge_mixed_matrices)
+		explicit MergedMatrixCache(const StiffnessMatrix &constant);
+
+		/// @brief Constant matrix
+		const StiffnessMatrix &constant() const { return constant_; }
+
+		/// @brief Columns of the constant matrix with no entry larger than 1e-12 in absolute value once the Dirichlet rows
+		/// are replaced by rows of the identity (as done by the Dirichlet solves)
+		/// @param[in] dirichlet_rows rows replaced by rows of the identity
+		std::vector<int> zero_columns(const std::vector<int> &dirichlet_rows) const;
+
+		/// @brief sum = constant + [block 0; 0 0]
+		/// @param[in] block top-left block, at most as large as the constant matrix
+		/// @param[out] sum sum of the matrices
+		void add(const StiffnessMatrix &block, StiffnessMatrix &sum);
+
+		/// @brief Number of times the pattern of the sum has been computed
+		int n_pattern_updates() const { return n_pattern_updates_; }
+
+	private:
+		bool same_pattern(const StiffnessMatrix &block) const;
+		void update_pattern(const StiffnessMatrix &block);
+
+		StiffnessMatrix constant_;
+
+		/// pattern of the sum, its values are the ones of the last sum
+		StiffnessMatrix sum_;
+		/// values of the constant matrix in the pattern of the sum
+		Eigen::VectorXd constant_values_;
+		/// position in the values of the sum of every value of the block
+		std::vector<int> slots_;
+
+		/// pattern of the block used to compute the slots
+		std::vector<StiffnessMatrix::StorageIndex> block_outer_;
+		std::vector<StiffnessMatrix::StorageIndex> block_inner_;
+		Eigen::Index block_rows_ = -1;
+		Eigen::Index block_cols_ = -1;
+
+		int n_pattern_updates_ = 0;
+	};
+} // namespace polyfem::solver
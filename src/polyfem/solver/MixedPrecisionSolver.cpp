@@ -0,0 +1,226 @@
+#include "MixedPrecisionSolver.hpp"
+
+#include <polyfem/utils/Logger.hpp>
+
+#include <cmath>
+#include <stdexcept>
+
+namespace polyfem::solver
+{
+	std::unique_ptr<polysolve::LinearSolver> MixedPrecisionSolver::create(const json &linear_params)
+	{
+		if (is_enabled(linear_params))
+			return std::make_unique<MixedPrecisionSolver>();
+		return polysolve::LinearSolver::create(linear_params["solver"], linear_params["precond"]);
+	}
+
+	bool MixedPrecisionSolver::is_enabled(const json &linear_params)
+	{
+		return linear_params.contains("mixed_precision") && linear_params["mixed_precision"].is_object() && linear_params["mixed_precision"]["enabled"].get<bool>();
+	}
+
+	void MixedPrecisionSolver::setParameters(const json &params)
+	{
+		if (!params.contains("mixed_precision"))
+			return;
+
+		const json &mixed = params["mixed_precision"];
+		tolerance_ = mixed.value("tolerance", tolerance_);
+		max_refinement_steps_ = mixed.value("max_refinement_steps", max_refinement_steps_);
+		max_gmres_iter_ = mixed.value("max_gmres_iter", max_gmres_iter_);
+		restart_ = mixed.value("restart", restart_);
+
+		if (restart_ <= 0)
+			log_and_throw_error("Invalid GMRES restart {}", restart_);
+	}
+
+	bool MixedPrecisionSolver::is_symmetric(const StiffnessMatrix &A)
+	{
+		if (A.rows() != A.cols())
+			return false;
+		const StiffnessMatrix At = A.transpose();
+		return (A - At).norm() <= 1e-12 * A.norm();
+	}
+
+	MixedPrecisionSolver::SparseMatrixf MixedPrecisionSolver::scaled_single_precision(const StiffnessMatrix &A) const
+	{
+		SparseMatrixf res = A.cast<float>();
+		for (int k = 0; k < A.outerSize(); ++k)
+		{
+			SparseMatrixf::InnerIterator it_f(res, k);
+			for (StiffnessMatrix::InnerIterator it(A, k); it; ++it, ++it_f)
+				it_f.valueRef() = float(it.value() * inv_sqrt_diagonal_[it.row()] * inv_sqrt_diagonal_[it.col()]);
+		}
+		return res;
+	}
+
+	void MixedPrecisionSolver::analyzePattern(const StiffnessMatrix &A, const int precond_num)
+	{
+		// the values only decide the factorization, the scaling keeps the pattern
+		symmetric_ = is_symmetric(A);
+		const SparseMatrixf Af = A.cast<float>();
+		if (symmetric_)
+			ldlt_.analyzePattern(Af);
+		else
+			lu_.analyzePattern(Af);
+		analyzed_ = true;
+	}
+
+	void MixedPrecisionSolver::factorize(const StiffnessMatrix &A)
+	{
+		if (!analyzed_ || is_symmetric(A) != symmetric_)
+			analyzePattern(A, A.rows());
+
+		A_ = A;
+
+		// the diagonal scaling keeps the entries in the range of single precision
+		inv_sqrt_diagonal_.resize(A.rows());
+		for (int i = 0; i < A.rows(); ++i)
+		{
+			const double d = std::abs(A.coeff(i, i));
+			inv_sqrt_diagonal_[i] = d > 0 ? 1 / std::sqrt(d) : 1;
+		}
+
+		const SparseMatrixf Af = scaled_single_precision(A);
+		if (symmetric_)
+		{
+			ldlt_.factorize(Af);
+			if (ldlt_.info() != Eigen::Success)
+				throw std::runtime_error("Single precision LDLT factorization failed");
+		}
+		else
+		{
+			lu_.factorize(Af);
+			if (lu_.info() != Eigen::Success)
+				throw std::runtime_error("Single precision LU factorization failed: " + lu_.lastErrorMessage());
+		}
+	}
+
+	void MixedPrecisionSolver::solve_factorized(const Eigen::VectorXd &r, Eigen::VectorXd &z) const
+	{
+		const Eigen::VectorXf rf = r.cwiseProduct(inv_sqrt_diagonal_).cast<float>();
+		const Eigen::VectorXf zf = symmetric_ ? Eigen::VectorXf(ldlt_.solve(rf)) : Eigen::VectorXf(lu_.solve(rf));
+		z = zf.cast<double>().cwiseProduct(inv_sqrt_diagonal_);
+	}
+
+	int MixedPrecisionSolver::gmres(const Eigen::VectorXd &b, const double target, Eigen::VectorXd &x, double &res) const
+	{
+		const int n = b.size();
+		Eigen::MatrixXd V(n, restart_ + 1);
+		Eigen::MatrixXd H = Eigen::MatrixXd::Zero(restart_ + 1, restart_);
+		Eigen::VectorXd cs(restart_), sn(restart_), g(restart_ + 1);
+		Eigen::VectorXd w, z;
+
+		Eigen::VectorXd r = b - A_ * x;
+		res = r.norm();
+		int it = 0;
+
+		while (res > target && it < max_gmres_iter_)
+		{
+			V.col(0) = r / res;
+			g.setZero();
+			g[0] = res;
+			H.setZero();
+
+			int k = 0;
+			while (k < restart_ && it < max_gmres_iter_)
+			{
+				solve_factorized(V.col(k), z);
+				w = A_ * z;
+
+				// modified Gram-Schmidt
+				for (int i = 0; i <= k; ++i)
+				{
+					H(i, k) = w.dot(V.col(i));
+					w -= H(i, k) * V.col(i);
+				}
+				const double h_next = w.norm();
+				H(k + 1, k) = h_next;
+				if (h_next > 0)
+					V.col(k + 1) = w / h_next;
+
+				for (int i = 0; i < k; ++i)
+				{
+					const double tmp = cs[i] * H(i, k) + sn[i] * H(i + 1, k);
+					H(i + 1, k) = -sn[i] * H(i, k) + cs[i] * H(i + 1, k);
+					H(i, k) = tmp;
+				}
+				const double rho = std::hypot(H(k, k), H(k + 1, k));
+				cs[k] = rho > 0 ? H(k, k) / rho : 1;
+				sn[k] = rho > 0 ? H(k + 1, k) / rho : 0;
+				H(k, k) = rho;
+				H(k + 1, k) = 0;
+				g[k + 1] = -sn[k] * g[k];
+				g[k] *= cs[k];
+
+				++k;
+				++it;
+				if (std::abs(g[k]) <= target || h_next == 0)
+					break;
+			}
+
+			// the preconditioner is fixed, the correction is M^-1 V y
+			const Eigen::VectorXd y = H.topLeftCorner(k, k).triangularView<Eigen::Upper>().solve(g.head(k));
+			solve_factorized(V.leftCols(k) * y, z);
+			x += z;
+
+			r = b - A_ * x;
+			res = r.norm();
+		}
+
+		return it;
+	}
+
+	void MixedPrecisionSolver::solve(const Eigen::Ref<const Eigen::VectorXd> b, Eigen::Ref<Eigen::VectorXd> x)
+	{
+		assert(b.size() == A_.rows());
+
+		const Eigen::VectorXd rhs = b;
+		const double b_norm = rhs.norm();
+		const double target = tolerance_ * (b_norm > 0 ? b_norm : 1);
+
+		Eigen::VectorXd sol, correction;
+		solve_factorized(rhs, sol);
+
+		// iterative refinement, the residuals are in double precision
+		Eigen::VectorXd r = rhs - A_ * sol;
+		double res = r.norm();
+		int steps = 0;
+		while (res > target && steps < max_refinement_steps_)
+		{
+			solve_factorized(r, correction);
+			sol += correction;
+			++steps;
+
+			const double prev_res = res;
+			r = rhs - A_ * sol;
+			res = r.norm();
+			if (!std::isfinite(res) || res > stagnation_ratio * prev_res)
+				break;
+		}
+
+		int gmres_iter = 0;
+		if (!std::isfinite(res))
+		{
+			// the refinement diverged, GMRES restarts from the first solve
+			solve_factorized(rhs, sol);
+			res = (rhs - A_ * sol).norm();
+		}
+		if (res > target)
+			gmres_iter = gmres(rhs, target, sol, res);
+
+		x = sol;
+
+		info_ = json::object();
+		info_["solver"] = name();
+		info_["factorization"] = symmetric_ ? "SimplicialLDLT<float>" : "SparseLU<float>";
+		info_["refinement_steps"] = steps;
+		info_["gmres_iterations"] = gmres_iter;
+		info_["error"] = res / (b_norm > 0 ? b_norm : 1);
+
+		if (res > target)
+			logger().warn("Mixed precision solver did not converge, relative residual {}", res / (b_norm > 0 ? b_norm : 1));
+		else
+			logger().trace("Mixed precision solver converged in {} refinement steps and {} GMRES iterations", steps, gmres_iter);
+	}
+} // namespace polyfem::solver
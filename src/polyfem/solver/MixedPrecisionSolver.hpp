@@ -0,0 +1,82 @@
+#pragma once
+
+#include <polyfem/Common.hpp>
+#include <polyfem/utils/Types.hpp>
+
+#include <polysolve/LinearSolver.hpp>
+
+#include <Eigen/Sparse>
+#include <Eigen/SparseCholesky>
+#include <Eigen/SparseLU>
+
+#include <memory>
+#include <string>
+
+namespace polyfem::solver
+{
+	/// @brief Direct solver factorizing a single precision copy of the matrix, the solution is recovered in double precision
+	/// The matrix is scaled by its diagonal, D^-1/2 A D^-1/2, and factorized in float with LDLT if it is symmetric and
+	/// LU otherwise (e.g., with the identity Dirichlet rows of dirichlet_solve). The solve runs a few steps of iterative
+	/// refinement with double residuals and continues with GMRES preconditioned by the factorization if they stagnate,
+	/// which happens for matrices too ill-conditioned for single precision.
+	/// It is a polysolve::LinearSolver, it can replace the linear solver of dirichlet_solve and of the Newton solvers.
+	class MixedPrecisionSolver : public polysolve::LinearSolver
+	{
+	public:
+		MixedPrecisionSolver() = default;
+
+		/// @brief Mixed precision solver if it is enabled in the linear solver settings, the polysolve solver otherwise
+		/// @param[in] linear_params settings of the linear solver (/solver/linear)
+		static std::unique_ptr<polysolve::LinearSolver> create(const json &linear_params);
+
+		/// @brief Mixed precision settings are enabled in the linear solver settings
+		static bool is_enabled(const json &linear_params);
+
+		/// @param[in] params settings of the linear solver (/solver/linear), the mixed precision settings are in "mixed_precision"
+		void setParameters(const json &params) override;
+
+		/// @brief Factorization, refinement steps, GMRES iterations, and relative residual of the last solve
+		void getInfo(json &params) const override { params = info_; }
+
+		using polysolve::LinearSolver::analyzePattern;
+		using polysolve::LinearSolver::factorize;
+
+		void analyzePattern(const StiffnessMatrix &A, const int precond_num) override;
+		void factorize(const StiffnessMatrix &A) override;
+
+		/// @brief Solves the factorized system, x is ignored on input
+		void solve(const Eigen::Ref<const Eigen::VectorXd> b, Eigen::Ref<Eigen::VectorXd> x) override;
+
+		std::string name() const override { return "MixedPrecision"; }
+
+	private:
+		using SparseMatrixf = Eigen::SparseMatrix<float, Eigen::ColMajor>;
+
+		/// z ~ A^-1 r with the single precision factorization
+		void solve_factorized(const Eigen::VectorXd &r, Eigen::VectorXd &z) const;
+
+		/// Right preconditioned restarted GMRES from x, returns the number of iterations
+		int gmres(const Eigen::VectorXd &b, const double target, Eigen::VectorXd &x, double &res) const;
+
+		static bool is_symmetric(const StiffnessMatrix &A);
+		SparseMatrixf scaled_single_precision(const StiffnessMatrix &A) const;
+
+		static constexpr double stagnation_ratio = 0.5; ///< Refinement stops if a step reduces the residual less than this
+
+		double tolerance_ = 1e-10;
+		int max_refinement_steps_ = 10;
+		int max_gmres_iter_ = 100;
+		int restart_ = 30;
+
+		bool analyzed_ = false;
+		bool symmetric_ = true;
+		Eigen::VectorXd inv_sqrt_diagonal_;
+
+		/// double precision matrix for the residuals
+		StiffnessMatrix A_;
+		Eigen::SimplicialLDLT<SparseMatrixf> ldlt_;
+		Eigen::SparseLU<SparseMatrixf> lu_;
+
+		json info_;
+	};
+} // namespace polyfem::solver
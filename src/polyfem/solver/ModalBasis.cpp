@@ -0,0 +1,171 @@
+#include "ModalBasis.hpp"
+
+#include <polyfem/utils/Logger.hpp>
+
+#include <polysolve/LinearSolver.hpp>
+
+#include <Eigen/Eigenvalues>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+
+namespace polyfem::solver
+{
+	ModalBasis::ModalBasis(
+		const StiffnessMatrix &stiffness,
+		const StiffnessMatrix &mass,
+		const std::vector<int> &boundary_nodes,
+		const int n_modes,
+		const double shift,
+		const double tolerance,
+		const json &linear_params,
+		const int precond_num)
+		: mass_(mass)
+	{
+		const int n = stiffness.rows();
+		if (stiffness.cols() != n || mass.rows() != n || mass.cols() != n)
+			log_and_throw_error("Modal basis: stiffness {}x{} and mass {}x{} do not match", stiffness.rows(), stiffness.cols(), mass.rows(), mass.cols());
+		if (n_modes <= 0)
+			log_and_throw_error("Modal basis: invalid number of modes {}", n_modes);
+
+		std::vector<bool> is_free(n, true);
+		for (const int i : boundary_nodes)
+			is_free[i] = false;
+		const int n_free = std::count(is_free.begin(), is_free.end(), true);
+		const int k = std::min(n_modes, n_free);
+
+		// K - shift M restricted to the free dofs, the Dirichlet dofs are rows and columns of the identity
+		const StiffnessMatrix shifted = stiffness - shift * mass;
+		std::vector<Eigen::Triplet<double>> triplets;
+		triplets.reserve(shifted.nonZeros() + boundary_nodes.size());
+		for (int j = 0; j < shifted.outerSize(); ++j)
+		{
+			for (StiffnessMatrix::InnerIterator it(shifted, j); it; ++it)
+			{
+				if (is_free[it.row()] && is_free[it.col()])
+					triplets.emplace_back(it.row(), it.col(), it.value());
+			}
+		}
+		for (int i = 0; i < n; ++i)
+		{
+			if (!is_free[i])
+				triplets.emplace_back(i, i, 1.);
+		}
+		StiffnessMatrix A(n, n);
+		A.setFromTriplets(triplets.begin(), triplets.end());
+
+		auto solver = polysolve::LinearSolver::create(linear_params["solver"], linear_params["precond"]);
+		solver->setParameters(linear_params);
+		solver->analyzePattern(A, precond_num);
+		solver->factorize(A);
+
+		const auto m_dot = [&](const Eigen::VectorXd &a, const Eigen::VectorXd &b) { return a.dot(mass * b); };
+		const auto free_part = [&](Eigen::VectorXd &v) {
+			for (int i = 0; i < n; ++i)
+			{
+				if (!is_free[i])
+					v[i] = 0;
+			}
+		};
+
+		// Lanczos basis (M-orthonormal), M times the basis, and the tridiagonal matrix
+		std::vector<Eigen::VectorXd> V, MV;
+		std::vector<double> alpha, beta;
+
+		// fixed seed, the modes are the same at every run
+		std::mt19937 gen(0);
+		std::uniform_real_distribution<double> dist(-1, 1);
+		Eigen::VectorXd v(n);
+		for (int i = 0; i < n; ++i)
+			v[i] = dist(gen);
+		free_part(v);
+		v /= std::sqrt(m_dot(v, v));
+
+		Eigen::VectorXd w, Mv, rhs;
+		Eigen::VectorXd theta;
+		Eigen::MatrixXd Y;
+		bool converged = false;
+
+		while (V.size() < n_free)
+		{
+			Mv = mass * v;
+			V.push_back(v);
+			MV.push_back(Mv);
+			const int j = V.size() - 1;
+
+			rhs = Mv;
+			free_part(rhs);
+			w.setZero(n);
+			solver->solve(rhs, w);
+			free_part(w);
+
+			alpha.push_back(w.dot(Mv));
+			w -= alpha.back() * v;
+			if (j > 0)
+				w -= beta.back() * V[j - 1];
+
+			// full reorthogonalization, twice is enough
+			for (int pass = 0; pass < 2; ++pass)
+			{
+				for (int i = 0; i <= j; ++i)
+					w -= MV[i].dot(w) * V[i];
+			}
+
+			const double b = std::sqrt(std::max(m_dot(w, w), 0.));
+			const int m = V.size();
+			const bool breakdown = b <= 1e-12 * std::abs(alpha.front());
+
+			if (m >= k && (m % 5 == 0 || breakdown || m == n_free))
+			{
+				Eigen::MatrixXd T = Eigen::MatrixXd::Zero(m, m);
+				for (int i = 0; i < m; ++i)
+				{
+					T(i, i) = alpha[i];
+					if (i + 1 < m)
+						T(i, i + 1) = T(i + 1, i) = beta[i];
+				}
+				// increasing eigenvalues, the largest theta are the eigenvalues closest to the shift
+				const Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> eig(T);
+				theta = eig.eigenvalues().reverse();
+				Y = eig.eigenvectors().rowwise().reverse();
+
+				converged = true;
+				for (int i = 0; i < k; ++i)
+				{
+					// residual of the Ritz pair of the shifted and inverted operator
+					if (theta[i] <= 0 || b * std::abs(Y(m - 1, i)) > tolerance * theta[i])
+						converged = false;
+				}
+			}
+
+			if (converged || breakdown)
+				break;
+
+			beta.push_back(b);
+			v = w / b;
+		}
+
+		n_iterations_ = V.size();
+		int n_found = 0;
+		while (n_found < std::min<int>(k, theta.size()) && theta[n_found] > 0)
+			++n_found;
+		if (!converged)
+			logger().warn("Modal basis: {} of {} modes after {} Lanczos iterations did not converge to {}", k, n_modes, n_iterations_, tolerance);
+		if (n_found < n_modes)
+			logger().warn("Modal basis: only {} of the {} requested modes", n_found, n_modes);
+
+		Eigen::MatrixXd basis(n, V.size());
+		for (int i = 0; i < V.size(); ++i)
+			basis.col(i) = V[i];
+
+		modes_ = basis * Y.leftCols(n_found);
+		eigenvalues_.resize(n_found);
+		for (int i = 0; i < n_found; ++i)
+			eigenvalues_[i] = shift + 1 / theta[i];
+
+		logger().debug("Modal basis: {} modes in {} Lanczos iterations, eigenvalues in [{}, {}]",
+					   n_found, n_iterations_, n_found > 0 ? eigenvalues_[0] : 0., n_found > 0 ? eigenvalues_[n_found - 1] : 0.);
+	}
+} // namespace polyfem::solver
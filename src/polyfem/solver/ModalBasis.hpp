@@ -0,0 +1,60 @@
+#pragma once
+
+#include <polyfem/Common.hpp>
+#include <polyfem/utils/Types.hpp>
+
+#include <Eigen/Dense>
+
+#include <vector>
+
+namespace polyfem::solver
+{
+	/// @brief Lowest eigenpairs of the generalized problem K phi = lambda M phi with phi = 0 on the Dirichlet dofs,
+	/// computed with shift-invert Lanczos: the Lanczos iteration runs on (K - shift M)^-1 M, self-adjoint in the
+	/// M inner product, with full reorthogonalization so that the Krylov basis stays M-orthonormal.
+	/// The modes are M-orthonormal (Phi^T M Phi = I, Phi^T K Phi = diag(lambda)), a linear elastodynamics
+	/// problem M a + K u = f projected on them is a set of decoupled scalar ODEs.
+	class ModalBasis
+	{
+	public:
+		/// @param[in] stiffness stiffness matrix K, symmetric
+		/// @param[in] mass mass matrix M, symmetric positive definite on the free dofs
+		/// @param[in] boundary_nodes Dirichlet dofs, the modes are zero on them
+		/// @param[in] n_modes number of eigenpairs, clamped to the number of free dofs
+		/// @param[in] shift eigenvalues closest to it (from above) are computed, K - shift M must be non singular
+		/// (e.g., a small negative shift for unconstrained bodies)
+		/// @param[in] tolerance relative residual of the Ritz pairs
+		/// @param[in] linear_params settings of the linear solver of K - shift M (/solver/linear)
+		/// @param[in] precond_num number of dofs for the preconditioner of the linear solver
+		ModalBasis(
+			const StiffnessMatrix &stiffness,
+			const StiffnessMatrix &mass,
+			const std::vector<int> &boundary_nodes,
+			const int n_modes,
+			const double shift,
+			const double tolerance,
+			const json &linear_params,
+			const int precond_num);
+
+		int n_modes() const { return modes_.cols(); }
+		/// @brief M-orthonormal modes, one per column
+		const Eigen::MatrixXd &modes() const { return modes_; }
+		/// @brief Eigenvalues (squared angular frequencies), in increasing order
+		const Eigen::VectorXd &eigenvalues() const { return eigenvalues_; }
+		/// @brief Number of Lanczos iterations (linear solves)
+		int n_iterations() const { return n_iterations_; }
+
+		/// @brief Modal coordinates of a field, Phi^T M u
+		Eigen::VectorXd project(const Eigen::VectorXd &u) const { return modes_.transpose() * (mass_ * u); }
+		/// @brief Modal load of a force vector, Phi^T f
+		Eigen::VectorXd project_load(const Eigen::VectorXd &f) const { return modes_.transpose() * f; }
+		/// @brief Field of modal coordinates, Phi q
+		Eigen::VectorXd expand(const Eigen::VectorXd &q) const { return modes_ * q; }
+
+	private:
+		StiffnessMatrix mass_;
+		Eigen::MatrixXd modes_;
+		Eigen::VectorXd eigenvalues_;
+		int n_iterations_ = 0;
+	};
+} // namespace polyfem::solver
@@ -0,0 +1,361 @@
+#include "MultigridSolver.hpp"
+
+#include <polyfem/basis/LagrangeBasis2d.hpp>
+#include <polyfem/basis/LagrangeBasis3d.hpp>
+#include <polyfem/mesh/mesh2D/Mesh2D.hpp>
+#include <polyfem/mesh/mesh3D/Mesh3D.hpp>
+#include <polyfem/utils/Logger.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace polyfem::solver
+{
+	MultigridSolver::MultigridSolver(const json &linear_params, const json &params)
+	{
+		smoother_ = params["smoother"];
+		smoothing_steps_ = params["smoothing_steps"];
+		tolerance_ = params["tolerance"];
+		max_iter_ = params["max_iter"];
+
+		if (smoother_ != "chebyshev" && smoother_ != "jacobi")
+			log_and_throw_error("Unknown multigrid smoother {}", smoother_);
+		if (smoothing_steps_ <= 0)
+			log_and_throw_error("Invalid number of multigrid smoothing steps {}", smoothing_steps_);
+
+		// empty names fall back to the solver of /solver/linear
+		const std::string coarse_solver = params["coarse_solver"];
+		coarse_solver_ = polysolve::LinearSolver::create(
+			coarse_solver.empty() ? linear_params["solver"].get<std::string>() : coarse_solver,
+			coarse_solver.empty() ? linear_params["precond"].get<std::string>() : params["coarse_precond"].get<std::string>());
+		coarse_solver_->setParameters(linear_params);
+	}
+
+	int MultigridSolver::build_linear_bases(const mesh::Mesh &mesh, const std::string &assembler, std::vector<basis::ElementBases> &linear_bases)
+	{
+		if (mesh.has_poly())
+			log_and_throw_error("Multigrid does not support polygonal elements");
+
+		// the coarse quadrature is not used, the coarse matrices are Galerkin products
+		std::vector<mesh::LocalBoundary> local_boundary;
+		std::map<int, basis::InterfaceData> poly_edge_to_data;
+		std::shared_ptr<mesh::MeshNodes> mesh_nodes;
+		if (mesh.is_volume())
+			return basis::LagrangeBasis3d::build_bases(dynamic_cast<const mesh::Mesh3D &>(mesh), assembler, -1, -1, 1, false, false, false, linear_bases, local_boundary, poly_edge_to_data, mesh_nodes);
+		else
+			return basis::LagrangeBasis2d::build_bases(dynamic_cast<const mesh::Mesh2D &>(mesh), assembler, -1, -1, 1, false, false, false, linear_bases, local_boundary, poly_edge_to_data, mesh_nodes);
+	}
+
+	void MultigridSolver::factorize(const StiffnessMatrix &A, const std::vector<int> &boundary_nodes)
+	{
+		if (!prolongations_.empty() && prolongations_[0].rows() != A.rows())
+			log_and_throw_error("Multigrid prolongation has {} rows, the matrix is {}x{}", prolongations_[0].rows(), A.rows(), A.cols());
+
+		A_ = A;
+		std::vector<bool> is_dirichlet(A.rows(), false);
+		for (const int i : boundary_nodes)
+			is_dirichlet[i] = true;
+
+		// Galerkin coarse matrix, the Dirichlet rows of P are removed so only the free block of A is used
+		StiffnessMatrix coarse;
+		if (!prolongations_.empty())
+		{
+			StiffnessMatrix A_free = A;
+			A_free.prune([&](const int row, const int col, const double) { return !is_dirichlet[row] && !is_dirichlet[col]; });
+			coarse = prolongations_[0].transpose() * A_free * prolongations_[0];
+		}
+
+		factorize([this](const Eigen::VectorXd &x, Eigen::VectorXd &y) { y = A_ * x; }, Eigen::VectorXd(A.diagonal()), coarse, boundary_nodes);
+	}
+
+	void MultigridSolver::factorize(const Operator &apply, const Eigen::VectorXd &diagonal, const StiffnessMatrix &coarse, const std::vector<int> &boundary_nodes)
+	{
+		const int n = diagonal.size();
+		const int n_coarse_levels = prolongations_.size();
+		if (n_coarse_levels > 0 && (prolongations_[0].rows() != n || coarse.rows() != prolongations_[0].cols() || coarse.cols() != prolongations_[0].cols()))
+			log_and_throw_error("Multigrid sizes do not match: prolongation {}x{}, coarse matrix {}x{}, {} dofs", prolongations_[0].rows(), prolongations_[0].cols(), coarse.rows(), coarse.cols(), n);
+		for (int k = 1; k < n_coarse_levels; ++k)
+		{
+			if (prolongations_[k].rows() != prolongations_[k - 1].cols())
+				log_and_throw_error("Multigrid prolongation {} has {} rows, the level has {} dofs", k, prolongations_[k].rows(), prolongations_[k - 1].cols());
+		}
+
+		apply_ = apply;
+		levels_.assign(n_coarse_levels + 1, Level());
+
+		Level &fine = levels_[0];
+		fine.is_dirichlet.assign(n, false);
+		for (const int i : boundary_nodes)
+			fine.is_dirichlet[i] = true;
+		fine.inv_diagonal.resize(n);
+		for (int i = 0; i < n; ++i)
+		{
+			const double d = std::abs(diagonal[i]);
+			fine.inv_diagonal[i] = (fine.is_dirichlet[i] || d == 0) ? 1 : 1 / d;
+		}
+
+		for (int k = 1; k <= n_coarse_levels; ++k)
+		{
+			const StiffnessMatrix &P = prolongations_[k - 1];
+			const Level &finer = levels_[k - 1];
+			Level &level = levels_[k];
+			const int n_level = P.cols();
+
+			// a coarse basis interpolating a Dirichlet node is fixed too
+			level.is_dirichlet.assign(n_level, false);
+			for (int j = 0; j < P.outerSize(); ++j)
+			{
+				for (StiffnessMatrix::InnerIterator it(P, j); it; ++it)
+				{
+					if (finer.is_dirichlet[it.row()] && std::abs(it.value() - 1) < 1e-10)
+						level.is_dirichlet[it.col()] = true;
+				}
+			}
+
+			levels_[k - 1].P = P;
+			levels_[k - 1].P.prune([&](const int row, const int col, const double) { return !finer.is_dirichlet[row] && !level.is_dirichlet[col]; });
+
+			// the identity rows of the finer level are not seen by the restricted prolongation
+			level.A = k == 1 ? coarse : StiffnessMatrix(finer.P.transpose() * finer.A * finer.P);
+			level.A.prune([&](const int row, const int col, const double) { return !level.is_dirichlet[row] && !level.is_dirichlet[col]; });
+
+			// fixed and unused dofs are replaced by the identity
+			const Eigen::VectorXd diag = level.A.diagonal();
+			StiffnessMatrix identity(n_level, n_level);
+			identity.reserve(Eigen::VectorXi::Constant(n_level, 1));
+			for (int i = 0; i < n_level; ++i)
+			{
+				if (level.is_dirichlet[i] || diag[i] == 0)
+					identity.insert(i, i) = 1;
+			}
+			level.A += identity;
+			level.A.makeCompressed();
+
+			level.inv_diagonal = level.A.diagonal().cwiseAbs().cwiseInverse();
+		}
+
+		// without coarse levels the finest one is smoothed too
+		for (int k = 0; k < std::max(n_coarse_levels, 1); ++k)
+			levels_[k].max_eigenvalue = max_eigenvalue_safety * estimate_max_eigenvalue(k);
+
+		if (n_coarse_levels > 0)
+		{
+			const StiffnessMatrix &A_c = levels_.back().A;
+			coarse_solver_->analyzePattern(A_c, A_c.rows());
+			coarse_solver_->factorize(A_c);
+		}
+	}
+
+	void MultigridSolver::apply_operator(const int k, const Eigen::VectorXd &x, Eigen::VectorXd &y) const
+	{
+		if (k > 0)
+		{
+			y = levels_[k].A * x;
+			return;
+		}
+
+		const std::vector<bool> &is_dirichlet = levels_[0].is_dirichlet;
+		Eigen::VectorXd x_free = x;
+		for (int i = 0; i < x.size(); ++i)
+		{
+			if (is_dirichlet[i])
+				x_free[i] = 0;
+		}
+
+		apply_(x_free, y);
+
+		for (int i = 0; i < x.size(); ++i)
+		{
+			if (is_dirichlet[i])
+				y[i] = x[i];
+		}
+	}
+
+	double MultigridSolver::estimate_max_eigenvalue(const int k) const
+	{
+		const Eigen::VectorXd &inv_diagonal = levels_[k].inv_diagonal;
+		const int n = inv_diagonal.size();
+		const int n_steps = std::min(n_lanczos_steps, n);
+		const Eigen::VectorXd scale = inv_diagonal.cwiseSqrt();
+
+		// Lanczos on the symmetric D^-1/2 A D^-1/2, its extreme eigenvalues converge much faster than with power iterations
+		// the start is deterministic with components along the whole spectrum
+		Eigen::VectorXd v(n), v_old = Eigen::VectorXd::Zero(n), w;
+		for (int i = 0; i < n; ++i)
+			v[i] = std::sin(12.9898 * i + 78.233 * (i % 7)) + 0.1;
+		v /= v.norm();
+
+		Eigen::VectorXd alpha(n_steps), beta = Eigen::VectorXd::Zero(n_steps);
+		int step = 0;
+		for (; step < n_steps; ++step)
+		{
+			apply_operator(k, scale.cwiseProduct(v), w);
+			w = scale.cwiseProduct(w);
+			alpha[step] = v.dot(w);
+			w -= alpha[step] * v + (step > 0 ? beta[step - 1] : 0.) * v_old;
+			beta[step] = w.norm();
+			// invariant subspace, its eigenvalues are exact
+			if (beta[step] <= 1e-12 * std::abs(alpha[step]))
+			{
+				++step;
+				break;
+			}
+			v_old = v;
+			v = w / beta[step];
+		}
+
+		Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> tridiagonal;
+		tridiagonal.computeFromTridiagonal(alpha.head(step), beta.head(step - 1), Eigen::EigenvaluesOnly);
+		const double lambda = tridiagonal.eigenvalues().maxCoeff();
+
+		return lambda > 0 ? lambda : 1;
+	}
+
+	void MultigridSolver::smooth(const int k, const Eigen::VectorXd &b, Eigen::VectorXd &x) const
+	{
+		const Level &level = levels_[k];
+
+		Eigen::VectorXd r, Ax;
+		if (smoother_ == "jacobi")
+		{
+			// damping minimizing the amplification of the upper half of the spectrum
+			const double omega = 4. / (3. * level.max_eigenvalue);
+			x = omega * level.inv_diagonal.cwiseProduct(b);
+			for (int it = 1; it < smoothing_steps_; ++it)
+			{
+				apply_operator(k, x, Ax);
+				x += omega * level.inv_diagonal.cwiseProduct(b - Ax);
+			}
+			return;
+		}
+
+		// Chebyshev polynomial of D^-1 A of degree smoothing_steps_ damping [λ_max / range, λ_max]
+		const double lambda_min = level.max_eigenvalue / chebyshev_range;
+		const double theta = (level.max_eigenvalue + lambda_min) / 2;
+		const double delta = (level.max_eigenvalue - lambda_min) / 2;
+		const double sigma = theta / delta;
+		double rho_old = 1 / sigma;
+
+		Eigen::VectorXd d = level.inv_diagonal.cwiseProduct(b) / theta;
+		x = d;
+		for (int it = 1; it < smoothing_steps_; ++it)
+		{
+			apply_operator(k, x, Ax);
+			r = b - Ax;
+			const double rho = 1 / (2 * sigma - rho_old);
+			d = (rho * rho_old) * d + (2 * rho / delta) * level.inv_diagonal.cwiseProduct(r);
+			x += d;
+			rho_old = rho;
+		}
+	}
+
+	void MultigridSolver::v_cycle(const int k, const Eigen::VectorXd &r, Eigen::VectorXd &y) const
+	{
+		// single level, the preconditioner is the smoother alone
+		if (levels_.size() == 1)
+		{
+			smooth(0, r, y);
+			return;
+		}
+
+		if (k + 1 == int(levels_.size()))
+		{
+			y.setZero(r.size());
+			coarse_solver_->solve(r, y);
+			return;
+		}
+
+		const StiffnessMatrix &P = levels_[k].P;
+		Eigen::VectorXd Ay, e_c, s;
+
+		smooth(k, r, y);
+
+		apply_operator(k, y, Ay);
+		v_cycle(k + 1, P.transpose() * (r - Ay), e_c);
+		y += P * e_c;
+
+		apply_operator(k, y, Ay);
+		smooth(k, r - Ay, s);
+		y += s;
+	}
+
+	void MultigridSolver::solve(const Eigen::VectorXd &b, Eigen::VectorXd &x)
+	{
+		assert(!levels_.empty());
+		const std::vector<bool> &is_dirichlet = levels_[0].is_dirichlet;
+		const int n = is_dirichlet.size();
+		assert(b.size() == n);
+		if (x.size() != n)
+			x.setZero(n);
+
+		for (int i = 0; i < n; ++i)
+		{
+			if (is_dirichlet[i])
+				x[i] = b[i];
+		}
+
+		const double b_norm = b.norm();
+		const double target = tolerance_ * (b_norm > 0 ? b_norm : 1);
+
+		// the Dirichlet values are lifted, the correction solves the symmetric system with the identity rows and columns
+		Eigen::VectorXd r;
+		apply_(x, r);
+		r = b - r;
+		for (int i = 0; i < n; ++i)
+		{
+			if (is_dirichlet[i])
+				r[i] = 0;
+		}
+
+		// flexible conjugate gradient (Polak-Ribière), the coarse solve can be inexact
+		Eigen::VectorXd z, p, q, r_old;
+		double res = r.norm();
+		int it = 0;
+		if (res > target)
+		{
+			v_cycle(0, r, z);
+			p = z;
+			double rz = r.dot(z);
+
+			while (it < max_iter_)
+			{
+				apply_operator(0, p, q);
+				const double pq = p.dot(q);
+				if (pq <= 0)
+				{
+					logger().warn("Multigrid conjugate gradient breakdown, the matrix is not positive definite");
+					break;
+				}
+
+				const double alpha = rz / pq;
+				x += alpha * p;
+				r_old = r;
+				r -= alpha * q;
+				++it;
+
+				res = r.norm();
+				if (res <= target)
+					break;
+
+				v_cycle(0, r, z);
+				const double beta = z.dot(r - r_old) / rz;
+				rz = r.dot(z);
+				p = z + beta * p;
+			}
+		}
+
+		info_ = json::object();
+		info_["solver"] = "PCG";
+		info_["smoother"] = smoother_;
+		info_["coarse_solver"] = levels_.size() > 1 ? coarse_solver_->name() : "";
+		info_["levels"] = levels_.size();
+		info_["n_coarse"] = levels_.back().A.rows();
+		info_["iterations"] = it;
+		info_["error"] = res / (b_norm > 0 ? b_norm : 1);
+
+		if (res > target)
+			logger().warn("Multigrid solver did not converge in {} iterations, relative residual {}", it, res / (b_norm > 0 ? b_norm : 1));
+		else
+			logger().debug("Multigrid solver converged in {} iterations, relative residual {}", it, res / (b_norm > 0 ? b_norm : 1));
+	}
+} // namespace polyfem::solver
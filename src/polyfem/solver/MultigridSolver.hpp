@@ -0,0 +1,117 @@
+#pragma once
+
+#include <polyfem/Common.hpp>
+#include <polyfem/basis/ElementBases.hpp>
+#include <polyfem/mesh/Mesh.hpp>
+#include <polyfem/utils/Types.hpp>
+
+#include <polysolve/LinearSolver.hpp>
+
+#include <Eigen/Dense>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace polyfem::solver
+{
+	/// @brief Conjugate gradient preconditioned by a multigrid V-cycle over a hierarchy of nested spaces
+	/// Every level but the coarsest is smoothed (Chebyshev or damped Jacobi on D^-1 A), the finest level only needs
+	/// the products with A and its diagonal and can be matrix-free. The coarser matrices are the Galerkin products
+	/// P^T A P and the coarsest one is solved by an inner linear solver (e.g., AMG).
+	/// The hierarchy is given by the prolongations, see PMultigridSolver and GeometricMultigridSolver. Without
+	/// prolongations the preconditioner is the smoother of the finest level alone (Chebyshev-Jacobi conjugate gradient).
+	class MultigridSolver
+	{
+	public:
+		/// y = A x
+		using Operator = std::function<void(const Eigen::VectorXd &x, Eigen::VectorXd &y)>;
+
+		/// @param[in] linear_params settings of the linear solver (/solver/linear), the coarse solver falls back to it
+		/// @param[in] params multigrid settings (smoother, smoothing_steps, coarse_solver, coarse_precond, tolerance, max_iter)
+		MultigridSolver(const json &linear_params, const json &params);
+		virtual ~MultigridSolver() = default;
+
+		/// @brief Builds the P1/Q1 bases of the mesh, the coarse level of the Lagrange bases of any order
+		/// @param[in] mesh mesh without polygons/polyhedra
+		/// @param[in] assembler name of the assembler
+		/// @param[out] linear_bases linear bases of every element
+		/// @return number of linear bases
+		static int build_linear_bases(const mesh::Mesh &mesh, const std::string &assembler, std::vector<basis::ElementBases> &linear_bases);
+
+		/// @param[in] prolongations prolongations[k] maps the level k + 1 to the level k, the level 0 is the system matrix, empty for a single level
+		void set_prolongations(const std::vector<StiffnessMatrix> &prolongations) { prolongations_ = prolongations; }
+
+		/// @brief Builds the smoothers and the Galerkin coarse matrices, the Dirichlet rows are replaced by rows of the identity as in dirichlet_solve
+		/// @param[in] A assembled system matrix
+		/// @param[in] boundary_nodes Dirichlet dofs
+		void factorize(const StiffnessMatrix &A, const std::vector<int> &boundary_nodes);
+
+		/// @brief Matrix-free version, A is only used through its products and its diagonal
+		/// @param[in] apply products with the system matrix (with its Dirichlet rows)
+		/// @param[in] diagonal diagonal of the system matrix
+		/// @param[in] coarse matrix of the level 1 (e.g., P^T A P or the matrix assembled on the coarse bases), unused for a single level
+		/// @param[in] boundary_nodes Dirichlet dofs
+		void factorize(const Operator &apply, const Eigen::VectorXd &diagonal, const StiffnessMatrix &coarse, const std::vector<int> &boundary_nodes);
+
+		/// @brief Solves the factorized system, x is the initial guess if it has the right size
+		/// @param[in] b right-hand side, its Dirichlet entries are the values of the Dirichlet dofs
+		/// @param[in, out] x solution
+		void solve(const Eigen::VectorXd &b, Eigen::VectorXd &x);
+
+		/// @brief factorize and solve
+		void solve(const StiffnessMatrix &A, const Eigen::VectorXd &b, const std::vector<int> &boundary_nodes, Eigen::VectorXd &x)
+		{
+			factorize(A, boundary_nodes);
+			solve(b, x);
+		}
+
+		/// @brief Iterations and residual of the last solve
+		void get_info(json &params) const { params = info_; }
+
+		/// @brief Number of levels, including the finest one
+		int n_levels() const { return levels_.size(); }
+
+	private:
+		struct Level
+		{
+			/// matrix with the Dirichlet rows and columns replaced by the identity, empty on the finest level
+			StiffnessMatrix A;
+			Eigen::VectorXd inv_diagonal;
+			std::vector<bool> is_dirichlet;
+			/// prolongation from the next coarser level with the Dirichlet rows and columns removed
+			StiffnessMatrix P;
+			/// upper bound of the spectrum of D^-1 A
+			double max_eigenvalue = 1;
+		};
+
+		/// y = A_k x, on the finest level the Dirichlet rows and columns are replaced by the identity
+		void apply_operator(const int k, const Eigen::VectorXd &x, Eigen::VectorXd &y) const;
+		/// x = S(b) from x = 0 on the level k, the smoother polynomial is symmetric
+		void smooth(const int k, const Eigen::VectorXd &b, Eigen::VectorXd &x) const;
+		/// y = V-cycle(r) from the level k
+		void v_cycle(const int k, const Eigen::VectorXd &r, Eigen::VectorXd &y) const;
+		/// Largest eigenvalue of D^-1 A_k by Lanczos iterations
+		double estimate_max_eigenvalue(const int k) const;
+
+		static constexpr int n_lanczos_steps = 20;
+		static constexpr double max_eigenvalue_safety = 1.1; ///< Upper bound of the smoothed spectrum over the estimated eigenvalue
+		static constexpr double chebyshev_range = 20;        ///< Ratio of the upper and lower bounds of the smoothed spectrum
+
+		std::string smoother_;
+		int smoothing_steps_;
+		double tolerance_;
+		int max_iter_;
+
+		std::unique_ptr<polysolve::LinearSolver> coarse_solver_;
+
+		std::vector<StiffnessMatrix> prolongations_;
+		std::vector<Level> levels_;
+
+		/// copy of the assembled matrix, empty in the matrix-free version
+		StiffnessMatrix A_;
+		Operator apply_;
+
+		json info_;
+	};
+} // namespace polyfem::solver
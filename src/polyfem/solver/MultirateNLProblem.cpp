@@ -0,0 +1,45 @@
+#include "MultirateNLProblem.hpp"
+
+#include <algorithm>
+
+namespace polyfem::solver
+{
+	MultirateNLProblem::MultirateNLProblem(
+		const int full_size,
+		const std::vector<int> &dirichlet_nodes,
+		const std::vector<int> &fixed_nodes,
+		const std::vector<mesh::LocalBoundary> &local_boundary,
+		const int n_boundary_samples,
+		const assembler::RhsAssembler &rhs_assembler,
+		const double t,
+		const std::vector<std::shared_ptr<Form>> &forms)
+		: NLProblem(full_size, fixed_nodes, local_boundary, n_boundary_samples, rhs_assembler, t, forms),
+		  dirichlet_nodes_(dirichlet_nodes)
+	{
+		assert(std::is_sorted(dirichlet_nodes.begin(), dirichlet_nodes.end()));
+		assert(std::includes(fixed_nodes.begin(), fixed_nodes.end(), dirichlet_nodes.begin(), dirichlet_nodes.end()));
+
+		std::set_difference(
+			fixed_nodes.begin(), fixed_nodes.end(),
+			dirichlet_nodes.begin(), dirichlet_nodes.end(),
+			std::back_inserter(slow_dofs_));
+
+		slow_values_.setZero(full_size);
+	}
+
+	void MultirateNLProblem::set_slow_values(const TVector &values)
+	{
+		assert(values.size() == full_size());
+		for (const int i : slow_dofs_)
+			slow_values_(i) = values(i);
+		invalidate_boundary_values();
+	}
+
+	Eigen::MatrixXd MultirateNLProblem::boundary_values() const
+	{
+		Eigen::MatrixXd result = dirichlet_values(dirichlet_nodes_);
+		for (const int i : slow_dofs_)
+			result(i) = slow_values_(i);
+		return result;
+	}
+} // namespace polyfem::solver
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <polyfem/solver/NLProblem.hpp>
+
+namespace polyfem::solver
+{
+	/// Nonlinear problem of one substep of a multirate time step: only the fast DoFs are free,
+	/// the slow DoFs are prescribed like Dirichlet nodes to the values given by set_slow_values.
+	class MultirateNLProblem : public NLProblem
+	{
+	public:
+		/// @param full_size Size of the full problem
+		/// @param dirichlet_nodes Sorted Dirichlet nodes
+		/// @param fixed_nodes Sorted union of the Dirichlet nodes and of the slow DoFs, it must outlive the problem
+		MultirateNLProblem(
+			const int full_size,
+			const std::vector<int> &dirichlet_nodes,
+			const std::vector<int> &fixed_nodes,
+			const std::vector<mesh::LocalBoundary> &local_boundary,
+			const int n_boundary_samples,
+			const assembler::RhsAssembler &rhs_assembler,
+			const double t,
+			const std::vector<std::shared_ptr<Form>> &forms);
+
+		/// @brief Set the values of the slow DoFs, the entries of the other DoFs are ignored
+		/// @param values Full size vector
+		void set_slow_values(const TVector &values);
+
+		const std::vector<int> &slow_dofs() const { return slow_dofs_; }
+
+	protected:
+		Eigen::MatrixXd boundary_values() const override;
+
+	private:
+		const std::vector<int> &dirichlet_nodes_;
+		std::vector<int> slow_dofs_; ///< Fixed nodes which are not Dirichlet nodes
+		TVector slow_values_;
+	};
+} // namespace polyfem::solver
@@ -31,6 +31,7 @@ namespace polyfem::solver
 		  n_boundary_samples_(0),
 		  t_(0)
 	{
+		init_free_dofs();
 		use_reduced_size();
 	}
 
@@ -53,77 +54,162 @@ namespace polyfem::solver
 	{
 		assert(std::is_sorted(boundary_nodes.begin(), boundary_nodes.end()));
 		assert(boundary_nodes.size() == 0 || (boundary_nodes.front() >= 0 && boundary_nodes.back() < full_size_));
+		init_free_dofs();
 		use_reduced_size();
 	}
 
+	void NLProblem::init_free_dofs()
+	{
+		free_dofs_.resize(reduced_size_);
+		int j = 0;
+		size_t k = 0;
+		for (int i = 0; i < full_size_; ++i)
+		{
+			if (k < boundary_nodes_.size() && boundary_nodes_[k] == i)
+			{
+				++k;
+				continue;
+			}
+			free_dofs_(j++) = i;
+		}
+		assert(j == reduced_size_);
+	}
+
 	void NLProblem::init_lagging(const TVector &x)
 	{
-		FullNLProblem::init_lagging(reduced_to_full(x));
+		FullNLProblem::init_lagging(full_buffer(x));
 	}
 
 	void NLProblem::update_lagging(const TVector &x, const int iter_num)
 	{
-		FullNLProblem::update_lagging(reduced_to_full(x), iter_num);
+		FullNLProblem::update_lagging(full_buffer(x), iter_num);
 	}
 
 	void NLProblem::update_quantities(const double t, const TVector &x)
 	{
 		t_ = t;
-		const TVector full = reduced_to_full(x);
+		boundary_values_valid_ = false;
+		invalidate_cache();
+		const TVector &full = full_buffer(x);
 		for (auto &f : forms_)
 			f->update_quantities(t, full);
 	}
 
 	void NLProblem::line_search_begin(const TVector &x0, const TVector &x1)
 	{
-		FullNLProblem::line_search_begin(reduced_to_full(x0), reduced_to_full(x1));
+		FullNLProblem::line_search_begin(full_buffer(x0, 0), full_buffer(x1, 1));
 	}
 
 	double NLProblem::max_step_size(const TVector &x0, const TVector &x1) const
 	{
-		return FullNLProblem::max_step_size(reduced_to_full(x0), reduced_to_full(x1));
+		return FullNLProblem::max_step_size(full_buffer(x0, 0), full_buffer(x1, 1));
 	}
 
 	bool NLProblem::is_step_valid(const TVector &x0, const TVector &x1) const
 	{
-		return FullNLProblem::is_step_valid(reduced_to_full(x0), reduced_to_full(x1));
+		return FullNLProblem::is_step_valid(full_buffer(x0, 0), full_buffer(x1, 1));
 	}
 
 	bool NLProblem::is_step_collision_free(const TVector &x0, const TVector &x1) const
 	{
-		return FullNLProblem::is_step_collision_free(reduced_to_full(x0), reduced_to_full(x1));
+		return FullNLProblem::is_step_collision_free(full_buffer(x0, 0), full_buffer(x1, 1));
 	}
 
 	double NLProblem::value(const TVector &x)
 	{
 		// TODO: removed fearure const bool only_elastic
-		return FullNLProblem::value(reduced_to_full(x));
+		return FullNLProblem::value(full_buffer(x));
+	}
+
+	void NLProblem::values(const std::vector<TVector> &xs, Eigen::VectorXd &vals)
+	{
+		std::vector<TVector> full_xs(xs.size());
+		for (size_t k = 0; k < xs.size(); ++k)
+			full_xs[k] = full_buffer(xs[k]);
+		FullNLProblem::values(full_xs, vals);
 	}
 
 	void NLProblem::gradient(const TVector &x, TVector &grad)
 	{
-		TVector full_grad;
-		FullNLProblem::gradient(reduced_to_full(x), full_grad);
-		grad = full_to_reduced(full_grad);
+		FullNLProblem::gradient(full_buffer(x), full_work_);
+		reduce_derivative(full_work_, grad);
 	}
 
 	void NLProblem::hessian(const TVector &x, THessian &hessian)
 	{
-		THessian full_hessian;
-		FullNLProblem::hessian(reduced_to_full(x), full_hessian);
-		assert(full_hessian.rows() == full_size());
-		assert(full_hessian.cols() == full_size());
-		utils::full_to_reduced_matrix(full_size(), current_size(), boundary_nodes_, full_hessian, hessian);
+		if (imposes_dirichlet_in_place())
+		{
+			sum_hessians(full_buffer(x), full_size(), {}, hessian);
+			utils::apply_dirichlet_in_place(hessian, boundary_nodes_);
+		}
+		else
+		{
+			// the Dirichlet rows and columns are dropped while summing the forms
+			sum_hessians(full_buffer(x), current_size(), boundary_nodes_, hessian);
+		}
+		assert(hessian.rows() == current_size());
+		assert(hessian.cols() == current_size());
+	}
+
+	void NLProblem::gradient_and_hessian(const TVector &x, TVector &grad, THessian &hessian)
+	{
+		if (imposes_dirichlet_in_place())
+		{
+			sum_hessians(full_buffer(x), full_size(), {}, hessian, &full_work_);
+			utils::apply_dirichlet_in_place(hessian, boundary_nodes_);
+		}
+		else
+			sum_hessians(full_buffer(x), current_size(), boundary_nodes_, hessian, &full_work_);
+		reduce_derivative(full_work_, grad);
+	}
+
+	void NLProblem::init_hessian_vector_product(const TVector &x)
+	{
+		FullNLProblem::init_hessian_vector_product(full_buffer(x));
+	}
+
+	void NLProblem::hessian_vector_product(const TVector &x, const TVector &v, TVector &out)
+	{
+		// the direction vanishes on the Dirichlet nodes
+		const TVector *full_v = &v;
+		if (v.size() != full_size())
+		{
+			scatter_reduced(v, nullptr, full_direction_);
+			full_v = &full_direction_;
+		}
+		else if (imposes_dirichlet_in_place())
+		{
+			full_direction_ = v;
+			for (const int b : boundary_nodes_)
+				full_direction_(b) = 0;
+			full_v = &full_direction_;
+		}
+
+		FullNLProblem::hessian_vector_product(full_buffer(x), *full_v, full_work_);
+		reduce_derivative(full_work_, out);
+
+		// identity rows of the Dirichlet nodes
+		if (imposes_dirichlet_in_place())
+		{
+			for (const int b : boundary_nodes_)
+				out(b) = v(b);
+		}
+	}
+
+	void NLProblem::hessian_diagonal(const TVector &x, TVector &diag)
+	{
+		FullNLProblem::hessian_diagonal(full_buffer(x), full_work_);
+		reduce_derivative(full_work_, diag, 1);
 	}
 
 	void NLProblem::solution_changed(const TVector &newX)
 	{
-		FullNLProblem::solution_changed(reduced_to_full(newX));
+		FullNLProblem::solution_changed(full_buffer(newX));
 	}
 
 	void NLProblem::post_step(const int iter_num, const TVector &x)
 	{
-		FullNLProblem::post_step(iter_num, reduced_to_full(x));
+		FullNLProblem::post_step(iter_num, full_buffer(x));
 
 		// TODO: add me back
 		// if (state_.args["output"]["advanced"]["save_nl_solve_sequence"])
@@ -138,7 +224,8 @@ namespace polyfem::solver
 
 	void NLProblem::set_apply_DBC(const TVector &x, const bool val)
 	{
-		TVector full = reduced_to_full(x);
+		invalidate_cache();
+		const TVector &full = full_buffer(x);
 		for (auto &form : forms_)
 			form->set_apply_DBC(full, val);
 	}
@@ -146,90 +233,117 @@ namespace polyfem::solver
 	NLProblem::TVector NLProblem::full_to_reduced(const TVector &full) const
 	{
 		TVector reduced;
-		full_to_reduced_aux(boundary_nodes_, full_size(), current_size(), full, reduced);
+		full_to_reduced(full, reduced);
 		return reduced;
 	}
 
 	NLProblem::TVector NLProblem::reduced_to_full(const TVector &reduced) const
 	{
 		TVector full;
-		reduced_to_full_aux(boundary_nodes_, full_size(), current_size(), reduced, boundary_values(), full);
+		reduced_to_full(reduced, full);
 		return full;
 	}
 
-	Eigen::MatrixXd NLProblem::boundary_values() const
-	{
-		Eigen::MatrixXd result = Eigen::MatrixXd::Zero(full_size(), 1);
-		// rhs_assembler->set_bc(*local_boundary_, boundary_nodes_, n_boundary_samples_, local_neumann_boundary_, result, t_);
-		rhs_assembler_->set_bc(*local_boundary_, boundary_nodes_, n_boundary_samples_, std::vector<mesh::LocalBoundary>(), result, Eigen::MatrixXd(), t_);
-		return result;
-	}
-
-	template <class FullMat, class ReducedMat>
-	void NLProblem::full_to_reduced_aux(const std::vector<int> &boundary_nodes, const int full_size, const int reduced_size, const FullMat &full, ReducedMat &reduced)
+	void NLProblem::full_to_reduced(const TVector &full, TVector &reduced) const
 	{
-		using namespace polyfem;
+		// The reduced vector keeps the Dirichlet nodes with their values
+		if (imposes_dirichlet_in_place())
+		{
+			assert(full.size() == full_size());
+			reduced = full;
+			const TVector &bc = cached_boundary_values();
+			for (const int b : boundary_nodes_)
+				reduced(b) = bc(b);
+			return;
+		}
 
 		// Reduced is already at the full size
-		if (full_size == reduced_size || full.size() == reduced_size)
+		if (full_size() == current_size() || full.size() == current_size())
 		{
 			reduced = full;
 			return;
 		}
 
-		assert(full.size() == full_size);
-		assert(full.cols() == 1);
-		reduced.resize(reduced_size, 1);
-
-		assert(std::is_sorted(boundary_nodes.begin(), boundary_nodes.end()));
+		assert(full.size() == full_size());
+		reduced.resize(current_size());
+		for (long i = 0; i < free_dofs_.size(); ++i)
+			reduced(i) = full(free_dofs_(i));
+	}
 
-		long j = 0;
-		size_t k = 0;
-		for (int i = 0; i < full.size(); ++i)
+	void NLProblem::reduced_to_full(const TVector &reduced, TVector &full) const
+	{
+		// Both are full size, the Dirichlet values are imposed again
+		if (imposes_dirichlet_in_place())
 		{
-			if (k < boundary_nodes.size() && boundary_nodes[k] == i)
-			{
-				++k;
-				continue;
-			}
+			full_to_reduced(reduced, full);
+			return;
+		}
 
-			reduced(j++) = full(i);
+		// Full is already at the reduced size
+		if (full_size() == current_size() || full_size() == reduced.size())
+		{
+			full = reduced;
+			return;
 		}
-		assert(j == reduced.size());
+
+		scatter_reduced(reduced, &cached_boundary_values(), full);
 	}
 
-	template <class ReducedMat, class FullMat>
-	void NLProblem::reduced_to_full_aux(const std::vector<int> &boundary_nodes, const int full_size, const int reduced_size, const ReducedMat &reduced, const Eigen::MatrixXd &rhs, FullMat &full)
+	void NLProblem::reduce_derivative(const TVector &full, TVector &reduced, const double dirichlet_value) const
 	{
-		using namespace polyfem;
-
-		// Full is already at the reduced size
-		if (full_size == reduced_size || full_size == reduced.size())
+		if (!imposes_dirichlet_in_place())
 		{
-			full = reduced;
+			full_to_reduced(full, reduced);
 			return;
 		}
 
-		assert(reduced.size() == reduced_size);
-		assert(reduced.cols() == 1);
-		full.resize(full_size, 1);
+		assert(full.size() == full_size());
+		reduced = full;
+		for (const int b : boundary_nodes_)
+			reduced(b) = dirichlet_value;
+	}
 
-		assert(std::is_sorted(boundary_nodes.begin(), boundary_nodes.end()));
+	void NLProblem::scatter_reduced(const TVector &reduced, const TVector *bc, TVector &full) const
+	{
+		assert(reduced.size() == free_dofs_.size());
+		full.resize(full_size());
 
-		long j = 0;
-		size_t k = 0;
-		for (int i = 0; i < full.size(); ++i)
-		{
-			if (k < boundary_nodes.size() && boundary_nodes[k] == i)
-			{
-				++k;
-				full(i) = rhs(i);
-				continue;
-			}
+		for (long i = 0; i < free_dofs_.size(); ++i)
+			full(free_dofs_(i)) = reduced(i);
+
+		for (const int b : boundary_nodes_)
+			full(b) = bc ? (*bc)(b) : 0;
+	}
+
+	const NLProblem::TVector &NLProblem::full_buffer(const TVector &x, const int buffer) const
+	{
+		if (x.size() == full_size())
+			return x;
+
+		reduced_to_full(x, full_buffers_[buffer]);
+		return full_buffers_[buffer];
+	}
 
-			full(i) = reduced(j++);
+	const NLProblem::TVector &NLProblem::cached_boundary_values() const
+	{
+		if (!boundary_values_valid_)
+		{
+			boundary_values_ = boundary_values();
+			boundary_values_valid_ = true;
 		}
+		return boundary_values_;
+	}
 
-		assert(j == reduced.size());
+	Eigen::MatrixXd NLProblem::boundary_values() const
+	{
+		return dirichlet_values(boundary_nodes_);
+	}
+
+	Eigen::MatrixXd NLProblem::dirichlet_values(const std::vector<int> &nodes) const
+	{
+		Eigen::MatrixXd result = Eigen::MatrixXd::Zero(full_size(), 1);
+		// rhs_assembler->set_bc(*local_boundary_, boundary_nodes_, n_boundary_samples_, local_neumann_boundary_, result, t_);
+		rhs_assembler_->set_bc(*local_boundary_, nodes, n_boundary_samples_, std::vector<mesh::LocalBoundary>(), result, Eigen::MatrixXd(), t_);
+		return result;
 	}
 } // namespace polyfem::solver
@@ -4,6 +4,8 @@
 #include <polyfem/assembler/RhsAssembler.hpp>
 #include <polyfem/mesh/LocalBoundary.hpp>
 
+#include <array>
+
 namespace polyfem::solver
 {
 	class NLProblem : public FullNLProblem
@@ -29,8 +31,14 @@ namespace polyfem::solver
 				  const std::vector<std::shared_ptr<Form>> &forms);
 
 		double value(const TVector &x) override;
+		void values(const std::vector<TVector> &xs, Eigen::VectorXd &vals) override;
 		void gradient(const TVector &x, TVector &gradv) override;
 		void hessian(const TVector &x, THessian &hessian) override;
+		void gradient_and_hessian(const TVector &x, TVector &gradv, THessian &hessian) override;
+
+		void init_hessian_vector_product(const TVector &x) override;
+		void hessian_vector_product(const TVector &x, const TVector &v, TVector &out) override;
+		void hessian_diagonal(const TVector &x, TVector &diag) override;
 
 		bool is_step_valid(const TVector &x0, const TVector &x1) const override;
 		bool is_step_collision_free(const TVector &x0, const TVector &x1) const override;
@@ -49,7 +57,8 @@ namespace polyfem::solver
 		void update_quantities(const double t, const TVector &x);
 
 		int full_size() const { return full_size_; }
-		int reduced_size() const { return reduced_size_; }
+		/// @brief Size of the reduced problem, the full size if the Dirichlet conditions are applied in place
+		int reduced_size() const { return dirichlet_in_place_ ? full_size_ : reduced_size_; }
 
 		void use_full_size() { current_size_ = CurrentSize::FULL_SIZE; }
 		void use_reduced_size() { current_size_ = CurrentSize::REDUCED_SIZE; }
@@ -57,11 +66,35 @@ namespace polyfem::solver
 		TVector full_to_reduced(const TVector &full) const;
 		TVector reduced_to_full(const TVector &reduced) const;
 
+		/// @brief Gather the free variables of full in reduced, does not allocate once reduced has the right size
+		void full_to_reduced(const TVector &full, TVector &reduced) const;
+		/// @brief Scatter reduced in full with the Dirichlet values, does not allocate once full has the right size
+		void reduced_to_full(const TVector &reduced, TVector &full) const;
+
 		void set_apply_DBC(const TVector &x, const bool val);
 
+		/// @brief Keep the Dirichlet variables in the reduced problem instead of removing them
+		/// The reduced vectors are full size with the Dirichlet values, the gradient vanishes on the Dirichlet variables,
+		/// and their rows and columns of the Hessian are replaced by the identity. The Hessian has the same pattern as the
+		/// full size one (e.g., of the augmented Lagrangian), the linear solver analyzes it once for both.
+		void set_dirichlet_in_place(const bool val) { dirichlet_in_place_ = val; }
+		bool dirichlet_in_place() const { return dirichlet_in_place_; }
+
 	protected:
 		virtual Eigen::MatrixXd boundary_values() const;
 
+		/// @brief Dirichlet values at the current time of the given sorted nodes, zero elsewhere
+		Eigen::MatrixXd dirichlet_values(const std::vector<int> &nodes) const;
+
+		/// @brief Recompute the boundary values on their next use
+		void invalidate_boundary_values() { boundary_values_valid_ = false; }
+
+		/// Dirichlet values at the current time, computed once per update_quantities
+		const TVector &cached_boundary_values() const;
+
+		/// @brief Full size version of x in the work buffer number buffer, x itself if it is already full size
+		const TVector &full_buffer(const TVector &x, const int buffer = 0) const;
+
 		const std::vector<int> &boundary_nodes_;
 
 		const int full_size_;    ///< Size of the full problem
@@ -79,15 +112,32 @@ namespace polyfem::solver
 		}
 
 	private:
+		void init_free_dofs();
+
+		/// the Dirichlet conditions are applied in place to the current (reduced size) problem
+		bool imposes_dirichlet_in_place() const
+		{
+			return dirichlet_in_place_ && current_size_ == CurrentSize::REDUCED_SIZE && !boundary_nodes_.empty();
+		}
+
+		/// gather the free entries of a full size derivative, with in place Dirichlet conditions its Dirichlet entries are set to dirichlet_value
+		void reduce_derivative(const TVector &full, TVector &reduced, const double dirichlet_value = 0) const;
+
+		/// scatter reduced in full, boundary values from bc or zero if bc is null
+		void scatter_reduced(const TVector &reduced, const TVector *bc, TVector &full) const;
+
+		Eigen::VectorXi free_dofs_; ///< Full index of every reduced variable
+
+		mutable std::array<TVector, 2> full_buffers_; ///< Work buffers for the full size solutions
+		TVector full_work_;                           ///< Work buffer for full size outputs (gradient, products)
+		TVector full_direction_;                      ///< Work buffer for full size directions
+		mutable TVector boundary_values_;
+		mutable bool boundary_values_valid_ = false;
+		bool dirichlet_in_place_ = false;
+
 		const assembler::RhsAssembler *rhs_assembler_;
 		const std::vector<mesh::LocalBoundary> *local_boundary_;
 		const int n_boundary_samples_;
 		double t_;
-
-		template <class FullMat, class ReducedMat>
-		static void full_to_reduced_aux(const std::vector<int> &boundary_nodes, const int full_size, const int reduced_size, const FullMat &full, ReducedMat &reduced);
-
-		template <class ReducedMat, class FullMat>
-		static void reduced_to_full_aux(const std::vector<int> &boundary_nodes, const int full_size, const int reduced_size, const ReducedMat &reduced, const Eigen::MatrixXd &rhs, FullMat &full);
 	};
 } // namespace polyfem::solver
@@ -5,6 +5,8 @@
 #include <polysolve/LinearSolver.hpp>
 
 #include <polyfem/assembler/AssemblerUtils.hpp>
+#include <polyfem/assembler/Mass.hpp>
+#include <polyfem/assembler/Stokes.hpp>
 
 #include <polyfem/utils/Logger.hpp>
 
@@ -57,6 +59,22 @@ namespace polyfem
 
 			const int precond_num = problem_dim * n_bases;
 
+			block_solver.reset();
+			if (BlockStokesSolver::is_enabled(solver_param["linear"]))
+			{
+				block_solver = std::make_unique<BlockStokesSolver>(solver_param["linear"], precond_num, n_pressure_bases, use_avg_pressure);
+				if (solver_param["linear"]["block"]["schur"] == "mass")
+				{
+					assembler::Mass pressure_mass_assembler;
+					pressure_mass_assembler.set_size(1);
+					StiffnessMatrix pressure_mass;
+					pressure_mass_assembler.assemble(is_volume, n_pressure_bases, pressure_bases, gbases, pressure_ass_vals_cache, pressure_mass, true);
+
+					const auto *stokes = dynamic_cast<const assembler::StokesVelocity *>(&velocity_stokes_assembler);
+					block_solver->set_pressure_mass(pressure_mass, stokes ? stokes->viscosity() : 1.);
+				}
+			}
+
 			igl::Timer time;
 
 			time.start();
@@ -69,6 +87,9 @@ namespace polyfem
 			AssemblerUtils::merge_mixed_matrices(n_bases, n_pressure_bases, problem_dim, use_avg_pressure,
 												 velocity_stiffness, mixed_stiffness, pressure_stiffness,
 												 stoke_stiffness);
+			// the Stokes blocks are constant, only the convective block is assembled in the iterations
+			MergedMatrixCache stokes(stoke_stiffness);
+			const std::vector<int> skipping = stokes.zero_columns(boundary_nodes);
 			time.stop();
 			stokes_matrix_time = time.getElapsedTimeInSec();
 			logger().debug("\tStokes matrix assembly time {}s", time.getElapsedTimeInSec());
@@ -78,30 +99,13 @@ namespace polyfem
 			logger().info("{}...", solver->name());
 
 			Eigen::VectorXd b = rhs;
-			dirichlet_solve(*solver, stoke_stiffness, b, boundary_nodes, x, precond_num, "", false, true, use_avg_pressure);
+			linear_solve(*solver, stoke_stiffness, b, boundary_nodes, precond_num, use_avg_pressure, x);
 			// solver->get_info(solver_info);
 			time.stop();
 			stokes_solve_time = time.getElapsedTimeInSec();
 			logger().debug("\tStokes solve time {}s", time.getElapsedTimeInSec());
-			logger().debug("\tStokes solver error: {}", (stoke_stiffness * x - b).norm());
-
-			std::vector<bool> zero_col(stoke_stiffness.cols(), true);
-			for (int k = 0; k < stoke_stiffness.outerSize(); ++k)
-			{
-				for (StiffnessMatrix::InnerIterator it(stoke_stiffness, k); it; ++it)
-				{
-					if (fabs(it.value()) > 1e-12)
-						zero_col[it.col()] = false;
-				}
-			}
-			std::vector<int> skipping;
-			for (int i = 0; i < zero_col.size(); ++i)
-			{
-				if (zero_col[i])
-				{
-					skipping.push_back(i);
-				}
-			}
+			if (logger().should_log(spdlog::level::debug))
+				logger().debug("\tStokes solver error: {}", (stoke_stiffness * x - b).norm());
 
 			assembly_time = 0;
 			inverting_time = 0;
@@ -120,7 +124,7 @@ namespace polyfem
 							   use_avg_pressure,
 							   problem_dim,
 							   is_volume,
-							   velocity_stiffness, mixed_stiffness, pressure_stiffness, b, 1e-3, solver, nlres_norm, x);
+							   stokes, b, 1e-3, solver, nlres_norm, x);
 			it += minimize_aux(false, skipping,
 							   n_bases,
 							   n_pressure_bases,
@@ -132,7 +136,7 @@ namespace polyfem
 							   use_avg_pressure,
 							   problem_dim,
 							   is_volume,
-							   velocity_stiffness, mixed_stiffness, pressure_stiffness, b, gradNorm, solver, nlres_norm, x);
+							   stokes, b, gradNorm, solver, nlres_norm, x);
 
 			solver_info["iterations"] = it;
 			solver_info["gradNorm"] = nlres_norm;
@@ -159,7 +163,7 @@ namespace polyfem
 			const bool use_avg_pressure,
 			const int problem_dim,
 			const bool is_volume,
-			const StiffnessMatrix &velocity_stiffness, const StiffnessMatrix &mixed_stiffness, const StiffnessMatrix &pressure_stiffness,
+			MergedMatrixCache &stokes,
 			const Eigen::VectorXd &rhs, const double grad_norm,
 			std::unique_ptr<LinearSolver> &solver, double &nlres_norm,
 			Eigen::VectorXd &x)
@@ -175,9 +179,7 @@ namespace polyfem
 			time.start();
 			velocity_assembler.set_picard(true);
 			velocity_assembler.assemble_hessian(is_volume, n_bases, false, bases, gbases, ass_vals_cache, 0, x, Eigen::MatrixXd(), mat_cache, nl_matrix);
-			AssemblerUtils::merge_mixed_matrices(n_bases, n_pressure_bases, problem_dim, use_avg_pressure,
-												 velocity_stiffness + nl_matrix, mixed_stiffness, pressure_stiffness,
-												 total_matrix);
+			stokes.add(nl_matrix, total_matrix);
 			time.stop();
 			assembly_time = time.getElapsedTimeInSec();
 			logger().debug("\tNavier Stokes assembly time {}s", time.getElapsedTimeInSec());
@@ -202,17 +204,16 @@ namespace polyfem
 				{
 					velocity_assembler.set_picard(false);
 					velocity_assembler.assemble_hessian(is_volume, n_bases, false, bases, gbases, ass_vals_cache, 0, x, Eigen::MatrixXd(), mat_cache, nl_matrix);
-					AssemblerUtils::merge_mixed_matrices(n_bases, n_pressure_bases, problem_dim, use_avg_pressure,
-														 velocity_stiffness + nl_matrix, mixed_stiffness, pressure_stiffness,
-														 total_matrix);
+					stokes.add(nl_matrix, total_matrix);
 				}
-				dirichlet_solve(*solver, total_matrix, nlres, boundary_nodes, dx, precond_num, "", false, true, use_avg_pressure);
+				linear_solve(*solver, total_matrix, nlres, boundary_nodes, precond_num, use_avg_pressure, dx);
 				// for (int i : boundary_nodes)
 				// 	dx[i] = 0;
 				time.stop();
 				inverting_time += time.getElapsedTimeInSec();
 				logger().debug("\tinverting time {}s", time.getElapsedTimeInSec());
-				logger().debug("\tinverting error: {}", (total_matrix * dx - nlres).norm());
+				if (logger().should_log(spdlog::level::debug))
+					logger().debug("\tinverting error: {}", (total_matrix * dx - nlres).norm());
 
 				x += dx;
 				// TODO check for nans
@@ -220,9 +221,7 @@ namespace polyfem
 				time.start();
 				velocity_assembler.set_picard(true);
 				velocity_assembler.assemble_hessian(is_volume, n_bases, false, bases, gbases, ass_vals_cache, 0, x, Eigen::MatrixXd(), mat_cache, nl_matrix);
-				AssemblerUtils::merge_mixed_matrices(n_bases, n_pressure_bases, problem_dim, use_avg_pressure,
-													 velocity_stiffness + nl_matrix, mixed_stiffness, pressure_stiffness,
-													 total_matrix);
+				stokes.add(nl_matrix, total_matrix);
 				time.stop();
 				logger().debug("\tassembly time {}s", time.getElapsedTimeInSec());
 				assembly_time += time.getElapsedTimeInSec();
@@ -258,5 +257,22 @@ namespace polyfem
 
 			return false;
 		}
+
+		void NavierStokesSolver::linear_solve(
+			polysolve::LinearSolver &solver,
+			StiffnessMatrix &A, Eigen::VectorXd &b,
+			const std::vector<int> &boundary_nodes,
+			const int precond_num,
+			const bool use_avg_pressure,
+			Eigen::VectorXd &x)
+		{
+			if (block_solver)
+			{
+				x.setZero(b.size());
+				block_solver->solve(A, b, boundary_nodes, x);
+			}
+			else
+				dirichlet_solve(solver, A, b, boundary_nodes, x, precond_num, "", false, true, use_avg_pressure);
+		}
 	} // namespace solver
 } // namespace polyfem
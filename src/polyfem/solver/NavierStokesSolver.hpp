@@ -1,5 +1,8 @@
 #pragma once
 
+#include "BlockStokesSolver.hpp"
+#include "MergedMatrixCache.hpp"
+
 #include <polyfem/Common.hpp>
 #include <polyfem/basis/ElementBases.hpp>
 #include <polyfem/assembler/NavierStokes.hpp>
@@ -59,11 +62,20 @@ namespace polyfem
 				const bool use_avg_pressure,
 				const int problem_dim,
 				const bool is_volume,
-				const StiffnessMatrix &velocity_stiffness, const StiffnessMatrix &mixed_stiffness, const StiffnessMatrix &pressure_stiffness,
+				MergedMatrixCache &stokes,
 				const Eigen::VectorXd &rhs, const double grad_norm,
 				std::unique_ptr<polysolve::LinearSolver> &solver, double &nlres_norm,
 				Eigen::VectorXd &x);
 
+			/// @brief Solves the mixed system with the Dirichlet rows replaced, with the block solver if enabled
+			void linear_solve(
+				polysolve::LinearSolver &solver,
+				StiffnessMatrix &A, Eigen::VectorXd &b,
+				const std::vector<int> &boundary_nodes,
+				const int precond_num,
+				const bool use_avg_pressure,
+				Eigen::VectorXd &x);
+
 			const json solver_param;
 			const std::string solver_type;
 			const std::string precond_type;
@@ -80,6 +92,9 @@ namespace polyfem
 			double stokes_matrix_time;
 			double stokes_solve_time;
 
+			/// block preconditioned solver of the mixed systems, if enabled in the linear solver settings
+			std::unique_ptr<BlockStokesSolver> block_solver;
+
 			bool has_nans(const polyfem::StiffnessMatrix &hessian);
 		};
 	} // namespace solver
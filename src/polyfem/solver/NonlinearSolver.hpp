@@ -10,6 +10,8 @@
 
 #include <cppoptlib/solver/isolver.h>
 
+#include <functional>
+
 namespace cppoptlib
 {
 	enum class ErrorCode
@@ -39,7 +41,8 @@ namespace cppoptlib
 
 		void minimize(ProblemType &objFunc, TVector &x) override;
 
-		double line_search(const TVector &x, const TVector &delta_x, ProblemType &objFunc);
+		/// Step size along delta_x, nan if the step is rejected (m_status is Continue to retry from x)
+		virtual double line_search(const TVector &x, const TVector &delta_x, ProblemType &objFunc);
 
 		void get_info(polyfem::json &params) { params = solver_info; }
 
@@ -62,6 +65,7 @@ namespace cppoptlib
 
 		bool normalize_gradient;
 		double use_grad_norm_tol;
+		int line_search_batch_size;
 		double first_grad_norm_tol;
 		double dt;
 
@@ -72,9 +76,27 @@ namespace cppoptlib
 		// Reset the solver at the start of a minimization
 		virtual void reset(const int ndof);
 
+		// Compute the gradient at the iterate, before compute_update_direction at the same x
+		virtual void compute_gradient(ProblemType &objFunc, const TVector &x, TVector &grad) { objFunc.gradient(x, grad); }
+
 		// Compute the search/update direction
 		virtual bool compute_update_direction(ProblemType &objFunc, const TVector &x_vec, const TVector &grad, TVector &direction) = 0;
 
+		/// Called after each accepted line search with its step size and the energy before the step
+		virtual void post_line_search(const double rate, const double energy) {}
+
+		// Work of the iteration which does not depend on the update direction (the energy at the iterate), set by minimize
+		// before compute_update_direction. The solvers run it concurrently with their factorization (see overlap_pending_work),
+		// minimize runs it after compute_update_direction otherwise.
+		std::function<void()> pending_work;
+
+		/// Runs the pending work if it was not run yet
+		void run_pending_work();
+
+		/// Runs task (e.g., the factorization of the Hessian) while another thread runs the pending work,
+		/// task must not use the problem.
+		void overlap_pending_work(const std::function<void()> &task);
+
 		virtual int default_descent_strategy() = 0;
 		virtual void increase_descent_strategy() = 0;
 
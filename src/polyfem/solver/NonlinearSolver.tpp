@@ -2,6 +2,10 @@
 
 #include "NonlinearSolver.hpp"
 
+#ifdef POLYFEM_WITH_TBB
+#include <tbb/task_group.h>
+#endif
+
 namespace cppoptlib
 {
 	template <typename ProblemType>
@@ -18,6 +22,7 @@ namespace cppoptlib
 
 		normalize_gradient = solver_params["relative_gradient"];
 		use_grad_norm_tol = solver_params["line_search"]["use_grad_norm_tol"];
+		line_search_batch_size = solver_params["line_search"]["batch_size"];
 		first_grad_norm_tol = solver_params["first_grad_norm_tol"];
 
 		set_line_search(solver_params["line_search"]["method"]);
@@ -49,6 +54,10 @@ namespace cppoptlib
 		// Set these to nan to indicate they have not been computed yet
 		double old_energy = std::nan("");
 
+		// the forms might have been changed since the last solve
+		objFunc.invalidate_cache();
+		const auto cache_hits_start = objFunc.cache_hits();
+
 		{
 			POLYFEM_SCOPED_TIMER("constraint set update", constraint_set_update_time);
 			objFunc.solution_changed(x);
@@ -88,7 +97,11 @@ namespace cppoptlib
 		utils::Timer timer("non-linear solver", this->total_time);
 		timer.start();
 
-		m_line_search->use_grad_norm_tol = use_grad_norm_tol;
+		if (m_line_search)
+		{
+			m_line_search->use_grad_norm_tol = use_grad_norm_tol;
+			m_line_search->batch_size = line_search_batch_size;
+		}
 
 		logger().debug(
 			"Starting {} solve f₀={:g} ‖∇f₀‖={:g} "
@@ -103,22 +116,16 @@ namespace cppoptlib
 				objFunc.solution_changed(x);
 			}
 
-			double energy;
-			{
+			// the energy is only needed once the direction is known, it is computed while the Hessian is factorized
+			double energy = std::nan("");
+			pending_work = [&]() {
 				POLYFEM_SCOPED_TIMER("compute objective function", obj_fun_time);
 				energy = objFunc.value(x);
-			}
-			if (!std::isfinite(energy))
-			{
-				this->m_status = Status::UserDefined;
-				m_error_code = ErrorCode::NAN_ENCOUNTERED;
-				log_and_throw_error("[{}] f(x) is nan or inf; stopping", name());
-				break;
-			}
+			};
 
 			{
 				POLYFEM_SCOPED_TIMER("compute gradient", grad_time);
-				objFunc.gradient(x, grad);
+				compute_gradient(objFunc, x, grad);
 			}
 
 			const double grad_norm = grad.norm();
@@ -135,7 +142,17 @@ namespace cppoptlib
 			// ------------------------
 
 			// Compute a Δx to update the variable
-			if (!compute_update_direction(objFunc, x, grad, delta_x))
+			const bool has_direction = compute_update_direction(objFunc, x, grad, delta_x);
+			run_pending_work();
+			if (!std::isfinite(energy))
+			{
+				this->m_status = Status::UserDefined;
+				m_error_code = ErrorCode::NAN_ENCOUNTERED;
+				log_and_throw_error("[{}] f(x) is nan or inf; stopping", name());
+				break;
+			}
+
+			if (!has_direction)
 			{
 				this->m_status = Status::Continue;
 				continue;
@@ -251,6 +268,8 @@ namespace cppoptlib
 
 			x += rate * delta_x;
 
+			post_line_search(rate, energy);
+
 			// -----------
 			// Post update
 			// -----------
@@ -299,6 +318,16 @@ namespace cppoptlib
 
 		log_times();
 		update_solver_info();
+
+		const long saved_obj_fun = objFunc.cache_hits().values - cache_hits_start.values;
+		const long saved_grad = objFunc.cache_hits().gradients - cache_hits_start.gradients;
+		const long saved_constraint_set_update = objFunc.cache_hits().solution_changes - cache_hits_start.solution_changes;
+		solver_info["saved_obj_fun_evaluations"] = saved_obj_fun;
+		solver_info["saved_grad_evaluations"] = saved_grad;
+		solver_info["saved_constraint_set_updates"] = saved_constraint_set_update;
+		polyfem::logger().debug(
+			"[{}] reused obj_fun {} times, grad {} times, constraint_set_update {} times",
+			name(), saved_obj_fun, saved_grad, saved_constraint_set_update);
 	}
 
 	template <typename ProblemType>
@@ -329,10 +358,50 @@ namespace cppoptlib
 		return rate;
 	}
 
+	template <typename ProblemType>
+	void NonlinearSolver<ProblemType>::run_pending_work()
+	{
+		if (!pending_work)
+			return;
+
+		const std::function<void()> work = std::move(pending_work);
+		pending_work = nullptr;
+		work();
+	}
+
+	template <typename ProblemType>
+	void NonlinearSolver<ProblemType>::overlap_pending_work(const std::function<void()> &task)
+	{
+#ifdef POLYFEM_WITH_TBB
+		if (pending_work)
+		{
+			const std::function<void()> work = std::move(pending_work);
+			pending_work = nullptr;
+
+			tbb::task_group group;
+			group.run(work);
+			try
+			{
+				task();
+			}
+			catch (...)
+			{
+				group.wait();
+				throw;
+			}
+			// rethrows the exception of the pending work
+			group.wait();
+			return;
+		}
+#endif
+		task();
+	}
+
 	template <typename ProblemType>
 	void NonlinearSolver<ProblemType>::reset(const int ndof)
 	{
 		this->m_current.reset();
+		pending_work = nullptr;
 		descent_strategy = default_descent_strategy();
 		m_error_code = ErrorCode::SUCCESS;
 
@@ -2,9 +2,12 @@
 
 #include <polyfem/Common.hpp>
 #include <polyfem/mesh/LocalBoundary.hpp>
+#include <polyfem/mesh/PointGrid.hpp>
+#include <polyfem/mesh/PointLocator.hpp>
 #include <polyfem/assembler/Problem.hpp>
 #include <polysolve/FEMSolver.hpp>
 #include <polyfem/utils/Logger.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
 
 #include <polyfem/assembler/Assembler.hpp>
 #include <memory>
@@ -60,6 +63,24 @@ namespace polyfem
 						T(e, i) = mesh.cell_vertex(e, i);
 					}
 				}
+
+				// elements around every vertex (counting sort), to relocate the particles from their previous element
+				vertex_elements_offsets.assign(mesh.n_vertices() + 1, 0);
+				for (int e = 0; e < n_el; e++)
+				{
+					for (int i = 0; i < shape; i++)
+						++vertex_elements_offsets[T(e, i) + 1];
+				}
+				for (int v = 0; v < mesh.n_vertices(); v++)
+					vertex_elements_offsets[v + 1] += vertex_elements_offsets[v];
+				vertex_elements.resize(vertex_elements_offsets.back());
+				std::vector<int> next(vertex_elements_offsets.begin(), vertex_elements_offsets.end() - 1);
+				for (int e = 0; e < n_el; e++)
+				{
+					for (int i = 0; i < shape; i++)
+						vertex_elements[next[T(e, i)]++] = e;
+				}
+
 				V = Eigen::MatrixXd::Zero(mesh.n_vertices(), 3);
 				for (int i = 0; i < V.rows(); i++)
 				{
@@ -71,85 +92,21 @@ namespace polyfem
 					if (dim == 2)
 						V(i, 2) = 0;
 				}
-			}
-
-			void initialize_hashtable(const mesh::Mesh &mesh)
-			{
-				Eigen::MatrixXd p0, p1, p;
-				mesh.get_edges(p0, p1);
-				p = p0 - p1;
-				double avg_edge_length = p.rowwise().norm().mean();
 
-				long total_cell_num = 1;
-				for (int d = 0; d < dim; d++)
-				{
-					hash_table_cell_num[d] = (long)std::round((max_domain(d) - min_domain(d)) / avg_edge_length) * 4;
-					logger().debug("hash grid in {} dimension: {}", d, hash_table_cell_num[d]);
-					total_cell_num *= hash_table_cell_num[d];
-				}
-				hash_table.resize(total_cell_num);
-				for (int e = 0; e < T.rows(); e++)
+				// vertices of the boundary elements, one per element and local vertex
+				Eigen::MatrixXd boundary_pts(boundary_elem_id.size() * shape, dim);
+				double avg_edge = 0;
+				for (int e = 0; e < boundary_elem_id.size(); e++)
 				{
-					Eigen::VectorXd min_ = V.row(T(e, 0));
-					Eigen::VectorXd max_ = min_;
-
-					for (int i = 1; i < T.cols(); i++)
-					{
-						Eigen::VectorXd p = V.row(T(e, i));
-						for (int d = 0; d < dim; d++)
-						{
-							if (min_(d) > p(d))
-								min_(d) = p(d);
-							if (max_(d) < p(d))
-								max_(d) = p(d);
-						}
-					}
-
-					Eigen::Matrix<long, Eigen::Dynamic, 1> min_int(dim), max_int(dim);
-
-					for (int d = 0; d < dim; d++)
+					for (int i = 0; i < shape; i++)
 					{
-						double temp = hash_table_cell_num[d] / (max_domain(d) - min_domain(d));
-						min_int(d) = floor((min_(d) * (1 - 1e-14) - min_domain(d)) * temp);
-						max_int(d) = ceil((max_(d) * (1 + 1e-14) - min_domain(d)) * temp);
-
-						if (min_int(d) < 0)
-							min_int(d) = 0;
-						if (max_int(d) > hash_table_cell_num[d])
-							max_int(d) = hash_table_cell_num[d];
-					}
-
-					for (long x = min_int(0); x < max_int(0); x++)
-					{
-						for (long y = min_int(1); y < max_int(1); y++)
-						{
-							if (dim == 2)
-							{
-								long idx = x + y * hash_table_cell_num[0];
-								hash_table[idx].push_back(e);
-							}
-							else
-							{
-								for (long z = min_int(2); z < max_int(2); z++)
-								{
-									long idx = x + (y + z * hash_table_cell_num[1]) * hash_table_cell_num[0];
-									hash_table[idx].push_back(e);
-								}
-							}
-						}
+						boundary_pts.row(e * shape + i) = V.row(T(boundary_elem_id[e], i)).head(dim);
+						avg_edge += (V.row(T(boundary_elem_id[e], i)) - V.row(T(boundary_elem_id[e], (i + 1) % shape))).norm();
 					}
 				}
-
-				float average_intersection_num = 0;
-				int max_intersection_num = 0;
-				for (int i = 0; i < hash_table.size(); i++)
-				{
-					average_intersection_num += hash_table[i].size();
-					(hash_table[i].size() > max_intersection_num) ? (max_intersection_num = hash_table[i].size()) : 1;
-				}
-				average_intersection_num /= hash_table.size();
-				logger().debug("average intersection number for hash grid: {}", average_intersection_num);
-				logger().debug("max intersection number for hash grid: {}", max_intersection_num);
+				if (boundary_pts.rows() > 0)
+					avg_edge /= boundary_pts.rows();
+				boundary_vertices = std::make_shared<mesh::PointGrid>(boundary_pts, avg_edge);
 			}
 
 			OperatorSplittingSolver() {}
@@ -164,7 +121,7 @@ namespace polyfem
 				boundary_nodes = bnd_nodes;
 
 				initialize_mesh(mesh, shape, n_el, local_boundary);
-				initialize_hashtable(mesh);
+				locator = std::make_shared<mesh::PointLocator>(mesh);
 			}
 
 			OperatorSplittingSolver(const mesh::Mesh &mesh,
@@ -297,36 +254,11 @@ namespace polyfem
 
 			int handle_boundary_advection(RowVectorNd &pos)
 			{
-				double dist = 1e10;
-				int idx = -1, local_idx = -1;
-				const int size = boundary_elem_id.size();
-#ifdef POLYFEM_WITH_TBB
-				tbb::parallel_for(0, size, 1, [&](int e)
-#else
-				for (int e = 0; e < size; e++)
-#endif
-								  {
-									  int elem_idx = boundary_elem_id[e];
+				// nearest vertex of the boundary elements
+				const int k = boundary_vertices->nearest(pos.head(dim));
+				assert(k >= 0);
+				const int idx = boundary_elem_id[k / shape], local_idx = k % shape;
 
-									  for (int i = 0; i < shape; i++)
-									  {
-										  double dist_ = 0;
-										  for (int d = 0; d < dim; d++)
-										  {
-											  dist_ += pow(pos(d) - V(T(elem_idx, i), d), 2);
-										  }
-										  dist_ = sqrt(dist_);
-										  if (dist_ < dist)
-										  {
-											  dist = dist_;
-											  idx = elem_idx;
-											  local_idx = i;
-										  }
-									  }
-								  }
-#ifdef POLYFEM_WITH_TBB
-				);
-#endif
 				for (int d = 0; d < dim; d++)
 					pos(d) = V(T(idx, local_idx), d);
 				return idx;
@@ -347,17 +279,20 @@ namespace polyfem
 				return interpolator(gbases, bases, pos_2, vel_2, local_pos, sol);
 			}
 
+			/// velocity at pos, returns its element or -1 if pos is outside of the mesh (the velocity is then the one of the nearest boundary vertex)
+			/// hint is an element tried first, see search_cell
 			int interpolator(const std::vector<basis::ElementBases> &gbases,
 							 const std::vector<basis::ElementBases> &bases,
 							 const RowVectorNd &pos,
 							 RowVectorNd &vel,
 							 Eigen::MatrixXd &local_pos,
-							 const Eigen::MatrixXd &sol)
+							 const Eigen::MatrixXd &sol,
+							 const int hint = -1)
 			{
 				bool insideDomain = true;
 
 				int new_elem;
-				if ((new_elem = search_cell(gbases, pos, local_pos)) == -1)
+				if ((new_elem = search_cell(gbases, pos, local_pos, hint)) == -1)
 				{
 					insideDomain = false;
 					RowVectorNd pos_ = pos;
@@ -365,16 +300,15 @@ namespace polyfem
 					calculate_local_pts(gbases[new_elem], new_elem, pos_, local_pos);
 				}
 
-				// interpolation
+				// interpolation, only the values of the bases are needed
 				vel = RowVectorNd::Zero(dim);
-				assembler::ElementAssemblyValues vals;
-				vals.compute(new_elem, dim == 3, local_pos, bases[new_elem], gbases[new_elem]);
-				for (int d = 0; d < dim; d++)
+				std::vector<assembler::AssemblyValues> vals;
+				bases[new_elem].evaluate_bases(local_pos, vals);
+				for (int i = 0; i < vals.size(); i++)
 				{
-					for (int i = 0; i < vals.basis_values.size(); i++)
-					{
-						vel(d) += vals.basis_values[i].val(0) * sol(bases[new_elem].bases[i].global()[0].index * dim + d);
-					}
+					const int global = bases[new_elem].bases[i].global()[0].index;
+					for (int d = 0; d < dim; d++)
+						vel(d) += vals[i].val(0) * sol(global * dim + d);
 				}
 				if (insideDomain)
 					return new_elem;
@@ -429,47 +363,45 @@ namespace polyfem
 				Eigen::MatrixXd new_sol = Eigen::MatrixXd::Zero(sol.size(), 1);
 				// number of FEM nodes
 				const int n_vert = sol.size() / dim;
-				Eigen::VectorXi traversed = Eigen::VectorXi::Zero(n_vert);
+				if (node_hints.size() != n_vert)
+					initialize_nodes(gbases, bases, local_pts, n_vert);
 
-#ifdef POLYFEM_WITH_TBB
-				tbb::parallel_for(0, n_el, 1, [&](int e)
-#else
-				for (int e = 0; e < n_el; ++e)
-#endif
-								  {
-									  // to compute global position with barycentric coordinate
-									  Eigen::MatrixXd mapped;
-									  gbases[e].eval_geom_mapping(local_pts, mapped);
-
-									  for (int i = 0; i < local_pts.rows(); i++)
-									  {
-										  // global index of this FEM node
-										  int global = bases[e].bases[i].global()[0].index;
-
-										  if (traversed(global))
-											  continue;
-										  traversed(global) = 1;
+				// one task per FEM node, the departure element of the last step is tried first
+				utils::maybe_parallel_for(n_vert, [&](int start, int end, int thread_id) {
+					Eigen::MatrixXd local_pos;
+					for (int global = start; global < end; global++)
+					{
+						if (node_hints[global] < 0)
+							continue;
 
-										  // velocity of this FEM node
-										  RowVectorNd vel_ = sol.block(global * dim, 0, dim, 1).transpose();
+						// velocity of this FEM node
+						RowVectorNd vel_ = sol.block(global * dim, 0, dim, 1).transpose();
 
-										  // global position of this FEM node
-										  RowVectorNd pos_ = RowVectorNd::Zero(1, dim);
-										  for (int d = 0; d < dim; d++)
-											  pos_(d) = mapped(i, d) - vel_(d) * dt;
+						// departure point of this FEM node
+						const RowVectorNd pos_ = node_positions.row(global) - vel_ * dt;
 
-										  Eigen::MatrixXd local_pos;
-										  interpolator(gbases, bases, pos_, vel_, local_pos, sol);
+						const int e = interpolator(gbases, bases, pos_, vel_, local_pos, sol, node_hints[global]);
+						if (e >= 0)
+							node_hints[global] = e;
 
-										  new_sol.block(global * dim, 0, dim, 1) = vel_.transpose();
-									  }
-								  }
-#ifdef POLYFEM_WITH_TBB
-				);
-#endif
+						new_sol.block(global * dim, 0, dim, 1) = vel_.transpose();
+					}
+				});
 				sol.swap(new_sol);
 			}
 
+			/// position of the density grid point idx
+			RowVectorNd grid_point(const long idx) const
+			{
+				const long nx = grid_cell_num(0) + 1, ny = grid_cell_num(1) + 1;
+				RowVectorNd pos(dim);
+				pos(0) = (idx % nx) * resolution + min_domain(0);
+				pos(1) = ((idx / nx) % ny) * resolution + min_domain(1);
+				if (dim == 3)
+					pos(2) = (idx / (nx * ny)) * resolution + min_domain(2);
+				return pos;
+			}
+
 			void advect_density_exact(const std::vector<basis::ElementBases> &gbases,
 									  const std::vector<basis::ElementBases> &bases,
 									  const std::shared_ptr<assembler::Problem> problem,
@@ -478,68 +410,28 @@ namespace polyfem
 									  const int RK = 3)
 			{
 				Eigen::VectorXd new_density = Eigen::VectorXd::Zero(density.size());
-				const int Nx = grid_cell_num(0);
-#ifdef POLYFEM_WITH_TBB
-				tbb::parallel_for(0, Nx + 1, 1, [&](int i)
-#else
-				for (int i = 0; i <= Nx; i++)
-#endif
-								  {
-									  for (int j = 0; j <= grid_cell_num(1); j++)
-									  {
-										  if (dim == 2)
-										  {
-											  Eigen::MatrixXd pos(1, dim);
-											  pos(0) = i * resolution + min_domain(0);
-											  pos(1) = j * resolution + min_domain(1);
-											  const long idx = i + (long)j * (grid_cell_num(0) + 1);
-
-											  Eigen::MatrixXd vel1, pos_;
-											  problem->exact(pos, t, vel1);
-											  if (RK > 1)
-											  {
-												  Eigen::MatrixXd vel2, vel3;
-												  problem->exact(pos - 0.5 * dt * vel1, t, vel2);
-												  problem->exact(pos - 0.75 * dt * vel2, t, vel3);
-												  pos_ = pos - (2 * vel1 + 3 * vel2 + 4 * vel3) * dt / 9;
-											  }
-											  else
-											  {
-												  pos_ = pos - vel1 * dt;
-											  }
-											  interpolator(pos_, new_density[idx]);
-										  }
-										  else
-										  {
-											  for (int k = 0; k <= grid_cell_num(2); k++)
-											  {
-												  RowVectorNd pos(1, dim);
-												  pos(0) = i * resolution + min_domain(0);
-												  pos(1) = j * resolution + min_domain(1);
-												  pos(2) = k * resolution + min_domain(2);
-												  const long idx = i + (j + (long)k * (grid_cell_num(1) + 1)) * (grid_cell_num(0) + 1);
-
-												  Eigen::MatrixXd vel1, pos_;
-												  problem->exact(pos, t, vel1);
-												  if (RK > 1)
-												  {
-													  Eigen::MatrixXd vel2, vel3;
-													  problem->exact(pos - 0.5 * dt * vel1, t, vel2);
-													  problem->exact(pos - 0.75 * dt * vel2, t, vel3);
-													  pos_ = pos - (2 * vel1 + 3 * vel2 + 4 * vel3) * dt / 9;
-												  }
-												  else
-												  {
-													  pos_ = pos - vel1 * dt;
-												  }
-												  interpolator(pos_, new_density[idx]);
-											  }
-										  }
-									  }
-								  }
-#ifdef POLYFEM_WITH_TBB
-				);
-#endif
+				// one task per grid point, for the balance of the 3D grids
+				utils::maybe_parallel_for(density.size(), [&](int start, int end, int thread_id) {
+					for (long idx = start; idx < end; idx++)
+					{
+						const Eigen::MatrixXd pos = grid_point(idx);
+
+						Eigen::MatrixXd vel1, pos_;
+						problem->exact(pos, t, vel1);
+						if (RK > 1)
+						{
+							Eigen::MatrixXd vel2, vel3;
+							problem->exact(pos - 0.5 * dt * vel1, t, vel2);
+							problem->exact(pos - 0.75 * dt * vel2, t, vel3);
+							pos_ = pos - (2 * vel1 + 3 * vel2 + 4 * vel3) * dt / 9;
+						}
+						else
+						{
+							pos_ = pos - vel1 * dt;
+						}
+						interpolator(pos_, new_density[idx]);
+					}
+				});
 				density.swap(new_density);
 			}
 
@@ -550,69 +442,34 @@ namespace polyfem
 								const int RK = 3)
 			{
 				Eigen::VectorXd new_density = Eigen::VectorXd::Zero(density.size());
-				const int Nx = grid_cell_num(0);
-#ifdef POLYFEM_WITH_TBB
-				tbb::parallel_for(0, Nx + 1, 1, [&](int i)
-#else
-				for (int i = 0; i <= Nx; i++)
-#endif
-								  {
-									  for (int j = 0; j <= grid_cell_num(1); j++)
-									  {
-										  Eigen::MatrixXd local_pos;
-										  if (dim == 2)
-										  {
-											  RowVectorNd pos(1, dim);
-											  pos(0) = i * resolution + min_domain(0);
-											  pos(1) = j * resolution + min_domain(1);
-											  const long idx = i + (long)j * (grid_cell_num(0) + 1);
-
-											  RowVectorNd vel1, pos_;
-											  interpolator(gbases, bases, pos, vel1, local_pos, sol);
-											  if (RK > 1)
-											  {
-												  RowVectorNd vel2, vel3;
-												  interpolator(gbases, bases, pos - 0.5 * dt * vel1, vel2, local_pos, sol);
-												  interpolator(gbases, bases, pos - 0.75 * dt * vel2, vel3, local_pos, sol);
-												  pos_ = pos - (2 * vel1 + 3 * vel2 + 4 * vel3) * dt / 9;
-											  }
-											  else
-											  {
-												  pos_ = pos - vel1 * dt;
-											  }
-											  interpolator(pos_, new_density[idx]);
-										  }
-										  else
-										  {
-											  for (int k = 0; k <= grid_cell_num(2); k++)
-											  {
-												  RowVectorNd pos(1, dim);
-												  pos(0) = i * resolution + min_domain(0);
-												  pos(1) = j * resolution + min_domain(1);
-												  pos(2) = k * resolution + min_domain(2);
-												  const long idx = i + (j + (long)k * (grid_cell_num(1) + 1)) * (grid_cell_num(0) + 1);
-
-												  RowVectorNd vel1, pos_;
-												  interpolator(gbases, bases, pos, vel1, local_pos, sol);
-												  if (RK > 1)
-												  {
-													  RowVectorNd vel2, vel3;
-													  interpolator(gbases, bases, pos - 0.5 * dt * vel1, vel2, local_pos, sol);
-													  interpolator(gbases, bases, pos - 0.75 * dt * vel2, vel3, local_pos, sol);
-													  pos_ = pos - (2 * vel1 + 3 * vel2 + 4 * vel3) * dt / 9;
-												  }
-												  else
-												  {
-													  pos_ = pos - vel1 * dt;
-												  }
-												  interpolator(pos_, new_density[idx]);
-											  }
-										  }
-									  }
-								  }
-#ifdef POLYFEM_WITH_TBB
-				);
-#endif
+				// the grid does not move, the element of every grid point is kept across the steps
+				if (density_hints.size() != density.size())
+					density_hints.assign(density.size(), -1);
+
+				utils::maybe_parallel_for(density.size(), [&](int start, int end, int thread_id) {
+					Eigen::MatrixXd local_pos;
+					for (long idx = start; idx < end; idx++)
+					{
+						const RowVectorNd pos = grid_point(idx);
+
+						RowVectorNd vel1, pos_;
+						const int e = interpolator(gbases, bases, pos, vel1, local_pos, sol, density_hints[idx]);
+						if (e >= 0)
+							density_hints[idx] = e;
+						if (RK > 1)
+						{
+							RowVectorNd vel2, vel3;
+							interpolator(gbases, bases, pos - 0.5 * dt * vel1, vel2, local_pos, sol, density_hints[idx]);
+							interpolator(gbases, bases, pos - 0.75 * dt * vel2, vel3, local_pos, sol, density_hints[idx]);
+							pos_ = pos - (2 * vel1 + 3 * vel2 + 4 * vel3) * dt / 9;
+						}
+						else
+						{
+							pos_ = pos - vel1 * dt;
+						}
+						interpolator(pos_, new_density[idx]);
+					}
+				});
 				density.swap(new_density);
 			}
 
@@ -702,35 +559,47 @@ namespace polyfem
 							}
 						}
 					}
-					// g2p -- update velocity
-#ifdef POLYFEM_WITH_TBB
-					tbb::parallel_for(0, (int)cellI_particle.size(), 1, [&](int pI)
-#else
-					for (int pI = 0; pI < cellI_particle.size(); ++pI)
-#endif
-									  {
-										  if (!isRedundant[pI])
-										  {
-											  int e = cellI_particle[pI];
-											  Eigen::MatrixXd local_pts_particle;
-											  calculate_local_pts(gbases[e], e, position_particle[pI], local_pts_particle);
-
-											  assembler::ElementAssemblyValues vals;
-											  vals.compute(e, dim == 3, local_pts_particle, bases[e], gbases[e]); // possibly higher-order
-											  RowVectorNd FLIPdVel, PICVel;
-											  FLIPdVel.setZero(1, dim);
-											  PICVel.setZero(1, dim);
-											  for (int i = 0; i < vals.basis_values.size(); ++i)
-											  {
-												  FLIPdVel += vals.basis_values[i].val(0) * (sol.block(bases[e].bases[i].global()[0].index * dim, 0, dim, 1) - new_sol.block(bases[e].bases[i].global()[0].index * dim, 0, dim, 1)).transpose();
-												  PICVel += vals.basis_values[i].val(0) * sol.block(bases[e].bases[i].global()[0].index * dim, 0, dim, 1).transpose();
-											  }
-											  velocity_particle[pI] = (1.0 - FLIPRatio) * PICVel + FLIPRatio * (velocity_particle[pI] + FLIPdVel);
-										  }
-									  }
-#ifdef POLYFEM_WITH_TBB
-					);
-#endif
+					// g2p -- update velocity, the particles are sorted by element so the bases are evaluated once per element
+					utils::maybe_parallel_for(n_el, [&](int start, int end, int thread_id) {
+						Eigen::MatrixXd local_pts_particle, tmp;
+						std::vector<int> particles;
+						for (int e = start; e < end; ++e)
+						{
+							particles.clear();
+							for (int pI = particle_offsets[e]; pI < particle_offsets[e + 1]; ++pI)
+							{
+								if (!isRedundant[pI])
+									particles.push_back(pI);
+							}
+							if (particles.empty())
+								continue;
+
+							local_pts_particle.resize(particles.size(), dim);
+							for (int k = 0; k < particles.size(); ++k)
+							{
+								calculate_local_pts(gbases[e], e, position_particle[particles[k]], tmp);
+								local_pts_particle.row(k) = tmp;
+							}
+
+							assembler::ElementAssemblyValues vals;
+							vals.compute(e, dim == 3, local_pts_particle, bases[e], gbases[e]); // possibly higher-order
+							for (int k = 0; k < particles.size(); ++k)
+							{
+								const int pI = particles[k];
+								RowVectorNd FLIPdVel, PICVel;
+								FLIPdVel.setZero(1, dim);
+								PICVel.setZero(1, dim);
+								for (int i = 0; i < vals.basis_values.size(); ++i)
+								{
+									const int global = bases[e].bases[i].global()[0].index;
+									FLIPdVel += vals.basis_values[i].val(k) * (sol.block(global * dim, 0, dim, 1) - new_sol.block(global * dim, 0, dim, 1)).transpose();
+									PICVel += vals.basis_values[i].val(k) * sol.block(global * dim, 0, dim, 1).transpose();
+								}
+								velocity_particle[pI] = (1.0 - FLIPRatio) * PICVel + FLIPRatio * (velocity_particle[pI] + FLIPdVel);
+							}
+						}
+					});
+
 					// resample
 					for (int e = 0; e < n_el; ++e)
 					{
@@ -780,59 +649,57 @@ namespace polyfem
 					}
 				}
 
-				// advect
-				std::vector<assembler::ElementAssemblyValues> velocity_interpolator(ppe * n_el);
-#ifdef POLYFEM_WITH_TBB
-				tbb::parallel_for(0, (int)(ppe * n_el), 1, [&](int pI)
-#else
-				for (int pI = 0; pI < ppe * n_el; ++pI)
-#endif
-								  {
-									  // update particle position via advection
-									  RowVectorNd newvel;
-									  Eigen::MatrixXd local_pos;
-									  cellI_particle[pI] = trace_back(gbases, bases, position_particle[pI], velocity_particle[pI],
-																	  position_particle[pI], newvel, local_pos, sol, -dt);
-
-									  // RK3:
-									  // RowVectorNd bypass, vel2, vel3;
-									  // trace_back( gbases, bases, position_particle[pI], velocity_particle[pI],
-									  //     bypass, vel2, sol, -0.5 * dt);
-									  // trace_back( gbases, bases, position_particle[pI], vel2,
-									  //     bypass, vel3, sol, -0.75 * dt);
-									  // trace_back( gbases, bases, position_particle[pI],
-									  //     2 * velocity_particle[pI] + 3 * vel2 + 4 * vel3,
-									  //     position_particle[pI], bypass, sol, -dt / 9);
-
-									  // prepare P2G
-									  if (cellI_particle[pI] >= 0)
-									  {
-										  // construct interpolator (always linear for P2G, can use gaussian or bspline later)
-										  velocity_interpolator[pI].compute(cellI_particle[pI], dim == 3, local_pos,
-																			gbases[cellI_particle[pI]], gbases[cellI_particle[pI]]);
-									  }
-								  }
-#ifdef POLYFEM_WITH_TBB
-				);
-#endif
+				// advect, the particles are first looked for around their previous element
+				local_particle.resize(ppe * n_el);
+				utils::maybe_parallel_for(ppe * n_el, [&](int start, int end, int thread_id) {
+					Eigen::MatrixXd local_pos;
+					for (int pI = start; pI < end; ++pI)
+					{
+						position_particle[pI] += velocity_particle[pI] * dt;
+						cellI_particle[pI] = search_cell(gbases, position_particle[pI], local_pos, cellI_particle[pI]);
+						if (cellI_particle[pI] >= 0)
+							local_particle[pI] = local_pos;
+					}
+				});
+
+				sort_particles();
+
+				// P2G, the interpolators are evaluated per element (always linear for P2G, can use gaussian or bspline later)
+				std::vector<Eigen::MatrixXd> particle_weights(n_el);
+				utils::maybe_parallel_for(n_el, [&](int start, int end, int thread_id) {
+					Eigen::MatrixXd local_pos;
+					for (int e = start; e < end; ++e)
+					{
+						const int n_particles = particle_offsets[e + 1] - particle_offsets[e];
+						if (n_particles == 0)
+							continue;
+
+						local_pos.resize(n_particles, dim);
+						for (int k = 0; k < n_particles; ++k)
+							local_pos.row(k) = local_particle[particle_offsets[e] + k];
+
+						assembler::ElementAssemblyValues vals;
+						vals.compute(e, dim == 3, local_pos, gbases[e], gbases[e]);
+						particle_weights[e].resize(vals.basis_values.size(), n_particles);
+						for (int i = 0; i < vals.basis_values.size(); ++i)
+							particle_weights[e].row(i) = vals.basis_values[i].val.transpose();
+					}
+				});
 
-				// P2G
 				new_sol = Eigen::MatrixXd::Zero(sol.size(), 1);
 				new_sol_w = Eigen::MatrixXd::Zero(sol.size() / dim, 1);
 				new_sol_w.array() += 1e-13;
-				for (int pI = 0; pI < ppe * n_el; ++pI)
+				for (int e = 0; e < n_el; ++e)
 				{
-					int cellI = cellI_particle[pI];
-					if (cellI == -1)
-					{
-						continue;
-					}
-					assembler::ElementAssemblyValues &vals = velocity_interpolator[pI];
-					for (int i = 0; i < vals.basis_values.size(); ++i)
+					for (int k = 0; k < particle_weights[e].cols(); ++k)
 					{
-						new_sol.block(bases[cellI].bases[i].global()[0].index * dim, 0, dim, 1) +=
-							vals.basis_values[i].val(0) * velocity_particle[pI].transpose();
-						new_sol_w(bases[cellI].bases[i].global()[0].index) += vals.basis_values[i].val(0);
+						const int pI = particle_offsets[e] + k;
+						for (int i = 0; i < particle_weights[e].rows(); ++i)
+						{
+							const int global = bases[e].bases[i].global()[0].index;
+							new_sol.block(global * dim, 0, dim, 1) += particle_weights[e](i, k) * velocity_particle[pI].transpose();
+							new_sol_w(global) += particle_weights[e](i, k);
+						}
 					}
 				}
 				// TODO: need to add up boundary velocities and weights because of perodic BC
@@ -976,37 +843,31 @@ namespace polyfem
 
 			void solve_diffusion_1st(const StiffnessMatrix &mass, const std::vector<int> &bnd_nodes, Eigen::MatrixXd &sol)
 			{
-				Eigen::VectorXd rhs;
+				// sol is interleaved per node, seen as a #nodes x dim row major matrix it has one column per component
+				const int n = sol.size() / dim;
+				Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>> sol_nodes(sol.data(), n, dim);
 
-				for (int d = 0; d < dim; d++)
-				{
-					Eigen::VectorXd x(sol.size() / dim);
-					for (int j = 0; j < x.size(); j++)
-					{
-						x(j) = sol(j * dim + d);
-					}
-					rhs = mass * x;
+				Eigen::MatrixXd x = sol_nodes;
+				// one product for all the components
+				Eigen::MatrixXd rhs = mass * x;
 
-					// keep dirichlet bc
-					for (int i = 0; i < bnd_nodes.size(); i++)
-					{
-						rhs(bnd_nodes[i]) = x(bnd_nodes[i]);
-					}
-
-					// if (solver_type == "Pardiso" || solver_type == "Eigen::SimplicialLDLT" || solver_type == "Eigen::SparseLU")
-					{
-						dirichlet_solve_prefactorized(*solver_diffusion, mat_diffusion, rhs, bnd_nodes, x);
-					}
-					// else
-					// {
-					// dirichlet_solve(*solver_diffusion, mat_diffusion, rhs, bnd_nodes, x, mat_diffusion.rows(), "", false, false, false);
-					// }
+				// keep dirichlet bc
+				for (int i = 0; i < bnd_nodes.size(); i++)
+				{
+					rhs.row(bnd_nodes[i]) = x.row(bnd_nodes[i]);
+				}
 
-					for (int j = 0; j < x.size(); j++)
-					{
-						sol(j * dim + d) = x(j);
-					}
+				// the prefactorized solver takes one right-hand side at a time
+				Eigen::VectorXd b, x_d;
+				for (int d = 0; d < dim; d++)
+				{
+					b = rhs.col(d);
+					x_d = x.col(d);
+					dirichlet_solve_prefactorized(*solver_diffusion, mat_diffusion, b, bnd_nodes, x_d);
+					x.col(d) = x_d;
 				}
+
+				sol_nodes = x;
 			}
 
 			void external_force(const mesh::Mesh &mesh,
@@ -1052,23 +913,12 @@ namespace polyfem
 
 			void solve_pressure(const StiffnessMatrix &mixed_stiffness, const std::vector<int> &pressure_boundary_nodes, Eigen::MatrixXd &sol, Eigen::MatrixXd &pressure)
 			{
-				Eigen::VectorXd rhs;
-				if (pressure_boundary_nodes.size() == 0)
-					rhs = Eigen::VectorXd::Zero(mixed_stiffness.rows() + 1); // mixed_stiffness * sol;
-				else
-					rhs = Eigen::VectorXd::Zero(mixed_stiffness.rows());     // mixed_stiffness * sol;
-
-				Eigen::VectorXd temp = mixed_stiffness * sol;
-				for (int i = 0; i < temp.rows(); i++)
-				{
-					rhs(i) = temp(i);
-				}
+				// without pressure boundary conditions the last row is the zero mean constraint
+				Eigen::VectorXd rhs = Eigen::VectorXd::Zero(mixed_stiffness.rows() + (pressure_boundary_nodes.size() == 0 ? 1 : 0));
+				rhs.head(mixed_stiffness.rows()) = mixed_stiffness * sol;
 
 				Eigen::VectorXd x = Eigen::VectorXd::Zero(rhs.size());
-				for (int i = 0; i < pressure.size(); i++)
-				{
-					x(i) = pressure(i);
-				}
+				x.head(pressure.size()) = Eigen::Map<const Eigen::VectorXd>(pressure.data(), pressure.size());
 
 				for (int i = 0; i < pressure_boundary_nodes.size(); i++)
 				{
@@ -1181,42 +1031,93 @@ namespace polyfem
 				}
 			}
 
-			long search_cell(const std::vector<basis::ElementBases> &gbases, const RowVectorNd &pos, Eigen::MatrixXd &local_pts)
+			/// positions of the FEM nodes of the velocity and the element of each one, kept across the advection steps
+			void initialize_nodes(const std::vector<basis::ElementBases> &gbases,
+								  const std::vector<basis::ElementBases> &bases,
+								  const Eigen::MatrixXd &local_pts,
+								  const int n_nodes)
 			{
-				Eigen::Matrix<long, Eigen::Dynamic, 1> pos_int(dim);
-				for (int d = 0; d < dim; d++)
-				{
-					pos_int(d) = floor((pos(d) - min_domain(d)) / (max_domain(d) - min_domain(d)) * hash_table_cell_num[d]);
-					if (pos_int(d) < 0)
-						return -1;
-					else if (pos_int(d) >= hash_table_cell_num[d])
-						return -1;
-				}
+				node_positions.setZero(n_nodes, dim);
+				node_hints.assign(n_nodes, -1);
 
-				long idx = 0, dim_num = 1;
-				for (int d = 0; d < dim; d++)
+				Eigen::MatrixXd mapped;
+				for (int e = 0; e < n_el; ++e)
 				{
-					idx += pos_int(d) * dim_num;
-					dim_num *= hash_table_cell_num[d];
+					gbases[e].eval_geom_mapping(local_pts, mapped);
+					for (int i = 0; i < local_pts.rows(); i++)
+					{
+						const int global = bases[e].bases[i].global()[0].index;
+						if (node_hints[global] >= 0)
+							continue;
+						node_hints[global] = e;
+						node_positions.row(global) = mapped.row(i);
+					}
 				}
+			}
 
-				const std::vector<long> &list = hash_table[idx];
-				for (auto it = list.begin(); it != list.end(); it++)
-				{
-					calculate_local_pts(gbases[*it], *it, pos, local_pts);
+			bool inside_element(const std::vector<basis::ElementBases> &gbases, const int e, const RowVectorNd &pos, Eigen::MatrixXd &local_pts)
+			{
+				calculate_local_pts(gbases[e], e, pos, local_pts);
 
-					if (shape == dim + 1)
-					{
-						if (local_pts.minCoeff() > -1e-13 && local_pts.sum() < 1 + 1e-13)
-							return *it;
-					}
-					else
+				if (shape == dim + 1)
+					return local_pts.minCoeff() > -1e-13 && local_pts.sum() < 1 + 1e-13;
+				else
+					return local_pts.minCoeff() > -1e-13 && local_pts.maxCoeff() < 1 + 1e-13;
+			}
+
+			/// element containing pos, -1 if outside of the mesh
+			/// hint (e.g., the previous element of a particle) and the elements sharing one of its vertices are tried before the locator
+			long search_cell(const std::vector<basis::ElementBases> &gbases, const RowVectorNd &pos, Eigen::MatrixXd &local_pts, const int hint = -1)
+			{
+				if (hint >= 0)
+				{
+					if (inside_element(gbases, hint, pos, local_pts))
+						return hint;
+					for (int i = 0; i < shape; i++)
 					{
-						if (local_pts.minCoeff() > -1e-13 && local_pts.maxCoeff() < 1 + 1e-13)
-							return *it;
+						const int v = T(hint, i);
+						for (int k = vertex_elements_offsets[v]; k < vertex_elements_offsets[v + 1]; k++)
+						{
+							const int e = vertex_elements[k];
+							if (e != hint && inside_element(gbases, e, pos, local_pts))
+								return e;
+						}
 					}
 				}
-				return -1; // not inside any elem
+
+				return locator->locate(
+					pos, [&](const RowVectorNd &p, const int e, Eigen::MatrixXd &coords) {
+						return inside_element(gbases, e, p, coords);
+					},
+					local_pts);
+			}
+
+			/// sorts the particles by element (counting sort, the ones outside of the mesh last),
+			/// the particles of element e are then particle_offsets[e] ... particle_offsets[e + 1] - 1
+			void sort_particles()
+			{
+				const int n = cellI_particle.size();
+				particle_offsets.assign(n_el + 2, 0);
+				for (const int c : cellI_particle)
+					++particle_offsets[(c < 0 ? n_el : c) + 1];
+				for (int e = 0; e <= n_el; e++)
+					particle_offsets[e + 1] += particle_offsets[e];
+
+				std::vector<int> order(n);
+				std::vector<int> next(particle_offsets.begin(), particle_offsets.end() - 1);
+				for (int pI = 0; pI < n; pI++)
+					order[next[cellI_particle[pI] < 0 ? n_el : cellI_particle[pI]]++] = pI;
+
+				const auto permute = [&](auto &values) {
+					std::remove_reference_t<decltype(values)> tmp(n);
+					for (int k = 0; k < n; k++)
+						tmp[k] = std::move(values[order[k]]);
+					values.swap(tmp);
+				};
+				permute(position_particle);
+				permute(velocity_particle);
+				permute(cellI_particle);
+				permute(local_particle);
 			}
 
 			bool outside_quad(const std::vector<RowVectorNd> &vert, const RowVectorNd &pos)
@@ -1392,16 +1293,32 @@ namespace polyfem
 			Eigen::MatrixXd V;
 			Eigen::MatrixXi T;
 
-			std::vector<std::vector<long>> hash_table;
-			std::array<long, 3> hash_table_cell_num;
+			/// elements containing the particles
+			std::shared_ptr<mesh::PointLocator> locator;
 
 			std::vector<RowVectorNd> position_particle;
 			std::vector<RowVectorNd> velocity_particle;
 			std::vector<int> cellI_particle;
+			/// coordinates of the particles in their element
+			std::vector<RowVectorNd> local_particle;
+			/// first particle of every element, see sort_particles
+			std::vector<int> particle_offsets;
+
+			/// positions of the FEM nodes of the velocity and departure element of each one at the last step, see initialize_nodes
+			Eigen::MatrixXd node_positions;
+			std::vector<int> node_hints;
+			/// element of every density grid point
+			std::vector<int> density_hints;
 			Eigen::MatrixXd new_sol;
 			Eigen::MatrixXd new_sol_w;
 
+			/// elements around every vertex, vertex_elements[vertex_elements_offsets[v]] ... vertex_elements[vertex_elements_offsets[v + 1] - 1]
+			std::vector<int> vertex_elements_offsets;
+			std::vector<int> vertex_elements;
+
 			std::vector<int> boundary_elem_id;
+			/// vertices of the boundary elements, to snap the points leaving the domain
+			std::shared_ptr<mesh::PointGrid> boundary_vertices;
 			std::vector<int> boundary_nodes;
 
 			std::unique_ptr<polysolve::LinearSolver> solver_diffusion;
@@ -0,0 +1,101 @@
+#include "PMultigridSolver.hpp"
+
+#include <polyfem/quadrature/Quadrature.hpp>
+#include <polyfem/utils/Logger.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace polyfem::solver
+{
+	PMultigridSolver::PMultigridSolver(const json &linear_params)
+		: MultigridSolver(linear_params, linear_params["p_multigrid"])
+	{
+	}
+
+	bool PMultigridSolver::is_enabled(const json &linear_params)
+	{
+		return linear_params.contains("p_multigrid") && linear_params["p_multigrid"].is_object() && linear_params["p_multigrid"]["enabled"].get<bool>();
+	}
+
+	StiffnessMatrix PMultigridSolver::prolongation(
+		const std::vector<basis::ElementBases> &fine_bases,
+		const int n_fine,
+		const std::vector<basis::ElementBases> &coarse_bases,
+		const int n_coarse,
+		const int problem_dim)
+	{
+		if (fine_bases.size() != coarse_bases.size())
+			log_and_throw_error("The coarse and fine bases must be on the same mesh, got {} and {} elements", coarse_bases.size(), fine_bases.size());
+
+		std::vector<bool> assigned(n_fine, false);
+		std::vector<Eigen::Triplet<double>> triplets;
+
+		std::vector<assembler::AssemblyValues> fine_vals, coarse_vals;
+		for (size_t e = 0; e < fine_bases.size(); ++e)
+		{
+			const basis::ElementBases &fine = fine_bases[e];
+			const basis::ElementBases &coarse = coarse_bases[e];
+			if (!fine.has_parameterization || !coarse.has_parameterization)
+				log_and_throw_error("p-multigrid needs parametric bases, element {} has none", e);
+
+			// the continuous coarse function has the same coefficients on every element, the first one sets them
+			bool has_new_dof = false;
+			for (const auto &b : fine.bases)
+			{
+				if (b.global().size() == 1 && !assigned[b.global()[0].index])
+					has_new_dof = true;
+			}
+			if (!has_new_dof)
+				continue;
+
+			// the mass quadrature integrates the products of two fine bases
+			quadrature::Quadrature quadrature;
+			fine.compute_mass_quadrature(quadrature);
+			fine.evaluate_bases(quadrature.points, fine_vals);
+			coarse.evaluate_bases(quadrature.points, coarse_vals);
+
+			Eigen::MatrixXd phi_fine(quadrature.size(), fine_vals.size());
+			for (size_t j = 0; j < fine_vals.size(); ++j)
+				phi_fine.col(j) = fine_vals[j].val;
+			Eigen::MatrixXd phi_coarse(quadrature.size(), coarse_vals.size());
+			for (size_t k = 0; k < coarse_vals.size(); ++k)
+				phi_coarse.col(k) = coarse_vals[k].val;
+
+			// L2 projection of the coarse bases on the fine ones in the reference element
+			const Eigen::MatrixXd weighted = quadrature.weights.asDiagonal() * phi_fine;
+			const Eigen::MatrixXd local = (phi_fine.transpose() * weighted).ldlt().solve(weighted.transpose() * phi_coarse);
+
+			for (size_t j = 0; j < fine_vals.size(); ++j)
+			{
+				// constrained (hanging) nodes are not dofs
+				const auto &fine_global = fine.bases[j].global();
+				if (fine_global.size() != 1 || assigned[fine_global[0].index])
+					continue;
+
+				const int row = fine_global[0].index;
+				assigned[row] = true;
+				for (size_t k = 0; k < coarse_vals.size(); ++k)
+				{
+					const double v = local(j, k) / fine_global[0].val;
+					if (std::abs(v) < 1e-12)
+						continue;
+					for (const auto &g : coarse.bases[k].global())
+					{
+						for (int d = 0; d < problem_dim; ++d)
+							triplets.emplace_back(row * problem_dim + d, g.index * problem_dim + d, v * g.val);
+					}
+				}
+			}
+		}
+
+		const int n_missing = std::count(assigned.begin(), assigned.end(), false);
+		if (n_missing > 0)
+			logger().warn("p-multigrid prolongation: {} fine bases are not interpolated from the coarse ones", n_missing);
+
+		StiffnessMatrix P(n_fine * problem_dim, n_coarse * problem_dim);
+		P.setFromTriplets(triplets.begin(), triplets.end());
+		P.makeCompressed();
+		return P;
+	}
+} // namespace polyfem::solver
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "MultigridSolver.hpp"
+
+namespace polyfem::solver
+{
+	/// @brief Two-level p-multigrid for high-order Lagrange bases
+	/// The error left by the smoother on the high-order level is corrected on a lower order space of the same
+	/// mesh (usually P1/Q1, see MultigridSolver::build_linear_bases), where P is the prolongation from the lower
+	/// order bases to the high-order ones.
+	class PMultigridSolver : public MultigridSolver
+	{
+	public:
+		/// @param[in] linear_params settings of the linear solver (/solver/linear), the multigrid settings are in "p_multigrid"
+		PMultigridSolver(const json &linear_params);
+
+		/// @brief Prolongation from the coarse to the fine bases, the coarse space must be contained in the fine one on every element
+		/// The fine coefficients of every coarse basis are the local L2 projection in the reference element (exact for nested spaces).
+		/// @param[in] fine_bases high-order bases
+		/// @param[in] n_fine number of fine bases
+		/// @param[in] coarse_bases lower order bases on the same mesh
+		/// @param[in] n_coarse number of coarse bases
+		/// @param[in] problem_dim number of dofs per basis, P is repeated for every component
+		/// @return (n_fine * problem_dim) x (n_coarse * problem_dim) prolongation
+		static StiffnessMatrix prolongation(
+			const std::vector<basis::ElementBases> &fine_bases,
+			const int n_fine,
+			const std::vector<basis::ElementBases> &coarse_bases,
+			const int n_coarse,
+			const int problem_dim);
+
+		void set_prolongation(const StiffnessMatrix &P) { set_prolongations({P}); }
+
+		/// @brief p-multigrid settings are enabled in the linear solver settings
+		static bool is_enabled(const json &linear_params);
+	};
+} // namespace polyfem::solver
@@ -0,0 +1,424 @@
+#include "SchwarzSolver.hpp"
+
+#include <polyfem/utils/Logger.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
+#include <polyfem/utils/par_for.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace polyfem::solver
+{
+	namespace
+	{
+		/// nodes of the element, including the ones of the constrained (hanging) nodes
+		void element_nodes(const basis::ElementBases &el, std::vector<int> &nodes)
+		{
+			nodes.clear();
+			for (const auto &b : el.bases)
+			{
+				for (const auto &g : b.global())
+					nodes.push_back(g.index);
+			}
+		}
+	} // namespace
+
+	SchwarzSolver::SchwarzSolver(const json &linear_params)
+	{
+		const json &params = linear_params["schwarz"];
+		overlap_ = params["overlap"];
+		use_coarse_space_ = params["coarse_space"];
+		tolerance_ = params["tolerance"];
+		max_iter_ = params["max_iter"];
+
+		if (overlap_ < 0)
+			log_and_throw_error("Invalid Schwarz overlap {}", overlap_);
+	}
+
+	int SchwarzSolver::n_subdomains(const json &linear_params)
+	{
+		const int n = linear_params["schwarz"]["n_subdomains"];
+		return n > 0 ? n : int(utils::get_n_threads());
+	}
+
+	bool SchwarzSolver::is_enabled(const json &linear_params)
+	{
+		return linear_params.contains("schwarz") && linear_params["schwarz"].is_object() && linear_params["schwarz"]["enabled"].get<bool>();
+	}
+
+	void SchwarzSolver::set_subdomains(const Eigen::VectorXi &part, const int n_parts, const std::vector<basis::ElementBases> &bases, const int n_bases, const int problem_dim)
+	{
+		const int n_elements = bases.size();
+		if (part.size() != n_elements)
+			log_and_throw_error("Schwarz partition has {} elements, the bases have {}", part.size(), n_elements);
+		if (n_parts <= 0 || (n_elements > 0 && (part.minCoeff() < 0 || part.maxCoeff() >= n_parts)))
+			log_and_throw_error("Invalid Schwarz partition in {} parts", n_parts);
+
+		// node to elements adjacency in CSR form
+		std::vector<int> offsets(n_bases + 1, 0), node_elements;
+		std::vector<int> nodes;
+		for (int e = 0; e < n_elements; ++e)
+		{
+			element_nodes(bases[e], nodes);
+			for (const int v : nodes)
+				++offsets[v + 1];
+		}
+		for (int v = 0; v < n_bases; ++v)
+			offsets[v + 1] += offsets[v];
+		node_elements.resize(offsets.back());
+		{
+			std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+			for (int e = 0; e < n_elements; ++e)
+			{
+				element_nodes(bases[e], nodes);
+				for (const int v : nodes)
+					node_elements[fill[v]++] = e;
+			}
+		}
+
+		// every part grows by overlap_ layers of elements sharing a node, independently of the others
+		subdomains_.clear();
+		subdomains_.resize(n_parts);
+		utils::maybe_parallel_for(n_parts, [&](const int p) {
+			std::vector<bool> in_subdomain(n_elements, false), has_node(n_bases, false);
+			std::vector<int> elements, sub_nodes, el_nodes;
+			for (int e = 0; e < n_elements; ++e)
+			{
+				if (part[e] == p)
+				{
+					in_subdomain[e] = true;
+					elements.push_back(e);
+				}
+			}
+
+			const auto add_nodes = [&](const int begin) {
+				for (size_t i = begin; i < elements.size(); ++i)
+				{
+					element_nodes(bases[elements[i]], el_nodes);
+					for (const int v : el_nodes)
+					{
+						if (!has_node[v])
+						{
+							has_node[v] = true;
+							sub_nodes.push_back(v);
+						}
+					}
+				}
+			};
+			add_nodes(0);
+
+			size_t layer_begin = 0;
+			for (int layer = 0; layer < overlap_; ++layer)
+			{
+				const size_t n_layer_nodes = sub_nodes.size();
+				const size_t n_layer_elements = elements.size();
+				for (size_t i = layer_begin; i < n_layer_nodes; ++i)
+				{
+					const int v = sub_nodes[i];
+					for (int k = offsets[v]; k < offsets[v + 1]; ++k)
+					{
+						if (!in_subdomain[node_elements[k]])
+						{
+							in_subdomain[node_elements[k]] = true;
+							elements.push_back(node_elements[k]);
+						}
+					}
+				}
+				layer_begin = n_layer_nodes;
+				add_nodes(n_layer_elements);
+			}
+
+			std::vector<int> &dofs = subdomains_[p].dofs;
+			dofs.reserve(sub_nodes.size() * problem_dim);
+			for (const int v : sub_nodes)
+			{
+				for (int d = 0; d < problem_dim; ++d)
+					dofs.push_back(v * problem_dim + d);
+			}
+			std::sort(dofs.begin(), dofs.end());
+		});
+
+		// a node belongs to the lowest part among its elements, its dofs get the coarse modes of that part
+		std::vector<int> owner(n_bases, n_parts);
+		std::vector<RowVectorNd> positions(n_bases);
+		for (int e = 0; e < n_elements; ++e)
+		{
+			for (const auto &b : bases[e].bases)
+			{
+				for (const auto &g : b.global())
+				{
+					owner[g.index] = std::min(owner[g.index], int(part[e]));
+					positions[g.index] = g.node;
+				}
+			}
+		}
+
+		const int dim = n_bases > 0 ? positions[0].size() : 0;
+		const bool rigid = problem_dim == dim && dim > 1;
+		// translations and rotations, or one constant per component
+		const int n_modes = rigid ? (dim == 2 ? 3 : 6) : problem_dim;
+
+		std::vector<RowVectorNd> centers(n_parts, RowVectorNd::Zero(dim));
+		std::vector<double> radii(n_parts, 0);
+		std::vector<int> n_owned(n_parts, 0);
+		for (int v = 0; v < n_bases; ++v)
+		{
+			if (owner[v] == n_parts)
+				continue;
+			centers[owner[v]] += positions[v];
+			++n_owned[owner[v]];
+		}
+		for (int p = 0; p < n_parts; ++p)
+		{
+			if (n_owned[p] > 0)
+				centers[p] /= n_owned[p];
+		}
+		for (int v = 0; v < n_bases; ++v)
+		{
+			if (owner[v] < n_parts)
+				radii[owner[v]] = std::max(radii[owner[v]], (positions[v] - centers[owner[v]]).norm());
+		}
+
+		std::vector<Eigen::Triplet<double>> triplets;
+		for (int v = 0; v < n_bases; ++v)
+		{
+			const int p = owner[v];
+			if (p == n_parts)
+				continue;
+
+			const int col = p * n_modes;
+			if (!rigid)
+			{
+				for (int d = 0; d < problem_dim; ++d)
+					triplets.emplace_back(v * problem_dim + d, col + d, 1);
+				continue;
+			}
+
+			for (int d = 0; d < dim; ++d)
+				triplets.emplace_back(v * dim + d, col + d, 1);
+
+			// rotations around the center of the part, scaled to unit displacements
+			const RowVectorNd x = (positions[v] - centers[p]) / (radii[p] > 0 ? radii[p] : 1);
+			if (dim == 2)
+			{
+				triplets.emplace_back(v * 2 + 0, col + 2, -x(1));
+				triplets.emplace_back(v * 2 + 1, col + 2, x(0));
+			}
+			else
+			{
+				triplets.emplace_back(v * 3 + 1, col + 3, -x(2));
+				triplets.emplace_back(v * 3 + 2, col + 3, x(1));
+				triplets.emplace_back(v * 3 + 0, col + 4, x(2));
+				triplets.emplace_back(v * 3 + 2, col + 4, -x(0));
+				triplets.emplace_back(v * 3 + 0, col + 5, -x(1));
+				triplets.emplace_back(v * 3 + 1, col + 5, x(0));
+			}
+		}
+
+		coarse_space_.resize(n_bases * problem_dim, n_parts * n_modes);
+		coarse_space_.setFromTriplets(triplets.begin(), triplets.end());
+		coarse_space_.makeCompressed();
+	}
+
+	void SchwarzSolver::factorize(const StiffnessMatrix &A, const std::vector<int> &boundary_nodes)
+	{
+		if (subdomains_.empty() || coarse_space_.rows() != A.rows())
+			log_and_throw_error("Schwarz subdomains have {} dofs, the matrix is {}x{}", coarse_space_.rows(), A.rows(), A.cols());
+
+		A_ = A;
+		is_dirichlet_.assign(A.rows(), false);
+		for (const int i : boundary_nodes)
+			is_dirichlet_[i] = true;
+
+		StiffnessMatrix A_free = A;
+		A_free.prune([&](const int row, const int col, const double) { return !is_dirichlet_[row] && !is_dirichlet_[col]; });
+
+		std::atomic<int> n_failed(0);
+		utils::maybe_parallel_for(subdomains_.size(), [&](const int p) {
+			Subdomain &sub = subdomains_[p];
+			sub.free_dofs.clear();
+			for (const int i : sub.dofs)
+			{
+				if (!is_dirichlet_[i])
+					sub.free_dofs.push_back(i);
+			}
+
+			// R_i A R_i^T from the columns of the free dofs
+			std::vector<Eigen::Triplet<double>> triplets;
+			for (size_t j = 0; j < sub.free_dofs.size(); ++j)
+			{
+				for (StiffnessMatrix::InnerIterator it(A_free, sub.free_dofs[j]); it; ++it)
+				{
+					const auto row = std::lower_bound(sub.free_dofs.begin(), sub.free_dofs.end(), it.row());
+					if (row != sub.free_dofs.end() && *row == it.row())
+						triplets.emplace_back(row - sub.free_dofs.begin(), j, it.value());
+				}
+			}
+
+			const int n_local = sub.free_dofs.size();
+			StiffnessMatrix local(n_local, n_local);
+			local.setFromTriplets(triplets.begin(), triplets.end());
+			sub.solver = std::make_unique<Eigen::SimplicialLDLT<StiffnessMatrix>>(local);
+			if (sub.solver->info() != Eigen::Success)
+				++n_failed;
+		});
+		if (n_failed > 0)
+			log_and_throw_error("Schwarz solver: unable to factorize {} subdomain matrices", int(n_failed));
+
+		if (!use_coarse_space_)
+			return;
+
+		Z_ = coarse_space_;
+		Z_.prune([&](const int row, const int, const double) { return !is_dirichlet_[row]; });
+
+		// the modes of a fixed part vanish, their rows are replaced by the identity
+		Eigen::MatrixXd A_0 = StiffnessMatrix(Z_.transpose() * A_free * Z_).toDense();
+		for (int i = 0; i < A_0.rows(); ++i)
+		{
+			if (A_0(i, i) <= 1e-14 * A_0.diagonal().cwiseAbs().maxCoeff())
+			{
+				A_0.row(i).setZero();
+				A_0.col(i).setZero();
+				A_0(i, i) = 1;
+			}
+		}
+		coarse_solver_.compute(A_0);
+		if (coarse_solver_.info() != Eigen::Success)
+			log_and_throw_error("Schwarz solver: unable to factorize the coarse matrix");
+	}
+
+	void SchwarzSolver::apply_operator(const Eigen::VectorXd &x, Eigen::VectorXd &y) const
+	{
+		Eigen::VectorXd x_free = x;
+		for (int i = 0; i < x.size(); ++i)
+		{
+			if (is_dirichlet_[i])
+				x_free[i] = 0;
+		}
+
+		y = A_ * x_free;
+
+		for (int i = 0; i < x.size(); ++i)
+		{
+			if (is_dirichlet_[i])
+				y[i] = x[i];
+		}
+	}
+
+	void SchwarzSolver::apply_local(const Eigen::VectorXd &r, Eigen::VectorXd &z) const
+	{
+		std::vector<Eigen::VectorXd> local(subdomains_.size());
+		utils::maybe_parallel_for(subdomains_.size(), [&](const int p) {
+			const Subdomain &sub = subdomains_[p];
+			Eigen::VectorXd r_local(sub.free_dofs.size());
+			for (size_t j = 0; j < sub.free_dofs.size(); ++j)
+				r_local[j] = r[sub.free_dofs[j]];
+			local[p] = sub.solver->solve(r_local);
+		});
+
+		z.setZero(r.size());
+		for (size_t p = 0; p < subdomains_.size(); ++p)
+		{
+			const Subdomain &sub = subdomains_[p];
+			for (size_t j = 0; j < sub.free_dofs.size(); ++j)
+				z[sub.free_dofs[j]] += local[p][j];
+		}
+	}
+
+	void SchwarzSolver::apply_preconditioner(const Eigen::VectorXd &r, Eigen::VectorXd &z) const
+	{
+		if (!use_coarse_space_)
+		{
+			apply_local(r, z);
+			return;
+		}
+
+		// balancing, the coarse space is solved exactly and the subdomains correct the rest:
+		//     M^-1 = Q + (I - Q A) M_1^-1 (I - A Q), Q = Z A_0^-1 Z^T
+		const auto coarse_solve = [this](const Eigen::VectorXd &v) -> Eigen::VectorXd {
+			return Z_ * coarse_solver_.solve(Z_.transpose() * v);
+		};
+
+		const Eigen::VectorXd y_0 = coarse_solve(r);
+		Eigen::VectorXd Ay, z_1, Az;
+		apply_operator(y_0, Ay);
+		apply_local(r - Ay, z_1);
+		apply_operator(z_1, Az);
+		z = y_0 + z_1 - coarse_solve(Az);
+	}
+
+	void SchwarzSolver::solve(const Eigen::VectorXd &b, Eigen::VectorXd &x)
+	{
+		const int n = is_dirichlet_.size();
+		assert(b.size() == n);
+		if (x.size() != n)
+			x.setZero(n);
+
+		for (int i = 0; i < n; ++i)
+		{
+			if (is_dirichlet_[i])
+				x[i] = b[i];
+		}
+
+		const double b_norm = b.norm();
+		const double target = tolerance_ * (b_norm > 0 ? b_norm : 1);
+
+		// the Dirichlet values are lifted, the correction solves the symmetric system with the identity rows and columns
+		Eigen::VectorXd r = b - A_ * x;
+		for (int i = 0; i < n; ++i)
+		{
+			if (is_dirichlet_[i])
+				r[i] = 0;
+		}
+
+		Eigen::VectorXd z, p, q;
+		double res = r.norm();
+		int it = 0;
+		if (res > target)
+		{
+			apply_preconditioner(r, z);
+			p = z;
+			double rz = r.dot(z);
+
+			while (it < max_iter_)
+			{
+				apply_operator(p, q);
+				const double pq = p.dot(q);
+				if (pq <= 0)
+				{
+					logger().warn("Schwarz conjugate gradient breakdown, the matrix is not positive definite");
+					break;
+				}
+
+				const double alpha = rz / pq;
+				x += alpha * p;
+				r -= alpha * q;
+				++it;
+
+				res = r.norm();
+				if (res <= target)
+					break;
+
+				apply_preconditioner(r, z);
+				const double rz_new = r.dot(z);
+				p = z + (rz_new / rz) * p;
+				rz = rz_new;
+			}
+		}
+
+		info_ = json::object();
+		info_["solver"] = "PCG";
+		info_["preconditioner"] = use_coarse_space_ ? "two-level additive Schwarz" : "additive Schwarz";
+		info_["subdomains"] = subdomains_.size();
+		info_["overlap"] = overlap_;
+		info_["n_coarse"] = use_coarse_space_ ? Z_.cols() : 0;
+		info_["iterations"] = it;
+		info_["error"] = res / (b_norm > 0 ? b_norm : 1);
+
+		if (res > target)
+			logger().warn("Schwarz solver did not converge in {} iterations, relative residual {}", it, res / (b_norm > 0 ? b_norm : 1));
+		else
+			logger().debug("Schwarz solver converged in {} iterations, relative residual {}", it, res / (b_norm > 0 ? b_norm : 1));
+	}
+} // namespace polyfem::solver
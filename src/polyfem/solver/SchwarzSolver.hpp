@@ -0,0 +1,95 @@
+#pragma once
+
+#include <polyfem/Common.hpp>
+#include <polyfem/basis/ElementBases.hpp>
+#include <polyfem/utils/Types.hpp>
+
+#include <Eigen/Dense>
+#include <Eigen/SparseCholesky>
+
+#include <memory>
+#include <vector>
+
+namespace polyfem::solver
+{
+	/// @brief Conjugate gradient preconditioned by a two-level overlapping additive Schwarz method
+	///     M^-1 = Z A_0^-1 Z^T + sum_i R_i^T A_i^-1 R_i
+	/// The subdomains are the parts of an element partition (see mesh::partition::bisection) extended by layers of
+	/// elements sharing a node, every subdomain matrix A_i = R_i A R_i^T is factorized in its own task.
+	/// The coarse space Z holds the rigid body modes (constants for scalar problems) of every part, restricted to the
+	/// nodes it owns, and A_0 = Z^T A Z. The balanced combination keeps M symmetric, it costs two more products with A.
+	class SchwarzSolver
+	{
+	public:
+		/// @param[in] linear_params settings of the linear solver (/solver/linear), the Schwarz settings are in "schwarz"
+		SchwarzSolver(const json &linear_params);
+
+		/// @brief Builds the overlapping subdomains and the coarse space
+		/// @param[in] part part of every element, in [0, n_parts)
+		/// @param[in] n_parts number of parts
+		/// @param[in] bases bases of the elements
+		/// @param[in] n_bases number of bases
+		/// @param[in] problem_dim number of dofs per basis, vector problems of the mesh dimension use the rigid body modes
+		void set_subdomains(const Eigen::VectorXi &part, const int n_parts, const std::vector<basis::ElementBases> &bases, const int n_bases, const int problem_dim);
+
+		/// @brief Factorizes the subdomain and coarse matrices, the Dirichlet rows are replaced by rows of the identity as in dirichlet_solve
+		/// @param[in] A assembled system matrix
+		/// @param[in] boundary_nodes Dirichlet dofs
+		void factorize(const StiffnessMatrix &A, const std::vector<int> &boundary_nodes);
+
+		/// @brief Solves the factorized system, x is the initial guess if it has the right size
+		/// @param[in] b right-hand side, its Dirichlet entries are the values of the Dirichlet dofs
+		/// @param[in, out] x solution
+		void solve(const Eigen::VectorXd &b, Eigen::VectorXd &x);
+
+		/// @brief factorize and solve
+		void solve(const StiffnessMatrix &A, const Eigen::VectorXd &b, const std::vector<int> &boundary_nodes, Eigen::VectorXd &x)
+		{
+			factorize(A, boundary_nodes);
+			solve(b, x);
+		}
+
+		/// @brief Iterations and residual of the last solve
+		void get_info(json &params) const { params = info_; }
+
+		/// @brief Number of subdomains of the Schwarz settings, the number of threads if it is 0
+		static int n_subdomains(const json &linear_params);
+
+		/// @brief Schwarz settings are enabled in the linear solver settings
+		static bool is_enabled(const json &linear_params);
+
+	private:
+		struct Subdomain
+		{
+			/// sorted dofs of the subdomain, the Dirichlet dofs are removed at factorization
+			std::vector<int> dofs;
+			std::vector<int> free_dofs;
+			std::unique_ptr<Eigen::SimplicialLDLT<StiffnessMatrix>> solver;
+		};
+
+		/// z = sum_i R_i^T A_i^-1 R_i r
+		void apply_local(const Eigen::VectorXd &r, Eigen::VectorXd &z) const;
+
+		/// z = M^-1 r on the free dofs
+		void apply_preconditioner(const Eigen::VectorXd &r, Eigen::VectorXd &z) const;
+
+		/// y = A x with the Dirichlet rows and columns replaced by the identity
+		void apply_operator(const Eigen::VectorXd &x, Eigen::VectorXd &y) const;
+
+		int overlap_;
+		bool use_coarse_space_;
+		double tolerance_;
+		int max_iter_;
+
+		std::vector<Subdomain> subdomains_;
+		/// coarse space with all dofs, the Dirichlet rows are removed at factorization
+		StiffnessMatrix coarse_space_;
+		StiffnessMatrix Z_;
+		Eigen::LDLT<Eigen::MatrixXd> coarse_solver_;
+
+		StiffnessMatrix A_;
+		std::vector<bool> is_dirichlet_;
+
+		json info_;
+	};
+} // namespace polyfem::solver
@@ -6,6 +6,7 @@
 #include <polyfem/solver/forms/BodyForm.hpp>
 #include <polyfem/solver/forms/ContactForm.hpp>
 #include <polyfem/solver/forms/ElasticForm.hpp>
+#include <polyfem/solver/forms/ElementSweep.hpp>
 #include <polyfem/solver/forms/FrictionForm.hpp>
 #include <polyfem/solver/forms/InertiaForm.hpp>
 #include <polyfem/solver/forms/LaggedRegForm.hpp>
@@ -129,6 +130,12 @@ namespace polyfem::solver
 			}
 		}
 
+		// the damping shares the element loop of the elasticity
+		element_sweep = std::make_shared<ElementSweep>();
+		element_sweep->add(elastic_form);
+		if (damping_form)
+			element_sweep->add(damping_form);
+
 		if (rhs_assembler != nullptr)
 		{
 			al_form = std::make_shared<ALForm>(
@@ -239,11 +246,17 @@ namespace polyfem::solver
 		if (time_integrator) // if is time dependent
 		{
 			assert(elastic_form != nullptr);
+			elastic_form->set_dt(time_integrator->dt());
 			elastic_form->set_weight(time_integrator->acceleration_scaling());
 			if (body_form)
 				body_form->set_weight(time_integrator->acceleration_scaling());
 			if (damping_form)
+			{
+				damping_form->set_dt(time_integrator->dt());
 				damping_form->set_weight(time_integrator->acceleration_scaling());
+			}
+			if (friction_form)
+				friction_form->set_dt(time_integrator->dt());
 
 			// TODO: Determine if friction should be scaled by h²
 			// if (friction_form)
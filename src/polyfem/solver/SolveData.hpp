@@ -17,6 +17,12 @@
 #include <string>
 #include <unordered_map>
 
+namespace cppoptlib
+{
+	template <typename ProblemType>
+	class NonlinearSolver;
+} // namespace cppoptlib
+
 namespace polyfem::time_integrator
 {
 	class ImplicitTimeIntegrator;
@@ -37,6 +43,7 @@ namespace polyfem::solver
 	class ALForm;
 	class InertiaForm;
 	class ElasticForm;
+	class ElementSweep;
 
 	/// class to store time stepping data
 	class SolveData
@@ -114,12 +121,18 @@ namespace polyfem::solver
 	public:
 		std::shared_ptr<assembler::RhsAssembler> rhs_assembler;
 		std::shared_ptr<solver::NLProblem> nl_problem;
+		/// kept across time steps so that the linear solver can reuse its symbolic analysis
+		std::shared_ptr<cppoptlib::NonlinearSolver<solver::NLProblem>> nl_solver;
 
 		std::shared_ptr<solver::ALForm> al_form;
+		/// AL weight that imposed the DBC in the last time step, negative if none
+		double al_warm_start_weight = -1;
 		std::shared_ptr<solver::BodyForm> body_form;
 		std::shared_ptr<solver::ContactForm> contact_form;
 		std::shared_ptr<solver::ElasticForm> damping_form;
 		std::shared_ptr<solver::ElasticForm> elastic_form;
+		/// elastic and damping forms evaluated in a single element loop
+		std::shared_ptr<solver::ElementSweep> element_sweep;
 		std::shared_ptr<solver::FrictionForm> friction_form;
 		std::shared_ptr<solver::InertiaForm> inertia_form;
 
@@ -2,12 +2,16 @@
 
 #include <polyfem/Common.hpp>
 #include "NonlinearSolver.hpp"
+#include "MixedPrecisionSolver.hpp"
+#include "MultigridSolver.hpp"
 #include <polysolve/LinearSolver.hpp>
 #include <polyfem/utils/MatrixUtils.hpp>
 
 #include <polyfem/utils/Logger.hpp>
 #include <polyfem/utils/Timer.hpp>
 
+#include <algorithm>
+
 namespace cppoptlib
 {
 	template <typename ProblemType>
@@ -22,15 +26,49 @@ namespace cppoptlib
 
 		std::string name() const override { return "Newton"; }
 
+		/// Solve the Newton systems with conjugate gradient preconditioned by multigrid instead of the linear solver
+		/// @param multigrid multigrid solver with the prolongations of the full dofs
+		/// @param boundary_nodes sorted full dofs eliminated from the reduced Hessians
+		/// @param full_size number of full dofs
+		void set_multigrid(std::shared_ptr<polyfem::solver::MultigridSolver> multigrid, const std::vector<int> &boundary_nodes, const int full_size);
+
+		/// Keep the factorization of the last solve for the next minimize of a close problem (e.g., the next lagged
+		/// friction solve), it is used as a lagged Hessian until it stops giving descent directions.
+		/// Only with Hessian lagging, without it every iteration factorizes anyway.
+		void warm_start_next_solve() { warm_start_factorization = true; }
+
 	protected:
+		/// Computes the Hessian with the gradient in a single pass if the direction assembles it at x
+		void compute_gradient(ProblemType &objFunc, const TVector &x, TVector &grad) override;
 		bool compute_update_direction(ProblemType &objFunc, const TVector &x, const TVector &grad, TVector &direction) override;
 
+		/// Whether compute_update_direction at x assembles a new Hessian for the current descent strategy
+		virtual bool assembles_hessian_at(const TVector &x) const;
+
+		/// Project the Hessians of the forms to PSD for the current descent strategy
+		void set_project_to_psd(ProblemType &objFunc) const;
 		void assemble_hessian(ProblemType &objFunc, const TVector &x, polyfem::StiffnessMatrix &hessian);
 		bool solve_linear_system(const polyfem::StiffnessMatrix &hessian, const TVector &grad, TVector &direction);
 		bool check_direction(const polyfem::StiffnessMatrix &hessian, const TVector &grad, const TVector &direction);
 
+		/// Solve the Newton system with the multigrid solver, reduced Hessians are extended to the full dofs with identity Dirichlet rows
+		bool solve_multigrid(const polyfem::StiffnessMatrix &hessian, const TVector &grad, TVector &direction);
+
+		/// Solve the Newton system with preconditioned conjugate gradient using Hessian-vector products only
+		bool solve_matrix_free(ProblemType &objFunc, const TVector &x, const TVector &grad, TVector &direction);
+
 		static bool has_hessian_nans(const polyfem::StiffnessMatrix &hessian);
 
+		/// Whether the linear solver is iterative, i.e., it has a tolerance and no factorization
+		static bool is_iterative_linear_solver(const std::string &linear_solver_name);
+
+		/// Update the relative tolerance of the iterative linear solver from the gradient norm reduction (Eisenstat-Walker)
+		void update_forcing_term(const double grad_norm);
+
+		/// Whether the current factorization can be reused for this iteration (modified Newton)
+		bool can_reuse_factorization() const;
+		void invalidate_factorization();
+
 		// ====================================================================
 		//                        Solver parameters
 		// ====================================================================
@@ -40,6 +78,8 @@ namespace cppoptlib
 		static constexpr double reg_weight_inc = 10;
 		static constexpr double reg_weight_dec = 2;
 
+		static constexpr double inexact_residual_slack = 10; // backends may measure a preconditioned residual
+
 		// ====================================================================
 		//                           Solver state
 		// ====================================================================
@@ -49,6 +89,8 @@ namespace cppoptlib
 		virtual int default_descent_strategy() override { return force_psd_projection ? 1 : 0; }
 		void increase_descent_strategy() override;
 
+		void post_line_search(const double rate, const double energy) override;
+
 		using Superclass::descent_strategy_name;
 		std::string descent_strategy_name(int descent_strategy) const override;
 
@@ -60,6 +102,44 @@ namespace cppoptlib
 		std::unique_ptr<polysolve::LinearSolver> linear_solver; ///< Linear solver used to solve the linear system
 		bool force_psd_projection = false;                      ///< Whether to force the Hessian to be positive semi-definite
 		double reg_weight = 0;                                  ///< Regularization Coefficients
+		polyfem::StiffnessMatrix last_hessian;                  ///< Last assembled Hessian, the one of the reusable factorization
+		bool has_prefetched_hessian = false;                    ///< Whether last_hessian was computed with the gradient at the iterate
+
+		size_t pattern_hash = 0;            ///< Sparsity pattern of the last analyzed Hessian
+		Eigen::Index pattern_nnz = -1;      ///< Non-zeros of the last analyzed Hessian, -1 if none
+		int n_pattern_analyses = 0;         ///< Number of symbolic analyses since the last reset
+
+		int lagging_max_iterations = 0;     ///< Maximum number of iterations reusing a factorization, 0 disables lagging
+		double lagging_min_step;            ///< Refactorize when the line search step is smaller than this
+		double lagging_stall_ratio;         ///< Refactorize when the energy decrease ratio between iterations exceeds this
+		bool has_factorization = false;     ///< Whether the linear solver holds a reusable factorization
+		int lagged_descent_strategy = -1;   ///< Descent strategy the reusable factorization was computed with
+		int lagged_iterations = 0;          ///< Iterations since the last factorization
+		bool last_direction_lagged = false; ///< Whether the last direction came from a reused factorization
+		double lagged_prev_energy;          ///< Energy at the previous iteration, nan right after a factorization
+		double lagged_prev_decrease;        ///< Energy decrease of the previous iteration, nan if unknown
+		int n_saved_factorizations = 0;     ///< Number of factorizations skipped since the last reset
+		bool warm_start_factorization = false; ///< Whether the next reset keeps the factorization
+
+		bool inexact = false;                   ///< Whether to adapt the linear tolerance (inexact Newton)
+		bool inexact_warm_start = true;         ///< Whether to start the iterative solve from the previous direction
+		double forcing_min;                     ///< Smallest relative linear tolerance, the configured one
+		double forcing_max;                     ///< Largest relative linear tolerance
+		double forcing_gamma;                   ///< Eisenstat-Walker scaling
+		double forcing_alpha;                   ///< Eisenstat-Walker exponent
+		double forcing_term;                    ///< Current relative linear tolerance
+		double forcing_grad_norm;               ///< Gradient norm the forcing term was computed for, nan if none
+		json linear_solver_params;              ///< Linear solver parameters, updated with the forcing term
+		json::json_pointer linear_tolerance;    ///< Location of the tolerance in the linear solver parameters
+
+		bool matrix_free = false;          ///< Whether to solve the Newton system without assembling the Hessian
+		int matrix_free_max_iterations;    ///< Maximum number of conjugate gradient iterations
+		double matrix_free_tolerance;      ///< Relative residual tolerance of conjugate gradient
+		bool matrix_free_jacobi = true;    ///< Whether to precondition conjugate gradient with the Hessian diagonal
+
+		std::shared_ptr<polyfem::solver::MultigridSolver> multigrid; ///< Multigrid solver replacing the linear solver, if any
+		std::vector<int> multigrid_boundary_nodes;                    ///< Full dofs missing from the reduced Hessians
+		Eigen::VectorXi multigrid_free_dofs;                          ///< Full dof of every reduced dof
 
 		// ====================================================================
 		//                            Solver info
@@ -9,10 +9,87 @@ namespace cppoptlib
 		const json &solver_params, const json &linear_solver_params, const double dt)
 		: Superclass(solver_params, dt)
 	{
-		linear_solver = polysolve::LinearSolver::create(
-			linear_solver_params["solver"], linear_solver_params["precond"]);
+		linear_solver = polyfem::solver::MixedPrecisionSolver::create(linear_solver_params);
 		linear_solver->setParameters(linear_solver_params);
 		force_psd_projection = solver_params["force_psd_projection"];
+
+		const json &matrix_free_params = solver_params["matrix_free"];
+		matrix_free = matrix_free_params["enabled"];
+		matrix_free_max_iterations = matrix_free_params["max_iterations"];
+		matrix_free_tolerance = matrix_free_params["tolerance"];
+		matrix_free_jacobi = matrix_free_params["preconditioner"] == "jacobi";
+
+		const json &inexact_params = solver_params["inexact"];
+		inexact = inexact_params["enabled"];
+		if (inexact)
+		{
+			const std::string linear_solver_name = linear_solver_params["solver"];
+			if (linear_solver_name == "AMGCL")
+				linear_tolerance = json::json_pointer("/AMGCL/solver/tol");
+			else if (is_iterative_linear_solver(linear_solver_name))
+				linear_tolerance = json::json_pointer("/" + linear_solver_name + "/tolerance");
+
+			if (linear_tolerance.empty() || !linear_solver_params.contains(linear_tolerance))
+			{
+				polyfem::logger().warn("Inexact Newton needs an iterative linear solver, {} is not; using exact solves", linear_solver_name);
+				inexact = false;
+			}
+			else
+			{
+				this->linear_solver_params = linear_solver_params;
+				forcing_min = linear_solver_params[linear_tolerance];
+				forcing_max = std::max(double(inexact_params["max_forcing"]), forcing_min);
+				forcing_gamma = inexact_params["gamma"];
+				forcing_alpha = inexact_params["alpha"];
+				inexact_warm_start = inexact_params["warm_start"];
+			}
+		}
+
+		const json &lagging_params = solver_params["hessian_lagging"];
+		lagging_max_iterations = lagging_params["max_iterations"];
+		lagging_min_step = lagging_params["min_step"];
+		lagging_stall_ratio = lagging_params["stall_ratio"];
+	}
+
+	// =======================================================================
+
+	template <typename ProblemType>
+	void SparseNewtonDescentSolver<ProblemType>::set_multigrid(
+		std::shared_ptr<polyfem::solver::MultigridSolver> multigrid, const std::vector<int> &boundary_nodes, const int full_size)
+	{
+		assert(std::is_sorted(boundary_nodes.begin(), boundary_nodes.end()));
+		this->multigrid = multigrid;
+		multigrid_boundary_nodes = boundary_nodes;
+
+		multigrid_free_dofs.resize(full_size - boundary_nodes.size());
+		int j = 0;
+		size_t k = 0;
+		for (int i = 0; i < full_size; ++i)
+		{
+			if (k < boundary_nodes.size() && boundary_nodes[k] == i)
+				++k;
+			else
+				multigrid_free_dofs(j++) = i;
+		}
+		assert(j == multigrid_free_dofs.size());
+
+		// the multigrid hierarchy is rebuilt for every Hessian, there is no factorization to lag
+		if (multigrid != nullptr && lagging_max_iterations > 0)
+		{
+			polyfem::logger().debug("[{}] Hessian lagging is disabled with multigrid", name());
+			lagging_max_iterations = 0;
+		}
+	}
+
+	// =======================================================================
+
+	template <typename ProblemType>
+	bool SparseNewtonDescentSolver<ProblemType>::is_iterative_linear_solver(const std::string &linear_solver_name)
+	{
+		return linear_solver_name == "AMGCL" || linear_solver_name == "Hypre" || linear_solver_name == "Trilinos"
+			   || linear_solver_name == "Eigen::ConjugateGradient" || linear_solver_name == "Eigen::BiCGSTAB"
+			   || linear_solver_name == "Eigen::GMRES" || linear_solver_name == "Eigen::DGMRES"
+			   || linear_solver_name == "Eigen::MINRES" || linear_solver_name == "Eigen::LeastSquaresConjugateGradient";
 	}
 
 	// =======================================================================
@@ -40,6 +117,14 @@ namespace cppoptlib
 	template <typename ProblemType>
 	void SparseNewtonDescentSolver<ProblemType>::increase_descent_strategy()
 	{
+		// a stale factorization failed, retry the same strategy with a fresh one first
+		if (last_direction_lagged)
+		{
+			last_direction_lagged = false;
+			invalidate_factorization();
+			return;
+		}
+
 		if (this->descent_strategy == 0 || reg_weight > reg_weight_max)
 			this->descent_strategy++;
 		else
@@ -49,6 +134,82 @@ namespace cppoptlib
 
 	// =======================================================================
 
+	template <typename ProblemType>
+	void SparseNewtonDescentSolver<ProblemType>::post_line_search(const double rate, const double energy)
+	{
+		if (!has_factorization)
+			return;
+
+		if (rate < lagging_min_step)
+		{
+			polyfem::logger().trace("[{}] small line search step {:g}; refactorizing the Hessian", name(), rate);
+			invalidate_factorization();
+			return;
+		}
+
+		// energy is the value before this step, so the decrease measured here is the one of the previous step
+		if (std::isfinite(lagged_prev_energy))
+		{
+			const double decrease = lagged_prev_energy - energy;
+			if (std::isfinite(lagged_prev_decrease) && decrease > lagging_stall_ratio * lagged_prev_decrease)
+			{
+				polyfem::logger().trace(
+					"[{}] energy decrease stalled ({:g} after {:g}); refactorizing the Hessian",
+					name(), decrease, lagged_prev_decrease);
+				invalidate_factorization();
+				return;
+			}
+			lagged_prev_decrease = decrease;
+		}
+		lagged_prev_energy = energy;
+	}
+
+	// =======================================================================
+
+	template <typename ProblemType>
+	void SparseNewtonDescentSolver<ProblemType>::update_forcing_term(const double grad_norm)
+	{
+		if (std::isnan(forcing_grad_norm))
+			forcing_term = forcing_max;
+		else if (grad_norm == forcing_grad_norm)
+			// same iterate, the previous direction was rejected: solve more accurately
+			forcing_term = std::max(forcing_term / 10, forcing_min);
+		else
+		{
+			// Eisenstat-Walker choice 2, with the safeguard against decreasing too fast
+			double eta = forcing_gamma * std::pow(grad_norm / forcing_grad_norm, forcing_alpha);
+			const double safeguard = forcing_gamma * std::pow(forcing_term, forcing_alpha);
+			if (safeguard > 0.1)
+				eta = std::max(eta, safeguard);
+			forcing_term = std::clamp(eta, forcing_min, forcing_max);
+		}
+		forcing_grad_norm = grad_norm;
+
+		linear_solver_params[linear_tolerance] = forcing_term;
+		linear_solver->setParameters(linear_solver_params);
+	}
+
+	// =======================================================================
+
+	template <typename ProblemType>
+	bool SparseNewtonDescentSolver<ProblemType>::can_reuse_factorization() const
+	{
+		return has_factorization
+			   && lagged_iterations < lagging_max_iterations
+			   && lagged_descent_strategy == this->descent_strategy;
+	}
+
+	template <typename ProblemType>
+	void SparseNewtonDescentSolver<ProblemType>::invalidate_factorization()
+	{
+		has_factorization = false;
+		lagged_iterations = 0;
+		lagged_prev_energy = std::nan("");
+		lagged_prev_decrease = std::nan("");
+	}
+
+	// =======================================================================
+
 	template <typename ProblemType>
 	void SparseNewtonDescentSolver<ProblemType>::reset(const int ndof)
 	{
@@ -56,10 +217,49 @@ namespace cppoptlib
 		assert(linear_solver != nullptr);
 		reg_weight = 0;
 		internal_solver_info = json::array();
+		// the analyzed pattern is kept on purpose, the next solve reuses it if the pattern did not change
+		n_pattern_analyses = 0;
+		// the factorization is not, the problem changed since, unless it was asked to be kept for a close problem
+		if (warm_start_factorization && has_factorization && last_hessian.rows() == ndof)
+		{
+			lagged_iterations = 0;
+			lagged_prev_energy = std::nan("");
+			lagged_prev_decrease = std::nan("");
+		}
+		else
+			invalidate_factorization();
+		warm_start_factorization = false;
+		last_direction_lagged = false;
+		has_prefetched_hessian = false;
+		n_saved_factorizations = 0;
+		forcing_term = forcing_max;
+		forcing_grad_norm = std::nan("");
 	}
 
 	// =======================================================================
 
+	template <typename ProblemType>
+	bool SparseNewtonDescentSolver<ProblemType>::assembles_hessian_at(const TVector &x) const
+	{
+		return this->descent_strategy != 2 && !matrix_free && !can_reuse_factorization();
+	}
+
+	template <typename ProblemType>
+	void SparseNewtonDescentSolver<ProblemType>::compute_gradient(ProblemType &objFunc, const TVector &x, TVector &grad)
+	{
+		has_prefetched_hessian = false;
+		if (!assembles_hessian_at(x))
+		{
+			Superclass::compute_gradient(objFunc, x, grad);
+			return;
+		}
+
+		// the element loops compute the gradient and the Hessian together, the Hessian is used by assemble_hessian
+		set_project_to_psd(objFunc);
+		objFunc.gradient_and_hessian(x, grad, last_hessian);
+		has_prefetched_hessian = true;
+	}
+
 	template <typename ProblemType>
 	bool SparseNewtonDescentSolver<ProblemType>::compute_update_direction(
 		ProblemType &objFunc,
@@ -67,28 +267,84 @@ namespace cppoptlib
 		const TVector &grad,
 		TVector &direction)
 	{
+		last_direction_lagged = false;
+
 		if (this->descent_strategy == 2)
 		{
 			direction = -grad;
 			return true;
 		}
 
-		polyfem::StiffnessMatrix hessian;
+		if (matrix_free)
+		{
+			if (!solve_matrix_free(objFunc, x, grad, direction))
+				// solve_matrix_free will increase descent_strategy if needed
+				return compute_update_direction(objFunc, x, grad, direction);
+
+			if (grad.dot(direction) >= 0)
+			{
+				increase_descent_strategy();
+				polyfem::logger().log(
+					log_level(), "[{}] direction is not a descent direction (Δx⋅g={}≥0); reverting to {}",
+					name(), direction.dot(grad), descent_strategy_name());
+				return compute_update_direction(objFunc, x, grad, direction);
+			}
+
+			reg_weight /= reg_weight_dec;
+			if (reg_weight < reg_weight_min)
+				reg_weight = 0;
+
+			return true;
+		}
+
+		if (can_reuse_factorization())
+		{
+			{
+				POLYFEM_SCOPED_TIMER("linear solve", this->inverting_time);
+				this->overlap_pending_work([&]() { linear_solver->solve(-grad, direction); });
+			}
+
+			if (std::isfinite(direction.squaredNorm()) && grad.dot(direction) < 0)
+			{
+				++lagged_iterations;
+				++n_saved_factorizations;
+				last_direction_lagged = true;
+				return true;
+			}
+
+			polyfem::logger().debug("[{}] lagged Hessian gives no descent direction; refactorizing", name());
+		}
+		invalidate_factorization();
+
+		// kept with the factorization, the next assembly reuses its storage
+		assemble_hessian(objFunc, x, last_hessian);
 
-		assemble_hessian(objFunc, x, hessian);
+		if (inexact)
+			update_forcing_term(grad.norm());
 
-		if (!solve_linear_system(hessian, grad, direction))
+		if (!solve_linear_system(last_hessian, grad, direction))
 			// solve_linear_system will increase descent_strategy if needed
 			return compute_update_direction(objFunc, x, grad, direction);
 
-		if (!check_direction(hessian, grad, direction))
+		if (!check_direction(last_hessian, grad, direction))
 			// check_direction will increase descent_strategy if needed
 			return compute_update_direction(objFunc, x, grad, direction);
 
 		json info;
-		linear_solver->getInfo(info);
+		if (multigrid)
+			multigrid->get_info(info);
+		else
+			linear_solver->getInfo(info);
+		if (inexact)
+			info["forcing_term"] = forcing_term;
 		internal_solver_info.push_back(info);
 
+		if (lagging_max_iterations > 0)
+		{
+			has_factorization = true;
+			lagged_descent_strategy = this->descent_strategy;
+		}
+
 		reg_weight /= reg_weight_dec;
 		if (reg_weight < reg_weight_min)
 			reg_weight = 0;
@@ -99,19 +355,33 @@ namespace cppoptlib
 	// =======================================================================
 
 	template <typename ProblemType>
-	void SparseNewtonDescentSolver<ProblemType>::assemble_hessian(
-		ProblemType &objFunc, const TVector &x, polyfem::StiffnessMatrix &hessian)
+	void SparseNewtonDescentSolver<ProblemType>::set_project_to_psd(ProblemType &objFunc) const
 	{
-		POLYFEM_SCOPED_TIMER("assembly time", this->assembly_time);
-
 		if (this->descent_strategy == 1)
 			objFunc.set_project_to_psd(true);
 		else if (this->descent_strategy == 0)
 			objFunc.set_project_to_psd(false);
 		else
 			assert(false);
+	}
+
+	template <typename ProblemType>
+	void SparseNewtonDescentSolver<ProblemType>::assemble_hessian(
+		ProblemType &objFunc, const TVector &x, polyfem::StiffnessMatrix &hessian)
+	{
+		POLYFEM_SCOPED_TIMER("assembly time", this->assembly_time);
 
-		objFunc.hessian(x, hessian);
+		// computed with the gradient at the same x, a retry with another descent strategy assembles it again
+		if (has_prefetched_hessian)
+		{
+			assert(&hessian == &last_hessian);
+			has_prefetched_hessian = false;
+		}
+		else
+		{
+			set_project_to_psd(objFunc);
+			objFunc.hessian(x, hessian);
+		}
 
 		if (reg_weight > 0)
 		{
@@ -124,30 +394,117 @@ namespace cppoptlib
 	template <typename ProblemType>
 	bool SparseNewtonDescentSolver<ProblemType>::solve_linear_system(
 		const polyfem::StiffnessMatrix &hessian, const TVector &grad, TVector &direction)
+	{
+		// the energy of the iteration is computed while the system is factorized and solved
+		bool solved = false;
+		if (multigrid)
+		{
+			this->overlap_pending_work([&]() { solved = solve_multigrid(hessian, grad, direction); });
+			return solved;
+		}
+
+		POLYFEM_SCOPED_TIMER("linear solve", this->inverting_time);
+
+		this->overlap_pending_work([&]() {
+			// the symbolic analysis only depends on the pattern, it is redone when the pattern changes (e.g., new contacts)
+			assert(hessian.isCompressed());
+			const size_t hash = polyfem::utils::sparse_pattern_hash(hessian);
+			if (hessian.nonZeros() != pattern_nnz || hash != pattern_hash)
+			{
+				// TODO: get the correct size
+				linear_solver->analyzePattern(hessian, hessian.rows());
+				pattern_nnz = hessian.nonZeros();
+				pattern_hash = hash;
+				++n_pattern_analyses;
+			}
+
+			try
+			{
+				linear_solver->factorize(hessian);
+			}
+			catch (const std::runtime_error &err)
+			{
+				increase_descent_strategy();
+
+				// warn if using gradient descent
+				polyfem::logger().log(
+					log_level(), "Unable to factorize Hessian: \"{}\"; reverting to {}",
+					err.what(), this->descent_strategy_name());
+
+				// polyfem::write_sparse_matrix_csv("problematic_hessian.csv", hessian);
+				return;
+			}
+
+			// iterative solvers start from the content of direction, i.e., the previous Newton direction
+			if (direction.size() != grad.size() || (inexact && !inexact_warm_start))
+				direction.setZero(grad.size());
+			linear_solver->solve(-grad, direction); // H Δx = -g
+			solved = true;
+		});
+
+		return solved;
+	}
+
+	// =======================================================================
+
+	template <typename ProblemType>
+	bool SparseNewtonDescentSolver<ProblemType>::solve_multigrid(
+		const polyfem::StiffnessMatrix &hessian, const TVector &grad, TVector &direction)
 	{
 		POLYFEM_SCOPED_TIMER("linear solve", this->inverting_time);
-		// TODO: get the correct size
-		linear_solver->analyzePattern(hessian, hessian.rows());
+
+		if (direction.size() != grad.size() || (inexact && !inexact_warm_start))
+			direction.setZero(grad.size());
+
+		// the augmented Lagrangian solves have full Hessians, they have no Dirichlet rows
+		const int full_size = multigrid_free_dofs.size() + multigrid_boundary_nodes.size();
+		const bool reduced = hessian.rows() != full_size;
+		if (reduced && hessian.rows() != multigrid_free_dofs.size())
+			polyfem::log_and_throw_error("[{}] Hessian of size {} matches neither the full nor the reduced multigrid dofs", name(), hessian.rows());
 
 		try
 		{
-			linear_solver->factorize(hessian);
+			if (!reduced)
+			{
+				multigrid->factorize(hessian, {});
+				multigrid->solve(-grad, direction);
+				return true;
+			}
+
+			std::vector<Eigen::Triplet<double>> triplets;
+			triplets.reserve(hessian.nonZeros() + multigrid_boundary_nodes.size());
+			for (int k = 0; k < hessian.outerSize(); ++k)
+			{
+				for (polyfem::StiffnessMatrix::InnerIterator it(hessian, k); it; ++it)
+					triplets.emplace_back(multigrid_free_dofs(it.row()), multigrid_free_dofs(it.col()), it.value());
+			}
+			for (const int b : multigrid_boundary_nodes)
+				triplets.emplace_back(b, b, 1);
+
+			polyfem::StiffnessMatrix full_hessian(full_size, full_size);
+			full_hessian.setFromTriplets(triplets.begin(), triplets.end());
+			multigrid->factorize(full_hessian, multigrid_boundary_nodes);
+
+			// the Dirichlet dofs of the direction are zero
+			Eigen::VectorXd b = Eigen::VectorXd::Zero(full_size), x = Eigen::VectorXd::Zero(full_size);
+			for (int i = 0; i < multigrid_free_dofs.size(); ++i)
+			{
+				b(multigrid_free_dofs(i)) = -grad(i);
+				x(multigrid_free_dofs(i)) = direction(i);
+			}
+			multigrid->solve(b, x);
+			for (int i = 0; i < multigrid_free_dofs.size(); ++i)
+				direction(i) = x(multigrid_free_dofs(i));
 		}
 		catch (const std::runtime_error &err)
 		{
 			increase_descent_strategy();
-
-			// warn if using gradient descent
 			polyfem::logger().log(
-				log_level(), "Unable to factorize Hessian: \"{}\"; reverting to {}",
+				log_level(), "Unable to solve the Newton system with multigrid: \"{}\"; reverting to {}",
 				err.what(), this->descent_strategy_name());
-
-			// polyfem::write_sparse_matrix_csv("problematic_hessian.csv", hessian);
 			return false;
 		}
 
-		linear_solver->solve(-grad, direction); // H Δx = -g
-
 		return true;
 	}
 
@@ -159,7 +516,8 @@ namespace cppoptlib
 	{
 		// gradient descent, check descent direction
 		const double residual = (hessian * direction + grad).norm(); // H Δx + g = 0
-		if (std::isnan(residual) || residual > std::max(1e-8 * grad.norm(), 1e-5))
+		const double relative_tol = inexact ? inexact_residual_slack * forcing_term : 1e-8;
+		if (std::isnan(residual) || residual > std::max(relative_tol * grad.norm(), 1e-5))
 		{
 			increase_descent_strategy();
 
@@ -190,11 +548,104 @@ namespace cppoptlib
 
 	// =======================================================================
 
+	template <typename ProblemType>
+	bool SparseNewtonDescentSolver<ProblemType>::solve_matrix_free(
+		ProblemType &objFunc, const TVector &x, const TVector &grad, TVector &direction)
+	{
+		TVector diag;
+		{
+			POLYFEM_SCOPED_TIMER("assembly time", this->assembly_time);
+
+			if (this->descent_strategy == 1)
+				objFunc.set_project_to_psd(true);
+			else if (this->descent_strategy == 0)
+				objFunc.set_project_to_psd(false);
+			else
+				assert(false);
+
+			objFunc.init_hessian_vector_product(x);
+			if (matrix_free_jacobi)
+			{
+				objFunc.hessian_diagonal(x, diag);
+				diag.array() += reg_weight;
+				// a non positive diagonal cannot precondition, fall back to the identity there
+				diag = (diag.array() > 0).select(diag, TVector::Ones(diag.size()));
+			}
+		}
+
+		POLYFEM_SCOPED_TIMER("linear solve", this->inverting_time);
+
+		// H Δx = -g with conjugate gradient, starting from Δx = 0
+		direction.setZero(grad.size());
+		TVector r = -grad;
+		TVector z = matrix_free_jacobi ? TVector(r.cwiseQuotient(diag)) : r;
+		TVector p = z;
+		TVector Hp;
+		double rz = r.dot(z);
+
+		const double tol = matrix_free_tolerance * grad.norm();
+		double residual = r.norm();
+		int iter = 0;
+		for (; iter < matrix_free_max_iterations && residual > tol; ++iter)
+		{
+			objFunc.hessian_vector_product(x, p, Hp);
+			if (reg_weight > 0)
+				Hp += reg_weight * p;
+
+			const double pHp = p.dot(Hp);
+			if (std::isnan(pHp) || pHp <= 0)
+			{
+				// negative curvature: keep the last iterate, unless there is none
+				if (iter > 0)
+					break;
+
+				increase_descent_strategy();
+				polyfem::logger().log(
+					log_level(), "[{}] negative curvature in conjugate gradient (pᵀHp={}); reverting to {}",
+					name(), pHp, this->descent_strategy_name());
+				return false;
+			}
+
+			const double alpha = rz / pHp;
+			direction += alpha * p;
+			r -= alpha * Hp;
+			residual = r.norm();
+
+			if (matrix_free_jacobi)
+				z = r.cwiseQuotient(diag);
+			else
+				z = r;
+
+			const double rz_new = r.dot(z);
+			p = z + (rz_new / rz) * p;
+			rz = rz_new;
+		}
+
+		if (std::isnan(residual))
+		{
+			increase_descent_strategy();
+			polyfem::logger().log(
+				log_level(), "[{}] nan conjugate gradient residual; reverting to {}",
+				name(), this->descent_strategy_name());
+			return false;
+		}
+
+		polyfem::logger().trace("conjugate gradient {} iterations, residual {}", iter, residual);
+
+		internal_solver_info.push_back(json({{"solver", "PCG"}, {"iterations", iter}, {"residual", residual}}));
+
+		return true;
+	}
+
+	// =======================================================================
+
 	template <typename ProblemType>
 	void SparseNewtonDescentSolver<ProblemType>::update_solver_info()
 	{
 		Superclass::update_solver_info();
 		this->solver_info["internal_solver"] = internal_solver_info;
+		this->solver_info["pattern_analyses"] = n_pattern_analyses;
+		this->solver_info["saved_factorizations"] = n_saved_factorizations;
 	}
 
 	// =======================================================================
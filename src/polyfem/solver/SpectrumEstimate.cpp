@@ -0,0 +1,99 @@
+#include "SpectrumEstimate.hpp"
+
+#include <polyfem/utils/Logger.hpp>
+#include <polyfem/utils/Timer.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace polyfem::solver
+{
+	Eigen::VectorXd lanczos_ritz_values(
+		const int n,
+		const std::function<void(const Eigen::VectorXd &, Eigen::VectorXd &)> &apply,
+		const std::vector<bool> &fixed,
+		const int n_steps)
+	{
+		assert(fixed.size() == n);
+		const int n_free = n - std::count(fixed.begin(), fixed.end(), true);
+		const int max_steps = std::min(n_steps, n_free);
+		if (max_steps <= 0)
+			return Eigen::VectorXd();
+
+		// the start is deterministic with components along the whole spectrum
+		Eigen::MatrixXd V(n, max_steps);
+		Eigen::VectorXd v(n), w;
+		for (int i = 0; i < n; ++i)
+			v[i] = fixed[i] ? 0 : (std::sin(12.9898 * i + 78.233 * (i % 7)) + 0.1);
+		V.col(0) = v / v.norm();
+
+		Eigen::VectorXd alpha(max_steps), beta = Eigen::VectorXd::Zero(max_steps);
+		int step = 0;
+		for (; step < max_steps; ++step)
+		{
+			apply(V.col(step), w);
+			for (int i = 0; i < n; ++i)
+			{
+				if (fixed[i])
+					w[i] = 0;
+			}
+
+			alpha[step] = V.col(step).dot(w);
+			// full reorthogonalization, the basis is small and it avoids the ghost copies of the converged values
+			w -= V.leftCols(step + 1) * (V.leftCols(step + 1).transpose() * w);
+			beta[step] = w.norm();
+
+			// invariant subspace, its eigenvalues are exact
+			if (step + 1 == max_steps || beta[step] <= 1e-12 * std::abs(alpha[step]))
+			{
+				++step;
+				break;
+			}
+			V.col(step + 1) = w / beta[step];
+		}
+
+		Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> tridiagonal;
+		tridiagonal.computeFromTridiagonal(alpha.head(step), beta.head(step - 1), Eigen::EigenvaluesOnly);
+		return tridiagonal.eigenvalues();
+	}
+
+	Eigen::Vector4d estimate_spectrum(
+		polysolve::LinearSolver &solver,
+		const StiffnessMatrix &A,
+		const std::vector<int> &dirichlet_nodes,
+		const int n_steps)
+	{
+		POLYFEM_SCOPED_TIMER("Spectrum estimate");
+
+		const int n = A.rows();
+		std::vector<bool> fixed(n, false);
+		for (const int i : dirichlet_nodes)
+			fixed[i] = true;
+
+		// with the Dirichlet rows replaced, A and A^-1 restricted to the free dofs are A_ff and A_ff^-1
+		const Eigen::VectorXd largest = lanczos_ritz_values(
+			n, [&](const Eigen::VectorXd &x, Eigen::VectorXd &y) { y = A * x; }, fixed, n_steps);
+		const Eigen::VectorXd inverse = lanczos_ritz_values(
+			n, [&](const Eigen::VectorXd &x, Eigen::VectorXd &y) { y.resize(n); solver.solve(x, y); }, fixed, n_steps);
+
+		Eigen::Vector4d spectrum;
+		spectrum.setZero();
+		if (largest.size() == 0 || inverse.size() == 0)
+			return spectrum;
+
+		// the extreme eigenvalues in magnitude, A can be indefinite
+		const auto by_magnitude = [](const Eigen::VectorXd &values) {
+			std::vector<double> sorted(values.data(), values.data() + values.size());
+			std::sort(sorted.begin(), sorted.end(), [](const double a, const double b) { return std::abs(a) < std::abs(b); });
+			return sorted;
+		};
+		const std::vector<double> l = by_magnitude(largest);
+		const std::vector<double> s = by_magnitude(inverse);
+		const int nl = l.size(), ns = s.size();
+		spectrum << 1 / s[ns - 1], 1 / s[std::max(ns - 2, 0)], l[std::max(nl - 2, 0)], l[nl - 1];
+
+		logger().debug("Spectrum estimate: [{}, {}, {}, {}], condition number {}", spectrum[0], spectrum[1], spectrum[2], spectrum[3], std::abs(spectrum[3] / spectrum[0]));
+		return spectrum;
+	}
+} // namespace polyfem::solver
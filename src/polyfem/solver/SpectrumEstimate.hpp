@@ -0,0 +1,41 @@
+#pragma once
+
+#include <polyfem/utils/Types.hpp>
+
+#include <polysolve/LinearSolver.hpp>
+
+#include <Eigen/Dense>
+
+#include <functional>
+#include <vector>
+
+namespace polyfem::solver
+{
+	/// @brief Ritz values of a few Lanczos steps (with full reorthogonalization) on a symmetric operator restricted
+	/// to the free dofs, the extreme ones converge to the extreme eigenvalues of the operator
+	/// @param[in] n size of the operator
+	/// @param[in] apply computes y = A x, the fixed entries of x are zero
+	/// @param[in] fixed true for the dofs excluded from the operator
+	/// @param[in] n_steps maximum number of steps (and of calls to apply)
+	/// @return the Ritz values in increasing order
+	Eigen::VectorXd lanczos_ritz_values(
+		const int n,
+		const std::function<void(const Eigen::VectorXd &, Eigen::VectorXd &)> &apply,
+		const std::vector<bool> &fixed,
+		const int n_steps);
+
+	/// @brief Cheap estimate of the extreme eigenvalues of a symmetric system after dirichlet_solve, instead of
+	/// the full eigen solve of its compute_spectrum. The largest ones are the Ritz values of Lanczos on A, the
+	/// smallest ones of Lanczos on A^-1 applied with the factorization the solver already holds, so the cost is
+	/// n_steps products and n_steps back substitutions, both restricted to the non Dirichlet dofs.
+	/// @param[in] solver solver factorized with A
+	/// @param[in] A system matrix, the Dirichlet rows can be replaced by rows of the identity
+	/// @param[in] dirichlet_nodes Dirichlet dofs
+	/// @param[in] n_steps number of Lanczos steps of each estimate
+	/// @return the two smallest and the two largest eigenvalue estimates in magnitude, in increasing order as the spectrum of dirichlet_solve
+	Eigen::Vector4d estimate_spectrum(
+		polysolve::LinearSolver &solver,
+		const StiffnessMatrix &A,
+		const std::vector<int> &dirichlet_nodes,
+		const int n_steps = 20);
+} // namespace polyfem::solver
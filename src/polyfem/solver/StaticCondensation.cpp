@@ -0,0 +1,238 @@
+#include "StaticCondensation.hpp"
+
+#include <polyfem/utils/Logger.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
+
+#include <algorithm>
+
+namespace polyfem::solver
+{
+	using namespace utils;
+
+	std::vector<std::vector<int>> StaticCondensation::interior_dofs(
+		const std::vector<basis::ElementBases> &bases,
+		const int n_bases,
+		const int problem_dim,
+		const std::vector<int> &excluded)
+	{
+		// element supporting every basis, -2 if there are several
+		std::vector<int> owner(n_bases, -1);
+		for (int e = 0; e < bases.size(); ++e)
+		{
+			for (const auto &b : bases[e].bases)
+			{
+				for (const auto &g : b.global())
+				{
+					int &o = owner[g.index];
+					if (o == -1)
+						o = e;
+					else if (o != e)
+						o = -2;
+				}
+			}
+		}
+
+		std::vector<bool> is_excluded(n_bases * problem_dim, false);
+		for (const int i : excluded)
+			is_excluded[i] = true;
+
+		std::vector<std::vector<int>> res(bases.size());
+		for (int i = 0; i < n_bases; ++i)
+		{
+			if (owner[i] < 0)
+				continue;
+			for (int d = 0; d < problem_dim; ++d)
+			{
+				const int dof = i * problem_dim + d;
+				if (!is_excluded[dof])
+					res[owner[i]].push_back(dof);
+			}
+		}
+
+		return res;
+	}
+
+	StaticCondensation::StaticCondensation(const StiffnessMatrix &A, const std::vector<std::vector<int>> &interior)
+	{
+		assert(A.rows() == A.cols());
+		const int n = A.rows();
+
+		// element of every interior dof, -1 for the skeleton
+		Eigen::VectorXi element = Eigen::VectorXi::Constant(n, -1);
+		for (int e = 0; e < interior.size(); ++e)
+		{
+			for (const int i : interior[e])
+			{
+				if (element[i] != -1)
+					log_and_throw_error("Static condensation: dof {} is interior to elements {} and {}", i, element[i], e);
+				element[i] = e;
+			}
+		}
+
+		skeleton_index_.resize(n);
+		int n_skeleton = 0;
+		for (int i = 0; i < n; ++i)
+			skeleton_index_[i] = element[i] < 0 ? n_skeleton++ : -1;
+
+		// rows of A are the columns of its transpose
+		const StiffnessMatrix At = A.transpose();
+
+		blocks_.resize(interior.size());
+		auto storage = create_thread_storage(std::vector<Eigen::Triplet<double>>());
+
+		maybe_parallel_for(interior.size(), [&](int start, int end, int thread_id) {
+			auto &triplets = get_local_thread_storage(storage, thread_id);
+
+			for (int e = start; e < end; ++e)
+			{
+				Block &block = blocks_[e];
+				block.interior = interior[e];
+				const int n_i = block.interior.size();
+				if (n_i == 0)
+					continue;
+
+				// skeleton dofs coupled to the interior ones, in the rows or in the columns
+				for (const int i : block.interior)
+				{
+					for (const StiffnessMatrix *M : {&A, &At})
+					{
+						for (StiffnessMatrix::InnerIterator it(*M, i); it; ++it)
+						{
+							const int j = it.row();
+							if (element[j] == -1)
+								block.coupled.push_back(skeleton_index_[j]);
+							else if (element[j] != e)
+								log_and_throw_error("Static condensation: interior dofs {} and {} of elements {} and {} are coupled", i, j, e, element[j]);
+						}
+					}
+				}
+				std::sort(block.coupled.begin(), block.coupled.end());
+				block.coupled.erase(std::unique(block.coupled.begin(), block.coupled.end()), block.coupled.end());
+				const int n_c = block.coupled.size();
+
+				// local position of the interior and skeleton dofs
+				const auto local_interior = [&](const int j) {
+					return int(std::find(block.interior.begin(), block.interior.end(), j) - block.interior.begin());
+				};
+				const auto local_coupled = [&](const int s) {
+					return int(std::lower_bound(block.coupled.begin(), block.coupled.end(), s) - block.coupled.begin());
+				};
+
+				Eigen::MatrixXd a_ii = Eigen::MatrixXd::Zero(n_i, n_i);
+				block.a_ic.setZero(n_i, n_c);
+				block.a_ci.setZero(n_c, n_i);
+				for (int li = 0; li < n_i; ++li)
+				{
+					// column li
+					for (StiffnessMatrix::InnerIterator it(A, block.interior[li]); it; ++it)
+					{
+						if (element[it.row()] == e)
+							a_ii(local_interior(it.row()), li) = it.value();
+						else
+							block.a_ci(local_coupled(skeleton_index_[it.row()]), li) = it.value();
+					}
+					// row li
+					for (StiffnessMatrix::InnerIterator it(At, block.interior[li]); it; ++it)
+					{
+						if (element[it.row()] != e)
+							block.a_ic(li, local_coupled(skeleton_index_[it.row()])) = it.value();
+					}
+				}
+
+				block.lu.compute(a_ii);
+
+				const Eigen::MatrixXd schur = block.a_ci * block.lu.solve(block.a_ic);
+				for (int r = 0; r < n_c; ++r)
+				{
+					for (int c = 0; c < n_c; ++c)
+					{
+						if (schur(r, c) != 0)
+							triplets.emplace_back(block.coupled[r], block.coupled[c], -schur(r, c));
+					}
+				}
+			}
+		});
+
+		std::vector<Eigen::Triplet<double>> triplets;
+		for (int k = 0; k < A.outerSize(); ++k)
+		{
+			if (element[k] != -1)
+				continue;
+			for (StiffnessMatrix::InnerIterator it(A, k); it; ++it)
+			{
+				if (element[it.row()] == -1)
+					triplets.emplace_back(skeleton_index_[it.row()], skeleton_index_[k], it.value());
+			}
+		}
+		for (const auto &local_triplets : storage)
+			triplets.insert(triplets.end(), local_triplets.begin(), local_triplets.end());
+
+		skeleton_.resize(n_skeleton, n_skeleton);
+		skeleton_.setFromTriplets(triplets.begin(), triplets.end());
+
+		logger().debug("Static condensation: {} interior dofs eliminated, {} skeleton dofs", n - n_skeleton, n_skeleton);
+	}
+
+	void StaticCondensation::condense(const Eigen::VectorXd &b, Eigen::VectorXd &b_s) const
+	{
+		assert(b.size() == n_dofs());
+
+		b_s.resize(n_skeleton());
+		for (int i = 0; i < n_dofs(); ++i)
+		{
+			if (skeleton_index_[i] >= 0)
+				b_s[skeleton_index_[i]] = b[i];
+		}
+
+		Eigen::VectorXd b_i;
+		for (const Block &block : blocks_)
+		{
+			if (block.interior.empty())
+				continue;
+
+			b_i.resize(block.interior.size());
+			for (int li = 0; li < block.interior.size(); ++li)
+				b_i[li] = b[block.interior[li]];
+
+			const Eigen::VectorXd tmp = block.a_ci * block.lu.solve(b_i);
+			for (int c = 0; c < block.coupled.size(); ++c)
+				b_s[block.coupled[c]] -= tmp[c];
+		}
+	}
+
+	void StaticCondensation::expand(const Eigen::VectorXd &b, const Eigen::VectorXd &x_s, Eigen::VectorXd &x) const
+	{
+		assert(b.size() == n_dofs());
+		assert(x_s.size() == n_skeleton());
+
+		x.resize(n_dofs());
+		for (int i = 0; i < n_dofs(); ++i)
+		{
+			if (skeleton_index_[i] >= 0)
+				x[i] = x_s[skeleton_index_[i]];
+		}
+
+		maybe_parallel_for(blocks_.size(), [&](int start, int end, int thread_id) {
+			Eigen::VectorXd rhs, x_c;
+			for (int e = start; e < end; ++e)
+			{
+				const Block &block = blocks_[e];
+				if (block.interior.empty())
+					continue;
+
+				x_c.resize(block.coupled.size());
+				for (int c = 0; c < block.coupled.size(); ++c)
+					x_c[c] = x_s[block.coupled[c]];
+
+				rhs.resize(block.interior.size());
+				for (int li = 0; li < block.interior.size(); ++li)
+					rhs[li] = b[block.interior[li]];
+				rhs -= block.a_ic * x_c;
+
+				const Eigen::VectorXd x_i = block.lu.solve(rhs);
+				for (int li = 0; li < block.interior.size(); ++li)
+					x[block.interior[li]] = x_i[li];
+			}
+		});
+	}
+} // namespace polyfem::solver
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <polyfem/basis/ElementBases.hpp>
+#include <polyfem/utils/Types.hpp>
+
+#include <Eigen/Dense>
+
+#include <vector>
+
+namespace polyfem::solver
+{
+	/// @brief Static condensation of the element-interior dofs of a linear system.
+	/// The dofs of the bases supported by one element only are coupled within their element, so the system
+	///     [A_ss A_si] [x_s]   [b_s]
+	///     [A_is A_ii] [x_i] = [b_i]
+	/// has a block diagonal A_ii (one block per element) and is reduced to the skeleton system
+	///     (A_ss - A_si A_ii^-1 A_is) x_s = b_s - A_si A_ii^-1 b_i
+	/// The interior dofs are recovered element by element with x_i = A_ii^-1 (b_i - A_is x_s).
+	class StaticCondensation
+	{
+	public:
+		/// @brief Interior dofs of every element: the dofs of the bases whose support is only that element
+		/// @param[in] bases bases
+		/// @param[in] n_bases number of global bases
+		/// @param[in] problem_dim number of dofs per basis
+		/// @param[in] excluded dofs kept in the skeleton (e.g., the Dirichlet nodes)
+		/// @return for every element the list of its interior dofs
+		static std::vector<std::vector<int>> interior_dofs(
+			const std::vector<basis::ElementBases> &bases,
+			const int n_bases,
+			const int problem_dim,
+			const std::vector<int> &excluded);
+
+		/// @brief Computes the Schur complement of the interior dofs, in parallel over the elements
+		/// @param[in] A full system matrix (not only the upper triangle)
+		/// @param[in] interior interior dofs of every element, see interior_dofs
+		StaticCondensation(const StiffnessMatrix &A, const std::vector<std::vector<int>> &interior);
+
+		int n_dofs() const { return skeleton_index_.size(); }
+		int n_skeleton() const { return skeleton_.rows(); }
+		int n_interior() const { return n_dofs() - n_skeleton(); }
+
+		/// @brief Skeleton system matrix (Schur complement), the skeleton dofs keep their relative order
+		const StiffnessMatrix &skeleton_matrix() const { return skeleton_; }
+
+		/// @brief Index of a dof in the skeleton system, -1 for interior dofs
+		int skeleton_index(const int dof) const { return skeleton_index_[dof]; }
+
+		/// @brief Right-hand side of the skeleton system
+		/// @param[in] b full right-hand side
+		/// @param[out] b_s skeleton right-hand side
+		void condense(const Eigen::VectorXd &b, Eigen::VectorXd &b_s) const;
+
+		/// @brief Solution of the full system from the skeleton solution
+		/// @param[in] b full right-hand side
+		/// @param[in] x_s skeleton solution
+		/// @param[out] x full solution
+		void expand(const Eigen::VectorXd &b, const Eigen::VectorXd &x_s, Eigen::VectorXd &x) const;
+
+	private:
+		struct Block
+		{
+			/// interior dofs
+			std::vector<int> interior;
+			/// skeleton indices of the dofs coupled to the interior ones
+			std::vector<int> coupled;
+			/// factorization of A_ii
+			Eigen::PartialPivLU<Eigen::MatrixXd> lu;
+			/// #interior x #coupled
+			Eigen::MatrixXd a_ic;
+			/// #coupled x #interior
+			Eigen::MatrixXd a_ci;
+		};
+
+		Eigen::VectorXi skeleton_index_;
+		StiffnessMatrix skeleton_;
+		std::vector<Block> blocks_;
+	};
+} // namespace polyfem::solver
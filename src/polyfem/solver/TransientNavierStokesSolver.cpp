@@ -2,7 +2,6 @@
 
 #include <polyfem/utils/MatrixUtils.hpp>
 #include <polysolve/LinearSolver.hpp>
-#include <polysolve/FEMSolver.hpp>
 #include <polyfem/assembler/AssemblerUtils.hpp>
 
 #include <polyfem/utils/Logger.hpp>
@@ -11,6 +10,7 @@
 
 #include <unsupported/Eigen/SparseExtra>
 
+#include <algorithm>
 #include <cmath>
 
 namespace polyfem
@@ -29,6 +29,9 @@ namespace polyfem
 		{
 			gradNorm = solver_param["nonlinear"]["grad_norm"];
 			iterations = solver_param["nonlinear"]["max_iterations"];
+
+			solver = LinearSolver::create(solver_type, precond_type);
+			solver->setParameters(solver_param);
 		}
 
 		void TransientNavierStokesSolver::minimize(
@@ -49,14 +52,13 @@ namespace polyfem
 		{
 			assert(velocity_assembler.name() == "NavierStokes");
 
-			auto solver = LinearSolver::create(solver_type, precond_type);
-			solver->setParameters(solver_param);
 			logger().debug("\tinternal solver {}", solver->name());
 
 			const int precond_num = problem_dim * n_bases;
 
-			StiffnessMatrix velocity_mass = velocity_mass1 / beta_dt;
-			// velocity_mass.setZero();
+			// there are no pressure bases here, the Schur complement is the least-squares commutator
+			if (!block_solver && BlockStokesSolver::is_enabled(solver_param["linear"]))
+				block_solver = std::make_unique<BlockStokesSolver>(solver_param["linear"], precond_num, n_pressure_bases, use_avg_pressure);
 
 			igl::Timer time;
 
@@ -64,13 +66,24 @@ namespace polyfem
 			StiffnessMatrix stoke_stiffness;
 			Eigen::VectorXd prev_sol_mass(rhs.size()); // prev_sol_mass=prev_sol
 			prev_sol_mass.setZero();
-			prev_sol_mass.block(0, 0, velocity_mass.rows(), 1) = velocity_mass * prev_sol.block(0, 0, velocity_mass.rows(), 1);
+			prev_sol_mass.block(0, 0, velocity_mass1.rows(), 1) = (velocity_mass1 * prev_sol.block(0, 0, velocity_mass1.rows(), 1)) / beta_dt;
 			for (int i : boundary_nodes)
 				prev_sol_mass[i] = 0;
 
-			AssemblerUtils::merge_mixed_matrices(n_bases, n_pressure_bases, problem_dim, use_avg_pressure,
-												 velocity_stiffness + velocity_mass, mixed_stiffness, pressure_stiffness,
-												 stoke_stiffness);
+			// the Stokes blocks and the mass are constant, they are merged again only if the time step changes
+			if (!stokes || beta_dt != stokes_beta_dt || stokes->constant().rows() != rhs.size())
+			{
+				const StiffnessMatrix velocity_mass = velocity_mass1 / beta_dt;
+				AssemblerUtils::merge_mixed_matrices(n_bases, n_pressure_bases, problem_dim, use_avg_pressure,
+													 velocity_stiffness + velocity_mass, mixed_stiffness, pressure_stiffness,
+													 stoke_stiffness);
+				stokes = std::make_unique<MergedMatrixCache>(stoke_stiffness);
+				stokes_beta_dt = beta_dt;
+				skipping = stokes->zero_columns(boundary_nodes);
+				needs_factorization = true;
+			}
+			else
+				stoke_stiffness = stokes->constant();
 			time.stop();
 			stokes_matrix_time = time.getElapsedTimeInSec();
 			logger().debug("\tStokes matrix assembly time {}s", time.getElapsedTimeInSec());
@@ -83,31 +96,29 @@ namespace polyfem
 			{
 				b[b.size() - 1] = 0;
 			}
-			dirichlet_solve(*solver, stoke_stiffness, b, boundary_nodes, x, precond_num, "", false, true, use_avg_pressure);
-			// solver->get_info(solver_info);
-			time.stop();
-			stokes_solve_time = time.getElapsedTimeInSec();
-			logger().debug("\tStokes solve time {}s", time.getElapsedTimeInSec());
-			logger().debug("\tStokes solver error: {}", (stoke_stiffness * x - b).norm());
-			// return;
-
-			std::vector<bool> zero_col(stoke_stiffness.cols(), true);
-			for (int k = 0; k < stoke_stiffness.outerSize(); ++k)
+			n_factorizations = 0;
+			if (x.size() == b.size())
 			{
-				for (StiffnessMatrix::InnerIterator it(stoke_stiffness, k); it; ++it)
-				{
-					if (fabs(it.value()) > 1e-12)
-						zero_col[it.col()] = false;
-				}
+				// warm start from the previous time step, only the Dirichlet values change
+				for (int i : boundary_nodes)
+					x[i] = b[i];
+				time.stop();
+				stokes_solve_time = 0;
+				logger().debug("\tStarting from the previous solution");
 			}
-			std::vector<int> skipping;
-			for (int i = 0; i < zero_col.size(); ++i)
+			else
 			{
-				if (zero_col[i])
-				{
-					skipping.push_back(i);
-				}
+				factorize(stoke_stiffness, boundary_nodes, precond_num);
+				solve_factorized(b, x);
+				// the Stokes matrix is only an approximation of the Jacobian
+				needs_factorization = true;
+				time.stop();
+				stokes_solve_time = time.getElapsedTimeInSec();
+				logger().debug("\tStokes solve time {}s", time.getElapsedTimeInSec());
+				if (logger().should_log(spdlog::level::debug))
+					logger().debug("\tStokes solver error: {}", (stoke_stiffness * x - b).norm());
 			}
+			// return;
 
 			assembly_time = 0;
 			inverting_time = 0;
@@ -120,7 +131,7 @@ namespace polyfem
 			{
 				b[b.size() - 1] = 0;
 			}
-			it += minimize_aux(true, skipping,
+			it += minimize_aux(true,
 							   n_bases,
 							   n_pressure_bases,
 							   bases,
@@ -131,8 +142,8 @@ namespace polyfem
 							   use_avg_pressure,
 							   problem_dim,
 							   is_volume,
-							   velocity_stiffness, mixed_stiffness, pressure_stiffness, velocity_mass, b, 1e-3, solver, nlres_norm, x);
-			it += minimize_aux(false, skipping,
+							   b, 1e-3, nlres_norm, x);
+			it += minimize_aux(false,
 							   n_bases,
 							   n_pressure_bases,
 							   bases,
@@ -143,25 +154,29 @@ namespace polyfem
 							   use_avg_pressure,
 							   problem_dim,
 							   is_volume,
-							   velocity_stiffness, mixed_stiffness, pressure_stiffness, velocity_mass, b, gradNorm, solver, nlres_norm, x);
+							   b, gradNorm, nlres_norm, x);
 
 			solver_info["iterations"] = it;
 			solver_info["gradNorm"] = nlres_norm;
+			solver_info["factorizations"] = n_factorizations;
+			solver_info["symbolic_analyses"] = n_analyses;
 
-			assembly_time /= it;
-			inverting_time /= it;
+			if (it > 0)
+			{
+				assembly_time /= it;
+				inverting_time /= it;
+			}
 
 			solver_info["time_assembly"] = assembly_time;
 			solver_info["time_inverting"] = inverting_time;
 			solver_info["time_stokes_assembly"] = stokes_matrix_time;
 			solver_info["time_stokes_solve"] = stokes_solve_time;
 
-			logger().info("finished with niter: {},  ||g||_2 = {}", it, nlres_norm);
+			logger().info("finished with niter: {}, factorizations: {}, ||g||_2 = {}", it, n_factorizations, nlres_norm);
 		}
 
 		int TransientNavierStokesSolver::minimize_aux(
 			const bool is_picard,
-			const std::vector<int> &skipping,
 			const int n_bases,
 			const int n_pressure_bases,
 			const std::vector<basis::ElementBases> &bases,
@@ -172,25 +187,21 @@ namespace polyfem
 			const bool use_avg_pressure,
 			const int problem_dim,
 			const bool is_volume,
-			const StiffnessMatrix &velocity_stiffness, const StiffnessMatrix &mixed_stiffness, const StiffnessMatrix &pressure_stiffness,
-			const StiffnessMatrix &velocity_mass,
 			const Eigen::VectorXd &rhs, const double grad_norm,
-			std::unique_ptr<LinearSolver> &solver, double &nlres_norm,
+			double &nlres_norm,
 			Eigen::VectorXd &x)
 		{
 			igl::Timer time;
 			const int precond_num = problem_dim * n_bases;
 
 			StiffnessMatrix nl_matrix;
-			StiffnessMatrix total_matrix;
-			SparseMatrixCache mat_cache;
+			// Picard matrices at the current iterate and at the trial one
+			StiffnessMatrix total_matrix, next_matrix;
 
 			time.start();
 			velocity_assembler.set_picard(true);
 			velocity_assembler.assemble_hessian(is_volume, n_bases, false, bases, gbases, ass_vals_cache, 0, x, Eigen::MatrixXd(), mat_cache, nl_matrix);
-			AssemblerUtils::merge_mixed_matrices(n_bases, n_pressure_bases, problem_dim, use_avg_pressure,
-												 (velocity_stiffness + nl_matrix) + velocity_mass, mixed_stiffness, pressure_stiffness,
-												 total_matrix);
+			stokes->add(nl_matrix, total_matrix);
 			time.stop();
 			assembly_time = time.getElapsedTimeInSec();
 			logger().debug("\tNavier Stokes assembly time {}s", time.getElapsedTimeInSec());
@@ -200,7 +211,7 @@ namespace polyfem
 				nlres[i] = 0;
 			for (int i : skipping)
 				nlres[i] = 0;
-			Eigen::VectorXd dx;
+			Eigen::VectorXd dx, next_nlres;
 			nlres_norm = nlres.norm();
 			logger().debug("\tInitial residula norm {}", nlres_norm);
 
@@ -211,15 +222,23 @@ namespace polyfem
 				++it;
 
 				time.start();
-				if (!is_picard)
+				// the last factorization (of an older iterate or time step) is reused until the residual stalls
+				const bool refactorized = needs_factorization;
+				if (needs_factorization)
 				{
-					velocity_assembler.set_picard(false);
-					velocity_assembler.assemble_hessian(is_volume, n_bases, false, bases, gbases, ass_vals_cache, 0, x, Eigen::MatrixXd(), mat_cache, nl_matrix);
-					AssemblerUtils::merge_mixed_matrices(n_bases, n_pressure_bases, problem_dim, use_avg_pressure,
-														 (velocity_stiffness + nl_matrix) + velocity_mass, mixed_stiffness, pressure_stiffness,
-														 total_matrix);
+					if (!is_picard)
+					{
+						velocity_assembler.set_picard(false);
+						velocity_assembler.assemble_hessian(is_volume, n_bases, false, bases, gbases, ass_vals_cache, 0, x, Eigen::MatrixXd(), mat_cache, nl_matrix);
+						StiffnessMatrix jacobian;
+						stokes->add(nl_matrix, jacobian);
+						factorize(jacobian, boundary_nodes, precond_num);
+					}
+					else
+						factorize(total_matrix, boundary_nodes, precond_num);
+					needs_factorization = false;
 				}
-				dirichlet_solve(*solver, total_matrix, nlres, boundary_nodes, dx, precond_num, "", false, true, use_avg_pressure);
+				solve_factorized(nlres, dx);
 				// for (int i : boundary_nodes)
 				// 	dx[i] = 0;
 				time.stop();
@@ -232,25 +251,37 @@ namespace polyfem
 				time.start();
 				velocity_assembler.set_picard(true);
 				velocity_assembler.assemble_hessian(is_volume, n_bases, false, bases, gbases, ass_vals_cache, 0, x, Eigen::MatrixXd(), mat_cache, nl_matrix);
-				AssemblerUtils::merge_mixed_matrices(n_bases, n_pressure_bases, problem_dim, use_avg_pressure,
-													 (velocity_stiffness + nl_matrix) + velocity_mass, mixed_stiffness, pressure_stiffness,
-													 total_matrix);
+				stokes->add(nl_matrix, next_matrix);
 				time.stop();
 				logger().debug("\tassembly time {}s", time.getElapsedTimeInSec());
 				assembly_time += time.getElapsedTimeInSec();
 
-				nlres = -(total_matrix * x) + rhs;
+				next_nlres = -(next_matrix * x) + rhs;
 				for (int i : boundary_nodes)
-					nlres[i] = 0;
+					next_nlres[i] = 0;
 				for (int i : skipping)
-					nlres[i] = 0;
+					next_nlres[i] = 0;
 
 				// if (use_avg_pressure)
 				// nlres[nlres.size() - 1] = 0;
-				nlres_norm = nlres.norm();
+				const double next_nlres_norm = next_nlres.norm();
+
+				logger().debug("\titer: {},  ||g||_2 = {}, ||step|| = {}, refactorized: {}\n",
+							   it, next_nlres_norm, dx.norm(), refactorized);
+
+				if (!refactorized && next_nlres_norm >= nlres_norm)
+				{
+					// the old factorization does not reduce the residual, the step is redone with a new one
+					x -= dx;
+					needs_factorization = true;
+					continue;
+				}
+				if (next_nlres_norm > refactorization_ratio * nlres_norm)
+					needs_factorization = true;
 
-				logger().debug("\titer: {},  ||g||_2 = {}, ||step|| = {}\n",
-							   it, nlres_norm, dx.norm());
+				std::swap(total_matrix, next_matrix);
+				std::swap(nlres, next_nlres);
+				nlres_norm = next_nlres_norm;
 			}
 
 			if (it >= iterations)
@@ -265,5 +296,70 @@ namespace polyfem
 
 			return it;
 		}
+
+		void TransientNavierStokesSolver::factorize(const StiffnessMatrix &A, const std::vector<int> &boundary_nodes, const int precond_num)
+		{
+			++n_factorizations;
+
+			if (block_solver)
+			{
+				block_solver->factorize(A, boundary_nodes);
+				return;
+			}
+
+			std::vector<bool> is_identity(A.rows(), false);
+			for (int i : boundary_nodes)
+				is_identity[i] = true;
+			for (int i : skipping)
+				is_identity[i] = true;
+
+			std::vector<Eigen::Triplet<double>> triplets;
+			triplets.reserve(A.nonZeros() + boundary_nodes.size() + skipping.size());
+			for (int k = 0; k < A.outerSize(); ++k)
+			{
+				for (StiffnessMatrix::InnerIterator it(A, k); it; ++it)
+				{
+					if (!is_identity[it.row()])
+						triplets.emplace_back(it.row(), it.col(), it.value());
+				}
+			}
+			for (int i = 0; i < A.rows(); ++i)
+			{
+				if (is_identity[i])
+					triplets.emplace_back(i, i, 1.);
+			}
+			StiffnessMatrix A_bc(A.rows(), A.cols());
+			A_bc.setFromTriplets(triplets.begin(), triplets.end());
+			A_bc.makeCompressed();
+
+			// the pattern is the same for the Picard and Newton matrices of every time step
+			const bool same_pattern = A_bc.outerSize() + 1 == analyzed_outer.size()
+									  && A_bc.nonZeros() == analyzed_inner.size()
+									  && std::equal(analyzed_outer.begin(), analyzed_outer.end(), A_bc.outerIndexPtr())
+									  && std::equal(analyzed_inner.begin(), analyzed_inner.end(), A_bc.innerIndexPtr());
+			if (!same_pattern)
+			{
+				solver->analyzePattern(A_bc, precond_num);
+				analyzed_outer.assign(A_bc.outerIndexPtr(), A_bc.outerIndexPtr() + A_bc.outerSize() + 1);
+				analyzed_inner.assign(A_bc.innerIndexPtr(), A_bc.innerIndexPtr() + A_bc.nonZeros());
+				++n_analyses;
+			}
+			solver->factorize(A_bc);
+		}
+
+		void TransientNavierStokesSolver::solve_factorized(const Eigen::VectorXd &b, Eigen::VectorXd &x)
+		{
+			x.setZero(b.size());
+			if (block_solver)
+			{
+				block_solver->solve(b, x);
+				return;
+			}
+
+			Eigen::VectorXd rhs = b;
+			for (int i : skipping)
+				rhs[i] = 0;
+			solver->solve(rhs, x);
+		}
 	} // namespace solver
 } // namespace polyfem
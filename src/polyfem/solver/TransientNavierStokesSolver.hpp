@@ -1,5 +1,8 @@
 #pragma once
 
+#include "BlockStokesSolver.hpp"
+#include "MergedMatrixCache.hpp"
+
 #include <polyfem/Common.hpp>
 #include <polyfem/basis/ElementBases.hpp>
 #include <polyfem/assembler/NavierStokes.hpp>
@@ -8,6 +11,7 @@
 #include <polysolve/LinearSolver.hpp>
 
 #include <polyfem/utils/Logger.hpp>
+#include <polyfem/utils/MatrixUtils.hpp>
 
 #include <memory>
 
@@ -43,7 +47,6 @@ namespace polyfem
 
 		private:
 			int minimize_aux(const bool is_picard,
-							 const std::vector<int> &skipping,
 							 const int n_bases,
 							 const int n_pressure_bases,
 							 const std::vector<basis::ElementBases> &bases,
@@ -54,12 +57,16 @@ namespace polyfem
 							 const bool use_avg_pressure,
 							 const int problem_dim,
 							 const bool is_volume,
-							 const StiffnessMatrix &velocity_stiffness, const StiffnessMatrix &mixed_stiffness, const StiffnessMatrix &pressure_stiffness,
-							 const StiffnessMatrix &velocity_mass,
 							 const Eigen::VectorXd &rhs, const double grad_norm,
-							 std::unique_ptr<polysolve::LinearSolver> &solver, double &nlres_norm,
+							 double &nlres_norm,
 							 Eigen::VectorXd &x);
 
+			/// @brief Factorizes the mixed system with the Dirichlet and skipped rows replaced by rows of the identity,
+			/// the symbolic analysis is redone only if the pattern changes
+			void factorize(const StiffnessMatrix &A, const std::vector<int> &boundary_nodes, const int precond_num);
+			/// @brief Solves with the last factorization, with the block solver if enabled
+			void solve_factorized(const Eigen::VectorXd &b, Eigen::VectorXd &x);
+
 			const json solver_param;
 			const std::string solver_type;
 			const std::string precond_type;
@@ -76,6 +83,31 @@ namespace polyfem
 			double stokes_matrix_time;
 			double stokes_solve_time;
 
+			/// linear solver kept across the iterations and the time steps
+			std::unique_ptr<polysolve::LinearSolver> solver;
+			/// pattern of the last analyzed matrix
+			std::vector<StiffnessMatrix::StorageIndex> analyzed_outer;
+			std::vector<StiffnessMatrix::StorageIndex> analyzed_inner;
+			/// the next solve factorizes the current matrix (no factorization yet, new time step size or stalled residual),
+			/// otherwise the last factorization is reused, also from the previous time step
+			bool needs_factorization = true;
+			int n_factorizations = 0;
+			int n_analyses = 0;
+			/// the Jacobian is refactorized when a step reduces the residual by less than this ratio
+			static constexpr double refactorization_ratio = 0.5;
+
+			/// block preconditioned solver of the mixed systems, if enabled in the linear solver settings
+			std::unique_ptr<BlockStokesSolver> block_solver;
+
+			/// merged Stokes and mass matrices, reused while the time step does not change
+			/// (the Stokes blocks, the mass and the boundary nodes are the same at every time step)
+			std::unique_ptr<MergedMatrixCache> stokes;
+			double stokes_beta_dt = 0;
+			/// zero columns of the merged matrix, skipped in the residual
+			std::vector<int> skipping;
+			/// pattern of the convective block, reused across the time steps
+			utils::SparseMatrixCache mat_cache;
+
 			bool
 			has_nans(const polyfem::StiffnessMatrix &hessian);
 		};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "SparseNewtonDescentSolver.hpp"
+
+#include <functional>
+
+namespace cppoptlib
+{
+	/// Newton trust-region solver: the step minimizes the quadratic model of the energy inside a ball
+	/// and the ball radius follows the agreement between the model and the energy, instead of a line search.
+	/// The model is solved with dogleg for direct linear solvers (the Newton step comes from the factorization,
+	/// reused when the Hessian is lagged) and with Steihaug conjugate gradient for iterative linear solvers
+	/// and matrix-free Hessians.
+	template <typename ProblemType>
+	class TrustRegionSolver : public SparseNewtonDescentSolver<ProblemType>
+	{
+	public:
+		using Superclass = SparseNewtonDescentSolver<ProblemType>;
+		using typename Superclass::Scalar;
+		using typename Superclass::TVector;
+
+		TrustRegionSolver(const json &solver_params, const json &linear_solver_params, const double dt);
+
+		std::string name() const override { return "TrustRegion"; }
+
+		/// Accepts or rejects the step from the ratio of the actual and predicted energy decrease
+		/// and updates the radius, the step is first truncated to the collision-free step size
+		double line_search(const TVector &x, const TVector &delta_x, ProblemType &objFunc) override;
+
+		double radius() const { return trust_radius; }
+
+	protected:
+		bool compute_update_direction(ProblemType &objFunc, const TVector &x, const TVector &grad, TVector &direction) override;
+
+		/// A rejected step keeps the model, the Hessian is not assembled again
+		bool assembles_hessian_at(const TVector &x) const override;
+
+		/// Dogleg step between the Cauchy point and the Newton step
+		void dogleg_step(const TVector &grad, TVector &direction);
+
+		/// Steihaug conjugate gradient, returns false if the descent strategy was increased
+		bool steihaug_step(const TVector &grad, TVector &direction);
+
+		/// Prepare the Hessian (or its products) at x for the current descent strategy, false if it was increased
+		bool update_model(ProblemType &objFunc, const TVector &x, const TVector &grad);
+
+		/// Norm of the trust region, scaled by the Jacobi preconditioner for Steihaug conjugate gradient
+		double step_norm(const TVector &p) const;
+		double metric_dot(const TVector &a, const TVector &b) const;
+		/// Step τ ≥ 0 along d such that z + τd is on the boundary of the trust region
+		double boundary_step(const TVector &z, const TVector &d) const;
+
+		void reset(const int ndof) override;
+
+		void update_solver_info() override;
+
+		// ====================================================================
+		//                        Solver parameters
+		// ====================================================================
+
+		static constexpr double shrink_ratio = 0.25; ///< Shrink the radius below this ratio of actual/predicted decrease
+		static constexpr double expand_ratio = 0.75; ///< Expand the radius above this ratio if the step hit the boundary
+		static constexpr double shrink_factor = 0.25;
+		static constexpr double expand_factor = 2;
+
+		bool steihaug = false;      ///< Whether to solve the model with Steihaug conjugate gradient instead of dogleg
+		double initial_radius;      ///< Radius of the first iteration, 0 to take the first step unconstrained
+		double max_radius;          ///< Largest radius, 0 if unbounded
+		double eta;                 ///< Smallest ratio of actual/predicted decrease accepting a step
+
+		// ====================================================================
+		//                           Solver state
+		// ====================================================================
+
+		double trust_radius;        ///< Current radius, nan before the first step
+
+		TVector model_x;            ///< Iterate the model was built at, rejected steps reuse it
+		int model_descent_strategy; ///< Descent strategy the model was built with
+		bool model_has_hessian;     ///< Whether the model is quadratic, false for gradient descent
+		TVector newton_step;        ///< Newton step of the model (dogleg)
+		TVector scaling;            ///< Normalized Jacobi preconditioner, the trust region metric (Steihaug)
+		std::function<void(const TVector &, TVector &)> model_hessian_product;
+
+		double step_gradient;       ///< gᵀp of the last step
+		double step_curvature;      ///< pᵀHp of the last step
+		bool step_on_boundary;      ///< Whether the last step was limited by the radius
+
+		int n_rejected_steps = 0;
+
+		// ====================================================================
+		//                                END
+		// ====================================================================
+	};
+
+} // namespace cppoptlib
+
+#include "TrustRegionSolver.tpp"
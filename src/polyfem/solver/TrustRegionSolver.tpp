@@ -0,0 +1,391 @@
+#pragma once
+
+#include "TrustRegionSolver.hpp"
+
+#include <limits>
+
+namespace cppoptlib
+{
+	template <typename ProblemType>
+	TrustRegionSolver<ProblemType>::TrustRegionSolver(
+		const json &solver_params, const json &linear_solver_params, const double dt)
+		: Superclass(solver_params, linear_solver_params, dt)
+	{
+		const json &trust_region_params = solver_params["trust_region"];
+		initial_radius = trust_region_params["initial_radius"];
+		max_radius = trust_region_params["max_radius"];
+		eta = trust_region_params["eta"];
+
+		// iterative linear solvers have no factorization to reuse for the Newton step of dogleg
+		steihaug = this->matrix_free || Superclass::is_iterative_linear_solver(linear_solver_params["solver"]);
+
+		// the step acceptance replaces the line search
+		this->set_line_search("none");
+	}
+
+	// =======================================================================
+
+	template <typename ProblemType>
+	void TrustRegionSolver<ProblemType>::reset(const int ndof)
+	{
+		Superclass::reset(ndof);
+		trust_radius = std::nan("");
+		model_x.resize(0);
+		newton_step.resize(0);
+		scaling.resize(0);
+		n_rejected_steps = 0;
+	}
+
+	// =======================================================================
+
+	template <typename ProblemType>
+	double TrustRegionSolver<ProblemType>::metric_dot(const TVector &a, const TVector &b) const
+	{
+		return scaling.size() ? a.dot(scaling.cwiseProduct(b)) : a.dot(b);
+	}
+
+	template <typename ProblemType>
+	double TrustRegionSolver<ProblemType>::step_norm(const TVector &p) const
+	{
+		return std::sqrt(metric_dot(p, p));
+	}
+
+	template <typename ProblemType>
+	double TrustRegionSolver<ProblemType>::boundary_step(const TVector &z, const TVector &d) const
+	{
+		// positive root of ‖z + τd‖² = Δ², z is inside the trust region
+		const double a = metric_dot(d, d);
+		const double b = 2 * metric_dot(z, d);
+		const double c = metric_dot(z, z) - trust_radius * trust_radius;
+		return (-b + std::sqrt(std::max(b * b - 4 * a * c, 0.0))) / (2 * a);
+	}
+
+	// =======================================================================
+
+	template <typename ProblemType>
+	bool TrustRegionSolver<ProblemType>::update_model(ProblemType &objFunc, const TVector &x, const TVector &grad)
+	{
+		if (!steihaug)
+		{
+			// Newton step from a new or the lagged factorization, the Hessian is kept with it
+			Superclass::compute_update_direction(objFunc, x, grad, newton_step);
+			model_has_hessian = this->descent_strategy != 2;
+			model_hessian_product = [this](const TVector &p, TVector &Hp) { Hp = this->last_hessian * p; };
+			return true;
+		}
+
+		model_has_hessian = this->descent_strategy != 2;
+		if (!model_has_hessian)
+			return true;
+
+		if (this->matrix_free)
+		{
+			POLYFEM_SCOPED_TIMER("assembly time", this->assembly_time);
+
+			objFunc.set_project_to_psd(this->descent_strategy == 1);
+			objFunc.init_hessian_vector_product(x);
+			if (this->matrix_free_jacobi)
+				objFunc.hessian_diagonal(x, scaling);
+
+			const double reg_weight = this->reg_weight;
+			model_hessian_product = [this, &objFunc, reg_weight](const TVector &p, TVector &Hp) {
+				objFunc.hessian_vector_product(model_x, p, Hp);
+				if (reg_weight > 0)
+					Hp += reg_weight * p;
+			};
+		}
+		else
+		{
+			this->assemble_hessian(objFunc, x, this->last_hessian);
+			if (this->matrix_free_jacobi)
+				scaling = this->last_hessian.diagonal();
+
+			model_hessian_product = [this](const TVector &p, TVector &Hp) { Hp = this->last_hessian * p; };
+		}
+
+		if (!this->matrix_free_jacobi)
+		{
+			scaling.setOnes(x.size());
+			return true;
+		}
+
+		if (this->matrix_free)
+			scaling.array() += this->reg_weight;
+
+		// normalized by the mean so that the radius stays in the units of the solution,
+		// a non positive diagonal cannot precondition, fall back to the mean there
+		const auto positive = scaling.array() > 0;
+		const int n_positive = positive.count();
+		const double mean = n_positive > 0 ? positive.select(scaling, 0).sum() / n_positive : 1;
+		scaling = positive.select(scaling / mean, TVector::Ones(scaling.size()));
+
+		return true;
+	}
+
+	// =======================================================================
+
+	template <typename ProblemType>
+	bool TrustRegionSolver<ProblemType>::assembles_hessian_at(const TVector &x) const
+	{
+		const bool same_model = model_x.size() == x.size() && model_x == x && model_descent_strategy == this->descent_strategy;
+		return !same_model && Superclass::assembles_hessian_at(x);
+	}
+
+	template <typename ProblemType>
+	bool TrustRegionSolver<ProblemType>::compute_update_direction(
+		ProblemType &objFunc,
+		const TVector &x,
+		const TVector &grad,
+		TVector &direction)
+	{
+		// a rejected step retries from the same iterate, only the radius changed
+		if (model_x.size() != x.size() || model_x != x || model_descent_strategy != this->descent_strategy)
+		{
+			model_x = x;
+			if (!update_model(objFunc, x, grad))
+			{
+				model_x.resize(0);
+				return compute_update_direction(objFunc, x, grad, direction);
+			}
+			model_descent_strategy = this->descent_strategy;
+		}
+
+		if (!model_has_hessian)
+		{
+			// gradient descent, the linear model is minimized on the boundary
+			if (std::isnan(trust_radius))
+				trust_radius = initial_radius > 0 ? initial_radius : step_norm(grad);
+			direction = -(trust_radius / step_norm(grad)) * grad;
+			step_on_boundary = true;
+		}
+		else if (steihaug)
+		{
+			if (!steihaug_step(grad, direction))
+			{
+				// steihaug_step increased descent_strategy
+				model_x.resize(0);
+				return compute_update_direction(objFunc, x, grad, direction);
+			}
+		}
+		else
+			dogleg_step(grad, direction);
+
+		step_gradient = grad.dot(direction);
+		step_curvature = 0;
+		if (model_has_hessian)
+		{
+			TVector Hp;
+			model_hessian_product(direction, Hp);
+			step_curvature = direction.dot(Hp);
+		}
+
+		return true;
+	}
+
+	// =======================================================================
+
+	template <typename ProblemType>
+	void TrustRegionSolver<ProblemType>::dogleg_step(const TVector &grad, TVector &direction)
+	{
+		const double newton_norm = newton_step.norm();
+		if (std::isnan(trust_radius))
+			trust_radius = initial_radius > 0 ? initial_radius : newton_norm;
+
+		step_on_boundary = newton_norm > trust_radius;
+		if (!step_on_boundary)
+		{
+			direction = newton_step;
+			return;
+		}
+
+		TVector Hg;
+		model_hessian_product(grad, Hg);
+		const double gHg = grad.dot(Hg);
+		const double grad_norm = grad.norm();
+
+		// Cauchy point outside the trust region (or no positive curvature along g), steepest descent to the boundary
+		if (!(gHg > 0) || grad_norm * grad_norm * grad_norm >= trust_radius * gHg)
+		{
+			direction = -(trust_radius / grad_norm) * grad;
+			return;
+		}
+
+		const TVector cauchy = -(grad.squaredNorm() / gHg) * grad;
+		const TVector d = newton_step - cauchy;
+		direction = cauchy + boundary_step(cauchy, d) * d;
+	}
+
+	// =======================================================================
+
+	template <typename ProblemType>
+	bool TrustRegionSolver<ProblemType>::steihaug_step(const TVector &grad, TVector &direction)
+	{
+		// without initial radius the first step is the (truncated) Newton step and sets the radius
+		const bool unbounded = std::isnan(trust_radius) && initial_radius <= 0;
+		if (std::isnan(trust_radius) && !unbounded)
+			trust_radius = initial_radius;
+
+		POLYFEM_SCOPED_TIMER("linear solve", this->inverting_time);
+
+		// conjugate gradient on the model from 0, stopped on the boundary or along negative curvature
+		direction.setZero(grad.size());
+		step_on_boundary = false;
+		TVector r = grad; // gradient of the model at direction
+		TVector y = r.cwiseQuotient(scaling);
+		TVector d = -y;
+		TVector Hd;
+		double ry = r.dot(y);
+
+		const double tol = this->matrix_free_tolerance * grad.norm();
+		double residual = r.norm();
+		int iter = 0;
+		for (; iter < this->matrix_free_max_iterations && residual > tol; ++iter)
+		{
+			model_hessian_product(d, Hd);
+			const double dHd = d.dot(Hd);
+			if (std::isnan(dHd))
+			{
+				residual = dHd;
+				break;
+			}
+
+			if (dHd <= 0)
+			{
+				if (!unbounded)
+				{
+					direction += boundary_step(direction, d) * d;
+					step_on_boundary = true;
+					break;
+				}
+
+				// keep the last iterate, unless there is none
+				if (iter > 0)
+					break;
+
+				this->increase_descent_strategy();
+				polyfem::logger().log(
+					this->log_level(), "[{}] negative curvature in Steihaug conjugate gradient (dᵀHd={}); reverting to {}",
+					name(), dHd, this->descent_strategy_name());
+				return false;
+			}
+
+			const double alpha = ry / dHd;
+			if (!unbounded && step_norm(direction + alpha * d) >= trust_radius)
+			{
+				direction += boundary_step(direction, d) * d;
+				step_on_boundary = true;
+				break;
+			}
+
+			direction += alpha * d;
+			r += alpha * Hd;
+			residual = r.norm();
+
+			y = r.cwiseQuotient(scaling);
+			const double ry_new = r.dot(y);
+			d = -y + (ry_new / ry) * d;
+			ry = ry_new;
+		}
+
+		if (std::isnan(residual) || !std::isfinite(direction.squaredNorm()))
+		{
+			this->increase_descent_strategy();
+			polyfem::logger().log(
+				this->log_level(), "[{}] nan Steihaug conjugate gradient residual; reverting to {}",
+				name(), this->descent_strategy_name());
+			return false;
+		}
+
+		if (unbounded)
+			trust_radius = step_norm(direction);
+
+		polyfem::logger().trace(
+			"Steihaug conjugate gradient {} iterations, residual {}, on boundary {}", iter, residual, step_on_boundary);
+
+		this->internal_solver_info.push_back(json({{"solver", "Steihaug-CG"}, {"iterations", iter}, {"residual", residual}}));
+
+		this->reg_weight /= this->reg_weight_dec;
+		if (this->reg_weight < this->reg_weight_min)
+			this->reg_weight = 0;
+
+		return true;
+	}
+
+	// =======================================================================
+
+	template <typename ProblemType>
+	double TrustRegionSolver<ProblemType>::line_search(const TVector &x, const TVector &delta_x, ProblemType &objFunc)
+	{
+		POLYFEM_SCOPED_TIMER("line search", this->line_search_time);
+
+		const double energy = objFunc.value(x);
+
+		// the step is truncated to the collision-free step size, as in the line searches
+		TVector new_x = x + delta_x;
+		objFunc.line_search_begin(x, new_x);
+		const double rate = std::min(objFunc.max_step_size(x, new_x), 1.0);
+		if (rate < 1)
+			new_x = x + rate * delta_x;
+
+		double new_energy = std::nan("");
+		bool is_step_valid = rate > 0;
+		if (is_step_valid)
+		{
+			objFunc.solution_changed(new_x);
+			new_energy = objFunc.value(new_x);
+			is_step_valid = std::isfinite(new_energy) && objFunc.is_step_valid(x, new_x);
+		}
+		objFunc.line_search_end();
+
+		// ratio of the actual and predicted decrease, the model is exact to round-off for tiny steps
+		const double predicted = -(rate * step_gradient + 0.5 * rate * rate * step_curvature);
+		const double actual = energy - new_energy;
+		const double round_off = std::numeric_limits<double>::epsilon() * std::abs(energy);
+		double rho = actual / predicted;
+		if (predicted <= round_off)
+			rho = actual >= -round_off ? 1 : -1;
+
+		const double step = rate * step_norm(delta_x);
+		if (!is_step_valid || !(rho >= shrink_ratio))
+			trust_radius = shrink_factor * std::min(trust_radius, step);
+		else if (rho > expand_ratio && step_on_boundary && rate == 1)
+		{
+			trust_radius *= expand_factor;
+			if (max_radius > 0)
+				trust_radius = std::min(trust_radius, max_radius);
+		}
+
+		polyfem::logger().trace(
+			"[{}] trust region ρ={:g} (actual={:g} predicted={:g}) rate={:g} radius={:g}",
+			name(), rho, actual, predicted, rate, trust_radius);
+
+		if (is_step_valid && rho > eta)
+			return rate;
+
+		++n_rejected_steps;
+		polyfem::logger().debug(
+			"[{}] step rejected (valid={} ρ={:g}); shrinking the trust region to {:g}",
+			name(), is_step_valid, rho, trust_radius);
+
+		if (!(trust_radius > std::numeric_limits<double>::epsilon() * std::max(1.0, x.norm())))
+		{
+			polyfem::logger().error("[{}] Trust region radius vanished; stopping", name());
+			this->m_status = Status::UserDefined;
+			throw std::runtime_error("Trust region radius vanished");
+		}
+
+		// retry from x with the smaller radius
+		this->m_status = Status::Continue;
+		return std::nan("");
+	}
+
+	// =======================================================================
+
+	template <typename ProblemType>
+	void TrustRegionSolver<ProblemType>::update_solver_info()
+	{
+		Superclass::update_solver_info();
+		this->solver_info["trust_region_radius"] = trust_radius;
+		this->solver_info["rejected_steps"] = n_rejected_steps;
+	}
+} // namespace cppoptlib
@@ -69,6 +69,7 @@ namespace polyfem::solver
 			assert(row == col); // matrix should be diagonal
 			return !is_boundary_dof[row];
 		});
+		masked_lumped_mass_.makeCompressed();
 	}
 
 	double ALForm::value_unweighted(const Eigen::VectorXd &x) const
@@ -86,6 +87,11 @@ namespace polyfem::solver
 		return AL_penalty;
 	}
 
+	double ALForm::compute_error(const Eigen::VectorXd &x) const
+	{
+		return std::sqrt(2 * value_unweighted(x));
+	}
+
 	void ALForm::first_derivative_unweighted(const Eigen::VectorXd &x, Eigen::VectorXd &gradv) const
 	{
 		gradv = masked_lumped_mass_ * (x - target_x_);
@@ -96,6 +102,12 @@ namespace polyfem::solver
 		hessian = masked_lumped_mass_;
 	}
 
+	const StiffnessMatrix *ALForm::constant_hessian(double &scale) const
+	{
+		scale = 1;
+		return &masked_lumped_mass_;
+	}
+
 	void ALForm::update_quantities(const double t, const Eigen::VectorXd &)
 	{
 		if (is_time_dependent_)
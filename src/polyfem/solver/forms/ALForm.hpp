@@ -64,6 +64,16 @@ namespace polyfem::solver
 		/// @param[out] hessian Output Hessian of the value wrt x
 		void second_derivative_unweighted(const Eigen::VectorXd &x, StiffnessMatrix &hessian) const override;
 
+		/// @brief Compute the distance of the Dirichlet DoFs to their target in the lumped mass norm
+		/// @param x Current solution
+		/// @return \f$\sqrt{(x - \hat{x})^T M (x - \hat{x})}\f$
+		double compute_error(const Eigen::VectorXd &x) const;
+
+		/// @brief The Hessian is the masked lumped mass matrix
+		/// @param[out] scale Factor of the masked lumped mass matrix
+		/// @return Masked lumped mass matrix
+		const StiffnessMatrix *constant_hessian(double &scale) const override;
+
 	public:
 		/// @brief Update time dependent quantities
 		/// @param t New time
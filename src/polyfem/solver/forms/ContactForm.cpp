@@ -11,10 +11,16 @@
 #include <polyfem/io/OBJWriter.hpp>
 
 #include <ipc/barrier/adaptive_stiffness.hpp>
+#include <ipc/barrier/barrier.hpp>
 #include <ipc/utils/world_bbox_diagonal_length.hpp>
 
 #include <igl/writePLY.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <limits>
+
 namespace polyfem::solver
 {
 	ContactForm::ContactForm(const ipc::CollisionMesh &collision_mesh,
@@ -44,12 +50,14 @@ namespace polyfem::solver
 
 	void ContactForm::init(const Eigen::VectorXd &x)
 	{
-		update_constraint_set(compute_displaced_surface(x));
+		update_constraint_set(x);
+		world_bbox_diagonal_ = ipc::world_bbox_diagonal_length(displaced_surface(x));
 	}
 
 	void ContactForm::update_quantities(const double t, const Eigen::VectorXd &x)
 	{
-		update_constraint_set(compute_displaced_surface(x));
+		update_constraint_set(x);
+		world_bbox_diagonal_ = ipc::world_bbox_diagonal_length(displaced_surface(x));
 	}
 
 	Eigen::MatrixXd ContactForm::compute_displaced_surface(const Eigen::VectorXd &x) const
@@ -57,6 +65,22 @@ namespace polyfem::solver
 		return collision_mesh_.displace_vertices(utils::unflatten(x, collision_mesh_.dim()));
 	}
 
+	const Eigen::MatrixXd &ContactForm::displaced_surface(const Eigen::VectorXd &x) const
+	{
+		if (!has_displaced_surface_ || displaced_surface_x_.size() != x.size() || displaced_surface_x_ != x)
+		{
+			displaced_surface_ = compute_displaced_surface(x);
+			displaced_surface_x_ = x;
+			has_displaced_surface_ = true;
+		}
+		return displaced_surface_;
+	}
+
+	bool ContactForm::is_constraint_set_solution(const Eigen::VectorXd &x) const
+	{
+		return has_constraint_set_x_ && constraint_set_x_.size() == x.size() && constraint_set_x_ == x;
+	}
+
 	void ContactForm::update_barrier_stiffness(
 		const Eigen::VectorXd &x,
 		NLProblem &nl_problem,
@@ -87,11 +111,9 @@ namespace polyfem::solver
 		if (!use_adaptive_barrier_stiffness())
 			return;
 
-		const Eigen::MatrixXd displaced_surface = compute_displaced_surface(x);
+		const Eigen::MatrixXd &displaced_surface = this->displaced_surface(x);
 
-		Eigen::VectorXd grad_barrier = ipc::compute_barrier_potential_gradient(
-			collision_mesh_, displaced_surface, constraint_set_, dhat_);
-		grad_barrier = collision_mesh_.to_full_dof(grad_barrier);
+		const Eigen::VectorXd grad_barrier = collision_mesh_.to_full_dof(surface_barrier_gradient(displaced_surface));
 
 		weight_ = ipc::initial_barrier_stiffness(
 			ipc::world_bbox_diagonal_length(displaced_surface), dhat_, avg_mass_,
@@ -106,49 +128,267 @@ namespace polyfem::solver
 		logger().debug("adaptive barrier form stiffness {}", barrier_stiffness());
 	}
 
-	void ContactForm::update_constraint_set(const Eigen::MatrixXd &displaced_surface)
+	void ContactForm::update_constraint_set(const Eigen::VectorXd &x)
 	{
-		// Store the previous value used to compute the constraint set to avoid duplicate computation.
-		static Eigen::MatrixXd cached_displaced_surface;
-		if (cached_displaced_surface.size() == displaced_surface.size() && cached_displaced_surface == displaced_surface)
+		// The constraint set only depends on the solution, avoid duplicate computation.
+		if (is_constraint_set_solution(x))
 			return;
 
+		const Eigen::MatrixXd &displaced_surface = this->displaced_surface(x);
 		if (use_cached_candidates_)
 			constraint_set_.build(
 				candidates_, collision_mesh_, displaced_surface, dhat_);
+		else if (update_persistent_candidates(displaced_surface))
+			constraint_set_.build(
+				persistent_candidates_, collision_mesh_, displaced_surface, dhat_);
 		else
 			constraint_set_.build(
 				collision_mesh_, displaced_surface, dhat_, /*dmin=*/0, broad_phase_method_);
-		cached_displaced_surface = displaced_surface;
+
+		constraint_set_x_ = x;
+		has_constraint_set_x_ = true;
+		has_barrier_potential_ = false;
+		has_barrier_gradient_ = false;
+		has_minimum_distance_ = false;
+	}
+
+	double ContactForm::minimum_distance(const Eigen::VectorXd &x) const
+	{
+		const bool at_constraint_set_solution = is_constraint_set_solution(x);
+		if (at_constraint_set_solution && has_minimum_distance_)
+			return minimum_distance_;
+
+		// only the active constraints are visited
+		const Eigen::MatrixXd &V = displaced_surface(x);
+		const double distance = std::min(ipc::compute_minimum_distance(collision_mesh_, V, constraint_set_), plane_minimum_distance(V));
+		if (at_constraint_set_solution)
+		{
+			minimum_distance_ = distance;
+			has_minimum_distance_ = true;
+		}
+		return distance;
+	}
+
+	bool ContactForm::persistent_candidates_cover(const Eigen::MatrixXd &V) const
+	{
+		// Every box moved by at most the margin in every direction, so the boxes inflated
+		// by dhat / 1.99 that overlap were overlapping when inflated by dhat / 1.99 + margin.
+		return has_persistent_candidates_
+			   && persistent_surface_.rows() == V.rows() && persistent_surface_.cols() == V.cols()
+			   && (V - persistent_surface_).lpNorm<Eigen::Infinity>() <= persistent_candidates_margin * dhat_;
+	}
+
+	bool ContactForm::update_persistent_candidates(const Eigen::MatrixXd &V)
+	{
+		if (persistent_candidates_margin <= 0)
+			return false;
+
+		if (!persistent_candidates_cover(V))
+		{
+			POLYFEM_SCOPED_TIMER("persistent broad phase");
+			ipc::construct_collision_candidates(
+				collision_mesh_, V, persistent_candidates_,
+				/*inflation_radius=*/dhat_ / 1.99 + persistent_candidates_margin * dhat_,
+				broad_phase_method_);
+			persistent_surface_ = V;
+			has_persistent_candidates_ = true;
+		}
+		return true;
 	}
 
 	double ContactForm::value_unweighted(const Eigen::VectorXd &x) const
 	{
-		return ipc::compute_barrier_potential(collision_mesh_, compute_displaced_surface(x), constraint_set_, dhat_);
+		const bool at_constraint_set_solution = is_constraint_set_solution(x);
+		if (at_constraint_set_solution && has_barrier_potential_)
+			return barrier_potential_;
+
+		const Eigen::MatrixXd &V = displaced_surface(x);
+		const double potential = ipc::compute_barrier_potential(collision_mesh_, V, constraint_set_, dhat_) + plane_potential(V);
+		if (at_constraint_set_solution)
+		{
+			barrier_potential_ = potential;
+			has_barrier_potential_ = true;
+		}
+		return potential;
 	}
 
 	void ContactForm::first_derivative_unweighted(const Eigen::VectorXd &x, Eigen::VectorXd &gradv) const
 	{
-		gradv = ipc::compute_barrier_potential_gradient(collision_mesh_, compute_displaced_surface(x), constraint_set_, dhat_);
-		gradv = collision_mesh_.to_full_dof(gradv);
+		gradv = collision_mesh_.to_full_dof(surface_gradient(x));
+	}
+
+	Eigen::VectorXd ContactForm::surface_gradient(const Eigen::VectorXd &x) const
+	{
+		const bool at_constraint_set_solution = is_constraint_set_solution(x);
+		if (at_constraint_set_solution && has_barrier_gradient_)
+			return barrier_gradient_;
+
+		Eigen::VectorXd grad = surface_barrier_gradient(displaced_surface(x));
+		if (at_constraint_set_solution)
+		{
+			barrier_gradient_ = grad;
+			has_barrier_gradient_ = true;
+		}
+		return grad;
+	}
+
+	Eigen::VectorXd ContactForm::surface_barrier_gradient(const Eigen::MatrixXd &V) const
+	{
+		Eigen::VectorXd grad = ipc::compute_barrier_potential_gradient(collision_mesh_, V, constraint_set_, dhat_);
+		add_plane_potential_gradient(V, grad);
+		return grad;
 	}
 
 	void ContactForm::second_derivative_unweighted(const Eigen::VectorXd &x, StiffnessMatrix &hessian) const
 	{
 		POLYFEM_SCOPED_TIMER("barrier hessian");
-		hessian = ipc::compute_barrier_potential_hessian(collision_mesh_, compute_displaced_surface(x), constraint_set_, dhat_, project_to_psd_);
-		hessian = collision_mesh_.to_full_dof(hessian);
+		const Eigen::MatrixXd &V = displaced_surface(x);
+		StiffnessMatrix surface_hessian = ipc::compute_barrier_potential_hessian(collision_mesh_, V, constraint_set_, dhat_, project_to_psd_);
+		if (!planes_.empty())
+		{
+			StiffnessMatrix plane_hessian;
+			plane_potential_hessian(V, plane_hessian);
+			surface_hessian += plane_hessian;
+		}
+		surface_hessian_to_full_dof(surface_hessian, hessian);
+	}
+
+	void ContactForm::set_planes(const std::vector<mesh::Obstacle::Plane> &planes, const std::vector<int> &plane_vertices)
+	{
+		assert(std::all_of(planes.begin(), planes.end(), [&](const auto &p) { return p.normal().size() == collision_mesh_.dim(); }));
+		planes_ = planes;
+		plane_vertices_ = plane_vertices;
+		has_barrier_potential_ = false;
+		has_barrier_gradient_ = false;
+		has_minimum_distance_ = false;
+	}
+
+	double ContactForm::plane_potential(const Eigen::MatrixXd &V) const
+	{
+		// the convergent formulation divides the barrier by dhat^2, see update_barrier_stiffness
+		const double scale = use_convergent_formulation() ? 1 / (dhat_ * dhat_) : 1;
+
+		double potential = 0;
+		for (const auto &plane : planes_)
+		{
+			for (const int vi : plane_vertices_)
+			{
+				const double d = plane.normal().dot(V.row(vi).transpose() - plane.point());
+				if (d <= 0)
+					return std::numeric_limits<double>::infinity();
+				if (d < dhat_)
+					potential += ipc::barrier(d * d, dhat_ * dhat_);
+			}
+		}
+		return scale * potential;
+	}
+
+	void ContactForm::add_plane_potential_gradient(const Eigen::MatrixXd &V, Eigen::VectorXd &grad) const
+	{
+		const double scale = use_convergent_formulation() ? 1 / (dhat_ * dhat_) : 1;
+		const int dim = V.cols();
+		assert(grad.size() == V.size());
+
+		for (const auto &plane : planes_)
+		{
+			for (const int vi : plane_vertices_)
+			{
+				const double d = plane.normal().dot(V.row(vi).transpose() - plane.point());
+				if (d <= 0 || d >= dhat_)
+					continue;
+				// d(d^2)/dv = 2 d n
+				grad.segment(vi * dim, dim) += scale * ipc::barrier_gradient(d * d, dhat_ * dhat_) * 2 * d * plane.normal();
+			}
+		}
+	}
+
+	void ContactForm::plane_potential_hessian(const Eigen::MatrixXd &V, StiffnessMatrix &hessian) const
+	{
+		const double scale = use_convergent_formulation() ? 1 / (dhat_ * dhat_) : 1;
+		const int dim = V.cols();
+
+		std::vector<Eigen::Triplet<double>> entries;
+		for (const auto &plane : planes_)
+		{
+			const VectorNd &n = plane.normal();
+			for (const int vi : plane_vertices_)
+			{
+				const double d = plane.normal().dot(V.row(vi).transpose() - plane.point());
+				if (d <= 0 || d >= dhat_)
+					continue;
+
+				// the Hessian is rank one along the normal, its projection clamps the coefficient
+				const double d2 = d * d;
+				double coeff = scale * (4 * d2 * ipc::barrier_hessian(d2, dhat_ * dhat_) + 2 * ipc::barrier_gradient(d2, dhat_ * dhat_));
+				if (project_to_psd_)
+					coeff = std::max(coeff, 0.0);
+
+				for (int i = 0; i < dim; ++i)
+					for (int j = 0; j < dim; ++j)
+						entries.emplace_back(vi * dim + i, vi * dim + j, coeff * n(i) * n(j));
+			}
+		}
+
+		hessian.resize(V.size(), V.size());
+		hessian.setFromTriplets(entries.begin(), entries.end());
+	}
+
+	double ContactForm::plane_collision_free_stepsize(const Eigen::MatrixXd &V0, const Eigen::MatrixXd &V1) const
+	{
+		// same margin as the conservative rescaling of the CCD
+		static constexpr double conservative_rescaling = 0.8;
+
+		double max_step = 1;
+		for (const auto &plane : planes_)
+		{
+			for (const int vi : plane_vertices_)
+			{
+				const double d0 = plane.normal().dot(V0.row(vi).transpose() - plane.point());
+				const double d1 = plane.normal().dot(V1.row(vi).transpose() - plane.point());
+				if (d1 > 0)
+					continue;
+				// the distance is linear in the step, stop at a fraction of the time of impact
+				max_step = std::min(max_step, std::max(0.0, conservative_rescaling * d0 / (d0 - d1)));
+			}
+		}
+		return max_step;
+	}
+
+	double ContactForm::plane_minimum_distance(const Eigen::MatrixXd &V) const
+	{
+		double min_distance = std::numeric_limits<double>::infinity();
+		for (const auto &plane : planes_)
+		{
+			for (const int vi : plane_vertices_)
+			{
+				const double d = std::max(0.0, plane.normal().dot(V.row(vi).transpose() - plane.point()));
+				min_distance = std::min(min_distance, d * d);
+			}
+		}
+		return min_distance;
+	}
+
+	void ContactForm::surface_hessian_to_full_dof(const StiffnessMatrix &surface_hessian, StiffnessMatrix &hessian) const
+	{
+		if (full_dof_map_.size() == 0)
+		{
+			hessian = collision_mesh_.to_full_dof(surface_hessian);
+			return;
+		}
+
+		assert(full_dof_map_.cols() == surface_hessian.rows());
+		utils::map_sparse_matrix(surface_hessian, full_dof_map_, hessian);
 	}
 
 	void ContactForm::solution_changed(const Eigen::VectorXd &new_x)
 	{
-		update_constraint_set(compute_displaced_surface(new_x));
+		update_constraint_set(new_x);
 	}
 
 	double ContactForm::max_step_size(const Eigen::VectorXd &x0, const Eigen::VectorXd &x1) const
 	{
 		// Extract surface only
-		const Eigen::MatrixXd V0 = compute_displaced_surface(x0);
+		const Eigen::MatrixXd &V0 = displaced_surface(x0);
 		const Eigen::MatrixXd V1 = compute_displaced_surface(x1);
 
 		if (save_ccd_debug_meshes)
@@ -161,11 +401,12 @@ namespace polyfem::solver
 
 		double max_step;
 		if (use_cached_candidates_ && broad_phase_method_ != ipc::BroadPhaseMethod::SWEEP_AND_TINIEST_QUEUE_GPU)
-			max_step = ipc::compute_collision_free_stepsize(
-				candidates_, collision_mesh_, V0, V1, ccd_tolerance_, ccd_max_iterations_);
+			max_step = compute_collision_free_stepsize(candidates_, V0, V1);
 		else
 			max_step = ipc::compute_collision_free_stepsize(
 				collision_mesh_, V0, V1, broad_phase_method_, ccd_tolerance_, ccd_max_iterations_);
+		if (!planes_.empty())
+			max_step = std::min(max_step, plane_collision_free_stepsize(V0, V1));
 
 #ifndef NDEBUG
 		// This will check for static intersections as a failsafe. Not needed if we use our conservative CCD.
@@ -189,13 +430,17 @@ namespace polyfem::solver
 
 	void ContactForm::line_search_begin(const Eigen::VectorXd &x0, const Eigen::VectorXd &x1)
 	{
-		ipc::construct_collision_candidates(
-			collision_mesh_,
-			compute_displaced_surface(x0),
-			compute_displaced_surface(x1),
-			candidates_,
-			/*inflation_radius=*/dhat_ / 1.99, // divide by 1.99 instead of 2 to be conservative
-			broad_phase_method_);
+		const Eigen::MatrixXd &V0 = displaced_surface(x0);
+		const Eigen::MatrixXd V1 = compute_displaced_surface(x1);
+
+		// the swept boxes are the boxes of the end positions, reuse the persistent candidates if both ends are covered
+		if (update_persistent_candidates(V0) && persistent_candidates_cover(V1))
+			candidates_ = persistent_candidates_;
+		else
+			ipc::construct_collision_candidates(
+				collision_mesh_, V0, V1, candidates_,
+				/*inflation_radius=*/dhat_ / 1.99, // divide by 1.99 instead of 2 to be conservative
+				broad_phase_method_);
 
 		use_cached_candidates_ = true;
 	}
@@ -208,19 +453,17 @@ namespace polyfem::solver
 
 	void ContactForm::post_step(const int iter_num, const Eigen::VectorXd &x)
 	{
-		const Eigen::MatrixXd displaced_surface = compute_displaced_surface(x);
-
-		const double curr_distance = ipc::compute_minimum_distance(collision_mesh_, displaced_surface, constraint_set_);
-
 		if (use_adaptive_barrier_stiffness_)
 		{
 			if (is_time_dependent_)
 			{
+				// the distance is only needed by the stiffness update, the bounding box is fixed per time step
+				const double curr_distance = minimum_distance(x);
 				const double prev_barrier_stiffness = barrier_stiffness();
 
 				weight_ = ipc::update_barrier_stiffness(
 					prev_distance_, curr_distance, max_barrier_stiffness_,
-					barrier_stiffness(), ipc::world_bbox_diagonal_length(displaced_surface));
+					barrier_stiffness(), world_bbox_diagonal_);
 
 				if (barrier_stiffness() != prev_barrier_stiffness)
 				{
@@ -228,6 +471,8 @@ namespace polyfem::solver
 						"updated barrier stiffness from {:g} to {:g}",
 						prev_barrier_stiffness, barrier_stiffness());
 				}
+
+				prev_distance_ = curr_distance;
 			}
 			else
 			{
@@ -235,13 +480,115 @@ namespace polyfem::solver
 				// update_barrier_stiffness(x);
 			}
 		}
+	}
 
-		prev_distance_ = curr_distance;
+	double ContactForm::compute_collision_free_stepsize(const ipc::Candidates &candidates, const Eigen::MatrixXd &V0, const Eigen::MatrixXd &V1) const
+	{
+		if (candidates.empty())
+			return 1;
+
+		const Eigen::MatrixXi &E = collision_mesh_.edges();
+		const Eigen::MatrixXi &F = collision_mesh_.faces();
+		const Eigen::VectorXd displacement = (V1 - V0).rowwise().norm();
+
+		// Lower bound of the time of impact of two primitives given by their vertices: the distance shrinks at most
+		// by the sum of the largest vertex displacements, the gap between the boxes is below the distance, and CCD
+		// stops at a fraction (1 - conservative rescaling = 20%) of the distance, so half the gap is still conservative.
+		const auto toi_lower_bound = [&](const auto &a, const int na, const auto &b, const int nb) {
+			double max_disp = 0, gap = 0;
+			for (int i = 0; i < na; ++i)
+				max_disp = std::max(max_disp, displacement(a[i]));
+			double max_disp_b = 0;
+			for (int i = 0; i < nb; ++i)
+				max_disp_b = std::max(max_disp_b, displacement(b[i]));
+			max_disp += max_disp_b;
+
+			for (int d = 0; d < V0.cols(); ++d)
+			{
+				double min_a = V0(a[0], d), max_a = min_a, min_b = V0(b[0], d), max_b = min_b;
+				for (int i = 1; i < na; ++i)
+				{
+					min_a = std::min(min_a, V0(a[i], d));
+					max_a = std::max(max_a, V0(a[i], d));
+				}
+				for (int i = 1; i < nb; ++i)
+				{
+					min_b = std::min(min_b, V0(b[i], d));
+					max_b = std::max(max_b, V0(b[i], d));
+				}
+				const double axis_gap = std::max({0.0, min_b - max_a, min_a - max_b});
+				gap += axis_gap * axis_gap;
+			}
+			gap = std::sqrt(gap);
+
+			if (gap == 0)
+				return 0.0;
+			return max_disp == 0 ? std::numeric_limits<double>::infinity() : 0.5 * gap / max_disp;
+		};
+
+		struct Query
+		{
+			double lower_bound;
+			const ipc::ContinuousCollisionCandidate *candidate;
+		};
+		std::vector<Query> queries;
+		queries.reserve(candidates.size());
+		for (const auto &c : candidates.ev_candidates)
+		{
+			const std::array<int, 2> e = {{E(c.edge_index, 0), E(c.edge_index, 1)}};
+			const std::array<int, 1> v = {{int(c.vertex_index)}};
+			queries.push_back({toi_lower_bound(e, 2, v, 1), &c});
+		}
+		for (const auto &c : candidates.ee_candidates)
+		{
+			const std::array<int, 2> e0 = {{E(c.edge0_index, 0), E(c.edge0_index, 1)}};
+			const std::array<int, 2> e1 = {{E(c.edge1_index, 0), E(c.edge1_index, 1)}};
+			queries.push_back({toi_lower_bound(e0, 2, e1, 2), &c});
+		}
+		for (const auto &c : candidates.fv_candidates)
+		{
+			const std::array<int, 3> f = {{F(c.face_index, 0), F(c.face_index, 1), F(c.face_index, 2)}};
+			const std::array<int, 1> v = {{int(c.vertex_index)}};
+			queries.push_back({toi_lower_bound(f, 3, v, 1), &c});
+		}
+
+		// queries that cannot hit before the end of the step are dropped before sorting
+		queries.erase(std::remove_if(queries.begin(), queries.end(), [](const Query &q) { return q.lower_bound >= 1; }), queries.end());
+		std::sort(queries.begin(), queries.end(), [](const Query &a, const Query &b) { return a.lower_bound < b.lower_bound; });
+
+		std::atomic<double> earliest_toi(1);
+		std::atomic<size_t> n_skipped(candidates.size() - queries.size());
+		utils::maybe_parallel_for(queries.size(), [&](int start, int end, int thread_id) {
+			for (int i = start; i < end; ++i)
+			{
+				// sorted, the remaining queries of this range cannot lower the minimum either
+				if (queries[i].lower_bound >= earliest_toi.load())
+				{
+					n_skipped += end - i;
+					break;
+				}
+
+				double toi = std::numeric_limits<double>::infinity();
+				const bool are_colliding = queries[i].candidate->ccd(
+					V0, V1, E, F, toi, /*tmax=*/earliest_toi.load(), ccd_tolerance_, ccd_max_iterations_);
+				if (!are_colliding)
+					continue;
+
+				double current = earliest_toi.load();
+				while (toi < current && !earliest_toi.compare_exchange_weak(current, toi))
+					;
+			}
+		});
+
+		logger().trace("CCD skipped {}/{} candidates", n_skipped.load(), candidates.size());
+
+		assert(earliest_toi >= 0 && earliest_toi <= 1);
+		return earliest_toi;
 	}
 
 	bool ContactForm::is_step_collision_free(const Eigen::VectorXd &x0, const Eigen::VectorXd &x1) const
 	{
-		const auto displaced0 = compute_displaced_surface(x0);
+		const Eigen::MatrixXd &displaced0 = displaced_surface(x0);
 		const auto displaced1 = compute_displaced_surface(x1);
 
 		// Skip CCD if the displacement is zero.
@@ -265,6 +612,21 @@ namespace polyfem::solver
 				displaced1,
 				broad_phase_method_, ccd_tolerance_, ccd_max_iterations_);
 
+		// the vertices stay in front of the planes iff their end positions do
+		for (const auto &plane : planes_)
+		{
+			if (!is_valid)
+				break;
+			for (const int vi : plane_vertices_)
+			{
+				if (plane.normal().dot(displaced1.row(vi).transpose() - plane.point()) <= 0)
+				{
+					is_valid = false;
+					break;
+				}
+			}
+		}
+
 		return is_valid;
 	}
 } // namespace polyfem::solver
@@ -3,6 +3,7 @@
 #include "Form.hpp"
 
 #include <polyfem/Common.hpp>
+#include <polyfem/mesh/Obstacle.hpp>
 #include <polyfem/utils/Types.hpp>
 
 #include <ipc/ipc.hpp>
@@ -124,11 +125,38 @@ namespace polyfem::solver
 		/// @param x Current solution
 		void update_barrier_stiffness(const Eigen::VectorXd &x, const Eigen::MatrixXd &grad_energy);
 
+		/// @brief Constraint set built for the solution x
+		/// @return nullptr if the current constraint set was built for another solution
+		const ipc::Constraints *constraint_set(const Eigen::VectorXd &x) const { return is_constraint_set_solution(x) ? &constraint_set_ : nullptr; }
+
+		/// @brief Unweighted barrier gradient wrt the collision mesh dofs, it is cached at the solution of the constraint set
+		/// @param x Current solution
+		Eigen::VectorXd surface_gradient(const Eigen::VectorXd &x) const;
+
 		inline bool use_adaptive_barrier_stiffness() const { return use_adaptive_barrier_stiffness_; }
 		inline bool use_convergent_formulation() const { return constraint_set_.use_convergent_formulation; }
 
 		bool save_ccd_debug_meshes = false; ///< If true, output debug files
 
+		/// @brief Set the map from the collision mesh dofs to the full dofs (see State::collision_mesh_dof_map)
+		void set_full_dof_map(const StiffnessMatrix &full_dof_map) { full_dof_map_ = full_dof_map; }
+
+		/// @brief Map a Hessian on the collision mesh dofs to the full dofs, in one pass if the map is set
+		/// @param[in] surface_hessian Hessian wrt the collision mesh dofs
+		/// @param[out] hessian Output full size Hessian
+		void surface_hessian_to_full_dof(const StiffnessMatrix &surface_hessian, StiffnessMatrix &hessian) const;
+
+		/// @brief Set the static plane obstacles, they are handled analytically instead of through the collision mesh.
+		/// The barrier of a vertex is the one of the vertex-face constraints evaluated at its distance to the plane,
+		/// and the CCD is the time the vertex crosses the plane, no broad phase is needed.
+		/// @param planes Plane obstacles, the vertices must stay on the side of their normal
+		/// @param plane_vertices Collision mesh vertices in contact with the planes (e.g., the non-obstacle ones)
+		void set_planes(const std::vector<mesh::Obstacle::Plane> &planes, const std::vector<int> &plane_vertices);
+
+		/// Extra inflation, relative to dhat, of the persistent broad-phase candidates.
+		/// They are reused while the surface stays within this distance from where they were built, 0 disables them.
+		double persistent_candidates_margin = 0;
+
 	private:
 		const ipc::CollisionMesh &collision_mesh_;
 
@@ -145,17 +173,80 @@ namespace polyfem::solver
 		const double ccd_tolerance_;                     ///< Continuous collision detection tolerance
 		const int ccd_max_iterations_;                   ///< Continuous collision detection maximum iterations
 
-		double prev_distance_; ///< Previous minimum distance between all elements
+		double prev_distance_;            ///< Previous minimum distance between all elements
+		double world_bbox_diagonal_ = -1; ///< Diagonal of the world bounding box, updated once per time step
 
 		bool use_cached_candidates_ = false; ///< If true, use the cached candidate set for the current solution
 		ipc::Constraints constraint_set_;    ///< Cached constraint set for the current solution
 		ipc::Candidates candidates_;         ///< Cached candidate set for the current solution
 
+		StiffnessMatrix full_dof_map_; ///< Map from the collision mesh dofs to the full dofs, empty to use CollisionMesh::to_full_dof
+
+		std::vector<mesh::Obstacle::Plane> planes_; ///< Static plane obstacles
+		std::vector<int> plane_vertices_;           ///< Collision mesh vertices in contact with the planes
+
+		/// @brief Barrier potential of the planes, it is zero beyond dhat and infinite behind a plane
+		double plane_potential(const Eigen::MatrixXd &V) const;
+
+		/// @brief Add the gradient of the plane potential wrt the collision mesh dofs to grad
+		void add_plane_potential_gradient(const Eigen::MatrixXd &V, Eigen::VectorXd &grad) const;
+
+		/// @brief Hessian of the plane potential wrt the collision mesh dofs, a dim x dim block per active vertex
+		void plane_potential_hessian(const Eigen::MatrixXd &V, StiffnessMatrix &hessian) const;
+
+		/// @brief Time of impact of the vertices with the planes, scaled by the conservative rescaling of the CCD
+		double plane_collision_free_stepsize(const Eigen::MatrixXd &V0, const Eigen::MatrixXd &V1) const;
+
+		/// @brief Smallest squared distance to the planes, as the constraint distances
+		double plane_minimum_distance(const Eigen::MatrixXd &V) const;
+
+		/// @brief Barrier gradient wrt the collision mesh dofs, of the constraint set and of the planes
+		Eigen::VectorXd surface_barrier_gradient(const Eigen::MatrixXd &V) const;
+
 		/// @brief Compute the displaced positions of the surface nodes
 		Eigen::MatrixXd compute_displaced_surface(const Eigen::VectorXd &x) const;
 
-		/// @brief Update the cached candidate set for the current solution
-		/// @param displaced_surface Vertex positions displaced by the current solution
-		void update_constraint_set(const Eigen::MatrixXd &displaced_surface);
+		/// @brief Displaced positions of the surface nodes, cached for the last solution it was called with
+		/// @param x Solution
+		/// @return Reference valid until the next call with a different solution
+		const Eigen::MatrixXd &displaced_surface(const Eigen::VectorXd &x) const;
+
+		/// @brief Check if the constraint set was built for the solution x
+		bool is_constraint_set_solution(const Eigen::VectorXd &x) const;
+
+		/// @brief Check if the persistent candidates contain all the candidates of the surface V
+		bool persistent_candidates_cover(const Eigen::MatrixXd &V) const;
+
+		/// @brief Make sure the persistent candidates cover V, rebuilding them around V if needed
+		/// @return False if the persistent candidates are disabled
+		bool update_persistent_candidates(const Eigen::MatrixXd &V);
+
+		/// @brief Earliest time of impact of the candidates between V0 and V1 (1 if there is none).
+		/// Candidates are processed in parallel by increasing conservative lower bound of their time of impact and
+		/// skipped once the bound is above the current minimum.
+		double compute_collision_free_stepsize(const ipc::Candidates &candidates, const Eigen::MatrixXd &V0, const Eigen::MatrixXd &V1) const;
+
+		/// @brief Minimum distance over the constraint set, memoized for the solution the constraint set was built for
+		double minimum_distance(const Eigen::VectorXd &x) const;
+
+		/// @brief Update the cached constraint set for the current solution, nothing is done if it was built for x
+		/// @param x Current solution
+		void update_constraint_set(const Eigen::VectorXd &x);
+
+		mutable Eigen::VectorXd displaced_surface_x_; ///< Solution of the cached displaced surface
+		mutable Eigen::MatrixXd displaced_surface_;   ///< Cached displaced surface
+		mutable bool has_displaced_surface_ = false;  ///< If true, displaced_surface_ is valid
+		Eigen::VectorXd constraint_set_x_;            ///< Solution the constraint set was built for
+		bool has_constraint_set_x_ = false;           ///< If true, constraint_set_x_ is valid
+		mutable double barrier_potential_;            ///< Barrier potential at constraint_set_x_
+		mutable bool has_barrier_potential_ = false;  ///< If true, barrier_potential_ is valid
+		mutable Eigen::VectorXd barrier_gradient_;    ///< Surface barrier gradient at constraint_set_x_
+		mutable bool has_barrier_gradient_ = false;   ///< If true, barrier_gradient_ is valid
+		mutable double minimum_distance_;             ///< Minimum distance at constraint_set_x_
+		mutable bool has_minimum_distance_ = false;   ///< If true, minimum_distance_ is valid
+
+		ipc::Candidates persistent_candidates_;  ///< Candidates inflated by the margin around persistent_surface_
+		Eigen::MatrixXd persistent_surface_;     ///< Surface the persistent candidates were built at
+		bool has_persistent_candidates_ = false; ///< If true, persistent_candidates_ is valid
 	};
 } // namespace polyfem::solver
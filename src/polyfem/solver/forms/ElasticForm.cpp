@@ -4,6 +4,8 @@
 
 #include <polyfem/utils/Timer.hpp>
 
+#include <cmath>
+
 namespace polyfem::solver
 {
 	ElasticForm::ElasticForm(const int n_bases,
@@ -25,10 +27,53 @@ namespace polyfem::solver
 			compute_cached_stiffness();
 	}
 
+	void ElasticForm::set_incremental_assembly(const bool enabled, const double tolerance)
+	{
+		incremental_assembly_ = enabled && !assembler_.is_linear();
+		local_hessian_cache_.set_tolerance(tolerance);
+		local_hessian_cache_.clear();
+	}
+
+	void ElasticForm::update_quantities(const double t, const Eigen::VectorXd &x)
+	{
+		x_prev_ = x;
+		last_energy_x_.resize(0);
+		// the local hessians of history dependent energies change with the previous solution,
+		// the ones of time dependent materials (e.g., E given as an expression of t) change with the time
+		if (assembler_.is_history_dependent() || (t != t_ && assembler_.has_time_dependent_parameters()))
+			local_hessian_cache_.clear();
+		t_ = t;
+	}
+
+	void ElasticForm::set_dt(const double dt)
+	{
+		if (dt != dt_ && assembler_.is_history_dependent())
+			local_hessian_cache_.clear();
+		if (dt != dt_)
+			last_energy_x_.resize(0);
+		dt_ = dt;
+	}
+
 	double ElasticForm::value_unweighted(const Eigen::VectorXd &x) const
 	{
-		return assembler_.assemble_energy(is_volume_, bases_, geom_bases_,
-										  ass_vals_cache_, dt_, x, x_prev_);
+		const double energy = assembler_.assemble_energy(is_volume_, bases_, geom_bases_,
+														 ass_vals_cache_, dt_, x, x_prev_);
+		set_last_energy(x, energy);
+		return energy;
+	}
+
+	void ElasticForm::set_last_energy(const Eigen::VectorXd &x, const double energy) const
+	{
+		last_energy_x_ = x;
+		last_energy_finite_ = std::isfinite(energy);
+	}
+
+	void ElasticForm::values_unweighted(const std::vector<Eigen::VectorXd> &xs, Eigen::VectorXd &vals)
+	{
+		// the elastic energy has no state updated by solution_changed
+		const std::vector<Eigen::MatrixXd> displacements(xs.begin(), xs.end());
+		vals = assembler_.assemble_energies(is_volume_, bases_, geom_bases_,
+											ass_vals_cache_, dt_, displacements, x_prev_);
 	}
 
 	void ElasticForm::first_derivative_unweighted(const Eigen::VectorXd &x, Eigen::VectorXd &gradv) const
@@ -53,27 +98,97 @@ namespace polyfem::solver
 		else
 		{
 			// NOTE: mat_cache_ is marked as mutable so we can modify it here
-			assembler_.assemble_hessian(
+			if (incremental_assembly_)
+				assembler_.assemble_hessian_incremental(
+					is_volume_, n_bases_, project_to_psd_, bases_,
+					geom_bases_, ass_vals_cache_, dt_, x, x_prev_, mat_cache_, local_hessian_cache_, hessian);
+			else
+				assembler_.assemble_hessian(
+					is_volume_, n_bases_, project_to_psd_, bases_,
+					geom_bases_, ass_vals_cache_, dt_, x, x_prev_, mat_cache_, hessian);
+		}
+	}
+
+	void ElasticForm::value_and_derivatives_unweighted(const Eigen::VectorXd &x, double *value, Eigen::VectorXd *gradv, StiffnessMatrix *hessian) const
+	{
+		POLYFEM_SCOPED_TIMER("elastic value and derivatives");
+
+		// the stiffness of linear elasticity is cached, only the energy and gradient are assembled
+		StiffnessMatrix *assembled_hessian = hessian;
+		if (hessian && assembler_.is_linear())
+		{
+			assert(cached_stiffness_.rows() == x.size() && cached_stiffness_.cols() == x.size());
+			*hessian = cached_stiffness_;
+			assembled_hessian = nullptr;
+		}
+		// the incremental hessian only evaluates the elements that moved, it is not fused with the energy and gradient
+		else if (hessian && incremental_assembly_)
+		{
+			second_derivative_unweighted(x, *hessian);
+			assembled_hessian = nullptr;
+		}
+
+		Eigen::MatrixXd grad;
+		// NOTE: mat_cache_ is marked as mutable so we can modify it here
+		assembler_.assemble_energy_gradient_hessian(
+			is_volume_, n_bases_, project_to_psd_, bases_, geom_bases_, ass_vals_cache_, dt_, x, x_prev_,
+			mat_cache_, value, gradv ? &grad : nullptr, assembled_hessian);
+
+		if (value)
+			set_last_energy(x, *value);
+		if (gradv)
+			*gradv = grad;
+	}
+
+	void ElasticForm::hessian_vector_product_unweighted(const Eigen::VectorXd &x, const Eigen::VectorXd &v, Eigen::VectorXd &out) const
+	{
+		POLYFEM_SCOPED_TIMER("elastic hessian vector product");
+
+		if (assembler_.is_linear())
+		{
+			assert(cached_stiffness_.rows() == x.size() && cached_stiffness_.cols() == x.size());
+			out = cached_stiffness_ * v;
+		}
+		else
+		{
+			Eigen::MatrixXd tmp;
+			assembler_.assemble_hessian_vector_product(
+				is_volume_, n_bases_, project_to_psd_, bases_,
+				geom_bases_, ass_vals_cache_, dt_, x, x_prev_, v, tmp);
+			out = tmp;
+		}
+	}
+
+	void ElasticForm::hessian_diagonal_unweighted(const Eigen::VectorXd &x, Eigen::VectorXd &diag) const
+	{
+		if (assembler_.is_linear())
+		{
+			assert(cached_stiffness_.rows() == x.size() && cached_stiffness_.cols() == x.size());
+			diag = cached_stiffness_.diagonal();
+		}
+		else
+		{
+			Eigen::MatrixXd tmp;
+			assembler_.assemble_hessian_diagonal(
 				is_volume_, n_bases_, project_to_psd_, bases_,
-				geom_bases_, ass_vals_cache_, dt_, x, x_prev_, mat_cache_, hessian);
+				geom_bases_, ass_vals_cache_, dt_, x, x_prev_, tmp);
+			diag = tmp;
 		}
 	}
 
 	bool ElasticForm::is_step_valid(const Eigen::VectorXd &, const Eigen::VectorXd &x1) const
 	{
-		Eigen::VectorXd grad;
-		first_derivative(x1, grad);
-
-		if (grad.array().isNaN().any())
-			return false;
-
-		// Check the scalar field in the output does not contain NANs.
-		// WARNING: Does not work because the energy is not evaluated at the same quadrature points.
-		//          This causes small step lengths in the LS.
-		// TVector x1_full;
-		// reduced_to_full(x1, x1_full);
-		// return state_.check_scalar_value(x1_full, true, false);
-		return true;
+		// the energy and gradient of linear elasticity are finite for any finite displacement
+		if (assembler_.is_linear())
+			return x1.allFinite();
+
+		// the line search evaluates the energy at x1 right before, a non finite element energy is an invalid step
+		// (e.g., an inverted element for the energies with a log barrier on det(F))
+		if (last_energy_x_.size() == x1.size() && last_energy_x_ == x1)
+			return last_energy_finite_;
+
+		return assembler_.is_energy_finite(is_volume_, bases_, geom_bases_,
+										   ass_vals_cache_, dt_, x1, x_prev_);
 	}
 
 	void ElasticForm::compute_cached_stiffness()
@@ -30,6 +30,11 @@ namespace polyfem::solver
 		/// @return Value of the elastic potential
 		double value_unweighted(const Eigen::VectorXd &x) const override;
 
+		/// @brief Compute the elastic energy at several solutions in a single element loop
+		/// @param[in] xs Solutions
+		/// @param[out] vals Computed energies, one per solution
+		void values_unweighted(const std::vector<Eigen::VectorXd> &xs, Eigen::VectorXd &vals) override;
+
 		/// @brief Compute the first derivative of the value wrt x
 		/// @param[in] x Current solution
 		/// @param[out] gradv Output gradient of the value wrt x
@@ -40,7 +45,27 @@ namespace polyfem::solver
 		/// @param[out] hessian Output Hessian of the value wrt x
 		void second_derivative_unweighted(const Eigen::VectorXd &x, StiffnessMatrix &hessian) const override;
 
+		/// @brief Compute the elastic energy and its derivatives in a single element loop
+		/// @param[in] x Current solution
+		/// @param[out] value Output value, skipped if null
+		/// @param[out] gradv Output gradient of the value wrt x, skipped if null
+		/// @param[out] hessian Output Hessian of the value wrt x, skipped if null
+		void value_and_derivatives_unweighted(const Eigen::VectorXd &x, double *value, Eigen::VectorXd *gradv, StiffnessMatrix *hessian) const override;
+
+		/// @brief Compute the product of the second derivative wrt x with v, element by element without assembly
+		/// @param[in] x Current solution
+		/// @param[in] v Vector to multiply
+		/// @param[out] out Output product of the Hessian with v
+		void hessian_vector_product_unweighted(const Eigen::VectorXd &x, const Eigen::VectorXd &v, Eigen::VectorXd &out) const override;
+
+		/// @brief Compute the diagonal of the second derivative wrt x, element by element without assembly
+		/// @param[in] x Current solution
+		/// @param[out] diag Output diagonal of the Hessian
+		void hessian_diagonal_unweighted(const Eigen::VectorXd &x, Eigen::VectorXd &diag) const override;
+
 	public:
+		bool has_matrix_free_hessian() const override { return true; }
+
 		/// @brief Determine if a step from solution x0 to solution x1 is allowed
 		/// @param x0 Current solution
 		/// @param x1 Proposed next solution
@@ -50,24 +75,48 @@ namespace polyfem::solver
 		/// @brief Update time-dependent fields
 		/// @param t Current time
 		/// @param x Current solution at time t
-		void update_quantities(const double t, const Eigen::VectorXd &x) override { x_prev_ = x; }
+		void update_quantities(const double t, const Eigen::VectorXd &x) override;
+
+		/// @brief Set the time step size
+		/// @param dt New time step size
+		void set_dt(const double dt);
+
+		/// @brief Reuse the local Hessians of the elements whose nodes moved less than tolerance since they were computed
+		/// @param enabled If false, every Hessian assembly evaluates all the elements
+		/// @param tolerance Largest nodal displacement change of an element reusing its local Hessian
+		void set_incremental_assembly(const bool enabled, const double tolerance);
+
+		/// @brief Local Hessians of the incremental assembly, with the number of elements reused by the last assembly
+		const assembler::LocalHessianCache &local_hessian_cache() const { return local_hessian_cache_; }
 
 	private:
+		friend class ElementSweep; ///< evaluates the forms sharing the element loop together
+
 		const int n_bases_;
 		const std::vector<basis::ElementBases> &bases_;
 		const std::vector<basis::ElementBases> &geom_bases_;
 
 		const assembler::Assembler &assembler_; ///< Reference to the assembler
 		const assembler::AssemblyValsCache &ass_vals_cache_;
-		const double dt_;
+		double dt_;
 		const bool is_volume_;
 
 		StiffnessMatrix cached_stiffness_;           ///< Cached stiffness matrix for linear elasticity
 		mutable utils::SparseMatrixCache mat_cache_; ///< Matrix cache (mutable because it is modified in second_derivative_unweighted)
 
+		bool incremental_assembly_ = false;                       ///< Reuse the local Hessians of the elements that did not move
+		mutable assembler::LocalHessianCache local_hessian_cache_; ///< Local Hessians (mutable because it is modified in second_derivative_unweighted)
+		double t_ = 0;                                             ///< Time of the local Hessians, see update_quantities
+
 		/// @brief Compute the stiffness matrix (cached)
 		void compute_cached_stiffness();
 
+		/// @brief Record the point of the last energy evaluation, is_step_valid reuses it
+		void set_last_energy(const Eigen::VectorXd &x, const double energy) const;
+
+		mutable Eigen::VectorXd last_energy_x_; ///< Point of the last energy evaluation
+		mutable bool last_energy_finite_ = true; ///< The energy at last_energy_x_ is finite
+
 		Eigen::VectorXd x_prev_;
 	};
 } // namespace polyfem::solver
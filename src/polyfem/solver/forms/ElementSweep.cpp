@@ -0,0 +1,112 @@
+#include "ElementSweep.hpp"
+
+#include <polyfem/utils/Timer.hpp>
+
+namespace polyfem::solver
+{
+	namespace
+	{
+		const assembler::NLAssembler *nonlinear_assembler(const assembler::Assembler &assembler)
+		{
+			if (assembler.is_linear())
+				return nullptr;
+			return dynamic_cast<const assembler::NLAssembler *>(&assembler);
+		}
+	} // namespace
+
+	bool ElementSweep::add(const std::shared_ptr<ElasticForm> &form)
+	{
+		if (form == nullptr || nonlinear_assembler(form->assembler_) == nullptr)
+			return false;
+
+		if (!forms_.empty())
+		{
+			const ElasticForm &first = *forms_.front();
+			if (&form->bases_ != &first.bases_ || &form->geom_bases_ != &first.geom_bases_
+				|| &form->ass_vals_cache_ != &first.ass_vals_cache_ || form->is_volume_ != first.is_volume_
+				|| form->n_bases_ != first.n_bases_ || form->assembler_.size() != first.assembler_.size())
+				return false;
+		}
+
+		forms_.push_back(form);
+		return true;
+	}
+
+	bool ElementSweep::contains(const Form *form) const
+	{
+		for (const auto &f : forms_)
+			if (f.get() == form)
+				return true;
+		return false;
+	}
+
+	bool ElementSweep::is_active() const
+	{
+		int n_enabled = 0;
+		for (const auto &f : forms_)
+			if (f->enabled())
+				++n_enabled;
+		return n_enabled > 1;
+	}
+
+	std::vector<const ElasticForm *> ElementSweep::enabled_forms(std::vector<Eigen::MatrixXd> &prevs, std::vector<assembler::NLAssembler::FusedTerm> &terms) const
+	{
+		std::vector<const ElasticForm *> forms;
+		for (const auto &f : forms_)
+			if (f->enabled())
+				forms.push_back(f.get());
+
+		// the terms point to prevs, it is not resized afterwards
+		prevs.resize(forms.size());
+		terms.resize(forms.size());
+		for (size_t i = 0; i < forms.size(); ++i)
+		{
+			prevs[i] = forms[i]->x_prev_;
+			terms[i] = {nonlinear_assembler(forms[i]->assembler_), forms[i]->weight(), forms[i]->dt_, &prevs[i]};
+		}
+		return forms;
+	}
+
+	double ElementSweep::value(const Eigen::VectorXd &x) const
+	{
+		POLYFEM_SCOPED_TIMER("fused elastic energy");
+
+		std::vector<Eigen::MatrixXd> prevs;
+		std::vector<assembler::NLAssembler::FusedTerm> terms;
+		const std::vector<const ElasticForm *> forms = enabled_forms(prevs, terms);
+		if (forms.empty())
+			return 0;
+
+		const ElasticForm &first = *forms.front();
+		const Eigen::VectorXd energies = assembler::NLAssembler::assemble_fused_energies(
+			terms, first.is_volume_, first.bases_, first.geom_bases_, first.ass_vals_cache_, x);
+
+		double val = 0;
+		for (size_t i = 0; i < forms.size(); ++i)
+		{
+			forms[i]->set_last_energy(x, energies(i));
+			val += terms[i].weight * energies(i);
+		}
+		return val;
+	}
+
+	void ElementSweep::first_derivative(const Eigen::VectorXd &x, Eigen::VectorXd &gradv) const
+	{
+		POLYFEM_SCOPED_TIMER("fused elastic gradient");
+
+		std::vector<Eigen::MatrixXd> prevs;
+		std::vector<assembler::NLAssembler::FusedTerm> terms;
+		const std::vector<const ElasticForm *> forms = enabled_forms(prevs, terms);
+		if (forms.empty())
+		{
+			gradv.setZero(x.size());
+			return;
+		}
+
+		const ElasticForm &first = *forms.front();
+		Eigen::MatrixXd grad;
+		assembler::NLAssembler::assemble_fused_gradient(
+			terms, first.is_volume_, first.n_bases_, first.bases_, first.geom_bases_, first.ass_vals_cache_, x, grad);
+		gradv = grad;
+	}
+} // namespace polyfem::solver
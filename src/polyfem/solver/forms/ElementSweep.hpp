@@ -0,0 +1,42 @@
+#pragma once
+
+#include <polyfem/solver/forms/ElasticForm.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace polyfem::solver
+{
+	/// Elastic forms sharing an element loop (e.g., the elasticity and the viscous damping): their energies and gradients
+	/// are evaluated in a single sweep over the elements, which computes the assembly values of an element once for all of them.
+	class ElementSweep
+	{
+	public:
+		/// @brief Register the form if it can share the sweep of the registered ones
+		/// (same bases and assembly values cache and a non-linear assembler)
+		/// @param form Form to register
+		/// @return True if the form was registered
+		bool add(const std::shared_ptr<ElasticForm> &form);
+
+		/// @brief Check if the form is registered
+		bool contains(const Form *form) const;
+
+		/// @brief Check if the sweep evaluates the registered forms, which requires at least two of them enabled
+		bool is_active() const;
+
+		/// @brief Compute the sum of the weighted values of the enabled registered forms
+		/// @param x Current solution
+		double value(const Eigen::VectorXd &x) const;
+
+		/// @brief Compute the sum of the weighted gradients of the enabled registered forms
+		/// @param[in] x Current solution
+		/// @param[out] gradv Output gradient
+		void first_derivative(const Eigen::VectorXd &x, Eigen::VectorXd &gradv) const;
+
+	private:
+		/// @brief Enabled forms and the terms of their fused loop, prevs stores the previous solutions of the terms
+		std::vector<const ElasticForm *> enabled_forms(std::vector<Eigen::MatrixXd> &prevs, std::vector<assembler::NLAssembler::FusedTerm> &terms) const;
+
+		std::vector<std::shared_ptr<ElasticForm>> forms_;
+	};
+} // namespace polyfem::solver
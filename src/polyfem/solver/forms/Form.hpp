@@ -3,6 +3,7 @@
 #include <polyfem/utils/Types.hpp>
 
 #include <filesystem>
+#include <vector>
 
 namespace polyfem::solver
 {
@@ -23,6 +24,16 @@ namespace polyfem::solver
 			return weight_ * value_unweighted(x);
 		}
 
+		/// @brief Compute the values of the form at several solutions multiplied with the weigth
+		/// @note The cached fields are left for the last solution, call solution_changed before using the form again
+		/// @param[in] xs Solutions
+		/// @param[out] vals Computed values, one per solution
+		inline void values(const std::vector<Eigen::VectorXd> &xs, Eigen::VectorXd &vals)
+		{
+			values_unweighted(xs, vals);
+			vals *= weight_;
+		}
+
 		/// @brief Compute the first derivative of the value wrt x multiplied with the weigth
 		/// @param[in] x Current solution
 		/// @param[out] gradv Output gradient of the value wrt x
@@ -42,6 +53,49 @@ namespace polyfem::solver
 			hessian *= weight_;
 		}
 
+		/// @brief Compute the value and the first and second derivatives at the same solution multiplied with the weigth
+		/// @param[in] x Current solution
+		/// @param[out] value Output value, skipped if null
+		/// @param[out] gradv Output gradient of the value wrt x, skipped if null
+		/// @param[out] hessian Output Hessian of the value wrt x, skipped if null
+		inline void value_and_derivatives(const Eigen::VectorXd &x, double *value, Eigen::VectorXd *gradv, StiffnessMatrix *hessian) const
+		{
+			value_and_derivatives_unweighted(x, value, gradv, hessian);
+			if (value)
+				*value *= weight_;
+			if (gradv)
+				*gradv *= weight_;
+			if (hessian)
+				*hessian *= weight_;
+		}
+
+		/// @brief Compute the product of the second derivative wrt x with v multiplied with the weigth
+		/// @param[in] x Current solution
+		/// @param[in] v Vector to multiply
+		/// @param[out] out Output product of the Hessian with v
+		inline void hessian_vector_product(const Eigen::VectorXd &x, const Eigen::VectorXd &v, Eigen::VectorXd &out) const
+		{
+			hessian_vector_product_unweighted(x, v, out);
+			out *= weight_;
+		}
+
+		/// @brief Compute the diagonal of the second derivative wrt x multiplied with the weigth
+		/// @param[in] x Current solution
+		/// @param[out] diag Output diagonal of the Hessian
+		inline void hessian_diagonal(const Eigen::VectorXd &x, Eigen::VectorXd &diag) const
+		{
+			hessian_diagonal_unweighted(x, diag);
+			diag *= weight_;
+		}
+
+		/// @brief Determine if the form computes Hessian-vector products without assembling the Hessian
+		virtual bool has_matrix_free_hessian() const { return false; }
+
+		/// @brief Get the Hessian of the form if it does not depend on the solution, so it can be summed without a copy
+		/// @param[out] scale Factor such that the unweighted Hessian is scale times the returned matrix
+		/// @return Compressed constant matrix, nullptr if the form has to be differentiated at x
+		virtual const StiffnessMatrix *constant_hessian(double &scale) const { return nullptr; }
+
 		/// @brief Determine if a step from solution x0 to solution x1 is allowed
 		/// @param x0 Current solution
 		/// @param x1 Proposed next solution
@@ -151,6 +205,19 @@ namespace polyfem::solver
 		/// @return Computed value
 		virtual double value_unweighted(const Eigen::VectorXd &x) const = 0;
 
+		/// @brief Compute the values of the form at several solutions, one solution_changed and value per solution by default
+		/// @param[in] xs Solutions
+		/// @param[out] vals Computed values, one per solution
+		virtual void values_unweighted(const std::vector<Eigen::VectorXd> &xs, Eigen::VectorXd &vals)
+		{
+			vals.resize(xs.size());
+			for (size_t k = 0; k < xs.size(); ++k)
+			{
+				solution_changed(xs[k]);
+				vals[k] = value_unweighted(xs[k]);
+			}
+		}
+
 		/// @brief Compute the first derivative of the value wrt x
 		/// @param[in] x Current solution
 		/// @param[out] gradv Output gradient of the value wrt x
@@ -160,5 +227,41 @@ namespace polyfem::solver
 		/// @param[in] x Current solution
 		/// @param[out] hessian Output Hessian of the value wrt x
 		virtual void second_derivative_unweighted(const Eigen::VectorXd &x, StiffnessMatrix &hessian) const = 0;
+
+		/// @brief Compute the value and the derivatives wrt x, one after the other by default
+		/// @param[in] x Current solution
+		/// @param[out] value Output value, skipped if null
+		/// @param[out] gradv Output gradient of the value wrt x, skipped if null
+		/// @param[out] hessian Output Hessian of the value wrt x, skipped if null
+		virtual void value_and_derivatives_unweighted(const Eigen::VectorXd &x, double *value, Eigen::VectorXd *gradv, StiffnessMatrix *hessian) const
+		{
+			if (value)
+				*value = value_unweighted(x);
+			if (gradv)
+				first_derivative_unweighted(x, *gradv);
+			if (hessian)
+				second_derivative_unweighted(x, *hessian);
+		}
+
+		/// @brief Compute the product of the second derivative wrt x with v, assembles the Hessian by default
+		/// @param[in] x Current solution
+		/// @param[in] v Vector to multiply
+		/// @param[out] out Output product of the Hessian with v
+		virtual void hessian_vector_product_unweighted(const Eigen::VectorXd &x, const Eigen::VectorXd &v, Eigen::VectorXd &out) const
+		{
+			StiffnessMatrix hessian;
+			second_derivative_unweighted(x, hessian);
+			out = hessian * v;
+		}
+
+		/// @brief Compute the diagonal of the second derivative wrt x, assembles the Hessian by default
+		/// @param[in] x Current solution
+		/// @param[out] diag Output diagonal of the Hessian
+		virtual void hessian_diagonal_unweighted(const Eigen::VectorXd &x, Eigen::VectorXd &diag) const
+		{
+			StiffnessMatrix hessian;
+			second_derivative_unweighted(x, hessian);
+			diag = hessian.diagonal();
+		}
 	};
 } // namespace polyfem::solver
@@ -59,11 +59,11 @@ namespace polyfem::solver
 		assert(displaced_surface_prev_.rows() == collision_mesh_.num_vertices());
 		assert(displaced_surface_prev_.cols() == collision_mesh_.dim());
 
-		hessian = ipc::compute_friction_potential_hessian(
+		const StiffnessMatrix surface_hessian = ipc::compute_friction_potential_hessian(
 			collision_mesh_, displaced_surface_prev_, compute_displaced_surface(x),
 			friction_constraint_set_, epsv_ * dt_, project_to_psd_);
 
-		hessian = collision_mesh_.to_full_dof(hessian);
+		contact_form_.surface_hessian_to_full_dof(surface_hessian, hessian);
 	}
 
 	// TODO: handle lagging with more than one step
@@ -75,16 +75,31 @@ namespace polyfem::solver
 
 	void FrictionForm::update_lagging(const Eigen::VectorXd &x, const int iter_num)
 	{
+		// the friction constraints only depend on the solution and the barrier stiffness
+		if (has_lagged_x_ && lagged_barrier_stiffness_ == contact_form_.barrier_stiffness()
+			&& lagged_x_.size() == x.size() && lagged_x_ == x)
+			return;
+
 		const Eigen::MatrixXd displaced_surface = compute_displaced_surface(x);
 
+		// reuse the contact constraint set if it was built at x, it is the same set
 		ipc::Constraints constraint_set;
-		constraint_set.use_convergent_formulation = contact_form_.use_convergent_formulation();
-		constraint_set.build(
-			collision_mesh_, displaced_surface, dhat_,
-			/*dmin=*/0, broad_phase_method_);
+		const ipc::Constraints *contact_constraint_set = contact_form_.constraint_set(x);
+		if (contact_constraint_set == nullptr)
+		{
+			constraint_set.use_convergent_formulation = contact_form_.use_convergent_formulation();
+			constraint_set.build(
+				collision_mesh_, displaced_surface, dhat_,
+				/*dmin=*/0, broad_phase_method_);
+			contact_constraint_set = &constraint_set;
+		}
 
 		ipc::construct_friction_constraint_set(
-			collision_mesh_, displaced_surface, constraint_set,
+			collision_mesh_, displaced_surface, *contact_constraint_set,
 			dhat_, contact_form_.barrier_stiffness(), mu_, friction_constraint_set_);
+
+		lagged_x_ = x;
+		lagged_barrier_stiffness_ = contact_form_.barrier_stiffness();
+		has_lagged_x_ = true;
 	}
 } // namespace polyfem::solver
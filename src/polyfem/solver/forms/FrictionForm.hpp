@@ -73,12 +73,25 @@ namespace polyfem::solver
 
 		const Eigen::MatrixXd &displaced_surface_prev() const { return displaced_surface_prev_; }
 
+		/// @brief Lagged friction constraint set if it was built at x with the barrier stiffness
+		/// @return nullptr if the lagged set was built for another solution or barrier stiffness
+		const ipc::FrictionConstraints *friction_constraint_set(const Eigen::VectorXd &x, const double barrier_stiffness) const
+		{
+			if (has_lagged_x_ && lagged_barrier_stiffness_ == barrier_stiffness && lagged_x_.size() == x.size() && lagged_x_ == x)
+				return &friction_constraint_set_;
+			return nullptr;
+		}
+
+		/// @brief Set the time step size
+		/// @param dt New time step size
+		void set_dt(const double dt) { dt_ = dt; }
+
 	private:
 		const ipc::CollisionMesh &collision_mesh_;
 
 		const double epsv_;                              ///< Smoothing factor between static and dynamic friction
 		const double mu_;                                ///< Global coefficient of friction
-		const double dt_;                                ///< Time step size
+		double dt_;                                      ///< Time step size
 		const double dhat_;                              ///< Barrier activation distance
 		const ipc::BroadPhaseMethod broad_phase_method_; ///< Broad-phase method used for distance computation and collision detection
 		const int n_lagging_iters_;                      ///< Number of lagging iterations
@@ -86,6 +99,10 @@ namespace polyfem::solver
 		ipc::FrictionConstraints friction_constraint_set_; ///< Lagged friction constraint set
 		Eigen::MatrixXd displaced_surface_prev_;           ///< Displaced vertices at the start of the time-step.
 
+		Eigen::VectorXd lagged_x_;             ///< Solution the friction constraint set was built at
+		double lagged_barrier_stiffness_ = -1; ///< Barrier stiffness the friction constraint set was built with
+		bool has_lagged_x_ = false;            ///< If true, lagged_x_ is valid
+
 		/// @brief Compute the displaced positions of the surface nodes
 		Eigen::MatrixXd compute_displaced_surface(const Eigen::VectorXd &x) const;
 
@@ -13,20 +13,31 @@ namespace polyfem::solver
 
 	double InertiaForm::value_unweighted(const Eigen::VectorXd &x) const
 	{
-		const Eigen::VectorXd tmp = x - time_integrator_.x_tilde();
+		time_integrator_.x_tilde(diff_);
+		diff_ = x - diff_;
 		// FIXME: DBC on x tilde
-		const double prod = tmp.transpose() * mass_ * tmp;
+		const double prod = diff_.transpose() * mass_ * diff_;
 		const double energy = 0.5 * prod;
 		return energy;
 	}
 
 	void InertiaForm::first_derivative_unweighted(const Eigen::VectorXd &x, Eigen::VectorXd &gradv) const
 	{
-		gradv = mass_ * (x - time_integrator_.x_tilde());
+		time_integrator_.x_tilde(diff_);
+		diff_ = x - diff_;
+		gradv = mass_ * diff_;
 	}
 
 	void InertiaForm::second_derivative_unweighted(const Eigen::VectorXd &x, StiffnessMatrix &hessian) const
 	{
 		hessian = mass_;
 	}
+
+	const StiffnessMatrix *InertiaForm::constant_hessian(double &scale) const
+	{
+		if (!mass_.isCompressed())
+			return nullptr;
+		scale = 1;
+		return &mass_;
+	}
 } // namespace polyfem::solver
@@ -33,8 +33,16 @@ namespace polyfem::solver
 		/// @param[out] hessian Output Hessian of the value wrt x
 		void second_derivative_unweighted(const Eigen::VectorXd &x, StiffnessMatrix &hessian) const override;
 
+	public:
+		/// @brief The Hessian is the mass matrix
+		/// @param[out] scale Factor of the mass matrix
+		/// @return Mass matrix, nullptr if it is not compressed
+		const StiffnessMatrix *constant_hessian(double &scale) const override;
+
 	private:
 		const StiffnessMatrix &mass_;                                    ///< Mass matrix
 		const time_integrator::ImplicitTimeIntegrator &time_integrator_; ///< Time integrator
+
+		mutable Eigen::VectorXd diff_; ///< Storage for x - x_tilde reused between evaluations
 	};
 } // namespace polyfem::solver
@@ -25,8 +25,12 @@ namespace polyfem::solver
 
 	void LaggedRegForm::second_derivative_unweighted(const Eigen::VectorXd &x, StiffnessMatrix &hessian) const
 	{
-		hessian.resize(x.size(), x.size());
-		hessian.setIdentity();
+		if (hessian_.rows() != x.size())
+		{
+			hessian_.resize(x.size(), x.size());
+			hessian_.setIdentity();
+		}
+		hessian = hessian_;
 	}
 
 	void LaggedRegForm::init_lagging(const Eigen::VectorXd &x)
@@ -46,5 +46,6 @@ namespace polyfem::solver
 	private:
 		int n_lagging_iters_;      ///< Number of iterations to lag for
 		Eigen::VectorXd x_lagged_; ///< The full variables from the previous lagging solve.
+		mutable StiffnessMatrix hessian_; ///< Identity Hessian, built once and reused by every Newton iteration
 	};
 } // namespace polyfem::solver
@@ -59,6 +59,14 @@ namespace polyfem::solver
 		hessian = (stiffness() * time_integrator_.dv_dx()) * lagged_stiffness_matrix_;
 	}
 
+	const StiffnessMatrix *RayleighDampingForm::constant_hessian(double &scale) const
+	{
+		if (lagged_stiffness_matrix_.size() == 0 || !lagged_stiffness_matrix_.isCompressed())
+			return nullptr;
+		scale = stiffness() * time_integrator_.dv_dx();
+		return &lagged_stiffness_matrix_;
+	}
+
 	void RayleighDampingForm::init_lagging(const Eigen::VectorXd &x)
 	{
 		update_lagging(x, 0);
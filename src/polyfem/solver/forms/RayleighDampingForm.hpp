@@ -58,6 +58,11 @@ namespace polyfem::solver
 		/// @return True if the form requires lagging
 		bool uses_lagging() const override { return true; }
 
+		/// @brief The Hessian is the lagged stiffness matrix, constant until the next lagging update
+		/// @param[out] scale Factor of the lagged stiffness matrix
+		/// @return Lagged stiffness matrix, nullptr if it is not initialized
+		const StiffnessMatrix *constant_hessian(double &scale) const override;
+
 		/// @brief Get the stiffness of the form
 		double stiffness() const;
 
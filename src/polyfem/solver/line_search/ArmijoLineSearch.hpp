@@ -4,6 +4,8 @@
 
 #include <polyfem/utils/Timer.hpp>
 
+#include <vector>
+
 namespace polyfem
 {
 	namespace solver
@@ -100,6 +102,33 @@ namespace polyfem
 
 						while ((std::isinf(f) || std::isnan(f) || f > f_in + alpha * Cache || !valid) && alpha > this->min_step_size && this->cur_iter <= this->max_step_size_iter)
 						{
+							if (this->batch_size > 1 && !use_grad_norm)
+							{
+								// evaluate the next reductions at once, stopping after the first one below the minimum
+								std::vector<double> steps;
+								for (double a = alpha * tau; int(steps.size()) < this->batch_size
+															 && this->cur_iter + int(steps.size()) <= this->max_step_size_iter;
+									 a *= tau)
+								{
+									steps.push_back(a);
+									if (a <= this->min_step_size)
+										break;
+								}
+
+								Eigen::VectorXd energies;
+								const int accepted = this->find_batched_step_size(
+									x, searchDir, objFunc, steps,
+									[&](double a, double energy) { return std::isfinite(energy) && energy <= f_in + a * Cache; },
+									energies);
+
+								const int last = accepted >= 0 ? accepted : int(steps.size()) - 1;
+								alpha = steps[last];
+								f = energies[last];
+								valid = accepted >= 0;
+								this->cur_iter += last + 1;
+								continue;
+							}
+
 							alpha *= tau;
 							x1 = x + alpha * searchDir;
 
@@ -5,6 +5,7 @@
 #include <polyfem/utils/Timer.hpp>
 
 #include <cfenv>
+#include <vector>
 
 namespace polyfem
 {
@@ -148,6 +149,35 @@ namespace polyfem
 					bool is_step_valid = false;
 					while (step_size > this->min_step_size && this->cur_iter < this->max_step_size_iter)
 					{
+						if (this->batch_size > 1 && this->cur_iter > 0 && !use_grad_norm)
+						{
+							// the first step was rejected, evaluate the next halvings at once
+							std::vector<double> steps;
+							for (double s = step_size; int(steps.size()) < this->batch_size && s > this->min_step_size
+													   && this->cur_iter + int(steps.size()) < this->max_step_size_iter;
+								 s /= 2.0)
+								steps.push_back(s);
+
+							Eigen::VectorXd energies;
+							const int accepted = this->find_batched_step_size(
+								x, delta_x, objFunc, steps,
+								[&](double, double energy) { return std::isfinite(energy) && energy <= old_energy; },
+								energies);
+
+							is_step_valid = accepted >= 0;
+							if (accepted >= 0)
+							{
+								step_size = steps[accepted];
+								cur_energy = energies[accepted];
+								break;
+							}
+
+							cur_energy = energies[energies.size() - 1];
+							step_size = steps.back() / 2.0;
+							this->cur_iter += steps.size();
+							continue;
+						}
+
 						this->iterations++;
 
 						TVector new_x = x + step_size * delta_x;
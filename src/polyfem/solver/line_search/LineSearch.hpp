@@ -49,6 +49,9 @@ namespace polyfem
 
 				double use_grad_norm_tol = -1;
 
+				/// number of step sizes evaluated at once after the first step is rejected, 1 evaluates them one by one
+				int batch_size = 1;
+
 			protected:
 				double min_step_size = 0;
 				int max_step_size_iter = 100;
@@ -65,6 +68,20 @@ namespace polyfem
 					const TVector &delta_x,
 					ProblemType &objFunc,
 					const double starting_step_size);
+
+				/// @brief Evaluate the energy at all step sizes in one batched call and pick the largest accepted one.
+				/// @param[in] steps Decreasing step sizes to evaluate.
+				/// @param[in] accept Whether a step size with a given energy is acceptable, valid steps are also required.
+				/// @param[out] energies Energy at each step size.
+				/// @return Index of the accepted step size, the problem is updated to it, or -1 if none is accepted.
+				template <typename Accept>
+				int find_batched_step_size(
+					const TVector &x,
+					const TVector &delta_x,
+					ProblemType &objFunc,
+					const std::vector<double> &steps,
+					const Accept &accept,
+					Eigen::VectorXd &energies);
 				// #ifndef NDEBUG
 				// 				double compute_debug_collision_free_step_size(
 				// 					const typename ProblemType::TVector &x,
@@ -6,7 +6,10 @@
 #include "CppOptArmijoLineSearch.hpp"
 #include "MoreThuenteLineSearch.hpp"
 
+#include <polyfem/utils/Timer.hpp>
+
 #include <fstream>
+#include <vector>
 
 namespace polyfem
 {
@@ -50,6 +53,37 @@ namespace polyfem
 				}
 			}
 
+			template <typename ProblemType>
+			template <typename Accept>
+			int LineSearch<ProblemType>::find_batched_step_size(
+				const TVector &x,
+				const TVector &delta_x,
+				ProblemType &objFunc,
+				const std::vector<double> &steps,
+				const Accept &accept,
+				Eigen::VectorXd &energies)
+			{
+				std::vector<TVector> xs(steps.size());
+				for (size_t k = 0; k < steps.size(); ++k)
+					xs[k] = x + steps[k] * delta_x;
+
+				objFunc.values(xs, energies);
+				iterations += steps.size();
+
+				for (size_t k = 0; k < steps.size(); ++k)
+				{
+					logger().trace("batched ls step: {} f: {}", steps[k], energies[k]);
+					if (accept(steps[k], energies[k]) && objFunc.is_step_valid(x, xs[k]))
+					{
+						POLYFEM_SCOPED_TIMER("constraint set update in LS", this->constraint_set_update_time);
+						objFunc.solution_changed(xs[k]);
+						return k;
+					}
+				}
+
+				return -1;
+			}
+
 			template <typename ProblemType>
 			void LineSearch<ProblemType>::save_sampled_values(
 				const std::string &filename,
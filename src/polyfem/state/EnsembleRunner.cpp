@@ -0,0 +1,121 @@
+#include "EnsembleRunner.hpp"
+
+#include <polyfem/State.hpp>
+#include <polyfem/utils/Logger.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
+
+#include <igl/Timer.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+namespace polyfem
+{
+	EnsembleRunner::EnsembleRunner(const json &base_args, const bool strict_validation, const int max_concurrent_jobs)
+		: base_args_(base_args), strict_validation_(strict_validation), max_concurrent_jobs_(max_concurrent_jobs)
+	{
+		if (base_args_.is_null())
+			base_args_ = json::object();
+		if (max_concurrent_jobs_ <= 0)
+			max_concurrent_jobs_ = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	json EnsembleRunner::job_args(const json &patch, const int index) const
+	{
+		json args = base_args_;
+		args.merge_patch(patch);
+
+		// the parallelism is over the jobs
+		args["/solver/max_threads"_json_pointer] = 1;
+
+		const json::json_pointer output_dir("/output/directory");
+		const bool patch_has_dir = patch.is_object() && patch.contains(output_dir);
+		if (!patch_has_dir && base_args_.contains(output_dir) && !base_args_[output_dir].get<std::string>().empty())
+			args[output_dir] = (std::filesystem::path(base_args_[output_dir].get<std::string>()) / fmt::format("job_{}", index)).string();
+
+		return args;
+	}
+
+	json EnsembleRunner::run_job(const json &patch, const int index, const bool return_solution) const
+	{
+		igl::Timer timer;
+		timer.start();
+
+		json result;
+		result["index"] = index;
+
+		try
+		{
+			std::unique_ptr<State> state;
+			{
+				// the constructor initializes geogram
+				static std::mutex construction_mutex;
+				std::lock_guard<std::mutex> lock(construction_mutex);
+				state = std::make_unique<State>();
+			}
+			state->init_process_globals = false;
+
+			state->init(job_args(patch, index), strict_validation_);
+			state->load_mesh();
+			if (state->mesh == nullptr)
+				log_and_throw_error("unable to load the mesh!");
+
+			state->stats.compute_mesh_stats(*state->mesh);
+			state->build_basis();
+			state->assemble_rhs();
+			state->assemble_mass_mat();
+
+			Eigen::MatrixXd sol, pressure;
+			state->solve_problem(sol, pressure);
+			state->compute_errors(sol);
+
+			state->export_data(sol, pressure);
+			state->save_json(sol);
+
+			result["success"] = true;
+			result["n_bases"] = state->n_bases;
+			result["output_directory"] = state->output_dir;
+			if (return_solution)
+			{
+				result["solution"] = std::vector<double>(sol.data(), sol.data() + sol.size());
+				if (pressure.size() > 0)
+					result["pressure"] = std::vector<double>(pressure.data(), pressure.data() + pressure.size());
+			}
+		}
+		catch (const std::exception &e)
+		{
+			result["success"] = false;
+			result["error"] = e.what();
+		}
+
+		timer.stop();
+		result["time"] = timer.getElapsedTimeInSec();
+
+		return result;
+	}
+
+	std::vector<json> EnsembleRunner::run(const std::vector<json> &patches, const bool return_solution) const
+	{
+		std::vector<json> results(patches.size());
+
+		igl::Timer timer;
+		timer.start();
+
+#ifdef POLYFEM_WITH_TBB
+		utils::TaskArena arena(max_concurrent_jobs_);
+		utils::TaskArenaScope arena_scope(&arena);
+#endif
+		// one task per job, the jobs have different sizes
+		utils::maybe_parallel_for(int(patches.size()), [&](int i) {
+			results[i] = run_job(patches[i], i, return_solution);
+		});
+
+		timer.stop();
+		const int n_failed = std::count_if(results.begin(), results.end(), [](const json &r) { return !r["success"].get<bool>(); });
+		logger().info("{} jobs ({} failed) took {}s", patches.size(), n_failed, timer.getElapsedTimeInSec());
+
+		return results;
+	}
+} // namespace polyfem
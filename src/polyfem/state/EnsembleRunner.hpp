@@ -0,0 +1,42 @@
+#pragma once
+
+#include <polyfem/utils/JSONUtils.hpp>
+
+#include <vector>
+
+namespace polyfem
+{
+	/// Runs many small independent simulations in the process, one task per job with serial inner loops.
+	/// For models of a few thousand dofs the setup and the synchronization of the parallel loops of a single
+	/// State dominate, running the jobs concurrently scales instead.
+	///
+	/// The jobs are merge patches of the base arguments. The input spec and the quadrature rules are parsed once
+	/// per process and shared by the jobs, the process wide settings (logger, profiler, thread counts) are left
+	/// untouched by the jobs, so their /output/log settings are ignored.
+	class EnsembleRunner
+	{
+	public:
+		/// @param[in] base_args arguments patched by the jobs
+		/// @param[in] strict_validation strict validation of the job arguments
+		/// @param[in] max_concurrent_jobs maximum number of jobs running at the same time, 0 for the number of cores
+		EnsembleRunner(const json &base_args, const bool strict_validation, const int max_concurrent_jobs = 0);
+
+		/// @brief Runs the jobs, a failed job does not stop the others
+		/// @param[in] patches merge patch of every job
+		/// @param[in] return_solution if true, the results contain the solutions
+		/// @return result of every job, in the order of the patches: index, success, error (if it failed), time,
+		/// n_bases, output_directory, and solution
+		std::vector<json> run(const std::vector<json> &patches, const bool return_solution = false) const;
+
+		/// @brief Arguments of a job: the base arguments patched, with a single thread. If the base arguments have an
+		/// output directory and the patch does not, the job writes in its subdirectory job_<index>.
+		json job_args(const json &patch, const int index) const;
+
+	private:
+		json run_job(const json &patch, const int index, const bool return_solution) const;
+
+		json base_args_;
+		bool strict_validation_;
+		int max_concurrent_jobs_;
+	};
+} // namespace polyfem
@@ -0,0 +1,196 @@
+#include "JobServer.hpp"
+
+#include <polyfem/State.hpp>
+#include <polyfem/utils/Logger.hpp>
+
+#include <igl/Timer.h>
+
+#include <algorithm>
+
+namespace polyfem
+{
+	namespace
+	{
+		json rpc_error(const json &id, const int code, const std::string &message)
+		{
+			json res;
+			res["jsonrpc"] = "2.0";
+			res["id"] = id;
+			res["error"] = {{"code", code}, {"message", message}};
+			return res;
+		}
+	} // namespace
+
+	JobServer::JobServer(const json &base_args, const bool strict_validation, const int max_cached)
+		: base_args_(base_args), strict_validation_(strict_validation), max_cached_(std::max(1, max_cached))
+	{
+		if (base_args_.is_null())
+			base_args_ = json::object();
+	}
+
+	JobServer::~JobServer() = default;
+
+	std::string JobServer::cache_key(const json &args)
+	{
+		json key;
+		key["geometry"] = args.contains("geometry") ? args["geometry"] : json();
+		key["space"] = args.contains("space") ? args["space"] : json();
+		key["root_path"] = args.contains("root_path") ? args["root_path"] : json();
+		return key.dump();
+	}
+
+	void JobServer::run(std::istream &in, std::ostream &out)
+	{
+		std::string line;
+		while (running_ && std::getline(in, line))
+		{
+			if (line.find_first_not_of(" \t\r") == std::string::npos)
+				continue;
+
+			json response;
+			try
+			{
+				response = handle(json::parse(line));
+			}
+			catch (const json::parse_error &e)
+			{
+				response = rpc_error(nullptr, -32700, e.what());
+			}
+
+			if (!response.is_null())
+				out << response.dump() << std::endl;
+		}
+	}
+
+	json JobServer::handle(const json &request)
+	{
+		if (!request.is_object() || !request.contains("method") || !request["method"].is_string())
+			return rpc_error(request.is_object() && request.contains("id") ? request["id"] : json(), -32600, "Invalid request");
+
+		// requests without id are notifications and have no response
+		const bool is_notification = !request.contains("id");
+		const json id = is_notification ? json() : request["id"];
+		const std::string method = request["method"];
+		const json params = request.contains("params") ? request["params"] : json::object();
+
+		json res;
+		res["jsonrpc"] = "2.0";
+		res["id"] = id;
+
+		try
+		{
+			if (method == "solve")
+				res["result"] = solve(params);
+			else if (method == "stats")
+				res["result"] = stats();
+			else if (method == "clear")
+			{
+				cache_.clear();
+				res["result"] = stats();
+			}
+			else if (method == "shutdown")
+			{
+				running_ = false;
+				res["result"] = stats();
+			}
+			else
+				res = rpc_error(id, -32601, fmt::format("Method {} not found", method));
+		}
+		catch (const std::exception &e)
+		{
+			res = rpc_error(id, -32000, e.what());
+		}
+
+		return is_notification ? json() : res;
+	}
+
+	json JobServer::solve(const json &params)
+	{
+		igl::Timer timer;
+		timer.start();
+
+		// the server answers on stdout, the logs go to /output/log/path unless the job asks for them
+		json args = R"({"output": {"log": {"quiet": true}}})"_json;
+		args.merge_patch(params.contains("args") ? params["args"] : base_args_);
+		if (params.contains("patch"))
+			args.merge_patch(params["patch"]);
+
+		const std::string key = cache_key(args);
+		++n_jobs_;
+
+		auto it = cache_.find(key);
+		const bool is_warm = it != cache_.end();
+		if (is_warm)
+			++n_hits_;
+		else
+		{
+			if (cache_.size() >= size_t(max_cached_))
+			{
+				auto lru = std::min_element(cache_.begin(), cache_.end(), [](const auto &a, const auto &b) {
+					return a.second.last_used < b.second.last_used;
+				});
+				cache_.erase(lru);
+			}
+			it = cache_.emplace(key, CachedState{std::make_unique<State>(), 0}).first;
+		}
+		it->second.last_used = n_jobs_;
+		State &state = *it->second.state;
+
+		Eigen::MatrixXd sol, pressure;
+		try
+		{
+			// init resets the problem, assemblers, and materials, the mesh is kept and load_mesh only reads
+			// it if there is none. The bases, caches, and matrices depend on the boundary conditions and
+			// are rebuilt by build_basis.
+			state.init(args, strict_validation_);
+			state.load_mesh();
+			if (state.mesh == nullptr)
+				log_and_throw_error("unable to load the mesh!");
+
+			state.stats.compute_mesh_stats(*state.mesh);
+			state.build_basis();
+			state.assemble_rhs();
+			state.assemble_mass_mat();
+
+			state.solve_problem(sol, pressure);
+			state.compute_errors(sol);
+
+			state.export_data(sol, pressure);
+			state.save_json(sol);
+		}
+		catch (...)
+		{
+			// the state can be half updated, the next job on this geometry starts cold
+			cache_.erase(key);
+			throw;
+		}
+
+		timer.stop();
+
+		json result;
+		result["warm"] = is_warm;
+		result["time"] = timer.getElapsedTimeInSec();
+		result["n_bases"] = state.n_bases;
+		result["solver_info"] = state.stats.solver_info;
+		result["output_directory"] = state.output_dir;
+		if (params.value("return_solution", false))
+		{
+			result["solution"] = std::vector<double>(sol.data(), sol.data() + sol.size());
+			if (pressure.size() > 0)
+				result["pressure"] = std::vector<double>(pressure.data(), pressure.data() + pressure.size());
+		}
+
+		logger().info("job {} ({}) took {}s", n_jobs_, is_warm ? "warm" : "cold", result["time"].get<double>());
+
+		return result;
+	}
+
+	json JobServer::stats() const
+	{
+		json res;
+		res["jobs"] = n_jobs_;
+		res["cache_hits"] = n_hits_;
+		res["cached_states"] = cache_.size();
+		return res;
+	}
+} // namespace polyfem
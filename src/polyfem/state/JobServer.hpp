@@ -0,0 +1,62 @@
+#pragma once
+
+#include <polyfem/utils/JSONUtils.hpp>
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace polyfem
+{
+	class State;
+
+	/// Long-lived server answering line-delimited JSON-RPC 2.0 requests, it keeps the loaded meshes
+	/// resident between jobs so that jobs on the same geometry skip the mesh loading and preprocessing.
+	///
+	/// Methods:
+	///  - "solve": {"args": json (optional, replaces the base args), "patch": json (optional, merge patch
+	///    applied on the args, e.g., new materials, loads, or boundary conditions), "return_solution": bool}
+	///  - "stats": number of jobs, cache hits, and cached states
+	///  - "clear": drops the cached states
+	///  - "shutdown": stops the server
+	class JobServer
+	{
+	public:
+		/// @param[in] base_args default arguments of the jobs (e.g., the --json file of the command line)
+		/// @param[in] strict_validation strict validation of the job arguments
+		/// @param[in] max_cached maximum number of resident states, the least recently used is dropped
+		JobServer(const json &base_args, const bool strict_validation, const int max_cached = 4);
+		~JobServer();
+
+		/// answers the requests of in (one per line) on out until shutdown or the end of in
+		void run(std::istream &in, std::ostream &out);
+
+		/// answers a single request, returns the response (null for notifications)
+		json handle(const json &request);
+
+		/// key of the cache, the arguments the resident mesh depends on
+		static std::string cache_key(const json &args);
+
+		inline bool is_running() const { return running_; }
+
+	private:
+		json solve(const json &params);
+		json stats() const;
+
+		struct CachedState
+		{
+			std::unique_ptr<State> state;
+			size_t last_used = 0;
+		};
+
+		json base_args_;
+		bool strict_validation_;
+		int max_cached_;
+
+		std::map<std::string, CachedState> cache_;
+		size_t n_jobs_ = 0;
+		size_t n_hits_ = 0;
+		bool running_ = true;
+	};
+} // namespace polyfem
@@ -0,0 +1,172 @@
+#include <polyfem/State.hpp>
+
+#include <polyfem/mesh/mesh2D/NCMesh2D.hpp>
+#include <polyfem/mesh/mesh3D/NCMesh3D.hpp>
+#include <polyfem/refinement/APosteriori.hpp>
+
+#include <polyfem/utils/Logger.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
+
+#include <igl/Timer.h>
+
+namespace polyfem
+{
+	using namespace basis;
+	using namespace mesh;
+
+	namespace
+	{
+		// local coordinates of p in the element with geometric bases gbs, one step is exact for affine elements
+		Eigen::MatrixXd local_coordinates(const ElementBases &gbs, const RowVectorNd &p)
+		{
+			const int dim = p.size();
+			Eigen::MatrixXd local = Eigen::MatrixXd::Constant(1, dim, 1. / (dim + 1));
+
+			Eigen::MatrixXd mapped;
+			std::vector<Eigen::MatrixXd> grads;
+			for (int it = 0; it < 10; ++it)
+			{
+				gbs.eval_geom_mapping(local, mapped);
+				gbs.eval_geom_mapping_grads(local, grads);
+
+				// grads[0](i, :) is the derivative of the mapping along the local coordinate i
+				const Eigen::VectorXd delta = grads[0].transpose().partialPivLu().solve((mapped.row(0) - p).transpose());
+				local -= delta.transpose();
+				if (delta.norm() < 1e-12)
+					break;
+			}
+
+			return local;
+		}
+	} // namespace
+
+	void State::adapt_mesh(const std::vector<int> &refine_ids, const std::vector<int> &coarsen_ids, Eigen::MatrixXd &sol)
+	{
+		NCMesh3D *ncmesh = dynamic_cast<NCMesh3D *>(mesh.get());
+		if (!ncmesh)
+			log_and_throw_error("Adaptive refinement requires a non-conforming 3D mesh!");
+		if (mixed_assembler != nullptr)
+			log_and_throw_error("Adaptive refinement is not supported for mixed formulations!");
+
+		igl::Timer timer;
+		timer.start();
+		logger().info("Adapting mesh, refining {} and coarsening {} elements...", refine_ids.size(), coarsen_ids.size());
+
+		const int actual_dim = problem->is_scalar() ? 1 : mesh->dimension();
+		const int prev_n_bases = n_bases;
+		const int prev_n_mesh_bases = n_bases - obstacle.n_vertices();
+		const std::vector<int> prev_elements = ncmesh->all_to_valid_elements();
+		// build_basis clears them anyway
+		const std::vector<ElementBases> prev_bases = std::move(bases);
+		const std::vector<ElementBases> prev_geom_bases = std::move(geom_bases_);
+		const std::vector<ElementBases> &prev_gbases = iso_parametric() ? prev_bases : prev_geom_bases;
+
+		// both lists use the current numbering, the index mapping is only rebuilt by prepare_mesh
+		ncmesh->coarsen_elements(coarsen_ids);
+		ncmesh->refine_elements(refine_ids);
+
+		prev_all_to_valid_elements = prev_elements;
+		build_basis();
+
+		if (sol.size() == 0)
+		{
+			logger().info(" took {}s", timer.getElapsedTime());
+			return;
+		}
+		assert(sol.rows() == prev_n_bases * actual_dim);
+
+		// one element and position per node, unconstrained occurrences are preferred as the node lies in their element
+		const int n_mesh_bases = n_bases - obstacle.n_vertices();
+		std::vector<int> node_element(n_mesh_bases, -1);
+		std::vector<bool> node_constrained(n_mesh_bases, true);
+		std::vector<RowVectorNd> node_position(n_mesh_bases);
+		for (int e = 0; e < bases.size(); ++e)
+		{
+			for (const auto &b : bases[e].bases)
+			{
+				const bool constrained = b.global().size() != 1;
+				for (const auto &g : b.global())
+				{
+					if (node_element[g.index] >= 0 && (constrained || !node_constrained[g.index]))
+						continue;
+					node_element[g.index] = e;
+					node_constrained[g.index] = constrained;
+					node_position[g.index] = g.node;
+				}
+			}
+		}
+
+		Eigen::MatrixXd new_sol = Eigen::MatrixXd::Zero(n_bases * actual_dim, sol.cols());
+		utils::maybe_parallel_for(n_mesh_bases, [&](int start, int end, int thread_id) {
+			std::vector<assembler::AssemblyValues> vals;
+			for (int i = start; i < end; ++i)
+			{
+				if (node_element[i] < 0)
+					continue;
+
+				const RowVectorNd &p = node_position[i];
+				const int prev_e = ncmesh->find_previous_element(prev_elements, node_element[i], p);
+				assert(prev_e >= 0);
+
+				const Eigen::MatrixXd local = local_coordinates(prev_gbases[prev_e], p);
+				prev_bases[prev_e].evaluate_bases(local, vals);
+
+				for (size_t j = 0; j < vals.size(); ++j)
+				{
+					for (const auto &g : prev_bases[prev_e].bases[j].global())
+					{
+						for (int d = 0; d < actual_dim; ++d)
+							new_sol.row(i * actual_dim + d) += vals[j].val(0) * g.val * sol.row(g.index * actual_dim + d);
+					}
+				}
+			}
+		});
+
+		// the obstacle nodes are unchanged and numbered after the mesh nodes
+		const int n_obstacle = (prev_n_bases - prev_n_mesh_bases) * actual_dim;
+		new_sol.bottomRows(n_obstacle) = sol.bottomRows(n_obstacle);
+		sol = new_sol;
+
+		logger().info(" took {}s", timer.getElapsedTime());
+	}
+
+	void State::solve_adaptive(const double tolerance, const int max_iterations, const double theta,
+							   Eigen::MatrixXd &sol, Eigen::MatrixXd &pressure, Eigen::VectorXd &errors)
+	{
+		if (!mesh)
+			log_and_throw_error("Load the mesh first!");
+		if (mesh->is_conforming())
+			log_and_throw_error("Adaptive refinement requires a non-conforming mesh!");
+		if (problem->is_time_dependent())
+			log_and_throw_error("Adaptive refinement is only supported for static problems!");
+
+		const int actual_dim = problem->is_scalar() ? 1 : mesh->dimension();
+
+		build_basis();
+		for (int it = 0;; ++it)
+		{
+			assemble_rhs();
+			assemble_mass_mat();
+			solve_problem(sol, pressure);
+
+			refinement::APosteriori::zz_estimate(*mesh, actual_dim, bases, geom_bases(), *assembler, sol, errors);
+			const double error = errors.norm();
+			logger().info("Adaptive iteration {}: {} elements, {} bases, estimated error {}", it, mesh->n_elements(), n_bases, error);
+
+			if (error <= tolerance || it >= max_iterations)
+				break;
+
+			const std::vector<int> marked = refinement::APosteriori::mark(errors, theta);
+			if (dynamic_cast<NCMesh3D *>(mesh.get()))
+			{
+				Eigen::MatrixXd tmp;
+				adapt_mesh(marked, {}, tmp);
+			}
+			else
+			{
+				dynamic_cast<NCMesh2D &>(*mesh).refine_elements(marked);
+				build_basis();
+			}
+		}
+	}
+} // namespace polyfem
@@ -10,6 +10,7 @@
 #include <polyfem/utils/Logger.hpp>
 #include <polyfem/problem/KernelProblem.hpp>
 #include <polyfem/utils/par_for.hpp>
+#include <polyfem/utils/Profiler.hpp>
 
 #include <polysolve/LinearSolver.hpp>
 
@@ -24,10 +25,14 @@
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/sinks/ostream_sink.h>
+#include <spdlog/async.h>
+#include <spdlog/details/periodic_worker.h>
 
 #include <ipc/utils/logger.hpp>
 
+#include <fstream>
 #include <sstream>
+#include <unordered_map>
 
 namespace spdlog::level
 {
@@ -100,6 +105,121 @@ namespace polyfem
 				logger_->trace(str.substr(0, str.size() - 1));
 			}
 		};
+
+		// Rules of POLYFEM_INPUT_SPEC, completed with the available linear solvers and the load case rules.
+		// They are parsed once per process (e.g., for the jobs of a server) and grouped by top level key,
+		// the verification of an input only uses the groups of the keys it contains.
+		class InputSpec
+		{
+		public:
+			static const InputSpec &instance()
+			{
+				static const InputSpec spec;
+				return spec;
+			}
+
+			/// all the rules, used to inject the defaults
+			json rules;
+
+			/// rules of the root and of the top level keys of args
+			json verification_rules(const json &args) const
+			{
+				json res = json::array();
+				const auto add = [&](const std::string &key) {
+					const auto it = rules_by_key_.find(key);
+					if (it == rules_by_key_.end())
+						return;
+					for (const size_t i : it->second)
+						res.push_back(rules[i]);
+				};
+
+				add("");
+				if (args.is_object())
+				{
+					for (const auto &[key, value] : args.items())
+						add(key);
+				}
+				return res;
+			}
+
+		private:
+			InputSpec()
+			{
+				const std::string polyfem_input_spec = POLYFEM_INPUT_SPEC;
+				std::ifstream file(polyfem_input_spec);
+
+				if (file.is_open())
+					file >> rules;
+				else
+				{
+					logger().error("unable to open {} rules", polyfem_input_spec);
+					throw std::runtime_error("Invald spec file");
+				}
+
+				// Set valid options for enabled linear solvers
+				for (int i = 0; i < rules.size(); i++)
+				{
+					if (rules[i]["pointer"] == "/solver/linear/solver")
+					{
+						rules[i]["default"] = polysolve::LinearSolver::defaultSolver();
+						rules[i]["options"] = polysolve::LinearSolver::availableSolvers();
+					}
+					else if (rules[i]["pointer"] == "/solver/linear/precond")
+					{
+						rules[i]["default"] = polysolve::LinearSolver::defaultPrecond();
+						rules[i]["options"] = polysolve::LinearSolver::availablePrecond();
+					}
+				}
+
+				// the loads of the load cases have the rules of the loads of /boundary_conditions
+				const int n_rules = rules.size();
+				for (int i = 0; i < n_rules; i++)
+				{
+					const std::string pointer = rules[i]["pointer"];
+					for (const std::string load : {"rhs", "neumann_boundary", "pressure_boundary"})
+					{
+						const std::string prefix = "/boundary_conditions/" + load;
+						if (pointer == prefix || pointer.rfind(prefix + "/", 0) == 0)
+						{
+							json rule = rules[i];
+							rule["pointer"] = "/boundary_conditions/load_cases/*/" + pointer.substr(std::string("/boundary_conditions/").size());
+							rules.push_back(rule);
+						}
+					}
+				}
+
+				for (size_t i = 0; i < rules.size(); ++i)
+				{
+					// "/a/b" is grouped under "a" and the root "/" under ""
+					const std::string pointer = rules[i]["pointer"];
+					const size_t end = pointer.find('/', 1);
+					rules_by_key_[pointer.substr(1, end == std::string::npos ? std::string::npos : end - 1)].push_back(i);
+				}
+			}
+
+			std::unordered_map<std::string, std::vector<size_t>> rules_by_key_;
+		};
+
+		/// Thread writing the records of the asynchronous loggers, shared by all the states
+		/// The pool is replaced when the queue size changes, the old one writes its queued records before joining.
+		std::shared_ptr<spdlog::details::thread_pool> log_thread_pool(const int queue_size)
+		{
+			static std::shared_ptr<spdlog::details::thread_pool> pool;
+			static int pool_queue_size = 0;
+			if (!pool || pool_queue_size != queue_size)
+			{
+				pool = std::make_shared<spdlog::details::thread_pool>(queue_size, 1);
+				pool_queue_size = queue_size;
+			}
+			return pool;
+		}
+
+		/// Periodic flush of the asynchronous loggers, the loggers are not registered in spdlog so flush_every does not see them
+		std::unique_ptr<spdlog::details::periodic_worker> &log_flusher()
+		{
+			static std::unique_ptr<spdlog::details::periodic_worker> flusher;
+			return flusher;
+		}
 	} // namespace
 
 	State::State()
@@ -119,7 +239,7 @@ namespace polyfem
 		problem = ProblemFactory::factory().get_problem("Linear");
 	}
 
-	void State::init_logger(const std::string &log_file, const spdlog::level::level_enum log_level, const bool is_quiet)
+	void State::init_logger(const std::string &log_file, const spdlog::level::level_enum log_level, const bool is_quiet, const bool json_records, const int async_queue_size)
 	{
 		std::vector<spdlog::sink_ptr> sinks;
 
@@ -129,7 +249,13 @@ namespace polyfem
 		if (!log_file.empty())
 			sinks.emplace_back(std::make_shared<spdlog::sinks::basic_file_sink_mt>(log_file, /*truncate=*/true));
 
-		init_logger(sinks, log_level);
+		if (json_records)
+		{
+			for (const spdlog::sink_ptr &sink : sinks)
+				sink->set_formatter(std::make_unique<JSONLogFormatter>());
+		}
+
+		init_logger(sinks, log_level, async_queue_size);
 		spdlog::flush_every(std::chrono::seconds(3));
 	}
 
@@ -140,11 +266,41 @@ namespace polyfem
 		init_logger(sinks, log_level);
 	}
 
-	void State::init_logger(const std::vector<spdlog::sink_ptr> &sinks, const spdlog::level::level_enum log_level)
+	void State::init_logger(const std::vector<spdlog::sink_ptr> &sinks, const spdlog::level::level_enum log_level, const int async_queue_size)
 	{
 		spdlog::set_level(log_level);
 
-		set_logger(std::make_shared<spdlog::logger>("polyfem", sinks.begin(), sinks.end()));
+		// the flusher holds the previous loggers, stop it before their thread pool is replaced
+		log_flusher() = nullptr;
+
+		std::shared_ptr<spdlog::logger> polyfem_logger, ipc_logger;
+		if (async_queue_size > 0)
+		{
+			// the disabled levels are still skipped before formatting, the enabled records are formatted by the
+			// caller and the writes to the sinks are moved to the pool thread
+			const auto pool = log_thread_pool(async_queue_size);
+			polyfem_logger = std::make_shared<spdlog::async_logger>("polyfem", sinks.begin(), sinks.end(), pool, spdlog::async_overflow_policy::block);
+			ipc_logger = std::make_shared<spdlog::async_logger>("ipctk", sinks.begin(), sinks.end(), pool, spdlog::async_overflow_policy::block);
+
+			// the errors are flushed as soon as the pool thread writes them, not at the next periodic flush
+			polyfem_logger->flush_on(spdlog::level::err);
+
+			const std::weak_ptr<spdlog::logger> weak_polyfem = polyfem_logger, weak_ipc = ipc_logger;
+			const auto flush = [weak_polyfem, weak_ipc]() {
+				if (const auto l = weak_polyfem.lock())
+					l->flush();
+				if (const auto l = weak_ipc.lock())
+					l->flush();
+			};
+			log_flusher() = std::make_unique<spdlog::details::periodic_worker>(flush, std::chrono::seconds(3));
+		}
+		else
+		{
+			polyfem_logger = std::make_shared<spdlog::logger>("polyfem", sinks.begin(), sinks.end());
+			ipc_logger = std::make_shared<spdlog::logger>("ipctk", sinks.begin(), sinks.end());
+		}
+
+		set_logger(polyfem_logger);
 		logger().set_level(log_level);
 
 		GEO::Logger *geo_logger = GEO::Logger::instance();
@@ -152,7 +308,7 @@ namespace polyfem
 		geo_logger->register_client(new GeoLoggerForward(logger().clone("geogram")));
 		geo_logger->set_pretty(false);
 
-		ipc::set_logger(std::make_shared<spdlog::logger>("ipctk", sinks.begin(), sinks.end()));
+		ipc::set_logger(ipc_logger);
 		ipc::logger().set_level(log_level);
 	}
 
@@ -163,37 +319,11 @@ namespace polyfem
 		apply_common_params(args_in);
 
 		// CHECK validity json
-		json rules;
+		const InputSpec &spec = InputSpec::instance();
 		jse::JSE jse;
-		{
-			jse.strict = strict_validation;
-			const std::string polyfem_input_spec = POLYFEM_INPUT_SPEC;
-			std::ifstream file(polyfem_input_spec);
-
-			if (file.is_open())
-				file >> rules;
-			else
-			{
-				logger().error("unable to open {} rules", polyfem_input_spec);
-				throw std::runtime_error("Invald spec file");
-			}
-		}
-
-		// Set valid options for enabled linear solvers
-		for (int i = 0; i < rules.size(); i++)
-		{
-			if (rules[i]["pointer"] == "/solver/linear/solver")
-			{
-				rules[i]["default"] = polysolve::LinearSolver::defaultSolver();
-				rules[i]["options"] = polysolve::LinearSolver::availableSolvers();
-			}
-			else if (rules[i]["pointer"] == "/solver/linear/precond")
-			{
-				rules[i]["default"] = polysolve::LinearSolver::defaultPrecond();
-				rules[i]["options"] = polysolve::LinearSolver::availablePrecond();
-			}
-		}
+		jse.strict = strict_validation;
 
+		json rules = spec.verification_rules(args_in);
 		const bool valid_input = jse.verify_json(args_in, rules);
 
 		if (!valid_input)
@@ -203,7 +333,7 @@ namespace polyfem
 		}
 		// end of check
 
-		this->args = jse.inject_defaults(args_in, rules);
+		this->args = jse.inject_defaults(args_in, spec.rules);
 
 		const bool fallback_solver = this->args["solver"]["linear"]["enable_overwrite_solver"];
 		// Fallback to default linear solver if the specified solver is invalid
@@ -233,13 +363,28 @@ namespace polyfem
 			out_path_log = resolve_output_path(out_path_log);
 		}
 
-		spdlog::level::level_enum log_level = this->args["output"]["log"]["level"];
-		init_logger(out_path_log, log_level, this->args["output"]["log"]["quiet"]);
+		if (init_process_globals)
+		{
+			spdlog::level::level_enum log_level = this->args["output"]["log"]["level"];
+			const json &log_args = this->args["output"]["log"];
+			init_logger(out_path_log, log_level, log_args["quiet"], log_args["json"], log_args["async"] ? log_args["queue_size"].get<int>() : 0);
+		}
 
 		logger().info("Saving output to {}", output_dir);
 
 		const unsigned int thread_in = this->args["solver"]["max_threads"];
-		set_max_threads(thread_in <= 0 ? std::numeric_limits<unsigned int>::max() : thread_in);
+		set_max_threads(thread_in <= 0 ? std::numeric_limits<unsigned int>::max() : thread_in, this->args["solver"]["pin_threads"]);
+
+		const json &profile = this->args["output"]["advanced"]["profile"];
+		if (init_process_globals)
+		{
+			if (profile["enabled"])
+			{
+				utils::Profiler::instance().set_buffer_size(profile["buffer_size"].get<int>());
+				utils::Profiler::instance().clear();
+			}
+			utils::Profiler::instance().set_enabled(profile["enabled"]);
+		}
 
 		has_dhat = args_in["contact"].contains("dhat");
 
@@ -270,6 +415,8 @@ namespace polyfem
 		const std::string formulation = this->formulation();
 		assembler = assembler::AssemblerUtils::make_assembler(formulation);
 		assert(assembler->name() == formulation);
+		assembler->set_deterministic(args["solver"]["advanced"]["deterministic"]);
+		assembler->set_quadrature_psd_projection(args["solver"]["advanced"]["psd_projection"] == "quadrature_point");
 		mass_matrix_assembler = std::make_shared<assembler::Mass>();
 		const auto other_name = assembler::AssemblerUtils::other_assembler_name(formulation);
 
@@ -319,14 +466,22 @@ namespace polyfem
 		}
 	}
 
-	void State::set_max_threads(const unsigned int max_threads)
+	void State::set_max_threads(const unsigned int max_threads, const bool pin_threads)
 	{
 		const unsigned int num_threads = std::max(1u, std::min(max_threads, std::thread::hardware_concurrency()));
-		NThread::get().num_threads = num_threads;
+		thread_pinning = nullptr;
 #ifdef POLYFEM_WITH_TBB
-		thread_limiter = std::make_shared<tbb::global_control>(tbb::global_control::max_allowed_parallelism, num_threads);
+		task_arena = std::make_shared<tbb::task_arena>(num_threads);
+		if (pin_threads && utils::ThreadPinning::is_supported())
+			thread_pinning = std::make_shared<utils::ThreadPinning>(*task_arena);
 #endif
-		Eigen::setNbThreads(num_threads);
+		if (pin_threads && !thread_pinning)
+			logger().warn("Pinning the threads requires TBB on Linux, the threads are not pinned");
+		if (init_process_globals)
+		{
+			NThread::get().num_threads = num_threads;
+			Eigen::setNbThreads(num_threads);
+		}
 	}
 
 	void State::init_time()
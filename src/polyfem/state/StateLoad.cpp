@@ -11,8 +11,12 @@
 #include <polyfem/utils/Selection.hpp>
 
 #include <polyfem/utils/JSONUtils.hpp>
+#include <polyfem/utils/MatrixUtils.hpp>
 
 #include <igl/Timer.h>
+
+#include <algorithm>
+
 namespace polyfem
 {
 	using namespace basis;
@@ -40,6 +44,8 @@ namespace polyfem
 
 	void State::load_mesh(GEO::Mesh &meshin, const std::function<int(const RowVectorNd &)> &boundary_marker, bool non_conforming, bool skip_boundary_sideset)
 	{
+		utils::TaskArenaScope arena_scope(task_arena.get());
+
 		reset_mesh();
 
 		igl::Timer timer;
@@ -84,6 +90,8 @@ namespace polyfem
 		logger().info(" took {}s", timer.getElapsedTime());
 
 		out_geom.init_sampler(*mesh, args["output"]["paraview"]["vismesh_rel_area"]);
+
+		timings.sample_memory("load_mesh");
 	}
 
 	void State::load_mesh(bool non_conforming,
@@ -91,6 +99,8 @@ namespace polyfem
 						  const std::vector<Eigen::MatrixXi> &cells,
 						  const std::vector<Eigen::MatrixXd> &vertices)
 	{
+		utils::TaskArenaScope arena_scope(task_arena.get());
+
 		assert(names.size() == cells.size());
 		assert(vertices.size() == cells.size());
 
@@ -149,6 +159,8 @@ namespace polyfem
 			args["root_path"], mesh->dimension(), names, vertices, cells);
 		timer.stop();
 		logger().info(" took {}s", timer.getElapsedTime());
+
+		timings.sample_memory("load_mesh");
 	}
 
 	void State::init_mesh_vertices(Eigen::MatrixXd &V)
@@ -186,6 +198,63 @@ namespace polyfem
 		}		
 	}
 
+	void State::build_node_positions(const Eigen::MatrixXd &sol, Eigen::MatrixXd &V) const
+	{
+		assert(bases.size() == mesh->n_elements());
+		const int dim = mesh->dimension();
+
+		V.resize(n_bases, dim);
+		for (const basis::ElementBases &element : bases)
+		{
+			for (const basis::Basis &basis : element.bases)
+			{
+				for (const basis::Local2Global &g : basis.global())
+					V.row(g.index) = g.node;
+			}
+		}
+
+		if (obstacle.n_vertices() > 0)
+			V.bottomRows(obstacle.n_vertices()) = obstacle.v();
+
+		if (sol.size() > 0)
+		{
+			assert(sol.size() == V.size());
+			V += utils::unflatten(sol, dim);
+		}
+	}
+
+	void State::update_nullspace_vertices(const Eigen::MatrixXd &sol, const bool reduced)
+	{
+		test_boundary_nodes.clear();
+
+		if (problem->is_scalar() || mixed_assembler != nullptr)
+		{
+			// no rigid body modes for scalar or mixed problems
+			test_vertices.resize(0, mesh->dimension());
+			return;
+		}
+
+		const int dim = mesh->dimension();
+		if (nullspace_rest_vertices.rows() != n_bases || nullspace_rest_vertices.cols() != dim)
+			build_node_positions(Eigen::MatrixXd(), nullspace_rest_vertices);
+
+		// the assignment reuses the storage of test_vertices after the first call
+		test_vertices = nullspace_rest_vertices;
+		if (sol.size() > 0)
+		{
+			assert(sol.size() == test_vertices.size());
+			test_vertices += Eigen::Map<const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(sol.data(), n_bases, dim);
+		}
+
+		if (reduced)
+		{
+			for (const int b : boundary_nodes)
+				test_boundary_nodes.push_back(b / dim);
+			std::sort(test_boundary_nodes.begin(), test_boundary_nodes.end());
+			test_boundary_nodes.erase(std::unique(test_boundary_nodes.begin(), test_boundary_nodes.end()), test_boundary_nodes.end());
+		}
+	}
+
 	void State::build_mesh_matrices(Eigen::MatrixXd &V, Eigen::MatrixXi &F)
 	{
 		assert(bases.size() == mesh->n_elements());
@@ -1,6 +1,11 @@
 #include <polyfem/State.hpp>
 
+#include <polyfem/io/Checkpoint.hpp>
+#include <polyfem/solver/forms/ContactForm.hpp>
+#include <polyfem/time_integrator/ImplicitTimeIntegrator.hpp>
 #include <polyfem/utils/JSONUtils.hpp>
+#include <polyfem/utils/MatrixUtils.hpp>
+#include <polyfem/utils/Profiler.hpp>
 #include <polyfem/utils/Timer.hpp>
 
 #include <filesystem>
@@ -9,6 +14,8 @@ namespace polyfem
 {
 	void State::compute_errors(const Eigen::MatrixXd &sol)
 	{
+		utils::TaskArenaScope arena_scope(task_arena.get());
+
 		if (!args["output"]["advanced"]["compute_error"])
 			return;
 
@@ -21,7 +28,7 @@ namespace polyfem
 				tend = 1;
 		}
 
-		stats.compute_errors(n_bases, bases, geom_bases(), *mesh, *problem, tend, sol);
+		stats.compute_errors(n_bases, bases, geom_bases(), ass_vals_cache, *mesh, *problem, tend, sol);
 	}
 
 	std::string State::root_path() const
@@ -47,26 +54,199 @@ namespace polyfem
 
 	void State::save_timestep(const double time, const int t, const double t0, const double dt, const Eigen::MatrixXd &sol, const Eigen::MatrixXd &pressure)
 	{
+		save_probes(time, t, dt, sol);
+		stream_timestep(time, t, sol);
+
 		if (args["output"]["advanced"]["save_time_sequence"] && !(t % args["output"]["paraview"]["skip_frame"].get<int>()))
 		{
 			logger().trace("Saving VTU...");
 			POLYFEM_SCOPED_TIMER("Saving VTU");
 			const std::string step_name = args["output"]["advanced"]["timestep_prefix"];
 
-			if (!solve_export_to_file)
-				solution_frames.emplace_back();
+			io::OutGeometryData::ExportOptions opts(args, mesh->is_linear(), problem->is_scalar(), solve_export_to_file);
+			const std::string path = resolve_output_path(fmt::format(step_name + "{:d}.vtu", t));
+
+			const bool use_vtkhdf = args["output"]["paraview"]["vtkhdf"]["enabled"] && solve_export_to_file;
+			if (use_vtkhdf)
+			{
+				std::string series_path = resolve_output_path(args["output"]["paraview"]["file_name"]);
+				if (series_path.empty())
+					series_path = resolve_output_path(step_name);
+				opts.vtkhdf_path = series_path;
+
+				// a new simulation starts a new series
+				if (t == 0)
+				{
+					flush_output();
+					out_geom.close_vtkhdf_series();
+				}
+			}
+
+			int async_threads = args["output"]["advanced"]["async_threads"];
+			if (use_vtkhdf && async_threads > 1)
+			{
+				// the steps are appended to the series in the order they are written
+				logger().debug("Using a single output thread for the VTKHDF time series");
+				async_threads = 1;
+			}
+			if (async_threads > 0 && solve_export_to_file)
+			{
+				if (output_queue == nullptr)
+					output_queue = std::make_unique<io::OutputQueue>(async_threads, args["output"]["advanced"]["async_queue_size"]);
+
+				// the task owns copies of everything that changes in the next time steps
+				opts.snapshot = std::make_shared<const io::OutGeometryData::SolverSnapshot>(*this);
+				output_queue->push([this, path, sol, pressure, time, dt, opts]() {
+					std::vector<io::SolutionFrame> frames; // unused when exporting to files
+					out_geom.save_vtu(path, *this, sol, pressure, time, dt, opts, is_contact_enabled(), frames);
+				});
+			}
+			else
+			{
+				if (!solve_export_to_file)
+					solution_frames.emplace_back();
+
+				out_geom.save_vtu(path, *this, sol, pressure, time, dt, opts, is_contact_enabled(), solution_frames);
+				if (!solve_export_to_file)
+					store_solution_frame();
+			}
+
+			if (!use_vtkhdf)
+			{
+				out_geom.save_pvd(
+					resolve_output_path(args["output"]["paraview"]["file_name"]),
+					[step_name](int i) { return fmt::format(step_name + "{:d}.vtm", i); },
+					t, t0, dt, args["output"]["paraview"]["skip_frame"].get<int>());
+			}
+		}
+	}
+
+	void State::save_probes(const double time, const int t, const double dt, const Eigen::MatrixXd &sol)
+	{
+		const json &probe_args = args["output"]["probes"];
+		if (probe_args["points"].empty() && probe_args["reductions"].empty())
+			return;
+
+		if (t == 0 || probe_output == nullptr)
+		{
+			POLYFEM_SCOPED_TIMER("Locating probes");
+			Eigen::MatrixXd points(probe_args["points"].size(), mesh->dimension());
+			for (int i = 0; i < points.rows(); ++i)
+			{
+				const std::vector<double> p = probe_args["points"][i];
+				if (int(p.size()) != points.cols())
+					log_and_throw_error("Probe {} has {} coordinates instead of {}!", i, p.size(), points.cols());
+				for (int d = 0; d < points.cols(); ++d)
+					points(i, d) = p[d];
+			}
+
+			probe_output = std::make_unique<io::ProbeOutput>(
+				resolve_output_path(probe_args["path"]), points, probe_args["reductions"].get<std::vector<std::string>>());
+			probe_output->init(*this);
+		}
+
+		POLYFEM_SCOPED_TIMER("Saving probes");
+		probe_output->write(*this, time, dt, sol);
+	}
+
+	void State::stream_timestep(const double time, const int t, const Eigen::MatrixXd &sol)
+	{
+		const json &stream_args = args["output"]["stream"];
+		if (!stream_args["enabled"])
+			return;
+
+		POLYFEM_SCOPED_TIMER("Streaming time step");
+
+		const bool new_stream = stream_output == nullptr;
+		if (new_stream)
+			stream_output = std::make_unique<io::StreamOutput>(stream_args["host"], stream_args["port"], stream_args["queue_size"]);
+
+		// the solution at the points of the boundary visualization mesh, with its cached interpolation
+		const int stride = stream_args["surface_stride"];
+		Eigen::MatrixXd points, surface;
+		if (stride > 0)
+		{
+			io::OutGeometryData::ExportOptions opts(args, mesh->is_linear(), problem->is_scalar(), solve_export_to_file);
+			opts.boundary_only = true;
+			Eigen::MatrixXd all_points, values;
+			out_geom.vis_solution(*this, opts, sol, all_points, values);
+
+			const int n = (values.rows() + stride - 1) / stride;
+			points.resize(n, all_points.cols());
+			surface.resize(n, values.cols());
+			for (int i = 0; i < n; ++i)
+			{
+				points.row(i) = all_points.row(i * stride);
+				surface.row(i) = values.row(i * stride);
+			}
+		}
+
+		if (t == 0 || new_stream)
+		{
+			const json header = {
+				{"columns", probe_output ? probe_output->columns() : std::vector<std::string>()},
+				{"dimension", mesh->dimension()},
+				{"surface_points", points.rows()},
+				{"surface_stride", stride}};
+			stream_output->publish_header(header, points);
+		}
+
+		stream_output->publish_step(t, time, probe_output ? probe_output->last_row() : Eigen::VectorXd(), surface);
+		if (stream_args["stats"])
+			stream_output->publish_stats(stats.solver_info);
+	}
+
+	bool State::raw_output_paths(const int t, const Eigen::MatrixXd &x, const Eigen::MatrixXd &v, const Eigen::MatrixXd &a, std::array<std::string, 3> &paths)
+	{
+		paths = {};
+
+		const json &data_args = args["output"]["data"];
+		const int every = data_args["advanced"]["raw_frequency"];
+		const double tolerance = data_args["advanced"]["raw_tolerance"];
+		// u, v, and a are written together so that a restart reads a consistent state
+		if (!output_filter.due("u_path", t, x, every, tolerance))
+			return false;
+
+		const std::array<std::string, 3> names = {{"u_path", "v_path", "a_path"}};
+		const std::array<const Eigen::MatrixXd *, 3> data = {{&x, &v, &a}};
+		for (int i = 0; i < 3; ++i)
+		{
+			if (data_args[names[i]].get<std::string>().empty())
+				continue;
+
+			const std::string path = resolve_output_path(fmt::format(data_args[names[i]], t));
+			if (output_filter.changed(names[i], *data[i], path))
+				paths[i] = path;
+		}
+
+		return true;
+	}
 
-			out_geom.save_vtu(
-				resolve_output_path(fmt::format(step_name + "{:d}.vtu", t)),
-				*this, sol, pressure, time, dt,
-				io::OutGeometryData::ExportOptions(args, mesh->is_linear(), problem->is_scalar(), solve_export_to_file),
-				is_contact_enabled(), solution_frames);
+	void State::store_solution_frame()
+	{
+		const json &frames_args = args["output"]["advanced"]["frames"];
+		if (!frames_args["compress"].get<bool>() || solution_frames.empty())
+			return;
 
-			out_geom.save_pvd(
-				resolve_output_path(args["output"]["paraview"]["file_name"]),
-				[step_name](int i) { return fmt::format(step_name + "{:d}.vtm", i); },
-				t, t0, dt, args["output"]["paraview"]["skip_frame"].get<int>());
+		if (frame_store == nullptr)
+		{
+			frame_store = std::make_unique<io::SolutionFrameStore>(
+				size_t(frames_args["memory_budget"].get<double>() * 1024 * 1024),
+				resolve_output_path(frames_args["spill_file"]),
+				frames_args["float32"], frames_args["keyframe_interval"]);
 		}
+
+		frame_store->push(solution_frames.back());
+		solution_frames.pop_back();
+	}
+
+	void State::flush_output()
+	{
+		if (output_queue == nullptr)
+			return;
+
+		POLYFEM_SCOPED_TIMER("Waiting for the output");
+		output_queue->flush();
 	}
 
 	void State::save_json(const Eigen::MatrixXd &sol)
@@ -85,6 +265,40 @@ namespace polyfem
 		}
 	}
 
+	void State::save_profile() const
+	{
+		const std::string trace_path = args["output"]["advanced"]["profile"]["trace"];
+		if (!utils::Profiler::instance().enabled() || trace_path.empty())
+			return;
+
+		const std::string out_path = resolve_output_path(trace_path);
+		logger().info("Saving profile trace to {}", out_path);
+		utils::Profiler::instance().save_chrome_trace(out_path);
+	}
+
+	void State::track_memory()
+	{
+		timings.track_memory("assembly_values_cache", ass_vals_cache.memory_usage() + mass_ass_vals_cache.memory_usage() + pressure_ass_vals_cache.memory_usage());
+
+		size_t bases_memory = 0;
+		for (const auto *bs : {&bases, &pressure_bases, &geom_bases_})
+			for (const auto &b : *bs)
+				bases_memory += b.memory_usage();
+		timings.track_memory("bases", bases_memory);
+
+		timings.track_memory("sparse_matrix_cache_triplets", utils::SparseMatrixCache::peak_triplets_memory());
+
+		timings.track_memory("collision_mesh",
+							 utils::memory_usage(collision_mesh.rest_positions()) + utils::memory_usage(collision_mesh.edges())
+								 + utils::memory_usage(collision_mesh.faces()) + utils::memory_usage(collision_mesh_dof_map));
+
+		size_t frames_memory = frame_store ? frame_store->memory_usage() : 0;
+		for (const auto &frame : solution_frames)
+			for (const auto &[name, view] : frame.buffers())
+				frames_memory += view.itemsize * view.shape[0] * view.shape[1];
+		timings.track_memory("output_frames", frames_memory);
+	}
+
 	void State::save_json(const Eigen::MatrixXd &sol, std::ostream &out)
 	{
 		if (!mesh)
@@ -101,11 +315,25 @@ namespace polyfem
 		logger().info("Saving json...");
 
 		using json = nlohmann::json;
+		track_memory();
+
 		json j;
 		stats.save_json(args, n_bases, n_pressure_bases,
 						sol, *mesh, disc_orders, *problem, timings,
 						assembler->name(), iso_parametric(), args["output"]["advanced"]["sol_at_node"],
 						j);
+		if (utils::Profiler::instance().enabled())
+			j["profile"] = utils::Profiler::instance().summary();
+		if (ass_vals_cache.memory_budget() > 0)
+		{
+			const assembler::AssemblyValsCache::Stats cache_stats = ass_vals_cache.stats();
+			j["assembly_cache"] = {
+				{"cached_elements", cache_stats.cached_elements},
+				{"estimated_memory", cache_stats.estimated_memory},
+				{"hits", cache_stats.hits},
+				{"misses", cache_stats.misses},
+				{"hit_rate", cache_stats.hit_rate()}};
+		}
 		out << j.dump(4) << std::endl;
 	}
 
@@ -126,10 +354,14 @@ namespace polyfem
 			*this, sol, pressure, t, dt,
 			io::OutGeometryData::ExportOptions(args, mesh->is_linear(), problem->is_scalar(), solve_export_to_file),
 			is_contact_enabled(), solution_frames);
+		if (!solve_export_to_file)
+			store_solution_frame();
 	}
 
 	void State::export_data(const Eigen::MatrixXd &sol, const Eigen::MatrixXd &pressure)
 	{
+		utils::TaskArenaScope arena_scope(task_arena.get());
+
 		if (!mesh)
 		{
 			logger().error("Load the mesh first!");
@@ -175,10 +407,15 @@ namespace polyfem
 			stress_path,
 			mises_path,
 			is_contact_enabled(), solution_frames);
+		if (!problem->is_time_dependent())
+			save_probes(0, 0, 0, sol);
+		timings.sample_memory("export");
 	}
 
 	void State::save_restart_json(const double t0, const double dt, const int t) const
 	{
+		const std::string checkpoint_path = save_checkpoint(t0 + dt * t, t);
+
 		const std::string restart_json_path = args["output"]["restart_json"];
 		if (restart_json_path.empty())
 			return;
@@ -191,7 +428,10 @@ namespace polyfem
 		std::string rest_mesh_path = args["output"]["data"]["rest_mesh"].get<std::string>();
 		if (!rest_mesh_path.empty())
 		{
-			rest_mesh_path = resolve_output_path(fmt::format(args["output"]["data"]["rest_mesh"], t));
+			// the rest mesh is only written when it changes
+			rest_mesh_path = output_filter.path("rest_mesh");
+			if (rest_mesh_path.empty())
+				rest_mesh_path = resolve_output_path(fmt::format(args["output"]["data"]["rest_mesh"], t));
 
 			std::vector<json> patch;
 			if (args["geometry"].is_array())
@@ -242,16 +482,58 @@ namespace polyfem
 			restart_json["patch"] = patch;
 		}
 
+		// the raw data equal to a previous write references its file
+		const auto raw_path = [&](const std::string &name) {
+			const std::string &path = output_filter.path(name);
+			return path.empty() ? resolve_output_path(fmt::format(args["output"]["data"][name], t)) : path;
+		};
 		restart_json["input"] = {{
 			"data",
 			{
-				{"u_path", resolve_output_path(fmt::format(args["output"]["data"]["u_path"], t))},
-				{"v_path", resolve_output_path(fmt::format(args["output"]["data"]["v_path"], t))},
-				{"a_path", resolve_output_path(fmt::format(args["output"]["data"]["a_path"], t))},
+				{"u_path", raw_path("u_path")},
+				{"v_path", raw_path("v_path")},
+				{"a_path", raw_path("a_path")},
 			},
 		}};
+		if (!checkpoint_path.empty())
+			restart_json["input"]["data"]["checkpoint"] = checkpoint_path;
 
 		std::ofstream file(resolve_output_path(fmt::format(restart_json_path, t)));
 		file << restart_json;
 	}
+
+	std::string State::save_checkpoint(const double time, const int t) const
+	{
+		const std::string checkpoint_path = args["output"]["checkpoint"];
+		if (checkpoint_path.empty() || solve_data.time_integrator == nullptr)
+			return "";
+
+		POLYFEM_SCOPED_TIMER("Saving checkpoint");
+
+		const time_integrator::ImplicitTimeIntegrator &time_integrator = *solve_data.time_integrator;
+
+		io::Checkpoint checkpoint;
+		checkpoint.set("time", time);
+		checkpoint.set("dt", time_integrator.dt());
+		checkpoint.set("solution", time_integrator.x_prev());
+		checkpoint.set("n_prevs", double(time_integrator.steps()));
+		for (int i = 0; i < time_integrator.steps(); ++i)
+		{
+			checkpoint.set(fmt::format("x_prev_{}", i), time_integrator.x_prevs()[i]);
+			checkpoint.set(fmt::format("v_prev_{}", i), time_integrator.v_prevs()[i]);
+			checkpoint.set(fmt::format("a_prev_{}", i), time_integrator.a_prevs()[i]);
+		}
+		if (solve_data.contact_form != nullptr)
+			checkpoint.set("barrier_stiffness", solve_data.contact_form->barrier_stiffness());
+		if (solve_data.al_warm_start_weight > 0)
+			checkpoint.set("al_weight", solve_data.al_warm_start_weight);
+
+		const std::string path = resolve_output_path(fmt::format(checkpoint_path, t));
+		if (!checkpoint.write(path))
+		{
+			logger().error("Unable to save checkpoint to {}", path);
+			return "";
+		}
+		return path;
+	}
 } // namespace polyfem
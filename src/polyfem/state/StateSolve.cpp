@@ -17,6 +17,15 @@ namespace polyfem
 
 		solve_data.rhs_assembler = build_rhs_assembler();
 
+		input_checkpoint.clear();
+		const std::string checkpoint_path = resolve_input_path(args["input"]["data"]["checkpoint"]);
+		if (!checkpoint_path.empty())
+		{
+			POLYFEM_SCOPED_TIMER("Read checkpoint");
+			if (!input_checkpoint.read(checkpoint_path))
+				log_and_throw_error("Unable to read checkpoint from file ({})!", checkpoint_path);
+		}
+
 		initial_solution(sol);
 
 		if (mixed_assembler != nullptr)
@@ -38,7 +47,13 @@ namespace polyfem
 	{
 		assert(solve_data.rhs_assembler != nullptr);
 		const std::string in_path = resolve_input_path(args["input"]["data"]["u_path"]);
-		if (!in_path.empty())
+		if (input_checkpoint.has("solution"))
+		{
+			solution = input_checkpoint.get("solution");
+			if (solution.size() != rhs.size())
+				log_and_throw_error("Checkpoint solution has size {} instead of {}!", solution.size(), rhs.size());
+		}
+		else if (!in_path.empty())
 		{
 			if (!read_matrix(in_path, solution))
 				log_and_throw_error("Unable to read initial solution from file ({})!", in_path);
@@ -67,7 +82,9 @@ namespace polyfem
 	{
 		assert(solve_data.rhs_assembler != nullptr);
 		const std::string in_path = resolve_input_path(args["input"]["data"]["v_path"]);
-		if (!in_path.empty())
+		if (input_checkpoint.has("v_prev_0"))
+			velocity = input_checkpoint.get("v_prev_0");
+		else if (!in_path.empty())
 		{
 			if (!read_matrix(in_path, velocity))
 				log_and_throw_error("Unable to read initial velocity from file ({})!", in_path);
@@ -88,7 +105,9 @@ namespace polyfem
 	{
 		assert(solve_data.rhs_assembler != nullptr);
 		const std::string in_path = resolve_input_path(args["input"]["data"]["a_path"]);
-		if (!in_path.empty())
+		if (input_checkpoint.has("a_prev_0"))
+			acceleration = input_checkpoint.get("a_prev_0");
+		else if (!in_path.empty())
 		{
 			if (!read_matrix(in_path, acceleration))
 				log_and_throw_error("Unable to read initial acceleration from file ({})!", in_path);
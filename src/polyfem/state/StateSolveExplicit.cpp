@@ -0,0 +1,136 @@
+#include <polyfem/State.hpp>
+
+#include <polyfem/assembler/Mass.hpp>
+
+#include <polyfem/solver/forms/BodyForm.hpp>
+#include <polyfem/solver/forms/ElasticForm.hpp>
+#include <polyfem/time_integrator/CentralDifference.hpp>
+#include <polyfem/utils/MatrixUtils.hpp>
+#include <polyfem/utils/Timer.hpp>
+#include <polyfem/utils/Logger.hpp>
+
+#include <cmath>
+
+namespace polyfem
+{
+	using namespace solver;
+	using namespace time_integrator;
+
+	void State::solve_transient_tensor_explicit(const int time_steps, const double t0, const double dt, Eigen::MatrixXd &sol)
+	{
+		assert(!problem->is_scalar());     // tensor
+		assert(mixed_assembler == nullptr); // not mixed
+		assert(solve_data.rhs_assembler != nullptr);
+
+		if (is_contact_enabled())
+			log_and_throw_error("The explicit CentralDifference integrator does not support contact!");
+		if (args["solver"]["rayleigh_damping"].size() > 0)
+			logger().warn("Rayleigh damping is ignored by the explicit CentralDifference integrator");
+
+		const int ndof = n_bases * mesh->dimension();
+		assert(sol.size() == ndof);
+
+		// --------------------------------------------------------------------
+		// Forms, the time step size is only used by the elastic form for lagging
+		ElasticForm elastic_form(n_bases, bases, geom_bases(), *assembler, ass_vals_cache, dt, mesh->is_volume());
+		BodyForm body_form(
+			ndof, n_pressure_bases, boundary_nodes, local_boundary, local_neumann_boundary,
+			n_boundary_samples(), rhs, *solve_data.rhs_assembler, mass_matrix_assembler->density(),
+			/*apply_DBC=*/false, /*is_formulation_mixed=*/false, /*is_time_dependent=*/true);
+
+		Eigen::VectorXd elastic_grad, body_grad;
+		const auto compute_force = [&](const double time, const Eigen::VectorXd &x, Eigen::VectorXd &force) {
+			POLYFEM_SCOPED_TIMER("Compute forces");
+			body_form.update_quantities(time, x);
+			elastic_form.first_derivative(x, elastic_grad);
+			body_form.first_derivative(x, body_grad);
+			force = -(elastic_grad + body_grad);
+		};
+
+		Eigen::MatrixXd boundary_values = Eigen::MatrixXd::Zero(ndof, 1);
+		const auto compute_boundary_values = [&](const double time) {
+			solve_data.rhs_assembler->set_bc(
+				local_boundary, boundary_nodes, n_boundary_samples(), std::vector<mesh::LocalBoundary>(),
+				boundary_values, Eigen::MatrixXd(), time);
+		};
+
+		// --------------------------------------------------------------------
+		// Initialize time integrator
+		CentralDifference integrator;
+		{
+			POLYFEM_SCOPED_TIMER("Initialize time integrator");
+
+			Eigen::MatrixXd velocity;
+			initial_velocity(velocity);
+			assert(velocity.size() == sol.size());
+
+			const Eigen::VectorXd lumped_mass = utils::lump_matrix(mass).diagonal();
+			integrator.init(sol, velocity, lumped_mass, boundary_nodes, dt);
+		}
+
+		// --------------------------------------------------------------------
+		// Stable time step size
+		const json &integrator_args = args["time"]["integrator"];
+		const double cfl = integrator_args.is_object() ? integrator_args.value("cfl", 0.9) : 0.9;
+		const bool auto_dt = integrator_args.is_object() ? integrator_args.value("auto_dt", false) : false;
+
+		double step_dt = dt;
+		int n_steps = time_steps;
+		{
+			POLYFEM_SCOPED_TIMER("Estimate stable time step");
+			const Eigen::VectorXd x0 = sol;
+			const double critical_dt = integrator.stable_dt(
+				[&](const Eigen::VectorXd &v, Eigen::VectorXd &out) { elastic_form.hessian_vector_product(x0, v, out); });
+			logger().info("Explicit integrator critical time step size {}", critical_dt);
+
+			if (auto_dt && std::isfinite(critical_dt))
+			{
+				const double tend = t0 + time_steps * dt;
+				n_steps = std::max(1, int(std::ceil((tend - t0) / (cfl * critical_dt))));
+				step_dt = (tend - t0) / n_steps;
+				integrator.set_dt(step_dt);
+				logger().info("Using dt={} ({} steps) for CFL={}", step_dt, n_steps, cfl);
+			}
+			else if (dt > cfl * critical_dt)
+			{
+				logger().warn(
+					"dt={} is larger than CFL={} times the critical time step size {}, the explicit integration is likely to be unstable",
+					dt, cfl, critical_dt);
+			}
+		}
+
+		Eigen::VectorXd force;
+		compute_force(t0, integrator.x(), force);
+		integrator.init_acceleration(force);
+
+		output_filter.clear();
+		save_timestep(t0, 0, t0, step_dt, sol, Eigen::MatrixXd()); // no pressure
+
+		for (int t = 1; t <= n_steps; ++t)
+		{
+			const double time = t0 + t * step_dt;
+
+			integrator.update_position();
+			compute_boundary_values(time);
+			integrator.set_prescribed(boundary_values);
+
+			compute_force(time, integrator.x(), force);
+			integrator.update_velocity(force);
+
+			sol = integrator.x();
+
+			save_timestep(time, t, t0, step_dt, sol, Eigen::MatrixXd()); // no pressure
+
+			logger().info("{}/{}  t={}", t, n_steps, time);
+
+			std::array<std::string, 3> raw_paths;
+			if (raw_output_paths(t, integrator.x(), integrator.v(), integrator.a(), raw_paths))
+			{
+				integrator.save_raw(raw_paths[0], raw_paths[1], raw_paths[2]);
+
+				// save restart file
+				save_restart_json(t0, step_dt, t);
+			}
+		}
+	}
+} // namespace polyfem
@@ -2,32 +2,94 @@
 
 #include <polyfem/assembler/Mass.hpp>
 #include <polyfem/assembler/AssemblerUtils.hpp>
+#include <polyfem/assembler/GenericProblem.hpp>
+#include <polyfem/assembler/Stokes.hpp>
+#include <polyfem/assembler/SumFactorization.hpp>
+#include <polyfem/solver/BlockStokesSolver.hpp>
+#include <polyfem/solver/GeometricMultigridSolver.hpp>
+#include <polyfem/solver/MixedPrecisionSolver.hpp>
+#include <polyfem/solver/ModalBasis.hpp>
+#include <polyfem/solver/PMultigridSolver.hpp>
+#include <polyfem/solver/SchwarzSolver.hpp>
+#include <polyfem/solver/SpectrumEstimate.hpp>
+#include <polyfem/solver/StaticCondensation.hpp>
+#include <polyfem/io/MatrixIO.hpp>
+#include <polyfem/mesh/MeshPartition.hpp>
+#include <polyfem/utils/MatrixUtils.hpp>
 
 #include <polyfem/time_integrator/ImplicitTimeIntegrator.hpp>
 #include <polyfem/time_integrator/BDF.hpp>
+#include <polyfem/time_integrator/AdaptiveTimeStepping.hpp>
 
 #include <polysolve/FEMSolver.hpp>
 
 #include <igl/Timer.h>
 
-#include <unsupported/Eigen/SparseExtra>
-
 namespace polyfem
 {
 	using namespace mesh;
 	using namespace time_integrator;
 	using namespace utils;
 
+	namespace
+	{
+		/// records the RSS growth over its scope as the "factorization" memory, the solver
+		/// internals (e.g., the fill of direct solvers) are not accessible through polysolve
+		class FactorizationMemory
+		{
+		public:
+			FactorizationMemory(io::OutRuntimeData &timings)
+				: timings_(timings), before_(io::OutRuntimeData::current_memory())
+			{
+			}
+
+			~FactorizationMemory()
+			{
+				const size_t after = io::OutRuntimeData::current_memory();
+				timings_.track_memory("factorization", after > before_ ? after - before_ : 0);
+			}
+
+		private:
+			io::OutRuntimeData &timings_;
+			const size_t before_;
+		};
+
+		/// polysolve writes the matrices it factorizes in Matrix Market, the binary paths are
+		/// written with io::write_sparse_matrix after the call (see save_binary_matrix)
+		std::string polysolve_matrix_path(const std::string &path)
+		{
+			return io::is_binary_matrix_path(path) ? "" : path;
+		}
+
+		/// A is the matrix modified by polysolve, with the rows of the Dirichlet nodes replaced by the identity
+		void save_binary_matrix(const std::string &path, const StiffnessMatrix &A)
+		{
+			if (io::is_binary_matrix_path(path))
+				io::write_sparse_matrix(path, A);
+		}
+	} // namespace
+
 	void State::build_stiffness_mat(StiffnessMatrix &stiffness)
 	{
+		utils::TaskArenaScope arena_scope(task_arena.get());
+
 		igl::Timer timer;
 		timer.start();
 		logger().info("Assembling stiffness mat...");
 		assert(assembler->is_linear());
 
-		if (mixed_assembler != nullptr)
-		{
+		const auto *velocity_assembler = dynamic_cast<const assembler::LinearAssembler *>(assembler.get());
+		const auto *linear_pressure_assembler = dynamic_cast<const assembler::LinearAssembler *>(pressure_assembler.get());
 
+		if (mixed_assembler != nullptr && velocity_assembler != nullptr && linear_pressure_assembler != nullptr)
+		{
+			// the three blocks are assembled in one element loop directly into the saddle point system
+			mixed_assembler->assemble_system(mesh->is_volume(), n_pressure_bases, n_bases, pressure_bases, bases, geom_bases(),
+											 pressure_ass_vals_cache, ass_vals_cache, *velocity_assembler, *linear_pressure_assembler,
+											 use_avg_pressure ? assembler->is_fluid() : false, stiffness);
+		}
+		else if (mixed_assembler != nullptr)
+		{
 			StiffnessMatrix velocity_stiffness, mixed_stiffness, pressure_stiffness;
 			assembler->assemble(mesh->is_volume(), n_bases, bases, geom_bases(), ass_vals_cache, velocity_stiffness);
 			mixed_assembler->assemble(mesh->is_volume(), n_pressure_bases, n_bases, pressure_bases, bases, geom_bases(), pressure_ass_vals_cache, ass_vals_cache, mixed_stiffness);
@@ -47,6 +109,7 @@ namespace polyfem
 		timer.stop();
 		timings.assembling_stiffness_mat_time = timer.getElapsedTime();
 		logger().info(" took {}s", timings.assembling_stiffness_mat_time);
+		timings.sample_memory("assemble_stiffness");
 
 		stats.nn_zero = stiffness.nonZeros();
 		stats.num_dofs = stiffness.rows();
@@ -56,7 +119,7 @@ namespace polyfem
 		const std::string full_mat_path = args["output"]["data"]["full_mat"];
 		if (!full_mat_path.empty())
 		{
-			Eigen::saveMarket(stiffness, full_mat_path);
+			io::write_sparse_matrix(full_mat_path, stiffness);
 		}
 	}
 
@@ -73,15 +136,180 @@ namespace polyfem
 		const int problem_dim = problem->is_scalar() ? 1 : mesh->dimension();
 		const int precond_num = problem_dim * n_bases;
 
+		// mixed problems can be solved block by block instead of as one merged system
+		const bool use_block_solver = mixed_assembler != nullptr && polyfem::solver::BlockStokesSolver::is_enabled(args["solver"]["linear"]);
+
+		// high-order Lagrange bases can be solved with a p-multigrid preconditioner using the P1/Q1 bases of the same mesh
+		bool use_p_multigrid = mixed_assembler == nullptr && polyfem::solver::PMultigridSolver::is_enabled(args["solver"]["linear"]);
+		if (use_p_multigrid && (mesh->has_poly() || args["space"]["basis_type"] == "Spline"))
+		{
+			logger().warn("p-multigrid needs Lagrange bases without polygons, using the linear solver");
+			use_p_multigrid = false;
+		}
+
+		// uniformly refined meshes can be solved with a geometric multigrid preconditioner using the meshes before each refinement
+		bool use_geometric_multigrid = mixed_assembler == nullptr && !use_p_multigrid && polyfem::solver::GeometricMultigridSolver::is_enabled(args["solver"]["linear"]);
+		if (use_geometric_multigrid && (mesh->refinement_levels().empty() || mesh->has_poly() || args["space"]["basis_type"] == "Spline"))
+		{
+			logger().warn("Geometric multigrid needs Lagrange bases and the refinement levels of the mesh, using the linear solver");
+			use_geometric_multigrid = false;
+		}
+
+		// overlapping Schwarz preconditioner on a partition of the elements
+		bool use_schwarz = mixed_assembler == nullptr && !use_p_multigrid && !use_geometric_multigrid && polyfem::solver::SchwarzSolver::is_enabled(args["solver"]["linear"]);
+		if (use_schwarz && (mesh->has_poly() || args["space"]["basis_type"] == "Spline"))
+		{
+			logger().warn("Schwarz solver needs Lagrange bases without polygons, using the linear solver");
+			use_schwarz = false;
+		}
+
+		// the Lanczos estimate reuses the factorization of dirichlet_solve instead of its full eigen solve
+		const bool estimate_spectrum = compute_spectrum && args["output"]["advanced"]["spectrum_method"] == "lanczos";
+
 		Eigen::VectorXd x;
-		stats.spectrum = dirichlet_solve(
-			*solver, A, b, boundary_nodes, x, precond_num, args["output"]["data"]["stiffness_mat"], compute_spectrum,
-			assembler->is_fluid(), use_avg_pressure);
+		double error;
+		if (use_block_solver)
+		{
+			if (compute_spectrum)
+				logger().warn("The spectrum is not computed by the block solver");
+
+			const bool with_average = use_avg_pressure ? assembler->is_fluid() : false;
+			polyfem::solver::BlockStokesSolver block_solver(args["solver"]["linear"], precond_num, n_pressure_bases, with_average);
+			if (args["solver"]["linear"]["block"]["schur"] == "mass")
+			{
+				assembler::Mass pressure_mass_assembler;
+				pressure_mass_assembler.set_size(1);
+				StiffnessMatrix pressure_mass;
+				pressure_mass_assembler.assemble(mesh->is_volume(), n_pressure_bases, pressure_bases, geom_bases(), pressure_ass_vals_cache, pressure_mass, true);
+
+				const auto stokes = std::dynamic_pointer_cast<assembler::StokesVelocity>(assembler);
+				block_solver.set_pressure_mass(pressure_mass, stokes ? stokes->viscosity() : 1.);
+			}
+
+			block_solver.solve(A, b, boundary_nodes, x);
+			block_solver.get_info(stats.solver_info);
+
+			// A still has its Dirichlet rows
+			Eigen::VectorXd residual = A * x - b;
+			for (const int i : boundary_nodes)
+				residual[i] = 0;
+			error = residual.norm();
+		}
+		else if (use_p_multigrid)
+		{
+			if (compute_spectrum)
+				logger().warn("The spectrum is not computed by the p-multigrid solver");
+
+			polyfem::solver::PMultigridSolver multigrid(args["solver"]["linear"]);
+			std::vector<basis::ElementBases> coarse_bases;
+			const int n_coarse_bases = polyfem::solver::MultigridSolver::build_linear_bases(*mesh, assembler->name(), coarse_bases);
+			multigrid.set_prolongation(polyfem::solver::PMultigridSolver::prolongation(bases, n_bases, coarse_bases, n_coarse_bases, problem_dim));
+
+			{
+				FactorizationMemory memory(timings);
+				multigrid.solve(A, b, boundary_nodes, x);
+			}
+			multigrid.get_info(stats.solver_info);
+
+			// A still has its Dirichlet rows
+			Eigen::VectorXd residual = A * x - b;
+			for (const int i : boundary_nodes)
+				residual[i] = 0;
+			error = residual.norm();
+		}
+		else if (use_geometric_multigrid)
+		{
+			if (compute_spectrum)
+				logger().warn("The spectrum is not computed by the geometric multigrid solver");
+
+			polyfem::solver::GeometricMultigridSolver multigrid(args["solver"]["linear"]);
+			multigrid.set_prolongations(polyfem::solver::GeometricMultigridSolver::prolongations(*mesh, assembler->name(), bases, n_bases, problem_dim));
+
+			{
+				FactorizationMemory memory(timings);
+				multigrid.solve(A, b, boundary_nodes, x);
+			}
+			multigrid.get_info(stats.solver_info);
+
+			Eigen::VectorXd residual = A * x - b;
+			for (const int i : boundary_nodes)
+				residual[i] = 0;
+			error = residual.norm();
+		}
+		else if (use_schwarz)
+		{
+			if (compute_spectrum)
+				logger().warn("The spectrum is not computed by the Schwarz solver");
+
+			polyfem::solver::SchwarzSolver schwarz(args["solver"]["linear"]);
+			const int n_parts = polyfem::solver::SchwarzSolver::n_subdomains(args["solver"]["linear"]);
+			schwarz.set_subdomains(mesh::partition::bisection(*mesh, n_parts), n_parts, bases, n_bases, problem_dim);
+
+			{
+				FactorizationMemory memory(timings);
+				schwarz.solve(A, b, boundary_nodes, x);
+			}
+			schwarz.get_info(stats.solver_info);
+
+			Eigen::VectorXd residual = A * x - b;
+			for (const int i : boundary_nodes)
+				residual[i] = 0;
+			error = residual.norm();
+		}
+		else if (args["solver"]["advanced"]["static_condensation"] && mixed_assembler == nullptr)
+		{
+			// the Dirichlet nodes stay in the skeleton, their rows are replaced in the condensed system
+			const polyfem::solver::StaticCondensation condensation(
+				A, polyfem::solver::StaticCondensation::interior_dofs(bases, n_bases, problem_dim, boundary_nodes));
+
+			StiffnessMatrix S = condensation.skeleton_matrix();
+			Eigen::VectorXd b_s, x_s;
+			condensation.condense(b, b_s);
+
+			std::vector<int> skeleton_boundary_nodes;
+			skeleton_boundary_nodes.reserve(boundary_nodes.size());
+			for (const int i : boundary_nodes)
+				skeleton_boundary_nodes.push_back(condensation.skeleton_index(i));
+
+			{
+				FactorizationMemory memory(timings);
+				const std::string save_path = args["output"]["data"]["stiffness_mat"];
+				stats.spectrum = dirichlet_solve(
+					*solver, S, b_s, skeleton_boundary_nodes, x_s, S.rows(), polysolve_matrix_path(save_path), compute_spectrum && !estimate_spectrum,
+					assembler->is_fluid(), use_avg_pressure);
+				if (estimate_spectrum)
+					stats.spectrum = polyfem::solver::estimate_spectrum(*solver, S, skeleton_boundary_nodes);
+				save_binary_matrix(save_path, S);
+			}
+			condensation.expand(b, x_s, x);
+
+			error = (S * x_s - b_s).norm();
+		}
+		else
+		{
+			{
+				FactorizationMemory memory(timings);
+				const std::string save_path = args["output"]["data"]["stiffness_mat"];
+				stats.spectrum = dirichlet_solve(
+					*solver, A, b, boundary_nodes, x, precond_num, polysolve_matrix_path(save_path), compute_spectrum && !estimate_spectrum,
+					assembler->is_fluid(), use_avg_pressure);
+				if (estimate_spectrum)
+				{
+					// mixed systems are indefinite and the pressure of fluids can be constrained by extra columns
+					if (mixed_assembler != nullptr || A.rows() != x.size())
+						logger().warn("The spectrum is not estimated for mixed problems, use /output/advanced/spectrum_method = \"full\"");
+					else
+						stats.spectrum = polyfem::solver::estimate_spectrum(*solver, A, boundary_nodes);
+				}
+				save_binary_matrix(save_path, A);
+			}
+			error = (A * x - b).norm();
+		}
 		sol = x; // Explicit copy because sol is a MatrixXd (with one column)
 
-		solver->getInfo(stats.solver_info);
+		if (!use_block_solver && !use_p_multigrid && !use_geometric_multigrid && !use_schwarz)
+			solver->getInfo(stats.solver_info);
 
-		const auto error = (A * x - b).norm();
 		if (error > 1e-4)
 			logger().error("Solver error: {}", error);
 		else
@@ -98,25 +326,221 @@ namespace polyfem
 
 		// --------------------------------------------------------------------
 
+		solve_data.rhs_assembler->set_bc(
+			local_boundary, boundary_nodes, n_boundary_samples(),
+			(assembler->name() != "Bilaplacian") ? local_neumann_boundary : std::vector<LocalBoundary>(), rhs);
+
+		if (solve_linear_matrix_free(sol))
+			return;
+
+		// --------------------------------------------------------------------
+
 		std::unique_ptr<polysolve::LinearSolver> solver =
-			polysolve::LinearSolver::create(args["solver"]["linear"]["solver"], args["solver"]["linear"]["precond"]);
+			polyfem::solver::MixedPrecisionSolver::create(args["solver"]["linear"]);
 		solver->setParameters(args["solver"]["linear"]);
 		logger().info("{}...", solver->name());
 
+		StiffnessMatrix A;
+		build_stiffness_mat(A);
+
+		Eigen::VectorXd b = rhs;
+
 		// --------------------------------------------------------------------
 
-		solve_data.rhs_assembler->set_bc(
-			local_boundary, boundary_nodes, n_boundary_samples(),
-			(assembler->name() != "Bilaplacian") ? local_neumann_boundary : std::vector<LocalBoundary>(), rhs);
+		solve_linear(solver, A, b, args["output"]["advanced"]["spectrum"], sol, pressure);
+	}
+
+	bool State::solve_linear_matrix_free(Eigen::MatrixXd &sol)
+	{
+		const json &params = args["solver"]["linear"]["matrix_free"];
+		if (!params.is_object() || !params["enabled"].get<bool>())
+			return false;
+
+		if (assembler->name() != "Laplacian" || mixed_assembler != nullptr || mesh->has_poly() || args["space"]["basis_type"] == "Spline")
+		{
+			logger().warn("The matrix-free solver only supports the Laplacian with Lagrange bases, assembling the stiffness matrix");
+			return false;
+		}
+		if (args["output"]["advanced"]["spectrum"])
+			logger().warn("The spectrum is not computed by the matrix-free solver");
+
+		utils::TaskArenaScope arena_scope(task_arena.get());
+
+		igl::Timer timer;
+		timer.start();
+		logger().info("Matrix-free conjugate gradient...");
+
+		// the element tables and geometric factors replace the stiffness, O(#dofs) memory
+		const assembler::SumFactorizedLaplacian laplacian(mesh->is_volume(), n_bases, bases, geom_bases());
+		const Eigen::VectorXd diagonal = laplacian.diagonal();
+		logger().debug("{}/{} elements with sum factorization", laplacian.n_sum_factorized(), bases.size());
+
+		polyfem::solver::MultigridSolver cg(args["solver"]["linear"], params);
+		StiffnessMatrix coarse;
+		if (params["p_multigrid"].get<bool>() && disc_orders.maxCoeff() > 1)
+		{
+			std::vector<basis::ElementBases> coarse_bases;
+			const int n_coarse_bases = polyfem::solver::MultigridSolver::build_linear_bases(*mesh, assembler->name(), coarse_bases);
+			cg.set_prolongations({polyfem::solver::PMultigridSolver::prolongation(bases, n_bases, coarse_bases, n_coarse_bases, 1)});
+
+			// the Galerkin product would need the fine matrix, the P1/Q1 stiffness is the same for nested spaces
+			assembler::AssemblyValsCache coarse_cache;
+			assembler->assemble(mesh->is_volume(), n_coarse_bases, coarse_bases, geom_bases(), coarse_cache, coarse);
+		}
+
+		timer.stop();
+		timings.assembling_stiffness_mat_time = timer.getElapsedTime();
+		logger().info(" took {}s", timings.assembling_stiffness_mat_time);
+
+		stats.nn_zero = 0;
+		stats.num_dofs = n_bases;
+		stats.mat_size = (long long)n_bases * (long long)n_bases;
+
+		const auto apply = [&laplacian](const Eigen::VectorXd &x, Eigen::VectorXd &y) { laplacian.apply(x, y); };
+		const Eigen::VectorXd b = rhs;
+		Eigen::VectorXd x;
+		{
+			FactorizationMemory memory(timings);
+			cg.factorize(apply, diagonal, coarse, boundary_nodes);
+			cg.solve(b, x);
+		}
+		cg.get_info(stats.solver_info);
+
+		Eigen::VectorXd residual;
+		laplacian.apply(x, residual);
+		residual -= b;
+		for (const int i : boundary_nodes)
+			residual[i] = 0;
+		const double error = residual.norm();
+		if (error > 1e-4)
+			logger().error("Solver error: {}", error);
+		else
+			logger().debug("Solver error: {}", error);
+
+		sol = x;
+		return true;
+	}
+
+	void State::solve_linear_load_cases(const std::vector<json> &load_cases, Eigen::MatrixXd &sols, Eigen::MatrixXd &pressures)
+	{
+		assert(!problem->is_time_dependent());
+		assert(assembler->is_linear() && !is_contact_enabled());
+
+		if (load_cases.empty())
+			log_and_throw_error("No load cases to solve");
+		if (args.contains("preset_problem"))
+			log_and_throw_error("Load cases replace the loads of /boundary_conditions, they cannot be used with a preset problem");
+		if (assembler->name() == "Bilaplacian")
+			log_and_throw_error("Load cases are not supported for the Bilaplacian");
+
+		// --------------------------------------------------------------------
+
+		std::unique_ptr<polysolve::LinearSolver> solver =
+			polyfem::solver::MixedPrecisionSolver::create(args["solver"]["linear"]);
+		solver->setParameters(args["solver"]["linear"]);
+		logger().info("{} for {} load cases...", solver->name(), load_cases.size());
 
 		StiffnessMatrix A;
 		build_stiffness_mat(A);
 
-		Eigen::VectorXd b = rhs;
+		// --------------------------------------------------------------------
+
+		// loads of every case, the boundaries (and so the Dirichlet and Neumann nodes) are the ones of /boundary_conditions
+		const int n_b_samples = n_boundary_samples();
+		const int n_larger = mixed_assembler != nullptr ? (n_pressure_bases + (use_avg_pressure ? (assembler->is_fluid() ? 1 : 0) : 0)) : 0;
+		const json p_params = problem_parameters();
+
+		igl::Timer timer;
+		timer.start();
+
+		Eigen::MatrixXd rhs_cases(A.rows(), load_cases.size());
+		for (int c = 0; c < load_cases.size(); ++c)
+		{
+			json bc = args["boundary_conditions"];
+			bc.erase("load_cases");
+			for (const char *key : {"rhs", "neumann_boundary", "pressure_boundary"})
+			{
+				if (load_cases[c].contains(key))
+					bc[key] = load_cases[c][key];
+				else
+					bc.erase(key);
+			}
+			bc["root_path"] = root_path();
+
+			std::shared_ptr<assembler::Problem> case_problem;
+			if (!assembler->is_tensor())
+				case_problem = std::make_shared<assembler::GenericScalarProblem>("GenericScalar");
+			else
+				case_problem = std::make_shared<assembler::GenericTensorProblem>("GenericTensor");
+			case_problem->clear();
+			case_problem->set_parameters(bc);
+			case_problem->set_parameters(p_params);
+			case_problem->init(*mesh);
+			case_problem->update_nodes(in_node_to_node);
+
+			const auto rhs_assembler = build_rhs_assembler(n_bases, bases, mass_ass_vals_cache, *case_problem);
+
+			Eigen::MatrixXd case_rhs;
+			rhs_assembler->assemble(mass_matrix_assembler->density(), case_rhs);
+			case_rhs *= -1;
+			rhs_assembler->set_bc(local_boundary, boundary_nodes, n_b_samples, local_neumann_boundary, case_rhs);
+
+			assert(case_rhs.size() + n_larger == A.rows());
+			rhs_cases.col(c).head(case_rhs.size()) = case_rhs;
+			// divergence free
+			rhs_cases.col(c).tail(n_larger).setZero();
+		}
+
+		timer.stop();
+		logger().info(" load cases assembly took {}s", timer.getElapsedTime());
 
 		// --------------------------------------------------------------------
 
-		solve_linear(solver, A, b, args["output"]["advanced"]["spectrum"], sol, pressure);
+		// A is factorized once and every load case is a back substitution.
+		// Mixed problems go through the full Dirichlet solve, as in solve_transient_linear.
+		const bool can_prefactorize = mixed_assembler == nullptr;
+		const int precond_num = (problem->is_scalar() ? 1 : mesh->dimension()) * n_bases;
+
+		timer.start();
+		if (can_prefactorize)
+		{
+			FactorizationMemory memory(timings);
+			StiffnessMatrix A_bc = A;
+			const std::string save_path = args["output"]["data"]["stiffness_mat"];
+			prefactorize(*solver, A_bc, boundary_nodes, precond_num, polysolve_matrix_path(save_path));
+			save_binary_matrix(save_path, A_bc);
+		}
+
+		Eigen::MatrixXd sol, pressure;
+		for (int c = 0; c < load_cases.size(); ++c)
+		{
+			Eigen::VectorXd b = rhs_cases.col(c);
+			if (can_prefactorize)
+			{
+				Eigen::VectorXd x = Eigen::VectorXd::Zero(b.size());
+				dirichlet_solve_prefactorized(*solver, A, b, boundary_nodes, x);
+				sol = x;
+			}
+			else
+			{
+				StiffnessMatrix A_case = A;
+				solve_linear(solver, A_case, b, false, sol, pressure);
+			}
+
+			if (c == 0)
+			{
+				sols.resize(sol.size(), load_cases.size());
+				pressures.resize(pressure.size(), load_cases.size());
+			}
+			sols.col(c) = sol;
+			if (pressure.size() > 0)
+				pressures.col(c) = pressure;
+		}
+		timer.stop();
+		logger().info(" {} load cases solved in {}s", load_cases.size(), timer.getElapsedTime());
+
+		if (can_prefactorize)
+			solver->getInfo(stats.solver_info);
 	}
 
 	void State::solve_transient_linear(const int time_steps, const double t0, const double dt, Eigen::MatrixXd &sol, Eigen::MatrixXd &pressure)
@@ -127,10 +551,18 @@ namespace polyfem
 
 		const bool is_scalar_or_mixed = problem->is_scalar() || mixed_assembler != nullptr;
 
+		if (args["time"]["modal"]["enabled"])
+		{
+			if (is_scalar_or_mixed)
+				log_and_throw_error("Modal time integration is only available for linear elastodynamics");
+			solve_transient_linear_modal(time_steps, t0, dt, sol, pressure);
+			return;
+		}
+
 		// --------------------------------------------------------------------
 
 		auto solver =
-			polysolve::LinearSolver::create(args["solver"]["linear"]["solver"], args["solver"]["linear"]["precond"]);
+			polyfem::solver::MixedPrecisionSolver::create(args["solver"]["linear"]);
 		solver->setParameters(args["solver"]["linear"]);
 		logger().info("{}...", solver->name());
 
@@ -139,8 +571,11 @@ namespace polyfem
 		std::shared_ptr<ImplicitTimeIntegrator> time_integrator;
 		if (is_scalar_or_mixed)
 		{
+			// first order problems are always integrated with BDF, with the parameters of /time/integrator if it is one
+			const json &integrator_args = args["time"]["integrator"];
 			time_integrator = std::make_shared<BDF>();
-			time_integrator->set_parameters(args["time"]);
+			time_integrator->set_parameters(
+				integrator_args.is_object() && integrator_args["type"] == "BDF" ? integrator_args : json{{"steps", 1}});
 			time_integrator->init(sol, Eigen::VectorXd::Zero(sol.size()), Eigen::VectorXd::Zero(sol.size()), dt);
 		}
 		else
@@ -162,77 +597,264 @@ namespace polyfem
 		StiffnessMatrix stiffness;
 		build_stiffness_mat(stiffness);
 
+		// A only depends on the time integrator coefficient (dt, BDF order), it is factorized
+		// again only if that changes. Mixed problems go through the full Dirichlet solve.
+		const bool can_prefactorize = mixed_assembler == nullptr;
+		const int precond_num = (problem->is_scalar() ? 1 : mesh->dimension()) * n_bases;
+		double factorized_coefficient = std::nan("");
+		int n_factorizations = 0;
+
+		// With the Dirichlet conditions applied in place, A keeps its pattern for every coefficient
+		// and only the first factorization analyzes it
+		const bool dirichlet_in_place = args["solver"]["advanced"]["dirichlet_in_place"];
+		bool pattern_analyzed = false;
+
+		StiffnessMatrix A;
+
+		// With adaptive time stepping, steps are rejected and dt changes until tend = t0 + time_steps * dt is reached
+		std::unique_ptr<AdaptiveTimeStepping> adaptive_stepping;
+		if (args["time"]["adaptive"]["enabled"])
+			adaptive_stepping = std::make_unique<AdaptiveTimeStepping>(args["time"]["adaptive"], dt);
+		const double tend = t0 + time_steps * dt;
+		double step_start = t0;
+		int n_steps = 0;
+
 		// --------------------------------------------------------------------
 
-		for (int t = 1; t <= time_steps; ++t)
+		for (int t = 1; adaptive_stepping ? step_start < tend - 1e-12 * dt : t <= time_steps; ++t)
 		{
-			const double time = t0 + t * dt;
+			n_steps = t;
+			const Eigen::MatrixXd sol_prev = adaptive_stepping ? sol : Eigen::MatrixXd();
+			double time, current_dt;
+			while (true)
+			{
+				current_dt = time_integrator->dt();
+				time = adaptive_stepping ? (step_start + current_dt) : (t0 + t * dt);
 
-			StiffnessMatrix A;
-			Eigen::VectorXd b;
-			bool compute_spectrum = args["output"]["advanced"]["spectrum"];
+				Eigen::VectorXd b;
+				double coefficient;
+				bool compute_spectrum = args["output"]["advanced"]["spectrum"];
 
-			if (is_scalar_or_mixed)
-			{
-				solve_data.rhs_assembler->compute_energy_grad(
-					local_boundary, boundary_nodes, mass_matrix_assembler->density(), n_b_samples, local_neumann_boundary, rhs, time,
-					current_rhs);
+				if (is_scalar_or_mixed)
+				{
+					solve_data.rhs_assembler->compute_energy_grad(
+						local_boundary, boundary_nodes, mass_matrix_assembler->density(), n_b_samples, local_neumann_boundary, rhs, time,
+						current_rhs);
+
+					solve_data.rhs_assembler->set_bc(
+						local_boundary, boundary_nodes, n_b_samples, local_neumann_boundary, current_rhs, sol, time);
+
+					if (mixed_assembler != nullptr)
+					{
+						// divergence free
+						int fluid_offset = use_avg_pressure ? (assembler->is_fluid() ? 1 : 0) : 0;
+						current_rhs
+							.block(
+								current_rhs.rows() - n_pressure_bases - use_avg_pressure, 0,
+								n_pressure_bases + use_avg_pressure, current_rhs.cols())
+							.setZero();
+					}
+
+					std::shared_ptr<BDF> bdf = std::dynamic_pointer_cast<BDF>(time_integrator);
+					coefficient = 1 / bdf->beta_dt();
+					if (coefficient != factorized_coefficient)
+						A = mass * coefficient + stiffness;
+					b = (mass * bdf->weighted_sum_x_prevs()) / bdf->beta_dt();
+					for (int i : boundary_nodes)
+						b[i] = 0;
+					b += current_rhs;
+
+					compute_spectrum &= t == time_steps;
+				}
+				else
+				{
+					solve_data.rhs_assembler->assemble(mass_matrix_assembler->density(), current_rhs, time);
+
+					current_rhs *= -1;
+
+					solve_data.rhs_assembler->set_bc(
+						std::vector<LocalBoundary>(), std::vector<int>(), n_b_samples, local_neumann_boundary, current_rhs, sol, time);
 
-				solve_data.rhs_assembler->set_bc(
-					local_boundary, boundary_nodes, n_b_samples, local_neumann_boundary, current_rhs, sol, time);
+					current_rhs *= time_integrator->acceleration_scaling();
+					current_rhs += mass * time_integrator->x_tilde();
 
-				if (mixed_assembler != nullptr)
+					solve_data.rhs_assembler->set_bc(
+						local_boundary, boundary_nodes, n_b_samples, std::vector<LocalBoundary>(), current_rhs, sol, time);
+
+					coefficient = time_integrator->acceleration_scaling();
+					if (coefficient != factorized_coefficient)
+						A = stiffness * coefficient + mass;
+					b = current_rhs;
+
+					compute_spectrum &= t == 1;
+				}
+
+				if (!can_prefactorize || compute_spectrum)
+				{
+					solve_linear(solver, A, b, compute_spectrum, sol, pressure);
+					// the solver now holds the factorization of A with the Dirichlet rows replaced
+					factorized_coefficient = std::nan("");
+					pattern_analyzed = false;
+				}
+				else
 				{
-					// divergence free
-					int fluid_offset = use_avg_pressure ? (assembler->is_fluid() ? 1 : 0) : 0;
-					current_rhs
-						.block(
-							current_rhs.rows() - n_pressure_bases - use_avg_pressure, 0,
-							n_pressure_bases + use_avg_pressure, current_rhs.cols())
-						.setZero();
+					if (coefficient != factorized_coefficient)
+					{
+						FactorizationMemory memory(timings);
+						StiffnessMatrix A_bc = A;
+						if (dirichlet_in_place)
+						{
+							utils::apply_dirichlet_in_place(A_bc, boundary_nodes);
+							const std::string save_path = args["output"]["data"]["stiffness_mat"];
+							if (!save_path.empty())
+								io::write_sparse_matrix(save_path, A_bc);
+
+							if (!pattern_analyzed)
+							{
+								solver->analyzePattern(A_bc, precond_num);
+								pattern_analyzed = true;
+							}
+							solver->factorize(A_bc);
+						}
+						else
+						{
+							const std::string save_path = args["output"]["data"]["stiffness_mat"];
+							prefactorize(*solver, A_bc, boundary_nodes, precond_num, polysolve_matrix_path(save_path));
+							save_binary_matrix(save_path, A_bc);
+						}
+						factorized_coefficient = coefficient;
+						++n_factorizations;
+					}
+
+					Eigen::VectorXd x = sol;
+					if (dirichlet_in_place)
+					{
+						// b holds the Dirichlet values, the symmetric identity rows need them lifted
+						utils::lift_dirichlet_rhs(A, boundary_nodes, b);
+						solver->solve(b, x);
+					}
+					else
+						dirichlet_solve_prefactorized(*solver, A, b, boundary_nodes, x);
+					sol = x;
+
+					solver->getInfo(stats.solver_info);
 				}
 
-				std::shared_ptr<BDF> bdf = std::dynamic_pointer_cast<BDF>(time_integrator);
-				A = mass / bdf->beta_dt() + stiffness;
-				b = (mass * bdf->weighted_sum_x_prevs()) / bdf->beta_dt();
-				for (int i : boundary_nodes)
-					b[i] = 0;
-				b += current_rhs;
+				if (!adaptive_stepping || adaptive_stepping->update(*time_integrator, sol))
+					break;
 
-				compute_spectrum &= t == time_steps;
+				// restart the step from the previous solution with the smaller step size
+				sol = sol_prev;
+				time_integrator->set_dt(std::min(adaptive_stepping->dt(), current_dt));
 			}
+			step_start = time;
+
+			time_integrator->update_quantities(sol);
+
+			// do not step over tend
+			if (adaptive_stepping)
+				time_integrator->set_dt(std::min(adaptive_stepping->dt(), std::max(tend - time, 1e-12 * dt)));
+
+			save_timestep(time, t, t0, current_dt, sol, pressure);
+			if (adaptive_stepping)
+				logger().info("{}  t={}/{} dt={}", t, time, tend, current_dt);
 			else
-			{
-				solve_data.rhs_assembler->assemble(mass_matrix_assembler->density(), current_rhs, time);
+				logger().info("{}/{}  t={}", t, time_steps, time);
+		}
+
+		if (adaptive_stepping)
+			logger().info("Adaptive time stepping: {} steps accepted, {} rejected", n_steps, adaptive_stepping->n_rejections());
+		if (can_prefactorize)
+			logger().debug("{} factorizations for {} time steps", n_factorizations, n_steps);
+
+		time_integrator->save_raw(
+			resolve_output_path(args["output"]["data"]["u_path"]),
+			resolve_output_path(args["output"]["data"]["v_path"]),
+			resolve_output_path(args["output"]["data"]["a_path"]));
+	}
+
+	void State::solve_transient_linear_modal(const int time_steps, const double t0, const double dt, Eigen::MatrixXd &sol, Eigen::MatrixXd &pressure)
+	{
+		assert(problem->is_time_dependent() && !problem->is_scalar() && mixed_assembler == nullptr);
+		assert(assembler->is_linear() && !is_contact_enabled());
+		assert(solve_data.rhs_assembler != nullptr);
 
-				current_rhs *= -1;
+		const json &modal_args = args["time"]["modal"];
+		if (args["time"]["adaptive"]["enabled"])
+			logger().warn("Adaptive time stepping is ignored by the modal time integration");
 
-				solve_data.rhs_assembler->set_bc(
-					std::vector<LocalBoundary>(), std::vector<int>(), n_b_samples, local_neumann_boundary, current_rhs, sol, time);
+		// --------------------------------------------------------------------
 
-				current_rhs *= time_integrator->acceleration_scaling();
-				current_rhs += mass * time_integrator->x_tilde();
+		StiffnessMatrix stiffness;
+		build_stiffness_mat(stiffness);
+
+		igl::Timer timer;
+		timer.start();
+		const solver::ModalBasis modal(
+			stiffness, mass, boundary_nodes, modal_args["n_modes"], modal_args["shift"], modal_args["tolerance"],
+			args["solver"]["linear"], mesh->dimension() * n_bases);
+		timer.stop();
+		logger().info("{} vibration modes computed in {}s ({} Lanczos iterations), frequencies in [{}, {}]Hz",
+					  modal.n_modes(), timer.getElapsedTime(), modal.n_iterations(),
+					  std::sqrt(std::max(modal.eigenvalues().minCoeff(), 0.)) / (2 * M_PI),
+					  std::sqrt(std::max(modal.eigenvalues().maxCoeff(), 0.)) / (2 * M_PI));
+
+		// --------------------------------------------------------------------
 
-				solve_data.rhs_assembler->set_bc(
-					local_boundary, boundary_nodes, n_b_samples, std::vector<LocalBoundary>(), current_rhs, sol, time);
+		// the modal system is diagonal (Phi^T M Phi = I, Phi^T K Phi = diag(lambda)), the time integrator
+		// advances the modal coordinates
+		Eigen::MatrixXd velocity, acceleration;
+		initial_velocity(velocity);
+		initial_acceleration(acceleration);
 
-				A = stiffness * time_integrator->acceleration_scaling() + mass;
-				b = current_rhs;
+		std::shared_ptr<ImplicitTimeIntegrator> time_integrator =
+			ImplicitTimeIntegrator::construct_time_integrator(args["time"]["integrator"]);
+		time_integrator->init(modal.project(sol), modal.project(velocity), modal.project(acceleration), dt);
 
-				compute_spectrum &= t == 1;
+		const int n_b_samples = n_boundary_samples();
+		Eigen::MatrixXd current_rhs = rhs;
+		Eigen::MatrixXd dirichlet;
+
+		for (int t = 1; t <= time_steps; ++t)
+		{
+			const double time = t0 + t * dt;
+
+			// the modes are zero on the Dirichlet nodes, so are the Dirichlet values
+			dirichlet.setZero(sol.rows(), 1);
+			solve_data.rhs_assembler->set_bc(
+				local_boundary, boundary_nodes, n_b_samples, std::vector<LocalBoundary>(), dirichlet, sol, time);
+			for (const int i : boundary_nodes)
+			{
+				if (dirichlet(i) != 0)
+					log_and_throw_error("Modal time integration requires homogeneous Dirichlet boundary conditions, dof {} is {} at t={}", i, dirichlet(i), time);
 			}
 
-			solve_linear(solver, A, b, compute_spectrum, sol, pressure);
+			solve_data.rhs_assembler->assemble(mass_matrix_assembler->density(), current_rhs, time);
+			current_rhs *= -1;
+			solve_data.rhs_assembler->set_bc(
+				std::vector<LocalBoundary>(), std::vector<int>(), n_b_samples, local_neumann_boundary, current_rhs, sol, time);
 
-			time_integrator->update_quantities(sol);
+			// (coef K + M) u = coef f + M x_tilde projected on the modes
+			const double coefficient = time_integrator->acceleration_scaling();
+			const Eigen::VectorXd b = coefficient * modal.project_load(current_rhs) + time_integrator->x_tilde();
+			const Eigen::VectorXd q = b.array() / (coefficient * modal.eigenvalues().array() + 1);
+
+			time_integrator->update_quantities(q);
+			sol = modal.expand(q);
 
 			save_timestep(time, t, t0, dt, sol, pressure);
 			logger().info("{}/{}  t={}", t, time_steps, time);
 		}
 
-		time_integrator->save_raw(
-			resolve_output_path(args["output"]["data"]["u_path"]),
-			resolve_output_path(args["output"]["data"]["v_path"]),
-			resolve_output_path(args["output"]["data"]["a_path"]));
+		// the raw quantities are written in the full space
+		const std::string u_path = resolve_output_path(args["output"]["data"]["u_path"]);
+		const std::string v_path = resolve_output_path(args["output"]["data"]["v_path"]);
+		const std::string a_path = resolve_output_path(args["output"]["data"]["a_path"]);
+		if (!u_path.empty())
+			io::write_matrix(u_path, Eigen::MatrixXd(modal.expand(time_integrator->x_prev())));
+		if (!v_path.empty())
+			io::write_matrix(v_path, Eigen::MatrixXd(modal.expand(time_integrator->v_prev())));
+		if (!a_path.empty())
+			io::write_matrix(a_path, Eigen::MatrixXd(modal.expand(time_integrator->a_prev())));
 	}
 } // namespace polyfem
@@ -0,0 +1,171 @@
+#include <polyfem/State.hpp>
+
+#include <polyfem/solver/forms/ContactForm.hpp>
+#include <polyfem/solver/MultirateNLProblem.hpp>
+#include <polyfem/solver/NonlinearSolver.hpp>
+#include <polyfem/time_integrator/ImplicitTimeIntegrator.hpp>
+#include <polyfem/utils/Timer.hpp>
+#include <polyfem/utils/Logger.hpp>
+
+#include <algorithm>
+
+namespace polyfem
+{
+	using namespace solver;
+	using namespace time_integrator;
+
+	bool State::solve_multirate_substeps(const Eigen::MatrixXd &sol_prev, const double time, const int t, Eigen::MatrixXd &sol)
+	{
+		POLYFEM_SCOPED_TIMER("Multirate substeps");
+
+		assert(solve_data.time_integrator != nullptr);
+		assert(solve_data.nl_problem != nullptr);
+		assert(sol.size() == sol_prev.size());
+
+		const json &multirate_args = args["time"]["multirate"];
+		const int n_substeps = multirate_args["substeps"];
+		if (n_substeps <= 1)
+			return false;
+
+		const int dim = mesh->dimension();
+		const int ndof = sol.size();
+
+		// --------------------------------------------------------------------
+		// Fast region: the nodes with an active contact constraint at the full step solution and
+		// the nodes of the selected bodies, expanded by layers of elements
+		std::vector<bool> is_fast(n_bases, false);
+		if (solve_data.contact_form != nullptr)
+		{
+			Eigen::VectorXd contact_grad;
+			solve_data.contact_form->first_derivative(sol, contact_grad);
+			for (int i = 0; i < contact_grad.size(); ++i)
+			{
+				if (contact_grad(i) != 0)
+					is_fast[i / dim] = true;
+			}
+		}
+
+		const std::vector<int> body_ids = multirate_args["body_ids"];
+		const auto for_each_node = [&](const int e, const std::function<void(int)> &f) {
+			for (const auto &b : bases[e].bases)
+				for (const auto &g : b.global())
+					f(g.index);
+		};
+
+		for (int e = 0; e < bases.size(); ++e)
+		{
+			if (std::find(body_ids.begin(), body_ids.end(), mesh->get_body_id(e)) != body_ids.end())
+				for_each_node(e, [&](const int n) { is_fast[n] = true; });
+		}
+
+		const int n_layers = multirate_args["layers"];
+		for (int l = 0; l < n_layers; ++l)
+		{
+			std::vector<bool> next = is_fast;
+			for (int e = 0; e < bases.size(); ++e)
+			{
+				bool touches = false;
+				for_each_node(e, [&](const int n) { touches = touches || is_fast[n]; });
+				if (touches)
+					for_each_node(e, [&](const int n) { next[n] = true; });
+			}
+			is_fast = std::move(next);
+		}
+
+		// Fixed DoFs of the substeps: the Dirichlet nodes and the slow region
+		assert(std::is_sorted(boundary_nodes.begin(), boundary_nodes.end()));
+		std::vector<int> fixed_dofs;
+		int n_fast = 0;
+		for (int i = 0, k = 0; i < ndof; ++i)
+		{
+			const bool is_dirichlet = k < boundary_nodes.size() && boundary_nodes[k] == i;
+			if (is_dirichlet)
+				++k;
+			if (is_dirichlet || !is_fast[i / dim])
+				fixed_dofs.push_back(i);
+			else
+				++n_fast;
+		}
+		if (n_fast == 0)
+			return false;
+
+		logger().debug("Multirate: {} substeps of {}/{} DoFs", n_substeps, n_fast, ndof);
+
+		// --------------------------------------------------------------------
+		// Restart the time integrator from the beginning of the step with the small step size
+
+		ImplicitTimeIntegrator &time_integrator = *solve_data.time_integrator;
+		const double dt = time_integrator.dt();
+		const double sub_dt = dt / n_substeps;
+
+		std::vector<Eigen::VectorXd> x_prevs, v_prevs, a_prevs;
+		for (int i = 0; i < time_integrator.steps(); ++i)
+		{
+			x_prevs.push_back(time_integrator.x_prevs()[i]);
+			v_prevs.push_back(time_integrator.v_prevs()[i]);
+			a_prevs.push_back(time_integrator.a_prevs()[i]);
+		}
+
+		const auto restore = [&]() {
+			time_integrator.init(x_prevs, v_prevs, a_prevs, dt);
+			solve_data.update_dt();
+			solve_data.nl_problem->update_quantities(time + dt, sol_prev);
+		};
+
+		time_integrator.set_dt(sub_dt);
+		solve_data.update_dt();
+
+		MultirateNLProblem nl_problem(
+			ndof, boundary_nodes, fixed_dofs, local_boundary, n_boundary_samples(),
+			*solve_data.rhs_assembler, time + sub_dt, solve_data.nl_problem->forms());
+
+		if (solve_data.nl_solver == nullptr)
+			solve_data.nl_solver = make_nl_solver<NLProblem>();
+
+		Eigen::VectorXd x = sol_prev;
+		for (int k = 1; k <= n_substeps; ++k)
+		{
+			nl_problem.update_quantities(time + k * sub_dt, x);
+			// the slow region moves linearly to the full step solution
+			nl_problem.set_slow_values(sol_prev + (double(k) / n_substeps) * (sol - sol_prev));
+
+			Eigen::VectorXd reduced = nl_problem.full_to_reduced(x);
+			const Eigen::VectorXd x0 = nl_problem.reduced_to_full(reduced);
+			if (!nl_problem.is_step_collision_free(x, x0))
+			{
+				logger().debug("Multirate: prescribed motion of substep {} is not collision free, keeping the full step", k);
+				restore();
+				return false;
+			}
+
+			try
+			{
+				nl_problem.init(x0);
+				if (nl_problem.uses_lagging())
+					nl_problem.init_lagging(x0);
+				solve_data.update_barrier_stiffness(x0);
+				solve_data.nl_solver->minimize(nl_problem, reduced);
+			}
+			catch (const std::runtime_error &e)
+			{
+				logger().debug("Multirate: substep {} failed ({}), keeping the full step", k, e.what());
+				restore();
+				return false;
+			}
+
+			json info;
+			solve_data.nl_solver->get_info(info);
+			stats.solver_info.push_back({{"type", "multirate"}, {"t", t}, {"substep", k}, {"info", info}});
+
+			x = nl_problem.reduced_to_full(reduced);
+			time_integrator.update_quantities(x);
+		}
+
+		// resample the history at the full step size
+		time_integrator.set_dt(dt);
+		solve_data.update_dt();
+
+		sol = x;
+		return true;
+	}
+} // namespace polyfem
@@ -192,6 +192,9 @@ namespace polyfem
 
 		const int n_b_samples = n_boundary_samples();
 
+		// velocity and pressure of the previous step, the initial guess of the next one
+		Eigen::VectorXd tmp_sol;
+
 		for (int t = 1; t <= time_steps; ++t)
 		{
 			double time = t0 + t * dt;
@@ -212,7 +215,6 @@ namespace polyfem
 				current_rhs.block(prev_size, 0, n_larger, current_rhs.cols()).setZero();
 			}
 
-			Eigen::VectorXd tmp_sol;
 			ns_solver.minimize(
 				n_bases, n_pressure_bases,
 				bases, geom_bases(),
@@ -12,12 +12,15 @@
 #include <polyfem/solver/forms/ALForm.hpp>
 #include <polyfem/solver/forms/RayleighDampingForm.hpp>
 
+#include <polyfem/solver/GeometricMultigridSolver.hpp>
 #include <polyfem/solver/NonlinearSolver.hpp>
 #include <polyfem/solver/LBFGSSolver.hpp>
 #include <polyfem/solver/SparseNewtonDescentSolver.hpp>
+#include <polyfem/solver/TrustRegionSolver.hpp>
 #include <polyfem/solver/NLProblem.hpp>
 #include <polyfem/solver/ALSolver.hpp>
 #include <polyfem/solver/SolveData.hpp>
+#include <polyfem/time_integrator/AdaptiveTimeStepping.hpp>
 #include <polyfem/io/MshWriter.hpp>
 #include <polyfem/io/OBJWriter.hpp>
 #include <polyfem/utils/MatrixUtils.hpp>
@@ -50,6 +53,14 @@ namespace polyfem
 			return std::make_shared<cppoptlib::SparseNewtonDescentSolver<ProblemType>>(
 				args["solver"]["nonlinear"], linear_solver_params, dt);
 		}
+		else if (name == "trust_region" || name == "TrustRegion")
+		{
+			json linear_solver_params = args["solver"]["linear"];
+			if (!linear_solver_type.empty())
+				linear_solver_params["solver"] = linear_solver_type;
+			return std::make_shared<cppoptlib::TrustRegionSolver<ProblemType>>(
+				args["solver"]["nonlinear"], linear_solver_params, dt);
+		}
 		else if (name == "lbfgs" || name == "LBFGS" || name == "L-BFGS")
 		{
 			return std::make_shared<cppoptlib::LBFGSSolver<ProblemType>>(args["solver"]["nonlinear"], dt);
@@ -66,72 +77,168 @@ namespace polyfem
 
 		save_timestep(t0, 0, t0, dt, sol, Eigen::MatrixXd()); // no pressure
 
-		for (int t = 1; t <= time_steps; ++t)
+		const int nullspace_update_interval = args["solver"]["advanced"]["nullspace_update_interval"];
+
+		// the rest mesh does not change between time steps, it is written once and referenced by the restart files
+		output_filter.clear();
+		const std::string rest_mesh_path = args["output"]["data"]["rest_mesh"].get<std::string>();
+		Eigen::MatrixXd rest_V;
+		Eigen::MatrixXi rest_F;
+		uint64_t rest_mesh_fingerprint = 0;
+		if (!rest_mesh_path.empty())
 		{
-			solve_tensor_nonlinear(sol, t);
-			/// Update vertices positions for nullspace vectors.
-			if (true)
-			// {
-			// 	utils::RefElementSampler ref_element_sampler;	//Null, not used	
-			// 	Eigen::MatrixXd fun;
-			// 	Evaluator::interpolate_function(
-			// 	*mesh, mesh->dimension(), bases, disc_orders,
-			// 	polys, polys_3d, ref_element_sampler,
-			// 	test_vertices.rows(), sol, fun, /*use_sampler*/ false, false);
-			// 	std::cout << "fun.rows: " << fun.rows() << std::endl;
-			// 	std::cout << "fun.cols: " << fun.cols() << std::endl;
-			// 	test_vertices=test_vertices+fun;
-			// }
+			build_mesh_matrices(rest_V, rest_F);
+			const std::vector<int> &body_ids = mesh->get_body_ids();
+			rest_mesh_fingerprint = io::OutputFilter::fingerprint(
+				Eigen::Map<const Eigen::VectorXi>(body_ids.data(), body_ids.size()),
+				io::OutputFilter::fingerprint(rest_F, io::OutputFilter::fingerprint(rest_V)));
+		}
+
+		// With adaptive time stepping, steps are rejected and dt changes until tend = t0 + time_steps * dt is reached
+		std::unique_ptr<AdaptiveTimeStepping> adaptive_stepping;
+		if (args["time"]["adaptive"]["enabled"])
+			adaptive_stepping = std::make_unique<AdaptiveTimeStepping>(args["time"]["adaptive"], dt);
+		const double tend = t0 + time_steps * dt;
+		double time = t0;
+		int n_steps = 0;
+
+		const bool multirate = args["time"]["multirate"]["enabled"];
+		if (multirate && adaptive_stepping)
+			logger().warn("Multirate time stepping is ignored with adaptive time stepping");
+
+		for (int t = 1; adaptive_stepping ? time < tend - 1e-12 * dt : t <= time_steps; ++t)
+		{
+			n_steps = t;
+			// true if the time integrator already advanced to sol
+			bool integrated = false;
+			if (adaptive_stepping)
+				solve_adaptive_time_step(*adaptive_stepping, time, t, sol);
+			else
 			{
-				Eigen::MatrixXd sol_reshaped(test_vertices.rows(),test_vertices.cols());
-				Eigen::MatrixXd ori_vertices;
-				Eigen::MatrixXi ori_faces;
-				build_mesh_matrices(ori_vertices,ori_faces);
-				int count=0;
-				for (size_t i = 0; i < test_vertices.rows(); i++)
-					for (size_t j = 0; j < test_vertices.cols(); j++)
-					{
-						sol_reshaped(i,j)=sol(count);
-						count++;
-					}
-				test_vertices=ori_vertices+sol_reshaped;
+				const Eigen::MatrixXd sol_prev = multirate ? sol : Eigen::MatrixXd();
+				extrapolate_initial_guess(sol);
+				solve_tensor_nonlinear(sol, t);
+				if (multirate)
+					integrated = solve_multirate_substeps(sol_prev, time, t, sol);
 			}
-			/////////////
+			const double current_dt = solve_data.time_integrator->dt();
+			time = adaptive_stepping ? (time + current_dt) : (t0 + t * dt);
+
+			// rotations of the near-nullspace are taken about the deformed configuration
+			if (nullspace_update_interval > 0 && t % nullspace_update_interval == 0)
+				update_nullspace_vertices(sol, true);
 
 			{
 				POLYFEM_SCOPED_TIMER("Update quantities");
 
-				solve_data.time_integrator->update_quantities(sol);
+				if (!integrated)
+					solve_data.time_integrator->update_quantities(sol);
 
-				solve_data.nl_problem->update_quantities(t0 + (t + 1) * dt, sol);
+				// do not step over tend
+				if (adaptive_stepping)
+					solve_data.time_integrator->set_dt(std::min(adaptive_stepping->dt(), std::max(tend - time, 1e-12 * dt)));
+
+				solve_data.nl_problem->update_quantities(time + solve_data.time_integrator->dt(), sol);
 
 				solve_data.update_dt();
 				solve_data.update_barrier_stiffness(sol);
 			}
 
-			save_timestep(t0 + dt * t, t, t0, dt, sol, Eigen::MatrixXd()); // no pressure
+			save_timestep(time, t, t0, current_dt, sol, Eigen::MatrixXd()); // no pressure
 
-			logger().info("{}/{}  t={}", t, time_steps, t0 + dt * t);
+			if (adaptive_stepping)
+				logger().info("{}  t={}/{} dt={}", t, time, tend, current_dt);
+			else
+				logger().info("{}/{}  t={}", t, time_steps, time);
 
-			const std::string rest_mesh_path = args["output"]["data"]["rest_mesh"].get<std::string>();
 			if (!rest_mesh_path.empty())
 			{
-				Eigen::MatrixXd V;
-				Eigen::MatrixXi F;
-				build_mesh_matrices(V, F);
-				io::MshWriter::write(
-					resolve_output_path(fmt::format(args["output"]["data"]["rest_mesh"], t)),
-					V, F, mesh->get_body_ids(), mesh->is_volume(), /*binary=*/true);
+				const std::string path = resolve_output_path(fmt::format(args["output"]["data"]["rest_mesh"], t));
+				if (output_filter.changed("rest_mesh", rest_mesh_fingerprint, path))
+					io::MshWriter::write(path, rest_V, rest_F, mesh->get_body_ids(), mesh->is_volume(), /*binary=*/true);
 			}
 
-			solve_data.time_integrator->save_raw(
-				resolve_output_path(fmt::format(args["output"]["data"]["u_path"], t)),
-				resolve_output_path(fmt::format(args["output"]["data"]["v_path"], t)),
-				resolve_output_path(fmt::format(args["output"]["data"]["a_path"], t)));
+			const time_integrator::ImplicitTimeIntegrator &integrator = *solve_data.time_integrator;
+			std::array<std::string, 3> raw_paths;
+			if (raw_output_paths(t, integrator.x_prev(), integrator.v_prev(), integrator.a_prev(), raw_paths))
+			{
+				integrator.save_raw(raw_paths[0], raw_paths[1], raw_paths[2]);
+
+				// save restart file
+				save_restart_json(t0, (time - t0) / t, t);
+			}
+		}
+
+		if (adaptive_stepping)
+			logger().info("Adaptive time stepping: {} steps accepted, {} rejected", n_steps, adaptive_stepping->n_rejections());
+	}
+
+	void State::solve_adaptive_time_step(AdaptiveTimeStepping &stepping, const double time, const int t, Eigen::MatrixXd &sol)
+	{
+		const Eigen::MatrixXd sol_prev = sol;
+		while (true)
+		{
+			bool accepted;
+			try
+			{
+				extrapolate_initial_guess(sol);
+				solve_tensor_nonlinear(sol, t);
+				accepted = stepping.update(*solve_data.time_integrator, sol);
+			}
+			catch (const std::runtime_error &)
+			{
+				// Newton or line search failure (e.g., the CCD step size collapsed)
+				if (!stepping.reduce())
+					throw;
+				accepted = false;
+			}
+
+			if (accepted)
+				return;
+
+			// restart the step from the previous solution with the smaller step size,
+			// the tried step may have been shortened to reach tend
+			sol = sol_prev;
+			const double retry_dt = std::min(stepping.dt(), solve_data.time_integrator->dt());
+			solve_data.time_integrator->set_dt(retry_dt);
+			solve_data.nl_problem->update_quantities(time + retry_dt, sol);
+			solve_data.update_dt();
+			solve_data.update_barrier_stiffness(sol);
+		}
+	}
+
+	void State::extrapolate_initial_guess(Eigen::MatrixXd &sol) const
+	{
+		const std::string initial_guess = args["time"]["initial_guess"];
+		if (initial_guess == "previous")
+			return;
+
+		assert(solve_data.time_integrator != nullptr);
+		const ImplicitTimeIntegrator &time_integrator = *solve_data.time_integrator;
+		assert(sol.size() == time_integrator.x_prev().size());
+
+		Eigen::VectorXd guess;
+		if (initial_guess == "constant_velocity")
+			guess = time_integrator.x_prev() + time_integrator.dt() * time_integrator.v_prev();
+		else if (initial_guess == "constant_acceleration")
+			guess = time_integrator.x_predictor();
+		else
+			log_and_throw_error(fmt::format("Unknown initial guess {}", initial_guess));
 
-			// save restart file
-			save_restart_json(t0, dt, t);
+		if (solve_data.contact_form != nullptr)
+		{
+			POLYFEM_SCOPED_TIMER("Initial guess CCD");
+			const double max_step = solve_data.contact_form->max_step_size(sol, guess);
+			if (max_step < 1)
+			{
+				// stay away from the time of impact, the barrier is infinite there
+				const double alpha = 0.8 * max_step;
+				logger().debug("Shortening the extrapolated initial guess to {:g} (max step {:g})", alpha, max_step);
+				guess = sol + alpha * (guess - sol);
+			}
 		}
+
+		sol = guess;
 	}
 
 	void State::init_nonlinear_tensor_solve(Eigen::MatrixXd &sol, const double t, const bool init_time_integrator)
@@ -175,6 +282,22 @@ namespace polyfem
 
 				const double dt = args["time"]["dt"];
 				solve_data.time_integrator->init(sol, velocity, acceleration, dt);
+
+				// restore the whole history of multi-step integrators
+				if (input_checkpoint.has("n_prevs"))
+				{
+					const int n_prevs = input_checkpoint.get_scalar("n_prevs");
+					std::vector<Eigen::VectorXd> x_prevs, v_prevs, a_prevs;
+					for (int i = 0; i < n_prevs; ++i)
+					{
+						x_prevs.push_back(input_checkpoint.get(fmt::format("x_prev_{}", i)));
+						v_prevs.push_back(input_checkpoint.get(fmt::format("v_prev_{}", i)));
+						a_prevs.push_back(input_checkpoint.get(fmt::format("a_prev_{}", i)));
+					}
+					// a longer history than the one of the current integrator is truncated
+					solve_data.time_integrator->init(x_prevs, v_prevs, a_prevs, input_checkpoint.get_scalar("dt"));
+					solve_data.time_integrator->set_dt(dt);
+				}
 			}
 			assert(solve_data.time_integrator != nullptr);
 		}
@@ -221,8 +344,26 @@ namespace polyfem
 		for (const auto &form : forms)
 			form->set_output_dir(output_dir);
 
+		solve_data.elastic_form->set_incremental_assembly(
+			args["solver"]["advanced"]["incremental_assembly"]["enabled"],
+			args["solver"]["advanced"]["incremental_assembly"]["tolerance"]);
+
 		if (solve_data.contact_form != nullptr)
+		{
 			solve_data.contact_form->save_ccd_debug_meshes = args["output"]["advanced"]["save_ccd_debug_meshes"];
+			solve_data.contact_form->persistent_candidates_margin = args["solver"]["contact"]["CCD"]["persistent_candidates_margin"];
+			solve_data.contact_form->set_full_dof_map(collision_mesh_dof_map);
+
+			// the planes are not part of the collision mesh, only the deformable vertices can touch them
+			if (!obstacle.planes().empty())
+			{
+				std::vector<int> plane_vertices;
+				for (int vi = 0; vi < collision_mesh.num_vertices(); ++vi)
+					if (!is_obstacle_vertex(collision_mesh.to_full_vertex_id(vi)))
+						plane_vertices.push_back(vi);
+				solve_data.contact_form->set_planes(obstacle.planes(), plane_vertices);
+			}
+		}
 
 		// --------------------------------------------------------------------
 		// Initialize nonlinear problems
@@ -231,6 +372,15 @@ namespace polyfem
 		solve_data.nl_problem = std::make_shared<NLProblem>(
 			ndof, boundary_nodes, local_boundary, n_boundary_samples(),
 			*solve_data.rhs_assembler, t, forms);
+		solve_data.nl_problem->set_dirichlet_in_place(args["solver"]["advanced"]["dirichlet_in_place"]);
+		solve_data.nl_problem->set_element_sweep(solve_data.element_sweep);
+		solve_data.nl_solver = nullptr;
+		solve_data.al_warm_start_weight = -1;
+
+		if (input_checkpoint.has("al_weight"))
+			solve_data.al_warm_start_weight = input_checkpoint.get_scalar("al_weight");
+		if (solve_data.contact_form != nullptr && input_checkpoint.has("barrier_stiffness"))
+			solve_data.contact_form->set_weight(input_checkpoint.get_scalar("barrier_stiffness"));
 
 		// --------------------------------------------------------------------
 
@@ -262,7 +412,25 @@ namespace polyfem
 
 		// ---------------------------------------------------------------------
 
-		std::shared_ptr<cppoptlib::NonlinearSolver<NLProblem>> nl_solver = make_nl_solver<NLProblem>();
+		if (solve_data.nl_solver == nullptr)
+		{
+			solve_data.nl_solver = make_nl_solver<NLProblem>();
+
+			// the Newton systems can be solved with the geometric multigrid of the refinement hierarchy
+			const auto newton = std::dynamic_pointer_cast<cppoptlib::SparseNewtonDescentSolver<NLProblem>>(solve_data.nl_solver);
+			if (newton != nullptr && GeometricMultigridSolver::is_enabled(args["solver"]["linear"]))
+			{
+				if (mesh->refinement_levels().empty() || mesh->has_poly() || args["space"]["basis_type"] == "Spline")
+					logger().warn("Geometric multigrid needs Lagrange bases and the refinement levels of the mesh, using the linear solver");
+				else
+				{
+					auto multigrid = std::make_shared<GeometricMultigridSolver>(args["solver"]["linear"]);
+					multigrid->set_prolongations(GeometricMultigridSolver::prolongations(*mesh, assembler->name(), bases, n_bases, mesh->dimension()));
+					newton->set_multigrid(multigrid, boundary_nodes, n_bases * mesh->dimension());
+				}
+			}
+		}
+		std::shared_ptr<cppoptlib::NonlinearSolver<NLProblem>> nl_solver = solve_data.nl_solver;
 
 		ALSolver al_solver(
 			nl_solver, solve_data.al_form,
@@ -272,6 +440,9 @@ namespace polyfem
 			[&](const Eigen::VectorXd &x) {
 				this->solve_data.update_barrier_stiffness(sol);
 			});
+		if (args["solver"]["augmented_lagrangian"]["warm_start"])
+			al_solver.warm_start_weight = solve_data.al_warm_start_weight;
+		al_solver.error_tolerance = args["solver"]["augmented_lagrangian"]["error_tolerance"];
 
 		al_solver.post_subsolve = [&](const double al_weight) {
 			json info;
@@ -282,17 +453,28 @@ namespace polyfem
 				 {"info", info}});
 			if (al_weight > 0)
 				stats.solver_info.back()["weight"] = al_weight;
+			else
+				stats.solver_info.back()["al_saved_steps"] = al_solver.saved_steps();
 			save_subsolve(++subsolve_count, t, sol, Eigen::MatrixXd()); // no pressure
 		};
 
 		Eigen::MatrixXd prev_sol = sol;
 		al_solver.solve(nl_problem, sol, args["solver"]["augmented_lagrangian"]["force"]);
+		if (al_solver.converged_weight() > 0)
+			solve_data.al_warm_start_weight = al_solver.converged_weight();
 
 		// ---------------------------------------------------------------------
 
 		// TODO: Make this more general
 		const double lagging_tol = args["solver"]["contact"].value("friction_convergence_tol", 1e-2);
 
+		// Inexact lagged solves: the gradient tolerance follows the lagging residual, the last solve is exact.
+		// The relative gradient criterion is not comparable with the residual, the solves stay exact with it.
+		const auto stop_criteria = nl_solver->getStopCriteria();
+		const double inexact_ratio = args["solver"]["nonlinear"]["relative_gradient"] ? 0.0 : args["solver"]["contact"]["friction_inexact_ratio"].get<double>();
+		const auto newton = std::dynamic_pointer_cast<cppoptlib::SparseNewtonDescentSolver<NLProblem>>(nl_solver);
+		double inner_tol = stop_criteria.gradNorm; // tolerance of the last solve
+
 		// Lagging loop (start at 1 because we already did an iteration above)
 		bool lagging_converged = !nl_problem.uses_lagging();
 		for (int lag_i = 1; !lagging_converged; lag_i++)
@@ -307,7 +489,9 @@ namespace polyfem
 			nl_problem.gradient(tmp_sol, grad);
 			const double delta_x_norm = (prev_sol - sol).lpNorm<Eigen::Infinity>();
 			logger().debug("Lagging convergence grad_norm={:g} tol={:g} (||Δx||={:g})", grad.norm(), lagging_tol, delta_x_norm);
-			if (grad.norm() <= lagging_tol)
+			// an inexact solve is followed by an exact one before accepting the convergence
+			const bool inexact_solve = inner_tol > stop_criteria.gradNorm;
+			if (grad.norm() <= lagging_tol && !inexact_solve)
 			{
 				logger().info(
 					"Lagging converged in {:d} iteration(s) (grad_norm={:g} tol={:g})",
@@ -316,7 +500,7 @@ namespace polyfem
 				break;
 			}
 
-			if (delta_x_norm <= 1e-12)
+			if (delta_x_norm <= 1e-12 && !inexact_solve)
 			{
 				logger().warn(
 					"Lagging produced tiny update between iterations {:d} and {:d} (grad_norm={:g} grad_tol={:g} ||Δx||={:g} Δx_tol={:g}); stopping early",
@@ -339,7 +523,31 @@ namespace polyfem
 			logger().info("Lagging iteration {:d}:", lag_i + 1);
 			nl_problem.init(sol);
 			solve_data.update_barrier_stiffness(sol);
-			nl_solver->minimize(nl_problem, tmp_sol);
+
+			// loose until the lagging converges or the last allowed solve, the constraint set of the previous
+			// solve is kept by the contact form since sol did not change
+			const bool last_solve = grad.norm() <= lagging_tol || lag_i + 1 >= nl_problem.max_lagging_iterations();
+			inner_tol = last_solve ? stop_criteria.gradNorm : std::max(stop_criteria.gradNorm, inexact_ratio * grad.norm());
+			if (inexact_ratio > 0)
+			{
+				auto criteria = stop_criteria;
+				criteria.gradNorm = inner_tol;
+				nl_solver->setStopCriteria(criteria);
+				if (newton)
+					newton->warm_start_next_solve();
+				logger().debug("Lagged solve tolerance ‖∇f‖={:g}", inner_tol);
+			}
+
+			try
+			{
+				nl_solver->minimize(nl_problem, tmp_sol);
+			}
+			catch (...)
+			{
+				// the solver is kept in solve_data, e.g., for a retry with a smaller time step
+				nl_solver->setStopCriteria(stop_criteria);
+				throw;
+			}
 			prev_sol = sol;
 			sol = nl_problem.reduced_to_full(tmp_sol);
 
@@ -351,8 +559,11 @@ namespace polyfem
 				 {"t", t}, // TODO: null if static?
 				 {"lag_i", lag_i},
 				 {"info", info}});
+			if (inexact_ratio > 0)
+				stats.solver_info.back()["grad_norm_tol"] = inner_tol;
 			save_subsolve(++subsolve_count, t, sol, Eigen::MatrixXd()); // no pressure
 		}
+		nl_solver->setStopCriteria(stop_criteria);
 	}
 
 	////////////////////////////////////////////////////////////////////////
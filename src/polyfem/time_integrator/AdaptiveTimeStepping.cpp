@@ -0,0 +1,137 @@
+#include "AdaptiveTimeStepping.hpp"
+
+#include <polyfem/time_integrator/BDF.hpp>
+#include <polyfem/utils/Logger.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace polyfem::time_integrator
+{
+	AdaptiveTimeStepping::AdaptiveTimeStepping(const json &params, const double dt)
+		: dt_(dt),
+		  min_dt_(params["min_ratio"].get<double>() * dt),
+		  max_dt_(params["max_ratio"].get<double>() * dt),
+		  rel_tol_(params["rel_tol"]),
+		  abs_tol_(params["abs_tol"]),
+		  safety_(params["safety"]),
+		  min_factor_(params["min_factor"]),
+		  max_factor_(params["max_factor"]),
+		  failure_factor_(params["failure_factor"])
+	{
+		assert(dt > 0);
+		if (min_dt_ > dt_ || max_dt_ < dt_)
+			log_and_throw_error("Adaptive time stepping requires min_ratio ≤ 1 ≤ max_ratio");
+		if (min_factor_ <= 0 || min_factor_ >= 1 || max_factor_ <= 1)
+			log_and_throw_error("Adaptive time stepping requires 0 < min_factor < 1 < max_factor");
+		if (failure_factor_ <= 0 || failure_factor_ >= 1)
+			log_and_throw_error("Adaptive time stepping requires 0 < failure_factor < 1");
+	}
+
+	double AdaptiveTimeStepping::error(const ImplicitTimeIntegrator &time_integrator, const Eigen::VectorXd &x) const
+	{
+		return scaled_norm(x - time_integrator.x_predictor(), time_integrator.x_prev(), x);
+	}
+
+	double AdaptiveTimeStepping::scaled_norm(const Eigen::VectorXd &e, const Eigen::VectorXd &x_prev, const Eigen::VectorXd &x) const
+	{
+		assert(x.size() == x_prev.size());
+		assert(e.size() == x.size());
+		if (x.size() == 0)
+			return 0;
+
+		const Eigen::ArrayXd scale = abs_tol_ + rel_tol_ * x.array().abs().max(x_prev.array().abs());
+		return std::sqrt((e.array() / scale).square().mean());
+	}
+
+	double AdaptiveTimeStepping::step_factor(const double error, const double p) const
+	{
+		return error > 0 ? safety_ * std::pow(error, -1 / (p + 1)) : max_factor_;
+	}
+
+	bool AdaptiveTimeStepping::update(const double error, const int order)
+	{
+		// the predictor is second order, the difference is dominated by the least accurate of the two
+		return accept(error, step_factor(error, std::min(order, 2)));
+	}
+
+	bool AdaptiveTimeStepping::update(ImplicitTimeIntegrator &time_integrator, const Eigen::VectorXd &x)
+	{
+		BDF *bdf = dynamic_cast<BDF *>(&time_integrator);
+		const int k = time_integrator.order();
+		// the backward difference needs k + 1 previous solutions
+		if (bdf == nullptr || !bdf->variable_order() || time_integrator.steps() <= k)
+			return update(error(time_integrator, x), k);
+
+		const Eigen::VectorXd &x_prev = time_integrator.x_prev();
+		Eigen::VectorXd e;
+		bdf->local_error(x, k, e);
+		const double error = scaled_norm(e, x_prev, x);
+		double factor = step_factor(error, k);
+
+		if (error <= 1 && ++n_steps_at_order_ > k)
+		{
+			int best = k;
+			if (k > 1)
+			{
+				bdf->local_error(x, k - 1, e);
+				const double lower = step_factor(scaled_norm(e, x_prev, x), k - 1);
+				if (lower > factor)
+				{
+					best = k - 1;
+					factor = lower;
+				}
+			}
+			if (k < bdf->max_order() && time_integrator.steps() > k + 1)
+			{
+				bdf->local_error(x, k + 1, e);
+				const double higher = step_factor(scaled_norm(e, x_prev, x), k + 1);
+				if (higher > factor)
+				{
+					best = k + 1;
+					factor = higher;
+				}
+			}
+
+			if (best != k)
+			{
+				logger().debug("Changing the BDF order from {} to {}", k, best);
+				bdf->set_next_order(best);
+				n_steps_at_order_ = 0;
+			}
+		}
+
+		return accept(error, factor);
+	}
+
+	bool AdaptiveTimeStepping::accept(const double error, const double factor)
+	{
+		const bool accepted = error <= 1 || dt_ <= min_dt_;
+		if (accepted)
+		{
+			if (error > 1)
+				logger().warn("Accepting step with error {} at the minimum time step size {}", error, dt_);
+			dt_ = std::clamp(dt_ * std::clamp(factor, min_factor_, max_factor_), min_dt_, max_dt_);
+		}
+		else
+		{
+			// never grow after a rejection
+			dt_ = std::max(dt_ * std::clamp(factor, min_factor_, 1.0), min_dt_);
+			++n_rejections_;
+			logger().debug("Rejecting step with error {}, retrying with dt={}", error, dt_);
+		}
+
+		return accepted;
+	}
+
+	bool AdaptiveTimeStepping::reduce()
+	{
+		if (dt_ <= min_dt_)
+			return false;
+
+		dt_ = std::max(dt_ * failure_factor_, min_dt_);
+		++n_rejections_;
+		logger().debug("Nonlinear solve failed, retrying with dt={}", dt_);
+		return true;
+	}
+} // namespace polyfem::time_integrator
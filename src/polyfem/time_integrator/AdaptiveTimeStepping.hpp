@@ -0,0 +1,82 @@
+#pragma once
+
+#include <polyfem/Common.hpp>
+#include <polyfem/time_integrator/ImplicitTimeIntegrator.hpp>
+
+#include <Eigen/Core>
+
+namespace polyfem::time_integrator
+{
+	/// Time step size controller on top of an ImplicitTimeIntegrator. The local error of a step is estimated
+	/// from the difference between the implicit solution (corrector) and the explicit predictor
+	/// ImplicitTimeIntegrator::x_predictor, the step is accepted if the scaled error is at most one.
+	/// The next step size is
+	/// \f[
+	/// 	\Delta t' = \Delta t \min(f_{max}, \max(f_{min}, s\, e^{-1/(p+1)}))
+	/// \f]
+	/// where \f$s\f$ is the safety factor and \f$p\f$ the order of the error estimate.
+	/// With a variable order BDF, the error is instead estimated from the backward differences of the history
+	/// (BDF::local_error) and the order of the next steps is the one among \f$k-1, k, k+1\f$ allowing the largest step,
+	/// it is only changed after \f$k+1\f$ steps at the order \f$k\f$.
+	class AdaptiveTimeStepping
+	{
+	public:
+		/// @brief Construct the controller
+		/// @param params parameters of the adaptive time stepping (args["time"]["adaptive"])
+		/// @param dt initial time step size, the limits are relative to it
+		AdaptiveTimeStepping(const json &params, const double dt);
+
+		/// @brief Scaled RMS norm of the local error of a step, must be called before the integrator is updated with x.
+		/// @param time_integrator time integrator holding the history before the step
+		/// @param x solution at the end of the step
+		/// @return scaled error, the step is accurate enough if it is at most one
+		double error(const ImplicitTimeIntegrator &time_integrator, const Eigen::VectorXd &x) const;
+
+		/// @brief Accept or reject a step based on its error and choose the next step size.
+		/// @param error scaled error of the step
+		/// @param order order of the time integrator
+		/// @return true if the step is accepted
+		bool update(const double error, const int order);
+
+		/// @brief Accept or reject the step to x and choose the next step size, and order with a variable order BDF.
+		/// Must be called before the integrator is updated with x.
+		/// @param time_integrator time integrator holding the history before the step
+		/// @param x solution at the end of the step
+		/// @return true if the step is accepted
+		bool update(ImplicitTimeIntegrator &time_integrator, const Eigen::VectorXd &x);
+
+		/// @brief Shrink the step size after a failed nonlinear solve.
+		/// @return false if the step size is already the minimum one
+		bool reduce();
+
+		/// @brief Current step size.
+		double dt() const { return dt_; }
+
+		/// @brief Number of rejected steps.
+		int n_rejections() const { return n_rejections_; }
+
+	private:
+		/// @brief Scaled RMS norm of the error e of the step from x_prev to x
+		double scaled_norm(const Eigen::VectorXd &e, const Eigen::VectorXd &x_prev, const Eigen::VectorXd &x) const;
+
+		/// @brief Unclamped step size factor for an error estimate of order p
+		double step_factor(const double error, const double p) const;
+
+		/// @brief Accept or reject a step and scale the step size by factor
+		bool accept(const double error, const double factor);
+
+		double dt_;
+		double min_dt_;
+		double max_dt_;
+
+		double rel_tol_;
+		double abs_tol_;
+		double safety_;
+		double min_factor_;
+		double max_factor_;
+		double failure_factor_;
+
+		int n_rejections_ = 0;
+		int n_steps_at_order_ = 0; ///< Number of accepted steps since the last order change
+	};
+} // namespace polyfem::time_integrator
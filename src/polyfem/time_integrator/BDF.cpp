@@ -2,6 +2,8 @@
 
 #include <polyfem/utils/Logger.hpp>
 
+#include <algorithm>
+
 namespace polyfem::time_integrator
 {
 	void BDF::set_parameters(const json &params)
@@ -9,6 +11,30 @@ namespace polyfem::time_integrator
 		max_steps_ = params.at("steps");
 		if (max_steps_ < 1 || max_steps_ > 6)
 			log_and_throw_error("BDF steps must be 1 ≤ n ≤ 6");
+
+		variable_order_ = params.value("variable_order", false);
+		order_ = variable_order_ ? 1 : max_steps_;
+		next_order_ = order_;
+	}
+
+	void BDF::set_next_order(const int order)
+	{
+		next_order_ = std::clamp(order, 1, max_steps_);
+	}
+
+	void BDF::local_error(const Eigen::VectorXd &x, const int k, Eigen::VectorXd &error) const
+	{
+		assert(k >= 1 && k < steps());
+
+		// (-1)^j binom(k+1, j)
+		double c = 1;
+		error = x;
+		for (int j = 1; j <= k + 1; ++j)
+		{
+			c *= -double(k + 2 - j) / j;
+			error += c * x_prevs_[j - 1];
+		}
+		error /= k + 1;
 	}
 
 	const std::vector<double> &BDF::alphas(const int i)
@@ -41,73 +67,99 @@ namespace polyfem::time_integrator
 
 	Eigen::VectorXd BDF::weighted_sum_x_prevs() const
 	{
-		const std::vector<double> &alpha = alphas(steps() - 1);
+		Eigen::VectorXd sum;
+		weighted_sum_x_prevs(sum);
+		return sum;
+	}
 
-		Eigen::VectorXd sum = Eigen::VectorXd::Zero(x_prev().size());
-		for (int i = 0; i < steps(); i++)
+	Eigen::VectorXd BDF::weighted_sum_v_prevs() const
+	{
+		Eigen::VectorXd sum;
+		weighted_sum_v_prevs(sum);
+		return sum;
+	}
+
+	void BDF::weighted_sum_x_prevs(Eigen::VectorXd &sum) const
+	{
+		const std::vector<double> &alpha = alphas(order() - 1);
+
+		sum = alpha[0] * x_prevs_[0];
+		for (int i = 1; i < order(); i++)
 		{
 			sum += alpha[i] * x_prevs_[i];
 		}
-
-		return sum;
 	}
 
-	Eigen::VectorXd BDF::weighted_sum_v_prevs() const
+	void BDF::weighted_sum_v_prevs(Eigen::VectorXd &sum) const
 	{
-		const std::vector<double> &alpha = alphas(steps() - 1);
+		const std::vector<double> &alpha = alphas(order() - 1);
 
-		Eigen::VectorXd sum = Eigen::VectorXd::Zero(v_prev().size());
-		for (int i = 0; i < steps(); i++)
+		sum = alpha[0] * v_prevs_[0];
+		for (int i = 1; i < order(); i++)
 		{
 			sum += alpha[i] * v_prevs_[i];
 		}
-
-		return sum;
 	}
 
 	void BDF::update_quantities(const Eigen::VectorXd &x)
 	{
+		// v and a depend on the whole history, they are computed before the oldest values are overwritten
 		const Eigen::VectorXd v = compute_velocity(x);
 		const Eigen::VectorXd a = compute_acceleration(v);
 
+		assert(x_prevs_.capacity() == max_steps());
 		x_prevs_.push_front(x);
 		v_prevs_.push_front(v);
 		a_prevs_.push_front(a);
 
-		if (steps() > max_steps())
-		{
-			x_prevs_.pop_back();
-			v_prevs_.pop_back();
-			a_prevs_.pop_back();
-		}
 		assert(x_prevs_.size() <= max_steps());
 		assert(x_prevs_.size() == v_prevs_.size());
 		assert(x_prevs_.size() == a_prevs_.size());
+
+		order_ = next_order_;
 	}
 
-	Eigen::VectorXd BDF::x_tilde() const
+	void BDF::x_tilde(Eigen::VectorXd &out) const
 	{
-		const double beta = betas(steps() - 1);
-		return weighted_sum_x_prevs() + beta * dt() * weighted_sum_v_prevs();
+		const std::vector<double> &alpha = alphas(order() - 1);
+		const double beta_dt = betas(order() - 1) * dt();
+
+		out = alpha[0] * (x_prevs_[0] + beta_dt * v_prevs_[0]);
+		for (int i = 1; i < order(); i++)
+		{
+			out += alpha[i] * (x_prevs_[i] + beta_dt * v_prevs_[i]);
+		}
 	}
 
 	Eigen::VectorXd BDF::compute_velocity(const Eigen::VectorXd &x) const
 	{
-		const Eigen::VectorXd sum_x_prev = weighted_sum_x_prevs();
-		const double beta = betas(steps() - 1);
-		return (x - sum_x_prev) / (beta * dt());
+		const std::vector<double> &alpha = alphas(order() - 1);
+
+		Eigen::VectorXd v = x;
+		for (int i = 0; i < order(); i++)
+		{
+			v -= alpha[i] * x_prevs_[i];
+		}
+		v /= beta_dt();
+		return v;
 	}
 
 	Eigen::VectorXd BDF::compute_acceleration(const Eigen::VectorXd &v) const
 	{
-		const Eigen::VectorXd sum_v_prev = weighted_sum_v_prevs();
-		const double beta = betas(steps() - 1);
-		return (v - sum_v_prev) / (beta * dt());
+		const std::vector<double> &alpha = alphas(order() - 1);
+
+		Eigen::VectorXd a = v;
+		for (int i = 0; i < order(); i++)
+		{
+			a -= alpha[i] * v_prevs_[i];
+		}
+		a /= beta_dt();
+		return a;
 	}
 
 	double BDF::acceleration_scaling() const
 	{
-		const double beta = betas(steps() - 1);
+		const double beta = betas(order() - 1);
 		return beta * beta * dt() * dt();
 	}
 
@@ -118,7 +170,7 @@ namespace polyfem::time_integrator
 
 	double BDF::beta_dt() const
 	{
-		const double beta = betas(steps() - 1);
+		const double beta = betas(order() - 1);
 		return beta * dt();
 	}
 } // namespace polyfem::time_integrator
@@ -9,6 +9,8 @@ namespace polyfem::time_integrator
 	/// 	x^{t+1} = \left(\sum_{i=0}^{n-1} \alpha_{i} x^{t-i}\right)+ \Delta t \beta v^{t+1}\newline
 	/// 	v^{t+1} = \left(\sum_{i=0}^{n-1} \alpha_{i} v^{t-i}\right)+ \Delta t \beta a^{t+1}
 	/// \f]
+	/// With `variable_order`, the order starts at one and is changed by set_next_order (see AdaptiveTimeStepping),
+	/// one more step than the maximum order is kept in the history to estimate the error of the next order.
 	/// @see https://en.wikipedia.org/wiki/Backward_differentiation_formula
 	class BDF : public ImplicitTimeIntegrator
 	{
@@ -16,7 +18,7 @@ namespace polyfem::time_integrator
 		BDF() {}
 
 		/// @brief Set the number of steps parameters from a json object.
-		/// @param params json containing `{"steps": 1}`
+		/// @param params json containing `{"steps": 1}` and optionally `{"variable_order": false}`
 		void set_parameters(const json &params) override;
 
 		/// @brief Update the time integration quantities (i.e., \f$x\f$, \f$v\f$, and \f$a\f$).
@@ -27,8 +29,9 @@ namespace polyfem::time_integrator
 		/// \f[
 		/// 	\tilde{x} = \left(\sum_{i=0}^{n-1} \alpha_i x^{t-i}\right) + \beta \Delta t \left(\sum_{i=0}^{n-1} \alpha_i v^{t-i}\right)
 		/// \f]
-		/// @return value for \f$\tilde{x}\f$
-		Eigen::VectorXd x_tilde() const override;
+		/// @param[out] out value for \f$\tilde{x}\f$
+		void x_tilde(Eigen::VectorXd &out) const override;
+		using ImplicitTimeIntegrator::x_tilde;
 
 		/// @brief Compute the current velocity given the current solution and using the stored previous solution(s).
 		/// \f[
@@ -58,6 +61,29 @@ namespace polyfem::time_integrator
 		/// \f]
 		double dv_dx() const override;
 
+		/// @brief Order of accuracy, equal to the number of steps used by the formula.
+		int order() const override { return std::min(steps(), order_); }
+
+		/// @brief Maximum order, in [1, 6].
+		int max_order() const { return max_steps_; }
+
+		/// @brief True if the order is chosen by the time step controller.
+		bool variable_order() const { return variable_order_; }
+
+		/// @brief Change the order after the next update_quantities.
+		/// @param order new order, clamped to [1, max_order()]
+		void set_next_order(const int order);
+
+		/// @brief Estimate of the local error of the order k formula for the step to x, from the backward difference
+		/// \f[
+		/// 	\frac{1}{k+1} \nabla^{k+1} x^{t+1}
+		/// \f]
+		/// of the history, which is equally spaced (see set_dt).
+		/// @param x solution at the end of the step
+		/// @param k order, requires steps() > k
+		/// @param[out] error local error estimate
+		void local_error(const Eigen::VectorXd &x, const int k, Eigen::VectorXd &error) const;
+
 		/// @brief Compute \f$\beta\Delta t\f$
 		double beta_dt() const;
 
@@ -73,13 +99,25 @@ namespace polyfem::time_integrator
 		/// \f]
 		Eigen::VectorXd weighted_sum_v_prevs() const;
 
+		/// @brief Compute the weighted sum of the previous solutions in place.
+		/// @param[out] sum weighted sum, the storage is reused if it has the right size
+		void weighted_sum_x_prevs(Eigen::VectorXd &sum) const;
+
+		/// @brief Compute the weighted sum of the previous velocities in place.
+		/// @param[out] sum weighted sum, the storage is reused if it has the right size
+		void weighted_sum_v_prevs(Eigen::VectorXd &sum) const;
+
 	protected:
 		/// @brief Get the maximum number of steps to use for integration.
-		int max_steps() const override { return max_steps_; }
+		int max_steps() const override { return variable_order_ ? max_steps_ + 1 : max_steps_; }
 
 		/// @brief The maximum number of steps to use for integration.
 		int max_steps_ = 1;
 
+		bool variable_order_ = false; ///< If true, the order is changed by set_next_order
+		int order_ = 1;               ///< Order of the formula, if the history is long enough
+		int next_order_ = 1;          ///< Order after the next update_quantities
+
 		/// @brief Retrieve the alphas used for BDF with `i` steps.
 		/// @param i number of steps
 		/// @see https://en.wikipedia.org/wiki/Backward_differentiation_formula#General_formula
@@ -0,0 +1,129 @@
+#include "CentralDifference.hpp"
+
+#include <polyfem/io/MatrixIO.hpp>
+#include <polyfem/utils/Logger.hpp>
+
+#include <cmath>
+#include <limits>
+
+namespace polyfem::time_integrator
+{
+	void CentralDifference::init(
+		const Eigen::VectorXd &x,
+		const Eigen::VectorXd &v,
+		const Eigen::VectorXd &lumped_mass,
+		const std::vector<int> &fixed_dofs,
+		const double dt)
+	{
+		assert(x.size() == v.size() && x.size() == lumped_mass.size());
+
+		x_ = x;
+		x_prev_ = x;
+		v_ = v;
+		a_.setZero(x.size());
+		fixed_dofs_ = fixed_dofs;
+
+		std::vector<bool> is_fixed(x.size(), false);
+		for (const int d : fixed_dofs_)
+			is_fixed[d] = true;
+
+		inv_mass_.resize(x.size());
+		for (int d = 0; d < x.size(); ++d)
+		{
+			if (is_fixed[d])
+			{
+				inv_mass_[d] = 0;
+				v_[d] = 0;
+			}
+			else if (lumped_mass[d] > 0)
+				inv_mass_[d] = 1 / lumped_mass[d];
+			else
+				log_and_throw_error("Explicit time integration requires a positive lumped mass, DoF {} has mass {}", d, lumped_mass[d]);
+		}
+
+		set_dt(dt);
+	}
+
+	void CentralDifference::set_dt(const double dt)
+	{
+		assert(dt > 0);
+		dt_ = dt;
+	}
+
+	void CentralDifference::init_acceleration(const Eigen::VectorXd &force)
+	{
+		a_ = inv_mass_.cwiseProduct(force);
+	}
+
+	void CentralDifference::update_position()
+	{
+		x_prev_ = x_;
+		x_ += dt_ * (v_ + (0.5 * dt_) * a_);
+	}
+
+	void CentralDifference::set_prescribed(const Eigen::VectorXd &values)
+	{
+		assert(values.size() == x_.size());
+		for (const int d : fixed_dofs_)
+		{
+			x_[d] = values[d];
+			v_[d] = (x_[d] - x_prev_[d]) / dt_;
+		}
+	}
+
+	void CentralDifference::update_velocity(const Eigen::VectorXd &force)
+	{
+		// the fixed DoFs have a zero inverse mass, so their velocity is left untouched
+		v_ += (0.5 * dt_) * a_;
+		a_ = inv_mass_.cwiseProduct(force);
+		v_ += (0.5 * dt_) * a_;
+	}
+
+	void CentralDifference::save_raw(const std::string &x_path, const std::string &v_path, const std::string &a_path) const
+	{
+		if (!x_path.empty())
+			io::write_matrix(x_path, x_);
+
+		if (!v_path.empty())
+			io::write_matrix(v_path, v_);
+
+		if (!a_path.empty())
+			io::write_matrix(a_path, a_);
+	}
+
+	double CentralDifference::stable_dt(
+		const std::function<void(const Eigen::VectorXd &, Eigen::VectorXd &)> &stiffness_product,
+		const int max_iterations) const
+	{
+		// power iterations on the symmetric M^{-1/2} K M^{-1/2}
+		const Eigen::VectorXd scale = inv_mass_.cwiseSqrt();
+
+		Eigen::VectorXd y = scale.cwiseProduct(Eigen::VectorXd::LinSpaced(scale.size(), 1, 2));
+		if (y.norm() == 0)
+			return std::numeric_limits<double>::infinity();
+		y.normalize();
+
+		Eigen::VectorXd Ky;
+		double lambda = 0;
+		for (int i = 0; i < max_iterations; ++i)
+		{
+			stiffness_product(scale.cwiseProduct(y), Ky);
+			const Eigen::VectorXd z = scale.cwiseProduct(Ky);
+
+			const double new_lambda = y.dot(z);
+			const double z_norm = z.norm();
+			if (z_norm == 0)
+				break;
+			y = z / z_norm;
+
+			const bool converged = std::abs(new_lambda - lambda) <= 1e-4 * std::abs(new_lambda);
+			lambda = new_lambda;
+			if (converged)
+				break;
+		}
+
+		if (lambda <= 0)
+			return std::numeric_limits<double>::infinity();
+		return 2 / std::sqrt(lambda);
+	}
+} // namespace polyfem::time_integrator
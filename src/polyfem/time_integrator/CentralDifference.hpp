@@ -0,0 +1,89 @@
+#pragma once
+
+#include <polyfem/Common.hpp>
+
+#include <Eigen/Core>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace polyfem::time_integrator
+{
+	/// Explicit central difference (velocity Verlet) time integrator of a second order ODE \f$M a = f(x)\f$
+	/// with a lumped (diagonal) mass matrix, so each step only needs one force evaluation and no linear solve.
+	/// \f[
+	/// 	x^{t+1} = x^t + \Delta t v^t + \frac{\Delta t^2}{2} a^t\newline
+	/// 	a^{t+1} = M^{-1} f(x^{t+1})\newline
+	/// 	v^{t+1} = v^t + \frac{\Delta t}{2} (a^t + a^{t+1})
+	/// \f]
+	/// @see https://en.wikipedia.org/wiki/Verlet_integration#Velocity_Verlet
+	class CentralDifference
+	{
+	public:
+		CentralDifference() {}
+
+		/// @brief Initialize the time integrator.
+		/// @param x current solution
+		/// @param v current velocity
+		/// @param lumped_mass diagonal of the lumped mass matrix
+		/// @param fixed_dofs prescribed DoFs (e.g., Dirichlet), their acceleration is zero and they are moved with set_prescribed
+		/// @param dt time step size
+		void init(
+			const Eigen::VectorXd &x,
+			const Eigen::VectorXd &v,
+			const Eigen::VectorXd &lumped_mass,
+			const std::vector<int> &fixed_dofs,
+			const double dt);
+
+		/// @brief Set the acceleration from the force at the current solution, used to start the integration.
+		/// @param force force at the current solution
+		void init_acceleration(const Eigen::VectorXd &force);
+
+		/// @brief Move the solution to the next time step with the current velocity and acceleration.
+		void update_position();
+
+		/// @brief Overwrite the prescribed DoFs of the new solution, their velocity is the finite difference of the step.
+		/// @param values full size vector with the prescribed values of the fixed DoFs
+		void set_prescribed(const Eigen::VectorXd &values);
+
+		/// @brief Update the acceleration and velocity from the force at the new solution.
+		/// @param force force at the new solution
+		void update_velocity(const Eigen::VectorXd &force);
+
+		/// @brief Critical time step size \f$2 / \sqrt{\lambda_{max}(M^{-1}K)}\f$, \f$\lambda_{max}\f$ is estimated by power iterations over the free DoFs.
+		/// @note Power iterations converge from below, the returned value is slightly larger than the exact one so it should be scaled by a CFL factor < 1.
+		/// @param[in] stiffness_product computes the product of the stiffness matrix with a vector
+		/// @param[in] max_iterations maximum number of power iterations
+		/// @return critical time step size, infinity if the stiffness has no positive eigenvalue
+		double stable_dt(
+			const std::function<void(const Eigen::VectorXd &, Eigen::VectorXd &)> &stiffness_product,
+			const int max_iterations = 100) const;
+
+		/// @brief Save the current solution, velocity, and acceleration to files, empty paths are skipped.
+		void save_raw(const std::string &x_path, const std::string &v_path, const std::string &a_path) const;
+
+		/// @brief Access the time step size.
+		const double &dt() const { return dt_; }
+		/// @brief Set the time step size.
+		void set_dt(const double dt);
+
+		/// @brief Current solution.
+		const Eigen::VectorXd &x() const { return x_; }
+		/// @brief Current velocity.
+		const Eigen::VectorXd &v() const { return v_; }
+		/// @brief Current acceleration.
+		const Eigen::VectorXd &a() const { return a_; }
+
+	private:
+		double dt_ = 1;
+
+		Eigen::VectorXd x_;
+		Eigen::VectorXd x_prev_;
+		Eigen::VectorXd v_;
+		Eigen::VectorXd a_;
+		/// inverse of the lumped mass, zero for the fixed DoFs
+		Eigen::VectorXd inv_mass_;
+		std::vector<int> fixed_dofs_;
+	};
+} // namespace polyfem::time_integrator
@@ -10,9 +10,9 @@ namespace polyfem::time_integrator
 		set_x_prev(x);
 	}
 
-	Eigen::VectorXd ImplicitEuler::x_tilde() const
+	void ImplicitEuler::x_tilde(Eigen::VectorXd &out) const
 	{
-		return x_prev() + dt() * v_prev();
+		out = x_prev() + dt() * v_prev();
 	}
 
 	Eigen::VectorXd ImplicitEuler::compute_velocity(const Eigen::VectorXd &x) const
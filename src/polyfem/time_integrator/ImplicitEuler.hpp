@@ -27,8 +27,9 @@ namespace polyfem::time_integrator
 		/// \f[
 		/// 	\tilde{x} = x^t + \Delta t v^t
 		/// \f]
-		/// @return value for \f$\tilde{x}\f$
-		Eigen::VectorXd x_tilde() const override;
+		/// @param[out] out value for \f$\tilde{x}\f$
+		void x_tilde(Eigen::VectorXd &out) const override;
+		using ImplicitTimeIntegrator::x_tilde;
 
 		/// @brief Compute the current velocity given the current solution and using the stored previous solution(s).
 		/// \f[
@@ -16,9 +16,9 @@ namespace polyfem::time_integrator
 		set_x_prev(x);
 	}
 
-	Eigen::VectorXd ImplicitNewmark::x_tilde() const
+	void ImplicitNewmark::x_tilde(Eigen::VectorXd &out) const
 	{
-		return x_prev() + dt() * (v_prev() + dt() * (0.5 - beta()) * a_prev());
+		out = x_prev() + dt() * (v_prev() + dt() * (0.5 - beta()) * a_prev());
 	}
 
 	Eigen::VectorXd ImplicitNewmark::compute_velocity(const Eigen::VectorXd &x) const
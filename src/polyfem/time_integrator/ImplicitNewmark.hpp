@@ -27,8 +27,9 @@ namespace polyfem::time_integrator
 		/// \f[
 		/// 	\tilde{x} = x^t + \Delta t (v^t + (0.5 - \beta) \Delta t a^t)
 		/// \f]
-		/// @return value for \f$\tilde{x}\f$
-		Eigen::VectorXd x_tilde() const override;
+		/// @param[out] out value for \f$\tilde{x}\f$
+		void x_tilde(Eigen::VectorXd &out) const override;
+		using ImplicitTimeIntegrator::x_tilde;
 
 		/// @brief Compute the current velocity given the current solution and using the stored previous solution(s).
 		/// \f[
@@ -60,6 +61,9 @@ namespace polyfem::time_integrator
 		/// \f]
 		double dv_dx() const override;
 
+		/// @brief Second order accurate for \f$\gamma = 1/2\f$.
+		int order() const override { return 2; }
+
 		/// @brief \f$\beta\f$ parameter for blending accelerations in the solution update.
 		double beta() const { return beta_; }
 		/// @brief \f$\gamma\f$ parameter for blending accelerations in the velocity update.
@@ -16,13 +16,13 @@ namespace polyfem
 	{
 		void ImplicitTimeIntegrator::init(const Eigen::VectorXd &x_prev, const Eigen::VectorXd &v_prev, const Eigen::VectorXd &a_prev, double dt)
 		{
-			x_prevs_.clear();
+			x_prevs_.reset(max_steps());
 			x_prevs_.push_front(x_prev);
 
-			v_prevs_.clear();
+			v_prevs_.reset(max_steps());
 			v_prevs_.push_front(v_prev);
 
-			a_prevs_.clear();
+			a_prevs_.reset(max_steps());
 			a_prevs_.push_front(a_prev);
 
 			assert(dt > 0);
@@ -35,13 +35,13 @@ namespace polyfem
 			const std::vector<Eigen::VectorXd> &a_prevs,
 			double dt)
 		{
-			assert(x_prevs.size() > 0 && x_prevs.size() <= max_steps());
+			assert(x_prevs.size() > 0);
 			assert(x_prevs.size() == v_prevs.size());
 			assert(x_prevs.size() == a_prevs.size());
 
-			x_prevs_.clear();
-			v_prevs_.clear();
-			a_prevs_.clear();
+			x_prevs_.reset(max_steps());
+			v_prevs_.reset(max_steps());
+			a_prevs_.reset(max_steps());
 
 			const int n = std::min(int(x_prevs.size()), max_steps());
 			for (int i = 0; i < n; i++)
@@ -55,6 +55,60 @@ namespace polyfem
 			dt_ = dt;
 		}
 
+		void ImplicitTimeIntegrator::set_dt(const double dt)
+		{
+			assert(dt > 0);
+			if (dt == dt_)
+				return;
+
+			// Lagrange interpolation of the history (stored at times -i dt_) at the times -j dt
+			const int n = steps();
+			if (n > 1)
+			{
+				const double oldest = -(n - 1) * dt_;
+				std::vector<Eigen::VectorXd> x_prevs, v_prevs, a_prevs;
+				for (int j = 0; j < n && -j * dt >= oldest * (1 + 1e-12); ++j)
+				{
+					const double s = -j * dt;
+					Eigen::VectorXd x = Eigen::VectorXd::Zero(x_prev().size());
+					Eigen::VectorXd v = Eigen::VectorXd::Zero(v_prev().size());
+					Eigen::VectorXd a = Eigen::VectorXd::Zero(a_prev().size());
+					for (int i = 0; i < n; ++i)
+					{
+						double l = 1;
+						for (int k = 0; k < n; ++k)
+						{
+							if (k != i)
+								l *= (s + k * dt_) / ((k - i) * dt_);
+						}
+						x += l * x_prevs_[i];
+						v += l * v_prevs_[i];
+						a += l * a_prevs_[i];
+					}
+					x_prevs.push_back(x);
+					v_prevs.push_back(v);
+					a_prevs.push_back(a);
+				}
+
+				x_prevs_.clear();
+				v_prevs_.clear();
+				a_prevs_.clear();
+				for (int j = 0; j < x_prevs.size(); ++j)
+				{
+					x_prevs_.push_back(x_prevs[j]);
+					v_prevs_.push_back(v_prevs[j]);
+					a_prevs_.push_back(a_prevs[j]);
+				}
+			}
+
+			dt_ = dt;
+		}
+
+		Eigen::VectorXd ImplicitTimeIntegrator::x_predictor() const
+		{
+			return x_prev() + dt() * (v_prev() + 0.5 * dt() * a_prev());
+		}
+
 		void ImplicitTimeIntegrator::save_raw(const std::string &x_path, const std::string &v_path, const std::string &a_path) const
 		{
 			if (!x_path.empty())
@@ -1,12 +1,12 @@
 #pragma once
 
 #include <polyfem/Common.hpp>
+#include <polyfem/time_integrator/RingBuffer.hpp>
 
 #include <Eigen/Core>
 
 #include <map>
 #include <vector>
-#include <deque>
 
 namespace polyfem::time_integrator
 {
@@ -29,6 +29,7 @@ namespace polyfem::time_integrator
 		virtual void init(const Eigen::VectorXd &x_prev, const Eigen::VectorXd &v_prev, const Eigen::VectorXd &a_prev, double dt);
 
 		/// @brief Initialize the time integrator with the previous values for \f$x\f$, \f$v\f$, and \f$a\f$.
+		/// The most recent values come first, the ones older than max_steps() are ignored.
 		/// @param x_prevs vector of previous solutions
 		/// @param v_prevs vector of previous velocities
 		/// @param a_prevs vector of previous accelerations
@@ -45,7 +46,16 @@ namespace polyfem::time_integrator
 
 		/// @brief Compute the predicted solution to be used in the inertia term \f$(x-\tilde{x})^TM(x-\tilde{x})\f$.
 		/// @return value for \f$\tilde{x}\f$
-		virtual Eigen::VectorXd x_tilde() const = 0;
+		Eigen::VectorXd x_tilde() const
+		{
+			Eigen::VectorXd out;
+			x_tilde(out);
+			return out;
+		}
+
+		/// @brief Compute the predicted solution in place, the storage of out is reused if it has the right size.
+		/// @param[out] out value for \f$\tilde{x}\f$
+		virtual void x_tilde(Eigen::VectorXd &out) const = 0;
 
 		/// @brief Compute the current velocity given the current solution and using the stored previous solution(s).
 		/// @param x current solution
@@ -67,6 +77,21 @@ namespace polyfem::time_integrator
 		/// @brief Access the time step size.
 		const double &dt() const { return dt_; }
 
+		/// @brief Change the time step size. The history of multi-step integrators is interpolated at the
+		/// new spacing, samples that would need an extrapolation are dropped (the order is rebuilt over the next steps).
+		/// @param dt new time step size
+		void set_dt(const double dt);
+
+		/// @brief Explicit prediction of the next solution from the most recent values.
+		/// \f[
+		/// 	x^p = x^t + \Delta t v^t + \frac{\Delta t^2}{2} a^t
+		/// \f]
+		/// @return value for \f$x^p\f$
+		Eigen::VectorXd x_predictor() const;
+
+		/// @brief Order of accuracy of the integrator, used to adapt the time step size.
+		virtual int order() const { return 1; }
+
 		/// @brief Save the values of \$x\$, \f$v\f$, and \f$a\f$.
 		/// @param x_path path for the output file containing \f$x\f$, if the extension is `.txt`
 		///               then it will write an ASCII file else if the extension is `.bin` it will
@@ -92,11 +117,11 @@ namespace polyfem::time_integrator
 		const Eigen::VectorXd &a_prev() const { return a_prevs_.front(); }
 
 		/// @brief Get the (relevant) history of previous solution value.
-		const std::deque<Eigen::VectorXd> &x_prevs() const { return x_prevs_; }
+		const RingBuffer &x_prevs() const { return x_prevs_; }
 		/// @brief Get the (relevant) history of previous velocity value.
-		const std::deque<Eigen::VectorXd> &v_prevs() const { return v_prevs_; }
+		const RingBuffer &v_prevs() const { return v_prevs_; }
 		/// @brief Get the (relevant) history of previous acceleration value.
-		const std::deque<Eigen::VectorXd> &a_prevs() const { return a_prevs_; }
+		const RingBuffer &a_prevs() const { return a_prevs_; }
 
 		/// @brief Get the current number of steps to use for integration.
 		int steps() const { return x_prevs_.size(); }
@@ -110,11 +135,12 @@ namespace polyfem::time_integrator
 		double dt_ = 1;
 
 		/// Store the necessary previous values of the solution for single or multi-step integration.
-		std::deque<Eigen::VectorXd> x_prevs_;
+		/// The capacity is max_steps(), so updating the history reuses the storage of the dropped values.
+		RingBuffer x_prevs_;
 		/// Store the necessary previous values of the velocity for single or multi-step integration.
-		std::deque<Eigen::VectorXd> v_prevs_;
+		RingBuffer v_prevs_;
 		/// Store the necessary previous values of the acceleration for single or multi-step integration.
-		std::deque<Eigen::VectorXd> a_prevs_;
+		RingBuffer a_prevs_;
 
 		/// Convenience functions for setting the most recent previous solution.
 		void set_x_prev(const Eigen::VectorXd &x_prev) { x_prevs_.front() = x_prev; }
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <Eigen/Core>
+
+#include <cassert>
+#include <vector>
+
+namespace polyfem::time_integrator
+{
+	/// Fixed capacity history of vectors, with the most recent one first. The slots are reused in a
+	/// circular way, so pushing a vector of the same size as the dropped one does not allocate.
+	class RingBuffer
+	{
+	public:
+		RingBuffer() {}
+
+		/// @brief Remove all the vectors and change the capacity, the storage is kept when the capacity is the same.
+		/// @param capacity maximum number of vectors
+		void reset(const int capacity)
+		{
+			assert(capacity > 0);
+			slots_.resize(capacity);
+			head_ = 0;
+			size_ = 0;
+		}
+
+		/// @brief Remove all the vectors, the storage is kept.
+		void clear()
+		{
+			head_ = 0;
+			size_ = 0;
+		}
+
+		int capacity() const { return slots_.size(); }
+		int size() const { return size_; }
+		bool empty() const { return size_ == 0; }
+
+		/// @brief Access the i-th most recent vector.
+		Eigen::VectorXd &operator[](const int i)
+		{
+			assert(i >= 0 && i < size_);
+			return slots_[(head_ + i) % capacity()];
+		}
+		const Eigen::VectorXd &operator[](const int i) const
+		{
+			assert(i >= 0 && i < size_);
+			return slots_[(head_ + i) % capacity()];
+		}
+
+		Eigen::VectorXd &front() { return (*this)[0]; }
+		const Eigen::VectorXd &front() const { return (*this)[0]; }
+		Eigen::VectorXd &back() { return (*this)[size_ - 1]; }
+		const Eigen::VectorXd &back() const { return (*this)[size_ - 1]; }
+
+		/// @brief Make room for a new most recent vector, dropping the oldest one if the buffer is full.
+		/// @return slot of the new vector, holding stale values to be overwritten in place
+		Eigen::VectorXd &push_front()
+		{
+			assert(capacity() > 0);
+			head_ = (head_ + capacity() - 1) % capacity();
+			if (size_ < capacity())
+				++size_;
+			return slots_[head_];
+		}
+
+		/// @brief Copy a new most recent vector, dropping the oldest one if the buffer is full.
+		void push_front(const Eigen::VectorXd &x) { push_front() = x; }
+
+		/// @brief Copy a vector older than all the stored ones, the buffer must not be full.
+		void push_back(const Eigen::VectorXd &x)
+		{
+			assert(size_ < capacity());
+			slots_[(head_ + size_) % capacity()] = x;
+			++size_;
+		}
+
+		/// @brief Drop the oldest vector.
+		void pop_back()
+		{
+			assert(size_ > 0);
+			--size_;
+		}
+
+	private:
+		std::vector<Eigen::VectorXd> slots_;
+		int head_ = 0;
+		int size_ = 0;
+	};
+} // namespace polyfem::time_integrator
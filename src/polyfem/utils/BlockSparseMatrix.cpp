@@ -0,0 +1,115 @@
+#include "BlockSparseMatrix.hpp"
+
+#include <polyfem/utils/MaybeParallelFor.hpp>
+
+#include <algorithm>
+
+namespace polyfem::utils
+{
+	void BlockSparseMatrix::init(const int block_size, const int n_block_rows, std::vector<std::pair<int, int>> &pattern)
+	{
+		assert(block_size > 0);
+		block_size_ = block_size;
+
+		std::sort(pattern.begin(), pattern.end());
+		pattern.erase(std::unique(pattern.begin(), pattern.end()), pattern.end());
+
+		outer_index_.assign(n_block_rows + 1, 0);
+		inner_index_.resize(pattern.size());
+		for (size_t k = 0; k < pattern.size(); ++k)
+		{
+			assert(pattern[k].first >= 0 && pattern[k].first < n_block_rows);
+			assert(pattern[k].second >= 0 && pattern[k].second < n_block_rows);
+			++outer_index_[pattern[k].first + 1];
+			inner_index_[k] = pattern[k].second;
+		}
+		for (int i = 0; i < n_block_rows; ++i)
+			outer_index_[i + 1] += outer_index_[i];
+
+		values_.assign(pattern.size() * block_size * block_size, 0);
+	}
+
+	void BlockSparseMatrix::init(const int block_size, const StiffnessMatrix &A)
+	{
+		assert(A.rows() == A.cols());
+		assert(A.rows() % block_size == 0);
+
+		std::vector<std::pair<int, int>> pattern;
+		pattern.reserve(A.nonZeros());
+		for (int k = 0; k < A.outerSize(); ++k)
+		{
+			for (StiffnessMatrix::InnerIterator it(A, k); it; ++it)
+				pattern.emplace_back(it.row() / block_size, it.col() / block_size);
+		}
+		init(block_size, A.rows() / block_size, pattern);
+
+		for (int k = 0; k < A.outerSize(); ++k)
+		{
+			for (StiffnessMatrix::InnerIterator it(A, k); it; ++it)
+			{
+				const int b = find(it.row() / block_size, it.col() / block_size);
+				assert(b >= 0);
+				block(b)[(it.row() % block_size) * block_size + it.col() % block_size] += it.value();
+			}
+		}
+	}
+
+	void BlockSparseMatrix::set_zero()
+	{
+		std::fill(values_.begin(), values_.end(), 0);
+	}
+
+	int BlockSparseMatrix::find(const int bi, const int bj) const
+	{
+		assert(bi >= 0 && bi < n_block_rows());
+		const auto begin = inner_index_.begin() + outer_index_[bi];
+		const auto end = inner_index_.begin() + outer_index_[bi + 1];
+		const auto it = std::lower_bound(begin, end, bj);
+		if (it == end || *it != bj)
+			return -1;
+		return int(it - inner_index_.begin());
+	}
+
+	void BlockSparseMatrix::multiply(const Eigen::VectorXd &x, Eigen::VectorXd &y) const
+	{
+		assert(x.size() == cols());
+		y.resize(rows());
+
+		const int bs = block_size_;
+		maybe_parallel_for(n_block_rows(), [&](int start, int end, int thread_id) {
+			for (int bi = start; bi < end; ++bi)
+			{
+				auto yi = y.segment(bi * bs, bs);
+				yi.setZero();
+				for (int k = outer_index_[bi]; k < outer_index_[bi + 1]; ++k)
+				{
+					const Eigen::Map<const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>> b(block(k), bs, bs);
+					yi += b * x.segment(inner_index_[k] * bs, bs);
+				}
+			}
+		});
+	}
+
+	StiffnessMatrix BlockSparseMatrix::to_csr() const
+	{
+		const int bs = block_size_;
+
+		std::vector<Eigen::Triplet<double>> entries;
+		entries.reserve(values_.size());
+		for (int bi = 0; bi < n_block_rows(); ++bi)
+		{
+			for (int k = outer_index_[bi]; k < outer_index_[bi + 1]; ++k)
+			{
+				const double *b = block(k);
+				for (int m = 0; m < bs; ++m)
+					for (int n = 0; n < bs; ++n)
+						entries.emplace_back(bi * bs + m, inner_index_[k] * bs + n, b[m * bs + n]);
+			}
+		}
+
+		StiffnessMatrix A(rows(), cols());
+		A.setFromTriplets(entries.begin(), entries.end());
+		A.makeCompressed();
+		return A;
+	}
+} // namespace polyfem::utils
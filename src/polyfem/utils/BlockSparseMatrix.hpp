@@ -0,0 +1,69 @@
+#pragma once
+
+#include <polyfem/Common.hpp>
+#include <polyfem/utils/Types.hpp>
+
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+
+#include <vector>
+
+namespace polyfem
+{
+	namespace utils
+	{
+		/// Square matrix of square dense blocks stored in block compressed rows (BSR), e.g., one
+		/// dim x dim block per node pair of a vector problem. Blocks are stored row-major one after
+		/// the other, so outer_index/inner_index/values can be handed as is to BSR consumers
+		/// (MKL row-major BSR with rows_start = outer, rows_end = outer + 1, or AMGCL with static blocks).
+		class BlockSparseMatrix
+		{
+		public:
+			BlockSparseMatrix() {}
+
+			/// @brief Build the pattern and zero the values.
+			/// @param[in] block_size Size of the blocks.
+			/// @param[in] n_block_rows Number of block rows (and columns).
+			/// @param[in] pattern Block coordinates (row, column) of the non-zero blocks, duplicates are allowed, it is sorted in place.
+			void init(const int block_size, const int n_block_rows, std::vector<std::pair<int, int>> &pattern);
+
+			/// @brief Build from a scalar matrix, zero entries inside a non-zero block are stored explicitly.
+			/// @param[in] block_size Size of the blocks, must divide the size of A.
+			/// @param[in] A Input matrix.
+			void init(const int block_size, const StiffnessMatrix &A);
+
+			void set_zero();
+
+			inline int block_size() const { return block_size_; }
+			inline int n_block_rows() const { return int(outer_index_.size()) - 1; }
+			inline int rows() const { return n_block_rows() * block_size_; }
+			inline int cols() const { return rows(); }
+			inline size_t n_blocks() const { return inner_index_.size(); }
+
+			/// Index of block (bi, bj) in the storage, -1 if it is not in the pattern
+			int find(const int bi, const int bj) const;
+
+			/// Row-major values of the k-th block
+			inline double *block(const int k) { return values_.data() + size_t(k) * block_size_ * block_size_; }
+			inline const double *block(const int k) const { return values_.data() + size_t(k) * block_size_ * block_size_; }
+
+			/// Values are in block storage order, they can be summed with another matrix of the same pattern
+			inline std::vector<double> &values() { return values_; }
+			inline const std::vector<double> &values() const { return values_; }
+			inline const std::vector<int> &outer_index() const { return outer_index_; }
+			inline const std::vector<int> &inner_index() const { return inner_index_; }
+
+			/// y = A x
+			void multiply(const Eigen::VectorXd &x, Eigen::VectorXd &y) const;
+
+			/// Scalar compressed matrix with the same entries
+			StiffnessMatrix to_csr() const;
+
+		private:
+			int block_size_ = 1;
+			std::vector<int> outer_index_ = {0};
+			std::vector<int> inner_index_;
+			std::vector<double> values_;
+		};
+	} // namespace utils
+} // namespace polyfem
@@ -1,8 +1,6 @@
 #include "BoundarySampler.hpp"
 
-#include <polyfem/quadrature/LineQuadrature.hpp>
-#include <polyfem/quadrature/TriQuadrature.hpp>
-#include <polyfem/quadrature/QuadQuadrature.hpp>
+#include <polyfem/quadrature/QuadratureCache.hpp>
 
 #include <polyfem/autogen/auto_p_bases.hpp>
 #include <polyfem/autogen/auto_q_bases.hpp>
@@ -104,9 +102,7 @@ namespace polyfem
 		{
 			auto endpoints = quad_local_node_coordinates_from_edge(index);
 
-			Quadrature quad;
-			LineQuadrature quad_rule;
-			quad_rule.get_quadrature(order, quad);
+			const Quadrature &quad = QuadratureCache::get(QuadratureCache::Shape::LINE, order);
 
 			points.resize(quad.points.rows(), endpoints.cols());
 			uv.resize(quad.points.rows(), 2);
@@ -127,9 +123,7 @@ namespace polyfem
 		{
 			auto endpoints = tri_local_node_coordinates_from_edge(index);
 
-			Quadrature quad;
-			LineQuadrature quad_rule;
-			quad_rule.get_quadrature(order, quad);
+			const Quadrature &quad = QuadratureCache::get(QuadratureCache::Shape::LINE, order);
 
 			points.resize(quad.points.rows(), endpoints.cols());
 			uv.resize(quad.points.rows(), 2);
@@ -150,9 +144,7 @@ namespace polyfem
 		{
 			auto endpoints = hex_local_node_coordinates_from_face(index);
 
-			Quadrature quad;
-			QuadQuadrature quad_rule;
-			quad_rule.get_quadrature(order, quad);
+			const Quadrature &quad = QuadratureCache::get(QuadratureCache::Shape::QUAD, order);
 
 			const int n_pts = quad.points.rows();
 			points.resize(n_pts, endpoints.cols());
@@ -184,9 +176,7 @@ namespace polyfem
 		void utils::BoundarySampler::quadrature_for_tri_face(int index, int order, int gid, const Mesh &mesh, Eigen::MatrixXd &uv, Eigen::MatrixXd &points, Eigen::VectorXd &weights)
 		{
 			auto endpoints = tet_local_node_coordinates_from_face(index);
-			Quadrature quad;
-			TriQuadrature quad_rule;
-			quad_rule.get_quadrature(order, quad);
+			const Quadrature &quad = QuadratureCache::get(QuadratureCache::Shape::TRIANGLE, order);
 
 			const int n_pts = quad.points.rows();
 			points.resize(n_pts, endpoints.cols());
@@ -365,9 +355,7 @@ namespace polyfem
 
 			auto p0 = mesh2d.point(index.vertex);
 			auto p1 = mesh2d.point(mesh2d.switch_edge(index).vertex);
-			Quadrature quad;
-			LineQuadrature quad_rule;
-			quad_rule.get_quadrature(order, quad);
+			const Quadrature &quad = QuadratureCache::get(QuadratureCache::Shape::LINE, order);
 
 			points.resize(quad.points.rows(), p0.cols());
 			uv.resize(quad.points.rows(), 2);
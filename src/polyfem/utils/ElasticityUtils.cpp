@@ -231,6 +231,29 @@ namespace polyfem
 		displacement_grad = (displacement_grad * vals.jac_it[p]).eval();
 	}
 
+	void flatten_element_data(const assembler::NonLinearAssemblerData &data, const int size, Eigen::VectorXd &grads, Eigen::VectorXd &local_disp)
+	{
+		assert(data.x.cols() == 1);
+
+		const int n_bases = data.vals.basis_values.size();
+		const int n_pts = data.da.size();
+
+		local_disp.setZero(n_bases * size);
+		grads.resize(n_pts * n_bases * size);
+		for (int i = 0; i < n_bases; ++i)
+		{
+			const auto &bs = data.vals.basis_values[i];
+			for (const auto &g : bs.global)
+			{
+				for (int d = 0; d < size; ++d)
+					local_disp(i * size + d) += g.val * data.x(g.index * size + d);
+			}
+
+			for (int p = 0; p < n_pts; ++p)
+				grads.segment((p * n_bases + i) * size, size) = (bs.grad.row(p) * data.vals.jac_it[p]).transpose();
+		}
+	}
+
 	double von_mises_stress_for_stress_tensor(const Eigen::MatrixXd &stress)
 	{
 		double von_mises_stress;
@@ -57,6 +57,13 @@ namespace polyfem
 	Eigen::MatrixXd pk2_from_cauchy(const Eigen::MatrixXd &stress, const Eigen::MatrixXd &F);
 	void compute_diplacement_grad(const int size, const basis::ElementBases &bs, const assembler::ElementAssemblyValues &vals, const Eigen::MatrixXd &local_pts, const int p, const Eigen::MatrixXd &displacement, Eigen::MatrixXd &displacement_grad);
 
+	/// @brief Element data in the layout of assembler::kernels (ElasticKernels.hpp)
+	/// @param[in] data element data
+	/// @param[in] size problem dimension
+	/// @param[out] grads physical gradients of the bases, grads[(p * n_bases + i) * size + c]
+	/// @param[out] local_disp displacement of the bases, local_disp[i * size + d]
+	void flatten_element_data(const assembler::NonLinearAssemblerData &data, const int size, Eigen::VectorXd &grads, Eigen::VectorXd &local_disp);
+
 	template <typename AutoDiffVect>
 	void get_local_disp(
 		const assembler::NonLinearAssemblerData &data,
@@ -6,7 +6,9 @@
 #include <igl/PI.h>
 
 #include <tinyexpr.h>
+#include <cctype>
 #include <filesystem>
+#include <unordered_map>
 
 namespace polyfem
 {
@@ -34,6 +36,113 @@ namespace polyfem
 			return check >= 0 ? ttrue : ffalse;
 		}
 
+		namespace
+		{
+			// expression compiled against its own variable slots
+			class CompiledExpression
+			{
+			public:
+				double x = 0, y = 0, z = 0, t = 0;
+
+				CompiledExpression(const std::string &expr, int &err)
+				{
+					std::vector<te_variable> vars = {
+						{"x", &x, TE_VARIABLE},
+						{"y", &y, TE_VARIABLE},
+						{"z", &z, TE_VARIABLE},
+						{"t", &t, TE_VARIABLE},
+						{"min", (const void *)min, TE_FUNCTION2},
+						{"max", (const void *)max, TE_FUNCTION2},
+						{"deg2rad", (const void *)deg2rad, TE_FUNCTION1},
+						{"rotate_2D_x", (const void *)rotate_2D_x, TE_FUNCTION3},
+						{"rotate_2D_y", (const void *)rotate_2D_y, TE_FUNCTION3},
+						{"if", (const void *)iflargerthanzerothenelse, TE_FUNCTION3},
+						{"smooth_abs", (const void *)smooth_abs, TE_FUNCTION2},
+					};
+
+					expr_ = te_compile(expr.c_str(), vars.data(), vars.size(), &err);
+				}
+
+				~CompiledExpression()
+				{
+					if (expr_)
+						te_free(expr_);
+				}
+
+				CompiledExpression(const CompiledExpression &) = delete;
+				CompiledExpression &operator=(const CompiledExpression &) = delete;
+
+				bool is_valid() const { return expr_ != nullptr; }
+				double eval() const { return te_eval(expr_); }
+
+			private:
+				te_expr *expr_;
+			};
+
+			class ThreadCompiledExpression
+			{
+			public:
+				std::weak_ptr<const std::string> program;
+				std::unique_ptr<CompiledExpression> compiled;
+			};
+
+			// every thread compiles an expression once and binds its own variable slots,
+			// a stale entry (expired program whose address got reused) is recompiled
+			CompiledExpression &thread_compiled_expression(const std::shared_ptr<const std::string> &program)
+			{
+				thread_local std::unordered_map<const std::string *, ThreadCompiledExpression> cache;
+
+				ThreadCompiledExpression &entry = cache[program.get()];
+				if (!entry.compiled || entry.program.expired())
+				{
+					int err;
+					entry.program = program;
+					entry.compiled = std::make_unique<CompiledExpression>(*program, err);
+					assert(entry.compiled->is_valid());
+
+					// drop the expressions of destroyed values
+					if (cache.size() > 64)
+					{
+						for (auto it = cache.begin(); it != cache.end();)
+						{
+							if (it->second.program.expired())
+								it = cache.erase(it);
+							else
+								++it;
+						}
+					}
+				}
+
+				return *entry.compiled;
+			}
+
+			// the expression contains the single letter variable var (and not only identifiers starting with it, e.g., tan for t)
+			bool references_variable(const std::string &expr, const char var)
+			{
+				const auto c = [&](const size_t i) { return static_cast<unsigned char>(expr[i]); };
+				for (size_t i = 0; i < expr.size();)
+				{
+					if (std::isalpha(c(i)) || expr[i] == '_')
+					{
+						const size_t start = i;
+						while (i < expr.size() && (std::isalnum(c(i)) || expr[i] == '_'))
+							++i;
+						if (i - start == 1 && expr[start] == var)
+							return true;
+					}
+					else if (std::isdigit(c(i)) || expr[i] == '.')
+					{
+						// skips numbers with exponents, e.g., 1e-3
+						while (i < expr.size() && (std::isalnum(c(i)) || expr[i] == '.'))
+							++i;
+					}
+					else
+						++i;
+				}
+				return false;
+			}
+		} // namespace
+
 		ExpressionValue::ExpressionValue()
 		{
 			clear();
@@ -42,10 +151,13 @@ namespace polyfem
 		void ExpressionValue::clear()
 		{
 			expr_ = "";
+			program_ = nullptr;
 			mat_.resize(0, 0);
 			sfunc_ = nullptr;
 			tfunc_ = nullptr;
 			value_ = 0;
+			time_dependent_ = false;
+			constant_ = true;
 		}
 
 		void ExpressionValue::init(const double val)
@@ -60,6 +172,7 @@ namespace polyfem
 			clear();
 
 			mat_ = val;
+			constant_ = false;
 		}
 
 		void ExpressionValue::init(const std::string &expr)
@@ -73,39 +186,28 @@ namespace polyfem
 
 			const auto path = std::filesystem::path(expr);
 
-			if (std::filesystem::is_regular_file(path))
+			// per-element/node arrays of an HDF5 input are read from their dataset only
+			std::string hdf5_file, dataset;
+			if (std::filesystem::is_regular_file(path) || (split_hdf5_dataset_path(expr, hdf5_file, dataset) && std::filesystem::is_regular_file(hdf5_file)))
 			{
 				read_matrix(expr, mat_);
+				constant_ = false;
 				return;
 			}
 
 			expr_ = expr;
-
-			double x = 0, y = 0, z = 0, t = 0;
-
-			std::vector<te_variable> vars = {
-				{"x", &x, TE_VARIABLE},
-				{"y", &y, TE_VARIABLE},
-				{"z", &z, TE_VARIABLE},
-				{"t", &t, TE_VARIABLE},
-				{"min", (const void *)min, TE_FUNCTION2},
-				{"max", (const void *)max, TE_FUNCTION2},
-				{"deg2rad", (const void *)deg2rad, TE_FUNCTION1},
-				{"rotate_2D_x", (const void *)rotate_2D_x, TE_FUNCTION3},
-				{"rotate_2D_y", (const void *)rotate_2D_y, TE_FUNCTION3},
-				{"if", (const void *)iflargerthanzerothenelse, TE_FUNCTION3},
-				{"smooth_abs", (const void *)smooth_abs, TE_FUNCTION2},
-			};
+			program_ = std::make_shared<const std::string>(expr);
+			time_dependent_ = references_variable(expr, 't');
+			constant_ = !time_dependent_ && !references_variable(expr, 'x') && !references_variable(expr, 'y') && !references_variable(expr, 'z');
 
 			int err;
-			te_expr *tmp = te_compile(expr.c_str(), vars.data(), vars.size(), &err);
-			if (!tmp)
+			const CompiledExpression tmp(expr, err);
+			if (!tmp.is_valid())
 			{
 				logger().error("Unable to parse: {}", expr);
 				logger().error("Error near here: {0: >{1}}", "^", err - 1);
 				assert(false);
 			}
-			te_free(tmp);
 		}
 
 		void ExpressionValue::init(const json &vals)
@@ -118,6 +220,7 @@ namespace polyfem
 			}
 			else if (vals.is_array())
 			{
+				constant_ = false;
 				mat_.resize(vals.size(), 1);
 
 				for (int i = 0; i < mat_.size(); ++i)
@@ -136,18 +239,23 @@ namespace polyfem
 			clear();
 
 			sfunc_ = [func](double x, double y, double z, double t, int index) { return func(x, y, z); };
+			constant_ = false;
 		}
 
 		void ExpressionValue::init(const std::function<double(double x, double y, double z, double t)> &func)
 		{
 			clear();
 			sfunc_ = [func](double x, double y, double z, double t, double index) { return func(x, y, z, t); };
+			time_dependent_ = true;
+			constant_ = false;
 		}
 
 		void ExpressionValue::init(const std::function<double(double x, double y, double z, double t, int index)> &func)
 		{
 			clear();
 			sfunc_ = func;
+			time_dependent_ = true;
+			constant_ = false;
 		}
 
 		void ExpressionValue::init(const std::function<Eigen::MatrixXd(double x, double y, double z)> &func, const int coo)
@@ -156,6 +264,7 @@ namespace polyfem
 
 			tfunc_ = [func](double x, double y, double z, double t) { return func(x, y, z); };
 			tfunc_coo_ = coo;
+			constant_ = false;
 		}
 
 		void ExpressionValue::init(const std::function<Eigen::MatrixXd(double x, double y, double z, double t)> &func, const int coo)
@@ -164,6 +273,8 @@ namespace polyfem
 
 			tfunc_ = func;
 			tfunc_coo_ = coo;
+			time_dependent_ = true;
+			constant_ = false;
 		}
 
 		double ExpressionValue::operator()(double x, double y, double z, double t, int index) const
@@ -182,27 +293,48 @@ namespace polyfem
 				return value_;
 			}
 
-			std::vector<te_variable> vars = {
-				{"x", &x, TE_VARIABLE},
-				{"y", &y, TE_VARIABLE},
-				{"z", &z, TE_VARIABLE},
-				{"t", &t, TE_VARIABLE},
-				{"min", (const void *)min, TE_FUNCTION2},
-				{"max", (const void *)max, TE_FUNCTION2},
-				{"deg2rad", (const void *)deg2rad, TE_FUNCTION1},
-				{"rotate_2D_x", (const void *)rotate_2D_x, TE_FUNCTION3},
-				{"rotate_2D_y", (const void *)rotate_2D_y, TE_FUNCTION3},
-				{"if", (const void *)iflargerthanzerothenelse, TE_FUNCTION3},
-				{"smooth_abs", (const void *)smooth_abs, TE_FUNCTION2},
-			};
+			assert(program_ != nullptr);
+			CompiledExpression &compiled = thread_compiled_expression(program_);
+			compiled.x = x;
+			compiled.y = y;
+			compiled.z = z;
+			compiled.t = t;
 
-			int err;
-			te_expr *tmp = te_compile(expr_.c_str(), vars.data(), vars.size(), &err);
-			assert(tmp != nullptr);
-			const auto res = te_eval(tmp);
-			te_free(tmp);
+			return compiled.eval();
+		}
+
+		void ExpressionValue::eval(const Eigen::MatrixXd &pts, const double t, Eigen::VectorXd &out, const int index) const
+		{
+			assert(pts.cols() == 2 || pts.cols() == 3);
+			const bool planar = pts.cols() == 2;
+			out.resize(pts.rows());
+
+			if (expr_.empty())
+			{
+				if (mat_.size() == 0 && !sfunc_ && !tfunc_)
+				{
+					out.setConstant(value_);
+					return;
+				}
 
-			return res;
+				for (long i = 0; i < pts.rows(); ++i)
+					out(i) = (*this)(pts(i, 0), pts(i, 1), planar ? 0 : pts(i, 2), t, index);
+				return;
+			}
+
+			// the compiled expression is fetched once for the whole block
+			assert(program_ != nullptr);
+			CompiledExpression &compiled = thread_compiled_expression(program_);
+			compiled.z = 0;
+			compiled.t = t;
+			for (long i = 0; i < pts.rows(); ++i)
+			{
+				compiled.x = pts(i, 0);
+				compiled.y = pts(i, 1);
+				if (!planar)
+					compiled.z = pts(i, 2);
+				out(i) = compiled.eval();
+			}
 		}
 	} // namespace utils
 } // namespace polyfem
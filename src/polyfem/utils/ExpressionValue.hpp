@@ -2,6 +2,8 @@
 
 #include <polyfem/Common.hpp>
 
+#include <memory>
+
 namespace polyfem
 {
 	namespace utils
@@ -24,9 +26,18 @@ namespace polyfem
 
 			double operator()(double x, double y, double z = 0, double t = 0, int index = -1) const;
 
+			// evaluates at every row of pts (2d or 3d), equivalent to calling operator() per row
+			void eval(const Eigen::MatrixXd &pts, const double t, Eigen::VectorXd &out, const int index = -1) const;
+
 			void clear();
 
 			bool is_zero() const { return expr_.empty() && fabs(value_) < 1e-10; }
+			// the value might change with t: the expression references t or the function takes t
+			bool is_time_dependent() const { return time_dependent_; }
+			// the value does not depend on the point, the time or the index
+			bool is_constant() const { return constant_; }
+			// the value only depends on the index (e.g., one value per element)
+			bool is_index_only() const { return constant_ || (expr_.empty() && mat_.size() > 0); }
 
 		private:
 			std::function<double(double x, double y, double z, double t, int index)> sfunc_;
@@ -34,8 +45,12 @@ namespace polyfem
 			int tfunc_coo_;
 
 			std::string expr_;
+			// shared by the copies, identifies the expression in the per thread compiled cache
+			std::shared_ptr<const std::string> program_;
 			double value_;
 			Eigen::MatrixXd mat_;
+			bool time_dependent_;
+			bool constant_;
 		};
 	} // namespace utils
 } // namespace polyfem
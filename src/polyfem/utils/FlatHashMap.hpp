@@ -0,0 +1,175 @@
+#pragma once
+
+#include <polyfem/utils/MaybeParallelFor.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace polyfem::utils
+{
+	/// Open addressing hash map with keys made of N integers (e.g., the sorted vertices of an edge or a face),
+	/// used to build the topology of the meshes instead of std::unordered_map.
+	///
+	/// The keys and values are stored contiguously in insertion order (which is also the iteration order),
+	/// the table only stores the index of the entries and is probed linearly. There is no allocation per entry
+	/// and a lookup reads a few contiguous integers. Entries cannot be erased.
+	template <int N, typename Value>
+	class FlatHashMap
+	{
+	public:
+		using Key = std::array<int, N>;
+
+		FlatHashMap() = default;
+		explicit FlatHashMap(const size_t expected_size) { reserve(expected_size); }
+
+		size_t size() const { return keys_.size(); }
+		bool empty() const { return keys_.empty(); }
+
+		/// @brief Keys in insertion order
+		const std::vector<Key> &keys() const { return keys_; }
+		/// @brief Values in insertion order
+		const std::vector<Value> &values() const { return values_; }
+
+		/// @brief Makes room for n entries without rehashing
+		void reserve(const size_t n)
+		{
+			keys_.reserve(n);
+			values_.reserve(n);
+			// at most half full
+			size_t capacity = 16;
+			while (capacity < 2 * n)
+				capacity *= 2;
+			if (capacity > table_.size())
+				rehash(capacity);
+		}
+
+		void clear()
+		{
+			keys_.clear();
+			values_.clear();
+			table_.clear();
+		}
+
+		/// @brief Pointer to the value of key, nullptr if it is not in the map (invalidated by the insertions)
+		const Value *find(const Key &key) const
+		{
+			const int entry = find_entry(key, hash(key));
+			return entry < 0 ? nullptr : &values_[entry];
+		}
+
+		Value *find(const Key &key)
+		{
+			const int entry = find_entry(key, hash(key));
+			return entry < 0 ? nullptr : &values_[entry];
+		}
+
+		bool contains(const Key &key) const { return find(key) != nullptr; }
+
+		/// @brief Value of key, throws std::out_of_range if it is not in the map
+		const Value &at(const Key &key) const
+		{
+			const Value *value = find(key);
+			if (value == nullptr)
+				throw std::out_of_range("FlatHashMap::at");
+			return *value;
+		}
+
+		/// @brief Inserts the entry if the key is not in the map
+		/// @return the value of the key and true if it was inserted
+		std::pair<Value *, bool> emplace(const Key &key, const Value &value)
+		{
+			return emplace(key, value, hash(key));
+		}
+
+		/// @brief Inserts n entries, in order, with the semantic of emplace.
+		/// The keys are hashed in parallel, the table is then filled serially so the result does not depend on the threads.
+		/// @param[in] n number of entries
+		/// @param[in] key function returning the key of entry i
+		/// @param[in] value function returning the value of entry i
+		template <typename KeyFunction, typename ValueFunction>
+		void bulk_emplace(const int n, const KeyFunction &key, const ValueFunction &value)
+		{
+			std::vector<Key> new_keys(n);
+			std::vector<uint64_t> hashes(n);
+			maybe_parallel_for(n, [&](int start, int end, int /*thread_id*/) {
+				for (int i = start; i < end; ++i)
+				{
+					new_keys[i] = key(i);
+					hashes[i] = hash(new_keys[i]);
+				}
+			});
+
+			reserve(size() + n);
+			for (int i = 0; i < n; ++i)
+				emplace(new_keys[i], value(i), hashes[i]);
+		}
+
+		static uint64_t hash(const Key &key)
+		{
+			uint64_t h = 0;
+			for (int i = 0; i < N; ++i)
+			{
+				h = (h ^ uint32_t(key[i])) * 0x9E3779B97F4A7C15ull;
+				h ^= h >> 29;
+			}
+			return h;
+		}
+
+	private:
+		/// index of the entry of key, -1 if it is not in the map
+		int find_entry(const Key &key, const uint64_t h) const
+		{
+			if (table_.empty())
+				return -1;
+
+			const size_t mask = table_.size() - 1;
+			for (size_t slot = h & mask;; slot = (slot + 1) & mask)
+			{
+				const int entry = table_[slot];
+				if (entry < 0 || keys_[entry] == key)
+					return entry;
+			}
+		}
+
+		std::pair<Value *, bool> emplace(const Key &key, const Value &value, const uint64_t h)
+		{
+			if (2 * (keys_.size() + 1) > table_.size())
+				rehash(std::max<size_t>(16, 2 * table_.size()));
+
+			const size_t mask = table_.size() - 1;
+			size_t slot = h & mask;
+			for (; table_[slot] >= 0; slot = (slot + 1) & mask)
+			{
+				if (keys_[table_[slot]] == key)
+					return {&values_[table_[slot]], false};
+			}
+
+			table_[slot] = keys_.size();
+			keys_.push_back(key);
+			values_.push_back(value);
+			return {&values_.back(), true};
+		}
+
+		void rehash(const size_t capacity)
+		{
+			table_.assign(capacity, -1);
+			const size_t mask = capacity - 1;
+			for (int entry = 0; entry < int(keys_.size()); ++entry)
+			{
+				size_t slot = hash(keys_[entry]) & mask;
+				while (table_[slot] >= 0)
+					slot = (slot + 1) & mask;
+				table_[slot] = entry;
+			}
+		}
+
+		std::vector<Key> keys_;
+		std::vector<Value> values_;
+		/// index of the entry in every slot, -1 for the empty slots, the size is a power of two
+		std::vector<int> table_;
+	};
+} // namespace polyfem::utils
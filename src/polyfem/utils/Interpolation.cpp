@@ -3,6 +3,10 @@
 #include <polyfem/utils/MatrixUtils.hpp>
 #include <polyfem/utils/Logger.hpp>
 
+#include <Eigen/Sparse>
+
+#include <algorithm>
+
 namespace polyfem::utils
 {
 	NLOHMANN_JSON_SERIALIZE_ENUM(
@@ -68,6 +72,38 @@ namespace polyfem::utils
 
 		assert(params.contains("extend"));
 		extend_ = params["extend"];
+
+		const int n_pieces = int(points_.size()) - 1;
+		bin_start_.clear();
+		bin_size_ = 0;
+		if (n_pieces <= 0 || points_.back() <= points_.front())
+			return;
+
+		bin_size_ = (points_.back() - points_.front()) / n_pieces;
+		bin_start_.resize(n_pieces);
+		int i = 0;
+		for (int b = 0; b < n_pieces; ++b)
+		{
+			const double t = points_.front() + b * bin_size_;
+			while (i < n_pieces - 1 && t >= points_[i + 1])
+				++i;
+			bin_start_[b] = i;
+		}
+	}
+
+	int PiecewiseInterpolation::find_piece(const double t) const
+	{
+		assert(!bin_start_.empty());
+		const int n_pieces = bin_start_.size();
+		const int b = std::clamp(int((t - points_.front()) / bin_size_), 0, n_pieces - 1);
+
+		// the bin start is rounded, step back if t is before it
+		int i = bin_start_[b];
+		while (i > 0 && t < points_[i])
+			--i;
+		while (i < n_pieces - 1 && t >= points_[i + 1])
+			++i;
+		return i;
 	}
 
 	double PiecewiseInterpolation::eval(const double t) const
@@ -75,16 +111,10 @@ namespace polyfem::utils
 		if (t < points_.front() || t >= points_.back())
 			return extend(t);
 
-		for (size_t i = 0; i < points_.size() - 1; ++i)
-		{
-			if (t >= points_[i] && t < points_[i + 1])
-			{
-				return eval_piece(t, i);
-			}
-		}
+		if (points_.size() == 1)
+			return values_[0];
 
-		assert(points_.size() == 1);
-		return values_[0];
+		return eval_piece(t, find_piece(t));
 	}
 
 	double PiecewiseInterpolation::extend(const double t) const
@@ -130,16 +160,14 @@ namespace polyfem::utils
 	{
 		assert(t >= points_.front() && t <= points_.back());
 
-		for (size_t i = 0; i < points_.size() - 1; ++i)
-		{
-			if (t >= points_[i] && t <= points_[i + 1])
-			{
-				return dy_dt_piece(t, i);
-			}
-		}
+		if (points_.size() == 1 || bin_start_.empty())
+			return 0;
 
-		assert(points_.size() == 1);
-		return 0;
+		// first piece with points_[i] <= t <= points_[i + 1]
+		int i = find_piece(std::min(t, points_.back()));
+		while (i > 0 && t <= points_[i])
+			--i;
+		return dy_dt_piece(t, i);
 	}
 
 	double PiecewiseLinearInterpolation::eval_piece(const double t, const int i) const
@@ -160,7 +188,10 @@ namespace polyfem::utils
 		// N+1 points ⟹ N cubic functions of the form fᵢ(x) = aᵢt³ + bᵢt² + cᵢt + dᵢ
 		//            ⟹ 4N unknowns
 		const int N = points_.size() - 1;
-		Eigen::MatrixXd A = Eigen::MatrixXd::Zero(4 * N, 4 * N);
+		// banded system, sparse so that long load histories (10^5 samples) stay linear in memory
+		std::vector<Eigen::Triplet<double>> entries;
+		entries.reserve(20 * N);
+		const auto add = [&](const int row, const int col, const double val) { entries.emplace_back(row, col, val); };
 		Eigen::VectorXd b = Eigen::VectorXd::Zero(4 * N);
 
 		// 2N equations: fᵢ(tᵢ) = yᵢ and fᵢ(tᵢ₊₁) = yᵢ₊₁
@@ -171,10 +202,10 @@ namespace polyfem::utils
 				// aᵢt³ + bᵢt² + cᵢt + dᵢ = yᵢ (yᵢ₊₁) at tᵢ (tᵢ₊₁)
 				const double t = points_[i + j];
 
-				A(2 * i + j, 4 * i + 0) = pow(t, 3);
-				A(2 * i + j, 4 * i + 1) = pow(t, 2);
-				A(2 * i + j, 4 * i + 2) = t;
-				A(2 * i + j, 4 * i + 3) = 1;
+				add(2 * i + j, 4 * i + 0, pow(t, 3));
+				add(2 * i + j, 4 * i + 1, pow(t, 2));
+				add(2 * i + j, 4 * i + 2, t);
+				add(2 * i + j, 4 * i + 3, 1);
 
 				b(2 * i + j) = values_[i + j];
 			}
@@ -188,11 +219,13 @@ namespace polyfem::utils
 			// 3aᵢt² + 2bᵢt + cᵢ - 3aᵢ₊₁t² - 2bᵢ₊₁t - cᵢ₊₁ = 0 at tᵢ₊₁
 			const double t = points_[i + 1];
 
-			A(offset + i, 4 * i + 0) = 3 * pow(t, 2);
-			A(offset + i, 4 * i + 1) = 2 * t;
-			A(offset + i, 4 * i + 2) = 1;
+			add(offset + i, 4 * i + 0, 3 * pow(t, 2));
+			add(offset + i, 4 * i + 1, 2 * t);
+			add(offset + i, 4 * i + 2, 1);
 
-			A.block<1, 3>(offset + i, 4 * (i + 1)) = -A.block<1, 3>(offset + i, 4 * i);
+			add(offset + i, 4 * (i + 1) + 0, -3 * pow(t, 2));
+			add(offset + i, 4 * (i + 1) + 1, -2 * t);
+			add(offset + i, 4 * (i + 1) + 2, -1);
 		}
 		offset += N - 1;
 
@@ -203,10 +236,11 @@ namespace polyfem::utils
 			// 6aᵢt + 2bᵢ - 6aᵢ₊₁t - 2bᵢ₊₁ = 0 at tᵢ₊₁
 			const double t = points_[i + 1];
 
-			A(offset + i, 4 * i + 0) = 6 * t;
-			A(offset + i, 4 * i + 1) = 2;
+			add(offset + i, 4 * i + 0, 6 * t);
+			add(offset + i, 4 * i + 1, 2);
 
-			A.block<1, 2>(offset + i, 4 * (i + 1)) = -A.block<1, 2>(offset + i, 4 * i);
+			add(offset + i, 4 * (i + 1) + 0, -6 * t);
+			add(offset + i, 4 * (i + 1) + 1, -2);
 		}
 		offset += N - 1;
 
@@ -215,28 +249,28 @@ namespace polyfem::utils
 		{
 			// Custom Spline
 			// f₀'(t₀) = 3a₀t₀² + 2b₀t + c₀ = 0
-			A(offset, 0) = 3 * pow(points_[0], 2);
-			A(offset, 1) = 2 * points_[0];
-			A(offset, 2) = 1;
+			add(offset, 0, 3 * pow(points_[0], 2));
+			add(offset, 1, 2 * points_[0]);
+			add(offset, 2, 1);
 			offset++;
 
 			// fₙ₋₁"(tₙ) = 6aₙ₋₁tₙ + 2bₙ₋₁ = 0
-			A(offset, 4 * (N - 1) + 0) = 3 * pow(points_[N], 2);
-			A(offset, 4 * (N - 1) + 1) = 2 * points_[N];
-			A(offset, 4 * (N - 1) + 2) = 1;
+			add(offset, 4 * (N - 1) + 0, 3 * pow(points_[N], 2));
+			add(offset, 4 * (N - 1) + 1, 2 * points_[N]);
+			add(offset, 4 * (N - 1) + 2, 1);
 			offset++;
 		}
 		else if (extend_ == Extend::EXTRAPOLATE)
 		{
 			// Natural Spline
 			// f₀"(t₀) = 6a₀t₀ + 2b₀ = 0
-			A(offset, 0) = 6 * points_[0];
-			A(offset, 1) = 2;
+			add(offset, 0, 6 * points_[0]);
+			add(offset, 1, 2);
 			offset++;
 
 			// fₙ₋₁"(tₙ) = 6aₙ₋₁tₙ + 2bₙ₋₁ = 0
-			A(offset, 4 * (N - 1) + 0) = 6 * points_[N];
-			A(offset, 4 * (N - 1) + 1) = 2;
+			add(offset, 4 * (N - 1) + 0, 6 * points_[N]);
+			add(offset, 4 * (N - 1) + 1, 2);
 			offset++;
 		}
 		else
@@ -245,25 +279,31 @@ namespace polyfem::utils
 			assert(extend_ == Extend::REPEAT || extend_ == Extend::REPEAT_OFFSET);
 
 			// f₀'(t₀) = fₙ₋₁'(tₙ) and f₀"(t₀) = fₙ₋₁"(tₙ)
-			A(offset, 0) = 3 * pow(points_[0], 2);
-			A(offset, 1) = 2 * points_[0];
-			A(offset, 2) = 1;
-			A(offset, 4 * (N - 1) + 0) = -3 * pow(points_[N], 2);
-			A(offset, 4 * (N - 1) + 1) = -2 * points_[N];
-			A(offset, 4 * (N - 1) + 2) = -1;
+			add(offset, 0, 3 * pow(points_[0], 2));
+			add(offset, 1, 2 * points_[0]);
+			add(offset, 2, 1);
+			add(offset, 4 * (N - 1) + 0, -3 * pow(points_[N], 2));
+			add(offset, 4 * (N - 1) + 1, -2 * points_[N]);
+			add(offset, 4 * (N - 1) + 2, -1);
 			offset++;
 
-			A(offset, 0) = 6 * points_[0];
-			A(offset, 1) = 2;
-			A(offset, 4 * (N - 1) + 0) = -6 * points_[N];
-			A(offset, 4 * (N - 1) + 1) = -2;
+			add(offset, 0, 6 * points_[0]);
+			add(offset, 1, 2);
+			add(offset, 4 * (N - 1) + 0, -6 * points_[N]);
+			add(offset, 4 * (N - 1) + 1, -2);
 			offset++;
 		}
 
 		assert(offset == 4 * N);
 
 		// Solve the system of linear equations
-		coeffs_ = A.lu().solve(b);
+		Eigen::SparseMatrix<double> A(4 * N, 4 * N);
+		A.setFromTriplets(entries.begin(), entries.end());
+		Eigen::SparseLU<Eigen::SparseMatrix<double>> solver;
+		solver.compute(A);
+		if (solver.info() != Eigen::Success)
+			log_and_throw_error("Unable to compute the cubic spline coefficients, are the points distinct?");
+		coeffs_ = solver.solve(b);
 		// unflatten coeffs so each row corresponds to a cubic function
 		coeffs_ = utils::unflatten(coeffs_, 4);
 		assert(coeffs_.rows() == N);
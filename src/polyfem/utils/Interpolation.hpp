@@ -65,6 +65,15 @@ namespace polyfem::utils
 
 		double dy_dt(const double t) const;
 		virtual double dy_dt_piece(const double t, const int i) const = 0;
+
+		/// piece i with points_[i] <= t < points_[i + 1], t in [points_.front(), points_.back())
+		int find_piece(const double t) const;
+
+	private:
+		/// uniform bins over [points_.front(), points_.back()], bin_start_[b] is the piece containing the start of bin b,
+		/// a lookup only walks the pieces of one bin (a single one for uniform samples)
+		std::vector<int> bin_start_;
+		double bin_size_ = 0;
 	};
 
 	class PiecewiseConstantInterpolation : public PiecewiseInterpolation
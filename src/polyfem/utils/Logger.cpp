@@ -1,6 +1,7 @@
 #include "Logger.hpp"
 #include <polyfem/utils/DisableWarnings.hpp>
 #include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/details/fmt_helper.h>
 #include <polyfem/utils/EnableWarnings.hpp>
 
 namespace polyfem
@@ -15,6 +16,36 @@ namespace polyfem
 			return logger;
 		}
 
+		void append_json_string(const spdlog::string_view_t &str, spdlog::memory_buf_t &dest)
+		{
+			dest.push_back('"');
+			for (const char c : str)
+			{
+				switch (c)
+				{
+				case '"':
+					spdlog::details::fmt_helper::append_string_view("\\\"", dest);
+					break;
+				case '\\':
+					spdlog::details::fmt_helper::append_string_view("\\\\", dest);
+					break;
+				case '\n':
+					spdlog::details::fmt_helper::append_string_view("\\n", dest);
+					break;
+				case '\t':
+					spdlog::details::fmt_helper::append_string_view("\\t", dest);
+					break;
+				default:
+					// other control characters, e.g., the color escapes of the timers
+					if (static_cast<unsigned char>(c) < 0x20)
+						fmt::format_to(std::back_inserter(dest), "\\u{:04x}", static_cast<int>(c));
+					else
+						dest.push_back(c);
+				}
+			}
+			dest.push_back('"');
+		}
+
 	} // namespace
 
 	// Retrieve current logger
@@ -46,4 +77,21 @@ namespace polyfem
 		logger().error(msg);
 		throw std::runtime_error(msg);
 	}
+
+	void JSONLogFormatter::format(const spdlog::details::log_msg &msg, spdlog::memory_buf_t &dest)
+	{
+		const double time = std::chrono::duration<double>(msg.time.time_since_epoch()).count();
+		fmt::format_to(std::back_inserter(dest), "{{\"time\":{:.6f},\"level\":", time);
+		append_json_string(spdlog::level::to_string_view(msg.level), dest);
+		spdlog::details::fmt_helper::append_string_view(",\"logger\":", dest);
+		append_json_string(msg.logger_name, dest);
+		fmt::format_to(std::back_inserter(dest), ",\"thread\":{},\"msg\":", msg.thread_id);
+		append_json_string(msg.payload, dest);
+		spdlog::details::fmt_helper::append_string_view("}\n", dest);
+	}
+
+	std::unique_ptr<spdlog::formatter> JSONLogFormatter::clone() const
+	{
+		return std::make_unique<JSONLogFormatter>();
+	}
 } // namespace polyfem
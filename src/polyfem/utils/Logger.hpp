@@ -4,6 +4,7 @@
 #include <spdlog/fmt/bundled/ranges.h>
 #include <spdlog/fmt/ostr.h>
 #include <spdlog/spdlog.h>
+#include <spdlog/formatter.h>
 #include <polyfem/utils/EnableWarnings.hpp>
 
 namespace polyfem
@@ -25,6 +26,18 @@ namespace polyfem
 
 	[[noreturn]] void log_and_throw_error(const std::string &msg);
 
+	///
+	/// Formats every record as one line of JSON
+	///     {"time": seconds since epoch, "level": "debug", "logger": "polyfem", "thread": id, "msg": "..."}
+	/// so the per-iteration records of a run can be parsed instead of the text log.
+	///
+	class JSONLogFormatter : public spdlog::formatter
+	{
+	public:
+		void format(const spdlog::details::log_msg &msg, spdlog::memory_buf_t &dest) override;
+		std::unique_ptr<spdlog::formatter> clone() const override;
+	};
+
 	template <typename... Args>
 	[[noreturn]] void log_and_throw_error(const std::string &msg, const Args &...args)
 	{
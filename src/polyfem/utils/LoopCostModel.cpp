@@ -0,0 +1,111 @@
+#include "LoopCostModel.hpp"
+
+#include <polyfem/utils/MaybeParallelFor.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <numeric>
+
+namespace polyfem::utils
+{
+	namespace
+	{
+		// chunks per thread, so that the threads finishing early can still take some work
+		constexpr int CHUNKS_PER_THREAD = 4;
+	} // namespace
+
+	void LoopCostModel::init(const std::vector<double> &costs)
+	{
+		costs_ = costs;
+		for (double &c : costs_)
+			c = std::max(c, 0.0);
+		measured_ = false;
+	}
+
+	std::vector<int> LoopCostModel::partition(const int n_chunks) const
+	{
+		const int n = size();
+		std::vector<int> res = {0};
+		if (n == 0)
+			return res;
+
+		const double total = std::accumulate(costs_.begin(), costs_.end(), 0.0);
+		if (total <= 0)
+		{
+			for (int c = 1; c <= n_chunks; ++c)
+			{
+				const int b = int((long(n) * c) / n_chunks);
+				if (b > res.back())
+					res.push_back(b);
+			}
+			return res;
+		}
+
+		double prefix = 0;
+		int c = 1;
+		for (int i = 0; i < n && c < n_chunks; ++i)
+		{
+			prefix += costs_[i];
+			// close the chunk once it reaches its share of the total
+			if (prefix >= total * c / n_chunks)
+			{
+				res.push_back(i + 1);
+				while (c < n_chunks && prefix >= total * c / n_chunks)
+					++c;
+			}
+		}
+		if (res.back() < n)
+			res.push_back(n);
+		return res;
+	}
+
+	void LoopCostModel::record(const std::vector<int> &chunks, const std::vector<double> &times)
+	{
+		assert(chunks.size() == times.size() + 1);
+
+		bool all_measured = true;
+		for (int c = 0; c < times.size(); ++c)
+		{
+			const int start = chunks[c];
+			const int end = chunks[c + 1];
+			assert(0 <= start && start <= end && end <= size());
+
+			// too fast for the clock
+			if (times[c] <= 0)
+			{
+				all_measured = false;
+				continue;
+			}
+
+			const double sum = std::accumulate(costs_.begin() + start, costs_.begin() + end, 0.0);
+			for (int i = start; i < end; ++i)
+			{
+				const double cost = sum > 0 ? costs_[i] * times[c] / sum : times[c] / (end - start);
+				// average with the previous measurement to damp the noise of the timings
+				costs_[i] = measured_ ? 0.5 * (costs_[i] + cost) : cost;
+			}
+		}
+
+		// once all the costs are in seconds
+		measured_ = measured_ || all_measured;
+	}
+
+	void maybe_parallel_for(LoopCostModel &costs, const std::function<void(int, int, int)> &partial_for)
+	{
+		const std::vector<int> chunks = costs.partition(CHUNKS_PER_THREAD * maybe_max_concurrency());
+		const int n_chunks = int(chunks.size()) - 1;
+		std::vector<double> times(n_chunks, 0);
+
+		maybe_parallel_for(n_chunks, [&](int start, int end, int thread_id) {
+			for (int c = start; c < end; ++c)
+			{
+				const auto t0 = std::chrono::steady_clock::now();
+				partial_for(chunks[c], chunks[c + 1], thread_id);
+				times[c] = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+			}
+		});
+
+		costs.record(chunks, times);
+	}
+} // namespace polyfem::utils
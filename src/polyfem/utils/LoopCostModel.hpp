@@ -0,0 +1,41 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+namespace polyfem::utils
+{
+	/// @brief Estimated cost of every iteration of a loop, used to split it in chunks of similar cost.
+	/// The estimates are set a priori (e.g., local bases × quadrature points of the elements) and, every time
+	/// the loop runs through maybe_parallel_for, rescaled so that each chunk matches its measured time.
+	class LoopCostModel
+	{
+	public:
+		/// @brief Sets the a priori costs and drops the measurements
+		void init(const std::vector<double> &costs);
+		void clear() { init({}); }
+
+		inline int size() const { return costs_.size(); }
+		inline bool empty() const { return costs_.empty(); }
+		inline const std::vector<double> &costs() const { return costs_; }
+
+		/// @brief Boundaries of at most n_chunks non-empty chunks of [0, size()) of similar total cost
+		/// @param[in] n_chunks number of chunks
+		/// @return n + 1 increasing indices, chunk c is [res[c], res[c + 1])
+		std::vector<int> partition(const int n_chunks) const;
+
+		/// @brief Rescales the costs of every chunk so that they sum to its measured time
+		/// @param[in] chunks boundaries of the chunks, as returned by partition
+		/// @param[in] times measured time of every chunk in seconds, the chunks with time 0 keep their costs
+		void record(const std::vector<int> &chunks, const std::vector<double> &times);
+
+	private:
+		std::vector<double> costs_;
+		/// the costs are in seconds
+		bool measured_ = false;
+	};
+
+	/// @brief Same as maybe_parallel_for(costs.size(), partial_for), the range is split in chunks of similar
+	/// cost according to costs, which is then refreshed with the time measured on every chunk.
+	void maybe_parallel_for(LoopCostModel &costs, const std::function<void(int, int, int)> &partial_for);
+} // namespace polyfem::utils
@@ -9,6 +9,7 @@
 #include <iostream>
 #include <fstream>
 #include <iomanip> // setprecision
+#include <numeric>
 #include <vector>
 #include <filesystem>
 
@@ -52,17 +53,25 @@ polyfem::utils::SparseMatrixCache::SparseMatrixCache(const polyfem::utils::Spars
 
 void polyfem::utils::SparseMatrixCache::init(const size_t size)
 {
-	assert(mapping().empty() || size_ == size);
+	assert(!has_mapping() || size_ == size);
 
 	size_ = size;
 	tmp_.resize(size_, size_);
-	mat_.resize(size_, size_);
-	mat_.setZero();
+	// with the mapping, mat_ keeps the pattern the values are accumulated in
+	if (!has_mapping())
+	{
+		mat_.resize(size_, size_);
+		mat_.setZero();
+	}
+	else if (has_pattern(mat_))
+		set_zero();
+	else
+		set_pattern(mat_);
 }
 
 void polyfem::utils::SparseMatrixCache::init(const size_t rows, const size_t cols)
 {
-	assert(mapping().empty());
+	assert(!has_mapping());
 
 	size_ = rows == cols ? rows : 0;
 	tmp_.resize(rows, cols);
@@ -81,25 +90,29 @@ void polyfem::utils::SparseMatrixCache::init(const SparseMatrixCache &other)
 	}
 	size_ = other.size_;
 
-	values_.resize(other.values_.size());
-
 	tmp_.resize(other.mat_.rows(), other.mat_.cols());
-	mat_.resize(other.mat_.rows(), other.mat_.cols());
-	mat_.setZero();
-	std::fill(values_.begin(), values_.end(), 0);
+	if (has_mapping())
+		set_pattern(mat_);
+	else
+	{
+		mat_.resize(other.mat_.rows(), other.mat_.cols());
+		mat_.setZero();
+	}
 }
 
 void polyfem::utils::SparseMatrixCache::set_zero()
 {
 	tmp_.setZero();
-	mat_.setZero();
 
-	std::fill(values_.begin(), values_.end(), 0);
+	if (has_mapping())
+		maybe_parallel_fill(mat_.valuePtr(), mat_.nonZeros(), 0.0);
+	else
+		mat_.setZero();
 }
 
 void polyfem::utils::SparseMatrixCache::add_value(const int e, const int i, const int j, const double value)
 {
-	if (mapping().empty())
+	if (!has_mapping())
 	{
 		entries_.emplace_back(i, j, value);
 		if (second_cache_entries_.size() <= e)
@@ -116,33 +129,75 @@ void polyfem::utils::SparseMatrixCache::add_value(const int e, const int i, cons
 				current_e_index_ = 0;
 			}
 
-			values_[second_cache()[e][current_e_index_]] += value;
+			add_element_value(e, current_e_index_, value);
 			current_e_index_++;
 		}
 		else
-		{
-			// mapping()[i].find(j)
-			const auto &map = mapping()[i];
-			bool found = false;
-			for (const auto &p : map)
-			{
-				if (p.first == j)
-				{
-					assert(p.second < values_.size());
-					values_[p.second] += value;
-					found = true;
-					break;
-				}
-			}
-			assert(found);
-		}
+			mat_.valuePtr()[find_slot(i, j)] += value;
 	}
 }
 
+size_t polyfem::utils::SparseMatrixCache::find_slot(const int i, const int j) const
+{
+	// column major, the rows of column j are sorted in inner_index[outer_index[j], outer_index[j + 1])
+	const auto &outer_index = this->outer_index();
+	const auto &inner_index = this->inner_index();
+	assert(j + 1 < outer_index.size());
+
+	const auto begin = inner_index.begin() + outer_index[j];
+	const auto end = inner_index.begin() + outer_index[j + 1];
+	const auto it = std::lower_bound(begin, end, i);
+	assert(it != end && *it == i);
+
+	return it - inner_index.begin();
+}
+
+bool polyfem::utils::SparseMatrixCache::has_pattern(const StiffnessMatrix &mat) const
+{
+	const auto &outer_index = this->outer_index();
+	const auto &inner_index = this->inner_index();
+
+	return mat.rows() == size_ && mat.cols() == size_ && mat.isCompressed() && mat.nonZeros() == inner_index.size()
+		   && std::equal(outer_index.begin(), outer_index.end(), mat.outerIndexPtr())
+		   && std::equal(inner_index.begin(), inner_index.end(), mat.innerIndexPtr());
+}
+
+void polyfem::utils::SparseMatrixCache::set_pattern(StiffnessMatrix &mat) const
+{
+	const auto &outer_index = this->outer_index();
+	const auto &inner_index = this->inner_index();
+	assert(size_ > 0 && outer_index.size() == size_ + 1);
+
+	mat.resize(size_, size_);
+	mat.resizeNonZeros(inner_index.size());
+	std::copy(outer_index.begin(), outer_index.end(), mat.outerIndexPtr());
+	std::copy(inner_index.begin(), inner_index.end(), mat.innerIndexPtr());
+	// the values are first touched by the threads of the assembly, not by the caller
+	maybe_parallel_fill(mat.valuePtr(), inner_index.size(), 0.0);
+}
+
+std::atomic<size_t> polyfem::utils::SparseMatrixCache::peak_triplets_memory_(0);
+
+size_t polyfem::utils::SparseMatrixCache::memory_usage() const
+{
+	size_t res = utils::memory_usage(tmp_) + utils::memory_usage(mat_);
+	res += entries_.capacity() * sizeof(Eigen::Triplet<double>);
+	res += (inner_index_.capacity() + outer_index_.capacity()) * sizeof(int);
+	res += second_cache_offsets_.capacity() * sizeof(size_t) + second_cache_.capacity() * sizeof(int);
+	for (const auto &c : second_cache_entries_)
+		res += c.capacity() * sizeof(std::pair<int, int>);
+	return res;
+}
+
 void polyfem::utils::SparseMatrixCache::prune()
 {
-	if (mapping().empty())
+	if (!has_mapping())
 	{
+		const size_t triplets_memory = entries_.capacity() * sizeof(Eigen::Triplet<double>);
+		size_t peak = peak_triplets_memory_.load();
+		while (triplets_memory > peak && !peak_triplets_memory_.compare_exchange_weak(peak, triplets_memory))
+			;
+
 		tmp_.setFromTriplets(entries_.begin(), entries_.end());
 		tmp_.makeCompressed();
 		mat_ += tmp_;
@@ -158,84 +213,68 @@ void polyfem::utils::SparseMatrixCache::prune()
 }
 
 polyfem::StiffnessMatrix polyfem::utils::SparseMatrixCache::get_matrix(const bool compute_mapping)
+{
+	StiffnessMatrix out;
+	get_matrix(out, compute_mapping);
+	return out;
+}
+
+void polyfem::utils::SparseMatrixCache::get_matrix(StiffnessMatrix &out, const bool compute_mapping)
 {
 	prune();
 
-	if (mapping().empty())
+	if (!has_mapping())
 	{
 		if (compute_mapping && size_ > 0)
 		{
 			assert(main_cache_ == nullptr);
 
-			values_.resize(mat_.nonZeros());
-			inner_index_.resize(mat_.nonZeros());
-			outer_index_.resize(mat_.rows() + 1);
-			mapping_.resize(mat_.rows());
-
 			const auto inn_ptr = mat_.innerIndexPtr();
 			const auto out_ptr = mat_.outerIndexPtr();
-			inner_index_.assign(inn_ptr, inn_ptr + inner_index_.size());
-			outer_index_.assign(out_ptr, out_ptr + outer_index_.size());
-
-			size_t index = 0;
-			for (size_t i = 0; i < mat_.rows(); ++i)
-			{
-
-				const auto start = outer_index_[i];
-				const auto end = outer_index_[i + 1];
-
-				for (size_t ii = start; ii < end; ++ii)
-				{
-					const auto j = inner_index_[ii];
-					auto &map = mapping_[j];
-					map.emplace_back(i, index);
-					++index;
-				}
-			}
+			inner_index_.assign(inn_ptr, inn_ptr + mat_.nonZeros());
+			outer_index_.assign(out_ptr, out_ptr + mat_.outerSize() + 1);
 
 			logger().trace("Cache computed");
 
 			if (use_second_cache_)
 			{
-				second_cache_.clear();
-				second_cache_.resize(second_cache_entries_.size());
-				for (int e = 0; e < second_cache_entries_.size(); ++e)
-				{
-					for (const auto &p : second_cache_entries_[e])
+				const int n_elements = second_cache_entries_.size();
+				second_cache_offsets_.resize(n_elements + 1);
+				second_cache_offsets_[0] = 0;
+				for (int e = 0; e < n_elements; ++e)
+					second_cache_offsets_[e + 1] = second_cache_offsets_[e] + second_cache_entries_[e].size();
+
+				second_cache_.resize(second_cache_offsets_.back());
+				maybe_parallel_for(n_elements, [&](int start, int end, int thread_id) {
+					for (int e = start; e < end; ++e)
 					{
-						const int i = p.first;
-						const int j = p.second;
-
-						const auto &map = mapping()[i];
-						int index = -1;
-						for (const auto &p : map)
-						{
-							if (p.first == j)
-							{
-								assert(p.second < values_.size());
-								index = p.second;
-								break;
-							}
-						}
-						assert(index >= 0);
-
-						second_cache_[e].emplace_back(index);
+						const auto &entries = second_cache_entries_[e];
+						for (size_t k = 0; k < entries.size(); ++k)
+							second_cache_[second_cache_offsets_[e] + k] = find_slot(entries[k].first, entries[k].second);
 					}
-				}
+				});
 
+				compute_element_colors();
 				second_cache_entries_.resize(0);
 
 				logger().trace("Second cache computed");
 			}
 		}
+
+		out = mat_;
+		// mat_ has the pattern and accumulates the values of the next assembly
+		if (has_mapping())
+			set_zero();
 	}
 	else
 	{
 		assert(size_ > 0);
-		const auto &outer_index = main_cache_ == nullptr ? outer_index_ : main_cache_->outer_index_;
-		const auto &inner_index = main_cache_ == nullptr ? inner_index_ : main_cache_->inner_index_;
-		mat_ = Eigen::Map<const StiffnessMatrix>(
-			size_, size_, values_.size(), &outer_index[0], &inner_index[0], &values_[0]);
+		out.swap(mat_);
+
+		if (has_pattern(mat_))
+			set_zero();
+		else
+			set_pattern(mat_);
 
 		if (use_second_cache_)
 		{
@@ -247,15 +286,74 @@ polyfem::StiffnessMatrix polyfem::utils::SparseMatrixCache::get_matrix(const boo
 		else
 			logger().trace("Using cache");
 	}
-	std::fill(values_.begin(), values_.end(), 0);
-	return mat_;
+}
+
+void polyfem::utils::SparseMatrixCache::compute_element_colors()
+{
+	POLYFEM_SCOPED_TIMER("element coloring");
+
+	const int n_elements = second_cache_entries_.size();
+
+	// dofs touched by each element, an element writes only entries (i, j) with i and j among its dofs
+	std::vector<std::vector<int>> element_dofs(n_elements);
+	std::vector<std::vector<int>> dof_elements(mat_.rows());
+	for (int e = 0; e < n_elements; ++e)
+	{
+		auto &dofs = element_dofs[e];
+		dofs.reserve(second_cache_entries_[e].size());
+		for (const auto &p : second_cache_entries_[e])
+			dofs.push_back(p.first);
+		std::sort(dofs.begin(), dofs.end());
+		dofs.erase(std::unique(dofs.begin(), dofs.end()), dofs.end());
+
+		for (const int d : dofs)
+			dof_elements[d].push_back(e);
+	}
+
+	std::vector<int> colors(n_elements, -1);
+	std::vector<int> forbidden; // forbidden[c] == e if color c is used by a neighbor of e
+	int n_colors = 0;
+	for (int e = 0; e < n_elements; ++e)
+	{
+		if (element_dofs[e].empty())
+			continue;
+
+		for (const int d : element_dofs[e])
+		{
+			for (const int other : dof_elements[d])
+			{
+				if (colors[other] >= 0)
+					forbidden[colors[other]] = e;
+			}
+		}
+
+		int c = 0;
+		while (c < n_colors && forbidden[c] == e)
+			++c;
+		if (c == n_colors)
+		{
+			++n_colors;
+			forbidden.push_back(-1);
+		}
+		colors[e] = c;
+	}
+
+	element_colors_.clear();
+	element_colors_.resize(n_colors);
+	for (int e = 0; e < n_elements; ++e)
+	{
+		if (colors[e] >= 0)
+			element_colors_[colors[e]].push_back(e);
+	}
+
+	logger().trace("Element coloring computed, {} colors", n_colors);
 }
 
 polyfem::utils::SparseMatrixCache polyfem::utils::SparseMatrixCache::operator+(const SparseMatrixCache &a) const
 {
 	polyfem::utils::SparseMatrixCache out(a);
 
-	if (a.mapping().empty() || mapping().empty())
+	if (!a.has_mapping() || !has_mapping())
 	{
 		out.mat_ = a.mat_ + mat_;
 		if (use_second_cache_)
@@ -288,12 +386,16 @@ polyfem::utils::SparseMatrixCache polyfem::utils::SparseMatrixCache::operator+(c
 		const auto &ainner_index = a.main_cache_ == nullptr ? a.inner_index_ : a.main_cache_->inner_index_;
 		assert(ainner_index.size() == inner_index.size());
 		assert(aouter_index.size() == outer_index.size());
-		assert(a.values_.size() == values_.size());
+		assert(a.mat_.nonZeros() == mat_.nonZeros());
 
-		maybe_parallel_for(a.values_.size(), [&](int start, int end, int thread_id) {
+		const double *a_values = a.mat_.valuePtr();
+		const double *values = mat_.valuePtr();
+		double *out_values = out.mat_.valuePtr();
+		// same split as the fill of the values, the threads read the pages they touched first
+		maybe_parallel_for_static(mat_.nonZeros(), [&](int start, int end, int thread_id) {
 			for (int i = start; i < end; ++i)
 			{
-				out.values_[i] = a.values_[i] + values_[i];
+				out_values[i] = a_values[i] + values[i];
 			}
 		});
 	}
@@ -303,7 +405,7 @@ polyfem::utils::SparseMatrixCache polyfem::utils::SparseMatrixCache::operator+(c
 
 void polyfem::utils::SparseMatrixCache::operator+=(const SparseMatrixCache &o)
 {
-	if (mapping().empty() || o.mapping().empty())
+	if (!has_mapping() || !o.has_mapping())
 	{
 		mat_ += o.mat_;
 
@@ -313,11 +415,14 @@ void polyfem::utils::SparseMatrixCache::operator+=(const SparseMatrixCache &o)
 			const size_t o_e_size = o.second_cache_entries_.size();
 
 			second_cache_entries_.resize(std::max(this_e_size, o_e_size));
-			for (int e = 0; e < o_e_size; ++e)
-			{
-				assert(second_cache_entries_[e].size() == 0 || o.second_cache_entries_[e].size() == 0);
-				second_cache_entries_[e].insert(second_cache_entries_[e].end(), o.second_cache_entries_[e].begin(), o.second_cache_entries_[e].end());
-			}
+			// each element is owned by a single cache, so the entries can be merged independently
+			maybe_parallel_for(o_e_size, [&](int start, int end, int thread_id) {
+				for (int e = start; e < end; ++e)
+				{
+					assert(second_cache_entries_[e].size() == 0 || o.second_cache_entries_[e].size() == 0);
+					second_cache_entries_[e].insert(second_cache_entries_[e].end(), o.second_cache_entries_[e].begin(), o.second_cache_entries_[e].end());
+				}
+			});
 		}
 	}
 	else
@@ -328,12 +433,14 @@ void polyfem::utils::SparseMatrixCache::operator+=(const SparseMatrixCache &o)
 		const auto &oinner_index = o.main_cache_ == nullptr ? o.inner_index_ : o.main_cache_->inner_index_;
 		assert(inner_index.size() == oinner_index.size());
 		assert(outer_index.size() == oouter_index.size());
-		assert(values_.size() == o.values_.size());
+		assert(mat_.nonZeros() == o.mat_.nonZeros());
 
-		maybe_parallel_for(o.values_.size(), [&](int start, int end, int thread_id) {
+		const double *o_values = o.mat_.valuePtr();
+		double *values = mat_.valuePtr();
+		maybe_parallel_for_static(mat_.nonZeros(), [&](int start, int end, int thread_id) {
 			for (int i = start; i < end; ++i)
 			{
-				values_[i] += o.values_[i];
+				values[i] += o_values[i];
 			}
 		});
 	}
@@ -348,6 +455,282 @@ namespace
 } // namespace
 
 // Flatten rowwises
+void polyfem::utils::SparseMatrixAccumulator::clear()
+{
+	pattern_.resize(0, 0);
+	scatter_.clear();
+	outer_index_.clear();
+	inner_index_.clear();
+	removed_vars_.clear();
+	reduced_size_ = -1;
+}
+
+bool polyfem::utils::SparseMatrixAccumulator::same_pattern(const std::vector<const StiffnessMatrix *> &mats, const int reduced_size, const std::vector<int> &removed_vars) const
+{
+	if (reduced_size != reduced_size_ || mats.size() != scatter_.size() || removed_vars != removed_vars_)
+		return false;
+
+	for (size_t k = 0; k < mats.size(); ++k)
+	{
+		const StiffnessMatrix &m = *mats[k];
+		assert(m.isCompressed());
+
+		if (m.outerSize() + 1 != outer_index_[k].size() || m.nonZeros() != inner_index_[k].size())
+			return false;
+		if (!std::equal(m.outerIndexPtr(), m.outerIndexPtr() + m.outerSize() + 1, outer_index_[k].begin()))
+			return false;
+		if (!std::equal(m.innerIndexPtr(), m.innerIndexPtr() + m.nonZeros(), inner_index_[k].begin()))
+			return false;
+	}
+
+	return true;
+}
+
+void polyfem::utils::SparseMatrixAccumulator::rebuild(const std::vector<const StiffnessMatrix *> &mats, const int full_size, const int reduced_size, const std::vector<int> &removed_vars)
+{
+	POLYFEM_SCOPED_TIMER("rebuild sum pattern");
+
+	const bool reduce = reduced_size != full_size;
+
+	Eigen::VectorXi indices(full_size);
+	int index = 0;
+	size_t kk = 0;
+	for (int i = 0; i < full_size; ++i)
+	{
+		if (reduce && kk < removed_vars.size() && removed_vars[kk] == i)
+		{
+			++kk;
+			indices(i) = -1;
+		}
+		else
+			indices(i) = index++;
+	}
+	assert(index == reduced_size);
+
+	size_t n_entries = 0;
+	for (const StiffnessMatrix *m : mats)
+		n_entries += m->nonZeros();
+
+	std::vector<Eigen::Triplet<double>> entries;
+	entries.reserve(n_entries);
+	for (const StiffnessMatrix *mp : mats)
+	{
+		const StiffnessMatrix &m = *mp;
+		assert(m.rows() == full_size && m.cols() == full_size);
+		for (int k = 0; k < m.outerSize(); ++k)
+		{
+			if (indices(k) < 0)
+				continue;
+
+			for (StiffnessMatrix::InnerIterator it(m, k); it; ++it)
+			{
+				if (indices(it.row()) >= 0)
+					entries.emplace_back(indices(it.row()), indices(it.col()), 0);
+			}
+		}
+	}
+
+	pattern_.resize(reduced_size, reduced_size);
+	pattern_.setFromTriplets(entries.begin(), entries.end());
+	pattern_.makeCompressed();
+
+	scatter_.resize(mats.size());
+	outer_index_.resize(mats.size());
+	inner_index_.resize(mats.size());
+	for (size_t k = 0; k < mats.size(); ++k)
+	{
+		const StiffnessMatrix &m = *mats[k];
+		outer_index_[k].assign(m.outerIndexPtr(), m.outerIndexPtr() + m.outerSize() + 1);
+		inner_index_[k].assign(m.innerIndexPtr(), m.innerIndexPtr() + m.nonZeros());
+
+		std::vector<StiffnessMatrix::StorageIndex> &scatter = scatter_[k];
+		scatter.assign(m.nonZeros(), -1);
+		for (int c = 0; c < m.outerSize(); ++c)
+		{
+			const int rc = indices(c);
+			if (rc < 0)
+				continue;
+
+			const StiffnessMatrix::StorageIndex *begin = pattern_.innerIndexPtr() + pattern_.outerIndexPtr()[rc];
+			const StiffnessMatrix::StorageIndex *end = pattern_.innerIndexPtr() + pattern_.outerIndexPtr()[rc + 1];
+			for (StiffnessMatrix::StorageIndex nz = m.outerIndexPtr()[c]; nz < m.outerIndexPtr()[c + 1]; ++nz)
+			{
+				const StiffnessMatrix::StorageIndex rr = indices(m.innerIndexPtr()[nz]);
+				if (rr < 0)
+					continue;
+
+				const StiffnessMatrix::StorageIndex *pos = std::lower_bound(begin, end, rr);
+				assert(pos != end && *pos == rr);
+				scatter[nz] = pos - pattern_.innerIndexPtr();
+			}
+		}
+	}
+
+	removed_vars_ = removed_vars;
+	reduced_size_ = reduced_size;
+	++n_rebuilds_;
+}
+
+void polyfem::utils::SparseMatrixAccumulator::sum(
+	const std::vector<StiffnessMatrix> &mats,
+	const int full_size,
+	const int reduced_size,
+	const std::vector<int> &removed_vars,
+	StiffnessMatrix &out)
+{
+	std::vector<const StiffnessMatrix *> ptrs(mats.size());
+	for (size_t k = 0; k < mats.size(); ++k)
+		ptrs[k] = &mats[k];
+	sum(ptrs, std::vector<double>(mats.size(), 1.0), full_size, reduced_size, removed_vars, out);
+}
+
+void polyfem::utils::SparseMatrixAccumulator::sum(
+	const std::vector<const StiffnessMatrix *> &mats,
+	const std::vector<double> &scales,
+	const int full_size,
+	const int reduced_size,
+	const std::vector<int> &removed_vars,
+	StiffnessMatrix &out)
+{
+	POLYFEM_SCOPED_TIMER("sum sparse matrices");
+	assert(mats.size() == scales.size());
+
+	if (!same_pattern(mats, reduced_size, removed_vars))
+		rebuild(mats, full_size, reduced_size, removed_vars);
+
+	double *values = pattern_.valuePtr();
+	std::fill(values, values + pattern_.nonZeros(), 0.0);
+
+	for (size_t k = 0; k < mats.size(); ++k)
+	{
+		const double *m_values = mats[k]->valuePtr();
+		const double scale = scales[k];
+		const std::vector<StiffnessMatrix::StorageIndex> &scatter = scatter_[k];
+		if (scale == 1)
+		{
+			for (size_t nz = 0; nz < scatter.size(); ++nz)
+			{
+				if (scatter[nz] >= 0)
+					values[scatter[nz]] += m_values[nz];
+			}
+		}
+		else
+		{
+			for (size_t nz = 0; nz < scatter.size(); ++nz)
+			{
+				if (scatter[nz] >= 0)
+					values[scatter[nz]] += scale * m_values[nz];
+			}
+		}
+	}
+
+	out = pattern_;
+}
+
+size_t polyfem::utils::sparse_pattern_hash(const StiffnessMatrix &M)
+{
+	assert(M.isCompressed());
+
+	// FNV-1a over the index arrays
+	size_t hash = 14695981039346656037ULL;
+	const auto combine = [&hash](const size_t v) {
+		hash ^= v;
+		hash *= 1099511628211ULL;
+	};
+
+	combine(M.rows());
+	combine(M.cols());
+	combine(M.nonZeros());
+	for (Eigen::Index i = 0; i <= M.outerSize(); ++i)
+		combine(M.outerIndexPtr()[i]);
+	for (Eigen::Index i = 0; i < M.nonZeros(); ++i)
+		combine(M.innerIndexPtr()[i]);
+
+	return hash;
+}
+
+double polyfem::utils::compensated_sum(const Eigen::Ref<const Eigen::VectorXd> &x)
+{
+	double sum = 0;
+	double compensation = 0;
+	for (Eigen::Index i = 0; i < x.size(); ++i)
+	{
+		const double t = sum + x[i];
+		// Neumaier: the lost low-order bits are those of the smaller term
+		if (std::abs(sum) >= std::abs(x[i]))
+			compensation += (sum - t) + x[i];
+		else
+			compensation += (x[i] - t) + sum;
+		sum = t;
+	}
+	return sum + compensation;
+}
+
+namespace
+{
+	// large enough to amortize the task overhead, small enough to stay in cache
+	constexpr Eigen::Index vector_block_size = 1 << 14;
+
+	int n_vector_blocks(const Eigen::Index size)
+	{
+		return int((size + vector_block_size - 1) / vector_block_size);
+	}
+
+	// calls f(begin, size) on the blocks of a vector of the given size, in parallel if there are several
+	template <typename F>
+	void for_each_vector_block(const Eigen::Index size, const F &f)
+	{
+		const int n_blocks = n_vector_blocks(size);
+		if (n_blocks <= 1)
+		{
+			f(0, 0, size);
+			return;
+		}
+
+		polyfem::utils::maybe_parallel_for(n_blocks, [&](int start, int end, int /*thread_id*/) {
+			for (int k = start; k < end; ++k)
+			{
+				const Eigen::Index begin = k * vector_block_size;
+				f(k, begin, std::min(vector_block_size, size - begin));
+			}
+		});
+	}
+} // namespace
+
+double polyfem::utils::parallel_dot(const Eigen::Ref<const Eigen::VectorXd> &a, const Eigen::Ref<const Eigen::VectorXd> &b)
+{
+	assert(a.size() == b.size());
+	std::vector<double> partial(std::max(n_vector_blocks(a.size()), 1), 0.0);
+	for_each_vector_block(a.size(), [&](const int k, const Eigen::Index begin, const Eigen::Index size) {
+		partial[k] = a.segment(begin, size).dot(b.segment(begin, size));
+	});
+	return std::accumulate(partial.begin(), partial.end(), 0.0);
+}
+
+void polyfem::utils::parallel_axpy(const double alpha, const Eigen::Ref<const Eigen::VectorXd> &x, Eigen::Ref<Eigen::VectorXd> y)
+{
+	assert(x.size() == y.size());
+	for_each_vector_block(x.size(), [&](const int, const Eigen::Index begin, const Eigen::Index size) {
+		y.segment(begin, size) += alpha * x.segment(begin, size);
+	});
+}
+
+double polyfem::utils::parallel_axpy_dot(
+	const double alpha,
+	const Eigen::Ref<const Eigen::VectorXd> &x,
+	Eigen::Ref<Eigen::VectorXd> y,
+	const Eigen::Ref<const Eigen::VectorXd> &z)
+{
+	assert(x.size() == y.size() && y.size() == z.size());
+	std::vector<double> partial(std::max(n_vector_blocks(x.size()), 1), 0.0);
+	for_each_vector_block(x.size(), [&](const int k, const Eigen::Index begin, const Eigen::Index size) {
+		// the block of y is still in cache for the dot product
+		y.segment(begin, size) += alpha * x.segment(begin, size);
+		partial[k] = y.segment(begin, size).dot(z.segment(begin, size));
+	});
+	return std::accumulate(partial.begin(), partial.end(), 0.0);
+}
+
 Eigen::VectorXd polyfem::utils::flatten(const Eigen::MatrixXd &X)
 {
 	if (X.size() == 0)
@@ -461,6 +844,106 @@ void polyfem::utils::full_to_reduced_matrix(
 	reduced.makeCompressed();
 }
 
+void polyfem::utils::apply_dirichlet_in_place(
+	StiffnessMatrix &A,
+	const std::vector<int> &dirichlet_vars)
+{
+	POLYFEM_SCOPED_TIMER("apply dirichlet in place");
+
+	assert(A.rows() == A.cols());
+	if (dirichlet_vars.empty())
+		return;
+
+	std::vector<bool> is_dirichlet(A.rows(), false);
+	for (const int i : dirichlet_vars)
+	{
+		assert(i >= 0 && i < A.rows());
+		is_dirichlet[i] = true;
+	}
+
+	std::vector<bool> has_diagonal(A.rows(), false);
+	for (int k = 0; k < A.outerSize(); ++k)
+	{
+		for (StiffnessMatrix::InnerIterator it(A, k); it; ++it)
+		{
+			if (!is_dirichlet[it.row()] && !is_dirichlet[it.col()])
+				continue;
+
+			if (it.row() == it.col())
+			{
+				it.valueRef() = 1;
+				has_diagonal[it.row()] = true;
+			}
+			else
+				it.valueRef() = 0;
+		}
+	}
+
+	// only a structurally missing diagonal changes the pattern
+	bool inserted = false;
+	for (const int i : dirichlet_vars)
+	{
+		if (has_diagonal[i])
+			continue;
+		A.coeffRef(i, i) = 1;
+		inserted = true;
+	}
+	if (inserted)
+		A.makeCompressed();
+}
+
+void polyfem::utils::lift_dirichlet_rhs(
+	const StiffnessMatrix &A,
+	const std::vector<int> &dirichlet_vars,
+	Eigen::VectorXd &b)
+{
+	assert(A.rows() == A.cols() && A.rows() == b.size());
+	if (dirichlet_vars.empty())
+		return;
+
+	std::vector<bool> is_dirichlet(A.rows(), false);
+	for (const int i : dirichlet_vars)
+		is_dirichlet[i] = true;
+
+	// A is column major, the Dirichlet columns are contiguous
+	for (const int j : dirichlet_vars)
+	{
+		const double value = b(j);
+		if (value == 0)
+			continue;
+		for (StiffnessMatrix::InnerIterator it(A, j); it; ++it)
+		{
+			if (!is_dirichlet[it.row()])
+				b(it.row()) -= it.value() * value;
+		}
+	}
+}
+
+void polyfem::utils::map_sparse_matrix(
+	const StiffnessMatrix &A,
+	const StiffnessMatrix &map,
+	StiffnessMatrix &out)
+{
+	assert(A.rows() == A.cols());
+	assert(map.cols() == A.rows());
+
+	std::vector<Eigen::Triplet<double>> entries;
+	entries.reserve(A.nonZeros()); // Exact for selections
+	for (int k = 0; k < A.outerSize(); ++k)
+	{
+		for (StiffnessMatrix::InnerIterator it(A, k); it; ++it)
+		{
+			for (StiffnessMatrix::InnerIterator i(map, it.row()); i; ++i)
+				for (StiffnessMatrix::InnerIterator j(map, it.col()); j; ++j)
+					entries.emplace_back(i.row(), j.row(), i.value() * j.value() * it.value());
+		}
+	}
+
+	out.resize(map.rows(), map.rows());
+	out.setFromTriplets(entries.begin(), entries.end());
+	out.makeCompressed();
+}
+
 Eigen::MatrixXd polyfem::utils::reorder_matrix(
 	const Eigen::MatrixXd &in,
 	const Eigen::VectorXi &in_to_out,
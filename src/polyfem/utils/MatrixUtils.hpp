@@ -6,6 +6,8 @@
 #include <Eigen/Dense>
 #include <Eigen/Sparse>
 
+#include <atomic>
+
 namespace polyfem
 {
 	namespace utils
@@ -29,6 +31,20 @@ namespace polyfem
 			return T(0);
 		}
 
+		/// size in bytes of the coefficients of a dense matrix
+		template <typename Derived>
+		inline size_t memory_usage(const Eigen::PlainObjectBase<Derived> &mat)
+		{
+			return mat.size() * sizeof(typename Derived::Scalar);
+		}
+
+		/// size in bytes of the values and indices of a sparse matrix
+		template <typename T, int Options, typename StorageIndex>
+		inline size_t memory_usage(const Eigen::SparseMatrix<T, Options, StorageIndex> &mat)
+		{
+			return mat.data().allocatedSize() * (sizeof(T) + sizeof(StorageIndex)) + (mat.outerSize() + 1) * sizeof(StorageIndex);
+		}
+
 		inline Eigen::SparseMatrix<double> sparse_identity(int rows, int cols)
 		{
 			Eigen::SparseMatrix<double> I(rows, cols);
@@ -53,11 +69,31 @@ namespace polyfem
 			inline void reserve(const size_t size) { entries_.reserve(size); }
 			inline size_t entries_size() const { return entries_.size(); }
 			inline size_t capacity() const { return entries_.capacity(); }
-			inline size_t non_zeros() const { return mapping_.empty() ? mat_.nonZeros() : values_.size(); }
-			inline size_t mapping_size() const { return mapping_.size(); }
+			inline size_t non_zeros() const { return mat_.nonZeros(); }
+			inline size_t mapping_size() const { return has_mapping() ? outer_index().size() - 1 : 0; }
 
 			void add_value(const int e, const int i, const int j, const double value);
+
+			/// Adds value to the k-th entry (in insertion order) of element e, requires the mapping to be computed.
+			/// It does not modify any other state, so it can be called concurrently for elements of the same color.
+			inline void add_element_value(const int e, const int k, const double value)
+			{
+				assert(!second_cache().empty());
+				assert(second_cache_offsets()[e] + k < second_cache_offsets()[e + 1]);
+				mat_.valuePtr()[second_cache()[second_cache_offsets()[e] + k]] += value;
+			}
+
+			/// Partition of the elements such that no two elements of the same color write the same entry,
+			/// it is computed with the mapping and empty before.
+			inline const std::vector<std::vector<int>> &element_colors() const
+			{
+				return main_cache_ == nullptr ? element_colors_ : main_cache_->element_colors_;
+			}
+
 			StiffnessMatrix get_matrix(const bool compute_mapping = true);
+			/// Same as get_matrix, with the mapping the assembled values are swapped into out without copy and
+			/// the previous storage of out becomes the buffer of the next assembly (reused if it has the same pattern).
+			void get_matrix(StiffnessMatrix &out, const bool compute_mapping = true);
 			void prune();
 
 			SparseMatrixCache operator+(const SparseMatrixCache &a) const;
@@ -66,32 +102,137 @@ namespace polyfem
 			const StiffnessMatrix &mat() const { return mat_; }
 			const std::vector<Eigen::Triplet<double>> &entries() const { return entries_; }
 
+			/// size in bytes of the matrices, triplets and mappings owned by the cache
+			size_t memory_usage() const;
+			/// largest triplet buffer (bytes) pruned by any cache since the start of the run
+			static size_t peak_triplets_memory() { return peak_triplets_memory_; }
+
 		private:
 			size_t size_;
 			StiffnessMatrix tmp_, mat_;
 			std::vector<Eigen::Triplet<double>> entries_;
-			std::vector<std::vector<std::pair<int, size_t>>> mapping_;
+			/// compressed pattern of the matrix, the mapping is computed when they are not empty.
+			/// With the mapping the values are accumulated in place in mat_, which has this pattern.
 			std::vector<int> inner_index_, outer_index_;
-			std::vector<double> values_;
 			const SparseMatrixCache *main_cache_ = nullptr;
 
-			std::vector<std::vector<int>> second_cache_;
+			/// slots in the values of the entries of each element in insertion order, flattened:
+			/// the entries of e are in [second_cache_offsets_[e], second_cache_offsets_[e + 1])
+			std::vector<size_t> second_cache_offsets_;
+			std::vector<int> second_cache_;
 			std::vector<std::vector<std::pair<int, int>>> second_cache_entries_;
+			std::vector<std::vector<int>> element_colors_;
 			bool use_second_cache_ = true;
 			int current_e_ = -1;
 			int current_e_index_ = -1;
 
-			inline const std::vector<std::vector<std::pair<int, size_t>>> &mapping() const
+			static std::atomic<size_t> peak_triplets_memory_;
+
+			inline const std::vector<int> &outer_index() const
+			{
+				return main_cache_ == nullptr ? outer_index_ : main_cache_->outer_index_;
+			}
+
+			inline const std::vector<int> &inner_index() const
+			{
+				return main_cache_ == nullptr ? inner_index_ : main_cache_->inner_index_;
+			}
+
+			inline bool has_mapping() const { return !outer_index().empty(); }
+
+			inline const std::vector<size_t> &second_cache_offsets() const
 			{
-				return main_cache_ == nullptr ? mapping_ : main_cache_->mapping_;
+				return main_cache_ == nullptr ? second_cache_offsets_ : main_cache_->second_cache_offsets_;
 			}
 
-			inline const std::vector<std::vector<int>> &second_cache() const
+			inline const std::vector<int> &second_cache() const
 			{
 				return main_cache_ == nullptr ? second_cache_ : main_cache_->second_cache_;
 			}
+
+			/// position in the values of the entry (i, j), binary search in the compressed pattern
+			size_t find_slot(const int i, const int j) const;
+
+			bool has_pattern(const StiffnessMatrix &mat) const;
+			/// sets mat to the mapped pattern with zero values
+			void set_pattern(StiffnessMatrix &mat) const;
+
+			/// greedy coloring of the elements from the rows in second_cache_entries_
+			void compute_element_colors();
+		};
+
+		/// Sums sparse matrices into a single union pattern over the kept variables. The pattern and the
+		/// per summand scatter maps are reused as long as the summand patterns and the removed variables do not change.
+		class SparseMatrixAccumulator
+		{
+		public:
+			/// @brief Sum matrices and drop rows and columns in one pass.
+			/// @param[in] mats Full size compressed matrices to sum.
+			/// @param[in] full_size Number of variables in the full system.
+			/// @param[in] reduced_size Number of variables in the output, removed_vars is ignored if equal to full_size.
+			/// @param[in] removed_vars Sorted indices of the variables (rows and columns) to remove.
+			/// @param[out] out Output reduced size sum.
+			void sum(
+				const std::vector<StiffnessMatrix> &mats,
+				const int full_size,
+				const int reduced_size,
+				const std::vector<int> &removed_vars,
+				StiffnessMatrix &out);
+
+			/// @brief Sum scaled matrices and drop rows and columns in one pass, the summands are not copied.
+			/// @param[in] mats Full size compressed matrices to sum.
+			/// @param[in] scales Factor of each matrix.
+			/// @param[in] full_size Number of variables in the full system.
+			/// @param[in] reduced_size Number of variables in the output, removed_vars is ignored if equal to full_size.
+			/// @param[in] removed_vars Sorted indices of the variables (rows and columns) to remove.
+			/// @param[out] out Output reduced size sum.
+			void sum(
+				const std::vector<const StiffnessMatrix *> &mats,
+				const std::vector<double> &scales,
+				const int full_size,
+				const int reduced_size,
+				const std::vector<int> &removed_vars,
+				StiffnessMatrix &out);
+
+			/// Forget the pattern, the next sum rebuilds it
+			void clear();
+
+			/// Number of times the pattern has been rebuilt
+			inline int n_rebuilds() const { return n_rebuilds_; }
+
+		private:
+			bool same_pattern(const std::vector<const StiffnessMatrix *> &mats, const int reduced_size, const std::vector<int> &removed_vars) const;
+			void rebuild(const std::vector<const StiffnessMatrix *> &mats, const int full_size, const int reduced_size, const std::vector<int> &removed_vars);
+
+			StiffnessMatrix pattern_;
+			/// position in pattern_ of every non-zero of every summand, -1 for removed entries
+			std::vector<std::vector<StiffnessMatrix::StorageIndex>> scatter_;
+			std::vector<std::vector<StiffnessMatrix::StorageIndex>> outer_index_, inner_index_;
+			std::vector<int> removed_vars_;
+			int reduced_size_ = -1;
+			int n_rebuilds_ = 0;
 		};
 
+		/// @brief Hash of the sparsity pattern (size, outer and inner indices) of a compressed matrix, values are ignored.
+		size_t sparse_pattern_hash(const StiffnessMatrix &M);
+
+		/// @brief Compensated (Kahan-Babuska) sum of the entries, summed in order.
+		double compensated_sum(const Eigen::Ref<const Eigen::VectorXd> &x);
+
+		/// @brief Blocked parallel dot product, the partial sums of fixed size blocks are added in order
+		/// so that the result does not depend on the number of threads.
+		double parallel_dot(const Eigen::Ref<const Eigen::VectorXd> &a, const Eigen::Ref<const Eigen::VectorXd> &b);
+
+		/// @brief Blocked parallel y += alpha * x.
+		void parallel_axpy(const double alpha, const Eigen::Ref<const Eigen::VectorXd> &x, Eigen::Ref<Eigen::VectorXd> y);
+
+		/// @brief Blocked parallel y += alpha * x, returns the updated y dot z computed in the same pass.
+		double parallel_axpy_dot(
+			const double alpha,
+			const Eigen::Ref<const Eigen::VectorXd> &x,
+			Eigen::Ref<Eigen::VectorXd> y,
+			const Eigen::Ref<const Eigen::VectorXd> &z);
+
 		/// Flatten rowwises
 		Eigen::VectorXd flatten(const Eigen::MatrixXd &X);
 
@@ -116,6 +257,33 @@ namespace polyfem
 			const StiffnessMatrix &full,
 			StiffnessMatrix &reduced);
 
+		/// @brief Replace the Dirichlet rows and columns by rows and columns of the identity, editing only the values.
+		/// Unlike full_to_reduced_matrix, the pattern does not depend on the Dirichlet variables, so the symbolic
+		/// analysis of a solver can be reused when they change. The result stays symmetric if A is.
+		/// @param[in, out] A Square matrix, its missing Dirichlet diagonal entries are inserted.
+		/// @param[in] dirichlet_vars Indices of the Dirichlet variables.
+		void apply_dirichlet_in_place(
+			StiffnessMatrix &A,
+			const std::vector<int> &dirichlet_vars);
+
+		/// @brief Move the Dirichlet columns of A to the right-hand side, b_i -= sum_j A_ij b_j for the free i and Dirichlet j.
+		/// @param[in] A Square matrix before apply_dirichlet_in_place.
+		/// @param[in] dirichlet_vars Indices of the Dirichlet variables.
+		/// @param[in, out] b Right-hand side holding the Dirichlet values in its Dirichlet entries, they are kept.
+		void lift_dirichlet_rhs(
+			const StiffnessMatrix &A,
+			const std::vector<int> &dirichlet_vars,
+			Eigen::VectorXd &b);
+
+		/// @brief Compute map * A * map^T with one pass over the entries of A, without sparse products.
+		/// @param[in] A Square matrix.
+		/// @param[in] map Matrix with A.rows() columns, each column holds the output variables of a variable of A (e.g., a selection).
+		/// @param[out] out Output map.rows() x map.rows() matrix.
+		void map_sparse_matrix(
+			const StiffnessMatrix &A,
+			const StiffnessMatrix &map,
+			StiffnessMatrix &out);
+
 		/// @brief Reorder row blocks in a matrix.
 		/// @param in Input matrix.
 		/// @param in_to_out Mapping from input blocks to output blocks.
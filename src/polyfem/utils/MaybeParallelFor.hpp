@@ -4,6 +4,8 @@
 #include <tbb/parallel_for.h>
 #include <tbb/parallel_reduce.h>
 #include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_sort.h>
+#include <tbb/task_arena.h>
 #elif defined(POLYFEM_WITH_CPP_THREADS)
 #include <polyfem/utils/par_for.hpp>
 #else
@@ -14,12 +16,68 @@ namespace polyfem
 {
 	namespace utils
 	{
+#if defined(POLYFEM_WITH_TBB)
+		using TaskArena = tbb::task_arena;
+#else
+		// without TBB the loops run on the threads of par_for or serially
+		class TaskArena
+		{
+		};
+#endif
+
+		// Arena in which the maybe_parallel_* calls of the current thread run, nullptr for the default arena.
+		inline TaskArena *&current_task_arena()
+		{
+			static thread_local TaskArena *arena = nullptr;
+			return arena;
+		}
+
+		// Runs the maybe_parallel_* calls of the current thread in arena (if not null) during its lifetime,
+		// the calls made by the worker threads already run in the arena of their caller.
+		class TaskArenaScope
+		{
+		public:
+			TaskArenaScope(TaskArena *arena)
+				: previous_(current_task_arena())
+			{
+				if (arena)
+					current_task_arena() = arena;
+			}
+
+			~TaskArenaScope() { current_task_arena() = previous_; }
+
+			TaskArenaScope(const TaskArenaScope &) = delete;
+			TaskArenaScope &operator=(const TaskArenaScope &) = delete;
+
+		private:
+			TaskArena *const previous_;
+		};
+
 		// Perform a parallel (maybe) for loop.
 		// The parallel for used depends on the compile definitions.
 		// The overall for loop is from 0 up to `size` with an increment of 1.
+		// With TBB the loop runs in current_task_arena().
 		inline void maybe_parallel_for(int size, const std::function<void(int, int, int)> &partial_for);
 		inline void maybe_parallel_for(int size, const std::function<void(int)> &body);
 
+		// Perform a parallel (maybe) for loop split in contiguous ranges of about the same length, one per thread.
+		// Unlike maybe_parallel_for the split only depends on size and the number of threads, with TBB the
+		// static partitioner gives the same range to the same thread in the calls of the same size.
+		inline void maybe_parallel_for_static(int size, const std::function<void(int, int, int)> &partial_for);
+
+		// Sets [data, data + size) to value with maybe_parallel_for_static. The pages of a newly allocated
+		// array are first touched, hence placed in the NUMA node, of the threads filling them; small arrays are filled serially.
+		template <typename T>
+		inline void maybe_parallel_fill(T *data, size_t size, const T &value);
+
+		// Maximal number of threads running the maybe_parallel_for calls of the current thread.
+		inline int maybe_max_concurrency();
+
+		// Sort [begin, end) in parallel when using TBB, with std::sort otherwise.
+		// As for std::sort, the order of equivalent elements is unspecified.
+		template <typename RandomIt>
+		inline void maybe_parallel_sort(RandomIt begin, RandomIt end);
+
 		// Returns thread specific storage for further use in `maybe_parallel_for()`.
 		// The return type depends on the threading library used.
 		//     TBB         ⟹ `std::vector<LocalStorage>`
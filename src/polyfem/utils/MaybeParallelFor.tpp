@@ -1,9 +1,14 @@
 #include <polyfem/utils/MaybeParallelFor.hpp>
 
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+
 #if defined(POLYFEM_WITH_TBB)
 #include <tbb/parallel_for.h>
 #include <tbb/parallel_reduce.h>
 #include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_sort.h>
 #elif defined(POLYFEM_WITH_CPP_THREADS)
 #include <polyfem/utils/par_for.hpp>
 #include <execution>
@@ -15,13 +20,26 @@ namespace polyfem
 {
 	namespace utils
 	{
+#if defined(POLYFEM_WITH_TBB)
+		template <typename F>
+		inline void in_current_arena(const F &f)
+		{
+			if (TaskArena *arena = current_task_arena())
+				arena->execute(f);
+			else
+				f();
+		}
+#endif
+
 		inline void maybe_parallel_for(int size, const std::function<void(int, int, int)> &partial_for)
 		{
 #if defined(POLYFEM_WITH_CPP_THREADS)
 			par_for(size, partial_for);
 #elif defined(POLYFEM_WITH_TBB)
-			tbb::parallel_for(tbb::blocked_range<int>(0, size), [&](const tbb::blocked_range<int> &r) {
-				partial_for(r.begin(), r.end(), tbb::this_task_arena::current_thread_index());
+			in_current_arena([&]() {
+				tbb::parallel_for(tbb::blocked_range<int>(0, size), [&](const tbb::blocked_range<int> &r) {
+					partial_for(r.begin(), r.end(), tbb::this_task_arena::current_thread_index());
+				});
 			});
 #else
 			partial_for(0, size, /*thread_id=*/0); // actually the full for loop
@@ -31,16 +49,76 @@ namespace polyfem
 		inline void maybe_parallel_for(int size, const std::function<void(int)> &body)
 		{
 #if defined(POLYFEM_WITH_CPP_THREADS)
-			for (int i = 0; i < size; ++i)
-				body(i);
+			par_for(size, [&](int start, int end, int /*thread_id*/) {
+				for (int i = start; i < end; ++i)
+					body(i);
+			});
 #elif defined(POLYFEM_WITH_TBB)
-			tbb::parallel_for(0, size, body);
+			in_current_arena([&]() { tbb::parallel_for(0, size, body); });
 #else
 			for (int i = 0; i < size; ++i)
 				body(i);
 #endif
 		}
 
+		inline void maybe_parallel_for_static(int size, const std::function<void(int, int, int)> &partial_for)
+		{
+#if defined(POLYFEM_WITH_CPP_THREADS)
+			// the chunks of par_for are taken dynamically, the ranges are contiguous but not bound to a thread
+			par_for(size, partial_for);
+#elif defined(POLYFEM_WITH_TBB)
+			in_current_arena([&]() {
+				tbb::parallel_for(
+					tbb::blocked_range<int>(0, size), [&](const tbb::blocked_range<int> &r) {
+						partial_for(r.begin(), r.end(), tbb::this_task_arena::current_thread_index());
+					},
+					tbb::static_partitioner());
+			});
+#else
+			partial_for(0, size, /*thread_id=*/0);
+#endif
+		}
+
+		template <typename T>
+		inline void maybe_parallel_fill(T *data, size_t size, const T &value)
+		{
+			// a block of a few pages per index, the arrays below 16 blocks are not worth the threads
+			constexpr size_t block = size_t(1) << 13;
+			if (size < 16 * block)
+			{
+				std::fill(data, data + size, value);
+				return;
+			}
+
+			const int n_blocks = int((size + block - 1) / block);
+			maybe_parallel_for_static(n_blocks, [&](int start, int end, int /*thread_id*/) {
+				std::fill(data + start * block, data + std::min(size, end * block), value);
+			});
+		}
+
+		inline int maybe_max_concurrency()
+		{
+#if defined(POLYFEM_WITH_CPP_THREADS)
+			return std::max<int>(1, get_n_threads());
+#elif defined(POLYFEM_WITH_TBB)
+			if (TaskArena *arena = current_task_arena())
+				return arena->max_concurrency();
+			return tbb::this_task_arena::max_concurrency();
+#else
+			return 1;
+#endif
+		}
+
+		template <typename RandomIt>
+		inline void maybe_parallel_sort(RandomIt begin, RandomIt end)
+		{
+#if defined(POLYFEM_WITH_TBB)
+			in_current_arena([&]() { tbb::parallel_sort(begin, end); });
+#else
+			std::sort(begin, end);
+#endif
+		}
+
 		template <typename LocalStorage>
 		inline auto create_thread_storage(const LocalStorage &initial_local_storage)
 		{
@@ -0,0 +1,225 @@
+#include "Profiler.hpp"
+
+#include <polyfem/utils/Logger.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+
+namespace polyfem::utils
+{
+	Profiler &Profiler::instance()
+	{
+		static Profiler profiler;
+		return profiler;
+	}
+
+	Profiler::Profiler()
+		: epoch_(std::chrono::steady_clock::now())
+	{
+	}
+
+	void Profiler::set_enabled(const bool val)
+	{
+#ifndef POLYFEM_WITH_PROFILER
+		if (val)
+			logger().warn("PolyFEM was built without POLYFEM_WITH_PROFILER, only the scopes opened explicitly are recorded");
+#endif
+		enabled_ = val;
+	}
+
+	int64_t Profiler::now() const
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch_).count();
+	}
+
+	void Profiler::ThreadData::reset(const size_t buffer_size)
+	{
+		nodes.clear();
+		nodes.push_back({"", -1});
+		stack.clear();
+		events.assign(buffer_size, {-1, 0, 0});
+		n_events = 0;
+	}
+
+	std::string Profiler::ThreadData::path(int node) const
+	{
+		std::string res = nodes[node].name;
+		for (node = nodes[node].parent; node > 0; node = nodes[node].parent)
+			res = nodes[node].name + "/" + res;
+		return res;
+	}
+
+	Profiler::ThreadData &Profiler::thread_data()
+	{
+		// the data outlives the thread, the scopes of finished threads are still exported
+		thread_local ThreadData *data = nullptr;
+		if (data == nullptr)
+		{
+			std::lock_guard<std::mutex> lock(threads_mutex_);
+			auto tmp = std::make_shared<ThreadData>();
+			tmp->id = threads_.size();
+			tmp->reset(buffer_size_);
+			threads_.push_back(tmp);
+			data = tmp.get();
+		}
+		return *data;
+	}
+
+	void Profiler::begin(const std::string &name)
+	{
+		ThreadData &data = thread_data();
+		const int64_t start = now();
+
+		std::lock_guard<std::mutex> lock(data.mutex);
+		const int parent = data.stack.empty() ? 0 : data.stack.back().first;
+
+		int node = -1;
+		for (const int c : data.nodes[parent].children)
+		{
+			if (data.nodes[c].name == name)
+			{
+				node = c;
+				break;
+			}
+		}
+		if (node < 0)
+		{
+			node = data.nodes.size();
+			data.nodes.push_back({name, parent});
+			data.nodes[parent].children.push_back(node);
+		}
+
+		data.stack.emplace_back(node, start);
+	}
+
+	void Profiler::end()
+	{
+		ThreadData &data = thread_data();
+		const int64_t stop = now();
+
+		std::lock_guard<std::mutex> lock(data.mutex);
+		// the scope was opened before a clear
+		if (data.stack.empty())
+			return;
+
+		const auto [node, start] = data.stack.back();
+		data.stack.pop_back();
+
+		Node &n = data.nodes[node];
+		++n.calls;
+		n.total += stop - start;
+
+		if (!data.events.empty())
+		{
+			data.events[data.n_events % data.events.size()] = {node, start, stop};
+			++data.n_events;
+		}
+	}
+
+	void Profiler::clear()
+	{
+		std::lock_guard<std::mutex> lock(threads_mutex_);
+		for (auto &data : threads_)
+		{
+			std::lock_guard<std::mutex> data_lock(data->mutex);
+			data->reset(buffer_size_);
+		}
+	}
+
+	json Profiler::summary() const
+	{
+		struct Entry
+		{
+			int64_t calls = 0;
+			int64_t total = 0;
+			int64_t self = 0;
+			int threads = 0;
+		};
+		// sorted by path, the children follow their parent
+		std::map<std::string, Entry> entries;
+
+		{
+			std::lock_guard<std::mutex> lock(threads_mutex_);
+			for (const auto &data : threads_)
+			{
+				std::lock_guard<std::mutex> data_lock(data->mutex);
+				for (int i = 1; i < data->nodes.size(); ++i)
+				{
+					const Node &n = data->nodes[i];
+					if (n.calls == 0)
+						continue;
+
+					int64_t children = 0;
+					for (const int c : n.children)
+						children += data->nodes[c].total;
+
+					Entry &e = entries[data->path(i)];
+					e.calls += n.calls;
+					e.total += n.total;
+					e.self += std::max<int64_t>(n.total - children, 0);
+					++e.threads;
+				}
+			}
+		}
+
+		json res = json::array();
+		for (const auto &[path, e] : entries)
+		{
+			res.push_back({
+				{"path", path},
+				{"calls", e.calls},
+				{"total", e.total * 1e-9},
+				{"self", e.self * 1e-9},
+				{"mean", e.total * 1e-9 / e.calls},
+				{"threads", e.threads},
+			});
+		}
+		return res;
+	}
+
+	void Profiler::save_chrome_trace(const std::string &path) const
+	{
+		json events = json::array();
+
+		{
+			std::lock_guard<std::mutex> lock(threads_mutex_);
+			for (const auto &data : threads_)
+			{
+				std::lock_guard<std::mutex> data_lock(data->mutex);
+
+				events.push_back({{"name", "thread_name"}, {"ph", "M"}, {"pid", 0}, {"tid", data->id}, {"args", {{"name", fmt::format("thread {}", data->id)}}}});
+
+				const size_t size = data->events.size();
+				const size_t n = std::min(data->n_events, size);
+				// oldest first
+				for (size_t k = data->n_events - n; k < data->n_events; ++k)
+				{
+					const Event &ev = data->events[k % size];
+					events.push_back({
+						{"name", data->nodes[ev.node].name},
+						{"cat", "polyfem"},
+						{"ph", "X"},
+						{"ts", ev.start * 1e-3},
+						{"dur", (ev.stop - ev.start) * 1e-3},
+						{"pid", 0},
+						{"tid", data->id},
+					});
+				}
+				if (data->n_events > size)
+					logger().warn("Profiler: {} scopes of thread {} were overwritten, increase the buffer size", data->n_events - size, data->id);
+			}
+		}
+
+		std::ofstream out(path);
+		if (!out.is_open())
+		{
+			logger().error("Unable to save the profile to {}", path);
+			return;
+		}
+		json trace;
+		trace["traceEvents"] = events;
+		trace["displayTimeUnit"] = "ms";
+		out << trace.dump() << std::endl;
+	}
+} // namespace polyfem::utils
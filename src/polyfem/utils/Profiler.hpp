@@ -0,0 +1,123 @@
+#pragma once
+
+#include <polyfem/Common.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef POLYFEM_WITH_PROFILER
+#define POLYFEM_PROFILE_CONCAT_IMPL(a, b) a##b
+#define POLYFEM_PROFILE_CONCAT(a, b) POLYFEM_PROFILE_CONCAT_IMPL(a, b)
+#define POLYFEM_PROFILE_SCOPE(name) polyfem::utils::ProfileScope POLYFEM_PROFILE_CONCAT(__polyfem_profile_, __LINE__)(name)
+#else
+#define POLYFEM_PROFILE_SCOPE(name)
+#endif
+
+namespace polyfem::utils
+{
+	/// @brief Hierarchical profiler of the named scopes (POLYFEM_SCOPED_TIMER and POLYFEM_PROFILE_SCOPE).
+	/// Every thread keeps its own scope stack, call tree (aggregated calls and time by call path) and ring buffer
+	/// of the last scopes, so recording does not contend between threads.
+	/// It is disabled by default and enabled at runtime, without POLYFEM_WITH_PROFILER the scopes compile to nothing.
+	class Profiler
+	{
+	public:
+		static Profiler &instance();
+
+		inline bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+		void set_enabled(const bool val);
+
+		/// @brief Number of scopes kept per thread for the trace, the oldest are overwritten. Applied by clear.
+		void set_buffer_size(const size_t size) { buffer_size_ = size; }
+
+		/// @brief Opens a scope on the calling thread
+		void begin(const std::string &name);
+		/// @brief Closes the last scope opened on the calling thread
+		void end();
+
+		/// @brief Drops the recorded scopes, must not be called while scopes are open
+		void clear();
+
+		/// @brief Calls, total and self time (in seconds) per call path, merged over the threads
+		json summary() const;
+
+		/// @brief Saves the scopes in the ring buffers as a Chrome trace (chrome://tracing, Perfetto)
+		/// @param[in] path output JSON file
+		void save_chrome_trace(const std::string &path) const;
+
+	private:
+		Profiler();
+
+		struct Node
+		{
+			std::string name;
+			int parent;
+			std::vector<int> children;
+			int64_t calls = 0;
+			/// nanoseconds
+			int64_t total = 0;
+		};
+
+		struct Event
+		{
+			int node;
+			int64_t start;
+			int64_t stop;
+		};
+
+		struct ThreadData
+		{
+			int id;
+			/// call tree, node 0 is the root
+			std::vector<Node> nodes;
+			/// open scopes (node, start)
+			std::vector<std::pair<int, int64_t>> stack;
+			std::vector<Event> events;
+			size_t n_events = 0;
+			/// only contended by the exports
+			mutable std::mutex mutex;
+
+			void reset(const size_t buffer_size);
+			std::string path(int node) const;
+		};
+
+		ThreadData &thread_data();
+		int64_t now() const;
+
+		std::atomic<bool> enabled_{false};
+		size_t buffer_size_ = 1 << 16;
+		const std::chrono::steady_clock::time_point epoch_;
+
+		mutable std::mutex threads_mutex_;
+		std::vector<std::shared_ptr<ThreadData>> threads_;
+	};
+
+	/// @brief Scope of the profiler, does nothing if the profiler is disabled when it is created
+	class ProfileScope
+	{
+	public:
+		ProfileScope(const std::string &name)
+			: active_(Profiler::instance().enabled())
+		{
+			if (active_)
+				Profiler::instance().begin(name);
+		}
+
+		~ProfileScope()
+		{
+			if (active_)
+				Profiler::instance().end();
+		}
+
+		ProfileScope(const ProfileScope &) = delete;
+		ProfileScope &operator=(const ProfileScope &) = delete;
+
+	private:
+		const bool active_;
+	};
+} // namespace polyfem::utils
@@ -1,6 +1,10 @@
 #include "RBFInterpolation.hpp"
 
 #include <polyfem/utils/Logger.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
+
+#include <Eigen/Sparse>
+
 #include <cmath>
 #include <iostream>
 
@@ -40,6 +44,12 @@ namespace polyfem
 				rbf_pum::init(pointscl, functioncl, data_[i], verbose_, rbfcl_, opt_, unit_cube_, num_threads_);
 			}
 #else
+			if (rbf == "wendland" || rbf == "wendland_c2")
+			{
+				init_compact(fun, pts, eps);
+				return;
+			}
+
 			std::function<double(double)> tmp;
 
 			if (rbf == "multiquadric")
@@ -101,6 +111,8 @@ namespace polyfem
 
 			rbf_ = rbf;
 			centers_ = pts;
+			support_radius_ = 0;
+			grid_.clear();
 
 			const int n = centers_.rows();
 
@@ -124,6 +136,99 @@ namespace polyfem
 #endif
 		}
 
+#ifndef POLYFEM_OPENCL
+		long long RBFInterpolation::cell_key(const Eigen::RowVectorXd &p, const Eigen::RowVector3i &offset) const
+		{
+			// 21 bits per coordinate
+			unsigned long long key = 0;
+			for (int d = 0; d < 3; ++d)
+			{
+				const long long c = d < p.size() ? (long long)(std::floor(p[d] / support_radius_)) + offset[d] : 0;
+				key = (key << 21) | ((unsigned long long)c & 0x1FFFFF);
+			}
+			return (long long)key;
+		}
+
+		void RBFInterpolation::neighbors(const Eigen::RowVectorXd &p, std::vector<int> &ids) const
+		{
+			ids.clear();
+			const int dz = p.size() == 3 ? 1 : 0;
+			for (int i = -1; i <= 1; ++i)
+			{
+				for (int j = -1; j <= 1; ++j)
+				{
+					for (int k = -dz; k <= dz; ++k)
+					{
+						const auto it = grid_.find(cell_key(p, Eigen::RowVector3i(i, j, k)));
+						if (it != grid_.end())
+							ids.insert(ids.end(), it->second.begin(), it->second.end());
+					}
+				}
+			}
+		}
+
+		void RBFInterpolation::init_compact(const Eigen::MatrixXd &fun, const Eigen::MatrixXd &pts, const double radius)
+		{
+			assert(pts.rows() == fun.rows());
+			if (radius <= 0)
+				log_and_throw_error("Invalid support radius {} of the compact rbf", radius);
+			if (pts.cols() < 1 || pts.cols() > 3)
+				log_and_throw_error("Compact rbf only supports points in 1, 2, or 3 dimensions, got {}", pts.cols());
+
+			// Wendland C2, positive definite up to dimension 3
+			rbf_ = [radius](const double r) {
+				const double x = r / radius;
+				if (x >= 1)
+					return 0.;
+				const double y = 1 - x;
+				return y * y * y * y * (4 * x + 1);
+			};
+			centers_ = pts;
+			support_radius_ = radius;
+
+			const int n = centers_.rows();
+			grid_.clear();
+			for (int i = 0; i < n; ++i)
+				grid_[cell_key(centers_.row(i), Eigen::RowVector3i::Zero())].push_back(i);
+
+			struct LocalStorage
+			{
+				std::vector<Eigen::Triplet<double>> entries;
+				std::vector<int> ids;
+			};
+			auto storage = create_thread_storage(LocalStorage());
+
+			maybe_parallel_for(n, [&](int start, int end, int thread_id) {
+				LocalStorage &local_storage = get_local_thread_storage(storage, thread_id);
+				for (int i = start; i < end; ++i)
+				{
+					neighbors(centers_.row(i), local_storage.ids);
+					for (const int j : local_storage.ids)
+					{
+						const double val = rbf_((centers_.row(i) - centers_.row(j)).norm());
+						if (val != 0)
+							local_storage.entries.emplace_back(i, j, val);
+					}
+				}
+			});
+
+			std::vector<Eigen::Triplet<double>> entries;
+			for (const LocalStorage &local_storage : storage)
+				entries.insert(entries.end(), local_storage.entries.begin(), local_storage.entries.end());
+
+			Eigen::SparseMatrix<double> A(n, n);
+			A.setFromTriplets(entries.begin(), entries.end());
+
+			Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> solver(A);
+			if (solver.info() != Eigen::Success)
+				log_and_throw_error("Unable to factorize the compact rbf system, are there duplicated points?");
+
+			weights_ = solver.solve(fun);
+
+			logger().debug("Compact rbf with {} centers and {} non zeros", n, A.nonZeros());
+		}
+#endif
+
 		Eigen::MatrixXd RBFInterpolation::interpolate(const Eigen::MatrixXd &pts) const
 		{
 #ifdef POLYFEM_OPENCL
@@ -152,16 +257,27 @@ namespace polyfem
 			const int n = centers_.rows();
 			const int m = pts.rows();
 
-			Eigen::MatrixXd mat(m, n);
-			for (int i = 0; i < m; ++i)
-			{
-				for (int j = 0; j < n; ++j)
+			Eigen::MatrixXd res(m, weights_.cols());
+
+			// evaluated point by point, the m x n kernel matrix is never formed
+			maybe_parallel_for(m, [&](int start, int end, int thread_id) {
+				std::vector<int> ids;
+				for (int i = start; i < end; ++i)
 				{
-					mat(i, j) = rbf_((centers_.row(j) - pts.row(i)).norm());
+					res.row(i).setZero();
+					if (support_radius_ > 0)
+					{
+						neighbors(pts.row(i), ids);
+						for (const int j : ids)
+							res.row(i) += rbf_((centers_.row(j) - pts.row(i)).norm()) * weights_.row(j);
+					}
+					else
+					{
+						for (int j = 0; j < n; ++j)
+							res.row(i) += rbf_((centers_.row(j) - pts.row(i)).norm()) * weights_.row(j);
+					}
 				}
-			}
-
-			const Eigen::MatrixXd res = mat * weights_;
+			});
 #endif
 			return res;
 		}
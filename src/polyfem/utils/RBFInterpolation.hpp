@@ -4,6 +4,8 @@
 
 #include <functional>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #ifdef POLYFEM_OPENCL
 #include <rbf_interpolate.hpp>
@@ -13,6 +15,10 @@ namespace polyfem
 {
 	namespace utils
 	{
+		/// Radial basis function interpolation of scattered data.
+		/// Global kernels (multiquadric, thin plate, ...) solve a dense system over all the points.
+		/// The compactly supported Wendland kernel ("wendland", support radius eps) only couples the points
+		/// closer than eps: the system is sparse and the evaluation only visits the neighboring centers.
 		class RBFInterpolation
 		{
 		public:
@@ -35,10 +41,21 @@ namespace polyfem
 
 			std::vector<rbf_pum::RBFData> data_;
 #else
+			void init_compact(const Eigen::MatrixXd &fun, const Eigen::MatrixXd &pts, const double radius);
+
+			/// centers in the grid cells touching the ball of radius support_radius_ around p
+			void neighbors(const Eigen::RowVectorXd &p, std::vector<int> &ids) const;
+			long long cell_key(const Eigen::RowVectorXd &p, const Eigen::RowVector3i &offset) const;
+
 			Eigen::MatrixXd centers_;
 			Eigen::MatrixXd weights_;
 
 			std::function<double(double)> rbf_;
+
+			/// support radius of the compact kernel, 0 for global kernels
+			double support_radius_ = 0;
+			/// centers bucketed in a hashed grid with cells of size support_radius_
+			std::unordered_map<long long, std::vector<int>> grid_;
 #endif
 		};
 	} // namespace utils
@@ -7,6 +7,7 @@
 
 #include <polyfem/io/MatrixIO.hpp>
 
+#include <algorithm>
 #include <memory>
 
 namespace polyfem::utils
@@ -115,6 +116,12 @@ namespace polyfem::utils
 		return inside;
 	}
 
+	bool BoxSelection::bounds(BBox &bbox) const
+	{
+		bbox = bbox_;
+		return true;
+	}
+
 	// ------------------------------------------------------------------------
 
 	BoxSideSelection::BoxSideSelection(
@@ -180,6 +187,14 @@ namespace polyfem::utils
 		return (p - center_).squaredNorm() <= radius2_;
 	}
 
+	bool SphereSelection::bounds(BBox &bbox) const
+	{
+		const double radius = std::sqrt(radius2_);
+		bbox[0] = center_.array() - radius;
+		bbox[1] = center_.array() + radius;
+		return true;
+	}
+
 	// ------------------------------------------------------------------------
 
 	CylinderSelection::CylinderSelection(
@@ -221,6 +236,15 @@ namespace polyfem::utils
 		return (v - axis_ * proj).squaredNorm() <= radius2_;
 	}
 
+	bool CylinderSelection::bounds(BBox &bbox) const
+	{
+		const double radius = std::sqrt(radius2_);
+		const RowVectorNd p2 = point_ + height_ * axis_;
+		bbox[0] = point_.cwiseMin(p2).array() - radius;
+		bbox[1] = point_.cwiseMax(p2).array() + radius;
+		return true;
+	}
+
 	// ------------------------------------------------------------------------
 
 	AxisPlaneSelection::AxisPlaneSelection(
@@ -323,18 +347,17 @@ namespace polyfem::utils
 		}
 		else
 		{
-			data_.resize(mat.rows());
+			data_.reserve(mat.rows());
 
 			for (int i = 0; i < mat.rows(); ++i)
 			{
-				data_[i].first = mat(i, 0) + id_offset;
-
+				std::vector<int> vs(mat.cols() - 1);
 				for (int j = 1; j < mat.cols(); ++j)
-				{
-					data_[i].second.push_back(mat(i, j));
-				}
+					vs[j - 1] = mat(i, j);
+				std::sort(vs.begin(), vs.end());
 
-				std::sort(data_[i].second.begin(), data_[i].second.end());
+				// the first row of a primitive wins
+				data_.emplace(std::move(vs), mat(i, 0) + id_offset);
 			}
 		}
 	}
@@ -344,13 +367,7 @@ namespace polyfem::utils
 		if (data_.empty())
 			return SpecifiedSelection::inside(p_id, vs, p);
 
-		std::vector<int> tmp;
-		for (const auto &t : data_)
-		{
-			if (t.second == vs)
-				return true;
-		}
-		return false;
+		return data_.find(vs) != data_.end();
 	}
 
 	int FileSelection::id(const size_t element_id, const std::vector<int> &vs, const RowVectorNd &p) const
@@ -358,12 +375,66 @@ namespace polyfem::utils
 		if (data_.empty())
 			return SpecifiedSelection::id(element_id, vs, p);
 
-		std::vector<int> tmp;
-		for (const auto &t : data_)
+		const auto it = data_.find(vs);
+		return it == data_.end() ? -1 : it->second;
+	}
+
+	// ------------------------------------------------------------------------
+
+	SelectionList::SelectionList(const std::vector<std::shared_ptr<Selection>> &selections)
+		: selections_(selections)
+	{
+		std::vector<std::array<Eigen::Vector3d, 2>> boxes;
+		for (int i = 0; i < selections_.size(); ++i)
+		{
+			Selection::BBox bbox;
+			if (!selections_[i]->bounds(bbox))
+			{
+				unbounded_.push_back(i);
+				continue;
+			}
+
+			// conservative bounds, the inside test is exact
+			std::array<Eigen::Vector3d, 2> box;
+			box[0].setZero();
+			box[1].setZero();
+			const double eps = 1e-10 * std::max(1.0, (bbox[1] - bbox[0]).norm());
+			for (int d = 0; d < bbox[0].size(); ++d)
+			{
+				box[0][d] = bbox[0][d] - eps;
+				box[1][d] = bbox[1][d] + eps;
+			}
+			boxes.push_back(box);
+			bounded_.push_back(i);
+		}
+
+		if (!boxes.empty())
+			bvh_.init(boxes);
+	}
+
+	int SelectionList::id(const size_t p_id, const std::vector<int> &vs, const RowVectorNd &p, const int default_id) const
+	{
+		std::vector<unsigned int> boxes;
+		if (!bounded_.empty())
+		{
+			const Eigen::Vector3d q(p[0], p[1], p.size() > 2 ? p[2] : 0);
+			bvh_.intersect_box(q, q, boxes);
+		}
+
+		std::vector<int> candidates;
+		candidates.reserve(unbounded_.size() + boxes.size());
+		for (const unsigned int b : boxes)
+			candidates.push_back(bounded_[b]);
+		std::sort(candidates.begin(), candidates.end());
+		const size_t n_bounded = candidates.size();
+		candidates.insert(candidates.end(), unbounded_.begin(), unbounded_.end());
+		std::inplace_merge(candidates.begin(), candidates.begin() + n_bounded, candidates.end());
+
+		for (const int i : candidates)
 		{
-			if (t.second == vs)
-				return t.first;
+			if (selections_[i]->inside(p_id, vs, p))
+				return selections_[i]->id(p_id, vs, p);
 		}
-		return -1;
+		return default_id;
 	}
 } // namespace polyfem::utils
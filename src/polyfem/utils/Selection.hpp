@@ -2,6 +2,11 @@
 
 #include <polyfem/mesh/Mesh.hpp>
 #include <polyfem/Common.hpp>
+#include <polyfem/utils/HashUtils.hpp>
+
+#include <BVH.hpp>
+
+#include <unordered_map>
 
 namespace polyfem
 {
@@ -23,6 +28,11 @@ namespace polyfem
 				return id_;
 			}
 
+			/// @brief Axis-aligned bounds of the points for which inside can be true.
+			/// @param[out] bbox bounds, only set if the selection is bounded
+			/// @return false if the selection is not bounded
+			virtual bool bounds(BBox &bbox) const { return false; }
+
 			/// @brief Build a selection objects from a JSON selection.
 			/// @param j_selections JSON object of selection(s).
 			/// @param mesh_bbox    Bounding box of the mesh.
@@ -59,6 +69,7 @@ namespace polyfem
 				const BBox &mesh_bbox);
 
 			bool inside(const size_t p_id, const std::vector<int> &vs, const RowVectorNd &p) const override;
+			bool bounds(BBox &bbox) const override;
 
 		protected:
 			BBox bbox_;
@@ -96,6 +107,7 @@ namespace polyfem
 				const BBox &mesh_bbox);
 
 			bool inside(const size_t p_id, const std::vector<int> &vs, const RowVectorNd &p) const override;
+			bool bounds(BBox &bbox) const override;
 
 		protected:
 			RowVectorNd center_;
@@ -112,6 +124,7 @@ namespace polyfem
 				const BBox &mesh_bbox);
 
 			bool inside(const size_t p_id, const std::vector<int> &vs, const RowVectorNd &p) const override;
+			bool bounds(BBox &bbox) const override;
 
 		protected:
 			RowVectorNd axis_;
@@ -194,7 +207,37 @@ namespace polyfem
 			int id(const size_t element_id, const std::vector<int> &vs, const RowVectorNd &p) const override;
 
 		private:
-			std::vector<std::pair<int, std::vector<int>>> data_;
+			/// sorted vertices of the selected primitives to their id
+			std::unordered_map<std::vector<int>, int, HashVector> data_;
+		};
+
+		// --------------------------------------------------------------------
+
+		/// @brief List of selections in priority order, compiled for fast queries.
+		/// The bounded selections are stored in a BVH of their bounds, so a query only tests
+		/// the unbounded selections and the ones whose bounds contain the point.
+		/// The result is the same as testing the selections in order.
+		class SelectionList
+		{
+		public:
+			SelectionList(const std::vector<std::shared_ptr<Selection>> &selections);
+
+			/// @brief Id of the first selection containing the primitive, safe to call concurrently.
+			/// @param p_id primitive id
+			/// @param vs   sorted vertices of the primitive
+			/// @param p    barycenter of the primitive
+			/// @param default_id id if no selection contains the primitive
+			int id(const size_t p_id, const std::vector<int> &vs, const RowVectorNd &p, const int default_id) const;
+
+			bool empty() const { return selections_.empty(); }
+
+		private:
+			std::vector<std::shared_ptr<Selection>> selections_;
+			/// indices of the unbounded selections, increasing
+			std::vector<int> unbounded_;
+			/// indices of the bounded selections, one per box of the BVH
+			std::vector<int> bounded_;
+			BVH::BVH bvh_;
 		};
 	} // namespace utils
 } // namespace polyfem
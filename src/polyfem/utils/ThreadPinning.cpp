@@ -0,0 +1,81 @@
+#include "ThreadPinning.hpp"
+
+#if defined(POLYFEM_WITH_TBB) && defined(__linux__)
+#define POLYFEM_WITH_THREAD_PINNING
+#include <tbb/task_scheduler_observer.h>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <vector>
+#endif
+
+namespace polyfem
+{
+	namespace utils
+	{
+#ifdef POLYFEM_WITH_THREAD_PINNING
+		class ThreadPinning::Observer : public tbb::task_scheduler_observer
+		{
+		public:
+			Observer(tbb::task_arena &arena)
+				: tbb::task_scheduler_observer(arena)
+			{
+				CPU_ZERO(&process_mask_);
+				if (sched_getaffinity(0, sizeof(cpu_set_t), &process_mask_) == 0)
+				{
+					for (int c = 0; c < CPU_SETSIZE; ++c)
+					{
+						if (CPU_ISSET(c, &process_mask_))
+							cores_.push_back(c);
+					}
+				}
+
+				observe(true);
+			}
+
+			~Observer() { observe(false); }
+
+			void on_scheduler_entry(bool /*is_worker*/) override
+			{
+				const int slot = tbb::this_task_arena::current_thread_index();
+				if (slot < 0 || cores_.empty())
+					return;
+
+				cpu_set_t mask;
+				CPU_ZERO(&mask);
+				CPU_SET(cores_[slot % cores_.size()], &mask);
+				pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &mask);
+			}
+
+			// the workers are shared with the other arenas and the caller continues outside of the arena
+			void on_scheduler_exit(bool /*is_worker*/) override
+			{
+				if (!cores_.empty())
+					pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &process_mask_);
+			}
+
+		private:
+			cpu_set_t process_mask_;
+			std::vector<int> cores_;
+		};
+
+		ThreadPinning::ThreadPinning(TaskArena &arena)
+			: observer_(std::make_unique<Observer>(arena))
+		{
+		}
+
+		bool ThreadPinning::is_supported() { return true; }
+#else
+		class ThreadPinning::Observer
+		{
+		};
+
+		ThreadPinning::ThreadPinning(TaskArena &arena) {}
+
+		bool ThreadPinning::is_supported() { return false; }
+#endif
+
+		ThreadPinning::~ThreadPinning() = default;
+	} // namespace utils
+} // namespace polyfem
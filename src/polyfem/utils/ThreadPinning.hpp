@@ -0,0 +1,33 @@
+#pragma once
+
+#include <polyfem/utils/MaybeParallelFor.hpp>
+
+#include <memory>
+
+namespace polyfem
+{
+	namespace utils
+	{
+		/// Pins the threads running in a task arena to the cores of the process: the thread in the slot i of
+		/// the arena runs on the i-th core of the affinity mask of the process while it is in the arena.
+		/// The arrays filled with maybe_parallel_fill then stay in the NUMA node of the threads using them.
+		/// Only supported with TBB on Linux, it does nothing otherwise.
+		class ThreadPinning
+		{
+		public:
+			/// @param[in] arena arena of the pinned threads, it must outlive the pinning
+			ThreadPinning(TaskArena &arena);
+			~ThreadPinning();
+
+			ThreadPinning(const ThreadPinning &) = delete;
+			ThreadPinning &operator=(const ThreadPinning &) = delete;
+
+			/// the threads can be pinned in this build
+			static bool is_supported();
+
+		private:
+			class Observer;
+			std::unique_ptr<Observer> observer_;
+		};
+	} // namespace utils
+} // namespace polyfem
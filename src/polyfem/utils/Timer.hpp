@@ -4,6 +4,7 @@
 #include <spdlog/fmt/bundled/color.h>
 #include <polyfem/utils/Logger.hpp>
 // clang-format on
+#include <polyfem/utils/Profiler.hpp>
 
 #include <igl/Timer.h>
 
@@ -47,6 +48,13 @@ namespace polyfem
 
 			inline void start()
 			{
+#ifdef POLYFEM_WITH_PROFILER
+				if (!m_name.empty() && !m_profiled && Profiler::instance().enabled())
+				{
+					Profiler::instance().begin(m_name);
+					m_profiled = true;
+				}
+#endif
 				is_running = true;
 				m_timer.start();
 			}
@@ -57,6 +65,13 @@ namespace polyfem
 					return;
 				m_timer.stop();
 				is_running = false;
+#ifdef POLYFEM_WITH_PROFILER
+				if (m_profiled)
+				{
+					Profiler::instance().end();
+					m_profiled = false;
+				}
+#endif
 				log_msg();
 				if (m_total_time)
 				{
@@ -74,7 +89,8 @@ namespace polyfem
 				const static std::string log_fmt_text =
 					fmt::format("[{}] {{}} {{:.3g}}s", fmt::format(fmt::fg(fmt::terminal_color::magenta), "timing"));
 
-				if (!m_name.empty())
+				// the timers of the hot loops skip the formatting when trace is disabled
+				if (!m_name.empty() && logger().should_log(spdlog::level::trace))
 				{
 					logger().trace(log_fmt_text, m_name, getElapsedTimeInSec());
 				}
@@ -90,6 +106,8 @@ namespace polyfem
 			igl::Timer m_timer;
 			double *m_total_time;
 			bool is_running = false;
+			/// the named timers are scopes of the profiler
+			bool m_profiled = false;
 		};
 	} // namespace utils
 } // namespace polyfem
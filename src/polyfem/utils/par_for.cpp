@@ -1,27 +1,171 @@
 #include "par_for.hpp"
 
-#include <vector>
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <vector>
 
 namespace polyfem
 {
 	namespace utils
 	{
+#ifdef POLYFEM_WITH_CPP_THREADS
+		namespace
+		{
+			// true while the thread runs chunks of a loop, nested loops are serial
+			thread_local bool in_parallel_loop = false;
+
+			// Persistent workers, the caller of run is thread 0 and the workers are 1, ..., n - 1.
+			// The range is split in chunks taken from an atomic counter so that the threads finishing
+			// their chunks early take the remaining ones.
+			class ThreadPool
+			{
+			public:
+				static ThreadPool &instance()
+				{
+					static ThreadPool pool;
+					return pool;
+				}
+
+				~ThreadPool() { resize(0); }
+
+				void run(const int size, const std::function<void(int, int, int)> &func, const size_t n_threads)
+				{
+					// the pool runs one loop at a time, concurrent loops (e.g., from another State) are serial
+					std::unique_lock<std::mutex> run_lock(run_mutex_, std::try_to_lock);
+					if (!run_lock.owns_lock())
+					{
+						func(0, size, 0);
+						return;
+					}
+
+					resize(n_threads - 1);
+
+					{
+						std::lock_guard<std::mutex> lock(mutex_);
+						func_ = &func;
+						size_ = size;
+						// a few chunks per thread balance the load without contending on the counter
+						chunk_ = std::max<int>(1, size / (8 * n_threads));
+						next_ = 0;
+						error_ = nullptr;
+						n_active_ = workers_.size();
+						++generation_;
+					}
+					start_cv_.notify_all();
+
+					work(0);
+
+					std::unique_lock<std::mutex> lock(mutex_);
+					done_cv_.wait(lock, [&]() { return n_active_ == 0; });
+					func_ = nullptr;
+
+					if (error_)
+						std::rethrow_exception(error_);
+				}
+
+			private:
+				ThreadPool() {}
+
+				void resize(const size_t n_workers)
+				{
+					if (workers_.size() == n_workers)
+						return;
+
+					{
+						std::lock_guard<std::mutex> lock(mutex_);
+						stop_ = true;
+					}
+					start_cv_.notify_all();
+					for (auto &t : workers_)
+						t.join();
+					workers_.clear();
+
+					stop_ = false;
+					workers_.reserve(n_workers);
+					for (size_t i = 0; i < n_workers; ++i)
+						workers_.emplace_back(&ThreadPool::worker, this, i + 1, generation_);
+				}
+
+				void worker(const int thread_id, size_t generation)
+				{
+					while (true)
+					{
+						{
+							std::unique_lock<std::mutex> lock(mutex_);
+							start_cv_.wait(lock, [&]() { return stop_ || generation_ != generation; });
+							if (stop_)
+								return;
+							generation = generation_;
+						}
+
+						work(thread_id);
+
+						std::lock_guard<std::mutex> lock(mutex_);
+						if (--n_active_ == 0)
+							done_cv_.notify_one();
+					}
+				}
+
+				void work(const int thread_id)
+				{
+					in_parallel_loop = true;
+					try
+					{
+						while (true)
+						{
+							const int start = next_.fetch_add(chunk_);
+							if (start >= size_)
+								break;
+							(*func_)(start, std::min(start + chunk_, size_), thread_id);
+						}
+					}
+					catch (...)
+					{
+						std::lock_guard<std::mutex> lock(mutex_);
+						if (!error_)
+							error_ = std::current_exception();
+						// the other threads stop after their current chunk
+						next_ = size_;
+					}
+					in_parallel_loop = false;
+				}
+
+				std::vector<std::thread> workers_;
+				std::mutex run_mutex_;
+
+				std::mutex mutex_;
+				std::condition_variable start_cv_;
+				std::condition_variable done_cv_;
+				size_t generation_ = 0;
+				bool stop_ = false;
+				size_t n_active_ = 0;
+
+				const std::function<void(int, int, int)> *func_ = nullptr;
+				int size_ = 0;
+				int chunk_ = 1;
+				std::atomic<int> next_{0};
+				std::exception_ptr error_;
+			};
+		} // namespace
+#endif
+
 		void par_for(const int size, const std::function<void(int, int, int)> &func)
 		{
 #ifdef POLYFEM_WITH_CPP_THREADS
-			const size_t n_threads = get_n_threads();
-			std::vector<std::thread> threads(n_threads);
+			if (size <= 0)
+				return;
 
-			for (int t = 0; t < n_threads; t++)
+			const size_t n_threads = get_n_threads();
+			if (n_threads <= 1 || size == 1 || in_parallel_loop)
 			{
-				threads[t] = std::thread(std::bind(
-					func,
-					t * size / n_threads,
-					(t + 1) == n_threads ? size : (t + 1) * size / n_threads,
-					t));
+				func(0, size, 0);
+				return;
 			}
-			std::for_each(threads.begin(), threads.end(), [](std::thread &x) { x.join(); });
+
+			ThreadPool::instance().run(size, func, n_threads);
 #endif
 		}
 	} // namespace utils
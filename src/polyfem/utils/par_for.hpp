@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <functional>
 #include <thread>
 
@@ -10,7 +11,7 @@ namespace polyfem
 		class NThread
 		{
 		public:
-			size_t num_threads;
+			size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
 			static NThread &get()
 			{
 				static NThread instance;
@@ -0,0 +1,177 @@
+////////////////////////////////////////////////////////////////////////////////
+#include <catch2/catch.hpp>
+
+#include <polyfem/State.hpp>
+#include <polyfem/utils/JSONUtils.hpp>
+#include <polyfem/utils/Logger.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+////////////////////////////////////////////////////////////////////////////////
+
+using namespace polyfem;
+
+// The perf tests are only built with POLYFEM_WITH_PERF_TESTS, the global operator new is replaced
+// to count the allocations of the whole binary (all the threads).
+namespace
+{
+	std::atomic<size_t> n_allocations(0);
+}
+
+void *operator new(std::size_t size)
+{
+	n_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void *ptr = std::malloc(size == 0 ? 1 : size))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+	std::free(ptr);
+}
+
+namespace
+{
+	const std::string baselines_path = POLYFEM_TEST_DIR "/perf_baselines.json";
+
+	// sum of the values of key in the nested objects and arrays of j
+	double sum_key(const json &j, const std::string &key)
+	{
+		double res = 0;
+		if (j.is_object())
+		{
+			for (const auto &[k, v] : j.items())
+			{
+				if (k == key && v.is_number())
+					res += v.get<double>();
+				else
+					res += sum_key(v, key);
+			}
+		}
+		else if (j.is_array())
+		{
+			for (const auto &v : j)
+				res += sum_key(v, key);
+		}
+		return res;
+	}
+
+	double env_value(const char *name, const double default_value)
+	{
+		const char *val = std::getenv(name);
+		return val ? std::atof(val) : default_value;
+	}
+
+	/// Runs a scene as in verify_run and returns its metrics
+	json run_scene(const std::string &json_file)
+	{
+		json args;
+		{
+			std::ifstream file(json_file);
+			REQUIRE(file.is_open());
+			file >> args;
+		}
+		args.erase("tests");
+		args["root_path"] = json_file;
+		args["output"] = json({});
+		args["output"]["advanced"]["save_time_sequence"] = false;
+		args["/output/log/level"_json_pointer] = "error";
+		args["/solver/linear/solver"_json_pointer] =
+			json_file.find("navier") == std::string::npos
+				? "Eigen::SimplicialLDLT"
+				: "Eigen::SparseLU";
+
+		State state;
+		state.init(args, true);
+		state.set_max_threads(1);
+
+		const size_t start_memory = io::OutRuntimeData::current_memory();
+		const size_t start_allocations = n_allocations.load();
+		const auto start = std::chrono::steady_clock::now();
+
+		state.load_mesh();
+		REQUIRE(state.mesh != nullptr);
+		state.build_basis();
+		state.assemble_rhs();
+		state.assemble_mass_mat();
+
+		Eigen::MatrixXd sol, pressure;
+		state.solve_problem(sol, pressure);
+
+		const double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		const size_t allocations = n_allocations.load() - start_allocations;
+
+		size_t peak_memory = start_memory;
+		for (const auto &[phase, bytes] : state.timings.phase_memory)
+			peak_memory = std::max(peak_memory, bytes);
+
+		json out;
+		out["time"] = time;
+		out["newton_iterations"] = sum_key(state.stats.solver_info, "iterations");
+		out["linear_iterations"] = sum_key(state.stats.solver_info, "num_iterations");
+		out["allocations"] = double(allocations);
+		out["peak_memory"] = double(peak_memory - start_memory) / (1024 * 1024);
+		return out;
+	}
+} // namespace
+
+// Scenes of perf_test_list.txt, the metrics are compared with perf_baselines.json and a metric fails if
+//     current > baseline * (1 + relative) + absolute
+// with the tolerances of the metric. POLYFEM_PERF_TIME_SCALE scales the time budgets (e.g., 2 on a slower machine)
+// and POLYFEM_PERF_UPDATE_BASELINES=1 records the current metrics as the new baselines.
+// Scenes without baseline are recorded and pass.
+TEST_CASE("perf_runners", "[perf]")
+{
+	json baselines;
+	{
+		std::ifstream file(baselines_path);
+		REQUIRE(file.is_open());
+		file >> baselines;
+	}
+	const json &tolerances = baselines.at("tolerances");
+	const bool update = env_value("POLYFEM_PERF_UPDATE_BASELINES", 0) != 0;
+	const double time_scale = env_value("POLYFEM_PERF_TIME_SCALE", 1);
+
+	std::ifstream file(POLYFEM_TEST_DIR "/perf_test_list.txt");
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		DYNAMIC_SECTION(line)
+		{
+			logger().info("Processing {}", line);
+			const json current = run_scene(POLYFEM_DATA_DIR "/" + line);
+			logger().info("{}: {}", line, current.dump());
+
+			if (update || !baselines["scenes"].contains(line))
+			{
+				logger().warn("Recording the perf baseline of {}", line);
+				baselines["scenes"][line] = current;
+				std::ofstream out(baselines_path);
+				out << baselines.dump(4) << std::endl;
+				continue;
+			}
+
+			const json &baseline = baselines["scenes"][line];
+			for (const auto &[metric, tolerance] : tolerances.items())
+			{
+				if (!baseline.contains(metric))
+					continue;
+
+				const double scale = metric == "time" ? time_scale : 1;
+				const double budget = scale * (baseline[metric].get<double>() * (1 + tolerance["relative"].get<double>()) + tolerance["absolute"].get<double>());
+				const double value = current[metric];
+
+				CAPTURE(line, metric, value, budget, baseline[metric]);
+				CHECK(value <= budget);
+			}
+		}
+	}
+}
@@ -1,9 +1,18 @@
 #include <polyfem/State.hpp>
 
+#include <polyfem/assembler/AssemblerUtils.hpp>
+#include <polyfem/assembler/ElasticKernels.hpp>
+#include <polyfem/assembler/LinearElasticity.hpp>
 #include <polyfem/assembler/NeoHookeanElasticity.hpp>
 #include <polyfem/assembler/NeoHookeanElasticityAutodiff.hpp>
+#include <polyfem/assembler/NavierStokes.hpp>
+#include <polyfem/assembler/SaintVenantElasticity.hpp>
+#include <polyfem/assembler/MatParams.hpp>
+#include <polyfem/assembler/SumFactorization.hpp>
+#include <polyfem/mesh/MeshPartition.hpp>
 
 #include <catch2/catch.hpp>
+#include <algorithm>
 #include <iostream>
 
 using namespace polyfem;
@@ -122,6 +131,599 @@ TEST_CASE("hessian_hooke", "[assembler]")
 	}
 }
 
+TEST_CASE("hessian_vector_product", "[assembler]")
+{
+	const std::string path = POLYFEM_DATA_DIR;
+	json in_args = json({});
+	in_args["geometry"] = {};
+	in_args["geometry"]["mesh"] = path + "/plane_hole.obj";
+	in_args["geometry"]["surface_selection"] = 7;
+
+	in_args["preset_problem"] = {};
+	in_args["preset_problem"]["type"] = "ElasticExact";
+
+	in_args["materials"] = {};
+	in_args["materials"]["type"] = "NeoHookean";
+	in_args["materials"]["E"] = 1e5;
+	in_args["materials"]["nu"] = 0.3;
+
+	State state;
+	state.init_logger("", spdlog::level::err, false);
+	state.init(in_args, true);
+	state.load_mesh();
+
+	state.build_basis();
+
+	SparseMatrixCache mat_cache;
+	StiffnessMatrix hessian;
+	Eigen::MatrixXd disp(state.n_bases * 2, 1);
+	disp.setZero();
+
+	for (int rand = 0; rand < 10; ++rand)
+	{
+		const bool project_to_psd = rand % 2 == 1;
+		state.assembler->assemble_hessian(false, state.n_bases, project_to_psd,
+										  state.bases, state.bases, state.ass_vals_cache, 0, disp, Eigen::MatrixXd(), mat_cache, hessian);
+
+		Eigen::MatrixXd v(disp.size(), 1);
+		v.setRandom();
+
+		Eigen::MatrixXd hv, diag;
+		state.assembler->assemble_hessian_vector_product(false, state.n_bases, project_to_psd,
+														 state.bases, state.bases, state.ass_vals_cache, 0, disp, Eigen::MatrixXd(), v, hv);
+		state.assembler->assemble_hessian_diagonal(false, state.n_bases, project_to_psd,
+												   state.bases, state.bases, state.ass_vals_cache, 0, disp, Eigen::MatrixXd(), diag);
+
+		const Eigen::MatrixXd expected_hv = hessian * v;
+		const Eigen::MatrixXd expected_diag = hessian.diagonal();
+
+		const double scale = std::max(1.0, expected_hv.norm());
+		REQUIRE((hv - expected_hv).norm() / scale == Approx(0).margin(1e-10));
+		REQUIRE((diag - expected_diag).norm() / std::max(1.0, expected_diag.norm()) == Approx(0).margin(1e-10));
+
+		disp.setRandom();
+		disp *= 1e-2;
+	}
+}
+
+TEST_CASE("fused_energy_gradient_hessian", "[assembler]")
+{
+	const std::string path = POLYFEM_DATA_DIR;
+	json in_args = json({});
+	in_args["geometry"] = {};
+	in_args["geometry"]["mesh"] = path + "/plane_hole.obj";
+	in_args["geometry"]["surface_selection"] = 7;
+
+	in_args["preset_problem"] = {};
+	in_args["preset_problem"]["type"] = "ElasticExact";
+
+	in_args["materials"] = {};
+	in_args["materials"]["type"] = "LinearElasticity";
+	in_args["materials"]["E"] = 1e5;
+	in_args["materials"]["nu"] = 0.3;
+
+	State state;
+	state.init_logger("", spdlog::level::err, false);
+	state.init(in_args, true);
+	state.load_mesh();
+
+	state.build_basis();
+
+	LinearElasticity linear;
+	SaintVenantElasticity saint_venant;
+	NeoHookeanElasticity neo_hookean;
+	NeoHookeanAutodiff generic;
+	const std::vector<Assembler *> assemblers = {&linear, &saint_venant, &neo_hookean, &generic};
+	Assembler &assembler = *assemblers[GENERATE(0, 1, 2, 3)];
+	assembler.set_size(2);
+	assembler.add_multimaterial(0, in_args["materials"]);
+
+	const bool project_to_psd = GENERATE(false, true);
+
+	Eigen::MatrixXd disp(state.n_bases * 2, 1);
+	disp.setRandom();
+	disp *= 1e-2;
+
+	SparseMatrixCache mat_cache, fused_mat_cache;
+	const double expected_energy = assembler.assemble_energy(false, state.bases, state.bases, state.ass_vals_cache, 0, disp, Eigen::MatrixXd());
+	Eigen::MatrixXd expected_grad;
+	assembler.assemble_gradient(false, state.n_bases, state.bases, state.bases, state.ass_vals_cache, 0, disp, Eigen::MatrixXd(), expected_grad);
+	StiffnessMatrix expected_hessian;
+	assembler.assemble_hessian(false, state.n_bases, project_to_psd, state.bases, state.bases, state.ass_vals_cache, 0, disp, Eigen::MatrixXd(), mat_cache, expected_hessian);
+
+	// the second assembly uses the mapping and the element colors of the cache
+	for (int k = 0; k < 2; ++k)
+	{
+		double energy;
+		Eigen::MatrixXd grad;
+		StiffnessMatrix hessian;
+		assembler.assemble_energy_gradient_hessian(false, state.n_bases, project_to_psd, state.bases, state.bases, state.ass_vals_cache, 0, disp, Eigen::MatrixXd(), fused_mat_cache, &energy, &grad, &hessian);
+
+		REQUIRE(energy == Approx(expected_energy).epsilon(1e-12));
+		REQUIRE((grad - expected_grad).norm() / std::max(1.0, expected_grad.norm()) == Approx(0).margin(1e-12));
+		REQUIRE((hessian - expected_hessian).norm() / std::max(1.0, expected_hessian.norm()) == Approx(0).margin(1e-12));
+	}
+
+	// any subset of the outputs
+	Eigen::MatrixXd grad;
+	StiffnessMatrix hessian;
+	assembler.assemble_energy_gradient_hessian(false, state.n_bases, project_to_psd, state.bases, state.bases, state.ass_vals_cache, 0, disp, Eigen::MatrixXd(), fused_mat_cache, nullptr, &grad, &hessian);
+	REQUIRE((grad - expected_grad).norm() / std::max(1.0, expected_grad.norm()) == Approx(0).margin(1e-12));
+	REQUIRE((hessian - expected_hessian).norm() / std::max(1.0, expected_hessian.norm()) == Approx(0).margin(1e-12));
+}
+
+TEST_CASE("incremental_hessian_assembly", "[assembler]")
+{
+	const std::string path = POLYFEM_DATA_DIR;
+	json in_args = json({});
+	in_args["geometry"] = {};
+	in_args["geometry"]["mesh"] = path + "/plane_hole.obj";
+	in_args["geometry"]["surface_selection"] = 7;
+
+	in_args["preset_problem"] = {};
+	in_args["preset_problem"]["type"] = "ElasticExact";
+
+	in_args["materials"] = {};
+	in_args["materials"]["type"] = "NeoHookean";
+	in_args["materials"]["E"] = 1e5;
+	in_args["materials"]["nu"] = 0.3;
+
+	State state;
+	state.init_logger("", spdlog::level::err, false);
+	state.init(in_args, true);
+	state.load_mesh();
+
+	state.build_basis();
+
+	SaintVenantElasticity saint_venant;
+	NeoHookeanElasticity neo_hookean;
+	const std::vector<Assembler *> assemblers = {&saint_venant, &neo_hookean};
+	Assembler &assembler = *assemblers[GENERATE(0, 1)];
+	assembler.set_size(2);
+	assembler.add_multimaterial(0, in_args["materials"]);
+
+	const bool project_to_psd = GENERATE(false, true);
+
+	Eigen::MatrixXd disp(state.n_bases * 2, 1);
+	disp.setRandom();
+	disp *= 1e-2;
+
+	const int n_elements = int(state.bases.size());
+	SparseMatrixCache mat_cache, incremental_mat_cache;
+	LocalHessianCache local_cache;
+
+	const auto check = [&](const Eigen::MatrixXd &u) {
+		StiffnessMatrix expected_hessian, hessian;
+		assembler.assemble_hessian(false, state.n_bases, project_to_psd, state.bases, state.bases, state.ass_vals_cache, 0, u, Eigen::MatrixXd(), mat_cache, expected_hessian);
+		assembler.assemble_hessian_incremental(false, state.n_bases, project_to_psd, state.bases, state.bases, state.ass_vals_cache, 0, u, Eigen::MatrixXd(), incremental_mat_cache, local_cache, hessian);
+
+		REQUIRE(hessian.nonZeros() == expected_hessian.nonZeros());
+		REQUIRE((hessian - expected_hessian).norm() / std::max(1.0, expected_hessian.norm()) == Approx(0).margin(1e-12));
+		REQUIRE(local_cache.n_evaluated() + local_cache.n_reused() == n_elements);
+	};
+
+	// the first assembly evaluates every element, the second one at the same displacement none
+	check(disp);
+	REQUIRE(local_cache.n_evaluated() == n_elements);
+	check(disp);
+	REQUIRE(local_cache.n_reused() == n_elements);
+
+	// moving the nodes of the first element only evaluates the elements around them
+	for (const auto &b : state.bases[0].bases)
+	{
+		for (const auto &g : b.global())
+			disp.middleRows(g.index * 2, 2).array() += 1e-3;
+	}
+	check(disp);
+	REQUIRE(local_cache.n_evaluated() > 0);
+	REQUIRE(local_cache.n_reused() > 0);
+
+	// the psd projection changes the stored hessians
+	StiffnessMatrix hessian;
+	assembler.assemble_hessian_incremental(false, state.n_bases, !project_to_psd, state.bases, state.bases, state.ass_vals_cache, 0, disp, Eigen::MatrixXd(), incremental_mat_cache, local_cache, hessian);
+	REQUIRE(local_cache.n_evaluated() == n_elements);
+
+	// within the tolerance the stored hessians are kept
+	local_cache.set_tolerance(1);
+	disp.array() += 1e-4;
+	assembler.assemble_hessian_incremental(false, state.n_bases, !project_to_psd, state.bases, state.bases, state.ass_vals_cache, 0, disp, Eigen::MatrixXd(), incremental_mat_cache, local_cache, hessian);
+	REQUIRE(local_cache.n_reused() == n_elements);
+}
+
+TEST_CASE("time_dependent_parameters", "[assembler]")
+{
+	// the stored local hessians of the incremental assembly are dropped at every step for these materials
+	json params = R"({"E": 1e5, "nu": 0.3})"_json;
+
+	NeoHookeanElasticity neo_hookean;
+	neo_hookean.set_size(2);
+	neo_hookean.add_multimaterial(0, params);
+	CHECK(!neo_hookean.has_time_dependent_parameters());
+
+	params["E"] = "1e5 * (1 + t)";
+	neo_hookean.add_multimaterial(0, params);
+	CHECK(neo_hookean.has_time_dependent_parameters());
+
+	// spatially varying parameters do not change with the time
+	params["E"] = "1e5 * (1 + x)";
+	neo_hookean.add_multimaterial(0, params);
+	CHECK(!neo_hookean.has_time_dependent_parameters());
+
+	SaintVenantElasticity saint_venant;
+	CHECK(!saint_venant.has_time_dependent_parameters());
+}
+
+TEST_CASE("deterministic_assembly", "[assembler]")
+{
+	const std::string path = POLYFEM_DATA_DIR;
+	json in_args = json({});
+	in_args["geometry"] = {};
+	in_args["geometry"]["mesh"] = path + "/plane_hole.obj";
+	in_args["geometry"]["surface_selection"] = 7;
+
+	in_args["preset_problem"] = {};
+	in_args["preset_problem"]["type"] = "ElasticExact";
+
+	in_args["materials"] = {};
+	in_args["materials"]["type"] = "NeoHookean";
+	in_args["materials"]["E"] = 1e5;
+	in_args["materials"]["nu"] = 0.3;
+
+	State state;
+	state.init_logger("", spdlog::level::err, false);
+	state.init(in_args, true);
+	state.load_mesh();
+
+	state.build_basis();
+
+	Eigen::MatrixXd disp(state.n_bases * 2, 1);
+	disp.setRandom();
+	disp *= 1e-2;
+
+	const auto assemble = [&](const unsigned int n_threads, double &energy, Eigen::MatrixXd &grad) {
+		state.set_max_threads(n_threads);
+		utils::TaskArenaScope arena_scope(state.task_arena.get());
+
+		energy = state.assembler->assemble_energy(false, state.bases, state.bases, state.ass_vals_cache, 0, disp, Eigen::MatrixXd());
+		state.assembler->assemble_gradient(false, state.n_bases, state.bases, state.bases, state.ass_vals_cache, 0, disp, Eigen::MatrixXd(), grad);
+	};
+
+	double expected_energy;
+	Eigen::MatrixXd expected_grad;
+	assemble(4, expected_energy, expected_grad);
+
+	// the gradient is scattered color by color, every entry is summed in the same order whatever the number of threads
+	double colored_energy;
+	Eigen::MatrixXd colored_grad;
+	assemble(1, colored_energy, colored_grad);
+	REQUIRE(colored_grad == expected_grad);
+
+	state.assembler->set_deterministic(true);
+
+	double energy1, energy4;
+	Eigen::MatrixXd grad1, grad4;
+	assemble(1, energy1, grad1);
+	assemble(4, energy4, grad4);
+
+	// bitwise identical whatever the number of threads
+	REQUIRE(energy1 == energy4);
+	REQUIRE(grad1 == grad4);
+
+	REQUIRE(energy1 == Approx(expected_energy).epsilon(1e-12));
+	REQUIRE((grad1 - expected_grad).norm() / std::max(1.0, expected_grad.norm()) == Approx(0).margin(1e-12));
+}
+
+TEST_CASE("quadrature_psd_projection", "[assembler]")
+{
+	const std::string path = POLYFEM_DATA_DIR;
+	json in_args = json({});
+	in_args["geometry"] = {};
+	in_args["geometry"]["mesh"] = path + "/plane_hole.obj";
+	in_args["geometry"]["surface_selection"] = 7;
+
+	in_args["preset_problem"] = {};
+	in_args["preset_problem"]["type"] = "ElasticExact";
+
+	in_args["materials"] = {};
+	in_args["materials"]["type"] = "NeoHookean";
+	in_args["materials"]["E"] = 1e5;
+	in_args["materials"]["nu"] = 0.3;
+
+	State state;
+	state.init_logger("", spdlog::level::err, false);
+	state.init(in_args, true);
+	state.load_mesh();
+
+	state.build_basis();
+
+	const auto assemble = [&](const Eigen::MatrixXd &disp, const bool project_to_psd) {
+		SparseMatrixCache mat_cache;
+		StiffnessMatrix hessian;
+		state.assembler->assemble_hessian(false, state.n_bases, project_to_psd,
+										  state.bases, state.bases, state.ass_vals_cache, 0, disp, Eigen::MatrixXd(), mat_cache, hessian);
+		return Eigen::MatrixXd(hessian);
+	};
+
+	state.assembler->set_quadrature_psd_projection(true);
+
+	// near the rest shape d2Psi/dF2 is positive definite and the projection does nothing
+	Eigen::MatrixXd disp(state.n_bases * 2, 1);
+	disp.setRandom();
+	disp *= 1e-4;
+	{
+		const Eigen::MatrixXd expected = assemble(disp, false);
+		const Eigen::MatrixXd projected = assemble(disp, true);
+		REQUIRE((projected - expected).norm() / expected.norm() == Approx(0).margin(1e-10));
+	}
+
+	// a uniform compression by half makes d2Psi/dF2 indefinite, the projected hessian is PSD
+	for (const ElementBases &element : state.bases)
+	{
+		for (const Basis &basis : element.bases)
+		{
+			const auto &global = basis.global()[0];
+			disp.block<2, 1>(global.index * 2, 0) = -0.5 * global.node.transpose();
+		}
+	}
+	{
+		const Eigen::MatrixXd projected = assemble(disp, true);
+		const Eigen::VectorXd eigenvalues = Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd>(projected).eigenvalues();
+		REQUIRE(eigenvalues.minCoeff() >= -1e-8 * eigenvalues.cwiseAbs().maxCoeff());
+	}
+}
+
+TEST_CASE("compact_assembly_cache", "[assembler]")
+{
+	const std::string path = POLYFEM_DATA_DIR;
+	json in_args = json({});
+	in_args["geometry"] = {};
+	in_args["geometry"]["mesh"] = path + "/plane_hole.obj";
+	in_args["geometry"]["surface_selection"] = 7;
+
+	in_args["preset_problem"] = {};
+	in_args["preset_problem"]["type"] = "ElasticExact";
+
+	in_args["materials"] = {};
+	in_args["materials"]["type"] = "NeoHookean";
+	in_args["materials"]["E"] = 1e5;
+	in_args["materials"]["nu"] = 0.3;
+
+	in_args["space"] = {};
+	in_args["space"]["discr_order"] = 2;
+
+	State state;
+	state.init_logger("", spdlog::level::err, false);
+	state.init(in_args, true);
+	state.load_mesh();
+
+	state.build_basis();
+
+	const auto &gbases = state.geom_bases();
+
+	AssemblyValsCache compact_cache;
+	compact_cache.set_compact(true);
+	compact_cache.init(false, state.bases, gbases);
+
+	ElementAssemblyValues expected, vals;
+	for (int e = 0; e < state.bases.size(); ++e)
+	{
+		state.ass_vals_cache.compute(e, false, state.bases[e], gbases[e], expected);
+		compact_cache.compute(e, false, state.bases[e], gbases[e], vals);
+
+		REQUIRE(vals.basis_values.size() == expected.basis_values.size());
+		REQUIRE((vals.det - expected.det).norm() == Approx(0).margin(1e-12));
+		REQUIRE((vals.val - expected.val).norm() == Approx(0).margin(1e-12));
+		REQUIRE((vals.quadrature.weights - expected.quadrature.weights).norm() == Approx(0).margin(1e-12));
+
+		for (int j = 0; j < vals.basis_values.size(); ++j)
+		{
+			REQUIRE(vals.basis_values[j].global.size() == expected.basis_values[j].global.size());
+			REQUIRE((vals.basis_values[j].val - expected.basis_values[j].val).norm() == Approx(0).margin(1e-12));
+			REQUIRE((vals.basis_values[j].grad_t_m - expected.basis_values[j].grad_t_m).norm() == Approx(0).margin(1e-10));
+		}
+	}
+}
+
+TEST_CASE("shared_mass_assembly_cache", "[assembler]")
+{
+	json in_args = json({});
+	in_args["materials"] = {};
+	in_args["materials"]["type"] = "LinearElasticity";
+	in_args["materials"]["E"] = 1e5;
+	in_args["materials"]["nu"] = 0.3;
+
+	in_args["space"] = {};
+	in_args["space"]["discr_order"] = 2;
+
+	// 2 x 2 x 2 hexes, their mass and stiffness quadratures are the same
+	Eigen::MatrixXd V(27, 3);
+	for (int k = 0; k < 3; ++k)
+		for (int j = 0; j < 3; ++j)
+			for (int i = 0; i < 3; ++i)
+				V.row(i + 3 * (j + 3 * k)) << i / 2., j / 2., k / 2.;
+	V.row(13) += Eigen::RowVector3d(0.05, -0.03, 0.02);
+
+	Eigen::MatrixXi F(8, 8);
+	for (int k = 0; k < 2; ++k)
+		for (int j = 0; j < 2; ++j)
+			for (int i = 0; i < 2; ++i)
+			{
+				const int v = i + 3 * (j + 3 * k);
+				F.row(i + 2 * (j + 2 * k)) << v, v + 1, v + 4, v + 3, v + 9, v + 10, v + 13, v + 12;
+			}
+
+	State state;
+	state.init_logger("", spdlog::level::err, false);
+	state.init(in_args, true);
+	state.load_mesh(V, F);
+	state.build_basis();
+
+	const auto &gbases = state.geom_bases();
+	REQUIRE(state.mass_ass_vals_cache.n_shared() == state.bases.size());
+
+	AssemblyValsCache mass_cache;
+	mass_cache.init(true, state.bases, gbases, true);
+	REQUIRE(mass_cache.n_shared() == 0);
+	REQUIRE(state.mass_ass_vals_cache.memory_usage() < mass_cache.memory_usage());
+
+	ElementAssemblyValues expected, vals;
+	for (int e = 0; e < state.bases.size(); ++e)
+	{
+		mass_cache.compute(e, true, state.bases[e], gbases[e], expected);
+		state.mass_ass_vals_cache.compute(e, true, state.bases[e], gbases[e], vals);
+
+		REQUIRE(vals.basis_values.size() == expected.basis_values.size());
+		REQUIRE((vals.quadrature.points - expected.quadrature.points).norm() == Approx(0).margin(1e-14));
+		REQUIRE((vals.quadrature.weights - expected.quadrature.weights).norm() == Approx(0).margin(1e-14));
+		REQUIRE((vals.det - expected.det).norm() == Approx(0).margin(1e-12));
+		for (int j = 0; j < vals.basis_values.size(); ++j)
+			REQUIRE((vals.basis_values[j].val - expected.basis_values[j].val).norm() == Approx(0).margin(1e-12));
+	}
+}
+
+TEST_CASE("single_precision_assembly_cache", "[assembler]")
+{
+	const std::string path = POLYFEM_DATA_DIR;
+	json in_args = json({});
+	in_args["geometry"] = {};
+	in_args["geometry"]["mesh"] = path + "/plane_hole.obj";
+	in_args["geometry"]["surface_selection"] = 7;
+
+	in_args["preset_problem"] = {};
+	in_args["preset_problem"]["type"] = "ElasticExact";
+
+	in_args["materials"] = {};
+	in_args["materials"]["type"] = "LinearElasticity";
+	in_args["materials"]["E"] = 1e5;
+	in_args["materials"]["nu"] = 0.3;
+
+	in_args["space"] = {};
+	in_args["space"]["discr_order"] = 2;
+
+	State state;
+	state.init_logger("", spdlog::level::err, false);
+	state.init(in_args, true);
+	state.load_mesh();
+
+	state.build_basis();
+
+	const auto &gbases = state.geom_bases();
+
+	AssemblyValsCache float_cache;
+	float_cache.set_single_precision(true);
+	float_cache.init(false, state.bases, gbases);
+
+	ElementAssemblyValues expected, vals;
+	for (int e = 0; e < state.bases.size(); ++e)
+	{
+		expected.compute(e, false, state.bases[e], gbases[e]);
+		float_cache.compute(e, false, state.bases[e], gbases[e], vals);
+
+		REQUIRE(vals.element_id == e);
+		REQUIRE(vals.basis_values.size() == expected.basis_values.size());
+		REQUIRE((vals.det - expected.det).norm() == Approx(0).margin(1e-6 * expected.det.norm()));
+		REQUIRE((vals.val - expected.val).norm() == Approx(0).margin(1e-6 * expected.val.norm()));
+
+		for (int j = 0; j < vals.basis_values.size(); ++j)
+		{
+			const auto &global = vals.basis_values[j].global;
+			REQUIRE(global.size() == expected.basis_values[j].global.size());
+			for (int k = 0; k < global.size(); ++k)
+			{
+				REQUIRE(global[k].index == expected.basis_values[j].global[k].index);
+				REQUIRE(global[k].val == expected.basis_values[j].global[k].val);
+			}
+			const Eigen::MatrixXd &grad = expected.basis_values[j].grad_t_m;
+			REQUIRE((vals.basis_values[j].grad_t_m - grad).norm() == Approx(0).margin(1e-6 * grad.norm()));
+		}
+
+		// the double precision cache restores the global mappings from the bases
+		state.ass_vals_cache.compute(e, false, state.bases[e], gbases[e], vals);
+		for (int j = 0; j < vals.basis_values.size(); ++j)
+		{
+			REQUIRE(vals.basis_values[j].global.size() == state.bases[e].bases[j].global().size());
+			for (int k = 0; k < vals.basis_values[j].global.size(); ++k)
+				REQUIRE(vals.basis_values[j].global[k].index == state.bases[e].bases[j].global()[k].index);
+		}
+	}
+
+	StiffnessMatrix stiffness, float_stiffness;
+	state.assembler->assemble(false, state.n_bases, state.bases, gbases, state.ass_vals_cache, stiffness);
+	state.assembler->assemble(false, state.n_bases, state.bases, gbases, float_cache, float_stiffness);
+	REQUIRE((stiffness - float_stiffness).norm() == Approx(0).margin(1e-5 * stiffness.norm()));
+}
+
+TEST_CASE("budgeted_assembly_cache", "[assembler]")
+{
+	const std::string path = POLYFEM_DATA_DIR;
+	json in_args = json({});
+	in_args["geometry"] = {};
+	in_args["geometry"]["mesh"] = path + "/plane_hole.obj";
+	in_args["geometry"]["surface_selection"] = 7;
+
+	in_args["preset_problem"] = {};
+	in_args["preset_problem"]["type"] = "ElasticExact";
+
+	in_args["materials"] = {};
+	in_args["materials"]["type"] = "LinearElasticity";
+	in_args["materials"]["E"] = 1e5;
+	in_args["materials"]["nu"] = 0.3;
+
+	in_args["space"] = {};
+	in_args["space"]["discr_order"] = 2;
+
+	State state;
+	state.init_logger("", spdlog::level::err, false);
+	state.init(in_args, true);
+	state.load_mesh();
+
+	state.build_basis();
+
+	const auto &gbases = state.geom_bases();
+	const int n_elements = state.bases.size();
+
+	const size_t budget = state.ass_vals_cache.memory_usage() / 2;
+	AssemblyValsCache budget_cache;
+	budget_cache.set_memory_budget(budget);
+	budget_cache.init(false, state.bases, gbases);
+
+	AssemblyValsCache::Stats stats = budget_cache.stats();
+	REQUIRE(stats.cached_elements > 0);
+	REQUIRE(stats.cached_elements < n_elements);
+	REQUIRE(stats.estimated_memory <= budget);
+	// nothing is computed before the first use
+	REQUIRE(stats.hits + stats.misses == 0);
+
+	ElementAssemblyValues expected, vals;
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		for (int e = 0; e < n_elements; ++e)
+		{
+			state.ass_vals_cache.compute(e, false, state.bases[e], gbases[e], expected);
+			budget_cache.compute(e, false, state.bases[e], gbases[e], vals);
+
+			REQUIRE(vals.basis_values.size() == expected.basis_values.size());
+			REQUIRE((vals.det - expected.det).norm() == Approx(0).margin(1e-12));
+			for (int j = 0; j < vals.basis_values.size(); ++j)
+			{
+				REQUIRE(vals.basis_values[j].global.size() == expected.basis_values[j].global.size());
+				REQUIRE((vals.basis_values[j].grad_t_m - expected.basis_values[j].grad_t_m).norm() == Approx(0).margin(1e-12));
+			}
+		}
+	}
+
+	stats = budget_cache.stats();
+	REQUIRE(stats.misses == 2 * n_elements - stats.cached_elements);
+	REQUIRE(stats.hits == stats.cached_elements);
+	REQUIRE(stats.hit_rate() == Approx(double(stats.cached_elements) / (2 * n_elements)));
+	REQUIRE(budget_cache.memory_usage() < state.ass_vals_cache.memory_usage());
+
+	StiffnessMatrix stiffness, budget_stiffness;
+	state.assembler->assemble(false, state.n_bases, state.bases, gbases, state.ass_vals_cache, stiffness);
+	state.assembler->assemble(false, state.n_bases, state.bases, gbases, budget_cache, budget_stiffness);
+	REQUIRE((stiffness - budget_stiffness).norm() == Approx(0).margin(1e-12 * stiffness.norm()));
+}
+
 TEST_CASE("generic_elastic_assembler", "[assembler]")
 {
 
@@ -130,8 +732,319 @@ TEST_CASE("generic_elastic_assembler", "[assembler]")
 	in_args["geometry"] = {};
 	in_args["geometry"]["mesh"] = path + "/plane_hole.obj";
 	in_args["geometry"]["surface_selection"] = 7;
-	// in_args["geometry"]["mesh"] = path + "/circle2.msh";
-	// in_args["force_linear_geometry"] = true;
+	// in_args["geometry"]["mesh"] = path + "/circle2.msh";
+	// in_args["force_linear_geometry"] = true;
+
+	in_args["preset_problem"] = {};
+	in_args["preset_problem"]["type"] = "ElasticExact";
+
+	in_args["materials"] = {};
+	in_args["materials"]["type"] = "LinearElasticity";
+	in_args["materials"]["E"] = 1e5;
+	in_args["materials"]["nu"] = 0.3;
+
+	State state;
+	state.init_logger("", spdlog::level::err, false);
+	state.init(in_args, true);
+	state.load_mesh();
+
+	// state.compute_mesh_stats();
+	state.build_basis();
+
+	NeoHookeanAutodiff autodiff;
+	NeoHookeanElasticity real;
+
+	autodiff.set_size(2);
+	real.set_size(2);
+
+	autodiff.add_multimaterial(0, in_args["materials"]);
+	real.add_multimaterial(0, in_args["materials"]);
+
+	const int el_id = 0;
+	const auto &bs = state.bases[el_id];
+	Eigen::MatrixXd local_pts;
+	Eigen::MatrixXi f;
+	regular_2d_grid(10, true, local_pts, f);
+
+	Eigen::MatrixXd displacement(state.n_bases, 1);
+
+	ElementAssemblyValues vals;
+	vals.compute(el_id, false, bs, bs);
+
+	const auto &quadrature = vals.quadrature;
+	const Eigen::MatrixXd da = vals.det.array() * quadrature.weights.array();
+
+	for (int rand = 0; rand < 10; ++rand)
+	{
+		displacement.setRandom();
+
+		// value
+		{
+			const NonLinearAssemblerData data(vals, 0, displacement, displacement, da);
+
+			const double ea = autodiff.compute_energy(data);
+			const double e = real.compute_energy(data);
+
+			if (std::isnan(e))
+				REQUIRE(std::isnan(ea));
+			else
+				REQUIRE(ea == Approx(e).margin(1e-12));
+		}
+
+		// grad
+		{
+			const NonLinearAssemblerData data(vals, 0, displacement, displacement, da);
+
+			const Eigen::VectorXd grada = autodiff.assemble_gradient(data);
+			const Eigen::VectorXd grad = real.assemble_gradient(data);
+
+			for (int i = 0; i < grada.size(); ++i)
+			{
+				if (std::isnan(grad(i)))
+					REQUIRE(std::isnan(grada(i)));
+				else
+					REQUIRE(grada(i) == Approx(grad(i)).margin(1e-12));
+			}
+		}
+
+		// hessian
+		{
+			const NonLinearAssemblerData data(vals, 0, displacement, displacement, da);
+
+			const Eigen::MatrixXd hessiana = autodiff.assemble_hessian(data);
+			const Eigen::MatrixXd hessian = real.assemble_hessian(data);
+
+			for (int i = 0; i < hessiana.size(); ++i)
+			{
+				if (std::isnan(hessian(i)))
+					REQUIRE(std::isnan(hessiana(i)));
+				else
+					REQUIRE(hessiana(i) == Approx(hessian(i)).margin(1e-12));
+			}
+		}
+
+		// F stress
+		{
+			Eigen::MatrixXd stressa, stress;
+			autodiff.compute_stress_tensor(el_id, bs, bs, local_pts, displacement, ElasticityTensorType::F, stressa);
+			real.compute_stress_tensor(el_id, bs, bs, local_pts, displacement, ElasticityTensorType::F, stress);
+
+			for (int i = 0; i < stressa.size(); ++i)
+			{
+				if (std::isnan(stress(i)))
+					REQUIRE(std::isnan(stressa(i)));
+				else
+					REQUIRE(stressa(i) == Approx(stress(i)).margin(1e-12));
+			}
+		}
+
+		// cauchy stress
+		{
+			Eigen::MatrixXd stressa, stress;
+			autodiff.compute_stress_tensor(el_id, bs, bs, local_pts, displacement, ElasticityTensorType::CAUCHY, stressa);
+			real.compute_stress_tensor(el_id, bs, bs, local_pts, displacement, ElasticityTensorType::CAUCHY, stress);
+
+			for (int i = 0; i < stressa.size(); ++i)
+			{
+				if (std::isnan(stress(i)))
+					REQUIRE(std::isnan(stressa(i)));
+				else
+					REQUIRE(stressa(i) == Approx(stress(i)).margin(1e-12));
+			}
+		}
+
+		// pk1 stress
+		{
+			Eigen::MatrixXd stressa, stress;
+			autodiff.compute_stress_tensor(el_id, bs, bs, local_pts, displacement, ElasticityTensorType::PK1, stressa);
+			real.compute_stress_tensor(el_id, bs, bs, local_pts, displacement, ElasticityTensorType::PK1, stress);
+
+			for (int i = 0; i < stressa.size(); ++i)
+			{
+				if (std::isnan(stress(i)))
+					REQUIRE(std::isnan(stressa(i)));
+				else
+					REQUIRE(stressa(i) == Approx(stress(i)).margin(1e-12));
+			}
+		}
+
+		// pk2 stress
+		{
+			Eigen::MatrixXd stressa, stress;
+			autodiff.compute_stress_tensor(el_id, bs, bs, local_pts, displacement, ElasticityTensorType::PK2, stressa);
+			real.compute_stress_tensor(el_id, bs, bs, local_pts, displacement, ElasticityTensorType::PK2, stress);
+
+			for (int i = 0; i < stressa.size(); ++i)
+			{
+				if (std::isnan(stress(i)))
+					REQUIRE(std::isnan(stressa(i)));
+				else
+					REQUIRE(stressa(i) == Approx(stress(i)).margin(1e-12));
+			}
+		}
+	}
+}
+
+TEST_CASE("elastic_kernels", "[assembler]")
+{
+	const std::string path = POLYFEM_DATA_DIR;
+	json in_args = json({});
+	in_args["geometry"] = {};
+	in_args["geometry"]["mesh"] = path + "/plane_hole.obj";
+	in_args["materials"] = {};
+	in_args["materials"]["type"] = "NeoHookean";
+	in_args["materials"]["E"] = 1e5;
+	in_args["materials"]["nu"] = 0.3;
+	in_args["space"] = {};
+	in_args["space"]["discr_order"] = 2;
+
+	State state;
+	state.init_logger("", spdlog::level::err, false);
+	state.init(in_args, true);
+	state.load_mesh();
+	state.build_basis();
+
+	LinearElasticity linear;
+	SaintVenantElasticity saint_venant;
+	NeoHookeanElasticity neo_hookean;
+	linear.set_size(2);
+	saint_venant.set_size(2);
+	neo_hookean.set_size(2);
+	linear.add_multimaterial(0, in_args["materials"]);
+	saint_venant.add_multimaterial(0, in_args["materials"]);
+	neo_hookean.add_multimaterial(0, in_args["materials"]);
+
+	LameParameters lame;
+	lame.add_multimaterial(0, in_args["materials"], false);
+
+	const int el_id = 0;
+	const auto &bs = state.bases[el_id];
+	ElementAssemblyValues vals;
+	vals.compute(el_id, false, bs, bs);
+	const Eigen::MatrixXd da = vals.det.array() * vals.quadrature.weights.array();
+	const int n_local = vals.basis_values.size() * 2;
+
+	Eigen::MatrixXd displacement(state.n_bases * 2, 1);
+	const double h = 1e-7;
+
+	for (int rand = 0; rand < 5; ++rand)
+	{
+		// small enough to keep the element positive
+		displacement.setRandom();
+		displacement *= 1e-2;
+		const NonLinearAssemblerData data(vals, 0, displacement, displacement, da);
+
+		// the closed form gradient and hessian are the derivatives of the energy
+		const auto check_derivatives = [&](const auto &assembler) {
+			const Eigen::VectorXd grad = assembler.assemble_gradient(data);
+			const Eigen::MatrixXd hessian = assembler.assemble_hessian(data);
+			REQUIRE(grad.size() == n_local);
+			REQUIRE((hessian - hessian.transpose()).norm() == Approx(0).margin(1e-10 * hessian.norm()));
+
+			Eigen::VectorXd fd_grad(n_local);
+			Eigen::MatrixXd fd_hessian(n_local, n_local);
+			for (int k = 0; k < n_local; ++k)
+			{
+				const int i = k / 2, d = k % 2;
+				REQUIRE(vals.basis_values[i].global.size() == 1);
+				const int dof = vals.basis_values[i].global[0].index * 2 + d;
+
+				Eigen::MatrixXd x_plus = displacement, x_minus = displacement;
+				x_plus(dof) += h;
+				x_minus(dof) -= h;
+				const NonLinearAssemblerData data_plus(vals, 0, x_plus, x_plus, da);
+				const NonLinearAssemblerData data_minus(vals, 0, x_minus, x_minus, da);
+
+				fd_grad(k) = (assembler.compute_energy(data_plus) - assembler.compute_energy(data_minus)) / (2 * h);
+				fd_hessian.col(k) = (assembler.assemble_gradient(data_plus) - assembler.assemble_gradient(data_minus)) / (2 * h);
+			}
+			REQUIRE((grad - fd_grad).norm() == Approx(0).margin(1e-5 * grad.norm()));
+			REQUIRE((hessian - fd_hessian).norm() == Approx(0).margin(1e-5 * hessian.norm()));
+		};
+		check_derivatives(linear);
+		check_derivatives(saint_venant);
+
+		// the NeoHookean kernel matches the batched assembler
+		Eigen::VectorXd grads, local_disp;
+		flatten_element_data(data, 2, grads, local_disp);
+		const auto material = [&](const int p, const double *grad_u, double *P, double *C) {
+			double lambda, mu;
+			lame.lambda_mu(vals.quadrature.points.row(p), vals.val.row(p), vals.element_id, lambda, mu);
+			return kernels::neo_hookean<2>(lambda, mu, grad_u, P, C);
+		};
+		const int n_bases = vals.basis_values.size();
+
+		const double energy = kernels::element_energy<2>(n_bases, da.size(), grads.data(), da.data(), local_disp.data(), material);
+		REQUIRE(energy == Approx(neo_hookean.compute_energy(data)).epsilon(1e-10));
+
+		Eigen::VectorXd grad(n_local);
+		kernels::element_gradient<2>(n_bases, da.size(), grads.data(), da.data(), local_disp.data(), material, grad.data());
+		const Eigen::VectorXd expected_grad = neo_hookean.assemble_gradient(data);
+		REQUIRE((grad - expected_grad).norm() == Approx(0).margin(1e-10 * expected_grad.norm()));
+
+		Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> hessian(n_local, n_local);
+		kernels::element_hessian<2>(n_bases, da.size(), grads.data(), da.data(), local_disp.data(), material, hessian.data());
+		const Eigen::MatrixXd expected_hessian = neo_hookean.assemble_hessian(data);
+		REQUIRE((Eigen::MatrixXd(hessian) - expected_hessian).norm() == Approx(0).margin(1e-10 * expected_hessian.norm()));
+	}
+}
+
+TEST_CASE("block_assembly", "[assembler]")
+{
+	const std::string path = POLYFEM_DATA_DIR;
+	json in_args = json({});
+	in_args["geometry"] = {};
+	in_args["geometry"]["mesh"] = path + "/plane_hole.obj";
+	in_args["geometry"]["surface_selection"] = 7;
+
+	in_args["preset_problem"] = {};
+	in_args["preset_problem"]["type"] = "ElasticExact";
+
+	in_args["materials"] = {};
+	in_args["materials"]["type"] = "LinearElasticity";
+	in_args["materials"]["E"] = 1e5;
+	in_args["materials"]["nu"] = 0.3;
+
+	State state;
+	state.init_logger("", spdlog::level::err, false);
+	state.init(in_args, true);
+	state.load_mesh();
+
+	state.build_basis();
+
+	StiffnessMatrix stiffness;
+	state.build_stiffness_mat(stiffness);
+
+	BlockSparseMatrix blocks;
+	state.assembler->assemble(false, state.n_bases, state.bases, state.bases, state.ass_vals_cache, blocks);
+
+	REQUIRE(blocks.block_size() == 2);
+	REQUIRE(blocks.rows() == stiffness.rows());
+
+	const StiffnessMatrix tmp = stiffness - blocks.to_csr();
+	for (int k = 0; k < tmp.outerSize(); ++k)
+	{
+		for (StiffnessMatrix::InnerIterator it(tmp, k); it; ++it)
+		{
+			REQUIRE(it.value() == Approx(0).margin(1e-8));
+		}
+	}
+
+	const Eigen::VectorXd x = Eigen::VectorXd::Random(stiffness.cols());
+	Eigen::VectorXd y;
+	blocks.multiply(x, y);
+	REQUIRE((y - stiffness * x).norm() == Approx(0).margin(1e-8 * std::max(1.0, y.norm())));
+}
+
+TEST_CASE("affine_assembly", "[assembler]")
+{
+	const std::string path = POLYFEM_DATA_DIR;
+	const int discr_order = GENERATE(1, 2);
+
+	json in_args = json({});
+	in_args["geometry"] = {};
+	in_args["geometry"]["mesh"] = path + "/plane_hole.obj";
+	in_args["geometry"]["surface_selection"] = 7;
 
 	in_args["preset_problem"] = {};
 	in_args["preset_problem"]["type"] = "ElasticExact";
@@ -140,145 +1053,372 @@ TEST_CASE("generic_elastic_assembler", "[assembler]")
 	in_args["materials"]["type"] = "LinearElasticity";
 	in_args["materials"]["E"] = 1e5;
 	in_args["materials"]["nu"] = 0.3;
+	in_args["materials"]["rho"] = 10;
+
+	in_args["space"] = {};
+	in_args["space"]["discr_order"] = discr_order;
 
 	State state;
 	state.init_logger("", spdlog::level::err, false);
 	state.init(in_args, true);
 	state.load_mesh();
 
-	// state.compute_mesh_stats();
 	state.build_basis();
 
-	NeoHookeanAutodiff autodiff;
-	NeoHookeanElasticity real;
+	const auto compare = [&](LinearAssembler &assembler, const AssemblyValsCache &cache, const bool is_mass) {
+		StiffnessMatrix affine, quadrature;
+		assembler.assemble(false, state.n_bases, state.bases, state.geom_bases(), cache, affine, is_mass);
+		assembler.set_affine_assembly(false);
+		assembler.assemble(false, state.n_bases, state.bases, state.geom_bases(), cache, quadrature, is_mass);
+		assembler.set_affine_assembly(true);
 
-	autodiff.set_size(2);
-	real.set_size(2);
+		REQUIRE(affine.rows() == quadrature.rows());
+		const double scale = quadrature.norm();
+		REQUIRE((affine - quadrature).norm() == Approx(0).margin(1e-12 * scale));
+	};
 
-	autodiff.add_multimaterial(0, in_args["materials"]);
-	real.add_multimaterial(0, in_args["materials"]);
+	// the bases and mass caches use different quadratures, the reference integrals are computed for both
+	compare(dynamic_cast<LinearAssembler &>(*state.assembler), state.ass_vals_cache, false);
+	compare(*state.mass_matrix_assembler, state.mass_ass_vals_cache, true);
+}
 
-	const int el_id = 0;
-	const auto &bs = state.bases[el_id];
-	Eigen::MatrixXd local_pts;
-	Eigen::MatrixXi f;
-	regular_2d_grid(10, true, local_pts, f);
+TEST_CASE("node_ordering", "[assembler]")
+{
+	const std::string path = POLYFEM_DATA_DIR;
+	const std::string ordering = GENERATE(std::string("rcm"), std::string("morton"));
 
-	Eigen::MatrixXd displacement(state.n_bases, 1);
+	json in_args = json({});
+	in_args["geometry"] = {};
+	in_args["geometry"]["mesh"] = path + "/plane_hole.obj";
+	in_args["geometry"]["surface_selection"] = 7;
 
-	ElementAssemblyValues vals;
-	vals.compute(el_id, false, bs, bs);
+	in_args["preset_problem"] = {};
+	in_args["preset_problem"]["type"] = "ElasticExact";
 
-	const auto &quadrature = vals.quadrature;
-	const Eigen::MatrixXd da = vals.det.array() * quadrature.weights.array();
+	in_args["materials"] = {};
+	in_args["materials"]["type"] = "LinearElasticity";
+	in_args["materials"]["E"] = 1e5;
+	in_args["materials"]["nu"] = 0.3;
 
-	for (int rand = 0; rand < 10; ++rand)
+	in_args["space"] = {};
+	in_args["space"]["discr_order"] = 2;
+
+	State state;
+	state.init_logger("", spdlog::level::err, false);
+	state.init(in_args, true);
+	state.load_mesh();
+	state.build_basis();
+
+	in_args["space"]["advanced"]["node_ordering"] = ordering;
+	State reordered;
+	reordered.init_logger("", spdlog::level::err, false);
+	reordered.init(in_args, true);
+	reordered.load_mesh();
+	reordered.build_basis();
+
+	REQUIRE(state.node_ordering.size() == 0);
+	const Eigen::VectorXi &old_to_new = reordered.node_ordering;
+	REQUIRE(old_to_new.size() == state.n_bases);
+	REQUIRE(reordered.n_bases == state.n_bases);
+
+	std::vector<bool> seen(old_to_new.size(), false);
+	for (int i = 0; i < old_to_new.size(); ++i)
 	{
-		displacement.setRandom();
+		REQUIRE(old_to_new[i] >= 0);
+		REQUIRE(old_to_new[i] < old_to_new.size());
+		REQUIRE(!seen[old_to_new[i]]);
+		seen[old_to_new[i]] = true;
+	}
 
-		// value
+	for (int e = 0; e < state.bases.size(); ++e)
+	{
+		for (int j = 0; j < state.bases[e].bases.size(); ++j)
 		{
-			const NonLinearAssemblerData data(vals, 0, displacement, displacement, da);
+			const auto &expected = state.bases[e].bases[j].global();
+			const auto &global = reordered.bases[e].bases[j].global();
+			REQUIRE(global.size() == expected.size());
+			for (int k = 0; k < global.size(); ++k)
+				REQUIRE(global[k].index == old_to_new[expected[k].index]);
+		}
+	}
 
-			const double ea = autodiff.compute_energy(data);
-			const double e = real.compute_energy(data);
+	// input nodes map to the same node positions, the exported solution is in the same order
+	REQUIRE(reordered.in_node_to_node.size() == state.in_node_to_node.size());
+	for (int i = 0; i < state.in_node_to_node.size(); ++i)
+		REQUIRE(reordered.in_node_to_node[i] == old_to_new[state.in_node_to_node[i]]);
 
-			if (std::isnan(e))
-				REQUIRE(std::isnan(ea));
-			else
-				REQUIRE(ea == Approx(e).margin(1e-12));
-		}
+	// the stiffness is the same matrix with permuted rows and columns
+	StiffnessMatrix stiffness, reordered_stiffness;
+	state.build_stiffness_mat(stiffness);
+	reordered.build_stiffness_mat(reordered_stiffness);
+	REQUIRE(stiffness.nonZeros() == reordered_stiffness.nonZeros());
 
-		// grad
+	int bandwidth = 0, reordered_bandwidth = 0;
+	for (int k = 0; k < stiffness.outerSize(); ++k)
+	{
+		for (StiffnessMatrix::InnerIterator it(stiffness, k); it; ++it)
 		{
-			const NonLinearAssemblerData data(vals, 0, displacement, displacement, da);
-
-			const Eigen::VectorXd grada = autodiff.assemble_gradient(data);
-			const Eigen::VectorXd grad = real.assemble_gradient(data);
+			const int r = 2 * old_to_new[it.row() / 2] + it.row() % 2;
+			const int c = 2 * old_to_new[it.col() / 2] + it.col() % 2;
+			REQUIRE(reordered_stiffness.coeff(r, c) == Approx(it.value()).margin(1e-8));
 
-			for (int i = 0; i < grada.size(); ++i)
-			{
-				if (std::isnan(grad(i)))
-					REQUIRE(std::isnan(grada(i)));
-				else
-					REQUIRE(grada(i) == Approx(grad(i)).margin(1e-12));
-			}
+			bandwidth = std::max(bandwidth, std::abs(int(it.row() - it.col())));
+			reordered_bandwidth = std::max(reordered_bandwidth, std::abs(r - c));
 		}
+	}
 
-		// hessian
-		{
-			const NonLinearAssemblerData data(vals, 0, displacement, displacement, da);
+	if (ordering == "rcm")
+		CHECK(reordered_bandwidth <= bandwidth);
+}
 
-			const Eigen::MatrixXd hessiana = autodiff.assemble_hessian(data);
-			const Eigen::MatrixXd hessian = real.assemble_hessian(data);
+TEST_CASE("mesh_partition", "[assembler]")
+{
+	const std::string path = POLYFEM_DATA_DIR;
+	const int n_parts = GENERATE(1, 3, 4);
 
-			for (int i = 0; i < hessiana.size(); ++i)
-			{
-				if (std::isnan(hessian(i)))
-					REQUIRE(std::isnan(hessiana(i)));
-				else
-					REQUIRE(hessiana(i) == Approx(hessian(i)).margin(1e-12));
-			}
-		}
+	json in_args = json({});
+	in_args["geometry"] = {};
+	in_args["geometry"]["mesh"] = path + "/plane_hole.obj";
+	in_args["geometry"]["surface_selection"] = 7;
 
-		// F stress
-		{
-			Eigen::MatrixXd stressa, stress;
-			autodiff.compute_stress_tensor(el_id, bs, bs, local_pts, displacement, ElasticityTensorType::F, stressa);
-			real.compute_stress_tensor(el_id, bs, bs, local_pts, displacement, ElasticityTensorType::F, stress);
+	in_args["preset_problem"] = {};
+	in_args["preset_problem"]["type"] = "ElasticExact";
 
-			for (int i = 0; i < stressa.size(); ++i)
-			{
-				if (std::isnan(stress(i)))
-					REQUIRE(std::isnan(stressa(i)));
-				else
-					REQUIRE(stressa(i) == Approx(stress(i)).margin(1e-12));
-			}
-		}
+	in_args["materials"] = {};
+	in_args["materials"]["type"] = "LinearElasticity";
+	in_args["materials"]["E"] = 1e5;
+	in_args["materials"]["nu"] = 0.3;
 
-		// cauchy stress
-		{
-			Eigen::MatrixXd stressa, stress;
-			autodiff.compute_stress_tensor(el_id, bs, bs, local_pts, displacement, ElasticityTensorType::CAUCHY, stressa);
-			real.compute_stress_tensor(el_id, bs, bs, local_pts, displacement, ElasticityTensorType::CAUCHY, stress);
+	State state;
+	state.init_logger("", spdlog::level::err, false);
+	state.init(in_args, true);
+	state.load_mesh();
 
-			for (int i = 0; i < stressa.size(); ++i)
-			{
-				if (std::isnan(stress(i)))
-					REQUIRE(std::isnan(stressa(i)));
-				else
-					REQUIRE(stressa(i) == Approx(stress(i)).margin(1e-12));
-			}
-		}
+	const Eigen::VectorXi part = partition::bisection(*state.mesh, n_parts);
+	REQUIRE(part.size() == state.mesh->n_elements());
+	REQUIRE(part.minCoeff() == 0);
+	REQUIRE(part.maxCoeff() == n_parts - 1);
+	std::vector<int> sizes(n_parts, 0);
+	for (int e = 0; e < part.size(); ++e)
+		++sizes[part[e]];
+	REQUIRE(*std::max_element(sizes.begin(), sizes.end()) - *std::min_element(sizes.begin(), sizes.end()) <= 1);
 
-		// pk1 stress
-		{
-			Eigen::MatrixXd stressa, stress;
-			autodiff.compute_stress_tensor(el_id, bs, bs, local_pts, displacement, ElasticityTensorType::PK1, stressa);
-			real.compute_stress_tensor(el_id, bs, bs, local_pts, displacement, ElasticityTensorType::PK1, stress);
+	const int cut = partition::edge_cut(*state.mesh, part);
+	if (n_parts == 1)
+		REQUIRE(cut == 0);
+	else
+		REQUIRE(cut > 0);
+}
 
-			for (int i = 0; i < stressa.size(); ++i)
+TEST_CASE("sum_factorization", "[assembler]")
+{
+	const std::string path = POLYFEM_DATA_DIR;
+	const int discr_order = GENERATE(1, 2, 3);
+
+	json in_args = json({});
+	in_args["geometry"] = {};
+	// replaced by the hex grid below
+	in_args["geometry"]["mesh"] = path + "/plane_hole.obj";
+
+	in_args["materials"] = {};
+	in_args["materials"]["type"] = "Laplacian";
+
+	in_args["space"] = {};
+	in_args["space"]["discr_order"] = discr_order;
+
+	// 2 x 2 x 2 hexes, the center vertex is moved so that the geometric mapping is not affine
+	Eigen::MatrixXd V(27, 3);
+	for (int k = 0; k < 3; ++k)
+		for (int j = 0; j < 3; ++j)
+			for (int i = 0; i < 3; ++i)
+				V.row(i + 3 * (j + 3 * k)) << i / 2., j / 2., k / 2.;
+	V.row(13) += Eigen::RowVector3d(0.05, -0.03, 0.02);
+
+	Eigen::MatrixXi F(8, 8);
+	for (int k = 0; k < 2; ++k)
+		for (int j = 0; j < 2; ++j)
+			for (int i = 0; i < 2; ++i)
 			{
-				if (std::isnan(stress(i)))
-					REQUIRE(std::isnan(stressa(i)));
-				else
-					REQUIRE(stressa(i) == Approx(stress(i)).margin(1e-12));
+				const int v = i + 3 * (j + 3 * k);
+				F.row(i + 2 * (j + 2 * k)) << v, v + 1, v + 4, v + 3, v + 9, v + 10, v + 13, v + 12;
 			}
-		}
 
-		// pk2 stress
-		{
-			Eigen::MatrixXd stressa, stress;
-			autodiff.compute_stress_tensor(el_id, bs, bs, local_pts, displacement, ElasticityTensorType::PK2, stressa);
-			real.compute_stress_tensor(el_id, bs, bs, local_pts, displacement, ElasticityTensorType::PK2, stress);
+	State state;
+	state.init_logger("", spdlog::level::err, false);
+	state.init(in_args, true);
+	state.load_mesh(V, F);
+	state.build_basis();
 
-			for (int i = 0; i < stressa.size(); ++i)
+	StiffnessMatrix stiffness;
+	state.assembler->assemble(true, state.n_bases, state.bases, state.geom_bases(), state.ass_vals_cache, stiffness);
+
+	SumFactorizedLaplacian op(true, state.n_bases, state.bases, state.geom_bases());
+	REQUIRE(op.n_sum_factorized() == state.bases.size());
+
+	const Eigen::VectorXd v = Eigen::VectorXd::Random(state.n_bases);
+	Eigen::VectorXd out;
+	op.apply(v, out);
+
+	const Eigen::VectorXd expected = stiffness * v;
+	REQUIRE((out - expected).norm() == Approx(0).margin(1e-10 * expected.norm()));
+
+	const Eigen::VectorXd diagonal = stiffness.diagonal();
+	REQUIRE((op.diagonal() - diagonal).norm() == Approx(0).margin(1e-10 * diagonal.norm()));
+}
+
+TEST_CASE("mixed_system_assembly", "[assembler]")
+{
+	const std::string path = POLYFEM_DATA_DIR;
+	json in_args = json({});
+	in_args["geometry"] = {};
+	in_args["geometry"]["mesh"] = path + "/plane_hole.obj";
+	in_args["geometry"]["surface_selection"] = 7;
+
+	in_args["preset_problem"] = {};
+	in_args["preset_problem"]["type"] = "DrivenCavity";
+
+	in_args["materials"] = {};
+	in_args["materials"]["type"] = "Stokes";
+	in_args["materials"]["viscosity"] = 1;
+
+	in_args["space"] = {};
+	in_args["space"]["discr_order"] = 2;
+	in_args["space"]["pressure_discr_order"] = 1;
+
+	State state;
+	state.init_logger("", spdlog::level::err, false);
+	state.init(in_args, true);
+	state.load_mesh();
+	state.build_basis();
+
+	REQUIRE(state.mixed_assembler != nullptr);
+	const auto &velocity_assembler = dynamic_cast<const LinearAssembler &>(*state.assembler);
+	const auto &pressure_assembler = dynamic_cast<const LinearAssembler &>(*state.pressure_assembler);
+
+	StiffnessMatrix velocity_stiffness, mixed_stiffness, pressure_stiffness;
+	velocity_assembler.assemble(false, state.n_bases, state.bases, state.bases, state.ass_vals_cache, velocity_stiffness);
+	state.mixed_assembler->assemble(false, state.n_pressure_bases, state.n_bases, state.pressure_bases, state.bases, state.bases, state.pressure_ass_vals_cache, state.ass_vals_cache, mixed_stiffness);
+	pressure_assembler.assemble(false, state.n_pressure_bases, state.pressure_bases, state.bases, state.pressure_ass_vals_cache, pressure_stiffness);
+
+	const bool add_average = GENERATE(false, true);
+	StiffnessMatrix expected, stiffness;
+	AssemblerUtils::merge_mixed_matrices(state.n_bases, state.n_pressure_bases, 2, add_average, velocity_stiffness, mixed_stiffness, pressure_stiffness, expected);
+	state.mixed_assembler->assemble_system(false, state.n_pressure_bases, state.n_bases, state.pressure_bases, state.bases, state.bases,
+										   state.pressure_ass_vals_cache, state.ass_vals_cache, velocity_assembler, pressure_assembler, add_average, stiffness);
+
+	REQUIRE(stiffness.rows() == expected.rows());
+	REQUIRE(stiffness.cols() == expected.cols());
+	REQUIRE(stiffness.nonZeros() == expected.nonZeros());
+	REQUIRE((stiffness - expected).norm() / expected.norm() == Approx(0).margin(1e-12));
+}
+
+TEST_CASE("navier_stokes_convective_term", "[assembler]")
+{
+	const std::string path = POLYFEM_DATA_DIR;
+	json in_args = json({});
+	in_args["geometry"] = {};
+	in_args["geometry"]["mesh"] = path + "/plane_hole.obj";
+	in_args["geometry"]["surface_selection"] = 7;
+
+	in_args["preset_problem"] = {};
+	in_args["preset_problem"]["type"] = "ElasticExact";
+
+	in_args["materials"] = {};
+	in_args["materials"]["type"] = "LinearElasticity";
+	in_args["materials"]["E"] = 1e5;
+	in_args["materials"]["nu"] = 0.3;
+
+	// P2 triangles use the fixed size kernel, P1 the dynamic one
+	const int discr_order = GENERATE(1, 2);
+	in_args["space"] = {};
+	in_args["space"]["discr_order"] = discr_order;
+
+	State state;
+	state.init_logger("", spdlog::level::err, false);
+	state.init(in_args, true);
+	state.load_mesh();
+	state.build_basis();
+
+	NavierStokesVelocity assembler;
+	assembler.set_size(2);
+	assembler.add_multimaterial(0, json({{"viscosity", 0.1}}));
+
+	Eigen::MatrixXd velocity(state.n_bases * 2, 1);
+	velocity.setRandom();
+	const Eigen::MatrixXd delta = Eigen::MatrixXd::Random(state.n_bases * 2, 1);
+	const double eps = 1e-6;
+
+	for (int el_id = 0; el_id < std::min<int>(5, state.bases.size()); ++el_id)
+	{
+		const auto &bs = state.bases[el_id];
+		ElementAssemblyValues vals;
+		vals.compute(el_id, false, bs, bs);
+		const QuadratureVector da = vals.det.array() * vals.quadrature.weights.array();
+
+		const auto local = [&](const Eigen::MatrixXd &x) {
+			Eigen::VectorXd res = Eigen::VectorXd::Zero(vals.basis_values.size() * 2);
+			for (int i = 0; i < vals.basis_values.size(); ++i)
 			{
-				if (std::isnan(stress(i)))
-					REQUIRE(std::isnan(stressa(i)));
-				else
-					REQUIRE(stressa(i) == Approx(stress(i)).margin(1e-12));
+				for (const auto &g : vals.basis_values[i].global)
+				{
+					for (int d = 0; d < 2; ++d)
+						res(i * 2 + d) += g.val * x(g.index * 2 + d);
+				}
 			}
-		}
+			return res;
+		};
+
+		const NonLinearAssemblerData data(vals, 0, velocity, velocity, da);
+		const Eigen::VectorXd residual = assembler.assemble_gradient(data);
+
+		// the Picard matrix applied to the velocity is the convective term
+		assembler.set_picard(true);
+		const Eigen::MatrixXd picard = assembler.assemble_hessian(data);
+		REQUIRE((picard * local(velocity) - residual).norm() == Approx(0).margin(1e-10 * residual.norm()));
+
+		// the full Jacobian is the derivative of the convective term
+		assembler.set_picard(false);
+		const Eigen::MatrixXd jacobian = assembler.assemble_hessian(data);
+
+		const Eigen::MatrixXd x_plus = velocity + eps * delta;
+		const Eigen::MatrixXd x_minus = velocity - eps * delta;
+		const Eigen::VectorXd fd = (assembler.assemble_gradient(NonLinearAssemblerData(vals, 0, x_plus, x_plus, da))
+									- assembler.assemble_gradient(NonLinearAssemblerData(vals, 0, x_minus, x_minus, da)))
+								   / (2 * eps);
+		const Eigen::VectorXd expected = jacobian * local(delta);
+		REQUIRE((fd - expected).norm() == Approx(0).margin(1e-6 * std::max(1., expected.norm())));
+	}
+}
+
+TEST_CASE("material_parameter_tables", "[assembler]")
+{
+	LameParameters lame;
+	for (int e = 0; e < 4; ++e)
+		lame.add_multimaterial(e, json{{"E", 100.0 + e}, {"nu", 0.3}}, true);
+
+	for (int e = 0; e < 4; ++e)
+	{
+		const double E = 100 + e, nu = 0.3;
+		double lambda, mu;
+		lame.lambda_mu(0, 0, 0, 1, 2, 3, e, lambda, mu);
+		CHECK(lambda == Approx(E * nu / ((1 + nu) * (1 - 2 * nu))));
+		CHECK(mu == Approx(E / (2 * (1 + nu))));
 	}
-}
\ No newline at end of file
+
+	// switching to lambda and mu changes the conversion of all the materials
+	lame.add_multimaterial(1, json{{"lambda", 2.0}, {"mu", 3.0}}, true);
+	double lambda, mu;
+	lame.lambda_mu(0, 0, 0, 1, 2, 3, 1, lambda, mu);
+	CHECK(lambda == Approx(2));
+	CHECK(mu == Approx(3));
+	lame.lambda_mu(0, 0, 0, 1, 2, 3, 0, lambda, mu);
+	CHECK(lambda == Approx(100));
+	CHECK(mu == Approx(0.3));
+
+	Density density;
+	CHECK(density(0, 0, 0, 0, 0, 0, 0) == 1);
+	density.add_multimaterial(0, json{{"rho", 7.0}});
+	density.add_multimaterial(1, json{{"density", 3.0}});
+	CHECK(density(0, 0, 0, 1, 2, 3, 0) == 7);
+	CHECK(density(0, 0, 0, 1, 2, 3, 1) == 3);
+}
@@ -6,12 +6,20 @@
 #include <polyfem/quadrature/QuadQuadrature.hpp>
 #include <polyfem/quadrature/HexQuadrature.hpp>
 
+#include <polyfem/assembler/ElementAssemblyValues.hpp>
+
 #include <polyfem/basis/LagrangeBasis3d.hpp>
+#include <polyfem/basis/ElementBases.hpp>
+#include <polyfem/basis/ReferenceTables.hpp>
 #include <polyfem/autogen/auto_p_bases.hpp>
 #include <polyfem/autogen/auto_q_bases.hpp>
+#include <polyfem/autogen/all_bases.hpp>
+#include <polyfem/basis/function/PolytopeSimilarity.hpp>
 
 #include <polyfem/basis/barycentric/MVPolygonalBasis2d.hpp>
 #include <polyfem/basis/barycentric/WSPolygonalBasis2d.hpp>
+#include <polyfem/basis/PolygonalBasis2d.hpp>
+#include <polyfem/State.hpp>
 
 #include <catch2/catch.hpp>
 #include <iostream>
@@ -1176,3 +1184,396 @@ TEST_CASE("WS_2d", "[bases]")
 		}
 	}
 }
+
+TEST_CASE("barycentric_blocks", "[bases]")
+{
+	const double eps = 1e-10;
+
+	Eigen::MatrixXd polygon(6, 2);
+	polygon.row(0) << 0, 0;
+	polygon.row(1) << 1, 0;
+	polygon.row(2) << 1, 1;
+	polygon.row(3) << 0.5, 2;
+	polygon.row(4) << 0, 2;
+	polygon.row(5) << -1, 1;
+	const BarycentricBasis2d::PolygonData data(polygon);
+
+	// interior points, the first two are on a vertex and on an edge
+	Eigen::MatrixXd pts = Eigen::MatrixXd::Random(30, 2) * 0.4;
+	pts.col(0).array() += 0.3;
+	pts.col(1).array() += 1;
+	pts.row(0) = polygon.row(2);
+	pts.row(1) << 0.5, 0;
+	const Eigen::MatrixXd interior = pts.bottomRows(pts.rows() - 2);
+
+	Eigen::MatrixXd b, dx, dy, expected;
+	for (const bool mean_value : {true, false})
+	{
+		if (mean_value)
+			MVPolygonalBasis2d::meanvalue_block(data, pts, b, eps);
+		else
+			WSPolygonalBasis2d::wachspress_block(data, pts, b, eps);
+		REQUIRE(b.rows() == pts.rows());
+		REQUIRE(b.cols() == polygon.rows());
+
+		for (int i = 0; i < pts.rows(); ++i)
+		{
+			if (mean_value)
+				MVPolygonalBasis2d::meanvalue(polygon, pts.row(i), expected, eps);
+			else
+				WSPolygonalBasis2d::wachspress(polygon, pts.row(i), expected, eps);
+			REQUIRE((b.row(i) - expected.transpose()).norm() == Approx(0).margin(1e-12));
+		}
+
+		// the pointwise derivatives are not defined on the boundary of the polygon
+		if (mean_value)
+			MVPolygonalBasis2d::meanvalue_derivative_block(data, interior, dx, dy, eps);
+		else
+			WSPolygonalBasis2d::wachspress_derivative_block(data, interior, dx, dy, eps);
+
+		for (int i = 0; i < interior.rows(); ++i)
+		{
+			if (mean_value)
+				MVPolygonalBasis2d::meanvalue_derivative(polygon, interior.row(i), expected, eps);
+			else
+				WSPolygonalBasis2d::wachspress_derivative(polygon, interior.row(i), expected, eps);
+			REQUIRE((dx.row(i) - expected.col(0).transpose()).norm() == Approx(0).margin(1e-12));
+			REQUIRE((dy.row(i) - expected.col(1).transpose()).norm() == Approx(0).margin(1e-12));
+		}
+	}
+}
+
+TEST_CASE("reference_tables", "[bases]")
+{
+	const int order = 3;
+	const int n_bases = (order + 1) * (order + 2) / 2;
+
+	TriQuadrature rule;
+	Quadrature quad;
+	rule.get_quadrature(2 * order, quad);
+
+	reference_tables::clear();
+
+	std::vector<ElementBases> elements(2);
+	for (auto &b : elements)
+	{
+		b.bases.resize(n_bases);
+		for (int j = 0; j < n_bases; ++j)
+		{
+			b.bases[j].set_basis([j](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::p_basis_value_2d(order, j, uv, val); });
+			b.bases[j].set_grad([j](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::p_grad_basis_value_2d(order, j, uv, val); });
+		}
+		b.set_reference_element(reference_tables::ReferenceElement::TRIANGLE, order);
+		REQUIRE(b.has_reference_table());
+	}
+
+	std::vector<AssemblyValues> expected, tabulated;
+	for (const auto &b : elements)
+	{
+		b.evaluate_bases(quad.points, expected);
+		b.evaluate_grads(quad.points, expected);
+		b.evaluate_tabulated(quad.points, tabulated);
+
+		REQUIRE(tabulated.size() == n_bases);
+		for (int j = 0; j < n_bases; ++j)
+		{
+			REQUIRE(tabulated[j].val == expected[j].val);
+			REQUIRE(tabulated[j].grad == expected[j].grad);
+		}
+	}
+	// both elements share the same table
+	REQUIRE(reference_tables::size() == 1);
+
+	// other point sets are evaluated directly once the cache of the element is full
+	for (int i = 0; i < reference_tables::MAX_POINT_SETS + 2; ++i)
+	{
+		const Eigen::MatrixXd pts = Eigen::MatrixXd::Constant(1, 2, 0.01 * (i + 1));
+		elements[0].evaluate_bases(pts, expected);
+		elements[0].evaluate_grads(pts, expected);
+		elements[0].evaluate_tabulated(pts, tabulated);
+		for (int j = 0; j < n_bases; ++j)
+		{
+			REQUIRE(tabulated[j].val == expected[j].val);
+			REQUIRE(tabulated[j].grad == expected[j].grad);
+		}
+	}
+	REQUIRE(reference_tables::size() == reference_tables::MAX_POINT_SETS);
+
+	reference_tables::clear();
+	REQUIRE(reference_tables::size() == 0);
+}
+
+TEST_CASE("batched_geom_mapping", "[bases]")
+{
+	const int order = 2;
+	const int n_bases = (order + 1) * (order + 2) / 2;
+
+	reference_tables::clear();
+
+	Eigen::MatrixXd ref_nodes;
+	autogen::p_nodes_2d(order, ref_nodes);
+
+	// curved elements, the last one has no reference table and is mapped on its own
+	std::vector<ElementBases> gbases(4);
+	for (int e = 0; e < gbases.size(); ++e)
+	{
+		ElementBases &b = gbases[e];
+		b.bases.resize(n_bases);
+		for (int j = 0; j < n_bases; ++j)
+		{
+			b.bases[j].init(order, e * n_bases + j, j, (ref_nodes.row(j) * (e + 1) + Eigen::RowVector2d::Random() * 0.05).eval());
+			b.bases[j].set_basis([j](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::p_basis_value_2d(order, j, uv, val); });
+			b.bases[j].set_grad([j](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::p_grad_basis_value_2d(order, j, uv, val); });
+		}
+		if (e < 3)
+			b.set_reference_element(reference_tables::ReferenceElement::TRIANGLE, order);
+	}
+
+	TriQuadrature rule;
+	Quadrature quad;
+	rule.get_quadrature(4, quad);
+
+	const std::vector<int> elements = {2, 0, 3, 1};
+	Eigen::MatrixXd mapped, expected;
+	std::vector<Eigen::MatrixXd> grads, expected_grads;
+	ElementBases::eval_geom_mapping(gbases, elements, quad.points, mapped);
+	ElementBases::eval_geom_mapping_grads(gbases, elements, quad.points, grads);
+
+	const int n_samples = quad.points.rows();
+	REQUIRE(mapped.rows() == elements.size() * n_samples);
+	REQUIRE(grads.size() == elements.size() * n_samples);
+	for (int i = 0; i < elements.size(); ++i)
+	{
+		gbases[elements[i]].eval_geom_mapping(quad.points, expected);
+		gbases[elements[i]].eval_geom_mapping_grads(quad.points, expected_grads);
+
+		REQUIRE((mapped.middleRows(i * n_samples, n_samples) - expected).norm() == Approx(0).margin(1e-12));
+		for (int k = 0; k < n_samples; ++k)
+			REQUIRE((grads[i * n_samples + k] - expected_grads[k]).norm() == Approx(0).margin(1e-12));
+	}
+	REQUIRE(reference_tables::size() == 1);
+
+	reference_tables::clear();
+}
+
+TEST_CASE("batched_jacobians", "[bases]")
+{
+	const int order = 2;
+
+	for (const bool is_volume : {false, true})
+	{
+		const int dim = is_volume ? 3 : 2;
+		const int n_bases = is_volume ? 10 : 6;
+
+		Eigen::MatrixXd ref_nodes;
+		if (is_volume)
+			autogen::p_nodes_3d(order, ref_nodes);
+		else
+			autogen::p_nodes_2d(order, ref_nodes);
+
+		// curved element, the jacobian changes at every point
+		ElementBases b;
+		b.bases.resize(n_bases);
+		for (int j = 0; j < n_bases; ++j)
+		{
+			b.bases[j].init(order, j, j, (ref_nodes.row(j) * 2 + Eigen::RowVectorXd::Random(dim) * 0.05).eval());
+			if (is_volume)
+			{
+				b.bases[j].set_basis([j](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::p_basis_value_3d(order, j, uv, val); });
+				b.bases[j].set_grad([j](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::p_grad_basis_value_3d(order, j, uv, val); });
+			}
+			else
+			{
+				b.bases[j].set_basis([j](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::p_basis_value_2d(order, j, uv, val); });
+				b.bases[j].set_grad([j](const Eigen::MatrixXd &uv, Eigen::MatrixXd &val) { autogen::p_grad_basis_value_2d(order, j, uv, val); });
+			}
+		}
+
+		Quadrature quad;
+		if (is_volume)
+			TetQuadrature().get_quadrature(4, quad);
+		else
+			TriQuadrature().get_quadrature(4, quad);
+
+		ElementAssemblyValues vals;
+		vals.compute(0, is_volume, quad.points, b, b);
+		REQUIRE(!vals.is_affine);
+
+		std::vector<Eigen::MatrixXd> grads;
+		b.eval_geom_mapping_grads(quad.points, grads);
+		for (int k = 0; k < quad.points.rows(); ++k)
+		{
+			const Eigen::MatrixXd jac_it = grads[k].inverse().transpose();
+			REQUIRE(vals.det(k) == Approx(grads[k].determinant()).epsilon(1e-12));
+			REQUIRE((Eigen::MatrixXd(vals.jac_it[k]) - jac_it).norm() == Approx(0).margin(1e-12));
+			for (const AssemblyValues &v : vals.basis_values)
+				REQUIRE((v.grad_t_m.row(k) - v.grad.row(k) * jac_it).norm() == Approx(0).margin(1e-12));
+		}
+	}
+}
+
+TEST_CASE("all_bases", "[bases]")
+{
+	const int dim = GENERATE(2, 3);
+	const Eigen::MatrixXd uv = Eigen::MatrixXd::Random(10, dim).cwiseAbs() / (dim + 1);
+
+	Eigen::MatrixXd val, expected;
+	std::vector<Eigen::MatrixXd> grad;
+
+	for (int p = 0; p <= autogen::MAX_P_BASES + 2; ++p)
+	{
+		autogen::p_basis_values(p, uv, val);
+		autogen::p_grad_basis_values(p, uv, grad);
+		REQUIRE(val.cols() == grad.size());
+
+		for (int j = 0; j < val.cols(); ++j)
+		{
+			if (dim == 2)
+				autogen::p_basis_value_2d(p, j, uv, expected);
+			else
+				autogen::p_basis_value_3d(p, j, uv, expected);
+			REQUIRE((val.col(j) - expected).cwiseAbs().maxCoeff() < 1e-12);
+
+			if (dim == 2)
+				autogen::p_grad_basis_value_2d(p, j, uv, expected);
+			else
+				autogen::p_grad_basis_value_3d(p, j, uv, expected);
+			REQUIRE((grad[j] - expected).cwiseAbs().maxCoeff() < 1e-11);
+		}
+	}
+
+	for (const int q : {0, 1, 2, 3, -2})
+	{
+		autogen::q_basis_values(q, uv, val);
+		autogen::q_grad_basis_values(q, uv, grad);
+		REQUIRE(val.cols() == grad.size());
+
+		for (int j = 0; j < val.cols(); ++j)
+		{
+			if (dim == 2)
+				autogen::q_basis_value_2d(q, j, uv, expected);
+			else
+				autogen::q_basis_value_3d(q, j, uv, expected);
+			REQUIRE((val.col(j) - expected).cwiseAbs().maxCoeff() < 1e-12);
+
+			if (dim == 2)
+				autogen::q_grad_basis_value_2d(q, j, uv, expected);
+			else
+				autogen::q_grad_basis_value_3d(q, j, uv, expected);
+			REQUIRE((grad[j] - expected).cwiseAbs().maxCoeff() < 1e-11);
+		}
+	}
+}
+
+TEST_CASE("polytope_similarity", "[bases]")
+{
+	const int dim = GENERATE(2, 3);
+	const bool with_constraints = GENERATE(false, true);
+	const int n_bases = 4;
+
+	const auto random_polytope = [&]() {
+		RBFFitData d;
+		d.collocation_points = Eigen::MatrixXd::Random(30, dim);
+		d.centers = 2 * Eigen::MatrixXd::Random(10, dim);
+		d.rhs = Eigen::MatrixXd::Random(30, n_bases);
+		d.local_basis_integral = Eigen::MatrixXd::Random(n_bases, dim);
+		d.quadrature.points = 0.5 * Eigen::MatrixXd::Random(20, dim);
+		d.quadrature.weights = Eigen::VectorXd::Random(20).array().abs() + 0.1;
+		return d;
+	};
+
+	// rotated, scaled and translated copy of the first polytope
+	const Eigen::MatrixXd rotation = Eigen::HouseholderQR<Eigen::MatrixXd>(Eigen::MatrixXd::Random(dim, dim)).householderQ();
+	const double scale = 2.5;
+	const Eigen::RowVectorXd translation = 10 * Eigen::RowVectorXd::Random(dim);
+	const auto transform = [&](const Eigen::MatrixXd &pts) -> Eigen::MatrixXd { return (scale * pts * rotation).rowwise() + translation; };
+
+	std::vector<RBFFitData> data = {random_polytope(), random_polytope()};
+	RBFFitData copy = data[0];
+	copy.collocation_points = transform(data[0].collocation_points);
+	copy.centers = transform(data[0].centers);
+	copy.quadrature.points = transform(data[0].quadrature.points);
+	copy.quadrature.weights *= std::pow(scale, dim);
+	copy.local_basis_integral = std::pow(scale, dim - 1) * data[0].local_basis_integral * rotation;
+	data.push_back(copy);
+
+	std::vector<int> representative;
+	std::vector<Similarity> to_representative;
+	group_similar_polytopes(data, with_constraints, representative, to_representative);
+	REQUIRE(representative == std::vector<int>{0, 1, 0});
+
+	Eigen::MatrixXd rhs = data[0].rhs;
+	const auto fitted = std::make_shared<RBFWithLinear>(data[0].centers, data[0].collocation_points, data[0].local_basis_integral, data[0].quadrature, rhs, with_constraints);
+	const MappedRBFWithLinear mapped(fitted, to_representative[2]);
+
+	rhs = copy.rhs;
+	const RBFWithLinear expected(copy.centers, copy.collocation_points, copy.local_basis_integral, copy.quadrature, rhs, with_constraints);
+
+	const Eigen::MatrixXd pts = transform(0.3 * Eigen::MatrixXd::Random(10, dim));
+	Eigen::MatrixXd val, expected_val;
+	mapped.bases_values(pts, val);
+	expected.bases_values(pts, expected_val);
+	REQUIRE((val - expected_val).norm() < 1e-6 * expected_val.norm());
+
+	for (int d = 0; d < dim; ++d)
+	{
+		mapped.bases_grads(d, pts, val);
+		expected.bases_grads(d, pts, expected_val);
+		REQUIRE((val - expected_val).norm() < 1e-6 * expected_val.norm());
+	}
+}
+
+TEST_CASE("polygon_samples_cache", "[bases]")
+{
+	State state;
+	state.init_logger("", spdlog::level::err, false);
+	state.init(R"({"materials": {"type": "Laplacian"}})"_json, true);
+
+	// 4x4 grid of unit squares, the 2x2 squares at the center are a single polygon with 8 vertices
+	const int n = 4;
+	GEO::Mesh M;
+	M.vertices.set_dimension(3);
+	for (int j = 0; j <= n; ++j)
+		for (int i = 0; i <= n; ++i)
+			M.vertices.create_vertex(GEO::vec3(i, j, 0).data());
+	const auto v = [&](const int i, const int j) { return GEO::index_t(j * (n + 1) + i); };
+	for (int j = 0; j < n; ++j)
+	{
+		for (int i = 0; i < n; ++i)
+		{
+			if (i >= 1 && i <= 2 && j >= 1 && j <= 2)
+				continue;
+			M.facets.create_quad(v(i, j), v(i + 1, j), v(i + 1, j + 1), v(i, j + 1));
+		}
+	}
+	GEO::vector<GEO::index_t> polygon = {v(1, 1), v(2, 1), v(3, 1), v(3, 2), v(3, 3), v(2, 3), v(1, 3), v(1, 2)};
+	M.facets.create_polygon(polygon);
+
+	state.load_mesh(M, [](const RowVectorNd &) { return 1; });
+	REQUIRE(state.mesh->n_elements() == n * n - 3);
+
+	const auto polygon_values = [&]() {
+		int e = 0;
+		while (!state.mesh->is_polytope(e))
+			++e;
+		const Eigen::MatrixXd pts = Eigen::RowVector2d(2.2, 1.7);
+		std::vector<AssemblyValues> values;
+		state.bases[e].evaluate_bases(pts, values);
+		Eigen::VectorXd res(values.size());
+		for (int i = 0; i < res.size(); ++i)
+			res(i) = values[i].val(0);
+		return res;
+	};
+
+	state.build_basis();
+	REQUIRE(state.polygon_samples_cache != nullptr);
+	CHECK(state.polygon_samples_cache->n_reused() == 0);
+	const Eigen::VectorXd first = polygon_values();
+
+	// same mesh and space, the samples are reused and the bases are the same
+	state.build_basis();
+	CHECK(state.polygon_samples_cache->n_reused() == 1);
+	const Eigen::VectorXd second = polygon_values();
+	REQUIRE(first.size() == second.size());
+	CHECK((first - second).norm() < 1e-12);
+}
@@ -1,10 +1,18 @@
 ////////////////////////////////////////////////////////////////////////////////
 #include <polyfem/mesh/mesh2D/CMesh2D.hpp>
+#include <polyfem/mesh/mesh3D/CMesh3D.hpp>
+#include <polyfem/mesh/PointGrid.hpp>
+#include <polyfem/mesh/PointLocator.hpp>
+#include <polyfem/mesh/FrameSequence.hpp>
+#include <polyfem/mesh/MeshCache.hpp>
+#include <polyfem/mesh/Obstacle.hpp>
 #include <polyfem/State.hpp>
 
 #include <catch2/catch.hpp>
+#include <atomic>
 #include <iostream>
 #include <fstream>
+#include <filesystem>
 ////////////////////////////////////////////////////////////////////////////////
 
 using namespace polyfem;
@@ -21,3 +29,406 @@ TEST_CASE("append_2d", "[mesh_test]")
 
 	m1->append(m2);
 }
+
+TEST_CASE("append_many", "[mesh_test]")
+{
+	//Used to init geogram
+	State state;
+
+	// shifted copies of a unit square split in two triangles
+	const auto body = [](const int k) {
+		Eigen::MatrixXd V(4, 2);
+		V << 0, 0, 1, 0, 1, 1, 0, 1;
+		V.col(0).array() += 2 * k;
+		Eigen::MatrixXi F(2, 3);
+		F << 0, 1, 2, 0, 2, 3;
+		auto mesh = Mesh::create(V, F);
+		mesh->set_body_ids(std::vector<int>(mesh->n_elements(), k));
+		return mesh;
+	};
+
+	const int n_bodies = 10;
+	auto sequential = body(0);
+	auto batch = body(0);
+	std::vector<std::unique_ptr<Mesh>> others;
+	std::vector<const Mesh *> to_append;
+	for (int k = 1; k < n_bodies; ++k)
+	{
+		sequential->append(body(k));
+		others.push_back(body(k));
+		to_append.push_back(others.back().get());
+	}
+	batch->append(to_append);
+
+	REQUIRE(batch->n_vertices() == 4 * n_bodies);
+	REQUIRE(batch->n_elements() == 2 * n_bodies);
+	REQUIRE(batch->n_vertices() == sequential->n_vertices());
+	REQUIRE(batch->n_edges() == sequential->n_edges());
+	REQUIRE(batch->in_ordered_vertices() == sequential->in_ordered_vertices());
+	for (int v = 0; v < batch->n_vertices(); ++v)
+		CHECK(batch->point(v) == sequential->point(v));
+	for (int e = 0; e < batch->n_elements(); ++e)
+	{
+		CHECK(batch->get_body_id(e) == e / 2);
+		for (int lv = 0; lv < 3; ++lv)
+			CHECK(batch->element_vertex(e, lv) == sequential->element_vertex(e, lv));
+	}
+
+	// obstacles, a segment mesh and a triangle mesh per body
+	Obstacle obstacle_sequential, obstacle_batch;
+	std::vector<Obstacle::MeshData> meshes;
+	std::vector<json> displacements;
+	for (int k = 0; k < n_bodies; ++k)
+	{
+		Obstacle::MeshData mesh;
+		mesh.vertices = Eigen::MatrixXd::Random(3, 2);
+		if (k % 2 == 0)
+		{
+			mesh.codim_edges.resize(2, 2);
+			mesh.codim_edges << 0, 1, 1, 2;
+		}
+		else
+		{
+			mesh.faces.resize(1, 3);
+			mesh.faces << 0, 1, 2;
+		}
+		const json displacement = R"({"value": [0, 0, 0]})"_json;
+		obstacle_sequential.append_mesh(mesh.vertices, mesh.codim_vertices, mesh.codim_edges, mesh.faces, displacement);
+		meshes.push_back(mesh);
+		displacements.push_back(displacement);
+	}
+	obstacle_batch.append_meshes(meshes, displacements);
+
+	REQUIRE(obstacle_batch.n_vertices() == 3 * n_bodies);
+	REQUIRE(obstacle_batch.n_faces() == n_bodies / 2);
+	// two codim edges or three face edges per body
+	REQUIRE(obstacle_batch.n_edges() == 5 * n_bodies / 2);
+	REQUIRE(obstacle_batch.f().row(0) == Eigen::RowVector3i(3, 4, 5));
+	REQUIRE(obstacle_batch.v() == obstacle_sequential.v());
+	REQUIRE(obstacle_batch.e() == obstacle_sequential.e());
+	REQUIRE(obstacle_batch.f() == obstacle_sequential.f());
+	REQUIRE(obstacle_batch.get_edge_connectivity() == obstacle_sequential.get_edge_connectivity());
+	REQUIRE(obstacle_batch.get_face_connectivity() == obstacle_sequential.get_face_connectivity());
+}
+
+TEST_CASE("read_many_geometries", "[mesh_test]")
+{
+	const std::string mesh_path = POLYFEM_DATA_DIR + std::string("/contact/meshes/2D/simple/circle/circle36.obj");
+	const int n_bodies = 8, n_obstacles = 4;
+
+	json args = R"(
+		{
+			"materials": {"type": "LinearElasticity", "E": 100, "nu": 0.3},
+			"geometry": []
+		})"_json;
+	for (int k = 0; k < n_bodies; ++k)
+	{
+		json entry = {{"mesh", mesh_path}, {"volume_selection", k + 1}};
+		entry["transformation"]["translation"] = {3 * k, 0};
+		args["geometry"].push_back(entry);
+	}
+	for (int k = 0; k < n_obstacles; ++k)
+	{
+		json entry = {{"mesh", mesh_path}, {"is_obstacle", true}};
+		entry["transformation"]["translation"] = {3 * k, 5};
+		args["geometry"].push_back(entry);
+	}
+
+	State state;
+	state.init_logger("", spdlog::level::off, false);
+	state.init(args, true);
+	state.load_mesh();
+
+	const auto single = Mesh::create(mesh_path);
+	const int n_v = single->n_vertices(), n_el = single->n_elements();
+	REQUIRE(state.mesh->n_vertices() == n_bodies * n_v);
+	REQUIRE(state.mesh->n_elements() == n_bodies * n_el);
+
+	// the meshes are read concurrently but appended in the order of the entries
+	for (int k = 0; k < n_bodies; ++k)
+	{
+		for (int v = 0; v < n_v; ++v)
+			CHECK((state.mesh->point(k * n_v + v) - single->point(v)).norm() == Approx(3 * k));
+		for (int e = 0; e < n_el; ++e)
+			CHECK(state.mesh->get_body_id(k * n_el + e) == k + 1);
+	}
+
+	REQUIRE(state.obstacle.n_vertices() % n_obstacles == 0);
+	const int n_obstacle_v = state.obstacle.n_vertices() / n_obstacles;
+	for (int k = 0; k < n_obstacles; ++k)
+		CHECK(state.obstacle.v()(k * n_obstacle_v, 0) - state.obstacle.v()(0, 0) == Approx(3 * k));
+
+	// the error of the first invalid entry is reported
+	args["geometry"][2]["mesh"] = "missing_2.obj";
+	args["geometry"][5]["mesh"] = "missing_5.obj";
+	State invalid;
+	invalid.init_logger("", spdlog::level::off, false);
+	invalid.init(args, true);
+	CHECK_THROWS_WITH(invalid.load_mesh(), Catch::Contains("missing_2"));
+}
+
+TEST_CASE("point_locator", "[mesh_test]")
+{
+	//Used to init geogram
+	State state;
+
+	// unit square split in two triangles
+	Eigen::MatrixXd V(4, 2);
+	V << 0, 0, 1, 0, 1, 1, 0, 1;
+	Eigen::MatrixXi F(2, 3);
+	F << 0, 1, 2, 0, 2, 3;
+	const auto mesh = Mesh::create(V, F);
+
+	const PointLocator locator(*mesh);
+
+	Eigen::MatrixXd coords;
+	RowVectorNd p(2);
+	p << 0.75, 0.25;
+	CHECK(locator.locate(p, coords) == 0);
+	CHECK(coords.sum() == Approx(1));
+	p << 0.25, 0.75;
+	CHECK(locator.locate(p, coords) == 1);
+	p << 1.5, 0.5;
+	CHECK(locator.locate(p, coords) == -1);
+
+	Eigen::MatrixXd points(4, 2);
+	points << 0.75, 0.25, 0.25, 0.75, 2, 2, 0.5, 0.5;
+	Eigen::VectorXi elements;
+	locator.locate(points, elements, coords);
+	CHECK(elements(0) == 0);
+	CHECK(elements(1) == 1);
+	CHECK(elements(2) == -1);
+	// on the shared edge, the first element wins
+	CHECK(elements(3) == 0);
+	REQUIRE(coords.rows() == 4);
+	for (const int i : {0, 1, 3})
+		CHECK(coords.row(i).sum() == Approx(1));
+}
+
+TEST_CASE("point_grid", "[mesh_test]")
+{
+	for (const int dim : {2, 3})
+	{
+		srand(42);
+		Eigen::MatrixXd points = Eigen::MatrixXd::Random(500, dim);
+		// duplicates are resolved by the smallest index
+		points.row(300) = points.row(10);
+
+		for (const double cell_size : {0.05, 1e-6, 10.})
+		{
+			const PointGrid grid(points, cell_size);
+			CHECK(grid.n_points() == points.rows());
+			CHECK(grid.n_cells() <= 4 * points.rows() + 1);
+
+			Eigen::MatrixXd queries = 1.5 * Eigen::MatrixXd::Random(200, dim);
+			queries.row(0) = points.row(300);
+			for (int q = 0; q < queries.rows(); ++q)
+			{
+				const RowVectorNd p = queries.row(q);
+				int expected = 0;
+				(points.rowwise() - p).rowwise().squaredNorm().minCoeff(&expected);
+				REQUIRE(grid.nearest(p) == expected);
+			}
+		}
+	}
+
+	CHECK(PointGrid(Eigen::MatrixXd(0, 2), 1).nearest(RowVectorNd::Zero(2)) == -1);
+}
+
+TEST_CASE("navigation_tables", "[mesh_test]")
+{
+	//Used to init geogram
+	State state;
+
+	const int n = 3;
+	const auto vid = [n](const int i, const int j, const int k) { return i + (n + 1) * (j + (n + 1) * k); };
+
+	// n x n quads and n x n x n hexes
+	Eigen::MatrixXd V2((n + 1) * (n + 1), 2), V3((n + 1) * (n + 1) * (n + 1), 3);
+	Eigen::MatrixXi F2(n * n, 4), F3(n * n * n, 8);
+	for (int k = 0; k <= n; ++k)
+		for (int j = 0; j <= n; ++j)
+			for (int i = 0; i <= n; ++i)
+			{
+				V3.row(vid(i, j, k)) << i, j, k;
+				if (k == 0)
+					V2.row(vid(i, j, 0)) << i, j;
+				if (i < n && j < n && k == 0)
+					F2.row(i + n * j) << vid(i, j, 0), vid(i + 1, j, 0), vid(i + 1, j + 1, 0), vid(i, j + 1, 0);
+				if (i < n && j < n && k < n)
+					F3.row(i + n * (j + n * k)) << vid(i, j, k), vid(i + 1, j, k), vid(i + 1, j + 1, k), vid(i, j + 1, k),
+						vid(i, j, k + 1), vid(i + 1, j, k + 1), vid(i + 1, j + 1, k + 1), vid(i, j + 1, k + 1);
+			}
+
+	srand(42);
+	SECTION("2D")
+	{
+		const auto search = Mesh::create(V2, F2);
+		const auto table = Mesh::create(V2, F2);
+		table->set_use_navigation_tables(true);
+		table->prepare_mesh();
+		const Mesh2D &m0 = dynamic_cast<const Mesh2D &>(*search);
+		const Mesh2D &m1 = dynamic_cast<const Mesh2D &>(*table);
+
+		for (int f = 0; f < m0.n_faces(); ++f)
+		{
+			for (int lv = 0; lv < 4; ++lv)
+			{
+				Navigation::Index idx = m0.get_index_from_face(f, lv);
+				for (int step = 0; step < 50 && idx.face >= 0; ++step)
+				{
+					const int op = rand() % 3;
+					const Navigation::Index a = op == 0 ? m0.switch_vertex(idx) : (op == 1 ? m0.switch_edge(idx) : m0.switch_face(idx));
+					const Navigation::Index b = op == 0 ? m1.switch_vertex(idx) : (op == 1 ? m1.switch_edge(idx) : m1.switch_face(idx));
+					REQUIRE(a.vertex == b.vertex);
+					REQUIRE(a.edge == b.edge);
+					REQUIRE(a.face == b.face);
+					REQUIRE(a.face_corner == b.face_corner);
+					idx = a;
+				}
+			}
+		}
+	}
+
+	SECTION("3D")
+	{
+		const auto search = Mesh::create(V3, F3);
+		const auto table = Mesh::create(V3, F3);
+		table->set_use_navigation_tables(true);
+		table->prepare_mesh();
+		const Mesh3D &m0 = dynamic_cast<const Mesh3D &>(*search);
+		const Mesh3D &m1 = dynamic_cast<const Mesh3D &>(*table);
+
+		for (int c = 0; c < m0.n_cells(); ++c)
+		{
+			for (int lf = 0; lf < 6; ++lf)
+			{
+				Navigation3D::Index idx = m0.get_index_from_element(c, lf, 0);
+				for (int step = 0; step < 50 && idx.element >= 0; ++step)
+				{
+					const int op = rand() % 4;
+					const auto apply = [&](const Mesh3D &m) {
+						if (op == 0)
+							return m.switch_vertex(idx);
+						if (op == 1)
+							return m.switch_edge(idx);
+						if (op == 2)
+							return m.switch_face(idx);
+						return m.switch_element(idx);
+					};
+					const Navigation3D::Index a = apply(m0);
+					const Navigation3D::Index b = apply(m1);
+					REQUIRE(a.vertex == b.vertex);
+					REQUIRE(a.edge == b.edge);
+					REQUIRE(a.face == b.face);
+					REQUIRE(a.face_corner == b.face_corner);
+					REQUIRE(a.element == b.element);
+					REQUIRE(a.element_patch == b.element_patch);
+					idx = a;
+				}
+			}
+		}
+	}
+}
+
+TEST_CASE("mesh_cache", "[mesh_test]")
+{
+	//Used to init geogram
+	State state;
+
+	const std::string mesh_path = POLYFEM_DATA_DIR + std::string("/contact/meshes/2D/arch/largeArch.01.obj");
+	const std::string directory = (std::filesystem::temp_directory_path() / "polyfem_mesh_cache").string();
+	std::filesystem::remove_all(directory);
+
+	auto mesh = Mesh::create(mesh_path);
+	REQUIRE(MeshCache::is_cacheable(*mesh));
+
+	RowVectorNd min, max;
+	mesh->bounding_box(min, max);
+	mesh->compute_boundary_ids([&](const RowVectorNd &p, bool is_boundary) {
+		return is_boundary ? (p(0) < (min(0) + max(0)) / 2 ? 1 : 2) : -1;
+	});
+	mesh->set_body_ids(std::vector<int>(mesh->n_elements(), 3));
+
+	const json options = R"({"n_refs": 0})"_json;
+	const std::string key = MeshCache::key(mesh_path, options);
+	CHECK(key != MeshCache::key(mesh_path, R"({"n_refs": 1})"_json));
+
+	const MeshCache cache(directory);
+	CHECK(cache.load(key) == nullptr);
+	REQUIRE(cache.save(key, *mesh));
+
+	const auto cached = cache.load(key);
+	REQUIRE(cached != nullptr);
+	REQUIRE(cached->n_vertices() == mesh->n_vertices());
+	REQUIRE(cached->n_elements() == mesh->n_elements());
+	REQUIRE(cached->n_edges() == mesh->n_edges());
+	for (int v = 0; v < mesh->n_vertices(); ++v)
+		CHECK(cached->point(v) == mesh->point(v));
+	for (int e = 0; e < mesh->n_elements(); ++e)
+		CHECK(cached->get_body_id(e) == 3);
+
+	// the boundary ids follow the edges, whatever their order
+	for (int e = 0; e < cached->n_edges(); ++e)
+	{
+		const int v0 = cached->edge_vertex(e, 0), v1 = cached->edge_vertex(e, 1);
+		for (int f = 0; f < mesh->n_edges(); ++f)
+		{
+			const int w0 = mesh->edge_vertex(f, 0), w1 = mesh->edge_vertex(f, 1);
+			if (std::min(v0, v1) == std::min(w0, w1) && std::max(v0, v1) == std::max(w0, w1))
+			{
+				CHECK(cached->get_boundary_id(e) == mesh->get_boundary_id(f));
+				break;
+			}
+		}
+	}
+
+	std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("frame_sequence", "[mesh_test]")
+{
+	// frame i moves every vertex by i along x
+	Eigen::MatrixXd V(3, 2);
+	V << 0, 0, 1, 0, 0, 1;
+	const int n_frames = 50;
+	const double fps = 10;
+	std::atomic<int> n_reads{0};
+	const FrameSequence::Loader loader = [&](const int frame) {
+		++n_reads;
+		Eigen::MatrixXd res = V;
+		res.col(0).array() += frame;
+		return res;
+	};
+
+	FrameSequence sequence(loader, n_frames, fps, loader(0));
+	for (double t = 0; t < 6; t += 0.037)
+	{
+		const Eigen::MatrixXd disp = sequence.displacement(t);
+		const double expected = std::min(t * fps, n_frames - 1.);
+		CHECK(disp.col(0).array().isApprox(Eigen::ArrayXd::Constant(3, expected)));
+		CHECK(disp.col(1).norm() == 0);
+		// the two bracketing frames and the prefetched one
+		CHECK(sequence.n_loaded() <= 3);
+	}
+	// every frame is read once
+	CHECK(n_reads == n_frames);
+
+	Obstacle obstacle;
+	Eigen::MatrixXi faces(1, 3);
+	faces << 0, 1, 2;
+	obstacle.append_mesh_sequence(loader, n_frames, Eigen::VectorXi(), Eigen::MatrixXi(), faces, fps);
+	REQUIRE(obstacle.n_vertices() == 3);
+
+	Eigen::MatrixXd sol = Eigen::MatrixXd::Zero(obstacle.ndof(), 1);
+	for (const double t : {0.0, 0.25, 1.0, 2.55, 100.0})
+	{
+		obstacle.update_displacement(t, sol);
+		const double expected = std::min(t * fps, n_frames - 1.);
+		for (int i = 0; i < 3; ++i)
+		{
+			CHECK(sol(i * 2) == Approx(expected));
+			CHECK(sol(i * 2 + 1) == Approx(0).margin(1e-12));
+		}
+	}
+}
@@ -6,6 +6,7 @@
 #include <polyfem/solver/forms/BodyForm.hpp>
 #include <polyfem/solver/forms/ContactForm.hpp>
 #include <polyfem/solver/forms/ElasticForm.hpp>
+#include <polyfem/solver/forms/ElementSweep.hpp>
 #include <polyfem/solver/forms/FrictionForm.hpp>
 #include <polyfem/solver/forms/InertiaForm.hpp>
 #include <polyfem/solver/forms/LaggedRegForm.hpp>
@@ -20,6 +21,7 @@
 #include <catch2/catch.hpp>
 #include <iostream>
 #include <memory>
+#include <numeric>
 ////////////////////////////////////////////////////////////////////////////////
 
 using namespace polyfem;
@@ -191,6 +193,68 @@ TEST_CASE("contact form derivatives", "[form][form_derivatives][contact_form]")
 	test_form(form, *state_ptr);
 }
 
+TEST_CASE("contact form plane derivatives", "[form][form_derivatives][contact_form]")
+{
+	const auto state_ptr = get_state();
+	const ipc::CollisionMesh &collision_mesh = state_ptr->collision_mesh;
+
+	const double dhat = 1e-3;
+	const bool use_convergent_formulation = GENERATE(true, false);
+
+	ContactForm form(
+		collision_mesh, dhat, state_ptr->avg_mass,
+		use_convergent_formulation, /*use_adaptive_barrier_stiffness=*/false,
+		/*is_time_dependent=*/true, ipc::BroadPhaseMethod::HASH_GRID,
+		/*ccd_tolerance=*/1e-6, /*ccd_max_iterations=*/static_cast<int>(1e6));
+
+	// the lowest vertex is at half dhat above the plane
+	const double y_min = collision_mesh.vertices_at_rest().col(1).minCoeff();
+	std::vector<int> plane_vertices(collision_mesh.num_vertices());
+	std::iota(plane_vertices.begin(), plane_vertices.end(), 0);
+	form.set_planes({mesh::Obstacle::Plane(Eigen::Vector2d(0, y_min - dhat / 2), Eigen::Vector2d(0, 1))}, plane_vertices);
+
+	Eigen::VectorXd x = Eigen::VectorXd::Zero(state_ptr->n_bases * 2);
+	form.init(x);
+	CHECK(form.value(x) > 0);
+
+	for (int rand = 0; rand < 5; ++rand)
+	{
+		Eigen::VectorXd grad;
+		form.first_derivative(x, grad);
+		Eigen::VectorXd fgrad;
+		fd::finite_gradient(
+			x, [&form](const Eigen::VectorXd &x) -> double { return form.value(x); }, fgrad);
+		CHECK(fd::compare_gradient(grad, fgrad));
+
+		StiffnessMatrix hess;
+		form.second_derivative(x, hess);
+		Eigen::MatrixXd fhess;
+		fd::finite_jacobian(
+			x,
+			[&form](const Eigen::VectorXd &x) -> Eigen::VectorXd {
+				Eigen::VectorXd grad;
+				form.first_derivative(x, grad);
+				return grad;
+			},
+			fhess);
+		CHECK(fd::compare_hessian(hess, fhess));
+
+		x.setRandom();
+		x *= dhat / 10;
+	}
+
+	// moving everything down by dhat crosses the plane half way
+	x.setZero();
+	Eigen::VectorXd x1 = x;
+	for (int i = 1; i < x1.size(); i += 2)
+		x1(i) = -dhat;
+	CHECK(!form.is_step_collision_free(x, x1));
+	const double max_step = form.max_step_size(x, x1);
+	CHECK(max_step > 0);
+	CHECK(max_step < 0.5);
+	CHECK(std::isfinite(form.value(x + max_step * (x1 - x))));
+}
+
 TEST_CASE("elastic form derivatives", "[form][form_derivatives][elastic_form]")
 {
 	const auto state_ptr = get_state();
@@ -205,6 +269,42 @@ TEST_CASE("elastic form derivatives", "[form][form_derivatives][elastic_form]")
 	test_form(form, *state_ptr);
 }
 
+TEST_CASE("elastic form step validity", "[form][elastic_form]")
+{
+	const auto state_ptr = get_state();
+	ElasticForm form(
+		state_ptr->n_bases,
+		state_ptr->bases,
+		state_ptr->geom_bases(),
+		*state_ptr->assembler,
+		state_ptr->ass_vals_cache,
+		state_ptr->args["time"]["dt"],
+		state_ptr->mesh->is_volume());
+
+	const Eigen::VectorXd x0 = Eigen::VectorXd::Zero(state_ptr->n_bases * 2);
+	form.init(x0);
+
+	// mirrors the mesh along x, every element is inverted
+	Eigen::VectorXd x1 = x0;
+	for (const auto &b : state_ptr->bases)
+		for (const auto &basis : b.bases)
+			for (const auto &g : basis.global())
+				x1[g.index * 2] = -2 * g.node(0);
+
+	CHECK(form.is_step_valid(x0, x0));
+	CHECK(!form.is_step_valid(x0, x1));
+
+	// the validity reuses the energy evaluated at the same point
+	CHECK(std::isfinite(form.value(x0)));
+	CHECK(form.is_step_valid(x0, x0));
+	CHECK(!std::isfinite(form.value(x1)));
+	CHECK(!form.is_step_valid(x0, x1));
+
+	Eigen::VectorXd grad;
+	form.first_derivative(x1, grad);
+	CHECK(grad.array().isNaN().any());
+}
+
 TEST_CASE("friction form derivatives", "[form][form_derivatives][friction_form]")
 {
 	const auto state_ptr = get_state();
@@ -252,6 +352,87 @@ TEST_CASE("damping form derivatives", "[form][form_derivatives][damping_form]")
 	test_form(form, *state_ptr);
 }
 
+TEST_CASE("damping history cache", "[form][damping_form]")
+{
+	const auto state_ptr = get_state();
+	const double dt = 1e-2;
+	const int ndof = state_ptr->n_bases * 2;
+
+	const auto make_form = [&](assembler::ViscousDamping &damping_assembler) {
+		state_ptr->set_materials(damping_assembler);
+		return std::make_shared<ElasticForm>(
+			state_ptr->n_bases, state_ptr->bases, state_ptr->geom_bases(), damping_assembler,
+			state_ptr->ass_vals_cache, dt, state_ptr->mesh->is_volume());
+	};
+
+	assembler::ViscousDamping damping_assembler;
+	const auto form = make_form(damping_assembler);
+
+	const Eigen::VectorXd x = Eigen::VectorXd::Random(ndof);
+	for (int step = 0; step < 3; ++step)
+	{
+		// the cached previous deformation gradients follow the previous solution of every step
+		const Eigen::VectorXd x_prev = Eigen::VectorXd::Random(ndof);
+		form->update_quantities(step * dt, x_prev);
+
+		assembler::ViscousDamping fresh_assembler;
+		const auto fresh_form = make_form(fresh_assembler);
+		fresh_form->update_quantities(step * dt, x_prev);
+
+		for (int it = 0; it < 2; ++it)
+		{
+			CHECK(form->value(x) == Approx(fresh_form->value(x)).epsilon(1e-12));
+
+			Eigen::VectorXd grad, fresh_grad;
+			form->first_derivative(x, grad);
+			fresh_form->first_derivative(x, fresh_grad);
+			CHECK((grad - fresh_grad).norm() <= 1e-12 * (1 + fresh_grad.norm()));
+		}
+	}
+}
+
+TEST_CASE("element sweep", "[form][elastic_form][damping_form]")
+{
+	const auto state_ptr = get_state();
+	const double dt = 1e-2;
+	const int ndof = state_ptr->n_bases * 2;
+
+	assembler::ViscousDamping damping_assembler;
+	state_ptr->set_materials(damping_assembler);
+
+	const auto elastic_form = std::make_shared<ElasticForm>(
+		state_ptr->n_bases, state_ptr->bases, state_ptr->geom_bases(), *state_ptr->assembler,
+		state_ptr->ass_vals_cache, dt, state_ptr->mesh->is_volume());
+	const auto damping_form = std::make_shared<ElasticForm>(
+		state_ptr->n_bases, state_ptr->bases, state_ptr->geom_bases(), damping_assembler,
+		state_ptr->ass_vals_cache, dt, state_ptr->mesh->is_volume());
+	elastic_form->set_weight(0.5);
+	damping_form->set_weight(2);
+	damping_form->update_quantities(0, 1e-2 * Eigen::VectorXd::Random(ndof));
+
+	ElementSweep sweep;
+	REQUIRE(sweep.add(elastic_form));
+	REQUIRE(sweep.add(damping_form));
+	CHECK(sweep.contains(damping_form.get()));
+	CHECK(sweep.is_active());
+
+	// the single element loop matches the sum of the separate loops
+	const Eigen::VectorXd x = 1e-2 * Eigen::VectorXd::Random(ndof);
+	const double expected_value = elastic_form->value(x) + damping_form->value(x);
+	CHECK(sweep.value(x) == Approx(expected_value).epsilon(1e-12));
+
+	Eigen::VectorXd grad, elastic_grad, damping_grad;
+	sweep.first_derivative(x, grad);
+	elastic_form->first_derivative(x, elastic_grad);
+	damping_form->first_derivative(x, damping_grad);
+	const Eigen::VectorXd expected_grad = elastic_grad + damping_grad;
+	CHECK((grad - expected_grad).norm() <= 1e-12 * (1 + expected_grad.norm()));
+
+	// with a single enabled form the forms are evaluated on their own
+	damping_form->disable();
+	CHECK(!sweep.is_active());
+}
+
 TEST_CASE("inertia form derivatives", "[form][form_derivatives][inertia_form]")
 {
 	const auto state_ptr = get_state();
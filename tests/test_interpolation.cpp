@@ -72,3 +72,46 @@ TEST_CASE("piecewise cubic interpolation", "[interpolation]")
 		CHECK(interp->eval(points[i]) == Approx(values[i]));
 	}
 }
+
+TEST_CASE("piecewise linear interpolation lookup", "[interpolation]")
+{
+	// non uniform samples, some pieces much shorter than the average
+	std::vector<double> points(1000), values(points.size());
+	for (int i = 0; i < points.size(); ++i)
+	{
+		points[i] = i + (i % 7 == 0 ? 0.9 : 0.0) + 0.001 * i * i;
+		values[i] = std::sin(0.1 * i);
+	}
+
+	json params = {
+		{"type", "piecewise_linear"},
+		{"points", points},
+		{"values", values},
+		{"extend", "constant"}};
+	const std::shared_ptr<Interpolation> interp = Interpolation::build(params);
+
+	for (int k = 0; k <= 10000; ++k)
+	{
+		const double t = points.front() - 1 + k * (points.back() - points.front() + 2) / 10000;
+
+		double expected;
+		if (t < points.front())
+			expected = values.front();
+		else if (t >= points.back())
+			expected = values.back();
+		else
+		{
+			int i = 0;
+			while (!(t >= points[i] && t < points[i + 1]))
+				++i;
+			const double alpha = (t - points[i]) / (points[i + 1] - points[i]);
+			expected = (values[i + 1] - values[i]) * alpha + values[i];
+		}
+
+		CAPTURE(t);
+		CHECK(interp->eval(t) == Approx(expected).margin(1e-12));
+	}
+
+	for (int i = 0; i < points.size(); ++i)
+		CHECK(interp->eval(points[i]) == Approx(values[i]).margin(1e-12));
+}
@@ -1,8 +1,10 @@
 ////////////////////////////////////////////////////////////////////////////////
 #include <polyfem/utils/MatrixUtils.hpp>
+#include <polyfem/utils/BlockSparseMatrix.hpp>
 #include <polyfem/autogen/auto_eigs.hpp>
 #include <polyfem/utils/AutodiffTypes.hpp>
 
+#include <array>
 #include <iostream>
 #include <cmath>
 
@@ -197,6 +199,38 @@ TEST_CASE("eigs3idautodiff", "[matrix]")
 	}
 }
 
+TEST_CASE("compensated_sum", "[matrix]")
+{
+	Eigen::VectorXd x(4);
+	x << 1e16, 1, 1, -1e16;
+	CHECK(utils::compensated_sum(x) == 2);
+
+	CHECK(utils::compensated_sum(Eigen::VectorXd()) == 0);
+}
+
+TEST_CASE("parallel_vector_kernels", "[matrix]")
+{
+	// several blocks and a partial last one
+	const int n = GENERATE(10, 100000);
+	const Eigen::VectorXd x = Eigen::VectorXd::Random(n);
+	const Eigen::VectorXd z = Eigen::VectorXd::Random(n);
+	Eigen::VectorXd y = Eigen::VectorXd::Random(n);
+
+	CHECK(utils::parallel_dot(x, y) == Approx(x.dot(y)).margin(1e-10));
+
+	Eigen::VectorXd expected = y + 0.5 * x;
+	utils::parallel_axpy(0.5, x, y);
+	CHECK((y - expected).norm() == Approx(0).margin(1e-12));
+
+	expected = y - 2 * x;
+	const double yz = utils::parallel_axpy_dot(-2, x, y, z);
+	CHECK((y - expected).norm() == Approx(0).margin(1e-12));
+	CHECK(yz == Approx(expected.dot(z)).margin(1e-10));
+
+	// the blocks are reduced in order, the result does not depend on the scheduling
+	CHECK(utils::parallel_dot(x, z) == utils::parallel_dot(x, z));
+}
+
 TEST_CASE("cache", "[matrix]")
 {
 	SparseMatrixCache cache(10);
@@ -245,3 +279,283 @@ TEST_CASE("cache", "[matrix]")
 	REQUIRE(tmp2.coeff(9, 4) == 6);
 	REQUIRE(tmp2.coeff(9, 9) == 4);
 }
+
+TEST_CASE("cache_element_colors", "[matrix]")
+{
+	// elements 0 and 1 share dof 1, element 2 is disjoint from both
+	const std::vector<std::vector<int>> element_dofs = {{0, 1}, {1, 2}, {3, 4}};
+
+	SparseMatrixCache cache(5);
+	for (int e = 0; e < element_dofs.size(); ++e)
+		for (const int i : element_dofs[e])
+			for (const int j : element_dofs[e])
+				cache.add_value(e, i, j, 1);
+
+	const StiffnessMatrix expected = cache.get_matrix();
+
+	const auto &colors = cache.element_colors();
+	REQUIRE(colors.size() == 2);
+
+	std::vector<int> element_color(element_dofs.size(), -1);
+	for (int c = 0; c < colors.size(); ++c)
+		for (const int e : colors[c])
+			element_color[e] = c;
+	REQUIRE(element_color[0] != element_color[1]);
+	REQUIRE(element_color[2] >= 0);
+
+	for (const auto &color : colors)
+	{
+		for (const int e : color)
+		{
+			int index = 0;
+			for (const int i : element_dofs[e])
+				for (const int j : element_dofs[e])
+					cache.add_element_value(e, index++, 1);
+		}
+	}
+
+	const StiffnessMatrix actual = cache.get_matrix();
+	REQUIRE((actual - expected).norm() == Approx(0).margin(1e-12));
+}
+
+TEST_CASE("cache_reuse", "[matrix]")
+{
+	// random elements with repeated dofs, the mapped assemblies must match the triplet one
+	const int n = 40;
+	std::vector<std::vector<int>> element_dofs(30);
+	for (auto &dofs : element_dofs)
+		for (int k = 0; k < 4; ++k)
+			dofs.push_back(rand() % n);
+
+	const auto assemble = [&](SparseMatrixCache &cache, const double value) {
+		for (int e = 0; e < element_dofs.size(); ++e)
+			for (const int i : element_dofs[e])
+				for (const int j : element_dofs[e])
+					cache.add_value(e, i, j, value);
+		return cache.get_matrix();
+	};
+
+	SparseMatrixCache cache(n);
+	const StiffnessMatrix expected = assemble(cache, 1);
+
+	for (int k = 0; k < 2; ++k)
+		REQUIRE((assemble(cache, 1) - expected).norm() == Approx(0).margin(1e-12));
+
+	SparseMatrixCache copy(cache);
+	REQUIRE((assemble(copy, 2) - 2 * expected).norm() == Approx(0).margin(1e-12));
+
+	// the values are swapped into the output, two buffers alternate between the cache and the output
+	StiffnessMatrix out;
+	std::vector<const double *> buffers;
+	for (int k = 0; k < 3; ++k)
+	{
+		// the assemblers init the cache before every assembly
+		cache.init(n);
+		for (int e = 0; e < element_dofs.size(); ++e)
+			for (const int i : element_dofs[e])
+				for (const int j : element_dofs[e])
+					cache.add_value(e, i, j, 1);
+		cache.get_matrix(out);
+		REQUIRE((out - expected).norm() == Approx(0).margin(1e-12));
+		buffers.push_back(out.valuePtr());
+	}
+	REQUIRE(buffers[0] != buffers[1]);
+	REQUIRE(buffers[0] == buffers[2]);
+}
+
+TEST_CASE("sparse_matrix_accumulator", "[matrix]")
+{
+	const int n = 50;
+	const std::vector<int> removed_vars = {0, 3, 17, 49};
+
+	const auto random_sparse = [n](const int n_entries) {
+		std::vector<Eigen::Triplet<double>> entries;
+		for (int k = 0; k < n_entries; ++k)
+			entries.emplace_back(rand() % n, rand() % n, double(rand()) / RAND_MAX);
+		StiffnessMatrix m(n, n);
+		m.setFromTriplets(entries.begin(), entries.end());
+		m.makeCompressed();
+		return m;
+	};
+
+	// one accumulator per reduced size, each keeps its own pattern
+	const std::array<int, 2> reduced_sizes = {n, n - int(removed_vars.size())};
+	std::array<SparseMatrixAccumulator, 2> accumulators;
+	std::vector<StiffnessMatrix> mats = {random_sparse(200), random_sparse(100), random_sparse(10)};
+
+	for (int iter = 0; iter < 4; ++iter)
+	{
+		// a new pattern for the last summand, like a changing contact set
+		if (iter == 2)
+			mats.back() = random_sparse(30);
+		// same patterns, new values
+		for (StiffnessMatrix &m : mats)
+			for (int k = 0; k < m.nonZeros(); ++k)
+				m.valuePtr()[k] = double(rand()) / RAND_MAX;
+
+		StiffnessMatrix full(n, n);
+		for (const StiffnessMatrix &m : mats)
+			full += m;
+
+		for (size_t r = 0; r < reduced_sizes.size(); ++r)
+		{
+			const int reduced_size = reduced_sizes[r];
+			SparseMatrixAccumulator &accumulator = accumulators[r];
+			const int n_rebuilds = accumulator.n_rebuilds();
+
+			StiffnessMatrix expected, res;
+			full_to_reduced_matrix(n, reduced_size, removed_vars, full, expected);
+			accumulator.sum(mats, n, reduced_size, removed_vars, res);
+
+			REQUIRE(res.rows() == reduced_size);
+			REQUIRE(res.cols() == reduced_size);
+			REQUIRE((Eigen::MatrixXd(res) - Eigen::MatrixXd(expected)).norm() == Approx(0).margin(1e-12));
+
+			// scaled summands reuse the same pattern
+			const std::vector<double> scales = {2.0, 1.0, -0.5};
+			StiffnessMatrix scaled_full = 2.0 * mats[0] + mats[1] - 0.5 * mats[2];
+			full_to_reduced_matrix(n, reduced_size, removed_vars, scaled_full, expected);
+			accumulator.sum({&mats[0], &mats[1], &mats[2]}, scales, n, reduced_size, removed_vars, res);
+			REQUIRE((Eigen::MatrixXd(res) - Eigen::MatrixXd(expected)).norm() == Approx(0).margin(1e-12));
+
+			// the pattern is only rebuilt when it is first seen or changes
+			if (iter == 0 || iter == 2)
+				CHECK(accumulator.n_rebuilds() == n_rebuilds + 1);
+			else
+				CHECK(accumulator.n_rebuilds() == n_rebuilds);
+		}
+	}
+}
+
+TEST_CASE("dirichlet_in_place", "[matrix]")
+{
+	const int n = 30;
+
+	// symmetric positive definite matrix with a stored diagonal
+	std::vector<Eigen::Triplet<double>> entries;
+	for (int k = 0; k < 60; ++k)
+	{
+		const int i = rand() % n, j = rand() % n;
+		const double v = double(rand()) / RAND_MAX;
+		entries.emplace_back(i, j, v);
+		entries.emplace_back(j, i, v);
+	}
+	for (int i = 0; i < n; ++i)
+		entries.emplace_back(i, i, 5);
+	StiffnessMatrix A(n, n);
+	A.setFromTriplets(entries.begin(), entries.end());
+	A.makeCompressed();
+
+	const Eigen::VectorXd rhs = Eigen::VectorXd::Random(n);
+
+	for (const std::vector<int> &dirichlet_vars : {std::vector<int>{0, 3, 4, 17, 29}, std::vector<int>{1, 2, 10}})
+	{
+		Eigen::VectorXd b = rhs;
+		for (const int i : dirichlet_vars)
+			b(i) = i + 1;
+
+		StiffnessMatrix A_bc = A;
+		apply_dirichlet_in_place(A_bc, dirichlet_vars);
+		Eigen::VectorXd b_bc = b;
+		lift_dirichlet_rhs(A, dirichlet_vars, b_bc);
+
+		// only the values change
+		REQUIRE(A_bc.nonZeros() == A.nonZeros());
+		REQUIRE(sparse_pattern_hash(A_bc) == sparse_pattern_hash(A));
+		REQUIRE((Eigen::MatrixXd(A_bc) - Eigen::MatrixXd(A_bc).transpose()).norm() == 0);
+
+		const Eigen::VectorXd x = Eigen::MatrixXd(A_bc).ldlt().solve(b_bc);
+
+		// reference: reduced system of the free variables
+		const int reduced_size = n - dirichlet_vars.size();
+		StiffnessMatrix reduced;
+		full_to_reduced_matrix(n, reduced_size, dirichlet_vars, A, reduced);
+		Eigen::VectorXd x_dirichlet = Eigen::VectorXd::Zero(n);
+		for (const int i : dirichlet_vars)
+			x_dirichlet(i) = b(i);
+		const Eigen::VectorXd r = b - A * x_dirichlet;
+		Eigen::VectorXd b_reduced(reduced_size);
+		for (int i = 0, k = 0, j = 0; i < n; ++i)
+		{
+			if (k < dirichlet_vars.size() && dirichlet_vars[k] == i)
+				++k;
+			else
+				b_reduced(j++) = r(i);
+		}
+		const Eigen::VectorXd x_reduced = Eigen::MatrixXd(reduced).ldlt().solve(b_reduced);
+
+		for (int i = 0, k = 0, j = 0; i < n; ++i)
+		{
+			if (k < dirichlet_vars.size() && dirichlet_vars[k] == i)
+			{
+				REQUIRE(x(i) == Approx(b(i)).margin(1e-12));
+				++k;
+			}
+			else
+				REQUIRE(x(i) == Approx(x_reduced(j++)).margin(1e-10));
+		}
+	}
+}
+
+TEST_CASE("block_sparse_matrix", "[matrix]")
+{
+	for (const int block_size : {1, 2, 3})
+	{
+		const int n = 20 * block_size;
+
+		std::vector<Eigen::Triplet<double>> entries;
+		for (int k = 0; k < 150; ++k)
+			entries.emplace_back(rand() % n, rand() % n, double(rand()) / RAND_MAX);
+		StiffnessMatrix A(n, n);
+		A.setFromTriplets(entries.begin(), entries.end());
+
+		BlockSparseMatrix B;
+		B.init(block_size, A);
+
+		REQUIRE(B.rows() == n);
+		REQUIRE((Eigen::MatrixXd(B.to_csr()) - Eigen::MatrixXd(A)).norm() == Approx(0).margin(1e-12));
+
+		const Eigen::VectorXd x = Eigen::VectorXd::Random(n);
+		Eigen::VectorXd y;
+		B.multiply(x, y);
+		REQUIRE((y - A * x).norm() == Approx(0).margin(1e-12));
+
+		// every non-zero is in a stored block, and blocks are found where they are stored
+		for (int k = 0; k < A.outerSize(); ++k)
+			for (StiffnessMatrix::InnerIterator it(A, k); it; ++it)
+				REQUIRE(B.find(it.row() / block_size, it.col() / block_size) >= 0);
+		for (int bi = 0; bi < B.n_block_rows(); ++bi)
+			for (int k = B.outer_index()[bi]; k < B.outer_index()[bi + 1]; ++k)
+				REQUIRE(B.find(bi, B.inner_index()[k]) == k);
+	}
+}
+
+TEST_CASE("map_sparse_matrix", "[matrix]")
+{
+	const int n = 30, n_full = 50;
+
+	std::vector<Eigen::Triplet<double>> entries;
+	for (int k = 0; k < 200; ++k)
+		entries.emplace_back(rand() % n, rand() % n, double(rand()) / RAND_MAX);
+	StiffnessMatrix A(n, n);
+	A.setFromTriplets(entries.begin(), entries.end());
+
+	// selection and interpolation maps
+	for (const int n_per_col : {1, 3})
+	{
+		std::vector<Eigen::Triplet<double>> map_entries;
+		for (int i = 0; i < n; ++i)
+			for (int k = 0; k < n_per_col; ++k)
+				map_entries.emplace_back((i * 7 + k * 11) % n_full, i, n_per_col == 1 ? 1 : double(rand()) / RAND_MAX);
+		StiffnessMatrix map(n_full, n);
+		map.setFromTriplets(map_entries.begin(), map_entries.end());
+
+		StiffnessMatrix out;
+		utils::map_sparse_matrix(A, map, out);
+
+		const StiffnessMatrix expected = map * A * map.transpose();
+		REQUIRE(out.rows() == n_full);
+		REQUIRE(out.cols() == n_full);
+		REQUIRE((Eigen::MatrixXd(out) - Eigen::MatrixXd(expected)).norm() == Approx(0).margin(1e-12));
+	}
+}
@@ -1,5 +1,6 @@
 ////////////////////////////////////////////////////////////////////////////////
 #include <polyfem/State.hpp>
+#include <polyfem/assembler/ElementAssemblyValues.hpp>
 
 #include <polyfem/mesh/mesh2D/NCMesh2D.hpp>
 #include <polyfem/mesh/mesh3D/NCMesh3D.hpp>
@@ -7,6 +8,8 @@
 #include <polyfem/autogen/auto_p_bases.hpp>
 #include <polyfem/autogen/auto_q_bases.hpp>
 
+#include <polyfem/refinement/APosteriori.hpp>
+
 #include <iostream>
 #include <fstream>
 #include <cmath>
@@ -188,3 +191,254 @@ TEST_CASE("ncmesh3d", "[ncmesh]")
 	REQUIRE(fabs(state.stats.h1_semi_err) < 1e-7);
 	REQUIRE(fabs(state.stats.l2_err) < 1e-8);
 }
+
+TEST_CASE("ncmesh3d_adapt", "[ncmesh]")
+{
+	const std::string path = POLYFEM_DATA_DIR;
+	json in_args = R"(
+		{
+			"materials": {"type": "Laplacian"},
+
+			"geometry": [{
+				"mesh": "",
+				"enabled": true,
+				"type": "mesh",
+				"surface_selection": 7
+			}],
+
+			"space":{
+				"discr_order": 2,
+				"advanced": {
+					"isoparametric": false,
+					"bc_method": "sample"
+				}
+			},
+
+			"boundary_conditions": {
+				"dirichlet_boundary": [{
+					"id": "all",
+					"value": "x^2+y^2+z^2"
+				}],
+				"rhs": 6
+			},
+
+			"output": {
+				"reference": {
+					"solution": "x^2+y^2+z^2",
+					"gradient": ["2*x","2*y","2*z"]
+				}
+			},
+
+			"solver": {
+				"linear": {
+					"solver": "Eigen::SimplicialLDLT"
+				}
+			}
+		}
+	)"_json;
+	in_args["geometry"][0]["mesh"] = path + "/contact/meshes/3D/simple/bar/bar-186.msh";
+
+	State state;
+	state.init_logger("", spdlog::level::off, false);
+	state.init(in_args, true);
+
+	state.load_mesh(true);
+	state.build_basis();
+
+	const auto f = [](const RowVectorNd &p) { return p.squaredNorm(); };
+
+	// the quadratic function is in the space, its interpolation is transferred exactly
+	Eigen::MatrixXd sol = Eigen::MatrixXd::Zero(state.n_bases, 1);
+	for (const auto &bs : state.bases)
+		for (const auto &b : bs.bases)
+			if (b.global().size() == 1)
+				sol(b.global()[0].index) = f(b.global()[0].node);
+
+	const auto check = [&]() {
+		REQUIRE(sol.rows() == state.n_bases);
+		for (const auto &bs : state.bases)
+			for (const auto &b : bs.bases)
+				if (b.global().size() == 1)
+					REQUIRE(sol(b.global()[0].index) == Approx(f(b.global()[0].node)).margin(1e-10));
+
+		// the reused entries of the cache match a fresh one
+		AssemblyValsCache cache;
+		cache.init(true, state.bases, state.geom_bases());
+		for (int e = 0; e < state.bases.size(); ++e)
+		{
+			ElementAssemblyValues expected, vals;
+			cache.compute(e, true, state.bases[e], state.geom_bases()[e], expected);
+			state.ass_vals_cache.compute(e, true, state.bases[e], state.geom_bases()[e], vals);
+
+			REQUIRE(vals.basis_values.size() == expected.basis_values.size());
+			REQUIRE((vals.det - expected.det).norm() < 1e-12);
+			for (int j = 0; j < vals.basis_values.size(); ++j)
+			{
+				REQUIRE((vals.basis_values[j].grad_t_m - expected.basis_values[j].grad_t_m).norm() < 1e-12);
+				REQUIRE(vals.basis_values[j].global.size() == expected.basis_values[j].global.size());
+				for (int k = 0; k < vals.basis_values[j].global.size(); ++k)
+				{
+					REQUIRE(vals.basis_values[j].global[k].index == expected.basis_values[j].global[k].index);
+					REQUIRE(vals.basis_values[j].global[k].val == expected.basis_values[j].global[k].val);
+				}
+			}
+		}
+	};
+
+	NCMesh3D &ncmesh = *dynamic_cast<NCMesh3D *>(state.mesh.get());
+
+	std::vector<int> ref_ids(ncmesh.n_cells() / 3);
+	for (int i = 0; i < ref_ids.size(); i++)
+		ref_ids[i] = 3 * i;
+	state.adapt_mesh(ref_ids, {}, sol);
+	check();
+
+	std::vector<int> coarsen_ids;
+	for (int e = 0; e < ncmesh.n_cells() && coarsen_ids.size() < 8; e++)
+		if (ncmesh.cell_ref_level(e) > 0)
+			coarsen_ids.push_back(e);
+	state.adapt_mesh({1}, coarsen_ids, sol);
+	check();
+
+	state.assemble_rhs();
+	state.assemble_mass_mat();
+
+	Eigen::MatrixXd pressure;
+	state.solve_problem(sol, pressure);
+	state.compute_errors(sol);
+
+	REQUIRE(fabs(state.stats.h1_semi_err) < 1e-7);
+	REQUIRE(fabs(state.stats.l2_err) < 1e-8);
+}
+
+TEST_CASE("ncmesh2d_a_posteriori", "[ncmesh]")
+{
+	const std::string path = POLYFEM_DATA_DIR;
+	json in_args = R"(
+		{
+			"materials": {"type": "Laplacian"},
+
+			"geometry": [{
+				"mesh": "",
+				"enabled": true,
+				"type": "mesh",
+				"surface_selection": 7
+			}],
+
+			"space":{
+				"discr_order": 1
+			},
+
+			"boundary_conditions": {
+				"dirichlet_boundary": [{
+					"id": "all",
+					"value": "exp(-20*((x-0.2)^2+y^2))"
+				}],
+				"rhs": "exp(-20*((x-0.2)^2+y^2))*(1600*((x-0.2)^2+y^2)-80)"
+			}
+		})"_json;
+	in_args["geometry"][0]["mesh"] = path + "/contact/meshes/2D/simple/circle/circle36.obj";
+
+	State state;
+	state.init_logger("", spdlog::level::off, false);
+	state.init(in_args, true);
+	state.load_mesh(true);
+	state.build_basis();
+
+	// the gradient of a linear function is recovered exactly
+	Eigen::MatrixXd sol = Eigen::MatrixXd::Zero(state.n_bases, 1);
+	for (const auto &bs : state.bases)
+		for (const auto &b : bs.bases)
+			sol(b.global()[0].index) = b.global()[0].node(0) + 2 * b.global()[0].node(1);
+
+	Eigen::VectorXd errors;
+	refinement::APosteriori::zz_estimate(*state.mesh, 1, state.bases, state.geom_bases(), *state.assembler, sol, errors);
+	REQUIRE(errors.size() == state.mesh->n_elements());
+	REQUIRE(errors.maxCoeff() < 1e-10);
+
+	errors.setConstant(1);
+	errors[3] = 10;
+	const std::vector<int> marked = refinement::APosteriori::mark(errors, 0.5);
+	REQUIRE(marked.size() == 1);
+	REQUIRE(marked[0] == 3);
+
+	// refining where the estimate is large reduces it
+	const int n_elements = state.mesh->n_elements();
+	Eigen::MatrixXd pressure;
+	state.solve_adaptive(0, 0, 0.5, sol, pressure, errors);
+	const double initial_error = errors.norm();
+
+	state.solve_adaptive(0, 3, 0.5, sol, pressure, errors);
+	REQUIRE(state.mesh->n_elements() > n_elements);
+	REQUIRE(errors.size() == state.mesh->n_elements());
+	REQUIRE(errors.norm() < initial_error);
+}
+
+TEST_CASE("ncmesh2d_prolongated_assembly", "[ncmesh]")
+{
+	const std::string path = POLYFEM_DATA_DIR;
+	json in_args = R"(
+		{
+			"materials": {"type": "Laplacian"},
+
+			"geometry": [{
+				"mesh": "",
+				"enabled": true,
+				"type": "mesh"
+			}],
+
+			"space":{
+				"discr_order": 2
+			}
+		})"_json;
+	in_args["geometry"][0]["mesh"] = path + "/contact/meshes/2D/simple/circle/circle36.obj";
+
+	State state;
+	state.init_logger("", spdlog::level::off, false);
+	state.init(in_args, true);
+
+	state.load_mesh(true);
+	NCMesh2D &ncmesh = *dynamic_cast<NCMesh2D *>(state.mesh.get());
+	for (int n = 0; n < 2; n++)
+	{
+		ncmesh.prepare_mesh();
+		std::vector<int> ref_ids(ncmesh.n_faces() / 2);
+		for (int i = 0; i < ref_ids.size(); i++)
+			ref_ids[i] = 2 * i;
+
+		ncmesh.refine_elements(ref_ids);
+	}
+	ncmesh.prepare_mesh();
+	state.build_basis();
+
+	// the hanging nodes are combinations of global nodes
+	bool has_hanging_nodes = false;
+	for (const ElementBases &bs : state.bases)
+		for (const Basis &b : bs.bases)
+			has_hanging_nodes = has_hanging_nodes || b.global().size() > 1;
+	REQUIRE(has_hanging_nodes);
+
+	StiffnessMatrix stiffness;
+	state.assembler->assemble(false, state.n_bases, state.bases, state.geom_bases(), state.ass_vals_cache, stiffness);
+	REQUIRE(stiffness.rows() == state.n_bases);
+	REQUIRE(stiffness.cols() == state.n_bases);
+
+	// the constant functions are in the kernel
+	CHECK((stiffness * Eigen::VectorXd::Ones(state.n_bases)).norm() < 1e-10);
+	CHECK((stiffness - StiffnessMatrix(stiffness.transpose())).norm() < 1e-12);
+
+	// u^T K u is the Dirichlet energy of the constrained function
+	const Eigen::VectorXd u = Eigen::VectorXd::Random(state.n_bases);
+	double energy = 0;
+	for (int e = 0; e < state.bases.size(); ++e)
+	{
+		ElementAssemblyValues vals;
+		vals.compute(e, false, state.bases[e], state.geom_bases()[e]);
+		Eigen::MatrixXd grad = Eigen::MatrixXd::Zero(vals.quadrature.weights.size(), 2);
+		for (const AssemblyValues &v : vals.basis_values)
+			for (const Local2Global &g : v.global)
+				grad += g.val * u(g.index) * v.grad_t_m;
+		energy += (vals.det.array() * vals.quadrature.weights.array() * grad.rowwise().squaredNorm().array()).sum();
+	}
+	CHECK(u.dot(stiffness * u) == Approx(energy).epsilon(1e-10));
+}
@@ -4,9 +4,35 @@
 #include <polyfem/State.hpp>
 #include <polyfem/Common.hpp>
 #include <polyfem/utils/JSONUtils.hpp>
+#include <polyfem/io/Evaluator.hpp>
+#include <polyfem/io/OutputFilter.hpp>
+#include <polyfem/io/OutputQueue.hpp>
+#include <polyfem/io/StreamOutput.hpp>
+#include <polyfem/io/VTKHDFWriter.hpp>
+#include <polyfem/io/MshReader.hpp>
+#include <polyfem/io/MshWriter.hpp>
+#include <polyfem/io/OBJReader.hpp>
+#include <polyfem/io/MatrixIO.hpp>
+#include <polyfem/mesh/Mesh.hpp>
+#include <polyfem/utils/ExpressionValue.hpp>
+
+#include <hdf5.h>
+#include <highfive/H5File.hpp>
 
 #include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <atomic>
 #include <iostream>
+#include <thread>
+#include <cstring>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
 ////////////////////////////////////////////////////////////////////////////////
 
 using namespace polyfem;
@@ -81,3 +107,802 @@ TEST_CASE("full sim", "[.][full_sim]")
 
 	std::filesystem::remove_all(outdir);
 }
+
+TEST_CASE("output queue", "[output]")
+{
+	const int n_threads = GENERATE(1, 3);
+
+	std::atomic<int> done = 0;
+	{
+		io::OutputQueue queue(n_threads, 2);
+		for (int i = 0; i < 20; ++i)
+		{
+			queue.push([&done]() { ++done; });
+			CHECK(queue.pending() <= 2 + n_threads);
+		}
+		queue.flush();
+		CHECK(done == 20);
+		CHECK(queue.pending() == 0);
+
+		// a failed task is reported once, the next ones still run
+		queue.push([]() { throw std::runtime_error("write failed"); });
+		CHECK_THROWS_AS(queue.flush(), std::runtime_error);
+		queue.push([&done]() { ++done; });
+		queue.flush();
+		CHECK(done == 21);
+
+		// the destructor waits for the pending tasks
+		for (int i = 0; i < 10; ++i)
+			queue.push([&done]() { ++done; });
+	}
+	CHECK(done == 31);
+}
+
+TEST_CASE("output filter", "[output]")
+{
+	io::OutputFilter filter;
+
+	const Eigen::MatrixXd V = Eigen::MatrixXd::Random(10, 3);
+	const Eigen::MatrixXi F = Eigen::MatrixXi::Random(5, 3);
+	const uint64_t fingerprint = io::OutputFilter::fingerprint(F, io::OutputFilter::fingerprint(V));
+	CHECK(fingerprint == io::OutputFilter::fingerprint(F, io::OutputFilter::fingerprint(V)));
+	CHECK(fingerprint != io::OutputFilter::fingerprint(V, io::OutputFilter::fingerprint(F)));
+
+	// an unchanged content is written once and referenced afterwards
+	CHECK(filter.path("mesh").empty());
+	CHECK(filter.changed("mesh", fingerprint, "mesh_1.msh"));
+	CHECK(!filter.changed("mesh", fingerprint, "mesh_2.msh"));
+	CHECK(filter.path("mesh") == "mesh_1.msh");
+	CHECK(filter.n_skipped() == 1);
+
+	Eigen::MatrixXd V2 = V;
+	V2(3, 1) += 1e-10;
+	CHECK(filter.changed("mesh", io::OutputFilter::fingerprint(V2), "mesh_3.msh"));
+	CHECK(filter.path("mesh") == "mesh_3.msh");
+
+	// frequency and tolerance
+	const Eigen::VectorXd u = Eigen::VectorXd::Ones(4);
+	CHECK(filter.due("u", 1, u, 1, 0.1));
+	CHECK(!filter.due("u", 1, u, 2, 0.1));
+	CHECK(filter.changed("u", u, "u_1.txt"));
+	CHECK(!filter.due("u", 2, 1.01 * u, 1, 0.1));
+	CHECK(filter.due("u", 2, 1.01 * u, 1, 0));
+	CHECK(filter.due("u", 2, 1.5 * u, 1, 0.1));
+	CHECK(!filter.changed("u", u, "u_2.txt"));
+	CHECK(filter.path("u") == "u_1.txt");
+
+	filter.clear();
+	CHECK(filter.path("u").empty());
+	CHECK(filter.n_skipped() == 0);
+}
+
+TEST_CASE("solution frame store", "[output]")
+{
+	const std::string spill_path = (std::filesystem::temp_directory_path() / "polyfem_frames.bin").string();
+
+	std::vector<io::SolutionFrame> frames;
+	const Eigen::MatrixXd points = Eigen::MatrixXd::Random(100, 3);
+	const Eigen::MatrixXi connectivity = Eigen::MatrixXi::Random(50, 4);
+	for (int t = 0; t < 20; ++t)
+	{
+		io::SolutionFrame frame;
+		frame.name = fmt::format("step_{}.vtu", t);
+		frame.points = points;
+		frame.connectivity = connectivity;
+		frame.solution = 0.01 * t * points;
+		frame.pressure = Eigen::MatrixXd::Constant(100, 1, t);
+		frames.push_back(frame);
+	}
+
+	// lossless with a budget small enough to spill most of the frames
+	{
+		io::SolutionFrameStore store(4096, spill_path, /*use_float=*/false, /*keyframe_interval=*/4);
+		for (const auto &frame : frames)
+			store.push(frame);
+		REQUIRE(store.size() == frames.size());
+		CHECK(store.memory_usage() <= 4096);
+		CHECK(store.spilled_size() > 0);
+		CHECK(std::filesystem::exists(spill_path));
+
+		for (const int i : {5, 19, 0, 7, 8, 3, 13})
+		{
+			const io::SolutionFrame frame = store.get(i);
+			CHECK(frame.name == frames[i].name);
+			CHECK(frame.points == frames[i].points);
+			CHECK(frame.connectivity == frames[i].connectivity);
+			CHECK(frame.solution == frames[i].solution);
+			CHECK(frame.pressure == frames[i].pressure);
+			CHECK(frame.exact.size() == 0);
+		}
+		CHECK_THROWS(store.get(20));
+	}
+	CHECK(!std::filesystem::exists(spill_path));
+
+	// single precision, the unchanged fields are only stored in the keyframes
+	{
+		io::SolutionFrameStore store(0, "", /*use_float=*/true, /*keyframe_interval=*/16);
+		for (const auto &frame : frames)
+			store.push(frame);
+		const size_t raw_size = frames.size() * ((2 * points.size() + 100) * sizeof(double) + connectivity.size() * sizeof(int));
+		CHECK(store.memory_usage() < raw_size / 3);
+
+		for (const int i : {19, 2, 17})
+		{
+			const io::SolutionFrame frame = store.get(i);
+			CHECK(frame.connectivity == frames[i].connectivity);
+			CHECK((frame.solution - frames[i].solution).lpNorm<Eigen::Infinity>() <= 1e-6 * frames[i].solution.lpNorm<Eigen::Infinity>());
+		}
+	}
+}
+
+TEST_CASE("msh round trip", "[output]")
+{
+	const bool binary = GENERATE(false, true);
+	const std::string path = (std::filesystem::temp_directory_path() / "polyfem_round_trip.msh").string();
+
+	// two tets sharing a face
+	Eigen::MatrixXd points(5, 3);
+	points << 0, 0, 0,
+		1, 0, 0,
+		0, 1, 0,
+		0, 0, 1,
+		1, 1, 1;
+	Eigen::MatrixXi cells(2, 4);
+	cells << 0, 1, 2, 3,
+		1, 2, 3, 4;
+
+	io::MshWriter::write(path, points, cells, {}, /*is_volume=*/true, binary);
+
+	Eigen::MatrixXd vertices;
+	Eigen::MatrixXi read_cells;
+	std::vector<std::vector<int>> elements;
+	std::vector<std::vector<double>> weights;
+	std::vector<int> body_ids;
+	REQUIRE(io::MshReader::load(path, vertices, read_cells, elements, weights, body_ids));
+
+	CHECK(vertices == points);
+	CHECK(read_cells == cells);
+	REQUIRE(elements.size() == 2);
+	CHECK(elements[1] == std::vector<int>({1, 2, 3, 4}));
+	CHECK(body_ids.size() == 2);
+
+	std::filesystem::remove(path);
+}
+
+TEST_CASE("hdf5 input datasets", "[output]")
+{
+	const std::string path = (std::filesystem::temp_directory_path() / "polyfem_input.hdf5").string();
+
+	// two triangles and a value per element, the rows are contiguous in the file
+	const std::vector<double> points = {0, 0, 1, 0, 0, 1, 1, 1};
+	const std::vector<int> triangles = {0, 1, 2, 1, 3, 2};
+	const std::vector<double> E = {1e5, 2e5};
+	{
+		HighFive::File file(path, HighFive::File::Overwrite);
+		file.createDataSet<double>("/meshes/square/v", HighFive::DataSpace({4, 2})).write_raw(points.data());
+		file.createDataSet<int>("/meshes/square/c", HighFive::DataSpace({2, 3})).write_raw(triangles.data());
+		file.createDataSet<double>("/materials/E", HighFive::DataSpace({2})).write_raw(E.data());
+	}
+
+	std::string file, dataset;
+	REQUIRE(io::split_hdf5_dataset_path(path + ":/materials/E", file, dataset));
+	CHECK(file == path);
+	CHECK(dataset == "/materials/E");
+	CHECK(!io::split_hdf5_dataset_path(path, file, dataset));
+
+	Eigen::MatrixXd vertices;
+	REQUIRE(io::read_matrix(path + ":/meshes/square/v", vertices));
+	REQUIRE(vertices.rows() == 4);
+	REQUIRE(vertices.cols() == 2);
+	CHECK(vertices(3, 0) == 1);
+	CHECK(vertices(2, 0) == 0);
+	CHECK(vertices(2, 1) == 1);
+	CHECK(!io::read_matrix(path + ":/meshes/missing", vertices));
+
+	const std::unique_ptr<mesh::Mesh> mesh = mesh::Mesh::create(path + ":/meshes/square");
+	REQUIRE(mesh != nullptr);
+	CHECK(mesh->n_vertices() == 4);
+	CHECK(mesh->n_elements() == 2);
+
+	// per-element parameters are read from their dataset
+	ExpressionValue value;
+	value.init(path + ":/materials/E");
+	CHECK(value(0, 0, 0, 0, 1) == 2e5);
+
+	std::filesystem::remove(path);
+}
+
+TEST_CASE("binary matrices", "[output]")
+{
+	const std::filesystem::path dir = std::filesystem::temp_directory_path();
+	const Eigen::MatrixXd dense = Eigen::MatrixXd::Random(50, 3);
+	const StiffnessMatrix sparse = Eigen::MatrixXd::Random(40, 30).sparseView(0.5, 1);
+
+	for (const std::string extension : {".bin", ".binz"})
+	{
+		const std::string path = (dir / ("polyfem_dense" + extension)).string();
+		REQUIRE(io::write_matrix(path, dense));
+		Eigen::MatrixXd read;
+		REQUIRE(io::read_matrix(path, read));
+		CHECK(read == dense);
+
+		// the scalar type is in the header
+		Eigen::MatrixXi read_int;
+		REQUIRE(io::read_matrix(path, read_int));
+		CHECK(read_int == dense.cast<int>());
+
+		// initial conditions
+		json import = json::object();
+		import["offset"] = 20;
+		Eigen::MatrixXd initial = Eigen::MatrixXd::Zero(30, 1);
+		REQUIRE(io::import_matrix(path, import, initial));
+		CHECK(initial.topRows(20) == dense.block(0, 0, 20, 1));
+
+		const std::string sparse_path = (dir / ("polyfem_sparse" + extension)).string();
+		REQUIRE(io::write_sparse_matrix(sparse_path, sparse));
+		StiffnessMatrix read_sparse;
+		REQUIRE(io::read_sparse_matrix_binary(sparse_path, read_sparse));
+		CHECK(read_sparse.nonZeros() == sparse.nonZeros());
+		CHECK((read_sparse - sparse).norm() == 0);
+		// not a dense matrix
+		CHECK(!io::read_matrix(sparse_path, read));
+
+		std::filesystem::remove(path);
+		std::filesystem::remove(sparse_path);
+	}
+
+	// compressed constant matrix
+	const std::string path = (dir / "polyfem_constant.binz").string();
+	REQUIRE(io::write_matrix(path, Eigen::MatrixXd::Ones(1000, 3).eval()));
+	CHECK(std::filesystem::file_size(path) < 1000 * 3 * sizeof(double) / 10);
+	Eigen::MatrixXd read;
+	REQUIRE(io::read_matrix(path, read));
+	CHECK(read == Eigen::MatrixXd::Ones(1000, 3));
+	std::filesystem::remove(path);
+
+	// files without header
+	const std::string legacy_path = (dir / "polyfem_legacy.bin").string();
+	{
+		std::ofstream out(legacy_path, std::ios::binary);
+		const Eigen::Index rows = dense.rows(), cols = dense.cols();
+		out.write(reinterpret_cast<const char *>(&rows), sizeof(rows));
+		out.write(reinterpret_cast<const char *>(&cols), sizeof(cols));
+		out.write(reinterpret_cast<const char *>(dense.data()), dense.size() * sizeof(double));
+	}
+	REQUIRE(io::read_matrix(legacy_path, read));
+	CHECK(read == dense);
+	std::filesystem::remove(legacy_path);
+}
+
+TEST_CASE("obj reader", "[output]")
+{
+	const std::string path = (std::filesystem::temp_directory_path() / "polyfem_reader.obj").string();
+
+	// large enough to be split in several chunks
+	const int n = 100000;
+	{
+		std::ofstream file(path);
+		file << "# comment\nmtllib mat.mtl\n";
+		for (int i = 0; i < n; ++i)
+			file << "v " << i << " " << 0.5 * i << " -1e-3\n";
+		file << "vn 0 0 1\n";
+		for (int i = 0; i < n - 2; ++i)
+			file << "f " << i + 1 << "/1/1 " << i + 2 << "//1 -1\n";
+		file << "l 1 2 -1\n";
+	}
+
+	Eigen::MatrixXd V;
+	Eigen::MatrixXi E, F;
+	REQUIRE(io::OBJReader::read(path, V, E, F));
+
+	REQUIRE(V.rows() == n);
+	REQUIRE(V.cols() == 3);
+	CHECK(V(n - 1, 0) == n - 1);
+	CHECK(V(n - 1, 1) == 0.5 * (n - 1));
+	CHECK(V(n / 2, 2) == -1e-3);
+
+	REQUIRE(F.rows() == n - 2);
+	REQUIRE(F.cols() == 3);
+	CHECK(F.row(n / 2) == Eigen::RowVector3i(n / 2, n / 2 + 1, n - 1));
+
+	REQUIRE(E.rows() == 2);
+	CHECK(E.row(0) == Eigen::RowVector2i(0, 1));
+	CHECK(E.row(1) == Eigen::RowVector2i(1, n - 1));
+
+	// faces of different degrees
+	{
+		std::ofstream file(path);
+		file << "v 0 0 0\nv 1 0 0\nv 0 1 0\nv 1 1 0\nf 1 2 3\nf 1 2 4 3\n";
+	}
+	CHECK(!io::OBJReader::read(path, V, E, F));
+
+	std::filesystem::remove(path);
+}
+
+TEST_CASE("solution frame buffers", "[output]")
+{
+	io::SolutionFrame frame;
+	frame.points = Eigen::MatrixXd::Random(10, 3);
+	frame.connectivity = Eigen::MatrixXi::Random(4, 3);
+	frame.solution = Eigen::MatrixXd::Random(10, 2);
+
+	const auto buffers = frame.buffers();
+	REQUIRE(buffers.size() == 3);
+
+	CHECK(buffers[0].first == "points");
+	const io::BufferView &points = buffers[0].second;
+	CHECK(points.data == frame.points.data());
+	CHECK(points.format == "d");
+	CHECK(points.itemsize == sizeof(double));
+	CHECK(points.shape[0] == 10);
+	CHECK(points.shape[1] == 3);
+	// column major
+	CHECK(points.strides[0] == sizeof(double));
+	CHECK(points.strides[1] == 10 * sizeof(double));
+	const double *data = static_cast<const double *>(points.data);
+	CHECK(data[(2 * points.strides[0] + 1 * points.strides[1]) / sizeof(double)] == frame.points(2, 1));
+
+	CHECK(buffers[1].first == "connectivity");
+	CHECK(buffers[1].second.format == "i");
+	CHECK(buffers[1].second.data == frame.connectivity.data());
+	CHECK(buffers[2].first == "solution");
+
+	const Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> row_major(4, 5);
+	const io::BufferView view = io::BufferView::of(row_major);
+	CHECK(view.format == "f");
+	CHECK(view.strides[0] == 5 * sizeof(float));
+	CHECK(view.strides[1] == sizeof(float));
+}
+
+namespace
+{
+	std::vector<hsize_t> hdf5_dims(const hid_t file, const std::string &name)
+	{
+		const hid_t dataset = H5Dopen2(file, name.c_str(), H5P_DEFAULT);
+		REQUIRE(dataset >= 0);
+		const hid_t space = H5Dget_space(dataset);
+		std::vector<hsize_t> dims(H5Sget_simple_extent_ndims(space));
+		H5Sget_simple_extent_dims(space, dims.data(), nullptr);
+		H5Sclose(space);
+		H5Dclose(dataset);
+		return dims;
+	}
+
+	std::vector<int64_t> hdf5_read_int(const hid_t file, const std::string &name)
+	{
+		const hid_t dataset = H5Dopen2(file, name.c_str(), H5P_DEFAULT);
+		REQUIRE(dataset >= 0);
+		std::vector<int64_t> values(hdf5_dims(file, name)[0]);
+		H5Dread(dataset, H5T_NATIVE_INT64, H5S_ALL, H5S_ALL, H5P_DEFAULT, values.data());
+		H5Dclose(dataset);
+		return values;
+	}
+
+	Eigen::MatrixXd hdf5_read_double(const hid_t file, const std::string &name, const int cols)
+	{
+		const hid_t dataset = H5Dopen2(file, name.c_str(), H5P_DEFAULT);
+		REQUIRE(dataset >= 0);
+		Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> values(hdf5_dims(file, name)[0], cols);
+		H5Dread(dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, values.data());
+		H5Dclose(dataset);
+		return values;
+	}
+
+	bool hdf5_is_float32(const hid_t file, const std::string &name)
+	{
+		const hid_t dataset = H5Dopen2(file, name.c_str(), H5P_DEFAULT);
+		REQUIRE(dataset >= 0);
+		const hid_t type = H5Dget_type(dataset);
+		const bool is_float32 = H5Tget_class(type) == H5T_FLOAT && H5Tget_size(type) == 4;
+		H5Tclose(type);
+		H5Dclose(dataset);
+		return is_float32;
+	}
+} // namespace
+
+TEST_CASE("vtkhdf time series", "[output]")
+{
+	const std::string path = (std::filesystem::temp_directory_path() / "polyfem_series.vtkhdf").string();
+
+	const Eigen::MatrixXd points = Eigen::MatrixXd::Random(10, 2);
+	const Eigen::MatrixXi cells = Eigen::MatrixXi::Random(6, 3).array().abs().unaryExpr([](int i) { return i % 10; });
+	{
+		io::VTKHDFWriter writer(path, /*compression_level=*/4, /*chunk_size=*/8);
+		writer.set_field_options("id", {/*compression_level=*/0, /*float32=*/true});
+		for (int t = 0; t < 3; ++t)
+			writer.write_step(0.1 * t, points, cells, {{"solution", 0.1 * t * points}, {"id", Eigen::VectorXd::Constant(10, t)}});
+
+		// the topology of a high-order mesh changes, the velocity is missing in the previous steps
+		std::vector<std::vector<int>> elements = {{0, 1, 2, 3, 4, 5}, {6, 7}};
+		const Eigen::MatrixXd new_points = Eigen::MatrixXd::Random(8, 2);
+		writer.write_step(0.3, new_points, elements, /*is_simplicial=*/true, {{"solution", new_points}, {"velocity", new_points}});
+		CHECK(writer.n_steps() == 4);
+
+		CHECK_THROWS(writer.write_step(0.4, new_points, elements, true, {{"solution", Eigen::VectorXd::Zero(8)}}));
+	}
+
+	const hid_t file = H5Fopen(path.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+	REQUIRE(file >= 0);
+
+	int64_t n_steps = 0;
+	const hid_t steps = H5Gopen2(file, "VTKHDF/Steps", H5P_DEFAULT);
+	const hid_t attr = H5Aopen(steps, "NSteps", H5P_DEFAULT);
+	H5Aread(attr, H5T_NATIVE_INT64, &n_steps);
+	H5Aclose(attr);
+	H5Gclose(steps);
+	CHECK(n_steps == 4);
+
+	// two topologies
+	CHECK(hdf5_read_int(file, "VTKHDF/NumberOfPoints") == std::vector<int64_t>{10, 8});
+	CHECK(hdf5_read_int(file, "VTKHDF/NumberOfCells") == std::vector<int64_t>{6, 2});
+	CHECK(hdf5_read_int(file, "VTKHDF/Offsets") == std::vector<int64_t>{0, 3, 6, 9, 12, 15, 18, 0, 6, 8});
+	CHECK(hdf5_dims(file, "VTKHDF/Points") == std::vector<hsize_t>{18, 3});
+	CHECK(hdf5_read_int(file, "VTKHDF/Steps/PartOffsets") == std::vector<int64_t>{0, 0, 0, 1});
+	CHECK(hdf5_read_int(file, "VTKHDF/Steps/PointOffsets") == std::vector<int64_t>{0, 0, 0, 10});
+	CHECK(hdf5_dims(file, "VTKHDF/Steps/CellOffsets") == std::vector<hsize_t>{4, 1});
+
+	// fields are appended per step
+	CHECK(hdf5_dims(file, "VTKHDF/PointData/solution") == std::vector<hsize_t>{38, 2});
+	CHECK(hdf5_dims(file, "VTKHDF/PointData/id") == std::vector<hsize_t>{38});
+	CHECK(hdf5_dims(file, "VTKHDF/PointData/velocity") == std::vector<hsize_t>{8, 2});
+	CHECK(hdf5_read_int(file, "VTKHDF/Steps/PointDataOffsets/solution") == std::vector<int64_t>{0, 10, 20, 30});
+	CHECK(hdf5_read_int(file, "VTKHDF/Steps/PointDataOffsets/velocity") == std::vector<int64_t>{0, 0, 0, 0});
+
+	// the chunks compressed by the writer, some of them written over several steps, read back
+	const Eigen::MatrixXd solution = hdf5_read_double(file, "VTKHDF/PointData/solution", 2);
+	for (int t = 0; t < 3; ++t)
+		CHECK(solution.middleRows(10 * t, 10).isApprox(0.1 * t * points));
+	CHECK(solution.bottomRows(8).isApprox(hdf5_read_double(file, "VTKHDF/PointData/velocity", 2)));
+	CHECK(hdf5_read_double(file, "VTKHDF/Points", 3).topRows(10).leftCols(2) == points);
+
+	CHECK(hdf5_is_float32(file, "VTKHDF/PointData/id"));
+	CHECK(!hdf5_is_float32(file, "VTKHDF/PointData/solution"));
+	CHECK(hdf5_read_double(file, "VTKHDF/PointData/id", 1).middleRows(20, 10).isApproxToConstant(2));
+
+	H5Fclose(file);
+	std::filesystem::remove(path);
+}
+
+TEST_CASE("requested output fields", "[output]")
+{
+	const std::filesystem::path outdir = std::filesystem::temp_directory_path() / "polyfem_fields_test_output";
+	json in_args = R"(
+		{
+			"materials": {"type": "LinearElasticity", "E": 100, "nu": 0.3},
+
+			"geometry": [{
+				"mesh": "",
+				"surface_selection": 7
+			}],
+
+			"boundary_conditions": {
+				"dirichlet_boundary": [{
+					"id": "all",
+					"value": ["0.1 * x", "0"]
+				}]
+			},
+
+			"output": {
+				"paraview": {
+					"file_name": "fields.vtu",
+					"fields": ["solution", "von_mises", "cauchy_stess"]
+				}
+			}
+		})"_json;
+	in_args["geometry"][0]["mesh"] = std::string(POLYFEM_DATA_DIR) + "/contact/meshes/2D/simple/circle/circle36.obj";
+	in_args["/output/directory"_json_pointer] = outdir.string();
+
+	State state;
+	state.init_logger("", spdlog::level::off, false);
+	state.init(in_args, true);
+	state.load_mesh();
+	state.build_basis();
+	state.assemble_rhs();
+	state.assemble_mass_mat();
+
+	Eigen::MatrixXd sol, pressure;
+	state.solve_problem(sol, pressure);
+	state.export_data(sol, pressure);
+
+	std::ifstream file(outdir / "fields.vtu");
+	REQUIRE(file.good());
+	const std::string vtu((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	CHECK(vtu.find("\"solution\"") != std::string::npos);
+	CHECK(vtu.find("\"von_mises\"") != std::string::npos);
+	CHECK(vtu.find("\"cauchy_stess_11\"") != std::string::npos);
+	// not requested, not computed
+	CHECK(vtu.find("\"pk1_stess_11\"") == std::string::npos);
+	CHECK(vtu.find("\"von_mises_avg\"") == std::string::npos);
+	CHECK(vtu.find("\"discr\"") == std::string::npos);
+
+	std::filesystem::remove_all(outdir);
+}
+
+TEST_CASE("probes and reductions", "[output]")
+{
+	const std::filesystem::path outdir = std::filesystem::temp_directory_path() / "polyfem_probes_test_output";
+	json in_args = R"(
+		{
+			"materials": {"type": "LinearElasticity", "E": 100, "nu": 0.3},
+
+			"geometry": [{
+				"mesh": "",
+				"surface_selection": 7
+			}],
+
+			"boundary_conditions": {
+				"dirichlet_boundary": [{
+					"id": "all",
+					"value": ["0.1 * x", "0"]
+				}]
+			},
+
+			"output": {
+				"probes": {
+					"reductions": ["reaction_forces", "energy", "max_von_mises"]
+				}
+			}
+		})"_json;
+	in_args["geometry"][0]["mesh"] = std::string(POLYFEM_DATA_DIR) + "/contact/meshes/2D/simple/circle/circle36.obj";
+	in_args["/output/directory"_json_pointer] = outdir.string();
+
+	State state;
+	state.init_logger("", spdlog::level::off, false);
+	state.init(in_args, true);
+	state.load_mesh();
+
+	// a probe at the barycenter of the first element and one outside of the mesh
+	const RowVectorNd p = state.mesh->face_barycenter(0);
+	state.args["output"]["probes"]["points"] = {{p(0), p(1)}, {1e3, 1e3}};
+
+	state.build_basis();
+	state.assemble_rhs();
+	state.assemble_mass_mat();
+
+	Eigen::MatrixXd sol, pressure;
+	state.solve_problem(sol, pressure);
+	state.export_data(sol, pressure);
+	state.probe_output = nullptr; // closes the file
+
+	std::ifstream file(outdir / "probes.csv");
+	REQUIRE(file.good());
+	std::string header, row;
+	std::getline(file, header);
+	std::getline(file, row);
+
+	const std::vector<std::string> expected = {"time", "probe0_0", "probe0_1", "probe1_0", "probe1_1", "reaction_7_0", "reaction_7_1", "energy"};
+	std::vector<std::string> columns;
+	std::vector<double> values;
+	{
+		std::stringstream hs(header), rs(row);
+		std::string c;
+		while (std::getline(hs, c, ','))
+			columns.push_back(c);
+		while (std::getline(rs, c, ','))
+			values.push_back(std::stod(c));
+	}
+	// a single body
+	REQUIRE(columns.size() == expected.size() + 1);
+	CHECK(std::vector<std::string>(columns.begin(), columns.end() - 1) == expected);
+	CHECK(columns.back().rfind("max_von_mises_", 0) == 0);
+	REQUIRE(values.size() == columns.size());
+
+	// the solution is linear, the probes interpolate it exactly
+	CHECK(values[1] == Approx(0.1 * p(0)).margin(1e-10));
+	CHECK(values[2] == Approx(0).margin(1e-10));
+	CHECK(std::isnan(values[3]));
+	CHECK(std::isnan(values[4]));
+
+	// without body forces the boundary forces are balanced
+	CHECK(values[5] == Approx(0).margin(1e-8));
+	CHECK(values[6] == Approx(0).margin(1e-8));
+
+	// homogeneous strain, the von Mises stress is constant
+	CHECK(values[7] > 0);
+	CHECK(values[8] > 0);
+
+	std::filesystem::remove_all(outdir);
+}
+
+TEST_CASE("shared stress field", "[output]")
+{
+	json in_args = R"(
+		{
+			"materials": {"type": "NeoHookean", "E": 100, "nu": 0.3},
+
+			"geometry": [{
+				"mesh": "",
+				"surface_selection": 7
+			}],
+
+			"boundary_conditions": {
+				"dirichlet_boundary": [{
+					"id": "all",
+					"value": ["0.1 * x", "0.05 * x * y"]
+				}]
+			}
+		})"_json;
+	in_args["geometry"][0]["mesh"] = std::string(POLYFEM_DATA_DIR) + "/contact/meshes/2D/simple/circle/circle36.obj";
+
+	State state;
+	state.init_logger("", spdlog::level::off, false);
+	state.init(in_args, true);
+	state.load_mesh();
+	state.build_basis();
+	state.assemble_rhs();
+	state.assemble_mass_mat();
+
+	Eigen::MatrixXd sol, pressure;
+	state.solve_problem(sol, pressure);
+
+	Eigen::MatrixXd stress, expected_stress;
+	Eigen::VectorXd mises, expected_mises;
+	io::Evaluator::compute_stress_at_quadrature_points(
+		*state.mesh, state.problem->is_scalar(), state.bases, state.geom_bases(), state.disc_orders, *state.assembler,
+		sol, expected_stress, expected_mises);
+
+	// the stress and von Mises outputs of a step share one sweep
+	io::StressField field;
+	for (int i = 0; i < 2; ++i)
+	{
+		io::Evaluator::compute_stress_at_quadrature_points(
+			*state.mesh, state.problem->is_scalar(), state.bases, state.geom_bases(), state.disc_orders, *state.assembler,
+			sol, stress, mises, &field);
+		CHECK(field.n_sweeps() == 1);
+		CHECK(stress == expected_stress);
+		CHECK((mises - expected_mises).norm() <= 1e-12 * (1 + expected_mises.norm()));
+	}
+
+	// a new solution drops the values
+	const Eigen::MatrixXd sol2 = 2 * sol;
+	io::Evaluator::compute_stress_at_quadrature_points(
+		*state.mesh, state.problem->is_scalar(), state.bases, state.geom_bases(), state.disc_orders, *state.assembler,
+		sol2, stress, mises, &field);
+	CHECK(field.n_sweeps() == 2);
+	io::Evaluator::compute_stress_at_quadrature_points(
+		*state.mesh, state.problem->is_scalar(), state.bases, state.geom_bases(), state.disc_orders, *state.assembler,
+		sol2, expected_stress, expected_mises);
+	CHECK(stress == expected_stress);
+	CHECK((mises - expected_mises).norm() <= 1e-12 * (1 + expected_mises.norm()));
+}
+
+#ifndef _WIN32
+TEST_CASE("stream output", "[output]")
+{
+	const auto read_message = [](const int fd, uint32_t &type) {
+		const auto read_all = [fd](char *data, size_t size) {
+			size_t done = 0;
+			while (done < size)
+			{
+				const ssize_t n = recv(fd, data + done, size - done, 0);
+				REQUIRE(n > 0);
+				done += n;
+			}
+		};
+		uint32_t header[2];
+		read_all(reinterpret_cast<char *>(header), sizeof(header));
+		type = header[0];
+		std::vector<char> payload(header[1]);
+		read_all(payload.data(), payload.size());
+		return payload;
+	};
+
+	Eigen::MatrixXd points(2, 3);
+	points << 0, 0, 0, 1, 0.5, 0;
+	Eigen::VectorXd values(3);
+	values << 1.5, -2, 3;
+	Eigen::MatrixXd surface(2, 3);
+	surface << 0.25, 0, 0, 0, 0.5, 0;
+
+	io::StreamOutput stream("127.0.0.1", 0, 16);
+	REQUIRE(stream.port() > 0);
+
+	// the header is published before the client connects, it is replayed to it
+	stream.publish_header({{"columns", {"a", "b", "c"}}}, points);
+
+	const int fd = socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(stream.port());
+	inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+	REQUIRE(connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0);
+
+	// the step waits for the client to be accepted, otherwise it is not sent to it
+	std::this_thread::sleep_for(std::chrono::milliseconds(300));
+	stream.publish_step(4, 0.5, values, surface);
+	stream.publish_stats(json::array({{{"type", "rc"}}}));
+	stream.publish_stats(json::array({{{"type", "rc"}}, {{"type", "al"}}}));
+
+	uint32_t type;
+	std::vector<char> payload = read_message(fd, type);
+	CHECK(type == uint32_t(io::StreamOutput::MessageType::HEADER));
+	CHECK(json::parse(payload.begin(), payload.end())["columns"].size() == 3);
+
+	payload = read_message(fd, type);
+	CHECK(type == uint32_t(io::StreamOutput::MessageType::SURFACE_POINTS));
+	CHECK(payload.size() == 8 + 4 * points.size());
+
+	payload = read_message(fd, type);
+	CHECK(type == uint32_t(io::StreamOutput::MessageType::STEP));
+	CHECK(payload == io::StreamOutput::encode_step(4, 0.5, values, surface));
+	int32_t step;
+	double time;
+	uint32_t n_values;
+	std::memcpy(&step, payload.data(), 4);
+	std::memcpy(&time, payload.data() + 4, 8);
+	std::memcpy(&n_values, payload.data() + 12, 4);
+	CHECK(step == 4);
+	CHECK(time == 0.5);
+	CHECK(n_values == 3);
+
+	// only the new entries of the solver info are sent
+	payload = read_message(fd, type);
+	CHECK(type == uint32_t(io::StreamOutput::MessageType::STATS));
+	CHECK(json::parse(payload.begin(), payload.end()).size() == 1);
+	payload = read_message(fd, type);
+	CHECK(json::parse(payload.begin(), payload.end())[0]["type"] == "al");
+
+	close(fd);
+	CHECK(stream.n_dropped() == 0);
+}
+
+TEST_CASE("stream output overflow", "[output]")
+{
+	using MessageType = io::StreamOutput::MessageType;
+	const auto message = [](const MessageType type) { return io::StreamOutput::encode_message(type, {}); };
+	const auto type_of = [](const std::vector<char> &m) {
+		uint32_t type;
+		std::memcpy(&type, m.data(), sizeof(type));
+		return type;
+	};
+
+	// a full queue drops the oldest step, the header messages stay
+	std::deque<std::vector<char>> queue;
+	CHECK(io::StreamOutput::enqueue(queue, message(MessageType::HEADER), 3) == 0);
+	CHECK(io::StreamOutput::enqueue(queue, message(MessageType::SURFACE_POINTS), 3) == 0);
+	CHECK(io::StreamOutput::enqueue(queue, message(MessageType::STEP), 3) == 0);
+	CHECK(io::StreamOutput::enqueue(queue, message(MessageType::STATS), 3) == 1);
+	REQUIRE(queue.size() == 3);
+	CHECK(type_of(queue[0]) == uint32_t(MessageType::HEADER));
+	CHECK(type_of(queue[1]) == uint32_t(MessageType::SURFACE_POINTS));
+	CHECK(type_of(queue[2]) == uint32_t(MessageType::STATS));
+
+	// with only header messages queued, a step is dropped and a new header is kept
+	queue.pop_back();
+	CHECK(io::StreamOutput::enqueue(queue, message(MessageType::HEADER), 2) == 0);
+	CHECK(io::StreamOutput::enqueue(queue, message(MessageType::STEP), 2) == 1);
+	CHECK(queue.size() == 3);
+
+	// a client connecting after the queue overflowed still receives the header
+	Eigen::MatrixXd points(2, 3);
+	points << 0, 0, 0, 1, 0.5, 0;
+	const Eigen::VectorXd values = Eigen::VectorXd::Ones(3);
+
+	io::StreamOutput stream("127.0.0.1", 0, 2);
+	REQUIRE(stream.port() > 0);
+	stream.publish_header({{"columns", {"a", "b", "c"}}}, points);
+	for (int step = 0; step < 1000000 && stream.n_dropped() == 0; ++step)
+		stream.publish_step(step, step, values, Eigen::MatrixXd());
+	REQUIRE(stream.n_dropped() > 0);
+
+	const int fd = socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(stream.port());
+	inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+	REQUIRE(connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0);
+
+	const auto read_type = [fd]() {
+		uint32_t header[2];
+		REQUIRE(recv(fd, header, sizeof(header), MSG_WAITALL) == sizeof(header));
+		std::vector<char> payload(header[1]);
+		if (!payload.empty())
+			REQUIRE(recv(fd, payload.data(), payload.size(), MSG_WAITALL) == ssize_t(payload.size()));
+		return header[0];
+	};
+	CHECK(read_type() == uint32_t(MessageType::HEADER));
+	CHECK(read_type() == uint32_t(MessageType::SURFACE_POINTS));
+
+	close(fd);
+}
+#endif
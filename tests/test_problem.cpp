@@ -558,4 +558,27 @@ TEST_CASE("elasticity 3d", "[problem]")
 
 		REQUIRE(diff.array().abs().maxCoeff() < 1e-10);
 	}
-}
\ No newline at end of file
+}
+
+TEST_CASE("exact with grad", "[problem]")
+{
+	const std::string name = GENERATE(std::string("Franke"), std::string("Quadratic"), std::string("ElasticExact"));
+	const int dim = GENERATE(2, 3);
+
+	Eigen::MatrixXd pts(50, dim);
+	pts.setRandom();
+
+	const auto &probl = ProblemFactory::factory().get_problem(name);
+
+	Eigen::MatrixXd val, grad, expected_val, expected_grad;
+	probl->exact(pts, 1, expected_val);
+	probl->exact_grad(pts, 1, expected_grad);
+	probl->exact_with_grad(pts, 1, val, grad);
+
+	REQUIRE(val.rows() == expected_val.rows());
+	REQUIRE(val.cols() == expected_val.cols());
+	REQUIRE(grad.rows() == expected_grad.rows());
+	REQUIRE(grad.cols() == expected_grad.cols());
+	CHECK((val - expected_val).norm() <= 1e-12 * (1 + expected_val.norm()));
+	CHECK((grad - expected_grad).norm() <= 1e-12 * (1 + expected_grad.norm()));
+}
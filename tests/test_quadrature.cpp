@@ -1,10 +1,19 @@
 ////////////////////////////////////////////////////////////////////////////////
 #include <polyfem/State.hpp>
+#include <polyfem/quadrature/GaussLobattoQuadrature.hpp>
 #include <polyfem/quadrature/LineQuadrature.hpp>
 #include <polyfem/quadrature/TriQuadrature.hpp>
 #include <polyfem/quadrature/TetQuadrature.hpp>
+#include <polyfem/quadrature/QuadQuadrature.hpp>
+#include <polyfem/quadrature/HexQuadrature.hpp>
+#include <polyfem/quadrature/QuadratureCache.hpp>
+#include <polyfem/quadrature/PolygonQuadrature.hpp>
+#include <polyfem/quadrature/PolytopeQuadratureCache.hpp>
+#include <polyfem/basis/AdaptiveQuadrature.hpp>
+#include <polyfem/autogen/all_bases.hpp>
 #include <iostream>
 #include <cmath>
+#include <limits>
 #include <Eigen/Dense>
 #include <Eigen/Geometry>
 #include <catch2/catch.hpp>
@@ -42,7 +51,8 @@ namespace
 			const std::string &mesh, const int n_refs,
 			const int basis_order,
 			const int quadrature, const int mass_quadrature,
-			const bool spline, const bool serendipity)
+			const bool spline, const bool serendipity,
+			const bool adaptive = false)
 		{
 			const std::string path = POLYFEM_DATA_DIR;
 			json in_args = R"(
@@ -92,6 +102,7 @@ namespace
 			in_args["space"]["discr_order"] = basis_order;
 			in_args["space"]["advanced"]["quadrature_order"] = quadrature;
 			in_args["space"]["advanced"]["mass_quadrature_order"] = mass_quadrature;
+			in_args["space"]["advanced"]["adaptive_quadrature"]["enabled"] = adaptive;
 
 			if (spline)
 				in_args["space"]["basis_type"] = "Spline";
@@ -113,14 +124,15 @@ namespace
 
 		void test_quadrature(const std::string &mesh, const int n_refs,
 							 const int basis_order,
-							 const bool spline, const bool serendipity)
+							 const bool spline, const bool serendipity,
+							 const bool adaptive = false)
 		{
 			const bool is_q = mesh.find("quad") != std::string::npos || mesh.find("hex") != std::string::npos;
 			const int expected_quad = is_q ? 20 : 14;
 			static const double margin = 1e-10;
 			// spdlog::info("Reference quad={}", expected_quad);
 
-			auto state = get_state(mesh, n_refs, basis_order, -1, -1, spline, serendipity);
+			auto state = get_state(mesh, n_refs, basis_order, -1, -1, spline, serendipity, adaptive);
 			auto expected = get_state(mesh, n_refs, basis_order, expected_quad, expected_quad, spline, serendipity);
 			StiffnessMatrix exp_st, st;
 			state->build_stiffness_mat(st);
@@ -203,6 +215,53 @@ TEST_CASE("auto_quadrature", "[quadrature]")
 	}
 }
 
+TEST_CASE("adaptive_quadrature", "[quadrature]")
+{
+	using namespace polyfem::basis;
+	using reference_tables::ReferenceElement;
+
+	const adaptive_quadrature::Params params;
+
+	// undistorted cubes of linear formulations use p+1 points, simplices keep the exact default
+	REQUIRE(adaptive_quadrature::quadrature_order("Laplacian", ReferenceElement::QUAD, 2, 0, true, params) == 3);
+	REQUIRE(adaptive_quadrature::quadrature_order("Mass", ReferenceElement::HEXAHEDRON, 1, 0, true, params) == 2);
+	REQUIRE(adaptive_quadrature::quadrature_order("Laplacian", ReferenceElement::TRIANGLE, 2, 0, true, params) == 2);
+
+	// one more order every time the variation doubles, up to max_increase
+	REQUIRE(adaptive_quadrature::quadrature_order("Laplacian", ReferenceElement::QUAD, 2, 0.05, true, params) == 4);
+	REQUIRE(adaptive_quadrature::quadrature_order("Laplacian", ReferenceElement::QUAD, 2, 0.15, true, params) == 5);
+	REQUIRE(adaptive_quadrature::quadrature_order("Laplacian", ReferenceElement::QUAD, 2, 0.5, true, params) == 6);
+	REQUIRE(adaptive_quadrature::quadrature_order("Laplacian", ReferenceElement::TETRAHEDRON, 2, std::numeric_limits<double>::infinity(), true, params) == 4);
+
+	// nonlinear formulations
+	REQUIRE(adaptive_quadrature::quadrature_order("NeoHookean", ReferenceElement::TRIANGLE, 2, 0, false, params) == 3);
+	REQUIRE(adaptive_quadrature::quadrature_order("NeoHookean", ReferenceElement::QUAD, 1, 0, false, params) == 3);
+
+	// the matrices of the test meshes are still integrated exactly
+	struct data
+	{
+		std::string mesh;
+		int n_refs;
+		int order;
+		bool serendipity;
+	};
+
+	const std::vector<data> tests = {
+		{"tri.obj", 1, 2, false},
+		{"quad.obj", 3, 1, false},
+		{"quad.obj", 2, 2, false},
+		{"quad.obj", 2, 2, true},
+		{"hex.HYBRID", 0, 1, false},
+		{"hex.HYBRID", 0, 2, false},
+	};
+
+	for (const auto &d : tests)
+	{
+		spdlog::info("Running {} Order={}, serendipity={} adaptive", d.mesh, d.order, d.serendipity);
+		test_quadrature(d.mesh, d.n_refs, d.order, false, d.serendipity, true);
+	}
+}
+
 TEST_CASE("weights", "[quadrature]")
 {
 	// Segment
@@ -239,6 +298,132 @@ TEST_CASE("weights", "[quadrature]")
 	}
 }
 
+TEST_CASE("quadrature_cache", "[quadrature]")
+{
+	const auto check = [](const QuadratureCache::Shape shape, const int order, const Quadrature &expected) {
+		const Quadrature &cached = QuadratureCache::get(shape, order);
+		REQUIRE(&cached == &QuadratureCache::get(shape, order));
+		REQUIRE(cached.points == expected.points);
+		REQUIRE(cached.weights == expected.weights);
+	};
+
+	for (int order = 1; order < 16; ++order)
+	{
+		Quadrature quadr;
+
+		LineQuadrature().get_quadrature(order, quadr);
+		check(QuadratureCache::Shape::LINE, order, quadr);
+
+		TriQuadrature().get_quadrature(order, quadr);
+		check(QuadratureCache::Shape::TRIANGLE, order, quadr);
+
+		QuadQuadrature().get_quadrature(order, quadr);
+		check(QuadratureCache::Shape::QUAD, order, quadr);
+
+		TetQuadrature().get_quadrature(order, quadr);
+		check(QuadratureCache::Shape::TETRAHEDRON, order, quadr);
+
+		HexQuadrature().get_quadrature(order, quadr);
+		check(QuadratureCache::Shape::HEXAHEDRON, order, quadr);
+	}
+
+	// rules are built once and shared
+	const int n_rules = QuadratureCache::size();
+	REQUIRE(n_rules >= 5 * 15);
+	QuadratureCache::get(QuadratureCache::Shape::TETRAHEDRON, 4);
+	REQUIRE(QuadratureCache::size() == n_rules);
+}
+
+TEST_CASE("polygon_quadrature_cache", "[quadrature]")
+{
+	Eigen::MatrixXd hexagon(6, 2);
+	for (int i = 0; i < 6; ++i)
+		hexagon.row(i) << std::cos(i * pi / 3), std::sin(i * pi / 3);
+
+	PolytopeQuadratureCache cache;
+	const TranslatedQuadrature first = cache.polygon(hexagon, 3);
+
+	// translated copies share the rule
+	const Eigen::RowVector2d shift(10.5, -3.25);
+	const Eigen::MatrixXd moved = hexagon.rowwise() + shift;
+	const TranslatedQuadrature second = cache.polygon(moved, 3);
+	REQUIRE(first.rule == second.rule);
+	REQUIRE(cache.n_built() == 1);
+	REQUIRE(cache.n_reused() == 1);
+
+	Quadrature expected, quadr;
+	PolygonQuadrature().get_quadrature(moved, 3, expected);
+	second.get(quadr);
+	REQUIRE(quadr.weights.size() == expected.weights.size());
+	REQUIRE((quadr.points - expected.points).cwiseAbs().maxCoeff() < 1e-12);
+	REQUIRE((quadr.weights - expected.weights).cwiseAbs().maxCoeff() < 1e-12);
+
+	// other orders and shapes get their own rule
+	cache.polygon(moved, 5);
+	const Eigen::MatrixXd scaled = 2 * hexagon;
+	const TranslatedQuadrature third = cache.polygon(scaled, 3);
+	REQUIRE(third.rule != first.rule);
+	REQUIRE(cache.n_built() == 3);
+	REQUIRE(cache.n_reused() == 1);
+
+	third.get(quadr);
+	REQUIRE(quadr.weights.sum() == Approx(4 * first.rule->weights.sum()).margin(1e-12));
+}
+
+TEST_CASE("gauss_lobatto", "[quadrature]")
+{
+	for (int n = 2; n <= 10; ++n)
+	{
+		Eigen::VectorXd pts, w;
+		GaussLobattoQuadrature::points_1d(n, pts, w);
+		REQUIRE(pts[0] == 0);
+		REQUIRE(pts[n - 1] == 1);
+
+		// exact up to degree 2n - 3
+		for (int k = 0; k <= 2 * n - 3; ++k)
+			REQUIRE(w.dot(pts.array().pow(k).matrix()) == Approx(1. / (k + 1)).margin(1e-13));
+	}
+
+	// up to order 2 the nodes are the equispaced ones
+	Eigen::VectorXd pts, w;
+	GaussLobattoQuadrature::points_1d(3, pts, w);
+	REQUIRE(pts[1] == Approx(0.5).margin(1e-15));
+
+	for (int q = 1; q <= 3; ++q)
+	{
+		Quadrature quadr;
+		GaussLobattoQuadrature().get_quadrature(q + 1, 3, quadr);
+		REQUIRE(&QuadratureCache::get(QuadratureCache::Shape::LOBATTO_HEXAHEDRON, q + 1) == &QuadratureCache::get(QuadratureCache::Shape::LOBATTO_HEXAHEDRON, q + 1));
+		REQUIRE(QuadratureCache::get(QuadratureCache::Shape::LOBATTO_HEXAHEDRON, q + 1).points == quadr.points);
+
+		GaussLobattoQuadrature::points_1d(q + 1, pts, w);
+		Eigen::MatrixXd val;
+		autogen::q_nodal_basis_values(pts, quadr.points, val);
+		REQUIRE(val.rows() == quadr.weights.size());
+		REQUIRE(val.cols() == quadr.weights.size());
+
+		// the bases interpolate on the quadrature points, so the mass matrix is diagonal
+		const Eigen::MatrixXd mass = val.transpose() * quadr.weights.asDiagonal() * val;
+		const double off_diagonal = (mass - Eigen::MatrixXd(mass.diagonal().asDiagonal())).cwiseAbs().maxCoeff();
+		REQUIRE(off_diagonal < 1e-14);
+		REQUIRE(mass.sum() == Approx(1).margin(1e-12));
+
+		// the gradients are the ones of the equispaced bases up to the node positions: constant and linear functions are reproduced
+		std::vector<Eigen::MatrixXd> grad;
+		autogen::q_nodal_grad_basis_values(pts, quadr.points, grad);
+		const Eigen::MatrixXi exps = autogen::q_tensor_indices(q, 3);
+		Eigen::MatrixXd sum = Eigen::MatrixXd::Zero(quadr.points.rows(), 3), x_grad = sum;
+		for (int j = 0; j < grad.size(); ++j)
+		{
+			sum += grad[j];
+			x_grad += pts[exps(j, 0)] * grad[j];
+		}
+		REQUIRE(sum.cwiseAbs().maxCoeff() < 1e-10);
+		REQUIRE((x_grad.col(0).array() - 1).abs().maxCoeff() < 1e-10);
+		REQUIRE(x_grad.rightCols(2).cwiseAbs().maxCoeff() < 1e-10);
+	}
+}
+
 // TEST_CASE("triangle", "[quadrature]") {
 //	for (int order = 1; order < 10; ++order) {
 //		Quadrature quadr;
@@ -33,3 +33,29 @@ TEST_CASE("interpolation", "[rbf_test]")
 	// std::ofstream file("xxx.txt");
 	// file << vals;
 }
+
+TEST_CASE("compact interpolation", "[rbf_test]")
+{
+	const int dim = GENERATE(2, 3);
+
+	Eigen::MatrixXd pts(2000, dim);
+	pts.setRandom();
+
+	Eigen::MatrixXd fun(pts.rows(), 2);
+	fun.col(0) = pts.col(0).array().sin() + pts.col(1).array() * pts.col(1).array();
+	fun.col(1) = pts.rowwise().sum();
+
+	RBFInterpolation rbf(fun, pts, "wendland", 0.5);
+
+	const Eigen::MatrixXd vals = rbf.interpolate(pts);
+	REQUIRE((vals - fun).cwiseAbs().maxCoeff() < 1e-8);
+
+	// the support covers several centers, the interpolant is close to the function between the centers
+	Eigen::MatrixXd other(100, dim);
+	other.setRandom();
+	other *= 0.5;
+	Eigen::MatrixXd expected(other.rows(), 2);
+	expected.col(0) = other.col(0).array().sin() + other.col(1).array() * other.col(1).array();
+	expected.col(1) = other.rowwise().sum();
+	CHECK((rbf.interpolate(other) - expected).cwiseAbs().maxCoeff() < 0.1);
+}
@@ -5,6 +5,7 @@
 #include <polyfem/Common.hpp>
 #include <polyfem/utils/Logger.hpp>
 #include <polyfem/utils/JSONUtils.hpp>
+#include <polyfem/io/Checkpoint.hpp>
 
 #include <filesystem>
 #include <iostream>
@@ -126,3 +127,32 @@ TEST_CASE("restart", "[.][restart]")
 
 	std::filesystem::remove_all(outdir);
 }
+
+TEST_CASE("checkpoint io", "[restart]")
+{
+	const std::filesystem::path path = std::filesystem::temp_directory_path() / "DELETE_ME_checkpoint.bin";
+
+	io::Checkpoint checkpoint;
+	checkpoint.set("dt", 0.01);
+	checkpoint.set("x_prev_0", Eigen::MatrixXd::Random(7, 1));
+	checkpoint.set("odd_sized_name", Eigen::MatrixXd::Random(3, 2));
+	checkpoint.set("empty", Eigen::MatrixXd());
+	REQUIRE(checkpoint.write(path.string()));
+
+	io::Checkpoint loaded;
+	REQUIRE(loaded.read(path.string()));
+	CHECK(loaded.get_scalar("dt") == 0.01);
+	CHECK(loaded.get("x_prev_0") == checkpoint.get("x_prev_0"));
+	CHECK(loaded.get("odd_sized_name") == checkpoint.get("odd_sized_name"));
+	CHECK(loaded.get("empty").size() == 0);
+	CHECK(!loaded.has("v_prev_0"));
+	CHECK_THROWS(loaded.get("v_prev_0"));
+	CHECK_THROWS(loaded.get_scalar("x_prev_0"));
+
+	// truncated files are rejected
+	std::filesystem::resize_file(path, std::filesystem::file_size(path) - 8);
+	CHECK(!loaded.read(path.string()));
+	CHECK(loaded.empty());
+
+	std::filesystem::remove(path);
+}
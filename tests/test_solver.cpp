@@ -1,10 +1,29 @@
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <polyfem/State.hpp>
+#include <polyfem/state/EnsembleRunner.hpp>
+#include <polyfem/state/JobServer.hpp>
 #include <polyfem/quadrature/TriQuadrature.hpp>
 #include <polyfem/basis/LagrangeBasis2d.hpp>
+#include <polyfem/solver/BlockStokesSolver.hpp>
+#include <polyfem/solver/FullNLProblem.hpp>
+#include <polyfem/solver/GeometricMultigridSolver.hpp>
+#include <polyfem/solver/LBFGSSolver.hpp>
+#include <polyfem/solver/MergedMatrixCache.hpp>
+#include <polyfem/solver/MixedPrecisionSolver.hpp>
+#include <polyfem/solver/ModalBasis.hpp>
+#include <polyfem/solver/PMultigridSolver.hpp>
+#include <polyfem/solver/SchwarzSolver.hpp>
+#include <polyfem/solver/SpectrumEstimate.hpp>
+#include <polyfem/assembler/AssemblerUtils.hpp>
+#include <polyfem/mesh/MeshPartition.hpp>
+#include <polyfem/solver/StaticCondensation.hpp>
+#include <polyfem/solver/TrustRegionSolver.hpp>
 
 #include <catch2/catch.hpp>
+#include <filesystem>
 #include <iostream>
+#include <sstream>
 #include <cppoptlib/meta.h>
 #include <cppoptlib/problem.h>
 #include <cppoptlib/solver/bfgssolver.h>
@@ -43,3 +62,1162 @@ TEST_CASE("solver", "[solver]")
 	std::cout << "f in argmin " << f(x) << std::endl;
 	REQUIRE(f(x) < 1e-10);
 }
+
+namespace
+{
+	class CountingForm : public polyfem::solver::Form
+	{
+	public:
+		mutable int n_values = 0;
+		mutable int n_gradients = 0;
+		int n_solution_changes = 0;
+
+		void solution_changed(const Eigen::VectorXd &new_x) override { ++n_solution_changes; }
+
+	protected:
+		double value_unweighted(const Eigen::VectorXd &x) const override
+		{
+			++n_values;
+			return x.squaredNorm();
+		}
+		void first_derivative_unweighted(const Eigen::VectorXd &x, Eigen::VectorXd &gradv) const override
+		{
+			++n_gradients;
+			gradv = 2 * x;
+		}
+		void second_derivative_unweighted(const Eigen::VectorXd &x, StiffnessMatrix &hessian) const override
+		{
+			hessian.resize(x.size(), x.size());
+			hessian.setIdentity();
+			hessian *= 2;
+		}
+	};
+
+	// extended Rosenbrock, with an indefinite Hessian away from the minimum
+	class RosenbrockForm : public polyfem::solver::Form
+	{
+	protected:
+		double value_unweighted(const Eigen::VectorXd &x) const override
+		{
+			double val = 0;
+			for (int i = 0; i + 1 < x.size(); ++i)
+				val += std::pow(1 - x[i], 2) + 100 * std::pow(x[i + 1] - x[i] * x[i], 2);
+			return val;
+		}
+		void first_derivative_unweighted(const Eigen::VectorXd &x, Eigen::VectorXd &gradv) const override
+		{
+			gradv.setZero(x.size());
+			for (int i = 0; i + 1 < x.size(); ++i)
+			{
+				const double t = x[i + 1] - x[i] * x[i];
+				gradv[i] += -2 * (1 - x[i]) - 400 * t * x[i];
+				gradv[i + 1] += 200 * t;
+			}
+		}
+		void second_derivative_unweighted(const Eigen::VectorXd &x, StiffnessMatrix &hessian) const override
+		{
+			std::vector<Eigen::Triplet<double>> triplets;
+			for (int i = 0; i + 1 < x.size(); ++i)
+			{
+				triplets.emplace_back(i, i, 2 - 400 * (x[i + 1] - x[i] * x[i]) + 800 * x[i] * x[i]);
+				triplets.emplace_back(i, i + 1, -400 * x[i]);
+				triplets.emplace_back(i + 1, i, -400 * x[i]);
+				triplets.emplace_back(i + 1, i + 1, 200);
+			}
+			hessian.resize(x.size(), x.size());
+			hessian.setFromTriplets(triplets.begin(), triplets.end());
+		}
+	};
+
+	// separable and badly scaled, its Hessian is diagonal
+	class ScaledQuarticForm : public polyfem::solver::Form
+	{
+	public:
+		ScaledQuarticForm(const Eigen::VectorXd &scaling) : scaling_(scaling) {}
+
+	protected:
+		double value_unweighted(const Eigen::VectorXd &x) const override
+		{
+			return 0.5 * x.dot(scaling_.cwiseProduct(x)) + 0.25 * (x.array() - 1).pow(4).sum() - x.sum();
+		}
+		void first_derivative_unweighted(const Eigen::VectorXd &x, Eigen::VectorXd &gradv) const override
+		{
+			gradv = scaling_.cwiseProduct(x) + (x.array() - 1).pow(3).matrix() - Eigen::VectorXd::Ones(x.size());
+		}
+		void second_derivative_unweighted(const Eigen::VectorXd &x, StiffnessMatrix &hessian) const override
+		{
+			const Eigen::VectorXd diag = scaling_ + 3 * (x.array() - 1).pow(2).matrix();
+			hessian = StiffnessMatrix(diag.asDiagonal());
+		}
+
+	private:
+		Eigen::VectorXd scaling_;
+	};
+} // namespace
+
+TEST_CASE("nl_problem_cache", "[solver]")
+{
+	auto form = std::make_shared<CountingForm>();
+	polyfem::solver::FullNLProblem problem({form});
+
+	const Eigen::VectorXd x = Eigen::VectorXd::Random(5);
+	Eigen::VectorXd grad;
+
+	problem.solution_changed(x);
+	REQUIRE(problem.value(x) == Approx(x.squaredNorm()));
+	problem.gradient(x, grad);
+
+	// same solution, everything is memoized
+	problem.solution_changed(x);
+	REQUIRE(problem.value(x) == Approx(x.squaredNorm()));
+	problem.gradient(x, grad);
+	REQUIRE(form->n_solution_changes == 1);
+	REQUIRE(form->n_values == 1);
+	REQUIRE(form->n_gradients == 1);
+	REQUIRE(problem.cache_hits().values == 1);
+	REQUIRE(problem.cache_hits().gradients == 1);
+	REQUIRE(problem.cache_hits().solution_changes == 1);
+
+	// a different solution is evaluated and not memoized as the forms are not at it
+	const Eigen::VectorXd y = 2 * x;
+	REQUIRE(problem.value(y) == Approx(y.squaredNorm()));
+	REQUIRE(problem.value(y) == Approx(y.squaredNorm()));
+	REQUIRE(form->n_values == 3);
+
+	// changing the weight invalidates the value
+	form->set_weight(3);
+	REQUIRE(problem.value(x) == Approx(3 * x.squaredNorm()));
+	problem.gradient(x, grad);
+	REQUIRE((grad - 6 * x).norm() == Approx(0).margin(1e-12));
+	REQUIRE(form->n_values == 4);
+	REQUIRE(form->n_gradients == 2);
+
+	problem.invalidate_cache();
+	problem.solution_changed(x);
+	REQUIRE(form->n_solution_changes == 2);
+}
+
+TEST_CASE("trust_region", "[solver]")
+{
+	// dogleg with a factorization, Steihaug conjugate gradient with an iterative solver or Hessian-vector products
+	const std::string linear_solver = GENERATE(std::string("Eigen::SimplicialLDLT"), std::string("Eigen::ConjugateGradient"));
+	const bool matrix_free = GENERATE(false, true);
+	const int lagging = GENERATE(0, 3);
+
+	json solver_params = R"({
+		"x_delta": 0, "f_delta": 0, "grad_norm": 1e-8, "first_grad_norm_tol": 1e-10,
+		"max_iterations": 500, "relative_gradient": false,
+		"line_search": {"method": "backtracking", "use_grad_norm_tol": -1, "batch_size": 1},
+		"force_psd_projection": false,
+		"matrix_free": {"enabled": false, "max_iterations": 100, "tolerance": 1e-10, "preconditioner": "jacobi"},
+		"hessian_lagging": {"max_iterations": 0, "min_step": 0.5, "stall_ratio": 0.5},
+		"inexact": {"enabled": false, "max_forcing": 0.5, "gamma": 0.9, "alpha": 2, "warm_start": true},
+		"trust_region": {"initial_radius": 0, "max_radius": 0, "eta": 1e-4}
+	})"_json;
+	solver_params["matrix_free"]["enabled"] = matrix_free;
+	solver_params["hessian_lagging"]["max_iterations"] = lagging;
+	const json linear_solver_params = {{"solver", linear_solver}, {"precond", "Eigen::DiagonalPreconditioner"}};
+
+	polyfem::solver::FullNLProblem problem({std::make_shared<RosenbrockForm>()});
+	cppoptlib::TrustRegionSolver<polyfem::solver::FullNLProblem> solver(solver_params, linear_solver_params, 1);
+
+	Eigen::VectorXd x = Eigen::VectorXd::Constant(20, -1.2);
+	x[1] = 1;
+	solver.minimize(problem, x);
+
+	json info;
+	solver.get_info(info);
+	CHECK(solver.converged());
+	CHECK((x - Eigen::VectorXd::Ones(x.size())).norm() == Approx(0).margin(1e-5));
+	CHECK(info["rejected_steps"].get<int>() > 0);
+	if (lagging > 0 && !matrix_free && linear_solver == "Eigen::SimplicialLDLT")
+		CHECK(info["saved_factorizations"].get<int>() > 0);
+}
+
+TEST_CASE("lbfgs_diagonal_metric", "[solver]")
+{
+	json solver_params = R"({
+		"x_delta": 0, "f_delta": 0, "grad_norm": 1e-4, "first_grad_norm_tol": 1e-10,
+		"max_iterations": 1000, "relative_gradient": false,
+		"line_search": {"method": "backtracking", "use_grad_norm_tol": -1, "batch_size": 1},
+		"lbfgs": {"initial_metric": "scalar", "metric_update_interval": 1}
+	})"_json;
+
+	const int n = 1000;
+	polyfem::solver::FullNLProblem problem({std::make_shared<ScaledQuarticForm>(Eigen::VectorXd::LinSpaced(n, 1, 1e3))});
+
+	std::map<std::string, int> iterations;
+	for (const std::string metric : {"scalar", "diagonal"})
+	{
+		solver_params["lbfgs"]["initial_metric"] = metric;
+		cppoptlib::LBFGSSolver<polyfem::solver::FullNLProblem> solver(solver_params, 1);
+
+		Eigen::VectorXd x = Eigen::VectorXd::Zero(n);
+		solver.minimize(problem, x);
+
+		json info;
+		solver.get_info(info);
+		CHECK(solver.converged());
+		iterations[metric] = info["iterations"];
+		if (metric == "diagonal")
+			CHECK(info["metric_updates"].get<int>() > 0);
+	}
+
+	// the diagonal metric removes the bad scaling
+	CHECK(iterations["diagonal"] * 10 < iterations["scalar"]);
+}
+
+TEST_CASE("static_condensation", "[solver]")
+{
+	const std::string path = POLYFEM_DATA_DIR;
+	const std::string material = GENERATE("Laplacian", "LinearElasticity");
+
+	json in_args = json({});
+	in_args["geometry"] = {};
+	in_args["geometry"]["mesh"] = path + "/plane_hole.obj";
+	in_args["materials"] = {};
+	in_args["materials"]["type"] = material;
+	in_args["materials"]["E"] = 1e5;
+	in_args["materials"]["nu"] = 0.3;
+	// P3 triangles have one interior node
+	in_args["space"] = {};
+	in_args["space"]["discr_order"] = 3;
+
+	State state;
+	state.init_logger("", spdlog::level::err, false);
+	state.init(in_args, true);
+	state.load_mesh();
+	state.build_basis();
+
+	const int problem_dim = state.problem->is_scalar() ? 1 : 2;
+	StiffnessMatrix A;
+	state.assembler->assemble(false, state.n_bases, state.bases, state.geom_bases(), state.ass_vals_cache, A);
+	// regularize the pure Neumann problem
+	StiffnessMatrix identity(A.rows(), A.cols());
+	identity.setIdentity();
+	A += identity;
+
+	const std::vector<int> excluded = {0, 1};
+	const auto interior = polyfem::solver::StaticCondensation::interior_dofs(state.bases, state.n_bases, problem_dim, excluded);
+	REQUIRE(interior.size() == state.bases.size());
+	for (const auto &dofs : interior)
+		REQUIRE(dofs.size() == problem_dim);
+
+	const polyfem::solver::StaticCondensation condensation(A, interior);
+	REQUIRE(condensation.n_interior() == problem_dim * state.bases.size());
+	REQUIRE(condensation.skeleton_index(0) == 0);
+	REQUIRE(condensation.skeleton_index(1) == 1);
+
+	const Eigen::VectorXd b = Eigen::VectorXd::Random(A.rows());
+	Eigen::VectorXd b_s, x;
+	condensation.condense(b, b_s);
+
+	Eigen::SparseLU<StiffnessMatrix> skeleton_solver(condensation.skeleton_matrix());
+	const Eigen::VectorXd x_s = skeleton_solver.solve(b_s);
+	condensation.expand(b, x_s, x);
+
+	Eigen::SparseLU<StiffnessMatrix> full_solver(A);
+	const Eigen::VectorXd expected = full_solver.solve(b);
+	REQUIRE((x - expected).norm() == Approx(0).margin(1e-8 * expected.norm()));
+}
+
+TEST_CASE("merged_matrix_cache", "[solver]")
+{
+	const int n_bases = 30, n_pressure_bases = 12, dim = 2;
+	const bool use_avg_pressure = GENERATE(false, true);
+	const int n = n_bases * dim;
+
+	const auto random_sparse = [](const int rows, const int cols, const int n_entries) {
+		std::vector<Eigen::Triplet<double>> triplets;
+		for (int i = 0; i < n_entries; ++i)
+			triplets.emplace_back(rand() % rows, rand() % cols, double(rand()) / RAND_MAX);
+		StiffnessMatrix res(rows, cols);
+		res.setFromTriplets(triplets.begin(), triplets.end());
+		return res;
+	};
+
+	const StiffnessMatrix velocity = random_sparse(n, n, 200);
+	const StiffnessMatrix mixed = random_sparse(n, n_pressure_bases, 80);
+	const StiffnessMatrix pressure = random_sparse(n_pressure_bases, n_pressure_bases, 20);
+
+	StiffnessMatrix stokes;
+	AssemblerUtils::merge_mixed_matrices(n_bases, n_pressure_bases, dim, use_avg_pressure, velocity, mixed, pressure, stokes);
+	polyfem::solver::MergedMatrixCache cache(stokes);
+
+	StiffnessMatrix nl = random_sparse(n, n, 300);
+	StiffnessMatrix expected, sum;
+	for (int i = 0; i < 3; ++i)
+	{
+		// same pattern, new values
+		if (i == 1)
+			nl.coeffs() *= -2;
+		// new pattern
+		if (i == 2)
+			nl = random_sparse(n, n, 300);
+
+		AssemblerUtils::merge_mixed_matrices(n_bases, n_pressure_bases, dim, use_avg_pressure, velocity + nl, mixed, pressure, expected);
+		cache.add(nl, sum);
+
+		REQUIRE(sum.rows() == expected.rows());
+		REQUIRE(sum.cols() == expected.cols());
+		REQUIRE((Eigen::MatrixXd(sum) - Eigen::MatrixXd(expected)).norm() == Approx(0).margin(1e-12));
+	}
+	REQUIRE(cache.n_pattern_updates() == 2);
+
+	// every column of the Dirichlet rows is kept
+	StiffnessMatrix sparse(4, 4);
+	sparse.insert(0, 0) = 1;
+	sparse.insert(1, 2) = 1;
+	sparse.insert(3, 3) = 1e-14;
+	polyfem::solver::MergedMatrixCache sparse_cache(sparse);
+	REQUIRE(sparse_cache.zero_columns({}) == std::vector<int>{1, 3});
+	REQUIRE(sparse_cache.zero_columns({1}) == std::vector<int>{2, 3});
+}
+
+TEST_CASE("block_stokes_solver", "[solver]")
+{
+	const int n_bases = 40, n_pressure_bases = 15, dim = 2;
+	const int n_velocity = n_bases * dim;
+	const bool use_avg_pressure = GENERATE(false, true);
+	const std::string schur = GENERATE("mass", "lsc");
+
+	// SPD velocity block, full rank divergence and pressure mass
+	std::vector<Eigen::Triplet<double>> triplets;
+	for (int i = 0; i < n_velocity; ++i)
+	{
+		triplets.emplace_back(i, i, 4);
+		if (i + dim < n_velocity)
+		{
+			triplets.emplace_back(i, i + dim, -1);
+			triplets.emplace_back(i + dim, i, -1);
+		}
+	}
+	StiffnessMatrix velocity(n_velocity, n_velocity);
+	velocity.setFromTriplets(triplets.begin(), triplets.end());
+
+	triplets.clear();
+	for (int p = 0; p < n_pressure_bases; ++p)
+	{
+		for (int k = 0; k < 4; ++k)
+			triplets.emplace_back((5 * p + 3 * k) % n_velocity, p, ((p + k) % 3) - 1.2);
+	}
+	StiffnessMatrix mixed(n_velocity, n_pressure_bases);
+	mixed.setFromTriplets(triplets.begin(), triplets.end());
+
+	StiffnessMatrix pressure(n_pressure_bases, n_pressure_bases);
+	StiffnessMatrix pressure_mass(n_pressure_bases, n_pressure_bases);
+	pressure_mass.setIdentity();
+
+	StiffnessMatrix A;
+	AssemblerUtils::merge_mixed_matrices(n_bases, n_pressure_bases, dim, use_avg_pressure, velocity, mixed, pressure, A);
+
+	const std::vector<int> boundary_nodes = {0, 1, 7};
+	Eigen::VectorXd b = Eigen::VectorXd::Random(A.rows());
+	if (use_avg_pressure)
+		b[b.size() - 1] = 0;
+
+	json linear_params = R"({
+		"solver": "Eigen::SparseLU",
+		"precond": "",
+		"block": {
+			"enabled": true,
+			"velocity_solver": "",
+			"velocity_precond": "",
+			"pressure_solver": "",
+			"pressure_precond": "",
+			"tolerance": 1e-10,
+			"max_iter": 200,
+			"restart": 30
+		}
+	})"_json;
+	linear_params["block"]["schur"] = schur;
+	REQUIRE(polyfem::solver::BlockStokesSolver::is_enabled(linear_params));
+
+	polyfem::solver::BlockStokesSolver solver(linear_params, n_velocity, n_pressure_bases, use_avg_pressure);
+	solver.set_pressure_mass(pressure_mass, 1);
+	Eigen::VectorXd x;
+	solver.solve(A, b, boundary_nodes, x);
+
+	// reference, Dirichlet rows replaced by the identity
+	StiffnessMatrix A_bc = A;
+	for (int k = 0; k < A_bc.outerSize(); ++k)
+	{
+		for (StiffnessMatrix::InnerIterator it(A_bc, k); it; ++it)
+		{
+			if (std::find(boundary_nodes.begin(), boundary_nodes.end(), it.row()) != boundary_nodes.end())
+				it.valueRef() = it.row() == it.col() ? 1 : 0;
+		}
+	}
+	Eigen::SparseLU<StiffnessMatrix> lu(A_bc);
+	const Eigen::VectorXd expected = lu.solve(b);
+
+	json info;
+	solver.get_info(info);
+	REQUIRE(info["iterations"].get<int>() < 200);
+	REQUIRE((x - expected).norm() == Approx(0).margin(1e-7 * expected.norm()));
+	for (const int i : boundary_nodes)
+		REQUIRE(x[i] == Approx(b[i]));
+}
+
+TEST_CASE("p_multigrid_solver", "[solver]")
+{
+	const std::string path = POLYFEM_DATA_DIR;
+	const int discr_order = GENERATE(2, 3);
+	const std::string smoother = GENERATE("chebyshev", "jacobi");
+
+	json in_args = json({});
+	in_args["geometry"] = {};
+	in_args["geometry"]["mesh"] = path + "/plane_hole.obj";
+	in_args["materials"] = {};
+	in_args["materials"]["type"] = "LinearElasticity";
+	in_args["materials"]["E"] = 1e5;
+	in_args["materials"]["nu"] = 0.3;
+	in_args["space"] = {};
+	in_args["space"]["discr_order"] = discr_order;
+
+	State state;
+	state.init_logger("", spdlog::level::err, false);
+	state.init(in_args, true);
+	state.load_mesh();
+	state.build_basis();
+
+	const int dim = 2;
+	std::vector<ElementBases> coarse_bases;
+	const int n_coarse = polyfem::solver::MultigridSolver::build_linear_bases(*state.mesh, state.assembler->name(), coarse_bases);
+	REQUIRE(n_coarse < state.n_bases);
+
+	// linear functions are interpolated exactly
+	const auto linear = [](const RowVectorNd &p) { return 1 + 2 * p(0) - 3 * p(1); };
+	Eigen::VectorXd coarse_values(n_coarse), fine_values(state.n_bases);
+	for (const ElementBases &b : coarse_bases)
+	{
+		for (const Basis &basis : b.bases)
+			coarse_values[basis.global()[0].index] = linear(basis.global()[0].node);
+	}
+	double min_x = std::numeric_limits<double>::max(), max_x = -min_x;
+	for (const ElementBases &b : state.bases)
+	{
+		for (const Basis &basis : b.bases)
+		{
+			fine_values[basis.global()[0].index] = linear(basis.global()[0].node);
+			min_x = std::min(min_x, basis.global()[0].node(0));
+			max_x = std::max(max_x, basis.global()[0].node(0));
+		}
+	}
+	const StiffnessMatrix P_scalar = polyfem::solver::PMultigridSolver::prolongation(state.bases, state.n_bases, coarse_bases, n_coarse, 1);
+	REQUIRE((P_scalar * coarse_values - fine_values).norm() == Approx(0).margin(1e-10 * fine_values.norm()));
+
+	// clamped left side
+	std::vector<int> boundary_nodes;
+	for (const ElementBases &b : state.bases)
+	{
+		for (const Basis &basis : b.bases)
+		{
+			if (basis.global()[0].node(0) < min_x + 0.05 * (max_x - min_x))
+			{
+				for (int d = 0; d < dim; ++d)
+					boundary_nodes.push_back(basis.global()[0].index * dim + d);
+			}
+		}
+	}
+	std::sort(boundary_nodes.begin(), boundary_nodes.end());
+	boundary_nodes.erase(std::unique(boundary_nodes.begin(), boundary_nodes.end()), boundary_nodes.end());
+	REQUIRE(!boundary_nodes.empty());
+
+	StiffnessMatrix A;
+	state.assembler->assemble(false, state.n_bases, state.bases, state.geom_bases(), state.ass_vals_cache, A);
+	const Eigen::VectorXd b = Eigen::VectorXd::Random(A.rows());
+
+	json linear_params = R"({
+		"solver": "Eigen::SparseLU",
+		"precond": "",
+		"p_multigrid": {
+			"enabled": true,
+			"smoothing_steps": 3,
+			"coarse_solver": "",
+			"coarse_precond": "",
+			"tolerance": 1e-10,
+			"max_iter": 200
+		}
+	})"_json;
+	linear_params["p_multigrid"]["smoother"] = smoother;
+	REQUIRE(polyfem::solver::PMultigridSolver::is_enabled(linear_params));
+
+	const StiffnessMatrix P = polyfem::solver::PMultigridSolver::prolongation(state.bases, state.n_bases, coarse_bases, n_coarse, dim);
+	polyfem::solver::PMultigridSolver solver(linear_params);
+	solver.set_prolongation(P);
+	Eigen::VectorXd x;
+	solver.solve(A, b, boundary_nodes, x);
+
+	// reference, Dirichlet rows replaced by the identity
+	StiffnessMatrix A_bc = A;
+	for (int k = 0; k < A_bc.outerSize(); ++k)
+	{
+		for (StiffnessMatrix::InnerIterator it(A_bc, k); it; ++it)
+		{
+			if (std::binary_search(boundary_nodes.begin(), boundary_nodes.end(), it.row()))
+				it.valueRef() = it.row() == it.col() ? 1 : 0;
+		}
+	}
+	Eigen::SparseLU<StiffnessMatrix> lu(A_bc);
+	const Eigen::VectorXd expected = lu.solve(b);
+
+	json info;
+	solver.get_info(info);
+	// the iterations do not depend much on the order
+	REQUIRE(info["iterations"].get<int>() < 60);
+	REQUIRE((x - expected).norm() == Approx(0).margin(1e-6 * expected.norm()));
+	for (const int i : boundary_nodes)
+		REQUIRE(x[i] == Approx(b[i]));
+
+	// matrix-free smoothing with the same coarse matrix
+	polyfem::solver::PMultigridSolver matrix_free(linear_params);
+	matrix_free.set_prolongation(P);
+	matrix_free.factorize(
+		[&A](const Eigen::VectorXd &v, Eigen::VectorXd &Av) { Av = A * v; },
+		A.diagonal(), P.transpose() * A * P, boundary_nodes);
+	Eigen::VectorXd x_free;
+	matrix_free.solve(b, x_free);
+	REQUIRE((x_free - expected).norm() == Approx(0).margin(1e-6 * expected.norm()));
+}
+
+TEST_CASE("matrix_free_laplacian", "[solver]")
+{
+	const int discr_order = GENERATE(1, 2);
+	const bool p_multigrid = GENERATE(false, true);
+
+	json in_args = R"({
+		"materials": {"type": "Laplacian"},
+		"boundary_conditions": {
+			"dirichlet_boundary": [{"id": "all", "value": "x^2 + y * z"}],
+			"rhs": 2
+		},
+		"solver": {
+			"linear": {
+				"solver": "Eigen::SimplicialLDLT",
+				"precond": "",
+				"matrix_free": {"enabled": false, "tolerance": 1e-12, "max_iter": 500}
+			}
+		}
+	})"_json;
+	in_args["space"]["discr_order"] = discr_order;
+	in_args["solver"]["linear"]["matrix_free"]["p_multigrid"] = p_multigrid;
+
+	// 3 x 3 x 3 hexes, the interior vertices are moved so that the geometric mapping is not affine
+	const int n = 3;
+	Eigen::MatrixXd V((n + 1) * (n + 1) * (n + 1), 3);
+	for (int k = 0; k <= n; ++k)
+		for (int j = 0; j <= n; ++j)
+			for (int i = 0; i <= n; ++i)
+			{
+				V.row(i + (n + 1) * (j + (n + 1) * k)) << i / double(n), j / double(n), k / double(n);
+				if (i > 0 && i < n && j > 0 && j < n && k > 0 && k < n)
+					V.row(i + (n + 1) * (j + (n + 1) * k)) += 0.05 * Eigen::RowVector3d(std::sin(i + j), std::cos(j + k), std::sin(k + i));
+			}
+
+	Eigen::MatrixXi F(n * n * n, 8);
+	for (int k = 0; k < n; ++k)
+		for (int j = 0; j < n; ++j)
+			for (int i = 0; i < n; ++i)
+			{
+				const int v = i + (n + 1) * (j + (n + 1) * k);
+				const int s = (n + 1) * (n + 1);
+				F.row(i + n * (j + n * k)) << v, v + 1, v + n + 2, v + n + 1, v + s, v + s + 1, v + s + n + 2, v + s + n + 1;
+			}
+
+	State state;
+	state.init_logger("", spdlog::level::err, false);
+	state.init(in_args, true);
+	state.load_mesh(V, F);
+	state.build_basis();
+	state.assemble_mass_mat();
+	state.assemble_rhs();
+
+	Eigen::MatrixXd expected, pressure;
+	state.solve_problem(expected, pressure);
+
+	state.args["solver"]["linear"]["matrix_free"]["enabled"] = true;
+	Eigen::MatrixXd sol;
+	state.solve_problem(sol, pressure);
+
+	// the stiffness matrix is not assembled
+	REQUIRE(state.stats.nn_zero == 0);
+	REQUIRE(state.stats.solver_info["levels"].get<int>() == (p_multigrid && discr_order > 1 ? 2 : 1));
+	REQUIRE(state.stats.solver_info["iterations"].get<int>() > 0);
+	REQUIRE((sol - expected).norm() == Approx(0).margin(1e-8 * expected.norm()));
+}
+
+TEST_CASE("geometric_multigrid_solver", "[solver]")
+{
+	const std::string path = POLYFEM_DATA_DIR;
+	const int discr_order = GENERATE(1, 2);
+	const int n_refs = 2;
+
+	json in_args = json({});
+	in_args["geometry"] = {};
+	in_args["geometry"]["mesh"] = path + "/plane_hole.obj";
+	in_args["geometry"]["n_refs"] = n_refs;
+	in_args["geometry"]["advanced"]["keep_refinement_levels"] = true;
+	in_args["materials"] = {};
+	in_args["materials"]["type"] = "LinearElasticity";
+	in_args["materials"]["E"] = 1e5;
+	in_args["materials"]["nu"] = 0.3;
+	in_args["space"] = {};
+	in_args["space"]["discr_order"] = discr_order;
+
+	State state;
+	state.init_logger("", spdlog::level::err, false);
+	state.init(in_args, true);
+	state.load_mesh();
+	state.build_basis();
+
+	const auto &levels = state.mesh->refinement_levels();
+	REQUIRE(levels.size() == n_refs);
+	REQUIRE(levels[0].cells.rows() < levels[1].cells.rows());
+	REQUIRE(levels[1].cells.rows() < state.mesh->n_elements());
+
+	// linear functions on the coarsest mesh are interpolated exactly on the finest one
+	const auto linear = [](const RowVectorNd &p) { return 1 + 2 * p(0) - 3 * p(1); };
+	const std::unique_ptr<Mesh> coarse_mesh = Mesh::create(levels[0].vertices, levels[0].cells);
+	std::vector<ElementBases> coarse_bases;
+	const int n_coarse = polyfem::solver::MultigridSolver::build_linear_bases(*coarse_mesh, state.assembler->name(), coarse_bases);
+	Eigen::VectorXd coarse_values(n_coarse), fine_values(state.n_bases);
+	for (const ElementBases &b : coarse_bases)
+	{
+		for (const Basis &basis : b.bases)
+			coarse_values[basis.global()[0].index] = linear(basis.global()[0].node);
+	}
+	double min_x = std::numeric_limits<double>::max(), max_x = -min_x;
+	for (const ElementBases &b : state.bases)
+	{
+		for (const Basis &basis : b.bases)
+		{
+			fine_values[basis.global()[0].index] = linear(basis.global()[0].node);
+			min_x = std::min(min_x, basis.global()[0].node(0));
+			max_x = std::max(max_x, basis.global()[0].node(0));
+		}
+	}
+	const StiffnessMatrix P_scalar = polyfem::solver::GeometricMultigridSolver::interpolation(coarse_bases, n_coarse, state.bases, state.n_bases, 1);
+	REQUIRE((P_scalar * coarse_values - fine_values).norm() == Approx(0).margin(1e-10 * fine_values.norm()));
+
+	const int dim = 2;
+	const std::vector<StiffnessMatrix> prolongations = polyfem::solver::GeometricMultigridSolver::prolongations(
+		*state.mesh, state.assembler->name(), state.bases, state.n_bases, dim);
+	REQUIRE(prolongations.size() == n_refs);
+	REQUIRE(prolongations[0].rows() == state.n_bases * dim);
+	REQUIRE(prolongations[1].cols() == n_coarse * dim);
+
+	// clamped left side
+	std::vector<int> boundary_nodes;
+	for (const ElementBases &b : state.bases)
+	{
+		for (const Basis &basis : b.bases)
+		{
+			if (basis.global()[0].node(0) < min_x + 0.05 * (max_x - min_x))
+			{
+				for (int d = 0; d < dim; ++d)
+					boundary_nodes.push_back(basis.global()[0].index * dim + d);
+			}
+		}
+	}
+	std::sort(boundary_nodes.begin(), boundary_nodes.end());
+	boundary_nodes.erase(std::unique(boundary_nodes.begin(), boundary_nodes.end()), boundary_nodes.end());
+	REQUIRE(!boundary_nodes.empty());
+
+	StiffnessMatrix A;
+	state.assembler->assemble(false, state.n_bases, state.bases, state.geom_bases(), state.ass_vals_cache, A);
+	const Eigen::VectorXd b = Eigen::VectorXd::Random(A.rows());
+
+	json linear_params = R"({
+		"solver": "Eigen::SparseLU",
+		"precond": "",
+		"geometric_multigrid": {
+			"enabled": true,
+			"smoother": "chebyshev",
+			"smoothing_steps": 3,
+			"coarse_solver": "",
+			"coarse_precond": "",
+			"tolerance": 1e-10,
+			"max_iter": 200
+		}
+	})"_json;
+	REQUIRE(polyfem::solver::GeometricMultigridSolver::is_enabled(linear_params));
+
+	polyfem::solver::GeometricMultigridSolver solver(linear_params);
+	solver.set_prolongations(prolongations);
+	Eigen::VectorXd x;
+	solver.solve(A, b, boundary_nodes, x);
+	REQUIRE(solver.n_levels() == n_refs + 1);
+
+	// reference, Dirichlet rows replaced by the identity
+	StiffnessMatrix A_bc = A;
+	for (int k = 0; k < A_bc.outerSize(); ++k)
+	{
+		for (StiffnessMatrix::InnerIterator it(A_bc, k); it; ++it)
+		{
+			if (std::binary_search(boundary_nodes.begin(), boundary_nodes.end(), it.row()))
+				it.valueRef() = it.row() == it.col() ? 1 : 0;
+		}
+	}
+	Eigen::SparseLU<StiffnessMatrix> lu(A_bc);
+	const Eigen::VectorXd expected = lu.solve(b);
+
+	json info;
+	solver.get_info(info);
+	REQUIRE(info["iterations"].get<int>() < 60);
+	REQUIRE((x - expected).norm() == Approx(0).margin(1e-6 * expected.norm()));
+}
+
+TEST_CASE("mixed_precision_solver", "[solver]")
+{
+	const std::string path = POLYFEM_DATA_DIR;
+	const bool dirichlet_rows = GENERATE(false, true);
+
+	json in_args = json({});
+	in_args["geometry"] = {};
+	in_args["geometry"]["mesh"] = path + "/plane_hole.obj";
+	in_args["materials"] = {};
+	in_args["materials"]["type"] = "LinearElasticity";
+	in_args["materials"]["E"] = 1e5;
+	in_args["materials"]["nu"] = 0.3;
+	in_args["space"] = {};
+	in_args["space"]["discr_order"] = 2;
+
+	State state;
+	state.init_logger("", spdlog::level::err, false);
+	state.init(in_args, true);
+	state.load_mesh();
+	state.build_basis();
+
+	StiffnessMatrix A;
+	state.assembler->assemble(false, state.n_bases, state.bases, state.geom_bases(), state.ass_vals_cache, A);
+
+	// the first node is clamped, with identity rows (LU) or with its rows and columns (LDLT)
+	for (int k = 0; k < A.outerSize(); ++k)
+	{
+		for (StiffnessMatrix::InnerIterator it(A, k); it; ++it)
+		{
+			if (it.row() < 2 || (!dirichlet_rows && it.col() < 2))
+				it.valueRef() = it.row() == it.col() ? 1 : 0;
+		}
+	}
+	const Eigen::VectorXd b = Eigen::VectorXd::Random(A.rows());
+
+	json linear_params = R"({
+		"solver": "Eigen::SparseLU",
+		"precond": "",
+		"mixed_precision": {
+			"enabled": true,
+			"tolerance": 1e-10,
+			"max_refinement_steps": 10,
+			"max_gmres_iter": 100,
+			"restart": 30
+		}
+	})"_json;
+	REQUIRE(polyfem::solver::MixedPrecisionSolver::is_enabled(linear_params));
+
+	std::unique_ptr<polysolve::LinearSolver> solver = polyfem::solver::MixedPrecisionSolver::create(linear_params);
+	solver->setParameters(linear_params);
+	REQUIRE(solver->name() == "MixedPrecision");
+	solver->analyzePattern(A, A.rows());
+	solver->factorize(A);
+	Eigen::VectorXd x(A.rows());
+	solver->solve(b, x);
+
+	Eigen::SparseLU<StiffnessMatrix> lu(A);
+	const Eigen::VectorXd expected = lu.solve(b);
+
+	json info;
+	solver->getInfo(info);
+	REQUIRE(info["factorization"] == (dirichlet_rows ? "SparseLU<float>" : "SimplicialLDLT<float>"));
+	REQUIRE(info["error"].get<double>() < 1e-10);
+	// the single precision factorization is an accurate preconditioner
+	REQUIRE(info["refinement_steps"].get<int>() + info["gmres_iterations"].get<int>() < 30);
+	REQUIRE((x - expected).norm() == Approx(0).margin(1e-8 * expected.norm()));
+
+	linear_params["mixed_precision"]["enabled"] = false;
+	REQUIRE(polyfem::solver::MixedPrecisionSolver::create(linear_params)->name() != "MixedPrecision");
+}
+
+TEST_CASE("schwarz_solver", "[solver]")
+{
+	const std::string path = POLYFEM_DATA_DIR;
+	const int overlap = GENERATE(0, 1);
+	const bool coarse_space = GENERATE(false, true);
+
+	json in_args = json({});
+	in_args["geometry"] = {};
+	in_args["geometry"]["mesh"] = path + "/plane_hole.obj";
+	in_args["geometry"]["n_refs"] = 1;
+	in_args["materials"] = {};
+	in_args["materials"]["type"] = "LinearElasticity";
+	in_args["materials"]["E"] = 1e5;
+	in_args["materials"]["nu"] = 0.3;
+	in_args["space"] = {};
+	in_args["space"]["discr_order"] = 2;
+
+	State state;
+	state.init_logger("", spdlog::level::err, false);
+	state.init(in_args, true);
+	state.load_mesh();
+	state.build_basis();
+
+	const int dim = 2;
+	double min_x = std::numeric_limits<double>::max(), max_x = -min_x;
+	for (const ElementBases &b : state.bases)
+	{
+		for (const Basis &basis : b.bases)
+		{
+			min_x = std::min(min_x, basis.global()[0].node(0));
+			max_x = std::max(max_x, basis.global()[0].node(0));
+		}
+	}
+
+	// clamped left side
+	std::vector<int> boundary_nodes;
+	for (const ElementBases &b : state.bases)
+	{
+		for (const Basis &basis : b.bases)
+		{
+			if (basis.global()[0].node(0) < min_x + 0.05 * (max_x - min_x))
+			{
+				for (int d = 0; d < dim; ++d)
+					boundary_nodes.push_back(basis.global()[0].index * dim + d);
+			}
+		}
+	}
+	std::sort(boundary_nodes.begin(), boundary_nodes.end());
+	boundary_nodes.erase(std::unique(boundary_nodes.begin(), boundary_nodes.end()), boundary_nodes.end());
+	REQUIRE(!boundary_nodes.empty());
+
+	StiffnessMatrix A;
+	state.assembler->assemble(false, state.n_bases, state.bases, state.geom_bases(), state.ass_vals_cache, A);
+	const Eigen::VectorXd b = Eigen::VectorXd::Random(A.rows());
+
+	json linear_params = R"({
+		"solver": "Eigen::SparseLU",
+		"precond": "",
+		"schwarz": {
+			"enabled": true,
+			"n_subdomains": 4,
+			"tolerance": 1e-10,
+			"max_iter": 1000
+		}
+	})"_json;
+	linear_params["schwarz"]["overlap"] = overlap;
+	linear_params["schwarz"]["coarse_space"] = coarse_space;
+	REQUIRE(polyfem::solver::SchwarzSolver::is_enabled(linear_params));
+
+	const int n_parts = polyfem::solver::SchwarzSolver::n_subdomains(linear_params);
+	REQUIRE(n_parts == 4);
+	const Eigen::VectorXi part = polyfem::mesh::partition::bisection(*state.mesh, n_parts);
+
+	polyfem::solver::SchwarzSolver solver(linear_params);
+	solver.set_subdomains(part, n_parts, state.bases, state.n_bases, dim);
+	Eigen::VectorXd x;
+	solver.solve(A, b, boundary_nodes, x);
+
+	// reference, Dirichlet rows replaced by the identity
+	StiffnessMatrix A_bc = A;
+	for (int k = 0; k < A_bc.outerSize(); ++k)
+	{
+		for (StiffnessMatrix::InnerIterator it(A_bc, k); it; ++it)
+		{
+			if (std::binary_search(boundary_nodes.begin(), boundary_nodes.end(), it.row()))
+				it.valueRef() = it.row() == it.col() ? 1 : 0;
+		}
+	}
+	Eigen::SparseLU<StiffnessMatrix> lu(A_bc);
+	const Eigen::VectorXd expected = lu.solve(b);
+
+	json info;
+	solver.get_info(info);
+	REQUIRE(info["subdomains"].get<int>() == n_parts);
+	// 3 rigid body modes per part
+	REQUIRE(info["n_coarse"].get<int>() == (coarse_space ? 3 * n_parts : 0));
+	REQUIRE(info["error"].get<double>() < 1e-10);
+	REQUIRE(info["iterations"].get<int>() < 500);
+	REQUIRE((x - expected).norm() == Approx(0).margin(1e-6 * expected.norm()));
+}
+
+TEST_CASE("spectrum estimate", "[solver]")
+{
+	// 1D Laplacian with Dirichlet rows at both ends replaced by rows of the identity
+	const int n = 200;
+	std::vector<Eigen::Triplet<double>> entries;
+	for (int i = 0; i < n; ++i)
+	{
+		if (i == 0 || i == n - 1)
+		{
+			entries.emplace_back(i, i, 1);
+			continue;
+		}
+		entries.emplace_back(i, i, 2);
+		entries.emplace_back(i, i - 1, -1);
+		entries.emplace_back(i, i + 1, -1);
+	}
+	StiffnessMatrix A(n, n);
+	A.setFromTriplets(entries.begin(), entries.end());
+	const std::vector<int> dirichlet_nodes = {0, n - 1};
+
+	auto solver = polysolve::LinearSolver::create("Eigen::SparseLU", "");
+	solver->analyzePattern(A, A.rows());
+	solver->factorize(A);
+
+	// eigenvalues of the interior block
+	const int m = n - 2;
+	const auto eigenvalue = [&](const int k) { return 2 - 2 * std::cos(k * M_PI / (m + 1)); };
+
+	const Eigen::Vector4d spectrum = solver::estimate_spectrum(*solver, A, dirichlet_nodes, 20);
+	CHECK(spectrum[0] == Approx(eigenvalue(1)).epsilon(1e-6));
+	CHECK(spectrum[3] == Approx(eigenvalue(m)).epsilon(1e-2));
+	CHECK(spectrum[3] / spectrum[0] == Approx(eigenvalue(m) / eigenvalue(1)).epsilon(1e-2));
+	CHECK(spectrum[0] <= spectrum[1]);
+	CHECK(spectrum[2] <= spectrum[3]);
+
+	// a small operator is reduced exactly
+	const Eigen::VectorXd ritz = solver::lanczos_ritz_values(
+		4, [](const Eigen::VectorXd &x, Eigen::VectorXd &y) { y = Eigen::Vector4d(1, 2, 3, 4).cwiseProduct(x); }, {false, false, true, false}, 10);
+	REQUIRE(ritz.size() == 3);
+	CHECK(ritz[0] == Approx(1));
+	CHECK(ritz[1] == Approx(2));
+	CHECK(ritz[2] == Approx(4));
+}
+
+TEST_CASE("modal_basis", "[solver]")
+{
+	// P1 elements of a 1D bar, fixed at both ends
+	const int n = 60;
+	const double h = 1. / (n - 1);
+	std::vector<Eigen::Triplet<double>> k_triplets, m_triplets;
+	for (int e = 0; e + 1 < n; ++e)
+	{
+		for (int a = 0; a < 2; ++a)
+		{
+			for (int b = 0; b < 2; ++b)
+			{
+				k_triplets.emplace_back(e + a, e + b, (a == b ? 1 : -1) / h);
+				m_triplets.emplace_back(e + a, e + b, (a == b ? 2 : 1) * h / 6);
+			}
+		}
+	}
+	StiffnessMatrix stiffness(n, n), mass(n, n);
+	stiffness.setFromTriplets(k_triplets.begin(), k_triplets.end());
+	mass.setFromTriplets(m_triplets.begin(), m_triplets.end());
+	const std::vector<int> boundary_nodes = {0, n - 1};
+
+	const int n_modes = 8;
+	const json linear_params = R"({"solver": "Eigen::SparseLU", "precond": ""})"_json;
+	const polyfem::solver::ModalBasis modal(stiffness, mass, boundary_nodes, n_modes, 0, 1e-10, linear_params, n);
+	REQUIRE(modal.n_modes() == n_modes);
+
+	// dense reference on the free dofs
+	const Eigen::MatrixXd K = Eigen::MatrixXd(stiffness).block(1, 1, n - 2, n - 2);
+	const Eigen::MatrixXd M = Eigen::MatrixXd(mass).block(1, 1, n - 2, n - 2);
+	const Eigen::GeneralizedSelfAdjointEigenSolver<Eigen::MatrixXd> reference(K, M);
+	for (int i = 0; i < n_modes; ++i)
+		REQUIRE(modal.eigenvalues()[i] == Approx(reference.eigenvalues()[i]).epsilon(1e-8));
+
+	const Eigen::MatrixXd &phi = modal.modes();
+	REQUIRE((phi.transpose() * mass * phi - Eigen::MatrixXd::Identity(n_modes, n_modes)).norm() == Approx(0).margin(1e-8));
+	REQUIRE((Eigen::MatrixXd(phi.transpose() * stiffness * phi) - Eigen::MatrixXd(modal.eigenvalues().asDiagonal())).norm() == Approx(0).margin(1e-6 * modal.eigenvalues().maxCoeff()));
+	REQUIRE(phi.row(0).norm() == 0);
+	REQUIRE(phi.row(n - 1).norm() == 0);
+
+	// a field in the span of the modes is recovered from its modal coordinates
+	const Eigen::VectorXd q = Eigen::VectorXd::Random(n_modes);
+	REQUIRE((modal.project(modal.expand(q)) - q).norm() == Approx(0).margin(1e-8));
+}
+
+TEST_CASE("linear_load_cases", "[solver]")
+{
+	const std::string path = POLYFEM_DATA_DIR;
+	json in_args = R"(
+		{
+			"materials": {
+				"type": "LinearElasticity",
+				"E": 1e5,
+				"nu": 0.3,
+				"rho": 1000
+			},
+
+			"geometry": [{
+				"mesh": "",
+				"enabled": true,
+				"type": "mesh",
+				"surface_selection": 7
+			}],
+
+			"boundary_conditions": {
+				"dirichlet_boundary": [{
+					"id": "all",
+					"value": [0, 0]
+				}]
+			},
+
+			"output": {
+				"log": {
+					"level": "warning"
+				}
+			}
+		})"_json;
+	in_args["geometry"][0]["mesh"] = path + "/contact/meshes/2D/simple/circle/circle36.obj";
+
+	const std::vector<json> loads = {{10, 10}, {0, -5}, {"x", "y"}};
+
+	const auto build_state = [&](const json &args) {
+		auto state = std::make_shared<State>();
+		state->init(args, true);
+		state->set_max_threads(1);
+		state->load_mesh();
+		state->build_basis();
+		state->assemble_rhs();
+		state->assemble_mass_mat();
+		return state;
+	};
+
+	json cases_args = in_args;
+	cases_args["boundary_conditions"]["load_cases"] = json::array();
+	for (const json &load : loads)
+		cases_args["boundary_conditions"]["load_cases"].push_back({{"rhs", load}});
+
+	const auto state = build_state(cases_args);
+	Eigen::MatrixXd sols, pressures;
+	state->solve_linear_load_cases(state->args["boundary_conditions"]["load_cases"].get<std::vector<json>>(), sols, pressures);
+	REQUIRE(sols.cols() == loads.size());
+	REQUIRE(pressures.size() == 0);
+
+	// same as one solve per load case
+	for (int c = 0; c < loads.size(); ++c)
+	{
+		json case_args = in_args;
+		case_args["boundary_conditions"]["rhs"] = loads[c];
+
+		Eigen::MatrixXd sol, pressure;
+		build_state(case_args)->solve_linear(sol, pressure);
+
+		REQUIRE(sol.size() == sols.rows());
+		REQUIRE((sols.col(c) - sol).norm() == Approx(0).margin(1e-8 * std::max(1., sol.norm())));
+	}
+}
+
+TEST_CASE("job_server", "[solver]")
+{
+	json base_args = R"(
+		{
+			"materials": {"type": "LinearElasticity", "E": 100, "nu": 0.3},
+
+			"geometry": [{
+				"mesh": "",
+				"surface_selection": 7
+			}],
+
+			"boundary_conditions": {
+				"dirichlet_boundary": [{
+					"id": "all",
+					"value": ["0.1 * x", "0"]
+				}]
+			},
+
+			"solver": {"linear": {"solver": "Eigen::SimplicialLDLT"}}
+		})"_json;
+	base_args["geometry"][0]["mesh"] = std::string(POLYFEM_DATA_DIR) + "/contact/meshes/2D/simple/circle/circle36.obj";
+	base_args["/output/directory"_json_pointer] = (std::filesystem::temp_directory_path() / "polyfem_job_server_test").string();
+	base_args["/output/log/level"_json_pointer] = "error";
+
+	JobServer server(base_args, true);
+
+	std::stringstream in, out;
+	in << R"({"jsonrpc": "2.0", "id": 1, "method": "solve", "params": {"return_solution": true}})" << std::endl;
+	// same geometry, new boundary conditions and material
+	in << R"({"jsonrpc": "2.0", "id": 2, "method": "solve", "params": {"return_solution": true, "patch": {"materials": {"E": 200}, "boundary_conditions": {"dirichlet_boundary": [{"id": "all", "value": ["0.2 * x", "0"]}]}}}})" << std::endl;
+	in << R"({"jsonrpc": "2.0", "id": 3, "method": "unknown"})" << std::endl;
+	in << R"({"jsonrpc": "2.0", "id": 4, "method": "shutdown"})" << std::endl;
+	in << R"({"jsonrpc": "2.0", "id": 5, "method": "stats"})" << std::endl;
+	server.run(in, out);
+
+	std::vector<json> responses;
+	std::string line;
+	while (std::getline(out, line))
+		responses.push_back(json::parse(line));
+
+	// the server stops after shutdown
+	REQUIRE(responses.size() == 4);
+	REQUIRE(!server.is_running());
+
+	const json &cold = responses[0]["result"];
+	const json &warm = responses[1]["result"];
+	CHECK(!cold["warm"].get<bool>());
+	CHECK(warm["warm"].get<bool>());
+
+	// the Dirichlet displacement is doubled, the solution doubles whatever the material
+	const std::vector<double> tmp0 = cold["solution"], tmp1 = warm["solution"];
+	const Eigen::VectorXd sol0 = Eigen::Map<const Eigen::VectorXd>(tmp0.data(), tmp0.size());
+	const Eigen::VectorXd sol1 = Eigen::Map<const Eigen::VectorXd>(tmp1.data(), tmp1.size());
+	REQUIRE(sol0.size() == sol1.size());
+	CHECK((sol1 - 2 * sol0).norm() == Approx(0).margin(1e-8 * std::max(1., sol1.norm())));
+
+	CHECK(responses[2]["error"]["code"] == -32601);
+	CHECK(responses[3]["result"]["jobs"] == 2);
+	CHECK(responses[3]["result"]["cache_hits"] == 1);
+}
+
+TEST_CASE("ensemble_runner", "[solver]")
+{
+	json base_args = R"(
+		{
+			"materials": {"type": "LinearElasticity", "E": 100, "nu": 0.3},
+
+			"geometry": [{
+				"mesh": "",
+				"surface_selection": 7
+			}],
+
+			"boundary_conditions": {
+				"dirichlet_boundary": [{
+					"id": "all",
+					"value": ["0.1 * x", "0"]
+				}]
+			},
+
+			"solver": {"linear": {"solver": "Eigen::SimplicialLDLT"}}
+		})"_json;
+	base_args["geometry"][0]["mesh"] = std::string(POLYFEM_DATA_DIR) + "/contact/meshes/2D/simple/circle/circle36.obj";
+	const std::filesystem::path outdir = std::filesystem::temp_directory_path() / "polyfem_ensemble_test";
+	base_args["/output/directory"_json_pointer] = outdir.string();
+
+	// the Dirichlet displacement is scaled by the job index, the last job is invalid
+	std::vector<json> patches;
+	for (int i = 1; i <= 4; ++i)
+	{
+		json patch;
+		patch["materials"]["E"] = 100 * i;
+		patch["boundary_conditions"]["dirichlet_boundary"] = {{{"id", "all"}, {"value", {fmt::format("{} * x", 0.1 * i), "0"}}}};
+		patches.push_back(patch);
+	}
+	patches.push_back(R"({"materials": {"type": "Unknown"}})"_json);
+
+	const EnsembleRunner runner(base_args, true, 2);
+	CHECK(runner.job_args(patches[0], 0)["solver"]["max_threads"] == 1);
+	CHECK(runner.job_args(patches[0], 3)["output"]["directory"] == (outdir / "job_3").string());
+
+	const std::vector<json> results = runner.run(patches, /*return_solution=*/true);
+	REQUIRE(results.size() == patches.size());
+
+	const std::vector<double> tmp0 = results[0]["solution"];
+	const Eigen::VectorXd sol0 = Eigen::Map<const Eigen::VectorXd>(tmp0.data(), tmp0.size());
+	for (int i = 0; i < 4; ++i)
+	{
+		REQUIRE(results[i]["success"].get<bool>());
+		CHECK(results[i]["index"] == i);
+		const std::vector<double> tmp = results[i]["solution"];
+		const Eigen::VectorXd sol = Eigen::Map<const Eigen::VectorXd>(tmp.data(), tmp.size());
+		REQUIRE(sol.size() == sol0.size());
+		CHECK((sol - (i + 1) * sol0).norm() == Approx(0).margin(1e-8 * std::max(1., sol.norm())));
+	}
+
+	CHECK(!results[4]["success"].get<bool>());
+	CHECK(results[4].contains("error"));
+
+	std::filesystem::remove_all(outdir);
+}
@@ -1,6 +1,9 @@
 #include <polyfem/time_integrator/ImplicitEuler.hpp>
 #include <polyfem/time_integrator/ImplicitNewmark.hpp>
 #include <polyfem/time_integrator/BDF.hpp>
+#include <polyfem/time_integrator/AdaptiveTimeStepping.hpp>
+#include <polyfem/time_integrator/CentralDifference.hpp>
+#include <polyfem/time_integrator/RingBuffer.hpp>
 
 #include <finitediff.hpp>
 
@@ -98,4 +101,252 @@ TEST_CASE("time integrator", "[time_integrator]")
 		x.setRandom();
 		x /= 100;
 	}
-}
\ No newline at end of file
+}
+
+TEST_CASE("time integrator set dt", "[time_integrator]")
+{
+	const int n = 3;
+	const double dt = 0.1;
+
+	// quadratic trajectories are reproduced exactly by the interpolation of a 3 step history
+	const auto x_at = [](const double t) -> Eigen::VectorXd { return Eigen::Vector3d(1 + t, 2 * t * t, -t + 3 * t * t); };
+
+	BDF bdf;
+	bdf.set_parameters(R"({"steps": 3})"_json);
+	std::vector<Eigen::VectorXd> x_prevs, v_prevs, a_prevs;
+	for (int i = 0; i < 3; ++i)
+	{
+		x_prevs.push_back(x_at(-i * dt));
+		v_prevs.push_back(Eigen::VectorXd::Zero(n));
+		a_prevs.push_back(Eigen::VectorXd::Zero(n));
+	}
+	bdf.init(x_prevs, v_prevs, a_prevs, dt);
+	REQUIRE(bdf.steps() == 3);
+
+	// smaller step, all the samples are interpolated
+	bdf.set_dt(dt / 2);
+	CHECK(bdf.dt() == dt / 2);
+	REQUIRE(bdf.steps() == 3);
+	for (int j = 0; j < bdf.steps(); ++j)
+		CHECK((bdf.x_prevs()[j] - x_at(-j * dt / 2)).norm() == Approx(0).margin(1e-12));
+
+	// larger step, the samples older than the history are dropped
+	bdf.set_dt(dt / 2 * 3);
+	REQUIRE(bdf.steps() == 1);
+	CHECK((bdf.x_prev() - x_at(0)).norm() == Approx(0).margin(1e-12));
+
+	// single step integrators keep their state
+	ImplicitEuler euler;
+	euler.init(x_at(0), Eigen::VectorXd::Ones(n), Eigen::VectorXd::Zero(n), dt);
+	euler.set_dt(2 * dt);
+	CHECK(euler.steps() == 1);
+	CHECK((euler.x_predictor() - (x_at(0) + 2 * dt * Eigen::VectorXd::Ones(n))).norm() == Approx(0).margin(1e-12));
+}
+
+TEST_CASE("adaptive time stepping", "[time_integrator]")
+{
+	const json params = R"({
+		"enabled": true,
+		"rel_tol": 0,
+		"abs_tol": 1e-3,
+		"min_ratio": 0.01,
+		"max_ratio": 10,
+		"safety": 0.9,
+		"min_factor": 0.2,
+		"max_factor": 2,
+		"failure_factor": 0.5
+	})"_json;
+	const double dt = 0.1;
+
+	AdaptiveTimeStepping stepping(params, dt);
+
+	ImplicitEuler euler;
+	euler.init(Eigen::VectorXd::Zero(4), Eigen::VectorXd::Zero(4), Eigen::VectorXd::Zero(4), dt);
+
+	// exact prediction, accepted and grown by the maximum factor
+	CHECK(stepping.error(euler, Eigen::VectorXd::Zero(4)) == 0);
+	CHECK(stepping.update(0, euler.order()));
+	CHECK(stepping.dt() == Approx(2 * dt));
+
+	// large error, rejected and shrunk without going below the minimum factor
+	const double error = stepping.error(euler, Eigen::VectorXd::Constant(4, 0.1));
+	CHECK(error == Approx(100));
+	CHECK(!stepping.update(error, euler.order()));
+	CHECK(stepping.dt() == Approx(0.2 * 2 * dt));
+	CHECK(stepping.n_rejections() == 1);
+
+	// failures shrink down to the minimum step size
+	while (stepping.reduce())
+		;
+	CHECK(stepping.dt() == Approx(0.01 * dt));
+
+	// steps at the minimum step size are always accepted
+	CHECK(stepping.update(100, euler.order()));
+}
+
+TEST_CASE("variable order BDF", "[time_integrator]")
+{
+	const json params = R"({
+		"enabled": true,
+		"rel_tol": 0,
+		"abs_tol": 0.1,
+		"min_ratio": 0.01,
+		"max_ratio": 10,
+		"safety": 0.5,
+		"min_factor": 0.2,
+		"max_factor": 2,
+		"failure_factor": 0.5
+	})"_json;
+	const double dt = 0.1;
+
+	const auto x_at = [](const double t) -> Eigen::VectorXd { return Eigen::Vector3d(1 + t, 2 * t * t, -t + 3 * t * t); };
+
+	BDF bdf;
+	bdf.set_parameters(R"({"steps": 3, "variable_order": true})"_json);
+	bdf.init(x_at(0), Eigen::VectorXd::Zero(3), Eigen::VectorXd::Zero(3), dt);
+	CHECK(bdf.order() == 1);
+	CHECK(bdf.max_order() == 3);
+
+	// the backward differences of a quadratic vanish from the third one
+	bdf.update_quantities(x_at(dt));
+	bdf.update_quantities(x_at(2 * dt));
+	CHECK(bdf.order() == 1);
+	Eigen::VectorXd e;
+	bdf.local_error(x_at(3 * dt), 1, e);
+	CHECK((e - Eigen::Vector3d(0, 2 * dt * dt, 3 * dt * dt)).norm() == Approx(0).margin(1e-12));
+	bdf.local_error(x_at(3 * dt), 2, e);
+	CHECK(e.norm() == Approx(0).margin(1e-12));
+
+	// the controller raises the order to the exact one and grows the step without rejections
+	bdf.init(x_at(0), Eigen::VectorXd::Zero(3), Eigen::VectorXd::Zero(3), dt);
+	AdaptiveTimeStepping stepping(params, dt);
+	double time = 0;
+	for (int i = 0; i < 10; ++i)
+	{
+		const double next = time + bdf.dt();
+		const Eigen::VectorXd x = x_at(next);
+		if (stepping.update(bdf, x))
+		{
+			bdf.update_quantities(x);
+			time = next;
+		}
+		bdf.set_dt(stepping.dt());
+	}
+	CHECK(bdf.order() == 2);
+	CHECK(stepping.n_rejections() == 0);
+	CHECK(stepping.dt() > dt);
+}
+
+TEST_CASE("central difference", "[time_integrator]")
+{
+	// chain of two springs (stiffness k) and masses m, the first DoF is fixed
+	const double k = 100, m = 2;
+	Eigen::MatrixXd K(3, 3);
+	K << k, -k, 0,
+		-k, 2 * k, -k,
+		0, -k, k;
+	const auto stiffness_product = [&](const Eigen::VectorXd &x, Eigen::VectorXd &out) { out = K * x; };
+
+	Eigen::VectorXd x(3), v = Eigen::VectorXd::Zero(3);
+	x << 0, 0.1, 0.3;
+
+	CentralDifference integrator;
+	integrator.init(x, v, Eigen::VectorXd::Constant(3, m), {0}, 1);
+
+	// eigenvalues of the free 2x2 block are (3 +- sqrt(5)) / 2 k / m
+	const double lambda_max = (3 + std::sqrt(5)) / 2 * k / m;
+	const double critical_dt = integrator.stable_dt(stiffness_product);
+	CHECK(critical_dt == Approx(2 / std::sqrt(lambda_max)).epsilon(1e-3));
+
+	const auto energy = [&]() {
+		return 0.5 * m * integrator.v().squaredNorm() + 0.5 * integrator.x().dot(K * integrator.x());
+	};
+	const double initial_energy = energy();
+
+	const double dt = 0.1 * critical_dt;
+	integrator.set_dt(dt);
+
+	Eigen::VectorXd force = -K * integrator.x();
+	integrator.init_acceleration(force);
+	for (int t = 0; t < 1000; ++t)
+	{
+		integrator.update_position();
+		integrator.set_prescribed(Eigen::VectorXd::Zero(3));
+		force = -K * integrator.x();
+		integrator.update_velocity(force);
+	}
+
+	// the fixed DoF does not move and the energy is conserved up to O(dt^2)
+	CHECK(integrator.x()[0] == 0);
+	CHECK(integrator.v()[0] == 0);
+	CHECK(energy() == Approx(initial_energy).epsilon(1e-2));
+
+	// the integration blows up above the critical time step
+	integrator.init(x, v, Eigen::VectorXd::Constant(3, m), {0}, 1.1 * critical_dt);
+	force = -K * integrator.x();
+	integrator.init_acceleration(force);
+	for (int t = 0; t < 200; ++t)
+	{
+		integrator.update_position();
+		force = -K * integrator.x();
+		integrator.update_velocity(force);
+	}
+	CHECK(integrator.x().norm() > 1e3 * x.norm());
+}
+
+TEST_CASE("ring buffer", "[time_integrator]")
+{
+	RingBuffer buffer;
+	buffer.reset(3);
+	CHECK(buffer.empty());
+
+	for (int i = 0; i < 5; ++i)
+		buffer.push_front(Eigen::VectorXd::Constant(2, i));
+
+	// the two oldest vectors have been dropped, the most recent is first
+	REQUIRE(buffer.size() == 3);
+	for (int i = 0; i < 3; ++i)
+		CHECK(buffer[i][0] == 4 - i);
+	CHECK(buffer.back()[0] == 2);
+
+	// pushing reuses the storage of the dropped vector
+	const double *oldest = buffer.back().data();
+	buffer.push_front(Eigen::VectorXd::Constant(2, 5));
+	CHECK(buffer.front().data() == oldest);
+
+	buffer.pop_back();
+	buffer.push_back(Eigen::VectorXd::Constant(2, -1));
+	CHECK(buffer.size() == 3);
+	CHECK(buffer.back()[0] == -1);
+}
+
+TEST_CASE("BDF in place history", "[time_integrator]")
+{
+	const int n = 5;
+	const double dt = 0.1;
+	BDF bdf;
+	bdf.set_parameters(R"({"steps": 3})"_json);
+	bdf.init(Eigen::VectorXd::Zero(n), Eigen::VectorXd::Ones(n), Eigen::VectorXd::Zero(n), dt);
+
+	Eigen::VectorXd out;
+	for (int t = 1; t <= 5; ++t)
+	{
+		const Eigen::VectorXd x = Eigen::VectorXd::LinSpaced(n, 0, 1) * (t * dt) * (t * dt);
+
+		const double beta_dt = bdf.beta_dt();
+		const Eigen::VectorXd sum_x = bdf.weighted_sum_x_prevs(), sum_v = bdf.weighted_sum_v_prevs();
+		const Eigen::VectorXd expected_x_tilde = sum_x + beta_dt * sum_v;
+
+		bdf.x_tilde(out);
+		CHECK((out - expected_x_tilde).norm() == Approx(0).margin(1e-12));
+		CHECK((bdf.x_tilde() - expected_x_tilde).norm() == Approx(0).margin(1e-12));
+		bdf.weighted_sum_x_prevs(out);
+		CHECK((out - sum_x).norm() == Approx(0).margin(1e-12));
+
+		CHECK((bdf.compute_velocity(x) - (x - sum_x) / beta_dt).norm() == Approx(0).margin(1e-10));
+
+		bdf.update_quantities(x);
+		CHECK(bdf.steps() == std::min(t + 1, 3));
+		CHECK((bdf.x_prev() - x).norm() == 0);
+	}
+}
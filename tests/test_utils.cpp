@@ -1,9 +1,17 @@
 ////////////////////////////////////////////////////////////////////////////////
 #include <polyfem/utils/InterpolatedFunction.hpp>
+#include <polyfem/utils/LoopCostModel.hpp>
 #include <polyfem/utils/RBFInterpolation.hpp>
 #include <polyfem/utils/Bessel.hpp>
+#include <polyfem/utils/Logger.hpp>
 #include <polyfem/utils/ExpressionValue.hpp>
+#include <polyfem/utils/FlatHashMap.hpp>
+#include <polyfem/utils/MaybeParallelFor.hpp>
+#include <polyfem/utils/Profiler.hpp>
+#include <polyfem/utils/Selection.hpp>
+#include <polyfem/utils/ThreadPinning.hpp>
 #include <polyfem/io/MshReader.hpp>
+#include <polyfem/mesh/CollisionGroups.hpp>
 #include <polyfem/mesh/Mesh.hpp>
 
 #ifdef POLYFEM_WITH_REMESHING
@@ -12,6 +20,15 @@
 
 #include <Eigen/Dense>
 
+#include <spdlog/sinks/ostream_sink.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <map>
+#include <numeric>
+#include <sstream>
+
 #include <catch2/catch.hpp>
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -103,6 +120,344 @@ TEST_CASE("expression", "[utils]")
 	REQUIRE(val(2, 3, 4) == Approx(1).margin(1e-16));
 }
 
+TEST_CASE("expression_value_parallel", "[utils]")
+{
+	utils::ExpressionValue expr;
+	expr.init(json("x^2+sqrt(x*y)+sin(z)*t"));
+	// copies share the compiled expression
+	const utils::ExpressionValue copy = expr;
+
+	const int n = 10000;
+	Eigen::VectorXd res(n);
+	utils::maybe_parallel_for(n, [&](int start, int end, int thread_id) {
+		for (int i = start; i < end; ++i)
+		{
+			const double x = 1 + i * 1e-3;
+			res(i) = (i % 2 == 0 ? expr : copy)(x, 2 * x, 3 * x, 0.5);
+		}
+	});
+
+	for (int i = 0; i < n; ++i)
+	{
+		const double x = 1 + i * 1e-3;
+		REQUIRE(res(i) == Approx(x * x + sqrt(x * 2 * x) + sin(3 * x) * 0.5).margin(1e-10));
+	}
+}
+
+TEST_CASE("expression_value_time_dependence", "[utils]")
+{
+	utils::ExpressionValue expr;
+
+	expr.init(json("x^2+sin(z)*t"));
+	CHECK(expr.is_time_dependent());
+	expr.init(json("t"));
+	CHECK(expr.is_time_dependent());
+	expr.init(json("tan(x)+sqrt(y)*1e-3"));
+	CHECK(!expr.is_time_dependent());
+	expr.init(json(2.5));
+	CHECK(!expr.is_time_dependent());
+	expr.init(std::function<double(double, double, double)>([](double x, double y, double z) { return x; }));
+	CHECK(!expr.is_time_dependent());
+	expr.init(std::function<double(double, double, double, double)>([](double x, double y, double z, double t) { return x * t; }));
+	CHECK(expr.is_time_dependent());
+}
+
+TEST_CASE("expression_value_batch", "[utils]")
+{
+	Eigen::MatrixXd pts2d(20, 2), pts3d(20, 3);
+	pts2d.setRandom();
+	pts3d.setRandom();
+
+	for (const json &value : {json("x^2+sqrt(abs(x*y))+sin(z)*t"), json(3.5)})
+	{
+		utils::ExpressionValue expr;
+		expr.init(value);
+
+		for (const Eigen::MatrixXd &pts : {pts2d, pts3d})
+		{
+			Eigen::VectorXd res;
+			expr.eval(pts, 0.5, res);
+			REQUIRE(res.size() == pts.rows());
+
+			for (int i = 0; i < pts.rows(); ++i)
+			{
+				const double expected = expr(pts(i, 0), pts(i, 1), pts.cols() == 2 ? 0 : pts(i, 2), 0.5);
+				REQUIRE(res(i) == Approx(expected).margin(1e-12));
+			}
+		}
+	}
+}
+
+TEST_CASE("selection_list", "[utils]")
+{
+	const int dim = GENERATE(2, 3);
+
+	Selection::BBox bbox;
+	bbox[0] = RowVectorNd::Zero(dim);
+	bbox[1] = RowVectorNd::Ones(dim);
+
+	json j_selections = json::array();
+	srand(42);
+	const auto coord = [&]() {
+		std::vector<double> x(dim);
+		for (double &v : x)
+			v = double(rand()) / RAND_MAX;
+		return x;
+	};
+	for (int i = 0; i < 100; ++i)
+	{
+		json j;
+		j["id"] = i + 1;
+		if (i % 3 == 0)
+		{
+			std::vector<double> a = coord(), b = a;
+			for (double &v : b)
+				v += 0.2;
+			j["box"] = {a, b};
+		}
+		else if (i % 3 == 1)
+		{
+			j["center"] = coord();
+			j["radius"] = 0.1;
+		}
+		else
+		{
+			j["p1"] = coord();
+			j["p2"] = coord();
+			j["radius"] = 0.05;
+		}
+		j_selections.push_back(j);
+	}
+	// unbounded selection in the middle of the list
+	j_selections.insert(j_selections.begin() + 50, json{{"id", 1000}, {"axis", 1}, {"position", 0.9}});
+
+	const std::vector<std::shared_ptr<Selection>> selections = Selection::build_selections(j_selections, bbox);
+	const SelectionList list(selections);
+
+	for (int k = 0; k < 10000; ++k)
+	{
+		const std::vector<double> x = coord();
+		const RowVectorNd p = Eigen::Map<const RowVectorNd>(x.data(), dim);
+
+		int expected = -1;
+		for (const auto &selection : selections)
+		{
+			if (selection->inside(k, {}, p))
+			{
+				expected = selection->id(k, {}, p);
+				break;
+			}
+		}
+
+		REQUIRE(list.id(k, {}, p, -1) == expected);
+	}
+}
+
+TEST_CASE("flat_hash_map", "[utils]")
+{
+	// sorted edges of a grid, each edge appears in up to two cells
+	const int n = 50;
+	std::map<std::array<int, 2>, int> expected;
+	std::vector<std::array<int, 2>> edges;
+	for (int i = 0; i < n; ++i)
+	{
+		for (int j = 0; j < n; ++j)
+		{
+			const int v = i * (n + 1) + j;
+			const std::array<int, 4> quad = {{v, v + 1, v + n + 2, v + n + 1}};
+			for (int k = 0; k < 4; ++k)
+			{
+				const int v0 = quad[k], v1 = quad[(k + 1) % 4];
+				edges.push_back({{std::min(v0, v1), std::max(v0, v1)}});
+				expected.emplace(edges.back(), int(expected.size()));
+			}
+		}
+	}
+
+	FlatHashMap<2, int> sequential;
+	for (const auto &e : edges)
+	{
+		const int next = sequential.size();
+		const auto [value, inserted] = sequential.emplace(e, next);
+		CHECK(inserted == (*value == next));
+	}
+
+	FlatHashMap<2, int> bulk;
+	bulk.bulk_emplace(
+		edges.size(), [&](int i) { return edges[i]; }, [&](int i) { return i; });
+
+	REQUIRE(sequential.size() == expected.size());
+	REQUIRE(bulk.size() == expected.size());
+	// the keys are in insertion order, the first insertion wins
+	CHECK(bulk.keys() == sequential.keys());
+	for (const auto &[key, id] : expected)
+	{
+		REQUIRE(sequential.find(key) != nullptr);
+		CHECK(sequential.at(key) == id);
+		CHECK(sequential.keys()[id] == key);
+		CHECK(edges[bulk.at(key)] == key);
+	}
+
+	CHECK(sequential.find({{n, 0}}) == nullptr);
+	CHECK(!bulk.contains({{-1, 2}}));
+	CHECK_THROWS_AS(bulk.at({{-1, 2}}), std::out_of_range);
+
+	bulk.clear();
+	CHECK(bulk.empty());
+	CHECK(bulk.find(edges[0]) == nullptr);
+	CHECK(bulk.emplace(edges[0], 3).second);
+	CHECK(bulk.at(edges[0]) == 3);
+}
+
+TEST_CASE("profiler", "[utils]")
+{
+	Profiler &profiler = Profiler::instance();
+	profiler.set_buffer_size(16);
+	profiler.clear();
+	profiler.set_enabled(true);
+
+	for (int i = 0; i < 3; ++i)
+	{
+		ProfileScope outer("outer");
+		for (int j = 0; j < 2; ++j)
+			ProfileScope inner("inner");
+		ProfileScope other("other");
+	}
+	{
+		ProfileScope inner("inner");
+	}
+
+	profiler.set_enabled(false);
+	{
+		// not recorded
+		ProfileScope outer("outer");
+	}
+
+	const json summary = profiler.summary();
+	std::map<std::string, json> entries;
+	for (const auto &e : summary)
+		entries[e["path"]] = e;
+
+	REQUIRE(entries.size() == 4);
+	CHECK(entries.at("outer")["calls"] == 3);
+	CHECK(entries.at("outer/inner")["calls"] == 6);
+	CHECK(entries.at("outer/other")["calls"] == 3);
+	CHECK(entries.at("inner")["calls"] == 1);
+	CHECK(entries.at("outer")["total"].get<double>() >= entries.at("outer/inner")["total"].get<double>());
+	CHECK(entries.at("outer")["self"].get<double>() <= entries.at("outer")["total"].get<double>());
+
+	profiler.clear();
+	CHECK(profiler.summary().empty());
+}
+
+TEST_CASE("maybe_parallel_for", "[utils]")
+{
+	for (const int n : {0, 1, 7, 100003})
+	{
+		auto storages = utils::create_thread_storage<long>(0);
+		utils::maybe_parallel_for(n, [&](int start, int end, int thread_id) {
+			long &local = utils::get_local_thread_storage(storages, thread_id);
+			for (int i = start; i < end; ++i)
+				local += i;
+		});
+
+		long sum = 0;
+		for (const long &local : storages)
+			sum += local;
+		CHECK(sum == long(n) * (n - 1) / 2);
+
+		std::vector<int> visited(n, 0);
+		utils::maybe_parallel_for(n, [&](int i) { ++visited[i]; });
+		CHECK(std::count(visited.begin(), visited.end(), 1) == n);
+	}
+
+	// nested loops
+	std::atomic<int> count(0);
+	utils::maybe_parallel_for(64, [&](int start, int end, int) {
+		for (int i = start; i < end; ++i)
+			utils::maybe_parallel_for(16, [&](int s, int e, int) { count += e - s; });
+	});
+	CHECK(count == 64 * 16);
+
+	// the exceptions of the workers reach the caller
+	CHECK_THROWS(utils::maybe_parallel_for(1000, [&](int start, int end, int) {
+		if (start <= 500 && 500 < end)
+			throw std::runtime_error("error");
+	}));
+}
+
+TEST_CASE("maybe_parallel_fill", "[utils]")
+{
+	for (const size_t n : {size_t(0), size_t(5), size_t(1) << 20, (size_t(1) << 20) + 3})
+	{
+		std::vector<double> values(n, -1);
+		utils::maybe_parallel_fill(values.data(), values.size(), 2.5);
+		CHECK(std::count(values.begin(), values.end(), 2.5) == n);
+
+		std::vector<int> visited(n, 0);
+		utils::maybe_parallel_for_static(int(n), [&](int start, int end, int) {
+			for (int i = start; i < end; ++i)
+				++visited[i];
+		});
+		CHECK(std::count(visited.begin(), visited.end(), 1) == n);
+	}
+
+#ifdef POLYFEM_WITH_TBB
+	// the pinned threads run the loops of the arena and are released after
+	utils::TaskArena arena(2);
+	{
+		utils::ThreadPinning pinning(arena);
+		utils::TaskArenaScope scope(&arena);
+
+		std::vector<double> values(size_t(1) << 20);
+		utils::maybe_parallel_fill(values.data(), values.size(), 1.0);
+		CHECK(std::accumulate(values.begin(), values.end(), 0.0) == values.size());
+	}
+#endif
+}
+
+TEST_CASE("loop_cost_model", "[utils]")
+{
+	// a few iterations are much more expensive
+	std::vector<double> costs(1000, 1);
+	for (int i = 0; i < 10; ++i)
+		costs[i] = 100;
+
+	LoopCostModel model;
+	model.init(costs);
+
+	for (const int n_chunks : {1, 4, 16})
+	{
+		const std::vector<int> chunks = model.partition(n_chunks);
+		REQUIRE(chunks.size() >= 2);
+		REQUIRE(chunks.size() <= n_chunks + 1);
+		CHECK(chunks.front() == 0);
+		CHECK(chunks.back() == 1000);
+
+		double max_cost = 0;
+		for (int c = 0; c + 1 < chunks.size(); ++c)
+		{
+			CHECK(chunks[c] < chunks[c + 1]);
+			max_cost = std::max(max_cost, std::accumulate(costs.begin() + chunks[c], costs.begin() + chunks[c + 1], 0.0));
+		}
+		// balanced up to one iteration
+		CHECK(max_cost <= 1990.0 / n_chunks + 100);
+	}
+
+	// the measured times replace the estimates
+	model.record({0, 500, 1000}, {1, 3});
+	CHECK(std::accumulate(model.costs().begin(), model.costs().begin() + 500, 0.0) == Approx(1));
+	CHECK(std::accumulate(model.costs().begin() + 500, model.costs().end(), 0.0) == Approx(3));
+
+	std::vector<int> visited(1000, 0);
+	utils::maybe_parallel_for(model, [&](int start, int end, int thread_id) {
+		for (int i = start; i < end; ++i)
+			++visited[i];
+	});
+	CHECK(std::count(visited.begin(), visited.end(), 1) == 1000);
+	CHECK(model.size() == 1000);
+}
+
 TEST_CASE("mshreader", "[utils]")
 {
 	const std::string path = POLYFEM_DATA_DIR;
@@ -117,4 +472,64 @@ TEST_CASE("wmtk_instatiation", "[utils]")
 {
 	wmtk::TriMesh mesh;
 }
-#endif
\ No newline at end of file
+#endif
+
+TEST_CASE("collision_groups", "[utils]")
+{
+	const CollisionGroups none;
+	CHECK(none.is_trivial());
+	CHECK(none.can_collide(none.group(3), none.group(3)));
+	CHECK(none.can_collide(none.group(3), none.obstacle_group()));
+	CHECK(!none.can_collide(none.obstacle_group(), none.obstacle_group()));
+
+	const json groups = R"([
+		{"body_ids": [1, 2], "self_collision": false},
+		{"body_ids": [3]},
+		{"body_ids": [4]}
+	])"_json;
+	const CollisionGroups collision_groups(groups, R"([[1, 2]])"_json);
+
+	CHECK(!collision_groups.is_trivial());
+	CHECK(collision_groups.n_groups() == 5);
+	CHECK(collision_groups.group(2) == 0);
+	CHECK(collision_groups.group(4) == 2);
+	CHECK(collision_groups.group(7) == collision_groups.default_group());
+
+	// self collision of the first group is off, the others keep it
+	CHECK(!collision_groups.can_collide(0, 0));
+	CHECK(collision_groups.can_collide(1, 1));
+	CHECK(collision_groups.can_collide(0, 1));
+	// disabled pair, in both orders
+	CHECK(!collision_groups.can_collide(1, 2));
+	CHECK(!collision_groups.can_collide(2, 1));
+	CHECK(collision_groups.can_collide(collision_groups.default_group(), 2));
+
+	CHECK_THROWS(CollisionGroups(groups, R"([[0, 3]])"_json));
+	CHECK_THROWS(CollisionGroups(R"([{"body_ids": [1]}, {"body_ids": [1]}])"_json, json::array()));
+}
+
+TEST_CASE("json_log_records", "[utils]")
+{
+	std::ostringstream os;
+	auto sink = std::make_shared<spdlog::sinks::ostream_sink_mt>(os);
+	sink->set_formatter(std::make_unique<JSONLogFormatter>());
+	spdlog::logger json_logger("polyfem", sink);
+	json_logger.set_level(spdlog::level::debug);
+
+	json_logger.info("iteration {} energy {}", 3, 1.5);
+	json_logger.debug("quotes \"{}\" and\ttab\\ \x1b[35mcolor\x1b[0m", "name");
+	json_logger.trace("disabled {}", 1);
+
+	std::istringstream lines(os.str());
+	std::vector<json> records;
+	for (std::string line; std::getline(lines, line);)
+		records.push_back(json::parse(line));
+
+	REQUIRE(records.size() == 2);
+	CHECK(records[0]["level"] == "info");
+	CHECK(records[0]["logger"] == "polyfem");
+	CHECK(records[0]["msg"] == "iteration 3 energy 1.5");
+	CHECK(records[0]["time"].get<double>() > 0);
+	CHECK(records[1]["level"] == "debug");
+	CHECK(records[1]["msg"] == "quotes \"name\" and\ttab\\ \x1b[35mcolor\x1b[0m");
+}